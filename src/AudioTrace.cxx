@@ -0,0 +1,94 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "AudioTrace.hxx"
+
+AudioTrace *audio_trace;
+
+static constexpr uint64_t
+RoundUpPowerOfTwo(uint64_t n) noexcept
+{
+	uint64_t result = 1;
+	while (result < n)
+		result <<= 1;
+	return result;
+}
+
+AudioTrace::AudioTrace(size_t size) noexcept
+	:start(std::chrono::steady_clock::now()),
+	 slots(new Slot[RoundUpPowerOfTwo(size)]),
+	 mask(RoundUpPowerOfTwo(size) - 1)
+{
+}
+
+void
+AudioTrace::Record(AudioTraceEvent event, const void *chunk,
+		   SignedSongTime chunk_time, const void *object,
+		   uint32_t value) noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	const uint64_t i = head.fetch_add(1, std::memory_order_relaxed);
+	Slot &slot = slots[i & mask];
+
+	slot.sequence.store(i * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.time.store(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count(),
+			std::memory_order_relaxed);
+	slot.event.store(event, std::memory_order_relaxed);
+	slot.chunk.store(chunk, std::memory_order_relaxed);
+	slot.chunk_time.store(chunk_time.ToMS(), std::memory_order_relaxed);
+	slot.object.store(object, std::memory_order_relaxed);
+	slot.value.store(value, std::memory_order_relaxed);
+
+	slot.sequence.store((i + 1) * 2, std::memory_order_release);
+}
+
+const char *
+ToString(AudioTraceEvent event) noexcept
+{
+	switch (event) {
+	case AudioTraceEvent::CHUNK_ALLOCATE:
+		return "chunk_allocate";
+
+	case AudioTraceEvent::DECODER_SUBMIT:
+		return "decoder_submit";
+
+	case AudioTraceEvent::PIPE_PUSH:
+		return "pipe_push";
+
+	case AudioTraceEvent::PIPE_SHIFT:
+		return "pipe_shift";
+
+	case AudioTraceEvent::FILTER_BEGIN:
+		return "filter_begin";
+
+	case AudioTraceEvent::FILTER_END:
+		return "filter_end";
+
+	case AudioTraceEvent::OUTPUT_PLAY:
+		return "output_play";
+
+	case AudioTraceEvent::OUTPUT_UNDERRUN:
+		return "output_underrun";
+	}
+
+	return "unknown";
+}
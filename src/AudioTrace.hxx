@@ -0,0 +1,237 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_AUDIO_TRACE_HXX
+#define MPD_AUDIO_TRACE_HXX
+
+#include "Chrono.hxx"
+#include "util/Compiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include <stdint.h>
+
+/**
+ * The trace points along the audio pipeline.
+ */
+enum class AudioTraceEvent : uint8_t {
+	/**
+	 * MusicBuffer::Allocate() has returned a chunk; the value
+	 * is the number of allocated chunks.
+	 */
+	CHUNK_ALLOCATE,
+
+	/**
+	 * The decoder has finished a chunk; the value is its length
+	 * in bytes.
+	 */
+	DECODER_SUBMIT,
+
+	/**
+	 * A chunk has been appended to a #MusicPipe; the value is
+	 * the new pipe size.
+	 */
+	PIPE_PUSH,
+
+	/**
+	 * A chunk has been removed from a #MusicPipe; the value is
+	 * the new pipe size.
+	 */
+	PIPE_SHIFT,
+
+	/**
+	 * An output begins filtering a chunk; the value is its length
+	 * in bytes.
+	 */
+	FILTER_BEGIN,
+
+	/**
+	 * An output has finished filtering a chunk; the value is the
+	 * length of the filtered data in bytes.
+	 */
+	FILTER_END,
+
+	/**
+	 * AudioOutput::Play() has returned; the value is the number
+	 * of bytes it has consumed.
+	 */
+	OUTPUT_PLAY,
+
+	/**
+	 * An output has run out of chunks while playing.
+	 */
+	OUTPUT_UNDERRUN,
+};
+
+/**
+ * A ring buffer which records events of the audio pipeline with
+ * their time stamps, for reconstructing the latency of each chunk.
+ * Recording is lock-free and may be done by any number of threads
+ * concurrently; old events are overwritten.
+ */
+class AudioTrace {
+	struct Slot {
+		/**
+		 * A sequence lock: odd while a writer fills this
+		 * slot, (index + 1) * 2 after it has finished.
+		 */
+		std::atomic<uint64_t> sequence{0};
+
+		/**
+		 * Nanoseconds since #start.
+		 */
+		std::atomic<uint64_t> time;
+
+		std::atomic<const void *> chunk, object;
+
+		/**
+		 * MusicChunk::time in milliseconds, or -1.
+		 */
+		std::atomic<int32_t> chunk_time;
+
+		std::atomic<uint32_t> value;
+
+		std::atomic<AudioTraceEvent> event;
+	};
+
+	const std::chrono::steady_clock::time_point start;
+
+	const std::unique_ptr<Slot[]> slots;
+
+	/**
+	 * The number of slots minus one; the number of slots is a
+	 * power of two.
+	 */
+	const uint64_t mask;
+
+	std::atomic<uint64_t> head{0};
+
+public:
+	/**
+	 * @param size the minimum number of events to be kept
+	 */
+	explicit AudioTrace(size_t size) noexcept;
+
+	void Record(AudioTraceEvent event, const void *chunk,
+		    SignedSongTime chunk_time, const void *object,
+		    uint32_t value) noexcept;
+
+	struct Entry {
+		std::chrono::nanoseconds time;
+		AudioTraceEvent event;
+		const void *chunk;
+		SignedSongTime chunk_time;
+		const void *object;
+		uint32_t value;
+	};
+
+	/**
+	 * Invoke the given function for all events, oldest first.
+	 * Events which are being overwritten concurrently are
+	 * skipped.
+	 */
+	template<typename F>
+	void ForEach(F &&f) const noexcept {
+		const uint64_t end = head.load(std::memory_order_acquire);
+		const uint64_t begin = end > mask ? end - mask - 1 : 0;
+
+		for (uint64_t i = begin; i < end; ++i) {
+			const Slot &slot = slots[i & mask];
+
+			const uint64_t sequence =
+				slot.sequence.load(std::memory_order_acquire);
+			if (sequence != (i + 1) * 2)
+				continue;
+
+			const Entry e{
+				std::chrono::nanoseconds(slot.time.load(std::memory_order_relaxed)),
+				slot.event.load(std::memory_order_relaxed),
+				slot.chunk.load(std::memory_order_relaxed),
+				SignedSongTime::FromMS(slot.chunk_time.load(std::memory_order_relaxed)),
+				slot.object.load(std::memory_order_relaxed),
+				slot.value.load(std::memory_order_relaxed),
+			};
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+				continue;
+
+			f(e);
+		}
+	}
+};
+
+gcc_const
+const char *
+ToString(AudioTraceEvent event) noexcept;
+
+/**
+ * The global #AudioTrace instance; nullptr if tracing is disabled.
+ * It is set up before any audio thread starts and freed after they
+ * have all exited, so it may be read without synchronization.
+ */
+extern AudioTrace *audio_trace;
+
+/**
+ * Record a trace event if tracing is enabled.  This costs only a
+ * load and a branch if it is not.
+ *
+ * @param chunk an opaque chunk identifier (its address) or nullptr
+ * @param object an opaque identifier of the #MusicPipe or output
+ */
+static inline void
+TraceAudio(AudioTraceEvent event, const void *chunk,
+	   SignedSongTime chunk_time, const void *object,
+	   uint32_t value=0) noexcept
+{
+	AudioTrace *const trace = audio_trace;
+	if (gcc_unlikely(trace != nullptr))
+		trace->Record(event, chunk, chunk_time, object, value);
+}
+
+/**
+ * Enables tracing (see #audio_trace) for the lifetime of this
+ * object.
+ */
+class ScopeAudioTraceInit {
+	std::unique_ptr<AudioTrace> trace;
+
+public:
+	/**
+	 * @param size the number of events to be kept; 0 disables
+	 * tracing
+	 */
+	explicit ScopeAudioTraceInit(size_t size) {
+		if (size > 0) {
+			trace = std::make_unique<AudioTrace>(size);
+			audio_trace = trace.get();
+		}
+	}
+
+	~ScopeAudioTraceInit() noexcept {
+		audio_trace = nullptr;
+	}
+
+	ScopeAudioTraceInit(const ScopeAudioTraceInit &) = delete;
+	ScopeAudioTraceInit &operator=(const ScopeAudioTraceInit &) = delete;
+};
+
+#endif
@@ -43,9 +43,6 @@ IcyMetaDataParser::Reset() noexcept
 	if (!IsDefined())
 		return;
 
-	if (data_rest == 0 && meta_size > 0)
-		delete[] meta_data;
-
 	tag.reset();
 
 	data_rest = data_size;
@@ -135,7 +132,7 @@ find_end_quote(char *p, char *const end) noexcept
 }
 
 static std::unique_ptr<Tag>
-icy_parse_tag(
+icy_parse_tag(TagBuilder &tag,
 #ifdef HAVE_ICU_CONVERTER
 	      const IcuConverter *icu_converter,
 #endif
@@ -144,8 +141,7 @@ icy_parse_tag(
 	assert(p != nullptr);
 	assert(end != nullptr);
 	assert(p <= end);
-
-	TagBuilder tag;
+	assert(tag.empty());
 
 	while (p != end) {
 		const char *const name = p;
@@ -214,10 +210,8 @@ IcyMetaDataParser::Meta(const void *data, size_t length) noexcept
 		   return value */
 		--length;
 
-		/* initialize metadata reader, allocate enough
-		   memory (+1 for the null terminator) */
+		/* initialize metadata reader */
 		meta_position = 0;
-		meta_data = new char[meta_size + 1];
 	}
 
 	assert(meta_position < meta_size);
@@ -235,12 +229,11 @@ IcyMetaDataParser::Meta(const void *data, size_t length) noexcept
 	if (meta_position == meta_size) {
 		/* parse */
 
-		tag = icy_parse_tag(
+		tag = icy_parse_tag(tag_builder,
 #ifdef HAVE_ICU_CONVERTER
 				    icu_converter.get(),
 #endif
 				    meta_data, meta_data + meta_size);
-		delete[] meta_data;
 
 		/* change back to normal data mode */
 
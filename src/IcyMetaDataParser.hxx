@@ -22,6 +22,7 @@
 
 #include "lib/icu/Converter.hxx"
 #include "tag/Tag.hxx"
+#include "tag/Builder.hxx"
 #include "config.h"
 
 #include <memory>
@@ -32,12 +33,25 @@ class IcyMetaDataParser {
 	size_t data_size = 0, data_rest;
 
 	size_t meta_size, meta_position;
-	char *meta_data;
+
+	/**
+	 * The buffer for the current metadata block.  Its size is
+	 * limited by the protocol (the length byte is multiplied by
+	 * 16), so it is allocated only once, together with this
+	 * object; +1 for the null terminator.
+	 */
+	char meta_data[255 * 16 + 1];
 
 #ifdef HAVE_ICU_CONVERTER
 	std::unique_ptr<IcuConverter> icu_converter;
 #endif
 
+	/**
+	 * This object is reused for each metadata block, to avoid
+	 * reallocating its item list.
+	 */
+	TagBuilder tag_builder;
+
 	std::unique_ptr<Tag> tag;
 
 public:
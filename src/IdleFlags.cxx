@@ -25,6 +25,8 @@
 #include "IdleFlags.hxx"
 #include "util/ASCII.hxx"
 
+#include <iterator>
+
 #include <assert.h>
 
 static const char *const idle_names[] = {
@@ -45,6 +47,9 @@ static const char *const idle_names[] = {
 	nullptr
 };
 
+static_assert(std::size(idle_names) == IDLE_N_FLAGS + 1,
+	      "Wrong number of idle names");
+
 const char*const*
 idle_get_names() noexcept
 {
@@ -24,6 +24,11 @@
 #include "Stats.hxx"
 #include "client/List.hxx"
 #include "input/cache/Manager.hxx"
+#include "PictureCache.hxx"
+#include "client/CommandPool.hxx"
+#include "client/Threads.hxx"
+#include "command/CommandStats.hxx"
+#include "metrics/Server.hxx"
 
 #ifdef ENABLE_CURL
 #include "RemoteTagCache.hxx"
@@ -33,6 +38,7 @@
 #ifdef ENABLE_DATABASE
 #include "db/DatabaseError.hxx"
 #include "db/Interface.hxx"
+#include "db/QueryCache.hxx"
 #include "db/update/Service.hxx"
 #include "storage/StorageInterface.hxx"
 
@@ -57,6 +63,14 @@ Instance::Instance()
 
 Instance::~Instance() noexcept
 {
+	metrics_server.reset();
+
+	/* close all clients before the database; this cancels
+	   commands which are running in a #CommandPool thread */
+	client_list.reset();
+	client_threads.reset();
+	command_pool.reset();
+
 #ifdef ENABLE_DATABASE
 	delete update;
 
@@ -91,6 +105,17 @@ Instance::GetDatabaseOrThrow() const
 	return *database;
 }
 
+void
+Instance::InvalidateDatabaseCaches() noexcept
+{
+	unique_tags_cache.Clear();
+
+	if (query_cache != nullptr)
+		query_cache->Clear();
+
+	++db_version;
+}
+
 void
 Instance::OnDatabaseModified() noexcept
 {
@@ -99,6 +124,7 @@ Instance::OnDatabaseModified() noexcept
 	/* propagate the change to all subsystems */
 
 	stats_invalidate();
+	InvalidateDatabaseCaches();
 
 	for (auto &partition : partitions)
 		partition.DatabaseModified(*database);
@@ -153,7 +179,8 @@ Instance::LookupRemoteTag(const char *uri) noexcept
 
 	if (!remote_tag_cache)
 		remote_tag_cache = std::make_unique<RemoteTagCache>(event_loop,
-								    *this);
+								    *this,
+								    RemoteTagCacheConfig());
 
 	remote_tag_cache->Lookup(uri);
 }
@@ -169,4 +196,20 @@ Instance::OnRemoteTag(const char *uri, const Tag &tag) noexcept
 		partition.TagModified(uri, tag);
 }
 
+void
+Instance::BeginRemoteTagBatch() noexcept
+{
+	/* increment the queue version and emit "playlist" only once
+	   per batch, not once per song */
+	for (auto &partition : partitions)
+		partition.playlist.BeginBulk();
+}
+
+void
+Instance::CommitRemoteTagBatch() noexcept
+{
+	for (auto &partition : partitions)
+		partition.playlist.CommitBulk(partition.pc);
+}
+
 #endif
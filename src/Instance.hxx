@@ -42,8 +42,10 @@ class NeighborGlue;
 #ifdef ENABLE_DATABASE
 #include "db/DatabaseListener.hxx"
 #include "db/Ptr.hxx"
+#include "db/UniqueTagsCache.hxx"
 class Storage;
 class UpdateService;
+class QueryCache;
 #endif
 
 #include <memory>
@@ -55,6 +57,11 @@ class StateFile;
 class RemoteTagCache;
 class StickerDatabase;
 class InputCacheManager;
+class PictureCache;
+class CommandPool;
+class CommandStatsLogger;
+class MetricsServer;
+class ClientThreads;
 
 /**
  * A utility class which, when used as the first base class, ensures
@@ -101,6 +108,12 @@ struct Instance final
 
 	std::unique_ptr<InputCacheManager> input_cache;
 
+	/**
+	 * Pictures sent by "albumart" and "readpicture".  This is
+	 * nullptr if "picture_cache_size" is zero.
+	 */
+	std::unique_ptr<PictureCache> picture_cache;
+
 	MaskMonitor idle_monitor;
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -117,12 +130,64 @@ struct Instance final
 	Storage *storage = nullptr;
 
 	UpdateService *update = nullptr;
+
+	/**
+	 * Shall "load" add database songs to the queue without
+	 * looking them up first?  See #LazySongResolver.
+	 */
+	bool lazy_playlist_load = false;
+
+	/**
+	 * Results of recent "list" commands.  It is cleared by
+	 * OnDatabaseModified().
+	 */
+	UniqueTagsCache unique_tags_cache;
+
+	/**
+	 * Rendered responses of recent "find", "search" and "count"
+	 * commands; nullptr if "query_cache_size" is zero.  It is
+	 * cleared by InvalidateDatabaseCaches().
+	 */
+	std::unique_ptr<QueryCache> query_cache;
+
+	/**
+	 * Incremented by InvalidateDatabaseCaches(), i.e. each time
+	 * the database has been modified.  Reported to clients in
+	 * "status" as "db_version", so they can cache query results
+	 * on their side.
+	 */
+	unsigned db_version = 0;
 #endif
 
 #ifdef ENABLE_CURL
 	std::unique_ptr<RemoteTagCache> remote_tag_cache;
 #endif
 
+	/**
+	 * Executes heavy read-only commands; nullptr if
+	 * "command_threads" is zero.
+	 */
+	std::unique_ptr<CommandPool> command_pool;
+
+	/**
+	 * Logs the #CommandStats periodically; nullptr if
+	 * "command_stats_interval" is zero.
+	 */
+	std::unique_ptr<CommandStatsLogger> command_stats_logger;
+
+	/**
+	 * The HTTP server configured with the "metrics" block;
+	 * nullptr if not configured.
+	 */
+	std::unique_ptr<MetricsServer> metrics_server;
+
+	/**
+	 * The threads which perform the socket I/O of clients;
+	 * nullptr if "client_threads" is zero (the main thread does
+	 * it).
+	 */
+	std::unique_ptr<ClientThreads> client_threads;
+
 	std::unique_ptr<ClientList> client_list;
 
 	std::list<Partition> partitions;
@@ -172,6 +237,13 @@ struct Instance final
 	 * music_directory was configured).
 	 */
 	const Database &GetDatabaseOrThrow() const;
+
+	/**
+	 * Discard all cached query results and increment
+	 * #db_version.  Call this after the database has been
+	 * modified.
+	 */
+	void InvalidateDatabaseCaches() noexcept;
 #endif
 
 #ifdef ENABLE_SQLITE
@@ -206,6 +278,8 @@ private:
 #ifdef ENABLE_CURL
 	/* virtual methods from class RemoteTagCacheHandler */
 	void OnRemoteTag(const char *uri, const Tag &tag) noexcept override;
+	void BeginRemoteTagBatch() noexcept override;
+	void CommitRemoteTagBatch() noexcept override;
 #endif
 
 	/* callback for #idle_monitor */
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "LazySongResolver.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "IdleFlags.hxx"
+#include "SongLoader.hxx"
+#include "playlist/PlaylistSong.hxx"
+#include "song/DetachedSong.hxx"
+
+#include <vector>
+
+void
+LazySongResolver::Add(unsigned id, const char *uri) noexcept
+try {
+	pending[id] = uri;
+
+	if (!timer.IsActive())
+		timer.Schedule(std::chrono::steady_clock::duration::zero());
+} catch (...) {
+	/* out of memory: the song remains a placeholder, which
+	   will be completed when it is played */
+}
+
+inline int
+LazySongResolver::Find(unsigned id, const std::string &uri) const noexcept
+{
+	const auto &queue = partition.playlist.queue;
+	int position = queue.IdToPosition(id);
+	if (position >= 0 && !queue.Get(position).IsURI(uri.c_str()))
+		/* the id was reused */
+		position = -1;
+
+	return position;
+}
+
+bool
+LazySongResolver::Resolve(unsigned position) noexcept
+{
+	auto &instance = partition.instance;
+	const SongLoader loader(instance.GetDatabase(), instance.storage);
+
+	auto &queue = partition.playlist.queue;
+	if (!playlist_check_translate_song(queue.Get(position), nullptr,
+					   loader))
+		return false;
+
+	queue.ModifyAtPosition(position);
+	return true;
+}
+
+inline void
+LazySongResolver::Modified() noexcept
+{
+	partition.playlist.queue.IncrementVersion();
+	partition.EmitIdle(IDLE_PLAYLIST);
+}
+
+void
+LazySongResolver::ResolveNow(unsigned id) noexcept
+{
+	auto i = pending.find(id);
+	if (i == pending.end())
+		return;
+
+	const int position = Find(id, i->second);
+	pending.erase(i);
+
+	if (position >= 0 && Resolve(position))
+		Modified();
+}
+
+void
+LazySongResolver::OnTimer() noexcept
+{
+	bool modified = false;
+	std::vector<unsigned> missing;
+
+	for (unsigned n = 0; n < BATCH_SIZE && !pending.empty(); ++n) {
+		auto i = pending.begin();
+		const unsigned id = i->first;
+		const int position = Find(id, i->second);
+		pending.erase(i);
+
+		if (position < 0)
+			continue;
+
+		if (Resolve(position))
+			modified = true;
+		else
+			missing.push_back(id);
+	}
+
+	for (unsigned id : missing) {
+		try {
+			partition.DeleteId(id);
+		} catch (...) {
+		}
+	}
+
+	if (modified)
+		Modified();
+
+	if (!pending.empty())
+		/* continue after the EventLoop has handled other
+		   events */
+		timer.Schedule(std::chrono::steady_clock::duration::zero());
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LAZY_SONG_RESOLVER_HXX
+#define MPD_LAZY_SONG_RESOLVER_HXX
+
+#include "event/TimerEvent.hxx"
+
+#include <map>
+#include <string>
+
+struct Partition;
+class DetachedSong;
+
+/**
+ * Completes placeholder songs which were added to the queue by
+ * "load" without looking them up in the database (see option
+ * "playlist_lazy_load").  This happens in small batches, between
+ * which the #EventLoop handles other events, and immediately if the
+ * player needs one of them.  Clients are notified with the
+ * "playlist" idle event.
+ *
+ * Placeholders which turn out to be missing from the database are
+ * removed from the queue.
+ */
+class LazySongResolver final {
+	/**
+	 * The maximum number of songs resolved in one OnTimer() call.
+	 */
+	static constexpr unsigned BATCH_SIZE = 64;
+
+	Partition &partition;
+
+	TimerEvent timer;
+
+	/**
+	 * Queue song id to the song's URI.  The URI is compared
+	 * before the song is resolved, because the id may have been
+	 * reused by another song meanwhile.
+	 */
+	std::map<unsigned, std::string> pending;
+
+public:
+	LazySongResolver(EventLoop &_loop, Partition &_partition) noexcept
+		:partition(_partition),
+		 timer(_loop, BIND_THIS_METHOD(OnTimer)) {}
+
+	/**
+	 * Register a placeholder song which was just added to the
+	 * queue.
+	 */
+	void Add(unsigned id, const char *uri) noexcept;
+
+	/**
+	 * Resolve the given song right now if it is a pending
+	 * placeholder.  Unlike the background resolution, a missing
+	 * song is left in the queue, because the caller is about to
+	 * submit it to the player, which will report the error.
+	 */
+	void ResolveNow(unsigned id) noexcept;
+
+private:
+	/**
+	 * Look up the given queue position.
+	 *
+	 * @return false if the song does not exist (any more)
+	 */
+	bool Resolve(unsigned position) noexcept;
+
+	/**
+	 * @return the queue position of the pending song or -1 if it
+	 * is gone
+	 */
+	int Find(unsigned id, const std::string &uri) const noexcept;
+
+	/**
+	 * Publish the modifications made by Resolve().
+	 */
+	void Modified() noexcept;
+
+	void OnTimer() noexcept;
+};
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "LogAsync.hxx"
+#include "LogBackend.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "util/BindMethod.hxx"
+#include "util/ForeignFifoBuffer.hxx"
+#include "util/Domain.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static constexpr Domain log_async_domain("log");
+
+namespace {
+
+/**
+ * Precedes each message in the buffer.
+ */
+struct LogEntryHeader {
+	time_t time;
+	const Domain *domain;
+	size_t length;
+	LogLevel level;
+};
+
+class AsyncLogger {
+	Mutex mutex;
+	Cond cond;
+
+	const std::unique_ptr<uint8_t[]> storage;
+
+	/**
+	 * A sequence of #LogEntryHeader, each followed by the
+	 * message text.  It never grows; if it is full, new messages
+	 * are dropped.  Protected by #mutex.
+	 */
+	ForeignFifoBuffer<uint8_t> buffer;
+
+	/**
+	 * The writer thread copies the #buffer contents here, to be
+	 * able to write them without holding the mutex.
+	 */
+	const std::unique_ptr<uint8_t[]> scratch;
+
+	Thread thread;
+
+	/**
+	 * The number of messages dropped since the last notice.
+	 * Protected by #mutex.
+	 */
+	uint64_t n_dropped = 0;
+
+	bool quit = false;
+
+public:
+	explicit AsyncLogger(size_t buffer_size) noexcept
+		:storage(new uint8_t[buffer_size]),
+		 buffer(storage.get(), buffer_size),
+		 scratch(new uint8_t[buffer_size]),
+		 thread(BIND_THIS_METHOD(Run)) {}
+
+	void Start() {
+		thread.Start();
+	}
+
+	void Stop() noexcept {
+		{
+			const std::lock_guard<Mutex> protect(mutex);
+			quit = true;
+			cond.notify_one();
+		}
+
+		thread.Join();
+	}
+
+	void Push(LogLevel level, const Domain &domain,
+		  const char *msg) noexcept;
+
+private:
+	void WriteEntries(const uint8_t *p, size_t size) noexcept;
+
+	void Run() noexcept;
+};
+
+}
+
+static AsyncLogger *async_logger;
+
+static std::atomic<uint64_t> total_dropped{0};
+
+inline void
+AsyncLogger::Push(LogLevel level, const Domain &domain,
+		  const char *msg) noexcept
+{
+	const LogEntryHeader header{time(nullptr), &domain, strlen(msg), level};
+	const size_t size = sizeof(header) + header.length;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	const bool was_empty = buffer.empty() && n_dropped == 0;
+
+	if (buffer.WantWrite(size)) {
+		auto w = buffer.Write();
+		memcpy(w.data, &header, sizeof(header));
+		memcpy(w.data + sizeof(header), msg, header.length);
+		buffer.Append(size);
+	} else {
+		++n_dropped;
+		total_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/* the writer thread waits only while there is nothing to
+	   do */
+	if (was_empty)
+		cond.notify_one();
+}
+
+inline void
+AsyncLogger::WriteEntries(const uint8_t *p, size_t size) noexcept
+{
+	while (size > 0) {
+		assert(size >= sizeof(LogEntryHeader));
+
+		LogEntryHeader header;
+		memcpy(&header, p, sizeof(header));
+		p += sizeof(header);
+		size -= sizeof(header);
+
+		assert(size >= header.length);
+
+		LogWrite(header.level, *header.domain, header.time,
+			 (const char *)p, header.length);
+		p += header.length;
+		size -= header.length;
+	}
+}
+
+void
+AsyncLogger::Run() noexcept
+{
+	SetThreadName("log");
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (true) {
+		if (buffer.empty() && n_dropped == 0) {
+			if (quit)
+				break;
+
+			cond.wait(lock);
+			continue;
+		}
+
+		const auto r = buffer.Read();
+		const size_t size = r.size;
+		std::copy_n(r.data, size, scratch.get());
+		buffer.Clear();
+
+		const uint64_t dropped = n_dropped;
+		n_dropped = 0;
+
+		lock.unlock();
+
+		WriteEntries(scratch.get(), size);
+
+		if (dropped > 0) {
+			char msg[64];
+			int length = snprintf(msg, sizeof(msg),
+					      "%" PRIu64 " log messages dropped",
+					      dropped);
+			LogWrite(LogLevel::WARNING, log_async_domain,
+				 time(nullptr), msg, length);
+		}
+
+		lock.lock();
+	}
+}
+
+static void
+AsyncLogDispatcher(LogLevel level, const Domain &domain,
+		   const char *msg) noexcept
+{
+	async_logger->Push(level, domain, msg);
+}
+
+void
+LogStartAsync(size_t buffer_size)
+{
+	assert(async_logger == nullptr);
+	assert(buffer_size > sizeof(LogEntryHeader));
+
+	auto logger = std::make_unique<AsyncLogger>(buffer_size);
+	logger->Start();
+	async_logger = logger.release();
+
+	SetLogDispatcher(AsyncLogDispatcher);
+}
+
+void
+LogStopAsync() noexcept
+{
+	if (async_logger == nullptr)
+		return;
+
+	SetLogDispatcher(nullptr);
+
+	async_logger->Stop();
+	delete async_logger;
+	async_logger = nullptr;
+}
+
+uint64_t
+LogGetDropped() noexcept
+{
+	return total_dropped.load(std::memory_order_relaxed);
+}
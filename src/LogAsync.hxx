@@ -0,0 +1,55 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LOG_ASYNC_HXX
+#define MPD_LOG_ASYNC_HXX
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Start a thread which writes all log messages.  Log() then only
+ * copies the message into a buffer of the given size and never
+ * blocks on the log file or on syslog; if the buffer is full, the
+ * message is dropped and counted.
+ *
+ * This must be called after daemonization, because the thread does
+ * not survive fork().
+ *
+ * Throws on error.
+ */
+void
+LogStartAsync(size_t buffer_size);
+
+/**
+ * Write all pending messages, stop the thread and revert to
+ * synchronous logging.  No other thread may log while this function
+ * runs.
+ */
+void
+LogStopAsync() noexcept;
+
+/**
+ * Returns the number of log messages which were dropped because the
+ * buffer was full.
+ */
+uint64_t
+LogGetDropped() noexcept;
+
+#endif
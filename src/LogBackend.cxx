@@ -23,6 +23,8 @@
 #include "util/StringStrip.hxx"
 #include "config.h"
 
+#include <atomic>
+
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -69,6 +71,8 @@ static bool enable_timestamp;
 static bool enable_syslog;
 #endif
 
+static std::atomic<LogDispatcher> log_dispatcher{nullptr};
+
 void
 SetLogThreshold(LogLevel _threshold) noexcept
 {
@@ -87,26 +91,14 @@ EnableLogTimestamp() noexcept
 }
 
 static const char *
-log_date() noexcept
+log_date(time_t t) noexcept
 {
 	static constexpr size_t LOG_DATE_BUF_SIZE = 16;
 	static char buf[LOG_DATE_BUF_SIZE];
-	time_t t = time(nullptr);
 	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ", localtime(&t));
 	return buf;
 }
 
-/**
- * Determines the length of the string excluding trailing whitespace
- * characters.
- */
-static int
-chomp_length(const char *p) noexcept
-{
-	size_t length = strlen(p);
-	return StripRight(p, length);
-}
-
 #ifdef HAVE_SYSLOG
 
 gcc_const
@@ -135,11 +127,12 @@ ToSysLogLevel(LogLevel log_level) noexcept
 }
 
 static void
-SysLog(const Domain &domain, LogLevel log_level, const char *message) noexcept
+SysLog(const Domain &domain, LogLevel log_level,
+       const char *message, int length) noexcept
 {
 	syslog(ToSysLogLevel(log_level), "%s: %.*s",
 	       domain.GetName(),
-	       chomp_length(message), message);
+	       length, message);
 }
 
 void
@@ -159,12 +152,13 @@ LogFinishSysLog() noexcept
 #endif
 
 static void
-FileLog(const Domain &domain, const char *message) noexcept
+FileLog(const Domain &domain, time_t t,
+	const char *message, int length) noexcept
 {
 	fprintf(stderr, "%s%s: %.*s\n",
-		enable_timestamp ? log_date() : "",
+		enable_timestamp ? log_date(t) : "",
 		domain.GetName(),
-		chomp_length(message), message);
+		length, message);
 
 #ifdef _WIN32
 	/* force-flush the log file, because setvbuf() does not seem
@@ -173,6 +167,31 @@ FileLog(const Domain &domain, const char *message) noexcept
 #endif
 }
 
+void
+SetLogDispatcher(LogDispatcher _dispatcher) noexcept
+{
+	log_dispatcher.store(_dispatcher);
+}
+
+void
+LogWrite(LogLevel level, const Domain &domain, time_t t,
+	 const char *msg, size_t length) noexcept
+{
+	const int i_length = StripRight(msg, length);
+
+#ifdef HAVE_SYSLOG
+	if (enable_syslog) {
+		(void)t;
+		SysLog(domain, level, msg, i_length);
+		return;
+	}
+#else
+	(void)level;
+#endif
+
+	FileLog(domain, t, msg, i_length);
+}
+
 #endif /* !ANDROID */
 
 void
@@ -189,13 +208,12 @@ Log(LogLevel level, const Domain &domain, const char *msg) noexcept
 	if (level < log_threshold)
 		return;
 
-#ifdef HAVE_SYSLOG
-	if (enable_syslog) {
-		SysLog(domain, level, msg);
+	const auto dispatcher = log_dispatcher.load(std::memory_order_acquire);
+	if (dispatcher != nullptr) {
+		dispatcher(level, domain, msg);
 		return;
 	}
-#endif
 
-	FileLog(domain, msg);
+	LogWrite(level, domain, time(nullptr), msg, strlen(msg));
 #endif /* !ANDROID */
 }
@@ -22,6 +22,19 @@
 
 #include "LogLevel.hxx"
 
+#include <stddef.h>
+#include <time.h>
+
+class Domain;
+
+/**
+ * A function which receives all log messages passing the threshold
+ * instead of having them written synchronously.  It may be called
+ * from any thread.
+ */
+typedef void (*LogDispatcher)(LogLevel level, const Domain &domain,
+			      const char *msg) noexcept;
+
 void
 SetLogThreshold(LogLevel _threshold) noexcept;
 
@@ -34,4 +47,22 @@ LogInitSysLog() noexcept;
 void
 LogFinishSysLog() noexcept;
 
+/**
+ * Install a #LogDispatcher, or pass nullptr to revert to writing log
+ * messages synchronously.
+ */
+void
+SetLogDispatcher(LogDispatcher dispatcher) noexcept;
+
+/**
+ * Write a message (which has already passed the threshold check) to
+ * the log file or to syslog.  This may block.
+ *
+ * @param t the time the message was generated, for the time stamp
+ * @param length the length of #msg; trailing whitespace is stripped
+ */
+void
+LogWrite(LogLevel level, const Domain &domain, time_t t,
+	 const char *msg, size_t length) noexcept;
+
 #endif /* LOG_H */
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "LogInit.hxx"
 #include "LogBackend.hxx"
+#include "LogAsync.hxx"
 #include "Log.hxx"
 #include "config/Param.hxx"
 #include "config/Data.hxx"
@@ -53,6 +54,12 @@ static constexpr Domain log_domain("log");
 static int out_fd = -1;
 static AllocatedPath out_path = nullptr;
 
+/**
+ * The size of the asynchronous log buffer in bytes; 0 means log
+ * messages are written synchronously.
+ */
+static size_t log_buffer_size;
+
 static void redirect_logs(int fd)
 {
 	assert(fd >= 0);
@@ -138,6 +145,9 @@ log_init(const ConfigData &config, bool verbose, bool use_stdout)
 				: LogLevel::DEFAULT;
 		}));
 
+	log_buffer_size = size_t(config.GetUnsigned(ConfigOption::LOG_BUFFER_SIZE,
+						    0)) * 1024;
+
 	if (use_stdout) {
 		out_fd = STDOUT_FILENO;
 	} else {
@@ -186,14 +196,17 @@ void
 log_deinit() noexcept
 {
 #ifndef ANDROID
+	LogStopAsync();
 	close_log_files();
 	out_path = nullptr;
 #endif
 }
 
-void setup_log_output()
-{
 #ifndef ANDROID
+
+static void
+redirect_log_output()
+{
 	if (out_fd == STDOUT_FILENO)
 		return;
 
@@ -212,6 +225,20 @@ void setup_log_output()
 	redirect_logs(out_fd);
 	close(out_fd);
 	out_fd = -1;
+}
+
+#endif
+
+void setup_log_output()
+{
+#ifndef ANDROID
+	redirect_log_output();
+
+	if (log_buffer_size > 0)
+		/* this is the earliest point where the writer thread
+		   can be started, because it would not survive
+		   daemonization */
+		LogStartAsync(log_buffer_size);
 #endif
 }
 
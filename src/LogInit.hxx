@@ -42,6 +42,13 @@ log_init(const ConfigData &config, bool verbose, bool use_stdout);
 void
 log_deinit() noexcept;
 
+/**
+ * Redirect stdout/stderr to the log file, and start the log writer
+ * thread if "log_buffer_size" is configured.  This must be called
+ * after daemonization.
+ *
+ * Throws on error.
+ */
 void
 setup_log_output();
 
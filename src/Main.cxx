@@ -20,10 +20,12 @@
 #include "config.h"
 #include "Main.hxx"
 #include "Instance.hxx"
+#include "AudioTrace.hxx"
 #include "CommandLine.hxx"
 #include "PlaylistFile.hxx"
 #include "MusicChunk.hxx"
 #include "StateFile.hxx"
+#include "Stats.hxx"
 #include "Mapper.hxx"
 #include "Permission.hxx"
 #include "Listen.hxx"
@@ -40,6 +42,14 @@
 #include "input/Init.hxx"
 #include "input/cache/Config.hxx"
 #include "input/cache/Manager.hxx"
+#include "PictureCache.hxx"
+#include "PluginInit.hxx"
+#include "PluginWarmUp.hxx"
+#include "ThreadConfig.hxx"
+#include "client/CommandPool.hxx"
+#include "client/Threads.hxx"
+#include "command/CommandStats.hxx"
+#include "metrics/Server.hxx"
 #include "event/Loop.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Config.hxx"
@@ -60,6 +70,7 @@
 #include "config/Option.hxx"
 #include "config/Domain.hxx"
 #include "config/Parser.hxx"
+#include "util/Domain.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/ScopeExit.hxx"
 
@@ -70,6 +81,8 @@
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
 #include "db/Configured.hxx"
+#include "db/Loader.hxx"
+#include "db/QueryCache.hxx"
 #include "db/DatabasePlugin.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "storage/Configured.hxx"
@@ -87,6 +100,10 @@
 #include "sticker/Database.hxx"
 #endif
 
+#ifdef ENABLE_CURL
+#include "RemoteTagCache.hxx"
+#endif
+
 #ifdef ENABLE_ARCHIVE
 #include "archive/ArchiveList.hxx"
 #endif
@@ -116,6 +133,8 @@
 #include <locale.h>
 #endif
 
+#include <array>
+
 #include <limits.h>
 
 static constexpr size_t KILOBYTE = 1024;
@@ -123,6 +142,8 @@ static constexpr size_t MEGABYTE = 1024 * KILOBYTE;
 
 static constexpr size_t DEFAULT_BUFFER_SIZE = 4 * MEGABYTE;
 
+static constexpr size_t DEFAULT_PICTURE_CACHE_SIZE = 16 * MEGABYTE;
+
 static constexpr
 size_t MIN_BUFFER_SIZE = std::max(CHUNK_SIZE * 32,
 				  64 * KILOBYTE);
@@ -134,6 +155,55 @@ LogListener *logListener;
 
 Instance *global_instance;
 
+static constexpr Domain startup_domain("startup");
+
+/**
+ * Measures the duration of each startup phase.  The results are
+ * logged by Finish(), because the first phases run before logging
+ * has been configured.
+ */
+class StartupProfiler {
+	struct Entry {
+		const char *name;
+		std::chrono::steady_clock::duration duration;
+	};
+
+	std::array<Entry, 16> phases;
+	unsigned n_phases = 0;
+
+	const std::chrono::steady_clock::time_point start_time =
+		std::chrono::steady_clock::now();
+
+	std::chrono::steady_clock::time_point last_time = start_time;
+
+public:
+	/**
+	 * Mark the end of a phase which began at the end of the
+	 * previous one.
+	 *
+	 * @param name a string literal
+	 */
+	void Phase(const char *name) noexcept {
+		const auto now = std::chrono::steady_clock::now();
+		if (n_phases < phases.size())
+			phases[n_phases++] = {name, now - last_time};
+		last_time = now;
+	}
+
+	void Finish() const noexcept {
+		for (unsigned i = 0; i < n_phases; ++i)
+			FormatDebug(startup_domain, "%s: %.1f ms",
+				    phases[i].name, ToMilliseconds(phases[i].duration));
+
+		FormatInfo(startup_domain, "startup took %.1f ms",
+			   ToMilliseconds(last_time - start_time));
+	}
+
+	static double ToMilliseconds(std::chrono::steady_clock::duration d) noexcept {
+		return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(d).count();
+	}
+};
+
 struct Config {
 	ReplayGainConfig replay_gain;
 
@@ -178,13 +248,68 @@ InitStorage(Instance &instance, EventLoop &event_loop,
 	composite->Mount("", std::move(storage));
 }
 
+static void
+StartupAfterDatabase(Instance &instance, const ConfigData &raw_config,
+		     bool create_db);
+
+/**
+ * Implements the "async_startup" option: the database is opened by a
+ * #DatabaseLoader thread while the main loop serves clients already,
+ * and the state file is restored after that.
+ */
+class AsyncStartup {
+	Instance &instance;
+	const ConfigData &config;
+
+	/**
+	 * The database being opened; it is moved to
+	 * Instance::database when that has finished.
+	 */
+	DatabasePtr db;
+
+	std::unique_ptr<UpdateService> update;
+
+	std::unique_ptr<DatabaseLoader> loader;
+
+	std::chrono::steady_clock::time_point start_time;
+
+public:
+	AsyncStartup(Instance &_instance, const ConfigData &_config) noexcept
+		:instance(_instance), config(_config) {}
+
+	bool IsStarted() const noexcept {
+		return loader != nullptr;
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	void Start(DatabasePtr &&_db, std::unique_ptr<UpdateService> &&_update) {
+		db = std::move(_db);
+		update = std::move(_update);
+		start_time = std::chrono::steady_clock::now();
+
+		loader = std::make_unique<DatabaseLoader>(instance.event_loop, *db,
+							  BIND_THIS_METHOD(OnLoaded));
+		loader->Start();
+	}
+
+private:
+	void OnLoaded(std::exception_ptr error) noexcept;
+};
+
 /**
  * Returns the database.  If this function returns false, this has not
  * succeeded, and the caller should create the database after the
  * process has been daemonized.
+ *
+ * @param async_startup if not nullptr, then the database is opened
+ * asynchronously (if the plugin allows it), and this function returns
+ * true
  */
 static bool
-glue_db_init_and_load(Instance &instance, const ConfigData &config)
+glue_db_init_and_load(Instance &instance, const ConfigData &config,
+		      AsyncStartup *async_startup)
 {
 	auto db = CreateConfiguredDatabase(config, instance.event_loop,
 					   instance.io_thread.GetEventLoop(),
@@ -209,6 +334,22 @@ glue_db_init_and_load(Instance &instance, const ConfigData &config)
 				   "because the database does not need it");
 	}
 
+	instance.lazy_playlist_load =
+		config.GetBool(ConfigOption::PLAYLIST_LAZY_LOAD, false);
+
+	auto *sdb = dynamic_cast<SimpleDatabase *>(db.get());
+
+	if (async_startup != nullptr && sdb != nullptr) {
+		/* SimpleDatabase::Open() only reads files, so it may
+		   run in another thread */
+		auto update = std::make_unique<UpdateService>(config,
+							      instance.event_loop, *sdb,
+							      static_cast<CompositeStorage &>(*instance.storage),
+							      instance);
+		async_startup->Start(std::move(db), std::move(update));
+		return true;
+	}
+
 	try {
 		db->Open();
 	} catch (...) {
@@ -217,7 +358,6 @@ glue_db_init_and_load(Instance &instance, const ConfigData &config)
 
 	instance.database = std::move(db);
 
-	auto *sdb = dynamic_cast<SimpleDatabase *>(instance.database.get());
 	if (sdb == nullptr)
 		return true;
 
@@ -231,12 +371,48 @@ glue_db_init_and_load(Instance &instance, const ConfigData &config)
 }
 
 static bool
-InitDatabaseAndStorage(Instance &instance, const ConfigData &config)
+InitDatabaseAndStorage(Instance &instance, const ConfigData &config,
+		       AsyncStartup *async_startup)
 {
-	const bool create_db = !glue_db_init_and_load(instance, config);
+	const bool create_db = !glue_db_init_and_load(instance, config,
+						       async_startup);
 	return create_db;
 }
 
+void
+AsyncStartup::OnLoaded(std::exception_ptr error) noexcept
+{
+	if (error) {
+		LogError(error, "Failed to open database plugin");
+		instance.Break();
+		return;
+	}
+
+	FormatInfo(startup_domain, "database loaded in %.1f ms",
+		   StartupProfiler::ToMilliseconds(std::chrono::steady_clock::now() - start_time));
+
+	auto &sdb = static_cast<SimpleDatabase &>(*db);
+	const bool create_db = !sdb.FileExists();
+
+	instance.database = std::move(db);
+	instance.update = update.release();
+
+	stats_invalidate();
+	for (auto &partition : instance.partitions)
+		partition.DatabaseModified(*instance.database);
+
+	try {
+		StartupAfterDatabase(instance, config, create_db);
+	} catch (...) {
+		LogError(std::current_exception());
+		instance.Break();
+		return;
+	}
+
+	/* the queue has been restored from the state file */
+	instance.EmitIdle(IDLE_PLAYLIST);
+}
+
 #endif
 
 #ifdef ENABLE_SQLITE
@@ -300,7 +476,8 @@ initialize_decoder_and_player(Instance &instance,
 	} else
 		buffer_size = DEFAULT_BUFFER_SIZE;
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	const size_t chunk_size = MusicChunkSizeForBuffer(buffer_size);
+	const unsigned buffered_chunks = buffer_size / chunk_size;
 
 	if (buffered_chunks >= 1 << 15)
 		throw FormatRuntimeError("buffer size \"%lu\" is too big",
@@ -320,7 +497,7 @@ initialize_decoder_and_player(Instance &instance,
 	instance.partitions.emplace_back(instance,
 					 "default",
 					 max_length,
-					 buffered_chunks,
+					 buffered_chunks, chunk_size,
 					 configured_audio_format,
 					 replay_gain_config);
 	auto &partition = instance.partitions.back();
@@ -330,6 +507,17 @@ initialize_decoder_and_player(Instance &instance,
 			? FromString(s)
 			: ReplayGainMode::OFF;
 	});
+
+	partition.pc.low_latency =
+		config.GetBool(ConfigOption::LOW_LATENCY, false);
+	partition.pc.lock_memory =
+		config.GetBool(ConfigOption::LOCK_MEMORY, false);
+	partition.pc.lookahead_decoder =
+		config.GetBool(ConfigOption::LOOKAHEAD_DECODER, false);
+	partition.pc.float_pipeline =
+		config.GetBool(ConfigOption::FLOAT_PIPELINE, false);
+	partition.pc.shared_decoder =
+		config.GetBool(ConfigOption::SHARED_DECODER, false);
 }
 
 inline void
@@ -366,8 +554,53 @@ Instance::OnIdle(unsigned flags) noexcept
 		state_file->CheckModified();
 }
 
+/**
+ * The part of the startup which needs the database: create it if it
+ * failed to load, restore the state file, watch the music directory
+ * and enable the audio outputs.
+ */
+static void
+StartupAfterDatabase(Instance &instance, const ConfigData &raw_config,
+		     gcc_unused bool create_db)
+{
+#ifdef ENABLE_DATABASE
+	if (create_db) {
+		/* the database failed to load: recreate the
+		   database */
+		instance.update->Enqueue("", true);
+	}
+#endif
+
+	glue_state_file_init(instance, raw_config);
+
+#ifdef ENABLE_DATABASE
+	if (raw_config.GetBool(ConfigOption::AUTO_UPDATE, false)) {
+#ifdef ENABLE_INOTIFY
+		if (instance.storage != nullptr &&
+		    instance.update != nullptr)
+			mpd_inotify_init(instance.event_loop,
+					 *instance.storage,
+					 *instance.update,
+					 raw_config.GetUnsigned(ConfigOption::AUTO_UPDATE_DEPTH,
+								INT_MAX));
+#else
+		FormatWarning(config_domain,
+			      "inotify: auto_update was disabled. enable during compilation phase");
+#endif
+	}
+#endif
+
+	Check(raw_config);
+
+	/* enable all audio outputs (if not already done by
+	   playlist_state_restore() */
+	for (auto &partition : instance.partitions)
+		partition.pc.LockUpdateAudio();
+}
+
 static inline void
-MainConfigured(const struct options &options, const ConfigData &raw_config)
+MainConfigured(const struct options &options, const ConfigData &raw_config,
+	       StartupProfiler &profiler)
 {
 #ifdef ENABLE_DAEMON
 	daemonize_close_stdin();
@@ -399,9 +632,21 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 
 	log_init(raw_config, options.verbose, options.log_stderr);
 
+	thread_config_init(raw_config);
+
+	/* this must outlive the Instance, which owns all audio
+	   threads */
+	const ScopeAudioTraceInit audio_trace_init(raw_config.GetUnsigned(ConfigOption::AUDIO_TRACE_SIZE, 0));
+
 	Instance instance;
 	global_instance = &instance;
 
+#ifdef ENABLE_DATABASE
+	AsyncStartup async_startup(instance, raw_config);
+#endif
+
+	profiler.Phase("init");
+
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	instance.neighbors = std::make_unique<NeighborGlue>();
 	instance.neighbors->Init(raw_config,
@@ -416,17 +661,80 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 		raw_config.GetPositive(ConfigOption::MAX_CONN, 10);
 	instance.client_list = std::make_unique<ClientList>(max_clients);
 
+	const unsigned command_threads =
+		raw_config.GetUnsigned(ConfigOption::COMMAND_THREADS, 1);
+	if (command_threads > 0)
+		instance.command_pool =
+			std::make_unique<CommandPool>(command_threads);
+
+	const unsigned client_threads =
+		raw_config.GetUnsigned(ConfigOption::CLIENT_THREADS, 0);
+	if (client_threads > 0)
+		instance.client_threads =
+			std::make_unique<ClientThreads>(client_threads);
+
+	const std::chrono::seconds command_stats_interval(raw_config.GetUnsigned(ConfigOption::COMMAND_STATS_INTERVAL, 0));
+	if (command_stats_interval > std::chrono::seconds::zero())
+		instance.command_stats_logger =
+			std::make_unique<CommandStatsLogger>(instance.event_loop,
+							     command_stats_interval);
+
 	const auto *input_cache_config = raw_config.GetBlock(ConfigBlockOption::INPUT_CACHE);
 	if (input_cache_config != nullptr) {
 		const InputCacheConfig c(*input_cache_config);
 		instance.input_cache = std::make_unique<InputCacheManager>(c);
 	}
 
+#ifdef ENABLE_CURL
+	const auto *remote_tag_cache_config =
+		raw_config.GetBlock(ConfigBlockOption::REMOTE_TAG_CACHE);
+	if (remote_tag_cache_config != nullptr)
+		instance.remote_tag_cache =
+			std::make_unique<RemoteTagCache>(instance.event_loop,
+							 instance,
+							 RemoteTagCacheConfig(*remote_tag_cache_config));
+#endif
+
+	size_t picture_cache_size = DEFAULT_PICTURE_CACHE_SIZE;
+	const auto *picture_cache_param =
+		raw_config.GetParam(ConfigOption::PICTURE_CACHE_SIZE);
+	if (picture_cache_param != nullptr)
+		picture_cache_size = picture_cache_param->With([](const char *s){
+			return ParseSize(s, KILOBYTE);
+		});
+	if (picture_cache_size > 0)
+		instance.picture_cache =
+			std::make_unique<PictureCache>(picture_cache_size);
+
+#ifdef ENABLE_DATABASE
+	const auto *query_cache_param =
+		raw_config.GetParam(ConfigOption::QUERY_CACHE_SIZE);
+	if (query_cache_param != nullptr) {
+		const size_t query_cache_size = query_cache_param->With([](const char *s){
+			return ParseSize(s, KILOBYTE);
+		});
+		if (query_cache_size > 0)
+			instance.query_cache =
+				std::make_unique<QueryCache>(query_cache_size);
+	}
+#endif
+
 	initialize_decoder_and_player(instance,
 				      raw_config, config.replay_gain);
 
+	profiler.Phase("player");
+
 	listen_global_init(raw_config, *instance.partitions.front().listener);
 
+	profiler.Phase("listen");
+
+	const auto *metrics_config = raw_config.GetBlock(ConfigBlockOption::METRICS);
+	if (metrics_config != nullptr)
+		instance.metrics_server =
+			std::make_unique<MetricsServer>(instance.event_loop,
+							instance,
+							*metrics_config);
+
 #ifdef ENABLE_DAEMON
 	daemonize_set_user();
 	daemonize_begin(options.daemon);
@@ -440,6 +748,7 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 
 	initPermissions(raw_config);
 	spl_global_init(raw_config);
+	spl_watch(instance.event_loop);
 #ifdef ENABLE_ARCHIVE
 	const ScopeArchivePluginsInit archive_plugins_init;
 #endif
@@ -448,12 +757,24 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 
 	const ScopeDecoderPluginsInit decoder_plugins_init(raw_config);
 
+	profiler.Phase("decoder_plugins");
+
 #ifdef ENABLE_DATABASE
-	const bool create_db = InitDatabaseAndStorage(instance, raw_config);
+	const bool create_db =
+		InitDatabaseAndStorage(instance, raw_config,
+				       raw_config.GetBool(ConfigOption::ASYNC_STARTUP, false)
+				       ? &async_startup
+				       : nullptr);
+#else
+	const bool create_db = false;
 #endif
 
+	profiler.Phase("database");
+
 #ifdef ENABLE_SQLITE
 	instance.sticker_database = LoadStickerDatabase(raw_config);
+
+	profiler.Phase("sticker");
 #endif
 
 	command_init();
@@ -466,12 +787,16 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 		partition.UpdateEffectiveReplayGainMode();
 	}
 
+	profiler.Phase("outputs");
+
 	client_manager_init(raw_config);
 	const ScopeInputPluginsInit input_plugins_init(raw_config,
 						       instance.io_thread.GetEventLoop());
 
 	const ScopePlaylistPluginsInit playlist_plugins_init(raw_config);
 
+	profiler.Phase("input_plugins");
+
 #ifdef ENABLE_DAEMON
 	daemonize_commit();
 #endif
@@ -485,6 +810,9 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 	instance.io_thread.Start();
 	instance.rtio_thread.Start();
 
+	if (instance.client_threads != nullptr)
+		instance.client_threads->Start();
+
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance.neighbors != nullptr)
 		instance.neighbors->Open();
@@ -497,39 +825,17 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 
 	ZeroconfInit(raw_config, instance.event_loop);
 
-#ifdef ENABLE_DATABASE
-	if (create_db) {
-		/* the database failed to load: recreate the
-		   database */
-		instance.update->Enqueue("", true);
-	}
-#endif
-
-	glue_state_file_init(instance, raw_config);
+	profiler.Phase("threads");
 
 #ifdef ENABLE_DATABASE
-	if (raw_config.GetBool(ConfigOption::AUTO_UPDATE, false)) {
-#ifdef ENABLE_INOTIFY
-		if (instance.storage != nullptr &&
-		    instance.update != nullptr)
-			mpd_inotify_init(instance.event_loop,
-					 *instance.storage,
-					 *instance.update,
-					 raw_config.GetUnsigned(ConfigOption::AUTO_UPDATE_DEPTH,
-								INT_MAX));
-#else
-		FormatWarning(config_domain,
-			      "inotify: auto_update was disabled. enable during compilation phase");
-#endif
-	}
+	if (async_startup.IsStarted())
+		/* continues in AsyncStartup::OnLoaded() */
+		FormatInfo(startup_domain, "loading the database in the background");
+	else
 #endif
+		StartupAfterDatabase(instance, raw_config, create_db);
 
-	Check(raw_config);
-
-	/* enable all audio outputs (if not already done by
-	   playlist_state_restore() */
-	for (auto &partition : instance.partitions)
-		partition.pc.LockUpdateAudio();
+	profiler.Phase("state_file");
 
 #ifdef _WIN32
 	win32_app_started();
@@ -543,9 +849,19 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 	sd_notify(0, "READY=1");
 #endif
 
+	/* initialize the remaining plugins while the main loop runs
+	   already */
+	PluginWarmUp plugin_warm_up;
+	if (GetPluginInitMode(raw_config) == PluginInitMode::BACKGROUND)
+		plugin_warm_up.Start();
+
+	profiler.Finish();
+
 	/* run the main loop */
 	instance.event_loop.Run();
 
+	plugin_warm_up.Stop();
+
 #ifdef _WIN32
 	win32_app_stopping();
 #endif
@@ -553,6 +869,7 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 	/* cleanup */
 
 	instance.BeginShutdownUpdate();
+	spl_unwatch();
 
 	if (instance.state_file != nullptr) {
 		instance.state_file->Write();
@@ -569,6 +886,7 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 static void
 AndroidMain()
 {
+	StartupProfiler profiler;
 	struct options options;
 	ConfigData raw_config;
 
@@ -580,7 +898,9 @@ AndroidMain()
 			ReadConfigFile(raw_config, config_path);
 	}
 
-	MainConfigured(options, raw_config);
+	profiler.Phase("config");
+
+	MainConfigured(options, raw_config, profiler);
 }
 
 gcc_visibility_default
@@ -620,12 +940,15 @@ Java_org_musicpd_Bridge_shutdown(JNIEnv *, jclass)
 static inline void
 MainOrThrow(int argc, char *argv[])
 {
+	StartupProfiler profiler;
 	struct options options;
 	ConfigData raw_config;
 
 	ParseCommandLine(argc, argv, options, raw_config);
 
-	MainConfigured(options, raw_config);
+	profiler.Phase("config");
+
+	MainConfigured(options, raw_config, profiler);
 }
 
 int mpd_main(int argc, char *argv[]) noexcept
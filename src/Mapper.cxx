@@ -69,15 +69,11 @@ map_uri_fs(const char *uri) noexcept
 	if (global_instance->storage == nullptr)
 		return nullptr;
 
-	const auto music_dir_fs = global_instance->storage->MapFS("");
-	if (music_dir_fs.IsNull())
-		return nullptr;
-
-	const auto uri_fs = AllocatedPath::FromUTF8(uri);
-	if (uri_fs.IsNull())
-		return nullptr;
-
-	return music_dir_fs / uri_fs;
+	/* let the storage map the whole URI in one step; this
+	   avoids copying the music directory path and lets
+	   LocalStorage skip the charset conversion if the file
+	   system is UTF-8 */
+	return global_instance->storage->MapFS(uri);
 }
 
 std::string
@@ -20,55 +20,87 @@
 #ifndef MPD_MIX_RAMP_INFO_HXX
 #define MPD_MIX_RAMP_INFO_HXX
 
+#include "Chrono.hxx"
 #include "util/Compiler.h"
 
-#include <string>
+#include <utility>
+#include <vector>
 
-class MixRampInfo {
-	std::string start, end;
+/**
+ * A parsed "mixramp_start" or "mixramp_end" value: pairs of loudness
+ * [dB] and time which describe the volume profile at the start or
+ * the end of a song.  It is parsed once when the tags are read, so
+ * the cross-fade calculation does not need to parse strings.
+ */
+class MixRampCurve {
+public:
+	struct Point {
+		float db;
+		FloatDuration time;
+	};
+
+private:
+	std::vector<Point> points;
+
+	/**
+	 * Was a value specified?  This may be true even if
+	 * #points is empty, because the value was malformed.
+	 */
+	bool defined = false;
 
 public:
-	MixRampInfo() = default;
+	MixRampCurve() = default;
+
+	explicit MixRampCurve(std::vector<Point> &&_points) noexcept
+		:points(std::move(_points)), defined(true) {}
 
 	void Clear() noexcept {
-		start.clear();
-		end.clear();
+		points.clear();
+		defined = false;
 	}
 
-	gcc_pure
 	bool IsDefined() const noexcept {
-		return !start.empty() || !end.empty();
+		return defined;
 	}
 
-	gcc_pure
-	const char *GetStart() const noexcept {
-		return start.empty() ? nullptr : start.c_str();
+	/**
+	 * The points in the order in which they were specified; the
+	 * dB values should be monotonically increasing.
+	 */
+	const std::vector<Point> &GetPoints() const noexcept {
+		return points;
+	}
+};
+
+class MixRampInfo {
+	MixRampCurve start, end;
+
+public:
+	MixRampInfo() = default;
+
+	void Clear() noexcept {
+		start.Clear();
+		end.Clear();
 	}
 
 	gcc_pure
-	const char *GetEnd() const noexcept {
-		return end.empty() ? nullptr : end.c_str();
+	bool IsDefined() const noexcept {
+		return start.IsDefined() || end.IsDefined();
 	}
 
-	void SetStart(const char *new_value) noexcept {
-		if (new_value == nullptr)
-			start.clear();
-		else
-			start = new_value;
+	const MixRampCurve &GetStart() const noexcept {
+		return start;
 	}
 
-	void SetStart(std::string &&new_value) noexcept {
-		start = std::move(new_value);
+	const MixRampCurve &GetEnd() const noexcept {
+		return end;
 	}
 
-	void SetEnd(const char *new_value) noexcept {
-		if (new_value == nullptr)
-			end.clear();
-		else
-			end = new_value;
+	void SetStart(MixRampCurve &&new_value) noexcept {
+		start = std::move(new_value);
 	}
 
-	void SetEnd(std::string &&new_value) noexcept {
+	void SetEnd(MixRampCurve &&new_value) noexcept {
 		end = std::move(new_value);
 	}
 };
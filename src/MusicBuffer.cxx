@@ -19,18 +19,85 @@
 
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
+#include "AudioTrace.hxx"
+
+#include <new>
+#include <thread>
 
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
+MusicBuffer::MusicBuffer(unsigned _num_chunks, size_t _chunk_size,
+			 bool lock)
+	:num_chunks(_num_chunks), chunk_size(_chunk_size),
+	 keep_resident(lock),
+	 chunks(_num_chunks),
+	 data(size_t(_num_chunks) * _chunk_size),
+	 next(new std::atomic<uint_least16_t>[_num_chunks]),
+	 state(_num_chunks > 0 ? 0 : END)
+{
+	assert(num_chunks < END);
+
+	chunks.ForkCow(false);
+	data.ForkCow(false);
+
+	if (lock)
+		/* fault in everything now, so the real-time threads
+		   don't have to */
+		locked = chunks.Lock() & data.Lock();
+
+	/* link all chunks in ascending order */
+	for (unsigned i = 0; i < num_chunks; ++i)
+		next[i].store(i + 1 < num_chunks ? i + 1 : END,
+			      std::memory_order_relaxed);
+}
+
+MusicBuffer::~MusicBuffer() noexcept
+{
+	/* all chunks must be returned explicitly, and this assertion
+	   checks for leaks */
+	assert(GetAllocated() == 0);
 }
 
 MusicChunkPtr
 MusicBuffer::Allocate() noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
-	return MusicChunkPtr(buffer.Allocate(), MusicChunkDeleter(*this));
+	uint64_t s = state.load(std::memory_order_acquire);
+	unsigned i;
+
+	while (true) {
+		if (s & DISCARDING) {
+			/* the buffer has just become empty and
+			   Return() is giving the memory back to the
+			   kernel; this is rare and short */
+			std::this_thread::yield();
+			s = state.load(std::memory_order_acquire);
+			continue;
+		}
+
+		i = GetHead(s);
+		if (i == END)
+			/* the buffer is full */
+			return MusicChunkPtr(nullptr, MusicChunkDeleter(*this));
+
+		/* if another thread pops this chunk concurrently,
+		   "next" may be stale, but then the counter makes the
+		   compare_exchange fail */
+		const unsigned n = next[i].load(std::memory_order_relaxed);
+		if (state.compare_exchange_weak(s,
+						MakeState(s, n, GetAllocated(s) + 1),
+						std::memory_order_acquire,
+						std::memory_order_acquire))
+			break;
+	}
+
+	auto *chunk = ::new((void *)GetChunk(i)) MusicChunk();
+	chunk->data = &data[size_t(i) * chunk_size];
+	chunk->capacity = chunk_size;
+
+	TraceAudio(AudioTraceEvent::CHUNK_ALLOCATE, chunk,
+		   SignedSongTime::Negative(), this, GetAllocated(s) + 1);
+
+	return MusicChunkPtr(chunk, MusicChunkDeleter(*this));
 }
 
 void
@@ -38,15 +105,45 @@ MusicBuffer::Return(MusicChunk *chunk) noexcept
 {
 	assert(chunk != nullptr);
 
-	/* these attributes need to be cleared before locking the
-	   mutex, because they might recursively call this method,
-	   causing a deadlock */
-	chunk->next.reset();
+	/* this attribute needs to be cleared before the chunk is
+	   destructed, because it might recursively call this
+	   method */
 	chunk->other.reset();
 
-	const std::lock_guard<Mutex> protect(mutex);
+	const unsigned i = IndexOf(chunk);
+	assert(i < num_chunks);
+
+	chunk->~MusicChunk();
+
+	uint64_t s = state.load(std::memory_order_relaxed), new_state;
+
+	do {
+		assert(!(s & DISCARDING));
+		assert(GetAllocated(s) > 0);
+
+		next[i].store(GetHead(s), std::memory_order_relaxed);
 
-	assert(!chunk->other || !chunk->other->other);
+		const unsigned allocated = GetAllocated(s) - 1;
+		new_state = MakeState(s, i, allocated);
+		if (allocated == 0 && !keep_resident)
+			/* block Allocate() while the memory is being
+			   discarded */
+			new_state |= DISCARDING;
+	} while (!state.compare_exchange_weak(s, new_state,
+					      std::memory_order_release,
+					      std::memory_order_relaxed));
+
+	if (new_state & DISCARDING)
+		DiscardMemory();
+}
+
+void
+MusicBuffer::DiscardMemory() noexcept
+{
+	/* give memory back to the kernel when the last chunk was
+	   freed; the free list in #next is not affected */
+	chunks.Discard();
+	data.Discard();
 
-	buffer.Free(chunk);
+	state.fetch_and(~DISCARDING, std::memory_order_release);
 }
@@ -20,52 +20,147 @@
 #ifndef MPD_MUSIC_BUFFER_HXX
 #define MPD_MUSIC_BUFFER_HXX
 
-#include "MusicChunkPtr.hxx"
-#include "util/SliceBuffer.hxx"
-#include "thread/Mutex.hxx"
+#include "MusicChunk.hxx"
+#include "util/HugeAllocator.hxx"
+#include "util/Compiler.h"
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+#include <stdint.h>
 
 /**
  * An allocator for #MusicChunk objects.
+ *
+ * Allocate() and Return() are lock-free: the free chunks are kept in
+ * a Treiber stack whose head, the number of allocated chunks and an
+ * ABA counter are packed into one atomic word.
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
-	mutable Mutex mutex;
+	/**
+	 * The "next" index which terminates the free list.
+	 */
+	static constexpr uint_least16_t END = 0xffff;
+
+	/**
+	 * The #state bits.
+	 */
+	static constexpr unsigned ALLOCATED_SHIFT = 16;
+	static constexpr uint64_t DISCARDING = uint64_t(1) << 32;
+	static constexpr unsigned TAG_SHIFT = 33;
+
+	typedef std::aligned_storage_t<sizeof(MusicChunk),
+				       alignof(MusicChunk)> ChunkStorage;
+
+	const unsigned num_chunks;
+
+	/**
+	 * The number of data bytes in each #MusicChunk.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * Shall the memory stay resident?  If true, it was faulted
+	 * in (and locked, if possible) by the constructor, and it is
+	 * never discarded.
+	 */
+	const bool keep_resident;
+
+	/**
+	 * Was HugeLock() successful?
+	 */
+	bool locked = false;
 
-	SliceBuffer<MusicChunk> buffer;
+	/**
+	 * Storage for the #MusicChunk objects.
+	 */
+	HugeArray<ChunkStorage> chunks;
+
+	/**
+	 * The audio data of all chunks; each chunk owns #chunk_size
+	 * bytes at the same index.
+	 */
+	HugeArray<uint8_t> data;
+
+	/**
+	 * For each free chunk, the index of the next free chunk.
+	 * This is kept outside of #chunks so the free list survives
+	 * HugeDiscard().
+	 */
+	const std::unique_ptr<std::atomic<uint_least16_t>[]> next;
+
+	/**
+	 * Bits 0-15: the index of the first free chunk (or #END);
+	 * bits 16-31: the number of allocated chunks; bit 32: the
+	 * #DISCARDING flag; the remaining bits: a counter which is
+	 * incremented by each modification.
+	 */
+	std::atomic<uint64_t> state;
 
 public:
 	/**
 	 * Creates a new #MusicBuffer object.
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
-	 * this buffer
+	 * this buffer; must be smaller than 65535
+	 * @param chunk_size the number of data bytes in each
+	 * #MusicChunk
+	 * @param lock fault in all memory and lock it into RAM (see
+	 * HugeLock()), and never give it back to the kernel
 	 */
-	explicit MusicBuffer(unsigned num_chunks);
+	MusicBuffer(unsigned num_chunks, size_t chunk_size,
+		    bool lock=false);
+
+	~MusicBuffer() noexcept;
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
+
+	/**
+	 * Returns the number of data bytes in each #MusicChunk.
+	 */
+	size_t GetChunkSize() const noexcept {
+		return chunk_size;
+	}
+
+	/**
+	 * Was the memory locked into RAM successfully?  Always false
+	 * if the constructor was not asked to lock it.
+	 */
+	bool IsLocked() const noexcept {
+		return locked;
+	}
 
 #ifndef NDEBUG
 	/**
-	 * Check whether the buffer is empty.  This call is not
-	 * protected with the mutex, and may only be used while this
-	 * object is inaccessible to other threads.
+	 * Check whether the buffer is empty.  This may only be used
+	 * while this object is inaccessible to other threads.
 	 */
 	bool IsEmptyUnsafe() const {
-		return buffer.empty();
+		return GetAllocated() == 0;
 	}
 #endif
 
 	bool IsFull() const noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
-		return buffer.IsFull();
+		return GetAllocated() == num_chunks;
 	}
 
 	/**
 	 * Returns the total number of reserved chunks in this buffer.  This
-	 * is the same value which was passed to the constructor
-	 * music_buffer_new().
+	 * is the same value which was passed to the constructor.
 	 */
 	gcc_pure
 	unsigned GetSize() const noexcept {
-		return buffer.GetCapacity();
+		return num_chunks;
+	}
+
+	/**
+	 * Returns the number of chunks which are currently in use.
+	 */
+	gcc_pure
+	unsigned GetAllocated() const noexcept {
+		return GetAllocated(state.load(std::memory_order_relaxed));
 	}
 
 	/**
@@ -82,6 +177,41 @@ public:
 	 * Allocate() then.
 	 */
 	void Return(MusicChunk *chunk) noexcept;
+
+private:
+	static constexpr unsigned GetHead(uint64_t s) noexcept {
+		return s & 0xffff;
+	}
+
+	static constexpr unsigned GetAllocated(uint64_t s) noexcept {
+		return (s >> ALLOCATED_SHIFT) & 0xffff;
+	}
+
+	/**
+	 * Build a new #state value from the given one, with a new
+	 * head/allocated pair and the counter incremented.
+	 */
+	static constexpr uint64_t MakeState(uint64_t old, unsigned head,
+					    unsigned allocated) noexcept {
+		return ((old >> TAG_SHIFT) + 1) << TAG_SHIFT |
+			uint64_t(allocated) << ALLOCATED_SHIFT |
+			head;
+	}
+
+	MusicChunk *GetChunk(unsigned i) noexcept {
+		return reinterpret_cast<MusicChunk *>(&chunks[i]);
+	}
+
+	unsigned IndexOf(const MusicChunk *chunk) const noexcept {
+		return reinterpret_cast<const ChunkStorage *>(chunk) - &chunks.front();
+	}
+
+	/**
+	 * Give the memory back to the kernel.  Called by Return()
+	 * after the last chunk was returned, with the #DISCARDING
+	 * flag set.
+	 */
+	void DiscardMemory() noexcept;
 };
 
 #endif
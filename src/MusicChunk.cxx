@@ -56,7 +56,7 @@ MusicChunk::Write(const AudioFormat af,
 	}
 
 	const size_t frame_size = af.GetFrameSize();
-	size_t num_frames = (sizeof(data) - length) / frame_size;
+	size_t num_frames = (capacity - length) / frame_size;
 	return { data + length, num_frames * frame_size };
 }
 
@@ -65,10 +65,25 @@ MusicChunk::Expand(const AudioFormat af, size_t _length) noexcept
 {
 	const size_t frame_size = af.GetFrameSize();
 
-	assert(length + _length <= sizeof(data));
+	assert(length + _length <= capacity);
 	assert(audio_format == af);
 
 	length += _length;
 
-	return length + frame_size > sizeof(data);
+	return length + frame_size > capacity;
+}
+
+size_t
+MusicChunkSizeForBuffer(size_t buffer_size) noexcept
+{
+	/* aim at roughly this number of chunks; that is what the
+	   default buffer size has with the minimum chunk size */
+	constexpr size_t target_chunks = 1024;
+
+	size_t chunk_size = CHUNK_SIZE;
+	while (chunk_size < MAX_CHUNK_SIZE &&
+	       buffer_size / (chunk_size * 2) >= target_chunks)
+		chunk_size *= 2;
+
+	return chunk_size;
 }
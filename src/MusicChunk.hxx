@@ -22,30 +22,53 @@
 
 #include "MusicChunkPtr.hxx"
 #include "Chrono.hxx"
-#include "ReplayGainInfo.hxx"
 #include "util/WritableBuffer.hxx"
+#include "util/Compiler.h"
 
 #ifndef NDEBUG
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
 #include <memory>
 
 #include <stdint.h>
 #include <stddef.h>
 
+/**
+ * The smallest (and default) amount of audio data in one
+ * #MusicChunk.  Larger buffers get larger chunks, see
+ * MusicChunkSizeForBuffer().
+ */
 static constexpr size_t CHUNK_SIZE = 4096;
 
+/**
+ * The largest amount of audio data in one #MusicChunk.
+ */
+static constexpr size_t MAX_CHUNK_SIZE = 256 * 1024;
+
 struct AudioFormat;
 struct Tag;
+struct ReplayGainInfo;
 struct MusicChunk;
 
 /**
  * Meta information for #MusicChunk.
  */
 struct MusicChunkInfo {
-	/** the next chunk in a linked list */
-	MusicChunkPtr next;
+	/**
+	 * The next chunk in a #MusicPipe.  It is owned by the pipe,
+	 * and it may be read by other threads without locking.
+	 */
+	std::atomic<MusicChunk *> next{nullptr};
+
+	/**
+	 * A serial number assigned by MusicPipe::Push(); it
+	 * increases with every chunk, which allows consumers to
+	 * publish their progress with a single integer (see
+	 * SharedPipeConsumer).
+	 */
+	std::atomic<uint64_t> serial{0};
 
 	/**
 	 * An optional chunk which should be mixed into this chunk.
@@ -55,9 +78,11 @@ struct MusicChunkInfo {
 
 	/**
 	 * An optional tag associated with this chunk (and the
-	 * following chunks); appears at song boundaries.
+	 * following chunks); appears at song boundaries.  It is
+	 * immutable and may be shared with other chunks and with the
+	 * decoder.
 	 */
-	std::unique_ptr<Tag> tag;
+	std::shared_ptr<const Tag> tag;
 
 	/**
 	 * The current mix ratio for cross-fading: 1.0 means play 100%
@@ -66,7 +91,7 @@ struct MusicChunkInfo {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length = 0;
+	uint32_t length = 0;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -75,17 +100,13 @@ struct MusicChunkInfo {
 	SignedSongTime time;
 
 	/**
-	 * Replay gain information associated with this chunk.
-	 * Only valid if the serial is not 0.
+	 * Replay gain information associated with this chunk;
+	 * nullptr if there is none.  It is immutable and shared by
+	 * all chunks of the song (until the decoder submits new
+	 * values), which keeps it out of the chunk header, and
+	 * consumers can detect a change by comparing pointers.
 	 */
-	ReplayGainInfo replay_gain_info;
-
-	/**
-	 * A serial number for checking if replay gain info has
-	 * changed since the last chunk.  The magic value 0 indicates
-	 * that there is no replay gain info available.
-	 */
-	unsigned replay_gain_serial;
+	std::shared_ptr<const ReplayGainInfo> replay_gain_info;
 
 #ifndef NDEBUG
 	AudioFormat audio_format;
@@ -116,8 +137,14 @@ struct MusicChunkInfo {
  * MusicPipe::Push() caller.
  */
 struct MusicChunk : MusicChunkInfo {
-	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE - sizeof(MusicChunkInfo)];
+	/**
+	 * The data (probably PCM).  This memory is owned by the
+	 * #MusicBuffer which allocated this chunk.
+	 */
+	uint8_t *data = nullptr;
+
+	/** the maximum number of bytes in #data */
+	size_t capacity = 0;
 
 	/**
 	 * Prepares appending to the music chunk.  Returns a buffer
@@ -146,6 +173,15 @@ struct MusicChunk : MusicChunkInfo {
 	bool Expand(AudioFormat af, size_t length) noexcept;
 };
 
-static_assert(sizeof(MusicChunk) == CHUNK_SIZE, "Wrong size");
+/**
+ * Choose the #MusicChunk data size for a #MusicBuffer of the given
+ * size (in bytes).  Large buffers are mostly configured for
+ * high-resolution and DSD audio; larger chunks reduce the number of
+ * chunks per second (and thus the per-chunk locking and wakeup
+ * overhead) for those formats.
+ */
+gcc_const
+size_t
+MusicChunkSizeForBuffer(size_t buffer_size) noexcept;
 
 #endif
@@ -32,6 +32,10 @@ public:
 	MusicChunkDeleter() = default;
 	explicit MusicChunkDeleter(MusicBuffer &_buffer):buffer(&_buffer) {}
 
+	MusicBuffer &GetBuffer() const noexcept {
+		return *buffer;
+	}
+
 	void operator()(MusicChunk *chunk) noexcept;
 };
 
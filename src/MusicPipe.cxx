@@ -19,17 +19,26 @@
 
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
+#include "AudioTrace.hxx"
+
+#include <thread>
 
 #include <assert.h>
 
+/**
+ * The source of MusicChunk::serial.  It is global (and not per pipe)
+ * so serial numbers never repeat, even when a consumer switches to a
+ * new pipe.
+ */
+static std::atomic<uint64_t> next_serial{0};
+
 #ifndef NDEBUG
 
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
-
-	for (const MusicChunk *i = head.get(); i != nullptr; i = i->next.get())
+	for (const MusicChunk *i = Peek(); i != nullptr;
+	     i = i->next.load(std::memory_order_acquire))
 		if (i == chunk)
 			return true;
 
@@ -41,32 +50,56 @@ MusicPipe::Contains(const MusicChunk *chunk) const noexcept
 MusicChunkPtr
 MusicPipe::Shift() noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
-
-	auto chunk = std::move(head);
-	if (chunk != nullptr) {
-		assert(!chunk->IsEmpty());
+	MusicChunk *chunk = head.load(std::memory_order_acquire);
+	if (chunk == nullptr)
+		return nullptr;
 
-		head = std::move(chunk->next);
-		--size;
-
-		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
+	assert(!chunk->IsEmpty());
 
-			tail_r = &head;
+	MusicChunk *next = chunk->next.load(std::memory_order_acquire);
+	if (next == nullptr) {
+		/* this appears to be the last chunk; try to detach
+		   it from the tail */
+		MusicChunk *expected = chunk;
+		if (tail.compare_exchange_strong(expected, nullptr,
+						 std::memory_order_acq_rel)) {
+			/* if Push() has meanwhile started over with
+			   an empty list, it has already replaced
+			   #head, and this fails */
+			expected = chunk;
+			head.compare_exchange_strong(expected, nullptr,
+						     std::memory_order_acq_rel);
 		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
+			/* Push() has already replaced the tail, but
+			   has not yet linked the new chunk; this is a
+			   matter of a few instructions */
+			while ((next = chunk->next.load(std::memory_order_acquire)) == nullptr)
+				std::this_thread::yield();
 		}
+	}
+
+	if (next != nullptr)
+		head.store(next, std::memory_order_release);
+
+	chunk->next.store(nullptr, std::memory_order_relaxed);
+
+	const unsigned old_size = size.fetch_sub(1, std::memory_order_relaxed);
+	assert(old_size > 0);
+
+	TraceAudio(AudioTraceEvent::PIPE_SHIFT, chunk, chunk->time, this,
+		   old_size - 1);
 
 #ifndef NDEBUG
-		if (size == 0)
-			audio_format.Clear();
-#endif
+	if (old_size == 1) {
+		const std::lock_guard<Mutex> protect(mutex);
+		audio_format.Clear();
 	}
+#else
+	(void)old_size;
+#endif
 
-	return chunk;
+	return MusicChunkPtr(chunk,
+			     MusicChunkDeleter(*buffer.load(std::memory_order_relaxed)));
 }
 
 void
@@ -81,20 +114,38 @@ MusicPipe::Push(MusicChunkPtr chunk) noexcept
 	assert(!chunk->IsEmpty());
 	assert(chunk->length == 0 || chunk->audio_format.IsValid());
 
-	const std::lock_guard<Mutex> protect(mutex);
+#ifndef NDEBUG
+	{
+		const std::lock_guard<Mutex> protect(mutex);
 
-	assert(size > 0 || !audio_format.IsDefined());
-	assert(!audio_format.IsDefined() ||
-	       chunk->CheckFormat(audio_format));
+		assert(size > 0 || !audio_format.IsDefined());
+		assert(!audio_format.IsDefined() ||
+		       chunk->CheckFormat(audio_format));
 
-#ifndef NDEBUG
-	if (!audio_format.IsDefined() && chunk->length > 0)
-		audio_format = chunk->audio_format;
+		if (!audio_format.IsDefined() && chunk->length > 0)
+			audio_format = chunk->audio_format;
+	}
 #endif
 
-	chunk->next.reset();
-	*tail_r = std::move(chunk);
-	tail_r = &(*tail_r)->next;
+	buffer.store(&chunk.get_deleter().GetBuffer(),
+		     std::memory_order_relaxed);
+
+	MusicChunk *c = chunk.release();
+	c->next.store(nullptr, std::memory_order_relaxed);
+	c->serial.store(next_serial.fetch_add(1, std::memory_order_relaxed) + 1,
+			std::memory_order_relaxed);
+
+	/* count it before it becomes visible, so GetSize() is never
+	   smaller than the number of reachable chunks */
+	const unsigned new_size = size.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	/* trace before the chunk becomes visible; afterwards, the
+	   consumer may already have freed it */
+	TraceAudio(AudioTraceEvent::PIPE_PUSH, c, c->time, this, new_size);
 
-	++size;
+	MusicChunk *prev = tail.exchange(c, std::memory_order_acq_rel);
+	if (prev != nullptr)
+		prev->next.store(c, std::memory_order_release);
+	else
+		head.store(c, std::memory_order_release);
 }
@@ -21,39 +21,59 @@
 #define MPD_PIPE_H
 
 #include "MusicChunkPtr.hxx"
-#include "thread/Mutex.hxx"
 #include "util/Compiler.h"
 
 #ifndef NDEBUG
 #include "AudioFormat.hxx"
+#include "thread/Mutex.hxx"
 #endif
 
+#include <atomic>
+
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * This is a lock-free linked list: Push() may be called by one
+ * producer thread, Shift() and Clear() by one consumer thread, and
+ * Peek(), GetSize() and the #MusicChunk::next links may be read by
+ * any thread.  Chunks are only freed by Shift(), so readers need
+ * another way to know that a chunk is still alive (see
+ * SharedPipeConsumer).
  */
 class MusicPipe {
 	/** the first chunk */
-	MusicChunkPtr head;
+	std::atomic<MusicChunk *> head{nullptr};
 
-	/** a pointer to the tail of the chunk */
-	MusicChunkPtr *tail_r = &head;
+	/** the last chunk */
+	std::atomic<MusicChunk *> tail{nullptr};
 
 	/** the current number of chunks */
-	unsigned size = 0;
+	std::atomic_uint size{0};
 
-	/** a mutex which protects #head and #tail_r */
-	mutable Mutex mutex;
+	/**
+	 * The #MusicBuffer which owns the chunks; it is needed to
+	 * construct the #MusicChunkPtr returned by Shift().
+	 */
+	std::atomic<MusicBuffer *> buffer{nullptr};
 
 #ifndef NDEBUG
+	/** protects #audio_format */
+	mutable Mutex mutex;
+
 	AudioFormat audio_format = AudioFormat::Undefined();
 #endif
 
 public:
+	MusicPipe() = default;
+
 	~MusicPipe() noexcept {
 		Clear();
 	}
 
+	MusicPipe(const MusicPipe &) = delete;
+	MusicPipe &operator=(const MusicPipe &) = delete;
+
 #ifndef NDEBUG
 	/**
 	 * Checks if the audio format if the chunk is equal to the specified
@@ -61,6 +81,7 @@ public:
 	 */
 	gcc_pure
 	bool CheckFormat(AudioFormat other) const noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
 		return !audio_format.IsDefined() ||
 			audio_format == other;
 	}
@@ -78,8 +99,7 @@ public:
 	 */
 	gcc_pure
 	const MusicChunk *Peek() const noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
-		return head.get();
+		return head.load(std::memory_order_acquire);
 	}
 
 	/**
@@ -102,8 +122,7 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
-		return size;
+		return size.load(std::memory_order_relaxed);
 	}
 
 	gcc_pure
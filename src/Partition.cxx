@@ -20,20 +20,20 @@
 #include "config.h"
 #include "Partition.hxx"
 #include "Instance.hxx"
-#include "Log.hxx"
 #include "song/DetachedSong.hxx"
 #include "mixer/Volume.hxx"
 #include "IdleFlags.hxx"
 #include "client/Listener.hxx"
 #include "input/cache/Manager.hxx"
-#include "util/Domain.hxx"
+#include "input/Prefetch.hxx"
 
-static constexpr Domain cache_domain("cache");
+#include <algorithm>
 
 Partition::Partition(Instance &_instance,
 		     const char *_name,
 		     unsigned max_length,
 		     unsigned buffer_chunks,
+		     size_t buffer_chunk_size,
 		     AudioFormat configured_audio_format,
 		     const ReplayGainConfig &replay_gain_config) noexcept
 	:instance(_instance),
@@ -44,8 +44,11 @@ Partition::Partition(Instance &_instance,
 	 outputs(*this),
 	 pc(*this, outputs,
 	    instance.input_cache.get(),
-	    buffer_chunks,
+	    buffer_chunks, buffer_chunk_size,
 	    configured_audio_format, replay_gain_config)
+#ifdef ENABLE_DATABASE
+	, lazy_resolver(instance.event_loop, *this)
+#endif
 {
 	UpdateEffectiveReplayGainMode();
 }
@@ -58,41 +61,47 @@ Partition::EmitIdle(unsigned mask) noexcept
 	instance.EmitIdle(mask);
 }
 
-static void
-PrefetchSong(InputCacheManager &cache, const char *uri) noexcept
+inline void
+Partition::PrefetchQueue() noexcept
 {
-	if (cache.Contains(uri))
-		return;
+	const unsigned cache_count = instance.input_cache
+		? instance.input_cache->GetPrefetchCount()
+		: 0;
+
+	/* the next song is always announced to its input plugin,
+	   even without an input cache */
+	const unsigned count = std::max(cache_count, 1U);
 
-	FormatDebug(cache_domain, "Prefetch '%s'", uri);
+	const auto &queue = playlist.queue;
 
-	try {
-		cache.Prefetch(uri);
-	} catch (...) {
-		FormatError(std::current_exception(),
-			    "Prefetch '%s' failed", uri);
+	/* collect the upcoming songs in the order they will be
+	   played; this respects "random" and song priorities,
+	   because both are expressed by the queue's order */
+	std::vector<std::string> uris;
+
+	int next = playlist.GetNextPosition();
+	if (next >= 0) {
+		const unsigned first_order = queue.PositionToOrder(next);
+		int order = first_order;
+
+		do {
+			uris.emplace_back(queue.GetOrder(order).GetURI());
+			order = queue.GetNextOrder(order);
+		} while (order >= 0 && unsigned(order) != first_order &&
+			 uris.size() < count);
 	}
-}
 
-static void
-PrefetchSong(InputCacheManager &cache, const DetachedSong &song) noexcept
-{
-	PrefetchSong(cache, song.GetURI());
-}
+	/* let streaming services resolve the URLs ahead of time */
+	for (const auto &uri : uris)
+		InputPrefetch(uri.c_str());
 
-inline void
-Partition::PrefetchQueue() noexcept
-{
 	if (!instance.input_cache)
 		return;
 
-	auto &cache = *instance.input_cache;
+	if (uris.size() > cache_count)
+		uris.resize(cache_count);
 
-	int next = playlist.GetNextPosition();
-	if (next >= 0)
-		PrefetchSong(cache, playlist.queue.Get(next));
-
-	// TODO: prefetch more songs
+	instance.input_cache->Prefetch(std::move(uris));
 }
 
 void
@@ -180,6 +189,14 @@ Partition::OnQueueSongStarted() noexcept
 	EmitIdle(IDLE_PLAYER);
 }
 
+void
+Partition::OnQueueSongNeeded(gcc_unused unsigned id) noexcept
+{
+#ifdef ENABLE_DATABASE
+	lazy_resolver.ResolveNow(id);
+#endif
+}
+
 void
 Partition::OnPlayerSync() noexcept
 {
@@ -32,6 +32,10 @@
 #include "Chrono.hxx"
 #include "config.h"
 
+#ifdef ENABLE_DATABASE
+#include "LazySongResolver.hxx"
+#endif
+
 #include <string>
 #include <memory>
 
@@ -63,12 +67,17 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	PlayerControl pc;
 
+#ifdef ENABLE_DATABASE
+	LazySongResolver lazy_resolver;
+#endif
+
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
 	Partition(Instance &_instance,
 		  const char *_name,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
+		  size_t buffer_chunk_size,
 		  AudioFormat configured_audio_format,
 		  const ReplayGainConfig &replay_gain_config) noexcept;
 
@@ -82,7 +91,8 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	/**
 	 * Populate the #InputCacheManager with soon-to-be-played song
-	 * files.
+	 * files, and announce them to their input plugins (see
+	 * InputPrefetch()).
 	 *
 	 * Errors will be logged.
 	 */
@@ -257,6 +267,7 @@ private:
 	void OnQueueModified() noexcept override;
 	void OnQueueOptionsChanged() noexcept override;
 	void OnQueueSongStarted() noexcept override;
+	void OnQueueSongNeeded(unsigned id) noexcept override;
 
 	/* virtual methods from class PlayerListener */
 	void OnPlayerSync() noexcept override;
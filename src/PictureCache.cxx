@@ -0,0 +1,74 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PictureCache.hxx"
+
+#include <assert.h>
+
+void
+PictureCache::Erase(std::list<Item>::iterator i) noexcept
+{
+	assert(size >= i->picture.data.size());
+
+	size -= i->picture.data.size();
+	map.erase(i->key);
+	items.erase(i);
+}
+
+const PictureCache::Picture *
+PictureCache::Get(const std::string &key,
+		  std::chrono::system_clock::time_point mtime) noexcept
+{
+	auto m = map.find(key);
+	if (m == map.end())
+		return nullptr;
+
+	auto i = m->second;
+	if (i->picture.mtime != mtime) {
+		/* the file has been modified */
+		Erase(i);
+		return nullptr;
+	}
+
+	/* move to the front of the list */
+	items.splice(items.begin(), items, i);
+	return &i->picture;
+}
+
+const PictureCache::Picture &
+PictureCache::Put(std::string &&key, Picture &&picture) noexcept
+{
+	assert(CanStore(picture.data.size()));
+
+	auto m = map.find(key);
+	if (m != map.end())
+		Erase(m->second);
+
+	while (size + picture.data.size() > max_size) {
+		assert(!items.empty());
+		Erase(std::prev(items.end()));
+	}
+
+	size += picture.data.size();
+	items.emplace_front(std::move(key), std::move(picture));
+
+	auto i = items.begin();
+	map.emplace(i->key, i);
+	return i->picture;
+}
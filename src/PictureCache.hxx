@@ -0,0 +1,141 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PICTURE_CACHE_HXX
+#define MPD_PICTURE_CACHE_HXX
+
+#include "util/AllocatedArray.hxx"
+#include "util/Compiler.h"
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <string>
+
+#include <stdint.h>
+
+/**
+ * A bounded in-memory LRU cache for pictures sent by the commands
+ * "albumart" and "readpicture".  Clients download a picture in many
+ * small chunks, and without this cache, each chunk would reopen the
+ * file and parse all of its tags again.
+ *
+ * Each entry remembers the modification time of the file it was
+ * loaded from; a lookup with a different time stamp discards it.
+ *
+ * This object is not thread-safe and may only be used in the main
+ * thread.
+ */
+class PictureCache {
+public:
+	struct Picture {
+		/**
+		 * The modification time of the file this picture was
+		 * loaded from.
+		 */
+		std::chrono::system_clock::time_point mtime;
+
+		/**
+		 * The MIME type, or an empty string if unknown.
+		 */
+		std::string mime_type;
+
+		/**
+		 * The picture data.  Empty if the file does not
+		 * contain any picture; this negative result is
+		 * cached, too.
+		 */
+		AllocatedArray<uint8_t> data;
+	};
+
+private:
+	struct Item {
+		std::string key;
+
+		Picture picture;
+
+		Item(std::string &&_key, Picture &&_picture) noexcept
+			:key(std::move(_key)), picture(std::move(_picture)) {}
+	};
+
+	/**
+	 * All cached pictures; the most recently used one comes
+	 * first, the last one is evicted first.
+	 */
+	std::list<Item> items;
+
+	std::map<std::string, std::list<Item>::iterator, std::less<>> map;
+
+	/**
+	 * The maximum total size of all pictures [bytes].
+	 */
+	const size_t max_size;
+
+	/**
+	 * The current total size of all pictures [bytes].
+	 */
+	size_t size = 0;
+
+public:
+	explicit PictureCache(size_t _max_size) noexcept
+		:max_size(_max_size) {}
+
+	PictureCache(const PictureCache &) = delete;
+	PictureCache &operator=(const PictureCache &) = delete;
+
+	/**
+	 * May a picture with the given size be stored in this cache?
+	 * A single picture may occupy at most a quarter of the cache,
+	 * to avoid flushing everything else.
+	 */
+	gcc_pure
+	bool CanStore(size_t picture_size) const noexcept {
+		return picture_size <= max_size / 4;
+	}
+
+	/**
+	 * Look up a picture.  A stale entry (i.e. with a different
+	 * modification time) is discarded.
+	 *
+	 * @return the picture (valid until the next non-const call)
+	 * or nullptr if it is not cached
+	 */
+	const Picture *Get(const std::string &key,
+			   std::chrono::system_clock::time_point mtime) noexcept;
+
+	/**
+	 * Add a picture to the cache, evicting old entries if
+	 * necessary.  The caller must check CanStore() first.
+	 *
+	 * @return a reference to the cached picture (valid until
+	 * the next non-const call)
+	 */
+	const Picture &Put(std::string &&key, Picture &&picture) noexcept;
+
+	void Clear() noexcept {
+		map.clear();
+		items.clear();
+		size = 0;
+	}
+
+private:
+	void Erase(std::list<Item>::iterator i) noexcept;
+};
+
+#endif
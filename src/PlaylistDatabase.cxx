@@ -19,7 +19,7 @@
 
 #include "PlaylistDatabase.hxx"
 #include "db/PlaylistVector.hxx"
-#include "fs/io/TextFile.hxx"
+#include "fs/io/LineReader.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/StringStrip.hxx"
@@ -28,20 +28,25 @@
 #include <string.h>
 #include <stdlib.h>
 
+void
+playlist_metadata_save(BufferedOutputStream &os, const PlaylistInfo &pi)
+{
+	os.Format(PLAYLIST_META_BEGIN "%s\n", pi.name.c_str());
+	if (!IsNegative(pi.mtime))
+		os.Format("mtime: %li\n",
+			  (long)std::chrono::system_clock::to_time_t(pi.mtime));
+	os.Write("playlist_end\n");
+}
+
 void
 playlist_vector_save(BufferedOutputStream &os, const PlaylistVector &pv)
 {
-	for (const PlaylistInfo &pi : pv) {
-		os.Format(PLAYLIST_META_BEGIN "%s\n", pi.name.c_str());
-		if (!IsNegative(pi.mtime))
-			os.Format("mtime: %li\n",
-				  (long)std::chrono::system_clock::to_time_t(pi.mtime));
-		os.Write("playlist_end\n");
-	}
+	for (const PlaylistInfo &pi : pv)
+		playlist_metadata_save(os, pi);
 }
 
 void
-playlist_metadata_load(TextFile &file, PlaylistVector &pv, const char *name)
+playlist_metadata_load(LineReader &file, PlaylistVector &pv, const char *name)
 {
 	PlaylistInfo pm(name);
 
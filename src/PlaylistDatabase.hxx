@@ -22,9 +22,13 @@
 
 #define PLAYLIST_META_BEGIN "playlist_begin: "
 
+struct PlaylistInfo;
 class PlaylistVector;
 class BufferedOutputStream;
-class TextFile;
+class LineReader;
+
+void
+playlist_metadata_save(BufferedOutputStream &os, const PlaylistInfo &pi);
 
 void
 playlist_vector_save(BufferedOutputStream &os, const PlaylistVector &pv);
@@ -33,6 +37,6 @@ playlist_vector_save(BufferedOutputStream &os, const PlaylistVector &pv);
  * Throws #std::runtime_error on error.
  */
 void
-playlist_metadata_load(TextFile &file, PlaylistVector &pv, const char *name);
+playlist_metadata_load(LineReader &file, PlaylistVector &pv, const char *name);
 
 #endif
@@ -40,13 +40,54 @@
 #include "fs/FileInfo.hxx"
 #include "fs/DirectoryReader.hxx"
 #include "util/StringCompare.hxx"
+#include "util/StringFormat.hxx"
 #include "util/UriExtract.hxx"
+#include "util/NumberParser.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_INOTIFY
+#include "db/update/InotifySource.hxx"
+
+#include <memory>
+
+#include <sys/inotify.h>
+#endif
+
+#include <algorithm>
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 static const char PLAYLIST_COMMENT = '#';
 
+/**
+ * Edits of a stored playlist other than appending are not applied
+ * to its m3u file immediately; they are recorded in an edit log next
+ * to it ("NAME.m3u.log"), which is replayed by LoadPlaylistFile() and
+ * merged into the m3u file by spl_flush() before the playlist is
+ * read by a client, or when the log has grown too large.  This makes
+ * editing large playlists cheap.
+ *
+ * The log begins with the line "base MTIME SIZE LENGTH" which
+ * describes the m3u file it applies to, followed by one line per
+ * edit:
+ *
+ * - "A MTIME SIZE": an entry was appended to the m3u file, which
+ *   now has the given modification time and size
+ * - "D POS": the entry at the given position was removed
+ * - "M FROM TO": an entry was moved
+ *
+ * If the m3u file was modified by somebody else, the log is obsolete
+ * and gets discarded.
+ */
+static constexpr auto PLAYLIST_EDIT_LOG_SUFFIX = PATH_LITERAL(".log");
+
+/**
+ * Merge the edit log into the m3u file after this number of edits.
+ */
+static constexpr unsigned PLAYLIST_EDIT_LOG_MAX = 1024;
+
 static unsigned playlist_max_length;
 bool playlist_saveAbsolutePaths = DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS;
 
@@ -149,11 +190,113 @@ LoadPlaylistFileInfo(PlaylistInfo &info,
 	}
 
 	info.mtime = fi.GetModificationTime();
+
+	/* pending edits have modified the playlist, too */
+	const auto log_path_fs =
+		AllocatedPath::FromFS(PathTraitsFS::string(name_fs_str) +
+				      PLAYLIST_EDIT_LOG_SUFFIX);
+	FileInfo log_fi;
+	if (GetFileInfo(parent_path_fs / log_path_fs, log_fi) &&
+	    log_fi.GetModificationTime() > info.mtime)
+		info.mtime = log_fi.GetModificationTime();
+
 	return true;
 }
 
-PlaylistVector
-ListPlaylistFiles()
+/**
+ * The most recent ListPlaylistFiles() result.
+ */
+static PlaylistVector spl_list_cache;
+
+/**
+ * Is #spl_list_cache up to date?  This is cleared by spl_modified()
+ * and by inotify events.
+ */
+static bool spl_list_cache_valid = false;
+
+#ifdef ENABLE_INOTIFY
+
+/**
+ * Watches the playlist directory; as long as this exists, the
+ * ListPlaylistFiles() result can be cached in #spl_list_cache.
+ */
+static std::unique_ptr<InotifySource> spl_inotify;
+
+/**
+ * Set by the inotify callback when the watch has been removed by
+ * the kernel; #spl_inotify cannot be destroyed from within its own
+ * callback, so this is done by ListPlaylistFiles().
+ */
+static bool spl_inotify_gone = false;
+
+static void
+spl_inotify_callback(gcc_unused int wd, unsigned mask,
+		     gcc_unused const char *name, gcc_unused void *ctx)
+{
+	spl_list_cache_valid = false;
+
+	if (mask & (IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT))
+		/* the directory is gone; stop caching, because we
+		   won't get any more events */
+		spl_inotify_gone = true;
+}
+
+void
+spl_watch(EventLoop &loop) noexcept
+{
+	const AllocatedPath &path_fs = map_spl_path();
+	if (path_fs.IsNull())
+		return;
+
+	try {
+		auto source = std::make_unique<InotifySource>(loop,
+							      spl_inotify_callback,
+							      nullptr);
+		source->Add(path_fs.c_str(),
+			    IN_CREATE|IN_DELETE|IN_MOVE|IN_CLOSE_WRITE|
+			    IN_MODIFY|IN_ATTRIB|
+			    IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR);
+		spl_inotify = std::move(source);
+		spl_inotify_gone = false;
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to watch the playlist directory");
+	}
+}
+
+void
+spl_unwatch() noexcept
+{
+	spl_inotify.reset();
+	spl_list_cache = {};
+	spl_list_cache_valid = false;
+}
+
+#else
+
+void
+spl_watch(EventLoop &) noexcept
+{
+}
+
+void
+spl_unwatch() noexcept
+{
+	spl_list_cache = {};
+}
+
+#endif
+
+void
+spl_modified() noexcept
+{
+	spl_list_cache_valid = false;
+
+	idle_add(IDLE_STORED_PLAYLIST);
+}
+
+static PlaylistVector
+ReadPlaylistFiles()
 {
 	PlaylistVector list;
 
@@ -172,12 +315,31 @@ ListPlaylistFiles()
 	return list;
 }
 
-static void
-SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path)
+const PlaylistVector &
+ListPlaylistFiles()
 {
-	assert(utf8path != nullptr);
+#ifdef ENABLE_INOTIFY
+	if (spl_inotify_gone)
+		spl_inotify.reset();
 
-	const auto path_fs = spl_map_to_fs(utf8path);
+	if (spl_inotify != nullptr && spl_list_cache_valid)
+		return spl_list_cache;
+#endif
+
+	spl_list_cache = ReadPlaylistFiles();
+
+#ifdef ENABLE_INOTIFY
+	/* without inotify, we don't know when the directory gets
+	   modified by others, and the cache must not be used */
+	spl_list_cache_valid = spl_inotify != nullptr;
+#endif
+
+	return spl_list_cache;
+}
+
+static void
+SavePlaylistFile(const PlaylistFileContents &contents, Path path_fs)
+{
 	assert(!path_fs.IsNull());
 
 	FileOutputStream fos(path_fs);
@@ -191,14 +353,14 @@ SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path)
 	fos.Commit();
 }
 
-PlaylistFileContents
-LoadPlaylistFile(const char *utf8path)
-try {
+/**
+ * Read all entries of the m3u file, ignoring the edit log.
+ */
+static PlaylistFileContents
+LoadPlaylistFileRaw(Path path_fs)
+{
 	PlaylistFileContents contents;
 
-	const auto path_fs = spl_map_to_fs(utf8path);
-	assert(!path_fs.IsNull());
-
 	TextFile file(path_fs);
 
 	char *s;
@@ -245,12 +407,316 @@ try {
 	}
 
 	return contents;
+}
+
+static AllocatedPath
+GetPlaylistEditLogPath(Path path_fs) noexcept
+{
+	return AllocatedPath::FromFS(PathTraitsFS::string(path_fs.c_str()) +
+				     PLAYLIST_EDIT_LOG_SUFFIX);
+}
+
+static uint64_t
+GetPlaylistFileStamp(const FileInfo &fi) noexcept
+{
+	return std::chrono::system_clock::to_time_t(fi.GetModificationTime());
+}
+
+struct PlaylistEdit {
+	char type;
+	unsigned a, b;
+};
+
+struct PlaylistEditLog {
+	/**
+	 * The modification time and size of the m3u file after the
+	 * last change recorded in the log.
+	 */
+	uint64_t mtime, size;
+
+	/**
+	 * The number of entries of the m3u file when the log was
+	 * created.
+	 */
+	unsigned base_length;
+
+	/**
+	 * The current length of the playlist.
+	 */
+	unsigned length;
+
+	std::vector<PlaylistEdit> edits;
+
+	bool Matches(const FileInfo &fi) const noexcept {
+		return mtime == GetPlaylistFileStamp(fi) &&
+			size == fi.GetSize();
+	}
+};
+
+static void
+RemovePlaylistEditLog(Path log_path_fs)
+{
+	try {
+		RemoveFile(log_path_fs);
+	} catch (const std::system_error &e) {
+		if (!IsFileNotFound(e))
+			throw;
+	}
+}
+
+static bool
+ParsePlaylistEditLog(TextFile &file, PlaylistEditLog &log)
+{
+	const char *line = file.ReadLine();
+	const char *p = line != nullptr ? StringAfterPrefix(line, "base ") : nullptr;
+	if (p == nullptr)
+		return false;
+
+	char *endptr;
+	log.mtime = ParseUint64(p, &endptr);
+	log.size = ParseUint64(endptr, &endptr);
+	log.base_length = log.length = ParseUnsigned(endptr, &endptr);
+	if (*endptr != 0)
+		return false;
+
+	log.edits.clear();
+
+	char *s;
+	while ((s = file.ReadLine()) != nullptr) {
+		PlaylistEdit edit{*s, 0, 0};
+		if (edit.type == 0 || s[1] != ' ')
+			return false;
+
+		p = s + 2;
+
+		switch (edit.type) {
+		case 'A':
+			log.mtime = ParseUint64(p, &endptr);
+			log.size = ParseUint64(endptr, &endptr);
+			++log.length;
+			break;
+
+		case 'D':
+			edit.a = ParseUnsigned(p, &endptr);
+			if (edit.a >= log.length)
+				return false;
+			--log.length;
+			break;
+
+		case 'M':
+			edit.a = ParseUnsigned(p, &endptr);
+			edit.b = ParseUnsigned(endptr, &endptr);
+			if (edit.a >= log.length || edit.b >= log.length)
+				return false;
+			break;
+
+		default:
+			return false;
+		}
+
+		if (*endptr != 0)
+			return false;
+
+		log.edits.push_back(edit);
+	}
+
+	return true;
+}
+
+/**
+ * Load the edit log of the given m3u file.  An obsolete or malformed
+ * log is deleted.
+ *
+ * Throws on I/O error.
+ *
+ * @return false if there is no (valid) edit log
+ */
+static bool
+LoadPlaylistEditLog(Path log_path_fs, const FileInfo &fi,
+		    PlaylistEditLog &log)
+{
+	if (!FileExists(log_path_fs))
+		return false;
+
+	bool valid;
+
+	{
+		TextFile file(log_path_fs);
+		valid = ParsePlaylistEditLog(file, log) && log.Matches(fi);
+	}
+
+	if (!valid)
+		RemovePlaylistEditLog(log_path_fs);
+
+	return valid;
+}
+
+/**
+ * Apply the edits recorded in the log to the entries of the m3u
+ * file.  The entries following the first PlaylistEditLog::base_length
+ * ones were appended while the log existed; they are consumed by the
+ * "A" records.
+ */
+static PlaylistFileContents
+ApplyPlaylistEditLog(PlaylistFileContents &&raw,
+		     const PlaylistEditLog &log) noexcept
+{
+	const std::size_t base_length =
+		std::min<std::size_t>(raw.size(), log.base_length);
+
+	PlaylistFileContents contents;
+	contents.reserve(raw.size());
+	std::move(raw.begin(), std::next(raw.begin(), base_length),
+		  std::back_inserter(contents));
+
+	auto appended = std::next(raw.begin(), base_length);
+
+	for (const auto &edit : log.edits) {
+		switch (edit.type) {
+		case 'A':
+			if (appended != raw.end())
+				contents.emplace_back(std::move(*appended++));
+			break;
+
+		case 'D':
+			if (edit.a < contents.size())
+				contents.erase(std::next(contents.begin(),
+							 edit.a));
+			break;
+
+		case 'M':
+			if (edit.a < contents.size() &&
+			    edit.b < contents.size()) {
+				const auto src = std::next(contents.begin(),
+							   edit.a);
+				auto value = std::move(*src);
+				contents.erase(src);
+				contents.insert(std::next(contents.begin(),
+							  edit.b),
+						std::move(value));
+			}
+			break;
+		}
+	}
+
+	return contents;
+}
+
+static PlaylistFileContents
+LoadPlaylistFile(Path path_fs, Path log_path_fs)
+{
+	FileInfo fi(path_fs);
+
+	PlaylistEditLog log;
+	const bool have_log = LoadPlaylistEditLog(log_path_fs, fi, log);
+
+	auto contents = LoadPlaylistFileRaw(path_fs);
+	if (have_log)
+		contents = ApplyPlaylistEditLog(std::move(contents), log);
+
+	return contents;
+}
+
+/**
+ * Rewrite the m3u file with the edits from the log applied and
+ * delete the log.
+ */
+static void
+CompactPlaylistFile(Path path_fs, Path log_path_fs)
+{
+	SavePlaylistFile(LoadPlaylistFile(path_fs, log_path_fs), path_fs);
+	RemovePlaylistEditLog(log_path_fs);
+}
+
+/**
+ * Append a record to the edit log.  If there is no log yet, it is
+ * created with a header describing the m3u file.
+ */
+static void
+AppendPlaylistEditLog(Path path_fs, Path log_path_fs,
+		      PlaylistEditLog &log, bool have_log,
+		      const char *record)
+{
+	FileOutputStream fos(log_path_fs,
+			     have_log
+			     ? FileOutputStream::Mode::APPEND_EXISTING
+			     : FileOutputStream::Mode::CREATE);
+	BufferedOutputStream bos(fos);
+
+	if (!have_log)
+		bos.Format("base %llu %llu %u\n",
+			   (unsigned long long)log.mtime,
+			   (unsigned long long)log.size,
+			   log.base_length);
+
+	bos.Write(record);
+	bos.Write('\n');
+	bos.Flush();
+	fos.Commit();
+
+	log.edits.push_back({*record, 0, 0});
+	if (log.edits.size() >= PLAYLIST_EDIT_LOG_MAX)
+		CompactPlaylistFile(path_fs, log_path_fs);
+}
+
+/**
+ * Load the edit log of a playlist for a positional edit, or prepare
+ * a new one (which requires one pass over the m3u file to count its
+ * entries).
+ *
+ * @return true if the log exists already
+ */
+static bool
+PreparePlaylistEditLog(Path path_fs, Path log_path_fs,
+		       PlaylistEditLog &log)
+try {
+	const FileInfo fi(path_fs);
+
+	if (LoadPlaylistEditLog(log_path_fs, fi, log))
+		return true;
+
+	log.mtime = GetPlaylistFileStamp(fi);
+	log.size = fi.GetSize();
+	log.base_length = log.length = LoadPlaylistFileRaw(path_fs).size();
+	log.edits.clear();
+	return false;
+} catch (const std::system_error &e) {
+	if (IsFileNotFound(e))
+		throw PlaylistError::NoSuchList();
+	throw;
+}
+
+PlaylistFileContents
+LoadPlaylistFile(const char *utf8path)
+try {
+	const auto path_fs = spl_map_to_fs(utf8path);
+	assert(!path_fs.IsNull());
+
+	return LoadPlaylistFile(path_fs, GetPlaylistEditLogPath(path_fs));
 } catch (const std::system_error &e) {
 	if (IsFileNotFound(e))
 		throw PlaylistError::NoSuchList();
 	throw;
 }
 
+void
+spl_flush(Path path_fs)
+{
+	const auto log_path_fs = GetPlaylistEditLogPath(path_fs);
+	if (FileExists(log_path_fs))
+		CompactPlaylistFile(path_fs, log_path_fs);
+}
+
+void
+spl_discard_edit_log(Path path_fs) noexcept
+{
+	try {
+		RemovePlaylistEditLog(GetPlaylistEditLogPath(path_fs));
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 {
@@ -259,21 +725,22 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 		   what the hell.. */
 		return;
 
-	auto contents = LoadPlaylistFile(utf8path);
+	const auto path_fs = spl_map_to_fs(utf8path);
+	assert(!path_fs.IsNull());
 
-	if (src >= contents.size() || dest >= contents.size())
-		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
+	const auto log_path_fs = GetPlaylistEditLogPath(path_fs);
 
-	const auto src_i = std::next(contents.begin(), src);
-	auto value = std::move(*src_i);
-	contents.erase(src_i);
+	PlaylistEditLog log;
+	const bool have_log =
+		PreparePlaylistEditLog(path_fs, log_path_fs, log);
 
-	const auto dest_i = std::next(contents.begin(), dest);
-	contents.insert(dest_i, std::move(value));
+	if (src >= log.length || dest >= log.length)
+		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
-	SavePlaylistFile(contents, utf8path);
+	AppendPlaylistEditLog(path_fs, log_path_fs, log, have_log,
+			      StringFormat<64>("M %u %u", src, dest));
 
-	idle_add(IDLE_STORED_PLAYLIST);
+	spl_modified();
 }
 
 void
@@ -292,7 +759,9 @@ spl_clear(const char *utf8path)
 			throw;
 	}
 
-	idle_add(IDLE_STORED_PLAYLIST);
+	RemovePlaylistEditLog(GetPlaylistEditLogPath(path_fs));
+
+	spl_modified();
 }
 
 void
@@ -311,21 +780,30 @@ spl_delete(const char *name_utf8)
 			throw;
 	}
 
-	idle_add(IDLE_STORED_PLAYLIST);
+	RemovePlaylistEditLog(GetPlaylistEditLogPath(path_fs));
+
+	spl_modified();
 }
 
 void
 spl_remove_index(const char *utf8path, unsigned pos)
 {
-	auto contents = LoadPlaylistFile(utf8path);
+	const auto path_fs = spl_map_to_fs(utf8path);
+	assert(!path_fs.IsNull());
+
+	const auto log_path_fs = GetPlaylistEditLogPath(path_fs);
+
+	PlaylistEditLog log;
+	const bool have_log =
+		PreparePlaylistEditLog(path_fs, log_path_fs, log);
 
-	if (pos >= contents.size())
+	if (pos >= log.length)
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
-	contents.erase(std::next(contents.begin(), pos));
+	AppendPlaylistEditLog(path_fs, log_path_fs, log, have_log,
+			      StringFormat<32>("D %u", pos));
 
-	SavePlaylistFile(contents, utf8path);
-	idle_add(IDLE_STORED_PLAYLIST);
+	spl_modified();
 }
 
 void
@@ -334,6 +812,15 @@ try {
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	/* if there is an edit log, the new entry must be recorded in
+	   it, or else the log becomes obsolete; it needs to be checked
+	   against the m3u file before the file gets modified */
+	const auto log_path_fs = GetPlaylistEditLogPath(path_fs);
+	PlaylistEditLog log;
+	bool have_log = false;
+	if (FileInfo fi; GetFileInfo(path_fs, fi))
+		have_log = LoadPlaylistEditLog(log_path_fs, fi, log);
+
 	FileOutputStream fos(path_fs, FileOutputStream::Mode::APPEND_OR_CREATE);
 
 	if (fos.Tell() / (MPD_PATH_MAX + 1) >= playlist_max_length)
@@ -347,7 +834,15 @@ try {
 	bos.Flush();
 	fos.Commit();
 
-	idle_add(IDLE_STORED_PLAYLIST);
+	if (have_log) {
+		const FileInfo fi(path_fs);
+		AppendPlaylistEditLog(path_fs, log_path_fs, log, true,
+				      StringFormat<64>("A %llu %llu",
+						       (unsigned long long)GetPlaylistFileStamp(fi),
+						       (unsigned long long)fi.GetSize()));
+	}
+
+	spl_modified();
 } catch (const std::system_error &e) {
 	if (IsFileNotFound(e))
 		throw PlaylistError::NoSuchList();
@@ -378,7 +873,12 @@ spl_rename_internal(Path from_path_fs, Path to_path_fs)
 			throw;
 	}
 
-	idle_add(IDLE_STORED_PLAYLIST);
+	const auto from_log_path_fs = GetPlaylistEditLogPath(from_path_fs);
+	if (FileExists(from_log_path_fs))
+		RenameFile(from_log_path_fs,
+			   GetPlaylistEditLogPath(to_path_fs));
+
+	spl_modified();
 }
 
 void
@@ -24,9 +24,11 @@
 #include <string>
 
 struct ConfigData;
+class EventLoop;
 class DetachedSong;
 class SongLoader;
 class PlaylistVector;
+class Path;
 class AllocatedPath;
 
 typedef std::vector<std::string> PlaylistFileContents;
@@ -39,6 +41,24 @@ extern bool playlist_saveAbsolutePaths;
 void
 spl_global_init(const ConfigData &config);
 
+/**
+ * Watch the playlist directory with inotify (if available), which
+ * allows ListPlaylistFiles() to cache its result.  Errors are
+ * logged.
+ */
+void
+spl_watch(EventLoop &loop) noexcept;
+
+void
+spl_unwatch() noexcept;
+
+/**
+ * A stored playlist has been modified: discard the cached
+ * ListPlaylistFiles() result and emit #IDLE_STORED_PLAYLIST.
+ */
+void
+spl_modified() noexcept;
+
 /**
  * Determines whether the specified string is a valid name for a
  * stored playlist.
@@ -50,14 +70,35 @@ AllocatedPath
 spl_map_to_fs(const char *name_utf8);
 
 /**
- * Returns a list of stored_playlist_info struct pointers.
+ * Returns a list of stored_playlist_info struct pointers.  While
+ * the playlist directory is watched (see spl_watch()), this is
+ * answered from a cache.  The returned reference is valid until the
+ * next call.
  */
-PlaylistVector
+const PlaylistVector &
 ListPlaylistFiles();
 
 PlaylistFileContents
 LoadPlaylistFile(const char *utf8path);
 
+/**
+ * Merge pending edits of the stored playlist into its m3u file, so
+ * it can be read by a playlist plugin (or another program).
+ *
+ * Throws on error.
+ *
+ * @param path_fs the path of the m3u file
+ */
+void
+spl_flush(Path path_fs);
+
+/**
+ * Delete the edit log of a stored playlist whose m3u file has been
+ * replaced.  Errors are logged.
+ */
+void
+spl_discard_edit_log(Path path_fs) noexcept;
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest);
 
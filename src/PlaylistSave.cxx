@@ -24,7 +24,6 @@
 #include "queue/Playlist.hxx"
 #include "song/DetachedSong.hxx"
 #include "Mapper.hxx"
-#include "Idle.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 #include "fs/FileSystem.hxx"
@@ -91,6 +90,9 @@ spl_save_queue(const char *name_utf8, const Queue &queue)
 		throw PlaylistError(PlaylistResult::LIST_EXISTS,
 				    "Playlist already exists");
 
+	/* a leftover edit log must not be applied to the new file */
+	spl_discard_edit_log(path_fs);
+
 	FileOutputStream fos(path_fs);
 	BufferedOutputStream bos(fos);
 
@@ -100,7 +102,7 @@ spl_save_queue(const char *name_utf8, const Queue &queue)
 	bos.Flush();
 	fos.Commit();
 
-	idle_add(IDLE_STORED_PLAYLIST);
+	spl_modified();
 }
 
 void
@@ -0,0 +1,184 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PLUGIN_INIT_HXX
+#define MPD_PLUGIN_INIT_HXX
+
+#include "config/Data.hxx"
+#include "config/Option.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Domain.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/StringAPI.hxx"
+#include "Log.hxx"
+
+#include <atomic>
+#include <chrono>
+
+#include <stdint.h>
+
+/**
+ * When shall decoder and input plugins be initialized?  (option
+ * "lazy_plugin_init")
+ */
+enum class PluginInitMode : uint8_t {
+	/**
+	 * Initialize all plugins at startup.
+	 */
+	EAGER,
+
+	/**
+	 * Initialize each plugin when it is used for the first
+	 * time.
+	 */
+	LAZY,
+
+	/**
+	 * Like #LAZY, but initialize the remaining plugins in a
+	 * background thread after startup.
+	 */
+	BACKGROUND,
+};
+
+/**
+ * Throws on error.
+ */
+static inline PluginInitMode
+GetPluginInitMode(const ConfigData &config)
+{
+	return config.With(ConfigOption::LAZY_PLUGIN_INIT, [](const char *s){
+		if (s == nullptr || StringIsEqual(s, "no"))
+			return PluginInitMode::EAGER;
+		else if (StringIsEqual(s, "yes"))
+			return PluginInitMode::LAZY;
+		else if (StringIsEqual(s, "background"))
+			return PluginInitMode::BACKGROUND;
+		else
+			throw FormatRuntimeError("Invalid value: %s", s);
+	});
+}
+
+/**
+ * Log how long the initialization of a plugin took; slow plugins are
+ * logged with a higher level.
+ */
+static inline void
+LogPluginInitTime(const char *type, const char *name,
+		  std::chrono::steady_clock::duration duration) noexcept
+{
+	static constexpr Domain plugin_init_domain("plugin_init");
+
+	const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
+	LogFormat(ms >= std::chrono::milliseconds(100)
+		  ? LogLevel::INFO
+		  : LogLevel::DEBUG,
+		  plugin_init_domain,
+		  "%s plugin '%s' initialized in %u ms",
+		  type, name, unsigned(ms.count()));
+}
+
+/**
+ * The initialization state of a plugin.  All methods are
+ * thread-safe.
+ */
+class LazyPluginState {
+	enum : uint8_t {
+		/**
+		 * Disabled in the configuration, or the
+		 * initialization has failed.
+		 */
+		DISABLED,
+
+		/**
+		 * Not yet initialized; this will be done on first
+		 * use.
+		 */
+		PENDING,
+
+		/**
+		 * Initialized successfully.
+		 */
+		ENABLED,
+	};
+
+	std::atomic<uint8_t> state{DISABLED};
+
+public:
+	void SetPending() noexcept {
+		state.store(PENDING, std::memory_order_relaxed);
+	}
+
+	void SetEnabled() noexcept {
+		state.store(ENABLED, std::memory_order_release);
+	}
+
+	/**
+	 * Has the plugin been initialized successfully?
+	 */
+	bool IsEnabled() const noexcept {
+		return state.load(std::memory_order_acquire) == ENABLED;
+	}
+
+	/**
+	 * Is the plugin enabled or not yet initialized?
+	 */
+	bool IsAvailable() const noexcept {
+		return state.load(std::memory_order_acquire) != DISABLED;
+	}
+
+	bool IsPending() const noexcept {
+		return state.load(std::memory_order_acquire) == PENDING;
+	}
+
+	/**
+	 * Initialize the plugin if that has not been done yet.
+	 *
+	 * @param mutex serializes all lazy initializations of one
+	 * plugin registry
+	 * @param init the initialization function; it returns false
+	 * (or throws) if the plugin shall be disabled
+	 * @return true if the plugin is enabled
+	 */
+	template<typename F>
+	bool Ensure(Mutex &mutex, F &&init) noexcept {
+		if (!IsPending())
+			return IsEnabled();
+
+		const std::lock_guard<Mutex> lock(mutex);
+
+		/* check again; another thread may have been
+		   faster */
+		if (!IsPending())
+			return IsEnabled();
+
+		bool success;
+		try {
+			success = init();
+		} catch (...) {
+			LogError(std::current_exception());
+			success = false;
+		}
+
+		state.store(success ? ENABLED : DISABLED,
+			    std::memory_order_release);
+		return success;
+	}
+};
+
+#endif
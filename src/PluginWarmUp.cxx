@@ -0,0 +1,53 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "PluginWarmUp.hxx"
+#include "decoder/DecoderList.hxx"
+#include "input/Registry.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+
+void
+PluginWarmUp::Start()
+{
+	cancel = false;
+	thread.Start();
+}
+
+void
+PluginWarmUp::Stop() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	cancel = true;
+	thread.Join();
+}
+
+void
+PluginWarmUp::Run() noexcept
+{
+	SetThreadName("plugin_init");
+	SetThreadIdlePriority();
+
+	for (unsigned i = 0; decoder_plugins[i] != nullptr && !cancel; ++i)
+		decoder_plugin_ensure_init(i);
+
+	for (unsigned i = 0; input_plugins[i] != nullptr && !cancel; ++i)
+		input_plugin_ensure_init(i);
+}
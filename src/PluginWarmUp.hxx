@@ -0,0 +1,57 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_PLUGIN_WARM_UP_HXX
+#define MPD_PLUGIN_WARM_UP_HXX
+
+#include "thread/Thread.hxx"
+
+#include <atomic>
+
+/**
+ * A thread which initializes all decoder and input plugins whose
+ * initialization was postponed (#PluginInitMode::BACKGROUND), so the
+ * first song does not have to pay for it.
+ */
+class PluginWarmUp {
+	Thread thread;
+
+	std::atomic_bool cancel{false};
+
+public:
+	PluginWarmUp() noexcept
+		:thread(BIND_THIS_METHOD(Run)) {}
+
+	~PluginWarmUp() noexcept {
+		Stop();
+	}
+
+	void Start();
+
+	/**
+	 * Stop the thread after the plugin which is currently being
+	 * initialized and wait for it to finish.  This must be called
+	 * while the "io" thread is still running.
+	 */
+	void Stop() noexcept;
+
+private:
+	void Run() noexcept;
+};
+
+#endif
@@ -19,23 +19,158 @@
 
 #include "RemoteTagCache.hxx"
 #include "RemoteTagCacheHandler.hxx"
+#include "SongSave.hxx"
+#include "song/DetachedSong.hxx"
 #include "input/ScanTags.hxx"
+#include "config/Block.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "system/Error.hxx"
 #include "util/DeleteDisposer.hxx"
+#include "util/StringCompare.hxx"
+#include "util/StringView.hxx"
+#include "util/UriExtract.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <assert.h>
+
+#define CACHE_VERSION "remote_tag_cache: 1"
+
+static constexpr Domain remote_tag_cache_domain("remote_tag_cache");
+
+RemoteTagCacheConfig::RemoteTagCacheConfig(const ConfigBlock &block)
+	:size(block.GetPositiveValue("size", 4096u)),
+	 ttl(std::chrono::seconds(block.GetPositiveValue("ttl", 86400u))),
+	 max_scans(block.GetPositiveValue("max_scans", 16u)),
+	 max_scans_per_host(block.GetPositiveValue("max_scans_per_host", 4u)),
+	 path(block.GetPath("path"))
+{
+}
+
+/**
+ * Returns the key for RemoteTagCache::running_per_host.
+ */
+static std::string
+GetHostKey(const std::string &uri) noexcept
+{
+	const auto authority = uri_get_authority(uri.c_str());
+	if (authority.IsNull())
+		return {};
+
+	return {authority.data, authority.size};
+}
+
 RemoteTagCache::RemoteTagCache(EventLoop &event_loop,
-			       RemoteTagCacheHandler &_handler) noexcept
-	:handler(_handler),
+			       RemoteTagCacheHandler &_handler,
+			       RemoteTagCacheConfig &&_config) noexcept
+	:config(std::move(_config)),
+	 handler(_handler),
 	 defer_invoke_handler(event_loop, BIND_THIS_METHOD(InvokeHandlers)),
 	 map(typename KeyMap::bucket_traits(&buckets.front(), buckets.size()))
 {
+	if (config.path.IsNull())
+		return;
+
+	try {
+		Load();
+	} catch (const std::system_error &e) {
+		if (!IsFileNotFound(e))
+			LogError(e, "Failed to load the remote tag cache");
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to load the remote tag cache");
+	}
 }
 
 RemoteTagCache::~RemoteTagCache() noexcept
 {
+	if (modified && !config.path.IsNull()) {
+		try {
+			Save();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to save the remote tag cache");
+		}
+	}
+
 	map.clear_and_dispose(DeleteDisposer());
 }
 
+inline void
+RemoteTagCache::Load()
+{
+	TextFile file(config.path);
+
+	const char *line = file.ReadLine();
+	if (line == nullptr || !StringIsEqual(line, CACHE_VERSION)) {
+		LogDebug(remote_tag_cache_domain,
+			 "Ignoring incompatible remote tag cache file");
+		return;
+	}
+
+	char *s;
+	while ((s = file.ReadLine()) != nullptr) {
+		const char *uri = StringAfterPrefix(s, SONG_BEGIN);
+		if (uri == nullptr)
+			throw FormatRuntimeError("Malformed remote tag cache line: %s",
+						 s);
+
+		/* copy the URI, because song_load() overwrites the
+		   line buffer */
+		auto *item = new Item(*this, uri);
+		auto song = song_load(file, item->uri.c_str());
+		item->tag = std::move(song.WritableTag());
+		item->time = song.GetLastModified();
+
+		KeyMap::insert_commit_data hint;
+		if (IsExpired(*item) ||
+		    !map.insert_check(item->uri, Item::Hash(), Item::Equal(),
+				      hint).second) {
+			delete item;
+			continue;
+		}
+
+		map.insert_commit(*item, hint);
+		idle_list.push_back(*item);
+	}
+
+	/* the file is sorted from least to most recently used */
+	while (map.size() > config.size) {
+		auto *item = &idle_list.front();
+		idle_list.pop_front();
+		map.erase(map.iterator_to(*item));
+		delete item;
+	}
+}
+
+inline void
+RemoteTagCache::Save()
+{
+	FileOutputStream fos(config.path);
+	BufferedOutputStream os(fos);
+
+	os.Write(CACHE_VERSION "\n");
+
+	/* only successful lookups are saved; failed ones will be
+	   retried after the restart */
+	for (const auto *list : {&idle_list, &invoke_list}) {
+		for (const auto &item : *list) {
+			if (!item.tag.IsDefined())
+				continue;
+
+			DetachedSong song(item.uri, Tag(item.tag));
+			song.SetLastModified(item.time);
+			song_save(os, song);
+		}
+	}
+
+	os.Flush();
+	fos.Commit();
+}
+
 void
 RemoteTagCache::Lookup(const std::string &uri) noexcept
 {
@@ -46,32 +181,17 @@ RemoteTagCache::Lookup(const std::string &uri) noexcept
 	if (result.second) {
 		auto *item = new Item(*this, uri);
 		map.insert_commit(*item, hint);
-		waiting_list.push_back(*item);
-		lock.unlock();
-
-		try {
-			item->scanner = InputScanTags(uri.c_str(), *item);
-			if (!item->scanner) {
-				/* unsupported */
-				lock.lock();
-				ItemResolved(*item);
-				return;
-			}
-
-			item->scanner->Start();
-		} catch (...) {
-			FormatError(std::current_exception(),
-				    "Failed to scan tags of '%s'",
-				    uri.c_str());
+		Enqueue(lock, *item);
+	} else if (result.first->busy) {
+		/* already scanning this one - no-op */
+	} else if (IsExpired(*result.first)) {
+		/* too old: scan again */
 
-			item->scanner.reset();
+		auto &item = *result.first;
+		item.tag.Clear();
 
-			lock.lock();
-			ItemResolved(*item);
-			return;
-		}
-	} else if (result.first->scanner) {
-		/* already scanning this one - no-op */
+		idle_list.erase(idle_list.iterator_to(item));
+		Enqueue(lock, item);
 	} else {
 		/* already finished: re-invoke the handler */
 
@@ -84,36 +204,127 @@ RemoteTagCache::Lookup(const std::string &uri) noexcept
 	}
 }
 
+void
+RemoteTagCache::Enqueue(std::unique_lock<Mutex> &lock, Item &item) noexcept
+{
+	item.busy = true;
+	pending_list.push_back(item);
+	StartPending(lock);
+}
+
+void
+RemoteTagCache::StartPending(std::unique_lock<Mutex> &lock) noexcept
+{
+	/* only the event loop thread modifies #pending_list, so the
+	   iterator remains valid while StartScanner() releases the
+	   mutex */
+	for (auto i = pending_list.begin();
+	     i != pending_list.end() && n_running < config.max_scans;) {
+		auto &item = *i++;
+
+		const auto host = GetHostKey(item.uri);
+		auto h = running_per_host.find(host);
+		if (h == running_per_host.end())
+			h = running_per_host.emplace(host, 0).first;
+		else if (h->second >= config.max_scans_per_host)
+			/* this host is busy; try the next item */
+			continue;
+
+		++h->second;
+		++n_running;
+
+		pending_list.erase(pending_list.iterator_to(item));
+		waiting_list.push_back(item);
+		StartScanner(lock, item);
+	}
+}
+
+void
+RemoteTagCache::StartScanner(std::unique_lock<Mutex> &lock,
+			     Item &item) noexcept
+{
+	lock.unlock();
+
+	try {
+		item.scanner = InputScanTags(item.uri.c_str(), item);
+		if (!item.scanner) {
+			/* unsupported */
+			lock.lock();
+			ItemResolved(item);
+			return;
+		}
+
+		item.scanner->Start();
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Failed to scan tags of '%s'",
+			    item.uri.c_str());
+
+		item.scanner.reset();
+
+		lock.lock();
+		ItemResolved(item);
+	}
+}
+
 void
 RemoteTagCache::ItemResolved(Item &item) noexcept
 {
+	item.time = std::chrono::system_clock::now();
+	item.busy = false;
+	modified = true;
+
 	waiting_list.erase(waiting_list.iterator_to(item));
 	invoke_list.push_back(item);
 
+	/* release the slot; StartPending() will be called by
+	   InvokeHandlers() in the event loop thread */
+	assert(n_running > 0);
+	--n_running;
+
+	auto h = running_per_host.find(GetHostKey(item.uri));
+	assert(h != running_per_host.end());
+	assert(h->second > 0);
+	if (--h->second == 0)
+		running_per_host.erase(h);
+
 	ScheduleInvokeHandlers();
 }
 
 void
 RemoteTagCache::InvokeHandlers() noexcept
 {
-	const std::lock_guard<Mutex> lock(mutex);
+	std::unique_lock<Mutex> lock(mutex);
 
-	while (!invoke_list.empty()) {
-		auto &item = invoke_list.front();
-		invoke_list.pop_front();
-		idle_list.push_back(item);
+	if (!invoke_list.empty()) {
+		lock.unlock();
+		handler.BeginRemoteTagBatch();
+		lock.lock();
 
-		const ScopeUnlock unlock(mutex);
-		handler.OnRemoteTag(item.uri.c_str(), item.tag);
+		while (!invoke_list.empty()) {
+			auto &item = invoke_list.front();
+			invoke_list.pop_front();
+			idle_list.push_back(item);
+
+			const ScopeUnlock unlock(mutex);
+			handler.OnRemoteTag(item.uri.c_str(), item.tag);
+		}
+
+		lock.unlock();
+		handler.CommitRemoteTagBatch();
+		lock.lock();
 	}
 
 	/* evict items if there are too many */
-	while (map.size() > MAX_SIZE && !idle_list.empty()) {
+	while (map.size() > config.size && !idle_list.empty()) {
 		auto *item = &idle_list.front();
 		idle_list.pop_front();
 		map.erase(map.iterator_to(*item));
 		delete item;
 	}
+
+	/* resolved items have released their slots */
+	StartPending(lock);
 }
 
 void
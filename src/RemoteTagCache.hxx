@@ -23,20 +23,59 @@
 #include "input/RemoteTagScanner.hxx"
 #include "tag/Tag.hxx"
 #include "event/DeferEvent.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "thread/Mutex.hxx"
 
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/unordered_set.hpp>
 
+#include <chrono>
+#include <map>
 #include <string>
 
+struct ConfigBlock;
 class RemoteTagCacheHandler;
 
+struct RemoteTagCacheConfig {
+	/**
+	 * The maximum number of items.
+	 */
+	size_t size = 4096;
+
+	/**
+	 * Items which were resolved longer ago than this are scanned
+	 * again.
+	 */
+	std::chrono::system_clock::duration ttl = std::chrono::hours(24);
+
+	/**
+	 * The maximum number of #RemoteTagScanner instances running
+	 * at a time.  More lookups are queued.
+	 */
+	unsigned max_scans = 16;
+
+	/**
+	 * The maximum number of #RemoteTagScanner instances running
+	 * at a time for one host.
+	 */
+	unsigned max_scans_per_host = 4;
+
+	/**
+	 * The file which keeps the cache across restarts; nullptr if
+	 * disabled.
+	 */
+	AllocatedPath path = nullptr;
+
+	RemoteTagCacheConfig() noexcept = default;
+
+	explicit RemoteTagCacheConfig(const ConfigBlock &block);
+};
+
 /**
  * A cache for tags received via #RemoteTagScanner.
  */
 class RemoteTagCache final {
-	static constexpr size_t MAX_SIZE = 4096;
+	const RemoteTagCacheConfig config;
 
 	RemoteTagCacheHandler &handler;
 
@@ -57,6 +96,16 @@ class RemoteTagCache final {
 
 		Tag tag;
 
+		/**
+		 * Is this item in #pending_list or #waiting_list?
+		 */
+		bool busy = false;
+
+		/**
+		 * When was this item resolved?
+		 */
+		std::chrono::system_clock::time_point time;
+
 		template<typename U>
 		Item(RemoteTagCache &_parent, U &&_uri) noexcept
 			:parent(_parent), uri(std::forward<U>(_uri)) {}
@@ -94,12 +143,20 @@ class RemoteTagCache final {
 
 	/**
 	 * These items have been resolved completely (successful or
-	 * failed).  All callbacks have been invoked.  The oldest
-	 * comes first in the list, and is the first one to be evicted
-	 * if the cache is full.
+	 * failed).  All callbacks have been invoked.  The least
+	 * recently used one comes first in the list, and is the first
+	 * one to be evicted if the cache is full.
 	 */
 	ItemList idle_list;
 
+	/**
+	 * These items shall be scanned, but the scanner has not yet
+	 * been started because the #RemoteTagCacheConfig::max_scans
+	 * or #RemoteTagCacheConfig::max_scans_per_host limit has been
+	 * reached.  StartPending() starts them in FIFO order.
+	 */
+	ItemList pending_list;
+
 	/**
 	 * A #RemoteTagScanner instances is currently busy on fetching
 	 * information, and we're waiting for our #RemoteTagHandler
@@ -123,14 +180,71 @@ class RemoteTagCache final {
 
 	KeyMap map;
 
+	/**
+	 * The number of items in #waiting_list.
+	 */
+	unsigned n_running = 0;
+
+	/**
+	 * The number of items in #waiting_list per host (see
+	 * uri_get_authority()).  Hosts without running scanners are
+	 * removed.
+	 */
+	std::map<std::string, unsigned> running_per_host;
+
+	/**
+	 * Has an item been resolved since the file was loaded?
+	 */
+	bool modified = false;
+
 public:
+	/**
+	 * Loads the file (if one is configured); errors are logged.
+	 */
 	RemoteTagCache(EventLoop &event_loop,
-		       RemoteTagCacheHandler &_handler) noexcept;
+		       RemoteTagCacheHandler &_handler,
+		       RemoteTagCacheConfig &&_config) noexcept;
+
+	/**
+	 * Saves the file (if one is configured); errors are logged.
+	 */
 	~RemoteTagCache() noexcept;
 
 	void Lookup(const std::string &uri) noexcept;
 
 private:
+	gcc_pure
+	bool IsExpired(const Item &item) const noexcept {
+		return std::chrono::system_clock::now() - item.time > config.ttl;
+	}
+
+	/**
+	 * Add the item to the #pending_list and start as many
+	 * scanners as the limits allow.
+	 */
+	void Enqueue(std::unique_lock<Mutex> &lock, Item &item) noexcept;
+
+	/**
+	 * Move items from #pending_list to #waiting_list and start
+	 * their scanners, as long as the limits allow.
+	 *
+	 * @param lock a lock on #mutex which is released while the
+	 * scanners are being started
+	 */
+	void StartPending(std::unique_lock<Mutex> &lock) noexcept;
+
+	/**
+	 * Start scanning the tags of an item which has been added to
+	 * the #waiting_list.
+	 *
+	 * @param lock a lock on #mutex which is released while the
+	 * scanner is being started
+	 */
+	void StartScanner(std::unique_lock<Mutex> &lock, Item &item) noexcept;
+
+	void Load();
+	void Save();
+
 	void InvokeHandlers() noexcept;
 
 	void ScheduleInvokeHandlers() noexcept {
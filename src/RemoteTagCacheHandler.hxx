@@ -25,6 +25,14 @@ struct Tag;
 class RemoteTagCacheHandler {
 public:
 	virtual void OnRemoteTag(const char *uri, const Tag &tag) noexcept = 0;
+
+	/**
+	 * Called before and after a batch of OnRemoteTag() calls.
+	 * This allows the handler to postpone (and merge)
+	 * notifications until the whole batch has been delivered.
+	 */
+	virtual void BeginRemoteTagBatch() noexcept {}
+	virtual void CommitRemoteTagBatch() noexcept {}
 };
 
 #endif
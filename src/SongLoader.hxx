@@ -62,6 +62,10 @@ public:
 #endif
 
 #ifdef ENABLE_DATABASE
+	const Database *GetDatabase() const {
+		return db;
+	}
+
 	const Storage *GetStorage() const {
 		return storage;
 	}
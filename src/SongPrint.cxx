@@ -26,6 +26,7 @@
 #include "fs/Traits.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/UriUtil.hxx"
+#include "util/StringView.hxx"
 
 #define SONG_FILE "file: "
 
@@ -42,7 +43,7 @@ song_print_uri(Response &r, const char *uri, bool base) noexcept
 			uri = allocated.c_str();
 	}
 
-	r.Format(SONG_FILE "%s\n", uri);
+	r.WriteField("file", uri);
 }
 
 void
@@ -89,7 +90,7 @@ song_print_info(Response &r, const LightSong &song, bool base) noexcept
 		time_print(r, "Last-Modified", song.mtime);
 
 	if (song.audio_format.IsDefined())
-		r.Format("Format: %s\n", ToString(song.audio_format).c_str());
+		r.WriteField("Format", ToString(song.audio_format).c_str());
 
 	tag_print(r, song.tag);
 }
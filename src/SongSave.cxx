@@ -22,11 +22,13 @@
 #include "db/plugins/simple/Song.hxx"
 #include "song/DetachedSong.hxx"
 #include "TagSave.hxx"
-#include "fs/io/TextFile.hxx"
+#include "fs/io/LineReader.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "tag/ParseName.hxx"
 #include "tag/Tag.hxx"
 #include "tag/Builder.hxx"
+#include "tag/ReplayGain.hxx"
+#include "ReplayGainInfo.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/StringAPI.hxx"
 #include "util/StringBuffer.hxx"
@@ -39,6 +41,20 @@
 #define SONG_MTIME "mtime"
 #define SONG_END "song_end"
 
+static void
+replay_gain_save(BufferedOutputStream &os, const ReplayGainInfo &info)
+{
+	if (info.track.IsDefined())
+		os.Format("replaygain_track_gain: %.2f\n"
+			  "replaygain_track_peak: %.6f\n",
+			  info.track.gain, info.track.peak);
+
+	if (info.album.IsDefined())
+		os.Format("replaygain_album_gain: %.2f\n"
+			  "replaygain_album_peak: %.6f\n",
+			  info.album.gain, info.album.peak);
+}
+
 static void
 range_save(BufferedOutputStream &os, unsigned start_ms, unsigned end_ms)
 {
@@ -51,15 +67,17 @@ range_save(BufferedOutputStream &os, unsigned start_ms, unsigned end_ms)
 void
 song_save(BufferedOutputStream &os, const Song &song)
 {
-	os.Format(SONG_BEGIN "%s\n", song.filename.c_str());
+	os.Format(SONG_BEGIN "%s\n", song.GetFilename());
 
-	if (!song.target.empty())
-		os.Format("Target: %s\n", song.target.c_str());
+	if (song.HasTarget())
+		os.Format("Target: %s\n", song.GetTarget());
 
-	range_save(os, song.start_time.ToMS(), song.end_time.ToMS());
+	range_save(os, song.GetStartTime().ToMS(), song.GetEndTime().ToMS());
 
 	tag_save(os, song.tag);
 
+	replay_gain_save(os, song.GetReplayGain());
+
 	if (song.audio_format.IsDefined())
 		os.Format("Format: %s\n", ToString(song.audio_format).c_str());
 
@@ -70,14 +88,20 @@ song_save(BufferedOutputStream &os, const Song &song)
 }
 
 void
-song_save(BufferedOutputStream &os, const DetachedSong &song)
+song_save(BufferedOutputStream &os, const DetachedSong &song,
+	  const char *target)
 {
 	os.Format(SONG_BEGIN "%s\n", song.GetURI());
 
+	if (target != nullptr && *target != 0)
+		os.Format("Target: %s\n", target);
+
 	range_save(os, song.GetStartTime().ToMS(), song.GetEndTime().ToMS());
 
 	tag_save(os, song.GetTag());
 
+	replay_gain_save(os, song.GetReplayGain());
+
 	if (!IsNegative(song.GetLastModified()))
 		os.Format(SONG_MTIME ": %li\n",
 			  (long)std::chrono::system_clock::to_time_t(song.GetLastModified()));
@@ -85,13 +109,14 @@ song_save(BufferedOutputStream &os, const DetachedSong &song)
 }
 
 DetachedSong
-song_load(TextFile &file, const char *uri,
+song_load(LineReader &file, const char *uri,
 	  std::string *target_r,
 	  AudioFormat *audio_format_r)
 {
 	DetachedSong song(uri);
 
 	TagBuilder tag;
+	auto replay_gain = ReplayGainInfo::Undefined();
 
 	char *line;
 	while ((line = file.ReadLine()) != nullptr &&
@@ -135,11 +160,14 @@ song_load(TextFile &file, const char *uri,
 
 			song.SetStartTime(SongTime::FromMS(start_ms));
 			song.SetEndTime(SongTime::FromMS(end_ms));
+		} else if (ParseReplayGainTag(replay_gain, line, value)) {
+			/* measured by the database update */
 		} else {
 			throw FormatRuntimeError("unknown line in db: %s", line);
 		}
 	}
 
 	song.SetTag(tag.Commit());
+	song.SetReplayGain(replay_gain);
 	return song;
 }
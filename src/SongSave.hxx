@@ -28,13 +28,18 @@ struct Song;
 struct AudioFormat;
 class DetachedSong;
 class BufferedOutputStream;
-class TextFile;
+class LineReader;
 
 void
 song_save(BufferedOutputStream &os, const Song &song);
 
+/**
+ * @param target an optional "Target" value (see Song::GetTarget()),
+ * to be loaded by song_load()
+ */
 void
-song_save(BufferedOutputStream &os, const DetachedSong &song);
+song_save(BufferedOutputStream &os, const DetachedSong &song,
+	  const char *target=nullptr);
 
 /**
  * Loads a song from the input file.  Reading stops after the
@@ -43,7 +48,7 @@ song_save(BufferedOutputStream &os, const DetachedSong &song);
  * Throws on error.
  */
 DetachedSong
-song_load(TextFile &file, const char *uri,
+song_load(LineReader &file, const char *uri,
 	  std::string *target_r=nullptr,
 	  AudioFormat *audio_format_r=nullptr);
 
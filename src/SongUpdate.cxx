@@ -45,7 +45,7 @@ Song::LoadFile(Storage &storage, const char *path_utf8, Directory &parent)
 	assert(!uri_has_scheme(path_utf8));
 	assert(strchr(path_utf8, '\n') == nullptr);
 
-	auto song = std::make_unique<Song>(path_utf8, parent);
+	auto song = Song::New(path_utf8, parent);
 	if (!song->UpdateFile(storage))
 		return nullptr;
 
@@ -57,21 +57,21 @@ Song::LoadFile(Storage &storage, const char *path_utf8, Directory &parent)
 #ifdef ENABLE_DATABASE
 
 bool
-Song::UpdateFile(Storage &storage)
+Song::ScanFile(Storage &storage, const char *relative_uri,
+	       Tag &tag_r, AudioFormat &audio_format_r,
+	       std::chrono::system_clock::time_point &mtime_r)
 {
-	const auto &relative_uri = GetURI();
-
-	const auto info = storage.GetInfo(relative_uri.c_str(), true);
+	const auto info = storage.GetInfo(relative_uri, true);
 	if (!info.IsRegular())
 		return false;
 
 	TagBuilder tag_builder;
 	auto new_audio_format = AudioFormat::Undefined();
 
-	const auto path_fs = storage.MapFS(relative_uri.c_str());
+	const auto path_fs = storage.MapFS(relative_uri);
 	if (path_fs.IsNull()) {
 		const auto absolute_uri =
-			storage.MapUTF8(relative_uri.c_str());
+			storage.MapUTF8(relative_uri);
 		if (!tag_stream_scan(absolute_uri.c_str(), tag_builder,
 				     &new_audio_format))
 			return false;
@@ -81,12 +81,20 @@ Song::UpdateFile(Storage &storage)
 			return false;
 	}
 
-	mtime = info.mtime;
-	audio_format = new_audio_format;
-	tag_builder.Commit(tag);
+	mtime_r = info.mtime;
+	audio_format_r = new_audio_format;
+	tag_builder.Commit(tag_r);
 	return true;
 }
 
+bool
+Song::UpdateFile(Storage &storage)
+{
+	const auto relative_uri = GetURI();
+	return ScanFile(storage, relative_uri.c_str(),
+			tag, audio_format, mtime);
+}
+
 #endif
 
 #ifdef ENABLE_ARCHIVE
@@ -98,7 +106,7 @@ Song::LoadFromArchive(ArchiveFile &archive, const char *name_utf8,
 	assert(!uri_has_scheme(name_utf8));
 	assert(strchr(name_utf8, '\n') == nullptr);
 
-	auto song = std::make_unique<Song>(name_utf8, parent);
+	auto song = Song::New(name_utf8, parent);
 	if (!song->UpdateFileInArchive(archive))
 		return nullptr;
 
@@ -107,10 +115,16 @@ Song::LoadFromArchive(ArchiveFile &archive, const char *name_utf8,
 
 bool
 Song::UpdateFileInArchive(ArchiveFile &archive) noexcept
+{
+	return ScanFileInArchive(archive, tag);
+}
+
+bool
+Song::ScanFileInArchive(ArchiveFile &archive, Tag &tag_r) const noexcept
 {
 	assert(parent.device == DEVICE_INARCHIVE);
 
-	std::string path_utf8(filename);
+	std::string path_utf8(GetFilename());
 
 	for (const Directory *directory = &parent;
 	     directory->parent != nullptr &&
@@ -124,7 +138,7 @@ Song::UpdateFileInArchive(ArchiveFile &archive) noexcept
 	if (!tag_archive_scan(archive, path_utf8.c_str(), tag_builder))
 		return false;
 
-	tag_builder.Commit(tag);
+	tag_builder.Commit(tag_r);
 	return true;
 }
 
@@ -36,10 +36,28 @@
 
 static constexpr Domain state_file_domain("state_file");
 
+#ifdef ENABLE_DATABASE
+/**
+ * The number of queue songs checked by one StateFile::OnRefresh()
+ * call.
+ */
+static constexpr unsigned REFRESH_BATCH = 256;
+
+/**
+ * The delay between two StateFile::OnRefresh() calls, to let the
+ * #EventLoop handle other events in between.
+ */
+static constexpr std::chrono::steady_clock::duration REFRESH_DELAY =
+	std::chrono::milliseconds(10);
+#endif
+
 StateFile::StateFile(StateFileConfig &&_config,
 		     Partition &_partition, EventLoop &_loop)
 	:config(std::move(_config)), path_utf8(config.path.ToUTF8()),
 	 timer_event(_loop, BIND_THIS_METHOD(OnTimeout)),
+#ifdef ENABLE_DATABASE
+	 refresh_timer(_loop, BIND_THIS_METHOD(OnRefresh)),
+#endif
 	 partition(_partition)
 {
 }
@@ -70,7 +88,7 @@ StateFile::IsModified() const noexcept
 }
 
 inline void
-StateFile::Write(BufferedOutputStream &os)
+StateFile::Write(BufferedOutputStream &os, bool external_queue)
 {
 	save_sw_volume_state(os);
 	audio_output_state_save(os, partition.outputs);
@@ -79,26 +97,62 @@ StateFile::Write(BufferedOutputStream &os)
 	storage_state_save(os, partition.instance);
 #endif
 
-	playlist_state_save(os, partition.playlist, partition.pc);
+	playlist_state_save(config, os, partition.playlist, partition.pc,
+			    external_queue);
 }
 
 inline void
-StateFile::Write(OutputStream &os)
+StateFile::Write(OutputStream &os, bool external_queue)
 {
 	BufferedOutputStream bos(os);
-	Write(bos);
+	Write(bos, external_queue);
 	bos.Flush();
 }
 
+bool
+StateFile::WriteQueue() noexcept
+{
+	const unsigned version = partition.playlist.queue.version;
+	if (queue_saved && version == prev_queue_version)
+		/* only the player status has changed; don't rewrite
+		   the (possibly large) queue */
+		return true;
+
+	FormatDebug(state_file_domain,
+		    "Saving queue file %s", config.queue_path.ToUTF8().c_str());
+
+	queue_saved = false;
+
+	try {
+		FileOutputStream fos(config.queue_path);
+		BufferedOutputStream bos(fos);
+		playlist_state_save_queue(config, bos, partition.playlist);
+		bos.Flush();
+		fos.Commit();
+	} catch (...) {
+		LogError(std::current_exception());
+		return false;
+	}
+
+	prev_queue_version = version;
+	queue_saved = true;
+	return true;
+}
+
 void
 StateFile::Write()
 {
+	/* if the queue file can't be written, fall back to saving
+	   the queue in the state file */
+	const bool external_queue = !config.queue_path.IsNull() &&
+		WriteQueue();
+
 	FormatDebug(state_file_domain,
 		    "Saving state file %s", path_utf8.c_str());
 
 	try {
 		FileOutputStream fos(config.path);
-		Write(fos);
+		Write(fos, external_queue);
 		fos.Commit();
 	} catch (...) {
 		LogError(std::current_exception());
@@ -116,6 +170,16 @@ try {
 
 	TextFile file(config.path);
 
+	std::unique_ptr<TextFile> queue_file;
+	if (!config.queue_path.IsNull()) {
+		try {
+			queue_file = std::make_unique<TextFile>(config.queue_path);
+		} catch (...) {
+			/* doesn't exist yet; no problem unless the
+			   state file refers to it */
+		}
+	}
+
 #ifdef ENABLE_DATABASE
 	const SongLoader song_loader(partition.instance.GetDatabase(),
 				     partition.instance.storage);
@@ -127,7 +191,8 @@ try {
 	while ((line = file.ReadLine()) != nullptr) {
 		success = read_sw_volume_state(line, partition.outputs) ||
 			audio_output_state_read(line, partition.outputs) ||
-			playlist_state_restore(config, line, file, song_loader,
+			playlist_state_restore(config, line, file,
+					       queue_file.get(), song_loader,
 					       partition.playlist,
 					       partition.pc);
 #ifdef ENABLE_DATABASE
@@ -140,6 +205,22 @@ try {
 				    line);
 	}
 
+#ifdef ENABLE_DATABASE
+	if (config.queue_metadata && partition.instance.GetDatabase() != nullptr &&
+	    !partition.playlist.queue.IsEmpty()) {
+		/* the queue was restored without database lookups;
+		   verify it in the background */
+		refresh_position = 0;
+		refresh_timer.Schedule(REFRESH_DELAY);
+	}
+#endif
+
+	/* if the queue was loaded from the queue file, then it has
+	   been read until the end; otherwise (e.g. after enabling
+	   "state_file_separate_queue") it must be rewritten */
+	queue_saved = queue_file != nullptr && queue_file->ReadLine() == nullptr;
+	prev_queue_version = partition.playlist.queue.version;
+
 	RememberVersions();
 } catch (...) {
 	LogError(std::current_exception());
@@ -157,3 +238,33 @@ StateFile::OnTimeout() noexcept
 {
 	Write();
 }
+
+#ifdef ENABLE_DATABASE
+
+void
+StateFile::OnRefresh() noexcept
+{
+	const Database *db = partition.instance.GetDatabase();
+	if (db == nullptr)
+		return;
+
+	auto &playlist = partition.playlist;
+
+	try {
+		refresh_position = playlist.RefreshFromDatabase(partition.pc,
+								*db,
+								refresh_position,
+								REFRESH_BATCH);
+	} catch (...) {
+		LogError(std::current_exception());
+		return;
+	}
+
+	if (refresh_position < playlist.queue.GetLength())
+		refresh_timer.Schedule(REFRESH_DELAY);
+	else
+		FormatDebug(state_file_domain,
+			    "Queue has been refreshed from the database");
+}
+
+#endif
@@ -22,6 +22,7 @@
 
 #include "StateFileConfig.hxx"
 #include "event/TimerEvent.hxx"
+#include "event/CoarseTimerEvent.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
@@ -36,7 +37,20 @@ class StateFile final {
 
 	const std::string path_utf8;
 
-	TimerEvent timer_event;
+	CoarseTimerEvent timer_event;
+
+#ifdef ENABLE_DATABASE
+	/**
+	 * Refreshes the queue from the database in small steps after
+	 * it was restored with StateFileConfig::queue_metadata.
+	 */
+	TimerEvent refresh_timer;
+
+	/**
+	 * The queue position where #refresh_timer continues.
+	 */
+	unsigned refresh_position;
+#endif
 
 	Partition &partition;
 
@@ -51,6 +65,18 @@ class StateFile final {
 	unsigned prev_storage_version = 0;
 #endif
 
+	/**
+	 * The queue version saved in StateFileConfig::queue_path.
+	 * Only valid if #queue_saved is true.
+	 */
+	unsigned prev_queue_version;
+
+	/**
+	 * Does the file StateFileConfig::queue_path contain the queue
+	 * as of #prev_queue_version?
+	 */
+	bool queue_saved = false;
+
 public:
 	StateFile(StateFileConfig &&_config,
 		  Partition &partition, EventLoop &loop);
@@ -64,8 +90,16 @@ public:
 	void CheckModified() noexcept;
 
 private:
-	void Write(OutputStream &os);
-	void Write(BufferedOutputStream &os);
+	void Write(OutputStream &os, bool external_queue);
+	void Write(BufferedOutputStream &os, bool external_queue);
+
+	/**
+	 * Write the queue to StateFileConfig::queue_path, unless it
+	 * is unmodified.
+	 *
+	 * @return true if the file contains the current queue
+	 */
+	bool WriteQueue() noexcept;
 
 	/**
 	 * Save the current state versions for use with IsModified().
@@ -81,6 +115,11 @@ private:
 
 	/* callback for #timer_event */
 	void OnTimeout() noexcept;
+
+#ifdef ENABLE_DATABASE
+	/* callback for #refresh_timer */
+	void OnRefresh() noexcept;
+#endif
 };
 
 #endif /* STATE_FILE_H */
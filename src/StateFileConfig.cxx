@@ -19,6 +19,7 @@
 
 #include "StateFileConfig.hxx"
 #include "config/Data.hxx"
+#include "fs/Traits.hxx"
 
 #ifdef ANDROID
 #include "fs/StandardDirectory.hxx"
@@ -30,7 +31,9 @@ StateFileConfig::StateFileConfig(const ConfigData &config)
 	:path(config.GetPath(ConfigOption::STATE_FILE)),
 	 interval(config.GetUnsigned(ConfigOption::STATE_FILE_INTERVAL,
 				     DEFAULT_INTERVAL)),
-	 restore_paused(config.GetBool(ConfigOption::RESTORE_PAUSED, false))
+	 restore_paused(config.GetBool(ConfigOption::RESTORE_PAUSED, false)),
+	 queue_metadata(config.GetBool(ConfigOption::STATE_FILE_QUEUE_METADATA,
+				       false))
 {
 #ifdef ANDROID
 	if (path.IsNull()) {
@@ -41,4 +44,9 @@ StateFileConfig::StateFileConfig(const ConfigData &config)
 		path = cache_dir / Path::FromFS("state");
 	}
 #endif
+
+	if (!path.IsNull() &&
+	    config.GetBool(ConfigOption::STATE_FILE_SEPARATE_QUEUE, false))
+		queue_path = AllocatedPath::FromFS(PathTraitsFS::string(path.c_str()) +
+						   PATH_LITERAL(".queue"));
 }
@@ -35,6 +35,20 @@ struct StateFileConfig {
 
 	bool restore_paused;
 
+	/**
+	 * Save the metadata of database songs in the queue, and
+	 * restore them without looking each up in the database
+	 * (which is refreshed later, see StateFile::OnRefresh()).
+	 */
+	bool queue_metadata;
+
+	/**
+	 * If not null, then the queue is saved in this file
+	 * instead of the state file, and it is only rewritten when
+	 * the queue has been modified.
+	 */
+	AllocatedPath queue_path = nullptr;
+
 	explicit StateFileConfig(const ConfigData &config);
 
 	bool IsEnabled() const noexcept {
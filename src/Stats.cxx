@@ -26,6 +26,7 @@
 #include "db/Selection.hxx"
 #include "db/Interface.hxx"
 #include "db/Stats.hxx"
+#include "tag/Pool.hxx"
 #include "Log.hxx"
 #include "time/ChronoUtil.hxx"
 
@@ -88,6 +89,12 @@ stats_update(const Database &db)
 	}
 }
 
+const DatabaseStats *
+stats_get(const Database &db) noexcept
+{
+	return stats_update(db) ? &stats : nullptr;
+}
+
 static void
 db_stats_print(Response &r, const Database &db)
 {
@@ -106,6 +113,10 @@ db_stats_print(Response &r, const Database &db)
 		 stats.song_count,
 		 total_duration_s);
 
+	if (stats.song_memory > 0 && stats.song_count > 0)
+		r.Format("db_song_bytes: %zu\n",
+			 stats.song_memory / stats.song_count);
+
 	const auto update_stamp = db.GetUpdateStamp();
 	if (!IsNegative(update_stamp))
 		r.Format("db_update: %lu\n",
@@ -128,6 +139,12 @@ stats_print(Response &r, const Partition &partition)
 		 (unsigned)std::chrono::duration_cast<std::chrono::seconds>(uptime).count(),
 		 std::lround(partition.pc.GetTotalPlayTime().count()));
 
+	const auto tag_pool = tag_pool_get_stats();
+	r.Format("tag_pool_items: %zu\n"
+		 "tag_pool_buckets: %zu\n"
+		 "tag_pool_max_chain: %zu\n",
+		 tag_pool.items, tag_pool.buckets, tag_pool.max_chain);
+
 #ifdef ENABLE_DATABASE
 	const Database *db = partition.instance.GetDatabase();
 	if (db != nullptr)
@@ -22,6 +22,8 @@
 
 class Response;
 struct Partition;
+class Database;
+struct DatabaseStats;
 
 void
 stats_invalidate();
@@ -29,4 +31,11 @@ stats_invalidate();
 void
 stats_print(Response &r, const Partition &partition);
 
+/**
+ * Returns the (cached) statistics of the given database, or nullptr
+ * on error.
+ */
+const DatabaseStats *
+stats_get(const Database &db) noexcept;
+
 #endif
@@ -20,7 +20,6 @@
 #include "TagAny.hxx"
 #include "TagStream.hxx"
 #include "TagFile.hxx"
-#include "tag/Generic.hxx"
 #include "storage/StorageInterface.hxx"
 #include "client/Client.hxx"
 #include "protocol/Ack.hxx"
@@ -39,10 +38,8 @@ TagScanStream(const char *uri, TagHandler &handler)
 static void
 TagScanFile(const Path path_fs, TagHandler &handler)
 {
-	if (!ScanFileTagsNoGeneric(path_fs, handler))
+	if (!ScanFileTagsWithGeneric(path_fs, handler))
 		throw ProtocolError(ACK_ERROR_NO_EXIST, "Failed to load file");
-
-	ScanGenericTags(path_fs, handler);
 }
 
 static void
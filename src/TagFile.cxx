@@ -65,11 +65,38 @@ public:
 	}
 
 	bool Scan(const DecoderPlugin &plugin) {
-		return plugin.SupportsSuffix(suffix) &&
-			(ScanFile(plugin) || ScanStream(plugin));
+		return ScanFile(plugin) || ScanStream(plugin);
+	}
+
+	/**
+	 * Run the generic scanners (APE and ID3).  Reuses the
+	 * #InputStream opened by ScanStream() instead of opening
+	 * the file again.
+	 */
+	bool ScanGeneric() {
+		if (is == nullptr)
+			is = OpenLocalInputStream(path_fs, mutex);
+
+		/* ScanGenericTags() seeks by itself, no need to
+		   rewind */
+		return ScanGenericTags(*is, handler);
 	}
 };
 
+/**
+ * Invoke all matching decoder plugins.
+ *
+ * @return true if the file was recognized
+ */
+static bool
+ScanFileTagsNoGeneric(TagFileScan &tfs, const char *suffix_utf8)
+{
+	return decoder_plugins_try_suffix(suffix_utf8,
+					  [&](const DecoderPlugin &plugin){
+						  return tfs.Scan(plugin);
+					  });
+}
+
 bool
 ScanFileTagsNoGeneric(Path path_fs, TagHandler &handler)
 {
@@ -84,22 +111,40 @@ ScanFileTagsNoGeneric(Path path_fs, TagHandler &handler)
 	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
 
 	TagFileScan tfs(path_fs, suffix_utf8.c_str(), handler);
-	return decoder_plugins_try([&](const DecoderPlugin &plugin){
-			return tfs.Scan(plugin);
-		});
+	return ScanFileTagsNoGeneric(tfs, suffix_utf8.c_str());
 }
 
 bool
-ScanFileTagsWithGeneric(Path path, TagBuilder &builder,
-			AudioFormat *audio_format)
+ScanFileTagsWithGeneric(Path path_fs, TagHandler &handler,
+			const std::function<bool()> &skip_generic)
 {
-	FullTagHandler h(builder, audio_format);
+	assert(!path_fs.IsNull());
+
+	const auto *suffix = path_fs.GetSuffix();
+	if (suffix == nullptr)
+		return false;
+
+	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
 
-	if (!ScanFileTagsNoGeneric(path, h))
+	TagFileScan tfs(path_fs, suffix_utf8.c_str(), handler);
+	if (!ScanFileTagsNoGeneric(tfs, suffix_utf8.c_str()))
 		return false;
 
-	if (builder.empty())
-		ScanGenericTags(path, h);
+	if (!skip_generic || !skip_generic())
+		tfs.ScanGeneric();
 
 	return true;
 }
+
+bool
+ScanFileTagsWithGeneric(Path path, TagBuilder &builder,
+			AudioFormat *audio_format)
+{
+	FullTagHandler h(builder, audio_format);
+
+	/* skip the generic scanners if the decoder plugin has
+	   already found tags */
+	return ScanFileTagsWithGeneric(path, h, [&builder](){
+			return !builder.empty();
+		});
+}
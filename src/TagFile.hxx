@@ -20,6 +20,8 @@
 #ifndef MPD_TAG_FILE_HXX
 #define MPD_TAG_FILE_HXX
 
+#include <functional>
+
 struct AudioFormat;
 class Path;
 class TagHandler;
@@ -38,6 +40,25 @@ class TagBuilder;
 bool
 ScanFileTagsNoGeneric(Path path, TagHandler &handler);
 
+/**
+ * Scan the tags of a song file.  Invokes matching decoder plugins,
+ * and then the generic scanners (APE and ID3) unless @a
+ * skip_generic returns true.  If the file was not recognized, the
+ * generic scanners are not used at all.
+ *
+ * The file is opened only once: the #InputStream opened for the
+ * decoder plugin's ScanStream() method is reused by the generic
+ * scanners.
+ *
+ * Throws on error.
+ *
+ * @return true if the file was recognized (even if no metadata was
+ * found)
+ */
+bool
+ScanFileTagsWithGeneric(Path path, TagHandler &handler,
+			const std::function<bool()> &skip_generic=nullptr);
+
 /**
  * Scan the tags of a song file.  Invokes matching decoder plugins,
  * and falls back to generic scanners (APE and ID3) if no tags were
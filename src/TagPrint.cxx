@@ -35,14 +35,13 @@ tag_print_types(Response &r) noexcept
 void
 tag_print(Response &r, TagType type, StringView value) noexcept
 {
-	r.Format("%s: %.*s\n", tag_item_names[type],
-		 int(value.size), value.data);
+	r.WriteField(tag_item_names[type], value);
 }
 
 void
 tag_print(Response &r, TagType type, const char *value) noexcept
 {
-	r.Format("%s: %s\n", tag_item_names[type], value);
+	r.WriteField(tag_item_names[type], value);
 }
 
 void
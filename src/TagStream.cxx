@@ -30,18 +30,6 @@
 
 #include <assert.h>
 
-/**
- * Does the #DecoderPlugin support either the suffix or the MIME type?
- */
-gcc_pure
-static bool
-CheckDecoderPlugin(const DecoderPlugin &plugin,
-		   const char *suffix, const char *mime) noexcept
-{
-	return (mime != nullptr && plugin.SupportsMimeType(mime)) ||
-		(suffix != nullptr && plugin.SupportsSuffix(suffix));
-}
-
 bool
 tag_stream_scan(InputStream &is, TagHandler &handler) noexcept
 {
@@ -58,15 +46,14 @@ tag_stream_scan(InputStream &is, TagHandler &handler) noexcept
 	if (mime != nullptr)
 		mime = (mime_base = GetMimeTypeBase(mime)).c_str();
 
-	return decoder_plugins_try([suffix, mime, &is,
-				    &handler](const DecoderPlugin &plugin){
+	return decoder_plugins_try_suffix_or_mime(suffix, mime,
+						  [&is, &handler](const DecoderPlugin &plugin){
 			try {
 				is.LockRewind();
 			} catch (...) {
 			}
 
-			return CheckDecoderPlugin(plugin, suffix, mime) &&
-				plugin.ScanStream(is, handler);
+			return plugin.ScanStream(is, handler);
 		});
 }
 
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ThreadConfig.hxx"
+#include "thread/Scheduling.hxx"
+#include "config/Data.hxx"
+#include "config/Block.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/NumberParser.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <string>
+
+#include <string.h>
+
+/**
+ * Parse a CPU list like "0-3,6".
+ */
+static std::vector<unsigned>
+ParseCpuList(const char *s)
+{
+	std::vector<unsigned> cpus;
+
+	for (const auto i : IterableSplitString(s, ',')) {
+		const std::string item(i.data, i.size);
+
+		char *endptr;
+		const unsigned first = ParseUnsigned(item.c_str(), &endptr);
+		unsigned last = first;
+		if (endptr == item.c_str())
+			throw FormatRuntimeError("Malformed CPU list: \"%s\"", s);
+
+		if (*endptr == '-') {
+			const char *p = endptr + 1;
+			last = ParseUnsigned(p, &endptr);
+			if (endptr == p || last < first)
+				throw FormatRuntimeError("Malformed CPU list: \"%s\"",
+							 s);
+		}
+
+		if (*endptr != 0)
+			throw FormatRuntimeError("Malformed CPU list: \"%s\"", s);
+
+		if (last >= 1024)
+			throw FormatRuntimeError("CPU number too large: %u",
+						 last);
+
+		for (unsigned cpu = first; cpu <= last; ++cpu)
+			cpus.push_back(cpu);
+	}
+
+	return cpus;
+}
+
+static ThreadPolicy
+ParseThreadPolicy(const char *s)
+{
+	if (strcmp(s, "other") == 0)
+		return ThreadPolicy::OTHER;
+	else if (strcmp(s, "batch") == 0)
+		return ThreadPolicy::BATCH;
+	else if (strcmp(s, "idle") == 0)
+		return ThreadPolicy::IDLE;
+	else if (strcmp(s, "fifo") == 0)
+		return ThreadPolicy::FIFO;
+	else if (strcmp(s, "rr") == 0)
+		return ThreadPolicy::RR;
+	else
+		throw FormatRuntimeError("Unrecognized scheduling policy: \"%s\"",
+					 s);
+}
+
+static ThreadScheduling
+LoadThreadScheduling(const ConfigBlock &block)
+{
+	ThreadScheduling s;
+
+	const auto *param = block.GetBlockParam("cpu_affinity");
+	if (param != nullptr)
+		s.cpus = param->With(ParseCpuList);
+
+	param = block.GetBlockParam("policy");
+	if (param != nullptr) {
+		s.policy = param->With(ParseThreadPolicy);
+		s.has_policy = true;
+	}
+
+	param = block.GetBlockParam("priority");
+	if (param != nullptr) {
+		s.priority = param->GetPositiveValue();
+		if (s.priority > 99)
+			throw FormatRuntimeError("Priority in line %i must be 1..99",
+						 param->line);
+	}
+
+	param = block.GetBlockParam("nice");
+	if (param != nullptr) {
+		s.nice = param->GetIntValue();
+		if (s.nice < -20 || s.nice > 19)
+			throw FormatRuntimeError("Nice value in line %i must be -20..19",
+						 param->line);
+		s.has_nice = true;
+	}
+
+	param = block.GetBlockParam("timer_slack");
+	if (param != nullptr)
+		s.timer_slack = std::chrono::microseconds(param->GetUnsignedValue());
+
+	return s;
+}
+
+void
+thread_config_init(const ConfigData &config)
+{
+	for (const auto &block : config.GetBlockList(ConfigBlockOption::THREAD)) {
+		block.SetUsed();
+
+		const char *name = block.GetBlockValue("name");
+		if (name == nullptr)
+			throw FormatRuntimeError("Missing \"name\" in \"thread\" block in line %i",
+						 block.line);
+
+		SetThreadScheduling(name, LoadThreadScheduling(block));
+	}
+}
@@ -22,16 +22,22 @@
   */
 
 #include "Bzip2ArchivePlugin.hxx"
+#include "Bzip2Parallel.hxx"
 #include "../ArchivePlugin.hxx"
 #include "../ArchiveFile.hxx"
 #include "../ArchiveVisitor.hxx"
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
 #include "fs/Path.hxx"
+#include "Log.hxx"
 
 #include <bzlib.h>
 
+#include <algorithm>
+#include <memory>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 class Bzip2ArchiveFile final : public ArchiveFile {
 	std::string name;
@@ -56,10 +62,69 @@ public:
 };
 
 class Bzip2InputStream final : public InputStream {
+	/**
+	 * Record a #Checkpoint at most every this number of
+	 * (uncompressed) bytes.
+	 */
+	static constexpr offset_type CHECKPOINT_INTERVAL = 2 * 1024 * 1024;
+
+	/**
+	 * A position where decompression can be restarted: the
+	 * beginning of a bzip2 stream inside a multi-stream file (as
+	 * written by pbzip2 and lbzip2).
+	 */
+	struct Checkpoint {
+		/**
+		 * The position of the stream within #input.
+		 */
+		offset_type input_offset;
+
+		/**
+		 * The uncompressed offset.
+		 */
+		offset_type offset;
+	};
+
 	std::shared_ptr<InputStream> input;
 
+	/**
+	 * The position within #input after the end of #buffer.
+	 */
+	offset_type input_offset = 0;
+
+	/**
+	 * The position within #input where the current bzip2 stream
+	 * begins.
+	 */
+	offset_type stream_offset = 0;
+
+	/**
+	 * All known stream boundaries, sorted by offset.  This index
+	 * is built while decompressing, and allows Seek() to avoid
+	 * decompressing the file from the beginning.
+	 */
+	std::vector<Checkpoint> checkpoints;
+
 	bool eof = false;
 
+	/**
+	 * Has the end of #input been reached?  Only used by
+	 * DecompressParallel().
+	 */
+	bool input_eof = false;
+
+	/**
+	 * The number of worker threads for #parallel; 0 means
+	 * decompress sequentially.
+	 */
+	unsigned parallel_threads;
+
+	/**
+	 * If not nullptr, then the file is decompressed on worker
+	 * threads, and #bzstream is not used.
+	 */
+	std::unique_ptr<ParallelBzip2Decompressor> parallel;
+
 	bz_stream bzstream;
 
 	char buffer[5000];
@@ -74,10 +139,49 @@ public:
 	bool IsEOF() const noexcept override;
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    void *ptr, size_t size) override;
+	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
 
 private:
 	void Open();
+	void StartParallel() noexcept;
+	void Restart(const Checkpoint &c);
+
+	/**
+	 * Read compressed data from #input at #input_offset.  The
+	 * caller must not hold the mutex.
+	 */
+	size_t ReadInput(void *dest, size_t length);
+
 	bool FillBuffer();
+
+	/**
+	 * Called at the end of a bzip2 stream; checks whether another
+	 * one follows.
+	 *
+	 * @param position the current uncompressed offset
+	 * @return false on end of file
+	 */
+	bool NextStream(offset_type position);
+
+	/**
+	 * Decompress data into the given buffer, without updating
+	 * #offset.  The caller must not hold the mutex.
+	 */
+	size_t Decompress(void *ptr, size_t length);
+
+	size_t DecompressParallel(void *ptr, size_t length);
+
+	/**
+	 * Switch to sequential decompression after
+	 * DecompressParallel() has failed.
+	 */
+	void FallBackToSequential();
+
+	/**
+	 * Decompress and discard data until #offset has reached the
+	 * given value.  The caller must not hold the mutex.
+	 */
+	void Skip(offset_type new_offset);
 };
 
 /* single archive handling allocation helpers */
@@ -95,8 +199,41 @@ Bzip2InputStream::Open()
 	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
 	if (ret != BZ_OK)
 		throw std::runtime_error("BZ2_bzDecompressInit() has failed");
+}
 
-	SetReady();
+void
+Bzip2InputStream::StartParallel() noexcept
+{
+	if (parallel_threads == 0)
+		return;
+
+	try {
+		parallel = std::make_unique<ParallelBzip2Decompressor>(parallel_threads);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to start bzip2 decompression threads");
+		parallel_threads = 0;
+	}
+}
+
+void
+Bzip2InputStream::Restart(const Checkpoint &c)
+{
+	BZ2_bzDecompressEnd(&bzstream);
+
+	input_offset = stream_offset = c.input_offset;
+	offset = c.offset;
+	eof = false;
+
+	Open();
+
+	parallel.reset();
+	input_eof = false;
+
+	/* the parallel decompressor can only start at the beginning
+	   of the file */
+	if (c.input_offset == 0)
+		StartParallel();
 }
 
 /* archive open && listing routine */
@@ -115,9 +252,18 @@ Bzip2InputStream::Bzip2InputStream(const std::shared_ptr<InputStream> &_input,
 				   const char *_uri,
 				   Mutex &_mutex)
 	:InputStream(_uri, _mutex),
-	 input(_input)
+	 input(_input),
+	 /* with only one CPU, sequential decompression is
+	    faster */
+	 parallel_threads(std::thread::hardware_concurrency() > 1
+			  ? std::thread::hardware_concurrency()
+			  : 0)
 {
 	Open();
+	StartParallel();
+
+	seekable = input->IsSeekable();
+	SetReady();
 }
 
 Bzip2InputStream::~Bzip2InputStream()
@@ -132,13 +278,33 @@ Bzip2ArchiveFile::OpenStream(const char *path,
 	return std::make_unique<Bzip2InputStream>(istream, path, mutex);
 }
 
+size_t
+Bzip2InputStream::ReadInput(void *dest, size_t length)
+{
+	size_t count;
+
+	{
+		/* the input stream may be shared with other streams
+		   opened from the same archive */
+		std::unique_lock<Mutex> lock(input->mutex);
+
+		if (input->GetOffset() != input_offset)
+			input->Seek(lock, input_offset);
+
+		count = input->Read(lock, dest, length);
+	}
+
+	input_offset += count;
+	return count;
+}
+
 inline bool
 Bzip2InputStream::FillBuffer()
 {
 	if (bzstream.avail_in > 0)
 		return true;
 
-	size_t count = input->LockRead(buffer, sizeof(buffer));
+	const size_t count = ReadInput(buffer, sizeof(buffer));
 	if (count == 0)
 		return false;
 
@@ -147,27 +313,117 @@ Bzip2InputStream::FillBuffer()
 	return true;
 }
 
+bool
+Bzip2InputStream::NextStream(offset_type position)
+{
+	if (!FillBuffer())
+		return false;
+
+	const Checkpoint c{input_offset - bzstream.avail_in, position};
+	if (c.offset >= (checkpoints.empty()
+			 ? CHECKPOINT_INTERVAL
+			 : checkpoints.back().offset + CHECKPOINT_INTERVAL))
+		checkpoints.push_back(c);
+
+	/* keep the remaining input in the buffer */
+	char *const next_in = bzstream.next_in;
+	const unsigned avail_in = bzstream.avail_in;
+
+	BZ2_bzDecompressEnd(&bzstream);
+	Open();
+
+	bzstream.next_in = next_in;
+	bzstream.avail_in = avail_in;
+	stream_offset = c.input_offset;
+	return true;
+}
+
 size_t
-Bzip2InputStream::Read(std::unique_lock<Mutex> &, void *ptr, size_t length)
+Bzip2InputStream::DecompressParallel(void *ptr, size_t length)
 {
-	const ScopeUnlock unlock(mutex);
+	assert(parallel != nullptr);
+
+	while (true) {
+		if (parallel->IsReadable()) {
+			size_t nbytes = parallel->Read(ptr, length);
+			if (nbytes > 0)
+				return nbytes;
+
+			continue;
+		}
+
+		if (!input_eof && parallel->WantInput()) {
+			const size_t count = ReadInput(buffer, sizeof(buffer));
+			if (count > 0)
+				parallel->Feed(buffer, count);
+			else {
+				input_eof = true;
+				parallel->End();
+			}
+		} else if (parallel->IsEmpty()) {
+			eof = true;
+			return 0;
+		} else
+			parallel->WaitReadable();
+	}
+}
 
-	int bz_result;
-	size_t nbytes = 0;
+void
+Bzip2InputStream::FallBackToSequential()
+{
+	const offset_type position = offset;
 
+	parallel_threads = 0;
+	Restart({0, 0});
+	Skip(position);
+}
+
+size_t
+Bzip2InputStream::Decompress(void *ptr, size_t length)
+{
 	if (eof)
 		return 0;
 
+	if (parallel != nullptr) {
+		try {
+			return DecompressParallel(ptr, length);
+		} catch (...) {
+			/* this happens with corrupt files, but also
+			   if the block pattern occurs inside
+			   compressed data by chance */
+			Log(LogLevel::INFO, std::current_exception(),
+			    "Parallel bzip2 decompression failed, decompressing sequentially");
+			FallBackToSequential();
+		}
+
+		if (eof)
+			return 0;
+	}
+
 	bzstream.next_out = (char *)ptr;
 	bzstream.avail_out = length;
 
 	do {
-		if (!FillBuffer())
-			return 0;
+		if (!FillBuffer()) {
+			/* truncated file */
+			eof = true;
+			break;
+		}
 
-		bz_result = BZ2_bzDecompress(&bzstream);
+		int bz_result = BZ2_bzDecompress(&bzstream);
 
 		if (bz_result == BZ_STREAM_END) {
+			if (!NextStream(offset + length - bzstream.avail_out)) {
+				eof = true;
+				break;
+			}
+
+			continue;
+		}
+
+		if (bz_result == BZ_DATA_ERROR_MAGIC && stream_offset > 0) {
+			/* ignore trailing garbage after the last
+			   stream, just like bzip2 does */
 			eof = true;
 			break;
 		}
@@ -176,12 +432,56 @@ Bzip2InputStream::Read(std::unique_lock<Mutex> &, void *ptr, size_t length)
 			throw std::runtime_error("BZ2_bzDecompress() has failed");
 	} while (bzstream.avail_out == length);
 
-	nbytes = length - bzstream.avail_out;
+	return length - bzstream.avail_out;
+}
+
+size_t
+Bzip2InputStream::Read(std::unique_lock<Mutex> &, void *ptr, size_t length)
+{
+	const ScopeUnlock unlock(mutex);
+
+	size_t nbytes = Decompress(ptr, length);
 	offset += nbytes;
 
 	return nbytes;
 }
 
+void
+Bzip2InputStream::Seek(std::unique_lock<Mutex> &, offset_type new_offset)
+{
+	const ScopeUnlock unlock(mutex);
+
+	/* find the last stream boundary before the new offset */
+	auto i = std::upper_bound(checkpoints.begin(), checkpoints.end(),
+				  new_offset,
+				  [](offset_type o, const Checkpoint &c){
+					  return o < c.offset;
+				  });
+	const Checkpoint start = i == checkpoints.begin()
+		? Checkpoint{0, 0}
+		: *std::prev(i);
+
+	if (new_offset < offset || start.offset > offset)
+		Restart(start);
+
+	Skip(new_offset);
+}
+
+void
+Bzip2InputStream::Skip(offset_type new_offset)
+{
+	char discard[8192];
+	while (offset < new_offset) {
+		size_t nbytes = Decompress(discard,
+					   std::min<offset_type>(sizeof(discard),
+								 new_offset - offset));
+		if (nbytes == 0)
+			throw std::runtime_error("Seek beyond end of file");
+
+		offset += nbytes;
+	}
+}
+
 bool
 Bzip2InputStream::IsEOF() const noexcept
 {
@@ -0,0 +1,442 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Bzip2Parallel.hxx"
+#include "thread/Name.hxx"
+#include "util/ScopeExit.hxx"
+#include "Log.hxx"
+
+#include <bzlib.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <assert.h>
+
+/**
+ * The 48 bit pattern which begins each bzip2 block (the BCD
+ * representation of pi).
+ */
+static constexpr uint64_t BLOCK_MAGIC = 0x314159265359;
+
+/**
+ * The 48 bit pattern which ends each bzip2 stream (the BCD
+ * representation of sqrt(pi)).
+ */
+static constexpr uint64_t EOS_MAGIC = 0x177245385090;
+
+static constexpr uint64_t MAGIC_MASK = (uint64_t(1) << 48) - 1;
+
+/**
+ * The magic is followed by the 32 bit CRC of the block (or of the
+ * whole stream).
+ */
+static constexpr size_t BLOCK_HEADER_BITS = 48 + 32;
+
+static constexpr unsigned
+GetBit(const uint8_t *p, size_t bit) noexcept
+{
+	return (p[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+static uint64_t
+GetBits(const uint8_t *p, size_t bit, unsigned n) noexcept
+{
+	uint64_t value = 0;
+	for (unsigned i = 0; i < n; ++i)
+		value = value << 1 | GetBit(p, bit + i);
+	return value;
+}
+
+namespace {
+
+/**
+ * Appends bits (most significant first) to a byte vector.
+ */
+class BitWriter {
+	std::vector<uint8_t> &dest;
+
+	uint64_t pending = 0;
+	unsigned n_pending = 0;
+
+public:
+	explicit BitWriter(std::vector<uint8_t> &_dest) noexcept
+		:dest(_dest) {}
+
+	/**
+	 * @param n the number of bits; must not be more than 48
+	 */
+	void Put(uint64_t value, unsigned n) noexcept {
+		assert(n <= 48);
+
+		pending = pending << n | value;
+		n_pending += n;
+
+		while (n_pending >= 8) {
+			n_pending -= 8;
+			dest.push_back(uint8_t(pending >> n_pending));
+		}
+
+		pending &= (uint64_t(1) << n_pending) - 1;
+	}
+
+	/**
+	 * Pad the last byte with zero bits.
+	 */
+	void Flush() noexcept {
+		if (n_pending > 0)
+			Put(0, 8 - n_pending);
+	}
+};
+
+}
+
+void
+ParallelBzip2Decompressor::Job::Run()
+{
+	if (n_bits < BLOCK_HEADER_BITS)
+		throw std::runtime_error("Truncated bzip2 block");
+
+	/* build a standalone bzip2 stream containing only this
+	   block */
+
+	std::vector<uint8_t> stream;
+	stream.reserve(4 + n_bits / 8 + 12);
+	stream.push_back('B');
+	stream.push_back('Z');
+	stream.push_back('h');
+	stream.push_back(level);
+
+	/* copy the block, shifted to a byte boundary */
+	const uint8_t *const src = input.data();
+	const size_t n_bytes = n_bits / 8;
+	if (shift == 0)
+		stream.insert(stream.end(), src, src + n_bytes);
+	else
+		for (size_t i = 0; i < n_bytes; ++i)
+			stream.push_back(uint8_t(src[i] << shift |
+						 src[i + 1] >> (8 - shift)));
+
+	BitWriter w(stream);
+	const unsigned rest = n_bits % 8;
+	w.Put(GetBits(src, shift + n_bytes * 8, rest), rest);
+
+	/* the stream CRC of a single-block stream equals the block
+	   CRC */
+	w.Put(EOS_MAGIC, 48);
+	w.Put(GetBits(src, shift + 48, 32), 32);
+	w.Flush();
+
+	input = {};
+
+	/* decompress it */
+
+	bz_stream z{};
+	if (BZ2_bzDecompressInit(&z, 0, 0) != BZ_OK)
+		throw std::runtime_error("BZ2_bzDecompressInit() has failed");
+
+	AtScopeExit(&z) { BZ2_bzDecompressEnd(&z); };
+
+	z.next_in = (char *)stream.data();
+	z.avail_in = stream.size();
+
+	/* the level is the maximum block size in units of 100 kB
+	   before the final RLE step, which usually expands the data
+	   only a little bit */
+	output.resize((level - '0') * 100000 + 4096);
+	size_t n = 0;
+
+	while (true) {
+		if (n == output.size())
+			output.resize(output.size() * 2);
+
+		z.next_out = (char *)output.data() + n;
+		z.avail_out = output.size() - n;
+
+		int result = BZ2_bzDecompress(&z);
+		n = output.size() - z.avail_out;
+
+		if (result == BZ_STREAM_END)
+			break;
+
+		if (result != BZ_OK)
+			throw std::runtime_error("BZ2_bzDecompress() has failed");
+
+		if (z.avail_in == 0 && z.avail_out > 0)
+			throw std::runtime_error("Truncated bzip2 block");
+	}
+
+	output.resize(n);
+}
+
+ParallelBzip2Decompressor::ParallelBzip2Decompressor(unsigned n_threads)
+	:max_jobs(2 * n_threads)
+{
+	assert(n_threads > 0);
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		threads.emplace_front(BIND_THIS_METHOD(ThreadFunc));
+
+		try {
+			threads.front().Start();
+		} catch (...) {
+			threads.pop_front();
+
+			if (threads.empty())
+				throw;
+
+			LogError(std::current_exception(),
+				 "Failed to start bzip2 thread");
+			break;
+		}
+	}
+}
+
+ParallelBzip2Decompressor::~ParallelBzip2Decompressor() noexcept
+{
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		quit = true;
+		work_cond.notify_all();
+	}
+
+	for (auto &thread : threads)
+		thread.Join();
+}
+
+bool
+ParallelBzip2Decompressor::WantInput() const noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	return jobs.size() < max_jobs;
+}
+
+void
+ParallelBzip2Decompressor::TrimData(uint64_t keep_from_bit) noexcept
+{
+	const uint64_t keep_from = keep_from_bit / 8;
+	if (keep_from <= data_offset)
+		return;
+
+	const size_t n = std::min<uint64_t>(keep_from - data_offset,
+					    data.size());
+	data.erase(data.begin(), std::next(data.begin(), n));
+	data_offset = keep_from;
+}
+
+void
+ParallelBzip2Decompressor::Submit(uint64_t end)
+{
+	assert(in_block);
+	assert(end > block_start);
+
+	const size_t first = block_start / 8 - data_offset;
+	const size_t last = (end + 7) / 8 - data_offset;
+	assert(last <= data.size());
+
+	std::vector<uint8_t> input(std::next(data.begin(), first),
+				   std::next(data.begin(), last));
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		jobs.emplace_back(std::move(input), unsigned(block_start % 8),
+				  size_t(end - block_start), level);
+		work_cond.notify_one();
+	}
+
+	in_block = false;
+	TrimData(end);
+}
+
+inline void
+ParallelBzip2Decompressor::ScanByte(uint8_t b)
+{
+	switch (scan_state) {
+	case ScanState::HEADER:
+		if (input_position < header_position)
+			/* the stream CRC and padding */
+			return;
+
+		header[header_fill++] = b;
+		if (header_fill < sizeof(header))
+			return;
+
+		header_fill = 0;
+
+		if (header[0] == 'B' && header[1] == 'Z' && header[2] == 'h' &&
+		    header[3] >= '1' && header[3] <= '9') {
+			level = header[3];
+			scan_state = ScanState::BLOCKS;
+			search_from = (input_position + 1) * 8;
+		} else if (n_streams > 0)
+			/* ignore trailing garbage after the last
+			   stream, just like bzip2 does */
+			scan_state = ScanState::TRAILER;
+		else
+			throw std::runtime_error("Not a bzip2 file");
+
+		return;
+
+	case ScanState::BLOCKS:
+		break;
+
+	case ScanState::TRAILER:
+		return;
+	}
+
+	register_bits = register_bits << 8 | b;
+
+	/* check all bit positions where a pattern can end within
+	   this byte, in file order */
+	const uint64_t end_bit = (input_position + 1) * 8;
+	for (int k = 7; k >= 0; --k) {
+		const uint64_t value = (register_bits >> k) & MAGIC_MASK;
+		if (value != BLOCK_MAGIC && value != EOS_MAGIC)
+			continue;
+
+		if (end_bit < uint64_t(k) + 48)
+			continue;
+
+		const uint64_t start = end_bit - k - 48;
+		if (start < search_from)
+			continue;
+
+		if (in_block)
+			Submit(start);
+
+		if (value == BLOCK_MAGIC) {
+			in_block = true;
+			block_start = start;
+			search_from = start + 48;
+		} else {
+			/* the next stream (if any) begins at the byte
+			   boundary after the stream CRC */
+			scan_state = ScanState::HEADER;
+			header_position = (start + BLOCK_HEADER_BITS + 7) / 8;
+			++n_streams;
+			break;
+		}
+	}
+}
+
+void
+ParallelBzip2Decompressor::Feed(const void *_src, size_t size)
+{
+	const auto *src = (const uint8_t *)_src;
+
+	data.insert(data.end(), src, src + size);
+
+	for (size_t i = 0; i < size; ++i, ++input_position)
+		ScanByte(src[i]);
+
+	if (!in_block)
+		TrimData(input_position * 8);
+}
+
+void
+ParallelBzip2Decompressor::End() noexcept
+{
+	if (in_block)
+		/* truncated file; this block will fail */
+		Submit(input_position * 8);
+}
+
+bool
+ParallelBzip2Decompressor::IsEmpty() const noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	return jobs.empty();
+}
+
+bool
+ParallelBzip2Decompressor::IsReadable() const noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	return !jobs.empty() && jobs.front().state == Job::State::DONE;
+}
+
+void
+ParallelBzip2Decompressor::WaitReadable() noexcept
+{
+	std::unique_lock<Mutex> lock(mutex);
+	assert(!jobs.empty());
+
+	done_cond.wait(lock, [this]{
+		return jobs.front().state == Job::State::DONE;
+	});
+}
+
+size_t
+ParallelBzip2Decompressor::Read(void *dest, size_t size)
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	assert(!jobs.empty());
+
+	auto &job = jobs.front();
+	assert(job.state == Job::State::DONE);
+
+	if (job.error)
+		std::rethrow_exception(job.error);
+
+	const size_t n = std::min(size, job.output.size() - job.consumed);
+	std::copy_n(job.output.data() + job.consumed, n, (uint8_t *)dest);
+	job.consumed += n;
+
+	if (job.consumed == job.output.size())
+		jobs.pop_front();
+
+	return n;
+}
+
+void
+ParallelBzip2Decompressor::ThreadFunc() noexcept
+{
+	SetThreadName("bzip2");
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (!quit) {
+		auto i = std::find_if(jobs.begin(), jobs.end(),
+				      [](const Job &job){
+					      return job.state == Job::State::QUEUED;
+				      });
+		if (i == jobs.end()) {
+			work_cond.wait(lock);
+			continue;
+		}
+
+		/* the reading thread removes only finished jobs, so
+		   this job stays valid while the mutex is
+		   unlocked */
+		i->state = Job::State::RUNNING;
+
+		{
+			const ScopeUnlock unlock(mutex);
+
+			try {
+				i->Run();
+			} catch (...) {
+				i->error = std::current_exception();
+			}
+		}
+
+		i->state = Job::State::DONE;
+		done_cond.notify_one();
+	}
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ARCHIVE_BZ2_PARALLEL_HXX
+#define MPD_ARCHIVE_BZ2_PARALLEL_HXX
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <cstdint>
+#include <exception>
+#include <forward_list>
+#include <list>
+#include <vector>
+
+#include <stddef.h>
+
+/**
+ * Decompresses a bzip2 file on several worker threads, like lbzip2
+ * and pbzip2 do.
+ *
+ * The compressed data is scanned for the bit patterns which start
+ * each block (and end each stream).  Each block is shifted to a byte
+ * boundary and wrapped in a stream header and trailer, which makes it
+ * a standalone single-block bzip2 stream that libbz2 can decompress
+ * independently.  The decompressed blocks are returned in order.
+ *
+ * The compressed data is fed by the (one) reading thread, which must
+ * not be one of the worker threads.  Errors (e.g. a corrupt block, or
+ * an accidental match of the block pattern inside compressed data)
+ * are reported by Read(); the caller may then fall back to
+ * decompressing the file sequentially.
+ */
+class ParallelBzip2Decompressor {
+	/**
+	 * One bzip2 block.
+	 */
+	struct Job {
+		/**
+		 * The compressed bytes containing the block.
+		 */
+		std::vector<uint8_t> input;
+
+		/**
+		 * The number of leading bits in #input which do not
+		 * belong to the block.
+		 */
+		unsigned shift;
+
+		/**
+		 * The size of the block in bits, including its
+		 * block header.
+		 */
+		size_t n_bits;
+
+		/**
+		 * The block size digit from the stream header ('1' to
+		 * '9').
+		 */
+		uint8_t level;
+
+		enum class State : uint8_t {
+			QUEUED,
+			RUNNING,
+			DONE,
+		} state = State::QUEUED;
+
+		std::vector<uint8_t> output;
+
+		/**
+		 * The number of bytes of #output which have already
+		 * been returned by Read().
+		 */
+		size_t consumed = 0;
+
+		std::exception_ptr error;
+
+		Job(std::vector<uint8_t> &&_input, unsigned _shift,
+		    size_t _n_bits, uint8_t _level) noexcept
+			:input(std::move(_input)), shift(_shift),
+			 n_bits(_n_bits), level(_level) {}
+
+		/**
+		 * Decompress the block into #output.
+		 *
+		 * Throws on error.
+		 */
+		void Run();
+	};
+
+	const size_t max_jobs;
+
+	mutable Mutex mutex;
+
+	/**
+	 * Wakes up the worker threads when a new job was submitted
+	 * or when they shall quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Wakes up the reading thread when a job has finished.
+	 */
+	Cond done_cond;
+
+	/**
+	 * All jobs in the order of their blocks.  Protected by
+	 * #mutex; only the reading thread adds and removes items.
+	 */
+	std::list<Job> jobs;
+
+	std::forward_list<Thread> threads;
+
+	bool quit = false;
+
+	/* the scanner state; only accessed by the reading thread */
+
+	enum class ScanState : uint8_t {
+		/**
+		 * Parsing the four byte stream header.
+		 */
+		HEADER,
+
+		/**
+		 * Searching for the next block or end-of-stream
+		 * pattern.
+		 */
+		BLOCKS,
+
+		/**
+		 * Ignoring trailing garbage after the last stream.
+		 */
+		TRAILER,
+	} scan_state = ScanState::HEADER;
+
+	uint8_t header[4];
+	unsigned header_fill = 0;
+
+	uint8_t level = 0;
+
+	/**
+	 * The number of streams which have been finished.
+	 */
+	unsigned n_streams = 0;
+
+	/**
+	 * The compressed bytes which have not yet been submitted as
+	 * a job; #data[0] is the byte at offset #data_offset within
+	 * the file.
+	 */
+	std::vector<uint8_t> data;
+	uint64_t data_offset = 0;
+
+	/**
+	 * The file offset of the next byte passed to Feed().
+	 */
+	uint64_t input_position = 0;
+
+	/**
+	 * In #ScanState::HEADER: the file offset of the next stream
+	 * header.
+	 */
+	uint64_t header_position = 0;
+
+	/**
+	 * The last 64 bits which have been scanned.
+	 */
+	uint64_t register_bits = 0;
+
+	/**
+	 * Matches which begin before this bit position (within the
+	 * file) are ignored.
+	 */
+	uint64_t search_from = 0;
+
+	/**
+	 * The bit position where the current block begins (only
+	 * valid if #in_block is set).
+	 */
+	uint64_t block_start;
+
+	bool in_block = false;
+
+public:
+	/**
+	 * Throws if no worker thread could be started.
+	 */
+	explicit ParallelBzip2Decompressor(unsigned n_threads);
+
+	~ParallelBzip2Decompressor() noexcept;
+
+	ParallelBzip2Decompressor(const ParallelBzip2Decompressor &) = delete;
+	ParallelBzip2Decompressor &operator=(const ParallelBzip2Decompressor &) = delete;
+
+	/**
+	 * Shall the caller pass more compressed data to Feed()?  This
+	 * returns false while enough blocks are pending.
+	 */
+	bool WantInput() const noexcept;
+
+	/**
+	 * Pass compressed data (in file order).
+	 *
+	 * Throws if the data does not look like bzip2.
+	 */
+	void Feed(const void *src, size_t size);
+
+	/**
+	 * The end of the compressed file has been reached; submit the
+	 * last (possibly truncated) block.
+	 */
+	void End() noexcept;
+
+	/**
+	 * Have all submitted blocks been returned by Read()?
+	 */
+	bool IsEmpty() const noexcept;
+
+	/**
+	 * Can Read() return data (or an error) without blocking?
+	 */
+	bool IsReadable() const noexcept;
+
+	/**
+	 * Wait until IsReadable() returns true.  Must not be called
+	 * if IsEmpty() returns true.
+	 */
+	void WaitReadable() noexcept;
+
+	/**
+	 * Copy decompressed data from the first block.  Must not be
+	 * called if IsReadable() returns false.
+	 *
+	 * Throws if the block could not be decompressed.
+	 *
+	 * @return the number of bytes copied (non-zero)
+	 */
+	size_t Read(void *dest, size_t size);
+
+private:
+	void ScanByte(uint8_t b);
+
+	/**
+	 * Submit the current block, which ends at the given bit
+	 * position.
+	 */
+	void Submit(uint64_t end);
+
+	/**
+	 * Drop the bytes of #data which are not needed anymore.
+	 */
+	void TrimData(uint64_t keep_from_bit) noexcept;
+
+	void ThreadFunc() noexcept;
+};
+
+#endif
@@ -31,6 +31,9 @@
 
 #include <cdio/iso9660.h>
 
+#include <map>
+#include <string>
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -58,9 +61,24 @@ struct Iso9660 {
 	}
 };
 
+/**
+ * The location of a file inside the ISO9660 image.
+ */
+struct Iso9660Entry {
+	lsn_t lsn;
+	InputStream::offset_type size;
+};
+
 class Iso9660ArchiveFile final : public ArchiveFile {
 	std::shared_ptr<Iso9660> iso;
 
+	/**
+	 * All files seen by Visit(), indexed by their path (without
+	 * the leading slash).  This avoids walking the directory
+	 * records again in OpenStream().
+	 */
+	std::map<std::string, Iso9660Entry> toc;
+
 public:
 	Iso9660ArchiveFile(std::shared_ptr<Iso9660> &&_iso)
 		:iso(std::move(_iso)) {}
@@ -109,6 +127,8 @@ Iso9660ArchiveFile::Visit(char *path, size_t length, size_t capacity,
 			Visit(path, new_length + 1, capacity, visitor);
 		} else {
 			//remove leading /
+			toc.emplace(path + 1,
+				    Iso9660Entry{statbuf->lsn, statbuf->size});
 			visitor.VisitArchiveEntry(path + 1);
 		}
 	}
@@ -138,24 +158,20 @@ Iso9660ArchiveFile::Visit(ArchiveVisitor &visitor)
 class Iso9660InputStream final : public InputStream {
 	std::shared_ptr<Iso9660> iso;
 
-	iso9660_stat_t *statbuf;
+	const lsn_t lsn;
 
 public:
 	Iso9660InputStream(const std::shared_ptr<Iso9660> &_iso,
 			   const char *_uri,
 			   Mutex &_mutex,
-			   iso9660_stat_t *_statbuf)
+			   const Iso9660Entry &entry)
 		:InputStream(_uri, _mutex),
-		 iso(_iso), statbuf(_statbuf) {
-		size = statbuf->size;
+		 iso(_iso), lsn(entry.lsn) {
+		size = entry.size;
 		seekable = true;
 		SetReady();
 	}
 
-	~Iso9660InputStream() {
-		free(statbuf);
-	}
-
 	/* virtual methods from InputStream */
 	bool IsEOF() const noexcept override;
 	size_t Read(std::unique_lock<Mutex> &lock,
@@ -170,13 +186,20 @@ InputStreamPtr
 Iso9660ArchiveFile::OpenStream(const char *pathname,
 			       Mutex &mutex)
 {
-	auto statbuf = iso9660_ifs_stat_translate(iso->iso, pathname);
-	if (statbuf == nullptr)
-		throw FormatRuntimeError("not found in the ISO file: %s",
-					 pathname);
+	auto i = toc.find(pathname);
+	if (i == toc.end()) {
+		auto statbuf = iso9660_ifs_stat_translate(iso->iso, pathname);
+		if (statbuf == nullptr)
+			throw FormatRuntimeError("not found in the ISO file: %s",
+						 pathname);
+
+		i = toc.emplace(pathname,
+				Iso9660Entry{statbuf->lsn, statbuf->size}).first;
+		free(statbuf);
+	}
 
 	return std::make_unique<Iso9660InputStream>(iso, pathname, mutex,
-						    statbuf);
+						    i->second);
 }
 
 size_t
@@ -187,7 +210,7 @@ Iso9660InputStream::Read(std::unique_lock<Mutex> &,
 
 	int readed = 0;
 	int no_blocks, cur_block;
-	size_t left_bytes = statbuf->size - offset;
+	size_t left_bytes = size - offset;
 
 	if (left_bytes < read_size) {
 		no_blocks = CEILING(left_bytes, ISO_BLOCKSIZE);
@@ -200,7 +223,7 @@ Iso9660InputStream::Read(std::unique_lock<Mutex> &,
 
 	cur_block = offset / ISO_BLOCKSIZE;
 
-	readed = iso->SeekRead(ptr, statbuf->lsn + cur_block, no_blocks);
+	readed = iso->SeekRead(ptr, lsn + cur_block, no_blocks);
 
 	if (readed != no_blocks * ISO_BLOCKSIZE)
 		throw FormatRuntimeError("error reading ISO file at lsn %lu",
@@ -21,6 +21,7 @@
   * zip archive handling (requires zziplib)
   */
 
+#include "config.h"
 #include "ZzipArchivePlugin.hxx"
 #include "../ArchivePlugin.hxx"
 #include "../ArchiveFile.hxx"
@@ -29,6 +30,20 @@
 #include "fs/Path.hxx"
 #include "util/RuntimeError.hxx"
 
+#ifdef ENABLE_ZLIB
+#include "input/LocalOpen.hxx"
+#include "lib/zlib/Error.hxx"
+#include "util/AllocatedArray.hxx"
+#include "Log.hxx"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#endif
+
 #include <zzip/zzip.h>
 
 struct ZzipDir {
@@ -49,25 +64,195 @@ struct ZzipDir {
 	ZzipDir &operator=(const ZzipDir &) = delete;
 };
 
+#ifdef ENABLE_ZLIB
+
+/**
+ * A deflated file inside the ZIP file, as described by its central
+ * directory.  These are inflated with zlib instead of zziplib,
+ * because zziplib's zzip_seek() needs to inflate from the beginning
+ * of the file for each backwards seek.
+ */
+struct ZipDeflatedEntry {
+	/**
+	 * The position of the local file header within the ZIP file.
+	 */
+	InputStream::offset_type header_offset;
+
+	InputStream::offset_type compressed_size, size;
+
+	/**
+	 * The position of the compressed data within the ZIP file;
+	 * zero if the local file header has not been parsed yet.
+	 */
+	InputStream::offset_type data_offset = 0;
+};
+
+static constexpr uint16_t
+LoadLE16(const uint8_t *p) noexcept
+{
+	return p[0] | (p[1] << 8);
+}
+
+static constexpr uint32_t
+LoadLE32(const uint8_t *p) noexcept
+{
+	return LoadLE16(p) | (uint32_t(LoadLE16(p + 2)) << 16);
+}
+
+/**
+ * Load the central directory of a ZIP file and collect the entries
+ * which can be inflated with zlib.  Throws on I/O error; an empty map
+ * is returned if the file is not understood (e.g. ZIP64).
+ */
+static std::map<std::string, ZipDeflatedEntry>
+LoadZipDirectory(InputStream &is)
+{
+	std::map<std::string, ZipDeflatedEntry> result;
+
+	if (!is.KnownSize())
+		return result;
+
+	std::unique_lock<Mutex> lock(is.mutex);
+
+	/* the "end of central directory" record is 22 bytes long
+	   plus a comment of up to 64 kB */
+	const auto file_size = is.GetSize();
+	const size_t tail_size = std::min<InputStream::offset_type>(file_size,
+								    22 + 65535);
+	AllocatedArray<uint8_t> tail(tail_size);
+	is.Seek(lock, file_size - tail_size);
+	is.ReadFull(lock, tail.begin(), tail_size);
+
+	const uint8_t *eocd = nullptr;
+	for (size_t i = tail_size; i >= 22; --i) {
+		const uint8_t *p = tail.begin() + i - 22;
+		if (LoadLE32(p) == 0x06054b50) {
+			eocd = p;
+			break;
+		}
+	}
+
+	if (eocd == nullptr)
+		return result;
+
+	const unsigned n_entries = LoadLE16(eocd + 10);
+	const uint32_t directory_size = LoadLE32(eocd + 12);
+	const uint32_t directory_offset = LoadLE32(eocd + 16);
+	if (n_entries == 0xffff || directory_offset == 0xffffffff ||
+	    InputStream::offset_type(directory_offset) + directory_size > file_size)
+		/* ZIP64 or broken */
+		return result;
+
+	AllocatedArray<uint8_t> directory(directory_size);
+	is.Seek(lock, directory_offset);
+	is.ReadFull(lock, directory.begin(), directory_size);
+
+	const uint8_t *p = directory.begin(), *const end = directory.end();
+	for (unsigned i = 0; i < n_entries; ++i) {
+		if (end - p < 46 || LoadLE32(p) != 0x02014b50)
+			break;
+
+		const unsigned flags = LoadLE16(p + 8);
+		const unsigned method = LoadLE16(p + 10);
+		const uint32_t compressed_size = LoadLE32(p + 20);
+		const uint32_t size = LoadLE32(p + 24);
+		const size_t name_length = LoadLE16(p + 28);
+		const size_t extra_length = LoadLE16(p + 30);
+		const size_t comment_length = LoadLE16(p + 32);
+		const uint32_t header_offset = LoadLE32(p + 42);
+
+		const uint8_t *const name = p + 46;
+		const size_t entry_size = 46 + name_length + extra_length +
+			comment_length;
+		if (size_t(end - p) < entry_size)
+			break;
+
+		p += entry_size;
+
+		/* only deflated files which are not encrypted and
+		   have no ZIP64 extension */
+		if (method != Z_DEFLATED || (flags & 0x1) != 0 ||
+		    compressed_size == 0xffffffff || size == 0xffffffff ||
+		    header_offset == 0xffffffff)
+			continue;
+
+		ZipDeflatedEntry entry;
+		entry.header_offset = header_offset;
+		entry.compressed_size = compressed_size;
+		entry.size = size;
+		result.emplace(std::string((const char *)name, name_length),
+			       entry);
+	}
+
+	return result;
+}
+
+#endif
+
 class ZzipArchiveFile final : public ArchiveFile {
 	std::shared_ptr<ZzipDir> dir;
 
+#ifdef ENABLE_ZLIB
+	/**
+	 * The ZIP file, used for reading deflated files with zlib.
+	 */
+	std::shared_ptr<InputStream> istream;
+
+	/**
+	 * The deflated files, indexed by their path.
+	 */
+	std::map<std::string, ZipDeflatedEntry> deflated;
+#endif
+
 public:
 	ZzipArchiveFile(std::shared_ptr<ZzipDir> &&_dir)
 		:dir(std::move(_dir)) {}
 
+#ifdef ENABLE_ZLIB
+	void LoadDirectory(Path path) noexcept;
+#endif
+
 	virtual void Visit(ArchiveVisitor &visitor) override;
 
 	InputStreamPtr OpenStream(const char *path,
 				  Mutex &mutex) override;
+
+private:
+#ifdef ENABLE_ZLIB
+	InputStreamPtr OpenDeflated(ZipDeflatedEntry &entry, const char *path,
+				    Mutex &mutex);
+#endif
 };
 
 /* archive open && listing routine */
 
+#ifdef ENABLE_ZLIB
+
+inline void
+ZzipArchiveFile::LoadDirectory(Path path) noexcept
+{
+	static Mutex mutex;
+
+	try {
+		istream = OpenLocalInputStream(path, mutex);
+		deflated = LoadZipDirectory(*istream);
+	} catch (...) {
+		/* fall back to zziplib */
+		LogError(std::current_exception());
+		deflated.clear();
+	}
+}
+
+#endif
+
 static std::unique_ptr<ArchiveFile>
 zzip_archive_open(Path pathname)
 {
-	return std::make_unique<ZzipArchiveFile>(std::make_shared<ZzipDir>(pathname));
+	auto file = std::make_unique<ZzipArchiveFile>(std::make_shared<ZzipDir>(pathname));
+#ifdef ENABLE_ZLIB
+	file->LoadDirectory(pathname);
+#endif
+	return file;
 }
 
 inline void
@@ -116,10 +301,308 @@ public:
 	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
 };
 
+#ifdef ENABLE_ZLIB
+
+/**
+ * Inflates a file inside the ZIP file with zlib.  While inflating, it
+ * takes snapshots of the decompressor state (with inflateCopy()),
+ * which allows seeking without inflating from the beginning of the
+ * file.
+ */
+class ZipDeflateInputStream final : public InputStream {
+	/**
+	 * Take a snapshot at most every this number of (uncompressed)
+	 * bytes.  Each snapshot costs roughly 40 kB of memory (mostly
+	 * the 32 kB deflate window).
+	 */
+	static constexpr offset_type CHECKPOINT_INTERVAL = 2 * 1024 * 1024;
+
+	struct Checkpoint {
+		z_stream z;
+
+		/**
+		 * The compressed position relative to the beginning
+		 * of the file data.
+		 */
+		offset_type input_offset;
+
+		/**
+		 * The uncompressed offset.
+		 */
+		offset_type offset;
+
+		Checkpoint(z_stream &src,
+			   offset_type _input_offset, offset_type _offset)
+			:input_offset(_input_offset), offset(_offset) {
+			int result = inflateCopy(&z, &src);
+			if (result != Z_OK)
+				throw ZlibError(result);
+		}
+
+		~Checkpoint() noexcept {
+			inflateEnd(&z);
+		}
+
+		Checkpoint(const Checkpoint &) = delete;
+		Checkpoint &operator=(const Checkpoint &) = delete;
+	};
+
+	const std::shared_ptr<InputStream> input;
+
+	const offset_type data_offset, compressed_size;
+
+	/**
+	 * The compressed position (relative to #data_offset) after
+	 * the end of #buffer.
+	 */
+	offset_type input_offset = 0;
+
+	/**
+	 * Sorted by offset.  This is a std::deque because the
+	 * #z_stream objects must not be moved.
+	 */
+	std::deque<Checkpoint> checkpoints;
+
+	z_stream z;
+
+	bool eof = false;
+
+	Bytef buffer[16384];
+
+public:
+	ZipDeflateInputStream(const std::shared_ptr<InputStream> &_input,
+			      const char *_uri, Mutex &_mutex,
+			      const ZipDeflatedEntry &entry)
+		:InputStream(_uri, _mutex),
+		 input(_input),
+		 data_offset(entry.data_offset),
+		 compressed_size(entry.compressed_size) {
+		z.zalloc = Z_NULL;
+		z.zfree = Z_NULL;
+		z.opaque = Z_NULL;
+		z.next_in = buffer;
+		z.avail_in = 0;
+
+		/* raw deflate without zlib header */
+		int result = inflateInit2(&z, -MAX_WBITS);
+		if (result != Z_OK)
+			throw ZlibError(result);
+
+		size = entry.size;
+		seekable = true;
+		SetReady();
+	}
+
+	~ZipDeflateInputStream() noexcept {
+		inflateEnd(&z);
+	}
+
+	/* virtual methods from InputStream */
+	bool IsEOF() const noexcept override {
+		return eof || offset == size;
+	}
+
+	size_t Read(std::unique_lock<Mutex> &lock,
+		    void *ptr, size_t size) override;
+	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
+
+private:
+	bool FillBuffer();
+	void Restart();
+	void Restore(Checkpoint &c);
+
+	/**
+	 * Inflate data into the given buffer, without updating
+	 * #offset.  The caller must not hold the mutex.
+	 */
+	size_t Inflate(void *ptr, size_t length);
+};
+
+bool
+ZipDeflateInputStream::FillBuffer()
+{
+	if (z.avail_in > 0)
+		return true;
+
+	const offset_type remaining = compressed_size - input_offset;
+	if (remaining == 0)
+		return false;
+
+	size_t nbytes;
+
+	{
+		/* the ZIP file stream is shared with other streams
+		   opened from the same archive */
+		std::unique_lock<Mutex> lock(input->mutex);
+
+		const offset_type position = data_offset + input_offset;
+		if (input->GetOffset() != position)
+			input->Seek(lock, position);
+
+		nbytes = input->Read(lock, buffer,
+				     std::min<offset_type>(sizeof(buffer),
+							   remaining));
+	}
+
+	if (nbytes == 0)
+		return false;
+
+	input_offset += nbytes;
+
+	z.next_in = buffer;
+	z.avail_in = nbytes;
+	return true;
+}
+
+void
+ZipDeflateInputStream::Restart()
+{
+	int result = inflateReset(&z);
+	if (result != Z_OK)
+		throw ZlibError(result);
+
+	z.next_in = buffer;
+	z.avail_in = 0;
+	input_offset = 0;
+	offset = 0;
+	eof = false;
+}
+
+void
+ZipDeflateInputStream::Restore(Checkpoint &c)
+{
+	inflateEnd(&z);
+
+	/* if this fails, the z_stream is left without state, and the
+	   next inflate() call will fail */
+	int result = inflateCopy(&z, &c.z);
+	if (result != Z_OK)
+		throw ZlibError(result);
+
+	z.next_in = buffer;
+	z.avail_in = 0;
+	input_offset = c.input_offset;
+	offset = c.offset;
+	eof = false;
+}
+
+size_t
+ZipDeflateInputStream::Inflate(void *ptr, size_t length)
+{
+	if (eof)
+		return 0;
+
+	if (offset >= (checkpoints.empty()
+		       ? CHECKPOINT_INTERVAL
+		       : checkpoints.back().offset + CHECKPOINT_INTERVAL))
+		checkpoints.emplace_back(z, input_offset - z.avail_in, offset);
+
+	z.next_out = (Bytef *)ptr;
+	z.avail_out = length;
+
+	do {
+		if (!FillBuffer())
+			throw std::runtime_error("Truncated ZIP file");
+
+		int result = inflate(&z, Z_NO_FLUSH);
+		if (result == Z_STREAM_END) {
+			eof = true;
+			break;
+		}
+
+		if (result != Z_OK)
+			throw ZlibError(result);
+	} while (z.avail_out == length);
+
+	return length - z.avail_out;
+}
+
+size_t
+ZipDeflateInputStream::Read(std::unique_lock<Mutex> &,
+			    void *ptr, size_t read_size)
+{
+	const ScopeUnlock unlock(mutex);
+
+	size_t nbytes = Inflate(ptr, read_size);
+	offset += nbytes;
+	return nbytes;
+}
+
+void
+ZipDeflateInputStream::Seek(std::unique_lock<Mutex> &, offset_type new_offset)
+{
+	const ScopeUnlock unlock(mutex);
+
+	/* find the last snapshot before the new offset */
+	auto i = std::upper_bound(checkpoints.begin(), checkpoints.end(),
+				  new_offset,
+				  [](offset_type o, const Checkpoint &c){
+					  return o < c.offset;
+				  });
+	Checkpoint *start = i == checkpoints.begin()
+		? nullptr
+		: &*std::prev(i);
+
+	if (new_offset < offset ||
+	    (start != nullptr && start->offset > offset)) {
+		if (start != nullptr)
+			Restore(*start);
+		else
+			Restart();
+	}
+
+	/* inflate and discard data until the new offset is
+	   reached */
+	Bytef discard[8192];
+	while (offset < new_offset) {
+		size_t nbytes = Inflate(discard,
+					std::min<offset_type>(sizeof(discard),
+							      new_offset - offset));
+		if (nbytes == 0)
+			throw std::runtime_error("Seek beyond end of file");
+
+		offset += nbytes;
+	}
+}
+
+inline InputStreamPtr
+ZzipArchiveFile::OpenDeflated(ZipDeflatedEntry &entry, const char *pathname,
+			      Mutex &mutex)
+{
+	if (entry.data_offset == 0) {
+		/* parse the local file header to find the data */
+		uint8_t header[30];
+
+		{
+			std::unique_lock<Mutex> lock(istream->mutex);
+			istream->Seek(lock, entry.header_offset);
+			istream->ReadFull(lock, header, sizeof(header));
+		}
+
+		if (LoadLE32(header) != 0x04034b50)
+			throw FormatRuntimeError("Malformed ZIP file entry: %s",
+						 pathname);
+
+		entry.data_offset = entry.header_offset + sizeof(header) +
+			LoadLE16(header + 26) + LoadLE16(header + 28);
+	}
+
+	return std::make_unique<ZipDeflateInputStream>(istream, pathname,
+						       mutex, entry);
+}
+
+#endif
+
 InputStreamPtr
 ZzipArchiveFile::OpenStream(const char *pathname,
 			    Mutex &mutex)
 {
+#ifdef ENABLE_ZLIB
+	auto i = deflated.find(pathname);
+	if (i != deflated.end())
+		return OpenDeflated(i->second, pathname, mutex);
+#endif
+
 	ZZIP_FILE *_file = zzip_file_open(dir->dir, pathname, 0);
 	if (_file == nullptr)
 		throw FormatRuntimeError("not found in the ZIP file: %s",
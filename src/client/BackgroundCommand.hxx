@@ -42,6 +42,14 @@ public:
 	 * #Client's #EventLoop thread.
 	 */
 	virtual void Cancel() noexcept = 0;
+
+	/**
+	 * The client's output buffer has become empty.  Commands
+	 * which produce their response incrementally can use this to
+	 * write more data.  It will be called from the #Client's
+	 * #EventLoop thread.
+	 */
+	virtual void OnOutputDrained() noexcept {}
 };
 
 #endif
@@ -18,16 +18,18 @@
  */
 
 #include "Client.hxx"
+#include "Socket.hxx"
 #include "Config.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "BackgroundCommand.hxx"
+#include "Compression.hxx"
 #include "config.h"
 
 Client::~Client() noexcept
 {
-	if (FullyBufferedSocket::IsDefined())
-		FullyBufferedSocket::Close();
+	if (socket != nullptr)
+		socket->Destroy(false);
 
 	if (background_command) {
 		background_command->Cancel();
@@ -54,6 +56,8 @@ Client::OnBackgroundCommandFinished() noexcept
 
 	background_command.reset();
 
+	EndResponse();
+
 	/* just in case OnSocketInput() has returned
 	   InputResult::PAUSE meanwhile */
 	ResumeInput();
@@ -61,12 +65,32 @@ Client::OnBackgroundCommandFinished() noexcept
 	timeout_event.Schedule(client_timeout);
 }
 
+void
+Client::ResumeInput() noexcept
+{
+	/* process the remaining input asynchronously, because this
+	   may be called by the #BackgroundCommand */
+	if (!IsExpired())
+		socket_event.Schedule();
+}
+
 Instance &
 Client::GetInstance() noexcept
 {
 	return partition->instance;
 }
 
+std::size_t
+Client::GetMemoryUsage() noexcept
+{
+	std::size_t size = sizeof(*this) + input.capacity();
+
+	if (socket != nullptr)
+		size += socket->GetMemoryUsage();
+
+	return size;
+}
+
 playlist &
 Client::GetPlaylist() noexcept
 {
@@ -24,23 +24,31 @@
 #include "command/CommandResult.hxx"
 #include "command/CommandListBuilder.hxx"
 #include "tag/Mask.hxx"
-#include "event/FullyBufferedSocket.hxx"
+#include "IdleFlags.hxx"
+#include "event/DeferEvent.hxx"
 #include "event/TimerEvent.hxx"
+#include "event/CoarseTimerEvent.hxx"
 #include "util/Compiler.h"
 
 #include <boost/intrusive/link_mode.hpp>
 #include <boost/intrusive/list_hook.hpp>
 
+#include <array>
+#include <exception>
 #include <set>
 #include <string>
 #include <list>
 #include <memory>
 
 #include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 class SocketAddress;
 class UniqueSocketDescriptor;
+class UniqueFileDescriptor;
 class EventLoop;
+class ClientSocket;
 class Path;
 struct Instance;
 struct Partition;
@@ -49,11 +57,48 @@ struct playlist;
 class Database;
 class Storage;
 class BackgroundCommand;
+class Client;
+
+/**
+ * An item in one of #ClientList's per-event lists of clients waiting
+ * in "idle" mode.
+ */
+struct ClientIdleHook
+	: boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+	Client *client;
+};
 
 class Client final
-	: FullyBufferedSocket,
-	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
-	TimerEvent timeout_event;
+	: public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+	EventLoop &loop;
+
+	/**
+	 * Scheduled by the #ClientSocket when new input or other
+	 * events are pending.
+	 */
+	DeferEvent socket_event;
+
+	/**
+	 * The connection to the client.  It may run in a different
+	 * thread, see #ClientThreads.  This is nullptr if the client
+	 * is expired.
+	 */
+	ClientSocket *socket;
+
+	/**
+	 * Data received from the #socket which has not yet been
+	 * processed.
+	 */
+	std::string input;
+
+	/**
+	 * Has the peer closed the connection?  The client will be
+	 * expired after all complete lines in #input have been
+	 * processed.
+	 */
+	bool input_closed = false;
+
+	CoarseTimerEvent timeout_event;
 
 	Partition *partition;
 
@@ -76,6 +121,44 @@ class Client final
 	/** idle flags that the client wants to receive */
 	unsigned idle_subscriptions;
 
+	/**
+	 * Shall the "idle" response include the changes of the
+	 * "status" response?  Set by the "idlestatus" command.
+	 */
+	bool idle_status = false;
+
+	/**
+	 * The ClientList::GetIdleSerial() value at the time global
+	 * idle events were last collected into this client.  All
+	 * global events after that are pending on this client.
+	 */
+	uint64_t idle_serial;
+
+	/**
+	 * When was the last "idle" response sent?  Used to implement
+	 * #client_idle_min_interval.
+	 */
+	std::chrono::steady_clock::time_point idle_notify_time;
+
+	/**
+	 * Sends the "idle" response which was deferred because of
+	 * #client_idle_min_interval.
+	 */
+	TimerEvent idle_event;
+
+	/**
+	 * While waiting in "idle" mode, these items are linked into
+	 * the #ClientList's lists of the subscribed events.
+	 */
+	std::array<ClientIdleHook, IDLE_N_FLAGS> idle_hooks;
+
+	/**
+	 * The "status" response at the time of the last
+	 * "idlestatus" response.  The next one includes only lines
+	 * which differ from it.
+	 */
+	std::string idle_status_text;
+
 public:
 	// TODO: make this attribute "private"
 	/**
@@ -112,24 +195,65 @@ private:
 	 */
 	std::unique_ptr<BackgroundCommand> background_command;
 
+	/**
+	 * Is ProcessCommandList() currently running?
+	 */
+	bool processing_command_list = false;
+
+	struct CompressionState;
+
+	/**
+	 * If set, then responses are compressed (the "compression"
+	 * command).
+	 */
+	std::unique_ptr<CompressionState> compression;
+
+	/**
+	 * The setting of the last "compression" command, which will
+	 * be applied by EndResponse().
+	 */
+	std::unique_ptr<CompressionState> next_compression;
+	bool compression_changed = false;
+
 public:
-	Client(EventLoop &loop, Partition &partition,
+	/**
+	 * @param socket_loop the #EventLoop which handles the
+	 * socket; may be different from #loop
+	 */
+	Client(EventLoop &loop, EventLoop &socket_loop,
+	       Partition &partition,
 	       UniqueSocketDescriptor fd, int uid,
 	       unsigned _permission,
 	       int num) noexcept;
 
 	~Client() noexcept;
 
-	using FullyBufferedSocket::GetEventLoop;
+	EventLoop &GetEventLoop() const noexcept {
+		return loop;
+	}
 
 	gcc_pure
 	bool IsExpired() const noexcept {
-		return !FullyBufferedSocket::IsDefined();
+		return socket == nullptr;
 	}
 
 	void Close() noexcept;
 	void SetExpired() noexcept;
 
+	/**
+	 * Is a command list currently being executed?  Commands in a
+	 * command list cannot be moved to background.
+	 */
+	bool IsProcessingCommandList() const noexcept {
+		return processing_command_list;
+	}
+
+	/**
+	 * Has all output been sent to the socket?
+	 */
+	gcc_pure
+	bool IsOutputEmpty() const noexcept;
+
 	bool Write(const void *data, size_t length) noexcept;
 
 	/**
@@ -137,6 +261,42 @@ public:
 	 */
 	bool Write(const char *data) noexcept;
 
+	/**
+	 * Is the current response subject to compression?  If yes,
+	 * then WriteFile() must not be used.
+	 */
+	bool IsCompressing() const noexcept {
+		return compression != nullptr;
+	}
+
+	/**
+	 * Enable or disable the compression of responses, starting
+	 * with the next response.
+	 *
+	 * Throws std::invalid_argument if the algorithm is not
+	 * supported.
+	 *
+	 * @param name the algorithm name ("none", "gzip" or "zstd")
+	 * @param threshold responses up to this size are not
+	 * compressed
+	 */
+	void SetCompression(const char *name, size_t threshold);
+
+	/**
+	 * Called at the end of each response.  This finishes the
+	 * compression of the response.
+	 */
+	void EndResponse() noexcept;
+
+#ifdef __linux__
+	/**
+	 * Send a portion of a regular file with sendfile().  See
+	 * ClientSocket::WriteFile().
+	 */
+	bool WriteFile(UniqueFileDescriptor &&file_fd, off_t offset,
+		       size_t length) noexcept;
+#endif
+
 	/**
 	 * returns the uid of the client process, or a negative value
 	 * if the uid is unknown
@@ -166,7 +326,25 @@ public:
 	 */
 	void IdleNotify() noexcept;
 	void IdleAdd(unsigned flags) noexcept;
-	bool IdleWait(unsigned flags) noexcept;
+
+	/**
+	 * @param status include the "status" changes in the
+	 * response (the "idlestatus" command)?
+	 * @return true if the response has been sent already
+	 */
+	bool IdleWait(unsigned flags, bool status=false) noexcept;
+
+	/**
+	 * Leave "idle" mode without sending a response (the
+	 * "noidle" command).
+	 */
+	void IdleCancel() noexcept;
+
+	/**
+	 * Called by #ClientList when a subscribed event has
+	 * occurred while waiting in "idle" mode.
+	 */
+	void OnIdleEvent() noexcept;
 
 	/**
 	 * Called by a command handler to defer execution to a
@@ -243,6 +421,12 @@ public:
 	gcc_pure
 	Instance &GetInstance() noexcept;
 
+	/**
+	 * Determine the approximate number of bytes occupied by this
+	 * client, including its socket buffers.
+	 */
+	std::size_t GetMemoryUsage() noexcept;
+
 	gcc_pure
 	playlist &GetPlaylist() noexcept;
 
@@ -269,13 +453,39 @@ private:
 
 	CommandResult ProcessLine(char *line) noexcept;
 
-	/* virtual methods from class BufferedSocket */
-	InputResult OnSocketInput(void *data, size_t length) noexcept override;
-	void OnSocketError(std::exception_ptr ep) noexcept override;
-	void OnSocketClosed() noexcept override;
+	/**
+	 * Execute all complete lines in #input.
+	 *
+	 * @return false if the client has been closed (and deleted) or
+	 * expired
+	 */
+	bool ProcessInput() noexcept;
+
+	/**
+	 * Continue processing #input after it was paused by a
+	 * #BackgroundCommand.
+	 */
+	void ResumeInput() noexcept;
+
+	void OnSocketOutputDrained() noexcept;
+	void OnSocketError(std::exception_ptr ep) noexcept;
+
+	/* callback for #socket_event */
+	void OnSocketEvent() noexcept;
+
+	/**
+	 * Write to the socket, bypassing #compression.
+	 */
+	bool WriteRaw(const void *data, size_t length) noexcept;
+
+	/**
+	 * Unlink all #idle_hooks.
+	 */
+	void UnlinkIdleHooks() noexcept;
 
 	/* callback for TimerEvent */
 	void OnTimeout() noexcept;
+	void OnIdleTimer() noexcept;
 };
 
 void
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "CommandPool.hxx"
+#include "thread/Name.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+CommandPool::CommandPool(unsigned n_threads)
+{
+	assert(n_threads > 0);
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		threads.emplace_front(BIND_THIS_METHOD(WorkerThread));
+
+		try {
+			threads.front().Start();
+		} catch (...) {
+			threads.pop_front();
+
+			if (threads.empty())
+				throw;
+
+			LogError(std::current_exception(),
+				 "Failed to start command thread");
+			break;
+		}
+	}
+}
+
+CommandPool::~CommandPool() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		assert(queue.empty());
+		quit = true;
+		cond.notify_all();
+	}
+
+	for (auto &thread : threads)
+		thread.Join();
+}
+
+void
+CommandPool::Submit(Job &job) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	assert(job.state == Job::State::NONE);
+
+	job.state = Job::State::QUEUED;
+	queue.push_back(&job);
+	cond.notify_one();
+}
+
+void
+CommandPool::Cancel(Job &job) noexcept
+{
+	std::unique_lock<Mutex> lock(mutex);
+
+	switch (job.state) {
+	case Job::State::NONE:
+	case Job::State::FINISHED:
+		break;
+
+	case Job::State::QUEUED:
+		queue.erase(std::find(queue.begin(), queue.end(), &job));
+		job.state = Job::State::NONE;
+		break;
+
+	case Job::State::RUNNING:
+		done_cond.wait(lock, [&job]{
+			return job.state == Job::State::FINISHED;
+		});
+		break;
+	}
+}
+
+CommandPool::ScopePause::ScopePause(CommandPool *_pool) noexcept
+	:pool(_pool)
+{
+	if (pool == nullptr)
+		return;
+
+	std::unique_lock<Mutex> lock(pool->mutex);
+	++pool->n_paused;
+
+	for (auto *job : pool->running)
+		job->OnPause();
+
+	pool->done_cond.wait(lock, [this]{ return pool->running.empty(); });
+}
+
+CommandPool::ScopePause::~ScopePause() noexcept
+{
+	if (pool == nullptr)
+		return;
+
+	const std::lock_guard<Mutex> protect(pool->mutex);
+	assert(pool->n_paused > 0);
+	if (--pool->n_paused == 0)
+		pool->cond.notify_all();
+}
+
+void
+CommandPool::WorkerThread() noexcept
+{
+	SetThreadName("command");
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (true) {
+		cond.wait(lock, [this]{
+			return quit || (n_paused == 0 && !queue.empty());
+		});
+		if (quit)
+			break;
+
+		Job &job = *queue.front();
+		queue.pop_front();
+		job.state = Job::State::RUNNING;
+		running.push_front(&job);
+		const auto i = running.begin();
+
+		lock.unlock();
+		job.Run();
+		lock.lock();
+
+		running.erase(i);
+		job.state = Job::State::FINISHED;
+		done_cond.notify_all();
+
+		/* this may delete the job (in another thread) */
+		job.OnFinished();
+	}
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_COMMAND_POOL_HXX
+#define MPD_CLIENT_COMMAND_POOL_HXX
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <forward_list>
+#include <list>
+
+/**
+ * A pool of threads which execute heavy read-only commands
+ * (e.g. "search" and "listallinfo").  This keeps the main thread
+ * responsive for other clients while a big database is being
+ * searched.
+ *
+ * @see PoolBackgroundCommand
+ */
+class CommandPool final {
+public:
+	class Job {
+		friend class CommandPool;
+
+		enum class State {
+			NONE,
+			QUEUED,
+			RUNNING,
+			FINISHED,
+		};
+
+		/**
+		 * Protected by CommandPool::mutex.
+		 */
+		State state = State::NONE;
+
+	protected:
+		/**
+		 * Execute the job in a worker thread.
+		 */
+		virtual void Run() noexcept = 0;
+
+		/**
+		 * Called by the worker thread after Run() has
+		 * returned, while holding CommandPool::mutex.  After
+		 * this method has been called, the pool does not
+		 * access this object anymore, i.e. it may be deleted
+		 * from another thread as soon as this method has been
+		 * entered.  It should only wake up the thread which
+		 * owns the job.
+		 */
+		virtual void OnFinished() noexcept = 0;
+
+		/**
+		 * Called by ScopePause while this job is running,
+		 * while holding CommandPool::mutex.  A job which
+		 * waits for the main thread (e.g. for a client's
+		 * socket to become writable) must stop waiting,
+		 * because the main thread is blocked until the job
+		 * has finished.
+		 */
+		virtual void OnPause() noexcept {}
+	};
+
+private:
+	Mutex mutex;
+
+	/**
+	 * Wakes up the worker threads.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a job was finished.
+	 */
+	Cond done_cond;
+
+	/**
+	 * Jobs which have not yet been started.  Protected by
+	 * #mutex.
+	 */
+	std::list<Job *> queue;
+
+	/**
+	 * Jobs currently being executed.  Protected by #mutex.
+	 */
+	std::list<Job *> running;
+
+	/**
+	 * The number of #ScopePause instances.  While this is
+	 * non-zero, no new job is started.  Protected by #mutex.
+	 */
+	unsigned n_paused = 0;
+
+	bool quit = false;
+
+	std::forward_list<Thread> threads;
+
+public:
+	/**
+	 * Throws if no thread could be started.
+	 */
+	explicit CommandPool(unsigned n_threads);
+
+	~CommandPool() noexcept;
+
+	CommandPool(const CommandPool &) = delete;
+	CommandPool &operator=(const CommandPool &) = delete;
+
+	/**
+	 * Enqueue a job.  The caller must keep the #Job object alive
+	 * until Job::OnFinished() has been called or until Cancel()
+	 * has returned.
+	 */
+	void Submit(Job &job) noexcept;
+
+	/**
+	 * Remove the job from the queue if it has not been started
+	 * yet, or wait until it has finished.
+	 */
+	void Cancel(Job &job) noexcept;
+
+	/**
+	 * While an instance of this class exists, jobs are not being
+	 * executed.  The constructor waits until all running jobs
+	 * have finished.  This is used by the main thread before it
+	 * modifies objects which are used by the jobs without
+	 * locking, e.g. before unmounting a database.
+	 */
+	class ScopePause {
+		CommandPool *const pool;
+
+	public:
+		explicit ScopePause(CommandPool *_pool) noexcept;
+		~ScopePause() noexcept;
+
+		ScopePause(const ScopePause &) = delete;
+		ScopePause &operator=(const ScopePause &) = delete;
+	};
+
+private:
+	void WorkerThread() noexcept;
+};
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Compression.hxx"
+#include "Domain.hxx"
+#include "util/StringFormat.hxx"
+#include "util/StringAPI.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_ZLIB
+#include "fs/io/GzipOutputStream.hxx"
+#endif
+
+#ifdef ENABLE_ZSTD
+#include "fs/io/ZstdOutputStream.hxx"
+#endif
+
+#include <stdexcept>
+
+#include <assert.h>
+#include <string.h>
+
+void
+Client::CompressionState::FrameWriter::Write(const void *data, size_t size)
+{
+	/* errors are ignored here; the client has been marked
+	   "expired" already */
+	const auto header = StringFormat<32>("compressed: %zu\n", size);
+	if (client.WriteRaw(header.c_str(), strlen(header.c_str())) &&
+	    client.WriteRaw(data, size))
+		client.WriteRaw("\n", 1);
+}
+
+Client::CompressionState::CompressionState(Client &_client,
+					   Algorithm _algorithm,
+					   size_t _threshold) noexcept
+	:client(_client), algorithm(_algorithm), threshold(_threshold),
+	 frame_writer(_client)
+{
+}
+
+Client::CompressionState::~CompressionState() noexcept = default;
+
+bool
+Client::CompressionState::IsCompressing() const noexcept
+{
+#ifdef ENABLE_ZLIB
+	if (gzip)
+		return true;
+#endif
+
+#ifdef ENABLE_ZSTD
+	if (zstd)
+		return true;
+#endif
+
+	return false;
+}
+
+OutputStream &
+Client::CompressionState::StartCompressing()
+{
+	assert(!IsCompressing());
+
+	switch (algorithm) {
+#ifdef ENABLE_ZLIB
+	case Algorithm::GZIP:
+		gzip = std::make_unique<GzipOutputStream>(frame_writer);
+		return *gzip;
+#endif
+
+#ifdef ENABLE_ZSTD
+	case Algorithm::ZSTD:
+		zstd = std::make_unique<ZstdOutputStream>(frame_writer);
+		return *zstd;
+#endif
+	}
+
+	gcc_unreachable();
+}
+
+void
+Client::CompressionState::Write(const void *data, size_t size)
+{
+#ifdef ENABLE_ZLIB
+	if (gzip) {
+		gzip->Write(data, size);
+		return;
+	}
+#endif
+
+#ifdef ENABLE_ZSTD
+	if (zstd) {
+		zstd->Write(data, size);
+		return;
+	}
+#endif
+
+	if (pending.size() + size <= threshold) {
+		pending.append((const char *)data, size);
+		return;
+	}
+
+	/* the response has become too large: compress it */
+	auto &os = StartCompressing();
+	if (!pending.empty()) {
+		os.Write(pending.data(), pending.size());
+		pending.clear();
+	}
+
+	os.Write(data, size);
+}
+
+void
+Client::CompressionState::End()
+{
+#ifdef ENABLE_ZLIB
+	if (gzip) {
+		auto os = std::move(gzip);
+		os->Flush();
+		return;
+	}
+#endif
+
+#ifdef ENABLE_ZSTD
+	if (zstd) {
+		auto os = std::move(zstd);
+		os->Flush();
+		return;
+	}
+#endif
+
+	/* small response: send it uncompressed */
+	if (!pending.empty()) {
+		client.WriteRaw(pending.data(), pending.size());
+		pending.clear();
+	}
+}
+
+void
+Client::SetCompression(const char *name, size_t threshold)
+{
+	std::unique_ptr<CompressionState> c;
+
+	if (StringIsEqual(name, "none")) {
+#ifdef ENABLE_ZLIB
+	} else if (StringIsEqual(name, "gzip")) {
+		c = std::make_unique<CompressionState>(*this,
+						       CompressionState::Algorithm::GZIP,
+						       threshold);
+#endif
+#ifdef ENABLE_ZSTD
+	} else if (StringIsEqual(name, "zstd")) {
+		c = std::make_unique<CompressionState>(*this,
+						       CompressionState::Algorithm::ZSTD,
+						       threshold);
+#endif
+	} else
+		throw std::invalid_argument("Unsupported compression algorithm");
+
+	/* this takes effect after the current response */
+	next_compression = std::move(c);
+	compression_changed = true;
+}
+
+void
+Client::EndResponse() noexcept
+{
+	if (compression) {
+		try {
+			compression->End();
+		} catch (...) {
+			FormatError(std::current_exception(),
+				    "[%u] compression failed", num);
+			SetExpired();
+			return;
+		}
+	}
+
+	if (compression_changed) {
+		compression = std::move(next_compression);
+		compression_changed = false;
+	}
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_CLIENT_COMPRESSION_HXX
+#define MPD_CLIENT_COMPRESSION_HXX
+
+#include "Client.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "config.h"
+
+#include <string>
+#include <memory>
+
+#ifdef ENABLE_ZLIB
+class GzipOutputStream;
+#endif
+
+#ifdef ENABLE_ZSTD
+class ZstdOutputStream;
+#endif
+
+/**
+ * Implementation of the "compression" command: responses larger than
+ * a threshold are compressed and sent in "compressed" frames.
+ */
+struct Client::CompressionState final {
+	enum class Algorithm {
+#ifdef ENABLE_ZLIB
+		GZIP,
+#endif
+#ifdef ENABLE_ZSTD
+		ZSTD,
+#endif
+	};
+
+	/**
+	 * An #OutputStream which wraps compressed data in
+	 * "compressed: N" frames and writes them to the client's
+	 * socket.
+	 */
+	class FrameWriter final : public OutputStream {
+		Client &client;
+
+	public:
+		explicit FrameWriter(Client &_client) noexcept
+			:client(_client) {}
+
+		/* virtual methods from class OutputStream */
+		void Write(const void *data, size_t size) override;
+	};
+
+	Client &client;
+
+	const Algorithm algorithm;
+
+	/**
+	 * Responses up to this size are sent uncompressed.
+	 */
+	const size_t threshold;
+
+	FrameWriter frame_writer;
+
+	/**
+	 * The beginning of the current response, until it exceeds
+	 * the #threshold.
+	 */
+	std::string pending;
+
+#ifdef ENABLE_ZLIB
+	std::unique_ptr<GzipOutputStream> gzip;
+#endif
+
+#ifdef ENABLE_ZSTD
+	std::unique_ptr<ZstdOutputStream> zstd;
+#endif
+
+	CompressionState(Client &_client, Algorithm _algorithm,
+			 size_t _threshold) noexcept;
+	~CompressionState() noexcept;
+
+	/**
+	 * Is the current response being compressed?
+	 */
+	bool IsCompressing() const noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void Write(const void *data, size_t size);
+
+	/**
+	 * Finish the current response.
+	 *
+	 * Throws on error.
+	 */
+	void End();
+
+private:
+	/**
+	 * Throws on error.
+	 */
+	OutputStream &StartCompressing();
+};
+
+#endif
@@ -27,6 +27,7 @@
 std::chrono::steady_clock::duration client_timeout;
 size_t client_max_command_list_size;
 size_t client_max_output_buffer_size;
+std::chrono::steady_clock::duration client_idle_min_interval;
 
 void
 client_manager_init(const ConfigData &config)
@@ -44,4 +45,8 @@ client_manager_init(const ConfigData &config)
 		config.GetPositive(ConfigOption::MAX_OUTPUT_BUFFER_SIZE,
 				   CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT / 1024)
 		* 1024;
+
+	client_idle_min_interval =
+		std::chrono::milliseconds(config.GetUnsigned(ConfigOption::IDLE_MIN_INTERVAL,
+							     0));
 }
@@ -28,6 +28,13 @@ extern std::chrono::steady_clock::duration client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
 
+/**
+ * The minimum time between two "idle" responses to the same client.
+ * Events occurring within this period are coalesced into one
+ * response.
+ */
+extern std::chrono::steady_clock::duration client_idle_min_interval;
+
 void
 client_manager_init(const ConfigData &config);
 
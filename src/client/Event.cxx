@@ -18,8 +18,17 @@
  */
 
 #include "Client.hxx"
+#include "Socket.hxx"
+#include "BackgroundCommand.hxx"
 #include "Log.hxx"
 
+void
+Client::OnSocketOutputDrained() noexcept
+{
+	if (background_command)
+		background_command->OnOutputDrained();
+}
+
 void
 Client::OnSocketError(std::exception_ptr ep) noexcept
 {
@@ -29,7 +38,30 @@ Client::OnSocketError(std::exception_ptr ep) noexcept
 }
 
 void
-Client::OnSocketClosed() noexcept
+Client::OnSocketEvent() noexcept
 {
-	SetExpired();
+	if (IsExpired())
+		return;
+
+	const auto events = socket->TakeEvents(input, ClientSocket::MAX_INPUT_SIZE);
+	if (events.error) {
+		OnSocketError(events.error);
+		return;
+	}
+
+	if (events.closed)
+		input_closed = true;
+
+	if (events.drained) {
+		OnSocketOutputDrained();
+		if (IsExpired())
+			return;
+	}
+
+	if (!ProcessInput())
+		return;
+
+	if (input_closed && !background_command)
+		/* all complete lines have been executed */
+		SetExpired();
 }
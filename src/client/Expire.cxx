@@ -18,6 +18,7 @@
  */
 
 #include "Client.hxx"
+#include "Socket.hxx"
 #include "BackgroundCommand.hxx"
 #include "Domain.hxx"
 #include "Log.hxx"
@@ -28,9 +29,13 @@ Client::SetExpired() noexcept
 	if (IsExpired())
 		return;
 
-	background_command.reset();
+	if (background_command) {
+		background_command->Cancel();
+		background_command.reset();
+	}
 
-	FullyBufferedSocket::Close();
+	socket->Destroy(false);
+	socket = nullptr;
 	timeout_event.Schedule(std::chrono::steady_clock::duration::zero());
 }
 
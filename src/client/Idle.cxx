@@ -19,38 +19,193 @@
 
 #include "Client.hxx"
 #include "Config.hxx"
+#include "List.hxx"
 #include "Response.hxx"
 #include "Idle.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "command/PlayerCommands.hxx"
+
+#include <algorithm>
+#include <string>
+#include <string_view>
 
 #include <assert.h>
 
 static void
-WriteIdleResponse(Response &r, unsigned flags) noexcept
+WriteIdleFlags(Response &r, unsigned flags) noexcept
 {
 	const char *const*idle_names = idle_get_names();
 	for (unsigned i = 0; idle_names[i]; ++i) {
 		if (flags & (1 << i))
 			r.Format("changed: %s\n", idle_names[i]);
 	}
+}
 
-	r.Write("OK\n");
+/**
+ * Collects a #Response in a std::string.
+ */
+class StringResponseSink final : public ResponseSink {
+	std::string &value;
+
+public:
+	explicit StringResponseSink(std::string &_value) noexcept
+		:value(_value) {}
+
+	bool Write(const void *data, size_t length) noexcept override {
+		value.append((const char *)data, length);
+		return true;
+	}
+
+	bool Throttle() noexcept override {
+		return true;
+	}
+};
+
+/**
+ * Invoke the function for each line of the string (without the
+ * newline character).
+ */
+template<typename F>
+static void
+ForEachLine(std::string_view s, F &&f) noexcept
+{
+	while (!s.empty()) {
+		auto newline = s.find('\n');
+		if (newline == s.npos)
+			newline = s.size();
+
+		f(s.substr(0, newline));
+		s.remove_prefix(std::min(newline + 1, s.size()));
+	}
+}
+
+/**
+ * Does the newline-separated string contain a line which starts with
+ * the given prefix?
+ */
+gcc_pure
+static bool
+HasLineWithPrefix(std::string_view s, std::string_view prefix,
+		  bool exact=false) noexcept
+{
+	bool found = false;
+	ForEachLine(s, [&found, prefix, exact](std::string_view line){
+			if (exact
+			    ? line == prefix
+			    : line.substr(0, prefix.size()) == prefix)
+				found = true;
+		});
+	return found;
+}
+
+/**
+ * Write all lines of the new status which were not present in the old
+ * one, and a "removed" line for each attribute which has
+ * disappeared.
+ */
+static void
+WriteStatusDelta(Response &r, std::string_view old_status,
+		 std::string_view new_status) noexcept
+{
+	ForEachLine(new_status, [&r, old_status](std::string_view line){
+			if (!HasLineWithPrefix(old_status, line, true))
+				r.Format("%.*s\n", int(line.size()),
+					 line.data());
+		});
+
+	ForEachLine(old_status, [&r, new_status](std::string_view line){
+			const auto colon = line.find(": ");
+			if (colon == line.npos)
+				return;
+
+			const auto key = line.substr(0, colon + 2);
+			if (!HasLineWithPrefix(new_status, key))
+				r.Format("removed: %.*s\n",
+					 int(colon), line.data());
+		});
+}
+
+void
+Client::UnlinkIdleHooks() noexcept
+{
+	for (auto &i : idle_hooks)
+		if (i.is_linked())
+			i.unlink();
 }
 
 void
 Client::IdleNotify() noexcept
 {
 	assert(idle_waiting);
-	assert(idle_flags != 0);
 
-	unsigned flags = std::exchange(idle_flags, 0) & idle_subscriptions;
+	const auto &client_list = *partition->instance.client_list;
+
+	unsigned flags = (std::exchange(idle_flags, 0) |
+			  client_list.GetIdleFlagsSince(idle_serial))
+		& idle_subscriptions;
+	idle_serial = client_list.GetIdleSerial();
+
+	assert(flags != 0);
+
+	UnlinkIdleHooks();
+	idle_event.Cancel();
 	idle_waiting = false;
+	idle_notify_time = GetEventLoop().GetTime();
 
 	Response r(*this, 0);
-	WriteIdleResponse(r, flags);
+	WriteIdleFlags(r, flags);
+
+	if (idle_status) {
+		std::string status;
+		StringResponseSink sink(status);
+		Response status_response(*this, 0, sink);
+		print_status(*this, status_response);
+
+		WriteStatusDelta(r, idle_status_text, status);
+		idle_status_text = std::move(status);
+	}
+
+	r.Write("OK\n");
+	EndResponse();
 
 	timeout_event.Schedule(client_timeout);
 }
 
+void
+Client::OnIdleEvent() noexcept
+{
+	assert(idle_waiting);
+
+	/* no more events are needed: all events until the response
+	   is sent will be collected by IdleNotify() */
+	UnlinkIdleHooks();
+
+	if (IsExpired())
+		return;
+
+	if (client_idle_min_interval > std::chrono::steady_clock::duration::zero()) {
+		const auto now = GetEventLoop().GetTime();
+		const auto next = idle_notify_time + client_idle_min_interval;
+		if (now < next) {
+			/* rate limit: coalesce all events until then into
+			   one response */
+			if (!idle_event.IsActive())
+				idle_event.Schedule(next - now);
+			return;
+		}
+	}
+
+	IdleNotify();
+}
+
+void
+Client::OnIdleTimer() noexcept
+{
+	if (!IsExpired() && idle_waiting)
+		IdleNotify();
+}
+
 void
 Client::IdleAdd(unsigned flags) noexcept
 {
@@ -58,24 +213,44 @@ Client::IdleAdd(unsigned flags) noexcept
 		return;
 
 	idle_flags |= flags;
-	if (idle_waiting && (idle_flags & idle_subscriptions))
-		IdleNotify();
+	if (idle_waiting && (flags & idle_subscriptions) &&
+	    !idle_event.IsActive())
+		OnIdleEvent();
 }
 
 bool
-Client::IdleWait(unsigned flags) noexcept
+Client::IdleWait(unsigned flags, bool status) noexcept
 {
 	assert(!idle_waiting);
 
 	idle_waiting = true;
 	idle_subscriptions = flags;
+	idle_status = status;
 
-	if (idle_flags & idle_subscriptions) {
-		IdleNotify();
-		return true;
-	} else {
-		/* disable timeouts while in "idle" */
-		timeout_event.Cancel();
-		return false;
+	/* disable timeouts while in "idle" */
+	timeout_event.Cancel();
+
+	auto &client_list = *partition->instance.client_list;
+	const unsigned pending = idle_flags |
+		client_list.GetIdleFlagsSince(idle_serial);
+	if (pending & idle_subscriptions) {
+		OnIdleEvent();
+		return !idle_waiting;
 	}
+
+	for (unsigned i = 0; i < IDLE_N_FLAGS; ++i)
+		if (idle_subscriptions & (1u << i))
+			client_list.AddIdleWaiter(i, idle_hooks[i]);
+
+	return false;
+}
+
+void
+Client::IdleCancel() noexcept
+{
+	assert(idle_waiting);
+
+	UnlinkIdleHooks();
+	idle_event.Cancel();
+	idle_waiting = false;
 }
@@ -40,6 +40,32 @@ ClientList::IdleAdd(unsigned flags) noexcept
 {
 	assert(flags != 0);
 
-	for (auto &client : list)
-		client.IdleAdd(flags);
+	++idle_serial;
+
+	/* mark all flags first, so the clients notified below see
+	   all of them */
+	for (unsigned i = 0; i < IDLE_N_FLAGS; ++i)
+		if (flags & (1u << i))
+			idle_flag_serials[i] = idle_serial;
+
+	for (unsigned i = 0; i < IDLE_N_FLAGS; ++i) {
+		if (!(flags & (1u << i)))
+			continue;
+
+		/* OnIdleEvent() unlinks all hooks of the client */
+		auto &waiters = idle_waiters[i];
+		while (!waiters.empty())
+			waiters.front().client->OnIdleEvent();
+	}
+}
+
+unsigned
+ClientList::GetIdleFlagsSince(uint64_t serial) const noexcept
+{
+	unsigned flags = 0;
+	for (unsigned i = 0; i < IDLE_N_FLAGS; ++i)
+		if (idle_flag_serials[i] > serial)
+			flags |= 1u << i;
+
+	return flags;
 }
@@ -24,15 +24,48 @@
 
 #include <boost/intrusive/list.hpp>
 
+#include <array>
+
+#include <stdint.h>
+
 class ClientList {
 	using List =
 		boost::intrusive::list<Client,
 				       boost::intrusive::constant_time_size<true>>;
 
+	using IdleList =
+		boost::intrusive::list<ClientIdleHook,
+				       boost::intrusive::constant_time_size<false>>;
+
 	const unsigned max_size;
 
 	List list;
 
+	/**
+	 * Incremented by each IdleAdd() call.
+	 */
+	uint64_t idle_serial = 0;
+
+	/**
+	 * For each idle flag: the #idle_serial of the last IdleAdd()
+	 * call which included it.
+	 */
+	std::array<uint64_t, IDLE_N_FLAGS> idle_flag_serials{};
+
+	/**
+	 * For each idle flag: the clients waiting in "idle" mode
+	 * which are subscribed to it.  This way, IdleAdd() does not
+	 * need to visit all clients.
+	 */
+	std::array<IdleList, IDLE_N_FLAGS> idle_waiters;
+
+	/**
+	 * The number of connections accepted and rejected (because
+	 * #max_size was reached) so far; exported as metrics, so the
+	 * connection rate can be monitored.
+	 */
+	uint64_t n_accepted = 0, n_rejected = 0;
+
 public:
 	explicit ClientList(unsigned _max_size) noexcept
 		:max_size(_max_size) {}
@@ -47,17 +80,63 @@ public:
 		return list.end();
 	}
 
+	unsigned GetSize() const noexcept {
+		return list.size();
+	}
+
+	unsigned GetMaxSize() const noexcept {
+		return max_size;
+	}
+
 	bool IsFull() const noexcept {
 		return list.size() >= max_size;
 	}
 
 	void Add(Client &client) noexcept {
 		list.push_front(client);
+		++n_accepted;
+	}
+
+	void CountRejected() noexcept {
+		++n_rejected;
+	}
+
+	uint64_t GetAcceptedCount() const noexcept {
+		return n_accepted;
+	}
+
+	uint64_t GetRejectedCount() const noexcept {
+		return n_rejected;
 	}
 
 	void Remove(Client &client) noexcept;
 
+	/**
+	 * Emit idle events.  Clients which are not waiting in "idle"
+	 * mode are not visited; they collect these events with
+	 * GetIdleFlagsSince() later.
+	 */
 	void IdleAdd(unsigned flags) noexcept;
+
+	uint64_t GetIdleSerial() const noexcept {
+		return idle_serial;
+	}
+
+	/**
+	 * Returns the idle flags emitted after the given
+	 * GetIdleSerial() value.
+	 */
+	gcc_pure
+	unsigned GetIdleFlagsSince(uint64_t serial) const noexcept;
+
+	/**
+	 * Register a client waiting in "idle" mode for the given
+	 * flag.  It gets unlinked automatically.
+	 */
+	void AddIdleWaiter(unsigned flag_index,
+			   ClientIdleHook &hook) noexcept {
+		idle_waiters[flag_index].push_back(hook);
+	}
 };
 
 #endif
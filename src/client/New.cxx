@@ -18,10 +18,13 @@
  */
 
 #include "Client.hxx"
+#include "Socket.hxx"
+#include "Threads.hxx"
 #include "Config.hxx"
 #include "Domain.hxx"
 #include "List.hxx"
 #include "BackgroundCommand.hxx"
+#include "Compression.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
@@ -33,18 +36,26 @@
 
 static constexpr char GREETING[] = "OK MPD " PROTOCOL_VERSION "\n";
 
-Client::Client(EventLoop &_loop, Partition &_partition,
+Client::Client(EventLoop &_loop, EventLoop &socket_loop,
+	       Partition &_partition,
 	       UniqueSocketDescriptor _fd,
 	       int _uid, unsigned _permission,
 	       int _num) noexcept
-	:FullyBufferedSocket(_fd.Release(), _loop,
-			     16384, client_max_output_buffer_size),
+	:loop(_loop),
+	 socket_event(_loop, BIND_THIS_METHOD(OnSocketEvent)),
+	 socket(ClientSocket::Create(socket_loop, std::move(_fd), socket_event,
+				     client_max_output_buffer_size)),
 	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout)),
 	 partition(&_partition),
 	 permission(_permission),
 	 uid(_uid),
-	 num(_num)
+	 num(_num),
+	 idle_serial(_partition.instance.client_list->GetIdleSerial()),
+	 idle_event(_loop, BIND_THIS_METHOD(OnIdleTimer))
 {
+	for (auto &i : idle_hooks)
+		i.client = this;
+
 	timeout_event.Schedule(client_timeout);
 }
 
@@ -60,14 +71,21 @@ client_new(EventLoop &loop, Partition &partition,
 
 	ClientList &client_list = *partition.instance.client_list;
 	if (client_list.IsFull()) {
+		client_list.CountRejected();
 		LogWarning(client_domain, "Max connections reached");
 		return;
 	}
 
 	(void)fd.Write(GREETING, sizeof(GREETING) - 1);
 
+	/* the socket is handled by one of the client I/O threads
+	   (if configured), everything else by the main thread */
+	auto *threads = partition.instance.client_threads.get();
+	EventLoop &socket_loop = threads != nullptr ? threads->Next() : loop;
+
 	const unsigned num = next_client_num++;
-	Client *client = new Client(loop, partition, std::move(fd), uid,
+	Client *client = new Client(loop, socket_loop, partition,
+				    std::move(fd), uid,
 				    permission,
 				    num);
 
@@ -82,8 +100,8 @@ Client::Close() noexcept
 {
 	partition->instance.client_list->Remove(*this);
 
-	if (FullyBufferedSocket::IsDefined())
-		FullyBufferedSocket::Close();
+	if (socket != nullptr)
+		socket->Destroy(false);
 
 	FormatInfo(client_domain, "[%u] closed", num);
 	delete this;
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PoolBackgroundCommand.hxx"
+#include "Client.hxx"
+#include "Response.hxx"
+#include "Domain.hxx"
+#include "Instance.hxx"
+#include "command/Request.hxx"
+#include "command/CommandError.hxx"
+#include "command/CommandStats.hxx"
+#include "protocol/Result.hxx"
+#include "Config.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#endif
+
+#include <algorithm>
+#include <memory>
+
+/**
+ * Throttle() blocks while more than this number of bytes are waiting
+ * to be passed to the client.
+ */
+static constexpr size_t THROTTLE_SIZE = 64 * 1024;
+
+/**
+ * Transfer() passes at most this number of bytes at a time to the
+ * client's output buffer.
+ */
+static constexpr size_t TRANSFER_SIZE = 16 * 1024;
+
+PoolBackgroundCommand::PoolBackgroundCommand(Client &_client,
+					     CommandPool &_pool,
+					     Handler _handler,
+					     const char *_command,
+					     Request _args,
+					     CommandStats &_stats) noexcept
+	:client(_client), pool(_pool),
+	 defer_transfer(_client.GetEventLoop(), BIND_THIS_METHOD(Transfer)),
+	 handler(_handler), command(_command),
+	 args(_args.begin(), _args.end()),
+	 stats(_stats)
+{
+}
+
+void
+PoolBackgroundCommand::Run() noexcept
+{
+	std::vector<const char *> argv;
+	argv.reserve(args.size());
+	for (const auto &i : args)
+		argv.push_back(i.c_str());
+
+	Response r(client, 0, *this);
+	r.SetCommand(command);
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	try {
+		result = handler(client, Request(argv.data(), argv.size()), r);
+	} catch (...) {
+		PrintError(r, std::current_exception());
+		result = CommandResult::ERROR;
+	}
+
+	stats.Add(std::chrono::steady_clock::now() - start_time,
+		  r.GetWrittenBytes(), result == CommandResult::ERROR);
+}
+
+void
+PoolBackgroundCommand::OnFinished() noexcept
+{
+	/* schedule the DeferEvent while holding the mutex, because
+	   Transfer() may delete this object as soon as it sees the
+	   "finished" flag */
+	const std::lock_guard<Mutex> protect(mutex);
+	finished = true;
+	defer_transfer.Schedule();
+}
+
+void
+PoolBackgroundCommand::OnPause() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	paused = true;
+	cond.notify_one();
+}
+
+bool
+PoolBackgroundCommand::Write(const void *data, size_t length) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (cancelled || overflow)
+		return false;
+
+	if (GetPendingSize() + length > client_max_output_buffer_size) {
+		overflow = true;
+		defer_transfer.Schedule();
+		return false;
+	}
+
+	if (GetPendingSize() == 0)
+		defer_transfer.Schedule();
+
+	pending.append((const char *)data, length);
+	return true;
+}
+
+bool
+PoolBackgroundCommand::Throttle() noexcept
+{
+	std::unique_lock<Mutex> lock(mutex);
+	cond.wait(lock, [this]{
+		return cancelled || overflow || paused ||
+			GetPendingSize() < THROTTLE_SIZE;
+	});
+
+	return !cancelled && !overflow;
+}
+
+void
+PoolBackgroundCommand::Transfer() noexcept
+{
+	auto &c = client;
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	if (overflow) {
+		if (!finished)
+			/* wait for the handler to return, or else
+			   SetExpired() would block the main thread
+			   until then */
+			return;
+
+		lock.unlock();
+
+		/* behave as if the client's output buffer had
+		   overflowed */
+		LogError(client_domain, "Output buffer is full");
+
+		/* this cancels and deletes this object */
+		c.SetExpired();
+		return;
+	}
+
+	if (GetPendingSize() > 0) {
+		if (!c.IsOutputEmpty())
+			/* wait for OnOutputDrained() */
+			return;
+
+		/* copy a chunk while holding the mutex; it must be
+		   released before calling Client::Write(), because
+		   that may cancel this command */
+		char buffer[TRANSFER_SIZE];
+		const size_t length = std::min(GetPendingSize(),
+					       sizeof(buffer));
+		std::copy_n(pending.data() + pending_position, length,
+			    buffer);
+		pending_position += length;
+
+		if (pending_position * 2 >= pending.size()) {
+			pending.erase(0, pending_position);
+			pending_position = 0;
+		}
+
+		cond.notify_one();
+		lock.unlock();
+
+		/* if this fails, then the client has been expired
+		   and this object has been deleted */
+		if (c.Write(buffer, length) && c.IsOutputEmpty())
+			/* the chunk did not reach the socket (it was
+			   consumed by a compressor); there will be no
+			   OnOutputDrained() call */
+			defer_transfer.Schedule();
+		return;
+	}
+
+	if (!finished)
+		/* wait for more data from Write() */
+		return;
+
+	lock.unlock();
+
+	if (result == CommandResult::OK)
+		command_success(c);
+
+	/* delete this object */
+	c.OnBackgroundCommandFinished();
+}
+
+void
+PoolBackgroundCommand::OnOutputDrained() noexcept
+{
+	Transfer();
+}
+
+void
+PoolBackgroundCommand::Cancel() noexcept
+{
+	{
+		/* wake up Throttle() */
+		const std::lock_guard<Mutex> protect(mutex);
+		cancelled = true;
+		cond.notify_one();
+	}
+
+	pool.Cancel(*this);
+
+	/* cancel the DeferEvent, just in case the job has meanwhile
+	   finished execution or has written more data */
+	defer_transfer.Cancel();
+}
+
+/**
+ * Does the database allow concurrent access from a #CommandPool
+ * thread?
+ */
+gcc_pure
+static bool
+IsDatabaseConcurrent(const Instance &instance) noexcept
+{
+#ifdef ENABLE_DATABASE
+	const Database *db = instance.database.get();
+	return db == nullptr || db->GetPlugin().SupportsConcurrentReads();
+#else
+	(void)instance;
+	return true;
+#endif
+}
+
+CommandResult
+RunInCommandPool(Client &client, Request args, Response &r,
+		 PoolBackgroundCommand::Handler handler,
+		 CommandStats &stats)
+{
+	auto &instance = client.GetInstance();
+	CommandPool *pool = instance.command_pool.get();
+
+	if (pool == nullptr ||
+	    /* a BACKGROUND result would abort the command list */
+	    client.IsProcessingCommandList() ||
+	    !IsDatabaseConcurrent(instance))
+		return handler(client, args, r);
+
+	auto cmd = std::make_unique<PoolBackgroundCommand>(client, *pool,
+							   handler,
+							   r.GetCommand(),
+							   args, stats);
+	cmd->Start();
+	client.SetBackgroundCommand(std::move(cmd));
+	return CommandResult::BACKGROUND;
+}
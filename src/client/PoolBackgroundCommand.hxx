@@ -0,0 +1,171 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_POOL_BACKGROUND_COMMAND_HXX
+#define MPD_POOL_BACKGROUND_COMMAND_HXX
+
+#include "BackgroundCommand.hxx"
+#include "CommandPool.hxx"
+#include "Response.hxx"
+#include "command/CommandResult.hxx"
+#include "event/DeferEvent.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <string>
+#include <vector>
+
+class Client;
+class Request;
+class CommandStats;
+
+/**
+ * A #BackgroundCommand which executes a regular command handler in a
+ * #CommandPool thread.  The response is collected in a string, and
+ * passed to the client by the main thread whenever the client's
+ * output buffer has been drained.  Handlers which produce large
+ * responses can use Response::Throttle() to wait for the client, so
+ * the amount of memory used per client stays bounded.
+ *
+ * The handler must not modify any state, because it runs
+ * concurrently with the main thread; it may only read the database
+ * (which is protected by #db_mutex) and the #Client settings (which
+ * don't change while the client waits for the command to finish).
+ */
+class PoolBackgroundCommand final
+	: public BackgroundCommand, CommandPool::Job, ResponseSink {
+public:
+	typedef CommandResult (*Handler)(Client &client, Request request,
+					 Response &response);
+
+private:
+	Client &client;
+	CommandPool &pool;
+
+	/**
+	 * Passes #pending to the client and finishes the command in
+	 * the main thread.
+	 */
+	DeferEvent defer_transfer;
+
+	const Handler handler;
+
+	/**
+	 * The command name; used by Response::FormatError().
+	 */
+	const char *const command;
+
+	const std::vector<std::string> args;
+
+	CommandStats &stats;
+
+	CommandResult result = CommandResult::OK;
+
+	/**
+	 * Protects #pending and the flags below.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Wakes up Throttle() when data has been taken from
+	 * #pending.
+	 */
+	Cond cond;
+
+	/**
+	 * Response data which has not yet been passed to the client.
+	 * The first #pending_position bytes have already been
+	 * passed.
+	 */
+	std::string pending;
+	size_t pending_position = 0;
+
+	/**
+	 * Has Run() returned?  Set by OnFinished().
+	 */
+	bool finished = false;
+
+	/**
+	 * Has Cancel() been called?
+	 */
+	bool cancelled = false;
+
+	/**
+	 * Has the #CommandPool been paused?  If yes, then Throttle()
+	 * doesn't block anymore.
+	 */
+	bool paused = false;
+
+	/**
+	 * Did #pending exceed #client_max_output_buffer_size?
+	 */
+	bool overflow = false;
+
+public:
+	PoolBackgroundCommand(Client &_client, CommandPool &_pool,
+			      Handler _handler, const char *_command,
+			      Request _args, CommandStats &_stats) noexcept;
+
+	void Start() noexcept {
+		pool.Submit(*this);
+	}
+
+	/* virtual methods from class BackgroundCommand */
+	void Cancel() noexcept override;
+	void OnOutputDrained() noexcept override;
+
+private:
+	/**
+	 * Pass (a portion of) #pending to the client if its output
+	 * buffer is empty, and finish the command after everything
+	 * has been passed.  This may delete this object.
+	 */
+	void Transfer() noexcept;
+
+	size_t GetPendingSize() const noexcept {
+		return pending.size() - pending_position;
+	}
+
+	/* virtual methods from class CommandPool::Job */
+	void Run() noexcept override;
+	void OnFinished() noexcept override;
+	void OnPause() noexcept override;
+
+	/* virtual methods from class ResponseSink */
+	bool Write(const void *data, size_t length) noexcept override;
+	bool Throttle() noexcept override;
+};
+
+/**
+ * Run the command handler in the #Instance's #CommandPool if that is
+ * possible, or else call it directly.  The pool is not used inside
+ * command lists, and not for database plugins which don't support
+ * concurrent reads.
+ *
+ * @param stats if the command is moved to the pool, then its usage
+ * is added to this object after it has finished
+ *
+ * Throws on error (only if the handler is called directly).
+ */
+CommandResult
+RunInCommandPool(Client &client, Request args, Response &r,
+		 PoolBackgroundCommand::Handler handler,
+		 CommandStats &stats);
+
+#endif
@@ -18,61 +18,80 @@
  */
 
 #include "Client.hxx"
+#include "Socket.hxx"
 #include "Config.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "util/StringStrip.hxx"
 
+#include <stdexcept>
+
 #include <string.h>
 
-BufferedSocket::InputResult
-Client::OnSocketInput(void *data, size_t length) noexcept
+bool
+Client::ProcessInput() noexcept
 {
-	if (background_command)
-		return InputResult::PAUSE;
+	size_t position = 0;
+
+	while (!background_command) {
+		char *p = input.data() + position;
+		char *newline = (char *)memchr(p, '\n', input.size() - position);
+		if (newline == nullptr)
+			break;
 
-	char *p = (char *)data;
-	char *newline = (char *)memchr(p, '\n', length);
-	if (newline == nullptr)
-		return InputResult::MORE;
+		timeout_event.Schedule(client_timeout);
 
-	timeout_event.Schedule(client_timeout);
+		position = newline + 1 - input.data();
 
-	BufferedSocket::ConsumeInput(newline + 1 - p);
+		/* skip whitespace at the end of the line */
+		char *end = StripRight(p, newline);
 
-	/* skip whitespace at the end of the line */
-	char *end = StripRight(p, newline);
+		/* terminate the string at the end of the line */
+		*end = 0;
 
-	/* terminate the string at the end of the line */
-	*end = 0;
+		CommandResult result = ProcessLine(p);
+		switch (result) {
+		case CommandResult::OK:
+		case CommandResult::ERROR:
+			EndResponse();
+			break;
 
-	CommandResult result = ProcessLine(p);
-	switch (result) {
-	case CommandResult::OK:
-	case CommandResult::IDLE:
-	case CommandResult::BACKGROUND:
-	case CommandResult::ERROR:
-		break;
+		case CommandResult::IDLE:
+		case CommandResult::BACKGROUND:
+			/* the response will be finished later */
+			break;
 
-	case CommandResult::KILL:
-		partition->instance.Break();
-		Close();
-		return InputResult::CLOSED;
+		case CommandResult::KILL:
+			partition->instance.Break();
+			Close();
+			return false;
 
-	case CommandResult::FINISH:
-		if (Flush())
+		case CommandResult::FINISH:
+			/* send the pending response before closing
+			   the socket */
+			socket->Destroy(true);
+			socket = nullptr;
 			Close();
-		return InputResult::CLOSED;
+			return false;
 
-	case CommandResult::CLOSE:
-		Close();
-		return InputResult::CLOSED;
+		case CommandResult::CLOSE:
+			Close();
+			return false;
+		}
+
+		if (IsExpired()) {
+			Close();
+			return false;
+		}
 	}
 
-	if (IsExpired()) {
-		Close();
-		return InputResult::CLOSED;
+	input.erase(0, position);
+
+	if (input.size() >= ClientSocket::MAX_INPUT_SIZE &&
+	    memchr(input.data(), '\n', input.size()) == nullptr) {
+		OnSocketError(std::make_exception_ptr(std::runtime_error("Input buffer is full")));
+		return false;
 	}
 
-	return InputResult::AGAIN;
+	return true;
 }
@@ -21,6 +21,19 @@
 #include "Client.hxx"
 #include "util/FormatString.hxx"
 #include "util/AllocatedString.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringView.hxx"
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include "system/UniqueFileDescriptor.hxx"
+
+#include <unistd.h>
+#endif
 
 TagMask
 Response::GetTagMask() const noexcept
@@ -31,18 +44,73 @@ Response::GetTagMask() const noexcept
 bool
 Response::Write(const void *data, size_t length) noexcept
 {
-	return client.Write(data, length);
+	written_bytes += length;
+
+	const bool result = sink != nullptr
+		? sink->Write(data, length)
+		: client.Write(data, length);
+
+	if (capture != nullptr && !capture_failed) {
+		if (result && capture->size() + length <= capture_limit)
+			capture->append((const char *)data, length);
+		else
+			capture_failed = true;
+	}
+
+	return result;
+}
+
+bool
+Response::Throttle() noexcept
+{
+	const bool result = sink == nullptr || sink->Throttle();
+	if (!result && capture != nullptr)
+		/* the caller will stop producing output */
+		capture_failed = true;
+
+	return result;
 }
 
 bool
 Response::Write(const char *data) noexcept
 {
-	return client.Write(data);
+	return Write(data, strlen(data));
+}
+
+bool
+Response::WriteField(StringView name, StringView value) noexcept
+{
+	char buffer[1024];
+	if (name.size + value.size + 3 > sizeof(buffer))
+		return Write(name.data, name.size) &&
+			Write(": ", 2) &&
+			Write(value.data, value.size) &&
+			Write("\n", 1);
+
+	char *p = std::copy_n(name.data, name.size, buffer);
+	*p++ = ':';
+	*p++ = ' ';
+	p = std::copy_n(value.data, value.size, p);
+	*p++ = '\n';
+
+	return Write(buffer, p - buffer);
 }
 
 bool
 Response::FormatV(const char *fmt, va_list args) noexcept
 {
+	/* most lines are short: try to format into a stack buffer
+	   first, to avoid the heap allocation */
+	char buffer[1024];
+
+	va_list tmp;
+	va_copy(tmp, args);
+	const int length = vsnprintf(buffer, sizeof(buffer), fmt, tmp);
+	va_end(tmp);
+
+	if (length >= 0 && size_t(length) < sizeof(buffer))
+		return Write(buffer, length);
+
 	return Write(FormatStringV(fmt, args).c_str());
 }
 
@@ -66,6 +134,40 @@ Response::WriteBinary(ConstBuffer<void> payload) noexcept
 		Write("\n");
 }
 
+#ifndef _WIN32
+
+bool
+Response::WriteBinaryFile(UniqueFileDescriptor &&fd, off_t offset,
+			  size_t size) noexcept
+{
+	assert(size <= MAX_BINARY_SIZE);
+
+#ifdef __linux__
+	if (sink == nullptr && !client.IsCompressing()) {
+		if (!Format("binary: %zu\n", size) ||
+		    !client.WriteFile(std::move(fd), offset, size))
+			return false;
+
+		written_bytes += size;
+
+		if (capture != nullptr)
+			/* the file contents bypass Write() */
+			capture_failed = true;
+
+		return Write("\n");
+	}
+#endif
+
+	uint8_t buffer[MAX_BINARY_SIZE];
+	ssize_t nbytes = pread(fd.Get(), buffer, size, offset);
+	if (nbytes < 0)
+		nbytes = 0;
+
+	return WriteBinary({buffer, size_t(nbytes)});
+}
+
+#endif
+
 void
 Response::Error(enum ack code, const char *msg) noexcept
 {
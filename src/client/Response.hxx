@@ -23,12 +23,42 @@
 #include "protocol/Ack.hxx"
 #include "util/Compiler.h"
 
+#include <string>
+
 #include <stddef.h>
 #include <stdarg.h>
 
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
 template<typename T> struct ConstBuffer;
+struct StringView;
 class Client;
 class TagMask;
+class UniqueFileDescriptor;
+
+/**
+ * An object which receives a #Response instead of the #Client.  This
+ * is used by #PoolBackgroundCommand, which must not access the
+ * client's socket from a worker thread.
+ */
+class ResponseSink {
+protected:
+	~ResponseSink() = default;
+
+public:
+	/**
+	 * @return false if the response is not wanted anymore (the
+	 * client has been closed or its output buffer is full)
+	 */
+	virtual bool Write(const void *data, size_t length) noexcept = 0;
+
+	/**
+	 * See Response::Throttle().
+	 */
+	virtual bool Throttle() noexcept = 0;
+};
 
 class Response {
 	Client &client;
@@ -44,10 +74,44 @@ class Response {
 	 */
 	const char *command = "";
 
+	/**
+	 * If not nullptr, then the response is written to this
+	 * object instead of the client.
+	 */
+	ResponseSink *const sink = nullptr;
+
+	/**
+	 * The number of bytes written so far.  Used for
+	 * #CommandStats.
+	 */
+	size_t written_bytes = 0;
+
+	/**
+	 * If not nullptr, then all data written is also appended to
+	 * this string.  See StartCapture().
+	 */
+	std::string *capture = nullptr;
+
+	/**
+	 * The maximum size of #capture.
+	 */
+	size_t capture_limit;
+
+	/**
+	 * Set if #capture is incomplete, i.e. it became too large, or
+	 * the client didn't accept all of the response.
+	 */
+	bool capture_failed;
+
 public:
 	Response(Client &_client, unsigned _list_index) noexcept
 		:client(_client), list_index(_list_index) {}
 
+	Response(Client &_client, unsigned _list_index,
+		 ResponseSink &_sink) noexcept
+		:client(_client), list_index(_list_index),
+		 sink(&_sink) {}
+
 	Response(const Response &) = delete;
 	Response &operator=(const Response &) = delete;
 
@@ -72,8 +136,67 @@ public:
 		command = _command;
 	}
 
+	const char *GetCommand() const noexcept {
+		return command;
+	}
+
+	size_t GetWrittenBytes() const noexcept {
+		return written_bytes;
+	}
+
+	/**
+	 * Can this response be flow-controlled with Throttle()?  If
+	 * not, then Throttle() never blocks, and the whole response
+	 * is buffered anyway.
+	 */
+	bool IsStreaming() const noexcept {
+		return sink != nullptr;
+	}
+
+	/**
+	 * Wait until the client has received most of the data which
+	 * was written so far.  This must only be called while no
+	 * lock (e.g. #db_mutex) is being held, because the main
+	 * thread may need it to make progress.
+	 *
+	 * @return false if the response is not wanted anymore; the
+	 * caller should stop producing output
+	 */
+	bool Throttle() noexcept;
+
+	/**
+	 * Begin collecting a copy of everything written to this
+	 * response in the given string (e.g. for the #QueryCache).
+	 *
+	 * @param limit the maximum size; if the response becomes
+	 * larger, the capture fails, but the response is still
+	 * written
+	 */
+	void StartCapture(std::string &dest, size_t limit) noexcept {
+		capture = &dest;
+		capture_limit = limit;
+		capture_failed = false;
+	}
+
+	/**
+	 * Stop collecting data.
+	 *
+	 * @return true if the string contains the complete response
+	 * written since StartCapture()
+	 */
+	bool StopCapture() noexcept {
+		capture = nullptr;
+		return !capture_failed;
+	}
+
 	bool Write(const void *data, size_t length) noexcept;
 	bool Write(const char *data) noexcept;
+
+	/**
+	 * Write a "NAME: VALUE" line.  This is cheaper than
+	 * Format(), because it bypasses the printf() machinery.
+	 */
+	bool WriteField(StringView name, StringView value) noexcept;
 	bool FormatV(const char *fmt, va_list args) noexcept;
 	bool Format(const char *fmt, ...) noexcept;
 
@@ -87,6 +210,22 @@ public:
 	 */
 	bool WriteBinary(ConstBuffer<void> payload) noexcept;
 
+#ifndef _WIN32
+	/**
+	 * Like WriteBinary(), but the chunk is read from a regular
+	 * file.  On Linux, it is sent with sendfile() and does not
+	 * pass through the output buffer.
+	 *
+	 * @param fd the file; it is closed after the chunk has been
+	 * sent
+	 * @param size the size of the chunk; the file must be at
+	 * least offset+size bytes large
+	 * @return true on success
+	 */
+	bool WriteBinaryFile(UniqueFileDescriptor &&fd, off_t offset,
+			     size_t size) noexcept;
+#endif
+
 	void Error(enum ack code, const char *msg) noexcept;
 	void FormatError(enum ack code, const char *fmt, ...) noexcept;
 };
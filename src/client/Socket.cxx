@@ -0,0 +1,277 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Socket.hxx"
+#include "event/Call.hxx"
+#include "event/Loop.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+
+#include <stdexcept>
+
+ClientSocket::ClientSocket(EventLoop &_loop, UniqueSocketDescriptor &&_fd,
+			   DeferEvent &_notify,
+			   size_t _max_output_size) noexcept
+	:FullyBufferedSocket(_fd.Release(), _loop,
+			     16384, _max_output_size),
+	 notify(_notify),
+	 defer_output(_loop, BIND_THIS_METHOD(OnDeferredOutput)),
+	 defer_resume(_loop, BIND_THIS_METHOD(OnDeferredResume)),
+	 max_output_size(_max_output_size)
+{
+}
+
+ClientSocket::~ClientSocket() noexcept
+{
+	if (IsDefined())
+		FullyBufferedSocket::Close();
+}
+
+ClientSocket *
+ClientSocket::Create(EventLoop &loop, UniqueSocketDescriptor fd,
+		     DeferEvent &notify, size_t max_output_size) noexcept
+{
+	ClientSocket *s;
+	BlockingCall(loop, [&](){
+			s = new ClientSocket(loop, std::move(fd), notify,
+					     max_output_size);
+		});
+	return s;
+}
+
+void
+ClientSocket::Destroy(bool flush) noexcept
+{
+	BlockingCall(GetEventLoop(), [this, flush](){
+			if (flush && IsDefined()) {
+				TransferOutput();
+				if (IsDefined())
+					Flush();
+			}
+
+			delete this;
+		});
+}
+
+ClientSocket::Events
+ClientSocket::TakeEvents(std::string &dest, size_t max_input) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (!input.empty() && dest.size() < max_input) {
+		dest.append(input);
+		input.clear();
+
+		if (input_paused) {
+			input_paused = false;
+			defer_resume.Schedule();
+		}
+	}
+
+	return {
+		std::exchange(error, nullptr),
+		std::exchange(closed, false),
+		std::exchange(drained, false),
+	};
+}
+
+bool
+ClientSocket::Write(const void *data, size_t length) noexcept
+{
+	if (GetEventLoop().IsInside())
+		/* same thread: no need to queue the data */
+		return IsDefined() && FullyBufferedSocket::Write(data, length);
+
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (error || closed)
+		return false;
+
+	if (output_size + length > max_output_size) {
+		error = std::make_exception_ptr(std::runtime_error("Output buffer is full"));
+		Notify();
+		return false;
+	}
+
+	if (output.empty())
+		output.emplace_back();
+
+	output.back().data.append((const char *)data, length);
+	output_size += length;
+	output_empty = false;
+
+	defer_output.Schedule();
+	return true;
+}
+
+#ifdef __linux__
+
+bool
+ClientSocket::WriteFile(UniqueFileDescriptor &&file_fd, off_t offset,
+			size_t length) noexcept
+{
+	if (GetEventLoop().IsInside())
+		return IsDefined() &&
+			FullyBufferedSocket::WriteFile(std::move(file_fd),
+						       offset, length);
+
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (error || closed)
+		return false;
+
+	output.emplace_back();
+	auto &chunk = output.back();
+	chunk.fd = std::move(file_fd);
+	chunk.offset = offset;
+	chunk.length = length;
+	output_empty = false;
+
+	defer_output.Schedule();
+	return true;
+}
+
+#endif
+
+bool
+ClientSocket::IsOutputEmpty() const noexcept
+{
+	if (GetEventLoop().IsInside())
+		return FullyBufferedSocket::IsOutputEmpty();
+
+	const std::lock_guard<Mutex> lock(mutex);
+	return output_empty;
+}
+
+size_t
+ClientSocket::GetMemoryUsage() noexcept
+{
+	size_t size = 0;
+
+	try {
+		BlockingCall(GetEventLoop(), [this, &size](){
+				if (IsDefined())
+					size += FullyBufferedSocket::GetOutputBufferSize();
+
+				const std::lock_guard<Mutex> lock(mutex);
+				size += input.capacity() + output_size;
+			});
+	} catch (...) {
+		/* out of memory; ignore */
+	}
+
+	return size;
+}
+
+void
+ClientSocket::TransferOutput() noexcept
+{
+	std::list<OutputChunk> chunks;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		chunks.swap(output);
+		output_size = 0;
+	}
+
+	for (auto &i : chunks) {
+#ifdef __linux__
+		if (i.fd.IsDefined() &&
+		    !FullyBufferedSocket::WriteFile(std::move(i.fd),
+						    i.offset, i.length))
+			return;
+#endif
+
+		if (!FullyBufferedSocket::Write(i.data.data(), i.data.size()))
+			return;
+	}
+
+	if (FullyBufferedSocket::IsOutputEmpty())
+		/* nothing was written; FullyBufferedSocket will not
+		   call OnSocketOutputDrained() */
+		OnSocketOutputDrained();
+}
+
+void
+ClientSocket::OnDeferredOutput() noexcept
+{
+	if (IsDefined())
+		TransferOutput();
+}
+
+void
+ClientSocket::OnDeferredResume() noexcept
+{
+	if (IsDefined())
+		ResumeInput();
+}
+
+void
+ClientSocket::OnSocketOutputDrained() noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (output.empty()) {
+		output_empty = true;
+		drained = true;
+		Notify();
+	}
+}
+
+BufferedSocket::InputResult
+ClientSocket::OnSocketInput(void *data, size_t length) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (input.size() >= MAX_INPUT_SIZE) {
+		/* the client is busy; wait until TakeEvents() has
+		   collected the data */
+		input_paused = true;
+		return InputResult::PAUSE;
+	}
+
+	const bool was_empty = input.empty();
+	input.append((const char *)data, length);
+	ConsumeInput(length);
+
+	if (was_empty)
+		Notify();
+
+	return InputResult::MORE;
+}
+
+void
+ClientSocket::OnSocketError(std::exception_ptr ep) noexcept
+{
+	FullyBufferedSocket::Close();
+
+	const std::lock_guard<Mutex> lock(mutex);
+	error = std::move(ep);
+	Notify();
+}
+
+void
+ClientSocket::OnSocketClosed() noexcept
+{
+	FullyBufferedSocket::Close();
+
+	const std::lock_guard<Mutex> lock(mutex);
+	closed = true;
+	Notify();
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_CLIENT_SOCKET_HXX
+#define MPD_CLIENT_SOCKET_HXX
+
+#include "event/FullyBufferedSocket.hxx"
+#include "event/DeferEvent.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Compiler.h"
+
+#include <exception>
+#include <list>
+#include <string>
+
+class UniqueSocketDescriptor;
+
+/**
+ * The socket of a #Client.  It may live in a different #EventLoop
+ * (i.e. a client I/O thread, see #ClientThreads) than the #Client
+ * itself, which lives in the main thread.  The #Client only uses the
+ * thread-safe methods of this class; received data, errors and
+ * "output drained" notifications are collected in mutex-protected
+ * fields and announced by scheduling the #DeferEvent passed to the
+ * constructor.
+ *
+ * Use Create() and Destroy() to construct and delete instances,
+ * because those must run in the socket's #EventLoop.
+ */
+class ClientSocket final : FullyBufferedSocket {
+	/**
+	 * Scheduled when new events are pending; it belongs to the
+	 * #Client's #EventLoop.
+	 */
+	DeferEvent &notify;
+
+	/**
+	 * Moves #output to the #FullyBufferedSocket.
+	 */
+	DeferEvent defer_output;
+
+	/**
+	 * Resumes reading from the socket after TakeEvents() has
+	 * collected the #input buffer.
+	 */
+	DeferEvent defer_resume;
+
+	mutable Mutex mutex;
+
+	/**
+	 * Received data which has not yet been collected by
+	 * TakeEvents().
+	 */
+	std::string input;
+
+	/**
+	 * Data written by another thread which has not yet been
+	 * moved to the #FullyBufferedSocket.
+	 */
+	struct OutputChunk {
+#ifdef __linux__
+		/**
+		 * A file to be sent with sendfile() before #data.
+		 */
+		UniqueFileDescriptor fd;
+		off_t offset;
+		size_t length;
+#endif
+
+		std::string data;
+	};
+
+	std::list<OutputChunk> output;
+
+	/**
+	 * The total size of all #OutputChunk::data strings.
+	 */
+	size_t output_size = 0;
+
+	const size_t max_output_size;
+
+	std::exception_ptr error;
+
+	bool closed = false, drained = false;
+
+	/**
+	 * Has reading been paused because #input is full?
+	 */
+	bool input_paused = false;
+
+	/**
+	 * Are #output and the #FullyBufferedSocket's buffer empty?
+	 */
+	bool output_empty = true;
+
+	ClientSocket(EventLoop &_loop, UniqueSocketDescriptor &&_fd,
+		     DeferEvent &_notify, size_t _max_output_size) noexcept;
+
+	~ClientSocket() noexcept;
+
+public:
+	/**
+	 * The maximum size of the #input buffer; reading is paused
+	 * until TakeEvents() collects it.
+	 */
+	static constexpr size_t MAX_INPUT_SIZE = 8192;
+
+	/**
+	 * Construct a new instance in the given #EventLoop.  May be
+	 * called from any thread.
+	 */
+	static ClientSocket *Create(EventLoop &loop, UniqueSocketDescriptor fd,
+				    DeferEvent &notify,
+				    size_t max_output_size) noexcept;
+
+	/**
+	 * Close and delete the socket in its #EventLoop.  May be
+	 * called from any thread; after returning, the #DeferEvent
+	 * passed to Create() will not be scheduled anymore.
+	 *
+	 * @param flush attempt to send pending output before closing
+	 */
+	void Destroy(bool flush) noexcept;
+
+	struct Events {
+		std::exception_ptr error;
+		bool closed, drained;
+	};
+
+	/**
+	 * Collect pending events and move received data to the end
+	 * of the given string.  This method is thread-safe.
+	 *
+	 * @param max_input the maximum size of #dest; if it is
+	 * already larger, no data is moved, and reading remains
+	 * paused until the next call
+	 */
+	Events TakeEvents(std::string &dest, size_t max_input) noexcept;
+
+	/**
+	 * Queue data for sending.  This method is thread-safe.
+	 *
+	 * @return false on error (which will be reported by
+	 * TakeEvents())
+	 */
+	bool Write(const void *data, size_t length) noexcept;
+
+#ifdef __linux__
+	/**
+	 * Queue a portion of a file for sendfile().  This method is
+	 * thread-safe.
+	 */
+	bool WriteFile(UniqueFileDescriptor &&file_fd, off_t offset,
+		       size_t length) noexcept;
+#endif
+
+	/**
+	 * Has all output been sent to the socket?  This method is
+	 * thread-safe.
+	 */
+	gcc_pure
+	bool IsOutputEmpty() const noexcept;
+
+	/**
+	 * Determine the number of bytes allocated by the input and
+	 * output buffers.  May be called from any thread; it blocks
+	 * until the socket's #EventLoop has answered.
+	 */
+	size_t GetMemoryUsage() noexcept;
+
+private:
+	void Notify() noexcept {
+		notify.Schedule();
+	}
+
+	/**
+	 * Move all #output chunks to the #FullyBufferedSocket.
+	 */
+	void TransferOutput() noexcept;
+
+	/* DeferEvent callbacks */
+	void OnDeferredOutput() noexcept;
+	void OnDeferredResume() noexcept;
+
+	/* virtual methods from class FullyBufferedSocket */
+	void OnSocketOutputDrained() noexcept override;
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(void *data, size_t length) noexcept override;
+	void OnSocketError(std::exception_ptr ep) noexcept override;
+	void OnSocketClosed() noexcept override;
+};
+
+#endif
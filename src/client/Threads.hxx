@@ -0,0 +1,57 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_CLIENT_THREADS_HXX
+#define MPD_CLIENT_THREADS_HXX
+
+#include "event/Thread.hxx"
+
+#include <list>
+
+/**
+ * A set of threads which perform the socket I/O of clients (see
+ * #ClientSocket).  New connections are assigned to them in a
+ * round-robin fashion; the commands are still executed in the main
+ * thread.
+ */
+class ClientThreads {
+	std::list<EventThread> threads;
+
+	std::list<EventThread>::iterator next;
+
+public:
+	explicit ClientThreads(unsigned n);
+	~ClientThreads() noexcept;
+
+	ClientThreads(const ClientThreads &) = delete;
+	ClientThreads &operator=(const ClientThreads &) = delete;
+
+	/**
+	 * Throws on error.
+	 */
+	void Start();
+
+	/**
+	 * Choose the #EventLoop for the next client connection.
+	 */
+	EventLoop &Next() noexcept;
+};
+
+#endif
@@ -18,14 +18,42 @@
  */
 
 #include "Client.hxx"
+#include "Socket.hxx"
+#include "Compression.hxx"
+#include "Domain.hxx"
+#include "Log.hxx"
 
 #include <string.h>
 
 bool
-Client::Write(const void *data, size_t length) noexcept
+Client::WriteRaw(const void *data, size_t length) noexcept
 {
 	/* if the client is going to be closed, do nothing */
-	return !IsExpired() && FullyBufferedSocket::Write(data, length);
+	return !IsExpired() && socket->Write(data, length);
+}
+
+bool
+Client::IsOutputEmpty() const noexcept
+{
+	return IsExpired() || socket->IsOutputEmpty();
+}
+
+bool
+Client::Write(const void *data, size_t length) noexcept
+{
+	if (compression == nullptr || IsExpired())
+		return WriteRaw(data, length);
+
+	try {
+		compression->Write(data, length);
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "[%u] compression failed", num);
+		SetExpired();
+		return false;
+	}
+
+	return !IsExpired();
 }
 
 bool
@@ -33,3 +61,15 @@ Client::Write(const char *data) noexcept
 {
 	return Write(data, strlen(data));
 }
+
+#ifdef __linux__
+
+bool
+Client::WriteFile(UniqueFileDescriptor &&file_fd, off_t offset,
+		  size_t length) noexcept
+{
+	return !IsExpired() &&
+		socket->WriteFile(std::move(file_fd), offset, length);
+}
+
+#endif
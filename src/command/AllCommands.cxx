@@ -20,6 +20,7 @@
 #include "config.h"
 #include "AllCommands.hxx"
 #include "CommandError.hxx"
+#include "CommandStats.hxx"
 #include "Request.hxx"
 #include "QueueCommands.hxx"
 #include "TagCommands.hxx"
@@ -41,7 +42,9 @@
 #include "Instance.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/PoolBackgroundCommand.hxx"
 #include "util/Tokenizer.hxx"
+#include "util/PerfectHash.hxx"
 #include "util/StringAPI.hxx"
 
 #ifdef ENABLE_SQLITE
@@ -68,6 +71,12 @@ struct command {
 	int min;
 	int max;
 	CommandResult (*handler)(Client &client, Request request, Response &response);
+
+	/**
+	 * Run this command in the #CommandPool?  This is only
+	 * allowed for read-only commands.
+	 */
+	bool pool = false;
 };
 
 /* don't be fooled, this is the command handler for "commands" command */
@@ -77,6 +86,9 @@ handle_commands(Client &client, Request request, Response &response);
 static CommandResult
 handle_not_commands(Client &client, Request request, Response &response);
 
+static CommandResult
+handle_commandstats(Client &client, Request request, Response &response);
+
 /**
  * The command registry.
  *
@@ -87,37 +99,45 @@ static constexpr struct command commands[] = {
 	{ "addid", PERMISSION_ADD, 1, 2, handle_addid },
 	{ "addtagid", PERMISSION_ADD, 3, 3, handle_addtagid },
 	{ "albumart", PERMISSION_READ, 2, 2, handle_album_art },
+#ifdef ENABLE_ALLOC_STATS
+	{ "allocstats", PERMISSION_READ, 0, 0, handle_allocstats },
+#endif
+	{ "audiotrace", PERMISSION_READ, 0, 0, handle_audiotrace },
 	{ "channels", PERMISSION_READ, 0, 0, handle_channels },
 	{ "clear", PERMISSION_CONTROL, 0, 0, handle_clear },
 	{ "clearerror", PERMISSION_CONTROL, 0, 0, handle_clearerror },
 	{ "cleartagid", PERMISSION_ADD, 1, 2, handle_cleartagid },
 	{ "close", PERMISSION_NONE, -1, -1, handle_close },
 	{ "commands", PERMISSION_NONE, 0, 0, handle_commands },
+	{ "commandstats", PERMISSION_READ, 0, 0, handle_commandstats },
+	{ "compression", PERMISSION_NONE, 0, 2, handle_compression },
 	{ "config", PERMISSION_ADMIN, 0, 0, handle_config },
 	{ "consume", PERMISSION_CONTROL, 1, 1, handle_consume },
 #ifdef ENABLE_DATABASE
-	{ "count", PERMISSION_READ, 1, -1, handle_count },
+	{ "count", PERMISSION_READ, 1, -1, handle_count, true },
 #endif
 	{ "crossfade", PERMISSION_CONTROL, 1, 1, handle_crossfade },
 	{ "currentsong", PERMISSION_READ, 0, 0, handle_currentsong },
 	{ "decoders", PERMISSION_READ, 0, 0, handle_decoders },
+	{ "decoderstats", PERMISSION_READ, 0, 0, handle_decoderstats },
 	{ "delete", PERMISSION_CONTROL, 1, 1, handle_delete },
 	{ "deleteid", PERMISSION_CONTROL, 1, 1, handle_deleteid },
 	{ "disableoutput", PERMISSION_ADMIN, 1, 1, handle_disableoutput },
 	{ "enableoutput", PERMISSION_ADMIN, 1, 1, handle_enableoutput },
 #ifdef ENABLE_DATABASE
-	{ "find", PERMISSION_READ, 1, -1, handle_find },
+	{ "find", PERMISSION_READ, 1, -1, handle_find, true },
 	{ "findadd", PERMISSION_ADD, 1, -1, handle_findadd},
 #endif
 #ifdef ENABLE_CHROMAPRINT
 	{ "getfingerprint", PERMISSION_READ, 1, 1, handle_getfingerprint },
 #endif
 	{ "idle", PERMISSION_READ, 0, -1, handle_idle },
+	{ "idlestatus", PERMISSION_READ, 0, -1, handle_idlestatus },
 	{ "kill", PERMISSION_ADMIN, -1, -1, handle_kill },
 #ifdef ENABLE_DATABASE
-	{ "list", PERMISSION_READ, 1, -1, handle_list },
+	{ "list", PERMISSION_READ, 1, -1, handle_list, true },
 	{ "listall", PERMISSION_READ, 0, 1, handle_listall },
-	{ "listallinfo", PERMISSION_READ, 0, 1, handle_listallinfo },
+	{ "listallinfo", PERMISSION_READ, 0, 1, handle_listallinfo, true },
 #endif
 	{ "listfiles", PERMISSION_READ, 0, 1, handle_listfiles },
 #ifdef ENABLE_DATABASE
@@ -131,7 +151,8 @@ static constexpr struct command commands[] = {
 	{ "listplaylistinfo", PERMISSION_READ, 1, 1, handle_listplaylistinfo },
 	{ "listplaylists", PERMISSION_READ, 0, 0, handle_listplaylists },
 	{ "load", PERMISSION_ADD, 1, 2, handle_load },
-	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo },
+	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo, true },
+	{ "memory", PERMISSION_READ, 0, 0, handle_memory },
 	{ "mixrampdb", PERMISSION_CONTROL, 1, 1, handle_mixrampdb },
 	{ "mixrampdelay", PERMISSION_CONTROL, 1, 1, handle_mixrampdelay },
 #ifdef ENABLE_DATABASE
@@ -144,6 +165,7 @@ static constexpr struct command commands[] = {
 	{ "notcommands", PERMISSION_NONE, 0, 0, handle_not_commands },
 	{ "outputs", PERMISSION_READ, 0, 0, handle_devices },
 	{ "outputset", PERMISSION_ADMIN, 3, 3, handle_outputset },
+	{ "outputstats", PERMISSION_READ, 0, 0, handle_outputstats },
 	{ "partition", PERMISSION_READ, 1, 1, handle_partition },
 	{ "password", PERMISSION_NONE, 1, 1, handle_password },
 	{ "pause", PERMISSION_CONTROL, 0, 1, handle_pause },
@@ -179,7 +201,7 @@ static constexpr struct command commands[] = {
 	{ "rm", PERMISSION_CONTROL, 1, 1, handle_rm },
 	{ "save", PERMISSION_CONTROL, 1, 1, handle_save },
 #ifdef ENABLE_DATABASE
-	{ "search", PERMISSION_READ, 1, -1, handle_search },
+	{ "search", PERMISSION_READ, 1, -1, handle_search, true },
 	{ "searchadd", PERMISSION_ADD, 1, -1, handle_searchadd },
 	{ "searchaddpl", PERMISSION_CONTROL, 2, -1, handle_searchaddpl },
 #endif
@@ -212,6 +234,19 @@ static constexpr struct command commands[] = {
 
 static constexpr unsigned num_commands = std::size(commands);
 
+/**
+ * A perfect hash table for command_lookup(), generated at compile
+ * time.
+ */
+static constexpr PerfectHashTable<num_commands> command_hash([](size_t i){
+		return commands[i].cmd;
+	});
+
+/**
+ * Usage statistics for each item in #commands.
+ */
+static CommandStats command_stats[num_commands];
+
 gcc_pure
 static bool
 command_available(gcc_unused const Partition &partition,
@@ -282,6 +317,34 @@ handle_not_commands(Client &client, gcc_unused Request request, Response &r)
 	return PrintUnavailableCommands(r, client.GetPermission());
 }
 
+static CommandResult
+handle_commandstats(gcc_unused Client &client, gcc_unused Request request,
+		    Response &r)
+{
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (!command_stats[i].IsEmpty())
+			command_stats[i].Print(r, commands[i].cmd);
+
+	return CommandResult::OK;
+}
+
+void
+command_stats_log() noexcept
+{
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (!command_stats[i].IsEmpty())
+			command_stats[i].Log(commands[i].cmd);
+}
+
+void
+command_stats_for_each(const std::function<void(const char *name,
+						const CommandStats &stats)> &f)
+{
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (!command_stats[i].IsEmpty())
+			f(commands[i].cmd, command_stats[i]);
+}
+
 void
 command_init() noexcept
 {
@@ -296,22 +359,10 @@ gcc_pure
 static const struct command *
 command_lookup(const char *name) noexcept
 {
-	unsigned a = 0, b = num_commands, i;
-
-	/* binary search */
-	do {
-		i = (a + b) / 2;
-
-		const auto cmp = strcmp(name, commands[i].cmd);
-		if (cmp == 0)
-			return &commands[i];
-		else if (cmp < 0)
-			b = i;
-		else if (cmp > 0)
-			a = i + 1;
-	} while (a < b);
-
-	return nullptr;
+	const size_t i = command_hash.Lookup(name);
+	return i < num_commands && StringIsEqual(name, commands[i].cmd)
+		? &commands[i]
+		: nullptr;
 }
 
 static bool
@@ -421,7 +472,29 @@ command_process(Client &client, unsigned num, char *line) noexcept
 		if (cmd == nullptr)
 			return CommandResult::ERROR;
 
-		return cmd->handler(client, args, r);
+		auto &stats = command_stats[cmd - commands];
+		const auto start_time = std::chrono::steady_clock::now();
+
+		CommandResult result;
+		try {
+			result = cmd->pool
+				? RunInCommandPool(client, args, r,
+						   cmd->handler, stats)
+				: cmd->handler(client, args, r);
+		} catch (...) {
+			stats.Add(std::chrono::steady_clock::now() - start_time,
+				  r.GetWrittenBytes(), true);
+			throw;
+		}
+
+		/* a command which was moved to the #CommandPool
+		   accounts for itself after it has finished */
+		if (!cmd->pool || result != CommandResult::BACKGROUND)
+			stats.Add(std::chrono::steady_clock::now() - start_time,
+				  r.GetWrittenBytes(),
+				  result == CommandResult::ERROR);
+
+		return result;
 	} catch (...) {
 		PrintError(r, std::current_exception());
 		return CommandResult::ERROR;
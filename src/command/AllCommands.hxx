@@ -22,7 +22,10 @@
 
 #include "CommandResult.hxx"
 
+#include <functional>
+
 class Client;
+class CommandStats;
 
 void
 command_init() noexcept;
@@ -30,4 +33,19 @@ command_init() noexcept;
 CommandResult
 command_process(Client &client, unsigned num, char *line) noexcept;
 
+/**
+ * Write the usage statistics of all commands which have been called
+ * at least once to the log file.
+ */
+void
+command_stats_log() noexcept;
+
+/**
+ * Invoke the callback for each command which has been called at least
+ * once.
+ */
+void
+command_stats_for_each(const std::function<void(const char *name,
+						const CommandStats &stats)> &f);
+
 #endif
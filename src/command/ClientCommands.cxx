@@ -25,6 +25,9 @@
 #include "TagPrint.hxx"
 #include "tag/ParseName.hxx"
 #include "util/StringAPI.hxx"
+#include "config.h"
+
+#include <stdexcept>
 
 CommandResult
 handle_close(gcc_unused Client &client, gcc_unused Request args,
@@ -109,3 +112,37 @@ handle_tagtypes(Client &client, Request request, Response &r)
 		return CommandResult::ERROR;
 	}
 }
+
+/**
+ * Responses up to this size are not compressed unless the client
+ * specifies a different threshold.
+ */
+static constexpr size_t DEFAULT_COMPRESSION_THRESHOLD = 4096;
+
+CommandResult
+handle_compression(Client &client, Request request, Response &r)
+{
+	if (request.empty()) {
+		/* list the supported algorithms */
+#ifdef ENABLE_ZLIB
+		r.Write("compression: gzip\n");
+#endif
+#ifdef ENABLE_ZSTD
+		r.Write("compression: zstd\n");
+#endif
+		return CommandResult::OK;
+	}
+
+	const size_t threshold = request.size > 1
+		? request.ParseUnsigned(1)
+		: DEFAULT_COMPRESSION_THRESHOLD;
+
+	try {
+		client.SetCompression(request.front(), threshold);
+	} catch (const std::invalid_argument &e) {
+		r.Error(ACK_ERROR_ARG, e.what());
+		return CommandResult::ERROR;
+	}
+
+	return CommandResult::OK;
+}
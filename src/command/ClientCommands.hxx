@@ -38,4 +38,7 @@ handle_password(Client &client, Request request, Response &response);
 CommandResult
 handle_tagtypes(Client &client, Request request, Response &response);
 
+CommandResult
+handle_compression(Client &client, Request request, Response &response);
+
 #endif
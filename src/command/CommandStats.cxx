@@ -0,0 +1,117 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "CommandStats.hxx"
+#include "AllCommands.hxx"
+#include "client/Response.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+#include <inttypes.h>
+
+static constexpr Domain command_stats_domain("command_stats");
+
+static constexpr struct {
+	std::chrono::microseconds limit;
+	const char *name;
+} latency_buckets[CommandStats::N_BUCKETS - 1] = {
+	{ std::chrono::microseconds(100), "100us" },
+	{ std::chrono::milliseconds(1), "1ms" },
+	{ std::chrono::milliseconds(10), "10ms" },
+	{ std::chrono::milliseconds(100), "100ms" },
+	{ std::chrono::seconds(1), "1s" },
+};
+
+std::chrono::microseconds
+CommandStats::GetBucketLimit(size_t i) noexcept
+{
+	assert(i < std::size(latency_buckets));
+
+	return latency_buckets[i].limit;
+}
+
+void
+CommandStats::Add(std::chrono::steady_clock::duration duration,
+		  size_t bytes, bool error) noexcept
+{
+	const auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration);
+
+	size_t bucket = 0;
+	while (bucket < std::size(latency_buckets) &&
+	       us > latency_buckets[bucket].limit)
+		++bucket;
+
+	n_calls.fetch_add(1, std::memory_order_relaxed);
+	if (error)
+		n_errors.fetch_add(1, std::memory_order_relaxed);
+	n_bytes.fetch_add(bytes, std::memory_order_relaxed);
+	total_time.fetch_add(us.count(), std::memory_order_relaxed);
+	histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+CommandStats::Print(Response &r, const char *name) const noexcept
+{
+	const uint64_t us = total_time.load(std::memory_order_relaxed);
+
+	r.Format("command: %s\n"
+		 "calls: %" PRIu64 "\n"
+		 "errors: %" PRIu64 "\n"
+		 "time: %" PRIu64 ".%06" PRIu64 "\n"
+		 "bytes: %" PRIu64 "\n",
+		 name,
+		 n_calls.load(std::memory_order_relaxed),
+		 n_errors.load(std::memory_order_relaxed),
+		 us / 1000000, us % 1000000,
+		 n_bytes.load(std::memory_order_relaxed));
+
+	for (size_t i = 0; i < std::size(latency_buckets); ++i)
+		r.Format("latency_%s: %" PRIu64 "\n",
+			 latency_buckets[i].name,
+			 histogram[i].load(std::memory_order_relaxed));
+
+	r.Format("latency_inf: %" PRIu64 "\n",
+		 histogram[N_BUCKETS - 1].load(std::memory_order_relaxed));
+}
+
+void
+CommandStats::Log(const char *name) const noexcept
+{
+	const uint64_t us = total_time.load(std::memory_order_relaxed);
+	const uint64_t calls = n_calls.load(std::memory_order_relaxed);
+
+	FormatDefault(command_stats_domain,
+		      "%s: %" PRIu64 " calls, %" PRIu64 " errors, "
+		      "%" PRIu64 " ms total, %" PRIu64 " us average, "
+		      "%" PRIu64 " bytes, %" PRIu64 " calls over 1s",
+		      name, calls,
+		      n_errors.load(std::memory_order_relaxed),
+		      us / 1000, calls > 0 ? us / calls : 0,
+		      n_bytes.load(std::memory_order_relaxed),
+		      histogram[N_BUCKETS - 1].load(std::memory_order_relaxed));
+}
+
+void
+CommandStatsLogger::OnTimer() noexcept
+{
+	command_stats_log();
+	timer.Schedule(interval);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_COMMAND_STATS_HXX
+#define MPD_COMMAND_STATS_HXX
+
+#include "event/TimerEvent.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Response;
+
+/**
+ * Usage statistics of one protocol command: the number of calls, the
+ * time spent and the number of bytes written.  All methods are
+ * thread-safe, because commands may be executed in a #CommandPool
+ * thread.
+ */
+class CommandStats {
+public:
+	/**
+	 * The number of latency histogram buckets.  Their upper
+	 * bounds are 100us, 1ms, 10ms, 100ms and 1s; the last bucket
+	 * has no upper bound.
+	 */
+	static constexpr size_t N_BUCKETS = 6;
+
+private:
+	std::atomic<uint64_t> n_calls{0}, n_errors{0}, n_bytes{0};
+
+	/**
+	 * The total time spent in microseconds.
+	 */
+	std::atomic<uint64_t> total_time{0};
+
+	std::array<std::atomic<uint64_t>, N_BUCKETS> histogram{};
+
+public:
+	/**
+	 * Account for one finished call.
+	 */
+	void Add(std::chrono::steady_clock::duration duration,
+		 size_t bytes, bool error) noexcept;
+
+	bool IsEmpty() const noexcept {
+		return n_calls.load(std::memory_order_relaxed) == 0;
+	}
+
+	uint64_t GetCalls() const noexcept {
+		return n_calls.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetErrors() const noexcept {
+		return n_errors.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetBytes() const noexcept {
+		return n_bytes.load(std::memory_order_relaxed);
+	}
+
+	std::chrono::microseconds GetTotalTime() const noexcept {
+		return std::chrono::microseconds(total_time.load(std::memory_order_relaxed));
+	}
+
+	/**
+	 * Returns the number of calls in the given histogram bucket.
+	 */
+	uint64_t GetBucket(size_t i) const noexcept {
+		return histogram[i].load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the upper bound of the given histogram bucket
+	 * (except for the last one, which has no upper bound).
+	 */
+	gcc_const
+	static std::chrono::microseconds GetBucketLimit(size_t i) noexcept;
+
+	/**
+	 * Print the statistics in the "commandstats" response
+	 * format.
+	 */
+	void Print(Response &r, const char *name) const noexcept;
+
+	/**
+	 * Write the statistics to the log file.
+	 */
+	void Log(const char *name) const noexcept;
+};
+
+/**
+ * Calls command_stats_log() periodically.
+ */
+class CommandStatsLogger final {
+	const std::chrono::steady_clock::duration interval;
+
+	TimerEvent timer;
+
+public:
+	CommandStatsLogger(EventLoop &loop,
+			   std::chrono::steady_clock::duration _interval) noexcept
+		:interval(_interval), timer(loop, BIND_THIS_METHOD(OnTimer)) {
+		timer.Schedule(interval);
+	}
+
+private:
+	void OnTimer() noexcept;
+};
+
+#endif
@@ -17,24 +17,38 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "DatabaseCommands.hxx"
 #include "Request.hxx"
 #include "db/DatabaseQueue.hxx"
 #include "db/DatabasePlaylist.hxx"
 #include "db/DatabasePrint.hxx"
 #include "db/Count.hxx"
+#include "db/Interface.hxx"
+#include "db/QueryCache.hxx"
 #include "db/Selection.hxx"
 #include "protocol/RangeArg.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "Instance.hxx"
+#include "tag/Mask.hxx"
 #include "tag/ParseName.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Exception.hxx"
 #include "util/StringAPI.hxx"
+#include "util/StringCompare.hxx"
 #include "util/ASCII.hxx"
+#include "time/ChronoUtil.hxx"
 #include "song/Filter.hxx"
 
+#ifdef ENABLE_SQLITE
+#include "StickerCommands.hxx"
+#endif
+
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
 CommandResult
@@ -68,13 +82,37 @@ ParseSortTag(const char *s)
 	return tag;
 }
 
+/**
+ * Parse the filter arguments and load the stickers it references.
+ *
+ * Throws #ProtocolError on error.
+ */
+static void
+ParseFilter(Client &client, SongFilter &filter, Request args, bool fold_case)
+{
+	try {
+		filter.Parse(args, fold_case);
+	} catch (...) {
+		throw ProtocolError(ACK_ERROR_ARG,
+				    GetFullMessage(std::current_exception()).c_str());
+	}
+	filter.Optimize();
+
+#ifdef ENABLE_SQLITE
+	LoadFilterStickers(client, filter);
+#else
+	(void)client;
+#endif
+}
+
 /**
  * Convert all remaining arguments to a #DatabaseSelection.
  *
  * @param filter a buffer to be used for DatabaseSelection::filter
  */
 static DatabaseSelection
-ParseDatabaseSelection(Request args, bool fold_case, SongFilter &filter)
+ParseDatabaseSelection(Client &client, Request args, bool fold_case,
+		       SongFilter &filter)
 {
 	RangeArg window = RangeArg::All();
 	if (args.size >= 2 && StringIsEqual(args[args.size - 2], "window")) {
@@ -85,6 +123,7 @@ ParseDatabaseSelection(Request args, bool fold_case, SongFilter &filter)
 	}
 
 	TagType sort = TAG_NUM_OF_ITEM_TYPES;
+	std::shared_ptr<const StickerValueMap> sort_stickers;
 	bool descending = false;
 	if (args.size >= 2 && StringIsEqual(args[args.size - 2], "sort")) {
 		const char *s = args.back();
@@ -93,35 +132,134 @@ ParseDatabaseSelection(Request args, bool fold_case, SongFilter &filter)
 			++s;
 		}
 
-		sort = ParseSortTag(s);
+		if (auto sticker_name = StringAfterPrefix(s, "sticker:")) {
+			if (*sticker_name == 0)
+				throw ProtocolError(ACK_ERROR_ARG,
+						    "Sticker name expected");
+
+			sort = TagType(SORT_TAG_STICKER);
+#ifdef ENABLE_SQLITE
+			sort_stickers = LoadSortStickers(client,
+							 sticker_name);
+#endif
+		} else
+			sort = ParseSortTag(s);
 
 		args.pop_back();
 		args.pop_back();
 	}
 
-	try {
-		filter.Parse(args, fold_case);
-	} catch (...) {
-		throw ProtocolError(ACK_ERROR_ARG,
-				    GetFullMessage(std::current_exception()).c_str());
-	}
-	filter.Optimize();
+	ParseFilter(client, filter, args, fold_case);
 
 	DatabaseSelection selection("", true, &filter);
 	selection.window = window;
 	selection.sort = sort;
+	selection.sort_stickers = std::move(sort_stickers);
 	selection.descending = descending;
 	return selection;
 }
 
+/**
+ * Generate the response of a database query with the given function,
+ * but look it up in the #QueryCache (if enabled) first, and add it to
+ * the cache afterwards.
+ *
+ * @param cacheable false if the response depends on something else
+ * than the song database (i.e. stickers)
+ * @param make_key a function returning the cache key, which must
+ * contain everything which affects the response
+ */
+template<typename K, typename F>
+static void
+PrintCachedQuery(Client &client, Response &r, bool cacheable,
+		 K &&make_key, F &&f)
+{
+	auto &instance = client.GetInstance();
+	auto *const cache = instance.query_cache.get();
+	const Database *const db = instance.GetDatabase();
+	if (cache == nullptr || db == nullptr || !cacheable ||
+	    /* there is nobody to tell us when this database
+	       changes */
+	    IsNegative(db->GetUpdateStamp())) {
+		f();
+		return;
+	}
+
+	std::string key = make_key();
+	if (const auto result = cache->Get(key)) {
+		/* send big responses in pieces, to allow flow control
+		   like the database walk would */
+		constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+		std::string_view rest(*result);
+		while (!rest.empty()) {
+			const auto n = std::min(rest.size(), CHUNK_SIZE);
+			if (!r.Write(rest.data(), n) || !r.Throttle())
+				break;
+
+			rest.remove_prefix(n);
+		}
+
+		return;
+	}
+
+	const unsigned generation = cache->GetGeneration();
+
+	std::string value;
+	r.StartCapture(value, cache->GetMaxItemSize());
+
+	try {
+		f();
+	} catch (...) {
+		r.StopCapture();
+		throw;
+	}
+
+	if (r.StopCapture())
+		cache->Put(std::move(key), std::move(value), generation);
+}
+
+static std::string
+MakeQueryCacheKey(const char *command, const SongFilter &filter)
+{
+	std::string key(command);
+	key.push_back('\n');
+	if (!filter.IsEmpty())
+		key += filter.ToExpression();
+	key.push_back('\n');
+	return key;
+}
+
 static CommandResult
 handle_match(Client &client, Request args, Response &r, bool fold_case)
 {
 	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, fold_case, filter);
-
-	db_selection_print(r, client.GetPartition(),
-			   selection, true, false);
+	const auto selection = ParseDatabaseSelection(client, args, fold_case, filter);
+
+	const auto make_key = [&r, &selection, &filter](){
+		auto key = MakeQueryCacheKey(r.GetCommand(), filter);
+		key += std::to_string(selection.sort);
+		key.push_back(selection.descending ? '-' : '+');
+		key += std::to_string(selection.window.start);
+		key.push_back(':');
+		key += std::to_string(selection.window.end);
+		key.push_back('\n');
+
+		/* the tag mask selects the tags being printed */
+		const auto tag_mask = r.GetTagMask();
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+			key.push_back(tag_mask.Test(TagType(i)) ? '1' : '0');
+
+		return key;
+	};
+
+	/* the sticker database is not versioned */
+	const bool cacheable = !filter.HasSticker() &&
+		selection.sort != TagType(SORT_TAG_STICKER);
+
+	PrintCachedQuery(client, r, cacheable, make_key, [&](){
+		db_selection_print(r, client.GetPartition(),
+				   selection, true, false);
+	});
 	return CommandResult::OK;
 }
 
@@ -141,7 +279,7 @@ static CommandResult
 handle_match_add(Client &client, Request args, bool fold_case)
 {
 	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, fold_case, filter);
+	const auto selection = ParseDatabaseSelection(client, args, fold_case, filter);
 
 	auto &partition = client.GetPartition();
 	AddFromDatabase(partition, selection);
@@ -166,7 +304,7 @@ handle_searchaddpl(Client &client, Request args, Response &)
 	const char *playlist = args.shift();
 
 	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, true, filter);
+	const auto selection = ParseDatabaseSelection(client, args, true, filter);
 
 	const Database &db = client.GetDatabaseOrThrow();
 
@@ -193,19 +331,17 @@ handle_count(Client &client, Request args, Response &r)
 	}
 
 	SongFilter filter;
-	if (!args.empty()) {
-		try {
-			filter.Parse(args, false);
-		} catch (...) {
-			r.Error(ACK_ERROR_ARG,
-				GetFullMessage(std::current_exception()).c_str());
-			return CommandResult::ERROR;
-		}
+	if (!args.empty())
+		ParseFilter(client, filter, args, false);
 
-		filter.Optimize();
-	}
+	const auto make_key = [&r, &filter, group](){
+		return MakeQueryCacheKey(r.GetCommand(), filter) +
+			std::to_string(group);
+	};
 
-	PrintSongCount(r, client.GetPartition(), "", &filter, group);
+	PrintCachedQuery(client, r, !filter.HasSticker(), make_key, [&](){
+		PrintSongCount(r, client.GetPartition(), "", &filter, group);
+	});
 	return CommandResult::OK;
 }
 
@@ -228,14 +364,7 @@ handle_list_file(Client &client, Request args, Response &r)
 
 	if (!args.empty()) {
 		filter.reset(new SongFilter());
-		try {
-			filter->Parse(args, false);
-		} catch (...) {
-			r.Error(ACK_ERROR_ARG,
-				GetFullMessage(std::current_exception()).c_str());
-			return CommandResult::ERROR;
-		}
-		filter->Optimize();
+		ParseFilter(client, *filter, args, false);
 	}
 
 	PrintSongUris(r, client.GetPartition(), filter.get());
@@ -303,14 +432,7 @@ handle_list(Client &client, Request args, Response &r)
 
 	if (!args.empty()) {
 		filter.reset(new SongFilter());
-		try {
-			filter->Parse(args, false);
-		} catch (...) {
-			r.Error(ACK_ERROR_ARG,
-				GetFullMessage(std::current_exception()).c_str());
-			return CommandResult::ERROR;
-		}
-		filter->Optimize();
+		ParseFilter(client, *filter, args, false);
 	}
 
 	PrintUniqueTags(r, client.GetPartition(),
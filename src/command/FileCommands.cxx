@@ -32,6 +32,8 @@
 #include "tag/Handler.hxx"
 #include "tag/Generic.hxx"
 #include "TagAny.hxx"
+#include "PictureCache.hxx"
+#include "Instance.hxx"
 #include "storage/StorageInterface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/FileInfo.hxx"
@@ -43,7 +45,17 @@
 #include "thread/Mutex.hxx"
 #include "Log.hxx"
 
+#ifndef _WIN32
+#include "system/UniqueFileDescriptor.hxx"
+
+#include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+
 #include <assert.h>
+#include <errno.h>
 #include <inttypes.h> /* for PRIu64 */
 
 gcc_pure
@@ -168,16 +180,16 @@ handle_read_comments(Client &client, Request args, Response &r)
  * URI that #InputStream supports. Returns the first successfully
  * opened file or #nullptr on failure.
  */
+static constexpr char const * art_names[] = {
+	"cover.png",
+	"cover.jpg",
+	"cover.tiff",
+	"cover.bmp"
+};
+
 static InputStreamPtr
 find_stream_art(const char *directory, Mutex &mutex)
 {
-	static constexpr char const * art_names[] = {
-		"cover.png",
-		"cover.jpg",
-		"cover.tiff",
-		"cover.bmp"
-	};
-
 	for(const auto name: art_names) {
 		std::string art_file = PathTraitsUTF8::Build(directory, name);
 
@@ -192,11 +204,194 @@ find_stream_art(const char *directory, Mutex &mutex)
 	return nullptr;
 }
 
+/**
+ * Send one chunk of a (cached) picture to the client.
+ */
 static CommandResult
-read_stream_art(Response &r, const char *uri, size_t offset)
+SendPicture(Response &r, const PictureCache::Picture &picture,
+	    size_t offset, bool send_type)
+{
+	ConstBuffer<void> buffer(picture.data.begin(), picture.data.size());
+	if (buffer.empty())
+		/* there is no picture */
+		return CommandResult::OK;
+
+	if (offset > buffer.size) {
+		r.Error(ACK_ERROR_ARG, "Bad file offset");
+		return CommandResult::ERROR;
+	}
+
+	r.Format("size: %" PRIoffset "\n", buffer.size);
+
+	if (send_type && !picture.mime_type.empty())
+		r.Format("type: %s\n", picture.mime_type.c_str());
+
+	buffer.size -= offset;
+	if (buffer.size > Response::MAX_BINARY_SIZE)
+		buffer.size = Response::MAX_BINARY_SIZE;
+	buffer.data = OffsetPointer(buffer.data, offset);
+
+	r.WriteBinary(buffer);
+	return CommandResult::OK;
+}
+
+/**
+ * Read the whole (seekable, local) stream into a buffer.
+ */
+static AllocatedArray<uint8_t>
+ReadWholeStream(InputStream &is, std::unique_lock<Mutex> &lock,
+		size_t size)
+{
+	AllocatedArray<uint8_t> data(size);
+
+	size_t position = 0;
+	while (position < size) {
+		size_t nbytes = is.Read(lock, data.begin() + position,
+					size - position);
+		if (nbytes == 0)
+			throw std::runtime_error("Unexpected end of file");
+
+		position += nbytes;
+	}
+
+	return data;
+}
+
+/**
+ * Like read_stream_art(), but use the #PictureCache.  Only local
+ * files are supported, because only they have a cheap way to check
+ * whether the cached copy is still valid.
+ *
+ * @return false if the picture cannot be cached and the caller
+ * shall fall back to reading the file directly
+ */
+static bool
+read_cached_art(PictureCache &cache, Response &r,
+		const std::string &art_directory, size_t offset,
+		CommandResult &result)
+{
+	if (!PathTraitsUTF8::IsAbsolute(art_directory.c_str()))
+		return false;
+
+	for (const auto name : art_names) {
+		std::string art_file = PathTraitsUTF8::Build(art_directory.c_str(),
+							     name);
+		const auto path_fs = AllocatedPath::FromUTF8(art_file.c_str());
+		if (path_fs.IsNull())
+			return false;
+
+		FileInfo fi;
+		if (!GetFileInfo(path_fs, fi) || !fi.IsRegular())
+			continue;
+
+		if (!cache.CanStore(fi.GetSize()))
+			return false;
+
+		std::string key = "albumart:" + art_file;
+		const auto *picture = cache.Get(key, fi.GetModificationTime());
+		if (picture == nullptr) {
+			PictureCache::Picture p;
+			p.mtime = fi.GetModificationTime();
+
+			Mutex mutex;
+			auto is = InputStream::OpenReady(art_file.c_str(), mutex);
+			if (!is->KnownSize() || !cache.CanStore(is->GetSize()))
+				return false;
+
+			{
+				std::unique_lock<Mutex> lock(mutex);
+				p.data = ReadWholeStream(*is, lock,
+							 is->GetSize());
+			}
+
+			picture = &cache.Put(std::move(key), std::move(p));
+		}
+
+		result = SendPicture(r, *picture, offset, false);
+		return true;
+	}
+
+	return false;
+}
+
+#ifndef _WIN32
+
+/**
+ * Send a chunk of a cover file in a local directory directly from
+ * the file descriptor (see Response::WriteBinaryFile()).  The
+ * kernel's page cache makes a #PictureCache unnecessary here.
+ *
+ * @return false if no cover file was found and the caller shall
+ * fall back to find_stream_art()
+ */
+static bool
+read_local_art(Response &r, const std::string &art_directory, size_t offset,
+	       CommandResult &result)
+{
+	if (!PathTraitsUTF8::IsAbsolute(art_directory.c_str()))
+		return false;
+
+	for (const auto name : art_names) {
+		std::string art_file = PathTraitsUTF8::Build(art_directory.c_str(),
+							     name);
+		const auto path_fs = AllocatedPath::FromUTF8(art_file.c_str());
+		if (path_fs.IsNull())
+			return false;
+
+		UniqueFileDescriptor fd;
+		if (!fd.OpenReadOnly(path_fs.c_str())) {
+			if (errno == ENOENT)
+				continue;
+
+			/* let find_stream_art() report the error */
+			return false;
+		}
+
+		struct stat st;
+		if (fstat(fd.Get(), &st) < 0 || !S_ISREG(st.st_mode))
+			return false;
+
+		const offset_type art_file_size = st.st_size;
+		if (offset > art_file_size) {
+			r.Error(ACK_ERROR_ARG, "Bad file offset");
+			result = CommandResult::ERROR;
+			return true;
+		}
+
+		size_t chunk_size = std::min<offset_type>(art_file_size - offset,
+							  Response::MAX_BINARY_SIZE);
+
+		r.Format("size: %" PRIoffset "\n", art_file_size);
+		r.WriteBinaryFile(std::move(fd), offset, chunk_size);
+		result = CommandResult::OK;
+		return true;
+	}
+
+	return false;
+}
+
+#endif
+
+static CommandResult
+read_stream_art(Client &client, Response &r, const char *uri, size_t offset)
 {
 	std::string art_directory = PathTraitsUTF8::GetParent(uri);
 
+#ifndef _WIN32
+	{
+		CommandResult result;
+		if (read_local_art(r, art_directory, offset, result))
+			return result;
+	}
+#endif
+
+	auto *cache = client.GetInstance().picture_cache.get();
+	if (cache != nullptr) {
+		CommandResult result;
+		if (read_cached_art(*cache, r, art_directory, offset, result))
+			return result;
+	}
+
 	Mutex mutex;
 
 	InputStreamPtr is = find_stream_art(art_directory.c_str(), mutex);
@@ -237,7 +432,7 @@ read_db_art(Client &client, Response &r, const char *uri, const uint64_t offset)
 		return CommandResult::ERROR;
 	}
 	std::string uri2 = storage->MapUTF8(uri);
-	return read_stream_art(r, uri2.c_str(), offset);
+	return read_stream_art(client, r, uri2.c_str(), offset);
 }
 #endif
 
@@ -258,7 +453,8 @@ handle_album_art(Client &client, Request args, Response &r)
 	switch (located_uri.type) {
 	case LocatedUri::Type::ABSOLUTE:
 	case LocatedUri::Type::PATH:
-		return read_stream_art(r, located_uri.canonical_uri, offset);
+		return read_stream_art(client, r, located_uri.canonical_uri,
+				       offset);
 	case LocatedUri::Type::RELATIVE:
 #ifdef ENABLE_DATABASE
 		return read_db_art(client, r, located_uri.canonical_uri, offset);
@@ -317,6 +513,66 @@ public:
 	}
 };
 
+/**
+ * Copies the first picture into a #PictureCache::Picture.
+ */
+class CollectPictureHandler final : public NullTagHandler {
+	PictureCache::Picture &picture;
+
+	bool found = false;
+
+public:
+	explicit CollectPictureHandler(PictureCache::Picture &_picture) noexcept
+		:NullTagHandler(WANT_PICTURE), picture(_picture) {}
+
+	void OnPicture(const char *mime_type,
+		       ConstBuffer<void> buffer) noexcept override {
+		if (found)
+			/* only use the first picture */
+			return;
+
+		found = true;
+
+		if (mime_type != nullptr)
+			picture.mime_type = mime_type;
+
+		const auto src = ConstBuffer<uint8_t>::FromVoid(buffer);
+		picture.data.ResizeDiscard(src.size);
+		std::copy(src.begin(), src.end(), picture.data.begin());
+	}
+};
+
+/**
+ * Determine the local file path of a song URI for the
+ * #PictureCache.  Returns nullptr if the file is not local.
+ */
+static AllocatedPath
+LocatePictureFile(Client &client, const char *uri)
+{
+	auto located_uri = LocateUri(UriPluginKind::INPUT, uri, &client
+#ifdef ENABLE_DATABASE
+				     , nullptr
+#endif
+				     );
+
+	switch (located_uri.type) {
+	case LocatedUri::Type::ABSOLUTE:
+		break;
+
+	case LocatedUri::Type::RELATIVE:
+#ifdef ENABLE_DATABASE
+		if (const Storage *storage = client.GetStorage())
+			return storage->MapFS(located_uri.canonical_uri);
+#endif
+		break;
+
+	case LocatedUri::Type::PATH:
+		return std::move(located_uri.path);
+	}
+
+	return nullptr;
+}
+
 CommandResult
 handle_read_picture(Client &client, Request args, Response &r)
 {
@@ -325,6 +581,32 @@ handle_read_picture(Client &client, Request args, Response &r)
 	const char *const uri = args.front();
 	const size_t offset = args.ParseUnsigned(1);
 
+	auto *cache = client.GetInstance().picture_cache.get();
+	if (cache != nullptr) {
+		const auto path_fs = LocatePictureFile(client, uri);
+		FileInfo fi;
+		if (!path_fs.IsNull() && GetFileInfo(path_fs, fi) &&
+		    fi.IsRegular()) {
+			std::string key = "readpicture:" + path_fs.ToUTF8();
+			const auto *picture =
+				cache->Get(key, fi.GetModificationTime());
+			if (picture != nullptr)
+				return SendPicture(r, *picture, offset, true);
+
+			PictureCache::Picture p;
+			p.mtime = fi.GetModificationTime();
+
+			CollectPictureHandler handler(p);
+			TagScanAny(client, uri, handler);
+
+			if (!cache->CanStore(p.data.size()))
+				return SendPicture(r, p, offset, true);
+
+			picture = &cache->Put(std::move(key), std::move(p));
+			return SendPicture(r, *picture, offset, true);
+		}
+	}
+
 	PrintPictureHandler handler(r, offset);
 	TagScanAny(client, uri, handler);
 	handler.RethrowError();
@@ -72,13 +72,11 @@ protected:
 
 private:
 	void DecodeStream(InputStream &is, const DecoderPlugin &plugin);
-	bool DecodeStream(InputStream &is, const char *suffix,
-			  const DecoderPlugin &plugin);
+	bool TryDecodeStream(InputStream &is, const DecoderPlugin &plugin);
 	void DecodeStream(InputStream &is);
-	bool DecodeContainer(const char *suffix, const DecoderPlugin &plugin);
+	bool DecodeContainer(const DecoderPlugin &plugin);
 	bool DecodeContainer(const char *suffix);
-	bool DecodeFile(const char *suffix, InputStream &is,
-			const DecoderPlugin &plugin);
+	bool DecodeFile(InputStream &is, const DecoderPlugin &plugin);
 	void DecodeFile();
 
 	/* virtual methods from class DecoderClient */
@@ -115,44 +113,11 @@ GetChromaprintCommand::DecodeStream(InputStream &input_stream,
 	plugin.StreamDecode(*this, input_stream);
 }
 
-gcc_pure
-static bool
-decoder_check_plugin_mime(const DecoderPlugin &plugin,
-			  const InputStream &is) noexcept
-{
-	assert(plugin.stream_decode != nullptr);
-
-	const char *mime_type = is.GetMimeType();
-	return mime_type != nullptr &&
-		plugin.SupportsMimeType(GetMimeTypeBase(mime_type).c_str());
-}
-
-gcc_pure
-static bool
-decoder_check_plugin_suffix(const DecoderPlugin &plugin,
-			    const char *suffix) noexcept
-{
-	assert(plugin.stream_decode != nullptr);
-
-	return suffix != nullptr && plugin.SupportsSuffix(suffix);
-}
-
-gcc_pure
-static bool
-decoder_check_plugin(const DecoderPlugin &plugin, const InputStream &is,
-		     const char *suffix) noexcept
-{
-	return plugin.stream_decode != nullptr &&
-		(decoder_check_plugin_mime(plugin, is) ||
-		 decoder_check_plugin_suffix(plugin, suffix));
-}
-
 inline bool
-GetChromaprintCommand::DecodeStream(InputStream &is,
-				    const char *suffix,
-				    const DecoderPlugin &plugin)
+GetChromaprintCommand::TryDecodeStream(InputStream &is,
+				       const DecoderPlugin &plugin)
 {
-	if (!decoder_check_plugin(plugin, is, suffix))
+	if (plugin.stream_decode == nullptr)
 		return false;
 
 	ChromaprintDecoderClient::Reset();
@@ -167,18 +132,22 @@ GetChromaprintCommand::DecodeStream(InputStream &is)
 	UriSuffixBuffer suffix_buffer;
 	const char *const suffix = uri_get_suffix(uri.c_str(), suffix_buffer);
 
-	decoder_plugins_try([this, &is, suffix](const DecoderPlugin &plugin){
-		return DecodeStream(is, suffix, plugin);
+	std::string mime_base;
+	const char *mime_type = is.GetMimeType();
+	if (mime_type != nullptr)
+		mime_type = (mime_base = GetMimeTypeBase(mime_type)).c_str();
+
+	decoder_plugins_try_suffix_or_mime(suffix, mime_type,
+					   [this, &is](const DecoderPlugin &plugin){
+		return TryDecodeStream(is, plugin);
 	});
 }
 
 inline bool
-GetChromaprintCommand::DecodeContainer(const char *suffix,
-				       const DecoderPlugin &plugin)
+GetChromaprintCommand::DecodeContainer(const DecoderPlugin &plugin)
 {
 	if (plugin.container_scan == nullptr ||
-	    plugin.file_decode == nullptr ||
-	    !plugin.SupportsSuffix(suffix))
+	    plugin.file_decode == nullptr)
 		return false;
 
 	ChromaprintDecoderClient::Reset();
@@ -190,18 +159,16 @@ GetChromaprintCommand::DecodeContainer(const char *suffix,
 inline bool
 GetChromaprintCommand::DecodeContainer(const char *suffix)
 {
-	return decoder_plugins_try([this, suffix](const DecoderPlugin &plugin){
-		return DecodeContainer(suffix, plugin);
+	return decoder_plugins_try_suffix(suffix,
+					  [this](const DecoderPlugin &plugin){
+		return DecodeContainer(plugin);
 	});
 }
 
 inline bool
-GetChromaprintCommand::DecodeFile(const char *suffix, InputStream &is,
+GetChromaprintCommand::DecodeFile(InputStream &is,
 				  const DecoderPlugin &plugin)
 {
-	if (!plugin.SupportsSuffix(suffix))
-		return false;
-
 	{
 		const std::lock_guard<Mutex> protect(mutex);
 		if (cancel)
@@ -244,8 +211,9 @@ GetChromaprintCommand::DecodeFile()
 	assert(input_stream);
 
 	auto &is = *input_stream;
-	decoder_plugins_try([this, suffix, &is](const DecoderPlugin &plugin){
-		return DecodeFile(suffix, is, plugin);
+	decoder_plugins_try_suffix(suffix,
+				   [this, &is](const DecoderPlugin &plugin){
+		return DecodeFile(is, plugin);
 	});
 }
 
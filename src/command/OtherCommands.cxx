@@ -40,10 +40,14 @@
 #include "util/StringView.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "Stats.hxx"
+#include "AudioTrace.hxx"
 #include "PlaylistFile.hxx"
 #include "db/PlaylistVector.hxx"
 #include "client/Client.hxx"
+#include "client/List.hxx"
 #include "client/Response.hxx"
+#include "input/cache/Manager.hxx"
+#include "tag/Pool.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "IdleFlags.hxx"
@@ -53,9 +57,23 @@
 #include "DatabaseCommands.hxx"
 #include "db/Interface.hxx"
 #include "db/update/Service.hxx"
+#include "db/Stats.hxx"
 #endif
 
+#ifdef ENABLE_ALLOC_STATS
+#include "thread/AllocStats.hxx"
+#endif
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include <iterator>
+
 #include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 
 static void
 print_spl_list(Response &r, const PlaylistVector &list)
@@ -366,6 +384,133 @@ handle_stats(Client &client, gcc_unused Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_audiotrace(gcc_unused Client &client, gcc_unused Request args,
+		  Response &r)
+{
+	const AudioTrace *trace = audio_trace;
+	if (trace == nullptr) {
+		r.Error(ACK_ERROR_NO_EXIST, "Audio tracing is disabled");
+		return CommandResult::ERROR;
+	}
+
+	trace->ForEach([&r](const AudioTrace::Entry &e){
+			char chunk_time[32];
+			if (e.chunk_time.IsNegative())
+				strcpy(chunk_time, "-");
+			else
+				snprintf(chunk_time, sizeof(chunk_time),
+					 "%.3f", e.chunk_time.ToDoubleS());
+
+			r.Format("%s: %" PRIu64 " %" PRIxPTR " %s %" PRIxPTR " %u\n",
+				 ToString(e.event),
+				 uint64_t(e.time.count()),
+				 uintptr_t(e.chunk), chunk_time,
+				 uintptr_t(e.object), unsigned(e.value));
+		});
+
+	return CommandResult::OK;
+}
+
+#ifdef __linux__
+
+/**
+ * Determine the resident set size of this process from
+ * /proc/self/statm.
+ *
+ * @return the number of bytes or 0 on error
+ */
+static std::size_t
+GetResidentSetSize() noexcept
+{
+	FILE *file = fopen("/proc/self/statm", "r");
+	if (file == nullptr)
+		return 0;
+
+	unsigned long size, resident;
+	const bool success = fscanf(file, "%lu %lu", &size, &resident) == 2;
+	fclose(file);
+
+	return success
+		? std::size_t(resident) * std::size_t(sysconf(_SC_PAGESIZE))
+		: 0;
+}
+
+#endif
+
+CommandResult
+handle_memory(Client &client, gcc_unused Request args, Response &r)
+{
+	auto &instance = client.GetInstance();
+
+	r.Format("tag_pool: %zu\n", tag_pool_get_stats().bytes);
+
+#ifdef ENABLE_DATABASE
+	const Database *db = instance.GetDatabase();
+	if (db != nullptr) {
+		const auto *stats = stats_get(*db);
+		if (stats != nullptr && stats->song_memory > 0)
+			r.Format("database: %zu\n", stats->song_memory);
+	}
+#endif
+
+	std::size_t partitions = 0, queue = 0, buffer = 0, buffer_reserved = 0;
+	for (const auto &partition : instance.partitions) {
+		partitions += sizeof(partition);
+		queue += partition.playlist.queue.GetMemoryUsage();
+
+		const auto m = partition.pc.LockGetMetrics();
+		buffer += m.buffer_used * m.buffer_chunk_memory;
+		buffer_reserved += m.buffer_size * m.buffer_chunk_memory;
+	}
+
+	r.Format("partitions: %zu\n"
+		 "queue: %zu\n"
+		 "music_buffer: %zu\n"
+		 "music_buffer_reserved: %zu\n",
+		 partitions, queue, buffer, buffer_reserved);
+
+	if (instance.input_cache)
+		r.Format("input_cache: %zu\n",
+			 instance.input_cache->LockGetSize());
+
+	std::size_t clients = 0;
+	for (auto &c : *instance.client_list)
+		clients += c.GetMemoryUsage();
+
+	r.Format("clients: %zu\n", clients);
+
+#ifdef __linux__
+	const std::size_t rss = GetResidentSetSize();
+	if (rss > 0)
+		r.Format("rss: %zu\n", rss);
+#endif
+
+	return CommandResult::OK;
+}
+
+#ifdef ENABLE_ALLOC_STATS
+
+CommandResult
+handle_allocstats(gcc_unused Client &client, gcc_unused Request args,
+		  Response &r)
+{
+	AllocThreadStats stats[64];
+	const std::size_t n = GetAllocStats(stats, std::size(stats));
+
+	for (std::size_t i = 0; i < n; ++i)
+		r.Format("thread: %s\n"
+			 "allocations: %" PRIu64 "\n"
+			 "deallocations: %" PRIu64 "\n"
+			 "bytes: %" PRIu64 "\n",
+			 stats[i].name, stats[i].allocations,
+			 stats[i].deallocations, stats[i].bytes);
+
+	return CommandResult::OK;
+}
+
+#endif
+
 CommandResult
 handle_config(Client &client, gcc_unused Request args, Response &r)
 {
@@ -386,8 +531,8 @@ handle_config(Client &client, gcc_unused Request args, Response &r)
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_idle(Client &client, Request args, Response &r)
+static CommandResult
+IdleWait(Client &client, Request args, Response &r, bool status)
 {
 	unsigned flags = 0;
 	for (const char *i : args) {
@@ -406,7 +551,19 @@ handle_idle(Client &client, Request args, Response &r)
 		flags = ~0;
 
 	/* enable "idle" mode on this client */
-	client.IdleWait(flags);
+	client.IdleWait(flags, status);
 
 	return CommandResult::IDLE;
 }
+
+CommandResult
+handle_idle(Client &client, Request args, Response &r)
+{
+	return IdleWait(client, args, r, false);
+}
+
+CommandResult
+handle_idlestatus(Client &client, Request args, Response &r)
+{
+	return IdleWait(client, args, r, true);
+}
@@ -56,10 +56,25 @@ handle_volume(Client &client, Request request, Response &response);
 CommandResult
 handle_stats(Client &client, Request request, Response &response);
 
+CommandResult
+handle_audiotrace(Client &client, Request request, Response &response);
+
+CommandResult
+handle_memory(Client &client, Request request, Response &response);
+
+/**
+ * Only available if MPD was built with "alloc_stats".
+ */
+CommandResult
+handle_allocstats(Client &client, Request request, Response &response);
+
 CommandResult
 handle_config(Client &client, Request request, Response &response);
 
 CommandResult
 handle_idle(Client &client, Request request, Response &response);
 
+CommandResult
+handle_idlestatus(Client &client, Request request, Response &response);
+
 #endif
@@ -125,3 +125,12 @@ handle_devices(Client &client, gcc_unused Request args, Response &r)
 	printAudioDevices(r, client.GetPartition().outputs);
 	return CommandResult::OK;
 }
+
+CommandResult
+handle_outputstats(Client &client, gcc_unused Request args, Response &r)
+{
+	assert(args.empty());
+
+	printAudioOutputStats(r, client.GetPartition().outputs);
+	return CommandResult::OK;
+}
@@ -22,6 +22,7 @@
 #include "Instance.hxx"
 #include "Partition.hxx"
 #include "IdleFlags.hxx"
+#include "MusicChunk.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
 #include "util/CharUtil.hxx"
@@ -100,10 +101,19 @@ handle_newpartition(Client &client, Request request, Response &response)
 	instance.partitions.emplace_back(instance, name,
 					 // TODO: use real configuration
 					 16384,
-					 1024,
+					 1024, CHUNK_SIZE,
 					 AudioFormat::Undefined(),
 					 ReplayGainConfig());
 	auto &partition = instance.partitions.back();
+	/* inherit the latency profile of the default partition */
+	partition.pc.low_latency = instance.partitions.front().pc.low_latency;
+	partition.pc.lock_memory = instance.partitions.front().pc.lock_memory;
+	partition.pc.lookahead_decoder =
+		instance.partitions.front().pc.lookahead_decoder;
+	partition.pc.float_pipeline =
+		instance.partitions.front().pc.float_pipeline;
+	partition.pc.shared_decoder =
+		instance.partitions.front().pc.shared_decoder;
 	partition.outputs.AddNullOutput(instance.io_thread.GetEventLoop(),
 					ReplayGainConfig(),
 					partition.pc);
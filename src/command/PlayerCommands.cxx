@@ -40,6 +40,8 @@
 
 #include <cmath>
 
+#include <inttypes.h>
+
 #define COMMAND_STATUS_STATE            "state"
 #define COMMAND_STATUS_REPEAT           "repeat"
 #define COMMAND_STATUS_SINGLE           "single"
@@ -59,6 +61,7 @@
 #define COMMAND_STATUS_MIXRAMPDELAY	"mixrampdelay"
 #define COMMAND_STATUS_AUDIO		"audio"
 #define COMMAND_STATUS_UPDATING_DB	"updating_db"
+#define COMMAND_STATUS_DB_VERSION	"db_version"
 
 CommandResult
 handle_play(Client &client, Request args, gcc_unused Response &r)
@@ -106,8 +109,8 @@ handle_pause(Client &client, Request args, gcc_unused Response &r)
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_status(Client &client, gcc_unused Request args, Response &r)
+void
+print_status(Client &client, Response &r)
 {
 	auto &pc = client.GetPlayerControl();
 
@@ -195,6 +198,10 @@ handle_status(Client &client, gcc_unused Request args, Response &r)
 		r.Format(COMMAND_STATUS_UPDATING_DB ": %i\n",
 			 updateJobId);
 	}
+
+	if (client.GetInstance().GetDatabase() != nullptr)
+		r.Format(COMMAND_STATUS_DB_VERSION ": %u\n",
+			 client.GetInstance().db_version);
 #endif
 
 	try {
@@ -209,6 +216,42 @@ handle_status(Client &client, gcc_unused Request args, Response &r)
 		r.Format(COMMAND_STATUS_NEXTSONG ": %i\n"
 			 COMMAND_STATUS_NEXTSONGID ": %u\n",
 			 song, playlist.PositionToId(song));
+}
+
+CommandResult
+handle_status(Client &client, gcc_unused Request args, Response &r)
+{
+	print_status(client, r);
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_decoderstats(Client &client, gcc_unused Request args, Response &r)
+{
+	const auto stats = client.GetPlayerControl().LockGetDecoderStats();
+	if (!stats.IsDefined())
+		return CommandResult::OK;
+
+	const auto audio_duration = stats.GetAudioDuration();
+
+	r.Format("plugin: %s\n"
+		 "frames: %" PRIu64 "\n"
+		 "audio_time: %.3f\n"
+		 "bytes_read: %" PRIu64 "\n",
+		 stats.plugin, stats.frames,
+		 audio_duration.count(),
+		 stats.bytes_read);
+
+	if (stats.HasCPUTime()) {
+		const FloatDuration cpu_time = stats.cpu_time;
+		r.Format("cpu_time: %.3f\n", cpu_time.count());
+
+		if (audio_duration.count() > 0)
+			r.Format("cpu_per_second: %.6f\n"
+				 "realtime_factor: %.1f\n",
+				 cpu_time / audio_duration,
+				 stats.GetRealtimeFactor());
+	}
 
 	return CommandResult::OK;
 }
@@ -41,9 +41,18 @@ handle_currentsong(Client &client, Request request, Response &response);
 CommandResult
 handle_pause(Client &client, Request request, Response &response);
 
+/**
+ * Print the "status" response.
+ */
+void
+print_status(Client &client, Response &r);
+
 CommandResult
 handle_status(Client &client, Request request, Response &response);
 
+CommandResult
+handle_decoderstats(Client &client, Request request, Response &response);
+
 CommandResult
 handle_next(Client &client, Request request, Response &response);
 
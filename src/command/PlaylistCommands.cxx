@@ -21,6 +21,7 @@
 #include "PlaylistCommands.hxx"
 #include "Request.hxx"
 #include "Instance.hxx"
+#include "Partition.hxx"
 #include "db/Selection.hxx"
 #include "db/DatabasePlaylist.hxx"
 #include "PlaylistSave.hxx"
@@ -82,14 +83,34 @@ handle_load(Client &client, Request args, gcc_unused Response &r)
 	auto &playlist = client.GetPlaylist();
 	const unsigned old_size = playlist.GetLength();
 
+	auto &instance = client.GetInstance();
+
+#ifdef ENABLE_DATABASE
+	std::vector<unsigned> lazy_positions;
+#endif
+
 	const SongLoader loader(client);
 	playlist_open_into_queue(uri,
 				 range.start, range.end,
 				 playlist,
-				 client.GetPlayerControl(), loader);
+				 client.GetPlayerControl(), loader
+#ifdef ENABLE_DATABASE
+				 , instance.lazy_playlist_load
+				 ? &lazy_positions : nullptr
+#endif
+				 );
+
+#ifdef ENABLE_DATABASE
+	/* register the placeholders before the bulk edit gets
+	   committed, so the one which gets queued is resolved */
+	auto &lazy_resolver = client.GetPartition().lazy_resolver;
+	for (unsigned position : lazy_positions)
+		if (position < playlist.GetLength())
+			lazy_resolver.Add(playlist.queue.PositionToId(position),
+					  playlist.queue.Get(position).GetURI());
+#endif
 
 	/* invoke the RemoteTagScanner on all newly added songs */
-	auto &instance = client.GetInstance();
 	const unsigned new_size = playlist.GetLength();
 	for (unsigned i = old_size; i < new_size; ++i)
 		instance.LookupRemoteTag(playlist.queue.Get(i).GetURI());
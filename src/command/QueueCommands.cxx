@@ -39,6 +39,10 @@
 #include "util/StringAPI.hxx"
 #include "util/NumberParser.hxx"
 
+#ifdef ENABLE_SQLITE
+#include "StickerCommands.hxx"
+#endif
+
 #include <limits>
 
 static void
@@ -274,6 +278,10 @@ handle_playlist_match(Client &client, Request args, Response &r,
 	}
 	filter.Optimize();
 
+#ifdef ENABLE_SQLITE
+	LoadFilterStickers(client, filter);
+#endif
+
 	playlist_print_find(r, client.GetPlaylist(), filter);
 	return CommandResult::OK;
 }
@@ -132,6 +132,12 @@ handle_sticker_song(Response &r, Partition &partition,
 				op = StickerOperator::LESS_THAN;
 			else if (StringIsEqual(op_s, ">"))
 				op = StickerOperator::GREATER_THAN;
+			else if (StringIsEqual(op_s, "eq"))
+				op = StickerOperator::EQUALS_INT;
+			else if (StringIsEqual(op_s, "lt"))
+				op = StickerOperator::LESS_THAN_INT;
+			else if (StringIsEqual(op_s, "gt"))
+				op = StickerOperator::GREATER_THAN_INT;
 			else {
 				r.Error(ACK_ERROR_ARG, "bad operator");
 				return CommandResult::ERROR;
@@ -176,3 +182,23 @@ handle_sticker(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 }
+
+void
+LoadFilterStickers(Client &client, const SongFilter &filter)
+{
+	auto &instance = client.GetInstance();
+	if (instance.HasStickerDatabase())
+		sticker_song_load_filter(*instance.sticker_database, filter);
+}
+
+std::shared_ptr<const StickerValueMap>
+LoadSortStickers(Client &client, const char *name)
+{
+	auto &instance = client.GetInstance();
+	if (!instance.HasStickerDatabase())
+		return nullptr;
+
+	auto values = sticker_song_load_values(*instance.sticker_database,
+					       name);
+	return std::make_shared<const StickerValueMap>(std::move(values));
+}
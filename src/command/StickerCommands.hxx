@@ -21,12 +21,33 @@
 #define MPD_STICKER_COMMANDS_HXX
 
 #include "CommandResult.hxx"
+#include "sticker/ValueMap.hxx"
+
+#include <memory>
 
 class Client;
 class Request;
 class Response;
+class SongFilter;
 
 CommandResult
 handle_sticker(Client &client, Request request, Response &response);
 
+/**
+ * Load the stickers referenced by the given #SongFilter.  If the
+ * sticker database is disabled, this does nothing, and no song
+ * matches a sticker filter.
+ */
+void
+LoadFilterStickers(Client &client, const SongFilter &filter);
+
+/**
+ * Load the specified sticker of all songs, for sorting.
+ *
+ * @return the sticker values or nullptr if the sticker database is
+ * disabled
+ */
+std::shared_ptr<const StickerValueMap>
+LoadSortStickers(Client &client, const char *name);
+
 #endif
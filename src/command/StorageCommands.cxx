@@ -28,6 +28,7 @@
 #include "fs/Traits.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/CommandPool.hxx"
 #include "Instance.hxx"
 #include "storage/Registry.hxx"
 #include "storage/CompositeStorage.hxx"
@@ -217,6 +218,7 @@ handle_mount(Client &client, Request args, Response &r)
 
 		// TODO: call Instance::OnDatabaseModified()?
 		// TODO: trigger database update?
+		instance.InvalidateDatabaseCaches();
 		instance.EmitIdle(IDLE_DATABASE);
 	}
 #endif
@@ -252,9 +254,16 @@ handle_unmount(Client &client, Request args, Response &r)
 		instance.update->CancelMount(local_uri);
 
 	if (auto *db = dynamic_cast<SimpleDatabase *>(instance.GetDatabase())) {
-		if (db->Unmount(local_uri))
+		/* a "search" in a #CommandPool thread may be using
+		   the mounted database without holding the
+		   db_mutex */
+		const CommandPool::ScopePause pause(instance.command_pool.get());
+
+		if (db->Unmount(local_uri)) {
 			// TODO: call Instance::OnDatabaseModified()?
+			instance.InvalidateDatabaseCaches();
 			instance.EmitIdle(IDLE_DATABASE);
+		}
 	}
 #endif
 
@@ -40,6 +40,8 @@ enum class ConfigOption {
 	STATE_FILE,
 	STATE_FILE_INTERVAL,
 	RESTORE_PAUSED,
+	STATE_FILE_QUEUE_METADATA,
+	STATE_FILE_SEPARATE_QUEUE,
 	USER,
 	GROUP,
 	BIND_TO_ADDRESS,
@@ -58,8 +60,15 @@ enum class ConfigOption {
 	REPLAYGAIN_LIMIT,
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
+	DITHER,
+	DSD_FILTER,
 	AUDIO_BUFFER_SIZE,
 	BUFFER_BEFORE_PLAY,
+	LOW_LATENCY,
+	LOCK_MEMORY,
+	LOOKAHEAD_DECODER,
+	FLOAT_PIPELINE,
+	SHARED_DECODER,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
 	HTTP_PROXY_USER,
@@ -69,13 +78,30 @@ enum class ConfigOption {
 	MAX_PLAYLIST_LENGTH,
 	MAX_COMMAND_LIST_SIZE,
 	MAX_OUTPUT_BUFFER_SIZE,
+	IDLE_MIN_INTERVAL,
+	COMMAND_THREADS,
+	COMMAND_STATS_INTERVAL,
+	CLIENT_THREADS,
 	FS_CHARSET,
 	ID3V1_ENCODING,
 	METADATA_TO_USE,
+	PRECOMPUTE_FOLD_CASE,
 	SAVE_ABSOLUTE_PATHS,
 	GAPLESS_MP3_PLAYBACK,
 	AUTO_UPDATE,
 	AUTO_UPDATE_DEPTH,
+	UPDATE_SCAN_THREADS,
+	UPDATE_LOUDNESS_ANALYSIS,
+	UPDATE_SKIP_UNCHANGED_DIRECTORIES,
+	CONTAINER_CACHE,
+	PICTURE_CACHE_SIZE,
+	LAZY_PLUGIN_INIT,
+	SEEK_TABLE_CACHE,
+	PLAYLIST_LAZY_LOAD,
+	AUDIO_TRACE_SIZE,
+	ASYNC_STARTUP,
+	LOG_BUFFER_SIZE,
+	QUERY_CACHE_SIZE,
 	DESPOTIFY_USER,
 	DESPOTIFY_PASSWORD,
 	DESPOTIFY_HIGH_BITRATE,
@@ -87,11 +113,14 @@ enum class ConfigBlockOption {
 	DECODER,
 	INPUT,
 	INPUT_CACHE,
+	REMOTE_TAG_CACHE,
 	PLAYLIST_PLUGIN,
 	RESAMPLER,
 	AUDIO_FILTER,
 	DATABASE,
 	NEIGHBORS,
+	METRICS,
+	THREAD,
 	MAX
 };
 
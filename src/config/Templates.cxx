@@ -36,6 +36,8 @@ const ConfigTemplate config_param_templates[] = {
 	{ "state_file" },
 	{ "state_file_interval" },
 	{ "restore_paused" },
+	{ "state_file_queue_metadata" },
+	{ "state_file_separate_queue" },
 	{ "user" },
 	{ "group" },
 	{ "bind_to_address", true },
@@ -54,8 +56,15 @@ const ConfigTemplate config_param_templates[] = {
 	{ "replaygain_limit" },
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
+	{ "dither" },
+	{ "dsd_filter" },
 	{ "audio_buffer_size" },
 	{ "buffer_before_play", false, true },
+	{ "low_latency" },
+	{ "lock_memory" },
+	{ "lookahead_decoder" },
+	{ "float_pipeline" },
+	{ "shared_decoder" },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
 	{ "http_proxy_user", false, true },
@@ -65,13 +74,30 @@ const ConfigTemplate config_param_templates[] = {
 	{ "max_playlist_length" },
 	{ "max_command_list_size" },
 	{ "max_output_buffer_size" },
+	{ "idle_min_interval" },
+	{ "command_threads" },
+	{ "command_stats_interval" },
+	{ "client_threads" },
 	{ "filesystem_charset" },
 	{ "id3v1_encoding", false, true },
 	{ "metadata_to_use" },
+	{ "precompute_fold_case" },
 	{ "save_absolute_paths_in_playlists" },
 	{ "gapless_mp3_playback", false, true },
 	{ "auto_update" },
 	{ "auto_update_depth" },
+	{ "update_scan_threads" },
+	{ "update_loudness_analysis" },
+	{ "update_skip_unchanged_directories" },
+	{ "container_cache" },
+	{ "picture_cache_size" },
+	{ "lazy_plugin_init" },
+	{ "seek_table_cache" },
+	{ "playlist_lazy_load" },
+	{ "audio_trace_size" },
+	{ "async_startup" },
+	{ "log_buffer_size" },
+	{ "query_cache_size" },
 	{ "despotify_user", false, true },
 	{ "despotify_password", false, true },
 	{ "despotify_high_bitrate", false, true },
@@ -88,11 +114,14 @@ const ConfigTemplate config_block_templates[] = {
 	{ "decoder", true },
 	{ "input", true },
 	{ "input_cache" },
+	{ "remote_tag_cache" },
 	{ "playlist_plugin", true },
-	{ "resampler" },
+	{ "resampler", true },
 	{ "filter", true },
 	{ "database" },
 	{ "neighbors", true },
+	{ "metrics" },
+	{ "thread", true },
 };
 
 static constexpr unsigned n_config_block_templates =
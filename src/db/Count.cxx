@@ -20,6 +20,7 @@
 #include "Count.hxx"
 #include "Selection.hxx"
 #include "Interface.hxx"
+#include "Stats.hxx"
 #include "Partition.hxx"
 #include "client/Response.hxx"
 #include "song/LightSong.hxx"
@@ -63,16 +64,6 @@ Print(Response &r, TagType group, const TagCountMap &m) noexcept
 	}
 }
 
-static void
-stats_visitor_song(SearchStats &stats, const LightSong &song) noexcept
-{
-	stats.n_songs++;
-
-	const auto duration = song.GetDuration();
-	if (!duration.IsNegative())
-		stats.total_duration += duration;
-}
-
 static void
 CollectGroupCounts(TagCountMap &map, const Tag &tag,
 		   const char *value) noexcept
@@ -105,14 +96,14 @@ PrintSongCount(Response &r, const Partition &partition, const char *name,
 	const DatabaseSelection selection(name, true, filter);
 
 	if (group == TAG_NUM_OF_ITEM_TYPES) {
-		/* no grouping */
+		/* no grouping: the database plugin may know the
+		   result without visiting all songs */
 
-		SearchStats stats;
+		const auto db_stats = db.CountSongs(selection);
 
-		using namespace std::placeholders;
-		const auto f = std::bind(stats_visitor_song, std::ref(stats),
-					 _1);
-		db.Visit(selection, f);
+		SearchStats stats;
+		stats.n_songs = db_stats.song_count;
+		stats.total_duration = db_stats.total_duration;
 
 		PrintSearchStats(r, stats);
 	} else {
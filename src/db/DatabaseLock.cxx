@@ -21,6 +21,8 @@
 
 Mutex db_mutex;
 
+unsigned db_serial;
+
 #ifndef NDEBUG
 ThreadId db_mutex_holder;
 #endif
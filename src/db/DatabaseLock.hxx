@@ -33,6 +33,16 @@
 
 extern Mutex db_mutex;
 
+/**
+ * A counter which is incremented whenever the #Directory/#Song tree
+ * is modified.  Indexes and caches derived from the tree compare it
+ * with the value they were built with to find out whether they are
+ * stale.
+ *
+ * This variable is protected with #db_mutex.
+ */
+extern unsigned db_serial;
+
 #ifndef NDEBUG
 
 #include "thread/Id.hxx"
@@ -82,6 +92,19 @@ db_unlock(void)
 	db_mutex.unlock();
 }
 
+/**
+ * Mark the #Directory/#Song tree as modified.
+ *
+ * Caller must lock the #db_mutex.
+ */
+static inline void
+db_modified() noexcept
+{
+	assert(holding_db_lock());
+
+	++db_serial;
+}
+
 class ScopeDatabaseLock {
 	bool locked = true;
 
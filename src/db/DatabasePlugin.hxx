@@ -39,6 +39,13 @@ struct DatabasePlugin {
 	 */
 	static constexpr unsigned FLAG_REQUIRE_STORAGE = 0x1;
 
+	/**
+	 * The const methods (e.g. Database::Visit()) of this plugin's
+	 * #Database instances may be called concurrently from any
+	 * thread, not just from the main thread.
+	 */
+	static constexpr unsigned FLAG_CONCURRENT_READS = 0x2;
+
 	const char *name;
 
 	unsigned flags;
@@ -61,6 +68,10 @@ struct DatabasePlugin {
 	constexpr bool RequireStorage() const {
 		return flags & FLAG_REQUIRE_STORAGE;
 	}
+
+	constexpr bool SupportsConcurrentReads() const {
+		return flags & FLAG_CONCURRENT_READS;
+	}
 };
 
 #endif
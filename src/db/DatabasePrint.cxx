@@ -23,16 +23,21 @@
 #include "TimePrint.hxx"
 #include "client/Response.hxx"
 #include "Partition.hxx"
+#include "Instance.hxx"
 #include "song/LightSong.hxx"
+#include "song/Filter.hxx"
 #include "tag/Tag.hxx"
 #include "LightDirectory.hxx"
 #include "PlaylistInfo.hxx"
 #include "Interface.hxx"
+#include "DatabaseError.hxx"
 #include "fs/Traits.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/RecursiveMap.hxx"
 
 #include <functional>
+#include <string>
+#include <vector>
 
 gcc_pure
 static const char *
@@ -139,6 +144,88 @@ PrintPlaylistFull(Response &r, bool base,
 		time_print(r, "Last-Modified", playlist.mtime);
 }
 
+/**
+ * Like Database::Visit() with a recursive #DatabaseSelection, but
+ * visit only one directory at a time, and call Response::Throttle()
+ * in between, while the database is not locked.  This way, the
+ * response is generated only as fast as the client receives it.
+ * The order of the visitor calls is the same as with a recursive
+ * visit, except that the base directory itself is not visited.
+ *
+ * @return false if the response is not wanted anymore
+ */
+static bool
+VisitIncremental(Response &r, const Database &db, const char *uri,
+		 const SongFilter *filter,
+		 const VisitDirectory &visit_directory,
+		 const VisitSong &visit_song,
+		 const VisitPlaylist &visit_playlist)
+{
+	struct Child {
+		std::string uri;
+		std::chrono::system_clock::time_point mtime;
+	};
+
+	/* the child directories are visited after the songs and
+	   playlists, each one followed by its contents; copy them,
+	   because the LightDirectory is only valid while the database
+	   is locked */
+	std::vector<Child> children;
+	const auto collect = [&children](const LightDirectory &directory){
+		children.push_back({directory.GetPath(), directory.mtime});
+	};
+
+	try {
+		db.Visit(DatabaseSelection(uri, false, filter),
+			 collect, visit_song, visit_playlist);
+	} catch (const DatabaseError &e) {
+		if (e.GetCode() != DatabaseErrorCode::NOT_FOUND)
+			throw;
+
+		/* the directory has been deleted by the database
+		   update since its parent was visited */
+		return true;
+	}
+
+	if (!r.Throttle())
+		return false;
+
+	for (const auto &i : children) {
+		if (visit_directory)
+			visit_directory(LightDirectory(i.uri.c_str(), i.mtime));
+
+		if (!VisitIncremental(r, db, i.uri.c_str(), filter,
+				      visit_directory, visit_song,
+				      visit_playlist))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Can the given selection be handled by VisitIncremental()?
+ */
+gcc_pure
+static bool
+CanVisitIncremental(const Response &r,
+		    const DatabaseSelection &selection,
+		    const VisitDirectory &visit_directory) noexcept
+{
+	return r.IsStreaming() && selection.recursive &&
+		/* sorting and windowing need the whole result */
+		selection.sort == TAG_NUM_OF_ITEM_TYPES &&
+		selection.window.IsAll() &&
+		/* VisitIncremental() doesn't print the base
+		   directory's entry */
+		(selection.uri.empty() || !visit_directory) &&
+		/* an exact tag match can be looked up quickly in the
+		   tag index (if there is one), which needs a single
+		   visit */
+		(selection.filter == nullptr ||
+		 !selection.filter->HasExactTagMatch());
+}
+
 void
 db_selection_print(Response &r, Partition &partition,
 		   const DatabaseSelection &selection,
@@ -158,7 +245,11 @@ db_selection_print(Response &r, Partition &partition,
 			    std::ref(r), base, _1, _2)
 		: VisitPlaylist();
 
-	db.Visit(selection, d, s, p);
+	if (CanVisitIncremental(r, selection, d))
+		VisitIncremental(r, db, selection.uri.c_str(), selection.filter,
+				 d, s, p);
+	else
+		db.Visit(selection, d, s, p);
 }
 
 static void
@@ -178,7 +269,12 @@ PrintSongUris(Response &r, Partition &partition,
 	using namespace std::placeholders;
 	const auto f = std::bind(PrintSongURIVisitor,
 				 std::ref(r), _1);
-	db.Visit(selection, f);
+
+	if (CanVisitIncremental(r, selection, VisitDirectory()))
+		VisitIncremental(r, db, "", filter,
+				 VisitDirectory(), f, VisitPlaylist());
+	else
+		db.Visit(selection, f);
 }
 
 static void
@@ -205,6 +301,8 @@ PrintUniqueTags(Response &r, Partition &partition,
 
 	const DatabaseSelection selection("", true, filter);
 
-	PrintUniqueTags(r, tag_types,
-			db.CollectUniqueTags(selection, tag_types));
+	const auto result =
+		partition.instance.unique_tags_cache.Get(db, selection,
+							 tag_types);
+	PrintUniqueTags(r, tag_types, *result);
 }
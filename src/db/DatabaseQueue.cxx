@@ -24,23 +24,20 @@
 #include "Instance.hxx"
 #include "song/DetachedSong.hxx"
 
-#include <functional>
-
-static void
-AddToQueue(Partition &partition, const LightSong &song)
-{
-	const auto *storage = partition.instance.storage;
-	partition.playlist.AppendSong(partition.pc,
-				      DatabaseDetachSong(storage,
-							 song));
-}
+#include <vector>
 
 void
 AddFromDatabase(Partition &partition, const DatabaseSelection &selection)
 {
 	const Database &db = partition.instance.GetDatabaseOrThrow();
+	const auto *storage = partition.instance.storage;
+
+	/* collect all songs first, and add them to the queue in one
+	   bulk operation */
+	std::vector<DetachedSong> songs;
+	db.Visit(selection, [&songs, storage](const LightSong &song){
+			songs.emplace_back(DatabaseDetachSong(storage, song));
+		});
 
-	using namespace std::placeholders;
-	const auto f = std::bind(AddToQueue, std::ref(partition), _1);
-	db.Visit(selection, f);
+	partition.playlist.AppendSongs(partition.pc, std::move(songs));
 }
@@ -85,3 +85,20 @@ GetStats(const Database &db, const DatabaseSelection &selection)
 	stats.album_count = albums.size();
 	return stats;
 }
+
+DatabaseStats
+CountSongs(const Database &db, const DatabaseSelection &selection)
+{
+	DatabaseStats stats;
+	stats.Clear();
+
+	db.Visit(selection, [&stats](const LightSong &song){
+			++stats.song_count;
+
+			const auto duration = song.GetDuration();
+			if (!duration.IsNegative())
+				stats.total_duration += duration;
+		});
+
+	return stats;
+}
@@ -27,4 +27,10 @@ struct DatabaseStats;
 DatabaseStats
 GetStats(const Database &db, const DatabaseSelection &selection);
 
+/**
+ * Walk the database to implement Database::CountSongs().
+ */
+DatabaseStats
+CountSongs(const Database &db, const DatabaseSelection &selection);
+
 #endif
@@ -23,6 +23,7 @@
 #include "Visitor.hxx"
 #include "tag/Type.h"
 #include "util/Compiler.h"
+#include "util/ConstBuffer.hxx"
 
 #include <chrono>
 #include <string>
@@ -32,7 +33,6 @@ struct DatabaseStats;
 struct DatabaseSelection;
 struct LightSong;
 template<typename Key> class RecursiveMap;
-template<typename T> struct ConstBuffer;
 
 class Database {
 	const DatabasePlugin &plugin;
@@ -83,6 +83,32 @@ public:
 	 */
 	virtual void ReturnSong(const LightSong *song) const noexcept = 0;
 
+	/**
+	 * A hint that GetSong() will soon be called for each of the
+	 * given URIs.  Plugins with expensive lookups (e.g. over the
+	 * network) may fetch all of them at once.  Errors are
+	 * ignored; they will be reported by GetSong().
+	 */
+	virtual void PrefetchSongs(gcc_unused ConstBuffer<const char *> uris) const noexcept {
+	}
+
+	/**
+	 * Look up many songs at once.  This is much cheaper than
+	 * calling GetSong() for each of them, because implementations
+	 * may sort the URIs and resolve them all in one pass.  Songs
+	 * which do not exist are skipped silently.  The default
+	 * implementation calls PrefetchSongs() and GetSong().
+	 *
+	 * Throws on error.
+	 *
+	 * @param uris the song URIs (in any order)
+	 * @param visit_song invoked for each song which was found,
+	 * with its index in #uris; the #LightSong is only valid
+	 * during the call
+	 */
+	virtual void GetSongs(ConstBuffer<const char *> uris,
+			      VisitSongIndex visit_song) const;
+
 	/**
 	 * Visit the selected entities.
 	 *
@@ -119,6 +145,16 @@ public:
 	 */
 	virtual DatabaseStats GetStats(const DatabaseSelection &selection) const = 0;
 
+	/**
+	 * Count the selected songs and sum up their durations (see
+	 * LightSong::GetDuration()).  Only the attributes
+	 * #DatabaseStats::song_count and
+	 * #DatabaseStats::total_duration are filled.
+	 *
+	 * Throws on error.
+	 */
+	virtual DatabaseStats CountSongs(const DatabaseSelection &selection) const = 0;
+
 	/**
 	 * Update the database.
 	 *
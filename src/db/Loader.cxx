@@ -0,0 +1,63 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Loader.hxx"
+#include "Interface.hxx"
+#include "thread/Name.hxx"
+
+#include <utility>
+
+DatabaseLoader::~DatabaseLoader() noexcept
+{
+	if (thread.IsDefined())
+		thread.Join();
+
+	if (opened)
+		db.Close();
+}
+
+void
+DatabaseLoader::Start()
+{
+	thread.Start();
+}
+
+void
+DatabaseLoader::Run() noexcept
+{
+	SetThreadName("db_load");
+
+	try {
+		db.Open();
+		opened = true;
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	defer_finished.Schedule();
+}
+
+void
+DatabaseLoader::OnFinished() noexcept
+{
+	thread.Join();
+
+	opened = false;
+	callback(std::exchange(error, nullptr));
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DB_LOADER_HXX
+#define MPD_DB_LOADER_HXX
+
+#include "event/DeferEvent.hxx"
+#include "thread/Thread.hxx"
+#include "util/BindMethod.hxx"
+
+#include <exception>
+
+class Database;
+
+/**
+ * Opens a #Database in a separate thread, so the main thread can
+ * serve clients meanwhile.  This is only allowed for database
+ * plugins whose Open() method does not use any #EventLoop.
+ */
+class DatabaseLoader final {
+	Thread thread;
+
+	/**
+	 * Invokes the callback in the main thread after Open() has
+	 * finished.
+	 */
+	DeferEvent defer_finished;
+
+	Database &db;
+
+	/**
+	 * The exception thrown by Database::Open(), if any.
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * Has Database::Open() succeeded, and the database not yet
+	 * been passed to the callback?  Then the destructor must
+	 * close it.
+	 */
+	bool opened = false;
+
+public:
+	/**
+	 * @param error the exception thrown by Database::Open() or
+	 * nullptr on success
+	 */
+	typedef BoundMethod<void(std::exception_ptr error) noexcept> Callback;
+
+private:
+	const Callback callback;
+
+public:
+	DatabaseLoader(EventLoop &loop, Database &_db,
+		       Callback _callback) noexcept
+		:thread(BIND_THIS_METHOD(Run)),
+		 defer_finished(loop, BIND_THIS_METHOD(OnFinished)),
+		 db(_db), callback(_callback) {}
+
+	/**
+	 * Waits for the thread to finish (this cannot be
+	 * interrupted); the callback will not be invoked, and the
+	 * database will be closed if it has been opened.
+	 */
+	~DatabaseLoader() noexcept;
+
+	DatabaseLoader(const DatabaseLoader &) = delete;
+	DatabaseLoader &operator=(const DatabaseLoader &) = delete;
+
+	/**
+	 * Throws on error.
+	 */
+	void Start();
+
+private:
+	/* the thread function */
+	void Run() noexcept;
+
+	/* DeferEvent callback */
+	void OnFinished() noexcept;
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "QueryCache.hxx"
+
+#include <assert.h>
+
+void
+QueryCache::Erase(std::list<Item>::iterator i) noexcept
+{
+	assert(size >= i->value->size());
+
+	size -= i->value->size();
+	map.erase(i->key);
+	items.erase(i);
+}
+
+QueryCache::Result
+QueryCache::Get(const std::string &key) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto m = map.find(key);
+	if (m == map.end())
+		return nullptr;
+
+	/* move to the front of the list */
+	auto i = m->second;
+	items.splice(items.begin(), items, i);
+	return i->value;
+}
+
+void
+QueryCache::Put(std::string &&key, std::string &&value,
+		unsigned old_generation) noexcept
+{
+	if (value.size() > GetMaxItemSize())
+		return;
+
+	auto result = std::make_shared<const std::string>(std::move(value));
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (generation != old_generation)
+		/* the database was modified meanwhile */
+		return;
+
+	auto m = map.find(key);
+	if (m != map.end())
+		Erase(m->second);
+
+	while (size + result->size() > max_size) {
+		assert(!items.empty());
+		Erase(std::prev(items.end()));
+	}
+
+	size += result->size();
+	items.emplace_front(std::move(key), std::move(result));
+
+	auto i = items.begin();
+	map.emplace(i->key, i);
+}
+
+void
+QueryCache::Clear() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	map.clear();
+	items.clear();
+	size = 0;
+	++generation;
+}
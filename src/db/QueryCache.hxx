@@ -0,0 +1,138 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DB_QUERY_CACHE_HXX
+#define MPD_DB_QUERY_CACHE_HXX
+
+#include "thread/Mutex.hxx"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+/**
+ * A bounded LRU cache for the rendered responses of "find", "search"
+ * and "count".  Web interfaces tend to send the same queries from
+ * many clients, and each of them would walk the database.
+ *
+ * The keys are built by the caller; they must contain everything
+ * which affects the response (the command, the filter expression,
+ * sort, window, the client's tag mask).
+ *
+ * This object does not know when the database gets modified; its
+ * owner must call Clear().  It is thread-safe, because these
+ * commands may run in a #CommandPool thread.
+ */
+class QueryCache {
+public:
+	typedef std::shared_ptr<const std::string> Result;
+
+private:
+	struct Item {
+		std::string key;
+
+		Result value;
+
+		Item(std::string &&_key, Result &&_value) noexcept
+			:key(std::move(_key)), value(std::move(_value)) {}
+	};
+
+	/**
+	 * Protects all attributes below.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * All cached responses; the most recently used one comes
+	 * first, the last one is evicted first.
+	 */
+	std::list<Item> items;
+
+	std::map<std::string, std::list<Item>::iterator, std::less<>> map;
+
+	/**
+	 * The maximum total size of all responses [bytes].
+	 */
+	const size_t max_size;
+
+	/**
+	 * The current total size of all responses [bytes].
+	 */
+	size_t size = 0;
+
+	/**
+	 * Incremented by Clear().  A response which was generated
+	 * while Clear() was called may be stale, and is not added to
+	 * the cache.
+	 */
+	unsigned generation = 0;
+
+public:
+	explicit QueryCache(size_t _max_size) noexcept
+		:max_size(_max_size) {}
+
+	QueryCache(const QueryCache &) = delete;
+	QueryCache &operator=(const QueryCache &) = delete;
+
+	/**
+	 * The maximum size of one response.  A single response may
+	 * occupy at most a quarter of the cache, to avoid flushing
+	 * everything else.
+	 */
+	size_t GetMaxItemSize() const noexcept {
+		return max_size / 4;
+	}
+
+	/**
+	 * Look up a response.
+	 *
+	 * @return the response (remains valid even if the cache is
+	 * cleared meanwhile) or nullptr if it is not cached
+	 */
+	Result Get(const std::string &key) noexcept;
+
+	/**
+	 * Obtain the current generation; pass it to Put() after the
+	 * response has been generated.
+	 */
+	unsigned GetGeneration() const noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		return generation;
+	}
+
+	/**
+	 * Add a response to the cache, evicting old entries if
+	 * necessary.  It is discarded if Clear() has been called
+	 * since GetGeneration() returned the given value.
+	 */
+	void Put(std::string &&key, std::string &&value,
+		 unsigned old_generation) noexcept;
+
+	/**
+	 * Discard all cached responses.  Call this after the
+	 * database has been modified.
+	 */
+	void Clear() noexcept;
+
+private:
+	void Erase(std::list<Item>::iterator i) noexcept;
+};
+
+#endif
@@ -22,8 +22,10 @@
 
 #include "protocol/RangeArg.hxx"
 #include "tag/Type.h"
+#include "sticker/ValueMap.hxx"
 #include "util/Compiler.h"
 
+#include <memory>
 #include <string>
 
 class SongFilter;
@@ -43,10 +45,18 @@ struct DatabaseSelection {
 	/**
 	 * Sort the result by the given tag.  #TAG_NUM_OF_ITEM_TYPES
 	 * means don't sort.  #SORT_TAG_LAST_MODIFIED sorts by
-	 * "Last-Modified" (not technically a tag).
+	 * "Last-Modified" (not technically a tag).  #SORT_TAG_STICKER
+	 * sorts by the values in #sort_stickers.
 	 */
 	TagType sort = TAG_NUM_OF_ITEM_TYPES;
 
+	/**
+	 * The sticker values (indexed by song URI) used by
+	 * #SORT_TAG_STICKER.  Songs which are not in this map are
+	 * sorted last.
+	 */
+	std::shared_ptr<const StickerValueMap> sort_stickers;
+
 	/**
 	 * If #sort is set, this flag can reverse the sort order.
 	 */
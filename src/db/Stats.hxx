@@ -22,6 +22,8 @@
 
 #include "Chrono.hxx"
 
+#include <cstddef>
+
 struct DatabaseStats {
 	/**
 	 * Number of songs.
@@ -43,10 +45,17 @@ struct DatabaseStats {
 	 */
 	unsigned album_count;
 
+	/**
+	 * Approximate number of bytes occupied by all song objects in
+	 * memory.  Zero if the database plugin does not know.
+	 */
+	std::size_t song_memory;
+
 	void Clear() {
 		song_count = 0;
 		total_duration = total_duration.zero();
 		artist_count = album_count = 0;
+		song_memory = 0;
 	}
 };
 
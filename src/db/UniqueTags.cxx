@@ -21,9 +21,10 @@
 #include "Interface.hxx"
 #include "song/LightSong.hxx"
 #include "tag/VisitFallback.hxx"
-#include "util/ConstBuffer.hxx"
 #include "util/RecursiveMap.hxx"
 
+#include <algorithm>
+
 static void
 CollectUniqueTags(RecursiveMap<std::string> &result,
 		  const Tag &tag,
@@ -51,3 +52,73 @@ CollectUniqueTags(const Database &db, const DatabaseSelection &selection,
 
 	return result;
 }
+
+UniqueTagsCollector::UniqueTagsCollector(ConstBuffer<TagType> _tag_types) noexcept
+	:tag_types(_tag_types), current(tag_types.size)
+{
+}
+
+void
+UniqueTagsCollector::Add(const Tag &tag, std::size_t i) noexcept
+{
+	if (i == tag_types.size) {
+		if (i > 0)
+			values.insert(values.end(),
+				      current.begin(), current.end());
+		return;
+	}
+
+	VisitTagWithFallbackOrEmpty(tag, tag_types[i], [this, &tag, i](const char *value){
+			current[i] = value;
+			Add(tag, i + 1);
+		});
+}
+
+RecursiveMap<std::string>
+UniqueTagsCollector::Commit() const noexcept
+{
+	RecursiveMap<std::string> result;
+
+	const std::size_t n = tag_types.size;
+	if (n == 0 || values.empty())
+		return result;
+
+	/* sort the tuples by their pointers; this is cheaper than
+	   comparing strings, and it moves identical tuples (and
+	   tuples sharing a prefix) next to each other */
+	std::vector<const char *const *> tuples;
+	tuples.reserve(values.size() / n);
+	for (std::size_t i = 0; i < values.size(); i += n)
+		tuples.push_back(&values[i]);
+
+	std::sort(tuples.begin(), tuples.end(),
+		  [n](const char *const *a, const char *const *b){
+			  return std::lexicographical_compare(a, a + n,
+							      b, b + n);
+		  });
+
+	/* the map nodes of the previous tuple; a new tuple needs to
+	   look up only the values after the common prefix */
+	std::vector<RecursiveMap<std::string> *> nodes(n);
+	const char *const *previous = nullptr;
+
+	for (const auto *t : tuples) {
+		std::size_t i = 0;
+		if (previous != nullptr) {
+			while (i < n && t[i] == previous[i])
+				++i;
+
+			if (i == n)
+				/* duplicate */
+				continue;
+		}
+
+		auto *m = i == 0 ? &result : nodes[i - 1];
+		for (; i < n; ++i)
+			nodes[i] = m = &(*m)[t[i]];
+
+		previous = t;
+	}
+
+	return result;
+}
@@ -21,13 +21,52 @@
 #define MPD_DB_UNIQUE_TAGS_HXX
 
 #include "tag/Type.h"
+#include "util/ConstBuffer.hxx"
 
 #include <string>
+#include <vector>
 
+struct Tag;
 class Database;
 struct DatabaseSelection;
 template<typename Key> class RecursiveMap;
-template<typename T> struct ConstBuffer;
+
+/**
+ * Collects unique tag value combinations in a flat array of string
+ * pointers, and builds the #RecursiveMap only once at the end, after
+ * sorting and removing duplicates.  This saves a lot of map lookups
+ * (and temporary std::string keys) for big databases.
+ *
+ * The pointers are not copied, so all #Tag instances passed to Add()
+ * must remain valid until Commit() has been called; this is true for
+ * the tag pool strings of the "simple" database while #db_mutex is
+ * locked.
+ */
+class UniqueTagsCollector {
+	ConstBuffer<TagType> tag_types;
+
+	/**
+	 * One tuple of tag_types.size values per combination.
+	 */
+	std::vector<const char *> values;
+
+	/**
+	 * The tuple being constructed by Add().
+	 */
+	std::vector<const char *> current;
+
+public:
+	explicit UniqueTagsCollector(ConstBuffer<TagType> _tag_types) noexcept;
+
+	void Add(const Tag &tag) noexcept {
+		Add(tag, 0);
+	}
+
+	RecursiveMap<std::string> Commit() const noexcept;
+
+private:
+	void Add(const Tag &tag, std::size_t i) noexcept;
+};
 
 /**
  * Walk the database and collect unique tag values.
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "UniqueTagsCache.hxx"
+#include "Interface.hxx"
+#include "Selection.hxx"
+#include "song/Filter.hxx"
+#include "time/ChronoUtil.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <tuple>
+
+UniqueTagsCache::Key::Key(const DatabaseSelection &selection,
+			  ConstBuffer<TagType> _tag_types)
+	:tag_types(_tag_types.begin(), _tag_types.end()),
+	 uri(selection.uri),
+	 recursive(selection.recursive)
+{
+	if (selection.filter != nullptr)
+		filter = selection.filter->ToExpression();
+}
+
+bool
+UniqueTagsCache::Key::operator<(const Key &other) const noexcept
+{
+	return std::tie(tag_types, uri, filter, recursive) <
+		std::tie(other.tag_types, other.uri, other.filter,
+			 other.recursive);
+}
+
+UniqueTagsCache::Result
+UniqueTagsCache::Get(const Database &db, const DatabaseSelection &selection,
+		     ConstBuffer<TagType> tag_types)
+{
+	if (IsNegative(db.GetUpdateStamp()))
+		return std::make_shared<const RecursiveMap<std::string>>(db.CollectUniqueTags(selection, tag_types));
+
+	Key key(selection, tag_types);
+
+	unsigned old_generation;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		auto i = map.find(key);
+		if (i != map.end())
+			return i->second;
+
+		old_generation = generation;
+	}
+
+	/* walk the database without holding the mutex; if another
+	   thread does the same meanwhile, the second result simply
+	   replaces the first one */
+	auto result = std::make_shared<const RecursiveMap<std::string>>(db.CollectUniqueTags(selection, tag_types));
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (generation != old_generation)
+		/* the database was modified meanwhile */
+		return result;
+
+	if (map.size() >= MAX_ENTRIES)
+		map.clear();
+
+	map[std::move(key)] = result;
+	return result;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_DB_UNIQUE_TAGS_CACHE_HXX
+#define MPD_DB_UNIQUE_TAGS_CACHE_HXX
+
+#include "tag/Type.h"
+#include "thread/Mutex.hxx"
+#include "util/RecursiveMap.hxx"
+#include "util/Compiler.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Database;
+struct DatabaseSelection;
+template<typename T> struct ConstBuffer;
+
+/**
+ * A cache for the results of Database::CollectUniqueTags().  Clients
+ * tend to send the same "list" commands over and over (e.g. whenever
+ * a library browser is opened), and each of them would walk the
+ * whole database.
+ *
+ * This object does not know when the database gets modified; its
+ * owner must call Clear() (from
+ * DatabaseListener::OnDatabaseModified()).  It is thread-safe, because
+ * "list" may run in a #CommandPool thread.
+ */
+class UniqueTagsCache {
+	/**
+	 * Clear the cache when it grows beyond this number of
+	 * entries, to limit the memory usage.
+	 */
+	static constexpr std::size_t MAX_ENTRIES = 64;
+
+	struct Key {
+		std::vector<TagType> tag_types;
+
+		/**
+		 * The base URI of the #DatabaseSelection.
+		 */
+		std::string uri;
+
+		/**
+		 * The filter in its canonical string representation
+		 * (SongFilter::ToExpression()), or an empty string if
+		 * there is no filter.
+		 */
+		std::string filter;
+
+		bool recursive;
+
+		Key(const DatabaseSelection &selection,
+		    ConstBuffer<TagType> _tag_types);
+
+		gcc_pure
+		bool operator<(const Key &other) const noexcept;
+	};
+
+	typedef std::shared_ptr<const RecursiveMap<std::string>> Result;
+
+	/**
+	 * Protects #map.
+	 */
+	mutable Mutex mutex;
+
+	std::map<Key, Result> map;
+
+	/**
+	 * Incremented by Clear().  A result which was collected
+	 * while Clear() was called may be stale, and is not added to
+	 * the cache.  Protected by #mutex.
+	 */
+	unsigned generation = 0;
+
+public:
+	/**
+	 * Look up the result in the cache, or call
+	 * Database::CollectUniqueTags() and add its result to the
+	 * cache.  Results from databases which do not know their
+	 * update time stamp (e.g. UPnP) are not cached, because
+	 * there is nobody to tell us when they change.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the result; it remains valid even if the cache is
+	 * cleared meanwhile
+	 */
+	Result Get(const Database &db, const DatabaseSelection &selection,
+		   ConstBuffer<TagType> tag_types);
+
+	/**
+	 * Discard all cached results.  Call this after the database
+	 * has been modified.
+	 */
+	void Clear() noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		map.clear();
+		++generation;
+	}
+};
+
+#endif
@@ -43,9 +43,26 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(const DatabaseSelection &_selection
 		   this std::vector, and then sort it */
 
 		original_visit_song = std::move(visit_song);
-		visit_song = [this](const auto &song){
-			songs.emplace_back(song);
-		};
+
+		if (selection.window.end < RangeArg::All().end) {
+			/* only the first "window.end" songs of the
+			   sorted result will be needed; instead of
+			   collecting all songs, sort and truncate
+			   the buffer whenever it has grown to twice
+			   that size */
+			const size_t limit = std::max<size_t>(selection.window.end, 1);
+			songs.reserve(2 * limit);
+
+			visit_song = [this, limit](const auto &song){
+				songs.emplace_back(song);
+				if (songs.size() >= 2 * limit)
+					Truncate(limit);
+			};
+		} else {
+			visit_song = [this](const auto &song){
+				songs.emplace_back(song);
+			};
+		}
 	} else if (selection.window != RangeArg::All()) {
 		original_visit_song = std::move(visit_song);
 		visit_song = [this](const auto &song){
@@ -89,16 +106,49 @@ CompareTags(TagType type, bool descending, const Tag &a, const Tag &b) noexcept
 	}
 }
 
-void
-DatabaseVisitorHelper::Commit()
+/**
+ * Compare the sticker values of two songs.  Songs without a sticker
+ * are sorted last, regardless of #descending.  If both values are
+ * integers, they are compared numerically.
+ */
+gcc_pure
+static bool
+CompareStickers(const StickerValueMap *stickers, bool descending,
+		const DetachedSong &a, const DetachedSong &b) noexcept
 {
-	/* only needed if sorting is enabled */
-	if (selection.sort == TAG_NUM_OF_ITEM_TYPES)
-		return;
+	if (stickers == nullptr)
+		return false;
 
-	assert(original_visit_song);
+	const auto a_i = stickers->find(a.GetURI());
+	const auto b_i = stickers->find(b.GetURI());
+	if (a_i == stickers->end() || b_i == stickers->end())
+		return a_i != stickers->end() && b_i == stickers->end();
+
+	const char *a_value = a_i->second.c_str();
+	const char *b_value = b_i->second.c_str();
+
+	if (descending) {
+		using std::swap;
+		swap(a_value, b_value);
+	}
+
+	char *a_end, *b_end;
+	long a_number = strtol(a_value, &a_end, 10);
+	long b_number = strtol(b_value, &b_end, 10);
+	if (a_end > a_value && *a_end == 0 &&
+	    b_end > b_value && *b_end == 0)
+		return a_number < b_number;
+
+	return strcmp(a_value, b_value) < 0;
+}
+
+void
+DatabaseVisitorHelper::Sort()
+{
+	/* this needs to be a stable sort: Truncate() relies on songs
+	   which were collected earlier staying in front of later
+	   ones with the same sort key */
 
-	/* sort the song collection */
 	const auto sort = selection.sort;
 	const auto descending = selection.descending;
 
@@ -109,7 +159,16 @@ DatabaseVisitorHelper::Commit()
 						 ? a.GetLastModified() > b.GetLastModified()
 						 : a.GetLastModified() < b.GetLastModified();
 				 });
-	else
+	else if (sort == TagType(SORT_TAG_STICKER)) {
+		const StickerValueMap *stickers = selection.sort_stickers.get();
+		std::stable_sort(songs.begin(), songs.end(),
+				 [stickers, descending](const DetachedSong &a,
+							const DetachedSong &b){
+					 return CompareStickers(stickers,
+								descending,
+								a, b);
+				 });
+	} else
 		std::stable_sort(songs.begin(), songs.end(),
 				 [sort, descending](const DetachedSong &a,
 						    const DetachedSong &b){
@@ -117,11 +176,28 @@ DatabaseVisitorHelper::Commit()
 							    a.GetTag(),
 							    b.GetTag());
 				 });
+}
+
+void
+DatabaseVisitorHelper::Truncate(size_t n)
+{
+	Sort();
+
+	if (n < songs.size())
+		songs.erase(std::next(songs.begin(), n), songs.end());
+}
+
+void
+DatabaseVisitorHelper::Commit()
+{
+	/* only needed if sorting is enabled */
+	if (selection.sort == TAG_NUM_OF_ITEM_TYPES)
+		return;
+
+	assert(original_visit_song);
 
-	/* apply the "window" */
-	if (selection.window.end < songs.size())
-		songs.erase(std::next(songs.begin(), selection.window.end),
-			    songs.end());
+	/* sort the song collection and apply the "window" */
+	Truncate(selection.window.end);
 
 	if (selection.window.start >= songs.size())
 		return;
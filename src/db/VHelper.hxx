@@ -42,7 +42,8 @@ class DatabaseVisitorHelper {
 	/**
 	 * If the plugin can't sort, then this container will collect
 	 * all songs, sort them and report them to the visitor in
-	 * Commit().
+	 * Commit().  If there is a "window", then it holds at most
+	 * twice the number of songs needed to fill it.
 	 */
 	std::vector<DetachedSong> songs;
 
@@ -65,6 +66,14 @@ public:
 	~DatabaseVisitorHelper() noexcept;
 
 	void Commit();
+
+private:
+	void Sort();
+
+	/**
+	 * Sort #songs and keep only the first \p n of them.
+	 */
+	void Truncate(size_t n);
 };
 
 #endif
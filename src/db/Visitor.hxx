@@ -22,6 +22,8 @@
 
 #include <functional>
 
+#include <cstddef>
+
 struct LightDirectory;
 struct LightSong;
 struct PlaylistInfo;
@@ -29,6 +31,7 @@ struct Tag;
 
 typedef std::function<void(const LightDirectory &)> VisitDirectory;
 typedef std::function<void(const LightSong &)> VisitSong;
+typedef std::function<void(std::size_t, const LightSong &)> VisitSongIndex;
 typedef std::function<void(const PlaylistInfo &,
 			   const LightDirectory &)> VisitPlaylist;
 
@@ -23,10 +23,17 @@
 #include "db/DatabaseListener.hxx"
 #include "db/Selection.hxx"
 #include "db/VHelper.hxx"
+#include "db/Helpers.hxx"
 #include "db/DatabaseError.hxx"
 #include "db/PlaylistInfo.hxx"
 #include "db/LightDirectory.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/UniqueTags.hxx"
+#include "simple/Directory.hxx"
+#include "simple/Song.hxx"
+#include "simple/TagCounter.hxx"
 #include "song/LightSong.hxx"
+#include "song/DetachedSong.hxx"
 #include "db/Stats.hxx"
 #include "song/Filter.hxx"
 #include "song/UriSongFilter.hxx"
@@ -44,14 +51,50 @@
 #include "protocol/Ack.hxx"
 #include "event/SocketMonitor.hxx"
 #include "event/IdleMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 #include "Log.hxx"
 
 #include <mpd/client.h>
 #include <mpd/async.h>
 
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <string.h>
+
+/**
+ * If a refresh of the mirror finds more than this number of new
+ * songs which were not reported by the "modified-since" query (e.g.
+ * files which were moved), then the whole remote database is loaded
+ * again instead of querying each song.
+ */
+static constexpr size_t MIRROR_MAX_MISSING = 256;
+
+/**
+ * The maximum number of commands sent in one command list by
+ * PrefetchSongs().
+ */
+static constexpr size_t PREFETCH_CHUNK = 256;
+
+/**
+ * The maximum number of songs kept by PrefetchSongs() until they
+ * are obtained by GetSong().
+ */
+static constexpr size_t MAX_PREFETCHED = 4096;
+
+/**
+ * Idle pool connections which have not been used for this duration
+ * are closed instead of being reused, because the other MPD may
+ * have closed them already (see its "connection_timeout" setting).
+ */
+static constexpr std::chrono::steady_clock::duration POOL_IDLE_TIMEOUT =
+	std::chrono::seconds(30);
 
 class LibmpdclientError final : public std::runtime_error {
 	enum mpd_error code;
@@ -84,6 +127,21 @@ public:
 	}
 };
 
+struct DetachedSongHolder {
+	DetachedSong detached;
+};
+
+/**
+ * A copy of a song from the mirror, which remains valid even if the
+ * mirror is refreshed while the caller holds it.
+ */
+class MirrorSong final : DetachedSongHolder, public LightSong {
+public:
+	explicit MirrorSong(const LightSong &src)
+		:DetachedSongHolder{DetachedSong(src)},
+		 LightSong((LightSong)detached) {}
+};
+
 class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
 	DatabaseListener &listener;
 
@@ -92,7 +150,72 @@ class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
 	const unsigned port;
 	const bool keepalive;
 
-	struct mpd_connection *connection;
+	/**
+	 * Keep a copy of the remote database in memory and answer
+	 * all queries from it?  (Option "mirror")
+	 */
+	const bool mirror;
+
+	/**
+	 * The maximum number of additional connections used for
+	 * queries (option "connections").  If this is 0, then all
+	 * queries are sent over #connection.
+	 */
+	const unsigned max_pool_connections;
+
+	/**
+	 * This connection receives "idle" events.  Unless the
+	 * connection pool is enabled, it is also used for all
+	 * queries.
+	 */
+	struct mpd_connection *connection = nullptr;
+
+	struct PooledConnection {
+		struct mpd_connection *connection;
+
+		std::chrono::steady_clock::time_point released;
+	};
+
+	/**
+	 * Protects #pool, #n_pool_connections and #prefetched.
+	 */
+	mutable Mutex pool_mutex;
+
+	/**
+	 * Signalled when a connection is returned to the #pool.
+	 */
+	mutable Cond pool_cond;
+
+	/**
+	 * Pool connections which are currently not in use.
+	 */
+	mutable std::vector<PooledConnection> pool;
+
+	/**
+	 * The number of pool connections which exist (idle or busy).
+	 */
+	mutable unsigned n_pool_connections = 0;
+
+	/**
+	 * Songs received by PrefetchSongs() which were not yet
+	 * obtained by GetSong().
+	 */
+	mutable std::unordered_map<std::string, struct mpd_song *> prefetched;
+
+	/**
+	 * The in-memory copy of the remote database, or nullptr if it
+	 * has not been loaded yet.  This is only used if #mirror is
+	 * enabled.  Its contents are protected with the global
+	 * #db_mutex.
+	 */
+	Directory *mirror_root = nullptr;
+
+	/**
+	 * The newest "Last-Modified" time stamp of all songs in
+	 * #mirror_root.  A refresh requests only songs which were
+	 * modified since.
+	 */
+	std::chrono::system_clock::time_point mirror_stamp;
 
 	/* this is mutable because GetStats() must be "const" */
 	mutable std::chrono::system_clock::time_point update_stamp;
@@ -122,6 +245,7 @@ public:
 	void Close() noexcept override;
 	const LightSong *GetSong(const char *uri_utf8) const override;
 	void ReturnSong(const LightSong *song) const noexcept override;
+	void PrefetchSongs(ConstBuffer<const char *> uris) const noexcept override;
 
 	void Visit(const DatabaseSelection &selection,
 		   VisitDirectory visit_directory,
@@ -132,6 +256,7 @@ public:
 						    ConstBuffer<TagType> tag_types) const override;
 
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
+	DatabaseStats CountSongs(const DatabaseSelection &selection) const override;
 
 	unsigned Update(const char *uri_utf8, bool discard) override;
 
@@ -140,12 +265,89 @@ public:
 	}
 
 private:
+	/**
+	 * A connection obtained with AcquireConnection() which is
+	 * returned with ReleaseConnection() by the destructor.
+	 */
+	class Lease {
+		const ProxyDatabase &db;
+		struct mpd_connection *const c;
+
+	public:
+		explicit Lease(const ProxyDatabase &_db)
+			:db(_db), c(db.AcquireConnection()) {}
+
+		~Lease() noexcept {
+			db.ReleaseConnection(c);
+		}
+
+		Lease(const Lease &) = delete;
+		Lease &operator=(const Lease &) = delete;
+
+		operator struct mpd_connection *() const noexcept {
+			return c;
+		}
+	};
+
 	void Connect();
 	void CheckConnection();
 	void EnsureConnected();
 
 	void Disconnect() noexcept;
 
+	/**
+	 * Obtain a connection for a query: an idle one from the
+	 * pool, a new one, or (if the pool is disabled) #connection.
+	 * If the pool is exhausted, this waits until another thread
+	 * releases a connection.
+	 *
+	 * Throws on error.
+	 */
+	struct mpd_connection *AcquireConnection() const;
+
+	void ReleaseConnection(struct mpd_connection *c) const noexcept;
+
+	/**
+	 * Close all idle pool connections.
+	 */
+	void ClosePool() noexcept;
+
+	void ClearPrefetched() const noexcept;
+
+	/**
+	 * Query the time stamp of the last database update from the
+	 * other MPD and store it in #update_stamp.
+	 */
+	void ReceiveUpdateStamp();
+
+	/**
+	 * Load the whole remote database into #mirror_root unless
+	 * that has been done already.
+	 */
+	void EnsureMirror();
+
+	/**
+	 * Load the whole remote database into a new #mirror_root
+	 * (with "listallinfo").
+	 */
+	void LoadMirror();
+
+	/**
+	 * Apply the changes of the remote database to #mirror_root:
+	 * "listall" finds deleted songs, and a "modified-since" query
+	 * obtains the ones which were added or modified.
+	 */
+	void RefreshMirror();
+
+	void DiscardMirror() noexcept;
+
+	const LightSong *GetMirrorSong(const char *uri) const;
+
+	void VisitMirror(const DatabaseSelection &selection,
+			 VisitDirectory visit_directory,
+			 VisitSong visit_song,
+			 VisitPlaylist visit_playlist) const;
+
 	/* virtual methods from SocketMonitor */
 	bool OnSocketReady(unsigned flags) noexcept override;
 
@@ -448,7 +650,9 @@ ProxyDatabase::ProxyDatabase(EventLoop &_loop, DatabaseListener &_listener,
 	 host(block.GetBlockValue("host", "")),
 	 password(block.GetBlockValue("password", "")),
 	 port(block.GetBlockValue("port", 0u)),
-	 keepalive(block.GetBlockValue("keepalive", false))
+	 keepalive(block.GetBlockValue("keepalive", false)),
+	 mirror(block.GetBlockValue("mirror", false)),
+	 max_pool_connections(block.GetBlockValue("connections", 0u))
 {
 }
 
@@ -479,13 +683,23 @@ ProxyDatabase::Close() noexcept
 {
 	if (connection != nullptr)
 		Disconnect();
+
+	ClosePool();
+	ClearPrefetched();
+	DiscardMirror();
 }
 
-void
-ProxyDatabase::Connect()
+/**
+ * Open a new connection to the other MPD and log in.
+ *
+ * Throws on error.
+ */
+static struct mpd_connection *
+ConnectUpstream(const std::string &host, unsigned port,
+		const std::string &password, bool keepalive)
 {
 	const char *_host = host.empty() ? nullptr : host.c_str();
-	connection = mpd_connection_new(_host, port, 0);
+	auto *connection = mpd_connection_new(_host, port, 0);
 	if (connection == nullptr)
 		throw LibmpdclientError(MPD_ERROR_OOM, "Out of memory");
 
@@ -501,7 +715,6 @@ ProxyDatabase::Connect()
 			ThrowError(connection);
 	} catch (...) {
 		mpd_connection_free(connection);
-		connection = nullptr;
 
 		std::throw_with_nested(host.empty()
 				       ? std::runtime_error("Failed to connect to remote MPD")
@@ -512,10 +725,17 @@ ProxyDatabase::Connect()
 #if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
 	mpd_connection_set_keepalive(connection, keepalive);
 #else
-	// suppress -Wunused-private-field
 	(void)keepalive;
 #endif
 
+	return connection;
+}
+
+void
+ProxyDatabase::Connect()
+{
+	connection = ConnectUpstream(host, port, password, keepalive);
+
 	idle_received = ~0u;
 	is_idle = false;
 
@@ -572,6 +792,95 @@ ProxyDatabase::Disconnect() noexcept
 	connection = nullptr;
 }
 
+struct mpd_connection *
+ProxyDatabase::AcquireConnection() const
+{
+	if (max_pool_connections == 0) {
+		// TODO: eliminate the const_cast
+		const_cast<ProxyDatabase *>(this)->EnsureConnected();
+		return connection;
+	}
+
+	std::unique_lock<Mutex> lock(pool_mutex);
+
+	while (true) {
+		while (!pool.empty()) {
+			const auto item = pool.back();
+			pool.pop_back();
+
+			if (std::chrono::steady_clock::now() - item.released < POOL_IDLE_TIMEOUT)
+				return item.connection;
+
+			/* this one has been idle for too long; the
+			   other MPD may have closed it already */
+			mpd_connection_free(item.connection);
+			--n_pool_connections;
+		}
+
+		if (n_pool_connections < max_pool_connections) {
+			++n_pool_connections;
+			lock.unlock();
+
+			try {
+				return ConnectUpstream(host, port, password,
+						       keepalive);
+			} catch (...) {
+				lock.lock();
+				--n_pool_connections;
+				pool_cond.notify_one();
+				throw;
+			}
+		}
+
+		pool_cond.wait(lock);
+	}
+}
+
+void
+ProxyDatabase::ReleaseConnection(struct mpd_connection *c) const noexcept
+{
+	if (max_pool_connections == 0)
+		return;
+
+	const bool usable = mpd_connection_get_error(c) == MPD_ERROR_SUCCESS ||
+		mpd_connection_clear_error(c);
+	if (!usable)
+		mpd_connection_free(c);
+
+	const std::lock_guard<Mutex> lock(pool_mutex);
+
+	if (usable)
+		pool.push_back({c, std::chrono::steady_clock::now()});
+	else
+		--n_pool_connections;
+
+	pool_cond.notify_one();
+}
+
+void
+ProxyDatabase::ClosePool() noexcept
+{
+	const std::lock_guard<Mutex> lock(pool_mutex);
+
+	for (const auto &i : pool) {
+		mpd_connection_free(i.connection);
+		--n_pool_connections;
+	}
+
+	pool.clear();
+}
+
+void
+ProxyDatabase::ClearPrefetched() const noexcept
+{
+	const std::lock_guard<Mutex> lock(pool_mutex);
+
+	for (const auto &i : prefetched)
+		mpd_song_free(i.second);
+
+	prefetched.clear();
+}
+
 bool
 ProxyDatabase::OnSocketReady(gcc_unused unsigned flags) noexcept
 {
@@ -610,8 +919,23 @@ ProxyDatabase::OnIdle() noexcept
 
 	/* handle previous idle events */
 
-	if (idle_received & MPD_IDLE_DATABASE)
+	if (idle_received & MPD_IDLE_DATABASE) {
+		ClearPrefetched();
+
+		if (mirror) {
+			try {
+				RefreshMirror();
+			} catch (...) {
+				LogError(std::current_exception(),
+					 "Failed to refresh the mirror of the remote database");
+
+				/* load it again on the next query */
+				DiscardMirror();
+			}
+		}
+
 		listener.OnDatabaseModified();
+	}
 
 	idle_received = 0;
 
@@ -641,17 +965,33 @@ ProxyDatabase::OnIdle() noexcept
 const LightSong *
 ProxyDatabase::GetSong(const char *uri) const
 {
-	// TODO: eliminate the const_cast
-	const_cast<ProxyDatabase *>(this)->EnsureConnected();
+	if (mirror) {
+		// TODO: eliminate the const_cast
+		const_cast<ProxyDatabase *>(this)->EnsureMirror();
+		return GetMirrorSong(uri);
+	}
 
-	if (!mpd_send_list_meta(connection, uri))
-		ThrowError(connection);
+	{
+		const std::lock_guard<Mutex> lock(pool_mutex);
+
+		auto i = prefetched.find(uri);
+		if (i != prefetched.end()) {
+			struct mpd_song *song = i->second;
+			prefetched.erase(i);
+			return new AllocatedProxySong(song);
+		}
+	}
+
+	const Lease c(*this);
 
-	struct mpd_song *song = mpd_recv_song(connection);
-	if (!mpd_response_finish(connection)) {
+	if (!mpd_send_list_meta(c, uri))
+		ThrowError(c);
+
+	struct mpd_song *song = mpd_recv_song(c);
+	if (!mpd_response_finish(c)) {
 		if (song != nullptr)
 			mpd_song_free(song);
-		ThrowError(connection);
+		ThrowError(c);
 	}
 
 	if (song == nullptr)
@@ -666,6 +1006,11 @@ ProxyDatabase::ReturnSong(const LightSong *_song) const noexcept
 {
 	assert(_song != nullptr);
 
+	if (mirror) {
+		delete (const MirrorSong *)_song;
+		return;
+	}
+
 	AllocatedProxySong *song = (AllocatedProxySong *)
 		const_cast<LightSong *>(_song);
 	delete song;
@@ -810,6 +1155,101 @@ Visit(struct mpd_connection *connection, const char *uri,
 	}
 }
 
+/**
+ * Send "lsinfo" for each of the given URIs in one command list and
+ * append the songs to #result.
+ *
+ * Throws on error.
+ *
+ * @return the number of URIs which were processed
+ */
+static size_t
+PrefetchSongs(struct mpd_connection *c, ConstBuffer<const char *> uris,
+	      std::vector<struct mpd_song *> &result)
+{
+	assert(!uris.empty());
+
+	if (!mpd_command_list_begin(c, true))
+		ThrowError(c);
+
+	for (const char *uri : uris)
+		if (!mpd_send_list_meta(c, uri))
+			ThrowError(c);
+
+	if (!mpd_command_list_end(c))
+		ThrowError(c);
+
+	size_t i = 0;
+	while (true) {
+		while (auto *entity = mpd_recv_entity(c)) {
+			const ProxyEntity e(entity);
+			if (mpd_entity_get_type(e) != MPD_ENTITY_TYPE_SONG)
+				continue;
+
+			const auto *song = mpd_entity_get_song(e);
+			if (strcmp(mpd_song_get_uri(song), uris[i]) == 0)
+				result.push_back(mpd_song_dup(song));
+		}
+
+		if (mpd_connection_get_error(c) != MPD_ERROR_SUCCESS ||
+		    ++i == uris.size || !mpd_response_next(c))
+			break;
+	}
+
+	if (!mpd_response_finish(c)) {
+		if (mpd_connection_get_error(c) != MPD_ERROR_SERVER)
+			ThrowError(c);
+
+		/* MPD aborts the command list at the first command
+		   which fails (e.g. because the song does not exist);
+		   skip that one and let the caller continue after
+		   it */
+		mpd_connection_clear_error(c);
+		return std::min(i + 1, uris.size);
+	}
+
+	return uris.size;
+}
+
+void
+ProxyDatabase::PrefetchSongs(ConstBuffer<const char *> uris) const noexcept
+{
+	if (mirror)
+		/* the mirror answers GetSong() quickly */
+		return;
+
+	std::vector<struct mpd_song *> songs;
+
+	try {
+		const Lease c(*this);
+
+		while (!uris.empty()) {
+			auto chunk = uris;
+			if (chunk.size > PREFETCH_CHUNK)
+				chunk.size = PREFETCH_CHUNK;
+
+			uris.skip_front(::PrefetchSongs(c, chunk, songs));
+		}
+	} catch (...) {
+		LogError(std::current_exception(), "Failed to prefetch songs");
+	}
+
+	const std::lock_guard<Mutex> lock(pool_mutex);
+
+	for (auto *song : songs) {
+		if (prefetched.size() >= MAX_PREFETCHED) {
+			mpd_song_free(song);
+			continue;
+		}
+
+		auto i = prefetched.emplace(mpd_song_get_uri(song), song);
+		if (!i.second) {
+			mpd_song_free(i.first->second);
+			i.first->second = song;
+		}
+	}
+}
+
 static void
 SearchSongs(struct mpd_connection *connection,
 	    const DatabaseSelection &selection,
@@ -972,36 +1412,41 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitSong visit_song,
 		     VisitPlaylist visit_playlist) const
 {
-	// TODO: eliminate the const_cast
-	const_cast<ProxyDatabase *>(this)->EnsureConnected();
+	if (mirror) {
+		// TODO: eliminate the const_cast
+		const_cast<ProxyDatabase *>(this)->EnsureMirror();
+		VisitMirror(selection, visit_directory, visit_song,
+			    visit_playlist);
+		return;
+	}
+
+	const Lease c(*this);
 
-	DatabaseVisitorHelper helper(CheckSelection(selection, connection),
+	DatabaseVisitorHelper helper(CheckSelection(selection, c),
 				     visit_song);
 
 	if (!visit_directory && !visit_playlist && selection.recursive &&
 	    !selection.IsEmpty()) {
 		/* this optimized code path can only be used under
 		   certain conditions */
-		::SearchSongs(connection, selection, visit_song);
+		::SearchSongs(c, selection, visit_song);
 		helper.Commit();
 		return;
 	}
 
 	/* fall back to recursive walk (slow!) */
-	::Visit(connection, selection.uri.c_str(),
+	::Visit(c, selection.uri.c_str(),
 		selection.recursive, selection.filter,
 		visit_directory, visit_song, visit_playlist);
 
 	helper.Commit();
 }
 
-RecursiveMap<std::string>
-ProxyDatabase::CollectUniqueTags(const DatabaseSelection &selection,
-				 ConstBuffer<TagType> tag_types) const
-try {
-	// TODO: eliminate the const_cast
-	const_cast<ProxyDatabase *>(this)->EnsureConnected();
-
+static RecursiveMap<std::string>
+CollectUniqueTags(struct mpd_connection *connection,
+		  const DatabaseSelection &selection,
+		  ConstBuffer<TagType> tag_types)
+{
 	enum mpd_tag_type tag_type2 = Convert(tag_types.back());
 	if (tag_type2 == MPD_TAG_COUNT)
 		throw std::runtime_error("Unsupported tag");
@@ -1022,7 +1467,7 @@ try {
 	position.emplace_back(&result);
 
 	while (auto *pair = mpd_recv_pair(connection)) {
-		AtScopeExit(this, pair) {
+		AtScopeExit(connection, pair) {
 			mpd_return_pair(connection, pair);
 		};
 
@@ -1050,26 +1495,57 @@ try {
 		ThrowError(connection);
 
 	return result;
-} catch (...) {
-	if (connection != nullptr)
-		mpd_search_cancel(connection);
+}
 
-	throw;
+RecursiveMap<std::string>
+ProxyDatabase::CollectUniqueTags(const DatabaseSelection &selection,
+				 ConstBuffer<TagType> tag_types) const
+{
+	if (mirror)
+		return ::CollectUniqueTags(*this, selection, tag_types);
+
+	const Lease c(*this);
+
+	try {
+		return ::CollectUniqueTags(c, selection, tag_types);
+	} catch (...) {
+		mpd_search_cancel(c);
+		throw;
+	}
 }
 
 DatabaseStats
 ProxyDatabase::GetStats(const DatabaseSelection &selection) const
 {
+	if (mirror) {
+		// TODO: eliminate the const_cast
+		const_cast<ProxyDatabase *>(this)->EnsureMirror();
+
+		if (selection.IsEmpty() && selection.recursive) {
+			const ScopeDatabaseLock protect;
+			const auto &totals = mirror_root->totals;
+
+			DatabaseStats stats;
+			stats.song_count = totals.n_songs;
+			stats.total_duration = totals.tag_duration;
+			stats.artist_count = mirror_root->tag_counter->GetArtistCount();
+			stats.album_count = mirror_root->tag_counter->GetAlbumCount();
+			stats.song_memory = totals.memory;
+			return stats;
+		}
+
+		return ::GetStats(*this, selection);
+	}
+
 	// TODO: match
 	(void)selection;
 
-	// TODO: eliminate the const_cast
-	const_cast<ProxyDatabase *>(this)->EnsureConnected();
+	const Lease c(*this);
 
 	struct mpd_stats *stats2 =
-		mpd_run_stats(connection);
+		mpd_run_stats(c);
 	if (stats2 == nullptr)
-		ThrowError(connection);
+		ThrowError(c);
 
 	update_stamp = std::chrono::system_clock::from_time_t(mpd_stats_get_db_update_time(stats2));
 
@@ -1078,24 +1554,499 @@ ProxyDatabase::GetStats(const DatabaseSelection &selection) const
 	stats.total_duration = std::chrono::seconds(mpd_stats_get_db_play_time(stats2));
 	stats.artist_count = mpd_stats_get_number_of_artists(stats2);
 	stats.album_count = mpd_stats_get_number_of_albums(stats2);
+	stats.song_memory = 0;
 	mpd_stats_free(stats2);
 	return stats;
 }
 
+DatabaseStats
+ProxyDatabase::CountSongs(const DatabaseSelection &selection) const
+{
+	return ::CountSongs(*this, selection);
+}
+
 unsigned
 ProxyDatabase::Update(const char *uri_utf8, bool discard)
 {
-	EnsureConnected();
+	const Lease c(*this);
 
 	unsigned id = discard
-		? mpd_run_rescan(connection, uri_utf8)
-		: mpd_run_update(connection, uri_utf8);
+		? mpd_run_rescan(c, uri_utf8)
+		: mpd_run_update(c, uri_utf8);
 	if (id == 0)
-		CheckError(connection);
+		CheckError(c);
 
 	return id;
 }
 
+void
+ProxyDatabase::ReceiveUpdateStamp()
+{
+	struct mpd_stats *stats = mpd_run_stats(connection);
+	if (stats == nullptr)
+		ThrowError(connection);
+
+	update_stamp = std::chrono::system_clock::from_time_t(mpd_stats_get_db_update_time(stats));
+	mpd_stats_free(stats);
+}
+
+/**
+ * Look up a directory in the mirror, and create it (and all of its
+ * parents) if it does not exist.
+ *
+ * Caller must lock the #db_mutex.
+ */
+static Directory &
+MakeMirrorDirectory(Directory &root, const char *path) noexcept
+{
+	Directory *directory = &root;
+
+	while (*path != 0) {
+		const char *slash = strchr(path, '/');
+		if (slash == nullptr)
+			return *directory->MakeChild(path);
+
+		directory = directory->MakeChild(std::string(path, slash).c_str());
+		path = slash + 1;
+	}
+
+	return *directory;
+}
+
+/**
+ * Create the parent directory of the given URI in the mirror.
+ *
+ * Caller must lock the #db_mutex.
+ *
+ * @return the parent directory and the base name
+ */
+static std::pair<Directory *, const char *>
+MakeMirrorParent(Directory &root, const char *uri) noexcept
+{
+	const char *slash = strrchr(uri, '/');
+	if (slash == nullptr)
+		return {&root, uri};
+
+	return {
+		&MakeMirrorDirectory(root, std::string(uri, slash).c_str()),
+		slash + 1,
+	};
+}
+
+/**
+ * Add a song to the mirror, replacing an existing one with the same
+ * URI.
+ *
+ * Caller must lock the #db_mutex.
+ *
+ * @return the song's "Last-Modified" time stamp
+ */
+static std::chrono::system_clock::time_point
+AddToMirror(Directory &root, const ProxySong &song)
+{
+	const auto parent = MakeMirrorParent(root, song.uri);
+
+	Song *old = parent.first->FindSong(parent.second);
+	if (old != nullptr)
+		parent.first->RemoveSong(old);
+
+	parent.first->AddSong(Song::New(parent.second, DetachedSong(song),
+					*parent.first));
+	return song.mtime;
+}
+
+/**
+ * Caller must lock the #db_mutex.
+ */
+static void
+AddToMirror(Directory &root, const struct mpd_playlist *playlist) noexcept
+{
+	const auto parent = MakeMirrorParent(root,
+					     mpd_playlist_get_path(playlist));
+
+	time_t mtime = mpd_playlist_get_last_modified(playlist);
+	parent.first->playlists.UpdateOrInsert(PlaylistInfo(parent.second,
+							    mtime > 0
+							    ? std::chrono::system_clock::from_time_t(mtime)
+							    : std::chrono::system_clock::time_point::min()));
+}
+
+/**
+ * Add an entity received from "listallinfo" to the mirror.
+ *
+ * Caller must lock the #db_mutex.
+ */
+static void
+AddToMirror(Directory &root, const struct mpd_entity *entity,
+	    std::chrono::system_clock::time_point &stamp)
+{
+	switch (mpd_entity_get_type(entity)) {
+	case MPD_ENTITY_TYPE_UNKNOWN:
+		break;
+
+	case MPD_ENTITY_TYPE_DIRECTORY:
+		{
+			const auto *directory = mpd_entity_get_directory(entity);
+			auto &d = MakeMirrorDirectory(root,
+						      mpd_directory_get_path(directory));
+
+			time_t mtime = mpd_directory_get_last_modified(directory);
+			if (mtime > 0)
+				d.mtime = std::chrono::system_clock::from_time_t(mtime);
+		}
+
+		break;
+
+	case MPD_ENTITY_TYPE_SONG:
+		stamp = std::max(stamp,
+				 AddToMirror(root,
+					     ProxySong(mpd_entity_get_song(entity))));
+		break;
+
+	case MPD_ENTITY_TYPE_PLAYLIST:
+		AddToMirror(root, mpd_entity_get_playlist(entity));
+		break;
+	}
+}
+
+void
+ProxyDatabase::EnsureMirror()
+{
+	if (mirror_root != nullptr)
+		return;
+
+	EnsureConnected();
+	LoadMirror();
+}
+
+void
+ProxyDatabase::LoadMirror()
+{
+	assert(connection != nullptr);
+
+	if (!mpd_send_list_all_meta(connection, ""))
+		ThrowError(connection);
+
+	std::unique_ptr<Directory> new_root(Directory::NewRoot());
+	auto stamp = std::chrono::system_clock::time_point::min();
+
+	while (auto *entity = mpd_recv_entity(connection)) {
+		const ProxyEntity e(entity);
+
+		/* the new tree is not visible to other threads yet,
+		   but Directory insists on the lock */
+		const ScopeDatabaseLock protect;
+		AddToMirror(*new_root, e, stamp);
+	}
+
+	if (!mpd_response_finish(connection))
+		ThrowError(connection);
+
+	ReceiveUpdateStamp();
+
+	Directory *old_root = new_root.release();
+
+	{
+		const ScopeDatabaseLock protect;
+		std::swap(mirror_root, old_root);
+	}
+
+	/* songs obtained with GetSong() are copies, so nobody
+	   references the old tree anymore */
+	delete old_root;
+
+	mirror_stamp = stamp;
+}
+
+namespace {
+
+/**
+ * The URIs received with "listall".
+ */
+struct RemoteUris {
+	std::unordered_set<std::string> directories, songs, playlists;
+
+	void Add(const struct mpd_entity *entity) {
+		switch (mpd_entity_get_type(entity)) {
+		case MPD_ENTITY_TYPE_UNKNOWN:
+			break;
+
+		case MPD_ENTITY_TYPE_DIRECTORY:
+			directories.emplace(mpd_directory_get_path(mpd_entity_get_directory(entity)));
+			break;
+
+		case MPD_ENTITY_TYPE_SONG:
+			songs.emplace(mpd_song_get_uri(mpd_entity_get_song(entity)));
+			break;
+
+		case MPD_ENTITY_TYPE_PLAYLIST:
+			playlists.emplace(mpd_playlist_get_path(mpd_entity_get_playlist(entity)));
+			break;
+		}
+	}
+};
+
+}
+
+gcc_pure
+static std::string
+JoinMirrorPath(const Directory &directory, const char *name) noexcept
+{
+	if (directory.IsRoot())
+		return name;
+
+	std::string result(directory.GetPath());
+	result.push_back('/');
+	result.append(name);
+	return result;
+}
+
+/**
+ * Remove all objects from the mirror which do not exist in the
+ * remote database anymore.  All URIs which exist in the mirror are
+ * removed from #remote, so it contains only the new ones afterwards.
+ *
+ * Caller must lock the #db_mutex.
+ */
+static void
+PruneMirror(Directory &directory, RemoteUris &remote) noexcept
+{
+	directory.ForEachChildSafe([&remote](Directory &child){
+		auto i = remote.directories.find(child.GetPath());
+		if (i == remote.directories.end()) {
+			child.Delete();
+			return;
+		}
+
+		remote.directories.erase(i);
+		PruneMirror(child, remote);
+	});
+
+	directory.ForEachSongSafe([&directory, &remote](Song &song){
+		auto i = remote.songs.find(song.GetURI());
+		if (i == remote.songs.end()) {
+			directory.RemoveSong(&song);
+			return;
+		}
+
+		remote.songs.erase(i);
+	});
+
+	for (auto i = directory.playlists.begin();
+	     i != directory.playlists.end();) {
+		auto j = remote.playlists.find(JoinMirrorPath(directory,
+							      i->name.c_str()));
+		if (j == remote.playlists.end()) {
+			i = directory.playlists.erase(i);
+			db_modified();
+			continue;
+		}
+
+		remote.playlists.erase(j);
+		++i;
+	}
+}
+
+void
+ProxyDatabase::RefreshMirror()
+{
+	assert(connection != nullptr);
+
+	if (mirror_root == nullptr) {
+		LoadMirror();
+		return;
+	}
+
+#if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+	/* obtain all URIs (without metadata) to find out which
+	   objects have been deleted */
+
+	if (!mpd_send_list_all(connection, ""))
+		ThrowError(connection);
+
+	RemoteUris remote;
+
+	while (auto *entity = mpd_recv_entity(connection)) {
+		const ProxyEntity e(entity);
+		remote.Add(e);
+	}
+
+	if (!mpd_response_finish(connection))
+		ThrowError(connection);
+
+	/* receive all songs which were modified since the last
+	   refresh */
+
+	const time_t since = mirror_stamp > std::chrono::system_clock::from_time_t(0)
+		? std::chrono::system_clock::to_time_t(mirror_stamp)
+		: 0;
+
+	std::list<AllocatedProxySong> modified;
+
+	try {
+		if (!mpd_search_db_songs(connection, true) ||
+		    !mpd_search_add_modified_since_constraint(connection,
+							      MPD_OPERATOR_DEFAULT,
+							      since) ||
+		    !mpd_search_commit(connection))
+			ThrowError(connection);
+
+		while (auto *song = mpd_recv_song(connection))
+			modified.emplace_back(song);
+
+		if (!mpd_response_finish(connection))
+			ThrowError(connection);
+	} catch (...) {
+		mpd_search_cancel(connection);
+		throw;
+	}
+
+	auto stamp = mirror_stamp;
+
+	{
+		const ScopeDatabaseLock protect;
+
+		PruneMirror(*mirror_root, remote);
+
+		for (const auto &song : modified) {
+			stamp = std::max(stamp, AddToMirror(*mirror_root, song));
+			remote.songs.erase(song.uri);
+		}
+
+		for (const auto &path : remote.directories)
+			MakeMirrorDirectory(*mirror_root, path.c_str());
+
+		for (const auto &path : remote.playlists) {
+			const auto parent = MakeMirrorParent(*mirror_root,
+							     path.c_str());
+			parent.first->playlists.UpdateOrInsert(PlaylistInfo(parent.second,
+									    std::chrono::system_clock::time_point::min()));
+		}
+	}
+
+	/* songs which are new, but have an old time stamp (e.g. they
+	   were moved) */
+
+	if (remote.songs.size() > MIRROR_MAX_MISSING) {
+		LoadMirror();
+		return;
+	}
+
+	for (const auto &uri : remote.songs) {
+		if (!mpd_send_list_meta(connection, uri.c_str()))
+			ThrowError(connection);
+
+		struct mpd_song *song = mpd_recv_song(connection);
+		if (!mpd_response_finish(connection)) {
+			if (song != nullptr)
+				mpd_song_free(song);
+			ThrowError(connection);
+		}
+
+		if (song == nullptr)
+			continue;
+
+		const AllocatedProxySong song2(song);
+		const ScopeDatabaseLock protect;
+		stamp = std::max(stamp, AddToMirror(*mirror_root, song2));
+	}
+
+	ReceiveUpdateStamp();
+
+	mirror_stamp = stamp;
+#else
+	/* without "modified-since" support, load everything
+	   again */
+	LoadMirror();
+#endif
+}
+
+void
+ProxyDatabase::DiscardMirror() noexcept
+{
+	Directory *old_root = nullptr;
+
+	{
+		const ScopeDatabaseLock protect;
+		std::swap(mirror_root, old_root);
+	}
+
+	delete old_root;
+}
+
+const LightSong *
+ProxyDatabase::GetMirrorSong(const char *uri) const
+{
+	assert(mirror_root != nullptr);
+
+	const ScopeDatabaseLock protect;
+
+	auto r = mirror_root->LookupDirectory(uri);
+	if (r.uri == nullptr || strchr(r.uri, '/') != nullptr)
+		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+				    "No such song");
+
+	const Song *song = r.directory->FindSong(r.uri);
+	if (song == nullptr)
+		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+				    "No such song");
+
+	return new MirrorSong(song->Export());
+}
+
+gcc_const
+static DatabaseSelection
+CheckMirrorSelection(DatabaseSelection selection) noexcept
+{
+	selection.uri.clear();
+	selection.filter = nullptr;
+	return selection;
+}
+
+void
+ProxyDatabase::VisitMirror(const DatabaseSelection &selection,
+			   VisitDirectory visit_directory,
+			   VisitSong visit_song,
+			   VisitPlaylist visit_playlist) const
+{
+	assert(mirror_root != nullptr);
+
+	const ScopeDatabaseLock protect;
+
+	auto r = mirror_root->LookupDirectory(selection.uri.c_str());
+
+	DatabaseVisitorHelper helper(CheckMirrorSelection(selection),
+				     visit_song);
+
+	if (r.uri == nullptr) {
+		/* it's a directory */
+
+		if (selection.recursive && visit_directory)
+			visit_directory(r.directory->Export());
+
+		r.directory->Walk(selection.recursive, selection.filter,
+				  visit_directory, visit_song,
+				  visit_playlist);
+		helper.Commit();
+		return;
+	}
+
+	if (strchr(r.uri, '/') == nullptr && visit_song) {
+		const Song *song = r.directory->FindSong(r.uri);
+		if (song != nullptr) {
+			const LightSong song2 = song->Export();
+			if (selection.Match(song2))
+				visit_song(song2);
+
+			helper.Commit();
+			return;
+		}
+	}
+
+	throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+			    "No such directory");
+}
+
 const DatabasePlugin proxy_db_plugin = {
 	"proxy",
 	DatabasePlugin::FLAG_REQUIRE_STORAGE,
@@ -0,0 +1,693 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "DatabaseBinary.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/Charset.hxx"
+#include "tag/Builder.hxx"
+#include "tag/ParseName.hxx"
+#include "tag/Settings.hxx"
+#include "time/ChronoUtil.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/StringView.hxx"
+
+#ifdef _WIN32
+#include <memory>
+#else
+#include "system/Error.hxx"
+#include <sys/mman.h>
+#endif
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * The version of the binary database layout.  It is independent of
+ * the text format's DB_FORMAT, and must be incremented whenever one
+ * of the structs below changes.
+ */
+static constexpr uint32_t BINARY_DB_FORMAT = 2;
+
+static constexpr char BINARY_DB_MAGIC[8] = {
+	'M', 'P', 'D', 'B', 'I', 'N', 'D', 'B',
+};
+
+/**
+ * All integers are stored in host byte order; this value is used to
+ * reject files written by a host with a different byte order.
+ */
+static constexpr uint32_t BINARY_DB_BYTE_ORDER = 0x01020304;
+
+static constexpr uint32_t BINARY_NO_PARENT = UINT32_MAX;
+static constexpr int64_t BINARY_NO_MTIME = INT64_MIN;
+
+namespace {
+
+/**
+ * A reference to a null-terminated string in the string table.
+ */
+struct BinaryString {
+	uint32_t offset, length;
+};
+
+/*
+ * The file consists of the header followed by these arrays (in
+ * this order): directories, songs, playlists, tags, items and the
+ * string table.  The sizes of the first three are multiples of 8,
+ * which keeps all records properly aligned.
+ */
+
+struct BinaryHeader {
+	char magic[sizeof(BINARY_DB_MAGIC)];
+	uint32_t format;
+	uint32_t byte_order;
+
+	BinaryString mpd_version, fs_charset;
+
+	uint32_t n_directories, n_songs, n_playlists, n_tags, n_items;
+
+	uint32_t string_table_size;
+};
+
+/**
+ * Directories are stored in pre-order, i.e. each parent is stored
+ * before its children, and the root directory comes first.  The
+ * songs and playlists of a directory are contiguous ranges.
+ */
+struct BinaryDirectory {
+	BinaryString name;
+	int64_t mtime;
+	uint32_t parent;
+	uint32_t device;
+	uint32_t first_song, n_songs;
+	uint32_t first_playlist, n_playlists;
+};
+
+struct BinarySong {
+	BinaryString filename, target;
+	int64_t mtime;
+	uint32_t start_ms, end_ms;
+	int32_t duration_ms;
+	uint32_t sample_rate;
+	uint32_t first_item, n_items;
+	uint8_t format, channels, has_playlist, reserved1;
+	uint32_t reserved2;
+
+	/**
+	 * The measured ReplayGain values (see
+	 * Song::GetReplayGain()); a gain of -200 means undefined.
+	 */
+	float track_gain, track_peak, album_gain, album_peak;
+};
+
+struct BinaryPlaylist {
+	BinaryString name;
+	int64_t mtime;
+};
+
+/**
+ * The tag types known to the MPD version which wrote the file.
+ * Items refer to these by index, so the numeric values of #TagType
+ * are not part of the format.
+ */
+struct BinaryTag {
+	BinaryString name;
+	uint32_t enabled;
+};
+
+struct BinaryItem {
+	uint32_t tag;
+	BinaryString value;
+};
+
+static_assert(sizeof(BinaryHeader) % 8 == 0, "Bad BinaryHeader size");
+static_assert(sizeof(BinaryDirectory) % 8 == 0, "Bad BinaryDirectory size");
+static_assert(sizeof(BinarySong) % 8 == 0, "Bad BinarySong size");
+static_assert(sizeof(BinaryPlaylist) % 8 == 0, "Bad BinaryPlaylist size");
+
+}
+
+static int64_t
+ExportTime(std::chrono::system_clock::time_point t) noexcept
+{
+	return IsNegative(t)
+		? BINARY_NO_MTIME
+		: int64_t(std::chrono::system_clock::to_time_t(t));
+}
+
+static std::chrono::system_clock::time_point
+ImportTime(int64_t t) noexcept
+{
+	return t > 0
+		? std::chrono::system_clock::from_time_t(t)
+		: std::chrono::system_clock::time_point::min();
+}
+
+static uint32_t
+CheckedSize(size_t size)
+{
+	if (size >= UINT32_MAX)
+		throw std::runtime_error("Database too large for the binary format");
+
+	return uint32_t(size);
+}
+
+namespace {
+
+/**
+ * Collects all strings in one buffer, storing each distinct value
+ * only once.
+ */
+class BinaryStringTable {
+	std::string data;
+	std::unordered_map<std::string, uint32_t> map;
+
+public:
+	BinaryString Add(StringView s) {
+		auto i = map.emplace(std::string(s.data, s.size),
+				     uint32_t(data.size()));
+		if (i.second) {
+			CheckedSize(data.size() + s.size + 1);
+			data.append(s.data, s.size);
+			data.push_back('\0');
+		}
+
+		return {i.first->second, uint32_t(s.size)};
+	}
+
+	BinaryString Add(const std::string &s) {
+		return Add(StringView(s.data(), s.length()));
+	}
+
+	BinaryString Add(const char *s) {
+		return Add(StringView(s));
+	}
+
+	const std::string &GetData() const noexcept {
+		return data;
+	}
+};
+
+class BinaryDatabaseBuilder {
+	BinaryStringTable strings;
+
+	std::vector<BinaryDirectory> directories;
+	std::vector<BinarySong> songs;
+	std::vector<BinaryPlaylist> playlists;
+	std::vector<BinaryTag> tags;
+	std::vector<BinaryItem> items;
+
+public:
+	BinaryDatabaseBuilder() {
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+			BinaryTag tag;
+			tag.name = strings.Add(tag_item_names[i]);
+			tag.enabled = IsTagEnabled(i);
+			tags.push_back(tag);
+		}
+	}
+
+	void AddDirectory(const Directory &directory, uint32_t parent);
+
+	void Write(BufferedOutputStream &os);
+
+private:
+	void AddSong(const Song &song);
+
+	template<typename T>
+	static void WriteArray(BufferedOutputStream &os,
+			       const std::vector<T> &v) {
+		os.Write(v.data(), v.size() * sizeof(T));
+	}
+};
+
+}
+
+inline void
+BinaryDatabaseBuilder::AddSong(const Song &song)
+{
+	BinarySong s;
+	memset(&s, 0, sizeof(s));
+
+	s.filename = strings.Add(song.GetFilename());
+	s.target = strings.Add(song.GetTarget());
+	s.mtime = ExportTime(song.mtime);
+	s.start_ms = song.GetStartTime().ToMS();
+	s.end_ms = song.GetEndTime().ToMS();
+	s.duration_ms = song.tag.duration.IsNegative()
+		? -1
+		: song.tag.duration.ToMS();
+	s.has_playlist = song.tag.has_playlist;
+
+	if (song.audio_format.IsDefined()) {
+		s.sample_rate = song.audio_format.sample_rate;
+		s.format = uint8_t(song.audio_format.format);
+		s.channels = song.audio_format.channels;
+	}
+
+	const auto replay_gain = song.GetReplayGain();
+	s.track_gain = replay_gain.track.gain;
+	s.track_peak = replay_gain.track.peak;
+	s.album_gain = replay_gain.album.gain;
+	s.album_peak = replay_gain.album.peak;
+
+	s.first_item = CheckedSize(items.size());
+	s.n_items = song.tag.num_items;
+
+	for (const auto &i : song.tag) {
+		BinaryItem item;
+		item.tag = i.type;
+		item.value = strings.Add(i.value);
+		items.push_back(item);
+	}
+
+	songs.push_back(s);
+}
+
+void
+BinaryDatabaseBuilder::AddDirectory(const Directory &directory,
+				    uint32_t parent)
+{
+	const uint32_t index = CheckedSize(directories.size());
+
+	BinaryDirectory d;
+	memset(&d, 0, sizeof(d));
+
+	d.name = strings.Add(directory.IsRoot() ? "" : directory.GetName());
+	d.mtime = ExportTime(directory.mtime);
+	d.parent = parent;
+	if (directory.IsReallyAFile())
+		d.device = directory.device;
+
+	d.first_song = CheckedSize(songs.size());
+	for (const auto &song : directory.songs)
+		AddSong(song);
+	d.n_songs = songs.size() - d.first_song;
+
+	d.first_playlist = CheckedSize(playlists.size());
+	for (const auto &pi : directory.playlists) {
+		BinaryPlaylist p;
+		p.name = strings.Add(pi.name);
+		p.mtime = ExportTime(pi.mtime);
+		playlists.push_back(p);
+	}
+	d.n_playlists = playlists.size() - d.first_playlist;
+
+	directories.push_back(d);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			AddDirectory(child, index);
+}
+
+void
+BinaryDatabaseBuilder::Write(BufferedOutputStream &os)
+{
+	BinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_DB_MAGIC, sizeof(header.magic));
+	header.format = BINARY_DB_FORMAT;
+	header.byte_order = BINARY_DB_BYTE_ORDER;
+	header.mpd_version = strings.Add(VERSION);
+	header.fs_charset = strings.Add(GetFSCharset());
+	header.n_directories = CheckedSize(directories.size());
+	header.n_songs = CheckedSize(songs.size());
+	header.n_playlists = CheckedSize(playlists.size());
+	header.n_tags = CheckedSize(tags.size());
+	header.n_items = CheckedSize(items.size());
+	header.string_table_size = CheckedSize(strings.GetData().size());
+
+	os.Write(&header, sizeof(header));
+	WriteArray(os, directories);
+	WriteArray(os, songs);
+	WriteArray(os, playlists);
+	WriteArray(os, tags);
+	WriteArray(os, items);
+	os.Write(strings.GetData().data(), strings.GetData().size());
+}
+
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root)
+{
+	BinaryDatabaseBuilder builder;
+	builder.AddDirectory(root, BINARY_NO_PARENT);
+	builder.Write(os);
+}
+
+bool
+db_is_binary(Path path)
+{
+	FileReader reader(path);
+
+	char magic[sizeof(BINARY_DB_MAGIC)];
+	size_t nbytes = 0;
+	while (nbytes < sizeof(magic)) {
+		size_t n = reader.Read(magic + nbytes, sizeof(magic) - nbytes);
+		if (n == 0)
+			return false;
+		nbytes += n;
+	}
+
+	return memcmp(magic, BINARY_DB_MAGIC, sizeof(magic)) == 0;
+}
+
+namespace {
+
+/**
+ * Makes the whole database file available in memory: mapped
+ * read-only where possible, so the pages are shared with the page
+ * cache instead of being copied.
+ */
+class MappedDatabaseFile {
+	const void *data;
+	size_t size;
+
+#ifdef _WIN32
+	std::unique_ptr<uint64_t[]> buffer;
+#endif
+
+public:
+	explicit MappedDatabaseFile(Path path);
+	~MappedDatabaseFile() noexcept;
+
+	MappedDatabaseFile(const MappedDatabaseFile &) = delete;
+	MappedDatabaseFile &operator=(const MappedDatabaseFile &) = delete;
+
+	const void *GetData() const noexcept {
+		return data;
+	}
+
+	size_t GetSize() const noexcept {
+		return size;
+	}
+};
+
+}
+
+MappedDatabaseFile::MappedDatabaseFile(Path path)
+{
+	FileReader reader(path);
+
+	const uint64_t size64 = reader.GetSize();
+	if (size64 < sizeof(BinaryHeader) || size64 > SIZE_MAX)
+		throw std::runtime_error("Database corrupted");
+
+	size = size64;
+
+#ifdef _WIN32
+	/* uint64_t guarantees sufficient alignment for all records */
+	buffer.reset(new uint64_t[(size + sizeof(uint64_t) - 1) / sizeof(uint64_t)]);
+	for (size_t position = 0; position < size;) {
+		size_t nbytes = reader.Read((char *)buffer.get() + position,
+					    size - position);
+		if (nbytes == 0)
+			throw std::runtime_error("Unexpected end of file");
+		position += nbytes;
+	}
+
+	data = buffer.get();
+#else
+	void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+		       reader.GetFD().Get(), 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to map database file");
+
+#ifdef MADV_WILLNEED
+	madvise(p, size, MADV_WILLNEED);
+#endif
+
+	data = p;
+#endif
+}
+
+MappedDatabaseFile::~MappedDatabaseFile() noexcept
+{
+#ifndef _WIN32
+	munmap(const_cast<void *>(data), size);
+#endif
+}
+
+namespace {
+
+/**
+ * Bounds-checked access to the sections of a mapped binary database
+ * file.
+ */
+class BinaryDatabaseReader {
+	const uint8_t *const base;
+	const size_t size;
+
+	size_t position = 0;
+
+	ConstBuffer<char> string_table;
+
+public:
+	const BinaryHeader &header;
+
+	ConstBuffer<BinaryDirectory> directories;
+	ConstBuffer<BinarySong> songs;
+	ConstBuffer<BinaryPlaylist> playlists;
+	ConstBuffer<BinaryTag> tags;
+	ConstBuffer<BinaryItem> items;
+
+	BinaryDatabaseReader(const void *_data, size_t _size);
+
+	StringView GetString(BinaryString s) const {
+		if (s.offset >= string_table.size ||
+		    s.length >= string_table.size - s.offset ||
+		    string_table[s.offset + s.length] != 0)
+			throw std::runtime_error("Database corrupted");
+
+		return {string_table.data + s.offset, s.length};
+	}
+
+	template<typename T>
+	ConstBuffer<T> GetRange(ConstBuffer<T> array,
+				uint32_t first, uint32_t n) const {
+		if (first > array.size || n > array.size - first)
+			throw std::runtime_error("Database corrupted");
+
+		return {array.data + first, n};
+	}
+
+private:
+	template<typename T>
+	ConstBuffer<T> NextSection(size_t n) {
+		if (n > (size - position) / sizeof(T))
+			throw std::runtime_error("Database corrupted");
+
+		ConstBuffer<T> result((const T *)(const void *)(base + position), n);
+		position += n * sizeof(T);
+		return result;
+	}
+};
+
+}
+
+BinaryDatabaseReader::BinaryDatabaseReader(const void *_data, size_t _size)
+	:base((const uint8_t *)_data), size(_size),
+	 header(NextSection<BinaryHeader>(1).front())
+{
+	if (memcmp(header.magic, BINARY_DB_MAGIC, sizeof(header.magic)) != 0)
+		throw std::runtime_error("Database corrupted");
+
+	if (header.format != BINARY_DB_FORMAT ||
+	    header.byte_order != BINARY_DB_BYTE_ORDER)
+		throw std::runtime_error("Database format mismatch, "
+					 "discarding database file");
+
+	directories = NextSection<BinaryDirectory>(header.n_directories);
+	songs = NextSection<BinarySong>(header.n_songs);
+	playlists = NextSection<BinaryPlaylist>(header.n_playlists);
+	tags = NextSection<BinaryTag>(header.n_tags);
+	items = NextSection<BinaryItem>(header.n_items);
+	string_table = NextSection<char>(header.string_table_size);
+
+	if (directories.empty() ||
+	    directories.front().parent != BINARY_NO_PARENT)
+		throw std::runtime_error("Database corrupted");
+}
+
+static void
+CheckTags(const BinaryDatabaseReader &reader,
+	  std::vector<TagType> &tag_map)
+{
+	bool tags[TAG_NUM_OF_ITEM_TYPES];
+	std::fill_n(tags, TAG_NUM_OF_ITEM_TYPES, false);
+
+	for (const auto &i : reader.tags) {
+		const auto name = reader.GetString(i.name);
+		const TagType tag = tag_name_parse(name.data);
+		if (tag == TAG_NUM_OF_ITEM_TYPES)
+			throw FormatRuntimeError("Unrecognized tag '%s', "
+						 "discarding database file",
+						 name.data);
+
+		tag_map.push_back(tag);
+		if (i.enabled)
+			tags[tag] = true;
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (IsTagEnabled(i) && !tags[i])
+			throw std::runtime_error("Tag list mismatch, "
+						 "discarding database file");
+}
+
+static void
+CheckCharset(const BinaryDatabaseReader &reader)
+{
+	const char *new_charset =
+		reader.GetString(reader.header.fs_charset).data;
+	const char *const old_charset = GetFSCharset();
+	if (*old_charset != 0 && strcmp(new_charset, old_charset) != 0)
+		throw FormatRuntimeError("Existing database has charset "
+					 "\"%s\" instead of \"%s\"; "
+					 "discarding database file",
+					 new_charset, old_charset);
+}
+
+static SongPtr
+LoadSong(const BinaryDatabaseReader &reader,
+	 const std::vector<TagType> &tag_map,
+	 TagBuilder &tag, const BinarySong &s, Directory &parent)
+{
+	const auto filename = reader.GetString(s.filename);
+	if (filename.empty())
+		throw std::runtime_error("Database corrupted");
+
+	auto song = Song::New(std::string_view(filename.data, filename.size),
+			      parent);
+
+	const auto target = reader.GetString(s.target);
+	if (!target.empty())
+		song->SetTarget(std::string(target.data, target.size));
+
+	song->mtime = ImportTime(s.mtime);
+	song->SetRange(SongTime::FromMS(s.start_ms),
+		       SongTime::FromMS(s.end_ms));
+
+	if (s.sample_rate > 0) {
+		const AudioFormat audio_format(s.sample_rate,
+					       SampleFormat(s.format),
+					       s.channels);
+		if (audio_format.IsValid())
+			song->audio_format = audio_format;
+	}
+
+	song->SetReplayGain({
+		{s.track_gain, s.track_peak},
+		{s.album_gain, s.album_peak},
+	});
+
+	if (s.duration_ms >= 0)
+		tag.SetDuration(SignedSongTime::FromMS(s.duration_ms));
+	tag.SetHasPlaylist(s.has_playlist);
+
+	for (const auto &i : reader.GetRange(reader.items,
+					     s.first_item, s.n_items)) {
+		if (i.tag >= tag_map.size())
+			throw std::runtime_error("Database corrupted");
+
+		const TagType type = tag_map[i.tag];
+		const auto value = reader.GetString(i.value);
+		/* the values have been sanitized already when they
+		   were added to the database; only the tag mask
+		   needs to be applied */
+		if (!value.empty() && IsTagEnabled(type))
+			tag.AddItemUnchecked(type, value);
+	}
+
+	tag.Commit(song->tag);
+	return song;
+}
+
+static void
+LoadTree(const BinaryDatabaseReader &reader,
+	 const std::vector<TagType> &tag_map, Directory &root)
+{
+	std::vector<Directory *> directories;
+	directories.reserve(reader.directories.size);
+
+	TagBuilder tag;
+
+	for (const auto &d : reader.directories) {
+		Directory *directory;
+		if (directories.empty()) {
+			directory = &root;
+		} else {
+			if (d.parent >= directories.size())
+				throw std::runtime_error("Database corrupted");
+
+			const auto name = reader.GetString(d.name);
+			if (name.empty() || name.Find('/') != nullptr)
+				throw std::runtime_error("Database corrupted");
+
+			directory = directories[d.parent]->CreateChild(name.data);
+			directory->mtime = ImportTime(d.mtime);
+
+			if (d.device == DEVICE_INARCHIVE ||
+			    d.device == DEVICE_CONTAINER ||
+			    d.device == DEVICE_PLAYLIST)
+				directory->device = d.device;
+		}
+
+		directories.push_back(directory);
+
+		for (const auto &s : reader.GetRange(reader.songs,
+						     d.first_song, d.n_songs))
+			directory->AddSong(LoadSong(reader, tag_map, tag,
+						    s, *directory));
+
+		for (const auto &p : reader.GetRange(reader.playlists,
+						     d.first_playlist,
+						     d.n_playlists)) {
+			const auto name = reader.GetString(p.name);
+			directory->playlists.push_back(PlaylistInfo(std::string(name.data, name.size),
+								    ImportTime(p.mtime)));
+		}
+	}
+}
+
+void
+db_load_binary(Path path, Directory &root)
+{
+	const MappedDatabaseFile file(path);
+	const BinaryDatabaseReader reader(file.GetData(), file.GetSize());
+
+	CheckCharset(reader);
+
+	std::vector<TagType> tag_map;
+	tag_map.reserve(reader.tags.size);
+	CheckTags(reader, tag_map);
+
+	const ScopeDatabaseLock protect;
+	LoadTree(reader, tag_map, root);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DATABASE_BINARY_HXX
+#define MPD_DATABASE_BINARY_HXX
+
+struct Directory;
+class BufferedOutputStream;
+class Path;
+
+/**
+ * Does the given file contain a database in the binary format
+ * written by db_save_binary()?
+ *
+ * Throws on I/O error.
+ */
+bool
+db_is_binary(Path path);
+
+/**
+ * Write the database in the binary format.  All strings are
+ * deduplicated into one string table, and all other sections are
+ * flat arrays of fixed-size records referring to it by offset, so
+ * the file can be mapped into memory and used without parsing.
+ *
+ * Throws on error.
+ */
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root);
+
+/**
+ * Load a database file written by db_save_binary().  The file is
+ * mapped into memory instead of being read and parsed line by line.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+db_load_binary(Path path, Directory &root);
+
+#endif
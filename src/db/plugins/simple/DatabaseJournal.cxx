@@ -0,0 +1,267 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "DatabaseJournal.hxx"
+#include "DirectorySave.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongSave.hxx"
+#include "PlaylistDatabase.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/LineReader.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Traits.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringCompare.hxx"
+#include "util/NumberParser.hxx"
+
+#include <stdexcept>
+#include <string>
+
+#include <assert.h>
+#include <string.h>
+
+#define JOURNAL_BASE "journal_base: "
+#define JOURNAL_BEGIN "journal: "
+#define JOURNAL_END "journal_end"
+
+void
+db_journal_save_header(BufferedOutputStream &os, const FileInfo &base)
+{
+	os.Format(JOURNAL_BASE "%lu %llu\n",
+		  (unsigned long)std::chrono::system_clock::to_time_t(base.GetModificationTime()),
+		  (unsigned long long)base.GetSize());
+}
+
+/**
+ * Remove directories which have become empty after an update of
+ * the given URI, and sort the entries of all its ancestors, because
+ * new entries are appended at the end of the list.
+ *
+ * @param deep prune and sort the whole subtree below the URI, too
+ */
+static void
+LockCleanup(Directory &root, const char *uri, bool deep)
+{
+	Directory *directory;
+	bool found;
+
+	{
+		const ScopeDatabaseLock protect;
+		const auto r = root.LookupDirectory(uri);
+		directory = r.directory;
+		found = r.uri == nullptr;
+	}
+
+	if (deep && found && !directory->IsMount()) {
+		directory->LockPruneEmpty();
+		directory->LockSort();
+	}
+
+	{
+		const ScopeDatabaseLock protect;
+		while (!directory->IsRoot() && !directory->IsMount() &&
+		       directory->IsEmpty()) {
+			Directory *parent = directory->parent;
+			directory->Delete();
+			directory = parent;
+		}
+	}
+
+	/* only this thread modifies the tree, so it is safe to
+	   follow the "parent" pointers without holding the lock */
+	for (; directory != nullptr; directory = directory->parent)
+		directory->LockSort(false);
+}
+
+void
+db_journal_save(BufferedOutputStream &os, Directory &root, const char *uri)
+{
+	assert(uri != nullptr);
+	assert(*uri != 0);
+
+	LockCleanup(root, uri, true);
+
+	const char *name = PathTraitsUTF8::GetBase(uri);
+	std::string parent_uri(uri, name);
+	if (!parent_uri.empty())
+		/* strip the trailing slash */
+		parent_uri.pop_back();
+
+	os.Format(JOURNAL_BEGIN "%s\n", uri);
+
+	const Directory *parent, *child = nullptr;
+	const Song *song = nullptr;
+
+	{
+		const ScopeDatabaseLock protect;
+		const auto r = root.LookupDirectory(parent_uri.c_str());
+		parent = r.uri == nullptr && !r.directory->IsMount()
+			? r.directory
+			: nullptr;
+
+		if (parent != nullptr) {
+			child = parent->FindChild(name);
+			song = parent->FindSong(name);
+		}
+	}
+
+	if (parent != nullptr) {
+		/* the tree is read without holding the lock; see
+		   Directory::LockPruneEmpty() */
+
+		if (child != nullptr && !child->IsMount()) {
+			os.Format(DIRECTORY_DIR "%s\n", name);
+			directory_save(os, *child);
+		}
+
+		if (song != nullptr)
+			song_save(os, *song);
+
+		for (const auto &pi : parent->playlists)
+			if (StringIsEqual(pi.name.c_str(), name))
+				playlist_metadata_save(os, pi);
+	}
+
+	os.Format(DIRECTORY_END "%s\n", uri);
+	os.Write(JOURNAL_END "\n");
+}
+
+unsigned
+db_journal_check(LineReader &file, const FileInfo &base, bool &complete_r)
+{
+	const char *line = file.ReadLine();
+	const char *p;
+	if (line == nullptr ||
+	    (p = StringAfterPrefix(line, JOURNAL_BASE)) == nullptr)
+		throw std::runtime_error("Malformed database journal");
+
+	char *endptr;
+	const auto mtime = ParseUint64(p, &endptr);
+	const auto size = ParseUint64(endptr, &endptr);
+	if (*endptr != 0 ||
+	    mtime != (uint64_t)std::chrono::system_clock::to_time_t(base.GetModificationTime()) ||
+	    size != base.GetSize())
+		throw std::runtime_error("Database journal does not belong to the database file");
+
+	unsigned n = 0;
+	bool open = false;
+
+	while ((line = file.ReadLine()) != nullptr) {
+		if (StringStartsWith(line, JOURNAL_BEGIN)) {
+			if (open)
+				/* the previous entry was truncated;
+				   everything after it is unusable */
+				break;
+
+			open = true;
+		} else if (open && StringIsEqual(line, JOURNAL_END)) {
+			open = false;
+			++n;
+		}
+	}
+
+	complete_r = line == nullptr && !open;
+	return n;
+}
+
+/**
+ * Look up the parent directory of the given URI, and create missing
+ * directories.
+ *
+ * Caller must lock the #db_mutex.
+ *
+ * @param name_r receives the base name of the URI
+ */
+static Directory &
+MakeParent(Directory &root, const char *uri, const char *&name_r)
+{
+	Directory *directory = &root;
+
+	const char *slash;
+	while ((slash = strchr(uri, '/')) != nullptr) {
+		if (slash > uri) {
+			const std::string name(uri, slash);
+			directory = directory->MakeChild(name.c_str());
+		}
+
+		uri = slash + 1;
+	}
+
+	name_r = uri;
+	return *directory;
+}
+
+/**
+ * Remove all entries with the given name from the directory.
+ *
+ * Caller must lock the #db_mutex.
+ */
+static void
+DeleteName(Directory &directory, const char *name)
+{
+	Directory *child = directory.FindChild(name);
+	if (child != nullptr)
+		child->Delete();
+
+	Song *song = directory.FindSong(name);
+	if (song != nullptr)
+		directory.RemoveSong(song);
+
+	directory.playlists.erase(name);
+}
+
+void
+db_journal_load(LineReader &file, Directory &root, unsigned n)
+{
+	/* skip the header which was verified by db_journal_check() */
+	if (file.ReadLine() == nullptr)
+		throw std::runtime_error("Malformed database journal");
+
+	for (unsigned i = 0; i < n; ++i) {
+		const char *line = file.ReadLine();
+		const char *p;
+		if (line == nullptr ||
+		    (p = StringAfterPrefix(line, JOURNAL_BEGIN)) == nullptr ||
+		    *p == 0)
+			throw std::runtime_error("Malformed database journal");
+
+		const std::string uri(p);
+
+		Directory *parent;
+
+		{
+			const ScopeDatabaseLock protect;
+
+			const char *name;
+			parent = &MakeParent(root, uri.c_str(), name);
+			DeleteName(*parent, name);
+		}
+
+		directory_load(file, *parent);
+
+		line = file.ReadLine();
+		if (line == nullptr || !StringIsEqual(line, JOURNAL_END))
+			throw std::runtime_error("Malformed database journal");
+
+		LockCleanup(root, uri.c_str(), false);
+	}
+}
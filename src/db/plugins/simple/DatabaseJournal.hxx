@@ -0,0 +1,80 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * An append-only journal which records the changes made by partial
+ * database updates.  Each entry replaces one URI (directory, song
+ * and playlist with that name) with the state saved in the entry.
+ * Replaying all entries on top of the database file it was created
+ * for restores the tree, which allows persisting small updates
+ * without rewriting the whole database file.
+ */
+
+#ifndef MPD_DATABASE_JOURNAL_HXX
+#define MPD_DATABASE_JOURNAL_HXX
+
+struct Directory;
+class FileInfo;
+class BufferedOutputStream;
+class LineReader;
+
+/**
+ * Write the header of a new journal file.  It identifies the
+ * database file the journal applies to.
+ */
+void
+db_journal_save_header(BufferedOutputStream &os, const FileInfo &base);
+
+/**
+ * Remove empty directories and sort the entries affected by an
+ * update of the given URI, and append a journal entry describing
+ * its new state.
+ *
+ * The same restrictions as with Directory::LockPruneEmpty() apply.
+ *
+ * @param uri the (non-empty) URI which was updated
+ */
+void
+db_journal_save(BufferedOutputStream &os, Directory &root, const char *uri);
+
+/**
+ * Check whether the journal belongs to the given database file and
+ * count its complete entries.  An incomplete entry at the end of the
+ * file (e.g. after a crash) is not counted.
+ *
+ * Throws #std::runtime_error on error.
+ *
+ * @param complete_r set to false if the file contains an incomplete
+ * entry
+ * @return the number of complete entries
+ */
+unsigned
+db_journal_check(LineReader &file, const FileInfo &base, bool &complete_r);
+
+/**
+ * Replay the first n entries of the journal.  Caller must not lock
+ * the #db_mutex.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+db_journal_load(LineReader &file, Directory &root, unsigned n);
+
+#endif
@@ -17,11 +17,11 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "DatabaseSave.hxx"
-#include "db/DatabaseLock.hxx"
 #include "DirectorySave.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
-#include "fs/io/TextFile.hxx"
+#include "fs/io/LineReader.hxx"
 #include "tag/ParseName.hxx"
 #include "tag/Settings.hxx"
 #include "fs/Charset.hxx"
@@ -38,7 +38,10 @@
 #define DIRECTORY_FS_CHARSET "fs_charset: "
 #define DB_TAG_PREFIX "tag: "
 
-static constexpr unsigned DB_FORMAT = 2;
+/**
+ * Format 3 adds the "replaygain_*" song attributes.
+ */
+static constexpr unsigned DB_FORMAT = 3;
 
 /**
  * The oldest database format understood by this MPD version.
@@ -63,7 +66,7 @@ db_save_internal(BufferedOutputStream &os, const Directory &music_root)
 }
 
 void
-db_load_internal(TextFile &file, Directory &music_root)
+db_load_header(LineReader &file)
 {
 	char *line;
 	unsigned format = 0;
@@ -124,7 +127,11 @@ db_load_internal(TextFile &file, Directory &music_root)
 		if (IsTagEnabled(i) && !tags[i])
 			throw std::runtime_error("Tag list mismatch, "
 						 "discarding database file");
+}
 
-	const ScopeDatabaseLock protect;
+void
+db_load_internal(LineReader &file, Directory &music_root)
+{
+	db_load_header(file);
 	directory_load(file, music_root);
 }
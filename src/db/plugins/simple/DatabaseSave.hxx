@@ -22,15 +22,24 @@
 
 struct Directory;
 class BufferedOutputStream;
-class TextFile;
+class LineReader;
 
 void
 db_save_internal(BufferedOutputStream &os, const Directory &root);
 
+/**
+ * Load and check the header of a database file.  Reading stops
+ * after the "info_end" line.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+db_load_header(LineReader &file);
+
 /**
  * Throws #std::runtime_error on error.
  */
 void
-db_load_internal(TextFile &file, Directory &root);
+db_load_internal(LineReader &file, Directory &root);
 
 #endif
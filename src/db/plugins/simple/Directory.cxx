@@ -21,6 +21,7 @@
 #include "SongSort.hxx"
 #include "Song.hxx"
 #include "Mount.hxx"
+#include "TagCounter.hxx"
 #include "db/LightDirectory.hxx"
 #include "song/LightSong.hxx"
 #include "db/Uri.hxx"
@@ -33,14 +34,60 @@
 #include "util/Alloc.hxx"
 #include "util/DeleteDisposer.hxx"
 
+#include <algorithm>
+#include <vector>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
+void
+Directory::Totals::Add(const Song &song) noexcept
+{
+	++n_songs;
+
+	if (!song.tag.duration.IsNegative())
+		tag_duration += song.tag.duration;
+
+	const auto duration = song.GetDuration();
+	if (!duration.IsNegative())
+		song_duration += duration;
+
+	memory += song.GetMemoryUsage();
+}
+
+Directory::Totals &
+Directory::Totals::operator+=(const Totals &other) noexcept
+{
+	n_songs += other.n_songs;
+	n_mounts += other.n_mounts;
+	tag_duration += other.tag_duration;
+	song_duration += other.song_duration;
+	memory += other.memory;
+	return *this;
+}
+
+Directory::Totals &
+Directory::Totals::operator-=(const Totals &other) noexcept
+{
+	assert(n_songs >= other.n_songs);
+	assert(n_mounts >= other.n_mounts);
+	assert(memory >= other.memory);
+
+	n_songs -= other.n_songs;
+	n_mounts -= other.n_mounts;
+	tag_duration -= other.tag_duration;
+	song_duration -= other.song_duration;
+	memory -= other.memory;
+	return *this;
+}
+
 Directory::Directory(std::string &&_path_utf8, Directory *_parent) noexcept
 	:parent(_parent),
 	 path(std::move(_path_utf8))
 {
+	if (parent == nullptr)
+		tag_counter = std::make_unique<TagCounter>();
 }
 
 Directory::~Directory() noexcept
@@ -54,14 +101,123 @@ Directory::~Directory() noexcept
 	children.clear_and_dispose(DeleteDisposer());
 }
 
+Directory &
+Directory::AddTotals(const Totals &delta) noexcept
+{
+	Directory *directory = this;
+	while (true) {
+		directory->totals += delta;
+		if (directory->parent == nullptr)
+			return *directory;
+
+		directory = directory->parent;
+	}
+}
+
+Directory &
+Directory::SubtractTotals(const Totals &delta) noexcept
+{
+	Directory *directory = this;
+	while (true) {
+		directory->totals -= delta;
+		if (directory->parent == nullptr)
+			return *directory;
+
+		directory = directory->parent;
+	}
+}
+
+/**
+ * Remove the tags of all songs in the given directory tree from the
+ * #TagCounter.
+ */
+static void
+RemoveTags(TagCounter &counter, const Directory &directory) noexcept
+{
+	for (const auto &song : directory.songs)
+		counter.Remove(song.tag);
+
+	for (const auto &child : directory.children)
+		RemoveTags(counter, child);
+}
+
+void
+Directory::SetMount(DatabasePtr db) noexcept
+{
+	assert(holding_db_lock());
+	assert(IsEmpty());
+	assert(!IsMount());
+	assert(db != nullptr);
+
+	mounted_database = std::move(db);
+
+	Totals delta;
+	delta.n_mounts = 1;
+	AddTotals(delta);
+}
+
 void
 Directory::Delete() noexcept
 {
 	assert(holding_db_lock());
 	assert(parent != nullptr);
 
-	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
-					   DeleteDisposer());
+	parent->EraseChild(parent->children.iterator_to(*this));
+}
+
+Directory::List::iterator
+Directory::EraseChild(List::iterator i) noexcept
+{
+	assert(n_children > 0);
+
+	if (child_index != nullptr) {
+		auto j = child_index->find(i->GetName());
+		if (j != child_index->end() && j->second == &*i)
+			child_index->erase(j);
+	}
+
+	if (i->totals.n_songs > 0 || i->totals.n_mounts > 0) {
+		Directory &root = SubtractTotals(i->totals);
+		RemoveTags(*root.tag_counter, *i);
+	}
+
+	--n_children;
+	db_modified();
+	i = children.erase_and_dispose(i, DeleteDisposer());
+	UpdateChildIndex();
+	return i;
+}
+
+void
+Directory::UpdateChildIndex() noexcept
+{
+	if (child_index == nullptr) {
+		if (n_children <= INDEX_THRESHOLD)
+			return;
+
+		child_index = std::make_unique<std::unordered_map<std::string_view, Directory *>>();
+		child_index->reserve(n_children);
+		for (auto &child : children)
+			child_index->emplace(child.GetName(), &child);
+	} else if (n_children < INDEX_THRESHOLD / 2)
+		/* hysteresis: don't rebuild the index all the time
+		   when the size oscillates around the threshold */
+		child_index.reset();
+}
+
+void
+Directory::UpdateSongIndex() noexcept
+{
+	if (song_index == nullptr) {
+		if (n_songs <= INDEX_THRESHOLD)
+			return;
+
+		song_index = std::make_unique<std::unordered_map<std::string_view, Song *>>();
+		song_index->reserve(n_songs);
+		for (auto &song : songs)
+			song_index->emplace(song.GetFilename(), &song);
+	} else if (n_songs < INDEX_THRESHOLD / 2)
+		song_index.reset();
 }
 
 const char *
@@ -85,6 +241,14 @@ Directory::CreateChild(const char *name_utf8) noexcept
 
 	Directory *child = new Directory(std::move(path_utf8), this);
 	children.push_back(*child);
+	++n_children;
+	db_modified();
+
+	if (child_index != nullptr)
+		child_index->emplace(child->GetName(), child);
+	else
+		UpdateChildIndex();
+
 	return child;
 }
 
@@ -93,6 +257,13 @@ Directory::FindChild(const char *name) const noexcept
 {
 	assert(holding_db_lock());
 
+	if (child_index != nullptr) {
+		auto i = child_index->find(name);
+		return i != child_index->end()
+			? i->second
+			: nullptr;
+	}
+
 	for (const auto &child : children)
 		if (strcmp(child.GetName(), name) == 0)
 			return &child;
@@ -100,18 +271,43 @@ Directory::FindChild(const char *name) const noexcept
 	return nullptr;
 }
 
+/**
+ * Caller must lock the #db_mutex.
+ */
+template<typename L>
+static auto
+SnapshotList(L &list)
+{
+	std::vector<typename L::pointer> v;
+	for (auto &i : list)
+		v.push_back(&i);
+	return v;
+}
+
 void
-Directory::PruneEmpty() noexcept
+Directory::LockPruneEmpty()
 {
-	assert(holding_db_lock());
+	std::vector<Directory *> snapshot;
+
+	{
+		const ScopeDatabaseLock protect;
+		snapshot = SnapshotList(children);
+	}
+
+	/* children which are not mount points can only be deleted
+	   by this thread (readers, even those in the CommandPool,
+	   never delete anything), so these pointers remain valid
+	   while the lock is released */
+	for (Directory *child : snapshot)
+		if (!child->IsMount())
+			child->LockPruneEmpty();
+
+	const ScopeDatabaseLock protect;
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
-		child->PruneEmpty();
-
 		if (child->IsEmpty() && !child->IsMount())
-			child = children.erase_and_dispose(child,
-							   DeleteDisposer());
+			child = EraseChild(child);
 		else
 			++child;
 	}
@@ -169,7 +365,19 @@ Directory::AddSong(SongPtr song) noexcept
 	assert(song != nullptr);
 	assert(&song->parent == this);
 
-	songs.push_back(*song.release());
+	Song *s = song.release();
+	songs.push_back(*s);
+	++n_songs;
+	db_modified();
+
+	Totals delta;
+	delta.Add(*s);
+	AddTotals(delta).tag_counter->Add(s->tag);
+
+	if (song_index != nullptr)
+		song_index->emplace(s->GetFilename(), s);
+	else
+		UpdateSongIndex();
 }
 
 SongPtr
@@ -179,20 +387,75 @@ Directory::RemoveSong(Song *song) noexcept
 	assert(song != nullptr);
 	assert(&song->parent == this);
 
+	assert(n_songs > 0);
+
+	if (song_index != nullptr) {
+		auto i = song_index->find(song->GetFilename());
+		if (i != song_index->end() && i->second == song)
+			song_index->erase(i);
+	}
+
 	songs.erase(songs.iterator_to(*song));
+	--n_songs;
+	db_modified();
+	UpdateSongIndex();
+
+	Totals delta;
+	delta.Add(*song);
+	SubtractTotals(delta).tag_counter->Remove(song->tag);
+
 	return SongPtr(song);
 }
 
+void
+Directory::ReplaceSongTag(Song &song, Tag &&tag) noexcept
+{
+	ModifySong(song, [&tag](Song &s){
+		s.tag = std::move(tag);
+	});
+}
+
+Directory &
+Directory::BeginModifySong(const Song &song) noexcept
+{
+	assert(holding_db_lock());
+	assert(&song.parent == this);
+
+	Totals old_delta;
+	old_delta.Add(song);
+	Directory &root = SubtractTotals(old_delta);
+	root.tag_counter->Remove(song.tag);
+	return root;
+}
+
+void
+Directory::EndModifySong(Directory &root, const Song &song) noexcept
+{
+	db_modified();
+
+	Totals new_delta;
+	new_delta.Add(song);
+	AddTotals(new_delta);
+	root.tag_counter->Add(song.tag);
+}
+
 const Song *
 Directory::FindSong(const char *name_utf8) const noexcept
 {
 	assert(holding_db_lock());
 	assert(name_utf8 != nullptr);
 
+	if (song_index != nullptr) {
+		auto i = song_index->find(name_utf8);
+		return i != song_index->end()
+			? i->second
+			: nullptr;
+	}
+
 	for (auto &song : songs) {
 		assert(&song.parent == this);
 
-		if (song.filename == name_utf8)
+		if (strcmp(song.GetFilename(), name_utf8) == 0)
 			return &song;
 	}
 
@@ -206,22 +469,93 @@ directory_cmp(const Directory &a, const Directory &b) noexcept
 	return IcuCollate(a.path.c_str(), b.path.c_str()) < 0;
 }
 
+/**
+ * Sort the list, but perform the (expensive) comparisons without
+ * holding the #db_mutex.  If the list gets modified meanwhile (which
+ * is only possible for mount points created by another thread), fall
+ * back to sorting it under the lock.
+ *
+ * @param make_key a function which calculates the sort key of an
+ * item; it is called only once per item, and comparing two keys must
+ * yield the same order as #cmp
+ */
+template<typename L, typename K, typename C>
+static void
+LockSortList(L &list, K make_key, C cmp)
+{
+	using pointer = typename L::pointer;
+
+	std::vector<pointer> snapshot;
+
+	{
+		const ScopeDatabaseLock protect;
+		snapshot = SnapshotList(list);
+	}
+
+	using Key = decltype(make_key(*snapshot.front()));
+	std::vector<std::pair<Key, pointer>> keyed;
+	keyed.reserve(snapshot.size());
+	for (auto *i : snapshot)
+		keyed.emplace_back(make_key(*i), i);
+
+	std::stable_sort(keyed.begin(), keyed.end(),
+			 [](const auto &a, const auto &b){
+				 return a.first < b.first;
+			 });
+
+	std::vector<pointer> sorted;
+	sorted.reserve(keyed.size());
+	for (const auto &i : keyed)
+		sorted.push_back(i.second);
+
+	if (sorted == snapshot)
+		/* already sorted */
+		return;
+
+	/* relink under the lock, so a reader on any thread sees
+	   either the old or the new order, never a partial one */
+	const ScopeDatabaseLock protect;
+
+	if (SnapshotList(list) != snapshot) {
+		list.sort(cmp);
+	} else {
+		list.clear();
+		for (auto *i : sorted)
+			list.push_back(*i);
+	}
+
+	db_modified();
+}
+
 void
-Directory::Sort() noexcept
+Directory::LockSort(bool recursive)
 {
-	assert(holding_db_lock());
+	LockSortList(children, [](const Directory &directory){
+			return IcuCollateKey(directory.path.c_str());
+		}, directory_cmp);
+	LockSortList(songs, SongSortKeyFactory(), song_cmp);
 
-	children.sort(directory_cmp);
-	song_list_sort(songs);
+	if (!recursive)
+		return;
+
+	std::vector<Directory *> snapshot;
+
+	{
+		const ScopeDatabaseLock protect;
+		snapshot = SnapshotList(children);
+	}
 
-	for (auto &child : children)
-		child.Sort();
+	/* see LockPruneEmpty() */
+	for (Directory *child : snapshot)
+		if (!child->IsMount())
+			child->LockSort();
 }
 
 void
 Directory::Walk(bool recursive, const SongFilter *filter,
-		VisitDirectory visit_directory, VisitSong visit_song,
-		VisitPlaylist visit_playlist) const
+		const VisitDirectory &visit_directory,
+		const VisitSong &visit_song,
+		const VisitPlaylist &visit_playlist) const
 {
 	if (IsMount()) {
 		assert(IsEmpty());
@@ -26,10 +26,17 @@
 #include "db/PlaylistVector.hxx"
 #include "db/Ptr.hxx"
 #include "Song.hxx"
+#include "Chrono.hxx"
 
 #include <boost/intrusive/list.hpp>
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 /**
  * Virtual directory that is really an archive file or a folder inside
@@ -51,8 +58,16 @@ static constexpr unsigned DEVICE_CONTAINER = -2;
 static constexpr unsigned DEVICE_PLAYLIST = -3;
 
 class SongFilter;
+class TagCounter;
 
 struct Directory {
+	/**
+	 * If a directory has more children (or songs) than this, then
+	 * a hash index is built to speed up FindChild() (or
+	 * FindSong()).  Smaller directories are scanned linearly.
+	 */
+	static constexpr unsigned INDEX_THRESHOLD = 32;
+
 	static constexpr auto link_mode = boost::intrusive::normal_link;
 	typedef boost::intrusive::link_mode<link_mode> LinkMode;
 	typedef boost::intrusive::list_member_hook<LinkMode> Hook;
@@ -88,6 +103,85 @@ struct Directory {
 	 */
 	SongList songs;
 
+	/**
+	 * The number of items in #children and #songs.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	unsigned n_children = 0, n_songs = 0;
+
+	/**
+	 * Optional hash indexes on #children and #songs, mapping
+	 * Directory::GetName() and Song::GetFilename() to the object.
+	 * They exist only while the respective list is larger than
+	 * #INDEX_THRESHOLD.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	std::unique_ptr<std::unordered_map<std::string_view, Directory *>> child_index;
+	std::unique_ptr<std::unordered_map<std::string_view, Song *>> song_index;
+
+	/**
+	 * Aggregate values of all songs in a directory and all of its
+	 * descendants.  The contents of mounted databases are not
+	 * included.
+	 */
+	struct Totals {
+		typedef std::chrono::duration<std::uint64_t,
+					      SongTime::period> Duration;
+
+		/**
+		 * The number of songs.
+		 */
+		unsigned n_songs = 0;
+
+		/**
+		 * The number of mount points.  If this is non-zero,
+		 * then the other attributes are incomplete.
+		 */
+		unsigned n_mounts = 0;
+
+		/**
+		 * The sum of all known tag durations (see
+		 * #DatabaseStats::total_duration).
+		 */
+		Duration tag_duration = Duration::zero();
+
+		/**
+		 * The sum of all known song durations, taking the
+		 * range of sub-songs into account (see
+		 * LightSong::GetDuration()).
+		 */
+		Duration song_duration = Duration::zero();
+
+		/**
+		 * The sum of Song::GetMemoryUsage().
+		 */
+		std::size_t memory = 0;
+
+		void Add(const Song &song) noexcept;
+
+		Totals &operator+=(const Totals &other) noexcept;
+		Totals &operator-=(const Totals &other) noexcept;
+	};
+
+	/**
+	 * The #Totals of this directory, maintained incrementally by
+	 * the methods which modify the tree.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 * Read access in the update thread does not need protection.
+	 */
+	Totals totals;
+
+	/**
+	 * Counts the distinct artists and albums of the whole tree.
+	 * Only the root directory has this object.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	std::unique_ptr<TagCounter> tag_counter;
+
 	PlaylistVector playlists;
 
 	Directory *const parent;
@@ -131,6 +225,14 @@ public:
 		return mounted_database != nullptr;
 	}
 
+	/**
+	 * Turn this (empty) directory into a mount point for the
+	 * given #Database.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void SetMount(DatabasePtr db) noexcept;
+
 	/**
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
@@ -269,26 +371,107 @@ public:
 	SongPtr RemoveSong(Song *song) noexcept;
 
 	/**
+	 * Replace the tag of a song which is in this directory, and
+	 * update the #totals.
+	 *
 	 * Caller must lock the #db_mutex.
 	 */
-	void PruneEmpty() noexcept;
+	void ReplaceSongTag(Song &song, Tag &&tag) noexcept;
 
 	/**
-	 * Sort all directory entries recursively.
+	 * Modify a song which is in this directory with the given
+	 * function, and update the #totals.  Every change to an
+	 * attribute which is counted by #Totals (the tag, the
+	 * #Song::Extra allocation, ...) must be made this way.
 	 *
 	 * Caller must lock the #db_mutex.
 	 */
-	void Sort() noexcept;
+	template<typename F>
+	void ModifySong(Song &song, F &&f) noexcept {
+		Directory &root = BeginModifySong(song);
+		f(song);
+		EndModifySong(root, song);
+	}
+
+	/**
+	 * Remove all empty directories recursively.  The #db_mutex
+	 * is locked only while one directory is being modified, so
+	 * readers do not have to wait for the whole tree to be
+	 * processed.
+	 *
+	 * Readers may run on any thread (the main thread, the
+	 * #CommandPool or the #ParallelSearch workers), but they
+	 * dereference the tree only while the #db_mutex is held
+	 * (by themselves or by the thread waiting for them), and
+	 * they never modify it.  Therefore, the thread which
+	 * modifies the tree (i.e. the update thread) may read it
+	 * without the lock; every modification still happens with
+	 * the lock held.  This may only be called by that thread.
+	 * Caller must not lock the #db_mutex.
+	 */
+	void LockPruneEmpty();
+
+	/**
+	 * Sort all directory entries recursively.  The entries are
+	 * compared without holding the #db_mutex, and it is locked
+	 * only while relinking the entries of one directory.  The
+	 * same restrictions as with LockPruneEmpty() apply.
+	 *
+	 * @param recursive if false, then only the entries of this
+	 * directory are sorted, but not those of its children
+	 */
+	void LockSort(bool recursive=true);
 
 	/**
 	 * Caller must lock #db_mutex.
 	 */
 	void Walk(bool recursive, const SongFilter *match,
-		  VisitDirectory visit_directory, VisitSong visit_song,
-		  VisitPlaylist visit_playlist) const;
+		  const VisitDirectory &visit_directory,
+		  const VisitSong &visit_song,
+		  const VisitPlaylist &visit_playlist) const;
 
 	gcc_pure
 	LightDirectory Export() const noexcept;
+
+private:
+	/**
+	 * Remove a child from #children (and from #child_index) and
+	 * free it.
+	 */
+	List::iterator EraseChild(List::iterator i) noexcept;
+
+	void UpdateChildIndex() noexcept;
+	void UpdateSongIndex() noexcept;
+
+	/**
+	 * Add the given values to the #totals of this directory and
+	 * all of its ancestors.
+	 *
+	 * @return the root directory
+	 */
+	Directory &AddTotals(const Totals &delta) noexcept;
+
+	/**
+	 * Subtract the given values from the #totals of this
+	 * directory and all of its ancestors.
+	 *
+	 * @return the root directory
+	 */
+	Directory &SubtractTotals(const Totals &delta) noexcept;
+
+	/**
+	 * Remove the song from the #totals and the #TagCounter before
+	 * it gets modified.
+	 *
+	 * @return the root directory
+	 */
+	Directory &BeginModifySong(const Song &song) noexcept;
+
+	/**
+	 * Add the modified song to the #totals and the #TagCounter
+	 * again.
+	 */
+	void EndModifySong(Directory &root, const Song &song) noexcept;
 };
 
 #endif
@@ -23,7 +23,8 @@
 #include "SongSave.hxx"
 #include "song/DetachedSong.hxx"
 #include "PlaylistDatabase.hxx"
-#include "fs/io/TextFile.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/LineReader.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/StringAPI.hxx"
@@ -31,13 +32,13 @@
 #include "util/NumberParser.hxx"
 #include "util/RuntimeError.hxx"
 
+#include <vector>
+
 #include <string.h>
 
-#define DIRECTORY_DIR "directory: "
 #define DIRECTORY_TYPE "type: "
 #define DIRECTORY_MTIME "mtime: "
 #define DIRECTORY_BEGIN "begin: "
-#define DIRECTORY_END "end: "
 
 gcc_const
 static const char *
@@ -120,29 +121,41 @@ ParseLine(Directory &directory, const char *line)
 	return true;
 }
 
-static Directory *
-directory_load_subdir(TextFile &file, Directory &parent, const char *name)
+void
+directory_load_attributes(LineReader &file, Directory &directory)
 {
-	if (parent.FindChild(name) != nullptr)
-		throw FormatRuntimeError("Duplicate subdirectory '%s'", name);
+	while (true) {
+		const char *line = file.ReadLine();
+		if (line == nullptr)
+			throw std::runtime_error("Unexpected end of file");
 
-	Directory *directory = parent.CreateChild(name);
+		if (StringStartsWith(line, DIRECTORY_BEGIN))
+			break;
 
-	try {
-		while (true) {
-			const char *line = file.ReadLine();
-			if (line == nullptr)
-				throw std::runtime_error("Unexpected end of file");
+		if (!ParseLine(directory, line))
+			throw FormatRuntimeError("Malformed line: %s", line);
+	}
+}
 
-			if (StringStartsWith(line, DIRECTORY_BEGIN))
-				break;
+static Directory *
+directory_load_subdir(LineReader &file, Directory &parent, const char *name)
+{
+	Directory *directory;
 
-			if (!ParseLine(*directory, line))
-				throw FormatRuntimeError("Malformed line: %s", line);
-		}
+	{
+		const ScopeDatabaseLock protect;
+
+		if (parent.FindChild(name) != nullptr)
+			throw FormatRuntimeError("Duplicate subdirectory '%s'", name);
 
+		directory = parent.CreateChild(name);
+	}
+
+	try {
+		directory_load_attributes(file, *directory);
 		directory_load(file, *directory);
 	} catch (...) {
+		const ScopeDatabaseLock protect;
 		directory->Delete();
 		throw;
 	}
@@ -151,8 +164,12 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name)
 }
 
 void
-directory_load(TextFile &file, Directory &directory)
+directory_load(LineReader &file, Directory &directory)
 {
+	/* songs are parsed without holding the lock, and are added
+	   to the directory in one batch at the end */
+	std::vector<SongPtr> songs;
+
 	const char *line;
 
 	while ((line = file.ReadLine()) != nullptr &&
@@ -163,26 +180,38 @@ directory_load(TextFile &file, Directory &directory)
 		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
 			const char *name = p;
 
-			if (directory.FindSong(name) != nullptr)
-				throw FormatRuntimeError("Duplicate song '%s'", name);
-
 			std::string target;
 			auto audio_format = AudioFormat::Undefined();
 			auto detached_song = song_load(file, name,
 						       &target,
 						       &audio_format);
 
-			auto song = std::make_unique<Song>(std::move(detached_song),
-							   directory);
-			song->target = std::move(target);
+			auto song = Song::New(std::move(detached_song),
+					      directory);
+			song->SetTarget(std::move(target));
 			song->audio_format = audio_format;
 
-			directory.AddSong(std::move(song));
+			songs.emplace_back(std::move(song));
 		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
 			const char *name = p;
+
+			const ScopeDatabaseLock protect;
 			playlist_metadata_load(file, directory.playlists, name);
 		} else {
 			throw FormatRuntimeError("Malformed line: %s", line);
 		}
 	}
+
+	if (songs.empty())
+		return;
+
+	const ScopeDatabaseLock protect;
+
+	for (auto &song : songs) {
+		if (directory.FindSong(song->GetFilename()) != nullptr)
+			throw FormatRuntimeError("Duplicate song '%s'",
+						 song->GetFilename());
+
+		directory.AddSong(std::move(song));
+	}
 }
@@ -20,17 +20,35 @@
 #ifndef MPD_DIRECTORY_SAVE_HXX
 #define MPD_DIRECTORY_SAVE_HXX
 
+#define DIRECTORY_DIR "directory: "
+#define DIRECTORY_END "end: "
+
 struct Directory;
-class TextFile;
+class LineReader;
 class BufferedOutputStream;
 
 void
 directory_save(BufferedOutputStream &os, const Directory &directory);
 
 /**
+ * Load the attributes of a directory, i.e. everything between the
+ * DIRECTORY_DIR line (which has already been consumed) and the
+ * "begin" line, which is consumed.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+directory_load_attributes(LineReader &file, Directory &directory);
+
+/**
+ * Load the contents of a directory until the DIRECTORY_END line or
+ * the end of the file.  The #db_mutex is locked only while the tree
+ * is being modified, to allow loading several directories
+ * concurrently.  Caller must not lock the #db_mutex.
+ *
  * Throws #std::runtime_error on error.
  */
 void
-directory_load(TextFile &file, Directory &directory);
+directory_load(LineReader &file, Directory &directory);
 
 #endif
@@ -0,0 +1,356 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ParallelLoad.hxx"
+#include "DatabaseSave.hxx"
+#include "DirectorySave.hxx"
+#include "Directory.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/LineReader.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/AutoDecompressReader.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Name.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/TextFile.hxx"
+#include "util/WritableBuffer.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <forward_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <string.h>
+
+/**
+ * A #LineReader which splits a writable buffer into lines in place.
+ */
+class MemoryLineReader final : public LineReader {
+	char *p;
+
+	/**
+	 * The end of the buffer.  If the last line is not terminated
+	 * by a newline character, then this byte will be overwritten
+	 * with the null terminator.
+	 */
+	char *const end;
+
+public:
+	MemoryLineReader(char *_begin, char *_end) noexcept
+		:p(_begin), end(_end) {}
+
+	char *GetPosition() const noexcept {
+		return p;
+	}
+
+	/* methods for ReadBufferedLine() */
+	WritableBuffer<char> Read() const noexcept {
+		return {p, size_t(end - p)};
+	}
+
+	void Consume(size_t n) noexcept {
+		p += n;
+	}
+
+	/* virtual methods from class LineReader */
+	char *ReadLine() noexcept override {
+		if (p >= end)
+			return nullptr;
+
+		/* this is the same code which BufferedReader (and
+		   thus TextFile, used by the serial loader) uses, so
+		   both parse lines the same way */
+		char *line = ReadBufferedLine(*this);
+		if (line != nullptr)
+			return line;
+
+		/* the last line is not terminated; BufferedReader
+		   returns it as-is */
+		line = p;
+		p = end;
+		*end = 0;
+		return line;
+	}
+};
+
+/**
+ * Read the whole (decompressed) file into a buffer.  One null byte
+ * is appended, which is not part of the file contents.
+ */
+static std::vector<char>
+ReadWholeFile(Path path)
+{
+	FileReader file(path);
+	AutoDecompressReader decompress(file);
+	Reader *reader = &decompress;
+
+	std::vector<char> buffer;
+	size_t size = 0;
+
+	while (true) {
+		if (buffer.size() - size < 64 * 1024)
+			buffer.resize(std::max<size_t>(buffer.size() * 2,
+						       1024 * 1024));
+
+		size_t nbytes = reader->Read(buffer.data() + size,
+					     buffer.size() - size);
+		if (nbytes == 0)
+			break;
+
+		size += nbytes;
+	}
+
+	buffer.resize(size + 1);
+	buffer[size] = 0;
+	return buffer;
+}
+
+class ParallelLoader {
+	struct Job {
+		Directory *directory;
+
+		char *begin, *end;
+
+		/**
+		 * Does the chunk begin with the attributes of the
+		 * directory (see directory_load_attributes())?
+		 */
+		bool attributes;
+	};
+
+	std::vector<Job> jobs;
+
+	/**
+	 * Directories larger than this are split into several jobs.
+	 */
+	const size_t max_job_size;
+
+	std::atomic_size_t next_job{0};
+
+	std::atomic_bool failed{false};
+
+	/**
+	 * Protects #error.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The first error which occurred in one of the jobs.
+	 */
+	std::exception_ptr error;
+
+public:
+	explicit ParallelLoader(size_t _max_job_size) noexcept
+		:max_job_size(_max_job_size) {}
+
+	/**
+	 * Split the contents of a directory (everything between its
+	 * "begin" and "end" lines) into jobs.  This creates the
+	 * #Directory objects of all sub directories which are split
+	 * further, so their order is preserved.
+	 *
+	 * Caller must not lock the #db_mutex.
+	 */
+	void Split(Directory &directory, char *p, char *end);
+
+	/**
+	 * Run all jobs in the calling thread and in (n_threads-1)
+	 * new threads.
+	 *
+	 * Throws on error.
+	 */
+	void Run(unsigned n_threads);
+
+private:
+	static void RunJob(const Job &job);
+
+	void Work() noexcept;
+
+	void ThreadFunc() noexcept {
+		SetThreadName("db_load");
+		Work();
+	}
+};
+
+gcc_pure
+static bool
+StartsWith(std::string_view s, std::string_view prefix) noexcept
+{
+	return s.size() >= prefix.size() &&
+		s.compare(0, prefix.size(), prefix) == 0;
+}
+
+void
+ParallelLoader::Split(Directory &directory, char *p, char *const end)
+{
+	static constexpr std::string_view directory_dir = DIRECTORY_DIR;
+
+	while (p < end) {
+		char *eol = (char *)memchr(p, '\n', end - p);
+		char *const next = eol != nullptr ? eol + 1 : end;
+
+		std::string_view line(p, (eol != nullptr ? eol : end) - p);
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+
+		if (!StartsWith(line, directory_dir)) {
+			/* songs and playlists of this directory, up
+			   to the next sub directory */
+			const std::string_view rest(p, end - p);
+			const auto i = rest.find("\n" DIRECTORY_DIR);
+			char *const run_end = i != rest.npos
+				? p + i + 1
+				: end;
+
+			jobs.push_back({&directory, p, run_end, false});
+			p = run_end;
+			continue;
+		}
+
+		line.remove_prefix(directory_dir.size());
+		const std::string name(line);
+
+		Directory *child;
+
+		{
+			const ScopeDatabaseLock protect;
+
+			if (directory.FindChild(name.c_str()) != nullptr)
+				throw FormatRuntimeError("Duplicate subdirectory '%s'",
+							 name.c_str());
+
+			child = directory.CreateChild(name.c_str());
+		}
+
+		/* find the "end" line of the new directory; it
+		   contains the directory's path, and all other "end"
+		   lines inside it contain longer paths */
+		const std::string needle = std::string("\n" DIRECTORY_END) +
+			child->GetPath();
+		char *block_end = end, *after = end;
+
+		if (eol != nullptr) {
+			const std::string_view rest(eol, end - eol);
+			for (size_t i = 0;
+			     (i = rest.find(needle, i)) != rest.npos; ++i) {
+				char *const q = eol + i + needle.size();
+				if (q == end || *q == '\n' || *q == '\r') {
+					block_end = eol + i + 1;
+
+					char *const q_eol = (char *)
+						memchr(q, '\n', end - q);
+					after = q_eol != nullptr
+						? q_eol + 1
+						: end;
+					break;
+				}
+			}
+		}
+
+		if (size_t(block_end - next) > max_job_size) {
+			MemoryLineReader reader(next, block_end);
+			directory_load_attributes(reader, *child);
+			Split(*child, reader.GetPosition(), block_end);
+		} else
+			jobs.push_back({child, next, block_end, true});
+
+		p = after;
+	}
+}
+
+inline void
+ParallelLoader::RunJob(const Job &job)
+{
+	MemoryLineReader reader(job.begin, job.end);
+
+	if (job.attributes)
+		directory_load_attributes(reader, *job.directory);
+
+	directory_load(reader, *job.directory);
+}
+
+void
+ParallelLoader::Work() noexcept
+{
+	while (!failed) {
+		const size_t i = next_job++;
+		if (i >= jobs.size())
+			break;
+
+		try {
+			RunJob(jobs[i]);
+		} catch (...) {
+			const std::lock_guard<Mutex> protect(mutex);
+			if (!error)
+				error = std::current_exception();
+			failed = true;
+		}
+	}
+}
+
+inline void
+ParallelLoader::Run(unsigned n_threads)
+{
+	std::forward_list<Thread> threads;
+
+	for (unsigned i = 1; i < n_threads && i < jobs.size(); ++i) {
+		threads.emplace_front(BIND_THIS_METHOD(ThreadFunc));
+
+		try {
+			threads.front().Start();
+		} catch (...) {
+			threads.pop_front();
+			LogError(std::current_exception(),
+				 "Failed to start database loader thread");
+			break;
+		}
+	}
+
+	Work();
+
+	for (auto &thread : threads)
+		thread.Join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void
+db_load_parallel(Path path, Directory &root, unsigned n_threads)
+{
+	auto buffer = ReadWholeFile(path);
+	char *const end = buffer.data() + buffer.size() - 1;
+
+	MemoryLineReader reader(buffer.data(), end);
+	db_load_header(reader);
+
+	char *const body = reader.GetPosition();
+
+	ParallelLoader loader(std::max<size_t>((end - body) / (n_threads * 8),
+					       256 * 1024));
+	loader.Split(root, body, end);
+	loader.Run(n_threads);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PARALLEL_LOAD_HXX
+#define MPD_PARALLEL_LOAD_HXX
+
+struct Directory;
+class Path;
+
+/**
+ * Load a database file in the text format like db_load_internal(),
+ * but parse independent directories concurrently.  The file is read
+ * (and decompressed) into memory at once, and then split at
+ * directory boundaries; every chunk is parsed by one of the worker
+ * threads.
+ *
+ * Caller must not lock the #db_mutex.
+ *
+ * Throws #std::runtime_error on error.
+ *
+ * @param n_threads the number of threads parsing the file
+ * (including the calling thread)
+ */
+void
+db_load_parallel(Path path, Directory &root, unsigned n_threads);
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ParallelSearch.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <forward_list>
+
+class ParallelSearcher {
+	struct Job {
+		/**
+		 * The directories whose songs are checked by this
+		 * job (but not their children, which may be part of
+		 * other jobs).
+		 */
+		std::vector<const Directory *> directories;
+
+		std::vector<const Song *> result;
+	};
+
+	const SongFilter &filter;
+
+	std::vector<Job> jobs;
+
+	/**
+	 * New directories are added to a new job after the current
+	 * one has reached this number of songs.
+	 */
+	const size_t max_job_size;
+
+	size_t last_job_size = 0;
+
+	std::atomic_size_t next_job{0};
+
+public:
+	ParallelSearcher(const SongFilter &_filter,
+			 size_t _max_job_size) noexcept
+		:filter(_filter), max_job_size(_max_job_size) {}
+
+	/**
+	 * Add the songs of the given directory and all of its
+	 * children to the jobs, in Directory::Walk() order.
+	 */
+	void Split(const Directory &directory) noexcept;
+
+	/**
+	 * Run all jobs in the calling thread and in (n_threads-1)
+	 * new threads.
+	 */
+	void Run(unsigned n_threads) noexcept;
+
+	std::vector<const Song *> Commit() noexcept;
+
+private:
+	void RunJob(Job &job) noexcept;
+
+	void Work() noexcept;
+
+	void ThreadFunc() noexcept {
+		SetThreadName("db_search");
+		Work();
+	}
+};
+
+void
+ParallelSearcher::Split(const Directory &directory) noexcept
+{
+	assert(directory.totals.n_mounts == 0);
+
+	if (directory.n_songs > 0) {
+		if (jobs.empty() || last_job_size >= max_job_size) {
+			jobs.emplace_back();
+			last_job_size = 0;
+		}
+
+		jobs.back().directories.push_back(&directory);
+		last_job_size += directory.n_songs;
+	}
+
+	for (const auto &child : directory.children)
+		Split(child);
+}
+
+inline void
+ParallelSearcher::RunJob(Job &job) noexcept
+{
+	for (const Directory *directory : job.directories)
+		for (const auto &song : directory->songs)
+			if (filter.MatchTagTypes(song.tag) &&
+			    filter.Match(song.Export()))
+				job.result.push_back(&song);
+}
+
+void
+ParallelSearcher::Work() noexcept
+{
+	while (true) {
+		const size_t i = next_job++;
+		if (i >= jobs.size())
+			break;
+
+		RunJob(jobs[i]);
+	}
+}
+
+inline void
+ParallelSearcher::Run(unsigned n_threads) noexcept
+{
+	std::forward_list<Thread> threads;
+
+	for (unsigned i = 1; i < n_threads && i < jobs.size(); ++i) {
+		threads.emplace_front(BIND_THIS_METHOD(ThreadFunc));
+
+		try {
+			threads.front().Start();
+		} catch (...) {
+			threads.pop_front();
+			LogError(std::current_exception(),
+				 "Failed to start database search thread");
+			break;
+		}
+	}
+
+	Work();
+
+	for (auto &thread : threads)
+		thread.Join();
+}
+
+inline std::vector<const Song *>
+ParallelSearcher::Commit() noexcept
+{
+	size_t n = 0;
+	for (const auto &job : jobs)
+		n += job.result.size();
+
+	std::vector<const Song *> result;
+	result.reserve(n);
+
+	for (const auto &job : jobs)
+		result.insert(result.end(),
+			      job.result.begin(), job.result.end());
+
+	return result;
+}
+
+std::vector<const Song *>
+ParallelSearch(const Directory &directory, const SongFilter &filter,
+	       unsigned n_threads)
+{
+	assert(n_threads > 0);
+
+	/* several jobs per thread balance the load if the songs of
+	   some jobs are more expensive to match than others */
+	ParallelSearcher searcher(filter,
+				  std::max<size_t>(directory.totals.n_songs / (n_threads * 8),
+						   256));
+	searcher.Split(directory);
+	searcher.Run(n_threads);
+	return searcher.Commit();
+}
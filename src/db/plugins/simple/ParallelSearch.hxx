@@ -0,0 +1,48 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PARALLEL_SEARCH_HXX
+#define MPD_PARALLEL_SEARCH_HXX
+
+#include <vector>
+
+struct Directory;
+struct Song;
+class SongFilter;
+
+/**
+ * Find all songs below the given directory (recursively) which match
+ * the filter, like a Directory::Walk() call, but evaluate the filter
+ * concurrently.  The directory tree is split into jobs of similar
+ * song counts, which are processed by a pool of worker threads.
+ *
+ * The caller must lock the #db_mutex; the worker threads access the
+ * tree without locking while the caller waits for them.  There must
+ * not be any mount point below the given directory.
+ *
+ * @param n_threads the number of threads evaluating the filter
+ * (including the calling thread)
+ * @return the matching songs in the same order as
+ * Directory::Walk() would visit them
+ */
+std::vector<const Song *>
+ParallelSearch(const Directory &directory, const SongFilter &filter,
+	       unsigned n_threads);
+
+#endif
@@ -27,12 +27,20 @@
 #include "db/Stats.hxx"
 #include "db/UniqueTags.hxx"
 #include "db/VHelper.hxx"
+#include "song/Filter.hxx"
 #include "db/LightDirectory.hxx"
 #include "Directory.hxx"
 #include "Song.hxx"
+#include "Walk.hxx"
+#include "TagCounter.hxx"
 #include "DatabaseSave.hxx"
+#include "DatabaseBinary.hxx"
+#include "DatabaseJournal.hxx"
+#include "ParallelLoad.hxx"
+#include "ParallelSearch.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
+#include "db/Uri.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/FileOutputStream.hxx"
@@ -43,43 +51,120 @@
 #include "util/Domain.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/RecursiveMap.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/StringAPI.hxx"
 #include "Log.hxx"
 
+#include "config/Parser.hxx"
+
 #ifdef ENABLE_ZLIB
 #include "fs/io/GzipOutputStream.hxx"
 #endif
 
+#ifdef ENABLE_ZSTD
+#include "fs/io/ZstdOutputStream.hxx"
+#endif
+
+#include <algorithm>
 #include <memory>
+#include <numeric>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include <errno.h>
 
 static constexpr Domain simple_db_domain("simple_db");
 
+/**
+ * Below this number of songs, starting threads for a search is more
+ * expensive than walking the tree in the calling thread.
+ */
+static constexpr unsigned PARALLEL_SEARCH_THRESHOLD = 16384;
+
+static SimpleDatabase::Compression
+ParseCompression(const char *value)
+{
+	using Compression = SimpleDatabase::Compression;
+
+	if (StringIsEqual(value, "gzip")) {
+#ifdef ENABLE_ZLIB
+		return Compression::GZIP;
+#else
+		throw std::runtime_error("gzip support is disabled");
+#endif
+	} else if (StringIsEqual(value, "zstd")) {
+#ifdef ENABLE_ZSTD
+		return Compression::ZSTD;
+#else
+		throw std::runtime_error("zstd support is disabled");
+#endif
+	}
+
+	/* "yes" means gzip, for compatibility with older versions;
+	   it is silently ignored if zlib is not available */
+#ifdef ENABLE_ZLIB
+	if (ParseBool(value))
+		return Compression::GZIP;
+#else
+	ParseBool(value);
+#endif
+
+	return Compression::NONE;
+}
+
+static SimpleDatabase::Compression
+ParseCompression(const ConfigBlock &block)
+{
+	const auto *param = block.GetBlockParam("compress");
+	if (param == nullptr)
+		return ParseCompression("yes");
+
+	return param->With([](const char *value){
+			return ParseCompression(value);
+		});
+}
+
 inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
 	:Database(simple_db_plugin),
 	 path(block.GetPath("path")),
-#ifdef ENABLE_ZLIB
-	 compress(block.GetBlockValue("compress", true)),
-#endif
+	 compress(ParseCompression(block)),
+	 journal(block.GetBlockValue("journal", false)),
+	 journal_path(AllocatedPath::FromFS(PathTraitsFS::string(path.c_str()) +
+					    PATH_LITERAL(".journal"))),
 	 cache_path(block.GetPath("cache_directory"))
 {
 	if (path.IsNull())
 		throw std::runtime_error("No \"path\" parameter specified");
 
 	path_utf8 = path.ToUTF8();
+
+	const char *format = block.GetBlockValue("format", "text");
+	if (StringIsEqual(format, "binary"))
+		binary = true;
+	else if (!StringIsEqual(format, "text"))
+		throw FormatRuntimeError("Unsupported database format: %s",
+					 format);
+
+	load_threads = block.GetBlockValue("load_threads", 0U);
+	if (load_threads == 0)
+		load_threads = std::max(std::thread::hardware_concurrency(),
+					1U);
+
+	search_threads = block.GetBlockValue("search_threads", 0U);
+	if (search_threads == 0)
+		search_threads = std::max(std::thread::hardware_concurrency(),
+					  1U);
 }
 
 inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
-#ifndef ENABLE_ZLIB
-				      gcc_unused
-#endif
-				      bool _compress) noexcept
+				      Compression _compress) noexcept
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
-#ifdef ENABLE_ZLIB
 	 compress(_compress),
-#endif
+	 journal_path(AllocatedPath::FromFS(PathTraitsFS::string(path.c_str()) +
+					    PATH_LITERAL(".journal"))),
 	 cache_path(nullptr),
 	 prefixed_light_song(nullptr) {
 }
@@ -151,15 +236,70 @@ SimpleDatabase::Load()
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	TextFile file(path);
+	if (db_is_binary(path)) {
+		LogDebug(simple_db_domain, "reading binary DB");
+
+		db_load_binary(path, *root);
+	} else if (load_threads > 1) {
+		FormatDebug(simple_db_domain, "reading DB with %u threads",
+			    load_threads);
 
-	LogDebug(simple_db_domain, "reading DB");
+		db_load_parallel(path, *root, load_threads);
+	} else {
+		TextFile file(path);
 
-	db_load_internal(file, *root);
+		LogDebug(simple_db_domain, "reading DB");
+
+		db_load_internal(file, *root);
+	}
 
 	FileInfo fi;
 	if (GetFileInfo(path, fi))
 		mtime = fi.GetModificationTime();
+
+	LoadJournal();
+}
+
+inline void
+SimpleDatabase::LoadJournal() noexcept
+{
+	FileInfo base, fi;
+	if (!GetFileInfo(path, base))
+		return;
+
+	if (!GetFileInfo(journal_path, fi)) {
+		/* no journal: new entries can be appended to a new
+		   journal file */
+		need_full_save = false;
+		return;
+	}
+
+	try {
+		bool complete;
+		unsigned n;
+
+		{
+			TextFile file(journal_path);
+			n = db_journal_check(file, base, complete);
+		}
+
+		FormatDebug(simple_db_domain,
+			    "replaying %u DB journal entries", n);
+
+		TextFile file(journal_path);
+		db_journal_load(file, *root, n);
+
+		mtime = fi.GetModificationTime();
+
+		if (complete)
+			need_full_save = false;
+		else
+			LogWarning(simple_db_domain,
+				   "DB journal is truncated");
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to load DB journal");
+	}
 }
 
 void
@@ -169,6 +309,7 @@ SimpleDatabase::Open()
 
 	root = Directory::NewRoot();
 	mtime = std::chrono::system_clock::time_point::min();
+	need_full_save = true;
 
 #ifndef NDEBUG
 	borrowed_song_count = 0;
@@ -185,6 +326,11 @@ SimpleDatabase::Open()
 
 		root = Directory::NewRoot();
 	}
+
+	/* build the TagIndex with the first Visit() call */
+	const ScopeDatabaseLock protect;
+	tag_index.Clear();
+	tag_index_serial = db_serial;
 }
 
 void
@@ -194,6 +340,8 @@ SimpleDatabase::Close() noexcept
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+	tag_index.Clear();
+
 	delete root;
 }
 
@@ -248,6 +396,128 @@ SimpleDatabase::GetSong(const char *uri) const
 	return &light_song.Get();
 }
 
+namespace {
+
+/**
+ * Songs requested by SimpleDatabase::GetSongs() which belong to one
+ * mounted database.
+ */
+struct MountedSongs {
+	const Directory &mount;
+
+	/**
+	 * Indexes into the caller's URI list.
+	 */
+	std::vector<std::size_t> indexes;
+
+	/**
+	 * The URIs relative to the mount point.
+	 */
+	std::vector<std::string> uris;
+
+	explicit MountedSongs(const Directory &_mount) noexcept
+		:mount(_mount) {}
+};
+
+}
+
+void
+SimpleDatabase::GetSongs(ConstBuffer<const char *> uris,
+			 VisitSongIndex visit_song) const
+{
+	assert(root != nullptr);
+
+	/* sort the URIs, so songs in the same directory are adjacent
+	   and each directory needs to be looked up only once */
+	std::vector<std::size_t> order(uris.size);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(),
+		  [uris](std::size_t a, std::size_t b){
+			  return StringCompare(uris[a], uris[b]) < 0;
+		  });
+
+	std::vector<MountedSongs> mounted;
+
+	{
+		const ScopeDatabaseLock protect;
+
+		std::string_view directory_uri;
+		const Directory *directory = nullptr;
+		const char *mount_uri = nullptr;
+		bool directory_missing = true;
+
+		for (std::size_t i : order) {
+			const char *uri = uris[i];
+			const char *slash = strrchr(uri, '/');
+			const std::string_view parent = slash != nullptr
+				? std::string_view(uri, slash - uri)
+				: std::string_view();
+			const char *name = slash != nullptr ? slash + 1 : uri;
+
+			if (directory == nullptr || parent != directory_uri) {
+				const std::string parent_s(parent);
+				auto r = root->LookupDirectory(parent_s.c_str());
+				directory_uri = parent;
+				directory = r.directory;
+				directory_missing = r.uri != nullptr &&
+					!directory->IsMount();
+				mount_uri = nullptr;
+
+				if (directory->IsMount()) {
+					/* remember the path below
+					   the mount point; "r.uri"
+					   points into the temporary
+					   string */
+					mount_uri = r.uri != nullptr
+						? uri + (r.uri - parent_s.c_str())
+						: nullptr;
+				}
+			}
+
+			if (directory_missing || *name == 0)
+				continue;
+
+			if (directory->IsMount()) {
+				auto m = std::find_if(mounted.begin(),
+						      mounted.end(),
+						      [directory](const MountedSongs &k){
+							      return &k.mount == directory;
+						      });
+				if (m == mounted.end()) {
+					mounted.emplace_back(*directory);
+					m = std::prev(mounted.end());
+				}
+
+				m->indexes.push_back(i);
+				m->uris.emplace_back(mount_uri != nullptr
+						     ? mount_uri
+						     : name);
+				continue;
+			}
+
+			const Song *song = directory->FindSong(name);
+			if (song != nullptr)
+				visit_song(i, song->Export());
+		}
+	}
+
+	/* pass the remaining requests to the mounted databases,
+	   unlocked, just like GetSong() does */
+	for (const auto &m : mounted) {
+		std::vector<const char *> p;
+		p.reserve(m.uris.size());
+		for (const auto &u : m.uris)
+			p.push_back(u.c_str());
+
+		m.mount.mounted_database->GetSongs({p.data(), p.size()},
+						   [&m, &visit_song](std::size_t j,
+								     const LightSong &song){
+			visit_song(m.indexes[j],
+				   PrefixedLightSong(song, m.mount.GetPath()));
+		});
+	}
+}
+
 void
 SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const noexcept
 {
@@ -267,6 +537,73 @@ SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const noexcept
 	}
 }
 
+const TagIndex *
+SimpleDatabase::GetTagIndex() const noexcept
+{
+	assert(holding_db_lock());
+
+	if (!tag_index.IsValid()) {
+		if (tag_index_serial != db_serial) {
+			/* the tree has been modified since the last
+			   call, and it may still be in progress
+			   (e.g. by the update thread); don't waste
+			   time rebuilding the index until the tree
+			   has settled */
+			tag_index_serial = db_serial;
+			return nullptr;
+		}
+
+		LogDebug(simple_db_domain, "building tag index");
+		tag_index.Build(*root);
+	}
+
+	return tag_index.IsUsable()
+		? &tag_index
+		: nullptr;
+}
+
+gcc_pure
+static bool
+IsInside(const Directory &directory, const Directory &parent,
+	 bool recursive) noexcept
+{
+	if (!recursive)
+		return &directory == &parent;
+
+	for (const Directory *i = &directory; i != nullptr; i = i->parent)
+		if (i == &parent)
+			return true;
+
+	return false;
+}
+
+bool
+SimpleDatabase::VisitIndexed(const Directory &directory,
+			     const DatabaseSelection &selection,
+			     const VisitSong &visit_song) const
+{
+	assert(selection.filter != nullptr);
+
+	const TagIndex *index = GetTagIndex();
+	if (index == nullptr)
+		return false;
+
+	std::vector<const Song *> songs;
+	if (!index->Lookup(*selection.filter, songs))
+		return false;
+
+	for (const Song *song : songs) {
+		if (!IsInside(song->parent, directory, selection.recursive))
+			continue;
+
+		const LightSong song2 = song->Export();
+		if (selection.filter->Match(song2))
+			visit_song(song2);
+	}
+
+	return true;
+}
+
 gcc_const
 static DatabaseSelection
 CheckSelection(DatabaseSelection selection) noexcept
@@ -305,6 +642,43 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		if (selection.recursive && visit_directory)
 			visit_directory(r.directory->Export());
 
+		if (selection.filter != nullptr && visit_song &&
+		    !visit_directory && !visit_playlist &&
+		    VisitIndexed(*r.directory, selection, visit_song)) {
+			helper.Commit();
+			return;
+		}
+
+		if (visit_song && !visit_directory && !visit_playlist &&
+		    r.directory->totals.n_mounts == 0 &&
+		    selection.filter != nullptr && selection.recursive &&
+		    search_threads > 1 &&
+		    r.directory->totals.n_songs >= PARALLEL_SEARCH_THRESHOLD) {
+			/* evaluate the filter in several threads;
+			   visit_song is invoked in this thread, in
+			   Walk() order, and the helper applies sort
+			   and window afterwards */
+			for (const Song *song : ParallelSearch(*r.directory,
+							       *selection.filter,
+							       search_threads))
+				visit_song(song->Export());
+
+			helper.Commit();
+			return;
+		}
+
+		if (visit_song && !visit_directory && !visit_playlist &&
+		    r.directory->totals.n_mounts == 0) {
+			const auto f = [&visit_song](const Song &song){
+				visit_song(song.Export());
+			};
+
+			ForEachSong(*r.directory, selection.recursive,
+				    selection.filter, f);
+			helper.Commit();
+			return;
+		}
+
 		r.directory->Walk(selection.recursive, selection.filter,
 				  visit_directory, visit_song,
 				  visit_playlist);
@@ -334,42 +708,145 @@ RecursiveMap<std::string>
 SimpleDatabase::CollectUniqueTags(const DatabaseSelection &selection,
 				  ConstBuffer<TagType> tag_types) const
 {
+	{
+		const ScopeDatabaseLock protect;
+
+		const Directory *directory = FindWalk(selection);
+		if (directory != nullptr) {
+			UniqueTagsCollector collector(tag_types);
+			const auto f = [&collector](const Song &song){
+				collector.Add(song.tag);
+			};
+
+			ForEachSong(*directory, selection.recursive,
+				    selection.filter, f);
+			return collector.Commit();
+		}
+	}
+
 	return ::CollectUniqueTags(*this, selection, tag_types);
 }
 
+const Directory *
+SimpleDatabase::FindTotals(const DatabaseSelection &selection) const noexcept
+{
+	if (!selection.recursive)
+		return nullptr;
+
+	const char *uri = selection.uri.c_str();
+
+	if (selection.filter != nullptr && !selection.filter->IsEmpty()) {
+		/* a single "base" filter item can be answered with
+		   the totals of that directory */
+		if (!selection.uri.empty() ||
+		    selection.filter->GetItems().size() != 1 ||
+		    selection.filter->HasOtherThanBase())
+			return nullptr;
+
+		uri = selection.filter->GetBase();
+	}
+
+	const auto r = root->LookupDirectory(uri);
+	if (r.uri != nullptr || r.directory->totals.n_mounts > 0)
+		return nullptr;
+
+	return r.directory;
+}
+
+const Directory *
+SimpleDatabase::FindWalk(const DatabaseSelection &selection) const noexcept
+{
+	if (!selection.window.IsAll() ||
+	    selection.sort != TAG_NUM_OF_ITEM_TYPES)
+		return nullptr;
+
+	const auto r = root->LookupDirectory(selection.uri.c_str());
+	if (r.uri != nullptr || r.directory->totals.n_mounts > 0)
+		return nullptr;
+
+	return r.directory;
+}
+
 DatabaseStats
 SimpleDatabase::GetStats(const DatabaseSelection &selection) const
 {
+	if (selection.IsEmpty() && selection.recursive) {
+		const ScopeDatabaseLock protect;
+
+		if (root->totals.n_mounts == 0) {
+			const auto &totals = root->totals;
+
+			DatabaseStats stats;
+			stats.song_count = totals.n_songs;
+			stats.total_duration = totals.tag_duration;
+			stats.artist_count = root->tag_counter->GetArtistCount();
+			stats.album_count = root->tag_counter->GetAlbumCount();
+			stats.song_memory = totals.memory;
+			return stats;
+		}
+	}
+
 	return ::GetStats(*this, selection);
 }
 
-void
-SimpleDatabase::Save()
+DatabaseStats
+SimpleDatabase::CountSongs(const DatabaseSelection &selection) const
 {
 	{
 		const ScopeDatabaseLock protect;
 
-		LogDebug(simple_db_domain, "removing empty directories from DB");
-		root->PruneEmpty();
+		const Directory *directory = FindTotals(selection);
+		if (directory != nullptr) {
+			DatabaseStats stats;
+			stats.Clear();
+			stats.song_count = directory->totals.n_songs;
+			stats.total_duration = directory->totals.song_duration;
+			return stats;
+		}
 
-		LogDebug(simple_db_domain, "sorting DB");
-		root->Sort();
+		directory = FindWalk(selection);
+		if (directory != nullptr) {
+			DatabaseStats stats;
+			stats.Clear();
+			const auto f = [&stats](const Song &song){
+				++stats.song_count;
+
+				const auto duration = song.GetDuration();
+				if (!duration.IsNegative())
+					stats.total_duration += duration;
+			};
+
+			ForEachSong(*directory, selection.recursive,
+				    selection.filter, f);
+			return stats;
+		}
 	}
 
-	LogDebug(simple_db_domain, "writing DB");
-
-	FileOutputStream fos(path);
+	return ::CountSongs(*this, selection);
+}
 
+inline void
+SimpleDatabase::SaveText(OutputStream &fos)
+{
 	OutputStream *os = &fos;
 
 #ifdef ENABLE_ZLIB
 	std::unique_ptr<GzipOutputStream> gzip;
-	if (compress) {
+	if (compress == Compression::GZIP) {
 		gzip.reset(new GzipOutputStream(*os));
 		os = gzip.get();
 	}
 #endif
 
+#ifdef ENABLE_ZSTD
+	std::unique_ptr<ZstdOutputStream> zstd;
+	if (compress == Compression::ZSTD) {
+		zstd = std::make_unique<ZstdOutputStream>(*os,
+							  std::thread::hardware_concurrency());
+		os = zstd.get();
+	}
+#endif
+
 	BufferedOutputStream bos(*os);
 
 	db_save_internal(bos, *root);
@@ -383,11 +860,113 @@ SimpleDatabase::Save()
 	}
 #endif
 
+#ifdef ENABLE_ZSTD
+	if (zstd != nullptr) {
+		zstd->Flush();
+		zstd.reset();
+	}
+#endif
+}
+
+inline void
+SimpleDatabase::SaveFull()
+{
+	/* these only lock the db_mutex for one directory at a time,
+	   to avoid blocking all clients while a big database is
+	   being processed; the db_mutex is exclusive, so readers
+	   (including those in the CommandPool) are serialized
+	   with each other, but none of them waits for more than
+	   one directory */
+
+	LogDebug(simple_db_domain, "removing empty directories from DB");
+	root->LockPruneEmpty();
+
+	LogDebug(simple_db_domain, "sorting DB");
+	root->LockSort();
+
+	LogDebug(simple_db_domain, "writing DB");
+
+	FileOutputStream fos(path);
+
+	if (binary)
+		/* the binary format is never compressed, because it
+		   gets mapped into memory when loading */
+		WithBufferedOutputStream(fos, [this](BufferedOutputStream &bos){
+				db_save_binary(bos, *root);
+			});
+	else
+		SaveText(fos);
+
 	fos.Commit();
 
 	FileInfo fi;
 	if (GetFileInfo(path, fi))
 		mtime = fi.GetModificationTime();
+
+	/* the journal does not belong to the new database file; it
+	   would be ignored by Load(), but it shall not waste disk
+	   space */
+	if (PathExists(journal_path))
+		RemoveFile(journal_path);
+
+	need_full_save = false;
+}
+
+inline bool
+SimpleDatabase::SaveJournal(const char *uri)
+{
+	FileInfo base;
+	if (!GetFileInfo(path, base))
+		return false;
+
+	uint64_t journal_size = 0;
+	FileInfo fi;
+	if (GetFileInfo(journal_path, fi))
+		journal_size = fi.GetSize();
+
+	if (journal_size > base.GetSize() / 4)
+		/* replaying the journal is getting expensive;
+		   compact it */
+		return false;
+
+	LogDebug(simple_db_domain, "writing DB journal");
+
+	FileOutputStream fos(journal_path,
+			     FileOutputStream::Mode::APPEND_OR_CREATE);
+
+	WithBufferedOutputStream(fos, [&](BufferedOutputStream &bos){
+			if (journal_size == 0)
+				db_journal_save_header(bos, base);
+
+			db_journal_save(bos, *root, uri);
+		});
+
+	fos.Commit();
+
+	if (GetFileInfo(journal_path, fi))
+		mtime = fi.GetModificationTime();
+
+	return true;
+}
+
+void
+SimpleDatabase::Save(const char *uri)
+{
+	if (journal && uri != nullptr && !isRootDirectory(uri) &&
+	    !need_full_save) {
+		try {
+			if (SaveJournal(uri))
+				return;
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to write DB journal");
+
+			/* the journal may be corrupt now */
+			need_full_save = true;
+		}
+	}
+
+	SaveFull();
 }
 
 void
@@ -412,7 +991,7 @@ SimpleDatabase::Mount(const char *uri, DatabasePtr db)
 				    "Parent not found");
 
 	Directory *mnt = r.directory->CreateChild(r.uri);
-	mnt->mounted_database = std::move(db);
+	mnt->SetMount(std::move(db));
 }
 
 static constexpr bool
@@ -439,9 +1018,6 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 
 	const auto name_fs = AllocatedPath::FromUTF8Throw(name.c_str());
 
-#ifndef ENABLE_ZLIB
-	constexpr bool compress = false;
-#endif
 	auto db = std::make_unique<SimpleDatabase>(cache_path / name_fs,
 						   compress);
 	db->Open();
@@ -484,6 +1060,7 @@ SimpleDatabase::Unmount(const char *uri) noexcept
 
 const DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE |
+	DatabasePlugin::FLAG_CONCURRENT_READS,
 	SimpleDatabase::Create,
 };
@@ -20,6 +20,7 @@
 #ifndef MPD_SIMPLE_DATABASE_PLUGIN_HXX
 #define MPD_SIMPLE_DATABASE_PLUGIN_HXX
 
+#include "TagIndex.hxx"
 #include "db/Interface.hxx"
 #include "db/Ptr.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -30,20 +31,69 @@
 
 #include <cassert>
 
+#include <stdint.h>
+
 struct ConfigBlock;
 struct Directory;
 struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
 class PrefixedLightSong;
+class OutputStream;
 
 class SimpleDatabase : public Database {
+public:
+	/**
+	 * The compression of the text format.
+	 */
+	enum class Compression : uint8_t {
+		NONE,
+		GZIP,
+		ZSTD,
+	};
+
+private:
 	AllocatedPath path;
 	std::string path_utf8;
 
-#ifdef ENABLE_ZLIB
-	bool compress;
-#endif
+	Compression compress;
+
+	/**
+	 * Save the database in the memory-mappable binary format
+	 * (see DatabaseBinary.hxx) instead of the text format?
+	 */
+	bool binary = false;
+
+	/**
+	 * The number of threads used to parse a database file in the
+	 * text format.
+	 */
+	unsigned load_threads = 1;
+
+	/**
+	 * The number of threads used for search filters which cannot
+	 * be answered by the #TagIndex.
+	 */
+	unsigned search_threads = 1;
+
+	/**
+	 * Append the changes made by partial updates to a journal
+	 * file instead of rewriting the whole database file each
+	 * time?  See DatabaseJournal.hxx.
+	 */
+	bool journal = false;
+
+	/**
+	 * If true, then the next Save() call must rewrite the whole
+	 * database file, because there is no usable journal file.
+	 */
+	bool need_full_save = true;
+
+	/**
+	 * The path of the journal file, i.e. #path with ".journal"
+	 * appended.
+	 */
+	AllocatedPath journal_path;
 
 	/**
 	 * The path where cache files for Mount() are located.
@@ -54,6 +104,23 @@ class SimpleDatabase : public Database {
 
 	std::chrono::system_clock::time_point mtime;
 
+	/**
+	 * An inverted index for selective Visit() calls.  It is
+	 * rebuilt on demand after the tree has been modified.
+	 *
+	 * Protected by #db_mutex.
+	 */
+	mutable TagIndex tag_index;
+
+	/**
+	 * The #db_serial value seen by the last Visit() call which
+	 * found #tag_index to be stale.  Used to postpone rebuilding
+	 * the index while the tree is still being modified.
+	 *
+	 * Protected by #db_mutex.
+	 */
+	mutable unsigned tag_index_serial;
+
 	/**
 	 * A buffer for GetSong() when prefixing the #LightSong
 	 * instance from a mounted #Database.
@@ -71,7 +138,7 @@ class SimpleDatabase : public Database {
 
 public:
 	SimpleDatabase(const ConfigBlock &block);
-	SimpleDatabase(AllocatedPath &&_path, bool _compress) noexcept;
+	SimpleDatabase(AllocatedPath &&_path, Compression _compress) noexcept;
 
 	static DatabasePtr Create(EventLoop &main_event_loop,
 				  EventLoop &io_event_loop,
@@ -85,7 +152,13 @@ public:
 		return *root;
 	}
 
-	void Save();
+	/**
+	 * Write the database to the disk.
+	 *
+	 * @param uri the URI which was updated, or nullptr (or
+	 * empty) if the whole database was updated
+	 */
+	void Save(const char *uri=nullptr);
 
 	/**
 	 * Returns true if there is a valid database file on the disk.
@@ -116,6 +189,8 @@ public:
 
 	const LightSong *GetSong(const char *uri_utf8) const override;
 	void ReturnSong(const LightSong *song) const noexcept override;
+	void GetSongs(ConstBuffer<const char *> uris,
+		      VisitSongIndex visit_song) const override;
 
 	void Visit(const DatabaseSelection &selection,
 		   VisitDirectory visit_directory,
@@ -126,6 +201,7 @@ public:
 						    ConstBuffer<TagType> tag_types) const override;
 
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
+	DatabaseStats CountSongs(const DatabaseSelection &selection) const override;
 
 	std::chrono::system_clock::time_point GetUpdateStamp() const noexcept override {
 		return mtime;
@@ -141,7 +217,76 @@ private:
 	 */
 	void Load();
 
+	/**
+	 * Replay the journal file (if one exists) on top of the
+	 * loaded database file.  Errors are logged.
+	 */
+	void LoadJournal() noexcept;
+
+	void SaveText(OutputStream &os);
+
+	/**
+	 * Rewrite the whole database file and delete the journal.
+	 */
+	void SaveFull();
+
+	/**
+	 * Append an entry for the given URI to the journal.
+	 *
+	 * @return false if the journal is too large and the whole
+	 * database file shall be rewritten instead
+	 */
+	bool SaveJournal(const char *uri);
+
 	DatabasePtr LockUmountSteal(const char *uri) noexcept;
+
+	/**
+	 * Returns the #TagIndex if it is up to date (or can be
+	 * rebuilt now), or nullptr if the caller shall walk the tree
+	 * instead.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	const TagIndex *GetTagIndex() const noexcept;
+
+	/**
+	 * Find the directory whose #Directory::totals answer a
+	 * Visit() with the given selection, i.e. without a filter
+	 * (other than "base") and without mount points.
+	 *
+	 * Caller must lock the #db_mutex.
+	 *
+	 * @return the directory or nullptr if the tree must be
+	 * walked
+	 */
+	gcc_pure
+	const Directory *FindTotals(const DatabaseSelection &selection) const noexcept;
+
+	/**
+	 * Find the directory which can be walked with ForEachSong()
+	 * (see Walk.hxx) for the given selection, i.e. one without
+	 * mount points, and the selection must not be sorted or
+	 * windowed.
+	 *
+	 * Caller must lock the #db_mutex.
+	 *
+	 * @return the directory or nullptr if the generic Visit()
+	 * code must be used
+	 */
+	gcc_pure
+	const Directory *FindWalk(const DatabaseSelection &selection) const noexcept;
+
+	/**
+	 * Visit the songs below the given directory using the
+	 * #TagIndex.
+	 *
+	 * Caller must lock the #db_mutex.
+	 *
+	 * @return false if the index cannot handle this selection
+	 */
+	bool VisitIndexed(const Directory &directory,
+			  const DatabaseSelection &selection,
+			  const VisitSong &visit_song) const;
 };
 
 extern const DatabasePlugin simple_db_plugin;
@@ -23,39 +23,130 @@
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 #include "fs/Traits.hxx"
+#include "util/Alloc.hxx"
 
-Song::Song(DetachedSong &&other, Directory &_parent) noexcept
-	:tag(std::move(other.WritableTag())),
-	 parent(_parent),
-	 mtime(other.GetLastModified()),
-	 start_time(other.GetStartTime()),
-	 end_time(other.GetEndTime()),
-	 filename(other.GetURI())
+#include <algorithm>
+
+#include <string.h>
+
+SongPtr
+Song::New(std::string_view filename, Directory &parent) noexcept
+{
+	void *p = xalloc(sizeof(Song) + filename.size() + 1);
+	SongPtr song(::new(p) Song(parent));
+
+	char *dest = const_cast<char *>(song->GetFilename());
+	*std::copy(filename.begin(), filename.end(), dest) = 0;
+
+	return song;
+}
+
+SongPtr
+Song::New(std::string_view filename, DetachedSong &&other, Directory &parent)
+{
+	auto song = New(filename, parent);
+	song->tag = std::move(other.WritableTag());
+	song->mtime = other.GetLastModified();
+	song->SetRange(other.GetStartTime(), other.GetEndTime());
+	song->SetReplayGain(other.GetReplayGain());
+	return song;
+}
+
+SongPtr
+Song::New(DetachedSong &&other, Directory &parent)
 {
+	return New(other.GetURI(), std::move(other), parent);
+}
+
+void
+Song::SetTarget(std::string &&_target)
+{
+	if (_target.empty() && extra == nullptr)
+		return;
+
+	if (extra == nullptr)
+		extra = std::make_unique<Extra>();
+
+	extra->target = std::move(_target);
+}
+
+void
+Song::SetRange(SongTime start_time, SongTime end_time)
+{
+	if (start_time.IsZero() && end_time.IsZero() && extra == nullptr)
+		return;
+
+	if (extra == nullptr)
+		extra = std::make_unique<Extra>();
+
+	extra->start_time = start_time;
+	extra->end_time = end_time;
+}
+
+void
+Song::SetReplayGain(const ReplayGainInfo &replay_gain)
+{
+	if (!replay_gain.IsDefined() && extra == nullptr)
+		return;
+
+	if (extra == nullptr)
+		extra = std::make_unique<Extra>();
+
+	extra->replay_gain = replay_gain;
+}
+
+SignedSongTime
+Song::GetDuration() const noexcept
+{
+	SongTime a = GetStartTime(), b = GetEndTime();
+	if (!b.IsPositive()) {
+		if (tag.duration.IsNegative())
+			return tag.duration;
+
+		b = SongTime(tag.duration);
+	}
+
+	return SignedSongTime(b - a);
+}
+
+std::size_t
+Song::GetMemoryUsage() const noexcept
+{
+	std::size_t size = sizeof(*this) + strlen(GetFilename()) + 1;
+
+	if (extra != nullptr) {
+		size += sizeof(*extra);
+		if (extra->target.capacity() >= sizeof(extra->target))
+			size += extra->target.capacity() + 1;
+	}
+
+	size += tag.num_items * Tag::ItemSize();
+	return size;
 }
 
 std::string
 Song::GetURI() const noexcept
 {
 	if (parent.IsRoot())
-		return filename;
+		return GetFilename();
 	else {
 		const char *path = parent.GetPath();
-		return PathTraitsUTF8::Build(path, filename.c_str());
+		return PathTraitsUTF8::Build(path, GetFilename());
 	}
 }
 
 LightSong
 Song::Export() const noexcept
 {
-	LightSong dest(filename.c_str(), tag);
+	LightSong dest(GetFilename(), tag);
 	if (!parent.IsRoot())
 		dest.directory = parent.GetPath();
-	if (!target.empty())
-		dest.real_uri = target.c_str();
+	if (HasTarget())
+		dest.real_uri = extra->target.c_str();
 	dest.mtime = mtime;
-	dest.start_time = start_time;
-	dest.end_time = end_time;
+	dest.start_time = GetStartTime();
+	dest.end_time = GetEndTime();
 	dest.audio_format = audio_format;
+	dest.replay_gain = GetReplayGain();
 	return dest;
 }
@@ -24,12 +24,18 @@
 #include "Chrono.hxx"
 #include "tag/Tag.hxx"
 #include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
 #include <boost/intrusive/list.hpp>
 
+#include <memory>
 #include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdlib>
 
 struct StringView;
 struct LightSong;
@@ -72,41 +78,141 @@ struct Song {
 		std::chrono::system_clock::time_point::min();
 
 	/**
-	 * Start of this sub-song within the file.
+	 * The audio format of the song, if given by the decoder
+	 * plugin.  May be undefined if unknown.
 	 */
-	SongTime start_time = SongTime::zero();
+	AudioFormat audio_format = AudioFormat::Undefined();
 
+private:
 	/**
-	 * End of this sub-song within the file.
-	 * Unused if zero.
+	 * Attributes which are only used by a small fraction of all
+	 * songs (sub-songs of CUE sheets, playlist entries, measured
+	 * ReplayGain values).  They
+	 * are allocated on demand to keep the #Song object small.
+	 */
+	struct Extra {
+		/**
+		 * If non-empty, then this object does not describe a
+		 * file within the `music_directory`, but some sort of
+		 * symbolic link pointing to this value.  It can be an
+		 * absolute URI (i.e. with URI scheme) or a URI
+		 * relative to this object (which may begin with one
+		 * or more "../").
+		 */
+		std::string target;
+
+		/**
+		 * Start of this sub-song within the file.
+		 */
+		SongTime start_time = SongTime::zero();
+
+		/**
+		 * End of this sub-song within the file.
+		 * Unused if zero.
+		 */
+		SongTime end_time = SongTime::zero();
+
+		/**
+		 * ReplayGain values measured by the database update
+		 * ("update_loudness_analysis").
+		 */
+		ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+	};
+
+	std::unique_ptr<Extra> extra;
+
+	/*
+	 * The null-terminated file name is stored right after this
+	 * object, in the same allocation; see New().
 	 */
-	SongTime end_time = SongTime::zero();
+
+	Song(Directory &_parent) noexcept
+		:parent(_parent) {}
+
+public:
+	Song(const Song &) = delete;
+	Song &operator=(const Song &) = delete;
 
 	/**
-	 * The audio format of the song, if given by the decoder
-	 * plugin.  May be undefined if unknown.
+	 * Allocate a new #Song object.  The file name is stored in
+	 * the same allocation, which saves the overhead of a second
+	 * heap allocation for each song.
 	 */
-	AudioFormat audio_format = AudioFormat::Undefined();
+	static SongPtr New(std::string_view filename,
+			   Directory &parent) noexcept;
+
+	/**
+	 * Allocate a new #Song object, copying all attributes from
+	 * the given #DetachedSong (with the URI as file name).
+	 */
+	static SongPtr New(DetachedSong &&other, Directory &parent);
+
+	/**
+	 * Like New(DetachedSong&&), but with a different file name.
+	 */
+	static SongPtr New(std::string_view filename,
+			   DetachedSong &&other, Directory &parent);
+
+	static void *operator new(std::size_t) = delete;
+
+	static void operator delete(void *p) noexcept {
+		std::free(p);
+	}
 
 	/**
 	 * The file name.
 	 */
-	std::string filename;
+	const char *GetFilename() const noexcept {
+		return reinterpret_cast<const char *>(this + 1);
+	}
 
 	/**
-	 * If non-empty, then this object does not describe a file
-	 * within the `music_directory`, but some sort of symbolic
-	 * link pointing to this value.  It can be an absolute URI
-	 * (i.e. with URI scheme) or a URI relative to this object
-	 * (which may begin with one or more "../").
+	 * @see Extra::target
 	 */
-	std::string target;
+	const char *GetTarget() const noexcept {
+		return extra != nullptr ? extra->target.c_str() : "";
+	}
 
-	template<typename F>
-	Song(F &&_filename, Directory &_parent) noexcept
-		:parent(_parent), filename(std::forward<F>(_filename)) {}
+	bool HasTarget() const noexcept {
+		return extra != nullptr && !extra->target.empty();
+	}
 
-	Song(DetachedSong &&other, Directory &_parent) noexcept;
+	void SetTarget(std::string &&_target);
+
+	SongTime GetStartTime() const noexcept {
+		return extra != nullptr ? extra->start_time : SongTime::zero();
+	}
+
+	SongTime GetEndTime() const noexcept {
+		return extra != nullptr ? extra->end_time : SongTime::zero();
+	}
+
+	void SetRange(SongTime start_time, SongTime end_time);
+
+	ReplayGainInfo GetReplayGain() const noexcept {
+		return extra != nullptr
+			? extra->replay_gain
+			: ReplayGainInfo::Undefined();
+	}
+
+	void SetReplayGain(const ReplayGainInfo &replay_gain);
+
+	/**
+	 * Returns the duration of this song (taking the range of
+	 * sub-songs into account), or a negative value if it is
+	 * unknown.  Equivalent to LightSong::GetDuration().
+	 */
+	gcc_pure
+	SignedSongTime GetDuration() const noexcept;
+
+	/**
+	 * Determine the approximate number of bytes occupied by this
+	 * object, including its file name, the out-of-line attributes
+	 * and the tag item array (but not the tag items, which are
+	 * shared in the tag pool).
+	 */
+	gcc_pure
+	std::size_t GetMemoryUsage() const noexcept;
 
 	/**
 	 * allocate a new song structure with a local file name and attempt to
@@ -128,11 +234,33 @@ struct Song {
 	 */
 	bool UpdateFile(Storage &storage);
 
+	/**
+	 * Scan a file like UpdateFile(), but store the results in the
+	 * given variables instead of a #Song object.  They are only
+	 * modified on success.  This function does not access the
+	 * database, and may be called from any thread.
+	 *
+	 * Throws on error.
+	 *
+	 * @param uri the URI of the file relative to the storage
+	 * @return true on success, false if the file was not recognized
+	 */
+	static bool ScanFile(Storage &storage, const char *uri,
+			     Tag &tag_r, AudioFormat &audio_format_r,
+			     std::chrono::system_clock::time_point &mtime_r);
+
 #ifdef ENABLE_ARCHIVE
 	static SongPtr LoadFromArchive(ArchiveFile &archive,
 				       const char *name_utf8,
 				       Directory &parent) noexcept;
 	bool UpdateFileInArchive(ArchiveFile &archive) noexcept;
+
+	/**
+	 * Like UpdateFileInArchive(), but store the new tag in the
+	 * given object instead of modifying this #Song.
+	 */
+	bool ScanFileInArchive(ArchiveFile &archive,
+			       Tag &tag_r) const noexcept;
 #endif
 
 	/**
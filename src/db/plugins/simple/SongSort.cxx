@@ -74,8 +74,7 @@ compare_tag_item(const Tag &a, const Tag &b, TagType type) noexcept
 }
 
 /* Only used for sorting/searchin a songvec, not general purpose compares */
-gcc_pure
-static bool
+bool
 song_cmp(const Song &a, const Song &b) noexcept
 {
 	int ret;
@@ -96,11 +95,64 @@ song_cmp(const Song &a, const Song &b) noexcept
 		return ret < 0;
 
 	/* still no difference?  compare file name */
-	return IcuCollate(a.filename.c_str(), b.filename.c_str()) < 0;
+	return IcuCollate(a.GetFilename(), b.GetFilename()) < 0;
+}
+
+/**
+ * Parse a disc or track number like compare_number_string() does:
+ * all non-positive values are equal.
+ */
+gcc_pure
+static long
+ParseSortNumber(const char *s) noexcept
+{
+	const long i = s == nullptr ? 0 : strtol(s, nullptr, 10);
+	return i > 0 ? i : 0;
+}
+
+bool
+SongSortKey::operator<(const SongSortKey &other) const noexcept
+{
+	/* albums with the same pointer are equal */
+	if (album != other.album) {
+		if (album == nullptr)
+			return true;
+
+		if (other.album == nullptr)
+			return false;
+
+		int ret = album->compare(*other.album);
+		if (ret != 0)
+			return ret < 0;
+	}
+
+	if (disc != other.disc)
+		return disc < other.disc;
+
+	if (track != other.track)
+		return track < other.track;
+
+	return filename < other.filename;
 }
 
-void
-song_list_sort(SongList &songs) noexcept
+SongSortKey
+SongSortKeyFactory::operator()(const Song &song) noexcept
 {
-	songs.sort(song_cmp);
+	const std::string *album = nullptr;
+
+	const char *album_value = song.tag.GetValue(TAG_ALBUM);
+	if (album_value != nullptr) {
+		auto i = album_keys.find(album_value);
+		if (i == album_keys.end())
+			i = album_keys.emplace(album_value,
+					       IcuCollateKey(album_value)).first;
+		album = &i->second;
+	}
+
+	return {
+		album,
+		ParseSortNumber(song.tag.GetValue(TAG_DISC)),
+		ParseSortNumber(song.tag.GetValue(TAG_TRACK)),
+		IcuCollateKey(song.GetFilename()),
+	};
 }
@@ -21,8 +21,52 @@
 #define MPD_SONG_SORT_HXX
 
 #include "Song.hxx"
+#include "util/Compiler.h"
 
-void
-song_list_sort(SongList &songs) noexcept;
+#include <string>
+#include <unordered_map>
+
+/**
+ * The order of songs within a #Directory.
+ */
+gcc_pure
+bool
+song_cmp(const Song &a, const Song &b) noexcept;
+
+/**
+ * A precomputed sort key of a #Song.  Comparing two keys yields the
+ * same order as song_cmp(), but without collating strings.
+ */
+struct SongSortKey {
+	/**
+	 * The collation key of the album name, owned by the
+	 * #SongSortKeyFactory; nullptr if the song has no album.
+	 */
+	const std::string *album;
+
+	long disc, track;
+
+	/**
+	 * The collation key of the file name.
+	 */
+	std::string filename;
+
+	gcc_pure
+	bool operator<(const SongSortKey &other) const noexcept;
+};
+
+/**
+ * Creates #SongSortKey instances.  The tag values are interned (see
+ * #TagPool), so the collation key of each album name is calculated
+ * only once and looked up by its pointer.  This object must be kept
+ * alive as long as the keys are used, and the songs must not be
+ * modified meanwhile.
+ */
+class SongSortKeyFactory {
+	std::unordered_map<const char *, std::string> album_keys;
+
+public:
+	SongSortKey operator()(const Song &song) noexcept;
+};
 
 #endif
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "TagCounter.hxx"
+#include "tag/Tag.hxx"
+
+#include <assert.h>
+
+static void
+AddValue(std::unordered_map<std::string, unsigned> &map,
+	 const char *value) noexcept
+{
+	++map[value];
+}
+
+static void
+RemoveValue(std::unordered_map<std::string, unsigned> &map,
+	    const char *value) noexcept
+{
+	auto i = map.find(value);
+	assert(i != map.end());
+	assert(i->second > 0);
+
+	if (--i->second == 0)
+		map.erase(i);
+}
+
+void
+TagCounter::Add(const Tag &tag) noexcept
+{
+	for (const auto &item : tag) {
+		switch (item.type) {
+		case TAG_ARTIST:
+			AddValue(artists, item.value);
+			break;
+
+		case TAG_ALBUM:
+			AddValue(albums, item.value);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+void
+TagCounter::Remove(const Tag &tag) noexcept
+{
+	for (const auto &item : tag) {
+		switch (item.type) {
+		case TAG_ARTIST:
+			RemoveValue(artists, item.value);
+			break;
+
+		case TAG_ALBUM:
+			RemoveValue(albums, item.value);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_SIMPLE_TAG_COUNTER_HXX
+#define MPD_SIMPLE_TAG_COUNTER_HXX
+
+#include <string>
+#include <unordered_map>
+
+struct Tag;
+
+/**
+ * Counts the distinct artist and album names of all songs in a
+ * #Directory tree.  It keeps a reference count for each value, so it
+ * can be updated incrementally when songs are added or removed.
+ *
+ * All methods must be called with #db_mutex locked.
+ */
+class TagCounter {
+	typedef std::unordered_map<std::string, unsigned> ValueMap;
+
+	ValueMap artists, albums;
+
+public:
+	void Add(const Tag &tag) noexcept;
+	void Remove(const Tag &tag) noexcept;
+
+	unsigned GetArtistCount() const noexcept {
+		return artists.size();
+	}
+
+	unsigned GetAlbumCount() const noexcept {
+		return albums.size();
+	}
+};
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "song/Filter.hxx"
+#include "song/TagSongFilter.hxx"
+#include "tag/Fallback.hxx"
+
+#include <algorithm>
+
+bool
+TagIndex::IsValid() const noexcept
+{
+	assert(holding_db_lock());
+
+	return valid && serial == db_serial;
+}
+
+void
+TagIndex::Clear() noexcept
+{
+	songs.clear();
+	for (auto &i : values)
+		i.clear();
+
+	valid = false;
+}
+
+inline void
+TagIndex::Add(const Directory &directory) noexcept
+{
+	if (directory.IsMount()) {
+		has_mounts = true;
+		return;
+	}
+
+	/* same order as Directory::Walk() */
+
+	for (const auto &song : directory.songs) {
+		const uint32_t i = songs.size();
+		songs.push_back(&song);
+
+		for (const auto &item : song.tag) {
+			auto &list = values[item.type][item.value];
+			/* a song may have the same value twice */
+			if (list.empty() || list.back() != i)
+				list.push_back(i);
+		}
+	}
+
+	for (const auto &child : directory.children)
+		Add(child);
+}
+
+void
+TagIndex::Build(const Directory &root) noexcept
+{
+	assert(holding_db_lock());
+
+	Clear();
+
+	has_mounts = false;
+	Add(root);
+
+	serial = db_serial;
+	valid = true;
+}
+
+inline const TagIndex::PostingList *
+TagIndex::Find(TagType type, const std::string &value) const noexcept
+{
+	const auto &map = values[type];
+	auto i = map.find(value);
+	return i != map.end()
+		? &i->second
+		: nullptr;
+}
+
+/**
+ * Can this filter item be evaluated by looking up its value in the
+ * index?
+ */
+gcc_pure
+static bool
+IsIndexable(const TagSongFilter &f) noexcept
+{
+	const auto &sf = f.GetStringFilter();
+	return f.GetTagType() < TAG_NUM_OF_ITEM_TYPES &&
+		!sf.IsNegated() && !sf.GetFoldCase() &&
+		!sf.IsSubstring() && !sf.IsRegex() &&
+		/* an empty value also matches songs which don't
+		   have this tag at all */
+		!sf.empty();
+}
+
+bool
+TagIndex::Lookup(const SongFilter &filter,
+		 std::vector<const Song *> &dest) const noexcept
+{
+	assert(IsValid());
+
+	/* find the most selective item; a song can match it through
+	   a fallback tag (e.g. "Artist" for "AlbumArtist"), so the
+	   posting lists of those need to be merged */
+
+	bool found = false;
+	size_t best_size = SIZE_MAX;
+	std::vector<const PostingList *> best;
+	std::vector<const PostingList *> lists;
+
+	for (const auto &i : filter.GetItems()) {
+		const auto *t = dynamic_cast<const TagSongFilter *>(i.get());
+		if (t == nullptr || !IsIndexable(*t))
+			continue;
+
+		lists.clear();
+		size_t size = 0;
+		ApplyTagWithFallback(t->GetTagType(), [&](TagType type){
+				const auto *list = Find(type, t->GetValue());
+				if (list != nullptr) {
+					lists.push_back(list);
+					size += list->size();
+				}
+
+				return false;
+			});
+
+		if (size < best_size) {
+			found = true;
+			best_size = size;
+			best.swap(lists);
+		}
+	}
+
+	if (!found)
+		return false;
+
+	dest.reserve(best_size);
+
+	if (best.size() == 1) {
+		for (auto i : *best.front())
+			dest.push_back(songs[i]);
+	} else if (!best.empty()) {
+		PostingList merged;
+		merged.reserve(best_size);
+		for (const auto *list : best)
+			merged.insert(merged.end(), list->begin(), list->end());
+
+		std::sort(merged.begin(), merged.end());
+		merged.erase(std::unique(merged.begin(), merged.end()),
+			     merged.end());
+
+		for (auto i : merged)
+			dest.push_back(songs[i]);
+	}
+
+	return true;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SIMPLE_TAG_INDEX_HXX
+#define MPD_SIMPLE_TAG_INDEX_HXX
+
+#include "tag/Type.h"
+#include "util/Compiler.h"
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+struct Directory;
+struct Song;
+class SongFilter;
+
+/**
+ * An inverted index mapping tag values to the songs which have them.
+ * It allows SimpleDatabase::Visit() to answer selective queries
+ * without walking the whole tree.
+ *
+ * This object is not updated incrementally.  It remembers the
+ * #db_serial value it was built with, and needs to be rebuilt after
+ * the tree has been modified.
+ *
+ * All methods must be called with #db_mutex locked.
+ */
+class TagIndex {
+	typedef std::vector<uint32_t> PostingList;
+	typedef std::unordered_map<std::string, PostingList> ValueMap;
+
+	/**
+	 * All songs in the order they are visited by
+	 * Directory::Walk().
+	 */
+	std::vector<const Song *> songs;
+
+	/**
+	 * For each tag type, this maps each value to an ascending
+	 * list of indexes into #songs.
+	 */
+	std::array<ValueMap, TAG_NUM_OF_ITEM_TYPES> values;
+
+	unsigned serial;
+
+	bool valid = false;
+
+	/**
+	 * Does the tree contain mount points?  Their contents are not
+	 * indexed, so this index is unusable.
+	 */
+	bool has_mounts;
+
+public:
+	gcc_pure
+	bool IsValid() const noexcept;
+
+	bool IsUsable() const noexcept {
+		return !has_mounts;
+	}
+
+	void Clear() noexcept;
+
+	void Build(const Directory &root) noexcept;
+
+	/**
+	 * Determine a superset of the songs matched by the given
+	 * filter, in Directory::Walk() order.  The caller is
+	 * responsible for applying the filter to each of them.
+	 *
+	 * @return false if the filter cannot be evaluated with this
+	 * index (e.g. because it does not contain an exact tag
+	 * match)
+	 */
+	bool Lookup(const SongFilter &filter,
+		    std::vector<const Song *> &dest) const noexcept;
+
+private:
+	void Add(const Directory &directory) noexcept;
+
+	gcc_pure
+	const PostingList *Find(TagType type,
+				const std::string &value) const noexcept;
+};
+
+#endif
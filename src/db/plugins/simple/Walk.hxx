@@ -0,0 +1,62 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SIMPLE_DATABASE_WALK_HXX
+#define MPD_SIMPLE_DATABASE_WALK_HXX
+
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+
+#include <cassert>
+
+/**
+ * A lightweight alternative to Directory::Walk() which visits only
+ * songs.  The callback is a template parameter (instead of a
+ * #VisitSong), which allows the compiler to inline it, and it
+ * receives the #Song itself; songs which are rejected by
+ * SongFilter::MatchTagTypes() are skipped without constructing a
+ * #LightSong.
+ *
+ * The caller must lock #db_mutex, and there must not be any mount
+ * point below the given directory.
+ */
+template<typename F>
+void
+ForEachSong(const Directory &directory, bool recursive,
+	    const SongFilter *filter, F &&f)
+{
+	assert(directory.totals.n_mounts == 0);
+
+	for (const auto &song : directory.songs) {
+		if (filter != nullptr &&
+		    (!filter->MatchTagTypes(song.tag) ||
+		     !filter->Match(song.Export())))
+			continue;
+
+		f(song);
+	}
+
+	if (recursive)
+		for (const auto &child : directory.children)
+			ForEachSong(child, recursive, filter, f);
+}
+
+#endif
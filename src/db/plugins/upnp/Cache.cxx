@@ -0,0 +1,177 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Cache.hxx"
+#include "Directory.hxx"
+
+/**
+ * Make room for the specified number of new entries.
+ */
+template<typename M>
+static void
+Purge(M &map, std::size_t n, std::size_t max_size,
+      std::chrono::steady_clock::time_point now) noexcept
+{
+	if (map.size() + n <= max_size)
+		return;
+
+	for (auto i = map.begin(); i != map.end();) {
+		if (now >= i->second.expires)
+			i = map.erase(i);
+		else
+			++i;
+	}
+
+	if (map.size() + n > max_size)
+		map.clear();
+}
+
+template<typename M>
+static auto
+Find(M &map, const std::string &id,
+     std::chrono::steady_clock::time_point now) noexcept
+	-> decltype(map.begin()->second.value)
+{
+	auto i = map.find(id);
+	if (i == map.end())
+		return nullptr;
+
+	if (now >= i->second.expires) {
+		map.erase(i);
+		return nullptr;
+	}
+
+	return i->second.value;
+}
+
+bool
+UpnpCache::CheckUpdateID(const std::string &server)
+{
+	if (!IsEnabled())
+		return false;
+
+	const auto now = clock_type::now();
+
+	const std::lock_guard<Mutex> protect(mutex);
+	auto &s = servers[server];
+	if (now < s.next_check)
+		return false;
+
+	s.next_check = now + UPDATE_CHECK_INTERVAL;
+	return true;
+}
+
+void
+UpnpCache::SetUpdateID(const std::string &server, std::string &&update_id)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	auto &s = servers[server];
+	if (update_id != s.update_id) {
+		s.Flush();
+		s.update_id = std::move(update_id);
+	}
+}
+
+std::shared_ptr<const UPnPDirObject>
+UpnpCache::GetMetadata(const std::string &server,
+		       const std::string &id) noexcept
+{
+	if (!IsEnabled())
+		return nullptr;
+
+	const auto now = clock_type::now();
+
+	const std::lock_guard<Mutex> protect(mutex);
+	auto s = servers.find(server);
+	if (s == servers.end())
+		return nullptr;
+
+	return Find(s->second.metadata, id, now);
+}
+
+void
+UpnpCache::PutMetadata(const std::string &server,
+		       std::shared_ptr<const UPnPDirObject> object)
+{
+	if (!IsEnabled())
+		return;
+
+	const auto now = clock_type::now();
+
+	const std::lock_guard<Mutex> protect(mutex);
+	auto &s = servers[server];
+	Purge(s.metadata, 1, MAX_ENTRIES, now);
+
+	const std::string id = object->id;
+	s.metadata[id] = {std::move(object), now + ttl};
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpCache::GetChildren(const std::string &server,
+		       const std::string &id) noexcept
+{
+	if (!IsEnabled())
+		return nullptr;
+
+	const auto now = clock_type::now();
+
+	const std::lock_guard<Mutex> protect(mutex);
+	auto s = servers.find(server);
+	if (s == servers.end())
+		return nullptr;
+
+	return Find(s->second.children, id, now);
+}
+
+void
+UpnpCache::PutChildren(const std::string &server, const std::string &id,
+		       std::shared_ptr<const UPnPDirContent> content)
+{
+	if (!IsEnabled())
+		return;
+
+	const auto now = clock_type::now();
+	const auto expires = now + ttl;
+
+	const std::lock_guard<Mutex> protect(mutex);
+	auto &s = servers[server];
+	Purge(s.children, 1, MAX_ENTRIES, now);
+
+	const std::size_t n = content->objects.size();
+	if (n <= MAX_ENTRIES) {
+		Purge(s.metadata, n, MAX_ENTRIES, now);
+
+		/* the child objects live inside the container
+		   entry; share its reference counter */
+		for (const auto &o : content->objects)
+			s.metadata[o.id] = {
+				std::shared_ptr<const UPnPDirObject>(content, &o),
+				expires,
+			};
+	}
+
+	s.children[id] = {std::move(content), expires};
+}
+
+void
+UpnpCache::Clear() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	servers.clear();
+}
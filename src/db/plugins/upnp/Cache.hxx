@@ -0,0 +1,146 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPNP_CACHE_HXX
+#define MPD_UPNP_CACHE_HXX
+
+#include "thread/Mutex.hxx"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+class UPnPDirObject;
+class UPnPDirContent;
+
+/**
+ * A cache for the results of "Browse" requests to UPnP media
+ * servers: object metadata and the children of containers.  Entries
+ * expire after a configurable time, and all entries of a server are
+ * discarded when its "SystemUpdateID" changes.
+ *
+ * This class is thread-safe.
+ */
+class UpnpCache {
+	using clock_type = std::chrono::steady_clock;
+
+	/**
+	 * How often is the "SystemUpdateID" of a server checked?
+	 */
+	static constexpr clock_type::duration UPDATE_CHECK_INTERVAL =
+		std::chrono::seconds(5);
+
+	/**
+	 * The maximum number of entries per server and per kind;
+	 * beyond that, expired entries are purged, and if that
+	 * doesn't help, everything.
+	 */
+	static constexpr std::size_t MAX_ENTRIES = 16384;
+
+	template<typename T>
+	struct Entry {
+		std::shared_ptr<const T> value;
+		clock_type::time_point expires;
+	};
+
+	template<typename T>
+	using EntryMap = std::map<std::string, Entry<T>, std::less<>>;
+
+	struct Server {
+		/**
+		 * The last known "SystemUpdateID"; empty if it was
+		 * not yet received.
+		 */
+		std::string update_id;
+
+		/**
+		 * When shall the "SystemUpdateID" be checked again?
+		 */
+		clock_type::time_point next_check;
+
+		EntryMap<UPnPDirObject> metadata;
+		EntryMap<UPnPDirContent> children;
+
+		void Flush() noexcept {
+			metadata.clear();
+			children.clear();
+		}
+	};
+
+	const clock_type::duration ttl;
+
+	mutable Mutex mutex;
+
+	/**
+	 * Key is ContentDirectoryService::GetURI().  Protected by
+	 * #mutex.
+	 */
+	std::map<std::string, Server, std::less<>> servers;
+
+public:
+	explicit UpnpCache(clock_type::duration _ttl) noexcept
+		:ttl(_ttl) {}
+
+	bool IsEnabled() const noexcept {
+		return ttl > clock_type::duration::zero();
+	}
+
+	/**
+	 * Shall the caller ask the server for its "SystemUpdateID"
+	 * now?  If this returns true, the next check is scheduled,
+	 * so concurrent callers will not send duplicate requests.
+	 */
+	bool CheckUpdateID(const std::string &server);
+
+	/**
+	 * Submit the "SystemUpdateID" received from the server.  If
+	 * it has changed, all cached entries of this server are
+	 * discarded.
+	 */
+	void SetUpdateID(const std::string &server,
+			 std::string &&update_id);
+
+	/**
+	 * @return the cached metadata or nullptr
+	 */
+	std::shared_ptr<const UPnPDirObject> GetMetadata(const std::string &server,
+							 const std::string &id) noexcept;
+
+	void PutMetadata(const std::string &server,
+			 std::shared_ptr<const UPnPDirObject> object);
+
+	/**
+	 * @return the cached children of the given container or
+	 * nullptr
+	 */
+	std::shared_ptr<const UPnPDirContent> GetChildren(const std::string &server,
+							  const std::string &id) noexcept;
+
+	/**
+	 * Store the children of the given container.  The metadata
+	 * of each child is cached as well.
+	 */
+	void PutChildren(const std::string &server, const std::string &id,
+			 std::shared_ptr<const UPnPDirContent> content);
+
+	void Clear() noexcept;
+};
+
+#endif
@@ -27,6 +27,11 @@
 #include "util/ScopeExit.hxx"
 #include "util/StringFormat.hxx"
 
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
 static void
 ReadResultTag(UPnPDirContent &dirbuf, IXML_Document *response)
 {
@@ -81,6 +86,24 @@ ContentDirectoryService::readDirSlice(UpnpClient_Handle hdl,
 	ReadResultTag(dirbuf, response);
 }
 
+/**
+ * The maximum number of "Browse" requests sent in parallel by
+ * ContentDirectoryService::readDir().
+ */
+static constexpr unsigned MAX_PARALLEL_BROWSE = 4;
+
+struct DirSlice {
+	unsigned offset, count;
+
+	UPnPDirContent content;
+	unsigned didread = 0;
+
+	std::exception_ptr error;
+
+	DirSlice(unsigned _offset, unsigned _count) noexcept
+		:offset(_offset), count(_count) {}
+};
+
 UPnPDirContent
 ContentDirectoryService::readDir(UpnpClient_Handle handle,
 				 const char *objectId) const
@@ -88,12 +111,78 @@ ContentDirectoryService::readDir(UpnpClient_Handle handle,
 	UPnPDirContent dirbuf;
 	unsigned offset = 0, total = -1, count;
 
-	do {
+	readDirSlice(handle, objectId, offset, m_rdreqcnt, dirbuf,
+		     count, total);
+	offset += count;
+
+	if (count > 0 && offset < total && total != unsigned(-1)) {
+		/* now that we know the total number of children and
+		   the slice size the server is willing to deliver,
+		   request the remaining slices in parallel */
+		std::vector<DirSlice> slices;
+		for (unsigned i = offset; i < total; i += count)
+			slices.emplace_back(i, std::min(count, total - i));
+
+		for (std::size_t begin = 0; begin < slices.size();
+		     begin += MAX_PARALLEL_BROWSE) {
+			const std::size_t end =
+				std::min(begin + MAX_PARALLEL_BROWSE,
+					 slices.size());
+
+			auto read_slice = [this, handle, objectId](DirSlice &slice){
+				try {
+					unsigned slice_total;
+					readDirSlice(handle, objectId,
+						     slice.offset, slice.count,
+						     slice.content,
+						     slice.didread,
+						     slice_total);
+				} catch (...) {
+					slice.error = std::current_exception();
+				}
+			};
+
+			std::vector<std::thread> threads;
+			for (std::size_t i = begin + 1; i < end; ++i) {
+				try {
+					threads.emplace_back(read_slice,
+							     std::ref(slices[i]));
+				} catch (...) {
+					/* no more threads: do it
+					   here */
+					read_slice(slices[i]);
+				}
+			}
+
+			read_slice(slices[begin]);
+
+			for (auto &t : threads)
+				t.join();
+		}
+
+		for (auto &slice : slices) {
+			if (slice.error)
+				std::rethrow_exception(slice.error);
+
+			if (slice.offset != offset)
+				/* a previous slice was short; the
+				   sequential loop below fills the
+				   gap */
+				break;
+
+			for (auto &o : slice.content.objects)
+				dirbuf.objects.emplace_back(std::move(o));
+
+			offset += slice.didread;
+		}
+	}
+
+	while (count > 0 && offset < total) {
 		readDirSlice(handle, objectId, offset, m_rdreqcnt, dirbuf,
 			     count, total);
 
 		offset += count;
-	} while (count > 0 && offset < total);
+	}
 
 	return dirbuf;
 }
@@ -19,6 +19,7 @@
 
 #include "UpnpDatabasePlugin.hxx"
 #include "Directory.hxx"
+#include "Cache.hxx"
 #include "Tags.hxx"
 #include "lib/upnp/ClientInit.hxx"
 #include "lib/upnp/Discovery.hxx"
@@ -28,18 +29,21 @@
 #include "db/Selection.hxx"
 #include "db/VHelper.hxx"
 #include "db/UniqueTags.hxx"
+#include "db/Helpers.hxx"
 #include "db/DatabaseError.hxx"
 #include "db/LightDirectory.hxx"
 #include "song/LightSong.hxx"
 #include "song/Filter.hxx"
 #include "song/TagSongFilter.hxx"
 #include "db/Stats.hxx"
+#include "config/Block.hxx"
 #include "tag/Table.hxx"
 #include "fs/Traits.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/RecursiveMap.hxx"
 #include "util/SplitString.hxx"
 
+#include <memory>
 #include <string>
 
 #include <assert.h>
@@ -61,10 +65,10 @@ class UpnpSong : UpnpSongData, public LightSong {
 	std::string real_uri2;
 
 public:
-	UpnpSong(UPnPDirObject &&object, std::string &&_uri) noexcept
-		:UpnpSongData(std::move(_uri), std::move(object.tag)),
+	UpnpSong(const UPnPDirObject &object, std::string &&_uri) noexcept
+		:UpnpSongData(std::move(_uri), object.tag),
 		 LightSong(UpnpSongData::uri.c_str(), UpnpSongData::tag),
-		 real_uri2(std::move(object.url)) {
+		 real_uri2(object.url) {
 		real_uri = real_uri2.c_str();
 	}
 };
@@ -74,15 +78,19 @@ class UpnpDatabase : public Database {
 	UpnpClient_Handle handle;
 	UPnPDeviceDirectory *discovery;
 
+	mutable UpnpCache cache;
+
 public:
-	explicit UpnpDatabase(EventLoop &_event_loop) noexcept
+	UpnpDatabase(EventLoop &_event_loop,
+		     std::chrono::steady_clock::duration cache_ttl) noexcept
 		:Database(upnp_db_plugin),
-		 event_loop(_event_loop) {}
+		 event_loop(_event_loop),
+		 cache(cache_ttl) {}
 
 	static DatabasePtr Create(EventLoop &main_event_loop,
 				  EventLoop &io_event_loop,
 				  DatabaseListener &listener,
-				  const ConfigBlock &block) noexcept;
+				  const ConfigBlock &block);
 
 	void Open() override;
 	void Close() noexcept override;
@@ -98,6 +106,7 @@ public:
 						    ConstBuffer<TagType> tag_types) const override;
 
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
+	DatabaseStats CountSongs(const DatabaseSelection &selection) const override;
 
 	std::chrono::system_clock::time_point GetUpdateStamp() const noexcept override {
 		return std::chrono::system_clock::time_point::min();
@@ -124,14 +133,26 @@ private:
 				   const char *objid,
 				   const DatabaseSelection &selection) const;
 
-	UPnPDirObject Namei(const ContentDirectoryService &server,
-			    std::forward_list<std::string> &&vpath) const;
+	/**
+	 * Ask the server for its "SystemUpdateID" (at most every few
+	 * seconds) and flush the cache if it has changed.
+	 */
+	void CheckUpdateID(const ContentDirectoryService &server) const;
+
+	std::shared_ptr<const UPnPDirObject> Namei(const ContentDirectoryService &server,
+						   std::forward_list<std::string> &&vpath) const;
 
 	/**
 	 * Take server and objid, return metadata.
 	 */
-	UPnPDirObject ReadNode(const ContentDirectoryService &server,
-			       const char *objid) const;
+	std::shared_ptr<const UPnPDirObject> ReadNode(const ContentDirectoryService &server,
+						      const char *objid) const;
+
+	/**
+	 * Take server and objid of a container, return its children.
+	 */
+	std::shared_ptr<const UPnPDirContent> ReadDir(const ContentDirectoryService &server,
+						      const char *objid) const;
 
 	/**
 	 * Get the path for an object Id. This works much like pwd,
@@ -145,9 +166,11 @@ private:
 DatabasePtr
 UpnpDatabase::Create(EventLoop &, EventLoop &io_event_loop,
 		     gcc_unused DatabaseListener &listener,
-		     const ConfigBlock &) noexcept
+		     const ConfigBlock &block)
 {
-	return std::make_unique<UpnpDatabase>(io_event_loop);
+	const std::chrono::seconds cache_ttl(block.GetBlockValue("cache_ttl",
+								 60U));
+	return std::make_unique<UpnpDatabase>(io_event_loop, cache_ttl);
 }
 
 void
@@ -168,6 +191,7 @@ UpnpDatabase::Open()
 void
 UpnpDatabase::Close() noexcept
 {
+	cache.Clear();
 	delete discovery;
 	UpnpClientGlobalFinish();
 }
@@ -198,7 +222,9 @@ UpnpDatabase::GetSong(const char *uri) const
 		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 				    "No such song");
 
-	UPnPDirObject dirent;
+	CheckUpdateID(server);
+
+	std::shared_ptr<const UPnPDirObject> dirent;
 	if (vpath.front() != rootid) {
 		dirent = Namei(server, std::move(vpath));
 	} else {
@@ -210,7 +236,7 @@ UpnpDatabase::GetSong(const char *uri) const
 		dirent = ReadNode(server, vpath.front().c_str());
 	}
 
-	return new UpnpSong(std::move(dirent), uri);
+	return new UpnpSong(*dirent, uri);
 }
 
 /**
@@ -372,31 +398,72 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 	}
 }
 
-UPnPDirObject
+void
+UpnpDatabase::CheckUpdateID(const ContentDirectoryService &server) const
+{
+	const std::string key = server.GetURI();
+	if (!cache.CheckUpdateID(key))
+		return;
+
+	std::string update_id;
+	try {
+		update_id = server.getSystemUpdateID(handle);
+	} catch (...) {
+		/* this action is mandatory, but if a server doesn't
+		   implement it, we rely on the TTL alone */
+		return;
+	}
+
+	cache.SetUpdateID(key, std::move(update_id));
+}
+
+std::shared_ptr<const UPnPDirObject>
 UpnpDatabase::ReadNode(const ContentDirectoryService &server,
 		       const char *objid) const
 {
+	const std::string key = server.GetURI();
+	auto object = cache.GetMetadata(key, objid);
+	if (object)
+		return object;
+
 	auto dirbuf = server.getMetadata(handle, objid);
 	if (dirbuf.objects.size() != 1)
 		throw std::runtime_error("Bad resource");
 
-	return std::move(dirbuf.objects.front());
+	object = std::make_shared<UPnPDirObject>(std::move(dirbuf.objects.front()));
+	cache.PutMetadata(key, object);
+	return object;
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpDatabase::ReadDir(const ContentDirectoryService &server,
+		      const char *objid) const
+{
+	const std::string key = server.GetURI();
+	auto content = cache.GetChildren(key, objid);
+	if (content)
+		return content;
+
+	content = std::make_shared<UPnPDirContent>(server.readDir(handle,
+								  objid));
+	cache.PutChildren(key, objid, content);
+	return content;
 }
 
 std::string
 UpnpDatabase::BuildPath(const ContentDirectoryService &server,
 			const UPnPDirObject& idirent) const
 {
-	const char *pid = idirent.id.c_str();
+	std::string pid = idirent.id;
 	std::string path;
-	while (strcmp(pid, rootid) != 0) {
-		auto dirent = ReadNode(server, pid);
-		pid = dirent.parent_id.c_str();
+	while (pid != rootid) {
+		auto dirent = ReadNode(server, pid.c_str());
+		pid = dirent->parent_id;
 
 		if (path.empty())
-			path = dirent.name;
+			path = dirent->name;
 		else
-			path = PathTraitsUTF8::Build(dirent.name.c_str(),
+			path = PathTraitsUTF8::Build(dirent->name.c_str(),
 						     path.c_str());
 	}
 
@@ -405,7 +472,7 @@ UpnpDatabase::BuildPath(const ContentDirectoryService &server,
 }
 
 // Take server and internal title pathname and return objid and metadata.
-UPnPDirObject
+std::shared_ptr<const UPnPDirObject>
 UpnpDatabase::Namei(const ContentDirectoryService &server,
 		    std::forward_list<std::string> &&vpath) const
 {
@@ -417,23 +484,24 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 
 	// Walk the path elements, read each directory and try to find the next one
 	while (true) {
-		auto dirbuf = server.readDir(handle, objid.c_str());
+		auto dirbuf = ReadDir(server, objid.c_str());
 
 		// Look for the name in the sub-container list
-		UPnPDirObject *child = dirbuf.FindObject(vpath.front().c_str());
+		const UPnPDirObject *child = dirbuf->FindObject(vpath.front().c_str());
 		if (child == nullptr)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "No such object");
 
 		vpath.pop_front();
 		if (vpath.empty())
-			return std::move(*child);
+			return std::shared_ptr<const UPnPDirObject>(std::move(dirbuf),
+								    child);
 
 		if (child->type != UPnPDirObject::Type::CONTAINER)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "Not a container");
 
-		objid = std::move(child->id);
+		objid = child->id;
 	}
 }
 
@@ -509,6 +577,8 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* !Note: this *can't* be handled by Namei further down,
 	   because the path is not valid for traversal. Besides, it's
 	   just faster to access the target node directly */
+	CheckUpdateID(server);
+
 	if (!vpath.empty() && vpath.front() == rootid) {
 		vpath.pop_front();
 		if (vpath.empty())
@@ -523,14 +593,14 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 		if (visit_song) {
 			auto dirent = ReadNode(server, objid.c_str());
 
-			if (dirent.type != UPnPDirObject::Type::ITEM ||
-			    dirent.item_class != UPnPDirObject::ItemClass::MUSIC)
+			if (dirent->type != UPnPDirObject::Type::ITEM ||
+			    dirent->item_class != UPnPDirObject::ItemClass::MUSIC)
 				throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 						    "Not found");
 
 			std::string path = songPath(server.getFriendlyName(),
-						    dirent.id);
-			visitSong(std::move(dirent), path.c_str(),
+						    dirent->id);
+			visitSong(*dirent, path.c_str(),
 				  selection, visit_song);
 		}
 
@@ -545,7 +615,7 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	   recursion (1-deep) here, which will handle the "add dir"
 	   case. */
 	if (selection.recursive && selection.filter) {
-		SearchSongs(server, tdirent.id.c_str(), selection, visit_song);
+		SearchSongs(server, tdirent->id.c_str(), selection, visit_song);
 		return;
 	}
 
@@ -553,8 +623,8 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 		? server.getFriendlyName()
 		: selection.uri.c_str();
 
-	if (tdirent.type == UPnPDirObject::Type::ITEM) {
-		VisitItem(tdirent, base_uri,
+	if (tdirent->type == UPnPDirObject::Type::ITEM) {
+		VisitItem(*tdirent, base_uri,
 			  selection,
 			  visit_song, visit_playlist);
 		return;
@@ -563,7 +633,8 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* Target was a a container. Visit it. We could read slices
 	   and loop here, but it's not useful as mpd will only return
 	   data to the client when we're done anyway. */
-	for (const auto &dirent : server.readDir(handle, tdirent.id.c_str()).objects) {
+	const auto children = ReadDir(server, tdirent->id.c_str());
+	for (const auto &dirent : children->objects) {
 		const std::string uri = PathTraitsUTF8::Build(base_uri,
 							      dirent.name.c_str());
 		VisitObject(dirent, uri.c_str(),
@@ -637,8 +708,14 @@ UpnpDatabase::GetStats(const DatabaseSelection &) const
 	return stats;
 }
 
+DatabaseStats
+UpnpDatabase::CountSongs(const DatabaseSelection &selection) const
+{
+	return ::CountSongs(*this, selection);
+}
+
 const DatabasePlugin upnp_db_plugin = {
 	"upnp",
-	0,
+	DatabasePlugin::FLAG_CONCURRENT_READS,
 	UpnpDatabase::Create,
 };
@@ -87,11 +87,15 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 					      directory.GetPath(), name);
 			}
 		} else {
-			if (!song->UpdateFileInArchive(archive)) {
+			Tag tag;
+			if (!song->ScanFileInArchive(archive, tag)) {
 				FormatDebug(update_domain,
 					    "deleting unrecognized file %s/%s",
 					    directory.GetPath(), name);
 				editor.LockDeleteSong(directory, song);
+			} else {
+				const ScopeDatabaseLock protect;
+				directory.ReplaceSongTag(*song, std::move(tag));
 			}
 		}
 	}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ChildPath.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "storage/StorageInterface.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/Charset.hxx"
+
+Path
+ChildPathBuilder::Map(const Directory &directory,
+		      const char *name_utf8) noexcept
+{
+	const char *uri = directory.GetPath();
+	if (!prepared || directory_uri != uri) {
+		directory_uri = uri;
+		prepared = true;
+
+		const auto directory_fs = storage.MapFS(uri);
+		is_local = !directory_fs.IsNull();
+		if (is_local) {
+			buffer = directory_fs.c_str();
+			buffer.push_back(PathTraitsFS::SEPARATOR);
+			directory_length = buffer.length();
+		}
+	}
+
+	if (!is_local)
+		return nullptr;
+
+	buffer.resize(directory_length);
+
+#ifndef _WIN32
+	if (IsFSCharsetUTF8())
+		buffer.append(name_utf8);
+	else
+#endif
+	{
+		const auto name_fs = AllocatedPath::FromUTF8(name_utf8);
+		if (name_fs.IsNull())
+			return nullptr;
+
+		buffer.append(name_fs.c_str());
+	}
+
+	return Path::FromFS(buffer.c_str());
+}
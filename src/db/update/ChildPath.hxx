@@ -0,0 +1,84 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_CHILD_PATH_HXX
+#define MPD_UPDATE_CHILD_PATH_HXX
+
+#include "fs/Path.hxx"
+#include "fs/Traits.hxx"
+
+#include <string>
+
+struct Directory;
+class Storage;
+
+/**
+ * Builds the local file system paths of directory children in a
+ * reusable buffer.  The update walk looks at all children of one
+ * directory in a row; this class maps the directory only once and
+ * then only appends the child name, which needs no allocation once
+ * the buffer has grown large enough.
+ */
+class ChildPathBuilder {
+	Storage &storage;
+
+	/**
+	 * The URI of the directory #buffer was prepared for.
+	 */
+	std::string directory_uri;
+
+	/**
+	 * The mapped directory path followed by a separator, and
+	 * (after Map()) the child name.
+	 */
+	PathTraitsFS::string buffer;
+
+	/**
+	 * The length of the directory prefix in #buffer.
+	 */
+	size_t directory_length;
+
+	/**
+	 * Is #directory_uri valid?
+	 */
+	bool prepared = false;
+
+	/**
+	 * Does #directory_uri map to a local directory?
+	 */
+	bool is_local;
+
+public:
+	explicit ChildPathBuilder(Storage &_storage) noexcept
+		:storage(_storage) {}
+
+	ChildPathBuilder(const ChildPathBuilder &) = delete;
+	ChildPathBuilder &operator=(const ChildPathBuilder &) = delete;
+
+	/**
+	 * Map the given child to a local file path, like
+	 * Storage::MapChildFS().
+	 *
+	 * @return the path (valid until the next call) or nullptr if
+	 * this is not a local file or the name cannot be converted
+	 */
+	Path Map(const Directory &directory, const char *name_utf8) noexcept;
+};
+
+#endif
@@ -31,7 +31,17 @@ UpdateConfig::UpdateConfig(const ConfigData &config)
 	follow_outside_symlinks =
 		config.GetBool(ConfigOption::FOLLOW_OUTSIDE_SYMLINKS,
 			       DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
-#else
-	(void)config;
 #endif
+
+	scan_threads = config.GetPositive(ConfigOption::UPDATE_SCAN_THREADS,
+					  DEFAULT_SCAN_THREADS);
+
+	loudness_analysis =
+		config.GetBool(ConfigOption::UPDATE_LOUDNESS_ANALYSIS, false);
+
+	skip_unchanged_directories =
+		config.GetBool(ConfigOption::UPDATE_SKIP_UNCHANGED_DIRECTORIES,
+			       false);
+
+	container_cache_path = config.GetPath(ConfigOption::CONTAINER_CACHE);
 }
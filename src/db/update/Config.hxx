@@ -20,6 +20,8 @@
 #ifndef MPD_UPDATE_CONFIG_HXX
 #define MPD_UPDATE_CONFIG_HXX
 
+#include "fs/AllocatedPath.hxx"
+
 struct ConfigData;
 
 struct UpdateConfig {
@@ -31,6 +33,34 @@ struct UpdateConfig {
 	bool follow_outside_symlinks = DEFAULT_FOLLOW_OUTSIDE_SYMLINKS;
 #endif
 
+	static constexpr unsigned DEFAULT_SCAN_THREADS = 1;
+
+	/**
+	 * The number of threads which scan song files concurrently.
+	 * With 1, the files are scanned by the update thread.
+	 */
+	unsigned scan_threads = DEFAULT_SCAN_THREADS;
+
+	/**
+	 * Decode new and modified song files and store their EBU
+	 * R128 loudness as ReplayGain values in the database
+	 * ("update_loudness_analysis")?
+	 */
+	bool loudness_analysis = false;
+
+	/**
+	 * Don't read directories whose modification time has not
+	 * changed since the last update; only their subdirectories
+	 * are visited ("update_skip_unchanged_directories").
+	 */
+	bool skip_unchanged_directories = false;
+
+	/**
+	 * The path of the #ContainerCache file; nullptr if the cache
+	 * is disabled.
+	 */
+	AllocatedPath container_cache_path = nullptr;
+
 	explicit UpdateConfig(const ConfigData &config);
 };
 
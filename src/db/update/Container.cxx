@@ -18,6 +18,7 @@
  */
 
 #include "Walk.hxx"
+#include "ContainerCache.hxx"
 #include "UpdateDomain.hxx"
 #include "song/DetachedSong.hxx"
 #include "db/DatabaseLock.hxx"
@@ -35,13 +36,23 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 				const char *name, const char *suffix,
 				const StorageFileInfo &info) noexcept
 {
-	const DecoderPlugin *_plugin = decoder_plugins_find([suffix](const DecoderPlugin &plugin){
-			return plugin.SupportsContainerSuffix(suffix);
+	const DecoderPlugin *_plugin = decoder_plugins_find_suffix(suffix,
+								   [](const DecoderPlugin &plugin){
+			return plugin.container_scan != nullptr;
 		});
 	if (_plugin == nullptr)
 		return false;
 	const DecoderPlugin &plugin = *_plugin;
 
+	/* look up the cache even if the file is not modified, to
+	   mark the entry as used */
+	ContainerCache::Key cache_key;
+	const bool use_cache = container_cache != nullptr &&
+		ContainerCache::MakeKey(info, cache_key);
+	const auto *cached = use_cache
+		? container_cache->Find(storage_uri, cache_key)
+		: nullptr;
+
 	Directory *contdir;
 	{
 		const ScopeDatabaseLock protect;
@@ -61,6 +72,33 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		return false;
 	}
 
+	auto add = [this, contdir, &info](DetachedSong &&vtrack){
+		auto song = Song::New(std::move(vtrack), *contdir);
+
+		// shouldn't be necessary but it's there..
+		song->mtime = info.mtime;
+
+		FormatDefault(update_domain, "added %s/%s",
+			      contdir->GetPath(),
+			      song->GetFilename());
+
+		{
+			const ScopeDatabaseLock protect;
+			contdir->AddSong(std::move(song));
+		}
+
+		modified = true;
+	};
+
+	if (cached != nullptr && !walk_discard) {
+		/* the same file was scanned before; skip the
+		   decoder plugin */
+		for (const auto &item : *cached)
+			add(DetachedSong(item.song));
+
+		return true;
+	}
+
 	try {
 		auto v = plugin.container_scan(pathname);
 		if (v.empty()) {
@@ -68,24 +106,19 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 			return false;
 		}
 
-		for (auto &vtrack : v) {
-			auto song = std::make_unique<Song>(std::move(vtrack),
-							   *contdir);
-
-			// shouldn't be necessary but it's there..
-			song->mtime = info.mtime;
+		ContainerCache::ItemList items;
 
-			FormatDefault(update_domain, "added %s/%s",
-				      contdir->GetPath(),
-				      song->filename.c_str());
-
-			{
-				const ScopeDatabaseLock protect;
-				contdir->AddSong(std::move(song));
-			}
+		for (auto &vtrack : v) {
+			if (use_cache)
+				items.emplace_back(DetachedSong(vtrack),
+						   std::string());
 
-			modified = true;
+			add(std::move(vtrack));
 		}
+
+		if (use_cache)
+			container_cache->Put(storage_uri, cache_key,
+					     std::move(items));
 	} catch (...) {
 		LogError(std::current_exception());
 		editor.LockDeleteDirectory(contdir);
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ContainerCache.hxx"
+#include "UpdateDomain.hxx"
+#include "SongSave.hxx"
+#include "storage/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "system/Error.hxx"
+#include "util/StringCompare.hxx"
+#include "util/NumberParser.hxx"
+#include "util/RuntimeError.hxx"
+#include "Log.hxx"
+
+#define CACHE_VERSION "container_cache: 1"
+#define CACHE_STORAGE "storage: "
+#define CACHE_FILE "file: "
+#define CACHE_FILE_END "file_end"
+
+bool
+ContainerCache::MakeKey(const StorageFileInfo &info, Key &key) noexcept
+{
+	if (info.inode == 0)
+		/* no file identity */
+		return false;
+
+	key.device = info.device;
+	key.inode = info.inode;
+	key.size = info.size;
+	key.mtime = std::chrono::system_clock::to_time_t(info.mtime);
+	return true;
+}
+
+static void
+ParseKey(const char *p, ContainerCache::Key &key)
+{
+	char *endptr;
+	key.device = ParseUint64(p, &endptr);
+	key.inode = ParseUint64(endptr, &endptr);
+	key.size = ParseUint64(endptr, &endptr);
+	key.mtime = ParseInt64(endptr, &endptr);
+	if (*endptr != 0)
+		throw std::runtime_error("Malformed container cache file");
+}
+
+inline void
+ContainerCache::Load()
+{
+	TextFile file(path);
+
+	const char *line = file.ReadLine();
+	if (line == nullptr || !StringIsEqual(line, CACHE_VERSION)) {
+		LogDebug(update_domain,
+			 "Ignoring incompatible container cache file");
+		return;
+	}
+
+	EntryMap *entries = nullptr;
+
+	char *s;
+	while ((s = file.ReadLine()) != nullptr) {
+		const char *p;
+		if ((p = StringAfterPrefix(s, CACHE_STORAGE)) != nullptr) {
+			entries = &storages[p];
+		} else if ((p = StringAfterPrefix(s, CACHE_FILE)) != nullptr &&
+			   entries != nullptr) {
+			Key key;
+			ParseKey(p, key);
+
+			ItemList items;
+
+			while ((s = file.ReadLine()) != nullptr &&
+			       !StringIsEqual(s, CACHE_FILE_END)) {
+				p = StringAfterPrefix(s, SONG_BEGIN);
+				if (p == nullptr)
+					throw FormatRuntimeError("Malformed container cache line: %s",
+								 s);
+
+				/* copy the name, because song_load()
+				   overwrites the line buffer */
+				const std::string name(p);
+				std::string target;
+				auto song = song_load(file, name.c_str(),
+						      &target);
+				items.emplace_back(std::move(song),
+						   std::move(target));
+			}
+
+			entries->emplace(key, Entry(std::move(items)));
+		} else
+			throw FormatRuntimeError("Malformed container cache line: %s",
+						 s);
+	}
+
+	/* the "used" flags of loaded entries are cleared; only
+	   entries seen by the next full update survive its
+	   Prune() */
+	for (auto &i : storages)
+		for (auto &j : i.second)
+			j.second.used = false;
+}
+
+void
+ContainerCache::LoadOnce() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (loaded)
+		return;
+
+	loaded = true;
+
+	try {
+		Load();
+	} catch (const std::system_error &e) {
+		if (!IsFileNotFound(e))
+			LogError(e, "Failed to load the container cache");
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to load the container cache");
+		storages.clear();
+	}
+}
+
+inline void
+ContainerCache::Save()
+{
+	FileOutputStream fos(path);
+	BufferedOutputStream os(fos);
+
+	os.Write(CACHE_VERSION "\n");
+
+	for (const auto &i : storages) {
+		if (i.second.empty())
+			continue;
+
+		os.Format(CACHE_STORAGE "%s\n", i.first.c_str());
+
+		for (const auto &j : i.second) {
+			const auto &key = j.first;
+			os.Format(CACHE_FILE "%llu %llu %llu %lli\n",
+				  (unsigned long long)key.device,
+				  (unsigned long long)key.inode,
+				  (unsigned long long)key.size,
+				  (long long)key.mtime);
+
+			for (const auto &item : j.second.items)
+				song_save(os, item.song,
+					  item.target.c_str());
+
+			os.Write(CACHE_FILE_END "\n");
+		}
+	}
+
+	os.Flush();
+	fos.Commit();
+}
+
+void
+ContainerCache::SaveIfModified() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (!modified)
+		return;
+
+	try {
+		Save();
+		modified = false;
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to save the container cache");
+	}
+}
+
+const ContainerCache::ItemList *
+ContainerCache::Find(const std::string &storage_uri, const Key &key) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = storages.find(storage_uri);
+	if (i == storages.end())
+		return nullptr;
+
+	auto j = i->second.find(key);
+	if (j == i->second.end())
+		return nullptr;
+
+	j->second.used = true;
+	return &j->second.items;
+}
+
+void
+ContainerCache::Put(const std::string &storage_uri, const Key &key,
+		    ItemList &&items) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto &entries = storages[storage_uri];
+	auto i = entries.find(key);
+	if (i != entries.end()) {
+		i->second.items = std::move(items);
+		i->second.used = true;
+	} else
+		entries.emplace(key, Entry(std::move(items)));
+
+	modified = true;
+}
+
+void
+ContainerCache::Prune(const std::string &storage_uri) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = storages.find(storage_uri);
+	if (i == storages.end())
+		return;
+
+	auto &entries = i->second;
+	for (auto j = entries.begin(); j != entries.end();) {
+		if (j->second.used) {
+			j->second.used = false;
+			++j;
+		} else {
+			j = entries.erase(j);
+			modified = true;
+		}
+	}
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_CONTAINER_CACHE_HXX
+#define MPD_UPDATE_CONTAINER_CACHE_HXX
+
+#include "song/DetachedSong.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Compiler.h"
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <stdint.h>
+
+struct StorageFileInfo;
+
+/**
+ * A persistent cache of the virtual songs which were obtained from
+ * container files (DecoderPlugin::container_scan()) and from
+ * playlists which are integrated into the database as a directory.
+ * The files are identified by device, inode, size and modification
+ * time, so the (potentially expensive) scan can be skipped after the
+ * database has been rebuilt or a file has been renamed.
+ *
+ * This class is thread-safe, because updates of different storages
+ * may run concurrently.  The #ItemList returned by Find() remains
+ * valid until the same storage's entry is modified, which only the
+ * walk of that storage does.
+ */
+class ContainerCache {
+public:
+	struct Key {
+		uint64_t device, inode, size;
+		int64_t mtime;
+
+		gcc_pure
+		bool operator<(const Key &other) const noexcept {
+			return std::tie(device, inode, size, mtime) <
+				std::tie(other.device, other.inode,
+					 other.size, other.mtime);
+		}
+	};
+
+	struct Item {
+		/**
+		 * The file name of the virtual song within the
+		 * virtual directory is DetachedSong::GetURI().
+		 */
+		DetachedSong song;
+
+		/**
+		 * See Song::GetTarget().
+		 */
+		std::string target;
+
+		Item(DetachedSong &&_song, std::string &&_target) noexcept
+			:song(std::move(_song)), target(std::move(_target)) {}
+	};
+
+	using ItemList = std::vector<Item>;
+
+private:
+	struct Entry {
+		ItemList items;
+
+		/**
+		 * Was this entry looked up since the last Prune()
+		 * call?
+		 */
+		bool used = true;
+
+		explicit Entry(ItemList &&_items) noexcept
+			:items(std::move(_items)) {}
+	};
+
+	using EntryMap = std::map<Key, Entry>;
+
+	const AllocatedPath path;
+
+	/**
+	 * Protects all other fields.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The entries of each storage (by its base URI).
+	 */
+	std::map<std::string, EntryMap> storages;
+
+	bool loaded = false, modified = false;
+
+public:
+	explicit ContainerCache(AllocatedPath &&_path) noexcept
+		:path(std::move(_path)) {}
+
+	/**
+	 * Create a #Key for the given file.
+	 *
+	 * @return false if the file cannot be identified (e.g. if the
+	 * storage does not provide inode numbers)
+	 */
+	static bool MakeKey(const StorageFileInfo &info, Key &key) noexcept;
+
+	/**
+	 * Load the cache file unless that was already done.  Errors
+	 * are logged.
+	 */
+	void LoadOnce() noexcept;
+
+	/**
+	 * Save the cache file if it was modified.  Errors are logged.
+	 */
+	void SaveIfModified() noexcept;
+
+	/**
+	 * Look up a file and mark the entry as used.
+	 *
+	 * @return the cached items or nullptr if there is no entry
+	 */
+	const ItemList *Find(const std::string &storage_uri,
+			     const Key &key) noexcept;
+
+	void Put(const std::string &storage_uri, const Key &key,
+		 ItemList &&items) noexcept;
+
+	/**
+	 * Remove all entries of the storage which were not used
+	 * since the last call.  This is called after a whole storage
+	 * has been visited.
+	 */
+	void Prune(const std::string &storage_uri) noexcept;
+
+private:
+	void Load();
+	void Save();
+};
+
+#endif
@@ -29,16 +29,79 @@
 #include "util/StringStrip.hxx"
 #include "config.h"
 
+#include <algorithm>
+
 #include <assert.h>
+#include <string.h>
 
 #ifdef HAVE_CLASS_GLOB
 
+#ifdef HAVE_FNMATCH
+
+gcc_pure
+static bool
+HasWildcards(const char *p) noexcept
+{
+	return strpbrk(p, "*?[\\") != nullptr;
+}
+
+#endif
+
 inline void
 ExcludeList::ParseLine(char *line) noexcept
 {
 	char *p = Strip(line);
-	if (*p != 0 && *p != '#')
-		patterns.emplace_front(p);
+	if (*p == 0 || *p == '#')
+		return;
+
+	++n_patterns;
+
+#ifdef HAVE_FNMATCH
+	/* simple patterns are matched with a hash lookup instead of
+	   fnmatch(); this is not done on Windows, because
+	   PathMatchSpecA() is case-insensitive */
+
+	if (!HasWildcards(p)) {
+		literals.emplace(p);
+		return;
+	}
+
+	if (*p == '*' && !HasWildcards(p + 1)) {
+		const size_t length = strlen(p + 1);
+		if (suffixes.emplace(p + 1).second) {
+			auto i = std::lower_bound(suffix_lengths.begin(),
+						  suffix_lengths.end(),
+						  length);
+			if (i == suffix_lengths.end() || *i != length)
+				suffix_lengths.insert(i, length);
+		}
+
+		return;
+	}
+#endif
+
+	patterns.emplace_front(p);
+}
+
+inline bool
+ExcludeList::CheckPatterns(const char *name, size_t length) const noexcept
+{
+	if (!literals.empty() && literals.find(name) != literals.end())
+		return true;
+
+	for (const size_t i : suffix_lengths) {
+		if (i > length)
+			break;
+
+		if (suffixes.find(std::string(name + length - i, i)) != suffixes.end())
+			return true;
+	}
+
+	for (const auto &i : patterns)
+		if (i.Check(name))
+			return true;
+
+	return false;
 }
 
 #endif
@@ -68,18 +131,18 @@ ExcludeList::Check(Path name_fs) const noexcept
 	/* XXX include full path name in check */
 
 #ifdef HAVE_CLASS_GLOB
-	if (parent != nullptr) {
-		if (parent->Check(name_fs)) {
-			return true;
-		}
-	}
+	try {
+		const NarrowPath narrow(name_fs);
+		const char *name = narrow.c_str();
+		const size_t length = strlen(name);
 
-	for (const auto &i : patterns) {
-		try {
-			if (i.Check(NarrowPath(name_fs).c_str()))
+		for (const ExcludeList *i = this; i != nullptr; i = i->parent) {
+			if (i->CheckPatterns(name, length)) {
+				++i->n_excluded;
 				return true;
-		} catch (...) {
+			}
 		}
+	} catch (...) {
 	}
 #else
 	/* not implemented */
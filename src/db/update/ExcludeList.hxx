@@ -32,15 +32,54 @@
 
 #ifdef HAVE_CLASS_GLOB
 #include <forward_list>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <stddef.h>
 #endif
 
 class Path;
 
 class ExcludeList {
+	/**
+	 * The nearest ancestor which has patterns; lists without
+	 * patterns are skipped, so a deep directory tree without
+	 * .mpdignore files does not make Check() slower.
+	 */
 	const ExcludeList *const parent;
 
 #ifdef HAVE_CLASS_GLOB
+	/**
+	 * Patterns without wildcards.
+	 */
+	std::unordered_set<std::string> literals;
+
+	/**
+	 * Patterns of the form "*SUFFIX" (without the asterisk),
+	 * where the suffix has no wildcards.
+	 */
+	std::unordered_set<std::string> suffixes;
+
+	/**
+	 * The distinct lengths of all #suffixes, sorted.
+	 */
+	std::vector<size_t> suffix_lengths;
+
+	/**
+	 * All other patterns; they are passed to fnmatch().
+	 */
 	std::forward_list<Glob> patterns;
+
+	unsigned n_patterns = 0;
+
+	/**
+	 * The number of names which were excluded by this list's
+	 * patterns.  This is only statistics for the update log,
+	 * therefore it may be modified by the "const" method
+	 * Check().
+	 */
+	mutable unsigned n_excluded = 0;
 #endif
 
 public:
@@ -48,15 +87,48 @@ public:
 		:parent(nullptr) {}
 
 	ExcludeList(const ExcludeList &_parent) noexcept
-		:parent(&_parent) {}
+		:parent(_parent.HasPatterns() ? &_parent : _parent.parent) {}
 
 	gcc_pure
 	bool IsEmpty() const noexcept {
+		return parent == nullptr && !HasPatterns();
+	}
+
+	/**
+	 * Does this object have patterns (not counting the
+	 * parent's)?
+	 */
+	gcc_pure
+	bool HasPatterns() const noexcept {
 #ifdef HAVE_CLASS_GLOB
-		return ((parent == nullptr) || parent->IsEmpty()) && patterns.empty();
+		return n_patterns > 0;
 #else
 		/* not implemented */
-		return true;
+		return false;
+#endif
+	}
+
+	/**
+	 * Returns the number of patterns in this object (not
+	 * counting the parent's).
+	 */
+	unsigned GetPatternCount() const noexcept {
+#ifdef HAVE_CLASS_GLOB
+		return n_patterns;
+#else
+		return 0;
+#endif
+	}
+
+	/**
+	 * Returns the number of names which were excluded by this
+	 * object's patterns so far.
+	 */
+	unsigned GetExcludedCount() const noexcept {
+#ifdef HAVE_CLASS_GLOB
+		return n_excluded;
+#else
+		return 0;
 #endif
 	}
 
@@ -75,6 +147,11 @@ public:
 
 private:
 	void ParseLine(char *line) noexcept;
+
+#ifdef HAVE_CLASS_GLOB
+	gcc_pure
+	bool CheckPatterns(const char *name, size_t length) const noexcept;
+#endif
 };
 
 
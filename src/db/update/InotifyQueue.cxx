@@ -22,31 +22,75 @@
 #include "Service.hxx"
 #include "Log.hxx"
 #include "protocol/Ack.hxx" // for class ProtocolError
+#include "event/Loop.hxx"
+#include "fs/Traits.hxx"
 #include "util/StringCompare.hxx"
 
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
 /**
- * Wait this long after the last change before calling
+ * Wait at least this long after the last change before calling
  * UpdateService::Enqueue().  This increases the probability that
  * updates can be bundled.
  */
 static constexpr std::chrono::steady_clock::duration INOTIFY_UPDATE_DELAY =
+	std::chrono::seconds(1);
+
+/**
+ * Each event of a burst (e.g. while copying lots of files) extends
+ * the delay after the last change by this duration ...
+ */
+static constexpr std::chrono::steady_clock::duration INOTIFY_BURST_STEP =
+	std::chrono::milliseconds(100);
+
+/**
+ * ... up to this limit.
+ */
+static constexpr std::chrono::steady_clock::duration INOTIFY_MAX_QUIET =
+	std::chrono::seconds(10);
+
+/**
+ * Never postpone an update longer than this after the first change,
+ * even if the changes keep coming.
+ */
+static constexpr std::chrono::steady_clock::duration INOTIFY_MAX_DELAY =
+	std::chrono::seconds(60);
+
+/**
+ * Retry after this duration if the update queue is full.
+ */
+static constexpr std::chrono::steady_clock::duration INOTIFY_RETRY_DELAY =
 	std::chrono::seconds(5);
 
+/**
+ * If more entries of one directory have changed, update the whole
+ * directory instead.
+ */
+static constexpr std::size_t INOTIFY_MAX_NAMES = 64;
+
 void
 InotifyQueue::OnDelay() noexcept
 {
 	unsigned id;
 
+	burst_events = 0;
+
 	while (!queue.empty()) {
-		const char *uri_utf8 = queue.front().c_str();
+		const auto &item = queue.front();
+		const char *uri_utf8 = item.uri.c_str();
 
 		try {
 			try {
-				id = update.Enqueue(uri_utf8, false);
+				id = update.Enqueue(uri_utf8,
+						    std::set<std::string>(item.names),
+						    false);
 			} catch (const ProtocolError &e) {
 				if (e.GetCode() == ACK_ERROR_UPDATE_ALREADY) {
 					/* retry later */
-					delay_event.Schedule(INOTIFY_UPDATE_DELAY);
+					delay_event.Schedule(INOTIFY_RETRY_DELAY);
 					return;
 				}
 
@@ -59,38 +103,79 @@ InotifyQueue::OnDelay() noexcept
 			continue;
 		}
 
-		FormatDebug(inotify_domain, "updating '%s' job=%u",
-			    uri_utf8, id);
+		if (item.names.empty())
+			FormatDebug(inotify_domain, "updating '%s' job=%u",
+				    uri_utf8, id);
+		else
+			FormatDebug(inotify_domain,
+				    "updating %zu entries in '%s' job=%u",
+				    item.names.size(), uri_utf8, id);
 
 		queue.pop_front();
 	}
 }
 
+/**
+ * If the path is inside the given directory, return the part of
+ * the path below the directory (an empty string for the directory
+ * itself).
+ *
+ * @return nullptr if the path is not inside the directory
+ */
 gcc_pure
-static bool
-path_in(const char *path, const char *possible_parent) noexcept
+static const char *
+path_rest(const char *path, const char *parent) noexcept
 {
-	if (StringIsEmpty(path))
-		return true;
+	if (StringIsEmpty(parent))
+		return path;
+
+	auto rest = StringAfterPrefix(path, parent);
+	if (rest == nullptr)
+		return nullptr;
+
+	if (StringIsEmpty(rest))
+		return rest;
 
-	auto rest = StringAfterPrefix(path, possible_parent);
-	return rest != nullptr &&
-		(StringIsEmpty(rest) || rest[0] == '/');
+	return rest[0] == '/'
+		? rest + 1
+		: nullptr;
 }
 
-void
-InotifyQueue::Enqueue(const char *uri_utf8) noexcept
+bool
+InotifyQueue::IsQueued(const char *uri_utf8, const char *name) const noexcept
 {
-	delay_event.Schedule(INOTIFY_UPDATE_DELAY);
+	for (const auto &item : queue) {
+		const char *rest = path_rest(uri_utf8, item.uri.c_str());
+		if (rest == nullptr)
+			continue;
 
-	for (auto i = queue.begin(), end = queue.end(); i != end;) {
-		const char *current_uri = i->c_str();
+		if (item.names.empty())
+			/* the whole directory is enqueued */
+			return true;
 
-		if (path_in(uri_utf8, current_uri))
-			/* already enqueued */
-			return;
+		if (StringIsEmpty(rest)) {
+			/* the same directory */
+			if (name != nullptr && item.names.count(name) > 0)
+				return true;
+		} else {
+			/* inside a sub directory: is it enqueued? */
+			const char *slash = strchr(rest, '/');
+			const std::string child = slash != nullptr
+				? std::string(rest, slash)
+				: std::string(rest);
+			if (item.names.count(child) > 0)
+				return true;
+		}
+	}
+
+	return false;
+}
 
-		if (path_in(current_uri, uri_utf8))
+void
+InotifyQueue::EraseBelow(const char *uri_utf8) noexcept
+{
+	for (auto i = queue.begin(), end = queue.end(); i != end;) {
+		if (path_rest(i->uri.c_str(), uri_utf8) != nullptr)
 			/* existing path is a sub-path of the new
 			   path; we can dequeue the existing path and
 			   update the new path instead */
@@ -98,6 +183,76 @@ InotifyQueue::Enqueue(const char *uri_utf8) noexcept
 		else
 			++i;
 	}
+}
+
+void
+InotifyQueue::ScheduleDelay() noexcept
+{
+	/* the delay grows with the number of events, so a burst of
+	   changes (e.g. copying lots of files) gets bundled into few
+	   updates, but a single change is picked up quickly */
+
+	const auto now = delay_event.GetEventLoop().GetTime();
+	if (burst_events == 0)
+		burst_start = now;
+
+	++burst_events;
+
+	auto delay = std::min<std::chrono::steady_clock::duration>(INOTIFY_UPDATE_DELAY +
+								   burst_events * INOTIFY_BURST_STEP,
+								   INOTIFY_MAX_QUIET);
+
+	const auto deadline = burst_start + INOTIFY_MAX_DELAY;
+	if (now + delay > deadline)
+		delay = deadline > now
+			? deadline - now
+			: std::chrono::steady_clock::duration::zero();
+
+	delay_event.Schedule(delay);
+}
+
+void
+InotifyQueue::Enqueue(const char *uri_utf8) noexcept
+{
+	ScheduleDelay();
+
+	if (IsQueued(uri_utf8, nullptr))
+		/* already enqueued */
+		return;
 
+	EraseBelow(uri_utf8);
 	queue.emplace_back(uri_utf8);
 }
+
+void
+InotifyQueue::Enqueue(const char *uri_utf8, const char *name) noexcept
+{
+	ScheduleDelay();
+
+	if (IsQueued(uri_utf8, name))
+		/* already enqueued */
+		return;
+
+	/* updating the entry covers everything inside it */
+	EraseBelow(PathTraitsUTF8::Build(uri_utf8, name).c_str());
+
+	for (auto i = queue.begin(), end = queue.end(); i != end; ++i) {
+		if (i->uri != uri_utf8)
+			continue;
+
+		assert(!i->names.empty());
+
+		i->names.emplace(name);
+		if (i->names.size() > INOTIFY_MAX_NAMES) {
+			/* too many changes in this directory: update
+			   all of it */
+			queue.erase(i);
+			EraseBelow(uri_utf8);
+			queue.emplace_back(uri_utf8);
+		}
+
+		return;
+	}
+
+	queue.emplace_back(uri_utf8).names.emplace(name);
+}
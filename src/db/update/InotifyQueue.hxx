@@ -20,9 +20,12 @@
 #ifndef MPD_INOTIFY_QUEUE_HXX
 #define MPD_INOTIFY_QUEUE_HXX
 
-#include "event/TimerEvent.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "util/Compiler.h"
 
+#include <chrono>
 #include <list>
+#include <set>
 #include <string>
 
 class UpdateService;
@@ -30,18 +33,66 @@ class UpdateService;
 class InotifyQueue final {
 	UpdateService &update;
 
-	std::list<std::string> queue;
+	struct Item {
+		/**
+		 * The URI of the directory to be updated.
+		 */
+		std::string uri;
 
-	TimerEvent delay_event;
+		/**
+		 * The names of the entries of the directory which
+		 * have changed.  If empty, the whole directory is
+		 * updated.
+		 */
+		std::set<std::string> names;
+
+		explicit Item(const char *_uri) noexcept:uri(_uri) {}
+	};
+
+	std::list<Item> queue;
+
+	CoarseTimerEvent delay_event;
+
+	/**
+	 * The time of the first event since the queue was last
+	 * flushed.
+	 */
+	std::chrono::steady_clock::time_point burst_start;
+
+	/**
+	 * The number of events since the queue was last flushed.
+	 */
+	unsigned burst_events = 0;
 
 public:
 	InotifyQueue(EventLoop &_loop, UpdateService &_update) noexcept
 		:update(_update),
 		 delay_event(_loop, BIND_THIS_METHOD(OnDelay)) {}
 
+	/**
+	 * Schedule an update of the directory.
+	 */
 	void Enqueue(const char *uri_utf8) noexcept;
 
+	/**
+	 * Schedule an update of one entry of the directory.
+	 */
+	void Enqueue(const char *uri_utf8, const char *name) noexcept;
+
 private:
+	gcc_pure
+	bool IsQueued(const char *uri_utf8, const char *name) const noexcept;
+
+	/**
+	 * Remove all items below the given path.
+	 */
+	void EraseBelow(const char *uri_utf8) noexcept;
+
+	/**
+	 * Count an event and (re)schedule the #delay_event.
+	 */
+	void ScheduleDelay() noexcept;
+
 	void OnDelay() noexcept;
 };
 
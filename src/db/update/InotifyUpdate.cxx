@@ -236,7 +236,7 @@ WatchDirectory::GetDepth() const noexcept
 
 static void
 mpd_inotify_callback(int wd, unsigned mask,
-		     gcc_unused const char *name, gcc_unused void *ctx)
+		     const char *name, gcc_unused void *ctx)
 {
 	WatchDirectory *directory;
 
@@ -275,13 +275,25 @@ mpd_inotify_callback(int wd, unsigned mask,
 		/* a file was changed, or a directory was
 		   moved/deleted: queue a database update */
 
+		std::string uri_utf8;
 		if (!uri_fs.IsNull()) {
-			const std::string uri_utf8 = uri_fs.ToUTF8();
-			if (!uri_utf8.empty())
-				inotify_queue->Enqueue(uri_utf8.c_str());
+			uri_utf8 = uri_fs.ToUTF8();
+			if (uri_utf8.empty())
+				return;
 		}
-		else
-			inotify_queue->Enqueue("");
+
+		if (name != nullptr && !skip_path(name)) {
+			/* update only the entry which was changed */
+			const std::string name_utf8 =
+				Path::FromFS(name).ToUTF8();
+			if (!name_utf8.empty()) {
+				inotify_queue->Enqueue(uri_utf8.c_str(),
+						       name_utf8.c_str());
+				return;
+			}
+		}
+
+		inotify_queue->Enqueue(uri_utf8.c_str());
 	}
 }
 
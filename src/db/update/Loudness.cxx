@@ -0,0 +1,359 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Loudness.hxx"
+#include "Walk.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "decoder/Client.hxx"
+#include "decoder/DecoderAPI.hxx"
+#include "decoder/DecoderList.hxx"
+#include "storage/StorageInterface.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "pcm/Convert.hxx"
+#include "pcm/LoudnessMeter.hxx"
+#include "system/Error.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/UriExtract.hxx"
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace {
+
+class LoudnessDecoderClient final : public DecoderClient {
+	std::unique_ptr<PcmConvert> convert;
+
+	std::unique_ptr<LoudnessMeter> meter;
+
+	std::exception_ptr error;
+
+	/**
+	 * Has the decoder plugin found ReplayGain tags?  Then the
+	 * analysis is not necessary.
+	 */
+	bool has_replay_gain = false;
+
+public:
+	Mutex mutex;
+
+	bool IsReady() const noexcept {
+		return meter != nullptr;
+	}
+
+	void Reset() noexcept {
+		convert.reset();
+		meter.reset();
+		error = {};
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	ReplayGainTuple Finish();
+
+	/* virtual methods from DecoderClient */
+	bool PreferFloat() const noexcept override {
+		return true;
+	}
+
+	void Ready(AudioFormat audio_format,
+		   bool seekable, SignedSongTime duration) noexcept override;
+
+	DecoderCommand GetCommand() noexcept override {
+		return error || has_replay_gain
+			? DecoderCommand::STOP
+			: DecoderCommand::NONE;
+	}
+
+	void CommandFinished() noexcept override {}
+
+	SongTime GetSeekTime() noexcept override {
+		return SongTime::zero();
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return 0;
+	}
+
+	void SeekError() noexcept override {}
+
+	InputStreamPtr OpenUri(const char *uri) override {
+		return InputStream::OpenReady(uri, mutex);
+	}
+
+	size_t Read(InputStream &is,
+		    void *buffer, size_t length) noexcept override;
+
+	void SubmitTimestamp(FloatDuration) noexcept override {}
+
+	DecoderCommand SubmitData(InputStream *is,
+				  const void *data, size_t length,
+				  uint16_t kbit_rate) noexcept override;
+
+	DecoderCommand SubmitTag(InputStream *, Tag &&) noexcept override {
+		return GetCommand();
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *info) noexcept override {
+		if (info != nullptr && info->IsDefined())
+			has_replay_gain = true;
+	}
+
+	void SubmitMixRamp(MixRampInfo &&) noexcept override {}
+};
+
+}
+
+void
+LoudnessDecoderClient::Ready(AudioFormat audio_format, bool,
+			     SignedSongTime) noexcept
+{
+	try {
+		if (audio_format.format != SampleFormat::FLOAT) {
+			const AudioFormat src_audio_format = audio_format;
+			audio_format.format = SampleFormat::FLOAT;
+
+			convert = std::make_unique<PcmConvert>(src_audio_format,
+							       audio_format);
+		}
+	} catch (...) {
+		error = std::current_exception();
+		return;
+	}
+
+	meter = std::make_unique<LoudnessMeter>(audio_format.sample_rate,
+						audio_format.channels);
+}
+
+DecoderCommand
+LoudnessDecoderClient::SubmitData(InputStream *,
+				  const void *_data, size_t length,
+				  uint16_t) noexcept
+{
+	if (meter == nullptr)
+		return DecoderCommand::STOP;
+
+	ConstBuffer<void> src{_data, length};
+
+	if (convert) {
+		try {
+			src = convert->Convert(src);
+		} catch (...) {
+			error = std::current_exception();
+			return DecoderCommand::STOP;
+		}
+	}
+
+	meter->Feed(ConstBuffer<float>::FromVoid(src));
+
+	return GetCommand();
+}
+
+size_t
+LoudnessDecoderClient::Read(InputStream &is,
+			    void *buffer, size_t length) noexcept
+{
+	try {
+		return is.LockRead(buffer, length);
+	} catch (...) {
+		error = std::current_exception();
+		return 0;
+	}
+}
+
+ReplayGainTuple
+LoudnessDecoderClient::Finish()
+{
+	if (error)
+		std::rethrow_exception(error);
+
+	if (has_replay_gain || meter == nullptr)
+		return ReplayGainTuple::Undefined();
+
+	if (convert) {
+		while (true) {
+			auto flushed = convert->Flush();
+			if (flushed.IsNull())
+				break;
+
+			meter->Feed(ConstBuffer<float>::FromVoid(flushed));
+		}
+	}
+
+	const double loudness = meter->GetIntegratedLoudness();
+	if (!std::isfinite(loudness))
+		/* digital silence */
+		return ReplayGainTuple::Undefined();
+
+	return {
+		float(REPLAY_GAIN_REFERENCE_LOUDNESS - loudness),
+		meter->GetPeak(),
+	};
+}
+
+static bool
+AnalyzeContainer(LoudnessDecoderClient &client, Path path,
+		 const char *suffix)
+{
+	return decoder_plugins_try_suffix(suffix,
+					  [&client, path](const DecoderPlugin &plugin){
+		if (plugin.container_scan == nullptr ||
+		    plugin.file_decode == nullptr)
+			return false;
+
+		client.Reset();
+		plugin.FileDecode(client, path);
+		return client.IsReady();
+	});
+}
+
+static void
+AnalyzeFile(LoudnessDecoderClient &client, Path path, const char *suffix)
+{
+	InputStreamPtr input_stream;
+
+	try {
+		input_stream = OpenLocalInputStream(path, client.mutex);
+	} catch (const std::system_error &e) {
+		if (IsPathNotFound(e) &&
+		    /* ENOTDIR means this may be a path inside a
+		       "container" file */
+		    AnalyzeContainer(client, path, suffix))
+			return;
+
+		throw;
+	}
+
+	auto &is = *input_stream;
+	decoder_plugins_try_suffix(suffix,
+				   [&client, path, &is](const DecoderPlugin &plugin){
+		client.Reset();
+
+		if (plugin.file_decode != nullptr)
+			plugin.FileDecode(client, path);
+		else if (plugin.stream_decode != nullptr) {
+			try {
+				is.LockRewind();
+			} catch (...) {
+			}
+
+			plugin.StreamDecode(client, is);
+		} else
+			return false;
+
+		return client.IsReady();
+	});
+}
+
+ReplayGainTuple
+AnalyzeLoudness(Storage &storage, const char *uri)
+{
+	const char *suffix = uri_get_suffix(uri);
+	if (suffix == nullptr)
+		return ReplayGainTuple::Undefined();
+
+	const auto path = storage.MapFS(uri);
+	if (path.IsNull())
+		/* not a local file */
+		return ReplayGainTuple::Undefined();
+
+	LoudnessDecoderClient client;
+
+	try {
+		AnalyzeFile(client, path, suffix);
+	} catch (StopDecoder) {
+	}
+
+	return client.Finish();
+}
+
+void
+UpdateWalk::UpdateAlbumGain(Directory &directory) noexcept
+{
+	struct Album {
+		/**
+		 * The sum of the songs' mean square values weighted
+		 * with their durations.
+		 */
+		double energy = 0;
+
+		double duration = 0;
+
+		float peak = 0;
+
+		ReplayGainTuple Get() const noexcept {
+			return {
+				float(REPLAY_GAIN_REFERENCE_LOUDNESS -
+				      10 * std::log10(energy / duration)),
+				peak,
+			};
+		}
+	};
+
+	/* this approximates the gated loudness of all blocks of the
+	   album with the duration-weighted mean of the songs'
+	   integrated loudness, because the blocks are not kept */
+	std::map<std::string, Album> albums;
+
+	for (const auto &song : directory.songs) {
+		const auto track = song.GetReplayGain().track;
+		const char *name = song.tag.GetValue(TAG_ALBUM);
+		if (!track.IsDefined() || name == nullptr)
+			continue;
+
+		auto duration = song.GetDuration().ToDoubleS();
+		if (duration <= 0)
+			duration = 1;
+
+		auto &album = albums[name];
+		album.energy += duration *
+			std::pow(10, (REPLAY_GAIN_REFERENCE_LOUDNESS - track.gain) / 10);
+		album.duration += duration;
+		album.peak = std::max(album.peak, track.peak);
+	}
+
+	if (albums.empty())
+		return;
+
+	for (auto &song : directory.songs) {
+		auto replay_gain = song.GetReplayGain();
+		const char *name = song.tag.GetValue(TAG_ALBUM);
+		if (!replay_gain.track.IsDefined() || name == nullptr)
+			continue;
+
+		const auto album = albums[name].Get();
+		if (std::fabs(album.gain - replay_gain.album.gain) < 0.01f &&
+		    album.peak == replay_gain.album.peak)
+			continue;
+
+		replay_gain.album = album;
+
+		const ScopeDatabaseLock protect;
+		song.SetReplayGain(replay_gain);
+		modified = true;
+	}
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_LOUDNESS_HXX
+#define MPD_UPDATE_LOUDNESS_HXX
+
+#include "ReplayGainInfo.hxx"
+
+class Storage;
+
+/**
+ * The ReplayGain 2.0 reference level in LUFS.
+ */
+static constexpr double REPLAY_GAIN_REFERENCE_LOUDNESS = -18;
+
+/**
+ * Decode the given song file and measure its loudness according to
+ * EBU R128 ("update_loudness_analysis").  Only files in the local
+ * file system are supported.
+ *
+ * Throws on error.
+ *
+ * @return the ReplayGain track values; undefined if the file has
+ * ReplayGain tags already or if it could not be decoded
+ */
+ReplayGainTuple
+AnalyzeLoudness(Storage &storage, const char *uri);
+
+#endif
@@ -18,10 +18,12 @@
  */
 
 #include "Walk.hxx"
+#include "ContainerCache.hxx"
 #include "UpdateDomain.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/PlaylistVector.hxx"
 #include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
 #include "song/DetachedSong.hxx"
 #include "input/InputStream.hxx"
 #include "playlist/PlaylistPlugin.hxx"
@@ -40,6 +42,15 @@ UpdateWalk::UpdatePlaylistFile(Directory &parent, const char *name,
 {
 	assert(plugin.open_stream);
 
+	/* look up the cache even if the file is not modified, to
+	   mark the entry as used */
+	ContainerCache::Key cache_key;
+	const bool use_cache = container_cache != nullptr &&
+		ContainerCache::MakeKey(info, cache_key);
+	const auto *cached = use_cache
+		? container_cache->Find(storage_uri, cache_key)
+		: nullptr;
+
 	Directory *directory =
 		LockMakeVirtualDirectoryIfModified(parent, name, info,
 						   DEVICE_PLAYLIST);
@@ -47,6 +58,19 @@ UpdateWalk::UpdatePlaylistFile(Directory &parent, const char *name,
 		/* not modified */
 		return;
 
+	if (cached != nullptr && !walk_discard) {
+		for (const auto &item : *cached) {
+			auto db_song = Song::New(DetachedSong(item.song),
+						 *directory);
+			db_song->SetTarget(std::string(item.target));
+
+			const ScopeDatabaseLock protect;
+			directory->AddSong(std::move(db_song));
+		}
+
+		return;
+	}
+
 	const auto uri_utf8 = storage.MapUTF8(directory->GetPath());
 
 	FormatDebug(update_domain, "scanning playlist '%s'", uri_utf8.c_str());
@@ -61,6 +85,7 @@ UpdateWalk::UpdatePlaylistFile(Directory &parent, const char *name,
 			return;
 		}
 
+		ContainerCache::ItemList items;
 		unsigned track = 0;
 
 		while (true) {
@@ -68,17 +93,33 @@ UpdateWalk::UpdatePlaylistFile(Directory &parent, const char *name,
 			if (!song)
 				break;
 
-			auto db_song = std::make_unique<Song>(std::move(*song),
-							      *directory);
-			db_song->target = "../" + db_song->filename;
-			db_song->filename = StringFormat<64>("track%04u",
-							     ++track);
+			std::string target = std::string("../") + song->GetURI();
+			auto db_song = Song::New(StringFormat<64>("track%04u",
+								  ++track).c_str(),
+						 std::move(*song),
+						 *directory);
+
+			if (use_cache) {
+				DetachedSong copy(db_song->GetFilename());
+				copy.SetTag(db_song->tag);
+				copy.SetLastModified(db_song->mtime);
+				copy.SetStartTime(db_song->GetStartTime());
+				copy.SetEndTime(db_song->GetEndTime());
+				items.emplace_back(std::move(copy),
+						   std::string(target));
+			}
+
+			db_song->SetTarget(std::move(target));
 
 			{
 				const ScopeDatabaseLock protect;
 				directory->AddSong(std::move(db_song));
 			}
 		}
+
+		if (use_cache)
+			container_cache->Put(storage_uri, cache_key,
+					     std::move(items));
 	} catch (...) {
 		FormatError(std::current_exception(),
 			    "Failed to scan playlist '%s'", uri_utf8.c_str());
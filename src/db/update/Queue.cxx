@@ -21,12 +21,14 @@
 
 bool
 UpdateQueue::Push(SimpleDatabase &db, Storage &storage,
-		  const char *path, bool discard, unsigned id) noexcept
+		  const char *path, std::set<std::string> &&names,
+		  bool discard, unsigned id) noexcept
 {
 	if (update_queue.size() >= MAX_UPDATE_QUEUE_SIZE)
 		return false;
 
-	update_queue.emplace_back(db, storage, path, discard, id);
+	update_queue.emplace_back(db, storage, path, std::move(names),
+				  discard, id);
 	return true;
 }
 
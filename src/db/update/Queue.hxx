@@ -23,6 +23,7 @@
 #include "util/Compiler.h"
 
 #include <string>
+#include <set>
 #include <list>
 
 class SimpleDatabase;
@@ -33,6 +34,13 @@ struct UpdateQueueItem {
 	Storage *storage;
 
 	std::string path_utf8;
+
+	/**
+	 * If not empty, then only these entries of the directory
+	 * #path_utf8 are updated instead of the whole directory.
+	 */
+	std::set<std::string> names;
+
 	unsigned id;
 	bool discard;
 
@@ -40,9 +48,12 @@ struct UpdateQueueItem {
 
 	UpdateQueueItem(SimpleDatabase &_db,
 			Storage &_storage,
-			const char *_path, bool _discard,
+			const char *_path,
+			std::set<std::string> &&_names,
+			bool _discard,
 			unsigned _id) noexcept
 		:db(&_db), storage(&_storage), path_utf8(_path),
+		 names(std::move(_names)),
 		 id(_id), discard(_discard) {}
 
 	bool IsDefined() const noexcept {
@@ -62,10 +73,29 @@ class UpdateQueue {
 public:
 	gcc_nonnull_all
 	bool Push(SimpleDatabase &db, Storage &storage,
-		  const char *path, bool discard, unsigned id) noexcept;
+		  const char *path, std::set<std::string> &&names,
+		  bool discard, unsigned id) noexcept;
 
 	UpdateQueueItem Pop() noexcept;
 
+	/**
+	 * Remove and return the first item which matches the given
+	 * predicate.  Returns an undefined item if there is none.
+	 */
+	template<typename P>
+	UpdateQueueItem PopIf(P &&p) noexcept {
+		for (auto i = update_queue.begin(), end = update_queue.end();
+		     i != end; ++i) {
+			if (p(*i)) {
+				auto result = std::move(*i);
+				update_queue.erase(i);
+				return result;
+			}
+		}
+
+		return UpdateQueueItem();
+	}
+
 	void Clear() noexcept {
 		update_queue.clear();
 	}
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "ScanPool.hxx"
+#include "Loudness.hxx"
+#include "UpdateDomain.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "fs/Traits.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "thread/Scheduling.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+static std::string
+MakeUri(const Directory &directory, const char *name) noexcept
+{
+	if (directory.IsRoot())
+		return name;
+
+	return PathTraitsUTF8::Build(directory.GetPath(), name);
+}
+
+ScanPool::Job::Job(Directory &_directory, Song *_song,
+		   const char *_name, bool _analyze_loudness) noexcept
+	:directory(_directory), song(_song), name(_name),
+	 uri(MakeUri(directory, _name)),
+	 analyze_loudness(_analyze_loudness)
+{
+}
+
+void
+ScanPool::Job::Run(Storage &storage) noexcept
+{
+	try {
+		found = Song::ScanFile(storage, uri.c_str(),
+				       tag, audio_format, mtime);
+	} catch (...) {
+		error = std::current_exception();
+		return;
+	}
+
+	if (!found || !analyze_loudness)
+		return;
+
+	try {
+		replay_gain = AnalyzeLoudness(storage, uri.c_str());
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Failed to analyze the loudness of %s",
+			    uri.c_str());
+	}
+}
+
+ScanPool::ScanPool(Storage &_storage, unsigned n_threads)
+	:storage(_storage)
+{
+	for (unsigned i = 0; i < n_threads; ++i) {
+		threads.emplace_front(BIND_THIS_METHOD(WorkerThread));
+
+		try {
+			threads.front().Start();
+		} catch (...) {
+			threads.pop_front();
+
+			if (threads.empty())
+				throw;
+
+			LogError(std::current_exception(),
+				 "Failed to start scanner thread");
+			break;
+		}
+	}
+}
+
+ScanPool::~ScanPool() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		assert(queue.empty());
+		quit = true;
+		cond.notify_all();
+	}
+
+	for (auto &thread : threads)
+		thread.Join();
+}
+
+void
+ScanPool::Submit(Job &job) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	queue.push_back(&job);
+	cond.notify_one();
+}
+
+void
+ScanPool::Wait(Job &job) noexcept
+{
+	std::unique_lock<Mutex> lock(mutex);
+
+	if (job.finished)
+		return;
+
+	/* jobs are usually waited for in the order they were
+	   submitted, so this one is likely at the front */
+	auto i = std::find(queue.begin(), queue.end(), &job);
+	if (i != queue.end()) {
+		/* not yet started: don't wait for a worker thread */
+		queue.erase(i);
+		lock.unlock();
+
+		job.Run(storage);
+		job.finished = true;
+		return;
+	}
+
+	done_cond.wait(lock, [&job]{ return job.finished; });
+}
+
+void
+ScanPool::WorkerThread() noexcept
+{
+	SetThreadName("scan");
+	SetThreadIdlePriority();
+
+	try {
+		ApplyThreadScheduling("scan");
+	} catch (...) {
+		Log(LogLevel::WARNING, std::current_exception(),
+		    "Failed to apply \"thread\" settings");
+	}
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (true) {
+		cond.wait(lock, [this]{ return quit || !queue.empty(); });
+		if (quit)
+			break;
+
+		Job &job = *queue.front();
+		queue.pop_front();
+
+		lock.unlock();
+		job.Run(storage);
+		lock.lock();
+
+		job.finished = true;
+		done_cond.notify_all();
+	}
+}
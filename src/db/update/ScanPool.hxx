@@ -0,0 +1,156 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_UPDATE_SCAN_POOL_HXX
+#define MPD_UPDATE_SCAN_POOL_HXX
+
+#include "tag/Tag.hxx"
+#include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <chrono>
+#include <exception>
+#include <forward_list>
+#include <list>
+#include <string>
+
+struct Directory;
+struct Song;
+class Storage;
+
+/**
+ * A pool of threads which scan song files for #UpdateWalk.  This
+ * allows overlapping the I/O latency of (remote) storages and the
+ * CPU time of decoder plugins.  The threads do not access the
+ * database; the results are applied by the update thread.
+ */
+class ScanPool final {
+public:
+	struct Job {
+		Directory &directory;
+
+		/**
+		 * The existing song which is being updated, or
+		 * nullptr if a new song is being loaded.
+		 */
+		Song *const song;
+
+		const std::string name;
+
+		/**
+		 * The URI of the file relative to the storage.
+		 */
+		const std::string uri;
+
+		/**
+		 * Decode the file and measure its loudness?  See
+		 * UpdateConfig::loudness_analysis.
+		 */
+		const bool analyze_loudness;
+
+		/**
+		 * Was the file recognized?  Only valid after
+		 * ScanPool::Wait() has returned.
+		 */
+		bool found = false;
+
+		Tag tag;
+		AudioFormat audio_format = AudioFormat::Undefined();
+		std::chrono::system_clock::time_point mtime;
+
+		/**
+		 * The measured ReplayGain track values; undefined if
+		 * the analysis was not done or failed.
+		 */
+		ReplayGainTuple replay_gain = ReplayGainTuple::Undefined();
+
+		/**
+		 * The error which occurred while the file was being
+		 * scanned.
+		 */
+		std::exception_ptr error;
+
+		/**
+		 * Protected by ScanPool::mutex.
+		 */
+		bool finished = false;
+
+		Job(Directory &_directory, Song *_song,
+		    const char *_name, bool _analyze_loudness) noexcept;
+
+		void Run(Storage &storage) noexcept;
+	};
+
+private:
+	Storage &storage;
+
+	Mutex mutex;
+
+	/**
+	 * Wakes up the worker threads.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a job was finished.
+	 */
+	Cond done_cond;
+
+	/**
+	 * Jobs which have not yet been started.  Protected by
+	 * #mutex.
+	 */
+	std::list<Job *> queue;
+
+	bool quit = false;
+
+	std::forward_list<Thread> threads;
+
+public:
+	/**
+	 * Throws if no thread could be started.
+	 */
+	ScanPool(Storage &_storage, unsigned n_threads);
+
+	~ScanPool() noexcept;
+
+	ScanPool(const ScanPool &) = delete;
+	ScanPool &operator=(const ScanPool &) = delete;
+
+	/**
+	 * Enqueue a job.  The caller must keep the #Job object alive
+	 * until Wait() has returned.
+	 */
+	void Submit(Job &job) noexcept;
+
+	/**
+	 * Wait until the given job has been finished.  If no worker
+	 * thread has started it yet, it is run in the calling thread.
+	 */
+	void Wait(Job &job) noexcept;
+
+private:
+	void WorkerThread() noexcept;
+};
+
+#endif
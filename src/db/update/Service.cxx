@@ -19,25 +19,109 @@
 
 #include "Service.hxx"
 #include "Walk.hxx"
+#include "ContainerCache.hxx"
 #include "UpdateDomain.hxx"
 #include "db/DatabaseListener.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/plugins/simple/Directory.hxx"
+#include "db/Uri.hxx"
 #include "storage/CompositeStorage.hxx"
+#include "fs/Traits.hxx"
 #include "protocol/Ack.hxx"
 #include "Idle.hxx"
 #include "Log.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
 #include "thread/Util.hxx"
+#include "thread/Scheduling.hxx"
 
 #ifndef NDEBUG
 #include "event/Loop.hxx"
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 
+/**
+ * One running update of one #SimpleDatabase.
+ */
+class UpdateService::Worker {
+	UpdateService &service;
+
+public:
+	const UpdateQueueItem item;
+
+private:
+	UpdateWalk walk;
+
+	Thread thread;
+
+	/**
+	 * Set by the thread when it is about to exit; after that,
+	 * the main thread may collect it.
+	 */
+	std::atomic_bool finished{false};
+
+	bool modified = false;
+
+	std::chrono::steady_clock::time_point start_time, end_time;
+
+public:
+	Worker(UpdateService &_service, UpdateQueueItem &&_item) noexcept
+		:service(_service), item(std::move(_item)),
+		 walk(service.config, service.GetEventLoop(),
+		      service.listener, *item.storage,
+		      service.container_cache.get()),
+		 thread(BIND_THIS_METHOD(Task)) {}
+
+	~Worker() noexcept {
+		Join();
+	}
+
+	Worker(const Worker &) = delete;
+	Worker &operator=(const Worker &) = delete;
+
+	bool IsFinished() const noexcept {
+		return finished;
+	}
+
+	/**
+	 * Was the database modified?  Only valid after the thread
+	 * has finished.
+	 */
+	bool IsModified() const noexcept {
+		return modified;
+	}
+
+	/**
+	 * How long did the update take?  Only valid after the thread
+	 * has finished.
+	 */
+	std::chrono::steady_clock::duration GetDuration() const noexcept {
+		return end_time - start_time;
+	}
+
+	void Start() {
+		start_time = std::chrono::steady_clock::now();
+		thread.Start();
+	}
+
+	void Cancel() noexcept {
+		walk.Cancel();
+	}
+
+	void Join() noexcept {
+		if (thread.IsDefined())
+			thread.Join();
+	}
+
+private:
+	/* the update thread */
+	void Task() noexcept;
+};
+
 UpdateService::UpdateService(const ConfigData &_config,
 			     EventLoop &_loop, SimpleDatabase &_db,
 			     CompositeStorage &_storage,
@@ -45,17 +129,24 @@ UpdateService::UpdateService(const ConfigData &_config,
 	:config(_config),
 	 defer(_loop, BIND_THIS_METHOD(RunDeferred)),
 	 db(_db), storage(_storage),
-	 listener(_listener),
-	 update_thread(BIND_THIS_METHOD(Task))
+	 listener(_listener)
 {
+	if (!config.container_cache_path.IsNull())
+		container_cache = std::make_unique<ContainerCache>(AllocatedPath(config.container_cache_path));
 }
 
 UpdateService::~UpdateService() noexcept
 {
 	CancelAllAsync();
 
-	if (update_thread.IsDefined())
-		update_thread.Join();
+	/* the Worker destructor joins the thread */
+	workers.clear();
+}
+
+unsigned
+UpdateService::GetId() const noexcept
+{
+	return workers.empty() ? 0 : workers.front().item.id;
 }
 
 void
@@ -65,8 +156,8 @@ UpdateService::CancelAllAsync() noexcept
 
 	queue.Clear();
 
-	if (walk != nullptr)
-		walk->Cancel();
+	for (auto &i : workers)
+		i.Cancel();
 }
 
 void
@@ -84,79 +175,121 @@ UpdateService::CancelMount(const char *uri) noexcept
 	if (!lr.directory->IsMount())
 		return;
 
-	bool cancel_current = false;
-
 	Storage *storage2 = storage.GetMount(uri);
-	if (storage2 != nullptr) {
+	if (storage2 != nullptr)
 		queue.Erase(*storage2);
-		cancel_current = next.IsDefined() && next.storage == storage2;
-	}
 
-	if (auto *db2 = dynamic_cast<SimpleDatabase *>(lr.directory->mounted_database.get())) {
+	auto *db2 = dynamic_cast<SimpleDatabase *>(lr.directory->mounted_database.get());
+	if (db2 != nullptr)
 		queue.Erase(*db2);
-		cancel_current |= next.IsDefined() && next.db == db2;
-	}
 
-	if (cancel_current && walk != nullptr) {
-		walk->Cancel();
-
-		if (update_thread.IsDefined())
-			update_thread.Join();
+	for (auto &i : workers) {
+		if ((storage2 != nullptr && i.item.storage == storage2) ||
+		    (db2 != nullptr && i.item.db == db2)) {
+			/* the Worker object will be removed by
+			   RunDeferred() */
+			i.Cancel();
+			i.Join();
+		}
 	}
 }
 
 inline void
-UpdateService::Task() noexcept
+UpdateService::Worker::Task() noexcept
 {
-	assert(walk != nullptr);
-
 	SetThreadName("update");
 
-	if (!next.path_utf8.empty())
+	if (!item.path_utf8.empty())
 		FormatDebug(update_domain, "starting: %s",
-			    next.path_utf8.c_str());
+			    item.path_utf8.c_str());
 	else
 		LogDebug(update_domain, "starting");
 
 	SetThreadIdlePriority();
 
-	modified = walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
-			      next.discard);
+	try {
+		ApplyThreadScheduling("update");
+	} catch (...) {
+		Log(LogLevel::WARNING, std::current_exception(),
+		    "Failed to apply \"thread\" settings");
+	}
+
+	auto *const container_cache = service.container_cache.get();
+	if (container_cache != nullptr)
+		container_cache->LoadOnce();
 
-	if (modified || !next.db->FileExists()) {
+	modified = walk.Walk(item.db->GetRoot(), item.path_utf8.c_str(),
+			     item.names, item.discard);
+
+	if (modified || !item.db->FileExists()) {
 		try {
-			next.db->Save();
+			item.db->Save(item.path_utf8.c_str());
 		} catch (...) {
 			LogError(std::current_exception(),
 				 "Failed to save database");
 		}
 	}
 
-	if (!next.path_utf8.empty())
+	if (container_cache != nullptr)
+		container_cache->SaveIfModified();
+
+	if (!item.path_utf8.empty())
 		FormatDebug(update_domain, "finished: %s",
-			    next.path_utf8.c_str());
+			    item.path_utf8.c_str());
 	else
 		LogDebug(update_domain, "finished");
 
-	defer.Schedule();
+	end_time = std::chrono::steady_clock::now();
+	finished = true;
+	service.defer.Schedule();
+}
+
+bool
+UpdateService::IsBusy(const SimpleDatabase &_db) const noexcept
+{
+	for (const auto &i : workers)
+		if (i.item.db == &_db)
+			return true;
+
+	return false;
 }
 
 void
-UpdateService::StartThread(UpdateQueueItem &&i)
+UpdateService::StartWorker(UpdateQueueItem &&i)
 {
 	assert(GetEventLoop().IsInside());
-	assert(walk == nullptr);
+	assert(!IsBusy(*i.db));
 
-	modified = false;
+	auto &worker = workers.emplace_back(*this, std::move(i));
 
-	next = std::move(i);
-	walk = std::make_unique<UpdateWalk>(config, GetEventLoop(), listener,
-					    *next.storage);
-
-	update_thread.Start();
+	try {
+		worker.Start();
+	} catch (...) {
+		workers.pop_back();
+		throw;
+	}
 
 	FormatDebug(update_domain,
-		    "spawned thread for update job id %i", next.id);
+		    "spawned thread for update job id %i", worker.item.id);
+}
+
+void
+UpdateService::StartQueued() noexcept
+{
+	while (true) {
+		auto i = queue.PopIf([this](const UpdateQueueItem &item){
+				return !IsBusy(*item.db);
+			});
+		if (!i.IsDefined())
+			break;
+
+		try {
+			StartWorker(std::move(i));
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to start the update thread");
+		}
+	}
 }
 
 unsigned
@@ -170,6 +303,13 @@ UpdateService::GenerateId() noexcept
 
 unsigned
 UpdateService::Enqueue(const char *path, bool discard)
+{
+	return Enqueue(path, {}, discard);
+}
+
+unsigned
+UpdateService::Enqueue(const char *path, std::set<std::string> &&names,
+		       bool discard)
 {
 	assert(GetEventLoop().IsInside());
 
@@ -182,6 +322,23 @@ UpdateService::Enqueue(const char *path, bool discard)
 	{
 		const ScopeDatabaseLock protect;
 		lr = db.GetRoot().LookupDirectory(path);
+
+		if (!names.empty() && !lr.directory->IsMount()) {
+			/* a mount point cannot be updated as an entry
+			   of its parent; update the whole directory,
+			   which follows the mount */
+			for (const auto &name : names) {
+				const auto child_uri = isRootDirectory(path)
+					? name
+					: PathTraitsUTF8::Build(path, name.c_str());
+				const auto lr2 = db.GetRoot().LookupDirectory(child_uri.c_str());
+				if (lr2.uri == nullptr &&
+				    lr2.directory->IsMount()) {
+					names.clear();
+					break;
+				}
+			}
+		}
 	}
 
 	if (lr.directory->IsMount()) {
@@ -216,9 +373,13 @@ UpdateService::Enqueue(const char *path, bool discard)
 		   happen */
 		throw std::runtime_error("No storage at this path");
 
-	if (walk != nullptr) {
+	if (IsBusy(*db2)) {
+		/* queued updates of other databases are started as
+		   soon as their database is idle, so the queue
+		   contains only items for busy databases */
 		const unsigned id = GenerateId();
-		if (!queue.Push(*db2, *storage2, path, discard, id))
+		if (!queue.Push(*db2, *storage2, path, std::move(names),
+				discard, id))
 			throw ProtocolError(ACK_ERROR_UPDATE_ALREADY,
 					    "Update queue is full");
 
@@ -227,7 +388,8 @@ UpdateService::Enqueue(const char *path, bool discard)
 	}
 
 	const unsigned id = update_task_id = GenerateId();
-	StartThread(UpdateQueueItem(*db2, *storage2, path, discard, id));
+	StartWorker(UpdateQueueItem(*db2, *storage2, path, std::move(names),
+				    discard, id));
 
 	idle_add(IDLE_UPDATE);
 
@@ -235,22 +397,32 @@ UpdateService::Enqueue(const char *path, bool discard)
 }
 
 /**
- * Called in the main thread after the database update is finished.
+ * Called in the main thread after a database update is finished.
  */
 void
 UpdateService::RunDeferred() noexcept
 {
-	assert(next.IsDefined());
-	assert(walk != nullptr);
-
-	/* wait for thread to finish only if it wasn't cancelled by
-	   CancelMount() */
-	if (update_thread.IsDefined())
-		update_thread.Join();
-
-	walk.reset();
+	bool modified = false, finished = false;
+
+	for (auto i = workers.begin(); i != workers.end();) {
+		if (i->IsFinished()) {
+			/* the destructor waits for the thread to
+			   finish (unless it was already joined by
+			   CancelMount()) */
+			modified |= i->IsModified();
+
+			++n_finished;
+			last_duration = i->GetDuration();
+			total_duration += last_duration;
+
+			i = workers.erase(i);
+			finished = true;
+		} else
+			++i;
+	}
 
-	next.Clear();
+	if (!finished)
+		return;
 
 	idle_add(IDLE_UPDATE);
 
@@ -258,9 +430,6 @@ UpdateService::RunDeferred() noexcept
 		/* send "idle" events */
 		listener.OnDatabaseModified();
 
-	auto i = queue.Pop();
-	if (i.IsDefined()) {
-		/* schedule the next path */
-		StartThread(std::move(i));
-	}
+	/* schedule the next paths */
+	StartQueued();
 }
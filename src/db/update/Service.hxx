@@ -23,18 +23,27 @@
 #include "Config.hxx"
 #include "Queue.hxx"
 #include "event/DeferEvent.hxx"
-#include "thread/Thread.hxx"
 #include "util/Compiler.h"
 
+#include <chrono>
+#include <list>
 #include <memory>
+#include <set>
+#include <string>
 
 class SimpleDatabase;
 class DatabaseListener;
-class UpdateWalk;
 class CompositeStorage;
+class ContainerCache;
 
 /**
- * This class manages the update queue and runs the update thread.
+ * This class manages the update queue and runs the update threads.
+ *
+ * Each #SimpleDatabase (the root database and each mounted database)
+ * is updated by at most one thread at a time, but updates of
+ * different databases (which are backed by different storages) run
+ * concurrently.  Queued updates of the same database are executed in
+ * order.
  */
 class UpdateService final {
 	const UpdateConfig config;
@@ -46,19 +55,32 @@ class UpdateService final {
 
 	DatabaseListener &listener;
 
-	bool modified;
-
-	Thread update_thread;
-
 	static constexpr unsigned update_task_id_max = 1 << 15;
 
 	unsigned update_task_id = 0;
 
 	UpdateQueue queue;
 
-	UpdateQueueItem next;
+	class Worker;
+
+	/**
+	 * The updates which are currently running, in the order they
+	 * were started.
+	 */
+	std::list<Worker> workers;
+
+	/**
+	 * Remembers the results of scanning container files; nullptr
+	 * if disabled.  Only accessed by the update threads.
+	 */
+	std::unique_ptr<ContainerCache> container_cache;
 
-	std::unique_ptr<UpdateWalk> walk;
+	/**
+	 * The number of finished updates and their durations.
+	 */
+	unsigned n_finished = 0;
+	std::chrono::steady_clock::duration last_duration{};
+	std::chrono::steady_clock::duration total_duration{};
 
 public:
 	UpdateService(const ConfigData &_config,
@@ -74,10 +96,28 @@ public:
 
 	/**
 	 * Returns a non-zero job id when we are currently updating
-	 * the database.
+	 * the database.  If there are several concurrent updates,
+	 * this is the id of the oldest one.
+	 */
+	gcc_pure
+	unsigned GetId() const noexcept;
+
+	unsigned GetFinishedCount() const noexcept {
+		return n_finished;
+	}
+
+	/**
+	 * Returns the duration of the most recently finished update.
 	 */
-	unsigned GetId() const noexcept {
-		return next.id;
+	auto GetLastDuration() const noexcept {
+		return last_duration;
+	}
+
+	/**
+	 * Returns the total duration of all finished updates.
+	 */
+	auto GetTotalDuration() const noexcept {
+		return total_duration;
 	}
 
 	/**
@@ -93,8 +133,19 @@ public:
 	unsigned Enqueue(const char *path, bool discard);
 
 	/**
-	 * Clear the queue and cancel the current update.  Does not
-	 * wait for the thread to exit.
+	 * Like Enqueue(const char *, bool), but update only the given
+	 * entries of the directory.
+	 *
+	 * @param names the names of the entries to be updated; if
+	 * empty, the whole directory is updated
+	 */
+	gcc_nonnull_all
+	unsigned Enqueue(const char *path, std::set<std::string> &&names,
+			 bool discard);
+
+	/**
+	 * Clear the queue and cancel all running updates.  Does not
+	 * wait for the threads to exit.
 	 */
 	void CancelAllAsync() noexcept;
 
@@ -109,10 +160,21 @@ private:
 	/* DeferEvent callback */
 	void RunDeferred() noexcept;
 
-	/* the update thread */
-	void Task() noexcept;
+	/**
+	 * Is an update of the given database running?
+	 */
+	gcc_pure
+	bool IsBusy(const SimpleDatabase &_db) const noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void StartWorker(UpdateQueueItem &&i);
 
-	void StartThread(UpdateQueueItem &&i);
+	/**
+	 * Start all queued updates whose database is not busy.
+	 */
+	void StartQueued() noexcept;
 
 	unsigned GenerateId() noexcept;
 };
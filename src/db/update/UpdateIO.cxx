@@ -84,18 +84,14 @@ try {
 }
 
 bool
-directory_child_access(Storage &storage, const Directory &directory,
-		       const char *name, int mode) noexcept
+directory_child_access(Path path, int mode) noexcept
 {
 #ifdef _WIN32
 	/* CheckAccess() is useless on WIN32 */
-	(void)storage;
-	(void)directory;
-	(void)name;
+	(void)path;
 	(void)mode;
 	return true;
 #else
-	const auto path = storage.MapChildFS(directory.GetPath(), name);
 	if (path.IsNull())
 		/* does not point to local file: silently ignore the
 		   check */
@@ -24,6 +24,7 @@
 
 struct Directory;
 struct StorageFileInfo;
+class Path;
 class Storage;
 class StorageDirectoryReader;
 
@@ -52,10 +53,13 @@ directory_child_is_regular(Storage &storage, const Directory &directory,
 
 /**
  * Checks if the given permissions on the mapped file are given.
+ *
+ * @param path the mapped path of the directory child (see
+ * ChildPathBuilder); nullptr if it is not a local file, which skips
+ * the check
  */
 gcc_pure
 bool
-directory_child_access(Storage &storage, const Directory &directory,
-		       const char *name, int mode) noexcept;
+directory_child_access(Path path, int mode) noexcept;
 
 #endif
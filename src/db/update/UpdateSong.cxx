@@ -28,6 +28,7 @@
 #include "Log.hxx"
 
 #include <unistd.h>
+#include <assert.h>
 
 inline void
 UpdateWalk::UpdateSongFile2(Directory &directory,
@@ -40,7 +41,7 @@ try {
 		song = directory.FindSong(name);
 	}
 
-	if (!directory_child_access(storage, directory, name, R_OK)) {
+	if (!directory_child_access(child_path.Map(directory, name), R_OK)) {
 		FormatError(update_domain,
 			    "no read permissions on %s/%s",
 			    directory.GetPath(), name);
@@ -62,6 +63,18 @@ try {
 		FormatDebug(update_domain, "reading %s/%s",
 			    directory.GetPath(), name);
 
+		if (scan_pool != nullptr) {
+			SubmitScan(directory, nullptr, name);
+			return;
+		}
+
+		if (config.loudness_analysis) {
+			ScanPool::Job job(directory, nullptr, name, true);
+			job.Run(storage);
+			ApplyScan(job);
+			return;
+		}
+
 		auto new_song = Song::LoadFile(storage, name, directory);
 		if (!new_song) {
 			FormatDebug(update_domain,
@@ -81,14 +94,19 @@ try {
 	} else if (info.mtime != song->mtime || walk_discard) {
 		FormatDefault(update_domain, "updating %s/%s",
 			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
-			FormatDebug(update_domain,
-				    "deleting unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			editor.LockDeleteSong(directory, song);
+
+		if (scan_pool != nullptr) {
+			SubmitScan(directory, song, name);
+			return;
 		}
 
-		modified = true;
+		/* scan into a temporary object and replace the tag
+		   with Directory::ModifySong(), which updates the
+		   directory totals */
+		ScanPool::Job job(directory, song, name,
+				  config.loudness_analysis);
+		job.Run(storage);
+		ApplyScan(job);
 	}
 } catch (...) {
 	FormatError(std::current_exception(),
@@ -96,6 +114,106 @@ try {
 		    directory.GetPath(), name);
 }
 
+void
+UpdateWalk::SubmitScan(Directory &directory, Song *song,
+		       const char *name) noexcept
+{
+	assert(scan_pool != nullptr);
+
+	scan_jobs.emplace_back(directory, song, name,
+			       config.loudness_analysis);
+	scan_pool->Submit(scan_jobs.back());
+}
+
+void
+UpdateWalk::ApplyScan(ScanPool::Job &job) noexcept
+{
+	Directory &directory = job.directory;
+	const char *name = job.name.c_str();
+
+	if (job.error) {
+		FormatError(job.error, "error reading file %s/%s",
+			    directory.GetPath(), name);
+		return;
+	}
+
+	if (job.song == nullptr) {
+		if (!job.found) {
+			FormatDebug(update_domain,
+				    "ignoring unrecognized file %s/%s",
+				    directory.GetPath(), name);
+			return;
+		}
+
+		auto new_song = Song::New(name, directory);
+		new_song->tag = std::move(job.tag);
+		new_song->mtime = job.mtime;
+		new_song->audio_format = job.audio_format;
+		new_song->SetReplayGain({
+			job.replay_gain,
+			ReplayGainTuple::Undefined(),
+		});
+
+		{
+			const ScopeDatabaseLock protect;
+			directory.AddSong(std::move(new_song));
+		}
+
+		modified = true;
+		FormatDefault(update_domain, "added %s/%s",
+			      directory.GetPath(), name);
+	} else {
+		if (!job.found) {
+			FormatDebug(update_domain,
+				    "deleting unrecognized file %s/%s",
+				    directory.GetPath(), name);
+			editor.LockDeleteSong(directory, job.song);
+		} else {
+			/* all attributes are replaced inside
+			   ModifySong(), because the replay gain may
+			   allocate Song::Extra, which is counted by
+			   the directory totals */
+			const ScopeDatabaseLock protect;
+			directory.ModifySong(*job.song, [&job](Song &song){
+				song.tag = std::move(job.tag);
+				song.mtime = job.mtime;
+				song.audio_format = job.audio_format;
+				song.SetReplayGain({
+					job.replay_gain,
+					ReplayGainTuple::Undefined(),
+				});
+			});
+		}
+
+		modified = true;
+	}
+}
+
+void
+UpdateWalk::FlushScans(const Directory *directory) noexcept
+{
+	if (scan_pool == nullptr)
+		return;
+
+	/* the jobs of the given directory are at the end of the
+	   list, because those of its sub directories have been
+	   flushed already at the end of their UpdateDirectory()
+	   call */
+	auto i = scan_jobs.end();
+	if (directory != nullptr)
+		while (i != scan_jobs.begin() &&
+		       &std::prev(i)->directory == directory)
+			--i;
+	else
+		i = scan_jobs.begin();
+
+	while (i != scan_jobs.end()) {
+		scan_pool->Wait(*i);
+		ApplyScan(*i);
+		i = scan_jobs.erase(i);
+	}
+}
+
 bool
 UpdateWalk::UpdateSongFile(Directory &directory,
 			   const char *name, const char *suffix,
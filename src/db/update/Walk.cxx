@@ -20,6 +20,7 @@
 #include "Walk.hxx"
 #include "UpdateIO.hxx"
 #include "Editor.hxx"
+#include "ContainerCache.hxx"
 #include "UpdateDomain.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/Uri.hxx"
@@ -33,13 +34,16 @@
 #include "storage/FileInfo.hxx"
 #include "input/InputStream.hxx"
 #include "input/Error.hxx"
+#include "time/ChronoUtil.hxx"
 #include "util/Alloc.hxx"
 #include "util/StringCompare.hxx"
 #include "util/UriExtract.hxx"
 #include "Log.hxx"
 
 #include <exception>
+#include <forward_list>
 #include <memory>
+#include <string>
 
 #include <assert.h>
 #include <string.h>
@@ -48,9 +52,12 @@
 
 UpdateWalk::UpdateWalk(const UpdateConfig &_config,
 		       EventLoop &_loop, DatabaseListener &_listener,
-		       Storage &_storage) noexcept
-	:config(_config), cancel(false),
-	 storage(_storage),
+		       Storage &_storage,
+		       ContainerCache *_container_cache) noexcept
+	:config(_config), container_cache(_container_cache),
+	 cancel(false),
+	 storage(_storage), storage_uri(storage.MapUTF8("")),
+	 child_path(storage),
 	 editor(_loop, _listener)
 {
 }
@@ -81,7 +88,7 @@ UpdateWalk::RemoveExcludedFromDirectory(Directory &directory,
 	directory.ForEachSongSafe([&](Song &song){
 			assert(&song.parent == &directory);
 
-			const auto name_fs = AllocatedPath::FromUTF8(song.filename.c_str());
+			const auto name_fs = AllocatedPath::FromUTF8(song.GetFilename());
 			if (name_fs.IsNull() || exclude_list.Check(name_fs)) {
 				editor.DeleteSong(directory, &song);
 				modified = true;
@@ -103,7 +110,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 
 	directory.ForEachSongSafe([&](Song &song){
 			if (!directory_child_is_regular(storage, directory,
-							song.filename.c_str())) {
+							song.GetFilename())) {
 				editor.LockDeleteSong(directory, &song);
 
 				modified = true;
@@ -233,8 +240,7 @@ UpdateWalk::SkipSymlink(const Directory *directory,
 			const char *utf8_name) const noexcept
 {
 #ifndef _WIN32
-	const auto path_fs = storage.MapChildFS(directory->GetPath(),
-						utf8_name);
+	const Path path_fs = child_path.Map(*directory, utf8_name);
 	if (path_fs.IsNull())
 		/* not a local file: don't skip */
 		return false;
@@ -301,68 +307,148 @@ UpdateWalk::SkipSymlink(const Directory *directory,
 #endif
 }
 
-bool
-UpdateWalk::UpdateDirectory(Directory &directory,
-			    const ExcludeList &exclude_list,
-			    const StorageFileInfo &info) noexcept
+inline bool
+UpdateWalk::IsUnchanged(const Directory &directory,
+			const StorageFileInfo &info) const noexcept
 {
-	assert(info.IsDirectory());
+	return skip_unchanged && !IsNegative(directory.mtime) &&
+		directory.mtime == info.mtime;
+}
 
-	directory_set_stat(directory, info);
+inline void
+UpdateWalk::UpdateUnchangedDirectory(Directory &directory,
+				     const ExcludeList &exclude_list) noexcept
+{
+	/* the list of entries is the same as in the last update, but
+	   the contents of subdirectories may have changed
+	   nonetheless */
 
-	std::unique_ptr<StorageDirectoryReader> reader;
+	skipped_directories = true;
 
-	try {
-		reader = storage.OpenDirectory(directory.GetPath());
-	} catch (...) {
-		LogError(std::current_exception());
-		return false;
-	}
+	directory.ForEachChildSafe([&](Directory &child){
+			if (cancel || child.IsMount() || child.IsReallyAFile())
+				return;
 
-	ExcludeList child_exclude_list(exclude_list);
+			StorageFileInfo info;
+			if (!GetInfo(storage, child.GetPath(), info) ||
+			    !info.IsDirectory() ||
+			    !UpdateDirectory(child, exclude_list, info)) {
+				editor.LockDeleteDirectory(&child);
+				modified = true;
+			}
+		});
+}
 
+void
+UpdateWalk::LoadExcludeList(ExcludeList &exclude_list,
+			    const char *uri_utf8) noexcept
+{
 	try {
 		Mutex mutex;
-		auto is = InputStream::OpenReady(PathTraitsUTF8::Build(storage.MapUTF8(directory.GetPath()).c_str(),
+		auto is = InputStream::OpenReady(PathTraitsUTF8::Build(storage.MapUTF8(uri_utf8).c_str(),
 								       ".mpdignore").c_str(),
 						 mutex);
-		child_exclude_list.Load(std::move(is));
+		exclude_list.Load(std::move(is));
 	} catch (...) {
 		if (!IsFileNotFound(std::current_exception()))
 			LogError(std::current_exception());
 	}
+}
+
+/**
+ * Is the given name (UTF-8) excluded by the #ExcludeList?
+ */
+gcc_pure
+static bool
+IsExcluded(const ExcludeList &exclude_list, const char *name_utf8) noexcept
+{
+	if (exclude_list.IsEmpty())
+		return false;
+
+	const auto name_fs = AllocatedPath::FromUTF8(name_utf8);
+	return name_fs.IsNull() || exclude_list.Check(name_fs);
+}
+
+bool
+UpdateWalk::UpdateDirectory(Directory &directory,
+			    const ExcludeList &exclude_list,
+			    const StorageFileInfo &info) noexcept
+{
+	assert(info.IsDirectory());
+
+	directory_set_stat(directory, info);
+
+	const auto scan_time = std::chrono::system_clock::now();
+	const bool unchanged = IsUnchanged(directory, info);
+
+	std::unique_ptr<StorageDirectoryReader> reader;
+
+	if (!unchanged) {
+		try {
+			reader = storage.OpenDirectory(directory.GetPath());
+		} catch (...) {
+			LogError(std::current_exception());
+			return false;
+		}
+	}
+
+	ExcludeList child_exclude_list(exclude_list);
+	LoadExcludeList(child_exclude_list, directory.GetPath());
 
 	if (!child_exclude_list.IsEmpty())
 		RemoveExcludedFromDirectory(directory, child_exclude_list);
 
-	PurgeDeletedFromDirectory(directory);
+	if (unchanged) {
+		UpdateUnchangedDirectory(directory, child_exclude_list);
+	} else {
+		PurgeDeletedFromDirectory(directory);
 
-	const char *name_utf8;
-	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
-		if (skip_path(name_utf8))
-			continue;
+		const char *name_utf8;
+		while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
+			if (skip_path(name_utf8))
+				continue;
 
-		{
-			const auto name_fs = AllocatedPath::FromUTF8(name_utf8);
-			if (name_fs.IsNull() || child_exclude_list.Check(name_fs))
+			if (IsExcluded(child_exclude_list, name_utf8))
 				continue;
-		}
 
-		if (SkipSymlink(&directory, name_utf8)) {
-			modified |= editor.DeleteNameIn(directory, name_utf8);
-			continue;
-		}
+			if (SkipSymlink(&directory, name_utf8)) {
+				modified |= editor.DeleteNameIn(directory, name_utf8);
+				continue;
+			}
 
-		StorageFileInfo info2;
-		if (!GetInfo(*reader, info2)) {
-			modified |= editor.DeleteNameIn(directory, name_utf8);
-			continue;
+			StorageFileInfo info2;
+			if (!GetInfo(*reader, info2)) {
+				modified |= editor.DeleteNameIn(directory, name_utf8);
+				continue;
+			}
+
+			UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
 		}
 
-		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
+		FlushScans(&directory);
+
+		if (config.loudness_analysis)
+			UpdateAlbumGain(directory);
+	}
+
+	if (child_exclude_list.HasPatterns()) {
+		/* this includes the names excluded in subdirectories
+		   which inherited this list */
+		const unsigned n = child_exclude_list.GetExcludedCount();
+		n_excluded += n;
+		FormatDebug(update_domain,
+			    "%u patterns in '%s/.mpdignore' excluded %u names",
+			    child_exclude_list.GetPatternCount(),
+			    directory.GetPath(), n);
 	}
 
-	directory.mtime = info.mtime;
+	/* the modification time has a resolution of one second; if
+	   the directory was modified in this second, another
+	   modification in the same second would go unnoticed, so
+	   don't let the next update skip it */
+	if (!config.skip_unchanged_directories ||
+	    info.mtime + std::chrono::seconds(1) <= scan_time)
+		directory.mtime = info.mtime;
 
 	return true;
 }
@@ -435,14 +521,82 @@ UpdateWalk::DirectoryMakeUriParentChecked(Directory &root,
 	return directory;
 }
 
+bool
+UpdateWalk::LoadAncestorExcludeLists(std::forward_list<ExcludeList> &exclude_lists,
+				     const char *uri) noexcept
+{
+	/* the root directory's .mpdignore is applied with an empty
+	   parent list, just like in a full update */
+	exclude_lists.emplace_front();
+	exclude_lists.emplace_front(exclude_lists.front());
+	LoadExcludeList(exclude_lists.front(), "");
+
+	const std::string uri_s(uri);
+	for (auto slash = uri_s.find('/'); slash != std::string::npos;
+	     slash = uri_s.find('/', slash + 1)) {
+		const std::string directory_uri = uri_s.substr(0, slash);
+		const char *name = PathTraitsUTF8::GetBase(directory_uri.c_str());
+		if (IsExcluded(exclude_lists.front(), name))
+			return false;
+
+		exclude_lists.emplace_front(exclude_lists.front());
+		LoadExcludeList(exclude_lists.front(), directory_uri.c_str());
+	}
+
+	return true;
+}
+
 inline void
 UpdateWalk::UpdateUri(Directory &root, const char *uri) noexcept
 try {
+	const char *name = PathTraitsUTF8::GetBase(uri);
+
+	/* a single entry is subject to the .mpdignore files of all
+	   its ancestors, just like in a full update; the front() is
+	   the list of its parent directory */
+	std::forward_list<ExcludeList> exclude_lists;
+	const bool excluded = !LoadAncestorExcludeLists(exclude_lists, uri) ||
+		(strcmp(name, ".mpdignore") != 0 &&
+		 IsExcluded(exclude_lists.front(), name));
+	if (excluded) {
+		++n_excluded;
+
+		/* remove it from the database if it was added before
+		   the pattern existed, but don't create any of its
+		   parent directories */
+		Directory *parent;
+		{
+			const ScopeDatabaseLock protect;
+			const auto lr = root.LookupDirectory(uri);
+			if (lr.uri == nullptr)
+				parent = lr.directory->parent;
+			else if (strcmp(lr.uri, name) == 0)
+				parent = lr.directory;
+			else
+				parent = nullptr;
+		}
+
+		if (parent != nullptr)
+			modified |= editor.DeleteNameIn(*parent, name);
+		return;
+	}
+
 	Directory *parent = DirectoryMakeUriParentChecked(root, uri);
 	if (parent == nullptr)
 		return;
 
-	const char *name = PathTraitsUTF8::GetBase(uri);
+	if (strcmp(name, ".mpdignore") == 0) {
+		/* the rules have changed: update the whole parent
+		   directory with them */
+		const std::string parent_uri = parent->GetPath();
+		StorageFileInfo info;
+		if (!GetInfo(storage, parent_uri.c_str(), info))
+			return;
+
+		exclude_lists.pop_front();
+		UpdateDirectory(*parent, exclude_lists.front(), info);
+		return;
+	}
 
 	if (SkipSymlink(parent, name)) {
 		modified |= editor.DeleteNameIn(*parent, name);
@@ -455,20 +609,45 @@ try {
 		return;
 	}
 
-	ExcludeList exclude_list;
+	if (info.IsDirectory())
+		storage.Prefetch(uri);
 
-	UpdateDirectoryChild(*parent, exclude_list, name, info);
+	UpdateDirectoryChild(*parent, exclude_lists.front(), name, info);
 } catch (...) {
 	LogError(std::current_exception());
 }
 
 bool
-UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
+UpdateWalk::Walk(Directory &root, const char *path,
+		 const std::set<std::string> &names, bool discard) noexcept
 {
 	walk_discard = discard;
 	modified = false;
+	n_excluded = 0;
+	skip_unchanged = false;
+	skipped_directories = false;
+
+	if (config.scan_threads > 1) {
+		try {
+			scan_pool = std::make_unique<ScanPool>(storage,
+							       config.scan_threads);
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to start scanner threads");
+		}
+	}
 
-	if (path != nullptr && !isRootDirectory(path)) {
+	if (!names.empty()) {
+		for (const auto &name : names) {
+			if (cancel)
+				break;
+
+			const auto uri = path == nullptr || isRootDirectory(path)
+				? name
+				: PathTraitsUTF8::Build(path, name.c_str());
+			UpdateUri(root, uri.c_str());
+		}
+	} else if (path != nullptr && !isRootDirectory(path)) {
 		UpdateUri(root, path);
 	} else {
 		StorageFileInfo info;
@@ -481,10 +660,35 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 			return false;
 		}
 
+		storage.Prefetch("");
+
 		ExcludeList exclude_list;
 
+		/* only a full update trusts the directory
+		   modification times; "update" with a path (e.g. from
+		   inotify) may be about files modified in place */
+		skip_unchanged = config.skip_unchanged_directories &&
+			!discard;
+
 		UpdateDirectory(root, exclude_list, info);
+
+		if (container_cache != nullptr && !cancel &&
+		    !skipped_directories)
+			/* all files of this storage have been
+			   visited; forget the ones which are gone */
+			container_cache->Prune(storage_uri);
+	}
+
+	if (scan_pool != nullptr) {
+		FlushScans(nullptr);
+		scan_pool.reset();
 	}
 
+	storage.ReleasePrefetch();
+
+	if (n_excluded > 0)
+		FormatDefault(update_domain,
+			      "%u names excluded by .mpdignore", n_excluded);
+
 	return modified;
 }
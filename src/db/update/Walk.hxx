@@ -21,11 +21,18 @@
 #define MPD_UPDATE_WALK_HXX
 
 #include "Config.hxx"
+#include "ChildPath.hxx"
 #include "Editor.hxx"
+#include "ScanPool.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
 #include <atomic>
+#include <forward_list>
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
 
 struct StorageFileInfo;
 struct Directory;
@@ -34,6 +41,7 @@ struct PlaylistPlugin;
 class ArchiveFile;
 class Storage;
 class ExcludeList;
+class ContainerCache;
 
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
@@ -42,9 +50,35 @@ class UpdateWalk final {
 
 	const UpdateConfig config;
 
+	/**
+	 * See UpdateService::container_cache; may be nullptr.
+	 */
+	ContainerCache *const container_cache;
+
 	bool walk_discard;
 	bool modified;
 
+	/**
+	 * The number of names excluded by .mpdignore files during
+	 * this Walk() call; only used for the log.
+	 */
+	unsigned n_excluded;
+
+	/**
+	 * Skip directories whose modification time has not changed
+	 * during this Walk() call?  See
+	 * UpdateConfig::skip_unchanged_directories.
+	 */
+	bool skip_unchanged;
+
+	/**
+	 * Has UpdateUnchangedDirectory() skipped the files of a
+	 * directory during this Walk() call?  Then not all files
+	 * have been visited, and the #container_cache must not be
+	 * pruned.
+	 */
+	bool skipped_directories;
+
 	/**
 	 * Set to true by the main thread when the update thread shall
 	 * cancel as quickly as possible.  Access to this flag is
@@ -54,12 +88,37 @@ class UpdateWalk final {
 
 	Storage &storage;
 
+	/**
+	 * The base URI of #storage, which identifies it in the
+	 * #container_cache.
+	 */
+	const std::string storage_uri;
+
+	/**
+	 * Maps directory children to local paths for SkipSymlink()
+	 * and the access check without allocating for each of them.
+	 */
+	mutable ChildPathBuilder child_path;
+
 	DatabaseEditor editor;
 
+	/**
+	 * Scans song files concurrently if configured; see
+	 * UpdateConfig::scan_threads.  Only exists while Walk() runs.
+	 */
+	std::unique_ptr<ScanPool> scan_pool;
+
+	/**
+	 * Jobs submitted to #scan_pool whose results have not been
+	 * applied to the database yet, in submission order.
+	 */
+	std::list<ScanPool::Job> scan_jobs;
+
 public:
 	UpdateWalk(const UpdateConfig &_config,
 		   EventLoop &_loop, DatabaseListener &_listener,
-		   Storage &_storage) noexcept;
+		   Storage &_storage,
+		   ContainerCache *_container_cache) noexcept;
 
 	/**
 	 * Cancel the current update and quit the Walk() method as
@@ -71,8 +130,12 @@ public:
 
 	/**
 	 * Returns true if the database was modified.
+	 *
+	 * @param names if not empty, then only these entries of the
+	 * directory #path are updated
 	 */
-	bool Walk(Directory &root, const char *path, bool discard) noexcept;
+	bool Walk(Directory &root, const char *path,
+		  const std::set<std::string> &names, bool discard) noexcept;
 
 private:
 	gcc_pure
@@ -84,10 +147,48 @@ private:
 
 	void PurgeDeletedFromDirectory(Directory &directory) noexcept;
 
+	/**
+	 * Has the given directory (which is about to be updated) not
+	 * been modified since the last update?
+	 */
+	gcc_pure
+	bool IsUnchanged(const Directory &directory,
+			 const StorageFileInfo &info) const noexcept;
+
+	/**
+	 * Update a directory whose list of entries has not changed:
+	 * skip its files and visit only its subdirectories.
+	 */
+	void UpdateUnchangedDirectory(Directory &directory,
+				      const ExcludeList &exclude_list) noexcept;
+
 	void UpdateSongFile2(Directory &directory,
 			     const char *name, const char *suffix,
 			     const StorageFileInfo &info) noexcept;
 
+	/**
+	 * Scan the given file in the #ScanPool.  The result is
+	 * applied by FlushScans().
+	 */
+	void SubmitScan(Directory &directory, Song *song,
+			const char *name) noexcept;
+
+	void ApplyScan(ScanPool::Job &job) noexcept;
+
+	/**
+	 * Calculate the album gain of all songs in the directory
+	 * whose track gain was measured by AnalyzeLoudness().
+	 */
+	void UpdateAlbumGain(Directory &directory) noexcept;
+
+	/**
+	 * Wait for the pending scans of the given directory (or all
+	 * of them if nullptr) and apply their results.  This must be
+	 * called before the directory's children have been modified
+	 * by somebody else, e.g. at the end of UpdateDirectory().
+	 */
+	void FlushScans(const Directory *directory) noexcept;
+
 	bool UpdateSongFile(Directory &directory,
 			    const char *name, const char *suffix,
 			    const StorageFileInfo &info) noexcept;
@@ -135,6 +236,25 @@ private:
 				  const char *name,
 				  const StorageFileInfo &info) noexcept;
 
+	/**
+	 * Load the .mpdignore file of the given directory (if it
+	 * exists) into the #ExcludeList.
+	 */
+	void LoadExcludeList(ExcludeList &exclude_list,
+			     const char *uri_utf8) noexcept;
+
+	/**
+	 * Load the .mpdignore files of all ancestors of the given
+	 * URI, starting at the root directory.  After returning, the
+	 * front() of the list is the one of the URI's parent
+	 * directory.
+	 *
+	 * @return false if one of the ancestor directories is
+	 * excluded
+	 */
+	bool LoadAncestorExcludeLists(std::forward_list<ExcludeList> &exclude_lists,
+				      const char *uri) noexcept;
+
 	bool UpdateDirectory(Directory &directory,
 			     const ExcludeList &exclude_list,
 			     const StorageFileInfo &info) noexcept;
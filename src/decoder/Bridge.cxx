@@ -26,6 +26,7 @@
 #include "MusicPipe.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
+#include "AudioTrace.hxx"
 #include "tag/Tag.hxx"
 #include "Log.hxx"
 #include "input/InputStream.hxx"
@@ -33,6 +34,7 @@
 #include "input/cache/Manager.hxx"
 #include "input/cache/Stream.hxx"
 #include "fs/Path.hxx"
+#include "thread/Util.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/StringBuffer.hxx"
 
@@ -52,6 +54,40 @@ DecoderBridge::~DecoderBridge() noexcept
 	assert(current_chunk == nullptr);
 }
 
+void
+DecoderBridge::BeginPlugin(const char *name) noexcept
+{
+	assert(plugin_cpu_start.count() < 0);
+
+	plugin_name = name;
+	plugin_cpu_start = GetCurrentThreadCPUTime();
+}
+
+void
+DecoderBridge::EndPlugin() noexcept
+{
+	if (plugin_cpu_start.count() >= 0) {
+		plugin_cpu_time += GetCurrentThreadCPUTime() - plugin_cpu_start;
+		plugin_cpu_start = std::chrono::nanoseconds(-1);
+	} else
+		plugin_cpu_time = std::chrono::nanoseconds(-1);
+}
+
+void
+DecoderBridge::UpdateStats() noexcept
+{
+	auto &stats = dc.stats;
+	stats.plugin = plugin_name;
+
+	stats.cpu_time = plugin_cpu_time;
+	if (stats.cpu_time.count() >= 0 && plugin_cpu_start.count() >= 0)
+		/* a plugin is still running */
+		stats.cpu_time += GetCurrentThreadCPUTime() - plugin_cpu_start;
+
+	stats.frames = submitted_frames;
+	stats.bytes_read = bytes_read;
+}
+
 InputStreamPtr
 DecoderBridge::OpenLocal(Path path_fs, const char *uri_utf8)
 {
@@ -117,12 +153,10 @@ DecoderBridge::GetChunk() noexcept
 		return current_chunk.get();
 
 	do {
-		current_chunk = dc.buffer->Allocate();
+		if (!dc.LockIsPipeLimitReached())
+			current_chunk = dc.buffer->Allocate();
 		if (current_chunk != nullptr) {
-			current_chunk->replay_gain_serial = replay_gain_serial;
-			if (replay_gain_serial != 0)
-				current_chunk->replay_gain_info = replay_gain_info;
-
+			current_chunk->replay_gain_info = replay_gain_info;
 			return current_chunk.get();
 		}
 
@@ -141,10 +175,14 @@ DecoderBridge::FlushChunk() noexcept
 	assert(current_chunk != nullptr);
 
 	auto chunk = std::move(current_chunk);
-	if (!chunk->IsEmpty())
+	if (!chunk->IsEmpty()) {
+		TraceAudio(AudioTraceEvent::DECODER_SUBMIT, chunk.get(),
+			   chunk->time, &dc, chunk->length);
 		dc.pipe->Push(std::move(chunk));
+	}
 
 	const std::lock_guard<Mutex> protect(dc.mutex);
+	UpdateStats();
 	dc.client_cond.notify_one();
 }
 
@@ -211,7 +249,7 @@ DecoderBridge::LockGetVirtualCommand() noexcept
 }
 
 DecoderCommand
-DecoderBridge::DoSendTag(const Tag &tag) noexcept
+DecoderBridge::DoSendTag(std::shared_ptr<const Tag> tag) noexcept
 {
 	if (current_chunk != nullptr) {
 		/* there is a partial chunk - flush it, we want the
@@ -227,7 +265,7 @@ DecoderBridge::DoSendTag(const Tag &tag) noexcept
 		return dc.command;
 	}
 
-	chunk->tag = std::make_unique<Tag>(tag);
+	chunk->tag = std::move(tag);
 	return DecoderCommand::NONE;
 }
 
@@ -252,6 +290,12 @@ DecoderBridge::UpdateStreamTag(InputStream *is) noexcept
 	return true;
 }
 
+bool
+DecoderBridge::PreferFloat() const noexcept
+{
+	return dc.PreferFloat();
+}
+
 void
 DecoderBridge::Ready(const AudioFormat audio_format,
 		     bool seekable, SignedSongTime duration) noexcept
@@ -268,6 +312,7 @@ DecoderBridge::Ready(const AudioFormat audio_format,
 	{
 		const std::lock_guard<Mutex> protect(dc.mutex);
 		dc.SetReady(audio_format, seekable, duration);
+		dc.stats.sample_rate = audio_format.sample_rate;
 	}
 
 	if (dc.in_audio_format != dc.out_audio_format) {
@@ -424,12 +469,38 @@ try {
 	size_t nbytes = is.Read(lock, buffer, length);
 	assert(nbytes > 0 || is.IsEOF());
 
+	bytes_read += nbytes;
+
 	return nbytes;
 } catch (...) {
 	error = std::current_exception();
 	return 0;
 }
 
+ConstBuffer<void>
+DecoderBridge::ReadDirect(InputStream &is) noexcept
+try {
+	assert(dc.state == DecoderState::START ||
+	       dc.state == DecoderState::DECODE);
+
+	std::unique_lock<Mutex> lock(is.mutex);
+
+	while (true) {
+		if (CheckCancelRead())
+			return nullptr;
+
+		if (is.IsAvailable())
+			break;
+
+		dc.cond.wait(lock);
+	}
+
+	return is.PeekDirect(lock);
+} catch (...) {
+	error = std::current_exception();
+	return nullptr;
+}
+
 void
 DecoderBridge::SubmitTimestamp(FloatDuration t) noexcept
 {
@@ -439,19 +510,12 @@ DecoderBridge::SubmitTimestamp(FloatDuration t) noexcept
 	absolute_frame = uint64_t(t.count() * dc.in_audio_format.sample_rate);
 }
 
-DecoderCommand
-DecoderBridge::SubmitData(InputStream *is,
-			  const void *data, size_t length,
-			  uint16_t kbit_rate) noexcept
+inline DecoderCommand
+DecoderBridge::PrepareSubmit(InputStream *is) noexcept
 {
-	assert(dc.state == DecoderState::DECODE);
-	assert(dc.pipe != nullptr);
-	assert(length % dc.in_audio_format.GetFrameSize() == 0);
-
 	DecoderCommand cmd = LockGetVirtualCommand();
 
-	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK ||
-	    length == 0)
+	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK)
 		return cmd;
 
 	assert(!initial_seek_pending);
@@ -460,32 +524,55 @@ DecoderBridge::SubmitData(InputStream *is,
 	/* send stream tags */
 
 	if (UpdateStreamTag(is)) {
-		if (decoder_tag != nullptr)
-			/* merge with tag from decoder plugin */
-			cmd = DoSendTag(*Tag::Merge(*decoder_tag,
-						    *stream_tag));
-		else
-			/* send only the stream tag */
-			cmd = DoSendTag(*stream_tag);
+		/* merge with tag from decoder plugin (if any) */
+		cmd = DoSendTag(Tag::Merge(decoder_tag, stream_tag));
 
 		if (cmd != DecoderCommand::NONE)
 			return cmd;
 	}
 
-	cmd = DecoderCommand::NONE;
+	return DecoderCommand::NONE;
+}
+
+uint64_t
+DecoderBridge::GetRemainingFrames() const noexcept
+{
+	if (!dc.end_time.IsPositive())
+		return UINT64_MAX;
+
+	const uint64_t end_frame =
+		dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate);
+	return absolute_frame < end_frame
+		? end_frame - absolute_frame
+		: 0;
+}
+
+DecoderCommand
+DecoderBridge::SubmitData(InputStream *is,
+			  const void *data, size_t length,
+			  uint16_t kbit_rate) noexcept
+{
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+	assert(length % dc.in_audio_format.GetFrameSize() == 0);
+
+	if (length == 0)
+		return LockGetVirtualCommand();
+
+	DecoderCommand cmd = PrepareSubmit(is);
+	if (cmd != DecoderCommand::NONE)
+		return cmd;
 
 	const size_t frame_size = dc.in_audio_format.GetFrameSize();
 	size_t data_frames = length / frame_size;
 
-	if (dc.end_time.IsPositive()) {
+	{
 		/* enforce the given end time */
 
-		const uint64_t end_frame =
-			dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate);
-		if (absolute_frame >= end_frame)
+		const uint64_t remaining_frames = GetRemainingFrames();
+		if (remaining_frames == 0)
 			return DecoderCommand::STOP;
 
-		const uint64_t remaining_frames = end_frame - absolute_frame;
 		if (data_frames >= remaining_frames) {
 			/* past the end of the range: truncate this
 			   data submission and stop the decoder */
@@ -554,6 +641,79 @@ DecoderBridge::SubmitData(InputStream *is,
 	}
 
 	absolute_frame += data_frames;
+	submitted_frames += data_frames;
+
+	return cmd;
+}
+
+WritableBuffer<void>
+DecoderBridge::GetSubmitBuffer(InputStream *is, uint16_t kbit_rate) noexcept
+{
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+
+	if (convert != nullptr)
+		/* the data needs to be converted; the plugin needs
+		   to use SubmitData() */
+		return nullptr;
+
+	assert(dc.in_audio_format == dc.out_audio_format);
+
+	if (PrepareSubmit(is) != DecoderCommand::NONE)
+		return nullptr;
+
+	const uint64_t remaining_frames = GetRemainingFrames();
+	if (remaining_frames == 0)
+		/* let SubmitData() return DecoderCommand::STOP */
+		return nullptr;
+
+	while (true) {
+		auto *chunk = GetChunk();
+		if (chunk == nullptr) {
+			assert(dc.command != DecoderCommand::NONE);
+			return nullptr;
+		}
+
+		auto dest = chunk->Write(dc.out_audio_format,
+					 SongTime::Cast(timestamp) -
+					 dc.song->GetStartTime(),
+					 kbit_rate);
+		if (dest.empty()) {
+			/* the chunk is full, flush it */
+			FlushChunk();
+			continue;
+		}
+
+		const size_t frame_size = dc.out_audio_format.GetFrameSize();
+		if (dest.size / frame_size > remaining_frames)
+			dest.size = remaining_frames * frame_size;
+
+		return dest;
+	}
+}
+
+DecoderCommand
+DecoderBridge::CommitSubmitBuffer(size_t length) noexcept
+{
+	assert(current_chunk != nullptr);
+	assert(convert == nullptr);
+	assert(length % dc.out_audio_format.GetFrameSize() == 0);
+
+	const uint64_t data_frames =
+		length / dc.out_audio_format.GetFrameSize();
+
+	DecoderCommand cmd = DecoderCommand::NONE;
+	if (data_frames >= GetRemainingFrames())
+		/* the end time has been reached */
+		cmd = DecoderCommand::STOP;
+
+	if (current_chunk->Expand(dc.out_audio_format, length))
+		/* the chunk is full, flush it */
+		FlushChunk();
+
+	timestamp += dc.out_audio_format.SizeToTime<FloatDuration>(length);
+	absolute_frame += data_frames;
+	submitted_frames += data_frames;
 
 	return cmd;
 }
@@ -568,7 +728,7 @@ DecoderBridge::SubmitTag(InputStream *is, Tag &&tag) noexcept
 
 	/* save the tag */
 
-	decoder_tag = std::make_unique<Tag>(std::move(tag));
+	decoder_tag = std::make_shared<Tag>(std::move(tag));
 
 	/* check for a new stream tag */
 
@@ -584,12 +744,9 @@ DecoderBridge::SubmitTag(InputStream *is, Tag &&tag) noexcept
 
 	/* send tag to music pipe */
 
-	if (stream_tag != nullptr)
-		/* merge with tag from input stream */
-		cmd = DoSendTag(*Tag::Merge(*stream_tag, *decoder_tag));
-	else
-		/* send only the decoder tag */
-		cmd = DoSendTag(*decoder_tag);
+	/* merge with tag from input stream (if any); the
+	   decoder tag is shared with the chunk, not copied */
+	cmd = DoSendTag(Tag::Merge(stream_tag, decoder_tag));
 
 	return cmd;
 }
@@ -597,11 +754,12 @@ DecoderBridge::SubmitTag(InputStream *is, Tag &&tag) noexcept
 void
 DecoderBridge::SubmitReplayGain(const ReplayGainInfo *new_replay_gain_info) noexcept
 {
-	if (new_replay_gain_info != nullptr) {
-		static unsigned serial;
-		if (++serial == 0)
-			serial = 1;
+	if (new_replay_gain_info != nullptr &&
+	    !new_replay_gain_info->IsDefined() && replay_gain_info != nullptr)
+		/* keep the values measured by the database update */
+		return;
 
+	if (new_replay_gain_info != nullptr) {
 		if (ReplayGainMode::OFF != dc.replay_gain_mode) {
 			ReplayGainMode rgm = dc.replay_gain_mode;
 			if (rgm != ReplayGainMode::ALBUM)
@@ -613,8 +771,8 @@ DecoderBridge::SubmitReplayGain(const ReplayGainInfo *new_replay_gain_info) noex
 			dc.replay_gain_db = 20.0 * log10f(scale);
 		}
 
-		replay_gain_info = *new_replay_gain_info;
-		replay_gain_serial = serial;
+		replay_gain_info =
+			std::make_shared<ReplayGainInfo>(*new_replay_gain_info);
 
 		if (current_chunk != nullptr) {
 			/* flush the current chunk because the new
@@ -623,7 +781,7 @@ DecoderBridge::SubmitReplayGain(const ReplayGainInfo *new_replay_gain_info) noex
 			FlushChunk();
 		}
 	} else
-		replay_gain_serial = 0;
+		replay_gain_info.reset();
 }
 
 void
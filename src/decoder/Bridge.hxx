@@ -24,6 +24,7 @@
 #include "ReplayGainInfo.hxx"
 #include "MusicChunkPtr.hxx"
 
+#include <chrono>
 #include <exception>
 #include <memory>
 
@@ -87,22 +88,20 @@ private:
 
 public:
 	/** the last tag received from the stream */
-	std::unique_ptr<Tag> stream_tag;
+	std::shared_ptr<const Tag> stream_tag;
 
 	/** the last tag received from the decoder plugin */
-	std::unique_ptr<Tag> decoder_tag;
+	std::shared_ptr<const Tag> decoder_tag;
 
 private:
 	/** the chunk currently being written to */
 	MusicChunkPtr current_chunk;
 
-	ReplayGainInfo replay_gain_info;
-
 	/**
-	 * A positive serial number for checking if replay gain info
-	 * has changed since the last check.
+	 * The replay gain info which is attached to new chunks;
+	 * nullptr if there is none.
 	 */
-	unsigned replay_gain_serial = 0;
+	std::shared_ptr<const ReplayGainInfo> replay_gain_info;
 
 	/**
 	 * An error has occurred (in DecoderAPI.cxx), and the plugin
@@ -110,6 +109,35 @@ private:
 	 */
 	std::exception_ptr error;
 
+	/**
+	 * The name of the decoder plugin which is currently running;
+	 * see BeginPlugin().
+	 */
+	const char *plugin_name = nullptr;
+
+	/**
+	 * The thread CPU time when the current plugin was started,
+	 * or negative if no plugin is running or the CPU time is
+	 * unknown.
+	 */
+	std::chrono::nanoseconds plugin_cpu_start{-1};
+
+	/**
+	 * The CPU time consumed by the plugins which have finished
+	 * already.
+	 */
+	std::chrono::nanoseconds plugin_cpu_time = std::chrono::nanoseconds::zero();
+
+	/**
+	 * The number of PCM frames submitted by the plugins.
+	 */
+	uint64_t submitted_frames = 0;
+
+	/**
+	 * The number of bytes read by the plugins with Read().
+	 */
+	uint64_t bytes_read = 0;
+
 public:
 	DecoderBridge(DecoderControl &_dc, bool _initial_seek_pending,
 		      std::unique_ptr<Tag> _tag) noexcept;
@@ -154,12 +182,35 @@ public:
 			std::rethrow_exception(error);
 	}
 
+	/**
+	 * A decoder plugin is about to be invoked; start accounting
+	 * the CPU time of this thread.
+	 *
+	 * Caller must not lock the #DecoderControl object.
+	 */
+	void BeginPlugin(const char *name) noexcept;
+
+	/**
+	 * The decoder plugin has returned (or thrown).
+	 *
+	 * Caller must not lock the #DecoderControl object.
+	 */
+	void EndPlugin() noexcept;
+
+	/**
+	 * Copy the accounting counters to DecoderControl::stats.
+	 *
+	 * Caller must lock the #DecoderControl object.
+	 */
+	void UpdateStats() noexcept;
+
 	/**
 	 * Open a local file.
 	 */
 	InputStreamPtr OpenLocal(Path path_fs, const char *uri_utf8);
 
 	/* virtual methods from DecoderClient */
+	bool PreferFloat() const noexcept override;
 	void Ready(AudioFormat audio_format,
 		   bool seekable, SignedSongTime duration) noexcept override;
 	DecoderCommand GetCommand() noexcept override;
@@ -170,10 +221,14 @@ public:
 	InputStreamPtr OpenUri(const char *uri) override;
 	size_t Read(InputStream &is,
 		    void *buffer, size_t length) noexcept override;
+	ConstBuffer<void> ReadDirect(InputStream &is) noexcept override;
 	void SubmitTimestamp(FloatDuration t) noexcept override;
 	DecoderCommand SubmitData(InputStream *is,
 				  const void *data, size_t length,
 				  uint16_t kbit_rate) noexcept override;
+	WritableBuffer<void> GetSubmitBuffer(InputStream *is,
+					     uint16_t kbit_rate) noexcept override;
+	DecoderCommand CommitSubmitBuffer(size_t length) noexcept override;
 	DecoderCommand SubmitTag(InputStream *is, Tag &&tag) noexcept override;
 	void SubmitReplayGain(const ReplayGainInfo *replay_gain_info) noexcept override;
 	void SubmitMixRamp(MixRampInfo &&mix_ramp) noexcept override;
@@ -197,9 +252,25 @@ private:
 	 * Sends a #Tag as-is to the #MusicPipe.  Flushes the current
 	 * chunk (DecoderBridge::chunk) if there is one.
 	 */
-	DecoderCommand DoSendTag(const Tag &tag) noexcept;
+	DecoderCommand DoSendTag(std::shared_ptr<const Tag> tag) noexcept;
 
 	bool UpdateStreamTag(InputStream *is) noexcept;
+
+	/**
+	 * The common part of SubmitData() and GetSubmitBuffer():
+	 * check the command and send stream tags.
+	 */
+	DecoderCommand PrepareSubmit(InputStream *is) noexcept;
+
+	/**
+	 * How many frames may still be submitted until
+	 * DecoderControl::end_time is reached?
+	 *
+	 * @return the number of frames or UINT64_MAX if there is no
+	 * end time
+	 */
+	gcc_pure
+	uint64_t GetRemainingFrames() const noexcept;
 };
 
 #endif
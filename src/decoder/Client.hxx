@@ -23,6 +23,8 @@
 #include "Command.hxx"
 #include "Chrono.hxx"
 #include "input/Ptr.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Compiler.h"
 
 #include <stdint.h>
@@ -37,6 +39,19 @@ class MixRampInfo;
  */
 class DecoderClient {
 public:
+	/**
+	 * Does the client prefer floating point samples?  Decoder
+	 * plugins which are able to produce both integer and floating
+	 * point samples should then pass SampleFormat::FLOAT to
+	 * Ready(), to avoid converting back and forth.
+	 *
+	 * The default implementation returns false.
+	 */
+	gcc_pure
+	virtual bool PreferFloat() const noexcept {
+		return false;
+	}
+
 	/**
 	 * Notify the client that it has finished initialization and
 	 * that it has read the song's meta data.
@@ -110,6 +125,21 @@ public:
 	virtual size_t Read(InputStream &is,
 			    void *buffer, size_t length) noexcept = 0;
 
+	/**
+	 * Blocking zero-copy read from the input stream; see
+	 * InputStream::PeekDirect().  After using the data, call
+	 * InputStream::ConsumeDirect().
+	 *
+	 * The default implementation returns nullptr.
+	 *
+	 * @return the data, or nullptr if the stream does not
+	 * support direct access (use Read() instead), or on end of
+	 * file, error or command (like SEEK or STOP)
+	 */
+	virtual ConstBuffer<void> ReadDirect(InputStream &) noexcept {
+		return nullptr;
+	}
+
 	/**
 	 * Sets the time stamp for the next data chunk [seconds].  The MPD
 	 * core automatically counts it up, and a decoder plugin only needs to
@@ -139,6 +169,47 @@ public:
 		return SubmitData(&is, data, length, kbit_rate);
 	}
 
+	/**
+	 * Obtain a buffer where the decoder plugin can write PCM data
+	 * directly, instead of passing its own buffer to
+	 * SubmitData(); this avoids copying the data once more.  The
+	 * data must be in the audio format which was passed to
+	 * Ready().  After writing, call CommitSubmitBuffer().
+	 *
+	 * This may return a buffer which is smaller than the data the
+	 * plugin has; call this method again after
+	 * CommitSubmitBuffer().
+	 *
+	 * The default implementation returns nullptr.
+	 *
+	 * @param is like in SubmitData()
+	 * @return a buffer whose size is a multiple of the frame size,
+	 * or nullptr if this is not possible currently (e.g. because
+	 * the data needs to be converted or because a command is
+	 * pending); in that case, the plugin must use SubmitData()
+	 */
+	virtual WritableBuffer<void> GetSubmitBuffer(InputStream *,
+						     uint16_t) noexcept {
+		return nullptr;
+	}
+
+	/**
+	 * Submit the data which was written to the buffer returned by
+	 * GetSubmitBuffer().
+	 *
+	 * @param length the number of bytes which were written; must
+	 * be a multiple of the frame size and must not be larger than
+	 * the buffer
+	 * @return the current command, or DecoderCommand::NONE if there is no
+	 * command pending
+	 */
+	virtual DecoderCommand CommitSubmitBuffer(size_t) noexcept {
+		/* not reachable, because the default
+		   GetSubmitBuffer() implementation never returns a
+		   buffer */
+		return DecoderCommand::NONE;
+	}
+
 	/**
 	 * This function is called by the decoder plugin when it has
 	 * successfully decoded a tag.
@@ -53,6 +53,13 @@ DecoderControl::SetReady(const AudioFormat audio_format,
 	in_audio_format = audio_format;
 	out_audio_format = audio_format.WithMask(configured_audio_format);
 
+	if (float_pipeline &&
+	    configured_audio_format.format == SampleFormat::UNDEFINED &&
+	    out_audio_format.format != SampleFormat::DSD)
+		/* keep DSD as-is, because it may be passed to the
+		   DAC natively */
+		out_audio_format.format = SampleFormat::FLOAT;
+
 	seekable = _seekable;
 	total_time = _duration;
 
@@ -77,6 +84,12 @@ DecoderControl::IsCurrentSong(const DetachedSong &_song) const noexcept
 	gcc_unreachable();
 }
 
+bool
+DecoderControl::IsPipeLimitReached() const noexcept
+{
+	return pipe_limit > 0 && pipe->GetSize() >= pipe_limit;
+}
+
 void
 DecoderControl::Start(std::unique_lock<Mutex> &lock,
 		      std::unique_ptr<DetachedSong> _song,
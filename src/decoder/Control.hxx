@@ -21,6 +21,7 @@
 #define MPD_DECODER_CONTROL_HXX
 
 #include "Command.hxx"
+#include "Stats.hxx"
 #include "AudioFormat.hxx"
 #include "MixRampInfo.hxx"
 #include "input/Handler.hxx"
@@ -153,6 +154,13 @@ public:
 
 	SignedSongTime total_time;
 
+	/**
+	 * Resource accounting of the current (or the most recent)
+	 * song; see DecoderBridge::UpdateStats().  Protected by
+	 * #mutex.
+	 */
+	DecoderStats stats;
+
 	/** the #MusicChunk allocator */
 	MusicBuffer *buffer;
 
@@ -165,6 +173,33 @@ public:
 	const ReplayGainConfig replay_gain_config;
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
+	/**
+	 * Attempt to give the decoder thread real-time scheduling
+	 * ("low_latency")?  Must be set before StartThread().
+	 */
+	bool realtime = false;
+
+	/**
+	 * Convert all PCM data to floating point
+	 * ("float_pipeline")?  Must be set before StartThread().
+	 */
+	bool float_pipeline = false;
+
+	/**
+	 * Subscribe to a #SharedDecoder when playing a remote
+	 * stream ("shared_decoder")?
+	 */
+	bool shared_decoder = false;
+
+	/**
+	 * If non-zero, then the decoder thread waits (as if the
+	 * #MusicBuffer was full) while its #pipe contains at least
+	 * this number of chunks.  This is used by the player's
+	 * look-ahead decoder, which must not starve the decoder of
+	 * the current song.
+	 */
+	unsigned pipe_limit = 0;
+
 	float replay_gain_db = 0;
 	float replay_gain_prev_db = 0;
 
@@ -182,6 +217,15 @@ public:
 		       const ReplayGainConfig &_replay_gain_config) noexcept;
 	~DecoderControl() noexcept;
 
+	/**
+	 * Returns the CPU time consumed by the decoder thread; see
+	 * Thread::GetCPUTime().
+	 */
+	gcc_pure
+	std::chrono::nanoseconds GetCPUTime() const noexcept {
+		return thread.GetCPUTime();
+	}
+
 	/**
 	 * Throws on error.
 	 */
@@ -234,6 +278,30 @@ public:
 		return state == DecoderState::START;
 	}
 
+	/**
+	 * Has #pipe_limit been reached?
+	 *
+	 * Caller must lock the object.
+	 */
+	gcc_pure
+	bool IsPipeLimitReached() const noexcept;
+
+	gcc_pure
+	bool LockIsPipeLimitReached() const noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		return IsPipeLimitReached();
+	}
+
+	/**
+	 * Shall decoder plugins produce floating point samples if
+	 * they can?  See DecoderClient::PreferFloat().
+	 */
+	gcc_pure
+	bool PreferFloat() const noexcept {
+		return float_pipeline ||
+			configured_audio_format.format == SampleFormat::FLOAT;
+	}
+
 	gcc_pure
 	bool LockIsStarting() const noexcept {
 		const std::lock_guard<Mutex> protect(mutex);
@@ -407,15 +475,15 @@ public:
 
 	void Quit() noexcept;
 
-	const char *GetMixRampStart() const noexcept {
+	const MixRampCurve &GetMixRampStart() const noexcept {
 		return mix_ramp.GetStart();
 	}
 
-	const char *GetMixRampEnd() const noexcept {
+	const MixRampCurve &GetMixRampEnd() const noexcept {
 		return mix_ramp.GetEnd();
 	}
 
-	const char *GetMixRampPreviousEnd() const noexcept {
+	const MixRampCurve &GetMixRampPreviousEnd() const noexcept {
 		return previous_mix_ramp.GetEnd();
 	}
 
@@ -423,6 +491,20 @@ public:
 		mix_ramp = std::move(new_value);
 	}
 
+	/**
+	 * Copy the MixRamp and ReplayGain information of the song
+	 * decoded by another #DecoderControl, as if this object had
+	 * decoded it.  When the next song starts, it becomes the
+	 * "previous" information.  This is used by the player's
+	 * look-ahead decoder.
+	 *
+	 * Caller must lock the object.
+	 */
+	void InheritMixRamp(const DecoderControl &other) noexcept {
+		mix_ramp = other.mix_ramp;
+		replay_gain_db = other.replay_gain_db;
+	}
+
 	/**
 	 * Move mixramp_end to mixramp_prev_end and clear
 	 * mixramp_start/mixramp_end.
@@ -42,6 +42,29 @@ decoder_read(DecoderClient *client,
 	}
 }
 
+ConstBuffer<void>
+decoder_read_direct(DecoderClient *client, InputStream &is) noexcept
+{
+	/* XXX don't allow client==nullptr */
+	if (client != nullptr)
+		return client->ReadDirect(is);
+
+	try {
+		std::unique_lock<Mutex> lock(is.mutex);
+		return is.PeekDirect(lock);
+	} catch (...) {
+		LogError(std::current_exception());
+		return nullptr;
+	}
+}
+
+void
+decoder_consume_direct(InputStream &is, size_t nbytes) noexcept
+{
+	const std::lock_guard<Mutex> protect(is.mutex);
+	is.ConsumeDirect(nbytes);
+}
+
 bool
 decoder_read_full(DecoderClient *client, InputStream &is,
 		  void *_buffer, size_t size)
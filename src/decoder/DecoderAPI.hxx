@@ -72,6 +72,24 @@ decoder_read(DecoderClient &decoder, InputStream &is,
 	return decoder_read(&decoder, is, buffer, length);
 }
 
+/**
+ * Blocking zero-copy read from the input stream; see
+ * DecoderClient::ReadDirect().  After using the data, call
+ * decoder_consume_direct().
+ *
+ * @return the data, or nullptr if the stream does not support direct
+ * access (use decoder_read() instead), or on end of file, error or
+ * command (like SEEK or STOP)
+ */
+ConstBuffer<void>
+decoder_read_direct(DecoderClient *decoder, InputStream &is) noexcept;
+
+/**
+ * Consume data which was returned by decoder_read_direct().
+ */
+void
+decoder_consume_direct(InputStream &is, size_t nbytes) noexcept;
+
 /**
  * Blocking read from the input stream.  Attempts to fill the buffer
  * completely; there is no partial result.
@@ -19,10 +19,40 @@
 
 #include "DecoderBuffer.hxx"
 #include "DecoderAPI.hxx"
+#include "input/InputStream.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+DecoderBuffer::DecoderBuffer(DecoderClient *_client, InputStream &_is,
+			     size_t _size, size_t _max_size) noexcept
+	:client(_client), is(_is), buffer(_size),
+	 max_size(_is.CheapSeeking() ? 0 : _max_size)
+{
+}
 
 bool
 DecoderBuffer::Fill()
 {
+	if (direct.empty() && buffer.empty()) {
+		direct = decoder_read_direct(client, is);
+		if (!direct.empty())
+			return true;
+	} else if (!direct.empty()) {
+		/* the caller needs more than the stream provides
+		   directly; copy it to the buffer and append more
+		   data from the stream */
+		auto w = buffer.Write();
+		const size_t nbytes = std::min(w.size, direct.size);
+		memcpy(w.data, direct.data, nbytes);
+		buffer.Append(nbytes);
+		Consume(nbytes);
+		direct = nullptr;
+		return true;
+	}
+
 	auto w = buffer.Write();
 	if (w.empty())
 		/* buffer is full */
@@ -36,6 +66,13 @@ DecoderBuffer::Fill()
 		return false;
 
 	buffer.Append(nbytes);
+
+	if (nbytes == w.size && buffer.GetCapacity() < max_size)
+		/* the stream had more data than we could take; grow
+		   the buffer, so the next Fill() call gets more of
+		   it at once */
+		buffer.Grow(std::min(buffer.GetCapacity() * 2, max_size));
+
 	return true;
 }
 
@@ -52,9 +89,32 @@ DecoderBuffer::Need(size_t min_size)
 	}
 }
 
+void
+DecoderBuffer::Consume(size_t nbytes) noexcept
+{
+	if (!direct.empty()) {
+		assert(nbytes <= direct.size);
+
+		decoder_consume_direct(is, nbytes);
+		direct.data = (const uint8_t *)direct.data + nbytes;
+		direct.size -= nbytes;
+		return;
+	}
+
+	buffer.Consume(nbytes);
+}
+
 bool
 DecoderBuffer::Skip(size_t nbytes)
 {
+	if (!direct.empty()) {
+		const size_t n = std::min(nbytes, direct.size);
+		Consume(n);
+		nbytes -= n;
+		if (nbytes == 0)
+			return true;
+	}
+
 	const auto r = buffer.Read();
 	if (r.size >= nbytes) {
 		buffer.Consume(nbytes);
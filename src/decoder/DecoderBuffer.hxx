@@ -41,18 +41,43 @@ class DecoderBuffer {
 
 	DynamicFifoBuffer<uint8_t> buffer;
 
+	/**
+	 * The #buffer may grow up to this size; see Fill().  This is
+	 * zero for streams with cheap seeking (i.e. local files),
+	 * where small reads are cheap.
+	 */
+	const size_t max_size;
+
+	/**
+	 * Data obtained with decoder_read_direct() which has not yet
+	 * been consumed.  While this is not empty, #buffer is empty;
+	 * this avoids copying data from streams which support
+	 * InputStream::PeekDirect().
+	 */
+	ConstBuffer<void> direct = nullptr;
+
 public:
+	/**
+	 * The default value for the "max_size" constructor
+	 * parameter.
+	 */
+	static constexpr size_t DEFAULT_MAX_SIZE = 256 * 1024;
+
 	/**
 	 * Creates a new buffer.
 	 *
 	 * @param _client the decoder client, used for decoder_read(),
 	 * may be nullptr
 	 * @param _is the input stream object where we should read from
-	 * @param _size the maximum size of the buffer
+	 * @param _size the initial size of the buffer
+	 * @param _max_size the buffer may grow up to this size if the
+	 * stream is remote and provides data faster than it is
+	 * consumed; this coalesces many small reads (each of which
+	 * locks the stream's mutex) into few large ones
 	 */
 	DecoderBuffer(DecoderClient *_client, InputStream &_is,
-		      size_t _size)
-		:client(_client), is(_is), buffer(_size) {}
+		      size_t _size,
+		      size_t _max_size=DEFAULT_MAX_SIZE) noexcept;
 
 	const InputStream &GetStream() const noexcept {
 		return is;
@@ -60,6 +85,7 @@ public:
 
 	void Clear() noexcept {
 		buffer.Clear();
+		direct = nullptr;
 	}
 
 	/**
@@ -76,7 +102,7 @@ public:
 	 */
 	gcc_pure
 	size_t GetAvailable() const noexcept {
-		return buffer.GetAvailable();
+		return direct.empty() ? buffer.GetAvailable() : direct.size;
 	}
 
 	/**
@@ -85,6 +111,9 @@ public:
 	 * becomes invalid after a Fill() or a Consume() call.
 	 */
 	ConstBuffer<void> Read() const noexcept {
+		if (!direct.empty())
+			return direct;
+
 		auto r = buffer.Read();
 		return { r.data, r.size };
 	}
@@ -102,9 +131,7 @@ public:
 	 *
 	 * @param nbytes the number of bytes to consume
 	 */
-	void Consume(size_t nbytes) noexcept {
-		buffer.Consume(nbytes);
-	}
+	void Consume(size_t nbytes) noexcept;
 
 	/**
 	 * Skips the specified number of bytes, discarding its data.
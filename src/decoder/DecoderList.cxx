@@ -21,6 +21,8 @@
 #include "DecoderList.hxx"
 #include "DecoderPlugin.hxx"
 #include "PluginUnavailable.hxx"
+#include "PluginInit.hxx"
+#include "SeekTableCache.hxx"
 #include "Log.hxx"
 #include "config/Data.hxx"
 #include "config/Block.hxx"
@@ -47,8 +49,13 @@
 #include "plugins/FluidsynthDecoderPlugin.hxx"
 #include "plugins/SidplayDecoderPlugin.hxx"
 #include "util/RuntimeError.hxx"
+#include "util/CharUtil.hxx"
 
+#include <chrono>
 #include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <string.h>
 
@@ -121,20 +128,145 @@ static constexpr unsigned num_decoder_plugins =
 	std::size(decoder_plugins) - 1;
 
 /** which plugins have been initialized successfully? */
-bool decoder_plugins_enabled[num_decoder_plugins];
+LazyPluginState decoder_plugin_states[num_decoder_plugins];
+
+/**
+ * The configuration of each (enabled) plugin, for lazy
+ * initialization.
+ */
+static const ConfigBlock *decoder_plugin_blocks[num_decoder_plugins];
+
+/**
+ * Used for plugins without a "decoder" block.
+ */
+static const ConfigBlock empty_decoder_block;
+
+/**
+ * Serializes lazy plugin initializations.
+ */
+static Mutex decoder_plugins_init_mutex;
+
+/**
+ * Maps a lower-case name (file name suffix or MIME type) to the
+ * indices of all enabled plugins which support it, in ascending
+ * order (i.e. by priority).
+ */
+using DecoderPluginTable =
+	std::unordered_map<std::string, std::vector<unsigned>>;
+
+static DecoderPluginTable decoder_plugins_by_suffix;
+static DecoderPluginTable decoder_plugins_by_mime_type;
+
+static std::string
+LowerCase(const char *s) noexcept
+{
+	std::string result(s);
+	for (auto &ch : result)
+		ch = ToLowerASCII(ch);
+	return result;
+}
+
+static void
+AddToTable(DecoderPluginTable &table, const char *const*names,
+	   unsigned i) noexcept
+{
+	if (names == nullptr)
+		return;
+
+	for (; *names != nullptr; ++names) {
+		auto &v = table[LowerCase(*names)];
+		/* a plugin may list a name twice */
+		if (v.empty() || v.back() != i)
+			v.push_back(i);
+	}
+}
+
+gcc_pure
+static ConstBuffer<unsigned>
+LookupTable(const DecoderPluginTable &table, const char *name) noexcept
+{
+	if (name == nullptr)
+		return nullptr;
+
+	const auto i = table.find(LowerCase(name));
+	if (i == table.end())
+		return nullptr;
+
+	return {i->second.data(), i->second.size()};
+}
+
+ConstBuffer<unsigned>
+decoder_plugins_for_suffix(const char *suffix) noexcept
+{
+	return LookupTable(decoder_plugins_by_suffix, suffix);
+}
+
+ConstBuffer<unsigned>
+decoder_plugins_for_mime_type(const char *mime_type) noexcept
+{
+	return LookupTable(decoder_plugins_by_mime_type, mime_type);
+}
 
 const struct DecoderPlugin *
 decoder_plugin_from_name(const char *name) noexcept
 {
-	return decoder_plugins_find([=](const DecoderPlugin &plugin){
-			return strcmp(plugin.name, name) == 0;
-		});
+	/* compare the names first, to avoid initializing other
+	   plugins lazily */
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
+		if (strcmp(decoder_plugins[i]->name, name) == 0)
+			return decoder_plugin_ensure_init(i)
+				? decoder_plugins[i]
+				: nullptr;
+
+	return nullptr;
+}
+
+/**
+ * Throws on fatal error.
+ *
+ * @return true if the plugin is enabled
+ */
+static bool
+InitDecoderPlugin(unsigned i)
+{
+	const DecoderPlugin &plugin = *decoder_plugins[i];
+	const ConfigBlock &block = *decoder_plugin_blocks[i];
+
+	block.SetUsed();
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	try {
+		const bool result = plugin.Init(block);
+		LogPluginInitTime("Decoder", plugin.name,
+				  std::chrono::steady_clock::now() - start_time);
+		return result;
+	} catch (const PluginUnavailable &e) {
+		FormatError(e,
+			    "Decoder plugin '%s' is unavailable",
+			    plugin.name);
+		return false;
+	} catch (...) {
+		std::throw_with_nested(FormatRuntimeError("Failed to initialize decoder plugin '%s'",
+							  plugin.name));
+	}
+}
+
+bool
+decoder_plugin_lazy_init(unsigned i) noexcept
+{
+	return decoder_plugin_states[i].Ensure(decoder_plugins_init_mutex,
+					       [i]{
+						       return InitDecoderPlugin(i);
+					       });
 }
 
 void
 decoder_plugin_init_all(const ConfigData &config)
 {
-	ConfigBlock empty;
+	const auto mode = GetPluginInitMode(config);
+
+	seek_table_cache_init(config);
 
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
 		const DecoderPlugin &plugin = *decoder_plugins[i];
@@ -143,40 +275,45 @@ decoder_plugin_init_all(const ConfigData &config)
 					 plugin.name);
 
 		if (param == nullptr)
-			param = &empty;
+			param = &empty_decoder_block;
 		else if (!param->GetBlockValue("enabled", true))
 			/* the plugin is disabled in mpd.conf */
 			continue;
 
-		if (param != nullptr)
-			param->SetUsed();
-
-		try {
-			if (plugin.Init(*param))
-				decoder_plugins_enabled[i] = true;
-		} catch (const PluginUnavailable &e) {
-			FormatError(e,
-				    "Decoder plugin '%s' is unavailable",
-				    plugin.name);
-		} catch (...) {
-			std::throw_with_nested(FormatRuntimeError("Failed to initialize decoder plugin '%s'",
-								  plugin.name));
-		}
+		decoder_plugin_blocks[i] = param;
+
+		if (mode != PluginInitMode::EAGER)
+			decoder_plugin_states[i].SetPending();
+		else if (InitDecoderPlugin(i))
+			decoder_plugin_states[i].SetEnabled();
+	}
+
+	/* build the dispatch tables, so the decoder and the tag
+	   scanner don't need to ask each plugin for each file;
+	   plugins which are not yet initialized are included */
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
+		if (!decoder_plugin_states[i].IsAvailable())
+			continue;
+
+		const DecoderPlugin &plugin = *decoder_plugins[i];
+		AddToTable(decoder_plugins_by_suffix, plugin.suffixes, i);
+		AddToTable(decoder_plugins_by_mime_type, plugin.mime_types, i);
 	}
 }
 
 void
 decoder_plugin_deinit_all() noexcept
 {
-	decoder_plugins_for_each_enabled([=](const DecoderPlugin &plugin){
-			plugin.Finish();
-		});
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
+		if (decoder_plugin_states[i].IsEnabled())
+			decoder_plugins[i]->Finish();
+
+	decoder_plugins_by_suffix.clear();
+	decoder_plugins_by_mime_type.clear();
 }
 
 bool
 decoder_plugins_supports_suffix(const char *suffix) noexcept
 {
-	return decoder_plugins_try([suffix](const DecoderPlugin &plugin){
-			return plugin.SupportsSuffix(suffix);
-		});
+	return !decoder_plugins_for_suffix(suffix).empty();
 }
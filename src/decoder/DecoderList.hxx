@@ -21,12 +21,37 @@
 #define MPD_DECODER_LIST_HXX
 
 #include "util/Compiler.h"
+#include "util/ConstBuffer.hxx"
+#include "PluginInit.hxx"
 
 struct ConfigData;
 struct DecoderPlugin;
 
 extern const struct DecoderPlugin *const decoder_plugins[];
-extern bool decoder_plugins_enabled[];
+extern LazyPluginState decoder_plugin_states[];
+
+/**
+ * Initialize the specified plugin if that was postponed (see
+ * #PluginInitMode).  Do not call directly; use
+ * decoder_plugin_ensure_init().
+ *
+ * @return true if the plugin is enabled
+ */
+bool
+decoder_plugin_lazy_init(unsigned i) noexcept;
+
+/**
+ * Make sure the specified plugin (an index into #decoder_plugins) is
+ * initialized.
+ *
+ * @return true if the plugin is enabled
+ */
+static inline bool
+decoder_plugin_ensure_init(unsigned i) noexcept
+{
+	return decoder_plugin_states[i].IsEnabled() ||
+		decoder_plugin_lazy_init(i);
+}
 
 /* interface for using plugins */
 
@@ -53,12 +78,16 @@ public:
 	}
 };
 
+/**
+ * Find the first enabled plugin which matches the given predicate.
+ * This initializes all plugins which are examined.
+ */
 template<typename F>
 static inline const DecoderPlugin *
 decoder_plugins_find(F f) noexcept
 {
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
-		if (decoder_plugins_enabled[i] && f(*decoder_plugins[i]))
+		if (decoder_plugin_ensure_init(i) && f(*decoder_plugins[i]))
 			return decoder_plugins[i];
 
 	return nullptr;
@@ -69,7 +98,7 @@ static inline bool
 decoder_plugins_try(F f)
 {
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
-		if (decoder_plugins_enabled[i] && f(*decoder_plugins[i]))
+		if (decoder_plugin_ensure_init(i) && f(*decoder_plugins[i]))
 			return true;
 
 	return false;
@@ -83,15 +112,102 @@ decoder_plugins_for_each(F f)
 		f(**i);
 }
 
+/**
+ * Invoke the given function for each enabled plugin, including those
+ * which are not yet initialized (see #PluginInitMode); only use this
+ * to access the plugins' static attributes.
+ */
 template<typename F>
 static inline void
 decoder_plugins_for_each_enabled(F f)
 {
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
-		if (decoder_plugins_enabled[i])
+		if (decoder_plugin_states[i].IsAvailable())
 			f(*decoder_plugins[i]);
 }
 
+/**
+ * Returns the indices (into #decoder_plugins) of all enabled plugins
+ * which support the specified file name suffix (case-insensitive),
+ * in order of priority.  This is a hash table lookup; the table is
+ * built by decoder_plugin_init_all().
+ *
+ * @param suffix the suffix or nullptr
+ */
+gcc_pure
+ConstBuffer<unsigned>
+decoder_plugins_for_suffix(const char *suffix) noexcept;
+
+/**
+ * Like decoder_plugins_for_suffix(), but look up a MIME type (without
+ * parameters).
+ */
+gcc_pure
+ConstBuffer<unsigned>
+decoder_plugins_for_mime_type(const char *mime_type) noexcept;
+
+/**
+ * Like decoder_plugins_find(), but consider only plugins which
+ * support the specified file name suffix.
+ */
+template<typename F>
+static inline const DecoderPlugin *
+decoder_plugins_find_suffix(const char *suffix, F f) noexcept
+{
+	for (unsigned i : decoder_plugins_for_suffix(suffix))
+		if (decoder_plugin_ensure_init(i) && f(*decoder_plugins[i]))
+			return decoder_plugins[i];
+
+	return nullptr;
+}
+
+/**
+ * Like decoder_plugins_try(), but consider only plugins which
+ * support the specified file name suffix.
+ */
+template<typename F>
+static inline bool
+decoder_plugins_try_suffix(const char *suffix, F f)
+{
+	for (unsigned i : decoder_plugins_for_suffix(suffix))
+		if (decoder_plugin_ensure_init(i) && f(*decoder_plugins[i]))
+			return true;
+
+	return false;
+}
+
+/**
+ * Like decoder_plugins_try(), but consider only plugins which
+ * support the specified file name suffix or the specified MIME type
+ * (both may be nullptr).  Each plugin is tried only once, in order
+ * of priority.
+ */
+template<typename F>
+static inline bool
+decoder_plugins_try_suffix_or_mime(const char *suffix,
+				   const char *mime_type, F f)
+{
+	const auto a = decoder_plugins_for_suffix(suffix);
+	const auto b = decoder_plugins_for_mime_type(mime_type);
+
+	/* merge the two sorted lists */
+	size_t i = 0, j = 0;
+	while (i < a.size || j < b.size) {
+		unsigned k;
+		if (j == b.size || (i < a.size && a[i] <= b[j])) {
+			k = a[i++];
+			if (j < b.size && b[j] == k)
+				++j;
+		} else
+			k = b[j++];
+
+		if (decoder_plugin_ensure_init(k) && f(*decoder_plugins[k]))
+			return true;
+	}
+
+	return false;
+}
+
 /**
  * Is there at least once #DecoderPlugin that supports the specified
  * file name suffix?
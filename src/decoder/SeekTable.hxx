@@ -0,0 +1,104 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_DECODER_SEEK_TABLE_HXX
+#define MPD_DECODER_SEEK_TABLE_HXX
+
+#include <vector>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A table which maps frame numbers to byte offsets, for formats
+ * without an index (e.g. VBR MP3 and AAC/ADTS).  The meaning of
+ * "frame" is up to the decoder plugin which builds the table; usually
+ * it is one compressed frame of the codec, with a fixed duration.
+ *
+ * Only every #step'th frame is recorded, so looking up a frame is an
+ * O(1) operation, after which the decoder needs to skip at most
+ * #step-1 frames.
+ */
+struct SeekTable {
+	/**
+	 * The number of frames between two entries.
+	 */
+	unsigned step;
+
+	/**
+	 * The total number of frames in the file; 0 if unknown
+	 * (i.e. the creator did not see the end of the file).
+	 */
+	uint64_t n_frames = 0;
+
+	/**
+	 * The byte offset of every #step'th frame, starting with
+	 * frame 0.
+	 */
+	std::vector<uint64_t> offsets;
+
+	explicit SeekTable(unsigned _step=1) noexcept
+		:step(_step) {}
+
+	bool empty() const noexcept {
+		return offsets.empty();
+	}
+
+	bool IsComplete() const noexcept {
+		return n_frames > 0;
+	}
+
+	void Clear() noexcept {
+		n_frames = 0;
+		offsets.clear();
+	}
+
+	/**
+	 * The number of the first frame whose offset is not known.
+	 */
+	uint64_t GetEndFrame() const noexcept {
+		return uint64_t(offsets.size()) * step;
+	}
+
+	/**
+	 * Record the byte offset of a frame.  Frames must be passed
+	 * in order; frames which are not a multiple of #step and
+	 * frames which have been recorded already are ignored.
+	 */
+	void Add(uint64_t frame, uint64_t offset) noexcept {
+		if (frame == GetEndFrame())
+			offsets.push_back(offset);
+	}
+
+	/**
+	 * Find the index of the entry at or before the specified
+	 * frame.  The table must not be empty.
+	 *
+	 * @return an index into #offsets; the frame number of that
+	 * entry is the index multiplied by #step
+	 */
+	size_t Find(uint64_t frame) const noexcept {
+		assert(!empty());
+
+		const uint64_t i = frame / step;
+		return i < offsets.size() ? size_t(i) : offsets.size() - 1;
+	}
+};
+
+#endif
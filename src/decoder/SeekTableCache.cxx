@@ -0,0 +1,306 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "SeekTableCache.hxx"
+#include "SeekTable.hxx"
+#include "input/InputStream.hxx"
+#include "config/Data.hxx"
+#include "config/Option.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Traits.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "system/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <cinttypes>
+#include <stdexcept>
+#include <string>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static constexpr Domain seek_table_domain("seek_table");
+
+/**
+ * The directory where seek tables are stored; nullptr if the cache
+ * is disabled.
+ */
+static AllocatedPath seek_table_directory = nullptr;
+
+/**
+ * The header of each seek table file; it is followed by the path
+ * (not null-terminated) and the offsets.  All values are in host
+ * byte order; this cache is not meant to be portable.
+ */
+struct SeekTableHeader {
+	uint32_t magic;
+
+	uint32_t step;
+
+	/**
+	 * The size of the audio file.
+	 */
+	uint64_t file_size;
+
+	/**
+	 * The modification time of the audio file (in seconds since
+	 * the epoch).
+	 */
+	int64_t file_mtime;
+
+	uint64_t n_frames;
+
+	uint32_t n_offsets;
+
+	uint32_t path_length;
+
+	/**
+	 * This constant must be changed whenever the file layout
+	 * changes.
+	 */
+	static constexpr uint32_t MAGIC = 0x4d505354; // "MPST"
+};
+
+static_assert(sizeof(SeekTableHeader) == 40, "Wrong header size");
+
+/**
+ * Refuse to load tables larger than this, to protect against
+ * corrupt files.
+ */
+static constexpr uint32_t MAX_OFFSETS = 16 * 1024 * 1024;
+
+void
+seek_table_cache_init(const ConfigData &config)
+{
+	seek_table_directory = config.GetPath(ConfigOption::SEEK_TABLE_CACHE);
+	if (seek_table_directory.IsNull())
+		return;
+
+	/* create the directory if it does not exist yet; errors are
+	   reported by seek_table_cache_store() */
+	mkdir(seek_table_directory.c_str(), 0700);
+}
+
+bool
+seek_table_cache_enabled() noexcept
+{
+	return !seek_table_directory.IsNull();
+}
+
+/**
+ * Generate a file name from the FNV-1a hash of the plugin name and
+ * the path.
+ */
+gcc_pure
+static AllocatedPath
+MakeCacheFilePath(const char *plugin, Path path_fs) noexcept
+{
+	uint64_t hash = 14695981039346656037ULL;
+	const auto update = [&hash](const char *p){
+		for (; *p != 0; ++p) {
+			hash ^= (uint8_t)*p;
+			hash *= 1099511628211ULL;
+		}
+
+		/* separator */
+		hash *= 1099511628211ULL;
+	};
+
+	update(plugin);
+	update(path_fs.c_str());
+
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016" PRIx64, hash);
+	return AllocatedPath::Build(seek_table_directory, buffer);
+}
+
+/**
+ * Obtain the identity of the audio file which is stored in the
+ * header.
+ *
+ * @return false if the file does not exist or is not a regular file
+ */
+static bool
+GetFileIdentity(Path path_fs, SeekTableHeader &header) noexcept
+{
+	FileInfo info;
+	if (!GetFileInfo(path_fs, info) || !info.IsRegular())
+		return false;
+
+	header.file_size = info.GetSize();
+	header.file_mtime =
+		std::chrono::system_clock::to_time_t(info.GetModificationTime());
+	return true;
+}
+
+static void
+ReadFull(FileReader &reader, void *dest, size_t size)
+{
+	if (size > 0 && reader.Read(dest, size) != size)
+		throw std::runtime_error("Truncated seek table file");
+}
+
+/**
+ * Throws on error.
+ *
+ * @return false if the file does not match
+ */
+static bool
+LoadSeekTable(Path cache_path, Path path_fs,
+	      const SeekTableHeader &identity, SeekTable &table)
+{
+	FileReader reader(cache_path);
+
+	SeekTableHeader header;
+	ReadFull(reader, &header, sizeof(header));
+
+	const size_t path_length = strlen(path_fs.c_str());
+	if (header.magic != SeekTableHeader::MAGIC ||
+	    header.step == 0 ||
+	    header.n_offsets == 0 || header.n_offsets > MAX_OFFSETS ||
+	    header.file_size != identity.file_size ||
+	    header.file_mtime != identity.file_mtime ||
+	    header.path_length != path_length)
+		return false;
+
+	std::string path(path_length, '\0');
+	ReadFull(reader, &path.front(), path_length);
+	if (memcmp(path.data(), path_fs.c_str(), path_length) != 0)
+		/* hash collision */
+		return false;
+
+	table.step = header.step;
+	table.n_frames = header.n_frames;
+	table.offsets.resize(header.n_offsets);
+	ReadFull(reader, table.offsets.data(),
+		 header.n_offsets * sizeof(table.offsets.front()));
+	return true;
+}
+
+bool
+seek_table_cache_load(const char *plugin, Path path_fs,
+		      SeekTable &table) noexcept
+{
+	if (!seek_table_cache_enabled())
+		return false;
+
+	SeekTableHeader identity;
+	if (!GetFileIdentity(path_fs, identity))
+		return false;
+
+	const auto cache_path = MakeCacheFilePath(plugin, path_fs);
+
+	try {
+		if (!LoadSeekTable(cache_path, path_fs, identity, table)) {
+			table.Clear();
+			return false;
+		}
+	} catch (const std::system_error &e) {
+		table.Clear();
+		if (!IsFileNotFound(e))
+			LogError(e);
+		return false;
+	} catch (...) {
+		table.Clear();
+		LogError(std::current_exception());
+		return false;
+	}
+
+	FormatDebug(seek_table_domain, "Loaded seek table for %s",
+		    path_fs.c_str());
+	return true;
+}
+
+/**
+ * Convert the URI of a local #InputStream to a file system path.
+ *
+ * @return the path or nullptr if this is not a local file
+ */
+static AllocatedPath
+InputStreamToPath(const InputStream &is) noexcept
+{
+	const char *uri = is.GetURI();
+	if (!PathTraitsUTF8::IsAbsolute(uri))
+		return nullptr;
+
+	return AllocatedPath::FromUTF8(uri);
+}
+
+bool
+seek_table_cache_load(const char *plugin, const InputStream &is,
+		      SeekTable &table) noexcept
+{
+	if (!seek_table_cache_enabled())
+		return false;
+
+	const auto path_fs = InputStreamToPath(is);
+	return !path_fs.IsNull() &&
+		seek_table_cache_load(plugin, path_fs, table);
+}
+
+void
+seek_table_cache_store(const char *plugin, Path path_fs,
+		       const SeekTable &table) noexcept
+{
+	if (!seek_table_cache_enabled() || table.empty() ||
+	    table.offsets.size() > MAX_OFFSETS)
+		return;
+
+	SeekTableHeader header;
+	if (!GetFileIdentity(path_fs, header))
+		return;
+
+	header.magic = SeekTableHeader::MAGIC;
+	header.step = table.step;
+	header.n_frames = table.n_frames;
+	header.n_offsets = table.offsets.size();
+	header.path_length = strlen(path_fs.c_str());
+
+	try {
+		FileOutputStream file(MakeCacheFilePath(plugin, path_fs));
+		file.Write(&header, sizeof(header));
+		file.Write(path_fs.c_str(), header.path_length);
+		file.Write(table.offsets.data(),
+			   table.offsets.size() * sizeof(table.offsets.front()));
+		file.Commit();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to store seek table");
+		return;
+	}
+
+	FormatDebug(seek_table_domain, "Stored seek table for %s",
+		    path_fs.c_str());
+}
+
+void
+seek_table_cache_store(const char *plugin, const InputStream &is,
+		       const SeekTable &table) noexcept
+{
+	if (!seek_table_cache_enabled())
+		return;
+
+	const auto path_fs = InputStreamToPath(is);
+	if (!path_fs.IsNull())
+		seek_table_cache_store(plugin, path_fs, table);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_DECODER_SEEK_TABLE_CACHE_HXX
+#define MPD_DECODER_SEEK_TABLE_CACHE_HXX
+
+struct ConfigData;
+struct SeekTable;
+class Path;
+class InputStream;
+
+/**
+ * Configure the seek table cache (option "seek_table_cache").
+ *
+ * Throws on error.
+ */
+void
+seek_table_cache_init(const ConfigData &config);
+
+/**
+ * Is the seek table cache enabled?
+ */
+bool
+seek_table_cache_enabled() noexcept;
+
+/**
+ * Load a seek table from the cache.  The table is keyed by the
+ * plugin name and the file's path; the file's size and modification
+ * time must match.
+ *
+ * @param plugin the name of the decoder plugin which created the
+ * table (tables are not compatible between plugins)
+ * @return true if a table was found (and was copied to #table)
+ */
+bool
+seek_table_cache_load(const char *plugin, Path path_fs,
+		      SeekTable &table) noexcept;
+
+/**
+ * Like seek_table_cache_load(), but for a (local) #InputStream.
+ * Returns false for remote streams.
+ */
+bool
+seek_table_cache_load(const char *plugin, const InputStream &is,
+		      SeekTable &table) noexcept;
+
+/**
+ * Store a seek table in the cache.  Errors are logged.
+ */
+void
+seek_table_cache_store(const char *plugin, Path path_fs,
+		       const SeekTable &table) noexcept;
+
+void
+seek_table_cache_store(const char *plugin, const InputStream &is,
+		       const SeekTable &table) noexcept;
+
+#endif
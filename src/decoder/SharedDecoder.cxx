@@ -0,0 +1,399 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SharedDecoder.hxx"
+#include "Control.hxx"
+#include "Client.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "song/DetachedSong.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+
+#include <list>
+#include <map>
+#include <string>
+
+/**
+ * The number of chunks in the #MusicBuffer of a #SharedDecoder.  The
+ * chunks are copied to the subscribers right away, therefore this
+ * can be small.
+ */
+static constexpr unsigned SHARED_DECODER_BUFFER_CHUNKS = 64;
+
+/**
+ * The maximum number of chunks queued for one subscriber.  If a
+ * subscriber falls behind, the oldest chunks are discarded.
+ */
+static constexpr size_t SHARED_DECODER_MAX_QUEUE = 256;
+
+class SharedDecoder {
+	const std::string uri;
+
+	mutable Mutex mutex;
+	Cond cond;
+
+	MusicBuffer buffer;
+	const std::shared_ptr<MusicPipe> pipe;
+
+	DecoderControl dc;
+
+	Thread thread;
+
+	/**
+	 * Protected by #mutex.
+	 */
+	std::list<SharedDecoderSubscription *> subscribers;
+
+	/**
+	 * The most recent tag; it is passed to new subscribers.
+	 * Protected by #mutex.
+	 */
+	std::shared_ptr<const Tag> last_tag;
+
+	/**
+	 * The error which has stopped the decoder.  Protected by
+	 * #mutex.
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * Has the decoder finished?  No new subscribers are accepted
+	 * after that.  Protected by #mutex.
+	 */
+	bool finished = false;
+
+	bool quit = false;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit SharedDecoder(const char *_uri);
+	~SharedDecoder() noexcept;
+
+	SharedDecoder(const SharedDecoder &) = delete;
+	SharedDecoder &operator=(const SharedDecoder &) = delete;
+
+	gcc_pure
+	bool LockIsFinished() const noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		return finished;
+	}
+
+	void Subscribe(SharedDecoderSubscription &s) noexcept;
+	void Unsubscribe(SharedDecoderSubscription &s) noexcept;
+
+	/**
+	 * A subscriber has consumed a chunk; wake up the thread in
+	 * case it waits for room in the subscribers' queues.  This
+	 * is called without holding #mutex.
+	 */
+	void WakeUp() noexcept {
+		cond.notify_one();
+	}
+
+private:
+	/**
+	 * Are the queues of all subscribers full?  In that case, the
+	 * thread waits instead of dropping more chunks.
+	 *
+	 * Caller must lock #mutex.
+	 */
+	gcc_pure
+	bool IsThrottled() const noexcept;
+
+	/**
+	 * Caller must lock #mutex.
+	 */
+	void Publish(const std::shared_ptr<const SharedDecoderChunk> &chunk) noexcept;
+
+	/**
+	 * Caller must lock #mutex.
+	 */
+	void Finish() noexcept;
+
+	void RunThread() noexcept;
+};
+
+static Mutex shared_decoders_mutex;
+
+/**
+ * All #SharedDecoder instances by URI.  Protected by
+ * #shared_decoders_mutex.
+ */
+static std::map<std::string, std::weak_ptr<SharedDecoder>> shared_decoders;
+
+SharedDecoder::SharedDecoder(const char *_uri)
+	:uri(_uri),
+	 buffer(SHARED_DECODER_BUFFER_CHUNKS, CHUNK_SIZE),
+	 pipe(std::make_shared<MusicPipe>()),
+	 dc(mutex, cond, nullptr, AudioFormat::Undefined(),
+	    ReplayGainConfig()),
+	 thread(BIND_THIS_METHOD(RunThread))
+{
+	dc.StartThread();
+
+	try {
+		thread.Start();
+	} catch (...) {
+		dc.Quit();
+		throw;
+	}
+}
+
+SharedDecoder::~SharedDecoder() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		quit = true;
+		cond.notify_one();
+	}
+
+	thread.Join();
+
+	{
+		std::unique_lock<Mutex> lock(mutex);
+		dc.Stop(lock);
+	}
+
+	pipe->Clear();
+	dc.Quit();
+
+	const std::lock_guard<Mutex> protect(shared_decoders_mutex);
+	auto i = shared_decoders.find(uri);
+	if (i != shared_decoders.end() && i->second.expired())
+		shared_decoders.erase(i);
+}
+
+void
+SharedDecoder::Subscribe(SharedDecoderSubscription &s) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	s.pending_tag = last_tag;
+
+	if (finished) {
+		s.finished = true;
+		s.error = error;
+	} else
+		subscribers.push_back(&s);
+}
+
+void
+SharedDecoder::Unsubscribe(SharedDecoderSubscription &s) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	subscribers.remove(&s);
+	cond.notify_one();
+}
+
+bool
+SharedDecoder::IsThrottled() const noexcept
+{
+	if (subscribers.empty())
+		return false;
+
+	for (const auto *s : subscribers) {
+		const std::lock_guard<Mutex> protect(s->dc.mutex);
+		if (s->queue.size() < SHARED_DECODER_MAX_QUEUE)
+			return false;
+	}
+
+	return true;
+}
+
+void
+SharedDecoder::Publish(const std::shared_ptr<const SharedDecoderChunk> &chunk) noexcept
+{
+	for (auto *s : subscribers) {
+		const std::lock_guard<Mutex> protect(s->dc.mutex);
+
+		if (s->queue.size() >= SHARED_DECODER_MAX_QUEUE)
+			/* this subscriber is too slow */
+			s->queue.pop_front();
+
+		s->queue.push_back(chunk);
+		s->dc.Signal();
+	}
+}
+
+void
+SharedDecoder::Finish() noexcept
+{
+	finished = true;
+
+	if (dc.HasFailed()) {
+		try {
+			dc.CheckRethrowError();
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	for (auto *s : subscribers) {
+		const std::lock_guard<Mutex> protect(s->dc.mutex);
+		s->finished = true;
+		s->error = error;
+		s->dc.Signal();
+	}
+}
+
+void
+SharedDecoder::RunThread() noexcept
+{
+	SetThreadName("shared_decoder");
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	dc.Start(lock, std::make_unique<DetachedSong>(uri),
+		 SongTime::zero(), SongTime::zero(),
+		 buffer, pipe);
+
+	while (!quit) {
+		if (IsThrottled()) {
+			/* wait for a subscriber to make room; the
+			   wakeup is not synchronized with #mutex,
+			   therefore use a timeout */
+			cond.wait_for(lock, std::chrono::milliseconds(50));
+			continue;
+		}
+
+		auto chunk = pipe->Shift();
+		if (chunk == nullptr) {
+			if (dc.IsIdle())
+				break;
+
+			cond.wait(lock);
+			continue;
+		}
+
+		auto shared = std::make_shared<SharedDecoderChunk>();
+		shared->audio_format = dc.out_audio_format;
+		shared->bit_rate = chunk->bit_rate;
+		shared->tag = chunk->tag;
+		shared->data.assign(chunk->data, chunk->data + chunk->length);
+
+		if (chunk->tag != nullptr)
+			last_tag = chunk->tag;
+
+		/* return the chunk to the buffer and wake up the
+		   decoder, which may be waiting for it */
+		chunk.reset();
+		dc.Signal();
+
+		Publish(shared);
+	}
+
+	Finish();
+}
+
+/**
+ * Look up the #SharedDecoder for the given URI, or create a new one.
+ */
+static std::shared_ptr<SharedDecoder>
+ObtainSharedDecoder(const char *uri)
+{
+	/* declared before the lock because ~SharedDecoder() locks
+	   #shared_decoders_mutex */
+	std::shared_ptr<SharedDecoder> old;
+
+	const std::lock_guard<Mutex> protect(shared_decoders_mutex);
+
+	auto &slot = shared_decoders[uri];
+	auto decoder = slot.lock();
+	if (decoder != nullptr && !decoder->LockIsFinished())
+		return decoder;
+
+	old = std::move(decoder);
+	decoder = std::make_shared<SharedDecoder>(uri);
+	slot = decoder;
+	return decoder;
+}
+
+SharedDecoderSubscription::SharedDecoderSubscription(DecoderControl &_dc,
+						     const char *uri)
+	:dc(_dc), decoder(ObtainSharedDecoder(uri))
+{
+	decoder->Subscribe(*this);
+}
+
+SharedDecoderSubscription::~SharedDecoderSubscription() noexcept
+{
+	decoder->Unsubscribe(*this);
+}
+
+bool
+SharedDecoderSubscription::Run(DecoderClient &client)
+{
+	bool ready = false;
+	AudioFormat audio_format = AudioFormat::Undefined();
+
+	std::unique_lock<Mutex> lock(dc.mutex);
+
+	while (dc.command != DecoderCommand::STOP) {
+		if (queue.empty()) {
+			if (finished)
+				break;
+
+			dc.Wait(lock);
+			continue;
+		}
+
+		auto chunk = std::move(queue.front());
+		queue.pop_front();
+
+		decoder->WakeUp();
+
+		const ScopeUnlock unlock(dc.mutex);
+
+		if (!ready) {
+			audio_format = chunk->audio_format;
+			client.Ready(audio_format, false,
+				     SignedSongTime::Negative());
+			ready = true;
+
+			if (pending_tag != nullptr && chunk->tag == nullptr)
+				client.SubmitTag(nullptr, Tag(*pending_tag));
+		} else if (chunk->audio_format != audio_format)
+			/* the #MusicPipe requires one format per
+			   song */
+			break;
+
+		if (chunk->tag != nullptr)
+			client.SubmitTag(nullptr, Tag(*chunk->tag));
+
+		auto cmd = client.SubmitData(nullptr, chunk->data.data(),
+					     chunk->data.size(),
+					     chunk->bit_rate);
+		if (cmd == DecoderCommand::SEEK)
+			client.SeekError();
+		else if (cmd == DecoderCommand::STOP)
+			break;
+	}
+
+	if (!ready && error)
+		std::rethrow_exception(error);
+
+	return ready;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_DECODER_HXX
+#define MPD_SHARED_DECODER_HXX
+
+#include "AudioFormat.hxx"
+
+#include <exception>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+struct Tag;
+class DecoderClient;
+class DecoderControl;
+class SharedDecoder;
+
+/**
+ * A copy of one #MusicChunk decoded by a #SharedDecoder.  It is
+ * immutable and may be referenced by any number of subscribers.
+ */
+struct SharedDecoderChunk {
+	AudioFormat audio_format;
+
+	uint16_t bit_rate;
+
+	std::shared_ptr<const Tag> tag;
+
+	std::vector<uint8_t> data;
+};
+
+/**
+ * One partition's subscription to a #SharedDecoder ("shared_decoder").
+ * Partitions which play the same remote URI at the same time share
+ * one decoder instead of downloading and decoding the stream once per
+ * partition.
+ *
+ * The queue is protected by the subscriber's DecoderControl::mutex;
+ * the #SharedDecoder wakes up the subscriber with
+ * DecoderControl::Signal().
+ */
+class SharedDecoderSubscription {
+	friend class SharedDecoder;
+
+	DecoderControl &dc;
+
+	std::shared_ptr<SharedDecoder> decoder;
+
+	std::deque<std::shared_ptr<const SharedDecoderChunk>> queue;
+
+	/**
+	 * The most recent tag received before this subscription was
+	 * created.
+	 */
+	std::shared_ptr<const Tag> pending_tag;
+
+	std::exception_ptr error;
+
+	bool finished = false;
+
+public:
+	/**
+	 * Subscribe to the #SharedDecoder playing the given URI,
+	 * creating a new one if none exists yet.
+	 *
+	 * @param dc the subscriber's #DecoderControl
+	 */
+	SharedDecoderSubscription(DecoderControl &dc, const char *uri);
+	~SharedDecoderSubscription() noexcept;
+
+	SharedDecoderSubscription(const SharedDecoderSubscription &) = delete;
+	SharedDecoderSubscription &operator=(const SharedDecoderSubscription &) = delete;
+
+	/**
+	 * Pass the shared chunks to the specified #DecoderClient until
+	 * the #SharedDecoder finishes or the client receives
+	 * DecoderCommand::STOP.  Throws if the #SharedDecoder has
+	 * failed before delivering any data.
+	 *
+	 * DecoderControl::mutex is not locked.
+	 *
+	 * @return true if at least one chunk was submitted
+	 */
+	bool Run(DecoderClient &client);
+};
+
+#endif
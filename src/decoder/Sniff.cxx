@@ -0,0 +1,205 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Sniff.hxx"
+
+#include <stdint.h>
+#include <string.h>
+
+/* the plugin lists are in the order of decoder_plugins[] */
+
+static constexpr const char *mpeg_audio_plugins[] = {
+	"mad", "mpg123", "ffmpeg", nullptr,
+};
+
+static constexpr const char *adts_plugins[] = {
+	"faad", "ffmpeg", nullptr,
+};
+
+static constexpr const char *flac_plugins[] = {
+	"flac", "ffmpeg", nullptr,
+};
+
+static constexpr const char *oggflac_plugins[] = {
+	"oggflac", "ffmpeg", nullptr,
+};
+
+static constexpr const char *vorbis_plugins[] = {
+	"vorbis", "ffmpeg", nullptr,
+};
+
+static constexpr const char *opus_plugins[] = {
+	"opus", "ffmpeg", nullptr,
+};
+
+static constexpr const char *wavpack_plugins[] = {
+	"wavpack", "ffmpeg", nullptr,
+};
+
+static constexpr const char *musepack_plugins[] = {
+	"mpcdec", "ffmpeg", nullptr,
+};
+
+static constexpr const char *dsf_plugins[] = {
+	"dsf", "ffmpeg", nullptr,
+};
+
+static constexpr const char *dsdiff_plugins[] = {
+	"dsdiff", "ffmpeg", nullptr,
+};
+
+static constexpr const char *pcm_container_plugins[] = {
+	"sndfile", "ffmpeg", nullptr,
+};
+
+static constexpr const char *mp4_plugins[] = {
+	"hybrid_dsd", "ffmpeg", nullptr,
+};
+
+static constexpr const char *ffmpeg_plugins[] = {
+	"ffmpeg", nullptr,
+};
+
+static bool
+StartsWith(ConstBuffer<uint8_t> data, const char *magic,
+	   size_t offset=0) noexcept
+{
+	const size_t length = strlen(magic);
+	return data.size >= offset + length &&
+		memcmp(data.data + offset, magic, length) == 0;
+}
+
+/**
+ * Does the buffer begin with a plausible MPEG audio frame header?
+ */
+gcc_pure
+static bool
+IsMpegAudioFrame(ConstBuffer<uint8_t> data) noexcept
+{
+	if (data.size < 4 || data[0] != 0xff || (data[1] & 0xe0) != 0xe0)
+		return false;
+
+	const unsigned version = (data[1] >> 3) & 0x3;
+	const unsigned layer = (data[1] >> 1) & 0x3;
+	const unsigned bitrate = data[2] >> 4;
+	const unsigned sample_rate = (data[2] >> 2) & 0x3;
+
+	return version != 1 && layer != 0 &&
+		bitrate != 0xf && sample_rate != 0x3;
+}
+
+/**
+ * Does the buffer begin with an ADTS (AAC) frame header?
+ */
+gcc_pure
+static bool
+IsAdtsFrame(ConstBuffer<uint8_t> data) noexcept
+{
+	return data.size >= 7 && data[0] == 0xff &&
+		/* syncword and layer 0 */
+		(data[1] & 0xf6) == 0xf0 &&
+		/* sampling frequency index */
+		((data[2] >> 2) & 0xf) < 13;
+}
+
+gcc_pure
+static const char *const *
+SniffOgg(ConstBuffer<uint8_t> data) noexcept
+{
+	/* the first page contains only the codec's identification
+	   header; skip the page header and the segment table */
+	if (data.size < 27)
+		return nullptr;
+
+	const size_t offset = 27 + data[26];
+
+	if (StartsWith(data, "\177FLAC", offset))
+		return oggflac_plugins;
+	else if (StartsWith(data, "\001vorbis", offset))
+		return vorbis_plugins;
+	else if (StartsWith(data, "OpusHead", offset))
+		return opus_plugins;
+	else
+		return ffmpeg_plugins;
+}
+
+gcc_pure
+static const char *const *
+Sniff(ConstBuffer<uint8_t> data) noexcept
+{
+	if (StartsWith(data, "ID3")) {
+		/* skip the ID3v2 tag and look at what follows */
+		if (data.size < 10)
+			return nullptr;
+
+		size_t size = 10 + ((data[6] & 0x7f) << 21) +
+			((data[7] & 0x7f) << 14) +
+			((data[8] & 0x7f) << 7) +
+			(data[9] & 0x7f);
+		if (data[5] & 0x10)
+			/* footer present */
+			size += 10;
+
+		if (size >= data.size)
+			/* the tag is larger than the probe buffer */
+			return nullptr;
+
+		data.skip_front(size);
+		if (StartsWith(data, "ID3"))
+			/* multiple ID3v2 tags; give up */
+			return nullptr;
+
+		return Sniff(data);
+	}
+
+	if (StartsWith(data, "fLaC"))
+		return flac_plugins;
+	else if (StartsWith(data, "OggS"))
+		return SniffOgg(data);
+	else if (StartsWith(data, "wvpk"))
+		return wavpack_plugins;
+	else if (StartsWith(data, "MPCK") || StartsWith(data, "MP+"))
+		return musepack_plugins;
+	else if (StartsWith(data, "DSD "))
+		return dsf_plugins;
+	else if (StartsWith(data, "FRM8"))
+		return dsdiff_plugins;
+	else if ((StartsWith(data, "RIFF") && StartsWith(data, "WAVE", 8)) ||
+		 (StartsWith(data, "FORM") && (StartsWith(data, "AIFF", 8) ||
+					       StartsWith(data, "AIFC", 8))))
+		return pcm_container_plugins;
+	else if (StartsWith(data, "ftyp", 4))
+		return mp4_plugins;
+	else if (StartsWith(data, "MAC ") ||
+		 StartsWith(data, "\x30\x26\xb2\x75\x8e\x66\xcf\x11"))
+		/* Monkey's Audio, ASF (WMA) */
+		return ffmpeg_plugins;
+	else if (IsAdtsFrame(data))
+		return adts_plugins;
+	else if (IsMpegAudioFrame(data))
+		return mpeg_audio_plugins;
+	else
+		return nullptr;
+}
+
+const char *const *
+SniffDecoderPlugins(ConstBuffer<void> data) noexcept
+{
+	return Sniff(ConstBuffer<uint8_t>::FromVoid(data));
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_STATS_HXX
+#define MPD_DECODER_STATS_HXX
+
+#include "Chrono.hxx"
+
+#include <chrono>
+
+#include <stdint.h>
+
+/**
+ * Resource accounting of one song played by the decoder thread; see
+ * DecoderControl::stats.
+ */
+struct DecoderStats {
+	/**
+	 * The name of the decoder plugin which decodes (or has
+	 * decoded) the song; nullptr if no plugin has been tried
+	 * yet.
+	 */
+	const char *plugin = nullptr;
+
+	/**
+	 * The CPU time consumed by the decoder thread inside the
+	 * decoder plugins (including plugins which were probed
+	 * unsuccessfully); negative if unknown.
+	 */
+	std::chrono::nanoseconds cpu_time = std::chrono::nanoseconds::zero();
+
+	/**
+	 * The number of PCM frames submitted by the plugin.
+	 */
+	uint64_t frames = 0;
+
+	/**
+	 * The number of bytes the plugin has read from its
+	 * #InputStream with decoder_read().
+	 */
+	uint64_t bytes_read = 0;
+
+	/**
+	 * The sample rate of the decoded audio, or 0 if the plugin
+	 * has not called DecoderClient::Ready() yet.
+	 */
+	unsigned sample_rate = 0;
+
+	constexpr bool IsDefined() const noexcept {
+		return plugin != nullptr;
+	}
+
+	constexpr bool HasCPUTime() const noexcept {
+		return cpu_time.count() >= 0;
+	}
+
+	/**
+	 * The duration of the audio submitted so far.
+	 */
+	constexpr FloatDuration GetAudioDuration() const noexcept {
+		return sample_rate > 0
+			? FloatDuration(double(frames) / sample_rate)
+			: FloatDuration::zero();
+	}
+
+	/**
+	 * How many times faster than real time is the plugin
+	 * decoding?  Returns 0 if unknown.
+	 */
+	constexpr double GetRealtimeFactor() const noexcept {
+		return cpu_time.count() > 0
+			? GetAudioDuration() / cpu_time
+			: 0.;
+	}
+};
+
+#endif
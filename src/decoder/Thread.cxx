@@ -29,6 +29,8 @@
 #include "input/InputStream.hxx"
 #include "input/Registry.hxx"
 #include "DecoderList.hxx"
+#include "Sniff.hxx"
+#include "SharedDecoder.hxx"
 #include "system/Error.hxx"
 #include "util/MimeType.hxx"
 #include "util/UriExtract.hxx"
@@ -37,6 +39,8 @@
 #include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
 #include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "thread/Scheduling.hxx"
 #include "tag/ApeReplayGain.hxx"
 #include "Log.hxx"
 
@@ -44,6 +48,9 @@
 #include <functional>
 #include <memory>
 
+#include <inttypes.h>
+#include <string.h>
+
 static constexpr Domain decoder_thread_domain("decoder_thread");
 
 /**
@@ -79,11 +86,16 @@ decoder_stream_decode(const DecoderPlugin &plugin,
 
 		FormatThreadName("decoder:%s", plugin.name);
 
+		bridge.BeginPlugin(plugin.name);
+		AtScopeExit(&bridge) { bridge.EndPlugin(); };
+
 		plugin.StreamDecode(bridge, input_stream);
 
 		SetThreadName("decoder");
 	}
 
+	bridge.UpdateStats();
+
 	assert(bridge.dc.state == DecoderState::START ||
 	       bridge.dc.state == DecoderState::DECODE);
 
@@ -116,57 +128,29 @@ decoder_file_decode(const DecoderPlugin &plugin,
 
 		FormatThreadName("decoder:%s", plugin.name);
 
+		bridge.BeginPlugin(plugin.name);
+		AtScopeExit(&bridge) { bridge.EndPlugin(); };
+
 		plugin.FileDecode(bridge, path);
 
 		SetThreadName("decoder");
 	}
 
+	bridge.UpdateStats();
+
 	assert(bridge.dc.state == DecoderState::START ||
 	       bridge.dc.state == DecoderState::DECODE);
 
 	return bridge.dc.state != DecoderState::START;
 }
 
-gcc_pure
-static bool
-decoder_check_plugin_mime(const DecoderPlugin &plugin,
-			  const InputStream &is) noexcept
-{
-	assert(plugin.stream_decode != nullptr);
-
-	const char *mime_type = is.GetMimeType();
-	return mime_type != nullptr &&
-		plugin.SupportsMimeType(GetMimeTypeBase(mime_type).c_str());
-}
-
-gcc_pure
-static bool
-decoder_check_plugin_suffix(const DecoderPlugin &plugin,
-			    const char *suffix) noexcept
-{
-	assert(plugin.stream_decode != nullptr);
-
-	return suffix != nullptr && plugin.SupportsSuffix(suffix);
-}
-
-gcc_pure
-static bool
-decoder_check_plugin(const DecoderPlugin &plugin, const InputStream &is,
-		     const char *suffix) noexcept
-{
-	return plugin.stream_decode != nullptr &&
-		(decoder_check_plugin_mime(plugin, is) ||
-		 decoder_check_plugin_suffix(plugin, suffix));
-}
-
 static bool
 decoder_run_stream_plugin(DecoderBridge &bridge, InputStream &is,
 			  std::unique_lock<Mutex> &lock,
-			  const char *suffix,
 			  const DecoderPlugin &plugin,
 			  bool &tried_r)
 {
-	if (!decoder_check_plugin(plugin, is, suffix))
+	if (plugin.stream_decode == nullptr)
 		return false;
 
 	bridge.Reset();
@@ -175,20 +159,59 @@ decoder_run_stream_plugin(DecoderBridge &bridge, InputStream &is,
 	return decoder_stream_decode(plugin, bridge, is, lock);
 }
 
+gcc_pure
+static bool
+IsSniffedPlugin(const char *const *sniffed,
+		const DecoderPlugin &plugin) noexcept
+{
+	if (sniffed != nullptr)
+		for (; *sniffed != nullptr; ++sniffed)
+			if (strcmp(*sniffed, plugin.name) == 0)
+				return true;
+
+	return false;
+}
+
+/**
+ * @param sniffed the return value of SniffDecoderPlugins(); these
+ * plugins are tried first
+ */
 static bool
 decoder_run_stream_locked(DecoderBridge &bridge, InputStream &is,
 			  std::unique_lock<Mutex> &lock,
-			  const char *uri, bool &tried_r)
+			  const char *uri, const char *const *sniffed,
+			  bool &tried_r)
 {
-	UriSuffixBuffer suffix_buffer;
-	const char *const suffix = uri_get_suffix(uri, suffix_buffer);
-
 	using namespace std::placeholders;
 	const auto f = std::bind(decoder_run_stream_plugin,
 				 std::ref(bridge), std::ref(is), std::ref(lock),
-				 suffix,
 				 _1, std::ref(tried_r));
-	return decoder_plugins_try(f);
+
+	if (sniffed != nullptr) {
+		/* the magic bytes are more reliable than suffix and
+		   MIME type; this avoids probing (and rewinding the
+		   stream for) plugins which will reject it */
+		for (auto i = sniffed; *i != nullptr; ++i) {
+			const auto *plugin = decoder_plugin_from_name(*i);
+			if (plugin != nullptr && f(*plugin))
+				return true;
+		}
+	}
+
+	UriSuffixBuffer suffix_buffer;
+	const char *const suffix = uri_get_suffix(uri, suffix_buffer);
+
+	std::string mime_base;
+	const char *mime_type = is.GetMimeType();
+	if (mime_type != nullptr)
+		mime_type = (mime_base = GetMimeTypeBase(mime_type)).c_str();
+
+	return decoder_plugins_try_suffix_or_mime(suffix, mime_type,
+						  [sniffed, &f](const DecoderPlugin &plugin){
+							  /* don't try the sniffed plugins again */
+							  return !IsSniffedPlugin(sniffed, plugin) &&
+								  f(plugin);
+						  });
 }
 
 /**
@@ -238,6 +261,32 @@ MaybeLoadReplayGain(DecoderBridge &bridge, InputStream &is)
 	LoadReplayGain(bridge, is);
 }
 
+/**
+ * Read the beginning of the stream (which is then buffered by
+ * #RewindInputStream) and guess its format.
+ *
+ * DecoderControl::mutex is not locked by caller.
+ *
+ * @return the return value of SniffDecoderPlugins()
+ */
+static const char *const *
+SniffStream(DecoderBridge &bridge, InputStream &is) noexcept
+{
+	char buffer[DECODER_SNIFF_SIZE];
+	size_t length = 0;
+
+	while (length < sizeof(buffer)) {
+		size_t nbytes = bridge.Read(is, buffer + length,
+					    sizeof(buffer) - length);
+		if (nbytes == 0)
+			break;
+
+		length += nbytes;
+	}
+
+	return SniffDecoderPlugins({buffer, length});
+}
+
 /**
  * Try decoding a stream.
  *
@@ -253,12 +302,14 @@ decoder_run_stream(DecoderBridge &bridge, const char *uri)
 
 	MaybeLoadReplayGain(bridge, *input_stream);
 
+	const auto *const sniffed = SniffStream(bridge, *input_stream);
+
 	std::unique_lock<Mutex> lock(dc.mutex);
 
 	bool tried = false;
 	return dc.command == DecoderCommand::STOP ||
 		decoder_run_stream_locked(bridge, *input_stream, lock, uri,
-					  tried) ||
+					  sniffed, tried) ||
 		/* fallback to mp3: this is needed for bastard streams
 		   that don't have a suffix or set the mimeType */
 		(!tried &&
@@ -271,13 +322,10 @@ decoder_run_stream(DecoderBridge &bridge, const char *uri)
  * DecoderControl::mutex is not locked by caller.
  */
 static bool
-TryDecoderFile(DecoderBridge &bridge, Path path_fs, const char *suffix,
+TryDecoderFile(DecoderBridge &bridge, Path path_fs,
 	       InputStream &input_stream,
 	       const DecoderPlugin &plugin)
 {
-	if (!plugin.SupportsSuffix(suffix))
-		return false;
-
 	bridge.Reset();
 
 	DecoderControl &dc = bridge.dc;
@@ -299,12 +347,11 @@ TryDecoderFile(DecoderBridge &bridge, Path path_fs, const char *suffix,
  * DecoderControl::mutex is not locked by caller.
  */
 static bool
-TryContainerDecoder(DecoderBridge &bridge, Path path_fs, const char *suffix,
+TryContainerDecoder(DecoderBridge &bridge, Path path_fs,
 		    const DecoderPlugin &plugin)
 {
 	if (plugin.container_scan == nullptr ||
-	    plugin.file_decode == nullptr ||
-	    !plugin.SupportsSuffix(suffix))
+	    plugin.file_decode == nullptr)
 		return false;
 
 	bridge.Reset();
@@ -322,13 +369,12 @@ TryContainerDecoder(DecoderBridge &bridge, Path path_fs, const char *suffix,
 static bool
 TryContainerDecoder(DecoderBridge &bridge, Path path_fs, const char *suffix)
 {
-	return decoder_plugins_try([&bridge, path_fs,
-				    suffix](const DecoderPlugin &plugin){
-					   return TryContainerDecoder(bridge,
-								      path_fs,
-								      suffix,
-								      plugin);
-				   });
+	return decoder_plugins_try_suffix(suffix,
+					  [&bridge, path_fs](const DecoderPlugin &plugin){
+						  return TryContainerDecoder(bridge,
+									     path_fs,
+									     plugin);
+					  });
 }
 
 /**
@@ -362,14 +408,26 @@ decoder_run_file(DecoderBridge &bridge, const char *uri_utf8, Path path_fs)
 	MaybeLoadReplayGain(bridge, *input_stream);
 
 	auto &is = *input_stream;
-	return decoder_plugins_try([&bridge, path_fs, suffix,
-				    &is](const DecoderPlugin &plugin){
-					   return TryDecoderFile(bridge,
-								 path_fs,
-								 suffix,
-								 is,
-								 plugin);
-				   });
+	return decoder_plugins_try_suffix(suffix,
+					  [&bridge, path_fs, &is](const DecoderPlugin &plugin){
+						  return TryDecoderFile(bridge,
+									path_fs,
+									is,
+									plugin);
+					  });
+}
+
+/**
+ * Subscribe to the #SharedDecoder of the given remote URI and pass
+ * its data to this decoder.
+ *
+ * DecoderControl::mutex is not locked.
+ */
+static bool
+decoder_run_shared(DecoderBridge &bridge, const char *uri)
+{
+	SharedDecoderSubscription subscription(bridge.dc, uri);
+	return subscription.Run(bridge);
 }
 
 /**
@@ -381,9 +439,13 @@ static bool
 DecoderUnlockedRunUri(DecoderBridge &bridge,
 		      const char *real_uri, Path path_fs)
 try {
-	return !path_fs.IsNull()
-		? decoder_run_file(bridge, real_uri, path_fs)
-		: decoder_run_stream(bridge, real_uri);
+	if (!path_fs.IsNull())
+		return decoder_run_file(bridge, real_uri, path_fs);
+
+	if (bridge.dc.shared_decoder && bridge.dc.start_time.IsZero())
+		return decoder_run_shared(bridge, real_uri);
+
+	return decoder_run_stream(bridge, real_uri);
 } catch (StopDecoder) {
 	return true;
 } catch (...) {
@@ -409,6 +471,36 @@ SongHasVolatileTags(const DetachedSong &song) noexcept
 	return !song.IsFile() && !HasRemoteTagScanner(song.GetRealURI());
 }
 
+static void
+LogDecoderStats(const DetachedSong &song, const DecoderStats &stats) noexcept
+{
+	if (!stats.IsDefined() || stats.frames == 0)
+		return;
+
+	const std::string uri = uri_remove_auth(song.GetURI());
+
+	if (stats.HasCPUTime()) {
+		const FloatDuration cpu_time = stats.cpu_time;
+		const auto audio_duration = stats.GetAudioDuration();
+		FormatInfo(decoder_thread_domain,
+			   "decoded %s with %s: %.1fs audio, %.3fs CPU (%.1fms per second of audio, %.0fx realtime), %" PRIu64 " bytes read",
+			   uri.empty() ? song.GetURI() : uri.c_str(),
+			   stats.plugin,
+			   audio_duration.count(), cpu_time.count(),
+			   audio_duration.count() > 0
+			   ? cpu_time.count() * 1000 / audio_duration.count()
+			   : 0.,
+			   stats.GetRealtimeFactor(),
+			   stats.bytes_read);
+	} else
+		FormatInfo(decoder_thread_domain,
+			   "decoded %s with %s: %.1fs audio, %" PRIu64 " bytes read",
+			   uri.empty() ? song.GetURI() : uri.c_str(),
+			   stats.plugin,
+			   stats.GetAudioDuration().count(),
+			   stats.bytes_read);
+}
+
 /**
  * Decode a song addressed by a #DetachedSong.
  *
@@ -431,6 +523,12 @@ decoder_run_song(DecoderControl &dc,
 				played it*/
 			     !SongHasVolatileTags(song) ? std::make_unique<Tag>(song.GetTag()) : nullptr);
 
+	if (song.GetReplayGain().IsDefined())
+		/* the values measured by the database update are used
+		   until the decoder plugin finds ReplayGain tags */
+		bridge.SubmitReplayGain(&song.GetReplayGain());
+
+	dc.stats = {};
 	dc.state = DecoderState::START;
 	dc.CommandFinishedLocked();
 
@@ -447,6 +545,9 @@ decoder_run_song(DecoderControl &dc,
 
 	}
 
+	bridge.UpdateStats();
+	LogDecoderStats(song, dc.stats);
+
 	bridge.CheckRethrowError();
 
 	if (success)
@@ -497,6 +598,22 @@ DecoderControl::RunThread() noexcept
 {
 	SetThreadName("decoder");
 
+	if (realtime) {
+		try {
+			SetThreadRealtime();
+		} catch (...) {
+			Log(LogLevel::INFO, std::current_exception(),
+			    "DecoderThread could not get realtime scheduling, continuing anyway");
+		}
+	}
+
+	try {
+		ApplyThreadScheduling("decoder");
+	} catch (...) {
+		Log(LogLevel::WARNING, std::current_exception(),
+		    "Failed to apply \"thread\" settings");
+	}
+
 	std::unique_lock<Mutex> lock(mutex);
 
 	do {
@@ -31,7 +31,7 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
-#include "util/bit_reverse.h"
+#include "pcm/BitReverse.hxx"
 #include "util/ByteOrder.hxx"
 #include "util/StringView.hxx"
 #include "tag/Handler.hxx"
@@ -341,13 +341,6 @@ dsdiff_read_metadata(DecoderClient *client, InputStream &is,
 	}
 }
 
-static void
-bit_reverse_buffer(uint8_t *p, uint8_t *end)
-{
-	for (; p < end; ++p)
-		*p = bit_reverse(*p);
-}
-
 static offset_type
 FrameToOffset(uint64_t frame, unsigned channels)
 {
@@ -406,7 +399,7 @@ dsdiff_decode_chunk(DecoderClient &client, InputStream &is,
 		remaining_bytes -= nbytes;
 
 		if (lsbitfirst)
-			bit_reverse_buffer(buffer, buffer + nbytes);
+			PcmBitReverse(buffer, buffer, nbytes);
 
 		cmd = client.SubmitData(is, buffer, nbytes,
 					kbit_rate);
@@ -32,7 +32,8 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
-#include "util/bit_reverse.h"
+#include "pcm/BitReverse.hxx"
+#include "pcm/Interleave.hxx"
 #include "util/ByteOrder.hxx"
 #include "DsdLib.hxx"
 #include "tag/Handler.hxx"
@@ -180,13 +181,6 @@ dsf_read_metadata(DecoderClient *client, InputStream &is,
 	return true;
 }
 
-static void
-bit_reverse_buffer(uint8_t *p, uint8_t *end)
-{
-	for (; p < end; ++p)
-		*p = bit_reverse(*p);
-}
-
 static void
 InterleaveDsfBlockMono(uint8_t *gcc_restrict dest,
 		       const uint8_t *gcc_restrict src)
@@ -195,49 +189,27 @@ InterleaveDsfBlockMono(uint8_t *gcc_restrict dest,
 }
 
 /**
- * DSF data is build up of alternating 4096 blocks of DSD samples for left and
- * right. Convert the buffer holding 1 block of 4096 DSD left samples and 1
- * block of 4096 DSD right samples to 8k of samples in normal PCM left/right
- * order.
+ * DSF data is build up of alternating 4096 blocks of DSD samples for
+ * each channel.  Convert the buffer holding one such block per
+ * channel to samples in normal PCM frame order.
  */
-static void
-InterleaveDsfBlockStereo(uint8_t *gcc_restrict dest,
-			 const uint8_t *gcc_restrict src)
-{
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i) {
-		dest[2 * i] = src[i];
-		dest[2 * i + 1] = src[DSF_BLOCK_SIZE + i];
-	}
-}
-
-static void
-InterleaveDsfBlockChannel(uint8_t *gcc_restrict dest,
-			  const uint8_t *gcc_restrict src,
-			  unsigned channels)
-{
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i, dest += channels, ++src)
-		*dest = *src;
-}
-
-static void
-InterleaveDsfBlockGeneric(uint8_t *gcc_restrict dest,
-			  const uint8_t *gcc_restrict src,
-			  unsigned channels)
-{
-	for (unsigned c = 0; c < channels; ++c, ++dest, src += DSF_BLOCK_SIZE)
-		InterleaveDsfBlockChannel(dest, src, channels);
-}
-
 static void
 InterleaveDsfBlock(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
 		   unsigned channels)
 {
-	if (channels == 1)
+	if (channels == 1) {
 		InterleaveDsfBlockMono(dest, src);
-	else if (channels == 2)
-		InterleaveDsfBlockStereo(dest, src);
-	else
-		InterleaveDsfBlockGeneric(dest, src, channels);
+		return;
+	}
+
+	const uint8_t *channel_blocks[MAX_CHANNELS];
+	for (unsigned c = 0; c < channels; ++c)
+		channel_blocks[c] = src + c * DSF_BLOCK_SIZE;
+
+	PcmInterleave(dest,
+		      ConstBuffer<const void *>((const void *const*)channel_blocks,
+						channels),
+		      DSF_BLOCK_SIZE, 1);
 }
 
 static offset_type
@@ -284,7 +256,7 @@ dsf_decode_chunk(DecoderClient &client, InputStream &is,
 			return false;
 
 		if (bitreverse)
-			bit_reverse_buffer(buffer, buffer + block_size);
+			PcmBitReverse(buffer, buffer, block_size);
 
 		uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
 		InterleaveDsfBlock(interleaved_buffer, buffer, channels);
@@ -20,6 +20,8 @@
 #include "FaadDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
 #include "../DecoderBuffer.hxx"
+#include "../SeekTable.hxx"
+#include "../SeekTableCache.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
@@ -42,6 +44,16 @@ static const unsigned adts_sample_rates[] =
 
 static constexpr Domain faad_decoder_domain("faad_decoder");
 
+/**
+ * The number of PCM frames in one AAC frame.
+ */
+static constexpr unsigned AAC_FRAME_SIZE = 1024;
+
+/**
+ * Record every n'th ADTS frame in the seek table.
+ */
+static constexpr unsigned SEEK_TABLE_STEP = 16;
+
 /**
  * Check whether the buffer head is an AAC frame, and return the frame
  * length.  Returns 0 if it is not a frame.
@@ -107,8 +119,25 @@ adts_find_frame(DecoderBuffer &buffer)
 	}
 }
 
+/**
+ * The offset of the data at the beginning of the #DecoderBuffer.
+ */
+gcc_pure
+static offset_type
+GetBufferOffset(const DecoderBuffer &buffer) noexcept
+{
+	return buffer.GetStream().GetOffset() - buffer.GetAvailable();
+}
+
+/**
+ * Determine the duration of an ADTS stream by reading all frames.
+ *
+ * @param table if not nullptr, then the frame offsets are recorded
+ * in this table; if it is already complete (loaded from the cache),
+ * it is used instead of reading all frames
+ */
 static SignedSongTime
-adts_song_duration(DecoderBuffer &buffer)
+adts_song_duration(DecoderBuffer &buffer, SeekTable *table)
 {
 	const InputStream &is = buffer.GetStream();
 	const bool estimate = !is.CheapSeeking();
@@ -117,6 +146,25 @@ adts_song_duration(DecoderBuffer &buffer)
 
 	unsigned sample_rate = 0;
 
+	if (table != nullptr && table->IsComplete()) {
+		/* we only need the sample rate from the first
+		   frame */
+		if (adts_find_frame(buffer) == 0)
+			return SignedSongTime::Negative();
+
+		auto data = ConstBuffer<uint8_t>::FromVoid(buffer.Read());
+		sample_rate = adts_sample_rates[(data.data[2] & 0x3c) >> 2];
+		if (sample_rate == 0)
+			return SignedSongTime::Negative();
+
+		return SignedSongTime::FromScale<uint64_t>(table->n_frames * AAC_FRAME_SIZE,
+							   sample_rate);
+	}
+
+	if (table != nullptr && estimate)
+		/* we won't see all frames */
+		table = nullptr;
+
 	/* Read all frames to ensure correct time and bitrate */
 	unsigned frames = 0;
 	for (;; frames++) {
@@ -134,6 +182,9 @@ adts_song_duration(DecoderBuffer &buffer)
 				break;
 		}
 
+		if (table != nullptr)
+			table->Add(frames, GetBufferOffset(buffer));
+
 		buffer.Consume(frame_length);
 
 		if (estimate && frames == 128) {
@@ -154,15 +205,25 @@ adts_song_duration(DecoderBuffer &buffer)
 		}
 	}
 
-	if (sample_rate == 0)
+	if (sample_rate == 0) {
+		if (table != nullptr)
+			table->Clear();
 		return SignedSongTime::Negative();
+	}
 
-	return SignedSongTime::FromScale<uint64_t>(frames * uint64_t(1024),
+	if (table != nullptr && frames > 0)
+		table->n_frames = frames;
+
+	return SignedSongTime::FromScale<uint64_t>(frames * uint64_t(AAC_FRAME_SIZE),
 						   sample_rate);
 }
 
+/**
+ * @param table see adts_song_duration()
+ */
 static SignedSongTime
-faad_song_duration(DecoderBuffer &buffer, InputStream &is)
+faad_song_duration(DecoderBuffer &buffer, InputStream &is,
+		   SeekTable *table=nullptr)
 {
 	auto data = ConstBuffer<uint8_t>::FromVoid(buffer.Need(5));
 	if (data.IsNull())
@@ -191,7 +252,7 @@ faad_song_duration(DecoderBuffer &buffer, InputStream &is)
 		if (!is.IsSeekable())
 			return SignedSongTime::Negative();
 
-		auto song_length = adts_song_duration(buffer);
+		auto song_length = adts_song_duration(buffer, table);
 
 		try {
 			is.LockSeek(tagsize);
@@ -302,9 +363,19 @@ faad_get_file_time(InputStream &is)
 {
 	DecoderBuffer buffer(nullptr, is,
 			     FAAD_MIN_STREAMSIZE * MAX_CHANNELS);
-	auto duration = faad_song_duration(buffer, is);
+
+	/* since all frames are read anyway, this is a good chance
+	   to fill the seek table cache */
+	SeekTable table(SEEK_TABLE_STEP);
+	const bool use_cache = seek_table_cache_enabled() &&
+		is.IsSeekable();
+	auto duration = faad_song_duration(buffer, is,
+					   use_cache ? &table : nullptr);
 	bool recognized = !duration.IsNegative();
 
+	if (recognized && table.IsComplete())
+		seek_table_cache_store("faad", is, table);
+
 	if (!recognized) {
 		NeAACDecHandle decoder = faad_decoder_new();
 		AtScopeExit(decoder) { NeAACDecClose(decoder); };
@@ -322,11 +393,90 @@ faad_get_file_time(InputStream &is)
 	return std::make_pair(recognized, duration);
 }
 
+/**
+ * Seek to the specified position with the help of the seek table.
+ *
+ * @param frame_r on success, the number of the ADTS frame which was
+ * found is returned here
+ * @param time_r on success, the actual position is returned here
+ * @return true on success
+ */
+static bool
+faad_seek(InputStream &is, DecoderBuffer &buffer,
+	  const SeekTable &table, SongTime t,
+	  uint64_t &frame_r, FloatDuration &time_r)
+{
+	if (table.empty())
+		return false;
+
+	/* the ADTS sample rate differs from the output sample rate
+	   with implicit SBR, therefore obtain it from the first ADTS
+	   header */
+	try {
+		is.LockSeek(table.offsets[0]);
+	} catch (...) {
+		LogError(std::current_exception());
+		return false;
+	}
+
+	buffer.Clear();
+
+	if (adts_find_frame(buffer) == 0)
+		return false;
+
+	const auto data = ConstBuffer<uint8_t>::FromVoid(buffer.Read());
+	const unsigned sample_rate =
+		adts_sample_rates[(data.data[2] & 0x3c) >> 2];
+	if (sample_rate == 0)
+		return false;
+
+	uint64_t frame = t.ToScale<uint64_t>(sample_rate) / AAC_FRAME_SIZE;
+	if (table.IsComplete() && frame >= table.n_frames)
+		return false;
+
+	const size_t i = table.Find(frame);
+
+	try {
+		is.LockSeek(table.offsets[i]);
+	} catch (...) {
+		LogError(std::current_exception());
+		return false;
+	}
+
+	buffer.Clear();
+
+	/* skip the frames between the table entry and the
+	   destination; this only needs to parse the ADTS headers */
+	for (uint64_t n = uint64_t(i) * table.step; n < frame; ++n) {
+		const size_t frame_length = adts_find_frame(buffer);
+		if (frame_length == 0)
+			return false;
+
+		buffer.Consume(frame_length);
+	}
+
+	frame_r = frame;
+	time_r = FloatDuration(frame * AAC_FRAME_SIZE) / sample_rate;
+	return true;
+}
+
 static void
 faad_stream_decode(DecoderClient &client, InputStream &is,
 		   DecoderBuffer &buffer, const NeAACDecHandle decoder)
 {
-	const auto total_time = faad_song_duration(buffer, is);
+	/* the seek table is loaded from the cache or built while
+	   determining the duration */
+	SeekTable seek_table(SEEK_TABLE_STEP);
+	const bool use_seek_table = is.IsSeekable();
+	if (use_seek_table)
+		seek_table_cache_load("faad", is, seek_table);
+
+	const bool was_cached = seek_table.IsComplete();
+	const auto total_time =
+		faad_song_duration(buffer, is,
+				   use_seek_table ? &seek_table : nullptr);
+	if (!was_cached && seek_table.IsComplete())
+		seek_table_cache_store("faad", is, seek_table);
 
 	if (adts_find_frame(buffer) == 0)
 		return;
@@ -338,7 +488,7 @@ faad_stream_decode(DecoderClient &client, InputStream &is,
 
 	/* initialize the MPD core */
 
-	client.Ready(audio_format, false, total_time);
+	client.Ready(audio_format, seek_table.IsComplete(), total_time);
 
 	/* the decoder loop */
 
@@ -395,6 +545,20 @@ faad_stream_decode(DecoderClient &client, InputStream &is,
 		cmd = client.SubmitData(is, decoded,
 					(size_t)frame_info.samples * 2,
 					bit_rate);
+
+		if (cmd == DecoderCommand::SEEK) {
+			uint64_t frame;
+			FloatDuration position;
+			if (faad_seek(is, buffer, seek_table,
+				      client.GetSeekTime(), frame, position)) {
+				NeAACDecPostSeekReset(decoder, frame);
+				client.CommandFinished();
+				client.SubmitTimestamp(position);
+			} else
+				client.SeekError();
+
+			cmd = DecoderCommand::NONE;
+		}
 	} while (cmd != DecoderCommand::STOP);
 }
 
@@ -34,6 +34,7 @@
 #include "FfmpegMetaData.hxx"
 #include "FfmpegIo.hxx"
 #include "pcm/Interleave.hxx"
+#include "pcm/ChannelDefs.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Handler.hxx"
 #include "tag/ReplayGain.hxx"
@@ -42,6 +43,8 @@
 #include "CheckAudioFormat.hxx"
 #include "util/ScopeExit.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/StringAPI.hxx"
 #include "LogV.hxx"
 
 extern "C" {
@@ -52,6 +55,8 @@ extern "C" {
 #include <libavutil/frame.h>
 }
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
@@ -60,6 +65,11 @@ extern "C" {
  */
 static AVDictionary *avformat_options = nullptr;
 
+/**
+ * Decoder options to be passed to avcodec_open2().
+ */
+static AVDictionary *avcodec_options = nullptr;
+
 static Ffmpeg::FormatContext
 FfmpegOpenInput(AVIOContext *pb,
 		const char *filename,
@@ -92,12 +102,35 @@ ffmpeg_init(const ConfigBlock &block)
 			av_dict_set(&avformat_options, name, value, 0);
 	}
 
+	/* multi-threaded decoding; frame threading delays the output
+	   by a few frames, which is handled by flushing the decoder
+	   at the end of the file and by carrying the seek skip over
+	   to the delayed frames */
+
+	const char *threads = block.GetBlockValue("threads");
+	if (threads != nullptr)
+		av_dict_set(&avcodec_options, "threads",
+			    StringIsEqual(threads, "0") ? "auto" : threads,
+			    0);
+
+	const char *thread_type = block.GetBlockValue("thread_type");
+	if (thread_type != nullptr) {
+		if (!StringIsEqual(thread_type, "frame") &&
+		    !StringIsEqual(thread_type, "slice") &&
+		    !StringIsEqual(thread_type, "frame+slice"))
+			throw FormatRuntimeError("Invalid thread_type: %s",
+						 thread_type);
+
+		av_dict_set(&avcodec_options, "thread_type", thread_type, 0);
+	}
+
 	return true;
 }
 
 static void
 ffmpeg_finish() noexcept
 {
+	av_dict_free(&avcodec_options);
 	av_dict_free(&avformat_options);
 }
 
@@ -201,6 +234,59 @@ PtsToPcmFrame(uint64_t pts, const AVStream &stream,
 	return av_rescale_q(pts, stream.time_base, codec_context.time_base);
 }
 
+/**
+ * Interleave a planar #AVFrame directly into the buffers obtained
+ * from DecoderClient::GetSubmitBuffer(), which saves one copy.
+ *
+ * @param offset the first PCM frame to be submitted
+ * @param cmd_r the command returned by
+ * DecoderClient::CommitSubmitBuffer()
+ * @return the number of PCM frames which were consumed; the rest
+ * needs to be submitted with DecoderClient::SubmitData()
+ */
+static size_t
+FfmpegSubmitPlanarDirect(DecoderClient &client, InputStream &is,
+			 const AVCodecContext &codec_context,
+			 const AVFrame &frame, size_t offset,
+			 DecoderCommand &cmd_r) noexcept
+{
+	const unsigned channels = codec_context.channels;
+	const size_t sample_size =
+		av_get_bytes_per_sample(codec_context.sample_fmt);
+	const size_t frame_size = sample_size * channels;
+	const size_t n_frames = frame.nb_samples;
+
+	assert(channels <= MAX_CHANNELS);
+
+	const void *planes[MAX_CHANNELS];
+
+	while (offset < n_frames) {
+		auto dest = client.GetSubmitBuffer(&is,
+						   codec_context.bit_rate / 1000);
+		if (dest.empty())
+			break;
+
+		const size_t n = std::min(dest.size / frame_size,
+					  n_frames - offset);
+
+		for (unsigned c = 0; c < channels; ++c)
+			planes[c] = frame.extended_data[c] + offset * sample_size;
+
+		PcmInterleave(dest.data,
+			      ConstBuffer<const void *>(planes, channels),
+			      n, sample_size);
+		offset += n;
+
+		cmd_r = client.CommitSubmitBuffer(n * frame_size);
+		if (cmd_r != DecoderCommand::NONE)
+			/* discard the rest, just like SubmitData()
+			   would */
+			return n_frames;
+	}
+
+	return offset;
+}
+
 /**
  * Invoke DecoderClient::SubmitData() with the contents of an
  * #AVFrame.
@@ -212,6 +298,35 @@ FfmpegSendFrame(DecoderClient &client, InputStream &is,
 		size_t &skip_bytes,
 		FfmpegBuffer &buffer)
 {
+	assert(frame.nb_samples > 0);
+
+	if (av_sample_fmt_is_planar(codec_context.sample_fmt) &&
+	    codec_context.channels > 1) {
+		/* try to interleave straight into the MusicChunk */
+
+		const size_t frame_size = codec_context.channels *
+			av_get_bytes_per_sample(codec_context.sample_fmt);
+		const size_t n_frames = frame.nb_samples;
+
+		size_t skip_frames = skip_bytes / frame_size;
+		if (skip_frames >= n_frames) {
+			skip_bytes -= n_frames * frame_size;
+			return DecoderCommand::NONE;
+		}
+
+		skip_bytes = 0;
+
+		DecoderCommand cmd = DecoderCommand::NONE;
+		skip_frames = FfmpegSubmitPlanarDirect(client, is,
+						       codec_context, frame,
+						       skip_frames, cmd);
+		if (skip_frames >= n_frames)
+			return cmd;
+
+		/* submit the rest with the code below */
+		skip_bytes = skip_frames * frame_size;
+	}
+
 	ConstBuffer<void> output_buffer =
 		copy_interleave_frame(codec_context, frame, buffer);
 
@@ -283,6 +398,9 @@ FfmpegReceiveFrames(DecoderClient &client, InputStream &is,
  * @param min_frame skip all data before this PCM frame number; this
  * is used after seeking to skip data in an AVPacket until the exact
  * desired time stamp has been reached
+ * @param skip_bytes the number of PCM bytes which remain to be
+ * skipped; this is kept across packets, because the decoder may
+ * return the frames of this packet later (e.g. with frame threading)
  */
 static DecoderCommand
 ffmpeg_send_packet(DecoderClient &client, InputStream &is,
@@ -291,17 +409,17 @@ ffmpeg_send_packet(DecoderClient &client, InputStream &is,
 		   const AVStream &stream,
 		   AVFrame &frame,
 		   uint64_t min_frame, size_t pcm_frame_size,
+		   size_t &skip_bytes,
 		   FfmpegBuffer &buffer)
 {
-	size_t skip_bytes = 0;
-
 	const auto pts = StreamRelativePts(packet, stream);
 	if (pts >= 0) {
 		if (min_frame > 0) {
 			auto cur_frame = PtsToPcmFrame(pts, stream,
 						       codec_context);
-			if (cur_frame < min_frame)
-				skip_bytes = pcm_frame_size * (min_frame - cur_frame);
+			skip_bytes = cur_frame < min_frame
+				? pcm_frame_size * (min_frame - cur_frame)
+				: 0;
 		} else
 			client.SubmitTimestamp(FfmpegTimeToDouble(pts,
 								  stream.time_base));
@@ -346,6 +464,7 @@ ffmpeg_send_packet(DecoderClient &client, InputStream &is,
 		   const AVStream &stream,
 		   AVFrame &frame,
 		   uint64_t min_frame, size_t pcm_frame_size,
+		   size_t &skip_bytes,
 		   FfmpegBuffer &buffer)
 {
 	return ffmpeg_send_packet(client, is,
@@ -354,9 +473,29 @@ ffmpeg_send_packet(DecoderClient &client, InputStream &is,
 				  AVPacket(packet),
 				  codec_context, stream,
 				  frame, min_frame, pcm_frame_size,
+				  skip_bytes,
 				  buffer);
 }
 
+/**
+ * Enter draining mode and submit the frames which are still buffered
+ * inside the decoder.
+ */
+static DecoderCommand
+FfmpegDrain(DecoderClient &client, InputStream &is,
+	    AVCodecContext &codec_context,
+	    AVFrame &frame,
+	    size_t &skip_bytes,
+	    FfmpegBuffer &buffer)
+{
+	if (avcodec_send_packet(&codec_context, nullptr) < 0)
+		return DecoderCommand::NONE;
+
+	bool eof = false;
+	return FfmpegReceiveFrames(client, is, codec_context,
+				   frame, skip_bytes, buffer, eof);
+}
+
 gcc_const
 static SampleFormat
 ffmpeg_sample_format(enum AVSampleFormat sample_fmt) noexcept
@@ -514,7 +653,11 @@ FfmpegDecode(DecoderClient &client, InputStream &input,
 
 	Ffmpeg::CodecContext codec_context(*codec);
 	codec_context.FillFromParameters(*av_stream.codecpar);
-	codec_context.Open(*codec, nullptr);
+	AVDictionary *codec_options = nullptr;
+	AtScopeExit(&codec_options) { av_dict_free(&codec_options); };
+	av_dict_copy(&codec_options, avcodec_options, 0);
+
+	codec_context.Open(*codec, &codec_options);
 
 	const SampleFormat sample_format =
 		ffmpeg_sample_format(codec_context->sample_fmt);
@@ -541,6 +684,7 @@ FfmpegDecode(DecoderClient &client, InputStream &input,
 	FfmpegBuffer interleaved_buffer;
 
 	uint64_t min_frame = 0;
+	size_t skip_bytes = 0;
 
 	DecoderCommand cmd = client.GetCommand();
 	while (cmd != DecoderCommand::STOP) {
@@ -564,9 +708,19 @@ FfmpegDecode(DecoderClient &client, InputStream &input,
 		}
 
 		AVPacket packet;
-		if (av_read_frame(&format_context, &packet) < 0)
+		if (av_read_frame(&format_context, &packet) < 0) {
 			/* end of file */
+
+			cmd = FfmpegDrain(client, input, *codec_context,
+					  *frame, skip_bytes,
+					  interleaved_buffer);
+			if (cmd == DecoderCommand::SEEK)
+				/* the seek flushes the decoder, which
+				   leaves draining mode */
+				continue;
+
 			break;
+		}
 
 		AtScopeExit(&packet) {
 			av_packet_unref(&packet);
@@ -581,6 +735,7 @@ FfmpegDecode(DecoderClient &client, InputStream &input,
 						 av_stream,
 						 *frame,
 						 min_frame, audio_format.GetFrameSize(),
+						 skip_bytes,
 						 interleaved_buffer);
 			min_frame = 0;
 		} else
@@ -26,6 +26,7 @@
 #include "Log.hxx"
 #include "input/InputStream.hxx"
 
+#include <algorithm>
 #include <exception>
 
 bool
@@ -134,6 +135,35 @@ FlacDecoder::GetDeltaPosition(const FLAC__StreamDecoder &sd)
 	return nbytes;
 }
 
+inline size_t
+FlacDecoder::SubmitDirect(const FLAC__int32 *const buf[],
+			  size_t n_frames) noexcept
+{
+	DecoderClient &decoder_client = *GetClient();
+	const size_t frame_size = pcm_import.GetAudioFormat().GetFrameSize();
+
+	size_t done = 0;
+	while (done < n_frames) {
+		auto dest = decoder_client.GetSubmitBuffer(&GetInputStream(),
+							   kbit_rate);
+		if (dest.empty())
+			break;
+
+		const size_t n = std::min(dest.size / frame_size,
+					  n_frames - done);
+		pcm_import.ImportTo(dest.data, buf, done, n);
+		done += n;
+
+		command = decoder_client.CommitSubmitBuffer(n * frame_size);
+		if (command != DecoderCommand::NONE)
+			/* discard the rest, just like SubmitData()
+			   would */
+			return n_frames;
+	}
+
+	return done;
+}
+
 FLAC__StreamDecoderWriteStatus
 FlacDecoder::OnWrite(const FLAC__Frame &frame,
 		     const FLAC__int32 *const buf[],
@@ -142,10 +172,26 @@ FlacDecoder::OnWrite(const FLAC__Frame &frame,
 	if (!initialized && !OnFirstFrame(frame.header))
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-	chunk = pcm_import.Import(buf, frame.header.blocksize);
-
 	kbit_rate = nbytes * 8 * frame.header.sample_rate /
 		(1000 * frame.header.blocksize);
 
+	const size_t n_frames = frame.header.blocksize;
+	size_t offset = 0;
+
+	/* the tag must be submitted before the data; if there is
+	   one, let FlacSubmitToClient() do everything */
+	if (tag.IsEmpty() && command == DecoderCommand::NONE)
+		offset = SubmitDirect(buf, n_frames);
+
+	if (offset == 0)
+		chunk = pcm_import.Import(buf, n_frames);
+	else if (offset < n_frames) {
+		const FLAC__int32 *rest[FLAC__MAX_CHANNELS];
+		for (unsigned c = 0; c < frame.header.channels; ++c)
+			rest[c] = buf[c] + offset;
+
+		chunk = pcm_import.Import(rest, n_frames - offset);
+	}
+
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
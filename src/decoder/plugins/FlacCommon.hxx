@@ -65,6 +65,14 @@ struct FlacDecoder : public FlacInput {
 	 */
 	ConstBuffer<void> chunk = nullptr;
 
+	/**
+	 * A command which was returned by
+	 * DecoderClient::CommitSubmitBuffer() inside the libFLAC
+	 * write callback; it will be returned by the next
+	 * FlacSubmitToClient() call.
+	 */
+	DecoderCommand command = DecoderCommand::NONE;
+
 	FlacDecoder(DecoderClient &_client, InputStream &_input_stream)
 		:FlacInput(_input_stream, &_client) {}
 
@@ -98,6 +106,16 @@ private:
 	 * (e.g. when seeking with SqueezeBox Server).
 	 */
 	bool OnFirstFrame(const FLAC__FrameHeader &header);
+
+	/**
+	 * Write decoded PCM data directly into the buffer provided
+	 * by DecoderClient::GetSubmitBuffer().
+	 *
+	 * @return the number of frames which were consumed (the rest
+	 * needs to be submitted with DecoderClient::SubmitData())
+	 */
+	size_t SubmitDirect(const FLAC__int32 *const buf[],
+			    size_t n_frames) noexcept;
 };
 
 #endif /* _FLAC_COMMON_H */
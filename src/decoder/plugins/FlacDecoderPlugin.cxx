@@ -140,6 +140,14 @@ flac_decoder_initialize(FlacDecoder *data, FLAC__StreamDecoder *sd)
 static DecoderCommand
 FlacSubmitToClient(DecoderClient &client, FlacDecoder &d) noexcept
 {
+	if (d.command != DecoderCommand::NONE) {
+		/* the write callback has already submitted the data
+		   and received a command */
+		const auto cmd = d.command;
+		d.command = DecoderCommand::NONE;
+		return cmd;
+	}
+
 	if (d.tag.IsEmpty() && d.chunk.empty())
 		return client.GetCommand();
 
@@ -23,6 +23,8 @@
 #include "util/RuntimeError.hxx"
 #include "util/ConstBuffer.hxx"
 
+#include <FLAC/format.h>
+
 #include <assert.h>
 
 void
@@ -80,6 +82,41 @@ FlacImport(PcmBuffer &buffer, const FLAC__int32 *const src[], size_t n_frames,
 	return {dest, dest_size};
 }
 
+void
+FlacPcmImport::ImportTo(void *dest, const FLAC__int32 *const src[],
+			size_t offset, size_t n_frames) const noexcept
+{
+	const FLAC__int32 *src2[FLAC__MAX_CHANNELS];
+	for (unsigned c = 0; c < audio_format.channels; ++c)
+		src2[c] = src[c] + offset;
+
+	switch (audio_format.format) {
+	case SampleFormat::S16:
+		FlacImport((int16_t *)dest, src2, n_frames,
+			   audio_format.channels);
+		return;
+
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+		FlacImport((int32_t *)dest, src2, n_frames,
+			   audio_format.channels);
+		return;
+
+	case SampleFormat::S8:
+		FlacImport((int8_t *)dest, src2, n_frames,
+			   audio_format.channels);
+		return;
+
+	case SampleFormat::FLOAT:
+	case SampleFormat::DSD:
+	case SampleFormat::UNDEFINED:
+		break;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
 ConstBuffer<void>
 FlacPcmImport::Import(const FLAC__int32 *const src[], size_t n_frames)
 {
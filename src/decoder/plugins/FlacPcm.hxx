@@ -49,6 +49,15 @@ public:
 
 	ConstBuffer<void> Import(const FLAC__int32 *const src[],
 				 size_t n_frames);
+
+	/**
+	 * Import a range of frames into the specified buffer, which
+	 * must be large enough.
+	 *
+	 * @param offset the first frame to be imported
+	 */
+	void ImportTo(void *dest, const FLAC__int32 *const src[],
+		      size_t offset, size_t n_frames) const noexcept;
 };
 
 #endif
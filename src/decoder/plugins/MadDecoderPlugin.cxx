@@ -20,6 +20,8 @@
 #include "config.h"
 #include "MadDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekTable.hxx"
+#include "../SeekTableCache.hxx"
 #include "input/InputStream.hxx"
 #include "tag/Id3Scan.hxx"
 #include "tag/Id3ReplayGain.hxx"
@@ -39,6 +41,8 @@
 #include <id3tag.h>
 #endif
 
+#include <algorithm>
+
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -46,6 +50,11 @@
 
 static constexpr unsigned long FRAMES_CUSHION = 2000;
 
+/**
+ * Record every n'th frame in the persistent seek table.
+ */
+static constexpr unsigned SEEK_TABLE_STEP = 16;
+
 enum class MadDecoderAction {
 	SKIP,
 	BREAK,
@@ -114,6 +123,14 @@ class MadDecoder {
 	size_t highest_frame = 0;
 	size_t max_frames = 0;
 	size_t current_frame = 0;
+
+	/**
+	 * The seek table loaded from the cache; it allows seeking
+	 * beyond #highest_frame without decoding all frames in
+	 * between.
+	 */
+	SeekTable seek_table{SEEK_TABLE_STEP};
+
 	unsigned int drop_start_frames;
 	unsigned int drop_end_frames;
 	unsigned int drop_start_samples = 0;
@@ -171,6 +188,19 @@ private:
 	gcc_pure
 	size_t TimeToFrame(SongTime t) const noexcept;
 
+	/**
+	 * Seek with the help of #seek_table.
+	 *
+	 * @return false if the table does not help
+	 */
+	bool SeekCached(SongTime t) noexcept;
+
+	/**
+	 * Store the frame offsets in the seek table cache, if they
+	 * cover more than the table which was loaded.
+	 */
+	void StoreSeekTable() noexcept;
+
 	/**
 	 * Record the current frame's offset in the "frame_offsets"
 	 * buffer and go forward to the next frame, updating the
@@ -776,21 +806,63 @@ MadDecoder::~MadDecoder() noexcept
 size_t
 MadDecoder::TimeToFrame(SongTime t) const noexcept
 {
-	size_t i;
+	/* "times" is sorted, so we can use a binary search */
+	return std::lower_bound(times, times + highest_frame, t,
+				[](const mad_timer_t &a, SongTime b){
+					return ToSongTime(a) < b;
+				}) - times;
+}
 
-	for (i = 0; i < highest_frame; ++i) {
-		auto frame_time = ToSongTime(times[i]);
-		if (frame_time >= t)
-			break;
-	}
+inline bool
+MadDecoder::SeekCached(SongTime t) noexcept
+{
+	if (seek_table.empty())
+		return false;
 
-	return i;
+	const unsigned samples_per_frame = 32 * MAD_NSBSAMPLES(&frame.header);
+	const uint64_t n = t.ToScale<uint64_t>(frame.header.samplerate)
+		/ samples_per_frame;
+
+	const size_t i = seek_table.Find(n);
+	const size_t frame_number = i * seek_table.step;
+	if (frame_number <= current_frame || frame_number >= max_frames)
+		/* decoding from here is as fast */
+		return false;
+
+	if (!Seek(seek_table.offsets[i]))
+		return false;
+
+	current_frame = frame_number;
+	timer = frame.header.duration;
+	mad_timer_multiply(&timer, frame_number);
+	elapsed_time = ToSongTime(timer);
+	was_eof = false;
+	return true;
+}
+
+void
+MadDecoder::StoreSeekTable() noexcept
+{
+	if (highest_frame <= seek_table.GetEndFrame())
+		return;
+
+	SeekTable table(SEEK_TABLE_STEP);
+	for (size_t i = 0; i < highest_frame; i += SEEK_TABLE_STEP)
+		table.Add(i, frame_offsets[i]);
+
+	seek_table_cache_store("mad", input_stream, table);
 }
 
 void
 MadDecoder::UpdateTimerNextFrame() noexcept
 {
-	if (current_frame >= highest_frame) {
+	if (current_frame > highest_frame) {
+		/* we have jumped beyond the known frames with
+		   the help of the seek table; don't record
+		   anything here, because "frame_offsets" must not
+		   have holes */
+		mad_timer_add(&timer, frame.header.duration);
+	} else if (current_frame == highest_frame) {
 		/* record this frame's properties in frame_offsets
 		   (for seeking) and times */
 
@@ -908,6 +980,10 @@ MadDecoder::HandleCurrentFrame() noexcept
 					client->CommandFinished();
 				} else
 					client->SeekError();
+			} else if (SeekCached(t)) {
+				seek_time = t;
+				mute_frame = MadDecoderMuteFrame::SEEK;
+				client->CommandFinished();
 			} else {
 				seek_time = t;
 				mute_frame = MadDecoderMuteFrame::SEEK;
@@ -968,6 +1044,9 @@ MadDecoder::RunDecoder() noexcept
 
 	AllocateBuffers();
 
+	if (input_stream.IsSeekable())
+		seek_table_cache_load("mad", input_stream, seek_table);
+
 	client->Ready(CheckAudioFormat(frame.header.samplerate,
 				       SampleFormat::S24_P32,
 				       MAD_NCHANNELS(&frame.header)),
@@ -978,6 +1057,9 @@ MadDecoder::RunDecoder() noexcept
 		client->SubmitTag(input_stream, std::move(tag));
 
 	while (Read()) {}
+
+	if (input_stream.IsSeekable())
+		StoreSeekTable();
 }
 
 static void
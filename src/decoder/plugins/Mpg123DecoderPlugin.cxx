@@ -19,6 +19,8 @@
 
 #include "Mpg123DecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekTable.hxx"
+#include "../SeekTableCache.hxx"
 #include "CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Builder.hxx"
@@ -32,6 +34,8 @@
 
 #include <mpg123.h>
 
+#include <vector>
+
 #include <stdio.h>
 
 static constexpr Domain mpg123_domain("mpg123");
@@ -179,6 +183,52 @@ mpd_mpg123_meta(DecoderClient &client, mpg123_handle *const handle)
 		mpd_mpg123_id3v2(client, *v2);
 }
 
+/**
+ * Pass the seek table from the cache to libmpg123, so it does not
+ * need to scan the file to seek accurately.
+ */
+static void
+mpd_mpg123_load_index(mpg123_handle *handle, Path path_fs,
+		      SeekTable &table) noexcept
+{
+	if (!seek_table_cache_load("mpg123", path_fs, table))
+		return;
+
+	std::vector<off_t> offsets(table.offsets.begin(),
+				   table.offsets.end());
+	int error = mpg123_set_index(handle, offsets.data(),
+				     table.step, offsets.size());
+	if (error != MPG123_OK) {
+		FormatWarning(mpg123_domain,
+			      "mpg123_set_index() failed: %s",
+			      mpg123_plain_strerror(error));
+		table.Clear();
+	}
+}
+
+/**
+ * Store libmpg123's frame index in the seek table cache if it covers
+ * more than the one which was loaded.
+ */
+static void
+mpd_mpg123_store_index(mpg123_handle *handle, Path path_fs,
+		       const SeekTable &loaded) noexcept
+{
+	if (!seek_table_cache_enabled())
+		return;
+
+	off_t *offsets, step;
+	size_t fill;
+	if (mpg123_index(handle, &offsets, &step, &fill) != MPG123_OK ||
+	    fill == 0 || step <= 0 ||
+	    uint64_t(fill) * uint64_t(step) <= loaded.GetEndFrame())
+		return;
+
+	SeekTable table(step);
+	table.offsets.assign(offsets, offsets + fill);
+	seek_table_cache_store("mpg123", path_fs, table);
+}
+
 static void
 mpd_mpg123_file_decode(DecoderClient &client, Path path_fs)
 {
@@ -199,6 +249,9 @@ mpd_mpg123_file_decode(DecoderClient &client, Path path_fs)
 	if (!mpd_mpg123_open(handle, path_fs.c_str(), audio_format))
 		return;
 
+	SeekTable seek_table;
+	mpd_mpg123_load_index(handle, path_fs, seek_table);
+
 	const off_t num_samples = mpg123_length(handle);
 
 	/* tell MPD core we're ready */
@@ -269,6 +322,8 @@ mpd_mpg123_file_decode(DecoderClient &client, Path path_fs)
 			cmd = DecoderCommand::NONE;
 		}
 	} while (cmd == DecoderCommand::NONE);
+
+	mpd_mpg123_store_index(handle, path_fs, seek_table);
 }
 
 static bool
@@ -73,7 +73,12 @@ mpd_opus_init(gcc_unused const ConfigBlock &block)
 
 class MPDOpusDecoder final : public OggDecoder {
 	OpusDecoder *opus_decoder = nullptr;
-	opus_int16 *output_buffer = nullptr;
+
+	/**
+	 * The PCM buffer for opus_decode() or opus_decode_float(),
+	 * depending on #use_float.
+	 */
+	char *output_buffer = nullptr;
 
 	/**
 	 * If non-zero, then a previous Opus stream has been found
@@ -85,6 +90,21 @@ class MPDOpusDecoder final : public OggDecoder {
 
 	size_t frame_size;
 
+	/**
+	 * Decode to SampleFormat::FLOAT with opus_decode_float()
+	 * instead of SampleFormat::S16?  This is enabled if the
+	 * client prefers floating point samples, which avoids
+	 * converting back and forth; libopus works with floating
+	 * point internally.
+	 */
+	bool use_float = false;
+
+	/**
+	 * Reused by HandleTags() for each comment packet (e.g. in
+	 * chained streams), to avoid reallocating its item list.
+	 */
+	TagBuilder tag_builder;
+
 public:
 	explicit MPDOpusDecoder(DecoderReader &reader)
 		:OggDecoder(reader) {}
@@ -172,13 +192,16 @@ MPDOpusDecoder::OnOggBeginning(const ogg_packet &packet)
 		: SignedSongTime::Negative();
 
 	previous_channels = channels;
+	use_float = client.PreferFloat();
 	const AudioFormat audio_format(opus_sample_rate,
-				       SampleFormat::S16, channels);
+				       use_float
+				       ? SampleFormat::FLOAT
+				       : SampleFormat::S16,
+				       channels);
 	client.Ready(audio_format, eos_granulepos > 0, duration);
 	frame_size = audio_format.GetFrameSize();
 
-	output_buffer = new opus_int16[opus_output_buffer_frames
-				       * audio_format.channels];
+	output_buffer = new char[opus_output_buffer_frames * frame_size];
 
 	auto cmd = client.GetCommand();
 	if (cmd != DecoderCommand::NONE)
@@ -205,11 +228,12 @@ MPDOpusDecoder::HandleTags(const ogg_packet &packet)
 	ReplayGainInfo rgi;
 	rgi.Clear();
 
-	TagBuilder tag_builder;
 	AddTagHandler h(tag_builder);
 
-	if (!ScanOpusTags(packet.packet, packet.bytes, &rgi, h))
+	if (!ScanOpusTags(packet.packet, packet.bytes, &rgi, h)) {
+		tag_builder.Clear();
 		return;
+	}
 
 	client.SubmitReplayGain(&rgi);
 
@@ -226,11 +250,19 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 {
 	assert(opus_decoder != nullptr);
 
-	int nframes = opus_decode(opus_decoder,
-				  (const unsigned char*)packet.packet,
-				  packet.bytes,
-				  output_buffer, opus_output_buffer_frames,
-				  0);
+	int nframes = use_float
+		? opus_decode_float(opus_decoder,
+				    (const unsigned char*)packet.packet,
+				    packet.bytes,
+				    (float *)output_buffer,
+				    opus_output_buffer_frames,
+				    0)
+		: opus_decode(opus_decoder,
+			      (const unsigned char*)packet.packet,
+			      packet.bytes,
+			      (opus_int16 *)output_buffer,
+			      opus_output_buffer_frames,
+			      0);
 	if (nframes < 0)
 		throw FormatRuntimeError("libopus error: %s",
 					 opus_strerror(nframes));
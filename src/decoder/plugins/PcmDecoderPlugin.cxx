@@ -25,6 +25,7 @@
 #include "pcm/Pack.hxx"
 #include "input/InputStream.hxx"
 #include "util/ByteOrder.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/Domain.hxx"
 #include "util/ByteReverse.hxx"
 #include "util/StaticFifoBuffer.hxx"
@@ -181,33 +182,47 @@ pcm_stream_decode(DecoderClient &client, InputStream &is)
 
 	DecoderCommand cmd;
 	do {
-		if (!FillBuffer(client, is, buffer))
-			break;
-
-		auto r = buffer.Read();
-		/* round down to the nearest frame size, because we
-		   must not pass partial frames to
-		   DecoderClient::SubmitData() */
-		r.size -= r.size % in_frame_size;
-		buffer.Consume(r.size);
-
-		if (reverse_endian)
-			/* make sure we deliver samples in host byte order */
-			reverse_bytes_16((uint16_t *)r.data,
-					 (uint16_t *)r.data,
-					 (uint16_t *)(r.data + r.size));
-		else if (l24) {
-			/* convert big-endian packed 24 bit
-			   (audio/L24) to native-endian 24 bit (in 32
-			   bit integers) */
-			pcm_unpack_24be(unpack_buffer, r.begin(), r.end());
-			r.data = (uint8_t *)&unpack_buffer[0];
-			r.size = (r.size / 3) * 4;
+		/* if no conversion is needed, try to submit the data
+		   straight from the input stream's buffer */
+		ConstBuffer<void> direct = nullptr;
+		if (buffer.empty() && !reverse_endian && !l24)
+			direct = decoder_read_direct(&client, is);
+
+		if (direct.size >= in_frame_size) {
+			const size_t nbytes =
+				direct.size - direct.size % in_frame_size;
+			cmd = client.SubmitData(is, direct.data, nbytes, 0);
+			decoder_consume_direct(is, nbytes);
+		} else {
+			if (!FillBuffer(client, is, buffer))
+				break;
+
+			auto r = buffer.Read();
+			/* round down to the nearest frame size, because we
+			   must not pass partial frames to
+			   DecoderClient::SubmitData() */
+			r.size -= r.size % in_frame_size;
+			buffer.Consume(r.size);
+
+			if (reverse_endian)
+				/* make sure we deliver samples in host byte order */
+				reverse_bytes_16((uint16_t *)r.data,
+						 (uint16_t *)r.data,
+						 (uint16_t *)(r.data + r.size));
+			else if (l24) {
+				/* convert big-endian packed 24 bit
+				   (audio/L24) to native-endian 24 bit (in 32
+				   bit integers) */
+				pcm_unpack_24be(unpack_buffer, r.begin(), r.end());
+				r.data = (uint8_t *)&unpack_buffer[0];
+				r.size = (r.size / 3) * 4;
+			}
+
+			cmd = !r.empty()
+				? client.SubmitData(is, r.data, r.size, 0)
+				: client.GetCommand();
 		}
 
-		cmd = !r.empty()
-			? client.SubmitData(is, r.data, r.size, 0)
-			: client.GetCommand();
 		if (cmd == DecoderCommand::SEEK) {
 			uint64_t frame = client.GetSeekFrame();
 			offset_type offset = frame * in_frame_size;
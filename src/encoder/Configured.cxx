@@ -20,10 +20,18 @@
 #include "Configured.hxx"
 #include "EncoderList.hxx"
 #include "EncoderPlugin.hxx"
+#include "EncoderInterface.hxx"
+#include "SharedEncoder.hxx"
+#include "ThreadedEncoder.hxx"
 #include "config/Block.hxx"
 #include "util/StringAPI.hxx"
 #include "util/RuntimeError.hxx"
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
 static const EncoderPlugin &
 GetConfiguredEncoderPlugin(const ConfigBlock &block, bool shout_legacy)
 {
@@ -48,9 +56,71 @@ GetConfiguredEncoderPlugin(const ConfigBlock &block, bool shout_legacy)
 	return *plugin;
 }
 
+/**
+ * Create the encoder, and build a string from its plugin name and
+ * all settings it has queried; encoders with equal keys are
+ * interchangeable.
+ */
+static std::unique_ptr<PreparedEncoder>
+CreateEncoderWithKey(const EncoderPlugin &plugin, const ConfigBlock &block,
+		     std::string &key)
+{
+	/* reset the "used" flags to see which settings the encoder
+	   plugin looks at */
+	std::vector<bool> was_used;
+	was_used.reserve(block.block_params.size());
+	for (const auto &i : block.block_params) {
+		was_used.push_back(i.used);
+		i.used = false;
+	}
+
+	std::unique_ptr<PreparedEncoder> encoder;
+	std::vector<std::string> settings;
+
+	try {
+		encoder.reset(encoder_init(plugin, block));
+	} catch (...) {
+		for (size_t i = 0; i < was_used.size(); ++i)
+			block.block_params[i].used |= was_used[i];
+		throw;
+	}
+
+	for (size_t i = 0; i < was_used.size(); ++i) {
+		const auto &param = block.block_params[i];
+		if (param.used)
+			settings.emplace_back(param.name + '=' + param.value);
+
+		param.used |= was_used[i];
+	}
+
+	/* the order of settings in the configuration file doesn't
+	   matter */
+	std::sort(settings.begin(), settings.end());
+
+	key = plugin.name;
+	for (const auto &i : settings) {
+		key.push_back('\n');
+		key.append(i);
+	}
+
+	return encoder;
+}
+
 PreparedEncoder *
 CreateConfiguredEncoder(const ConfigBlock &block, bool shout_legacy)
 {
-	return encoder_init(GetConfiguredEncoderPlugin(block, shout_legacy),
-			    block);
+	const auto &plugin = GetConfiguredEncoderPlugin(block, shout_legacy);
+
+	std::unique_ptr<PreparedEncoder> encoder;
+	if (block.GetBlockValue("share_encoder", false)) {
+		std::string key;
+		encoder = CreateEncoderWithKey(plugin, block, key);
+		encoder = NewSharedEncoder(std::move(key), std::move(encoder));
+	} else
+		encoder.reset(encoder_init(plugin, block));
+
+	if (block.GetBlockValue("encoder_thread", false))
+		encoder = NewThreadedEncoder(std::move(encoder));
+
+	return encoder.release();
 }
@@ -28,6 +28,10 @@ class PreparedEncoder;
  * #ConfigBlock.  Its "encoder" setting is used to choose the encoder
  * plugin.
  *
+ * If "share_encoder" is enabled, the encoder is shared with all
+ * other outputs which have the same encoder settings (see
+ * NewSharedEncoder()).
+ *
  * Throws an exception on error.
  *
  * @param shout_legacy enable the "shout" plugin legacy configuration?
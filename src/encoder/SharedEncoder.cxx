@@ -0,0 +1,598 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SharedEncoder.hxx"
+#include "EncoderInterface.hxx"
+#include "AudioFormat.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Item.hxx"
+#include "thread/Mutex.hxx"
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+class SharedEncoder;
+
+gcc_pure
+static bool
+TagEquals(const Tag &a, const Tag &b) noexcept
+{
+	if (a.num_items != b.num_items)
+		return false;
+
+	return std::equal(a.begin(), a.end(), b.begin(),
+			  [](const TagItem &x, const TagItem &y){
+				  return x.type == y.type &&
+					  strcmp(x.value, y.value) == 0;
+			  });
+}
+
+/**
+ * Read everything the #Encoder has produced so far.
+ */
+static void
+ReadAll(Encoder &encoder, std::vector<uint8_t> &dest)
+{
+	while (true) {
+		const size_t old_size = dest.size();
+		dest.resize(old_size + 4096);
+
+		const size_t nbytes = encoder.Read(dest.data() + old_size, 4096);
+		dest.resize(old_size + nbytes);
+		if (nbytes == 0)
+			break;
+	}
+}
+
+/**
+ * One #Encoder instance shared by several #SharedEncoder objects.
+ */
+struct SharedEncoderStream {
+	/**
+	 * The maximum number of operations remembered in #log.  A
+	 * consumer which lags behind further loses its place and
+	 * continues with a private stream.
+	 */
+	static constexpr size_t MAX_ENTRIES = 64;
+
+	enum class Operation : uint8_t {
+		WRITE, FLUSH, PRE_TAG, TAG, END,
+	};
+
+	struct Entry {
+		const Operation operation;
+
+		/**
+		 * The PCM data (#Operation::WRITE).
+		 */
+		std::vector<uint8_t> input;
+
+		/**
+		 * The tag (#Operation::TAG).
+		 */
+		std::unique_ptr<Tag> tag;
+
+		/**
+		 * The encoder output generated by this operation.
+		 */
+		std::vector<uint8_t> output;
+
+		explicit Entry(Operation _operation) noexcept
+			:operation(_operation) {}
+
+		gcc_pure
+		bool Matches(Operation _operation,
+			     const void *data, size_t length,
+			     const Tag *_tag) const noexcept {
+			if (_operation != operation)
+				return false;
+
+			switch (operation) {
+			case Operation::WRITE:
+				return length == input.size() &&
+					memcmp(data, input.data(), length) == 0;
+
+			case Operation::TAG:
+				return TagEquals(*tag, *_tag);
+
+			default:
+				return true;
+			}
+		}
+	};
+
+	const std::string key;
+
+	/**
+	 * The #AudioFormat passed to PreparedEncoder::Open().
+	 */
+	const AudioFormat in_audio_format;
+
+	/**
+	 * The #AudioFormat modified by PreparedEncoder::Open().
+	 */
+	AudioFormat out_audio_format;
+
+	/**
+	 * Protects the #encoder and #log.  The #members list is
+	 * protected by #SharedEncoderRegistry::mutex, but the members'
+	 * positions are protected by this one.
+	 */
+	Mutex mutex;
+
+	std::unique_ptr<Encoder> encoder;
+
+	/**
+	 * Data which must be sent to new consumers before they get
+	 * the output of the next operation: the output of
+	 * PreparedEncoder::Open() or of the most recent
+	 * Encoder::SendTag().
+	 */
+	std::vector<uint8_t> header;
+
+	std::deque<Entry> log;
+
+	/**
+	 * The absolute index of the first #log entry.
+	 */
+	uint_least64_t begin = 0;
+
+	std::vector<SharedEncoder *> members;
+
+	/**
+	 * Has Encoder::End() been called?  New consumers will not
+	 * join this stream.
+	 */
+	bool ended = false;
+
+	/**
+	 * Throws on error.
+	 */
+	SharedEncoderStream(const std::string &_key,
+			    PreparedEncoder &prepared,
+			    AudioFormat audio_format)
+		:key(_key), in_audio_format(audio_format),
+		 out_audio_format(audio_format),
+		 encoder(prepared.Open(out_audio_format)) {
+		ReadAll(*encoder, header);
+	}
+
+	uint_least64_t GetEnd() const noexcept {
+		return begin + log.size();
+	}
+
+	/**
+	 * Submit an operation on behalf of a member, which gets the
+	 * output.  Caller must lock the mutex.
+	 *
+	 * Throws on error.
+	 *
+	 * @return false if the member's operation doesn't match the
+	 * operation performed by others at this position
+	 */
+	bool Submit(SharedEncoder &member, Operation operation,
+		    const void *data, size_t length, const Tag *tag);
+
+	gcc_pure
+	unsigned CountActiveMembers() const noexcept;
+
+private:
+	/**
+	 * Perform an operation on the #Encoder and append it to the
+	 * #log.
+	 */
+	Entry &Execute(Operation operation,
+		       const void *data, size_t length, const Tag *tag);
+
+	/**
+	 * Remove entries which are not needed anymore.
+	 */
+	void Prune() noexcept;
+};
+
+class SharedEncoder final : public Encoder {
+	friend struct SharedEncoderStream;
+	friend class SharedEncoderRegistry;
+
+	PreparedEncoder &prepared;
+
+	SharedEncoderStream *stream = nullptr;
+
+	/**
+	 * The absolute index of the next #SharedEncoderStream::log
+	 * entry expected by this object.
+	 */
+	uint_least64_t position;
+
+	/**
+	 * Set by SharedEncoderStream::Prune() when this object has
+	 * fallen behind too far; the next operation switches to a
+	 * private stream.
+	 */
+	bool lost = false;
+
+	/**
+	 * Output which has not yet been consumed by Read().
+	 */
+	std::vector<uint8_t> pending;
+	size_t pending_position = 0;
+
+public:
+	SharedEncoder(PreparedEncoder &_prepared,
+		      bool _implements_tag) noexcept
+		:Encoder(_implements_tag), prepared(_prepared) {}
+
+	~SharedEncoder() noexcept override;
+
+	/* virtual methods from class Encoder */
+	void End() override {
+		Submit(SharedEncoderStream::Operation::END);
+	}
+
+	void Flush() override {
+		Submit(SharedEncoderStream::Operation::FLUSH);
+	}
+
+	void PreTag() override {
+		Submit(SharedEncoderStream::Operation::PRE_TAG);
+	}
+
+	void SendTag(const Tag &tag) override {
+		Submit(SharedEncoderStream::Operation::TAG,
+		       nullptr, 0, &tag);
+	}
+
+	void Write(const void *data, size_t length) override {
+		Submit(SharedEncoderStream::Operation::WRITE, data, length);
+	}
+
+	size_t Read(void *dest, size_t length) noexcept override;
+
+private:
+	void Submit(SharedEncoderStream::Operation operation,
+		    const void *data=nullptr, size_t length=0,
+		    const Tag *tag=nullptr);
+
+	void Append(const std::vector<uint8_t> &src) noexcept {
+		if (pending_position == pending.size()) {
+			pending.clear();
+			pending_position = 0;
+		}
+
+		pending.insert(pending.end(), src.begin(), src.end());
+	}
+};
+
+/**
+ * The list of all #SharedEncoderStream instances.
+ */
+class SharedEncoderRegistry {
+	Mutex mutex;
+
+	std::list<SharedEncoderStream> streams;
+
+public:
+	~SharedEncoderRegistry() noexcept {
+		assert(streams.empty());
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	Encoder *Open(const std::string &key, PreparedEncoder &prepared,
+		      AudioFormat &audio_format);
+
+	/**
+	 * Move the member to a new stream which it doesn't share
+	 * with anybody (yet).
+	 *
+	 * Throws on error.
+	 */
+	void Diverge(SharedEncoder &member);
+
+	void Remove(SharedEncoder &member) noexcept;
+
+private:
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void Attach(SharedEncoderStream &stream,
+		    SharedEncoder &member) noexcept;
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void Detach(SharedEncoder &member) noexcept;
+};
+
+static SharedEncoderRegistry shared_encoder_registry;
+
+unsigned
+SharedEncoderStream::CountActiveMembers() const noexcept
+{
+	return std::count_if(members.begin(), members.end(),
+			     [](const SharedEncoder *m){ return !m->lost; });
+}
+
+SharedEncoderStream::Entry &
+SharedEncoderStream::Execute(Operation operation,
+			     const void *data, size_t length, const Tag *tag)
+{
+	Entry entry(operation);
+
+	switch (operation) {
+	case Operation::WRITE:
+		encoder->Write(data, length);
+		entry.input.assign((const uint8_t *)data,
+				   (const uint8_t *)data + length);
+		break;
+
+	case Operation::FLUSH:
+		encoder->Flush();
+		break;
+
+	case Operation::PRE_TAG:
+		encoder->PreTag();
+		break;
+
+	case Operation::TAG:
+		/* flush after the tag, so the new stream header
+		   is complete and can be sent to new consumers */
+		encoder->SendTag(*tag);
+		encoder->Flush();
+		entry.tag = std::make_unique<Tag>(*tag);
+		break;
+
+	case Operation::END:
+		encoder->End();
+		ended = true;
+		break;
+	}
+
+	ReadAll(*encoder, entry.output);
+
+	if (operation == Operation::TAG)
+		header = entry.output;
+
+	log.emplace_back(std::move(entry));
+	return log.back();
+}
+
+bool
+SharedEncoderStream::Submit(SharedEncoder &member, Operation operation,
+			    const void *data, size_t length, const Tag *tag)
+{
+	assert(!member.lost);
+
+	while (member.position < GetEnd()) {
+		const Entry &entry = log[member.position - begin];
+
+		if (entry.Matches(operation, data, length, tag)) {
+			member.Append(entry.output);
+			++member.position;
+			Prune();
+			return true;
+		}
+
+		if (entry.operation == Operation::FLUSH) {
+			/* somebody else has flushed the encoder; this
+			   just makes the following output available
+			   earlier */
+			member.Append(entry.output);
+			++member.position;
+			continue;
+		}
+
+		/* a flush is not necessary if others are ahead;
+		   their output is already there */
+		return operation == Operation::FLUSH;
+	}
+
+	if (operation == Operation::END && CountActiveMembers() > 1)
+		/* others are still using this encoder; this member
+		   just stops receiving data */
+		return true;
+
+	member.Append(Execute(operation, data, length, tag).output);
+	++member.position;
+	Prune();
+	return true;
+}
+
+void
+SharedEncoderStream::Prune() noexcept
+{
+	uint_least64_t needed = GetEnd();
+	for (const auto *m : members)
+		if (!m->lost)
+			needed = std::min(needed, m->position);
+
+	while (begin < needed) {
+		log.pop_front();
+		++begin;
+	}
+
+	while (log.size() > MAX_ENTRIES) {
+		for (auto *m : members)
+			if (!m->lost && m->position == begin)
+				m->lost = true;
+
+		log.pop_front();
+		++begin;
+	}
+}
+
+void
+SharedEncoderRegistry::Attach(SharedEncoderStream &stream,
+			      SharedEncoder &member) noexcept
+{
+	const std::lock_guard<Mutex> protect(stream.mutex);
+
+	member.stream = &stream;
+	member.position = stream.GetEnd();
+	member.lost = false;
+	member.Append(stream.header);
+	stream.members.push_back(&member);
+}
+
+void
+SharedEncoderRegistry::Detach(SharedEncoder &member) noexcept
+{
+	auto &stream = *member.stream;
+	member.stream = nullptr;
+
+	bool empty;
+
+	{
+		const std::lock_guard<Mutex> protect(stream.mutex);
+		auto &members = stream.members;
+		members.erase(std::find(members.begin(), members.end(),
+					&member));
+		empty = members.empty();
+	}
+
+	if (empty)
+		streams.remove_if([&stream](const SharedEncoderStream &s){
+				return &s == &stream;
+			});
+}
+
+Encoder *
+SharedEncoderRegistry::Open(const std::string &key,
+			    PreparedEncoder &prepared,
+			    AudioFormat &audio_format)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = std::find_if(streams.begin(), streams.end(),
+			      [&](SharedEncoderStream &s){
+				      const std::lock_guard<Mutex> lock(s.mutex);
+				      return s.key == key &&
+					      s.in_audio_format == audio_format &&
+					      !s.ended &&
+					      s.CountActiveMembers() > 0;
+			      });
+
+	SharedEncoderStream &stream = i != streams.end()
+		? *i
+		: streams.emplace_back(key, prepared, audio_format);
+
+	audio_format = stream.out_audio_format;
+
+	auto *member = new SharedEncoder(prepared,
+					 stream.encoder->ImplementsTag());
+	Attach(stream, *member);
+	return member;
+}
+
+void
+SharedEncoderRegistry::Diverge(SharedEncoder &member)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	const auto &old_stream = *member.stream;
+
+	/* create the new stream first; if that fails, the member
+	   remains in the old one */
+	auto &stream = streams.emplace_back(old_stream.key, member.prepared,
+					    old_stream.in_audio_format);
+
+	Detach(member);
+	Attach(stream, member);
+}
+
+void
+SharedEncoderRegistry::Remove(SharedEncoder &member) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	Detach(member);
+}
+
+SharedEncoder::~SharedEncoder() noexcept
+{
+	shared_encoder_registry.Remove(*this);
+}
+
+void
+SharedEncoder::Submit(SharedEncoderStream::Operation operation,
+		      const void *data, size_t length, const Tag *tag)
+{
+	{
+		const std::lock_guard<Mutex> protect(stream->mutex);
+		if (!lost &&
+		    stream->Submit(*this, operation, data, length, tag))
+			return;
+	}
+
+	/* this object has diverged from the others; continue with
+	   an encoder of our own */
+	shared_encoder_registry.Diverge(*this);
+
+	const std::lock_guard<Mutex> protect(stream->mutex);
+	gcc_unused const bool success =
+		stream->Submit(*this, operation, data, length, tag);
+	assert(success);
+}
+
+size_t
+SharedEncoder::Read(void *dest, size_t length) noexcept
+{
+	const size_t remaining = pending.size() - pending_position;
+	if (length > remaining)
+		length = remaining;
+
+	memcpy(dest, pending.data() + pending_position, length);
+	pending_position += length;
+	return length;
+}
+
+class SharedPreparedEncoder final : public PreparedEncoder {
+	const std::string key;
+
+	const std::unique_ptr<PreparedEncoder> encoder;
+
+public:
+	SharedPreparedEncoder(std::string &&_key,
+			      std::unique_ptr<PreparedEncoder> _encoder) noexcept
+		:key(std::move(_key)), encoder(std::move(_encoder)) {}
+
+	/* virtual methods from class PreparedEncoder */
+	Encoder *Open(AudioFormat &audio_format) override {
+		return shared_encoder_registry.Open(key, *encoder,
+						    audio_format);
+	}
+
+	const char *GetMimeType() const noexcept override {
+		return encoder->GetMimeType();
+	}
+};
+
+std::unique_ptr<PreparedEncoder>
+NewSharedEncoder(std::string &&key,
+		 std::unique_ptr<PreparedEncoder> encoder) noexcept
+{
+	return std::make_unique<SharedPreparedEncoder>(std::move(key),
+						       std::move(encoder));
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_ENCODER_HXX
+#define MPD_SHARED_ENCODER_HXX
+
+#include <memory>
+#include <string>
+
+class PreparedEncoder;
+
+/**
+ * Wrap a #PreparedEncoder, so that all wrappers with the same @a key
+ * which are opened with the same #AudioFormat share one #Encoder
+ * instance.  Each operation (PCM data, flushes and tags) is
+ * performed only once, and its output is handed to all consumers
+ * which submit the same operation; this requires that they feed
+ * bit-identical PCM data.  A consumer which diverges gets a private
+ * #Encoder instance (which starts with a new stream header).
+ *
+ * A consumer which is opened while other consumers are already
+ * running joins their stream: it first gets the most recent stream
+ * header (i.e. the output of Open() or of the last SendTag()), and
+ * then everything encoded from this point on.
+ *
+ * @param key identifies the encoder plugin and its settings; two
+ * encoders with the same key must produce the same output
+ */
+std::unique_ptr<PreparedEncoder>
+NewSharedEncoder(std::string &&key,
+		 std::unique_ptr<PreparedEncoder> encoder) noexcept;
+
+#endif
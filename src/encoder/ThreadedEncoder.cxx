@@ -0,0 +1,298 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ThreadedEncoder.hxx"
+#include "EncoderInterface.hxx"
+#include "AudioFormat.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Name.hxx"
+#include "util/HugeAllocator.hxx"
+#include "util/CircularBuffer.hxx"
+
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * The size of the PCM queue between the caller and the encoder
+ * thread.
+ */
+static constexpr size_t THREADED_ENCODER_QUEUE_SIZE = 512 * 1024;
+
+/**
+ * Read everything the #Encoder has produced so far.
+ */
+static void
+ReadAll(Encoder &encoder, std::vector<uint8_t> &dest)
+{
+	while (true) {
+		const size_t old_size = dest.size();
+		dest.resize(old_size + 4096);
+		const size_t nbytes = encoder.Read(dest.data() + old_size, 4096);
+		dest.resize(old_size + nbytes);
+		if (nbytes == 0)
+			break;
+	}
+}
+
+class ThreadedEncoder final : public Encoder {
+	const std::unique_ptr<Encoder> encoder;
+
+	/**
+	 * The size of one PCM frame; the queue is always accessed in
+	 * whole frames.
+	 */
+	const size_t frame_size;
+
+	Thread thread;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when the thread shall be woken up: when PCM data
+	 * has been queued and when it shall quit.
+	 */
+	Cond wake_cond;
+
+	/**
+	 * Signalled by the thread after it has consumed data from
+	 * the queue.
+	 */
+	Cond done_cond;
+
+	std::exception_ptr postponed_exception;
+
+	HugeArray<uint8_t> allocation;
+
+	/**
+	 * PCM data waiting to be encoded.
+	 */
+	CircularBuffer<uint8_t> queue;
+
+	/**
+	 * Encoded data waiting to be returned by Read(), starting at
+	 * #output_position.
+	 */
+	std::vector<uint8_t> output;
+	size_t output_position = 0;
+
+	/**
+	 * Is the thread currently encoding (with the mutex
+	 * unlocked)?
+	 */
+	bool busy = false;
+
+	bool quit = false;
+
+public:
+	ThreadedEncoder(std::unique_ptr<Encoder> _encoder,
+			size_t _frame_size)
+		:Encoder(_encoder->ImplementsTag()),
+		 encoder(std::move(_encoder)),
+		 frame_size(_frame_size),
+		 thread(BIND_THIS_METHOD(Run)),
+		 allocation(THREADED_ENCODER_QUEUE_SIZE),
+		 /* the queue size is a multiple of the frame size,
+		    so its contiguous ranges always contain whole
+		    frames */
+		 queue(&allocation.front(),
+		       allocation.size() - allocation.size() % frame_size)
+	{
+		allocation.ForkCow(false);
+
+		/* the stream header */
+		ReadAll(*encoder, output);
+
+		thread.Start();
+	}
+
+	~ThreadedEncoder() noexcept override {
+		{
+			const std::lock_guard<Mutex> lock(mutex);
+			quit = true;
+			wake_cond.notify_one();
+		}
+
+		thread.Join();
+	}
+
+	/* virtual methods from class Encoder */
+	void End() override {
+		Synchronous([this]{ encoder->End(); });
+	}
+
+	void Flush() override {
+		Synchronous([this]{ encoder->Flush(); });
+	}
+
+	void PreTag() override {
+		Synchronous([this]{ encoder->PreTag(); });
+	}
+
+	void SendTag(const Tag &tag) override {
+		Synchronous([this, &tag]{ encoder->SendTag(tag); });
+	}
+
+	void Write(const void *data, size_t length) override;
+	size_t Read(void *dest, size_t length) override;
+
+private:
+	/**
+	 * Wait until the thread has encoded everything in the queue,
+	 * then invoke the given operation on the #Encoder and collect
+	 * its output.
+	 */
+	template<typename F>
+	void Synchronous(F &&f) {
+		std::unique_lock<Mutex> lock(mutex);
+
+		done_cond.wait(lock, [this]{
+			return (queue.empty() && !busy) || postponed_exception;
+		});
+
+		if (postponed_exception)
+			std::rethrow_exception(postponed_exception);
+
+		/* the thread is idle, and it will not touch the
+		   Encoder until more PCM data is queued */
+		f();
+		ReadAll(*encoder, output);
+	}
+
+	void Run() noexcept;
+};
+
+void
+ThreadedEncoder::Write(const void *_data, size_t length)
+{
+	assert(length % frame_size == 0);
+
+	const auto *data = (const uint8_t *)_data;
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (length > 0) {
+		if (postponed_exception)
+			std::rethrow_exception(postponed_exception);
+
+		auto w = queue.Write();
+		const size_t nbytes = std::min(w.size - w.size % frame_size,
+					       length);
+		if (nbytes == 0) {
+			/* the queue is full: wait for the thread to
+			   catch up */
+			done_cond.wait(lock);
+			continue;
+		}
+
+		memcpy(w.data, data, nbytes);
+		queue.Append(nbytes);
+		wake_cond.notify_one();
+
+		data += nbytes;
+		length -= nbytes;
+	}
+}
+
+size_t
+ThreadedEncoder::Read(void *dest, size_t length)
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	length = std::min(length, output.size() - output_position);
+	memcpy(dest, output.data() + output_position, length);
+	output_position += length;
+
+	if (output_position == output.size()) {
+		output.clear();
+		output_position = 0;
+	}
+
+	return length;
+}
+
+inline void
+ThreadedEncoder::Run() noexcept
+{
+	SetThreadName("encoder");
+
+	std::vector<uint8_t> buffer;
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (!quit) {
+		const auto r = queue.Read();
+		if (r.empty()) {
+			wake_cond.wait(lock);
+			continue;
+		}
+
+		assert(r.size % frame_size == 0);
+
+		busy = true;
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			encoder->Write(r.data, r.size);
+			ReadAll(*encoder, buffer);
+		} catch (...) {
+			postponed_exception = std::current_exception();
+			busy = false;
+			done_cond.notify_all();
+			break;
+		}
+
+		busy = false;
+		queue.Consume(r.size);
+		output.insert(output.end(), buffer.begin(), buffer.end());
+		buffer.clear();
+		done_cond.notify_all();
+	}
+}
+
+class PreparedThreadedEncoder final : public PreparedEncoder {
+	const std::unique_ptr<PreparedEncoder> encoder;
+
+public:
+	explicit PreparedThreadedEncoder(std::unique_ptr<PreparedEncoder> _encoder) noexcept
+		:encoder(std::move(_encoder)) {}
+
+	/* virtual methods from class PreparedEncoder */
+	Encoder *Open(AudioFormat &audio_format) override {
+		std::unique_ptr<Encoder> e(encoder->Open(audio_format));
+		return new ThreadedEncoder(std::move(e),
+					   audio_format.GetFrameSize());
+	}
+
+	const char *GetMimeType() const noexcept override {
+		return encoder->GetMimeType();
+	}
+};
+
+std::unique_ptr<PreparedEncoder>
+NewThreadedEncoder(std::unique_ptr<PreparedEncoder> encoder) noexcept
+{
+	return std::make_unique<PreparedThreadedEncoder>(std::move(encoder));
+}
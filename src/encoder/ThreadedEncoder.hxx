@@ -0,0 +1,40 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREADED_ENCODER_HXX
+#define MPD_THREADED_ENCODER_HXX
+
+#include <memory>
+
+class PreparedEncoder;
+
+/**
+ * Wrap a #PreparedEncoder, so that its #Encoder instances encode PCM
+ * data in a dedicated thread.  Encoder::Write() only copies the data
+ * into a bounded queue (and blocks only if the queue is full), and
+ * Encoder::Read() returns whatever the thread has encoded so far.
+ *
+ * All other operations (flushes and tags) wait until the queue has
+ * been processed, and then call the wrapped #Encoder directly, so
+ * their order relative to the PCM data is preserved.
+ */
+std::unique_ptr<PreparedEncoder>
+NewThreadedEncoder(std::unique_ptr<PreparedEncoder> encoder) noexcept;
+
+#endif
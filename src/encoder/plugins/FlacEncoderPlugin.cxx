@@ -23,13 +23,24 @@
 #include "pcm/Buffer.hxx"
 #include "util/DynamicFifoBuffer.hxx"
 #include "util/RuntimeError.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <FLAC/stream_encoder.h>
 
+#include <algorithm>
+
 #if !defined(FLAC_API_VERSION_CURRENT) || FLAC_API_VERSION_CURRENT <= 7
 #error libFLAC is too old
 #endif
 
+static constexpr Domain flac_encoder_domain("flac_encoder");
+
+/**
+ * The maximum number of samples converted to 32 bit at a time.
+ */
+static constexpr unsigned FLAC_EXPAND_SAMPLES = 8192;
+
 class FlacEncoder final : public Encoder {
 	const AudioFormat audio_format;
 
@@ -66,6 +77,20 @@ public:
 	}
 
 private:
+	/**
+	 * Throws on error.
+	 */
+	void Process(const FLAC__int32 *buffer, unsigned num_frames);
+
+	/**
+	 * Convert 8 or 16 bit samples to 32 bit and pass them to
+	 * Process().
+	 *
+	 * Throws on error.
+	 */
+	template<typename T>
+	void WriteExpanded(const T *src, unsigned num_frames);
+
 	static FLAC__StreamEncoderWriteStatus WriteCallback(const FLAC__StreamEncoder *,
 							    const FLAC__byte data[],
 							    size_t bytes,
@@ -81,6 +106,12 @@ private:
 class PreparedFlacEncoder final : public PreparedEncoder {
 	const unsigned compression;
 
+	/**
+	 * The number of threads libFLAC shall use to encode frames in
+	 * parallel.
+	 */
+	const unsigned threads;
+
 public:
 	PreparedFlacEncoder(const ConfigBlock &block);
 
@@ -93,8 +124,13 @@ public:
 };
 
 PreparedFlacEncoder::PreparedFlacEncoder(const ConfigBlock &block)
-	:compression(block.GetBlockValue("compression", 5u))
+	:compression(block.GetBlockValue("compression", 5u)),
+	 threads(block.GetPositiveValue("threads", 1u))
 {
+#if FLAC_API_VERSION_CURRENT < 14
+	if (threads > 1)
+		throw std::runtime_error("Multi-threaded encoding requires libFLAC 1.5");
+#endif
 }
 
 static PreparedEncoder *
@@ -105,6 +141,7 @@ flac_encoder_init(const ConfigBlock &block)
 
 static void
 flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression,
+		   gcc_unused unsigned threads,
 		   const AudioFormat &audio_format, unsigned bits_per_sample)
 {
 	if (!FLAC__stream_encoder_set_compression_level(fse, compression))
@@ -123,6 +160,26 @@ flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression,
 						  audio_format.sample_rate))
 		throw FormatRuntimeError("error setting flac sample rate to %d",
 					 audio_format.sample_rate);
+
+#if FLAC_API_VERSION_CURRENT >= 14
+	if (threads > 1) {
+		/* libFLAC encodes independent frames on worker
+		   threads and writes them in order */
+		switch (FLAC__stream_encoder_set_num_threads(fse, threads)) {
+		case FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK:
+			break;
+
+		case FLAC__STREAM_ENCODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED:
+			LogWarning(flac_encoder_domain,
+				   "libFLAC was built without multi-threading");
+			break;
+
+		default:
+			throw FormatRuntimeError("error setting flac threads to %u",
+						 threads);
+		}
+	}
+#endif
 }
 
 FlacEncoder::FlacEncoder(AudioFormat _audio_format, FLAC__StreamEncoder *_fse)
@@ -173,7 +230,7 @@ PreparedFlacEncoder::Open(AudioFormat &audio_format)
 		throw std::runtime_error("FLAC__stream_encoder_new() failed");
 
 	try {
-		flac_encoder_setup(fse, compression,
+		flac_encoder_setup(fse, compression, threads,
 				   audio_format, bits_per_sample);
 	} catch (...) {
 		FLAC__stream_encoder_delete(fse);
@@ -183,67 +240,61 @@ PreparedFlacEncoder::Open(AudioFormat &audio_format)
 	return new FlacEncoder(audio_format, fse);
 }
 
-static inline void
-pcm8_to_flac(int32_t *out, const int8_t *in, unsigned num_samples) noexcept
+void
+FlacEncoder::Process(const FLAC__int32 *buffer, unsigned num_frames)
 {
-	while (num_samples > 0) {
-		*out++ = *in++;
-		--num_samples;
-	}
+	if (!FLAC__stream_encoder_process_interleaved(fse, buffer, num_frames))
+		throw std::runtime_error("flac encoder process failed");
 }
 
-static inline void
-pcm16_to_flac(int32_t *out, const int16_t *in, unsigned num_samples) noexcept
+template<typename T>
+inline void
+FlacEncoder::WriteExpanded(const T *src, unsigned num_frames)
 {
-	while (num_samples > 0) {
-		*out++ = *in++;
-		--num_samples;
+	/* convert in small blocks which stay in the CPU cache,
+	   instead of expanding the whole input at once */
+	const unsigned channels = audio_format.channels;
+	const unsigned max_frames = std::max(FLAC_EXPAND_SAMPLES / channels,
+					     1u);
+
+	auto *dest = expand_buffer.GetT<FLAC__int32>(std::min(num_frames,
+							      max_frames) *
+						     channels);
+
+	while (num_frames > 0) {
+		const unsigned n = std::min(num_frames, max_frames);
+		std::copy_n(src, n * channels, dest);
+		Process(dest, n);
+
+		src += n * channels;
+		num_frames -= n;
 	}
 }
 
 void
 FlacEncoder::Write(const void *data, size_t length)
 {
-	void *exbuffer;
-	const void *buffer = nullptr;
-
-	/* format conversion */
-
 	const unsigned num_frames = length / audio_format.GetFrameSize();
-	const unsigned num_samples = num_frames * audio_format.channels;
 
 	switch (audio_format.format) {
 	case SampleFormat::S8:
-		exbuffer = expand_buffer.Get(length * 4);
-		pcm8_to_flac((int32_t *)exbuffer, (const int8_t *)data,
-			     num_samples);
-		buffer = exbuffer;
+		WriteExpanded((const int8_t *)data, num_frames);
 		break;
 
 	case SampleFormat::S16:
-		exbuffer = expand_buffer.Get(length * 2);
-		pcm16_to_flac((int32_t *)exbuffer, (const int16_t *)data,
-			      num_samples);
-		buffer = exbuffer;
+		WriteExpanded((const int16_t *)data, num_frames);
 		break;
 
 	case SampleFormat::S24_P32:
 	case SampleFormat::S32:
 		/* nothing need to be done; format is the same for
 		   both mpd and libFLAC */
-		buffer = data;
+		Process((const FLAC__int32 *)data, num_frames);
 		break;
 
 	default:
 		gcc_unreachable();
 	}
-
-	/* feed samples to encoder */
-
-	if (!FLAC__stream_encoder_process_interleaved(fse,
-						      (const FLAC__int32 *)buffer,
-						      num_frames))
-		throw std::runtime_error("flac encoder process failed");
 }
 
 const EncoderPlugin flac_encoder_plugin = {
@@ -38,6 +38,12 @@ class OpusEncoder final : public OggEncoder {
 
 	const size_t frame_size;
 
+	/**
+	 * Flush an Ogg page after each Opus packet?  This minimizes
+	 * latency at the cost of some container overhead.
+	 */
+	const bool flush_packets;
+
 	const size_t buffer_frames, buffer_size;
 	size_t buffer_position = 0;
 	uint8_t *const buffer;
@@ -53,7 +59,9 @@ class OpusEncoder final : public OggEncoder {
 	ogg_int64_t granulepos = 0;
 
 public:
-	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc, bool _chaining);
+	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+		    size_t _buffer_frames, bool _flush_packets,
+		    bool _chaining);
 	~OpusEncoder() noexcept override;
 
 	/* virtual methods from class Encoder */
@@ -76,6 +84,18 @@ class PreparedOpusEncoder final : public PreparedEncoder {
 	opus_int32 bitrate;
 	int complexity;
 	int signal;
+
+	/**
+	 * Restrict libopus to the low-delay modes, use small frames
+	 * and flush an Ogg page after each packet?
+	 */
+	const bool low_delay;
+
+	/**
+	 * The duration of one Opus frame in microseconds.
+	 */
+	unsigned frame_duration_us;
+
 	const bool chaining;
 
 public:
@@ -89,8 +109,39 @@ public:
 	}
 };
 
+/**
+ * Parse a frame duration in milliseconds.  libopus supports only
+ * 2.5, 5, 10, 20, 40 and 60 ms.
+ *
+ * @return the duration in microseconds, or 0 on error
+ */
+gcc_pure
+static unsigned
+ParseFrameDuration(const char *s) noexcept
+{
+	char *endptr;
+	const double ms = strtod(s, &endptr);
+	if (endptr == s || *endptr != 0 || ms <= 0 || ms > 60)
+		return 0;
+
+	const unsigned us = unsigned(ms * 1000);
+	switch (us) {
+	case 2500:
+	case 5000:
+	case 10000:
+	case 20000:
+	case 40000:
+	case 60000:
+		return us;
+
+	default:
+		return 0;
+	}
+}
+
 PreparedOpusEncoder::PreparedOpusEncoder(const ConfigBlock &block)
-	:chaining(block.GetBlockValue("opustags", false))
+	:low_delay(block.GetBlockValue("low_delay", false)),
+	 chaining(block.GetBlockValue("opustags", false))
 {
 	const char *value = block.GetBlockValue("bitrate", "auto");
 	if (strcmp(value, "auto") == 0)
@@ -118,6 +169,11 @@ PreparedOpusEncoder::PreparedOpusEncoder(const ConfigBlock &block)
 		signal = OPUS_SIGNAL_MUSIC;
 	else
 		throw std::runtime_error("Invalid signal");
+
+	value = block.GetBlockValue("frame_duration", low_delay ? "10" : "20");
+	frame_duration_us = ParseFrameDuration(value);
+	if (frame_duration_us == 0)
+		throw std::runtime_error("Invalid frame duration");
 }
 
 static PreparedEncoder *
@@ -126,11 +182,14 @@ opus_encoder_init(const ConfigBlock &block)
 	return new PreparedOpusEncoder(block);
 }
 
-OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc, bool _chaining)
+OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+			 size_t _buffer_frames, bool _flush_packets,
+			 bool _chaining)
 	:OggEncoder(_chaining),
 	 audio_format(_audio_format),
 	 frame_size(_audio_format.GetFrameSize()),
-	 buffer_frames(_audio_format.sample_rate / 50),
+	 flush_packets(_flush_packets),
+	 buffer_frames(_buffer_frames),
 	 buffer_size(frame_size * buffer_frames),
 	 buffer(new uint8_t[buffer_size]),
 	 enc(_enc)
@@ -165,7 +224,9 @@ PreparedOpusEncoder::Open(AudioFormat &audio_format)
 	int error_code;
 	auto *enc = opus_encoder_create(audio_format.sample_rate,
 					audio_format.channels,
-					OPUS_APPLICATION_AUDIO,
+					low_delay
+					? OPUS_APPLICATION_RESTRICTED_LOWDELAY
+					: OPUS_APPLICATION_AUDIO,
 					&error_code);
 	if (enc == nullptr)
 		throw std::runtime_error(opus_strerror(error_code));
@@ -174,7 +235,11 @@ PreparedOpusEncoder::Open(AudioFormat &audio_format)
 	opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity));
 	opus_encoder_ctl(enc, OPUS_SET_SIGNAL(signal));
 
-	return new OpusEncoder(audio_format, enc, chaining);
+	const size_t buffer_frames = size_t(audio_format.sample_rate)
+		* frame_duration_us / 1000000;
+
+	return new OpusEncoder(audio_format, enc, buffer_frames,
+			       low_delay, chaining);
 }
 
 OpusEncoder::~OpusEncoder() noexcept
@@ -214,6 +279,9 @@ OpusEncoder::DoEncode(bool eos)
 	packet.packetno = packetno++;
 	stream.PacketIn(packet);
 
+	if (flush_packets)
+		Flush();
+
 	buffer_position = 0;
 }
 
@@ -24,6 +24,8 @@
 
 #include <boost/intrusive/list_hook.hpp>
 
+#include <atomic>
+
 class EventLoop;
 
 /**
@@ -37,6 +39,15 @@ class DeferEvent final {
 	typedef boost::intrusive::list_member_hook<> ListHook;
 	ListHook list_hook;
 
+	/**
+	 * A copy of IsPending() which can be read without holding
+	 * the #EventLoop's mutex.  It is only modified while holding
+	 * the mutex, and it is cleared before the callback is
+	 * invoked.  This allows Schedule() to return early without
+	 * locking if the event is already pending.
+	 */
+	std::atomic_bool pending{false};
+
 	EventLoop &loop;
 
 	typedef BoundMethod<void() noexcept> Callback;
@@ -21,9 +21,27 @@
 #include "net/SocketError.hxx"
 #include "util/Compiler.h"
 
+#include <stdexcept>
+
 #include <assert.h>
 #include <string.h>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+void
+FullyBufferedSocket::OnSendError(int code) noexcept
+{
+	IdleMonitor::Cancel();
+	BufferedSocket::Cancel();
+
+	if (IsSocketErrorClosed(code))
+		OnSocketClosed();
+	else
+		OnSocketError(std::make_exception_ptr(MakeSocketError(code, "Failed to send to socket")));
+}
+
 FullyBufferedSocket::ssize_t
 FullyBufferedSocket::DirectWrite(const void *data, size_t length) noexcept
 {
@@ -33,42 +51,100 @@ FullyBufferedSocket::DirectWrite(const void *data, size_t length) noexcept
 		if (IsSocketErrorAgain(code))
 			return 0;
 
+		OnSendError(code);
+	}
+
+	return nbytes;
+}
+
+#ifdef __linux__
+
+FullyBufferedSocket::ssize_t
+FullyBufferedSocket::DirectSendFile(FileSegment &segment) noexcept
+{
+	assert(segment.remaining > 0);
+
+	const auto nbytes = sendfile(GetSocket().Get(), segment.fd.Get(),
+				     &segment.offset, segment.remaining);
+	if (gcc_unlikely(nbytes < 0)) {
+		const auto code = GetSocketError();
+		if (IsSocketErrorAgain(code))
+			return 0;
+
+		OnSendError(code);
+		return -1;
+	}
+
+	if (gcc_unlikely(nbytes == 0)) {
+		/* the file has been truncated; we can't send the
+		   announced number of bytes */
 		IdleMonitor::Cancel();
 		BufferedSocket::Cancel();
-
-		if (IsSocketErrorClosed(code))
-			OnSocketClosed();
-		else
-			OnSocketError(std::make_exception_ptr(MakeSocketError(code, "Failed to send to socket")));
+		OnSocketError(std::make_exception_ptr(std::runtime_error("File was truncated while sending it")));
+		return -1;
 	}
 
+	segment.remaining -= nbytes;
 	return nbytes;
 }
 
+#endif
+
 bool
 FullyBufferedSocket::Flush() noexcept
 {
 	assert(IsDefined());
 
-	const auto data = output.Read();
-	if (data.empty()) {
-		IdleMonitor::Cancel();
-		CancelWrite();
-		return true;
+	while (true) {
+		const auto data = output.Read();
+		if (!data.empty()) {
+			auto nbytes = DirectWrite(data.data, data.size);
+			if (gcc_unlikely(nbytes <= 0))
+				return nbytes == 0;
+
+			output.Consume(nbytes);
+
+			if (!output.empty())
+				/* the socket is full; try again later */
+				return true;
+		}
+
+#ifdef __linux__
+		if (file_segments.empty())
+			break;
+
+		auto &segment = file_segments.front();
+		if (segment.remaining > 0) {
+			auto nbytes = DirectSendFile(segment);
+			if (gcc_unlikely(nbytes <= 0))
+				return nbytes == 0;
+
+			if (segment.remaining > 0)
+				/* the socket is full; try again later */
+				return true;
+		}
+
+		/* the file has been sent completely; continue with
+		   the data which was written after it */
+		trailer_size -= segment.trailer.size();
+		if (!output.Append(segment.trailer.data(),
+				   segment.trailer.size()))
+			/* can't happen: the output buffer is empty,
+			   and the trailer is not larger than its
+			   capacity */
+			gcc_unreachable();
+
+		file_segments.pop_front();
+#else
+		break;
+#endif
 	}
 
-	auto nbytes = DirectWrite(data.data, data.size);
-	if (gcc_unlikely(nbytes <= 0))
-		return nbytes == 0;
+	IdleMonitor::Cancel();
+	CancelWrite();
 
-	output.Consume(nbytes);
-
-	if (output.empty()) {
-		IdleMonitor::Cancel();
-		CancelWrite();
-	}
-
-	return true;
+	OnSocketOutputDrained();
+	return IsDefined();
 }
 
 bool
@@ -79,6 +155,22 @@ FullyBufferedSocket::Write(const void *data, size_t length) noexcept
 	if (length == 0)
 		return true;
 
+#ifdef __linux__
+	if (!file_segments.empty()) {
+		/* a file is being sent; this data must wait until it
+		   is complete */
+		if (trailer_size + length > max_trailer_size) {
+			OnSocketError(std::make_exception_ptr(std::runtime_error("Output buffer is full")));
+			return false;
+		}
+
+		file_segments.back().trailer.append((const char *)data,
+						    length);
+		trailer_size += length;
+		return true;
+	}
+#endif
+
 	const bool was_empty = output.empty();
 
 	if (!output.Append(data, length)) {
@@ -91,11 +183,34 @@ FullyBufferedSocket::Write(const void *data, size_t length) noexcept
 	return true;
 }
 
+#ifdef __linux__
+
+bool
+FullyBufferedSocket::WriteFile(UniqueFileDescriptor &&file_fd, off_t offset,
+			       size_t length) noexcept
+{
+	assert(IsDefined());
+	assert(file_fd.IsDefined());
+
+	if (length == 0)
+		return true;
+
+	const bool was_empty = IsOutputEmpty();
+
+	file_segments.emplace_back(std::move(file_fd), offset, length);
+
+	if (was_empty)
+		IdleMonitor::Schedule();
+	return true;
+}
+
+#endif
+
 bool
 FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 {
 	if (flags & WRITE) {
-		assert(!output.empty());
+		assert(!IsOutputEmpty());
 		assert(!IdleMonitor::IsActive());
 
 		if (!Flush())
@@ -111,6 +226,6 @@ FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 void
 FullyBufferedSocket::OnIdle() noexcept
 {
-	if (Flush() && !output.empty())
+	if (Flush() && !IsOutputEmpty())
 		ScheduleWrite();
 }
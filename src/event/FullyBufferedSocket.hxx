@@ -24,17 +24,67 @@
 #include "IdleMonitor.hxx"
 #include "util/PeakBuffer.hxx"
 
+#ifdef __linux__
+#include "system/UniqueFileDescriptor.hxx"
+
+#include <list>
+#include <string>
+
+#include <sys/types.h>
+#endif
+
 /**
  * A #BufferedSocket specialization that adds an output buffer.
  */
 class FullyBufferedSocket : protected BufferedSocket, private IdleMonitor {
 	PeakBuffer output;
 
+#ifdef __linux__
+	/**
+	 * A portion of a file which will be sent with sendfile()
+	 * after everything before it has been sent.
+	 */
+	struct FileSegment {
+		UniqueFileDescriptor fd;
+
+		off_t offset;
+
+		size_t remaining;
+
+		/**
+		 * Data written after this segment was queued; it
+		 * will be moved to the #output buffer after the file
+		 * has been sent.
+		 */
+		std::string trailer;
+
+		FileSegment(UniqueFileDescriptor &&_fd, off_t _offset,
+			    size_t _length) noexcept
+			:fd(std::move(_fd)), offset(_offset),
+			 remaining(_length) {}
+	};
+
+	std::list<FileSegment> file_segments;
+
+	/**
+	 * The total size of all FileSegment::trailer strings.  It is
+	 * limited by #max_trailer_size, just like the #output
+	 * buffer.
+	 */
+	size_t trailer_size = 0;
+
+	const size_t max_trailer_size;
+#endif
+
 public:
 	FullyBufferedSocket(SocketDescriptor _fd, EventLoop &_loop,
 			    size_t normal_size, size_t peak_size=0) noexcept
 		:BufferedSocket(_fd, _loop), IdleMonitor(_loop),
-		 output(normal_size, peak_size) {
+		 output(normal_size, peak_size)
+#ifdef __linux__
+		, max_trailer_size(normal_size + peak_size)
+#endif
+	{
 	}
 
 	using BufferedSocket::GetEventLoop;
@@ -43,6 +93,29 @@ public:
 	void Close() noexcept {
 		IdleMonitor::Cancel();
 		BufferedSocket::Close();
+#ifdef __linux__
+		file_segments.clear();
+		trailer_size = 0;
+#endif
+	}
+
+protected:
+	gcc_pure
+	bool IsOutputEmpty() const noexcept {
+		return output.empty()
+#ifdef __linux__
+			&& file_segments.empty()
+#endif
+			;
+	}
+
+	/**
+	 * Returns the number of bytes allocated by the output
+	 * buffer.
+	 */
+	gcc_pure
+	size_t GetOutputBufferSize() const noexcept {
+		return output.GetAllocatedSize();
 	}
 
 private:
@@ -53,6 +126,23 @@ private:
 	 */
 	ssize_t DirectWrite(const void *data, size_t length) noexcept;
 
+	/**
+	 * Handle a send error.  This may close (and destruct) the
+	 * socket.
+	 */
+	void OnSendError(int code) noexcept;
+
+#ifdef __linux__
+	/**
+	 * Send (a part of) the given file segment with sendfile().
+	 *
+	 * @return the number of bytes written to the socket, 0 if the
+	 * socket isn't ready for writing, -1 on error (the socket has
+	 * been closed and probably destructed)
+	 */
+	ssize_t DirectSendFile(FileSegment &segment) noexcept;
+#endif
+
 protected:
 	/**
 	 * Send data from the output buffer to the socket.
@@ -66,6 +156,28 @@ protected:
 	 */
 	bool Write(const void *data, size_t length) noexcept;
 
+#ifdef __linux__
+	/**
+	 * Send a portion of a file after all data which has been
+	 * written so far.  The file is copied to the socket by the
+	 * kernel (sendfile()), without passing through the output
+	 * buffer.
+	 *
+	 * @param file_fd a regular file; it is closed after it has been
+	 * sent
+	 * @return false if the socket has been closed
+	 */
+	bool WriteFile(UniqueFileDescriptor &&file_fd, off_t offset,
+		       size_t length) noexcept;
+#endif
+
+	/**
+	 * Called by Flush() after the output buffer has been sent
+	 * completely.  The method may write more data, and it may
+	 * close the socket.
+	 */
+	virtual void OnSocketOutputDrained() noexcept {}
+
 	/* virtual methods from class SocketMonitor */
 	bool OnSocketReady(unsigned flags) noexcept override;
 
@@ -41,6 +41,7 @@ EventLoop::~EventLoop() noexcept
 {
 	assert(idle.empty());
 	assert(timers.empty());
+	assert(coarse_timers.IsEmpty());
 }
 
 void
@@ -105,9 +106,22 @@ EventLoop::CancelTimer(TimerEvent &t) noexcept
 	timers.erase(timers.iterator_to(t));
 }
 
+void
+EventLoop::AddCoarseTimer(CoarseTimerEvent &t,
+			  std::chrono::steady_clock::duration d) noexcept
+{
+	assert(IsInside());
+
+	t.due = now + d;
+	coarse_timers.Insert(t, now);
+	again = true;
+}
+
 inline std::chrono::steady_clock::duration
 EventLoop::HandleTimers() noexcept
 {
+	const auto coarse_timeout = coarse_timers.Run(now);
+
 	std::chrono::steady_clock::duration timeout;
 
 	while (!quit) {
@@ -118,14 +132,17 @@ EventLoop::HandleTimers() noexcept
 		TimerEvent &t = *i;
 		timeout = t.due - now;
 		if (timeout > timeout.zero())
-			return timeout;
+			return coarse_timeout >= coarse_timeout.zero() &&
+				coarse_timeout < timeout
+				? coarse_timeout
+				: timeout;
 
 		timers.erase(i);
 
 		t.Run();
 	}
 
-	return std::chrono::steady_clock::duration(-1);
+	return coarse_timeout;
 }
 
 /**
@@ -228,6 +245,14 @@ EventLoop::Run() noexcept
 void
 EventLoop::AddDeferred(DeferEvent &d) noexcept
 {
+	if (d.pending.load()) {
+		/* fast path without locking: the event is already
+		   queued, and its callback has not been invoked
+		   yet */
+		n_coalesced.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
 	bool must_wake;
 
 	{
@@ -240,7 +265,12 @@ EventLoop::AddDeferred(DeferEvent &d) noexcept
 		must_wake = !busy && deferred.empty();
 
 		deferred.push_back(d);
+		d.pending = true;
 		again = true;
+
+		++n_deferred;
+		if (must_wake)
+			++n_wakeups;
 	}
 
 	if (must_wake)
@@ -250,10 +280,17 @@ EventLoop::AddDeferred(DeferEvent &d) noexcept
 void
 EventLoop::RemoveDeferred(DeferEvent &d) noexcept
 {
+	if (!d.pending.load())
+		/* not queued (or already running): nothing to do, and
+		   no need to lock */
+		return;
+
 	const std::lock_guard<Mutex> protect(mutex);
 
-	if (d.IsPending())
+	if (d.IsPending()) {
 		deferred.erase(deferred.iterator_to(d));
+		d.pending = false;
+	}
 }
 
 void
@@ -264,12 +301,24 @@ EventLoop::HandleDeferred() noexcept
 		assert(m.IsPending());
 
 		deferred.pop_front();
+		m.pending = false;
 
 		const ScopeUnlock unlock(mutex);
 		m.RunDeferred();
 	}
 }
 
+EventLoop::DeferStats
+EventLoop::GetDeferStats() const noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	return {
+		n_deferred,
+		n_wakeups,
+		n_coalesced.load(std::memory_order_relaxed),
+	};
+}
+
 bool
 EventLoop::OnSocketReady(gcc_unused unsigned flags) noexcept
 {
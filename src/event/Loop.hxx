@@ -28,6 +28,7 @@
 #include "WakeFD.hxx"
 #include "SocketMonitor.hxx"
 #include "TimerEvent.hxx"
+#include "TimerWheel.hxx"
 #include "IdleMonitor.hxx"
 #include "DeferEvent.hxx"
 
@@ -38,6 +39,7 @@
 #include <atomic>
 
 #include <assert.h>
+#include <stdint.h>
 
 /**
  * An event loop that polls for events on file/socket descriptors.
@@ -46,7 +48,8 @@
  * thread that runs it, except where explicitly documented as
  * thread-safe.
  *
- * @see SocketMonitor, MultiSocketMonitor, TimerEvent, IdleMonitor
+ * @see SocketMonitor, MultiSocketMonitor, TimerEvent,
+ * CoarseTimerEvent, IdleMonitor
  */
 class EventLoop final : SocketMonitor
 {
@@ -67,6 +70,11 @@ class EventLoop final : SocketMonitor
 					   boost::intrusive::constant_time_size<false>> TimerSet;
 	TimerSet timers;
 
+	/**
+	 * The #CoarseTimerEvent instances.
+	 */
+	TimerWheel coarse_timers{std::chrono::steady_clock::now()};
+
 	typedef boost::intrusive::list<IdleMonitor,
 				       boost::intrusive::member_hook<IdleMonitor,
 								     IdleMonitor::ListHook,
@@ -74,7 +82,7 @@ class EventLoop final : SocketMonitor
 				       boost::intrusive::constant_time_size<false>> IdleList;
 	IdleList idle;
 
-	Mutex mutex;
+	mutable Mutex mutex;
 
 	typedef boost::intrusive::list<DeferEvent,
 				       boost::intrusive::member_hook<DeferEvent,
@@ -83,6 +91,25 @@ class EventLoop final : SocketMonitor
 				       boost::intrusive::constant_time_size<false>> DeferredList;
 	DeferredList deferred;
 
+	/**
+	 * The number of DeferEvents added to #deferred.  Protected
+	 * with #mutex.
+	 */
+	uint64_t n_deferred = 0;
+
+	/**
+	 * The number of times #wake_fd was written.  Protected with
+	 * #mutex.
+	 */
+	uint64_t n_wakeups = 0;
+
+	/**
+	 * The number of AddDeferred() calls which returned early
+	 * without locking because the #DeferEvent was already
+	 * pending.
+	 */
+	std::atomic<uint64_t> n_coalesced{0};
+
 	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 
 	/**
@@ -171,6 +198,9 @@ public:
 		      std::chrono::steady_clock::duration d) noexcept;
 	void CancelTimer(TimerEvent &t) noexcept;
 
+	void AddCoarseTimer(CoarseTimerEvent &t,
+			    std::chrono::steady_clock::duration d) noexcept;
+
 	/**
 	 * Schedule a call to DeferEvent::RunDeferred().
 	 *
@@ -186,6 +216,18 @@ public:
 	 */
 	void RemoveDeferred(DeferEvent &d) noexcept;
 
+	struct DeferStats {
+		uint64_t deferred, wakeups, coalesced;
+	};
+
+	/**
+	 * Obtain statistics about AddDeferred() calls.
+	 *
+	 * This method is thread-safe.
+	 */
+	gcc_pure
+	DeferStats GetDeferStats() const noexcept;
+
 	/**
 	 * The main function of this class.  It will loop until
 	 * Break() gets called.  Can be called only once.
@@ -201,7 +243,8 @@ private:
 	void HandleDeferred() noexcept;
 
 	/**
-	 * Invoke all expired #TimerEvent instances and return the
+	 * Invoke all expired #TimerEvent and #CoarseTimerEvent
+	 * instances and return the
 	 * duration until the next timer expires.  Returns a negative
 	 * duration if there is no timeout.
 	 */
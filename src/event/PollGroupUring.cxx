@@ -0,0 +1,206 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+
+#ifdef USE_IO_URING
+
+#include "PollGroupUring.hxx"
+#include "system/IoUring.hxx"
+#include "Log.hxx"
+#include <assert.h>
+#include <errno.h>
+
+/**
+ * The number of submission queue entries.  The completion queue has
+ * twice as many, and the kernel buffers overflowing completions.
+ */
+static constexpr unsigned URING_ENTRIES = 256;
+
+/**
+ * The "user_data" value of requests whose completion is ignored
+ * (timeouts and cancellations).
+ */
+static constexpr uint64_t IGNORED_USER_DATA = 0;
+
+static constexpr uint64_t
+MakeUserData(int fd, uint32_t generation) noexcept
+{
+	return (uint64_t(uint32_t(fd)) << 32) | generation;
+}
+
+PollGroupUring::PollGroupUring()
+{
+	try {
+		ring = std::make_unique<IoUring>(URING_ENTRIES);
+	} catch (...) {
+		Log(LogLevel::DEBUG, std::current_exception(),
+		    "Falling back to epoll");
+		epoll = std::make_unique<PollGroupEpoll>();
+	}
+}
+
+PollGroupUring::~PollGroupUring() noexcept = default;
+
+io_uring_sqe &
+PollGroupUring::GetSqe() noexcept
+{
+	assert(ring);
+
+	io_uring_sqe *sqe;
+	while ((sqe = ring->GetSqe()) == nullptr)
+		/* the submission queue is full: flush it */
+		ring->Submit();
+
+	return *sqe;
+}
+
+void
+PollGroupUring::QueuePoll(int fd, const Registration &r) noexcept
+{
+	/* errors and hangups are always reported */
+	auto &sqe = GetSqe();
+	sqe.opcode = IORING_OP_POLL_ADD;
+	sqe.fd = fd;
+	sqe.poll_events = r.events;
+	sqe.user_data = MakeUserData(fd, r.generation);
+}
+
+void
+PollGroupUring::QueueCancel(int fd, const Registration &r) noexcept
+{
+	auto &sqe = GetSqe();
+	sqe.opcode = IORING_OP_POLL_REMOVE;
+	sqe.fd = -1;
+	sqe.addr = MakeUserData(fd, r.generation);
+	sqe.user_data = IGNORED_USER_DATA;
+}
+
+bool
+PollGroupUring::Add(int fd, unsigned events, void *obj) noexcept
+{
+	if (!ring)
+		return epoll->Add(fd, events, obj);
+
+	auto i = registrations.emplace(fd, Registration{events, obj, 1});
+	if (!i.second)
+		return false;
+
+	QueuePoll(fd, i.first->second);
+	return true;
+}
+
+bool
+PollGroupUring::Modify(int fd, unsigned events, void *obj) noexcept
+{
+	if (!ring)
+		return epoll->Modify(fd, events, obj);
+
+	auto i = registrations.find(fd);
+	if (i == registrations.end())
+		return false;
+
+	auto &r = i->second;
+	QueueCancel(fd, r);
+
+	r.events = events;
+	r.obj = obj;
+	if (++r.generation == 0)
+		r.generation = 1;
+
+	QueuePoll(fd, r);
+	return true;
+}
+
+bool
+PollGroupUring::Remove(int fd) noexcept
+{
+	if (!ring)
+		return epoll->Remove(fd);
+
+	auto i = registrations.find(fd);
+	if (i == registrations.end())
+		return false;
+
+	QueueCancel(fd, i->second);
+	registrations.erase(i);
+	return true;
+}
+
+void
+PollGroupUring::ReadEvents(PollResultGeneric &result, int timeout_ms) noexcept
+{
+	if (!ring) {
+		PollResultEpoll r;
+		epoll->ReadEvents(r, timeout_ms);
+		for (size_t i = 0; i < r.GetSize(); ++i)
+			result.Add(r.GetEvents(i), r.GetObject(i));
+		return;
+	}
+
+	if (timeout_ms > 0) {
+		/* this completes after the first other completion
+		   or after the timeout, whatever comes first */
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+		auto &sqe = GetSqe();
+		sqe.opcode = IORING_OP_TIMEOUT;
+		sqe.fd = -1;
+		sqe.addr = (uint64_t)&timeout;
+		sqe.len = 1;
+		sqe.off = 1;
+		sqe.user_data = IGNORED_USER_DATA;
+	}
+
+	ring->Submit(timeout_ms != 0 ? 1 : 0);
+
+	ring->ForEachCompletion([this, &result](const io_uring_cqe &cqe){
+			if (cqe.user_data == IGNORED_USER_DATA)
+				return;
+
+			const int fd = int(cqe.user_data >> 32);
+			const uint32_t generation = uint32_t(cqe.user_data);
+
+			auto i = registrations.find(fd);
+			if (i == registrations.end() ||
+			    i->second.generation != generation)
+				/* stale completion after Modify() or
+				   Remove() */
+				return;
+
+			auto &r = i->second;
+
+			if (cqe.res < 0) {
+				if (cqe.res != -ECANCELED)
+					result.Add(ERROR, r.obj);
+				return;
+			}
+
+			result.Add(cqe.res, r.obj);
+
+			/* poll requests are "oneshot": re-arm it to
+			   emulate level-triggered epoll; it will be
+			   submitted with the next ReadEvents() call */
+			QueuePoll(fd, r);
+		});
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_EVENT_POLLGROUP_URING_HXX
+#define MPD_EVENT_POLLGROUP_URING_HXX
+
+#include "PollResultGeneric.hxx"
+#include "PollGroupEpoll.hxx"
+
+#include <linux/time_types.h>
+
+#include <memory>
+#include <unordered_map>
+
+#include <poll.h>
+#include <stdint.h>
+
+class IoUring;
+struct io_uring_sqe;
+
+/**
+ * A #PollGroup implementation based on io_uring "poll" operations.
+ * Registering, modifying and removing file descriptors does not
+ * cost a system call; all changes are submitted together with the
+ * wait for new events, i.e. one io_uring_enter() call per
+ * #EventLoop iteration.
+ *
+ * If the kernel does not support io_uring, this falls back to
+ * #PollGroupEpoll.
+ */
+class PollGroupUring
+{
+	std::unique_ptr<IoUring> ring;
+
+	/**
+	 * Used if io_uring is not available.
+	 */
+	std::unique_ptr<PollGroupEpoll> epoll;
+
+	struct Registration {
+		unsigned events;
+		void *obj;
+
+		/**
+		 * Incremented each time the poll request is replaced
+		 * or canceled; part of the "user_data" value to
+		 * identify stale completions.
+		 */
+		uint32_t generation;
+	};
+
+	std::unordered_map<int, Registration> registrations;
+
+	/**
+	 * The timeout passed to IORING_OP_TIMEOUT.  It must be
+	 * valid until the entry has been submitted.
+	 */
+	__kernel_timespec timeout;
+
+	PollGroupUring(PollGroupUring &) = delete;
+	PollGroupUring &operator=(PollGroupUring &) = delete;
+
+public:
+	static constexpr unsigned READ = POLLIN;
+	static constexpr unsigned WRITE = POLLOUT;
+	static constexpr unsigned ERROR = POLLERR;
+	static constexpr unsigned HANGUP = POLLHUP;
+
+	static_assert(READ == PollGroupEpoll::READ);
+	static_assert(WRITE == PollGroupEpoll::WRITE);
+	static_assert(ERROR == PollGroupEpoll::ERROR);
+	static_assert(HANGUP == PollGroupEpoll::HANGUP);
+
+	PollGroupUring();
+	~PollGroupUring() noexcept;
+
+	void ReadEvents(PollResultGeneric &result, int timeout_ms) noexcept;
+
+	bool Add(int fd, unsigned events, void *obj) noexcept;
+	bool Modify(int fd, unsigned events, void *obj) noexcept;
+	bool Remove(int fd) noexcept;
+
+	bool Abandon(int fd) noexcept {
+		/* the pending poll request holds a reference on the
+		   file, so it must be canceled explicitly */
+		return Remove(fd);
+	}
+
+private:
+	io_uring_sqe &GetSqe() noexcept;
+
+	void QueuePoll(int fd, const Registration &r) noexcept;
+	void QueueCancel(int fd, const Registration &r) noexcept;
+};
+
+#endif
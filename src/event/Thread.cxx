@@ -21,6 +21,7 @@
 #include "thread/Name.hxx"
 #include "thread/Slack.hxx"
 #include "thread/Util.hxx"
+#include "thread/Scheduling.hxx"
 #include "Log.hxx"
 
 void
@@ -49,7 +50,8 @@ EventThread::Stop() noexcept
 void
 EventThread::Run() noexcept
 {
-	SetThreadName(realtime ? "rtio" : "io");
+	const char *const name = realtime ? "rtio" : "io";
+	SetThreadName(name);
 
 	if (realtime) {
 		SetThreadTimerSlack(std::chrono::microseconds(10));
@@ -62,5 +64,12 @@ EventThread::Run() noexcept
 		}
 	}
 
+	try {
+		ApplyThreadScheduling(name);
+	} catch (...) {
+		Log(LogLevel::WARNING, std::current_exception(),
+		    "Failed to apply \"thread\" settings");
+	}
+
 	event_loop.Run();
 }
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "TimerWheel.hxx"
+
+bool
+TimerWheel::IsEmpty() const noexcept
+{
+	if (!ready.empty())
+		return false;
+
+	for (const auto &bucket : buckets)
+		if (!bucket.empty())
+			return false;
+
+	return true;
+}
+
+void
+TimerWheel::Insert(CoarseTimerEvent &t, TimePoint now) noexcept
+{
+	if (t.due <= now)
+		ready.push_back(t);
+	else
+		buckets[GetBucketIndex(t.due)].push_back(t);
+}
+
+void
+TimerWheel::Run(List &list, TimePoint now) noexcept
+{
+	/* move all timers to a temporary list first, because the
+	   callbacks may schedule new timers */
+	List tmp;
+	tmp.splice(tmp.end(), list);
+
+	while (!tmp.empty()) {
+		auto &t = tmp.front();
+		tmp.pop_front();
+
+		if (t.due <= now)
+			t.Run();
+		else
+			/* due in a later revolution */
+			list.push_back(t);
+	}
+}
+
+TimerWheel::Duration
+TimerWheel::GetSleep(TimePoint now) const noexcept
+{
+	if (!ready.empty())
+		return Duration::zero();
+
+	for (std::size_t i = 0; i < N_BUCKETS; ++i) {
+		const TimePoint t = last_time + i * RESOLUTION;
+		if (!buckets[GetBucketIndex(t)].empty()) {
+			const TimePoint end = t + RESOLUTION;
+			return end > now ? end - now : Duration::zero();
+		}
+	}
+
+	return Duration(-1);
+}
+
+TimerWheel::Duration
+TimerWheel::Run(TimePoint now) noexcept
+{
+	Run(ready, now);
+
+	if (now - last_time >= SPAN) {
+		/* more than one revolution has passed since the last
+		   call: check all buckets */
+		for (auto &bucket : buckets)
+			Run(bucket, now);
+
+		last_time = GetBucketStartTime(now);
+	} else {
+		/* check all buckets whose time slot has passed */
+		while (last_time + RESOLUTION <= now) {
+			Run(buckets[GetBucketIndex(last_time)], now);
+			last_time += RESOLUTION;
+		}
+	}
+
+	return GetSleep(now);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TIMER_WHEEL_HXX
+#define MPD_TIMER_WHEEL_HXX
+
+#include "CoarseTimerEvent.hxx"
+#include "util/Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+
+#include <array>
+#include <chrono>
+
+/**
+ * A hashed timer wheel for #CoarseTimerEvent instances.  Each
+ * bucket covers #RESOLUTION; timers are inserted into the bucket of
+ * their due time and are checked only after the bucket's time slot
+ * has passed.  Timers which are due more than one revolution in the
+ * future stay in their bucket until a later revolution.
+ */
+class TimerWheel final {
+public:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+	typedef std::chrono::steady_clock::duration Duration;
+
+	static constexpr Duration RESOLUTION = std::chrono::seconds(1);
+	static constexpr std::size_t N_BUCKETS = 64;
+
+private:
+	static constexpr Duration SPAN = RESOLUTION * N_BUCKETS;
+
+	typedef boost::intrusive::list<CoarseTimerEvent,
+				       boost::intrusive::member_hook<CoarseTimerEvent,
+								     CoarseTimerEvent::ListHook,
+								     &CoarseTimerEvent::list_hook>,
+				       boost::intrusive::constant_time_size<false>> List;
+
+	std::array<List, N_BUCKETS> buckets;
+
+	/**
+	 * Timers which were already due when they were scheduled.
+	 */
+	List ready;
+
+	/**
+	 * The start time of the first bucket which has not yet been
+	 * checked.
+	 */
+	TimePoint last_time;
+
+public:
+	explicit TimerWheel(TimePoint now) noexcept
+		:last_time(GetBucketStartTime(now)) {}
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	gcc_pure
+	bool IsEmpty() const noexcept;
+
+	void Insert(CoarseTimerEvent &t, TimePoint now) noexcept;
+
+	/**
+	 * Invoke all expired #CoarseTimerEvent instances and return
+	 * the duration until the next bucket needs to be checked.
+	 * Returns a negative duration if there are no timers.
+	 */
+	Duration Run(TimePoint now) noexcept;
+
+private:
+	static constexpr std::size_t GetBucketIndex(TimePoint t) noexcept {
+		return std::size_t(t.time_since_epoch() / RESOLUTION) % N_BUCKETS;
+	}
+
+	static TimePoint GetBucketStartTime(TimePoint t) noexcept {
+		return TimePoint(t.time_since_epoch() / RESOLUTION * RESOLUTION);
+	}
+
+	/**
+	 * Invoke all timers in the given list which are due and move
+	 * the others back.
+	 */
+	static void Run(List &list, TimePoint now) noexcept;
+
+	gcc_pure
+	Duration GetSleep(TimePoint now) const noexcept;
+};
+
+#endif
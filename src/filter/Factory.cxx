@@ -19,10 +19,13 @@
 
 #include "Factory.hxx"
 #include "LoadOne.hxx"
+#include "LoadChain.hxx"
+#include "SharedFilter.hxx"
 #include "Prepared.hxx"
 #include "config/Data.hxx"
 #include "config/Block.hxx"
 #include "util/RuntimeError.hxx"
+#include "plugins/ChainFilterPlugin.hxx"
 
 std::unique_ptr<PreparedFilter>
 FilterFactory::MakeFilter(const char *name)
@@ -37,3 +40,15 @@ FilterFactory::MakeFilter(const char *name)
 
 	return filter_configured_new(*cfg);
 }
+
+std::unique_ptr<PreparedFilter>
+FilterFactory::MakeSharedChain(const char *spec)
+{
+	auto chain = filter_chain_new();
+	filter_chain_parse(*chain, *this, spec);
+
+	if (cache == nullptr)
+		return chain;
+
+	return shared_filter_prepare(*cache, spec, std::move(chain));
+}
@@ -24,15 +24,33 @@
 
 struct ConfigData;
 class PreparedFilter;
+class FilterCache;
 
 class FilterFactory {
 	const ConfigData &config;
 
+	FilterCache *const cache;
+
 public:
-	explicit FilterFactory(const ConfigData &_config) noexcept
-		:config(_config) {}
+	/**
+	 * @param _cache if not nullptr, then chains created by
+	 * MakeSharedChain() are shared with other consumers of this
+	 * #FilterCache
+	 */
+	explicit FilterFactory(const ConfigData &_config,
+			       FilterCache *_cache=nullptr) noexcept
+		:config(_config), cache(_cache) {}
 
 	std::unique_ptr<PreparedFilter> MakeFilter(const char *name);
+
+	/**
+	 * Create a chain of the given comma-separated list of filter
+	 * templates (see filter_chain_parse()) whose work is shared
+	 * by all consumers using the same specification.
+	 *
+	 * Throws on error.
+	 */
+	std::unique_ptr<PreparedFilter> MakeSharedChain(const char *spec);
 };
 
 #endif
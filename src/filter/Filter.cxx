@@ -20,6 +20,12 @@
 #include "Filter.hxx"
 #include "util/ConstBuffer.hxx"
 
+ConstBuffer<void>
+Filter::FilterPCMTo(ConstBuffer<void>, SampleFormat)
+{
+	return nullptr;
+}
+
 ConstBuffer<void>
 Filter::Flush()
 {
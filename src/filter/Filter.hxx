@@ -63,6 +63,34 @@ public:
 	 */
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src) = 0;
 
+	/**
+	 * Like FilterPCM(), but produce samples in the specified
+	 * #SampleFormat instead of GetOutAudioFormat().format, in
+	 * the same pass.  This allows the #ChainFilter to skip a
+	 * following filter which only converts the sample format
+	 * (see GetFusableFormat()).
+	 *
+	 * Throws on error.
+	 *
+	 * @return the destination buffer or nullptr if this filter
+	 * cannot do that (then the caller falls back to FilterPCM())
+	 */
+	virtual ConstBuffer<void> FilterPCMTo(ConstBuffer<void> src,
+					      SampleFormat format);
+
+	/**
+	 * If this filter does nothing but convert the sample format
+	 * (i.e. the sample rate and the channel count are
+	 * unmodified), return the destination #SampleFormat.  The
+	 * previous filter in a chain may then do the conversion
+	 * instead (see FilterPCMTo()), and this filter is skipped.
+	 * Returns SampleFormat::UNDEFINED if this is not possible.
+	 */
+	gcc_pure
+	virtual SampleFormat GetFusableFormat() const noexcept {
+		return SampleFormat::UNDEFINED;
+	}
+
 	/**
 	 * Flush pending data and return it.  This should be called
 	 * repeatedly until it returns nullptr.
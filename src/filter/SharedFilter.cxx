@@ -0,0 +1,399 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SharedFilter.hxx"
+#include "Filter.hxx"
+#include "Prepared.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+#include <utility>
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * A #Filter which forwards to a #FilterCache::Stream.
+ */
+class SharedFilter final : public Filter {
+	friend class FilterCache;
+
+	FilterCache &cache;
+
+	const std::string &name;
+
+	const AudioFormat src_format;
+
+	PreparedFilter &prepared;
+
+	/**
+	 * The #FilterCache::Stream this object is attached to;
+	 * nullptr if it needs to find one with the next call.
+	 */
+	FilterCache::Stream *stream = nullptr;
+
+	/**
+	 * The absolute index of the next expected entry of #stream.
+	 */
+	uint_least64_t position;
+
+	/**
+	 * The entry whose result was returned by the most recent
+	 * call; this reference keeps it alive even if #stream drops
+	 * it.
+	 */
+	std::shared_ptr<const FilterCache::Entry> current;
+
+public:
+	SharedFilter(FilterCache &_cache, const std::string &_name,
+		     AudioFormat _src_format, PreparedFilter &_prepared,
+		     AudioFormat _out_audio_format) noexcept
+		:Filter(_out_audio_format),
+		 cache(_cache), name(_name), src_format(_src_format),
+		 prepared(_prepared) {}
+
+	~SharedFilter() noexcept override;
+
+	/* virtual methods from class Filter */
+	void Reset() noexcept override;
+	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+	ConstBuffer<void> Flush() override;
+};
+
+class PreparedSharedFilter final : public PreparedFilter {
+	FilterCache &cache;
+
+	const std::string name;
+
+	const std::unique_ptr<PreparedFilter> prepared;
+
+public:
+	PreparedSharedFilter(FilterCache &_cache, const char *_name,
+			     std::unique_ptr<PreparedFilter> _prepared) noexcept
+		:cache(_cache), name(_name), prepared(std::move(_prepared)) {}
+
+	/* virtual methods from class PreparedFilter */
+	std::unique_ptr<Filter> Open(AudioFormat &af) override;
+};
+
+bool
+FilterCache::Entry::Matches(ConstBuffer<void> _src,
+			    bool _flush) const noexcept
+{
+	return flush == _flush && src.size() == _src.size &&
+		(_src.size == 0 || memcmp(src.data(), _src.data, _src.size) == 0);
+}
+
+ConstBuffer<void>
+FilterCache::Entry::GetResult() const noexcept
+{
+	if (dest.empty())
+		/* Flush() returns nullptr at the end */
+		return flush ? nullptr : ConstBuffer<void>(dest.data(), 0);
+
+	return {dest.data(), dest.size()};
+}
+
+FilterCache::Stream::Stream(const std::string &_name,
+			    AudioFormat _src_format,
+			    PreparedFilter &prepared)
+	:name(_name), src_format(_src_format), in_format(_src_format),
+	 filter(prepared.Open(in_format))
+{
+}
+
+FilterCache::Stream::~Stream() noexcept = default;
+
+FilterCache::FilterCache() noexcept = default;
+
+FilterCache::~FilterCache() noexcept
+{
+	assert(std::all_of(streams.begin(), streams.end(),
+			   [](const Stream &stream){
+				   return stream.members.empty();
+			   }));
+}
+
+FilterCache::Stream &
+FilterCache::MakeStream(const std::string &name, AudioFormat src_format,
+			PreparedFilter &prepared)
+{
+	for (auto &stream : streams) {
+		if (stream.members.empty() &&
+		    stream.HasKey(name, src_format)) {
+			/* reuse an idle stream; this is cheaper than
+			   opening the filter chain again */
+			stream.filter->Reset();
+			return stream;
+		}
+	}
+
+	return streams.emplace_back(name, src_format, prepared);
+}
+
+void
+FilterCache::Recycle(std::shared_ptr<Entry> &&entry) noexcept
+{
+	/* entries which are still referenced by a member's
+	   "current" pointer cannot be reused */
+	if (entry.use_count() == 1 && spare.size() < MAX_ENTRIES)
+		spare.emplace_back(std::move(entry));
+	else
+		entry.reset();
+}
+
+void
+FilterCache::Attach(Stream &stream, SharedFilter &member,
+		    uint_least64_t position) noexcept
+{
+	assert(member.stream == nullptr);
+
+	stream.members.push_back(&member);
+	member.stream = &stream;
+	member.position = position;
+}
+
+void
+FilterCache::Detach(SharedFilter &member) noexcept
+{
+	auto *stream = std::exchange(member.stream, nullptr);
+	if (stream == nullptr)
+		return;
+
+	auto &members = stream->members;
+	members.erase(std::find(members.begin(), members.end(), &member));
+
+	if (members.empty()) {
+		/* keep the idle stream for MakeStream(), but drop its
+		   stale entries */
+		while (!stream->log.empty()) {
+			Recycle(std::move(stream->log.front()));
+			stream->log.pop_front();
+			++stream->begin;
+		}
+	} else
+		Prune(*stream);
+}
+
+void
+FilterCache::Prune(Stream &stream) noexcept
+{
+	const uint_least64_t end = stream.GetEnd();
+
+	uint_least64_t needed = end > HISTORY ? end - HISTORY : 0;
+	for (const auto *member : stream.members)
+		needed = std::min(needed, member->position);
+
+	if (end - needed > MAX_ENTRIES) {
+		/* a member lags behind too much; it loses this
+		   stream (its "current" entry stays alive) and will
+		   look for a new one with its next call */
+		needed = end - MAX_ENTRIES;
+
+		for (auto i = stream.members.begin(); i != stream.members.end();) {
+			auto &member = **i;
+			if (member.position < needed) {
+				member.stream = nullptr;
+				i = stream.members.erase(i);
+			} else
+				++i;
+		}
+	}
+
+	while (stream.begin < needed) {
+		Recycle(std::move(stream.log.front()));
+		stream.log.pop_front();
+		++stream.begin;
+	}
+}
+
+void
+FilterCache::RemoveIdleStreams() noexcept
+{
+	streams.remove_if([](const Stream &stream){
+		return stream.members.empty();
+	});
+}
+
+ConstBuffer<void>
+FilterCache::Append(Stream &stream, SharedFilter &member,
+		    ConstBuffer<void> src, bool flush)
+{
+	assert(member.stream == &stream);
+	assert(member.position == stream.GetEnd());
+
+	assert(!stream.busy);
+	stream.busy = true;
+
+	ConstBuffer<void> result;
+
+	try {
+		/* the filter may take a while; don't block the other
+		   streams meanwhile */
+		const ScopeUnlock unlock(mutex);
+
+		result = flush
+			? stream.filter->Flush()
+			: stream.filter->FilterPCM(src);
+	} catch (...) {
+		stream.busy = false;
+		cond.notify_all();
+		throw;
+	}
+
+	stream.busy = false;
+	cond.notify_all();
+
+	std::shared_ptr<Entry> entry;
+	if (spare.empty())
+		entry = std::make_shared<Entry>();
+	else {
+		entry = std::move(spare.back());
+		spare.pop_back();
+	}
+
+	const auto *s = (const uint8_t *)src.data;
+	entry->src.assign(s, s + src.size);
+	const auto *r = (const uint8_t *)result.data;
+	entry->dest.assign(r, r + result.size);
+	entry->flush = flush;
+
+	stream.log.emplace_back(entry);
+	++member.position;
+	member.current = std::move(entry);
+
+	Prune(stream);
+
+	return member.current->GetResult();
+}
+
+ConstBuffer<void>
+FilterCache::Lookup(std::unique_lock<Mutex> &lock,
+		    SharedFilter &member,
+		    ConstBuffer<void> src, bool flush)
+{
+	while (member.stream != nullptr) {
+		auto &stream = *member.stream;
+		if (member.position < stream.GetEnd()) {
+			const auto &entry = stream.log[member.position - stream.begin];
+			if (entry->Matches(src, flush)) {
+				++member.position;
+				member.current = entry;
+				Prune(stream);
+				return member.current->GetResult();
+			}
+
+			/* the input differs from what the other
+			   members have submitted */
+			Detach(member);
+			break;
+		}
+
+		if (!stream.busy)
+			/* this member is the first one to get here */
+			return Append(stream, member, src, flush);
+
+		/* another member is running the filter for the next
+		   entry right now; wait for it (this member may have
+		   been detached meanwhile) */
+		cond.wait(lock);
+	}
+
+	/* find another stream which has processed this input
+	   already; search backwards, because the most recent
+	   entries are the most likely candidates */
+	for (auto &stream : streams) {
+		if (stream.members.empty() ||
+		    !stream.HasKey(member.name, member.src_format))
+			continue;
+
+		for (size_t i = stream.log.size(); i > 0; --i) {
+			const auto &entry = stream.log[i - 1];
+			if (entry->Matches(src, flush)) {
+				Attach(stream, member, stream.begin + i);
+				member.current = entry;
+				Prune(stream);
+				return member.current->GetResult();
+			}
+		}
+	}
+
+	/* nobody has seen this input yet: start a new stream */
+	member.current.reset();
+	auto &stream = MakeStream(member.name, member.src_format,
+				  member.prepared);
+	Attach(stream, member, stream.GetEnd());
+	return Append(stream, member, src, flush);
+}
+
+SharedFilter::~SharedFilter() noexcept
+{
+	const std::lock_guard<Mutex> protect(cache.mutex);
+	cache.Detach(*this);
+	cache.RemoveIdleStreams();
+}
+
+void
+SharedFilter::Reset() noexcept
+{
+	const std::lock_guard<Mutex> protect(cache.mutex);
+
+	/* the next FilterPCM() call will look for a stream which
+	   matches the new input, or start a new one */
+	cache.Detach(*this);
+}
+
+ConstBuffer<void>
+SharedFilter::FilterPCM(ConstBuffer<void> src)
+{
+	std::unique_lock<Mutex> lock(cache.mutex);
+	return cache.Lookup(lock, *this, src, false);
+}
+
+ConstBuffer<void>
+SharedFilter::Flush()
+{
+	std::unique_lock<Mutex> lock(cache.mutex);
+	return cache.Lookup(lock, *this, nullptr, true);
+}
+
+std::unique_ptr<Filter>
+PreparedSharedFilter::Open(AudioFormat &af)
+{
+	const AudioFormat src_format = af;
+
+	const std::lock_guard<Mutex> protect(cache.mutex);
+
+	/* this throws if the filter cannot be opened, and prepares
+	   the stream we're most likely going to use */
+	const auto &stream = cache.MakeStream(name, src_format, *prepared);
+	af = stream.in_format;
+
+	return std::make_unique<SharedFilter>(cache, name, src_format,
+					      *prepared,
+					      stream.filter->GetOutAudioFormat());
+}
+
+std::unique_ptr<PreparedFilter>
+shared_filter_prepare(FilterCache &cache, const char *name,
+		      std::unique_ptr<PreparedFilter> prepared)
+{
+	return std::make_unique<PreparedSharedFilter>(cache, name,
+						      std::move(prepared));
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_FILTER_HXX
+#define MPD_SHARED_FILTER_HXX
+
+#include "AudioFormat.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+template<typename T> struct ConstBuffer;
+class Filter;
+class PreparedFilter;
+class SharedFilter;
+class PreparedSharedFilter;
+
+/**
+ * A set of #Filter instances which are shared by several
+ * #SharedFilter consumers (i.e. audio outputs).  Consumers which
+ * feed the same PCM data into the same named filter chain get the
+ * result of one single invocation.
+ *
+ * This works just like #PcmConvertCache: each #Stream remembers the
+ * input and output of its most recent invocations.  A consumer
+ * which submits the same input as the next entry just gets a
+ * reference to its output; a consumer which diverges moves to
+ * another #Stream or gets a new one (with its own #Filter
+ * instance).
+ *
+ * This object must outlive its consumers.
+ */
+class FilterCache {
+	friend class SharedFilter;
+	friend class PreparedSharedFilter;
+
+public:
+	/**
+	 * How many invocations does a #Stream remember?  Consumers
+	 * which lag behind more than this lose their #Stream.
+	 */
+	static constexpr size_t MAX_ENTRIES = 64;
+
+	/**
+	 * How many entries which have been consumed by all members
+	 * are kept for consumers which join late (e.g. an output
+	 * which has just been enabled)?
+	 */
+	static constexpr size_t HISTORY = 8;
+
+private:
+	struct Entry {
+		std::vector<uint8_t> src, dest;
+
+		bool flush = false;
+
+		bool Matches(ConstBuffer<void> _src,
+			     bool _flush) const noexcept;
+
+		ConstBuffer<void> GetResult() const noexcept;
+	};
+
+	struct Stream {
+		/**
+		 * The name of the filter chain, i.e. the
+		 * "shared_filters" specification.
+		 */
+		const std::string name;
+
+		/**
+		 * The audio format passed to PreparedFilter::Open().
+		 */
+		const AudioFormat src_format;
+
+		/**
+		 * The input audio format enforced by the filter.
+		 */
+		AudioFormat in_format;
+
+		std::unique_ptr<Filter> filter;
+
+		std::deque<std::shared_ptr<Entry>> log;
+
+		/**
+		 * The absolute index of the first #log entry.
+		 */
+		uint_least64_t begin = 0;
+
+		std::vector<SharedFilter *> members;
+
+		/**
+		 * Is a member currently running the filter for the
+		 * next entry (with the mutex unlocked)?
+		 */
+		bool busy = false;
+
+		/**
+		 * Throws on error.
+		 */
+		Stream(const std::string &_name, AudioFormat _src_format,
+		       PreparedFilter &prepared);
+
+		~Stream() noexcept;
+
+		uint_least64_t GetEnd() const noexcept {
+			return begin + log.size();
+		}
+
+		bool HasKey(const std::string &_name,
+			    AudioFormat _src_format) const noexcept {
+			return src_format == _src_format && name == _name;
+		}
+	};
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a #Stream is not #busy anymore.
+	 */
+	Cond cond;
+
+	std::list<Stream> streams;
+
+	/**
+	 * Retired #Entry objects whose allocations may be reused.
+	 */
+	std::vector<std::shared_ptr<Entry>> spare;
+
+public:
+	FilterCache() noexcept;
+	~FilterCache() noexcept;
+
+	FilterCache(const FilterCache &) = delete;
+	FilterCache &operator=(const FilterCache &) = delete;
+
+private:
+	/**
+	 * Find an idle #Stream with the given key or create a new
+	 * one.  Caller must lock the mutex.
+	 *
+	 * Throws on error.
+	 */
+	Stream &MakeStream(const std::string &name, AudioFormat src_format,
+			   PreparedFilter &prepared);
+
+	ConstBuffer<void> Lookup(std::unique_lock<Mutex> &lock,
+				 SharedFilter &member,
+				 ConstBuffer<void> src, bool flush);
+
+	/**
+	 * Run the filter for the next entry of the given #Stream,
+	 * unlocking the mutex meanwhile.
+	 */
+	ConstBuffer<void> Append(Stream &stream, SharedFilter &member,
+				 ConstBuffer<void> src, bool flush);
+
+	void Attach(Stream &stream, SharedFilter &member,
+		    uint_least64_t position) noexcept;
+	void Detach(SharedFilter &member) noexcept;
+
+	/**
+	 * Remove the #Entry objects which are not needed anymore.
+	 */
+	void Prune(Stream &stream) noexcept;
+
+	void Recycle(std::shared_ptr<Entry> &&entry) noexcept;
+
+	/**
+	 * Destroy all streams which have no members.
+	 */
+	void RemoveIdleStreams() noexcept;
+};
+
+/**
+ * Create a #PreparedFilter which shares the given filter chain with
+ * all other consumers of the #FilterCache which use the same name.
+ *
+ * @param name the unique name of the filter chain; consumers with
+ * the same name must pass equivalent #PreparedFilter objects
+ */
+std::unique_ptr<PreparedFilter>
+shared_filter_prepare(FilterCache &cache, const char *name,
+		      std::unique_ptr<PreparedFilter> prepared);
+
+#endif
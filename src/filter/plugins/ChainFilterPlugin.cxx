@@ -141,10 +141,29 @@ template<typename I>
 static ConstBuffer<void>
 ApplyFilterChain(I begin, I end, ConstBuffer<void> src)
 {
-	for (auto i = begin; i != end; ++i)
+	for (auto i = begin; i != end; ++i) {
+		const auto next = std::next(i);
+		if (next != end) {
+			/* if the next filter only converts the
+			   sample format, try to let this one do it
+			   in the same pass, saving one pass over the
+			   data and one intermediate buffer */
+			const auto format = next->filter->GetFusableFormat();
+			if (format != SampleFormat::UNDEFINED) {
+				auto fused = i->filter->FilterPCMTo(src,
+								    format);
+				if (!fused.IsNull()) {
+					src = fused;
+					i = next;
+					continue;
+				}
+			}
+		}
+
 		/* feed the output of the previous filter as input
 		   into the current one */
 		src = i->filter->FilterPCM(src);
+	}
 
 	return src;
 }
@@ -21,6 +21,7 @@
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
 #include "pcm/Convert.hxx"
+#include "pcm/SharedConvert.hxx"
 #include "util/ConstBuffer.hxx"
 #include "AudioFormat.hxx"
 
@@ -35,33 +36,70 @@ class ConvertFilter final : public Filter {
 	 */
 	const AudioFormat in_audio_format;
 
+	/**
+	 * If not nullptr, then resampling is shared with other
+	 * filters (see #shared).
+	 */
+	PcmConvertCache *const cache;
+
+	const PcmResamplerSetup *const resampler;
+
 	/**
 	 * This object is only "open" if #in_audio_format !=
-	 * #out_audio_format.
+	 * #out_audio_format (and #shared is not used).
 	 */
 	std::unique_ptr<PcmConvert> state;
 
+	/**
+	 * Used instead of #state if there is a #cache and the sample
+	 * rate gets converted.
+	 */
+	std::unique_ptr<SharedPcmConvert> shared;
+
 public:
-	ConvertFilter(const AudioFormat &audio_format);
+	ConvertFilter(const AudioFormat &audio_format,
+		      PcmConvertCache *_cache=nullptr,
+		      const PcmResamplerSetup *_resampler=nullptr);
 
 	void Set(const AudioFormat &_out_audio_format);
 
 	void Reset() noexcept override {
 		if (state)
 			state->Reset();
+		else if (shared)
+			shared->Reset();
 	}
 
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
 
+	SampleFormat GetFusableFormat() const noexcept override {
+		return state &&
+			out_audio_format.sample_rate == in_audio_format.sample_rate &&
+			out_audio_format.channels == in_audio_format.channels
+			? out_audio_format.format
+			: SampleFormat::UNDEFINED;
+	}
+
 	ConstBuffer<void> Flush() override {
-		return state
-			? state->Flush()
-			: nullptr;
+		if (state)
+			return state->Flush();
+		else if (shared)
+			return shared->Flush();
+		else
+			return nullptr;
 	}
 };
 
 class PreparedConvertFilter final : public PreparedFilter {
+	PcmConvertCache *const cache;
+
+	const PcmResamplerSetup *const resampler;
+
 public:
+	PreparedConvertFilter(PcmConvertCache *_cache,
+			      const PcmResamplerSetup *_resampler) noexcept
+		:cache(_cache), resampler(_resampler) {}
+
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
 };
 
@@ -74,23 +112,37 @@ ConvertFilter::Set(const AudioFormat &_out_audio_format)
 		/* no change */
 		return;
 
-	if (state) {
+	if (state || shared) {
 		out_audio_format = in_audio_format;
 		state.reset();
+		shared.reset();
 	}
 
 	if (_out_audio_format == in_audio_format)
 		/* optimized special case: no-op */
 		return;
 
-	state = std::make_unique<PcmConvert>(in_audio_format,
-					     _out_audio_format);
+	if (cache != nullptr &&
+	    _out_audio_format.sample_rate != in_audio_format.sample_rate)
+		/* resampling is expensive; let all outputs with the
+		   same format share it */
+		shared = std::make_unique<SharedPcmConvert>(*cache,
+							    in_audio_format,
+							    _out_audio_format,
+							    resampler);
+	else
+		state = std::make_unique<PcmConvert>(in_audio_format,
+						     _out_audio_format,
+						     resampler);
 
 	out_audio_format = _out_audio_format;
 }
 
-ConvertFilter::ConvertFilter(const AudioFormat &audio_format)
-	:Filter(audio_format), in_audio_format(audio_format)
+ConvertFilter::ConvertFilter(const AudioFormat &audio_format,
+			     PcmConvertCache *_cache,
+			     const PcmResamplerSetup *_resampler)
+	:Filter(audio_format), in_audio_format(audio_format),
+	 cache(_cache), resampler(_resampler)
 {
 	assert(in_audio_format.IsValid());
 }
@@ -100,22 +152,27 @@ PreparedConvertFilter::Open(AudioFormat &audio_format)
 {
 	assert(audio_format.IsValid());
 
-	return std::make_unique<ConvertFilter>(audio_format);
+	return std::make_unique<ConvertFilter>(audio_format, cache,
+					       resampler);
 }
 
 ConstBuffer<void>
 ConvertFilter::FilterPCM(ConstBuffer<void> src)
 {
-	return state
-		? state->Convert(src)
+	if (state)
+		return state->Convert(src);
+	else if (shared)
+		return shared->Convert(src);
+	else
 		/* optimized special case: no-op */
-		: src;
+		return src;
 }
 
 std::unique_ptr<PreparedFilter>
-convert_filter_prepare() noexcept
+convert_filter_prepare(PcmConvertCache *cache,
+		       const PcmResamplerSetup *resampler) noexcept
 {
-	return std::make_unique<PreparedConvertFilter>();
+	return std::make_unique<PreparedConvertFilter>(cache, resampler);
 }
 
 Filter *
@@ -24,10 +24,20 @@
 
 class PreparedFilter;
 class Filter;
+class PcmConvertCache;
+struct PcmResamplerSetup;
 struct AudioFormat;
 
+/**
+ * @param cache if not nullptr, then conversions which involve
+ * resampling are shared with all other filters which use the same
+ * #PcmConvertCache
+ * @param resampler the "resampler" block to be used (see
+ * pcm_resampler_find()); nullptr selects the default one
+ */
 std::unique_ptr<PreparedFilter>
-convert_filter_prepare() noexcept;
+convert_filter_prepare(PcmConvertCache *cache=nullptr,
+		       const PcmResamplerSetup *resampler=nullptr) noexcept;
 
 Filter *
 convert_filter_new(AudioFormat in_audio_format,
@@ -48,6 +48,10 @@ FfmpegFilter::FfmpegFilter(const AudioFormat &in_audio_format,
 ConstBuffer<void>
 FfmpegFilter::FilterPCM(ConstBuffer<void> src)
 {
+	if (src.empty())
+		/* nothing to submit; libavfilter rejects empty frames */
+		return nullptr;
+
 	/* submit source data into the FFmpeg audio buffer source */
 
 	frame.Unref();
@@ -56,11 +60,18 @@ FfmpegFilter::FilterPCM(ConstBuffer<void> src)
 	frame->channels = in_channels;
 	frame->nb_samples = src.size / in_audio_frame_size;
 
-	frame.GetBuffer();
+	/* the source data must be copied, because it's const and
+	   libavfilter may modify the frame in-place or keep a
+	   reference; but the buffer comes from a pool instead of
+	   being allocated for each call */
+	frame.SetPackedBuffer(buffer_pool.Get(src.size), src.size);
 
 	memcpy(frame.GetData(0), src.data, src.size);
 
-	int err = av_buffersrc_add_frame(buffer_src.get(), frame.get());
+	/* the format never changes, tell libavfilter to skip the
+	   check */
+	int err = av_buffersrc_add_frame_flags(buffer_src.get(), frame.get(),
+					       AV_BUFFERSRC_FLAG_NO_CHECK_FORMAT);
 	if (err < 0)
 		throw MakeFfmpegError(err, "av_buffersrc_write_frame() failed");
 
@@ -23,6 +23,7 @@
 #include "filter/Filter.hxx"
 #include "lib/ffmpeg/Filter.hxx"
 #include "lib/ffmpeg/Frame.hxx"
+#include "lib/ffmpeg/BufferPool.hxx"
 
 /**
  * A #Filter implementation using FFmpeg's libavfilter.
@@ -32,6 +33,13 @@ class FfmpegFilter final : public Filter {
 	Ffmpeg::FilterContext buffer_src, buffer_sink;
 	Ffmpeg::Frame frame;
 
+	/**
+	 * Provides the input frame buffers.  The filter graph may
+	 * keep a reference to a frame after FilterPCM() returns, so
+	 * a single buffer can't be reused.
+	 */
+	Ffmpeg::BufferPool buffer_pool;
+
 	const int in_format, in_sample_rate, in_channels;
 
 	const size_t in_audio_frame_size;
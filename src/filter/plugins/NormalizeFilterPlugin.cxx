@@ -22,9 +22,13 @@
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
 #include "pcm/Buffer.hxx"
+#include "pcm/Normalizer.hxx"
 #include "AudioFormat.hxx"
 #include "AudioCompress/compress.h"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <algorithm>
 
 #include <string.h>
 
@@ -46,6 +50,28 @@ public:
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
 };
 
+/**
+ * The normalizer for all formats other than 16 bit: the samples are
+ * processed as floating point, so high-resolution audio keeps its
+ * resolution.
+ */
+class FloatNormalizeFilter final : public Filter {
+	PcmNormalizer normalizer;
+
+	PcmBuffer buffer;
+
+public:
+	explicit FloatNormalizeFilter(const AudioFormat &audio_format)
+		:Filter(audio_format) {}
+
+	/* virtual methods from class Filter */
+	void Reset() noexcept override {
+		normalizer.Reset();
+	}
+
+	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+};
+
 class PreparedNormalizeFilter final : public PreparedFilter {
 public:
 	/* virtual methods from class PreparedFilter */
@@ -61,9 +87,17 @@ normalize_filter_init(gcc_unused const ConfigBlock &block)
 std::unique_ptr<Filter>
 PreparedNormalizeFilter::Open(AudioFormat &audio_format)
 {
-	audio_format.format = SampleFormat::S16;
+	switch (audio_format.format) {
+	case SampleFormat::S8:
+	case SampleFormat::S16:
+		/* AudioCompress operates on 16 bit samples */
+		audio_format.format = SampleFormat::S16;
+		return std::make_unique<NormalizeFilter>(audio_format);
 
-	return std::make_unique<NormalizeFilter>(audio_format);
+	default:
+		audio_format.format = SampleFormat::FLOAT;
+		return std::make_unique<FloatNormalizeFilter>(audio_format);
+	}
 }
 
 ConstBuffer<void>
@@ -76,6 +110,17 @@ NormalizeFilter::FilterPCM(ConstBuffer<void> src)
 	return { (const void *)dest, src.size };
 }
 
+ConstBuffer<void>
+FloatNormalizeFilter::FilterPCM(ConstBuffer<void> src)
+{
+	const auto src_f = ConstBuffer<float>::FromVoid(src);
+	float *dest = buffer.GetT<float>(src_f.size);
+	std::copy_n(src_f.data, src_f.size, dest);
+
+	normalizer.Process({dest, src_f.size});
+	return { (const void *)dest, src.size };
+}
+
 const FilterPlugin normalize_filter_plugin = {
 	"normalize",
 	normalize_filter_init,
@@ -51,11 +51,11 @@
 #include "util/RuntimeError.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/WritableBuffer.hxx"
+#include "util/Compiler.h"
 
 #include <array>
 #include <stdexcept>
 
-#include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -64,9 +64,23 @@ class RouteFilter final : public Filter {
 	 * The set of copy operations to perform on each sample
 	 * The index is an output channel to use, the value is
 	 * a corresponding input channel from which to take the
-	 * data. A -1 means "no source"
+	 * data. A -1 means "no source"; sources which do not exist
+	 * in the input format are normalized to -1 by the
+	 * constructor.
+	 */
+	std::array<int8_t, MAX_CHANNELS> sources;
+
+	/**
+	 * Does the map copy all input channels unmodified?  Then
+	 * FilterPCM() returns its input buffer.
 	 */
-	const std::array<int8_t, MAX_CHANNELS> sources;
+	bool identity = true;
+
+	/**
+	 * Is there only one input channel, which is copied to all
+	 * output channels?
+	 */
+	bool mono_to_all = true;
 
 	/**
 	 * The actual input format of our signal, once opened
@@ -213,6 +227,24 @@ RouteFilter::RouteFilter(const AudioFormat &audio_format,
 
 	// Precalculate this simple value, to speed up allocation later
 	output_frame_size = out_audio_format.GetFrameSize();
+
+	if (out_channels != input_format.channels)
+		identity = false;
+
+	for (unsigned c = 0; c < out_channels; ++c) {
+		if (sources[c] >= 0 &&
+		    unsigned(sources[c]) >= input_format.channels)
+			sources[c] = -1;
+
+		if (sources[c] != int8_t(c))
+			identity = false;
+
+		if (sources[c] != 0)
+			mono_to_all = false;
+	}
+
+	if (input_format.channels != 1)
+		mono_to_all = false;
 }
 
 std::unique_ptr<Filter>
@@ -222,50 +254,142 @@ PreparedRouteFilter::Open(AudioFormat &audio_format)
 					     sources);
 }
 
+/**
+ * Copy one input channel to all output channels.
+ */
+template<typename T>
+static void
+RouteMonoToAll(T *gcc_restrict dest, const T *gcc_restrict src,
+	       size_t n_frames, unsigned out_channels) noexcept
+{
+	for (size_t i = 0; i < n_frames; ++i) {
+		const T value = src[i];
+		for (unsigned c = 0; c < out_channels; ++c)
+			*dest++ = value;
+	}
+}
+
+/**
+ * The generic kernel: copy each output channel from the given
+ * input channel, or fill it with #silence.
+ */
+template<typename T, unsigned out_channels>
+static void
+RouteCopy(T *gcc_restrict dest, const T *gcc_restrict src,
+	  size_t n_frames, unsigned in_channels,
+	  const std::array<int8_t, MAX_CHANNELS> &sources,
+	  T silence) noexcept
+{
+	for (size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < out_channels; ++c)
+			*dest++ = sources[c] >= 0
+				? src[sources[c]]
+				: silence;
+
+		src += in_channels;
+	}
+}
+
+template<typename T>
+static void
+RouteCopy(T *gcc_restrict dest, const T *gcc_restrict src,
+	  size_t n_frames, unsigned in_channels, unsigned out_channels,
+	  const std::array<int8_t, MAX_CHANNELS> &sources,
+	  T silence) noexcept
+{
+	/* specialize the most common output channel counts, which
+	   allows the compiler to unroll the inner loop */
+	switch (out_channels) {
+	case 1:
+		RouteCopy<T, 1>(dest, src, n_frames, in_channels,
+				sources, silence);
+		break;
+
+	case 2:
+		RouteCopy<T, 2>(dest, src, n_frames, in_channels,
+				sources, silence);
+		break;
+
+	case 4:
+		RouteCopy<T, 4>(dest, src, n_frames, in_channels,
+				sources, silence);
+		break;
+
+	case 6:
+		RouteCopy<T, 6>(dest, src, n_frames, in_channels,
+				sources, silence);
+		break;
+
+	default:
+		for (size_t i = 0; i < n_frames; ++i) {
+			for (unsigned c = 0; c < out_channels; ++c)
+				*dest++ = sources[c] >= 0
+					? src[sources[c]]
+					: silence;
+
+			src += in_channels;
+		}
+		break;
+	}
+}
+
+template<typename T>
+static void
+RouteTyped(void *dest, const void *src, size_t n_frames,
+	   unsigned in_channels, unsigned out_channels,
+	   const std::array<int8_t, MAX_CHANNELS> &sources,
+	   bool mono_to_all, SampleFormat format) noexcept
+{
+	if (mono_to_all) {
+		RouteMonoToAll((T *)dest, (const T *)src,
+			       n_frames, out_channels);
+		return;
+	}
+
+	T silence;
+	PcmSilence({&silence, sizeof(silence)}, format);
+
+	RouteCopy((T *)dest, (const T *)src, n_frames,
+		  in_channels, out_channels, sources, silence);
+}
+
 ConstBuffer<void>
 RouteFilter::FilterPCM(ConstBuffer<void> src)
 {
-	size_t number_of_frames = src.size / input_frame_size;
-
-	const size_t bytes_per_frame_per_channel = input_format.GetSampleSize();
+	if (identity)
+		/* nothing to do, pass the input through */
+		return src;
 
-	// A moving pointer that always refers to channel 0 in the input, at the currently handled frame
-	const uint8_t *base_source = (const uint8_t *)src.data;
+	const size_t number_of_frames = src.size / input_frame_size;
 
-	// Grow our reusable buffer, if needed, and set the moving pointer
+	// Grow our reusable buffer, if needed
 	const size_t result_size = number_of_frames * output_frame_size;
 	void *const result = output_buffer.Get(result_size);
 
-	// A moving pointer that always refers to the currently filled channel of the currently handled frame, in the output
-	uint8_t *chan_destination = (uint8_t *)result;
-
-	// Perform our copy operations, with N input channels and M output channels
-	for (unsigned int s=0; s<number_of_frames; ++s) {
-
-		// Need to perform one copy per output channel
-		for (unsigned c = 0; c < out_audio_format.channels; ++c) {
-			if (sources[c] == -1 ||
-			    (unsigned)sources[c] >= input_format.channels) {
-				// No source for this destination output,
-				// give it zeroes as input
-				PcmSilence({chan_destination, bytes_per_frame_per_channel},
-					   input_format.format);
-			} else {
-				// Get the data from channel sources[c]
-				// and copy it to the output
-				const uint8_t *data = base_source +
-					(sources[c] * bytes_per_frame_per_channel);
-				memcpy(chan_destination,
-					  data,
-					  bytes_per_frame_per_channel);
-			}
-			// Move on to the next output channel
-			chan_destination += bytes_per_frame_per_channel;
-		}
-
-
-		// Go on to the next N input samples
-		base_source += input_frame_size;
+	const unsigned in_channels = input_format.channels;
+	const unsigned out_channels = out_audio_format.channels;
+
+	switch (input_format.GetSampleSize()) {
+	case 1:
+		RouteTyped<uint8_t>(result, src.data, number_of_frames,
+				    in_channels, out_channels, sources,
+				    mono_to_all, input_format.format);
+		break;
+
+	case 2:
+		RouteTyped<uint16_t>(result, src.data, number_of_frames,
+				     in_channels, out_channels, sources,
+				     mono_to_all, input_format.format);
+		break;
+
+	case 4:
+		RouteTyped<uint32_t>(result, src.data, number_of_frames,
+				     in_channels, out_channels, sources,
+				     mono_to_all, input_format.format);
+		break;
+
+	default:
+		gcc_unreachable();
 	}
 
 	// Here it is, ladies and gentlemen! Rerouted data!
@@ -44,6 +44,11 @@ public:
 
 	/* virtual methods from class Filter */
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+
+	ConstBuffer<void> FilterPCMTo(ConstBuffer<void> src,
+				      SampleFormat format) override {
+		return pv.Apply(src, format);
+	}
 };
 
 class PreparedVolumeFilter final : public PreparedFilter {
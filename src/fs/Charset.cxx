@@ -23,6 +23,7 @@
 #include "Log.hxx"
 #include "lib/icu/Converter.hxx"
 #include "util/AllocatedString.hxx"
+#include "util/ASCII.hxx"
 #include "config.h"
 
 #ifdef _WIN32
@@ -46,6 +47,16 @@ SetFSCharset(const char *charset)
 	assert(charset != nullptr);
 	assert(fs_converter == nullptr);
 
+	if (StringEqualsCaseASCII(charset, "UTF-8") ||
+	    StringEqualsCaseASCII(charset, "UTF8")) {
+		/* no converter: PathToUTF8() and PathFromUTF8()
+		   degrade to plain copies */
+		FormatDebug(path_domain,
+			    "SetFSCharset: fs charset is: %s (no conversion)",
+			    charset);
+		return;
+	}
+
 	fs_converter = IcuConverter::Create(charset);
 	assert(fs_converter != nullptr);
 
@@ -76,6 +87,18 @@ GetFSCharset() noexcept
 #endif
 }
 
+bool
+IsFSCharsetUTF8() noexcept
+{
+#ifdef _WIN32
+	return false;
+#elif defined(HAVE_FS_CHARSET)
+	return fs_converter == nullptr;
+#else
+	return true;
+#endif
+}
+
 static inline PathTraitsUTF8::string &&
 FixSeparators(PathTraitsUTF8::string &&s)
 {
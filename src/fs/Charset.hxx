@@ -39,6 +39,15 @@ SetFSCharset(const char *charset);
 void
 DeinitFSCharset() noexcept;
 
+/**
+ * Does the file system character set equal UTF-8, i.e. are
+ * PathToUTF8() and PathFromUTF8() plain copies?  Callers may use this
+ * to skip the conversion altogether.
+ */
+gcc_pure
+bool
+IsFSCharsetUTF8() noexcept;
+
 /**
  * Convert the path to UTF-8.
  *
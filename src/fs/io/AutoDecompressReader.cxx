@@ -17,13 +17,25 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
-#include "AutoGunzipReader.hxx"
+#include "AutoDecompressReader.hxx"
+
+#ifdef ENABLE_ZLIB
 #include "GunzipReader.hxx"
+#endif
+
+#ifdef ENABLE_ZSTD
+#include "ZstdReader.hxx"
+#endif
 
-AutoGunzipReader::AutoGunzipReader(Reader &_next) noexcept
+#include <assert.h>
+#include <stdint.h>
+
+AutoDecompressReader::AutoDecompressReader(Reader &_next) noexcept
 	:peek(_next) {}
 
-AutoGunzipReader::~AutoGunzipReader() noexcept = default;
+AutoDecompressReader::~AutoDecompressReader() noexcept = default;
+
+#ifdef ENABLE_ZLIB
 
 gcc_pure
 static bool
@@ -33,23 +45,43 @@ IsGzip(const uint8_t data[4]) noexcept
 		(data[3] & 0xe0) == 0;
 }
 
+#endif
+
+#ifdef ENABLE_ZSTD
+
+gcc_pure
+static bool
+IsZstd(const uint8_t data[4]) noexcept
+{
+	/* the frame magic number 0xFD2FB528 (little-endian) */
+	return data[0] == 0x28 && data[1] == 0xb5 && data[2] == 0x2f &&
+		data[3] == 0xfd;
+}
+
+#endif
+
 inline void
-AutoGunzipReader::Detect()
+AutoDecompressReader::Detect()
 {
+	next = &peek;
+
 	const uint8_t *data = (const uint8_t *)peek.Peek(4);
-	if (data == nullptr) {
-		next = &peek;
+	if (data == nullptr)
 		return;
-	}
 
+#ifdef ENABLE_ZLIB
 	if (IsGzip(data))
 		next = (gunzip = std::make_unique<GunzipReader>(peek)).get();
-	else
-		next = &peek;
+#endif
+
+#ifdef ENABLE_ZSTD
+	if (IsZstd(data))
+		next = (zstd = std::make_unique<ZstdReader>(peek)).get();
+#endif
 }
 
 size_t
-AutoGunzipReader::Read(void *data, size_t size)
+AutoDecompressReader::Read(void *data, size_t size)
 {
 	if (next == nullptr)
 		Detect();
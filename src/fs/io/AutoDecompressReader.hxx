@@ -17,27 +17,37 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
-#ifndef MPD_AUTO_GUNZIP_READER_HXX
-#define MPD_AUTO_GUNZIP_READER_HXX
+#ifndef MPD_AUTO_DECOMPRESS_READER_HXX
+#define MPD_AUTO_DECOMPRESS_READER_HXX
 
 #include "PeekReader.hxx"
+#include "config.h"
 
 #include <memory>
 
 class GunzipReader;
+class ZstdReader;
 
 /**
- * A filter that detects gzip compression and optionally inserts a
- * #GunzipReader.
+ * A filter which detects gzip and zstd compressed data by peeking at
+ * the first bytes and decompresses it on the fly (if the respective
+ * library is available).  Other data is passed through.
  */
-class AutoGunzipReader final : public Reader {
+class AutoDecompressReader final : public Reader {
 	Reader *next = nullptr;
 	PeekReader peek;
+
+#ifdef ENABLE_ZLIB
 	std::unique_ptr<GunzipReader> gunzip;
+#endif
+
+#ifdef ENABLE_ZSTD
+	std::unique_ptr<ZstdReader> zstd;
+#endif
 
 public:
-	explicit AutoGunzipReader(Reader &_next) noexcept;
-	~AutoGunzipReader() noexcept;
+	explicit AutoDecompressReader(Reader &_next) noexcept;
+	~AutoDecompressReader() noexcept;
 
 	/* virtual methods from class Reader */
 	virtual size_t Read(void *data, size_t size) override;
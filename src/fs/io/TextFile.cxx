@@ -19,7 +19,7 @@
 
 #include "TextFile.hxx"
 #include "FileReader.hxx"
-#include "AutoGunzipReader.hxx"
+#include "AutoDecompressReader.hxx"
 #include "BufferedReader.hxx"
 #include "fs/Path.hxx"
 
@@ -27,16 +27,8 @@
 
 TextFile::TextFile(Path path_fs)
 	:file_reader(std::make_unique<FileReader>(path_fs)),
-#ifdef ENABLE_ZLIB
-	 gunzip_reader(std::make_unique<AutoGunzipReader>(*file_reader)),
-#endif
-	 buffered_reader(std::make_unique<BufferedReader>(*
-#ifdef ENABLE_ZLIB
-							  gunzip_reader
-#else
-							  file_reader
-#endif
-							  ))
+	 decompress_reader(std::make_unique<AutoDecompressReader>(*file_reader)),
+	 buffered_reader(std::make_unique<BufferedReader>(*decompress_reader))
 {
 }
 
@@ -20,21 +20,19 @@
 #ifndef MPD_TEXT_FILE_HXX
 #define MPD_TEXT_FILE_HXX
 
-#include "config.h"
+#include "LineReader.hxx"
 
 #include <memory>
 
 class Path;
 class FileReader;
-class AutoGunzipReader;
+class AutoDecompressReader;
 class BufferedReader;
 
-class TextFile {
+class TextFile final : public LineReader {
 	const std::unique_ptr<FileReader> file_reader;
 
-#ifdef ENABLE_ZLIB
-	const std::unique_ptr<AutoGunzipReader> gunzip_reader;
-#endif
+	const std::unique_ptr<AutoDecompressReader> decompress_reader;
 
 	const std::unique_ptr<BufferedReader> buffered_reader;
 
@@ -45,14 +43,8 @@ public:
 
 	~TextFile() noexcept;
 
-	/**
-	 * Reads a line from the input file, and strips trailing
-	 * space.  There is a reasonable maximum line length, only to
-	 * prevent denial of service.
-	 *
-	 * @return a pointer to the line, or nullptr on end-of-file
-	 */
-	char *ReadLine();
+	/* virtual methods from class LineReader */
+	char *ReadLine() override;
 };
 
 #endif
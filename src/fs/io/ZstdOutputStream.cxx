@@ -0,0 +1,79 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ZstdOutputStream.hxx"
+#include "lib/zstd/Error.hxx"
+
+#include <new>
+
+#include <stdint.h>
+
+ZstdOutputStream::ZstdOutputStream(OutputStream &_next, unsigned threads)
+	:next(_next), cctx(ZSTD_createCCtx())
+{
+	if (cctx == nullptr)
+		throw std::bad_alloc();
+
+	if (threads > 0)
+		/* this fails if libzstd was built without
+		   multi-threading support; ignore that */
+		ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, threads);
+}
+
+void
+ZstdOutputStream::Flush()
+{
+	/* no more input */
+	ZSTD_inBuffer in{nullptr, 0, 0};
+
+	while (true) {
+		uint8_t output[16384];
+		ZSTD_outBuffer out{output, sizeof(output), 0};
+
+		const size_t result = ZSTD_compressStream2(cctx, &out, &in,
+							   ZSTD_e_end);
+		if (ZSTD_isError(result))
+			throw ZstdError(result);
+
+		if (out.pos > 0)
+			next.Write(output, out.pos);
+
+		if (result == 0)
+			break;
+	}
+}
+
+void
+ZstdOutputStream::Write(const void *data, size_t size)
+{
+	ZSTD_inBuffer in{data, size, 0};
+
+	while (in.pos < in.size) {
+		uint8_t output[16384];
+		ZSTD_outBuffer out{output, sizeof(output), 0};
+
+		const size_t result = ZSTD_compressStream2(cctx, &out, &in,
+							   ZSTD_e_continue);
+		if (ZSTD_isError(result))
+			throw ZstdError(result);
+
+		if (out.pos > 0)
+			next.Write(output, out.pos);
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ZSTD_OUTPUT_STREAM_HXX
+#define MPD_ZSTD_OUTPUT_STREAM_HXX
+
+#include "OutputStream.hxx"
+
+#include <zstd.h>
+
+/**
+ * A filter that compresses data using zstd.
+ */
+class ZstdOutputStream final : public OutputStream {
+	OutputStream &next;
+
+	ZSTD_CCtx *const cctx;
+
+public:
+	/**
+	 * Construct the filter.
+	 *
+	 * @param threads the number of worker threads; 0 compresses
+	 * in the calling thread; this is ignored if libzstd was
+	 * built without multi-threading support
+	 */
+	explicit ZstdOutputStream(OutputStream &_next,
+				  unsigned threads=0);
+
+	~ZstdOutputStream() noexcept {
+		ZSTD_freeCCtx(cctx);
+	}
+
+	ZstdOutputStream(const ZstdOutputStream &) = delete;
+	ZstdOutputStream &operator=(const ZstdOutputStream &) = delete;
+
+	/**
+	 * Finish the file and write all data remaining in zstd's
+	 * output buffer.
+	 */
+	void Flush();
+
+	/* virtual methods from class OutputStream */
+	void Write(const void *data, size_t size) override;
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ZstdReader.hxx"
+#include "lib/zstd/Error.hxx"
+
+#include <new>
+#include <stdexcept>
+
+#include <assert.h>
+
+ZstdReader::ZstdReader(Reader &_next)
+	:next(_next), dstream(ZSTD_createDStream())
+{
+	if (dstream == nullptr)
+		throw std::bad_alloc();
+
+	const size_t result = ZSTD_initDStream(dstream);
+	if (ZSTD_isError(result)) {
+		ZSTD_freeDStream(dstream);
+		throw ZstdError(result);
+	}
+}
+
+inline bool
+ZstdReader::FillBuffer()
+{
+	auto w = buffer.Write();
+	assert(!w.empty());
+
+	size_t nbytes = next.Read(w.data, w.size);
+	if (nbytes == 0)
+		return false;
+
+	buffer.Append(nbytes);
+	return true;
+}
+
+size_t
+ZstdReader::Read(void *data, size_t size)
+{
+	ZSTD_outBuffer out{data, size, 0};
+
+	while (true) {
+		if (buffer.Read().empty() && !input_eof && !FillBuffer())
+			input_eof = true;
+
+		auto r = buffer.Read();
+		if (r.empty() && frame_complete)
+			/* end of stream */
+			return 0;
+
+		ZSTD_inBuffer in{r.data, r.size, 0};
+		const size_t result = ZSTD_decompressStream(dstream,
+							    &out, &in);
+		if (ZSTD_isError(result))
+			throw ZstdError(result);
+
+		buffer.Consume(in.pos);
+		frame_complete = result == 0;
+
+		if (out.pos > 0)
+			return out.pos;
+
+		if (r.empty())
+			/* no progress with no more input */
+			throw std::runtime_error("Truncated zstd stream");
+	}
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ZSTD_READER_HXX
+#define MPD_ZSTD_READER_HXX
+
+#include "Reader.hxx"
+#include "util/StaticFifoBuffer.hxx"
+
+#include <zstd.h>
+
+#include <stdint.h>
+
+/**
+ * A filter that decompresses data using zstd.  Concatenated frames
+ * are supported.
+ */
+class ZstdReader final : public Reader {
+	Reader &next;
+
+	ZSTD_DStream *const dstream;
+
+	/**
+	 * Has the end of the input been reached?
+	 */
+	bool input_eof = false;
+
+	/**
+	 * Has the last frame been decoded completely?
+	 */
+	bool frame_complete = false;
+
+	StaticFifoBuffer<uint8_t, 65536> buffer;
+
+public:
+	/**
+	 * Construct the filter.
+	 */
+	explicit ZstdReader(Reader &_next);
+
+	~ZstdReader() noexcept {
+		ZSTD_freeDStream(dstream);
+	}
+
+	ZstdReader(const ZstdReader &) = delete;
+	ZstdReader &operator=(const ZstdReader &) = delete;
+
+	/* virtual methods from class Reader */
+	size_t Read(void *data, size_t size) override;
+
+private:
+	bool FillBuffer();
+};
+
+#endif
@@ -171,9 +171,8 @@ AsyncInputStream::IsAvailable() const noexcept
 		!buffer.empty();
 }
 
-size_t
-AsyncInputStream::Read(std::unique_lock<Mutex> &lock,
-		       void *ptr, size_t read_size)
+ConstBuffer<void>
+AsyncInputStream::PeekDirect(std::unique_lock<Mutex> &lock)
 {
 	assert(!GetEventLoop().IsInside());
 
@@ -192,15 +191,29 @@ AsyncInputStream::Read(std::unique_lock<Mutex> &lock,
 		cond_handler.cond.wait(lock);
 	}
 
-	const size_t nbytes = std::min(read_size, r.size);
-	memcpy(ptr, r.data, nbytes);
+	return {r.data, r.size};
+}
+
+void
+AsyncInputStream::ConsumeDirect(size_t nbytes) noexcept
+{
 	buffer.Consume(nbytes);
 
 	offset += (offset_type)nbytes;
 
 	if (paused && buffer.GetSize() < resume_at)
 		deferred_resume.Schedule();
+}
+
+size_t
+AsyncInputStream::Read(std::unique_lock<Mutex> &lock,
+		       void *ptr, size_t read_size)
+{
+	const auto r = PeekDirect(lock);
 
+	const size_t nbytes = std::min(read_size, r.size);
+	memcpy(ptr, r.data, nbytes);
+	ConsumeDirect(nbytes);
 	return nbytes;
 }
 
@@ -44,7 +44,7 @@ class AsyncInputStream : public InputStream {
 	HugeArray<uint8_t> allocation;
 
 	CircularBuffer<uint8_t> buffer;
-	const size_t resume_at;
+	size_t resume_at;
 
 	bool open = true;
 
@@ -89,6 +89,8 @@ public:
 	bool IsAvailable() const noexcept final;
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    void *ptr, size_t read_size) final;
+	ConstBuffer<void> PeekDirect(std::unique_lock<Mutex> &lock) final;
+	void ConsumeDirect(size_t nbytes) noexcept final;
 
 protected:
 	/**
@@ -99,6 +101,14 @@ protected:
 
 	void Pause() noexcept;
 
+	/**
+	 * Change the buffer level below which a paused stream gets
+	 * resumed.  The caller must lock the mutex.
+	 */
+	void SetResumeAt(size_t _resume_at) noexcept {
+		resume_at = _resume_at;
+	}
+
 	bool IsPaused() const noexcept {
 		return paused;
 	}
@@ -128,6 +138,11 @@ protected:
 		return buffer.GetSpace();
 	}
 
+	gcc_pure
+	size_t GetBufferedSize() const noexcept {
+		return buffer.GetSize();
+	}
+
 	CircularBuffer<uint8_t>::Range PrepareWriteBuffer() noexcept {
 		return buffer.Write();
 	}
@@ -70,3 +70,15 @@ BufferedInputStream::Read(std::unique_lock<Mutex> &lock,
 	InputStream::offset += nbytes;
 	return nbytes;
 }
+
+ConstBuffer<void>
+BufferedInputStream::PeekDirect(std::unique_lock<Mutex> &lock)
+{
+	return BufferingInputStream::Peek(lock, offset);
+}
+
+void
+BufferedInputStream::ConsumeDirect(size_t nbytes) noexcept
+{
+	InputStream::offset += nbytes;
+}
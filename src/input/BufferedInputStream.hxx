@@ -61,6 +61,8 @@ public:
 	bool IsAvailable() const noexcept override;
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    void *ptr, size_t size) override;
+	ConstBuffer<void> PeekDirect(std::unique_lock<Mutex> &lock) override;
+	void ConsumeDirect(size_t nbytes) noexcept override;
 
 private:
 	/* virtual methods from class BufferingInputStream */
@@ -71,21 +71,17 @@ BufferingInputStream::IsAvailable(size_t offset) const noexcept
 	return false;
 }
 
-size_t
-BufferingInputStream::Read(std::unique_lock<Mutex> &lock, size_t offset,
-			   void *ptr, size_t s)
+ConstBuffer<void>
+BufferingInputStream::Peek(std::unique_lock<Mutex> &lock, size_t offset)
 {
 	if (offset >= size())
-		return 0;
+		return nullptr;
 
 	while (true) {
 		auto r = buffer.Read(offset);
-		if (r.HasData()) {
+		if (r.HasData())
 			/* yay, we have some data */
-			size_t nbytes = std::min(s, r.defined_buffer.size);
-			memcpy(ptr, r.defined_buffer.data, nbytes);
-			return nbytes;
-		}
+			return r.defined_buffer.ToVoid();
 
 		if (error)
 			std::rethrow_exception(error);
@@ -97,6 +93,16 @@ BufferingInputStream::Read(std::unique_lock<Mutex> &lock, size_t offset,
 	}
 }
 
+size_t
+BufferingInputStream::Read(std::unique_lock<Mutex> &lock, size_t offset,
+			   void *ptr, size_t s)
+{
+	const auto r = Peek(lock, offset);
+	const size_t nbytes = std::min(s, r.size);
+	memcpy(ptr, r.data, nbytes);
+	return nbytes;
+}
+
 size_t
 BufferingInputStream::FindFirstHole() const noexcept
 {
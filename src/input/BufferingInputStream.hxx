@@ -26,6 +26,8 @@
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "util/SparseBuffer.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
 
 #include <exception>
 
@@ -106,6 +108,31 @@ public:
 	 */
 	bool IsAvailable(size_t offset) const noexcept;
 
+	/**
+	 * Returns the whole contents of the file if it has been read
+	 * completely, or nullptr otherwise.  The returned buffer
+	 * remains valid as long as this object exists.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	ConstBuffer<uint8_t> GetCompleteBuffer() const noexcept {
+		auto r = buffer.Read(0);
+		if (r.undefined_size > 0 || r.defined_buffer.size < size())
+			return nullptr;
+
+		return r.defined_buffer;
+	}
+
+	/**
+	 * Wait until data is available at the given offset and
+	 * return it.  The returned buffer remains valid as long as
+	 * this object exists.
+	 *
+	 * @return the data or nullptr on end of file
+	 */
+	ConstBuffer<void> Peek(std::unique_lock<Mutex> &lock, size_t offset);
+
 	/**
 	 * Copy data from the buffer into the given pointer.
 	 *
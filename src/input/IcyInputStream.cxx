@@ -95,6 +95,17 @@ IcyInputStream::ReadTag() noexcept
 	return Tag::Merge(*input_tag, *icy_tag);
 }
 
+ConstBuffer<void>
+IcyInputStream::PeekDirect(std::unique_lock<Mutex> &lock)
+{
+	if (!IsEnabled())
+		return ProxyInputStream::PeekDirect(lock);
+
+	/* the metadata needs to be removed from the stream, which
+	   is only implemented by Read() */
+	return nullptr;
+}
+
 size_t
 IcyInputStream::Read(std::unique_lock<Mutex> &lock,
 		     void *ptr, size_t read_size)
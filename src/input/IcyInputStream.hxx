@@ -71,6 +71,7 @@ public:
 	std::unique_ptr<Tag> ReadTag() noexcept override;
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    void *ptr, size_t size) override;
+	ConstBuffer<void> PeekDirect(std::unique_lock<Mutex> &lock) override;
 };
 
 #endif
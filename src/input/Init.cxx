@@ -25,16 +25,94 @@
 #include "config/Block.hxx"
 #include "Log.hxx"
 #include "PluginUnavailable.hxx"
+#include "PluginInit.hxx"
+#include "event/Call.hxx"
 #include "util/RuntimeError.hxx"
 
+#include <chrono>
 #include <stdexcept>
 
 #include <assert.h>
 
+/**
+ * Used for plugins without an "input" block.
+ */
+static const ConfigBlock empty_input_block;
+
+/**
+ * The #EventLoop passed to the plugins' init() method.
+ */
+static EventLoop *input_plugins_event_loop;
+
+/**
+ * Serializes lazy plugin initializations.
+ */
+static Mutex input_plugins_init_mutex;
+
+/**
+ * Throws on fatal error.
+ *
+ * @return true if the plugin is enabled
+ */
+static bool
+InitInputPlugin(unsigned i)
+{
+	const InputPlugin *plugin = input_plugins[i];
+	const ConfigBlock &block = *input_plugin_blocks[i];
+
+	block.SetUsed();
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	try {
+		if (plugin->init != nullptr)
+			plugin->init(*input_plugins_event_loop, block);
+		LogPluginInitTime("Input", plugin->name,
+				  std::chrono::steady_clock::now() - start_time);
+		return true;
+	} catch (const PluginUnconfigured &e) {
+		LogFormat(LogLevel::INFO, e,
+			  "Input plugin '%s' is not configured",
+			  plugin->name);
+		return false;
+	} catch (const PluginUnavailable &e) {
+		FormatError(e,
+			    "Input plugin '%s' is unavailable",
+			    plugin->name);
+		return false;
+	} catch (...) {
+		std::throw_with_nested(FormatRuntimeError("Failed to initialize input plugin '%s'",
+							  plugin->name));
+	}
+}
+
+bool
+input_plugin_lazy_init(unsigned i) noexcept
+{
+	bool result = false;
+
+	try {
+		/* input plugins register sockets and timers in the
+		   #EventLoop, therefore they must be initialized
+		   inside its thread */
+		BlockingCall(*input_plugins_event_loop, [i, &result]{
+			result = input_plugin_states[i].Ensure(input_plugins_init_mutex,
+							       [i]{
+								       return InitInputPlugin(i);
+							       });
+		});
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+
+	return result;
+}
+
 void
 input_stream_global_init(const ConfigData &config, EventLoop &event_loop)
 {
-	const ConfigBlock empty;
+	const auto mode = GetPluginInitMode(config);
+	input_plugins_event_loop = &event_loop;
 
 	for (unsigned i = 0; input_plugins[i] != nullptr; ++i) {
 		const InputPlugin *plugin = input_plugins[i];
@@ -47,38 +125,25 @@ input_stream_global_init(const ConfigData &config, EventLoop &event_loop)
 			config.FindBlock(ConfigBlockOption::INPUT, "plugin",
 					 plugin->name);
 		if (block == nullptr) {
-			block = &empty;
+			block = &empty_input_block;
 		} else if (!block->GetBlockValue("enabled", true))
 			/* the plugin is disabled in mpd.conf */
 			continue;
 
-		block->SetUsed();
+		input_plugin_blocks[i] = block;
 
-		try {
-			if (plugin->init != nullptr)
-				plugin->init(event_loop, *block);
-			input_plugins_enabled[i] = true;
-		} catch (const PluginUnconfigured &e) {
-			LogFormat(LogLevel::INFO, e,
-				  "Input plugin '%s' is not configured",
-				  plugin->name);
-			continue;
-		} catch (const PluginUnavailable &e) {
-			FormatError(e,
-				    "Input plugin '%s' is unavailable",
-				    plugin->name);
-			continue;
-		} catch (...) {
-			std::throw_with_nested(FormatRuntimeError("Failed to initialize input plugin '%s'",
-								  plugin->name));
-		}
+		if (mode != PluginInitMode::EAGER)
+			input_plugin_states[i].SetPending();
+		else if (InitInputPlugin(i))
+			input_plugin_states[i].SetEnabled();
 	}
 }
 
 void
 input_stream_global_finish() noexcept
 {
-	input_plugins_for_each_enabled(plugin)
-		if (plugin->finish != nullptr)
+	input_plugins_for_each(plugin)
+		if (input_plugin_states[input_plugin_current_index()].IsEnabled() &&
+		    plugin->finish != nullptr)
 			plugin->finish();
 }
@@ -82,6 +82,14 @@ struct InputPlugin {
 	std::unique_ptr<RemoteTagScanner> (*scan_tags)(const char *uri,
 						       RemoteTagHandler &handler) = nullptr;
 
+	/**
+	 * The given URI is going to be opened soon; this is a hint
+	 * for the plugin to do expensive preparations (e.g. resolve
+	 * the streaming URL) in the background.  May be called
+	 * repeatedly for the same URI.
+	 */
+	void (*prefetch)(const char *uri) noexcept = nullptr;
+
 	gcc_pure
 	bool SupportsUri(const char *uri) const noexcept;
 
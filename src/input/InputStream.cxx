@@ -123,6 +123,21 @@ InputStream::LockRead(void *ptr, size_t _size)
 	return Read(lock, ptr, _size);
 }
 
+ConstBuffer<void>
+InputStream::PeekDirect(std::unique_lock<Mutex> &)
+{
+	return nullptr;
+}
+
+void
+InputStream::ConsumeDirect(size_t) noexcept
+{
+	/* must not be called because PeekDirect() never returns
+	   anything */
+	assert(false);
+	gcc_unreachable();
+}
+
 void
 InputStream::ReadFull(std::unique_lock<Mutex> &lock, void *_ptr, size_t _size)
 {
@@ -23,6 +23,7 @@
 #include "Offset.hxx"
 #include "Ptr.hxx"
 #include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/Compiler.h"
 
 #include <string>
@@ -374,6 +375,32 @@ public:
 	gcc_nonnull_all
 	size_t LockRead(void *ptr, size_t size);
 
+	/**
+	 * Obtain a pointer to the data at the current offset, which
+	 * the caller may use without copying it to its own buffer.
+	 * After using (a part of) it, call ConsumeDirect().  The
+	 * pointer remains valid until the offset is modified.
+	 *
+	 * The caller must lock the mutex.
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @return the data, or nullptr if this stream does not
+	 * support direct access (use Read() instead) or if the end
+	 * of the stream has been reached
+	 */
+	virtual ConstBuffer<void> PeekDirect(std::unique_lock<Mutex> &lock);
+
+	/**
+	 * Consume data which was returned by PeekDirect().
+	 *
+	 * The caller must lock the mutex.
+	 *
+	 * @param nbytes the number of bytes to consume; must not be
+	 * larger than the size returned by PeekDirect()
+	 */
+	virtual void ConsumeDirect(size_t nbytes) noexcept;
+
 	/**
 	 * Reads the whole data from the stream into the caller-supplied buffer.
 	 *
@@ -37,7 +37,8 @@ InputStream::Open(const char *url, Mutex &mutex)
 	}
 
 	input_plugins_for_each_enabled(plugin) {
-		if (!plugin->SupportsUri(url))
+		if (!plugin->SupportsUri(url) ||
+		    !input_plugin_ensure_init(input_plugin_current_index()))
 			continue;
 
 		auto is = plugin->open(url, mutex);
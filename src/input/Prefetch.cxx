@@ -0,0 +1,36 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Prefetch.hxx"
+#include "InputPlugin.hxx"
+#include "Registry.hxx"
+
+void
+InputPrefetch(const char *uri) noexcept
+{
+	input_plugins_for_each_enabled(plugin) {
+		if (plugin->SupportsUri(uri)) {
+			if (plugin->prefetch != nullptr &&
+			    input_plugin_ensure_init(input_plugin_current_index()))
+				plugin->prefetch(uri);
+			return;
+		}
+	}
+}
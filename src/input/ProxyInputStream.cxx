@@ -129,3 +129,18 @@ ProxyInputStream::Read(std::unique_lock<Mutex> &lock,
 	CopyAttributes();
 	return nbytes;
 }
+
+ConstBuffer<void>
+ProxyInputStream::PeekDirect(std::unique_lock<Mutex> &lock)
+{
+	set_input_cond.wait(lock, [this]{ return !!input; });
+
+	return input->PeekDirect(lock);
+}
+
+void
+ProxyInputStream::ConsumeDirect(size_t nbytes) noexcept
+{
+	input->ConsumeDirect(nbytes);
+	CopyAttributes();
+}
@@ -67,6 +67,8 @@ public:
 	bool IsAvailable() const noexcept override;
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    void *ptr, size_t read_size) override;
+	ConstBuffer<void> PeekDirect(std::unique_lock<Mutex> &lock) override;
+	void ConsumeDirect(size_t nbytes) noexcept override;
 
 protected:
 	/**
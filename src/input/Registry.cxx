@@ -82,7 +82,8 @@ const InputPlugin *const input_plugins[] = {
 	nullptr
 };
 
-bool input_plugins_enabled[std::size(input_plugins) - 1];
+LazyPluginState input_plugin_states[std::size(input_plugins) - 1];
+const ConfigBlock *input_plugin_blocks[std::size(input_plugins) - 1];
 
 bool
 HasRemoteTagScanner(const char *uri) noexcept
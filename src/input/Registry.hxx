@@ -20,15 +20,47 @@
 #ifndef MPD_INPUT_REGISTRY_HXX
 #define MPD_INPUT_REGISTRY_HXX
 
+#include "PluginInit.hxx"
 #include "util/Compiler.h"
 
+struct ConfigBlock;
+
 /**
  * NULL terminated list of all input plugins which were enabled at
  * compile time.
  */
 extern const struct InputPlugin *const input_plugins[];
 
-extern bool input_plugins_enabled[];
+extern LazyPluginState input_plugin_states[];
+
+/**
+ * The configuration of each enabled plugin, for lazy
+ * initialization.
+ */
+extern const ConfigBlock *input_plugin_blocks[];
+
+/**
+ * Initialize the specified plugin if that was postponed (see
+ * #PluginInitMode).  Do not call directly; use
+ * input_plugin_ensure_init().
+ *
+ * @return true if the plugin is enabled
+ */
+bool
+input_plugin_lazy_init(unsigned i) noexcept;
+
+/**
+ * Make sure the specified plugin (an index into #input_plugins) is
+ * initialized.
+ *
+ * @return true if the plugin is enabled
+ */
+static inline bool
+input_plugin_ensure_init(unsigned i) noexcept
+{
+	return input_plugin_states[i].IsEnabled() ||
+		input_plugin_lazy_init(i);
+}
 
 #define input_plugins_for_each(plugin) \
 	for (const InputPlugin *plugin, \
@@ -36,9 +68,21 @@ extern bool input_plugins_enabled[];
 		(plugin = *input_plugin_iterator) != NULL; \
 		++input_plugin_iterator)
 
+/**
+ * The index of the current plugin inside
+ * input_plugins_for_each().
+ */
+#define input_plugin_current_index() \
+	unsigned(input_plugin_iterator - input_plugins)
+
+/**
+ * Iterate over all enabled plugins, including those which are not yet
+ * initialized; call input_plugin_ensure_init() before calling one of
+ * the plugin's methods (other than SupportsUri()).
+ */
 #define input_plugins_for_each_enabled(plugin) \
 	input_plugins_for_each(plugin) \
-		if (input_plugins_enabled[input_plugin_iterator - input_plugins])
+		if (input_plugin_states[input_plugin_current_index()].IsAvailable())
 
 gcc_pure
 bool
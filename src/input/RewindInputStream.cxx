@@ -62,6 +62,8 @@ public:
 
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    void *ptr, size_t size) override;
+	ConstBuffer<void> PeekDirect(std::unique_lock<Mutex> &lock) override;
+	void ConsumeDirect(size_t nbytes) noexcept override;
 	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
 
 private:
@@ -115,6 +117,33 @@ RewindInputStream::Read(std::unique_lock<Mutex> &lock,
 	}
 }
 
+ConstBuffer<void>
+RewindInputStream::PeekDirect(std::unique_lock<Mutex> &lock)
+{
+	if (ReadingFromBuffer())
+		return {buffer + head, tail - head};
+
+	if (tail == (size_t)offset &&
+	    input->GetOffset() <= (offset_type)sizeof(buffer))
+		/* the data needs to be appended to the buffer, which
+		   is only implemented by Read() */
+		return nullptr;
+
+	return ProxyInputStream::PeekDirect(lock);
+}
+
+void
+RewindInputStream::ConsumeDirect(size_t nbytes) noexcept
+{
+	if (ReadingFromBuffer()) {
+		head += nbytes;
+		offset += nbytes;
+	} else {
+		tail = 0;
+		ProxyInputStream::ConsumeDirect(nbytes);
+	}
+}
+
 void
 RewindInputStream::Seek(std::unique_lock<Mutex> &lock, offset_type new_offset)
 {
@@ -26,7 +26,8 @@ std::unique_ptr<RemoteTagScanner>
 InputScanTags(const char *uri, RemoteTagHandler &handler)
 {
 	input_plugins_for_each_enabled(plugin) {
-		if (plugin->scan_tags == nullptr || !plugin->SupportsUri(uri))
+		if (plugin->scan_tags == nullptr || !plugin->SupportsUri(uri) ||
+		    !input_plugin_ensure_init(input_plugin_current_index()))
 			continue;
 
 		auto scanner = plugin->scan_tags(uri, handler);
@@ -129,9 +129,8 @@ ThreadInputStream::IsAvailable() const noexcept
 	return !buffer.empty() || eof || postponed_exception;
 }
 
-inline size_t
-ThreadInputStream::Read(std::unique_lock<Mutex> &lock,
-			void *ptr, size_t read_size)
+inline ConstBuffer<void>
+ThreadInputStream::PeekDirect(std::unique_lock<Mutex> &lock)
 {
 	assert(!thread.IsInside());
 
@@ -142,23 +141,37 @@ ThreadInputStream::Read(std::unique_lock<Mutex> &lock,
 			std::rethrow_exception(postponed_exception);
 
 		auto r = buffer.Read();
-		if (!r.empty()) {
-			size_t nbytes = std::min(read_size, r.size);
-			memcpy(ptr, r.data, nbytes);
-			buffer.Consume(nbytes);
-			wake_cond.notify_all();
-			offset += nbytes;
-			return nbytes;
-		}
+		if (!r.empty())
+			return {r.data, r.size};
 
 		if (eof)
-			return 0;
+			return nullptr;
 
 		const ScopeExchangeInputStreamHandler h(*this, &cond_handler);
 		cond_handler.cond.wait(lock);
 	}
 }
 
+void
+ThreadInputStream::ConsumeDirect(size_t nbytes) noexcept
+{
+	buffer.Consume(nbytes);
+	wake_cond.notify_all();
+	offset += nbytes;
+}
+
+size_t
+ThreadInputStream::Read(std::unique_lock<Mutex> &lock,
+			void *ptr, size_t read_size)
+{
+	const auto r = PeekDirect(lock);
+
+	const size_t nbytes = std::min(read_size, r.size);
+	memcpy(ptr, r.data, nbytes);
+	ConsumeDirect(nbytes);
+	return nbytes;
+}
+
 bool
 ThreadInputStream::IsEOF() const noexcept
 {
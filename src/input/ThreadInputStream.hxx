@@ -96,6 +96,8 @@ public:
 	bool IsAvailable() const noexcept final;
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    void *ptr, size_t size) override final;
+	ConstBuffer<void> PeekDirect(std::unique_lock<Mutex> &lock) override final;
+	void ConsumeDirect(size_t nbytes) noexcept override final;
 
 protected:
 	/**
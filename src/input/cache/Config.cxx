@@ -20,10 +20,24 @@
 #include "Config.hxx"
 #include "config/Block.hxx"
 #include "config/Parser.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <string.h>
 
 static constexpr size_t KILOBYTE = 1024;
 static constexpr size_t MEGABYTE = 1024 * KILOBYTE;
 
+static InputCacheConfig::Eviction
+ParseEviction(const char *s)
+{
+	if (strcmp(s, "lru") == 0)
+		return InputCacheConfig::Eviction::LRU;
+	else if (strcmp(s, "lfu") == 0)
+		return InputCacheConfig::Eviction::LFU;
+	else
+		throw FormatRuntimeError("Unknown eviction policy: %s", s);
+}
+
 InputCacheConfig::InputCacheConfig(const ConfigBlock &block)
 {
 	size = 256 * MEGABYTE;
@@ -32,4 +46,20 @@ InputCacheConfig::InputCacheConfig(const ConfigBlock &block)
 		size = size_param->With([](const char *s){
 			return ParseSize(s);
 		});
+
+	eviction = Eviction::LRU;
+	const auto *eviction_param = block.GetBlockParam("eviction");
+	if (eviction_param != nullptr)
+		eviction = eviction_param->With(ParseEviction);
+
+	prefetch = block.GetBlockValue("prefetch", 1u);
+
+	disk_path = block.GetPath("disk_path");
+
+	disk_size = 1024 * MEGABYTE;
+	const auto *disk_size_param = block.GetBlockParam("disk_size");
+	if (disk_size_param != nullptr)
+		disk_size = disk_size_param->With([](const char *s){
+			return ParseSize(s);
+		});
 }
@@ -20,6 +20,8 @@
 #ifndef MPD_INPUT_CACHE_CONFIG_HXX
 #define MPD_INPUT_CACHE_CONFIG_HXX
 
+#include "fs/AllocatedPath.hxx"
+
 #include <stddef.h>
 
 struct ConfigBlock;
@@ -27,6 +29,33 @@ struct ConfigBlock;
 struct InputCacheConfig {
 	size_t size;
 
+	enum class Eviction {
+		/**
+		 * Evict the least recently used item.
+		 */
+		LRU,
+
+		/**
+		 * Evict the least frequently used item; among items
+		 * with the same number of accesses, the least
+		 * recently used one.
+		 */
+		LFU,
+	} eviction;
+
+	/**
+	 * The number of upcoming songs to be loaded into the cache.
+	 */
+	unsigned prefetch;
+
+	/**
+	 * The directory of the on-disk cache tier; nullptr if
+	 * disabled.
+	 */
+	AllocatedPath disk_path = nullptr;
+
+	size_t disk_size;
+
 	explicit InputCacheConfig(const ConfigBlock &block);
 };
 
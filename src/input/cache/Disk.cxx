@@ -0,0 +1,440 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Disk.hxx"
+#include "Lease.hxx"
+#include "input/InputStream.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "thread/Name.hxx"
+#include "system/Error.hxx"
+#include "util/CharUtil.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <cinttypes>
+#include <stdexcept>
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr Domain input_cache_domain("input_cache");
+
+/**
+ * The last bytes of each cache file.
+ */
+struct InputCacheTrailer {
+	/**
+	 * The size of the cached data at the beginning of the file.
+	 */
+	uint64_t size;
+
+	/**
+	 * The length of the URI following the data.
+	 */
+	uint32_t uri_length;
+
+	uint32_t magic;
+
+	/**
+	 * This constant must be changed whenever the file layout
+	 * changes.
+	 */
+	static constexpr uint32_t MAGIC = 0x4d504331; // "MPC1"
+};
+
+static_assert(sizeof(InputCacheTrailer) == 16, "Wrong trailer size");
+
+/**
+ * Generate a file name from the FNV-1a hash of the URI.
+ */
+gcc_pure
+static std::string
+MakeCacheFileName(const char *uri) noexcept
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (const char *p = uri; *p != 0; ++p) {
+		hash ^= (uint8_t)*p;
+		hash *= 1099511628211ULL;
+	}
+
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016" PRIx64, hash);
+	return buffer;
+}
+
+gcc_pure
+static bool
+IsCacheFileName(const char *name) noexcept
+{
+	const size_t length = strlen(name);
+	return length == 16 &&
+		std::all_of(name, name + length, [](char ch){
+				return IsDigitASCII(ch) ||
+					(ch >= 'a' && ch <= 'f');
+			});
+}
+
+/**
+ * A read-only mapping of a whole cache file.
+ */
+class InputCacheMapping {
+	const uint8_t *data;
+	size_t size;
+
+public:
+	explicit InputCacheMapping(Path path) {
+		FileReader reader(path);
+
+		const uint64_t size64 = reader.GetSize();
+		if (size64 < sizeof(InputCacheTrailer) || size64 > SIZE_MAX)
+			throw std::runtime_error("Malformed cache file");
+
+		size = size64;
+
+		void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+			       reader.GetFD().Get(), 0);
+		if (p == MAP_FAILED)
+			throw MakeErrno("Failed to map cache file");
+
+		data = (const uint8_t *)p;
+	}
+
+	~InputCacheMapping() noexcept {
+		munmap(const_cast<uint8_t *>(data), size);
+	}
+
+	InputCacheMapping(const InputCacheMapping &) = delete;
+	InputCacheMapping &operator=(const InputCacheMapping &) = delete;
+
+	const uint8_t *GetData() const noexcept {
+		return data;
+	}
+
+	size_t GetSize() const noexcept {
+		return size;
+	}
+
+	InputCacheTrailer GetTrailer() const noexcept {
+		/* copy it, because it may be unaligned */
+		InputCacheTrailer trailer;
+		memcpy(&trailer, data + size - sizeof(trailer),
+		       sizeof(trailer));
+		return trailer;
+	}
+};
+
+/**
+ * An #InputStream which reads from an #InputCacheMapping.
+ */
+class MappedCacheInputStream final : public InputStream {
+	const std::unique_ptr<InputCacheMapping> mapping;
+
+public:
+	MappedCacheInputStream(const char *_uri, Mutex &_mutex,
+			       std::unique_ptr<InputCacheMapping> &&_mapping,
+			       size_t _size) noexcept
+		:InputStream(_uri, _mutex),
+		 mapping(std::move(_mapping))
+	{
+		size = _size;
+		seekable = true;
+		SetReady();
+	}
+
+	/* virtual methods from class InputStream */
+
+	void Seek(std::unique_lock<Mutex> &,
+		  offset_type new_offset) override {
+		offset = new_offset;
+	}
+
+	bool IsEOF() const noexcept override {
+		return offset == size;
+	}
+
+	size_t Read(std::unique_lock<Mutex> &,
+		    void *ptr, size_t read_size) override {
+		const size_t position = offset;
+		const size_t nbytes = std::min<size_t>(read_size,
+						       size - offset);
+
+		{
+			/* copying may block on disk I/O */
+			const ScopeUnlock unlock(mutex);
+			memcpy(ptr, mapping->GetData() + position, nbytes);
+		}
+
+		offset += nbytes;
+		return nbytes;
+	}
+
+	ConstBuffer<void> PeekDirect(std::unique_lock<Mutex> &) override {
+		return {mapping->GetData() + offset, size_t(size - offset)};
+	}
+
+	void ConsumeDirect(size_t nbytes) noexcept override {
+		assert(offset + nbytes <= size);
+
+		offset += nbytes;
+	}
+};
+
+InputCacheDisk::InputCacheDisk(AllocatedPath &&_directory,
+			       uint64_t _max_total_size)
+	:directory(std::move(_directory)),
+	 max_total_size(_max_total_size),
+	 thread(BIND_THIS_METHOD(RunThread))
+{
+	/* create the directory if it does not exist yet; errors are
+	   reported by Scan() */
+	mkdir(directory.c_str(), 0700);
+
+	Scan();
+
+	FormatDebug(input_cache_domain,
+		    "%zu files with %" PRIu64 " bytes in %s",
+		    entries.size(), total_size, directory.c_str());
+
+	thread.Start();
+}
+
+InputCacheDisk::~InputCacheDisk() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		stop = true;
+		cond.notify_one();
+	}
+
+	thread.Join();
+}
+
+AllocatedPath
+InputCacheDisk::MakePath(const std::string &name) const noexcept
+{
+	return AllocatedPath::Build(directory, name.c_str());
+}
+
+void
+InputCacheDisk::Scan()
+{
+	DirectoryReader reader(directory);
+
+	while (reader.ReadEntry()) {
+		const Path name = reader.GetEntry();
+		if (!IsCacheFileName(name.c_str()))
+			continue;
+
+		const auto path = MakePath(name.c_str());
+
+		FileInfo info;
+		if (!GetFileInfo(path, info, false) || !info.IsRegular())
+			continue;
+
+		entries.emplace(name.c_str(),
+				Entry{info.GetSize(), info.GetModificationTime()});
+		total_size += info.GetSize();
+	}
+
+	EvictOldest();
+}
+
+InputStreamPtr
+InputCacheDisk::Open(const char *uri, Mutex &_mutex) noexcept
+{
+	const auto name = MakeCacheFileName(uri);
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		if (entries.find(name) == entries.end())
+			return nullptr;
+	}
+
+	const auto path = MakePath(name);
+
+	try {
+		auto mapping = std::make_unique<InputCacheMapping>(path);
+
+		const auto trailer = mapping->GetTrailer();
+		if (trailer.magic != InputCacheTrailer::MAGIC ||
+		    trailer.size + trailer.uri_length + sizeof(trailer) != mapping->GetSize())
+			throw std::runtime_error("Malformed cache file");
+
+		const char *stored_uri = (const char *)mapping->GetData() + trailer.size;
+		if (trailer.uri_length != strlen(uri) ||
+		    memcmp(stored_uri, uri, trailer.uri_length) != 0)
+			/* hash collision */
+			return nullptr;
+
+#ifdef MADV_WILLNEED
+		madvise(const_cast<uint8_t *>(mapping->GetData()),
+			mapping->GetSize(), MADV_WILLNEED);
+#endif
+
+		/* refresh the modification time for the LRU
+		   eviction */
+		utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+
+		{
+			const std::lock_guard<Mutex> protect(mutex);
+			auto i = entries.find(name);
+			if (i != entries.end())
+				i->second.mtime = std::chrono::system_clock::now();
+		}
+
+		const size_t size = trailer.size;
+		return std::make_unique<MappedCacheInputStream>(uri, _mutex,
+								std::move(mapping),
+								size);
+	} catch (...) {
+		LogError(std::current_exception());
+
+		const std::lock_guard<Mutex> protect(mutex);
+		Remove(name);
+		return nullptr;
+	}
+}
+
+void
+InputCacheDisk::Spill(std::unique_ptr<InputCacheItem> item) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	spill_queue.push_back(std::move(item));
+	cond.notify_one();
+}
+
+void
+InputCacheDisk::Write(InputCacheItem &item)
+{
+	const char *uri = item.GetUri();
+	const auto name = MakeCacheFileName(uri);
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		if (entries.find(name) != entries.end())
+			/* already on disk */
+			return;
+	}
+
+	ConstBuffer<uint8_t> data;
+
+	{
+		/* the buffer is complete, and nobody will modify it
+		   anymore; it can be read without holding the
+		   lock */
+		const std::lock_guard<Mutex> protect(item.mutex);
+		data = item.GetCompleteBuffer();
+	}
+
+	assert(!data.IsNull());
+
+	const size_t uri_length = strlen(uri);
+	const InputCacheTrailer trailer{
+		data.size, uint32_t(uri_length), InputCacheTrailer::MAGIC,
+	};
+
+	FileOutputStream file(MakePath(name));
+	file.Write(data.data, data.size);
+	file.Write(uri, uri_length);
+	file.Write(&trailer, sizeof(trailer));
+	file.Commit();
+
+	const uint64_t file_size = data.size + uri_length + sizeof(trailer);
+
+	const std::lock_guard<Mutex> protect(mutex);
+	entries[name] = Entry{file_size, std::chrono::system_clock::now()};
+	total_size += file_size;
+	EvictOldest();
+}
+
+void
+InputCacheDisk::Remove(const std::string &name) noexcept
+{
+	auto i = entries.find(name);
+	if (i == entries.end())
+		return;
+
+	assert(total_size >= i->second.size);
+	total_size -= i->second.size;
+	entries.erase(i);
+
+	unlink(MakePath(name).c_str());
+}
+
+void
+InputCacheDisk::EvictOldest() noexcept
+{
+	while (total_size > max_total_size) {
+		auto oldest = std::min_element(entries.begin(), entries.end(),
+					       [](const auto &a, const auto &b){
+						       return a.second.mtime < b.second.mtime;
+					       });
+		assert(oldest != entries.end());
+
+		FormatDebug(input_cache_domain, "Evicting %s",
+			    oldest->first.c_str());
+
+		const std::string name = oldest->first;
+		Remove(name);
+	}
+}
+
+void
+InputCacheDisk::RunThread() noexcept
+{
+	SetThreadName("input_cache");
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (true) {
+		if (spill_queue.empty()) {
+			if (stop)
+				break;
+
+			cond.wait(lock);
+			continue;
+		}
+
+		auto item = std::move(spill_queue.front());
+		spill_queue.pop_front();
+
+		const ScopeUnlock unlock(mutex);
+
+		try {
+			Write(*item);
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to write input cache file");
+		}
+
+		/* delete the item while the mutex is unlocked */
+		item.reset();
+	}
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_INPUT_CACHE_DISK_HXX
+#define MPD_INPUT_CACHE_DISK_HXX
+
+#include "input/Ptr.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/Compiler.h"
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <stdint.h>
+
+class InputCacheItem;
+
+/**
+ * The on-disk tier of the #InputCacheManager.  Remote files which
+ * have been evicted from RAM are written to a directory in a
+ * separate thread; later, they are read back with mmap() instead of
+ * being downloaded again.  Unlike the RAM tier, this one survives
+ * restarts.
+ *
+ * Each file is named after a hash of its URI.  It contains the raw
+ * data, followed by the URI and a fixed-size trailer.  The least
+ * recently used files (by their modification time) are deleted when
+ * the directory grows larger than the configured size.
+ */
+class InputCacheDisk {
+	const AllocatedPath directory;
+
+	const uint64_t max_total_size;
+
+	mutable Mutex mutex;
+
+	/**
+	 * Wakes up the #thread.
+	 */
+	Cond cond;
+
+	struct Entry {
+		uint64_t size;
+
+		std::chrono::system_clock::time_point mtime;
+	};
+
+	/**
+	 * All files in the #directory, indexed by file name.
+	 */
+	std::map<std::string, Entry> entries;
+
+	uint64_t total_size = 0;
+
+	/**
+	 * Completely buffered items waiting to be written by the
+	 * #thread.
+	 */
+	std::list<std::unique_ptr<InputCacheItem>> spill_queue;
+
+	bool stop = false;
+
+	Thread thread;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	InputCacheDisk(AllocatedPath &&_directory, uint64_t _max_total_size);
+
+	/**
+	 * Writes all pending items to disk before returning.
+	 */
+	~InputCacheDisk() noexcept;
+
+	InputCacheDisk(const InputCacheDisk &) = delete;
+	InputCacheDisk &operator=(const InputCacheDisk &) = delete;
+
+	uint64_t GetMaxSize() const noexcept {
+		return max_total_size;
+	}
+
+	/**
+	 * Returns the total size of all files on disk.
+	 */
+	gcc_pure
+	uint64_t LockGetSize() const noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		return total_size;
+	}
+
+	/**
+	 * Open the cached copy of the given URI.  Errors are logged,
+	 * and the broken file is deleted.
+	 *
+	 * @return a ready #InputStream or nullptr if the URI is not
+	 * in this cache
+	 */
+	InputStreamPtr Open(const char *uri, Mutex &_mutex) noexcept;
+
+	/**
+	 * Schedule writing the given item to disk.  Its contents must
+	 * be complete (see BufferingInputStream::GetCompleteBuffer()),
+	 * and it must not be in use.  This object takes ownership and
+	 * deletes the item after it has been written.
+	 */
+	void Spill(std::unique_ptr<InputCacheItem> item) noexcept;
+
+private:
+	AllocatedPath MakePath(const std::string &name) const noexcept;
+
+	void Scan();
+
+	/**
+	 * Write the item's contents to a new file.
+	 *
+	 * Throws on error.
+	 */
+	void Write(InputCacheItem &item);
+
+	void Remove(const std::string &name) noexcept;
+
+	/**
+	 * Delete the least recently used files until the total size
+	 * is within the configured limit.
+	 */
+	void EvictOldest() noexcept;
+
+	void RunThread() noexcept;
+};
+
+#endif
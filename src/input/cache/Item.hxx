@@ -26,8 +26,11 @@
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/set_hook.hpp>
 
+#include <algorithm>
 #include <string>
 
+#include <stdint.h>
+
 class InputCacheLease;
 
 /**
@@ -52,6 +55,19 @@ class InputCacheItem final
 	LeaseList leases;
 	LeaseList::iterator next_lease = leases.end();
 
+	/**
+	 * How often was this item requested by the player?  Protected
+	 * by the #InputCacheManager's items_mutex, just like
+	 * #priority.
+	 */
+	unsigned frequency = 0;
+
+	/**
+	 * The priority for the "lfu" eviction policy; the item with
+	 * the lowest value is evicted first.
+	 */
+	uint64_t priority = 0;
+
 public:
 	explicit InputCacheItem(InputStreamPtr _input) noexcept;
 	~InputCacheItem() noexcept;
@@ -62,6 +78,26 @@ public:
 
 	using BufferingInputStream::size;
 
+	uint64_t GetPriority() const noexcept {
+		return priority;
+	}
+
+	/**
+	 * Record an access for the "lfu" eviction policy ("LFU with
+	 * dynamic aging": the age prevents items which were popular
+	 * long ago from staying forever).
+	 *
+	 * @param age the priority of the most recently evicted item
+	 * @param use true if the player is going to play this item,
+	 * false if it is only being prefetched
+	 */
+	void Access(uint64_t age, bool use) noexcept {
+		if (use)
+			++frequency;
+
+		priority = age + std::max(frequency, 1U);
+	}
+
 	bool IsInUse() const noexcept {
 		const std::lock_guard<Mutex> lock(mutex);
 		return !leases.empty();
@@ -21,9 +21,10 @@
 #include "Config.hxx"
 #include "Item.hxx"
 #include "Lease.hxx"
+#include "Disk.hxx"
 #include "input/InputStream.hxx"
 #include "fs/Traits.hxx"
-#include "util/DeleteDisposer.hxx"
+#include "util/UriExtract.hxx"
 
 #include <string.h>
 
@@ -48,14 +49,29 @@ InputCacheManager::ItemCompare::operator()(const InputCacheItem &a,
 	return strcmp(a.GetUri(), b.GetUri()) < 0;
 }
 
-InputCacheManager::InputCacheManager(const InputCacheConfig &config) noexcept
-	:max_total_size(config.size)
+InputCacheManager::InputCacheManager(const InputCacheConfig &config)
+	:max_total_size(config.size),
+	 eviction(config.eviction),
+	 prefetch_count(config.prefetch),
+	 prefetcher(*this)
 {
+#ifndef _WIN32
+	if (!config.disk_path.IsNull())
+		disk = std::make_unique<InputCacheDisk>(AllocatedPath(config.disk_path),
+							config.disk_size);
+#endif
 }
 
 InputCacheManager::~InputCacheManager() noexcept
 {
-	items_by_time.clear_and_dispose(DeleteDisposer());
+	prefetcher.Stop();
+
+	/* this moves all complete remote files to the disk tier,
+	   so they survive the restart */
+	items_by_uri.clear();
+	items_by_time.clear_and_dispose([this](InputCacheItem *item){
+			Dispose(item);
+		});
 }
 
 bool
@@ -75,55 +91,85 @@ InputCacheManager::Contains(const char *uri) noexcept
 }
 
 InputCacheLease
-InputCacheManager::Get(const char *uri, bool create)
+InputCacheManager::Get(const char *uri, bool create, bool prefetch)
 {
-	// TODO: allow caching remote files
-	if (!PathTraitsUTF8::IsAbsolute(uri))
+	/* only count accesses by the player; Contains() and the
+	   prefetcher don't tell anything about the workload */
+	const bool count = create && !prefetch;
+
+	// TODO: allow caching remote files without the disk tier
+	if (!PathTraitsUTF8::IsAbsolute(uri) &&
+	    (disk == nullptr || !uri_has_scheme(uri)))
 		return {};
 
-	UriMap::insert_commit_data hint;
-	auto result = items_by_uri.insert_check(uri, items_by_uri.key_comp(),
-						hint);
-	if (!result.second) {
-		auto &item = *result.first;
+	{
+		const std::lock_guard<Mutex> protect(items_mutex);
+
+		auto i = items_by_uri.find(uri, items_by_uri.key_comp());
+		if (i != items_by_uri.end()) {
+			auto &item = *i;
 
-		/* refresh */
-		items_by_time.erase(items_by_time.iterator_to(item));
-		items_by_time.push_back(item);
+			/* refresh */
+			items_by_time.erase(items_by_time.iterator_to(item));
+			items_by_time.push_back(item);
 
-		// TODO revalidate the cache item using the file's mtime?
-		// TODO if cache item contains error, retry now?
+			if (count)
+				++stats.hits;
 
-		return InputCacheLease(item);
+			if (create)
+				item.Access(lfu_age, !prefetch);
+
+			// TODO revalidate the cache item using the file's mtime?
+			// TODO if cache item contains error, retry now?
+
+			return InputCacheLease(item);
+		}
 	}
 
 	if (!create)
 		return {};
 
+	if (count) {
+		const std::lock_guard<Mutex> protect(items_mutex);
+		++stats.misses;
+	}
+
+	/* open the file without holding the lock, because this may
+	   block for a long time */
+
+	InputStreamPtr is;
+	if (disk != nullptr)
+		is = disk->Open(uri, mutex);
+
 	// TODO: wait for "ready" without blocking here
-	auto is = InputStream::OpenReady(uri, mutex);
+	if (!is)
+		is = InputStream::OpenReady(uri, mutex);
 
 	if (!IsEligible(*is))
 		return {};
 
+	const std::lock_guard<Mutex> protect(items_mutex);
+
+	UriMap::insert_commit_data hint;
+	auto result = items_by_uri.insert_check(uri, items_by_uri.key_comp(),
+						hint);
+	if (!result.second)
+		/* another thread was faster */
+		return InputCacheLease(*result.first);
+
 	const size_t size = is->GetSize();
 	total_size += size;
 
-	while (total_size > max_total_size && EvictOldestUnused()) {}
+	while (total_size > max_total_size && EvictOneUnused()) {}
 
 	auto *item = new InputCacheItem(std::move(is));
+	item->Access(lfu_age, !prefetch);
 	items_by_uri.insert_commit(*item, hint);
 	items_by_time.push_back(*item);
 
 	return InputCacheLease(*item);
 }
 
-void
-InputCacheManager::Prefetch(const char *uri)
-{
-	Get(uri, true);
-}
-
 void
 InputCacheManager::Remove(InputCacheItem &item) noexcept
 {
@@ -134,11 +180,34 @@ InputCacheManager::Remove(InputCacheItem &item) noexcept
 	items_by_uri.erase(items_by_uri.iterator_to(item));
 }
 
+void
+InputCacheManager::Dispose(InputCacheItem *item) noexcept
+{
+	/* local files are not worth being copied to the disk tier;
+	   complete remote files are written there in the
+	   background */
+	if (disk != nullptr && uri_has_scheme(item->GetUri())) {
+		bool complete;
+
+		{
+			const std::lock_guard<Mutex> protect(mutex);
+			complete = !item->GetCompleteBuffer().IsNull();
+		}
+
+		if (complete) {
+			disk->Spill(std::unique_ptr<InputCacheItem>(item));
+			return;
+		}
+	}
+
+	delete item;
+}
+
 void
 InputCacheManager::Delete(InputCacheItem *item) noexcept
 {
 	Remove(*item);
-	delete item;
+	Dispose(item);
 }
 
 InputCacheItem *
@@ -151,13 +220,42 @@ InputCacheManager::FindOldestUnused() noexcept
 	return nullptr;
 }
 
+InputCacheItem *
+InputCacheManager::FindLeastFrequentlyUsedUnused() noexcept
+{
+	InputCacheItem *result = nullptr;
+
+	/* iterate from the oldest item, so among items with the
+	   same priority, the least recently used one wins */
+	for (auto &i : items_by_time)
+		if ((result == nullptr ||
+		     i.GetPriority() < result->GetPriority()) &&
+		    !i.IsInUse())
+			result = &i;
+
+	return result;
+}
+
 bool
-InputCacheManager::EvictOldestUnused() noexcept
+InputCacheManager::EvictOneUnused() noexcept
 {
-	auto *item = FindOldestUnused();
+	InputCacheItem *item = nullptr;
+	switch (eviction) {
+	case InputCacheConfig::Eviction::LRU:
+		item = FindOldestUnused();
+		break;
+
+	case InputCacheConfig::Eviction::LFU:
+		item = FindLeastFrequentlyUsedUnused();
+		if (item != nullptr)
+			lfu_age = item->GetPriority();
+		break;
+	}
+
 	if (item == nullptr)
 		return false;
 
+	++stats.evictions;
 	Delete(item);
 	return true;
 }
@@ -20,28 +20,89 @@
 #ifndef MPD_INPUT_CACHE_MANAGER_HXX
 #define MPD_INPUT_CACHE_MANAGER_HXX
 
+#include "Config.hxx"
+#include "Prefetcher.hxx"
 #include "thread/Mutex.hxx"
 #include "util/Compiler.h"
 
 #include <boost/intrusive/set.hpp>
 #include <boost/intrusive/list.hpp>
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
 class InputStream;
+class InputCacheDisk;
 class InputCacheItem;
 class InputCacheLease;
-struct InputCacheConfig;
+
+struct InputCacheStats {
+	/**
+	 * The number of songs which were played from the cache.
+	 */
+	uint64_t hits;
+
+	/**
+	 * The number of songs which had to be loaded when they were
+	 * about to be played.
+	 */
+	uint64_t misses;
+
+	/**
+	 * The number of items which were evicted to make room for
+	 * new ones.
+	 */
+	uint64_t evictions;
+};
 
 /**
  * A class which caches files in RAM.  It is supposed to prefetch
  * files before they are played.
+ *
+ * Optionally, remote files evicted from RAM are moved to an on-disk
+ * tier (#InputCacheDisk).
  */
 class InputCacheManager {
 	const size_t max_total_size;
 
+	const InputCacheConfig::Eviction eviction;
+
+	/**
+	 * The number of upcoming songs to be prefetched.
+	 */
+	const unsigned prefetch_count;
+
+	/**
+	 * The mutex used by all #InputStream and #InputCacheItem
+	 * instances.
+	 */
 	mutable Mutex mutex;
 
+	/**
+	 * Protects #total_size and the item containers.  It may be
+	 * locked before #mutex, but not the other way round.
+	 */
+	mutable Mutex items_mutex;
+
+	/**
+	 * The optional on-disk tier.  It is declared after #mutex,
+	 * because its thread deletes items which use that mutex.
+	 */
+	std::unique_ptr<InputCacheDisk> disk;
+
 	size_t total_size = 0;
 
+	InputCacheStats stats{};
+
+	/**
+	 * The priority of the most recently evicted item; see
+	 * InputCacheItem::Access().
+	 */
+	uint64_t lfu_age = 0;
+
 	struct ItemCompare {
 		gcc_pure
 		bool operator()(const InputCacheItem &a,
@@ -68,28 +129,74 @@ class InputCacheManager {
 
 	UriMap items_by_uri;
 
+	/**
+	 * Declared last, because its thread must be stopped before
+	 * anything else is destroyed.
+	 */
+	InputCachePrefetcher prefetcher;
+
 public:
-	explicit InputCacheManager(const InputCacheConfig &config) noexcept;
+	/**
+	 * Throws on error.
+	 */
+	explicit InputCacheManager(const InputCacheConfig &config);
 	~InputCacheManager() noexcept;
 
 	gcc_pure
 	bool Contains(const char *uri) noexcept;
 
+	size_t GetMaxSize() const noexcept {
+		return max_total_size;
+	}
+
+	/**
+	 * Returns the on-disk tier or nullptr if it is disabled.
+	 */
+	const InputCacheDisk *GetDisk() const noexcept {
+		return disk.get();
+	}
+
+	/**
+	 * Returns the total size of all cached items.
+	 */
+	gcc_pure
+	size_t LockGetSize() const noexcept {
+		const std::lock_guard<Mutex> protect(items_mutex);
+		return total_size;
+	}
+
+	gcc_pure
+	InputCacheStats LockGetStats() const noexcept {
+		const std::lock_guard<Mutex> protect(items_mutex);
+		return stats;
+	}
+
+	unsigned GetPrefetchCount() const noexcept {
+		return prefetch_count;
+	}
+
 	/**
 	 * Throws if opening the #InputStream fails.
 	 *
 	 * @param create if true, then the cache item will be created
 	 * if it did not exist
+	 * @param prefetch true if the song is not going to be played
+	 * right now; this access is then not counted in the
+	 * statistics and by the "lfu" eviction policy
 	 * @return a lease of the new item or nullptr if the file is
 	 * not eligible for caching
 	 */
-	InputCacheLease Get(const char *uri, bool create);
+	InputCacheLease Get(const char *uri, bool create,
+			    bool prefetch=false);
 
 	/**
-	 * Shortcut for "Get(uri,true)", discarding the returned
-	 * lease.
+	 * Load the given songs into the cache in a background
+	 * thread, one after the other.  This replaces the list
+	 * passed to the previous call.
 	 */
-	void Prefetch(const char *uri);
+	void Prefetch(std::vector<std::string> &&uris) noexcept {
+		prefetcher.Schedule(std::move(uris));
+	}
 
 private:
 	/**
@@ -99,15 +206,25 @@ private:
 	bool IsEligible(const InputStream &input) noexcept;
 
 	void Remove(InputCacheItem &item) noexcept;
+
+	/**
+	 * Delete an item which has already been removed from all
+	 * containers, moving it to the #disk tier if possible.
+	 */
+	void Dispose(InputCacheItem *item) noexcept;
+
 	void Delete(InputCacheItem *item) noexcept;
 
 	InputCacheItem *FindOldestUnused() noexcept;
+	InputCacheItem *FindLeastFrequentlyUsedUnused() noexcept;
 
 	/**
+	 * Evict one unused item according to the configured policy.
+	 *
 	 * @return true if one item has been evicted, false if no
 	 * unused item was found
 	 */
-	bool EvictOldestUnused() noexcept;
+	bool EvictOneUnused() noexcept;
 };
 
 #endif
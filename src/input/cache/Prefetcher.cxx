@@ -0,0 +1,155 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Prefetcher.hxx"
+#include "Manager.hxx"
+#include "Lease.hxx"
+#include "thread/Name.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+static constexpr Domain prefetch_domain("prefetch");
+
+InputCachePrefetcher::InputCachePrefetcher(InputCacheManager &_cache) noexcept
+	:cache(_cache),
+	 thread(BIND_THIS_METHOD(RunThread))
+{
+}
+
+InputCachePrefetcher::~InputCachePrefetcher() noexcept
+{
+	Stop();
+}
+
+void
+InputCachePrefetcher::Stop() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		stop = true;
+		cond.notify_one();
+	}
+
+	thread.Join();
+}
+
+void
+InputCachePrefetcher::Schedule(std::vector<std::string> &&_uris) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (stop || _uris == uris)
+		/* nothing has changed; don't disturb the thread */
+		return;
+
+	uris = std::move(_uris);
+	++generation;
+	cond.notify_one();
+
+	if (!thread.IsDefined()) {
+		try {
+			thread.Start();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to start the prefetch thread");
+		}
+	}
+}
+
+size_t
+InputCachePrefetcher::Load(const char *uri, unsigned _generation) noexcept
+{
+	size_t size = 0;
+
+	try {
+		/* this call opens the file and (if it was not already
+		   in the cache) starts loading it in the cache item's
+		   own thread */
+		const auto lease = cache.Get(uri, true, true);
+		if (!lease)
+			/* not eligible */
+			return 0;
+
+		auto &item = *lease;
+		size = item.size();
+
+		FormatDebug(prefetch_domain, "Prefetch '%s'", uri);
+
+		/* wait until it is complete before loading the next
+		   one, so it doesn't have to share its bandwidth */
+		while (true) {
+			{
+				const std::lock_guard<Mutex> protect(item.mutex);
+				item.Check();
+				if (!item.GetCompleteBuffer().IsNull())
+					break;
+			}
+
+			std::unique_lock<Mutex> lock(mutex);
+			if (stop || generation != _generation)
+				/* canceled */
+				break;
+
+			cond.wait_for(lock, std::chrono::milliseconds(250));
+		}
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Prefetch '%s' failed", uri);
+	}
+
+	return size;
+}
+
+void
+InputCachePrefetcher::RunThread() noexcept
+{
+	SetThreadName("prefetch");
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (!stop) {
+		const unsigned g = generation;
+		const auto list = uris;
+
+		size_t total_size = 0;
+
+		for (const auto &uri : list) {
+			if (stop || generation != g)
+				break;
+
+			{
+				const ScopeUnlock unlock(mutex);
+				total_size += Load(uri.c_str(), g);
+			}
+
+			if (total_size >= cache.GetMaxSize() / 2)
+				/* loading more would evict the songs
+				   which were just loaded */
+				break;
+		}
+
+		cond.wait(lock, [this, g]{
+				return stop || generation != g;
+			});
+	}
+}
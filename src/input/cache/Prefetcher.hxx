@@ -0,0 +1,91 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_INPUT_CACHE_PREFETCHER_HXX
+#define MPD_INPUT_CACHE_PREFETCHER_HXX
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <string>
+#include <vector>
+
+class InputCacheManager;
+
+/**
+ * Loads a list of upcoming songs into the #InputCacheManager in a
+ * background thread.  The songs are loaded one at a time, in the
+ * order they will be played, so the next song gets the whole
+ * bandwidth of a slow source.
+ */
+class InputCachePrefetcher {
+	InputCacheManager &cache;
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * The URIs which shall be loaded, in this order.
+	 */
+	std::vector<std::string> uris;
+
+	/**
+	 * Incremented by Schedule() to let the #thread restart with
+	 * the new list.
+	 */
+	unsigned generation = 0;
+
+	bool stop = false;
+
+	Thread thread;
+
+public:
+	explicit InputCachePrefetcher(InputCacheManager &_cache) noexcept;
+	~InputCachePrefetcher() noexcept;
+
+	InputCachePrefetcher(const InputCachePrefetcher &) = delete;
+	InputCachePrefetcher &operator=(const InputCachePrefetcher &) = delete;
+
+	/**
+	 * Replace the list of songs to be loaded.  Songs which are
+	 * already in the cache are skipped.
+	 */
+	void Schedule(std::vector<std::string> &&_uris) noexcept;
+
+	/**
+	 * Stop the thread.  This must be called before the
+	 * #InputCacheManager gets destroyed.
+	 */
+	void Stop() noexcept;
+
+private:
+	/**
+	 * Load one song and wait until it is complete.  Caller must
+	 * not lock the mutex.
+	 *
+	 * @return the size of the song in the cache
+	 */
+	size_t Load(const char *uri, unsigned _generation) noexcept;
+
+	void RunThread() noexcept;
+};
+
+#endif
@@ -25,15 +25,20 @@
 #include "lib/curl/Handler.hxx"
 #include "lib/curl/Slist.hxx"
 #include "../MaybeBufferedInputStream.hxx"
+#include "../BufferedInputStream.hxx"
+#include "../CondHandler.hxx"
 #include "../AsyncInputStream.hxx"
 #include "../IcyInputStream.hxx"
 #include "IcyMetaDataParser.hxx"
 #include "../InputPlugin.hxx"
 #include "config/Block.hxx"
+#include "config/Parser.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Tag.hxx"
 #include "event/Call.hxx"
+#include "event/DeferEvent.hxx"
 #include "event/Loop.hxx"
+#include "util/SparseBuffer.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringFormat.hxx"
 #include "util/NumberParser.hxx"
@@ -42,6 +47,8 @@
 #include "PluginUnavailable.hxx"
 
 #include <cinttypes>
+#include <list>
+#include <vector>
 
 #include <assert.h>
 #include <string.h>
@@ -49,16 +56,24 @@
 #include <curl/curl.h>
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * The default value for "buffer_size".  It should be a reasonable
+ * limit that doesn't make low-end machines suffer too much, but
+ * doesn't cause stuttering on high-latency lines.
  */
-static const size_t CURL_MAX_BUFFERED = 512 * 1024;
+static constexpr size_t CURL_DEFAULT_BUFFER_SIZE = 512 * 1024;
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * With "parallel_requests", remote files are downloaded in chunks of
+ * this size, each with its own "Range" request.
+ */
+static constexpr size_t PARALLEL_CHUNK_SIZE = 1024 * 1024;
+
+/**
+ * Files larger than this are not eligible for "parallel_requests",
+ * because the whole file is kept in memory.
  */
-static const size_t CURL_RESUME_AT = 384 * 1024;
+static constexpr InputStream::offset_type PARALLEL_MAX_SIZE =
+	512 * 1024 * 1024;
 
 class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/* some buffers which were passed to libcurl, which we have
@@ -142,6 +157,22 @@ static unsigned proxy_port;
 
 static bool verify_peer, verify_host;
 
+/**
+ * The maximum number of concurrent "Range" requests per file; 0
+ * disables this feature.
+ */
+static unsigned parallel_requests;
+
+/**
+ * Do not buffer more than this number of bytes.
+ */
+static size_t curl_max_buffered;
+
+/**
+ * Resume the stream at this number of bytes after it has been paused.
+ */
+static size_t curl_resume_at;
+
 static CurlInit *curl_init;
 
 static constexpr Domain curl_domain("curl");
@@ -319,6 +350,24 @@ input_curl_init(EventLoop &event_loop, const ConfigBlock &block)
 
 	verify_peer = block.GetBlockValue("verify_peer", true);
 	verify_host = block.GetBlockValue("verify_host", true);
+
+	parallel_requests = block.GetBlockValue("parallel_requests", 0u);
+	if (parallel_requests == 1)
+		/* a single request is what CurlInputStream does
+		   anyway */
+		parallel_requests = 0;
+
+	curl_max_buffered = CURL_DEFAULT_BUFFER_SIZE;
+	const auto *buffer_size = block.GetBlockParam("buffer_size");
+	if (buffer_size != nullptr)
+		curl_max_buffered = buffer_size->With([](const char *s){
+			const size_t value = ParseSize(s);
+			if (value < 64 * 1024)
+				throw std::runtime_error("buffer_size is too small");
+			return value;
+		});
+
+	curl_resume_at = curl_max_buffered / 4 * 3;
 }
 
 static void
@@ -337,8 +386,8 @@ CurlInputStream::CurlInputStream(EventLoop &event_loop, const char *_url,
 				 I &&_icy,
 				 Mutex &_mutex)
 	:AsyncInputStream(event_loop, _url, _mutex,
-			  CURL_MAX_BUFFERED,
-			  CURL_RESUME_AT),
+			  curl_max_buffered,
+			  curl_resume_at),
 	 icy(std::forward<I>(_icy))
 {
 	request_headers.Append("Icy-Metadata: 1");
@@ -352,29 +401,38 @@ CurlInputStream::~CurlInputStream() noexcept
 	FreeEasyIndirect();
 }
 
-void
-CurlInputStream::InitEasy()
+/**
+ * Apply the plugin configuration to a new #CurlRequest.
+ */
+static void
+SetupRequest(CurlRequest &request)
 {
-	request = new CurlRequest(**curl_init, GetURI(), *this);
-
-	request->SetOption(CURLOPT_HTTP200ALIASES, http_200_aliases);
-	request->SetOption(CURLOPT_FOLLOWLOCATION, 1l);
-	request->SetOption(CURLOPT_MAXREDIRS, 5l);
-	request->SetOption(CURLOPT_FAILONERROR, 1l);
+	request.SetOption(CURLOPT_HTTP200ALIASES, http_200_aliases);
+	request.SetOption(CURLOPT_FOLLOWLOCATION, 1l);
+	request.SetOption(CURLOPT_MAXREDIRS, 5l);
+	request.SetOption(CURLOPT_FAILONERROR, 1l);
 
 	if (proxy != nullptr)
-		request->SetOption(CURLOPT_PROXY, proxy);
+		request.SetOption(CURLOPT_PROXY, proxy);
 
 	if (proxy_port > 0)
-		request->SetOption(CURLOPT_PROXYPORT, (long)proxy_port);
+		request.SetOption(CURLOPT_PROXYPORT, (long)proxy_port);
 
 	if (proxy_user != nullptr && proxy_password != nullptr)
-		request->SetOption(CURLOPT_PROXYUSERPWD,
-				   StringFormat<1024>("%s:%s", proxy_user,
-						      proxy_password).c_str());
+		request.SetOption(CURLOPT_PROXYUSERPWD,
+				  StringFormat<1024>("%s:%s", proxy_user,
+						     proxy_password).c_str());
+
+	request.SetOption(CURLOPT_SSL_VERIFYPEER, verify_peer ? 1l : 0l);
+	request.SetOption(CURLOPT_SSL_VERIFYHOST, verify_host ? 2l : 0l);
+}
 
-	request->SetOption(CURLOPT_SSL_VERIFYPEER, verify_peer ? 1l : 0l);
-	request->SetOption(CURLOPT_SSL_VERIFYHOST, verify_host ? 2l : 0l);
+void
+CurlInputStream::InitEasy()
+{
+	request = new CurlRequest(**curl_init, GetURI(), *this);
+
+	SetupRequest(*request);
 	request->SetOption(CURLOPT_HTTPHEADER, request_headers.Get());
 }
 
@@ -425,6 +483,461 @@ CurlInputStream::DoSeek(offset_type new_offset)
 		});
 }
 
+/**
+ * An #InputStream which downloads a remote file with several
+ * concurrent "Range" requests into a #SparseBuffer.  This makes
+ * throughput on high-latency links bound by bandwidth instead of the
+ * round-trip time of a single TCP connection.
+ *
+ * It replaces a #CurlInputStream as soon as that one has revealed
+ * the size of the file and that it is seekable.  Only the chunks
+ * near the current offset are downloaded; seeking cancels requests
+ * for chunks which are no longer needed.
+ */
+class CurlParallelInputStream final : public InputStream {
+	class Range final : public CurlResponseHandler {
+		CurlParallelInputStream &parent;
+
+		CurlRequest request;
+
+	public:
+		/**
+		 * The index of the chunk being downloaded.
+		 */
+		const size_t chunk;
+
+	private:
+		/**
+		 * The offset of the next byte to be received.
+		 */
+		size_t position;
+
+		/**
+		 * The end offset of this request (exclusive).
+		 */
+		const size_t end;
+
+		bool done = false;
+
+	public:
+		Range(CurlParallelInputStream &_parent, size_t _chunk,
+		      size_t _start, size_t _end);
+
+		void Start() {
+			request.Start();
+		}
+
+		bool IsDone() const noexcept {
+			return done;
+		}
+
+	private:
+		/* virtual methods from CurlResponseHandler */
+		void OnHeaders(unsigned status,
+			       std::multimap<std::string, std::string> &&headers) override;
+		void OnData(ConstBuffer<void> data) override;
+		void OnEnd() override;
+		void OnError(std::exception_ptr e) noexcept override;
+	};
+
+	EventLoop &event_loop;
+
+	CurlSlist request_headers;
+
+	DeferEvent defer_schedule;
+
+	SparseBuffer<uint8_t> buffer;
+
+	/**
+	 * Which chunks are being downloaded by an item in #ranges?
+	 */
+	std::vector<bool> loading;
+
+	/**
+	 * The #InputStream which was replaced by this object.  It is
+	 * destroyed in the I/O thread, because destroying a
+	 * #CurlInputStream while holding the mutex would deadlock.
+	 */
+	InputStreamPtr initial;
+
+	/**
+	 * The running requests.  Only accessed in the I/O thread.
+	 */
+	std::list<Range> ranges;
+
+	std::exception_ptr error;
+
+public:
+	/**
+	 * Throws on error.  If an exception is thrown, the given
+	 * #InputStream is left untouched.
+	 *
+	 * @param _initial a ready #InputStream for which IsEligible()
+	 * returns true
+	 */
+	CurlParallelInputStream(InputStreamPtr &&_initial,
+				const std::multimap<std::string, std::string> &headers);
+
+	~CurlParallelInputStream() noexcept;
+
+	static bool IsEligible(const InputStream &input) noexcept {
+		assert(input.IsReady());
+
+		return input.IsSeekable() && input.KnownSize() &&
+			input.GetSize() > (offset_type)PARALLEL_CHUNK_SIZE &&
+			input.GetSize() <= PARALLEL_MAX_SIZE;
+	}
+
+	/* virtual methods from class InputStream */
+	void Check() override;
+	void Seek(std::unique_lock<Mutex> &lock,
+		  offset_type new_offset) override;
+	bool IsEOF() const noexcept override;
+	bool IsAvailable() const noexcept override;
+	size_t Read(std::unique_lock<Mutex> &lock,
+		    void *ptr, size_t size) override;
+
+private:
+	size_t GetChunkCount() const noexcept {
+		return loading.size();
+	}
+
+	/**
+	 * Determine the range of a chunk which still needs to be
+	 * downloaded.  Returns an empty range if the chunk is
+	 * complete.
+	 */
+	std::pair<size_t, size_t> GetMissingRange(size_t chunk) const noexcept;
+
+	/**
+	 * Copy received data into the buffer.  Returns the new
+	 * position.  Caller must lock the mutex.
+	 */
+	size_t CommitRange(size_t position, size_t end,
+			   ConstBuffer<void> data) noexcept;
+
+	void OnRangeDone(std::exception_ptr e) noexcept;
+
+	/* callback for #defer_schedule */
+	void OnDeferredSchedule() noexcept;
+};
+
+CurlParallelInputStream::Range::Range(CurlParallelInputStream &_parent,
+				      size_t _chunk,
+				      size_t _start, size_t _end)
+	:parent(_parent),
+	 request(**curl_init, parent.GetURI(), *this),
+	 chunk(_chunk), position(_start), end(_end)
+{
+	assert(position < end);
+
+	SetupRequest(request);
+	request.SetOption(CURLOPT_HTTPHEADER, parent.request_headers.Get());
+	request.SetOption(CURLOPT_RANGE,
+			  StringFormat<64>("%" PRIoffset "-%" PRIoffset,
+					   (offset_type)position,
+					   (offset_type)(end - 1)).c_str());
+}
+
+void
+CurlParallelInputStream::Range::OnHeaders(unsigned status,
+					  std::multimap<std::string, std::string> &&)
+{
+	if (status < 200 || status >= 300)
+		throw HttpStatusError(status,
+				      StringFormat<40>("got HTTP status %u",
+						       status).c_str());
+
+	if (status != 206)
+		throw std::runtime_error("Server ignored the Range request");
+}
+
+void
+CurlParallelInputStream::Range::OnData(ConstBuffer<void> data)
+{
+	const std::lock_guard<Mutex> protect(parent.mutex);
+	position = parent.CommitRange(position, end, data);
+}
+
+void
+CurlParallelInputStream::Range::OnEnd()
+{
+	done = true;
+
+	if (position < end)
+		throw std::runtime_error("Premature end of HTTP response");
+
+	parent.OnRangeDone(nullptr);
+}
+
+void
+CurlParallelInputStream::Range::OnError(std::exception_ptr e) noexcept
+{
+	done = true;
+	parent.OnRangeDone(std::move(e));
+}
+
+CurlParallelInputStream::CurlParallelInputStream(InputStreamPtr &&_initial,
+						 const std::multimap<std::string, std::string> &headers)
+	:InputStream(_initial->GetURI(), _initial->mutex),
+	 event_loop((*curl_init)->GetEventLoop()),
+	 defer_schedule(event_loop, BIND_THIS_METHOD(OnDeferredSchedule)),
+	 buffer(_initial->GetSize()),
+	 loading((buffer.size() + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE),
+	 initial(std::move(_initial))
+{
+	for (const auto &i : headers)
+		request_headers.Append((i.first + ":" + i.second).c_str());
+
+	/* from now on, we are responsible for waking up the client */
+	initial->SetHandler(nullptr);
+
+	if (initial->HasMimeType())
+		SetMimeType(initial->GetMimeType());
+
+	size = buffer.size();
+	seekable = true;
+	offset = initial->GetOffset();
+
+	SetReady();
+
+	defer_schedule.Schedule();
+}
+
+CurlParallelInputStream::~CurlParallelInputStream() noexcept
+{
+	BlockingCall(event_loop, [this](){
+			defer_schedule.Cancel();
+			ranges.clear();
+			initial.reset();
+			(*curl_init)->InvalidateSockets();
+		});
+}
+
+std::pair<size_t, size_t>
+CurlParallelInputStream::GetMissingRange(size_t chunk) const noexcept
+{
+	size_t start = chunk * PARALLEL_CHUNK_SIZE;
+	const size_t end = std::min(start + PARALLEL_CHUNK_SIZE,
+				    buffer.size());
+
+	/* skip data which is already there, e.g. from a request
+	   which was canceled by seeking */
+	auto r = buffer.Read(start);
+	if (r.undefined_size == 0)
+		start = std::min(start + r.defined_buffer.size, end);
+
+	return {start, end};
+}
+
+size_t
+CurlParallelInputStream::CommitRange(size_t position, size_t end,
+				     ConstBuffer<void> _data) noexcept
+{
+	auto data = ConstBuffer<uint8_t>::FromVoid(_data);
+	if (data.size > end - position)
+		data.size = end - position;
+
+	while (!data.empty()) {
+		auto w = buffer.Write(position);
+		if (w.empty()) {
+			/* this portion is already defined; skip it */
+			auto r = buffer.Read(position);
+			assert(r.undefined_size == 0);
+			const size_t nbytes = std::min(data.size,
+						       r.defined_buffer.size);
+			data.skip_front(nbytes);
+			position += nbytes;
+			continue;
+		}
+
+		const size_t nbytes = std::min(data.size, w.size);
+		memcpy(w.data, data.data, nbytes);
+		buffer.Commit(position, position + nbytes);
+		data.skip_front(nbytes);
+		position += nbytes;
+	}
+
+	InvokeOnAvailable();
+	return position;
+}
+
+void
+CurlParallelInputStream::OnRangeDone(std::exception_ptr e) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (e && !error)
+		error = std::move(e);
+
+	/* the #Range will be freed and replaced by
+	   OnDeferredSchedule() */
+	defer_schedule.Schedule();
+
+	InvokeOnAvailable();
+}
+
+void
+CurlParallelInputStream::OnDeferredSchedule() noexcept
+{
+	/* this is the first opportunity to get rid of the
+	   CurlInputStream */
+	initial.reset();
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	/* download the chunks near the current offset; this window
+	   is large enough to keep all requests busy while the
+	   client consumes data */
+	const size_t first = size_t(offset) / PARALLEL_CHUNK_SIZE;
+	const size_t last = std::min<size_t>(first + 2 * parallel_requests,
+					     GetChunkCount());
+
+	for (auto i = ranges.begin(); i != ranges.end();) {
+		if (i->IsDone() || i->chunk < first || i->chunk >= last) {
+			/* finished or no longer needed after
+			   seeking; data which was already received
+			   remains in the buffer */
+			loading[i->chunk] = false;
+			i = ranges.erase(i);
+		} else
+			++i;
+	}
+
+	if (error)
+		return;
+
+	for (size_t chunk = first;
+	     chunk < last && ranges.size() < parallel_requests;
+	     ++chunk) {
+		if (loading[chunk])
+			continue;
+
+		const auto r = GetMissingRange(chunk);
+		if (r.first >= r.second)
+			/* complete */
+			continue;
+
+		try {
+			ranges.emplace_back(*this, chunk, r.first, r.second);
+			ranges.back().Start();
+			loading[chunk] = true;
+		} catch (...) {
+			ranges.pop_back();
+			error = std::current_exception();
+			InvokeOnAvailable();
+			break;
+		}
+	}
+}
+
+void
+CurlParallelInputStream::Check()
+{
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void
+CurlParallelInputStream::Seek(std::unique_lock<Mutex> &,
+			      offset_type new_offset)
+{
+	offset = new_offset;
+	defer_schedule.Schedule();
+}
+
+bool
+CurlParallelInputStream::IsEOF() const noexcept
+{
+	return offset == size;
+}
+
+bool
+CurlParallelInputStream::IsAvailable() const noexcept
+{
+	return error || IsEOF() || buffer.Read(offset).HasData();
+}
+
+size_t
+CurlParallelInputStream::Read(std::unique_lock<Mutex> &lock,
+			      void *ptr, size_t read_size)
+{
+	assert(!event_loop.IsInside());
+
+	CondInputStreamHandler cond_handler;
+
+	while (true) {
+		Check();
+
+		if (IsEOF())
+			return 0;
+
+		auto r = buffer.Read(offset);
+		if (r.HasData()) {
+			const size_t nbytes = std::min(read_size,
+						       r.defined_buffer.size);
+			memcpy(ptr, r.defined_buffer.data, nbytes);
+
+			const size_t old_chunk = size_t(offset) / PARALLEL_CHUNK_SIZE;
+			offset += nbytes;
+
+			if (size_t(offset) / PARALLEL_CHUNK_SIZE != old_chunk)
+				/* move the download window */
+				defer_schedule.Schedule();
+
+			return nbytes;
+		}
+
+		const ScopeExchangeInputStreamHandler h(*this, &cond_handler);
+		cond_handler.cond.wait(lock);
+	}
+}
+
+/**
+ * A proxy which replaces a #CurlInputStream with a
+ * #CurlParallelInputStream (or a #BufferedInputStream) once it
+ * becomes ready and eligible.  This is the "parallel_requests"
+ * replacement for #MaybeBufferedInputStream.
+ */
+class MaybeParallelInputStream final : public ProxyInputStream {
+	const std::multimap<std::string, std::string> headers;
+
+public:
+	MaybeParallelInputStream(InputStreamPtr _input,
+				 const std::multimap<std::string, std::string> &_headers)
+		:ProxyInputStream(std::move(_input)), headers(_headers) {}
+
+	/* virtual methods from class InputStream */
+	void Update() noexcept override;
+};
+
+void
+MaybeParallelInputStream::Update() noexcept
+{
+	const bool was_ready = IsReady();
+
+	ProxyInputStream::Update();
+
+	if (was_ready || !IsReady())
+		return;
+
+	if (CurlParallelInputStream::IsEligible(*input)) {
+		try {
+			auto p = std::make_unique<CurlParallelInputStream>(std::move(input),
+									   headers);
+			SetInput(std::move(p));
+			return;
+		} catch (...) {
+			/* "input" is still valid; fall back to
+			   BufferedInputStream */
+			LogError(std::current_exception());
+		}
+	}
+
+	if (BufferedInputStream::IsEligible(*input))
+		SetInput(std::make_unique<BufferedInputStream>(std::move(input)));
+}
+
 inline InputStreamPtr
 CurlInputStream::Open(const char *url,
 		      const std::multimap<std::string, std::string> &headers,
@@ -442,7 +955,13 @@ CurlInputStream::Open(const char *url,
 			c->StartRequest();
 		});
 
-	return std::make_unique<MaybeBufferedInputStream>(std::make_unique<IcyInputStream>(std::move(c), std::move(icy)));
+	auto is = std::make_unique<IcyInputStream>(std::move(c), std::move(icy));
+
+	if (parallel_requests > 0)
+		return std::make_unique<MaybeParallelInputStream>(std::move(is),
+								  headers);
+
+	return std::make_unique<MaybeBufferedInputStream>(std::move(is));
 }
 
 InputStreamPtr
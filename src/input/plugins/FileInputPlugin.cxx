@@ -25,9 +25,18 @@
 #include "system/FileDescriptor.hxx"
 #include "util/RuntimeError.hxx"
 
+#include <algorithm>
+#include <stdexcept>
+
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
 class FileInputStream final : public InputStream {
 	FileReader reader;
 
@@ -53,6 +62,172 @@ public:
 		  offset_type offset) override;
 };
 
+#ifndef _WIN32
+
+/**
+ * A #FileInputStream variant which maps the whole file into memory.
+ * This saves one copy and the read() system calls, and allows
+ * callers to use PeekDirect() instead of copying the data at all.
+ * The kernel is advised to read ahead the window following the
+ * current offset, and the pages behind it are released from the
+ * mapping.
+ */
+class MmapFileInputStream final : public InputStream {
+	/**
+	 * The size of the window which gets validated and advised
+	 * at a time.  This is a multiple of all common page sizes,
+	 * as required by madvise().
+	 */
+	static constexpr offset_type WINDOW = 1024 * 1024;
+
+	/**
+	 * Kept open only to detect truncation with fstat().
+	 */
+	FileReader reader;
+
+	const uint8_t *const data;
+
+	/**
+	 * The range which has been validated by AdvanceWindow(); only
+	 * data inside it may be returned by PeekDirect().
+	 */
+	offset_type window_begin = 0, window_end = 0;
+
+public:
+	MmapFileInputStream(const char *path, FileReader &&_reader,
+			    const void *_data, off_t _size,
+			    Mutex &_mutex)
+		:InputStream(path, _mutex),
+		 reader(std::move(_reader)),
+		 data((const uint8_t *)_data) {
+		size = _size;
+		seekable = true;
+		SetReady();
+	}
+
+	~MmapFileInputStream() noexcept override {
+		munmap(const_cast<uint8_t *>(data), size);
+	}
+
+	/* virtual methods from InputStream */
+
+	bool IsEOF() const noexcept override {
+		return GetOffset() >= GetSize();
+	}
+
+	size_t Read(std::unique_lock<Mutex> &lock,
+		    void *ptr, size_t size) override;
+	ConstBuffer<void> PeekDirect(std::unique_lock<Mutex> &lock) override;
+	void ConsumeDirect(size_t nbytes) noexcept override;
+
+	void Seek(std::unique_lock<Mutex> &,
+		  offset_type new_offset) override {
+		offset = new_offset;
+	}
+
+private:
+	/**
+	 * Move the window to the current offset.
+	 *
+	 * Throws std::runtime_error if the file has been truncated
+	 * meanwhile; accessing the missing pages would raise SIGBUS.
+	 */
+	void AdvanceWindow();
+};
+
+void
+MmapFileInputStream::AdvanceWindow()
+{
+	const auto old_begin = window_begin;
+	const auto new_begin = offset - offset % WINDOW;
+	const auto new_end = std::min(new_begin + WINDOW, size);
+
+	{
+		const ScopeUnlock unlock(mutex);
+
+		if (reader.GetFileInfo().GetSize() < size)
+			throw std::runtime_error("File was truncated");
+
+		/* read ahead this window and the next one */
+		madvise(const_cast<uint8_t *>(data + new_begin),
+			std::min(new_end + WINDOW, size) - new_begin,
+			MADV_WILLNEED);
+
+		/* the previous window has been consumed */
+		if (old_begin + WINDOW == new_begin)
+			madvise(const_cast<uint8_t *>(data + old_begin),
+				WINDOW, MADV_DONTNEED);
+	}
+
+	window_begin = new_begin;
+	window_end = new_end;
+}
+
+ConstBuffer<void>
+MmapFileInputStream::PeekDirect(std::unique_lock<Mutex> &)
+{
+	if (offset >= size)
+		return nullptr;
+
+	if (offset < window_begin || offset >= window_end)
+		AdvanceWindow();
+
+	return {data + offset, size_t(window_end - offset)};
+}
+
+void
+MmapFileInputStream::ConsumeDirect(size_t nbytes) noexcept
+{
+	assert(offset + nbytes <= window_end);
+
+	offset += nbytes;
+}
+
+size_t
+MmapFileInputStream::Read(std::unique_lock<Mutex> &lock,
+			  void *ptr, size_t read_size)
+{
+	const auto src = PeekDirect(lock);
+	const size_t nbytes = std::min(src.size, read_size);
+
+	{
+		/* copying may block on page faults */
+		const ScopeUnlock unlock(mutex);
+		memcpy(ptr, src.data, nbytes);
+	}
+
+	ConsumeDirect(nbytes);
+	return nbytes;
+}
+
+/**
+ * Attempt to map the file into memory.
+ *
+ * @return the new stream or nullptr if the file cannot be mapped
+ */
+static InputStreamPtr
+OpenMmapFileInputStream(Path path, FileReader &reader, off_t size,
+			Mutex &mutex)
+{
+	if (size <= 0 || uint64_t(size) > SIZE_MAX)
+		return nullptr;
+
+	const auto uri = path.ToUTF8Throw();
+
+	void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+		       reader.GetFD().Get(), 0);
+	if (p == MAP_FAILED)
+		return nullptr;
+
+	madvise(p, size, MADV_SEQUENTIAL);
+
+	return std::make_unique<MmapFileInputStream>(uri.c_str(),
+						     std::move(reader),
+						     p, size, mutex);
+}
+
+#endif
+
 InputStreamPtr
 OpenFileInputStream(Path path, Mutex &mutex)
 {
@@ -69,6 +244,13 @@ OpenFileInputStream(Path path, Mutex &mutex)
 		      POSIX_FADV_SEQUENTIAL);
 #endif
 
+#ifndef _WIN32
+	auto is = OpenMmapFileInputStream(path, reader, info.GetSize(),
+					  mutex);
+	if (is)
+		return is;
+#endif
+
 	return std::make_unique<FileInputStream>(path.ToUTF8Throw().c_str(),
 						 std::move(reader), info.GetSize(),
 						 mutex);
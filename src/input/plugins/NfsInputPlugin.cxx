@@ -22,30 +22,68 @@
 #include "../InputPlugin.hxx"
 #include "lib/nfs/Glue.hxx"
 #include "lib/nfs/FileReader.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <algorithm>
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * The initial buffer size.  It should be a reasonable limit that
+ * doesn't make low-end machines suffer too much, but doesn't cause
+ * stuttering on high-latency lines.  It grows up to
+ * #nfs_max_buffered whenever the buffer runs empty.
  */
-static const size_t NFS_MAX_BUFFERED = 512 * 1024;
+static constexpr size_t NFS_MIN_BUFFERED = 512 * 1024;
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * The size of each READ call.
  */
-static const size_t NFS_RESUME_AT = 384 * 1024;
+static constexpr size_t NFS_READ_SIZE = 64 * 1024;
+
+/**
+ * The maximum number of concurrent READ calls per stream.
+ */
+static unsigned nfs_parallel_reads;
+
+/**
+ * Do not buffer more than this number of bytes.
+ */
+static size_t nfs_max_buffered;
 
 class NfsInputStream final : NfsFileReader, public AsyncInputStream {
+	/**
+	 * The offset of the next byte which will be appended to the
+	 * buffer.
+	 */
 	uint64_t next_offset;
 
+	/**
+	 * The offset of the next Read() call.  The difference to
+	 * #next_offset is the amount of data being read right now.
+	 */
+	uint64_t read_offset;
+
+	/**
+	 * The current buffer size, see #NFS_MIN_BUFFERED.
+	 */
+	size_t buffer_target = NFS_MIN_BUFFERED;
+
+	/**
+	 * Is the buffer being filled right after opening or seeking?
+	 * The buffer being empty during that phase is expected and
+	 * does not grow #buffer_target.
+	 */
+	bool refilling = true;
+
 	bool reconnect_on_resume = false, reconnecting = false;
 
 public:
 	NfsInputStream(const char *_uri, Mutex &_mutex)
 		:AsyncInputStream(NfsFileReader::GetEventLoop(),
 				  _uri, _mutex,
-				  NFS_MAX_BUFFERED,
-				  NFS_RESUME_AT) {}
+				  nfs_max_buffered,
+				  GetResumeAt(NFS_MIN_BUFFERED)) {}
 
 	virtual ~NfsInputStream() {
 		DeferClose();
@@ -58,6 +96,21 @@ public:
 	}
 
 private:
+	static constexpr size_t GetResumeAt(size_t target) noexcept {
+		return target / 4 * 3;
+	}
+
+	/**
+	 * How much more data may be requested right now?
+	 */
+	gcc_pure
+	size_t GetReadSpace() const noexcept;
+
+	/**
+	 * The buffer has run empty; double its size.
+	 */
+	void GrowBuffer() noexcept;
+
 	void DoRead();
 
 protected:
@@ -72,30 +125,63 @@ private:
 	void OnNfsFileError(std::exception_ptr &&e) noexcept override;
 };
 
-void
-NfsInputStream::DoRead()
+size_t
+NfsInputStream::GetReadSpace() const noexcept
 {
-	assert(NfsFileReader::IsIdle());
+	const size_t pending = read_offset - next_offset;
+	const size_t used = GetBufferedSize() + pending;
+	return used < buffer_target
+		? buffer_target - used
+		: 0;
+}
 
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
+void
+NfsInputStream::GrowBuffer() noexcept
+{
+	if (buffer_target >= nfs_max_buffered)
 		return;
 
-	const size_t buffer_space = GetBufferSpace();
-	if (buffer_space == 0) {
-		Pause();
-		return;
-	}
-
-	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, 32768),
-					 buffer_space);
+	buffer_target = std::min(buffer_target * 2, nfs_max_buffered);
+	SetResumeAt(GetResumeAt(buffer_target));
+}
 
-	try {
-		const ScopeUnlock unlock(mutex);
-		NfsFileReader::Read(next_offset, nbytes);
-	} catch (...) {
-		postponed_exception = std::current_exception();
-		InvokeOnAvailable();
+void
+NfsInputStream::DoRead()
+{
+	if (NfsFileReader::IsIdle())
+		/* a short read may have cancelled the remaining
+		   reads */
+		read_offset = next_offset;
+
+	while (NfsFileReader::CanRead() &&
+	       NfsFileReader::GetPendingReads() < nfs_parallel_reads) {
+		int64_t remaining = size - read_offset;
+		if (remaining <= 0)
+			return;
+
+		const size_t read_space = GetReadSpace();
+		size_t nbytes = std::min<uint64_t>(remaining, NFS_READ_SIZE);
+		if (read_space < nbytes) {
+			if (NfsFileReader::IsIdle()) {
+				refilling = false;
+				Pause();
+			}
+
+			/* else: wait for the pending reads to
+			   finish */
+			return;
+		}
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			NfsFileReader::Read(read_offset, nbytes);
+		} catch (...) {
+			postponed_exception = std::current_exception();
+			InvokeOnAvailable();
+			return;
+		}
+
+		read_offset += nbytes;
 	}
 }
 
@@ -130,7 +216,8 @@ NfsInputStream::DoSeek(offset_type new_offset)
 		NfsFileReader::CancelRead();
 	}
 
-	next_offset = offset = new_offset;
+	read_offset = next_offset = offset = new_offset;
+	refilling = true;
 	SeekDone();
 	DoRead();
 }
@@ -144,13 +231,14 @@ NfsInputStream::OnNfsFileOpen(uint64_t _size) noexcept
 		/* reconnect has succeeded */
 
 		reconnecting = false;
+		read_offset = next_offset;
 		DoRead();
 		return;
 	}
 
 	size = _size;
 	seekable = true;
-	next_offset = 0;
+	read_offset = next_offset = 0;
 	SetReady();
 	DoRead();
 }
@@ -159,8 +247,13 @@ void
 NfsInputStream::OnNfsFileRead(const void *data, size_t data_size) noexcept
 {
 	const std::lock_guard<Mutex> protect(mutex);
-	assert(!IsBufferFull());
-	assert(IsBufferFull() == (GetBufferSpace() == 0));
+	assert(data_size <= GetBufferSpace());
+
+	if (IsBufferEmpty() && !refilling)
+		/* the client has consumed everything while we were
+		   waiting for the server */
+		GrowBuffer();
+
 	AppendToBuffer(data, data_size);
 
 	next_offset += data_size;
@@ -200,8 +293,23 @@ NfsInputStream::OnNfsFileError(std::exception_ptr &&e) noexcept
  */
 
 static void
-input_nfs_init(EventLoop &event_loop, const ConfigBlock &)
+input_nfs_init(EventLoop &event_loop, const ConfigBlock &block)
 {
+	nfs_parallel_reads = block.GetPositiveValue("parallel_reads", 4u);
+	if (nfs_parallel_reads > NfsFileReader::MAX_READS)
+		throw FormatRuntimeError("\"parallel_reads\" is too large (maximum %u)",
+					 NfsFileReader::MAX_READS);
+
+	nfs_max_buffered = 4 * 1024 * 1024;
+	const auto *buffer_size = block.GetBlockParam("buffer_size");
+	if (buffer_size != nullptr)
+		nfs_max_buffered = buffer_size->With([](const char *s){
+			return ParseSize(s);
+		});
+
+	if (nfs_max_buffered < NFS_MIN_BUFFERED)
+		nfs_max_buffered = NFS_MIN_BUFFERED;
+
 	nfs_init(event_loop);
 }
 
@@ -21,6 +21,7 @@
 #include "QobuzClient.hxx"
 #include "QobuzTrackRequest.hxx"
 #include "QobuzTagScanner.hxx"
+#include "TrackUrlCache.hxx"
 #include "CurlInputPlugin.hxx"
 #include "PluginUnavailable.hxx"
 #include "input/ProxyInputStream.hxx"
@@ -34,9 +35,64 @@
 #include <memory>
 
 static QobuzClient *qobuz_client;
+static TrackUrlCache *qobuz_url_cache;
+
+/**
+ * Resolves the streaming URL of a track which is going to be played
+ * soon, and submits it to #qobuz_url_cache.
+ */
+class QobuzPrefetchJob final
+	: public TrackUrlJob, QobuzSessionHandler, QobuzTrackHandler {
+
+	const std::string track_id;
+
+	std::unique_ptr<QobuzTrackRequest> track_request;
+
+public:
+	explicit QobuzPrefetchJob(const char *_track_id) noexcept
+		:track_id(_track_id) {}
+
+	~QobuzPrefetchJob() noexcept override {
+		qobuz_client->RemoveLoginHandler(*this);
+	}
+
+	/* virtual methods from TrackUrlJob */
+	void Start() noexcept override {
+		qobuz_client->AddLoginHandler(*this);
+	}
+
+private:
+	/* virtual methods from QobuzSessionHandler */
+	void OnQobuzSession() noexcept override {
+		try {
+			const auto session = qobuz_client->GetSession();
+
+			QobuzTrackHandler &h = *this;
+			track_request = std::make_unique<QobuzTrackRequest>(*qobuz_client,
+									    session,
+									    track_id.c_str(),
+									    h);
+			track_request->Start();
+		} catch (...) {
+			/* this destroys the job */
+			qobuz_url_cache->Fail(track_id,
+					      std::current_exception());
+		}
+	}
+
+	/* virtual methods from QobuzTrackHandler */
+	void OnQobuzTrackSuccess(std::string url) noexcept override {
+		qobuz_url_cache->Finish(track_id, std::move(url));
+	}
+
+	void OnQobuzTrackError(std::exception_ptr e) noexcept override {
+		qobuz_url_cache->Fail(track_id, std::move(e));
+	}
+};
 
 class QobuzInputStream final
-	: public ProxyInputStream, QobuzSessionHandler, QobuzTrackHandler {
+	: public ProxyInputStream, QobuzSessionHandler, QobuzTrackHandler,
+	  TrackUrlHandler {
 
 	const std::string track_id;
 
@@ -50,10 +106,16 @@ public:
 		:ProxyInputStream(_uri, _mutex),
 		 track_id(_track_id)
 	{
-		qobuz_client->AddLoginHandler(*this);
+		std::string url;
+		if (!qobuz_url_cache->Take(track_id, *this, url))
+			/* not prefetched: resolve it now */
+			qobuz_client->AddLoginHandler(*this);
+		else if (!url.empty())
+			OnQobuzTrackSuccess(std::move(url));
 	}
 
 	~QobuzInputStream() {
+		qobuz_url_cache->Cancel(track_id, *this);
 		qobuz_client->RemoveLoginHandler(*this);
 	}
 
@@ -76,6 +138,15 @@ private:
 	/* virtual methods from QobuzTrackHandler */
 	void OnQobuzTrackSuccess(std::string url) noexcept override;
 	void OnQobuzTrackError(std::exception_ptr error) noexcept override;
+
+	/* virtual methods from TrackUrlHandler */
+	void OnTrackUrl(std::string url) noexcept override {
+		OnQobuzTrackSuccess(std::move(url));
+	}
+
+	void OnTrackUrlError(std::exception_ptr e) noexcept override {
+		OnQobuzTrackError(std::move(e));
+	}
 };
 
 void
@@ -155,11 +226,14 @@ InitQobuzInput(EventLoop &event_loop, const ConfigBlock &block)
 				       device_manufacturer_id,
 				       username, email, password,
 				       format_id);
+
+	qobuz_url_cache = new TrackUrlCache();
 }
 
 static void
 FinishQobuzInput()
 {
+	delete qobuz_url_cache;
 	delete qobuz_client;
 }
 
@@ -192,6 +266,20 @@ OpenQobuzInput(const char *uri, Mutex &mutex)
 	return std::make_unique<QobuzInputStream>(uri, track_id, mutex);
 }
 
+static void
+PrefetchQobuz(const char *uri) noexcept
+{
+	assert(qobuz_client != nullptr);
+
+	const char *track_id = ExtractQobuzTrackId(uri);
+	if (track_id == nullptr)
+		return;
+
+	qobuz_url_cache->Prefetch(track_id, [track_id](){
+		return std::make_unique<QobuzPrefetchJob>(track_id);
+	});
+}
+
 static std::unique_ptr<RemoteTagScanner>
 ScanQobuzTags(const char *uri, RemoteTagHandler &handler)
 {
@@ -218,4 +306,5 @@ const InputPlugin qobuz_input_plugin = {
 	OpenQobuzInput,
 	nullptr,
 	ScanQobuzTags,
+	PrefetchQobuz,
 };
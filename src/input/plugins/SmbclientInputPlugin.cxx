@@ -24,20 +24,49 @@
 #include "../InputPlugin.hxx"
 #include "../MaybeBufferedInputStream.hxx"
 #include "PluginUnavailable.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
 #include "system/Error.hxx"
+#include "util/AllocatedArray.hxx"
+
+#include <algorithm>
 
 #include <libsmbclient.h>
+#include <string.h>
+
+/**
+ * Small reads are rounded up to this number of bytes ("read_size"),
+ * because each smbc_read() call costs at least one round trip to the
+ * server.
+ */
+static size_t smbclient_read_size;
 
 class SmbclientInputStream final : public InputStream {
 	SMBCCTX *ctx;
 	int fd;
 
+	/**
+	 * The file offset of the libsmbclient file descriptor.  It
+	 * differs from #offset if data was served from #block or
+	 * after Seek().
+	 */
+	offset_type fd_offset = 0;
+
+	/**
+	 * Data which has been read ahead.  It begins at the file
+	 * offset #block_offset and contains #block_fill bytes.
+	 */
+	AllocatedArray<uint8_t> block;
+	offset_type block_offset = 0;
+	size_t block_fill = 0;
+
 public:
 	SmbclientInputStream(const char *_uri,
 			     Mutex &_mutex,
 			     SMBCCTX *_ctx, int _fd, const struct stat &st)
 		:InputStream(_uri, _mutex),
-		 ctx(_ctx), fd(_fd) {
+		 ctx(_ctx), fd(_fd),
+		 block(smbclient_read_size) {
 		seekable = true;
 		size = st.st_size;
 		SetReady();
@@ -58,6 +87,13 @@ public:
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    void *ptr, size_t size) override;
 	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
+
+private:
+	/**
+	 * Read from the server at the current #offset.  The caller
+	 * must not hold the mutex.
+	 */
+	size_t ReadFromServer(void *ptr, size_t read_size);
 };
 
 /*
@@ -66,8 +102,18 @@ public:
  */
 
 static void
-input_smbclient_init(EventLoop &, const ConfigBlock &)
+input_smbclient_init(EventLoop &, const ConfigBlock &block)
 {
+	smbclient_read_size = 1024 * 1024;
+	const auto *read_size = block.GetBlockParam("read_size");
+	if (read_size != nullptr)
+		smbclient_read_size = read_size->With([](const char *s){
+			const size_t value = ParseSize(s);
+			if (value == 0)
+				throw std::runtime_error("read_size must not be zero");
+			return value;
+		});
+
 	try {
 		SmbclientInit();
 	} catch (...) {
@@ -118,40 +164,65 @@ input_smbclient_open(const char *uri,
 }
 
 size_t
-SmbclientInputStream::Read(std::unique_lock<Mutex> &,
-			   void *ptr, size_t read_size)
+SmbclientInputStream::ReadFromServer(void *ptr, size_t read_size)
 {
-	ssize_t nbytes;
+	const std::lock_guard<Mutex> lock(smbclient_mutex);
 
-	{
-		const ScopeUnlock unlock(mutex);
-		const std::lock_guard<Mutex> lock(smbclient_mutex);
-		nbytes = smbc_read(fd, ptr, read_size);
+	if (fd_offset != offset) {
+		if (smbc_lseek(fd, offset, SEEK_SET) < 0)
+			throw MakeErrno("smbc_lseek() failed");
+
+		fd_offset = offset;
 	}
 
+	ssize_t nbytes = smbc_read(fd, ptr, read_size);
 	if (nbytes < 0)
 		throw MakeErrno("smbc_read() failed");
 
-	offset += nbytes;
+	fd_offset += nbytes;
 	return nbytes;
 }
 
-void
-SmbclientInputStream::Seek(std::unique_lock<Mutex> &,
-			   offset_type new_offset)
+size_t
+SmbclientInputStream::Read(std::unique_lock<Mutex> &,
+			   void *ptr, size_t read_size)
 {
-	off_t result;
+	if (offset < block_offset || offset >= block_offset + block_fill) {
+		if (read_size >= block.size()) {
+			/* large read: no need to copy */
+			size_t nbytes;
+
+			{
+				const ScopeUnlock unlock(mutex);
+				nbytes = ReadFromServer(ptr, read_size);
+			}
+
+			offset += nbytes;
+			return nbytes;
+		}
 
-	{
 		const ScopeUnlock unlock(mutex);
-		const std::lock_guard<Mutex> lock(smbclient_mutex);
-		result = smbc_lseek(fd, new_offset, SEEK_SET);
+		block_fill = 0;
+		block_offset = offset;
+		block_fill = ReadFromServer(block.begin(), block.size());
 	}
 
-	if (result < 0)
-		throw MakeErrno("smbc_lseek() failed");
+	const size_t position = offset - block_offset;
+	const size_t nbytes = std::min(read_size, block_fill - position);
+	memcpy(ptr, block.begin() + position, nbytes);
+
+	offset += nbytes;
+	return nbytes;
+}
 
-	offset = result;
+void
+SmbclientInputStream::Seek(std::unique_lock<Mutex> &,
+			   offset_type new_offset)
+{
+	/* the libsmbclient file descriptor is repositioned by the
+	   next ReadFromServer() call; seeking inside #block needs
+	   no server round trip at all */
+	offset = new_offset;
 }
 
 static constexpr const char *smbclient_prefixes[] = {
@@ -22,6 +22,7 @@
 #include "TidalTrackRequest.hxx"
 #include "TidalTagScanner.hxx"
 #include "TidalError.hxx"
+#include "TrackUrlCache.hxx"
 #include "CurlInputPlugin.hxx"
 #include "PluginUnavailable.hxx"
 #include "input/ProxyInputStream.hxx"
@@ -40,12 +41,114 @@ static constexpr Domain tidal_domain("tidal");
 
 static TidalSessionManager *tidal_session;
 static const char *tidal_audioquality;
+static TrackUrlCache *tidal_url_cache;
+
+gcc_pure
+static bool
+IsInvalidSession(std::exception_ptr e) noexcept
+{
+	try {
+		std::rethrow_exception(e);
+	} catch (const TidalError &te) {
+		return te.IsInvalidSession();
+	} catch (...) {
+		return false;
+	}
+}
+
+static std::unique_ptr<TidalTrackRequest>
+StartTidalTrackRequest(const std::string &session, const std::string &track_id,
+		       TidalTrackHandler &handler)
+{
+	auto request = std::make_unique<TidalTrackRequest>(tidal_session->GetCurl(),
+							    tidal_session->GetBaseUrl(),
+							    tidal_session->GetToken(),
+							    session.c_str(),
+							    track_id.c_str(),
+							    tidal_audioquality,
+							    handler);
+	request->Start();
+	return request;
+}
+
+/**
+ * Resolves the streaming URL of a track which is going to be played
+ * soon, and submits it to #tidal_url_cache.
+ */
+class TidalPrefetchJob final
+	: public TrackUrlJob, TidalSessionHandler, TidalTrackHandler {
+
+	const std::string track_id;
+
+	/**
+	 * The session id used by #track_request.
+	 */
+	std::string session;
+
+	std::unique_ptr<TidalTrackRequest> track_request;
+
+	bool retry_login = true;
+
+public:
+	explicit TidalPrefetchJob(const char *_track_id) noexcept
+		:track_id(_track_id) {}
+
+	~TidalPrefetchJob() noexcept override {
+		tidal_session->RemoveLoginHandler(*this);
+	}
+
+	/* virtual methods from TrackUrlJob */
+	void Start() noexcept override {
+		tidal_session->AddLoginHandler(*this);
+	}
+
+private:
+	/* virtual methods from TidalSessionHandler */
+	void OnTidalSession() noexcept override {
+		try {
+			session = tidal_session->GetSession();
+			track_request = StartTidalTrackRequest(session, track_id,
+							       *this);
+		} catch (...) {
+			/* this destroys the job */
+			tidal_url_cache->Fail(track_id,
+					      std::current_exception());
+		}
+	}
+
+	/* virtual methods from TidalTrackHandler */
+	void OnTidalTrackSuccess(std::string url) noexcept override {
+		FormatDebug(tidal_domain, "Prefetched Tidal track '%s': %s",
+			    track_id.c_str(), url.c_str());
+
+		tidal_url_cache->Finish(track_id, std::move(url));
+	}
+
+	void OnTidalTrackError(std::exception_ptr e) noexcept override {
+		if (retry_login && IsInvalidSession(e)) {
+			/* renew the session now, so the stream doesn't
+			   have to */
+			retry_login = false;
+			tidal_session->InvalidateSession(session);
+			tidal_session->AddLoginHandler(*this);
+			return;
+		}
+
+		tidal_url_cache->Fail(track_id, std::move(e));
+	}
+};
 
 class TidalInputStream final
-	: public ProxyInputStream, TidalSessionHandler, TidalTrackHandler {
+	: public ProxyInputStream, TidalSessionHandler, TidalTrackHandler,
+	  TrackUrlHandler {
 
 	const std::string track_id;
 
+	/**
+	 * The session id used by #track_request.
+	 */
+	std::string session;
+
 	std::unique_ptr<TidalTrackRequest> track_request;
 
 	std::exception_ptr error;
@@ -62,10 +165,16 @@ public:
 		:ProxyInputStream(_uri, _mutex),
 		 track_id(_track_id)
 	{
-		tidal_session->AddLoginHandler(*this);
+		std::string url;
+		if (!tidal_url_cache->Take(track_id, *this, url))
+			/* not prefetched: resolve it now */
+			tidal_session->AddLoginHandler(*this);
+		else if (!url.empty())
+			OnTidalTrackSuccess(std::move(url));
 	}
 
 	~TidalInputStream() {
+		tidal_url_cache->Cancel(track_id, *this);
 		tidal_session->RemoveLoginHandler(*this);
 	}
 
@@ -88,6 +197,15 @@ private:
 	/* virtual methods from TidalTrackHandler */
 	void OnTidalTrackSuccess(std::string url) noexcept override;
 	void OnTidalTrackError(std::exception_ptr error) noexcept override;
+
+	/* virtual methods from TrackUrlHandler */
+	void OnTrackUrl(std::string url) noexcept override {
+		OnTidalTrackSuccess(std::move(url));
+	}
+
+	void OnTrackUrlError(std::exception_ptr e) noexcept override {
+		OnTidalTrackError(std::move(e));
+	}
 };
 
 void
@@ -96,15 +214,8 @@ TidalInputStream::OnTidalSession() noexcept
 	const std::lock_guard<Mutex> protect(mutex);
 
 	try {
-		TidalTrackHandler &h = *this;
-		track_request = std::make_unique<TidalTrackRequest>(tidal_session->GetCurl(),
-								    tidal_session->GetBaseUrl(),
-								    tidal_session->GetToken(),
-								    tidal_session->GetSession().c_str(),
-								    track_id.c_str(),
-								    tidal_audioquality,
-								    h);
-		track_request->Start();
+		session = tidal_session->GetSession();
+		track_request = StartTidalTrackRequest(session, track_id, *this);
 	} catch (...) {
 		Failed(std::current_exception());
 	}
@@ -128,19 +239,6 @@ TidalInputStream::OnTidalTrackSuccess(std::string url) noexcept
 	}
 }
 
-gcc_pure
-static bool
-IsInvalidSession(std::exception_ptr e) noexcept
-{
-	try {
-		std::rethrow_exception(e);
-	} catch (const TidalError &te) {
-		return te.IsInvalidSession();
-	} catch (...) {
-		return false;
-	}
-}
-
 void
 TidalInputStream::OnTidalTrackError(std::exception_ptr e) noexcept
 {
@@ -154,6 +252,7 @@ TidalInputStream::OnTidalTrackError(std::exception_ptr e) noexcept
 			   GetFullMessage(e).c_str());
 
 		retry_login = false;
+		tidal_session->InvalidateSession(session);
 		tidal_session->AddLoginHandler(*this);
 		return;
 	}
@@ -185,11 +284,13 @@ InitTidalInput(EventLoop &event_loop, const ConfigBlock &block)
 
 	tidal_session = new TidalSessionManager(event_loop, base_url, token,
 						username, password);
+	tidal_url_cache = new TrackUrlCache();
 }
 
 static void
 FinishTidalInput()
 {
+	delete tidal_url_cache;
 	delete tidal_session;
 }
 
@@ -224,6 +325,20 @@ OpenTidalInput(const char *uri, Mutex &mutex)
 	return std::make_unique<TidalInputStream>(uri, track_id, mutex);
 }
 
+static void
+PrefetchTidal(const char *uri) noexcept
+{
+	assert(tidal_session != nullptr);
+
+	const char *track_id = ExtractTidalTrackId(uri);
+	if (track_id == nullptr)
+		return;
+
+	tidal_url_cache->Prefetch(track_id, [track_id](){
+		return std::make_unique<TidalPrefetchJob>(track_id);
+	});
+}
+
 static std::unique_ptr<RemoteTagScanner>
 ScanTidalTags(const char *uri, RemoteTagHandler &handler)
 {
@@ -252,4 +367,5 @@ const InputPlugin tidal_input_plugin = {
 	OpenTidalInput,
 	nullptr,
 	ScanTidalTags,
+	PrefetchTidal,
 };
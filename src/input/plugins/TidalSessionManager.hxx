@@ -146,6 +146,17 @@ public:
 		return session;
 	}
 
+	/**
+	 * The server has rejected the given session id (e.g. because
+	 * it has expired).  Forget it, so the next AddLoginHandler()
+	 * call logs in again.
+	 */
+	void InvalidateSession(const std::string &expired) noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		if (session == expired)
+			session.clear();
+	}
+
 private:
 	void InvokeHandlers() noexcept;
 
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "TrackUrlCache.hxx"
+
+TrackUrlCache::~TrackUrlCache() noexcept
+{
+	/* destroy the jobs without holding the mutex, because their
+	   destructors may cancel pending requests */
+	decltype(items) old;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		old.swap(items);
+	}
+}
+
+void
+TrackUrlCache::PurgeExpired(std::chrono::steady_clock::time_point now) noexcept
+{
+	for (auto i = items.begin(); i != items.end();) {
+		if (i->second.IsExpired(now))
+			i = items.erase(i);
+		else
+			++i;
+	}
+}
+
+bool
+TrackUrlCache::Take(const std::string &track_id, TrackUrlHandler &handler,
+		    std::string &url_r) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = items.find(track_id);
+	if (i == items.end())
+		return false;
+
+	auto &item = i->second;
+
+	if (item.job != nullptr) {
+		if (item.handler != nullptr)
+			/* somebody else is waiting already */
+			return false;
+
+		item.handler = &handler;
+		return true;
+	}
+
+	if (item.url.empty() ||
+	    item.IsExpired(std::chrono::steady_clock::now()))
+		/* already used or too old */
+		return false;
+
+	/* keep the (now empty) item for a while to suppress another
+	   prefetch of this track */
+	url_r = std::move(item.url);
+	item.url.clear();
+	return true;
+}
+
+void
+TrackUrlCache::Cancel(const std::string &track_id,
+		      TrackUrlHandler &handler) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = items.find(track_id);
+	if (i != items.end() && i->second.handler == &handler)
+		i->second.handler = nullptr;
+}
+
+void
+TrackUrlCache::Finish(const std::string &track_id, std::string url) noexcept
+{
+	std::unique_ptr<TrackUrlJob> job;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = items.find(track_id);
+	if (i == items.end())
+		return;
+
+	auto &item = i->second;
+	job = std::move(item.job);
+	item.time = std::chrono::steady_clock::now();
+
+	if (item.handler != nullptr) {
+		auto &handler = *item.handler;
+		item.handler = nullptr;
+		handler.OnTrackUrl(std::move(url));
+	} else
+		item.url = std::move(url);
+}
+
+void
+TrackUrlCache::Fail(const std::string &track_id,
+		    std::exception_ptr error) noexcept
+{
+	std::unique_ptr<TrackUrlJob> job;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = items.find(track_id);
+	if (i == items.end())
+		return;
+
+	auto *handler = i->second.handler;
+	job = std::move(i->second.job);
+
+	/* forget the failed prefetch; the next attempt to open the
+	   track will try again */
+	items.erase(i);
+
+	if (handler != nullptr)
+		handler->OnTrackUrlError(std::move(error));
+}
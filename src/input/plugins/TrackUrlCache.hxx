@@ -0,0 +1,173 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TRACK_URL_CACHE_HXX
+#define MPD_TRACK_URL_CACHE_HXX
+
+#include "thread/Mutex.hxx"
+
+#include <chrono>
+#include <exception>
+#include <map>
+#include <memory>
+#include <string>
+
+/**
+ * Callback class for #TrackUrlCache::Take().
+ *
+ * Its methods are invoked with the #TrackUrlCache mutex locked.
+ */
+class TrackUrlHandler {
+public:
+	virtual void OnTrackUrl(std::string url) noexcept = 0;
+	virtual void OnTrackUrlError(std::exception_ptr error) noexcept = 0;
+};
+
+/**
+ * An operation which resolves the streaming URL of one track.  It
+ * reports its result with TrackUrlCache::Finish() or
+ * TrackUrlCache::Fail(), which destroys the job.
+ */
+class TrackUrlJob {
+public:
+	virtual ~TrackUrlJob() noexcept = default;
+
+	virtual void Start() noexcept = 0;
+};
+
+/**
+ * Remembers the streaming URLs of tracks which were resolved ahead
+ * of time (see InputPlugin::prefetch), so opening the track does not
+ * have to wait for the streaming service's API.
+ *
+ * This class is thread-safe.
+ */
+class TrackUrlCache {
+	/**
+	 * Streaming URLs are signed and expire after a while; don't
+	 * use a URL older than this.  This also suppresses repeated
+	 * prefetches of a track which has just been opened.
+	 */
+	static constexpr std::chrono::steady_clock::duration max_age =
+		std::chrono::minutes(5);
+
+	/**
+	 * The maximum number of tracks being tracked; further
+	 * prefetch requests are ignored.
+	 */
+	static constexpr std::size_t max_items = 8;
+
+	struct Item {
+		/**
+		 * The operation resolving the URL; nullptr if it has
+		 * finished.
+		 */
+		std::unique_ptr<TrackUrlJob> job;
+
+		/**
+		 * This handler gets invoked when the #job finishes.
+		 */
+		TrackUrlHandler *handler = nullptr;
+
+		/**
+		 * The resolved URL.  Empty if the job is still
+		 * running or if it was already handed out by Take().
+		 */
+		std::string url;
+
+		/**
+		 * When was the URL resolved?
+		 */
+		std::chrono::steady_clock::time_point time;
+
+		bool IsExpired(std::chrono::steady_clock::time_point now) const noexcept {
+			return job == nullptr && now - time > max_age;
+		}
+	};
+
+	Mutex mutex;
+
+	std::map<std::string, Item> items;
+
+public:
+	~TrackUrlCache() noexcept;
+
+	/**
+	 * Start resolving the URL of the given track, unless that
+	 * has been done recently.
+	 *
+	 * @param create_job a function returning a new #TrackUrlJob
+	 */
+	template<typename F>
+	void Prefetch(const char *track_id, F &&create_job) noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+
+		const auto now = std::chrono::steady_clock::now();
+		PurgeExpired(now);
+
+		if (items.size() >= max_items)
+			return;
+
+		auto i = items.emplace(track_id, Item());
+		if (!i.second)
+			/* already known */
+			return;
+
+		auto &item = i.first->second;
+		item.job = create_job();
+		item.job->Start();
+	}
+
+	/**
+	 * Obtain the prefetched URL of the given track.
+	 *
+	 * @param url_r receives the URL if it has been resolved
+	 * already; it is left empty if the prefetch is still running,
+	 * and the #handler will be invoked when it finishes
+	 * @return false if no URL was prefetched; the caller has to
+	 * resolve it
+	 */
+	bool Take(const std::string &track_id, TrackUrlHandler &handler,
+		  std::string &url_r) noexcept;
+
+	/**
+	 * Unregister a handler which was passed to Take().
+	 */
+	void Cancel(const std::string &track_id,
+		    TrackUrlHandler &handler) noexcept;
+
+	/**
+	 * Called by the #TrackUrlJob when the URL has been resolved.
+	 * This destroys the job.
+	 */
+	void Finish(const std::string &track_id, std::string url) noexcept;
+
+	/**
+	 * Called by the #TrackUrlJob when it has failed.  This
+	 * destroys the job.
+	 */
+	void Fail(const std::string &track_id,
+		  std::exception_ptr error) noexcept;
+
+private:
+	void PurgeExpired(std::chrono::steady_clock::time_point now) noexcept;
+};
+
+#endif
@@ -173,7 +173,7 @@ SetupSampleFormat(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 
 HwResult
 SetupHw(snd_pcm_t *pcm,
-	unsigned buffer_time, unsigned period_time,
+	unsigned buffer_time, unsigned period_time, bool use_mmap,
 	AudioFormat &audio_format, PcmExport::Params &params)
 {
 	snd_pcm_hw_params_t *hwparams;
@@ -188,11 +188,25 @@ SetupHw(snd_pcm_t *pcm,
 		throw FormatRuntimeError("snd_pcm_hw_params_any() failed: %s",
 					 snd_strerror(-err));
 
-	err = snd_pcm_hw_params_set_access(pcm, hwparams,
-					   SND_PCM_ACCESS_RW_INTERLEAVED);
-	if (err < 0)
-		throw FormatRuntimeError("snd_pcm_hw_params_set_access() failed: %s",
-					 snd_strerror(-err));
+	bool mmap = false;
+	if (use_mmap) {
+		err = snd_pcm_hw_params_set_access(pcm, hwparams,
+						   SND_PCM_ACCESS_MMAP_INTERLEAVED);
+		if (err == 0)
+			mmap = true;
+		else
+			FormatDebug(alsa_output_domain,
+				    "Cannot set mmap'ed mode on ALSA device: %s",
+				    snd_strerror(-err));
+	}
+
+	if (!mmap) {
+		err = snd_pcm_hw_params_set_access(pcm, hwparams,
+						   SND_PCM_ACCESS_RW_INTERLEAVED);
+		if (err < 0)
+			throw FormatRuntimeError("snd_pcm_hw_params_set_access() failed: %s",
+						 snd_strerror(-err));
+	}
 
 	err = SetupSampleFormat(pcm, hwparams,
 				audio_format.format, params);
@@ -285,6 +299,7 @@ SetupHw(snd_pcm_t *pcm,
 					 snd_strerror(-err));
 
 	HwResult result;
+	result.mmap = mmap;
 
 	err = snd_pcm_hw_params_get_format(hwparams, &result.format);
 	if (err < 0)
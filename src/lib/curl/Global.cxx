@@ -105,6 +105,39 @@ CurlGlobal::CurlGlobal(EventLoop &_loop)
 
 	multi.SetOption(CURLMOPT_TIMERFUNCTION, TimerFunction);
 	multi.SetOption(CURLMOPT_TIMERDATA, this);
+
+#ifdef CURLPIPE_MULTIPLEX
+	/* multiplex HTTP/2 streams over one connection; this allows
+	   aborting a stream (e.g. for seeking) without losing the
+	   connection */
+	multi.SetOption(CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+#endif
+
+	share.SetOption(CURLSHOPT_LOCKFUNC, LockShare);
+	share.SetOption(CURLSHOPT_UNLOCKFUNC, UnlockShare);
+	share.SetOption(CURLSHOPT_USERDATA, this);
+	share.Share(CURL_LOCK_DATA_DNS);
+
+	try {
+		share.Share(CURL_LOCK_DATA_SSL_SESSION);
+	} catch (...) {
+		/* libcurl was built without TLS support */
+	}
+}
+
+void
+CurlGlobal::LockShare(CURL *, curl_lock_data, curl_lock_access,
+		      void *userptr) noexcept
+{
+	auto &global = *(CurlGlobal *)userptr;
+	global.share_mutex.lock();
+}
+
+void
+CurlGlobal::UnlockShare(CURL *, curl_lock_data, void *userptr) noexcept
+{
+	auto &global = *(CurlGlobal *)userptr;
+	global.share_mutex.unlock();
 }
 
 int
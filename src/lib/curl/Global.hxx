@@ -31,6 +31,8 @@
 #define CURL_GLOBAL_HXX
 
 #include "Multi.hxx"
+#include "Share.hxx"
+#include "thread/Mutex.hxx"
 #include "event/TimerEvent.hxx"
 #include "event/DeferEvent.hxx"
 
@@ -41,6 +43,24 @@ class CurlRequest;
  * Manager for the global CURLM object.
  */
 class CurlGlobal final {
+	/**
+	 * Protects #share; easy handles may be configured in any
+	 * thread.
+	 */
+	Mutex share_mutex;
+
+	/**
+	 * Shares the DNS cache and TLS sessions among all
+	 * #CurlRequest instances, so reconnecting to the same server
+	 * (e.g. an internet radio stream) needs neither a DNS lookup
+	 * nor a full TLS handshake.
+	 */
+	CurlShare share;
+
+	/**
+	 * Destroyed before #share, because the connection cache may
+	 * still refer to it.
+	 */
 	CurlMulti multi;
 
 	DeferEvent defer_read_info;
@@ -54,6 +74,10 @@ public:
 		return timeout_event.GetEventLoop();
 	}
 
+	CURLSH *GetShare() noexcept {
+		return share.Get();
+	}
+
 	void Add(CurlRequest &r);
 	void Remove(CurlRequest &r) noexcept;
 
@@ -85,6 +109,12 @@ private:
 	 */
 	void ReadInfo() noexcept;
 
+	static void LockShare(CURL *handle, curl_lock_data data,
+			      curl_lock_access access,
+			      void *userptr) noexcept;
+	static void UnlockShare(CURL *handle, curl_lock_data data,
+				void *userptr) noexcept;
+
 	void UpdateTimeout(long timeout_ms) noexcept;
 	static int TimerFunction(CURLM *multi, long timeout_ms,
 				 void *userp) noexcept;
@@ -63,6 +63,25 @@ CurlRequest::CurlRequest(CurlGlobal &_global,
 	easy.SetNoSignal();
 	easy.SetConnectTimeout(10);
 	easy.SetOption(CURLOPT_HTTPAUTH, (long) CURLAUTH_ANY);
+	easy.SetOption(CURLOPT_SHARE, global.GetShare());
+
+	/* keep resolved host names longer than libcurl's default
+	   (60 seconds); this speeds up switching between streams
+	   hosted on the same server */
+	easy.SetOption(CURLOPT_DNS_CACHE_TIMEOUT, 300l);
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	/* negotiate HTTP/2 on TLS connections (the default since
+	   libcurl 7.62) */
+	easy.SetOption(CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	/* if a connection to this host is still being established,
+	   wait for it instead of opening a new one; if it turns out
+	   to support HTTP/2, the new stream is multiplexed over it */
+	easy.SetOption(CURLOPT_PIPEWAIT, 1l);
+#endif
 }
 
 CurlRequest::~CurlRequest() noexcept
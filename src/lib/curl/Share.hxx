@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CURL_SHARE_HXX
+#define CURL_SHARE_HXX
+
+#include <curl/curl.h>
+
+#include <utility>
+#include <stdexcept>
+#include <cstddef>
+
+/**
+ * An OO wrapper for a "CURLSH*" (a libCURL "share" handle).
+ */
+class CurlShare {
+	CURLSH *handle = nullptr;
+
+public:
+	/**
+	 * Allocate a new CURLSH*.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	CurlShare()
+		:handle(curl_share_init())
+	{
+		if (handle == nullptr)
+			throw std::runtime_error("curl_share_init() failed");
+	}
+
+	/**
+	 * Create an empty instance.
+	 */
+	CurlShare(std::nullptr_t) noexcept:handle(nullptr) {}
+
+	CurlShare(CurlShare &&src) noexcept
+		:handle(std::exchange(src.handle, nullptr)) {}
+
+	~CurlShare() noexcept {
+		if (handle != nullptr)
+			curl_share_cleanup(handle);
+	}
+
+	operator bool() const noexcept {
+		return handle != nullptr;
+	}
+
+	CurlShare &operator=(CurlShare &&src) noexcept {
+		std::swap(handle, src.handle);
+		return *this;
+	}
+
+	CURLSH *Get() noexcept {
+		return handle;
+	}
+
+	template<typename T>
+	void SetOption(CURLSHoption option, T value) {
+		auto code = curl_share_setopt(handle, option, value);
+		if (code != CURLSHE_OK)
+			throw std::runtime_error(curl_share_strerror(code));
+	}
+
+	/**
+	 * Share the given kind of data (CURL_LOCK_DATA_*) among all
+	 * easy handles using this object.
+	 */
+	void Share(curl_lock_data data) {
+		SetOption(CURLSHOPT_SHARE, data);
+	}
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_FFMPEG_BUFFER_POOL_HXX
+#define MPD_FFMPEG_BUFFER_POOL_HXX
+
+extern "C" {
+#include <libavutil/buffer.h>
+}
+
+#include <new>
+
+#include <stddef.h>
+
+namespace Ffmpeg {
+
+/**
+ * A wrapper for an AVBufferPool which grows on demand.  Buffers
+ * obtained from the pool are recycled after libavfilter and friends
+ * have released their last reference, which avoids a malloc()/free()
+ * pair for each frame.
+ */
+class BufferPool {
+	AVBufferPool *pool = nullptr;
+
+	/**
+	 * The size of all buffers allocated by #pool.
+	 */
+	size_t size = 0;
+
+public:
+	BufferPool() noexcept = default;
+
+	~BufferPool() noexcept {
+		/* the pool itself is freed when the last buffer is
+		   returned */
+		av_buffer_pool_uninit(&pool);
+	}
+
+	BufferPool(const BufferPool &) = delete;
+	BufferPool &operator=(const BufferPool &) = delete;
+
+	/**
+	 * Obtain a buffer which is at least the given size.  The
+	 * caller owns the returned reference.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	AVBufferRef *Get(size_t min_size) {
+		if (min_size > size) {
+			/* all buffers of a pool have the same size;
+			   buffers still referenced from the old pool
+			   remain valid */
+			av_buffer_pool_uninit(&pool);
+			size = 0;
+
+			pool = av_buffer_pool_init(min_size, nullptr);
+			if (pool == nullptr)
+				throw std::bad_alloc();
+
+			size = min_size;
+		}
+
+		AVBufferRef *buffer = av_buffer_pool_get(pool);
+		if (buffer == nullptr)
+			throw std::bad_alloc();
+
+		return buffer;
+	}
+};
+
+} // namespace Ffmpeg
+
+#endif
@@ -28,6 +28,8 @@ extern "C" {
 
 #include <new>
 
+#include <stddef.h>
+
 namespace Ffmpeg {
 
 class Frame {
@@ -68,6 +70,19 @@ public:
 			throw MakeFfmpegError(err, "av_frame_get_buffer() failed");
 	}
 
+	/**
+	 * Attach a buffer with packed (interleaved) audio samples,
+	 * instead of allocating one with GetBuffer().  This object
+	 * takes over the reference.  The audio parameters
+	 * (nb_samples etc.) must already be set.
+	 */
+	void SetPackedBuffer(AVBufferRef *buffer, size_t size) noexcept {
+		frame->buf[0] = buffer;
+		frame->data[0] = buffer->data;
+		frame->extended_data = frame->data;
+		frame->linesize[0] = size;
+	}
+
 	void MakeWritable() {
 		int err = av_frame_make_writable(frame);
 		if (err < 0)
@@ -26,6 +26,7 @@
 #include "util/RuntimeError.hxx"
 
 #include <unicode/ucol.h>
+#include <unicode/uiter.h>
 #include <unicode/ustring.h>
 #else
 #include <algorithm>
@@ -124,3 +125,76 @@ IcuCollate(const char *a, const char *b) noexcept
 	return strcoll(a, b);
 #endif
 }
+
+std::string
+IcuCollateKey(const char *s) noexcept
+{
+	assert(s != nullptr);
+
+	std::string key;
+
+#ifdef HAVE_ICU
+	assert(collator != nullptr);
+
+	UCharIterator iter;
+	uiter_setUTF8(&iter, s, -1);
+
+	/* generate the key in parts, because the final size is not
+	   known in advance */
+	static constexpr int32_t PART_SIZE = 256;
+	uint32_t state[2] = {0, 0};
+
+	while (true) {
+		const size_t old_size = key.size();
+		key.resize(old_size + PART_SIZE);
+
+		UErrorCode code = U_ZERO_ERROR;
+		const int32_t n =
+			ucol_nextSortKeyPart(collator, &iter, state,
+					     (uint8_t *)&key[old_size],
+					     PART_SIZE, &code);
+		if (U_FAILURE(code) || n < 0) {
+			key.resize(old_size);
+			break;
+		}
+
+		key.resize(old_size + n);
+		if (n < PART_SIZE)
+			break;
+	}
+
+#elif defined(_WIN32)
+	AllocatedString<wchar_t> w = nullptr;
+
+	try {
+		w = MultiByteToWideChar(CP_UTF8, s);
+	} catch (...) {
+		/* sort invalid strings first, like IcuCollate()
+		   does */
+		return key;
+	}
+
+	static constexpr DWORD flags = LCMAP_SORTKEY|LINGUISTIC_IGNORECASE;
+
+	int size = LCMapStringEx(LOCALE_NAME_INVARIANT, flags,
+				 w.c_str(), -1, nullptr, 0,
+				 nullptr, nullptr, 0);
+	if (size > 0) {
+		key.resize(size);
+		size = LCMapStringEx(LOCALE_NAME_INVARIANT, flags,
+				     w.c_str(), -1,
+				     (LPWSTR)&key.front(), size,
+				     nullptr, nullptr, 0);
+		/* strip the null terminator */
+		key.resize(size > 0 ? size - 1 : 0);
+	}
+
+#else
+	const size_t size = strxfrm(nullptr, s, 0);
+	key.resize(size + 1);
+	strxfrm(&key.front(), s, size + 1);
+	key.resize(size);
+#endif
+
+	return key;
+}
@@ -22,6 +22,8 @@
 #include "util/StringAPI.hxx"
 #include "config.h"
 
+#include <assert.h>
+
 #ifdef HAVE_ICU_CASE_FOLD
 
 IcuCompare::IcuCompare(const char *_needle) noexcept
@@ -44,6 +46,22 @@ IcuCompare::operator==(const char *haystack) const noexcept
 #endif
 }
 
+bool
+IcuCompare::EqualsFolded(const char *folded_haystack) const noexcept
+{
+	assert(CanCompareFolded());
+
+	return StringIsEqual(folded_haystack, needle.c_str());
+}
+
+bool
+IcuCompare::IsInFolded(const char *folded_haystack) const noexcept
+{
+	assert(CanCompareFolded());
+
+	return StringFind(folded_haystack, needle.c_str()) != nullptr;
+}
+
 bool
 IcuCompare::IsIn(const char *haystack) const noexcept
 {
@@ -22,6 +22,7 @@
 
 #include "util/Compiler.h"
 #include "util/AllocatedString.hxx"
+#include "CaseFold.hxx"
 
 /**
  * This class can compare one string ("needle") with lots of other
@@ -61,6 +62,33 @@ public:
 
 	gcc_pure
 	bool IsIn(const char *haystack) const noexcept;
+
+	/**
+	 * Can EqualsFolded() and IsInFolded() be used?  This is false
+	 * if MPD was built without a case folding implementation.
+	 */
+	static constexpr bool CanCompareFolded() noexcept {
+#ifdef HAVE_ICU_CASE_FOLD
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * Like operator==(), but the haystack has already been
+	 * case-folded with IcuCaseFold().  This is only a byte
+	 * comparison.
+	 */
+	gcc_pure
+	bool EqualsFolded(const char *folded_haystack) const noexcept;
+
+	/**
+	 * Like IsIn(), but the haystack has already been case-folded
+	 * with IcuCaseFold().
+	 */
+	gcc_pure
+	bool IsInFolded(const char *folded_haystack) const noexcept;
 };
 
 #endif
@@ -24,13 +24,17 @@
 constexpr std::chrono::steady_clock::duration BlockingNfsOperation::timeout;
 
 void
-BlockingNfsOperation::Run()
+BlockingNfsOperation::Submit()
 {
 	/* subscribe to the connection, which will invoke either
 	   OnNfsConnectionReady() or OnNfsConnectionFailed() */
 	BlockingCall(connection.GetEventLoop(),
 		    [this](){ connection.AddLease(*this); });
+}
 
+void
+BlockingNfsOperation::Wait()
+{
 	/* wait for completion */
 	if (!LockWaitFinished())
 		throw std::runtime_error("Timeout");
@@ -55,7 +55,25 @@ public:
 	/**
 	 * Throws std::runtime_error on error.
 	 */
-	void Run();
+	void Run() {
+		Submit();
+		Wait();
+	}
+
+	/**
+	 * Start the operation, but don't wait for its completion.
+	 * This allows submitting several operations at a time.
+	 * Wait() must be called before the object is destroyed.
+	 */
+	void Submit();
+
+	/**
+	 * Wait for the completion of an operation started with
+	 * Submit().
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Wait();
 
 private:
 	bool LockWaitFinished() noexcept {
@@ -125,6 +125,20 @@ NfsConnection::CancellableCallback::CancelAndScheduleClose(struct nfsfh *fh) noe
 	Cancel();
 }
 
+inline bool
+NfsConnection::CancellableCallback::IsCloseShared() noexcept
+{
+	assert(close_fh != nullptr);
+
+	bool result = false;
+	connection.callbacks.ForEach([this, &result](CancellableCallback &c){
+			if (&c != this && c.close_fh == close_fh)
+				result = true;
+		});
+
+	return result;
+}
+
 inline void
 NfsConnection::CancellableCallback::PrepareDestroyContext() noexcept
 {
@@ -132,7 +146,13 @@ NfsConnection::CancellableCallback::PrepareDestroyContext() noexcept
 
 	if (close_fh != nullptr) {
 		connection.InternalClose(close_fh);
-		close_fh = nullptr;
+
+		/* don't let other operations close it again */
+		const auto fh = close_fh;
+		connection.callbacks.ForEach([fh](CancellableCallback &c){
+				if (c.close_fh == fh)
+					c.close_fh = nullptr;
+			});
 	}
 }
 
@@ -163,7 +183,7 @@ NfsConnection::CancellableCallback::Callback(int err, void *data) noexcept
 				struct nfsfh *fh = (struct nfsfh *)data;
 				connection.Close(fh);
 			}
-		} else if (close_fh != nullptr)
+		} else if (close_fh != nullptr && !IsCloseShared())
 			connection.DeferClose(close_fh);
 
 		connection.callbacks.Remove(*this);
@@ -22,7 +22,7 @@
 
 #include "Cancellable.hxx"
 #include "event/SocketMonitor.hxx"
-#include "event/TimerEvent.hxx"
+#include "event/CoarseTimerEvent.hxx"
 #include "event/DeferEvent.hxx"
 #include "util/Compiler.h"
 
@@ -54,7 +54,9 @@ class NfsConnection : SocketMonitor {
 
 		/**
 		 * The file handle scheduled to be closed as soon as
-		 * the operation finishes.
+		 * the operation finishes.  If several cancelled
+		 * operations share the same file handle, it is closed
+		 * by the last of them.
 		 */
 		struct nfsfh *close_fh;
 
@@ -88,13 +90,20 @@ class NfsConnection : SocketMonitor {
 		void PrepareDestroyContext() noexcept;
 
 	private:
+		/**
+		 * Is another cancelled operation going to close our
+		 * #close_fh?
+		 */
+		gcc_pure
+		bool IsCloseShared() noexcept;
+
 		static void Callback(int err, struct nfs_context *nfs,
 				     void *data, void *private_data) noexcept;
 		void Callback(int err, void *data) noexcept;
 	};
 
 	DeferEvent defer_new_lease;
-	TimerEvent mount_timeout_event;
+	CoarseTimerEvent mount_timeout_event;
 
 	std::string server, export_name;
 
@@ -24,6 +24,7 @@
 #include "event/Call.hxx"
 #include "util/ASCII.hxx"
 
+#include <stdexcept>
 #include <utility>
 
 #include <assert.h>
@@ -33,6 +34,8 @@
 NfsFileReader::NfsFileReader() noexcept
 	:defer_open(nfs_get_event_loop(), BIND_THIS_METHOD(OnDeferredOpen))
 {
+	for (auto &i : reads)
+		i.Init(*this);
 }
 
 NfsFileReader::~NfsFileReader() noexcept
@@ -65,9 +68,9 @@ NfsFileReader::CancelOrClose() noexcept
 	       state != State::DEFER);
 
 	if (state == State::IDLE)
-		/* no async operation in progress: can close
-		   immediately */
-		connection->Close(fh);
+		/* cancel all reads (if any) and close the file
+		   handle after they have finished */
+		CancelReads(true);
 	else if (state > State::OPEN)
 		/* one async operation in progress: cancel it and
 		   defer the nfs_close_async() call */
@@ -126,18 +129,119 @@ NfsFileReader::Open(const char *uri)
 void
 NfsFileReader::Read(uint64_t offset, size_t size)
 {
-	assert(state == State::IDLE);
+	assert(CanRead());
 
-	connection->Read(fh, offset, size, *this);
-	state = State::READ;
+	auto &op = reads[(reads_head + n_reads) % MAX_READS];
+	op.Start(size);
+	connection->Read(fh, offset, size, op);
+	++n_reads;
+}
+
+void
+NfsFileReader::CancelReads(bool close_fh) noexcept
+{
+	bool close_scheduled = false;
+
+	for (unsigned i = 0; i < n_reads; ++i) {
+		auto &op = reads[(reads_head + i) % MAX_READS];
+		if (!op.done) {
+			if (close_fh) {
+				connection->CancelAndClose(fh, op);
+				close_scheduled = true;
+			} else
+				connection->Cancel(op);
+		}
+
+		op.Reset();
+	}
+
+	reads_head = 0;
+	n_reads = 0;
+
+	if (close_fh && !close_scheduled)
+		/* no async operation in progress: can close
+		   immediately */
+		connection->Close(fh);
 }
 
 void
 NfsFileReader::CancelRead() noexcept
 {
-	if (state == State::READ) {
-		connection->Cancel(*this);
-		state = State::IDLE;
+	if (state == State::IDLE)
+		CancelReads(false);
+}
+
+void
+NfsFileReader::ReadOperation::OnNfsCallback(unsigned status,
+					    void *_data) noexcept
+{
+	reader->OnReadDone(*this, status, _data);
+}
+
+void
+NfsFileReader::ReadOperation::OnNfsError(std::exception_ptr &&e) noexcept
+{
+	error = std::move(e);
+	reader->OnReadDone(*this, 0, nullptr);
+}
+
+inline void
+NfsFileReader::DeliverHeadRead(size_t nbytes, const void *data) noexcept
+{
+	auto &op = GetHeadRead();
+	assert(op.done);
+
+	const bool short_read = nbytes < op.size;
+	auto error = std::move(op.error);
+
+	op.Reset();
+	reads_head = (reads_head + 1) % MAX_READS;
+	--n_reads;
+
+	if (error) {
+		CancelReads(false);
+		OnNfsFileError(std::move(error));
+		return;
+	}
+
+	if (short_read)
+		/* the following reads would leave a gap */
+		CancelReads(false);
+
+	OnNfsFileRead(data, nbytes);
+}
+
+inline void
+NfsFileReader::OnReadDone(ReadOperation &op, unsigned status,
+			  const void *data) noexcept
+{
+	assert(state == State::IDLE);
+	assert(n_reads > 0);
+	assert(!op.done);
+
+	op.done = true;
+
+	if (&op != &GetHeadRead()) {
+		/* an earlier read is still pending: keep a copy of
+		   this result until that one has been delivered */
+		if (!op.error && status > 0) {
+			op.data.reset(new uint8_t[status]);
+			memcpy(op.data.get(), data, status);
+		}
+
+		op.data_size = status;
+		return;
+	}
+
+	DeliverHeadRead(status, data);
+
+	/* deliver the stored results which were waiting for this
+	   one; the callback may have submitted or cancelled reads
+	   meanwhile */
+	while (n_reads > 0 && GetHeadRead().done) {
+		auto &head = GetHeadRead();
+		const auto head_data = std::move(head.data);
+		DeliverHeadRead(head.data_size, head_data.get());
 	}
 }
 
@@ -214,7 +318,7 @@ NfsFileReader::StatCallback(const struct stat *st) noexcept
 }
 
 void
-NfsFileReader::OnNfsCallback(unsigned status, void *data) noexcept
+NfsFileReader::OnNfsCallback(unsigned, void *data) noexcept
 {
 	switch (state) {
 	case State::INITIAL:
@@ -231,11 +335,6 @@ NfsFileReader::OnNfsCallback(unsigned status, void *data) noexcept
 	case State::STAT:
 		StatCallback((const struct stat *)data);
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		OnNfsFileRead(data, status);
-		break;
 	}
 }
 
@@ -260,10 +359,6 @@ NfsFileReader::OnNfsError(std::exception_ptr &&e) noexcept
 		connection->Close(fh);
 		state = State::INITIAL;
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		break;
 	}
 
 	OnNfsFileError(std::move(e));
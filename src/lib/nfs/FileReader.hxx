@@ -25,6 +25,8 @@
 #include "event/DeferEvent.hxx"
 #include "util/Compiler.h"
 
+#include <array>
+#include <memory>
 #include <string>
 #include <exception>
 
@@ -44,16 +46,66 @@ class NfsConnection;
  * virtual methods, construct an instance, and call Open().
  */
 class NfsFileReader : NfsLease, NfsCallback {
+public:
+	/**
+	 * The maximum number of concurrent Read() calls.
+	 */
+	static constexpr unsigned MAX_READS = 16;
+
+private:
 	enum class State {
 		INITIAL,
 		DEFER,
 		MOUNT,
 		OPEN,
 		STAT,
-		READ,
 		IDLE,
 	};
 
+	/**
+	 * One pending Read() call.  Its result may arrive before the
+	 * results of earlier reads; then it is stored here until
+	 * those have been delivered.
+	 */
+	class ReadOperation final : public NfsCallback {
+		NfsFileReader *reader;
+
+	public:
+		size_t size;
+
+		/**
+		 * Has the result arrived already?
+		 */
+		bool done;
+
+		std::unique_ptr<uint8_t[]> data;
+		size_t data_size;
+
+		std::exception_ptr error;
+
+		void Init(NfsFileReader &_reader) noexcept {
+			reader = &_reader;
+		}
+
+		void Start(size_t _size) noexcept {
+			size = _size;
+			done = false;
+			data.reset();
+			error = nullptr;
+		}
+
+		void Reset() noexcept {
+			data.reset();
+			error = nullptr;
+		}
+
+	private:
+		/* virtual methods from NfsCallback */
+		void OnNfsCallback(unsigned status, void *data) noexcept override;
+		void OnNfsError(std::exception_ptr &&e) noexcept override;
+	};
+
+
 	State state = State::INITIAL;
 
 	std::string server, export_name;
@@ -65,6 +117,13 @@ class NfsFileReader : NfsLease, NfsCallback {
 
 	DeferEvent defer_open;
 
+	/**
+	 * A ring buffer of pending reads, in the order they were
+	 * submitted.
+	 */
+	std::array<ReadOperation, MAX_READS> reads;
+	unsigned reads_head = 0, n_reads = 0;
+
 public:
 	NfsFileReader() noexcept;
 	~NfsFileReader() noexcept;
@@ -85,8 +144,12 @@ public:
 
 	/**
 	 * Attempt to read from the file.  This may only be done after
-	 * OnNfsFileOpen() has been called.  Only one read operation
-	 * may be performed at a time.
+	 * OnNfsFileOpen() has been called.  Up to #MAX_READS read
+	 * operations may be performed at a time; their results are
+	 * delivered to OnNfsFileRead() in the order they were
+	 * submitted.  If one of them returns less than requested,
+	 * all later ones are cancelled, because their data would not
+	 * be contiguous.
 	 *
 	 * This method is not thread-safe and must be called from
 	 * within the I/O thread.
@@ -96,15 +159,29 @@ public:
 	void Read(uint64_t offset, size_t size);
 
 	/**
-	 * Cancel the most recent Read() call.
+	 * Cancel all pending Read() calls.
 	 *
 	 * This method is not thread-safe and must be called from
 	 * within the I/O thread.
 	 */
 	void CancelRead() noexcept;
 
+	/**
+	 * Is the file open and no Read() pending?
+	 */
 	bool IsIdle() const noexcept {
-		return state == State::IDLE;
+		return state == State::IDLE && n_reads == 0;
+	}
+
+	/**
+	 * Is the file open and may another Read() be submitted?
+	 */
+	bool CanRead() const noexcept {
+		return state == State::IDLE && n_reads < MAX_READS;
+	}
+
+	unsigned GetPendingReads() const noexcept {
+		return n_reads;
 	}
 
 protected:
@@ -118,7 +195,8 @@ protected:
 	virtual void OnNfsFileOpen(uint64_t size) noexcept = 0;
 
 	/**
-	 * A Read() has completed successfully.
+	 * A Read() has completed successfully.  Results are delivered
+	 * in the order of the Read() calls.
 	 *
 	 * This method will be called from within the I/O thread.
 	 */
@@ -141,6 +219,30 @@ private:
 	void OpenCallback(nfsfh *_fh) noexcept;
 	void StatCallback(const struct stat *st) noexcept;
 
+	ReadOperation &GetHeadRead() noexcept {
+		return reads[reads_head];
+	}
+
+	/**
+	 * Called by #ReadOperation when its result has arrived.
+	 */
+	void OnReadDone(ReadOperation &op, unsigned status,
+			const void *data) noexcept;
+
+	/**
+	 * Remove the oldest read (which must have finished) and
+	 * deliver its result.
+	 */
+	void DeliverHeadRead(size_t nbytes, const void *data) noexcept;
+
+	/**
+	 * Cancel all pending reads and release all stored results.
+	 *
+	 * @param close_fh true to close the file handle after all
+	 * cancelled operations have finished
+	 */
+	void CancelReads(bool close_fh) noexcept;
+
 	/* virtual methods from NfsLease */
 	void OnNfsConnectionReady() noexcept final;
 	void OnNfsConnectionFailed(std::exception_ptr e) noexcept final;
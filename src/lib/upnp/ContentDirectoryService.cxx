@@ -77,3 +77,29 @@ ContentDirectoryService::getSearchCapabilities(UpnpClient_Handle hdl) const
 
 	return SplitString(s, ',', false);
 }
+
+std::string
+ContentDirectoryService::getSystemUpdateID(UpnpClient_Handle hdl) const
+{
+	UniqueIxmlDocument request(UpnpMakeAction("GetSystemUpdateID", m_serviceType.c_str(),
+						  0,
+						  nullptr, nullptr));
+	if (!request)
+		throw std::runtime_error("UpnpMakeAction() failed");
+
+	IXML_Document *_response;
+	auto code = UpnpSendAction(hdl, m_actionURL.c_str(),
+				   m_serviceType.c_str(),
+				   0 /*devUDN*/, request.get(), &_response);
+	if (code != UPNP_E_SUCCESS)
+		throw FormatRuntimeError("UpnpSendAction() failed: %s",
+					 UpnpGetErrorMessage(code));
+
+	UniqueIxmlDocument response(_response);
+
+	const char *s = ixmlwrap::getFirstElementValue(response.get(), "Id");
+	if (s == nullptr)
+		throw std::runtime_error("No Id in GetSystemUpdateID response");
+
+	return s;
+}
@@ -113,6 +113,14 @@ public:
 	 */
 	std::forward_list<std::string> getSearchCapabilities(UpnpClient_Handle handle) const;
 
+	/** Retrieve the "SystemUpdateID" state variable, which the
+	 * server changes whenever any object in the directory is
+	 * modified
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	std::string getSystemUpdateID(UpnpClient_Handle handle) const;
+
 	gcc_pure
 	std::string GetURI() const noexcept {
 		return "upnp://" + m_deviceId + "/" + m_serviceType;
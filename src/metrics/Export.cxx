@@ -0,0 +1,489 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Export.hxx"
+#include "Instance.hxx"
+#include "Partition.hxx"
+#include "Stats.hxx"
+#include "LogAsync.hxx"
+#include "client/List.hxx"
+#include "event/Loop.hxx"
+#include "command/AllCommands.hxx"
+#include "command/CommandStats.hxx"
+#include "input/cache/Manager.hxx"
+#include "input/cache/Disk.hxx"
+#include "output/Control.hxx"
+#include "tag/Pool.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/Stats.hxx"
+#include "db/update/Service.hxx"
+#endif
+
+#include <chrono>
+#include <iterator>
+#include <list>
+#include <vector>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+namespace {
+
+/**
+ * Helper class which formats samples in the Prometheus text format.
+ */
+class MetricsWriter {
+	std::string &out;
+
+public:
+	explicit MetricsWriter(std::string &_out) noexcept:out(_out) {}
+
+	/**
+	 * Write the "HELP" and "TYPE" lines of a metric.  All of its
+	 * samples must follow immediately.
+	 */
+	void Begin(const char *name, const char *type, const char *help) {
+		out.append("# HELP ").append(name).append(" ")
+			.append(help).append("\n");
+		out.append("# TYPE ").append(name).append(" ")
+			.append(type).append("\n");
+	}
+
+	void Integer(const char *name, const std::string &labels,
+		     uint64_t value) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), " %" PRIu64 "\n", value);
+		out.append(name).append(labels).append(buffer);
+	}
+
+	template<typename R, typename P>
+	void Seconds(const char *name, const std::string &labels,
+		     std::chrono::duration<R, P> value) {
+		const auto s = std::chrono::duration_cast<std::chrono::duration<double>>(value);
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), " %.6f\n", s.count());
+		out.append(name).append(labels).append(buffer);
+	}
+};
+
+} // namespace
+
+/**
+ * Append a label to a label set (e.g. '{name="value"}'), escaping
+ * the value.
+ */
+static std::string
+AddLabel(std::string labels, const char *name, const char *value)
+{
+	if (labels.empty())
+		labels.push_back('{');
+	else {
+		/* replace the closing brace */
+		labels.back() = ',';
+	}
+
+	labels.append(name).append("=\"");
+	for (const char *p = value; *p != 0; ++p) {
+		switch (*p) {
+		case '\\':
+			labels.append("\\\\");
+			break;
+
+		case '"':
+			labels.append("\\\"");
+			break;
+
+		case '\n':
+			labels.append("\\n");
+			break;
+
+		default:
+			labels.push_back(*p);
+		}
+	}
+
+	labels.append("\"}");
+	return labels;
+}
+
+static void
+ExportClients(MetricsWriter &w, const ClientList &client_list)
+{
+	w.Begin("mpd_clients", "gauge",
+		"Number of connected clients");
+	w.Integer("mpd_clients", {}, client_list.GetSize());
+
+	w.Begin("mpd_clients_max", "gauge",
+		"Maximum number of clients (max_connections)");
+	w.Integer("mpd_clients_max", {}, client_list.GetMaxSize());
+
+	w.Begin("mpd_client_connections_total", "counter",
+		"Number of accepted client connections");
+	w.Integer("mpd_client_connections_total", {},
+		  client_list.GetAcceptedCount());
+
+	w.Begin("mpd_client_connections_rejected_total", "counter",
+		"Number of client connections rejected because max_connections was reached");
+	w.Integer("mpd_client_connections_rejected_total", {},
+		  client_list.GetRejectedCount());
+}
+
+static void
+ExportCommands(MetricsWriter &w)
+{
+	w.Begin("mpd_command_calls_total", "counter",
+		"Number of calls per protocol command");
+	command_stats_for_each([&w](const char *name, const CommandStats &s){
+		w.Integer("mpd_command_calls_total",
+			  AddLabel({}, "command", name), s.GetCalls());
+	});
+
+	w.Begin("mpd_command_errors_total", "counter",
+		"Number of failed calls per protocol command");
+	command_stats_for_each([&w](const char *name, const CommandStats &s){
+		w.Integer("mpd_command_errors_total",
+			  AddLabel({}, "command", name), s.GetErrors());
+	});
+
+	w.Begin("mpd_command_response_bytes_total", "counter",
+		"Size of the responses per protocol command");
+	command_stats_for_each([&w](const char *name, const CommandStats &s){
+		w.Integer("mpd_command_response_bytes_total",
+			  AddLabel({}, "command", name), s.GetBytes());
+	});
+
+	w.Begin("mpd_command_duration_seconds", "histogram",
+		"Execution time per protocol command");
+	command_stats_for_each([&w](const char *name, const CommandStats &s){
+		const auto labels = AddLabel({}, "command", name);
+
+		/* Prometheus histogram buckets are cumulative */
+		uint64_t count = 0;
+		for (size_t i = 0; i < CommandStats::N_BUCKETS - 1; ++i) {
+			count += s.GetBucket(i);
+
+			char le[32];
+			snprintf(le, sizeof(le), "%g",
+				 std::chrono::duration_cast<std::chrono::duration<double>>(CommandStats::GetBucketLimit(i)).count());
+			w.Integer("mpd_command_duration_seconds_bucket",
+				  AddLabel(labels, "le", le), count);
+		}
+
+		w.Integer("mpd_command_duration_seconds_bucket",
+			  AddLabel(labels, "le", "+Inf"), s.GetCalls());
+		w.Seconds("mpd_command_duration_seconds_sum", labels,
+			  s.GetTotalTime());
+		w.Integer("mpd_command_duration_seconds_count", labels,
+			  s.GetCalls());
+	});
+}
+
+static void
+ExportPlayer(MetricsWriter &w, const std::list<Partition> &partitions)
+{
+	std::vector<PlayerMetrics> metrics;
+	metrics.reserve(partitions.size());
+	for (const auto &partition : partitions)
+		metrics.push_back(partition.pc.LockGetMetrics());
+
+	w.Begin("mpd_music_buffer_chunks", "gauge",
+		"Size of the audio buffer in chunks");
+	auto m = metrics.begin();
+	for (const auto &partition : partitions)
+		w.Integer("mpd_music_buffer_chunks",
+			  AddLabel({}, "partition", partition.name.c_str()),
+			  (m++)->buffer_size);
+
+	w.Begin("mpd_music_buffer_used_chunks", "gauge",
+		"Number of audio buffer chunks in use");
+	m = metrics.begin();
+	for (const auto &partition : partitions)
+		w.Integer("mpd_music_buffer_used_chunks",
+			  AddLabel({}, "partition", partition.name.c_str()),
+			  (m++)->buffer_used);
+
+	w.Begin("mpd_music_pipe_chunks", "gauge",
+		"Number of decoded chunks waiting to be played");
+	m = metrics.begin();
+	for (const auto &partition : partitions)
+		w.Integer("mpd_music_pipe_chunks",
+			  AddLabel({}, "partition", partition.name.c_str()),
+			  (m++)->pipe_size);
+
+	w.Begin("mpd_decoder_cpu_seconds_total", "counter",
+		"CPU time consumed by the decoder thread");
+	m = metrics.begin();
+	for (const auto &partition : partitions) {
+		const auto &i = *m++;
+		if (i.decoder_cpu_time.count() >= 0)
+			w.Seconds("mpd_decoder_cpu_seconds_total",
+				  AddLabel({}, "partition",
+					   partition.name.c_str()),
+				  i.decoder_cpu_time);
+	}
+}
+
+static void
+ExportOutputs(MetricsWriter &w, const std::list<Partition> &partitions)
+{
+	struct Item {
+		std::string labels;
+		AudioOutputControl::Metrics metrics;
+	};
+
+	std::vector<Item> items;
+	for (const auto &partition : partitions) {
+		const auto labels = AddLabel({}, "partition",
+					     partition.name.c_str());
+		const auto &outputs = partition.outputs;
+		for (unsigned i = 0, n = outputs.Size(); i < n; ++i) {
+			const auto &ao = outputs.Get(i);
+			items.push_back({AddLabel(labels, "output",
+						  ao.GetName()),
+					 ao.LockGetMetrics()});
+		}
+	}
+
+	w.Begin("mpd_output_underruns_total", "counter",
+		"Number of times the output ran out of audio data");
+	for (const auto &i : items)
+		w.Integer("mpd_output_underruns_total", i.labels,
+			  i.metrics.underruns);
+
+	w.Begin("mpd_output_delay_seconds_total", "counter",
+		"Time the output thread waited for the device's delay");
+	for (const auto &i : items)
+		w.Seconds("mpd_output_delay_seconds_total", i.labels,
+			  i.metrics.delay_time);
+
+	w.Begin("mpd_output_xruns_total", "counter",
+		"Number of xruns reported by the output device");
+	for (const auto &i : items)
+		w.Integer("mpd_output_xruns_total", i.labels,
+			  i.metrics.xruns);
+
+	w.Begin("mpd_output_played_bytes_total", "counter",
+		"Number of bytes submitted to the output device");
+	for (const auto &i : items)
+		w.Integer("mpd_output_played_bytes_total", i.labels,
+			  i.metrics.bytes_played);
+
+	w.Begin("mpd_output_play_calls_total", "counter",
+		"Number of calls to the output plugin's play method");
+	for (const auto &i : items)
+		w.Integer("mpd_output_play_calls_total", i.labels,
+			  i.metrics.play_calls);
+
+	w.Begin("mpd_output_play_seconds_total", "counter",
+		"Time spent in the output plugin's play method");
+	for (const auto &i : items)
+		w.Seconds("mpd_output_play_seconds_total", i.labels,
+			  i.metrics.play_time);
+
+	w.Begin("mpd_output_play_max_seconds", "gauge",
+		"Longest call to the output plugin's play method");
+	for (const auto &i : items)
+		w.Seconds("mpd_output_play_max_seconds", i.labels,
+			  i.metrics.max_play_time);
+
+	w.Begin("mpd_output_filter_cpu_seconds_total", "counter",
+		"CPU time spent in the output's filter chain");
+	for (const auto &i : items)
+		w.Seconds("mpd_output_filter_cpu_seconds_total", i.labels,
+			  i.metrics.filter_cpu_time);
+}
+
+static void
+ExportInputCache(MetricsWriter &w, const InputCacheManager &cache)
+{
+	w.Begin("mpd_input_cache_bytes", "gauge",
+		"Total size of the files in the input cache");
+	w.Integer("mpd_input_cache_bytes", {}, cache.LockGetSize());
+
+	w.Begin("mpd_input_cache_max_bytes", "gauge",
+		"Maximum size of the input cache");
+	w.Integer("mpd_input_cache_max_bytes", {}, cache.GetMaxSize());
+
+	const auto stats = cache.LockGetStats();
+
+	w.Begin("mpd_input_cache_hits_total", "counter",
+		"Number of files which were found in the input cache");
+	w.Integer("mpd_input_cache_hits_total", {}, stats.hits);
+
+	w.Begin("mpd_input_cache_misses_total", "counter",
+		"Number of files which were not found in the input cache");
+	w.Integer("mpd_input_cache_misses_total", {}, stats.misses);
+
+	w.Begin("mpd_input_cache_evictions_total", "counter",
+		"Number of files which were evicted from the input cache");
+	w.Integer("mpd_input_cache_evictions_total", {}, stats.evictions);
+
+	const auto *disk = cache.GetDisk();
+	if (disk == nullptr)
+		return;
+
+	w.Begin("mpd_input_cache_disk_bytes", "gauge",
+		"Total size of the files in the on-disk input cache");
+	w.Integer("mpd_input_cache_disk_bytes", {}, disk->LockGetSize());
+
+	w.Begin("mpd_input_cache_disk_max_bytes", "gauge",
+		"Maximum size of the on-disk input cache");
+	w.Integer("mpd_input_cache_disk_max_bytes", {}, disk->GetMaxSize());
+}
+
+static void
+ExportTagPool(MetricsWriter &w)
+{
+	const auto stats = tag_pool_get_stats();
+
+	w.Begin("mpd_tag_pool_items", "gauge",
+		"Number of distinct tag values in memory");
+	w.Integer("mpd_tag_pool_items", {}, stats.items);
+}
+
+static void
+ExportLog(MetricsWriter &w)
+{
+	w.Begin("mpd_log_dropped_total", "counter",
+		"Number of log messages dropped because the log buffer was full");
+	w.Integer("mpd_log_dropped_total", {}, LogGetDropped());
+}
+
+static void
+ExportEventLoops(MetricsWriter &w, Instance &instance)
+{
+	const struct {
+		const char *name;
+		EventLoop &loop;
+	} loops[] = {
+		{ "main", instance.event_loop },
+		{ "io", instance.io_thread.GetEventLoop() },
+		{ "rtio", instance.rtio_thread.GetEventLoop() },
+	};
+
+	EventLoop::DeferStats stats[std::size(loops)];
+	for (size_t i = 0; i < std::size(loops); ++i)
+		stats[i] = loops[i].loop.GetDeferStats();
+
+	w.Begin("mpd_event_loop_deferred_total", "counter",
+		"Number of DeferEvents queued in the event loop");
+	for (size_t i = 0; i < std::size(loops); ++i)
+		w.Integer("mpd_event_loop_deferred_total",
+			  AddLabel({}, "loop", loops[i].name),
+			  stats[i].deferred);
+
+	w.Begin("mpd_event_loop_deferred_coalesced_total", "counter",
+		"Number of DeferEvent schedules merged with a pending one");
+	for (size_t i = 0; i < std::size(loops); ++i)
+		w.Integer("mpd_event_loop_deferred_coalesced_total",
+			  AddLabel({}, "loop", loops[i].name),
+			  stats[i].coalesced);
+
+	w.Begin("mpd_event_loop_wakeups_total", "counter",
+		"Number of cross-thread wakeups of the event loop");
+	for (size_t i = 0; i < std::size(loops); ++i)
+		w.Integer("mpd_event_loop_wakeups_total",
+			  AddLabel({}, "loop", loops[i].name),
+			  stats[i].wakeups);
+}
+
+#ifdef ENABLE_DATABASE
+
+static void
+ExportDatabase(MetricsWriter &w, const Database &db)
+{
+	const auto *stats = stats_get(db);
+	if (stats == nullptr)
+		return;
+
+	w.Begin("mpd_database_songs", "gauge",
+		"Number of songs in the database");
+	w.Integer("mpd_database_songs", {}, stats->song_count);
+
+	w.Begin("mpd_database_artists", "gauge",
+		"Number of artists in the database");
+	w.Integer("mpd_database_artists", {}, stats->artist_count);
+
+	w.Begin("mpd_database_albums", "gauge",
+		"Number of albums in the database");
+	w.Integer("mpd_database_albums", {}, stats->album_count);
+
+	if (stats->song_memory > 0) {
+		w.Begin("mpd_database_song_memory_bytes", "gauge",
+			"Memory used by the song objects of the database");
+		w.Integer("mpd_database_song_memory_bytes", {},
+			  stats->song_memory);
+	}
+}
+
+static void
+ExportUpdate(MetricsWriter &w, const UpdateService &update)
+{
+	w.Begin("mpd_database_updates_total", "counter",
+		"Number of finished database updates");
+	w.Integer("mpd_database_updates_total", {},
+		  update.GetFinishedCount());
+
+	w.Begin("mpd_database_update_seconds_total", "counter",
+		"Total duration of all database updates");
+	w.Seconds("mpd_database_update_seconds_total", {},
+		  update.GetTotalDuration());
+
+	w.Begin("mpd_database_last_update_seconds", "gauge",
+		"Duration of the most recent database update");
+	w.Seconds("mpd_database_last_update_seconds", {},
+		  update.GetLastDuration());
+}
+
+#endif
+
+std::string
+ExportMetrics(Instance &instance) noexcept
+{
+	std::string out;
+	MetricsWriter w(out);
+
+	if (instance.client_list)
+		ExportClients(w, *instance.client_list);
+
+	ExportCommands(w);
+	ExportPlayer(w, instance.partitions);
+	ExportOutputs(w, instance.partitions);
+
+	if (instance.input_cache)
+		ExportInputCache(w, *instance.input_cache);
+
+	ExportTagPool(w);
+	ExportLog(w);
+	ExportEventLoops(w, instance);
+
+#ifdef ENABLE_DATABASE
+	const Database *db = instance.GetDatabase();
+	if (db != nullptr)
+		ExportDatabase(w, *db);
+
+	if (instance.update != nullptr)
+		ExportUpdate(w, *instance.update);
+#endif
+
+	return out;
+}
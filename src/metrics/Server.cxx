@@ -0,0 +1,223 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "Server.hxx"
+#include "Export.hxx"
+#include "config/Block.hxx"
+#include "config/Net.hxx"
+#include "net/SocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/Domain.hxx"
+#include "util/StringFormat.hxx"
+#include "util/RuntimeError.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr Domain metrics_domain("metrics");
+
+/**
+ * Idle connections are closed after this duration.
+ */
+static constexpr std::chrono::steady_clock::duration METRICS_TIMEOUT =
+	std::chrono::seconds(30);
+
+MetricsServer::Connection::Connection(MetricsServer &_server,
+				      UniqueSocketDescriptor &&_fd) noexcept
+	:FullyBufferedSocket(_fd.Release(), _server.GetEventLoop(),
+			     16384, 4 * 1024 * 1024),
+	 server(_server),
+	 timeout_event(_server.GetEventLoop(), BIND_THIS_METHOD(OnTimeout))
+{
+	timeout_event.Schedule(METRICS_TIMEOUT);
+}
+
+MetricsServer::Connection::~Connection() noexcept
+{
+	if (IsDefined())
+		FullyBufferedSocket::Close();
+}
+
+bool
+MetricsServer::Connection::HandleLine(const char *line) noexcept
+{
+	assert(state != State::RESPONSE);
+
+	if (state == State::HEADERS) {
+		if (*line == 0)
+			/* empty line: request is finished */
+			state = State::RESPONSE;
+
+		return true;
+	}
+
+	if (strncmp(line, "HEAD /", 6) == 0) {
+		line += 5;
+		head_method = true;
+	} else if (strncmp(line, "GET /", 5) == 0) {
+		line += 4;
+	} else {
+		/* only GET is supported */
+		LogWarning(metrics_domain,
+			   "malformed request line from client");
+		return false;
+	}
+
+	found = strncmp(line, "/metrics", 8) == 0 &&
+		(line[8] == ' ' || line[8] == '\0' || line[8] == '?');
+
+	line = strchr(line, ' ');
+	if (line == nullptr || strncmp(line + 1, "HTTP/", 5) != 0)
+		/* HTTP/0.9 without request headers */
+		state = State::RESPONSE;
+	else
+		/* after the request line, request headers follow */
+		state = State::HEADERS;
+
+	return true;
+}
+
+bool
+MetricsServer::Connection::SendResponse() noexcept
+{
+	assert(state == State::RESPONSE);
+
+	std::string body = found
+		? ExportMetrics(server.instance)
+		: std::string("Not found\n");
+
+	const auto header =
+		StringFormat<256>("HTTP/1.1 %s\r\n"
+				  "Content-Type: %s\r\n"
+				  "Content-Length: %zu\r\n"
+				  "Connection: close\r\n"
+				  "\r\n",
+				  found ? "200 OK" : "404 Not Found",
+				  found
+				  ? "text/plain; version=0.0.4; charset=utf-8"
+				  : "text/plain",
+				  body.size());
+
+	if (!Write(header.c_str(), strlen(header.c_str())))
+		return false;
+
+	if (!head_method && !Write(body.data(), body.size()))
+		return false;
+
+	return true;
+}
+
+void
+MetricsServer::Connection::OnTimeout() noexcept
+{
+	delete this;
+}
+
+BufferedSocket::InputResult
+MetricsServer::Connection::OnSocketInput(void *data, size_t length) noexcept
+{
+	if (state == State::RESPONSE)
+		/* ignore everything after the request */
+		return InputResult::PAUSE;
+
+	char *line = (char *)data;
+	char *newline = (char *)memchr(line, '\n', length);
+	if (newline == nullptr)
+		return InputResult::MORE;
+
+	ConsumeInput(newline + 1 - line);
+
+	if (newline > line && newline[-1] == '\r')
+		--newline;
+
+	/* terminate the string at the end of the line */
+	*newline = 0;
+
+	if (!HandleLine(line)) {
+		delete this;
+		return InputResult::CLOSED;
+	}
+
+	if (state == State::RESPONSE) {
+		if (!SendResponse())
+			return InputResult::CLOSED;
+
+		/* the response is complete; wait for
+		   OnSocketOutputDrained() */
+		return InputResult::PAUSE;
+	}
+
+	return InputResult::AGAIN;
+}
+
+void
+MetricsServer::Connection::OnSocketError(std::exception_ptr ep) noexcept
+{
+	LogError(ep);
+	delete this;
+}
+
+void
+MetricsServer::Connection::OnSocketClosed() noexcept
+{
+	delete this;
+}
+
+void
+MetricsServer::Connection::OnSocketOutputDrained() noexcept
+{
+	if (state != State::RESPONSE)
+		return;
+
+	/* the response has been sent; close the socket now, but
+	   delete this object later, because we're inside
+	   FullyBufferedSocket::Flush() */
+	FullyBufferedSocket::Close();
+	timeout_event.Schedule(std::chrono::steady_clock::duration::zero());
+}
+
+MetricsServer::MetricsServer(EventLoop &_loop, Instance &_instance,
+			     const ConfigBlock &block)
+	:ServerSocket(_loop), instance(_instance)
+{
+	const auto *port = block.GetBlockParam("port");
+	if (port == nullptr)
+		throw FormatRuntimeError("Missing \"port\" in metrics block on line %d",
+					 block.line);
+
+	ServerSocketAddGeneric(*this, block.GetBlockValue("bind_to_address"),
+			       port->GetPositiveValue());
+
+	Open();
+}
+
+MetricsServer::~MetricsServer() noexcept
+{
+	connections.clear_and_dispose(DeleteDisposer());
+}
+
+void
+MetricsServer::OnAccept(UniqueSocketDescriptor fd,
+			SocketAddress, int) noexcept
+{
+	connections.push_back(*new Connection(*this, std::move(fd)));
+}
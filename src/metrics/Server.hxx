@@ -0,0 +1,128 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_METRICS_SERVER_HXX
+#define MPD_METRICS_SERVER_HXX
+
+#include "event/ServerSocket.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "event/CoarseTimerEvent.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+struct ConfigBlock;
+struct Instance;
+
+/**
+ * A minimal HTTP server which exports internal counters and gauges
+ * at "/metrics" in the Prometheus text format.  It is configured
+ * with a "metrics" block.
+ *
+ * @see ExportMetrics()
+ */
+class MetricsServer final : public ServerSocket {
+	Instance &instance;
+
+	class Connection final
+		: FullyBufferedSocket,
+		  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+
+		MetricsServer &server;
+
+		/**
+		 * Closes idle connections, and deletes this object
+		 * after the response has been sent.
+		 */
+		CoarseTimerEvent timeout_event;
+
+		enum class State {
+			/**
+			 * Waiting for the request line.
+			 */
+			REQUEST,
+
+			/**
+			 * Skipping the request headers.
+			 */
+			HEADERS,
+
+			/**
+			 * The response is being sent.
+			 */
+			RESPONSE,
+		} state = State::REQUEST;
+
+		bool head_method = false;
+
+		/**
+		 * Was "/metrics" requested?
+		 */
+		bool found = false;
+
+	public:
+		Connection(MetricsServer &_server,
+			   UniqueSocketDescriptor &&_fd) noexcept;
+		~Connection() noexcept;
+
+		Connection(const Connection &) = delete;
+		Connection &operator=(const Connection &) = delete;
+
+	private:
+		/**
+		 * @return false if the request is malformed
+		 */
+		bool HandleLine(const char *line) noexcept;
+
+		/**
+		 * @return false if the socket has been closed
+		 */
+		bool SendResponse() noexcept;
+
+		void OnTimeout() noexcept;
+
+		/* virtual methods from class BufferedSocket */
+		InputResult OnSocketInput(void *data,
+					  size_t length) noexcept override;
+		void OnSocketError(std::exception_ptr ep) noexcept override;
+		void OnSocketClosed() noexcept override;
+
+		/* virtual methods from class FullyBufferedSocket */
+		void OnSocketOutputDrained() noexcept override;
+	};
+
+	boost::intrusive::list<Connection,
+			       boost::intrusive::constant_time_size<false>> connections;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	MetricsServer(EventLoop &_loop, Instance &_instance,
+		      const ConfigBlock &block);
+
+	~MetricsServer() noexcept;
+
+private:
+	/* virtual methods from class ServerSocket */
+	void OnAccept(UniqueSocketDescriptor fd,
+		      SocketAddress address, int uid) noexcept override;
+};
+
+#endif
@@ -75,6 +75,7 @@ mixer_close_internal(Mixer *mixer)
 
 	mixer->Close();
 	mixer->open = false;
+	mixer->cached_volume.store(-1, std::memory_order_relaxed);
 }
 
 void
@@ -122,12 +123,29 @@ mixer_get_volume(Mixer *mixer)
 	const std::lock_guard<Mutex> protect(mixer->mutex);
 
 	if (mixer->open) {
+		if (mixer->volume_events) {
+			/* the plugin keeps this up to date; no need
+			   to ask the sound hardware/server */
+			volume = mixer->cached_volume.load(std::memory_order_relaxed);
+			if (volume >= 0)
+				return volume;
+		}
+
 		try {
 			volume = mixer->GetVolume();
 		} catch (...) {
 			mixer_failed(mixer);
 			throw;
 		}
+
+		if (mixer->volume_events) {
+			/* don't overwrite a newer value which was
+			   submitted by VolumeChanged() meanwhile */
+			int expected = -1;
+			mixer->cached_volume.compare_exchange_strong(expected,
+								     volume,
+								     std::memory_order_relaxed);
+		}
 	} else
 		volume = -1;
 
@@ -145,6 +163,12 @@ mixer_set_volume(Mixer *mixer, unsigned volume)
 
 	const std::lock_guard<Mutex> protect(mixer->mutex);
 
-	if (mixer->open)
+	if (mixer->open) {
+		/* the plugin may round the value; read it back
+		   with the next mixer_get_volume() call (unless
+		   VolumeChanged() reports it earlier) */
+		mixer->cached_volume.store(-1, std::memory_order_relaxed);
+
 		mixer->SetVolume(volume);
+	}
 }
@@ -22,10 +22,11 @@
 
 #include "MixerPlugin.hxx"
 #include "MixerList.hxx"
+#include "Listener.hxx"
 #include "thread/Mutex.hxx"
 #include "util/Compiler.h"
 
-class MixerListener;
+#include <atomic>
 
 class Mixer {
 public:
@@ -50,10 +51,25 @@ public:
 	 */
 	bool failed = false;
 
+	/**
+	 * Does the plugin report all volume changes with
+	 * VolumeChanged()?  Then mixer_get_volume() returns
+	 * #cached_volume instead of calling GetVolume() each time.
+	 */
+	const bool volume_events;
+
+	/**
+	 * The volume most recently obtained from the plugin; -1 if
+	 * unknown.  Only used if #volume_events is set.
+	 */
+	std::atomic_int cached_volume{-1};
+
 public:
 	explicit Mixer(const MixerPlugin &_plugin,
-		       MixerListener &_listener) noexcept
-		:plugin(_plugin), listener(_listener) {}
+		       MixerListener &_listener,
+		       bool _volume_events=false) noexcept
+		:plugin(_plugin), listener(_listener),
+		 volume_events(_volume_events) {}
 
 	Mixer(const Mixer &) = delete;
 
@@ -93,6 +109,21 @@ public:
 	 * @param volume the new volume (0..100 including)
 	 */
 	virtual void SetVolume(unsigned volume) = 0;
+
+protected:
+	/**
+	 * The plugin calls this after it has been notified about a
+	 * volume change, e.g. by the sound server.  It updates the
+	 * cache (if #volume_events is set) and notifies the
+	 * #MixerListener.  May be called from any thread.
+	 *
+	 * @param volume the new volume (0..100 including) or -1 if
+	 * unavailable
+	 */
+	void VolumeChanged(int volume) noexcept {
+		cached_volume.store(volume, std::memory_order_relaxed);
+		listener.OnMixerVolumeChanged(*this, volume);
+	}
 };
 
 #endif
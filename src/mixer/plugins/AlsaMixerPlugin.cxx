@@ -41,19 +41,24 @@ extern "C" {
 #define VOLUME_MIXER_ALSA_CONTROL_DEFAULT	"PCM"
 static constexpr unsigned VOLUME_MIXER_ALSA_INDEX_DEFAULT = 0;
 
+class AlsaMixer;
+
 class AlsaMixerMonitor final : MultiSocketMonitor {
 	DeferEvent defer_invalidate_sockets;
 
+	AlsaMixer &owner;
+
 	snd_mixer_t *mixer;
 
 	AlsaNonBlockMixer non_block;
 
 public:
-	AlsaMixerMonitor(EventLoop &_loop, snd_mixer_t *_mixer)
+	AlsaMixerMonitor(EventLoop &_loop, AlsaMixer &_owner,
+			 snd_mixer_t *_mixer)
 		:MultiSocketMonitor(_loop),
 		 defer_invalidate_sockets(_loop,
 					  BIND_THIS_METHOD(InvalidateSockets)),
-		 mixer(_mixer) {
+		 owner(_owner), mixer(_mixer) {
 		defer_invalidate_sockets.Schedule();
 	}
 
@@ -83,7 +88,7 @@ class AlsaMixer final : public Mixer {
 
 public:
 	AlsaMixer(EventLoop &_event_loop, MixerListener &_listener)
-		:Mixer(alsa_mixer_plugin, _listener),
+		:Mixer(alsa_mixer_plugin, _listener, true),
 		 event_loop(_event_loop) {}
 
 	virtual ~AlsaMixer();
@@ -91,6 +96,27 @@ public:
 	void Configure(const ConfigBlock &block);
 	void Setup();
 
+	/**
+	 * Called by libasound (from inside snd_mixer_handle_events())
+	 * when the value of the mixer element has changed.
+	 */
+	void OnElemValueChanged() noexcept {
+		VolumeChanged(GetVolumeInternal());
+	}
+
+	/**
+	 * Called by #AlsaMixerMonitor when the sound device has
+	 * disappeared.
+	 */
+	void OnDeviceGone() noexcept {
+		VolumeChanged(-1);
+	}
+
+private:
+	int GetVolumeInternal() const noexcept;
+
+public:
+
 	/* virtual methods from class Mixer */
 	void Open() override;
 	void Close() noexcept override;
@@ -129,6 +155,7 @@ AlsaMixerMonitor::DispatchSockets() noexcept
 			   this GSource */
 			mixer = nullptr;
 			InvalidateSockets();
+			owner.OnDeviceGone();
 			return;
 		}
 	}
@@ -145,13 +172,8 @@ alsa_mixer_elem_callback(snd_mixer_elem_t *elem, unsigned mask)
 	AlsaMixer &mixer = *(AlsaMixer *)
 		snd_mixer_elem_get_callback_private(elem);
 
-	if (mask & SND_CTL_EVENT_MASK_VALUE) {
-		try {
-			int volume = mixer.GetVolume();
-			mixer.listener.OnMixerVolumeChanged(mixer, volume);
-		} catch (...) {
-		}
-	}
+	if (mask & SND_CTL_EVENT_MASK_VALUE)
+		mixer.OnElemValueChanged();
 
 	return 0;
 }
@@ -230,7 +252,7 @@ AlsaMixer::Setup()
 	snd_mixer_elem_set_callback_private(elem, this);
 	snd_mixer_elem_set_callback(elem, alsa_mixer_elem_callback);
 
-	monitor = new AlsaMixerMonitor(event_loop, handle);
+	monitor = new AlsaMixerMonitor(event_loop, *this, handle);
 }
 
 void
@@ -274,6 +296,12 @@ AlsaMixer::GetVolume()
 		throw FormatRuntimeError("snd_mixer_handle_events() failed: %s",
 					 snd_strerror(err));
 
+	return GetVolumeInternal();
+}
+
+int
+AlsaMixer::GetVolumeInternal() const noexcept
+{
 	return lrint(100 * get_normalized_playback_volume(elem, SND_MIXER_SCHN_FRONT_LEFT));
 }
 
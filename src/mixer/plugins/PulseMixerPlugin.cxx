@@ -48,7 +48,7 @@ class PulseMixer final : public Mixer {
 public:
 	PulseMixer(PulseOutput &_output, MixerListener &_listener,
 		   double _volume_scale_factor)
-		:Mixer(pulse_mixer_plugin, _listener),
+		:Mixer(pulse_mixer_plugin, _listener, true),
 		 output(_output),
 		 volume_scale_factor(_volume_scale_factor)
 	{
@@ -80,7 +80,7 @@ PulseMixer::Offline()
 
 	online = false;
 
-	listener.OnMixerVolumeChanged(*this, -1);
+	VolumeChanged(-1);
 }
 
 inline void
@@ -97,7 +97,7 @@ PulseMixer::VolumeCallback(const pa_sink_input_info *i, int eol)
 	online = true;
 	volume = i->volume;
 
-	listener.OnMixerVolumeChanged(*this, GetVolumeInternal());
+	VolumeChanged(GetVolumeInternal());
 }
 
 /**
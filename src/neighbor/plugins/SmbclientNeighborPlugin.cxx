@@ -33,7 +33,25 @@
 
 #include <libsmbclient.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <utility>
+#include <vector>
+
+/**
+ * The delay between two scans after a change was seen.
+ */
+static constexpr std::chrono::steady_clock::duration MIN_SCAN_INTERVAL =
+	std::chrono::seconds(10);
+
+/**
+ * If the network does not change, the delay between two scans is
+ * doubled each time up to this value.
+ */
+static constexpr std::chrono::steady_clock::duration MAX_SCAN_INTERVAL =
+	std::chrono::minutes(5);
 
 class SmbclientNeighborExplorer final : public NeighborExplorer {
 	struct Server {
@@ -58,11 +76,25 @@ class SmbclientNeighborExplorer final : public NeighborExplorer {
 
 	Thread thread;
 
-	mutable Mutex mutex;
+	/**
+	 * Protects #quit.
+	 */
+	Mutex mutex;
 	Cond cond;
 
+	/**
+	 * The servers seen by the last scan.  Only accessed by the
+	 * thread.
+	 */
 	List list;
 
+	/**
+	 * A copy of #list for GetList().  It is replaced (with
+	 * std::atomic_store()) after each scan which has found a
+	 * change, so GetList() never waits for a scan.
+	 */
+	std::shared_ptr<const List> snapshot;
+
 	bool quit;
 
 public:
@@ -77,9 +109,12 @@ public:
 
 private:
 	/**
-	 * Caller must lock the mutex.
+	 * Scan the network and update #list.  Caller must not lock
+	 * the mutex.
+	 *
+	 * @return true if a server was found or lost
 	 */
-	void Run() noexcept;
+	bool Run() noexcept;
 
 	void ThreadFunc() noexcept;
 };
@@ -106,13 +141,8 @@ SmbclientNeighborExplorer::Close() noexcept
 NeighborExplorer::List
 SmbclientNeighborExplorer::GetList() const noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
-	/*
-	List list;
-	for (const auto &i : servers)
-		list.emplace_front(i.Export());
-	*/
-	return list;
+	const auto s = std::atomic_load(&snapshot);
+	return s != nullptr ? *s : List();
 }
 
 static void
@@ -124,56 +154,53 @@ ReadServer(NeighborExplorer::List &list, const smbc_dirent &e) noexcept
 	list.emplace_front("smb://" + name, name + " (" + comment + ")");
 }
 
+/**
+ * List the servers in the given workgroup (or the workgroups if
+ * the URI is "smb://") and recurse into workgroups.
+ *
+ * The #smbclient_mutex is only held while one directory is being
+ * read, not during the whole network scan, so the smbclient
+ * storage plugin is not blocked for long.
+ */
 static void
-ReadServers(NeighborExplorer::List &list, const char *uri) noexcept;
-
-static void
-ReadWorkgroup(NeighborExplorer::List &list, const std::string &name) noexcept
+ReadServers(NeighborExplorer::List &list, const char *uri) noexcept
 {
-	std::string uri = "smb://" + name;
-	ReadServers(list, uri.c_str());
-}
+	std::vector<std::string> workgroups;
 
-static void
-ReadEntry(NeighborExplorer::List &list, const smbc_dirent &e) noexcept
-{
-	switch (e.smbc_type) {
-	case SMBC_WORKGROUP:
-		ReadWorkgroup(list, std::string(e.name, e.namelen));
-		break;
-
-	case SMBC_SERVER:
-		ReadServer(list, e);
-		break;
-	}
-}
+	{
+		const std::lock_guard<Mutex> protect(smbclient_mutex);
 
-static void
-ReadServers(NeighborExplorer::List &list, int fd) noexcept
-{
-	smbc_dirent *e;
-	while ((e = smbc_readdir(fd)) != nullptr)
-		ReadEntry(list, *e);
-}
+		int fd = smbc_opendir(uri);
+		if (fd < 0) {
+			FormatErrno(smbclient_domain,
+				    "smbc_opendir('%s') failed", uri);
+			return;
+		}
+
+		smbc_dirent *e;
+		while ((e = smbc_readdir(fd)) != nullptr) {
+			switch (e->smbc_type) {
+			case SMBC_WORKGROUP:
+				workgroups.emplace_back(e->name, e->namelen);
+				break;
+
+			case SMBC_SERVER:
+				ReadServer(list, *e);
+				break;
+			}
+		}
 
-static void
-ReadServers(NeighborExplorer::List &list, const char *uri) noexcept
-{
-	int fd = smbc_opendir(uri);
-	if (fd >= 0) {
-		ReadServers(list, fd);
 		smbc_closedir(fd);
-	} else
-		FormatErrno(smbclient_domain, "smbc_opendir('%s') failed",
-			    uri);
+	}
+
+	for (const auto &i : workgroups)
+		ReadServers(list, ("smb://" + i).c_str());
 }
 
-gcc_pure
 static NeighborExplorer::List
 DetectServers() noexcept
 {
 	NeighborExplorer::List list;
-	const std::lock_guard<Mutex> protect(smbclient_mutex);
 	ReadServers(list, "smb://");
 	return list;
 }
@@ -191,15 +218,10 @@ FindBeforeServerByURI(NeighborExplorer::List::const_iterator prev,
 	return end;
 }
 
-inline void
+inline bool
 SmbclientNeighborExplorer::Run() noexcept
 {
-	List found, lost;
-
-	{
-		const ScopeUnlock unlock(mutex);
-		found = DetectServers();
-	}
+	List found = DetectServers(), lost;
 
 	const auto found_before_begin = found.before_begin();
 	const auto found_end = found.end();
@@ -224,13 +246,19 @@ SmbclientNeighborExplorer::Run() noexcept
 	     i != found_end; prev = i, i = std::next(prev))
 		list.push_front(*i);
 
-	const ScopeUnlock unlock(mutex);
+	if (found.empty() && lost.empty())
+		return false;
+
+	std::atomic_store(&snapshot,
+			  std::shared_ptr<const List>(std::make_shared<List>(list)));
 
 	for (auto &i : lost)
 		listener.LostNeighbor(i);
 
 	for (auto &i : found)
 		listener.FoundNeighbor(i);
+
+	return true;
 }
 
 inline void
@@ -240,14 +268,25 @@ SmbclientNeighborExplorer::ThreadFunc() noexcept
 
 	std::unique_lock<Mutex> lock(mutex);
 
+	auto interval = MIN_SCAN_INTERVAL;
+
 	while (!quit) {
-		Run();
+		bool changed;
+
+		{
+			const ScopeUnlock unlock(mutex);
+			changed = Run();
+		}
 
 		if (quit)
 			break;
 
-		// TODO: sleep for how long?
-		cond.wait_for(lock, std::chrono::seconds(10));
+		/* scan less often while nothing changes */
+		interval = changed
+			? MIN_SCAN_INTERVAL
+			: std::min(interval * 2, MAX_SCAN_INTERVAL);
+
+		cond.wait_for(lock, interval);
 	}
 }
 
@@ -40,6 +40,10 @@ class StaticSocketAddress;
 class IPv4Address;
 class IPv6Address;
 
+#ifndef _WIN32
+struct iovec;
+#endif
+
 /**
  * An OO wrapper for a UNIX socket descriptor.
  */
@@ -235,6 +239,14 @@ public:
 	ssize_t Read(void *buffer, size_t length) noexcept;
 	ssize_t Write(const void *buffer, size_t length) noexcept;
 
+#ifndef _WIN32
+	/**
+	 * Send data from several buffers with one system call (like
+	 * writev()).
+	 */
+	ssize_t Write(const struct iovec *v, size_t n) noexcept;
+#endif
+
 #ifdef _WIN32
 	int WaitReadable(int timeout_ms) const noexcept;
 	int WaitWritable(int timeout_ms) const noexcept;
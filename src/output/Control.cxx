@@ -50,6 +50,9 @@ AudioOutputControl::Configure(const ConfigBlock &block)
 	tags = block.GetBlockValue("tags", true);
 	always_on = block.GetBlockValue("always_on", false);
 	enabled = block.GetBlockValue("enabled", true);
+	source.SetCrossFadeFloat(block.GetBlockValue("crossfade_float",
+						     false));
+	source.SetBatchSize(block.GetBlockValue("batch_size", 0U));
 }
 
 const char *
@@ -82,6 +85,29 @@ AudioOutputControl::GetAttributes() const noexcept
 	return output->GetAttributes();
 }
 
+std::chrono::steady_clock::duration
+AudioOutputControl::GetLatency() const noexcept
+{
+	return output->GetLatency();
+}
+
+AudioOutputControl::Metrics
+AudioOutputControl::LockGetMetrics() const noexcept
+{
+	const unsigned xruns = output->GetXruns();
+	const auto filter_cpu_time = source.GetFilterCPUTime();
+
+	const std::lock_guard<Mutex> protect(mutex);
+	return {
+		n_underruns, delay_time,
+		xruns,
+		bytes_played, n_play_calls,
+		play_time, max_play_time,
+		filter_cpu_time,
+		delay_histogram,
+	};
+}
+
 void
 AudioOutputControl::SetAttribute(std::string &&name, std::string &&value)
 {
@@ -278,6 +304,11 @@ AudioOutputControl::IsChunkConsumed(const MusicChunk &chunk) const noexcept
 bool
 AudioOutputControl::LockIsChunkConsumed(const MusicChunk &chunk) const noexcept
 {
+	/* lock-free fast path: the output thread has already moved
+	   past this chunk */
+	if (source.IsChunkReleased(chunk))
+		return true;
+
 	const std::lock_guard<Mutex> protect(mutex);
 	return IsChunkConsumed(chunk);
 }
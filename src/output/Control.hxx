@@ -21,6 +21,7 @@
 #define MPD_OUTPUT_CONTROL_HXX
 
 #include "Source.hxx"
+#include "Pacer.hxx"
 #include "AudioFormat.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Mutex.hxx"
@@ -28,6 +29,8 @@
 #include "system/PeriodClock.hxx"
 #include "util/Compiler.h"
 
+#include <array>
+#include <chrono>
 #include <exception>
 #include <memory>
 #include <string>
@@ -46,9 +49,15 @@ class AudioOutputClient;
 /**
  * Controller for an #AudioOutput and its output thread.
  */
-class AudioOutputControl {
+class AudioOutputControl final : OutputPacer::Client {
 	std::unique_ptr<FilteredAudioOutput> output;
 
+	/**
+	 * The partition's pacer, which wakes up this output if it
+	 * has a software clock.  May be nullptr.
+	 */
+	OutputPacer *pacer = nullptr;
+
 	/**
 	 * The PlayerControl object which "owns" this output.  This
 	 * object is needed to signal command completion.
@@ -212,6 +221,59 @@ class AudioOutputControl {
 	 */
 	bool skip_delay;
 
+	/**
+	 * Set by OnPacerDeadline(); WaitForDelay() waits for it.
+	 * Protected by #mutex.
+	 */
+	bool paced = false;
+
+	/**
+	 * Has the #MusicPipe run empty?  This is used to count
+	 * #n_underruns only once per gap.
+	 */
+	bool starved = true;
+
+	/**
+	 * The number of times the #MusicPipe has run empty during
+	 * playback.
+	 */
+	unsigned n_underruns = 0;
+
+	/**
+	 * The total time spent in WaitForDelay().
+	 */
+	std::chrono::steady_clock::duration delay_time{};
+
+	/**
+	 * The number of bytes passed to AudioOutput::Play()
+	 * successfully.
+	 */
+	uint64_t bytes_played = 0;
+
+	/**
+	 * The number of successful AudioOutput::Play() calls.
+	 */
+	uint64_t n_play_calls = 0;
+
+	/**
+	 * The total and the maximum (wall clock) duration of
+	 * AudioOutput::Play() calls.
+	 */
+	std::chrono::steady_clock::duration play_time{}, max_play_time{};
+
+public:
+	/**
+	 * The number of buckets in #Metrics::delay_histogram.
+	 */
+	static constexpr std::size_t N_DELAY_BUCKETS = 5;
+
+private:
+	/**
+	 * A histogram of positive AudioOutput::Delay() return
+	 * values: up to 1ms, 10ms, 100ms, 1s and more than 1s.
+	 */
+	std::array<unsigned, N_DELAY_BUCKETS> delay_histogram{};
+
 public:
 	/**
 	 * This mutex protects #open, #fail_timer, #pipe.
@@ -231,6 +293,15 @@ public:
 	 */
 	void Configure(const ConfigBlock &block);
 
+	/**
+	 * Let the given #OutputPacer wake up this output (if it has
+	 * a software clock).  Must be called before the output
+	 * thread is started.
+	 */
+	void SetPacer(OutputPacer *_pacer) noexcept {
+		pacer = _pacer;
+	}
+
 	gcc_pure
 	const char *GetName() const noexcept;
 
@@ -285,6 +356,31 @@ public:
 		return last_error;
 	}
 
+	struct Metrics {
+		unsigned underruns;
+		std::chrono::steady_clock::duration delay_time;
+
+		/**
+		 * The number of xruns reported by the output plugin
+		 * (see AudioOutput::GetXruns()).
+		 */
+		unsigned xruns;
+
+		uint64_t bytes_played, play_calls;
+
+		std::chrono::steady_clock::duration play_time, max_play_time;
+
+		/**
+		 * The CPU time spent in the filter chain.
+		 */
+		std::chrono::nanoseconds filter_cpu_time;
+
+		std::array<unsigned, N_DELAY_BUCKETS> delay_histogram;
+	};
+
+	gcc_pure
+	Metrics LockGetMetrics() const noexcept;
+
 	void StartThread();
 
 	/**
@@ -332,6 +428,12 @@ public:
 	const std::map<std::string, std::string> GetAttributes() const noexcept;
 	void SetAttribute(std::string &&name, std::string &&value);
 
+	/**
+	 * See AudioOutput::GetLatency().
+	 */
+	gcc_pure
+	std::chrono::steady_clock::duration GetLatency() const noexcept;
+
 	/**
 	 * Enables the device, but don't wait for completion.
 	 *
@@ -511,6 +613,14 @@ private:
 	 */
 	void InternalCheckClose(bool drain) noexcept;
 
+	/**
+	 * Add a positive AudioOutput::Delay() value to
+	 * #delay_histogram.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void CountDelay(std::chrono::steady_clock::duration delay) noexcept;
+
 	/**
 	 * Wait until the output's delay reaches zero.
 	 *
@@ -561,6 +671,9 @@ private:
 	 * The OutputThread.
 	 */
 	void Task() noexcept;
+
+	/* virtual methods from class OutputPacer::Client */
+	void OnPacerDeadline() noexcept override;
 };
 
 #endif
@@ -24,7 +24,9 @@
 AudioOutputDefaults::AudioOutputDefaults(const ConfigData &config)
 	:normalize(config.GetBool(ConfigOption::VOLUME_NORMALIZATION, false)),
 	 mixer_type(mixer_type_parse(config.GetString(ConfigOption::MIXER_TYPE,
-						      "hardware")))
+						      "hardware"))),
+	 low_latency(config.GetBool(ConfigOption::LOW_LATENCY, false)),
+	 lock_memory(config.GetBool(ConfigOption::LOCK_MEMORY, false))
 
 {
 }
@@ -33,6 +33,16 @@ struct AudioOutputDefaults {
 
 	MixerType mixer_type = MixerType::HARDWARE;
 
+	/**
+	 * The "low_latency" setting.
+	 */
+	bool low_latency = false;
+
+	/**
+	 * The "lock_memory" setting.
+	 */
+	bool lock_memory = false;
+
 	constexpr AudioOutputDefaults() = default;
 
 	/**
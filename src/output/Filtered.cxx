@@ -39,12 +39,30 @@ FilteredAudioOutput::SupportsPause() const noexcept
 	return output->SupportsPause();
 }
 
+bool
+FilteredAudioOutput::HasSoftwareClock() const noexcept
+{
+	return output->HasSoftwareClock();
+}
+
 const std::map<std::string, std::string>
 FilteredAudioOutput::GetAttributes() const noexcept
 {
 	return output->GetAttributes();
 }
 
+std::chrono::steady_clock::duration
+FilteredAudioOutput::GetLatency() const noexcept
+{
+	return output->GetLatency();
+}
+
+unsigned
+FilteredAudioOutput::GetXruns() const noexcept
+{
+	return output->GetXruns();
+}
+
 void
 FilteredAudioOutput::SetAttribute(std::string &&_name, std::string &&_value)
 {
@@ -38,6 +38,7 @@ struct ConfigBlock;
 class AudioOutput;
 struct AudioOutputDefaults;
 struct ReplayGainConfig;
+class PcmConvertCache;
 struct Tag;
 
 struct FilteredAudioOutput {
@@ -68,6 +69,17 @@ public:
 	 */
 	Mixer *mixer = nullptr;
 
+	/**
+	 * Is the low-latency profile enabled ("low_latency")?
+	 */
+	bool low_latency = false;
+
+	/**
+	 * Shall the output thread lock its stack into RAM
+	 * ("lock_memory")?
+	 */
+	bool lock_memory = false;
+
 	/**
 	 * The configured audio format.
 	 */
@@ -144,7 +156,8 @@ public:
 		   const MixerPlugin *mixer_plugin,
 		   MixerListener &mixer_listener,
 		   const ConfigBlock &block,
-		   const AudioOutputDefaults &defaults);
+		   const AudioOutputDefaults &defaults,
+		   PcmConvertCache *convert_cache);
 
 	const char *GetName() const {
 		return name;
@@ -170,9 +183,21 @@ public:
 	gcc_pure
 	bool SupportsPause() const noexcept;
 
+	/**
+	 * Is the device paced by a software clock?
+	 */
+	gcc_pure
+	bool HasSoftwareClock() const noexcept;
+
 	const std::map<std::string, std::string> GetAttributes() const noexcept;
 	void SetAttribute(std::string &&name, std::string &&value);
 
+	gcc_pure
+	std::chrono::steady_clock::duration GetLatency() const noexcept;
+
+	gcc_pure
+	unsigned GetXruns() const noexcept;
+
 	/**
 	 * Throws on error.
 	 */
@@ -235,6 +260,9 @@ public:
 
 /**
  * Throws on error.
+ *
+ * @param convert_cache if not nullptr, then resampling is shared
+ * with other outputs which use the same #PcmConvertCache
  */
 std::unique_ptr<FilteredAudioOutput>
 audio_output_new(EventLoop &event_loop,
@@ -242,6 +270,7 @@ audio_output_new(EventLoop &event_loop,
 		 const ConfigBlock &block,
 		 const AudioOutputDefaults &defaults,
 		 FilterFactory *filter_factory,
-		 MixerListener &mixer_listener);
+		 MixerListener &mixer_listener,
+		 PcmConvertCache *convert_cache);
 
 #endif
@@ -26,6 +26,7 @@
 #include "mixer/MixerList.hxx"
 #include "mixer/MixerType.hxx"
 #include "mixer/MixerControl.hxx"
+#include "filter/Factory.hxx"
 #include "filter/LoadChain.hxx"
 #include "filter/Prepared.hxx"
 #include "filter/plugins/AutoConvertFilterPlugin.hxx"
@@ -34,6 +35,7 @@
 #include "filter/plugins/ChainFilterPlugin.hxx"
 #include "filter/plugins/VolumeFilterPlugin.hxx"
 #include "filter/plugins/NormalizeFilterPlugin.hxx"
+#include "pcm/ConfiguredResampler.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/StringAPI.hxx"
 #include "util/StringFormat.hxx"
@@ -48,6 +50,7 @@
 #define AUDIO_OUTPUT_NAME	"name"
 #define AUDIO_OUTPUT_FORMAT	"format"
 #define AUDIO_FILTERS		"filters"
+#define AUDIO_SHARED_FILTERS	"shared_filters"
 
 FilteredAudioOutput::FilteredAudioOutput(const char *_plugin_name,
 					 std::unique_ptr<AudioOutput> &&_output,
@@ -168,6 +171,9 @@ FilteredAudioOutput::Configure(const ConfigBlock &block,
 
 	log_name = StringFormat<256>("\"%s\" (%s)", name, plugin_name);
 
+	low_latency = defaults.low_latency;
+	lock_memory = defaults.lock_memory;
+
 	/* set up the filter chain */
 
 	prepared_filter = filter_chain_new();
@@ -181,9 +187,19 @@ FilteredAudioOutput::Configure(const ConfigBlock &block,
 	}
 
 	try {
-		if (filter_factory != nullptr)
+		if (filter_factory != nullptr) {
+			/* the shared filters come first, because
+			   their input must be the same for all
+			   outputs using them */
+			const char *shared =
+				block.GetBlockValue(AUDIO_SHARED_FILTERS);
+			if (shared != nullptr)
+				filter_chain_append(*prepared_filter, "shared",
+						    filter_factory->MakeSharedChain(shared));
+
 			filter_chain_parse(*prepared_filter, *filter_factory,
 					   block.GetBlockValue(AUDIO_FILTERS, ""));
+		}
 	} catch (...) {
 		/* It's not really fatal - Part of the filter chain
 		   has been set up already and even an empty one will
@@ -200,7 +216,8 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 			   const MixerPlugin *mixer_plugin,
 			   MixerListener &mixer_listener,
 			   const ConfigBlock &block,
-			   const AudioOutputDefaults &defaults)
+			   const AudioOutputDefaults &defaults,
+			   PcmConvertCache *convert_cache)
 {
 	if (output->GetNeedFullyDefinedAudioFormat() &&
 	    !config_audio_format.IsFullyDefined())
@@ -259,8 +276,14 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 
 	/* the "convert" filter must be the last one in the chain */
 
+	const char *resampler_name = block.GetBlockValue("resampler");
+	const PcmResamplerSetup *resampler = resampler_name != nullptr
+		? &pcm_resampler_find(resampler_name)
+		: nullptr;
+
 	filter_chain_append(*prepared_filter, "convert",
-			    convert_filter.Set(convert_filter_prepare()));
+			    convert_filter.Set(convert_filter_prepare(convert_cache,
+								      resampler)));
 }
 
 std::unique_ptr<FilteredAudioOutput>
@@ -269,7 +292,8 @@ audio_output_new(EventLoop &event_loop,
 		 const ConfigBlock &block,
 		 const AudioOutputDefaults &defaults,
 		 FilterFactory *filter_factory,
-		 MixerListener &mixer_listener)
+		 MixerListener &mixer_listener,
+		 PcmConvertCache *convert_cache)
 {
 	const AudioOutputPlugin *plugin;
 
@@ -298,12 +322,15 @@ audio_output_new(EventLoop &event_loop,
 						       block));
 	assert(ao != nullptr);
 
+	if (defaults.low_latency)
+		ao->SetLowLatency();
+
 	auto f = std::make_unique<FilteredAudioOutput>(plugin->name,
 						       std::move(ao), block,
 						       defaults,
 						       filter_factory);
 	f->Setup(event_loop, replay_gain_config,
 		 plugin->mixer_plugin,
-		 mixer_listener, block, defaults);
+		 mixer_listener, block, defaults, convert_cache);
 	return f;
 }
@@ -40,6 +40,13 @@ protected:
 	 */
 	static constexpr unsigned FLAG_NEED_FULLY_DEFINED_AUDIO_FORMAT = 0x4;
 
+	/**
+	 * This output has no hardware clock; its Delay() is
+	 * calculated by a #Timer.  The output thread then waits on
+	 * the partition's #OutputPacer.
+	 */
+	static constexpr unsigned FLAG_SOFTWARE_CLOCK = 0x8;
+
 public:
 	explicit AudioOutput(unsigned _flags):flags(_flags) {}
 	virtual ~AudioOutput() = default;
@@ -59,6 +66,10 @@ public:
 		return flags & FLAG_NEED_FULLY_DEFINED_AUDIO_FORMAT;
 	}
 
+	bool HasSoftwareClock() const {
+		return flags & FLAG_SOFTWARE_CLOCK;
+	}
+
 	/**
 	 * Returns a map of runtime attributes.
 	 *
@@ -75,6 +86,37 @@ public:
 	 */
 	virtual void SetAttribute(std::string &&name, std::string &&value);
 
+	/**
+	 * The low-latency profile ("low_latency") is enabled.  The
+	 * plugin should shrink its buffers, unless they were
+	 * configured explicitly.  This is called once, right after
+	 * construction.
+	 */
+	virtual void SetLowLatency() noexcept {}
+
+	/**
+	 * Returns the measured latency of the device, i.e. how long
+	 * it takes until data passed to Play() becomes audible.
+	 * Returns a negative value if unknown.
+	 *
+	 * This method must be thread-safe.
+	 */
+	gcc_pure
+	virtual std::chrono::steady_clock::duration GetLatency() const noexcept {
+		return std::chrono::steady_clock::duration(-1);
+	}
+
+	/**
+	 * Returns the number of underruns ("xruns") the device has
+	 * reported so far; 0 if the plugin doesn't know.
+	 *
+	 * This method must be thread-safe.
+	 */
+	gcc_pure
+	virtual unsigned GetXruns() const noexcept {
+		return 0;
+	}
+
 	/**
 	 * Enable the device.  This may allocate resources, preparing
 	 * for the device to be opened.
@@ -23,6 +23,8 @@
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
 #include "filter/Factory.hxx"
+#include "filter/SharedFilter.hxx"
+#include "pcm/SharedConvert.hxx"
 #include "config/Block.hxx"
 #include "config/Data.hxx"
 #include "config/Option.hxx"
@@ -35,7 +37,10 @@
 #include <string.h>
 
 MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener) noexcept
-	:mixer_listener(_mixer_listener)
+	:mixer_listener(_mixer_listener),
+	 convert_cache(std::make_unique<PcmConvertCache>()),
+	 filter_cache(std::make_unique<FilterCache>()),
+	 pacer(std::make_unique<OutputPacer>())
 {
 }
 
@@ -52,12 +57,14 @@ LoadOutput(EventLoop &event_loop,
 	   MixerListener &mixer_listener,
 	   const ConfigBlock &block,
 	   const AudioOutputDefaults &defaults,
-	   FilterFactory *filter_factory)
+	   FilterFactory *filter_factory,
+	   PcmConvertCache &convert_cache)
 try {
 	return audio_output_new(event_loop, replay_gain_config, block,
 				defaults,
 				filter_factory,
-				mixer_listener);
+				mixer_listener,
+				&convert_cache);
 } catch (...) {
 	if (block.line > 0)
 		std::throw_with_nested(FormatRuntimeError("Failed to configure output in line %i",
@@ -72,13 +79,17 @@ LoadOutputControl(EventLoop &event_loop,
 		  MixerListener &mixer_listener,
 		  AudioOutputClient &client, const ConfigBlock &block,
 		  const AudioOutputDefaults &defaults,
-		  FilterFactory *filter_factory)
+		  FilterFactory *filter_factory,
+		  PcmConvertCache &convert_cache,
+		  OutputPacer &pacer)
 {
 	auto output = LoadOutput(event_loop, replay_gain_config,
 				 mixer_listener,
-				 block, defaults, filter_factory);
+				 block, defaults, filter_factory,
+				 convert_cache);
 	auto control = std::make_unique<AudioOutputControl>(std::move(output), client);
 	control->Configure(block);
+	control->SetPacer(&pacer);
 	return control;
 }
 
@@ -89,7 +100,7 @@ MultipleOutputs::Configure(EventLoop &event_loop,
 			   AudioOutputClient &client)
 {
 	const AudioOutputDefaults defaults(config);
-	FilterFactory filter_factory(config);
+	FilterFactory filter_factory(config, filter_cache.get());
 
 	for (const auto &block : config.GetBlockList(ConfigBlockOption::AUDIO_OUTPUT)) {
 		block.SetUsed();
@@ -97,7 +108,8 @@ MultipleOutputs::Configure(EventLoop &event_loop,
 						replay_gain_config,
 						mixer_listener,
 						client, block, defaults,
-						&filter_factory);
+						&filter_factory,
+						*convert_cache, *pacer);
 		if (HasName(output->GetName()))
 			throw FormatRuntimeError("output devices with identical "
 						 "names: %s", output->GetName());
@@ -112,7 +124,8 @@ MultipleOutputs::Configure(EventLoop &event_loop,
 						       replay_gain_config,
 						       mixer_listener,
 						       client, empty, defaults,
-						       nullptr));
+						       nullptr,
+						       *convert_cache, *pacer));
 	}
 }
 
@@ -129,7 +142,8 @@ MultipleOutputs::AddNullOutput(EventLoop &event_loop,
 	outputs.emplace_back(LoadOutputControl(event_loop, replay_gain_config,
 					       mixer_listener,
 					       client, block, defaults,
-					       nullptr));
+					       nullptr,
+					       *convert_cache, *pacer));
 }
 
 AudioOutputControl *
@@ -287,7 +301,7 @@ MultipleOutputs::CheckPipe() noexcept
 			   provides a defined value */
 			elapsed_time = chunk->time;
 
-		const bool is_tail = chunk->next == nullptr;
+		const bool is_tail = chunk->next.load(std::memory_order_relaxed) == nullptr;
 		if (is_tail)
 			/* this is the tail of the pipe - clear the
 			   chunk reference in all outputs */
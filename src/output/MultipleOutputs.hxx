@@ -40,6 +40,8 @@
 #include <assert.h>
 
 class MusicPipe;
+class PcmConvertCache;
+class FilterCache;
 class EventLoop;
 class MixerListener;
 class AudioOutputClient;
@@ -49,6 +51,26 @@ struct ReplayGainConfig;
 class MultipleOutputs final : public PlayerOutputs {
 	MixerListener &mixer_listener;
 
+	/**
+	 * Lets outputs with the same audio format share the
+	 * resampler.  It must be declared before #outputs, because
+	 * it must outlive them.
+	 */
+	const std::unique_ptr<PcmConvertCache> convert_cache;
+
+	/**
+	 * Lets outputs with the same "shared_filters" setting share
+	 * the filter chain.  Like #convert_cache, it must outlive
+	 * #outputs.
+	 */
+	const std::unique_ptr<FilterCache> filter_cache;
+
+	/**
+	 * Wakes up all outputs with a software clock.  Like
+	 * #convert_cache, it must outlive #outputs.
+	 */
+	const std::unique_ptr<OutputPacer> pacer;
+
 	std::vector<std::unique_ptr<AudioOutputControl>> outputs;
 
 	AudioFormat input_audio_format = AudioFormat::Undefined();
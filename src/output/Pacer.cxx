@@ -0,0 +1,148 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Pacer.hxx"
+#include "thread/Name.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+constexpr OutputPacer::Clock::duration OutputPacer::QUANTUM;
+
+/**
+ * Round the time point up to the next multiple of
+ * OutputPacer::QUANTUM, so deadlines of different outputs fall onto
+ * the same instants.
+ */
+gcc_const
+static OutputPacer::Clock::time_point
+RoundUp(OutputPacer::Clock::time_point t) noexcept
+{
+	constexpr auto q = OutputPacer::QUANTUM.count();
+	const auto n = t.time_since_epoch().count();
+	return OutputPacer::Clock::time_point(OutputPacer::Clock::duration((n + q - 1) / q * q));
+}
+
+OutputPacer::~OutputPacer() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		quit = true;
+		cond.notify_one();
+	}
+
+	thread.Join();
+}
+
+bool
+OutputPacer::Schedule(Client &client, Clock::time_point deadline) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (!thread.IsDefined()) {
+		/* start the thread on demand; most configurations
+		   have no software-clocked outputs */
+		try {
+			thread.Start();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to start the output pacer thread");
+			return false;
+		}
+	}
+
+	deadline = RoundUp(deadline);
+
+	auto i = std::find_if(scheduled.begin(), scheduled.end(),
+			      [&client](const auto &s){
+				      return s.second == &client;
+			      });
+	if (i != scheduled.end())
+		i->first = deadline;
+	else
+		scheduled.emplace_back(deadline, &client);
+
+	cond.notify_one();
+	return true;
+}
+
+void
+OutputPacer::Cancel(Client &client) noexcept
+{
+	std::unique_lock<Mutex> lock(mutex);
+
+	scheduled.erase(std::remove_if(scheduled.begin(), scheduled.end(),
+				       [&client](const auto &s){
+					       return s.second == &client;
+				       }),
+			scheduled.end());
+
+	dispatch_cond.wait(lock, [this, &client]{
+		return std::find(dispatching.begin(), dispatching.end(),
+				 &client) == dispatching.end();
+	});
+}
+
+void
+OutputPacer::Run() noexcept
+{
+	SetThreadName("pacer");
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (!quit) {
+		if (scheduled.empty()) {
+			cond.wait(lock);
+			continue;
+		}
+
+		const auto next = std::min_element(scheduled.begin(),
+						   scheduled.end())->first;
+		const auto now = Clock::now();
+		if (next > now) {
+			cond.wait_for(lock, next - now);
+			continue;
+		}
+
+		/* invoke all clients which are due */
+
+		scheduled.erase(std::remove_if(scheduled.begin(), scheduled.end(),
+					       [this, now](const auto &s){
+						       if (s.first > now)
+							       return false;
+
+						       dispatching.push_back(s.second);
+						       return true;
+					       }),
+				scheduled.end());
+
+		{
+			const ScopeUnlock unlock(mutex);
+
+			for (auto *client : dispatching)
+				client->OnPacerDeadline();
+		}
+
+		dispatching.clear();
+		dispatch_cond.notify_all();
+	}
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_PACER_HXX
+#define MPD_OUTPUT_PACER_HXX
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+/**
+ * Wakes up the threads of all outputs of one partition which are
+ * paced by a software clock (see AudioOutput::HasSoftwareClock()).
+ *
+ * Instead of sleeping with its own timeout, each output thread
+ * registers its deadline here.  Deadlines are rounded up to multiples
+ * of #QUANTUM, and one pacer thread waits for the earliest one and
+ * then wakes up all outputs which are due.  This way, many streaming
+ * outputs cause only one timer expiry per quantum.
+ */
+class OutputPacer {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/**
+	 * The granularity of all deadlines.
+	 */
+	static constexpr Clock::duration QUANTUM = std::chrono::milliseconds(10);
+
+	class Client {
+	public:
+		/**
+		 * The deadline passed to Schedule() has been reached.
+		 * This is called by the pacer thread, without any
+		 * lock held.
+		 */
+		virtual void OnPacerDeadline() noexcept = 0;
+	};
+
+private:
+	Thread thread;
+
+	Mutex mutex;
+
+	/**
+	 * Wakes up the pacer thread when #scheduled changes or when
+	 * it shall quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled after the pacer thread has finished invoking
+	 * everything in #dispatching.
+	 */
+	Cond dispatch_cond;
+
+	/**
+	 * All registered clients with their (rounded) deadlines.
+	 * Protected by #mutex.
+	 */
+	std::vector<std::pair<Clock::time_point, Client *>> scheduled;
+
+	/**
+	 * The clients which are currently being invoked by the pacer
+	 * thread.  Protected by #mutex.
+	 */
+	std::vector<Client *> dispatching;
+
+	bool quit = false;
+
+public:
+	OutputPacer() noexcept
+		:thread(BIND_THIS_METHOD(Run)) {}
+
+	~OutputPacer() noexcept;
+
+	OutputPacer(const OutputPacer &) = delete;
+	OutputPacer &operator=(const OutputPacer &) = delete;
+
+	/**
+	 * Invoke Client::OnPacerDeadline() at (or shortly after) the
+	 * given time.  A previous deadline of the same client is
+	 * replaced.
+	 *
+	 * @return false if the pacer thread could not be started;
+	 * the caller must then sleep on its own
+	 */
+	bool Schedule(Client &client, Clock::time_point deadline) noexcept;
+
+	/**
+	 * Unregister the client.  If the pacer thread is currently
+	 * invoking it, this waits until it has returned, so the
+	 * caller must not hold any lock which the client's
+	 * OnPacerDeadline() needs.
+	 */
+	void Cancel(Client &client) noexcept;
+
+private:
+	void Run() noexcept;
+};
+
+#endif
@@ -25,6 +25,7 @@
 #include "Print.hxx"
 #include "MultipleOutputs.hxx"
 #include "client/Response.hxx"
+#include "Chrono.hxx"
 
 void
 printAudioDevices(Response &r, const MultipleOutputs &outputs)
@@ -40,8 +41,64 @@ printAudioDevices(Response &r, const MultipleOutputs &outputs)
 			 ao.GetName(), ao.GetPluginName(),
 			 ao.IsEnabled());
 
+		const auto latency = ao.GetLatency();
+		if (latency >= std::chrono::steady_clock::duration::zero())
+			r.Format("latency: %1.3f\n",
+				 std::chrono::duration_cast<FloatDuration>(latency).count());
+
 		for (const auto &a : ao.GetAttributes())
 			r.Format("attribute: %s=%s\n",
 				 a.first.c_str(), a.second.c_str());
 	}
 }
+
+template<typename Rep, typename Period>
+static constexpr double
+ToFloatSeconds(std::chrono::duration<Rep, Period> d) noexcept
+{
+	return std::chrono::duration_cast<FloatDuration>(d).count();
+}
+
+void
+printAudioOutputStats(Response &r, const MultipleOutputs &outputs)
+{
+	static_assert(AudioOutputControl::N_DELAY_BUCKETS == 5,
+		      "Wrong number of delay_* lines");
+
+	for (unsigned i = 0, n = outputs.Size(); i != n; ++i) {
+		const auto &ao = outputs.Get(i);
+		const auto m = ao.LockGetMetrics();
+
+		r.Format("outputid: %u\n"
+			 "outputname: %s\n"
+			 "underruns: %u\n"
+			 "xruns: %u\n"
+			 "bytes: %llu\n"
+			 "play_calls: %llu\n"
+			 "play_time: %1.6f\n",
+			 i, ao.GetName(),
+			 m.underruns, m.xruns,
+			 (unsigned long long)m.bytes_played,
+			 (unsigned long long)m.play_calls,
+			 ToFloatSeconds(m.play_time));
+
+		if (m.play_calls > 0)
+			r.Format("play_time_avg: %1.6f\n"
+				 "play_time_max: %1.6f\n",
+				 ToFloatSeconds(m.play_time) / m.play_calls,
+				 ToFloatSeconds(m.max_play_time));
+
+		r.Format("filter_time: %1.6f\n"
+			 "delay_time: %1.6f\n"
+			 "delay_1ms: %u\n"
+			 "delay_10ms: %u\n"
+			 "delay_100ms: %u\n"
+			 "delay_1s: %u\n"
+			 "delay_inf: %u\n",
+			 ToFloatSeconds(m.filter_cpu_time),
+			 ToFloatSeconds(m.delay_time),
+			 m.delay_histogram[0], m.delay_histogram[1],
+			 m.delay_histogram[2], m.delay_histogram[3],
+			 m.delay_histogram[4]);
+	}
+}
@@ -31,4 +31,11 @@ class MultipleOutputs;
 void
 printAudioDevices(Response &r, const MultipleOutputs &outputs);
 
+/**
+ * Print the playback statistics of all audio outputs (command
+ * "outputstats").
+ */
+void
+printAudioOutputStats(Response &r, const MultipleOutputs &outputs);
+
 #endif
@@ -21,6 +21,15 @@
 #include "MusicChunk.hxx"
 #include "MusicPipe.hxx"
 
+void
+SharedPipeConsumer::Release(const MusicChunk &_chunk) noexcept
+{
+	/* "release" order: our accesses to the chunk happen before
+	   the feeder returns it to the MusicBuffer */
+	released.store(_chunk.serial.load(std::memory_order_relaxed),
+		       std::memory_order_release);
+}
+
 const MusicChunk *
 SharedPipeConsumer::Get() noexcept
 {
@@ -28,18 +37,41 @@ SharedPipeConsumer::Get() noexcept
 		if (!consumed)
 			return chunk;
 
-		if (chunk->next == nullptr)
+		const MusicChunk *next =
+			chunk->next.load(std::memory_order_acquire);
+		if (next == nullptr)
 			return nullptr;
 
+		Release(*chunk);
 		consumed = false;
-		return chunk = chunk->next.get();
+		return chunk = next;
 	} else {
 		/* get the first chunk from the pipe */
+		const MusicChunk *head = pipe->Peek();
+		if (head == nullptr)
+			return nullptr;
+
+		/* the feeder frees released chunks without our
+		   mutex, so we must not pick up one of those (after
+		   Init() or Cancel()); wait until the pipe has
+		   advanced past them */
+		const auto serial = head->serial.load(std::memory_order_relaxed);
+		if (pipe->Peek() != head ||
+		    serial <= released.load(std::memory_order_relaxed))
+			return nullptr;
+
 		consumed = false;
-		return chunk = pipe->Peek();
+		return chunk = head;
 	}
 }
 
+bool
+SharedPipeConsumer::IsReleased(const MusicChunk &_chunk) const noexcept
+{
+	return _chunk.serial.load(std::memory_order_relaxed) <=
+		released.load(std::memory_order_acquire);
+}
+
 bool
 SharedPipeConsumer::IsConsumed(const MusicChunk &_chunk) const noexcept
 {
@@ -53,5 +85,5 @@ SharedPipeConsumer::IsConsumed(const MusicChunk &_chunk) const noexcept
 		return true;
 	}
 
-	return consumed && _chunk.next == nullptr;
+	return consumed && _chunk.next.load(std::memory_order_relaxed) == nullptr;
 }
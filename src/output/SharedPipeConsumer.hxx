@@ -22,7 +22,10 @@
 
 #include "util/Compiler.h"
 
+#include <atomic>
+
 #include <assert.h>
+#include <stdint.h>
 
 struct MusicChunk;
 class MusicPipe;
@@ -34,6 +37,8 @@ class MusicPipe;
  * to be called from two distinct threads (PlayerThread=feeder and
  * OutputThread=consumer), all methods must be called with a mutex
  * locked to serialize access.  Usually, this is #AudioOutput::mutex.
+ * The only exception is IsReleased(), which allows the feeder to
+ * skip the mutex for chunks this consumer is done with.
  */
 class SharedPipeConsumer {
 	/**
@@ -54,6 +59,15 @@ class SharedPipeConsumer {
 	 */
 	bool consumed;
 
+	/**
+	 * The MusicChunk::serial of the newest chunk which this
+	 * consumer has left behind; it will never access this chunk
+	 * or older ones again.  This value never decreases, not even
+	 * in Init() or Cancel(), because serial numbers are unique
+	 * across all pipes.
+	 */
+	std::atomic<uint64_t> released{0};
+
 public:
 	void Init(const MusicPipe &_pipe) {
 		pipe = &_pipe;
@@ -86,11 +100,24 @@ public:
 	gcc_pure
 	bool IsConsumed(const MusicChunk &_chunk) const noexcept;
 
-	void ClearTail(gcc_unused const MusicChunk &_chunk) noexcept {
+	void ClearTail(const MusicChunk &_chunk) noexcept {
 		assert(chunk == &_chunk);
 		assert(consumed);
+		Release(_chunk);
 		chunk = nullptr;
 	}
+
+	/**
+	 * Has this consumer left the given chunk behind for good?
+	 * Unlike all other methods, this one may be called without
+	 * holding the mutex.  A "false" return value is
+	 * inconclusive; use IsConsumed() then.
+	 */
+	gcc_pure
+	bool IsReleased(const MusicChunk &_chunk) const noexcept;
+
+private:
+	void Release(const MusicChunk &_chunk) noexcept;
 };
 
 #endif
@@ -19,14 +19,18 @@
 
 #include "Source.hxx"
 #include "MusicChunk.hxx"
+#include "AudioTrace.hxx"
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
 #include "filter/plugins/ReplayGainFilterPlugin.hxx"
 #include "pcm/Mix.hxx"
 #include "thread/Mutex.hxx"
+#include "thread/Util.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/RuntimeError.hxx"
 
+#include <algorithm>
+
 #include <string.h>
 
 AudioOutputSource::AudioOutputSource() noexcept {}
@@ -100,13 +104,13 @@ try {
 
 	/* the replay_gain filter cannot fail here */
 	if (prepared_other_replay_gain_filter) {
-		other_replay_gain_serial = 0;
+		other_replay_gain_info.reset();
 		other_replay_gain_filter =
 			prepared_other_replay_gain_filter->Open(audio_format);
 	}
 
 	if (prepared_replay_gain_filter) {
-		replay_gain_serial = 0;
+		replay_gain_info.reset();
 		replay_gain_filter =
 			prepared_replay_gain_filter->Open(audio_format);
 
@@ -133,7 +137,7 @@ AudioOutputSource::CloseFilter() noexcept
 ConstBuffer<void>
 AudioOutputSource::GetChunkData(const MusicChunk &chunk,
 				Filter *current_replay_gain_filter,
-				unsigned *replay_gain_serial_p)
+				std::shared_ptr<const ReplayGainInfo> &last_replay_gain_info)
 {
 	assert(!chunk.IsEmpty());
 	assert(chunk.CheckFormat(in_audio_format));
@@ -146,12 +150,10 @@ AudioOutputSource::GetChunkData(const MusicChunk &chunk,
 		replay_gain_filter_set_mode(*current_replay_gain_filter,
 					    replay_gain_mode);
 
-		if (chunk.replay_gain_serial != *replay_gain_serial_p) {
+		if (chunk.replay_gain_info != last_replay_gain_info) {
 			replay_gain_filter_set_info(*current_replay_gain_filter,
-						    chunk.replay_gain_serial != 0
-						    ? &chunk.replay_gain_info
-						    : nullptr);
-			*replay_gain_serial_p = chunk.replay_gain_serial;
+						    chunk.replay_gain_info.get());
+			last_replay_gain_info = chunk.replay_gain_info;
 		}
 
 		data = current_replay_gain_filter->FilterPCM(data);
@@ -160,22 +162,60 @@ AudioOutputSource::GetChunkData(const MusicChunk &chunk,
 	return data;
 }
 
+namespace {
+
+/**
+ * Adds the CPU time consumed by the current thread during the
+ * lifetime of this object to the given counter.
+ */
+class ScopeCPUTimer {
+	std::atomic<std::chrono::nanoseconds::rep> &counter;
+	const std::chrono::nanoseconds start;
+
+public:
+	explicit ScopeCPUTimer(std::atomic<std::chrono::nanoseconds::rep> &_counter) noexcept
+		:counter(_counter), start(GetCurrentThreadCPUTime()) {}
+
+	~ScopeCPUTimer() noexcept {
+		if (start.count() < 0)
+			return;
+
+		const auto duration = GetCurrentThreadCPUTime() - start;
+		if (duration.count() > 0)
+			counter.fetch_add(duration.count(),
+					  std::memory_order_relaxed);
+	}
+
+	ScopeCPUTimer(const ScopeCPUTimer &) = delete;
+	ScopeCPUTimer &operator=(const ScopeCPUTimer &) = delete;
+};
+
+} // namespace
+
 ConstBuffer<void>
 AudioOutputSource::FilterChunk(const MusicChunk &chunk)
 {
 	auto data = GetChunkData(chunk, replay_gain_filter.get(),
-				 &replay_gain_serial);
+				 replay_gain_info);
 	if (data.empty())
 		return data;
 
+	TraceAudio(AudioTraceEvent::FILTER_BEGIN, &chunk, chunk.time, this,
+		   data.size);
+
+	const ScopeCPUTimer cpu_timer(filter_cpu_time);
+
 	/* cross-fade */
 
 	if (chunk.other != nullptr) {
 		auto other_data = GetChunkData(*chunk.other,
 					       other_replay_gain_filter.get(),
-					       &other_replay_gain_serial);
-		if (other_data.empty())
+					       other_replay_gain_info);
+		if (other_data.empty()) {
+			TraceAudio(AudioTraceEvent::FILTER_END, &chunk,
+				   chunk.time, this, data.size);
 			return data;
+		}
 
 		/* if the "other" chunk is longer, then that trailer
 		   is used as-is, without mixing; it is part of the
@@ -194,21 +234,37 @@ AudioOutputSource::FilterChunk(const MusicChunk &chunk)
 			   case */
 			mix_ratio = 1.0 - mix_ratio;
 
-		void *dest = cross_fade_buffer.Get(other_data.size);
-		memcpy(dest, other_data.data, other_data.size);
-		if (!pcm_mix(cross_fade_dither, dest, data.data, data.size,
-			     in_audio_format.format,
-			     mix_ratio))
-			throw FormatRuntimeError("Cannot cross-fade format %s",
-						 sample_format_to_string(in_audio_format.format));
-
-		data.data = dest;
-		data.size = other_data.size;
+		if (cross_fade_float) {
+			data = pcm_mix_float(cross_fade_buffer,
+					     cross_fade_float_buffer,
+					     cross_fade_dither,
+					     other_data, data,
+					     in_audio_format.format,
+					     mix_ratio);
+			if (data.IsNull())
+				throw FormatRuntimeError("Cannot cross-fade format %s",
+							 sample_format_to_string(in_audio_format.format));
+		} else {
+			void *dest = cross_fade_buffer.Get(other_data.size);
+			memcpy(dest, other_data.data, other_data.size);
+			if (!pcm_mix(cross_fade_dither, dest, data.data, data.size,
+				     in_audio_format.format,
+				     mix_ratio))
+				throw FormatRuntimeError("Cannot cross-fade format %s",
+							 sample_format_to_string(in_audio_format.format));
+
+			data.data = dest;
+			data.size = other_data.size;
+		}
 	}
 
 	/* apply filter chain */
 
-	return filter->FilterPCM(data);
+	data = filter->FilterPCM(data);
+
+	TraceAudio(AudioTraceEvent::FILTER_END, &chunk, chunk.time, this,
+		   data.size);
+	return data;
 }
 
 bool
@@ -238,9 +294,70 @@ AudioOutputSource::Fill(Mutex &mutex)
 		throw;
 	}
 
+	/* the tag is owned by the current chunk, which must not be
+	   left behind before the tag has been read */
+	if (batch_size > 0 && pending_tag == nullptr &&
+	    pending_data.size < batch_size) {
+		try {
+			FillBatch(mutex);
+		} catch (...) {
+			current_chunk = nullptr;
+			throw;
+		}
+	}
+
 	return true;
 }
 
+void
+AudioOutputSource::FillBatch(Mutex &mutex)
+{
+	size_t fill = 0;
+
+	while (fill < batch_size) {
+		const MusicChunk *next =
+			current_chunk->next.load(std::memory_order_acquire);
+		if (next == nullptr || next->tag)
+			/* stop at a tag, because it must be sent
+			   before its chunk's data */
+			break;
+
+		if (fill == 0) {
+			/* copy the first chunk, because the filter
+			   will overwrite its buffer */
+			batch_buffer.GrowDiscard(std::max(pending_data.size,
+							  2 * batch_size));
+			memcpy(batch_buffer.begin(), pending_data.data,
+			       pending_data.size);
+			fill = pending_data.size;
+		}
+
+		/* we have a copy of its data, so this chunk may now
+		   be returned to the MusicBuffer */
+		DropCurrentChunk();
+		current_chunk = pipe.Get();
+		assert(current_chunk == next);
+
+		ConstBuffer<uint8_t> data;
+
+		{
+			const ScopeUnlock unlock(mutex);
+			data = data.FromVoid(FilterChunk(*current_chunk));
+		}
+
+		if (fill + data.size > batch_buffer.size())
+			batch_buffer.GrowPreserve(std::max(fill + data.size,
+							   2 * batch_size),
+						  fill);
+
+		memcpy(batch_buffer.begin() + fill, data.data, data.size);
+		fill += data.size;
+	}
+
+	if (fill > 0)
+		pending_data = {batch_buffer.begin(), fill};
+}
+
 void
 AudioOutputSource::ConsumeData(size_t nbytes) noexcept
 {
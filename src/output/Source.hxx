@@ -26,8 +26,11 @@
 #include "pcm/Buffer.hxx"
 #include "pcm/Dither.hxx"
 #include "thread/Mutex.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/ConstBuffer.hxx"
 
+#include <atomic>
+#include <chrono>
 #include <utility>
 #include <memory>
 
@@ -35,6 +38,7 @@
 #include <stdint.h>
 
 struct MusicChunk;
+struct ReplayGainInfo;
 struct Tag;
 class Filter;
 class PreparedFilter;
@@ -60,16 +64,18 @@ class AudioOutputSource {
 	SharedPipeConsumer pipe;
 
 	/**
-	 * The serial number of the last replay gain info.  0 means no
-	 * replay gain info was available.
+	 * The last replay gain info passed to #replay_gain_filter.
+	 * nullptr means no replay gain info was available.  Holding
+	 * the reference makes sure that a new object cannot be
+	 * mistaken for it.
 	 */
-	unsigned replay_gain_serial;
+	std::shared_ptr<const ReplayGainInfo> replay_gain_info;
 
 	/**
-	 * The serial number of the last replay gain info by the
-	 * "other" chunk during cross-fading.
+	 * The last replay gain info of the "other" chunk during
+	 * cross-fading.
 	 */
-	unsigned other_replay_gain_serial;
+	std::shared_ptr<const ReplayGainInfo> other_replay_gain_info;
 
 	/**
 	 * The replay_gain_filter_plugin instance of this audio
@@ -89,11 +95,22 @@ class AudioOutputSource {
 	 */
 	PcmBuffer cross_fade_buffer;
 
+	/**
+	 * A second buffer for pcm_mix_float().
+	 */
+	PcmBuffer cross_fade_float_buffer;
+
 	/**
 	 * The dithering state for cross-fading two streams.
 	 */
 	PcmDither cross_fade_dither;
 
+	/**
+	 * Mix integer samples in the floating point domain while
+	 * cross-fading?  See pcm_mix_float().
+	 */
+	bool cross_fade_float = false;
+
 	/**
 	 * The filter object of this audio output.  This is an
 	 * instance of chain_filter_plugin.
@@ -118,6 +135,26 @@ class AudioOutputSource {
 	 */
 	ConstBuffer<uint8_t> pending_data;
 
+	/**
+	 * If non-zero, then Fill() filters consecutive chunks until
+	 * this many bytes are available, and returns them as one
+	 * #pending_data block.
+	 */
+	size_t batch_size = 0;
+
+	/**
+	 * The buffer which collects filtered data of several chunks
+	 * if #batch_size is enabled.
+	 */
+	AllocatedArray<uint8_t> batch_buffer;
+
+	/**
+	 * The accumulated CPU time (in nanoseconds) spent in
+	 * FilterChunk().  This is atomic because it is read by
+	 * GetFilterCPUTime() from other threads.
+	 */
+	std::atomic<std::chrono::nanoseconds::rep> filter_cpu_time{0};
+
 public:
 	AudioOutputSource() noexcept;
 	~AudioOutputSource() noexcept;
@@ -126,6 +163,14 @@ public:
 		replay_gain_mode = _mode;
 	}
 
+	void SetCrossFadeFloat(bool _cross_fade_float) noexcept {
+		cross_fade_float = _cross_fade_float;
+	}
+
+	void SetBatchSize(size_t _batch_size) noexcept {
+		batch_size = _batch_size;
+	}
+
 	bool IsOpen() const {
 		return in_audio_format.IsDefined();
 	}
@@ -167,6 +212,23 @@ public:
 		return std::exchange(pending_tag, nullptr);
 	}
 
+	/**
+	 * Returns the chunk which is currently being played, or
+	 * nullptr.  Its address is only used to identify it (e.g. for
+	 * tracing).
+	 */
+	const MusicChunk *GetCurrentChunk() const noexcept {
+		return current_chunk;
+	}
+
+	/**
+	 * Returns the CPU time spent in FilterChunk() so far.  This
+	 * method is thread-safe.
+	 */
+	std::chrono::nanoseconds GetFilterCPUTime() const noexcept {
+		return std::chrono::nanoseconds(filter_cpu_time.load(std::memory_order_relaxed));
+	}
+
 	/**
 	 * Returns the remaining filtered PCM data be played.  The
 	 * caller shall use ConsumeData() to mark portions of the
@@ -194,6 +256,16 @@ public:
 		pipe.ClearTail(chunk);
 	}
 
+	/**
+	 * Has this output left the given chunk behind for good?  This
+	 * may be called without holding the mutex; see
+	 * SharedPipeConsumer::IsReleased().
+	 */
+	gcc_pure
+	bool IsChunkReleased(const MusicChunk &chunk) const noexcept {
+		return pipe.IsReleased(chunk);
+	}
+
 	/**
 	 * Wrapper for Filter::Flush().
 	 */
@@ -209,10 +281,18 @@ private:
 
 	ConstBuffer<void> GetChunkData(const MusicChunk &chunk,
 				       Filter *replay_gain_filter,
-				       unsigned *replay_gain_serial_p);
+				       std::shared_ptr<const ReplayGainInfo> &last_replay_gain_info);
 
 	ConstBuffer<void> FilterChunk(const MusicChunk &chunk);
 
+	/**
+	 * Append the filtered data of the following chunks to
+	 * #pending_data until #batch_size is reached, the pipe runs
+	 * empty or a chunk with a #Tag is found.  The caller must
+	 * have filtered #current_chunk already.
+	 */
+	void FillBatch(Mutex &mutex);
+
 	void DropCurrentChunk() noexcept {
 		assert(current_chunk != nullptr);
 
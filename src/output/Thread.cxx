@@ -21,7 +21,10 @@
 #include "Filtered.hxx"
 #include "Client.hxx"
 #include "Domain.hxx"
+#include "AudioTrace.hxx"
+#include "MusicChunk.hxx"
 #include "thread/Util.hxx"
+#include "thread/Scheduling.hxx"
 #include "thread/Slack.hxx"
 #include "thread/Name.hxx"
 #include "util/StringBuffer.hxx"
@@ -29,6 +32,8 @@
 #include "util/RuntimeError.hxx"
 #include "Log.hxx"
 
+#include <string>
+
 #include <assert.h>
 #include <string.h>
 
@@ -201,6 +206,19 @@ AudioOutputControl::InternalCheckClose(bool drain) noexcept
 		InternalClose(drain);
 }
 
+inline void
+AudioOutputControl::CountDelay(std::chrono::steady_clock::duration delay) noexcept
+{
+	using namespace std::chrono_literals;
+
+	std::size_t i = 0;
+	for (auto limit = std::chrono::steady_clock::duration(1ms);
+	     i < delay_histogram.size() - 1 && delay > limit; limit *= 10)
+		++i;
+
+	++delay_histogram[i];
+}
+
 /**
  * Wait until the output's delay reaches zero.
  *
@@ -215,13 +233,42 @@ AudioOutputControl::WaitForDelay(std::unique_lock<Mutex> &lock) noexcept
 		if (delay <= std::chrono::steady_clock::duration::zero())
 			return true;
 
-		(void)wake_cond.wait_for(lock, delay);
+		CountDelay(delay);
+
+		const auto start_time = std::chrono::steady_clock::now();
+
+		/* outputs without a hardware clock are woken up by
+		   the partition's pacer, which batches their
+		   wakeups; the low-latency profile needs precise
+		   timing */
+		paced = false;
+		if (pacer != nullptr && output->HasSoftwareClock() &&
+		    !output->low_latency &&
+		    pacer->Schedule(*this, start_time + delay)) {
+			wake_cond.wait(lock, [this]{
+				return paced || command != Command::NONE;
+			});
+
+			const ScopeUnlock unlock(mutex);
+			pacer->Cancel(*this);
+		} else
+			(void)wake_cond.wait_for(lock, delay);
+
+		delay_time += std::chrono::steady_clock::now() - start_time;
 
 		if (command != Command::NONE)
 			return false;
 	}
 }
 
+void
+AudioOutputControl::OnPacerDeadline() noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	paced = true;
+	wake_cond.notify_one();
+}
+
 bool
 AudioOutputControl::FillSourceOrClose() noexcept
 try {
@@ -260,10 +307,13 @@ AudioOutputControl::PlayChunk(std::unique_lock<Mutex> &lock) noexcept
 			break;
 
 		size_t nbytes;
+		std::chrono::steady_clock::duration duration;
 
 		try {
 			const ScopeUnlock unlock(mutex);
+			const auto start_time = std::chrono::steady_clock::now();
 			nbytes = output->Play(data.data, data.size);
+			duration = std::chrono::steady_clock::now() - start_time;
 			assert(nbytes > 0);
 			assert(nbytes <= data.size);
 		} catch (...) {
@@ -275,6 +325,21 @@ AudioOutputControl::PlayChunk(std::unique_lock<Mutex> &lock) noexcept
 
 		assert(nbytes % output->out_audio_format.GetFrameSize() == 0);
 
+		bytes_played += nbytes;
+		++n_play_calls;
+		play_time += duration;
+		if (duration > max_play_time)
+			max_play_time = duration;
+
+		if (gcc_unlikely(audio_trace != nullptr)) {
+			const auto *chunk = source.GetCurrentChunk();
+			TraceAudio(AudioTraceEvent::OUTPUT_PLAY, chunk,
+				   chunk != nullptr
+				   ? chunk->time
+				   : SignedSongTime::Negative(),
+				   &source, nbytes);
+		}
+
 		source.ConsumeData(nbytes);
 	}
 
@@ -284,9 +349,20 @@ AudioOutputControl::PlayChunk(std::unique_lock<Mutex> &lock) noexcept
 inline bool
 AudioOutputControl::InternalPlay(std::unique_lock<Mutex> &lock) noexcept
 {
-	if (!FillSourceOrClose())
+	if (!FillSourceOrClose()) {
 		/* no chunk available */
+		if (!starved) {
+			starved = true;
+			++n_underruns;
+
+			TraceAudio(AudioTraceEvent::OUTPUT_UNDERRUN, nullptr,
+				   SignedSongTime::Negative(), &source);
+		}
+
 		return false;
+	}
+
+	starved = false;
 
 	assert(!in_playback_loop);
 	in_playback_loop = true;
@@ -410,7 +486,27 @@ AudioOutputControl::Task() noexcept
 		    "OutputThread could not get realtime scheduling, continuing anyway");
 	}
 
-	SetThreadTimerSlack(std::chrono::microseconds(100));
+	/* with the low-latency profile, wake up as close to the
+	   deadline as possible */
+	SetThreadTimerSlack(output->low_latency
+			    ? std::chrono::microseconds(10)
+			    : std::chrono::microseconds(100));
+
+	if (output->lock_memory) {
+		try {
+			LockThreadStack();
+		} catch (...) {
+			Log(LogLevel::WARNING, std::current_exception(),
+			    "Failed to lock the output thread stack");
+		}
+	}
+
+	try {
+		ApplyThreadScheduling((std::string("output:") + GetName()).c_str());
+	} catch (...) {
+		Log(LogLevel::WARNING, std::current_exception(),
+		    "Failed to apply \"thread\" settings");
+	}
 
 	std::unique_lock<Mutex> lock(mutex);
 
@@ -430,6 +526,7 @@ AudioOutputControl::Task() noexcept
 			break;
 
 		case Command::OPEN:
+			starved = true;
 			InternalOpen(request.audio_format, *request.pipe);
 			CommandFinished();
 			break;
@@ -485,6 +582,8 @@ AudioOutputControl::Task() noexcept
 			continue;
 
 		case Command::DRAIN:
+			starved = true;
+
 			if (open)
 				InternalDrain();
 
@@ -492,6 +591,7 @@ AudioOutputControl::Task() noexcept
 			continue;
 
 		case Command::CANCEL:
+			starved = true;
 			source.Cancel();
 
 			if (open) {
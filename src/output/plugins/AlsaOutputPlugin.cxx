@@ -44,6 +44,7 @@
 
 #include <boost/lockfree/spsc_queue.hpp>
 
+#include <atomic>
 #include <string>
 #include <forward_list>
 
@@ -51,6 +52,13 @@ static const char default_device[] = "default";
 
 static constexpr unsigned MPD_ALSA_BUFFER_TIME_US = 500000;
 
+/**
+ * The default buffer_time and period_time for the low-latency
+ * profile.
+ */
+static constexpr unsigned MPD_ALSA_LOW_LATENCY_BUFFER_TIME_US = 10000;
+static constexpr unsigned MPD_ALSA_LOW_LATENCY_PERIOD_TIME_US = 2500;
+
 class AlsaOutput final
 	: AudioOutput, MultiSocketMonitor {
 
@@ -85,10 +93,22 @@ class AlsaOutput final
 #endif
 
 	/** libasound's buffer_time setting (in microseconds) */
-	const unsigned buffer_time;
+	unsigned buffer_time;
 
 	/** libasound's period_time setting (in microseconds) */
-	const unsigned period_time;
+	unsigned period_time;
+
+	/**
+	 * Were #buffer_time and #period_time configured explicitly?
+	 * Then SetLowLatency() doesn't override them.
+	 */
+	const bool explicit_buffer_time, explicit_period_time;
+
+	/**
+	 * Attempt to configure SND_PCM_ACCESS_MMAP_INTERLEAVED
+	 * ("use_mmap")?
+	 */
+	const bool use_mmap;
 
 	/** the mode flags passed to snd_pcm_open */
 	int mode = 0;
@@ -118,8 +138,29 @@ class AlsaOutput final
 	 */
 	snd_pcm_uframes_t period_frames;
 
+	/**
+	 * Is the PCM in SND_PCM_ACCESS_MMAP_INTERLEAVED mode?  Then
+	 * data is copied from the #ring_buffer directly into the DMA
+	 * area, bypassing #period_buffer and snd_pcm_writei().
+	 */
+	bool mmap;
+
 	std::chrono::steady_clock::duration effective_period_duration;
 
+	/**
+	 * The most recently measured latency in frames: the ALSA
+	 * delay plus the frames still queued in #ring_buffer; -1 if
+	 * unknown.  It is written by the
+	 * IOThread and read by GetLatency().
+	 */
+	std::atomic<snd_pcm_sframes_t> latency_frames{-1};
+
+	/**
+	 * The number of underruns (EPIPE) reported by ALSA since the
+	 * device was enabled for the first time.
+	 */
+	std::atomic_uint n_xruns{0};
+
 	/**
 	 * If snd_pcm_avail() goes above this value and no more data
 	 * is available in the #ring_buffer, we need to play some
@@ -234,6 +275,13 @@ private:
 	void Enable() override;
 	void Disable() noexcept override;
 
+	void SetLowLatency() noexcept override;
+	std::chrono::steady_clock::duration GetLatency() const noexcept override;
+
+	unsigned GetXruns() const noexcept override {
+		return n_xruns.load(std::memory_order_relaxed);
+	}
+
 	void Open(AudioFormat &audio_format) override;
 	void Close() noexcept override;
 
@@ -361,6 +409,78 @@ private:
 		return frames_written;
 	}
 
+	/**
+	 * Write up to the given number of frames directly into the
+	 * mmap'ed DMA area.  The function generates the data; its
+	 * signature is void(uint8_t *dest, snd_pcm_uframes_t frames).
+	 *
+	 * @return 0 on success or a negative error code
+	 */
+	template<typename F>
+	snd_pcm_sframes_t MmapWrite(snd_pcm_uframes_t frames, F &&f) noexcept {
+		while (frames > 0) {
+			const snd_pcm_channel_area_t *areas;
+			snd_pcm_uframes_t offset, n = frames;
+			int err = snd_pcm_mmap_begin(pcm, &areas, &offset, &n);
+			if (err < 0)
+				return err;
+
+			if (n == 0)
+				break;
+
+			/* interleaved: all channels share one
+			   area */
+			auto *dest = (uint8_t *)areas[0].addr +
+				(areas[0].first + offset * areas[0].step) / 8;
+			f(dest, n);
+
+			auto committed = snd_pcm_mmap_commit(pcm, offset, n);
+			if (committed < 0)
+				return committed;
+
+			written = true;
+			frames -= n;
+		}
+
+		return 0;
+	}
+
+	/**
+	 * Move as many frames as possible from the #ring_buffer into
+	 * the DMA area.
+	 *
+	 * @return the number of frames, or a negative error code
+	 */
+	snd_pcm_sframes_t CopyRingToMmap() noexcept;
+
+	/**
+	 * The #mmap implementation of DispatchSockets().
+	 *
+	 * Throws on error.
+	 */
+	void DispatchMmap();
+
+	/**
+	 * There is no data in the #ring_buffer, but also no pressure
+	 * to fill the ALSA buffer.  Stop monitoring the ALSA file
+	 * descriptor until Play() delivers more data.
+	 */
+	void StartWaiting() noexcept;
+
+	/**
+	 * Update #latency_frames.  To be run in #EventLoop's thread.
+	 */
+	void MeasureLatency() noexcept {
+		snd_pcm_sframes_t delay;
+		if (snd_pcm_delay(pcm, &delay) < 0) {
+			latency_frames.store(-1, std::memory_order_relaxed);
+			return;
+		}
+
+		delay += ring_buffer->read_available() / out_frame_size;
+		latency_frames.store(delay, std::memory_order_relaxed);
+	}
+
 	void LockCaughtError() noexcept {
 		period_buffer.Clear();
 
@@ -404,7 +524,10 @@ AlsaOutput::AlsaOutput(EventLoop &_loop, const ConfigBlock &block)
 #endif
 	 buffer_time(block.GetPositiveValue("buffer_time",
 					    MPD_ALSA_BUFFER_TIME_US)),
-	 period_time(block.GetPositiveValue("period_time", 0u))
+	 period_time(block.GetPositiveValue("period_time", 0u)),
+	 explicit_buffer_time(block.GetBlockParam("buffer_time") != nullptr),
+	 explicit_period_time(block.GetBlockParam("period_time") != nullptr),
+	 use_mmap(block.GetBlockValue("use_mmap", false))
 {
 #ifdef SND_PCM_NO_AUTO_RESAMPLE
 	if (!block.GetBlockValue("auto_resample", true))
@@ -461,6 +584,26 @@ AlsaOutput::SetAttribute(std::string &&name, std::string &&value)
 		AudioOutput::SetAttribute(std::move(name), std::move(value));
 }
 
+void
+AlsaOutput::SetLowLatency() noexcept
+{
+	if (!explicit_buffer_time)
+		buffer_time = MPD_ALSA_LOW_LATENCY_BUFFER_TIME_US;
+
+	if (!explicit_period_time)
+		period_time = MPD_ALSA_LOW_LATENCY_PERIOD_TIME_US;
+}
+
+std::chrono::steady_clock::duration
+AlsaOutput::GetLatency() const noexcept
+{
+	const auto frames = latency_frames.load(std::memory_order_relaxed);
+	if (frames < 0)
+		return std::chrono::steady_clock::duration(-1);
+
+	return effective_period_duration * frames / period_frames;
+}
+
 void
 AlsaOutput::Enable()
 {
@@ -529,8 +672,13 @@ AlsaOutput::Setup(AudioFormat &audio_format,
 {
 	const auto hw_result = Alsa::SetupHw(pcm,
 					     buffer_time, period_time,
+					     use_mmap,
 					     audio_format, params);
 
+	mmap = hw_result.mmap;
+	if (mmap)
+		FormatDebug(alsa_output_domain, "mmap enabled");
+
 	FormatDebug(alsa_output_domain, "format=%s (%s)",
 		    snd_pcm_format_name(hw_result.format),
 		    snd_pcm_format_description(hw_result.format));
@@ -738,6 +886,7 @@ AlsaOutput::Open(AudioFormat &audio_format)
 	waiting = false;
 	must_prepare = false;
 	written = false;
+	latency_frames.store(-1, std::memory_order_relaxed);
 	error = {};
 }
 
@@ -745,6 +894,7 @@ inline int
 AlsaOutput::Recover(int err) noexcept
 {
 	if (err == -EPIPE) {
+		n_xruns.fetch_add(1, std::memory_order_relaxed);
 		FormatDebug(alsa_output_domain,
 			    "Underrun on ALSA device \"%s\"",
 			    GetDevice());
@@ -798,11 +948,28 @@ AlsaOutput::Recover(int err) noexcept
 inline bool
 AlsaOutput::DrainInternal()
 {
-	/* drain ring_buffer */
-	CopyRingToPeriodBuffer();
+	if (mmap) {
+		/* drain ring_buffer directly into the DMA area */
+		auto frames_written = CopyRingToMmap();
+		if (frames_written < 0) {
+			if (frames_written == -EAGAIN)
+				return false;
+
+			throw FormatRuntimeError("snd_pcm_mmap_commit() failed: %s",
+						 snd_strerror(-frames_written));
+		}
+
+		if (ring_buffer->read_available() >= out_frame_size)
+			/* the ALSA buffer is full; try again in the
+			   next iteration */
+			return false;
+	} else {
+		/* drain ring_buffer */
+		CopyRingToPeriodBuffer();
+	}
 
 	/* drain period_buffer */
-	if (!period_buffer.IsCleared()) {
+	if (!mmap && !period_buffer.IsCleared()) {
 		if (!period_buffer.IsFull())
 			/* generate some silence to finish the partial
 			   period */
@@ -900,6 +1067,7 @@ AlsaOutput::CancelInternal() noexcept
 	pcm_export->Reset();
 	period_buffer.Clear();
 	ring_buffer->reset();
+	latency_frames.store(-1, std::memory_order_relaxed);
 
 	active = false;
 	waiting = false;
@@ -938,6 +1106,7 @@ AlsaOutput::Close() noexcept
 			silence_timer.Cancel();
 		});
 
+	latency_frames.store(-1, std::memory_order_relaxed);
 	period_buffer.Free();
 	delete ring_buffer;
 	snd_pcm_close(pcm);
@@ -1022,6 +1191,134 @@ AlsaOutput::PrepareSockets() noexcept
 	}
 }
 
+void
+AlsaOutput::StartWaiting() noexcept
+{
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		waiting = true;
+		cond.notify_one();
+	}
+
+	/* avoid race condition: see if data has arrived meanwhile
+	   before disabling the event (but after setting the
+	   "waiting" flag) */
+	const bool more_data = mmap
+		? ring_buffer->read_available() >= out_frame_size
+		: CopyRingToPeriodBuffer();
+	if (!more_data) {
+		MultiSocketMonitor::Reset();
+		defer_invalidate_sockets.Cancel();
+
+		/* just in case Play() doesn't get called soon
+		   enough, schedule a timer which generates silence
+		   before the xrun occurs */
+		/* the timer fires in half of a period; this short
+		   duration may produce a few more wakeups than
+		   necessary, but should be small enough to avoid the
+		   xrun */
+		silence_timer.Schedule(effective_period_duration / 2);
+	}
+}
+
+snd_pcm_sframes_t
+AlsaOutput::CopyRingToMmap() noexcept
+{
+	snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+	if (avail < 0)
+		return avail;
+
+	/* the ring_buffer contains only whole frames, because
+	   PcmExport::Export() never returns partial frames */
+	const snd_pcm_uframes_t frames =
+		std::min<snd_pcm_uframes_t>(avail,
+					    ring_buffer->read_available() / out_frame_size);
+	if (frames == 0)
+		return 0;
+
+	auto err = MmapWrite(frames, [this](uint8_t *dest,
+					    snd_pcm_uframes_t n){
+		ring_buffer->pop(dest, n * out_frame_size);
+	});
+	if (err < 0)
+		return err;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		/* notify the OutputThread that there is now room in
+		   ring_buffer */
+		cond.notify_one();
+	}
+
+	return frames;
+}
+
+inline void
+AlsaOutput::DispatchMmap()
+{
+	snd_pcm_sframes_t frames_written;
+
+	if (ring_buffer->read_available() >= out_frame_size) {
+		frames_written = CopyRingToMmap();
+	} else {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+		if (avail >= 0 &&
+		    (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED ||
+		     avail <= max_avail_frames)) {
+			/* see the comment in DispatchSockets() */
+			StartWaiting();
+			return;
+		}
+
+		if (avail >= 0) {
+			if (throttle_silence_log.CheckUpdate(std::chrono::seconds(5)))
+				FormatWarning(alsa_output_domain, "Decoder is too slow; playing silence to avoid xrun");
+
+			/* insert up to one period of silence to
+			   avoid ALSA xrun */
+			const auto n = std::min<snd_pcm_uframes_t>(avail,
+								   period_frames);
+			frames_written = MmapWrite(n, [this](uint8_t *dest,
+							     snd_pcm_uframes_t n_frames){
+				std::copy_n(silence, n_frames * out_frame_size,
+					    dest);
+			});
+		} else
+			frames_written = avail;
+	}
+
+	if (frames_written < 0) {
+		if (frames_written == -EAGAIN || frames_written == -EINTR)
+			/* try again in the next DispatchSockets()
+			   call which is still scheduled */
+			return;
+
+		if (Recover(frames_written) < 0)
+			throw FormatRuntimeError("snd_pcm_mmap_commit() failed: %s",
+						 snd_strerror(-frames_written));
+
+		/* recovered; try again in the next DispatchSockets()
+		   call */
+		return;
+	}
+
+	MeasureLatency();
+
+	/* unlike snd_pcm_writei(), snd_pcm_mmap_commit() doesn't
+	   start the PCM automatically; emulate the start threshold
+	   configured by AlsaSetupSw() */
+	if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED) {
+		const auto avail = snd_pcm_avail_update(pcm);
+		if (avail < 0 || avail > max_avail_frames)
+			return;
+
+		int err = snd_pcm_start(pcm);
+		if (err < 0)
+			throw FormatRuntimeError("snd_pcm_start() failed: %s",
+						 snd_strerror(-err));
+	}
+}
+
 void
 AlsaOutput::DispatchSockets() noexcept
 try {
@@ -1057,6 +1354,11 @@ try {
 		}
 	}
 
+	if (mmap) {
+		DispatchMmap();
+		return;
+	}
+
 	CopyRingToPeriodBuffer();
 
 	if (!period_buffer.IsFull()) {
@@ -1077,32 +1379,7 @@ try {
 			   start of playback, when our ring_buffer is
 			   smaller than the ALSA-PCM buffer */
 
-			{
-				const std::lock_guard<Mutex> lock(mutex);
-				waiting = true;
-				cond.notify_one();
-			}
-
-			/* avoid race condition: see if data has
-			   arrived meanwhile before disabling the
-			   event (but after setting the "waiting"
-			   flag) */
-			if (!CopyRingToPeriodBuffer()) {
-				MultiSocketMonitor::Reset();
-				defer_invalidate_sockets.Cancel();
-
-				/* just in case Play() doesn't get
-				   called soon enough, schedule a
-				   timer which generates silence
-				   before the xrun occurs */
-				/* the timer fires in half of a
-				   period; this short duration may
-				   produce a few more wakeups than
-				   necessary, but should be small
-				   enough to avoid the xrun */
-				silence_timer.Schedule(effective_period_duration / 2);
-			}
-
+			StartWaiting();
 			return;
 		}
 
@@ -1129,6 +1406,8 @@ try {
 		   call */
 		return;
 	}
+
+	MeasureLatency();
 } catch (...) {
 	MultiSocketMonitor::Reset();
 	LockCaughtError();
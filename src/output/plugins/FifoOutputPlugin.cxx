@@ -28,6 +28,10 @@
 #include "Log.hxx"
 #include "open.h"
 
+#ifdef __linux__
+#include "PipeSplicer.hxx"
+#endif
+
 #include <sys/stat.h>
 #include <errno.h>
 #include <unistd.h>
@@ -41,6 +45,15 @@ class FifoOutput final : AudioOutput {
 	bool created = false;
 	Timer *timer;
 
+#ifdef __linux__
+	/**
+	 * Use vmsplice() instead of write()?  (option "splice")
+	 */
+	const bool splice;
+
+	PipeSplicer splicer;
+#endif
+
 public:
 	FifoOutput(const ConfigBlock &block);
 
@@ -72,12 +85,20 @@ private:
 static constexpr Domain fifo_output_domain("fifo_output");
 
 FifoOutput::FifoOutput(const ConfigBlock &block)
-	:AudioOutput(0),
+	:AudioOutput(FLAG_SOFTWARE_CLOCK),
 	 path(block.GetPath("path"))
+#ifdef __linux__
+	, splice(block.GetBlockValue("splice", false))
+#endif
 {
 	if (path.IsNull())
 		throw std::runtime_error("No \"path\" parameter specified");
 
+#ifndef __linux__
+	if (block.GetBlockValue("splice", false))
+		throw std::runtime_error("Option \"splice\" is only available on Linux");
+#endif
+
 	path_utf8 = path.ToUTF8();
 
 	OpenFifo();
@@ -169,12 +190,21 @@ try {
 void
 FifoOutput::Open(AudioFormat &audio_format)
 {
+#ifdef __linux__
+	if (splice)
+		splicer.Open(output);
+#endif
+
 	timer = new Timer(audio_format);
 }
 
 void
 FifoOutput::Close() noexcept
 {
+#ifdef __linux__
+	splicer.Close();
+#endif
+
 	delete timer;
 }
 
@@ -212,7 +242,13 @@ FifoOutput::Play(const void *chunk, size_t size)
 	timer->Add(size);
 
 	while (true) {
+#ifdef __linux__
+		ssize_t bytes = splice
+			? splicer.Write(output, chunk, size, true)
+			: write(output, chunk, size);
+#else
 		ssize_t bytes = write(output, chunk, size);
+#endif
 		if (bytes > 0)
 			return (size_t)bytes;
 
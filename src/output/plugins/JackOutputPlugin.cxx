@@ -20,6 +20,7 @@
 #include "config.h"
 #include "JackOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
+#include "pcm/Interleave.hxx"
 #include "thread/Mutex.hxx"
 #include "util/ScopeExit.hxx"
 #include "util/ConstBuffer.hxx"
@@ -644,9 +645,8 @@ JackOutput::WriteSamples(const float *src, size_t n_frames)
 
 	const size_t result = n_frames = std::min(space, n_frames);
 
-	while (n_frames-- > 0)
-		for (unsigned i = 0; i < n_channels; ++i)
-			*dest[i]++ = *src++;
+	/* deinterleave straight into the ring buffers */
+	PcmDeinterleaveFloat({dest, n_channels}, src, n_frames);
 
 	const size_t per_channel_advance = result * jack_sample_size;
 	for (unsigned i = 0; i < n_channels; ++i)
@@ -28,7 +28,7 @@ class NullOutput final  : AudioOutput {
 
 public:
 	NullOutput(const ConfigBlock &block)
-		:AudioOutput(0),
+		:AudioOutput(FLAG_SOFTWARE_CLOCK),
 		 sync(block.GetBlockValue("sync", true)) {}
 
 	static AudioOutput *Create(EventLoop &,
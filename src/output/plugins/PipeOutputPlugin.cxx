@@ -21,15 +21,30 @@
 #include "../OutputAPI.hxx"
 #include "system/Error.hxx"
 
+#ifdef __linux__
+#include "PipeSplicer.hxx"
+#endif
+
 #include <string>
 #include <stdexcept>
 
+#include <errno.h>
 #include <stdio.h>
+#include <unistd.h>
 
 class PipeOutput final : AudioOutput {
 	const std::string cmd;
 	FILE *fh;
 
+#ifdef __linux__
+	/**
+	 * Use vmsplice() instead of write()?  (option "splice")
+	 */
+	const bool splice;
+
+	PipeSplicer splicer;
+#endif
+
 	PipeOutput(const ConfigBlock &block);
 
 public:
@@ -42,6 +57,9 @@ private:
 	void Open(AudioFormat &audio_format) override;
 
 	void Close() noexcept override {
+#ifdef __linux__
+		splicer.Close();
+#endif
 		pclose(fh);
 	}
 
@@ -51,9 +69,17 @@ private:
 PipeOutput::PipeOutput(const ConfigBlock &block)
 	:AudioOutput(0),
 	 cmd(block.GetBlockValue("command", ""))
+#ifdef __linux__
+	, splice(block.GetBlockValue("splice", false))
+#endif
 {
 	if (cmd.empty())
 		throw std::runtime_error("No \"command\" parameter specified");
+
+#ifndef __linux__
+	if (block.GetBlockValue("splice", false))
+		throw std::runtime_error("Option \"splice\" is only available on Linux");
+#endif
 }
 
 inline void
@@ -62,16 +88,42 @@ PipeOutput::Open(gcc_unused AudioFormat &audio_format)
 	fh = popen(cmd.c_str(), "w");
 	if (fh == nullptr)
 		throw FormatErrno("Error opening pipe \"%s\"", cmd.c_str());
+
+#ifdef __linux__
+	if (splice) {
+		try {
+			splicer.Open(fileno(fh));
+		} catch (...) {
+			pclose(fh);
+			throw;
+		}
+	}
+#endif
 }
 
 inline size_t
 PipeOutput::Play(const void *chunk, size_t size)
 {
-	size_t nbytes = fwrite(chunk, 1, size, fh);
-	if (nbytes == 0)
-		throw MakeErrno("Write error on pipe");
+	/* bypass stdio buffering, which would only add another
+	   copy */
+	const int fd = fileno(fh);
+
+	while (true) {
+#ifdef __linux__
+		ssize_t nbytes = splice
+			? splicer.Write(fd, chunk, size, false)
+			: write(fd, chunk, size);
+#else
+		ssize_t nbytes = write(fd, chunk, size);
+#endif
+		if (nbytes > 0)
+			return nbytes;
+
+		if (nbytes < 0 && errno == EINTR)
+			continue;
 
-	return nbytes;
+		throw MakeErrno("Write error on pipe");
+	}
 }
 
 const struct AudioOutputPlugin pipe_output_plugin = {
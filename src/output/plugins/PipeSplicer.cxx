@@ -0,0 +1,113 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PipeSplicer.hxx"
+#include "system/Error.hxx"
+#include "util/HugeAllocator.hxx"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/**
+ * The export buffer is this many times larger than the pipe.
+ */
+static constexpr size_t PIPE_SPLICE_RING_FACTOR = 4;
+
+static size_t
+GetPipeSize(int fd) noexcept
+{
+	int size = fcntl(fd, F_GETPIPE_SZ);
+	return size > 0
+		? size_t(size)
+		: 65536;
+}
+
+void
+PipeSplicer::Allocate(size_t _pipe_size)
+{
+	Close();
+
+	/* pages still referenced by the pipe stay valid after
+	   munmap(), because the kernel holds its own references */
+	auto w = HugeAllocate(_pipe_size * PIPE_SPLICE_RING_FACTOR);
+	buffer = (uint8_t *)w.data;
+	buffer_size = w.size;
+	position = 0;
+	pipe_size = _pipe_size;
+
+	HugeForkCow(buffer, buffer_size, false);
+}
+
+void
+PipeSplicer::Open(int fd)
+{
+	if (fcntl(fd, F_GETPIPE_SZ) < 0)
+		throw MakeErrno("Not a pipe");
+
+	Allocate(GetPipeSize(fd));
+}
+
+void
+PipeSplicer::Close() noexcept
+{
+	if (buffer != nullptr) {
+		HugeFree(buffer, buffer_size);
+		buffer = nullptr;
+	}
+}
+
+ssize_t
+PipeSplicer::Write(int fd, const void *data, size_t size,
+		   bool nonblock) noexcept
+{
+	if (position >= buffer_size) {
+		/* wrap around; this is a good time to check whether
+		   the reader has enlarged the pipe */
+		const size_t new_pipe_size = GetPipeSize(fd);
+		if (new_pipe_size > pipe_size) {
+			try {
+				Allocate(new_pipe_size);
+			} catch (...) {
+				errno = ENOMEM;
+				return -1;
+			}
+		} else
+			position = 0;
+	}
+
+	size = std::min({size, pipe_size, buffer_size - position});
+
+	uint8_t *dest = buffer + position;
+	memcpy(dest, data, size);
+
+	struct iovec iov;
+	iov.iov_base = dest;
+	iov.iov_len = size;
+
+	ssize_t nbytes = vmsplice(fd, &iov, 1,
+				  nonblock ? SPLICE_F_NONBLOCK : 0);
+	if (nbytes > 0)
+		position += nbytes;
+
+	return nbytes;
+}
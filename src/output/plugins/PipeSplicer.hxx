@@ -0,0 +1,90 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PIPE_SPLICER_HXX
+#define MPD_PIPE_SPLICER_HXX
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Passes audio data to a pipe with vmsplice() instead of write().
+ *
+ * The data is copied into a page-aligned export ring buffer, and
+ * vmsplice() hands references to these pages to the kernel instead
+ * of copying them into pipe buffers.  Readers which splice() the
+ * data onwards (e.g. into a file or a socket) never copy it.
+ *
+ * The ring is several times larger than the pipe, and a single
+ * write never exceeds the pipe size, so a page is overwritten only
+ * after it has left the pipe.  The pipe size is checked again each
+ * time the ring wraps around, in case the reader has enlarged it.
+ *
+ * This class is only available on Linux.
+ */
+class PipeSplicer {
+	uint8_t *buffer = nullptr;
+	size_t buffer_size = 0;
+
+	/**
+	 * The position within #buffer where the next write starts.
+	 */
+	size_t position;
+
+	/**
+	 * The capacity of the pipe as reported by F_GETPIPE_SZ; no
+	 * single vmsplice() call may exceed it.
+	 */
+	size_t pipe_size;
+
+public:
+	PipeSplicer() = default;
+
+	~PipeSplicer() noexcept {
+		Close();
+	}
+
+	PipeSplicer(const PipeSplicer &) = delete;
+	PipeSplicer &operator=(const PipeSplicer &) = delete;
+
+	/**
+	 * Allocate the export buffer for the given pipe.
+	 *
+	 * Throws on error.
+	 */
+	void Open(int fd);
+
+	void Close() noexcept;
+
+	/**
+	 * Copy data into the export buffer and vmsplice() it into the
+	 * pipe.
+	 *
+	 * @return the number of bytes consumed, or -1 with errno set
+	 * (just like write())
+	 */
+	ssize_t Write(int fd, const void *data, size_t size,
+		      bool nonblock) noexcept;
+
+private:
+	void Allocate(size_t _pipe_size);
+};
+
+#endif
@@ -38,6 +38,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MPD_PULSE_NAME "Music Player Daemon"
 
@@ -796,12 +797,30 @@ PulseOutput::Play(const void *chunk, size_t size)
 		/* don't send more than possible */
 		size = writable;
 
+	/* copy the data directly into a memblock obtained from
+	   libpulse (which is shared with the server if SHM is
+	   available); this way, pa_stream_write() does not need to
+	   allocate a memblock and copy the buffer once more */
+
+	void *data;
+	size_t data_size = size;
+	if (pa_stream_begin_write(stream, &data, &data_size) < 0)
+		throw MakePulseError(context,
+				     "pa_stream_begin_write() failed");
+
+	if (size > data_size)
+		size = data_size;
+
+	memcpy(data, chunk, size);
+
 	writable -= size;
 
-	int result = pa_stream_write(stream, chunk, size, nullptr,
+	int result = pa_stream_write(stream, data, size, nullptr,
 				     0, PA_SEEK_RELATIVE);
-	if (result < 0)
+	if (result < 0) {
+		pa_stream_cancel_write(stream);
 		throw MakePulseError(context, "pa_stream_write() failed");
+	}
 
 	return size;
 }
@@ -18,12 +18,15 @@
  */
 
 #include "RecorderOutputPlugin.hxx"
+#include "ThreadOutputStream.hxx"
 #include "../OutputAPI.hxx"
 #include "tag/Format.hxx"
 #include "encoder/ToOutputStream.hxx"
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/Configured.hxx"
 #include "config/Path.hxx"
+#include "config/Parser.hxx"
+#include "config/Block.hxx"
 #include "Log.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/io/FileOutputStream.hxx"
@@ -62,11 +65,22 @@ class RecorderOutput final : AudioOutput {
 	 */
 	AudioFormat effective_audio_format;
 
+	/**
+	 * The size of the write buffer; 0 means write synchronously.
+	 */
+	size_t buffer_size;
+
 	/**
 	 * The destination file.
 	 */
 	FileOutputStream *file;
 
+	/**
+	 * Writes to #file in a separate thread (if #buffer_size is
+	 * non-zero).
+	 */
+	std::unique_ptr<ThreadOutputStream> writer;
+
 	RecorderOutput(const ConfigBlock &block);
 
 public:
@@ -93,6 +107,29 @@ private:
 		return !format_path.empty();
 	}
 
+	/**
+	 * Create #file and #writer.
+	 *
+	 * Throws on error.
+	 */
+	void OpenFile(Path p);
+
+	/**
+	 * Delete #writer (discarding buffered data) and #file.
+	 */
+	void DeleteFile() noexcept;
+
+	/**
+	 * The stream which receives the encoder output.
+	 */
+	OutputStream &GetOutputStream() noexcept {
+		assert(file != nullptr);
+
+		if (writer)
+			return *writer;
+		return *file;
+	}
+
 	/**
 	 * Finish the encoder and commit the file.
 	 *
@@ -121,14 +158,42 @@ RecorderOutput::RecorderOutput(const ConfigBlock &block)
 
 	if (!path.IsNull() && fmt != nullptr)
 		throw std::runtime_error("Cannot have both 'path' and 'format_path'");
+
+	buffer_size = 4 * 1024 * 1024;
+	const auto *buffer_size_param = block.GetBlockParam("buffer_size");
+	if (buffer_size_param != nullptr)
+		buffer_size = buffer_size_param->With([](const char *s){
+			return ParseSize(s);
+		});
+}
+
+void
+RecorderOutput::OpenFile(Path p)
+{
+	file = new FileOutputStream(p);
+
+	if (buffer_size > 0) {
+		try {
+			writer = std::make_unique<ThreadOutputStream>(*file,
+								      buffer_size);
+		} catch (...) {
+			delete file;
+			throw;
+		}
+	}
+}
+
+void
+RecorderOutput::DeleteFile() noexcept
+{
+	writer.reset();
+	delete file;
 }
 
 inline void
 RecorderOutput::EncoderToFile()
 {
-	assert(file != nullptr);
-
-	EncoderToOutputStream(*file, *encoder);
+	EncoderToOutputStream(GetOutputStream(), *encoder);
 }
 
 void
@@ -139,7 +204,7 @@ RecorderOutput::Open(AudioFormat &audio_format)
 	if (!HasDynamicPath()) {
 		assert(!path.IsNull());
 
-		file = new FileOutputStream(path);
+		OpenFile(path);
 	} else {
 		/* don't open the file just yet; wait until we have
 		   a tag that we can use to build the path */
@@ -153,7 +218,8 @@ RecorderOutput::Open(AudioFormat &audio_format)
 	try {
 		encoder = prepared_encoder->Open(audio_format);
 	} catch (...) {
-		delete file;
+		if (!HasDynamicPath())
+			DeleteFile();
 		throw;
 	}
 
@@ -162,6 +228,7 @@ RecorderOutput::Open(AudioFormat &audio_format)
 			EncoderToFile();
 		} catch (...) {
 			delete encoder;
+			DeleteFile();
 			throw;
 		}
 	} else {
@@ -186,6 +253,7 @@ RecorderOutput::Commit()
 		EncoderToFile();
 	} catch (...) {
 		delete encoder;
+		DeleteFile();
 		throw;
 	}
 
@@ -194,13 +262,19 @@ RecorderOutput::Commit()
 	delete encoder;
 
 	try {
+		if (writer) {
+			/* wait for the writer thread to finish */
+			writer->Flush();
+			writer.reset();
+		}
+
 		file->Commit();
 	} catch (...) {
-		delete file;
+		DeleteFile();
 		throw;
 	}
 
-	delete file;
+	DeleteFile();
 }
 
 void
@@ -251,14 +325,15 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path)
 	assert(path.IsNull());
 	assert(file == nullptr);
 
-	FileOutputStream *new_file = new FileOutputStream(new_path);
+	OpenFile(new_path);
 
 	AudioFormat new_audio_format = effective_audio_format;
 
 	try {
 		encoder = prepared_encoder->Open(new_audio_format);
 	} catch (...) {
-		delete new_file;
+		DeleteFile();
+		file = nullptr;
 		throw;
 	}
 
@@ -267,15 +342,15 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path)
 	assert(new_audio_format == effective_audio_format);
 
 	try {
-		EncoderToOutputStream(*new_file, *encoder);
+		EncoderToFile();
 	} catch (...) {
 		delete encoder;
-		delete new_file;
+		DeleteFile();
+		file = nullptr;
 		throw;
 	}
 
 	path = std::move(new_path);
-	file = new_file;
 
 	FormatDebug(recorder_domain, "Recording to \"%s\"",
 		    path.ToUTF8().c_str());
@@ -0,0 +1,287 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "RtpOutputPlugin.hxx"
+#include "../OutputAPI.hxx"
+#include "../Timer.hxx"
+#include "net/Resolver.hxx"
+#include "net/AddressInfo.hxx"
+#include "net/SocketDescriptor.hxx"
+#include "net/SocketError.hxx"
+#include "util/ByteOrder.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+/**
+ * The IANA port number assigned to RTP media (RFC 3551).
+ */
+static constexpr unsigned DEFAULT_PORT = 5004;
+
+/**
+ * The default maximum payload size per packet.  Together with the
+ * IP/UDP/RTP headers, this stays well below the usual Ethernet MTU,
+ * so packets do not get fragmented.
+ */
+static constexpr size_t DEFAULT_MAX_PAYLOAD = 1200;
+
+static constexpr size_t RTP_HEADER_SIZE = 12;
+
+/**
+ * The first dynamic payload type (RFC 3551 6).
+ */
+static constexpr unsigned RTP_DYNAMIC_PAYLOAD_TYPE = 96;
+
+class RtpOutput final : AudioOutput {
+	const std::string address;
+	const unsigned ttl;
+	const size_t max_payload;
+
+	/**
+	 * The configured payload type; 0 means it is chosen
+	 * automatically in Open().
+	 */
+	const unsigned configured_payload_type;
+
+	SocketDescriptor fd = SocketDescriptor::Undefined();
+
+	Timer *timer;
+
+	std::unique_ptr<uint8_t[]> packet;
+
+	size_t frame_size;
+
+	uint32_t ssrc, timestamp;
+	uint16_t sequence;
+	uint8_t payload_type;
+
+public:
+	explicit RtpOutput(const ConfigBlock &block);
+
+	static AudioOutput *Create(EventLoop &,
+				   const ConfigBlock &block) {
+		return new RtpOutput(block);
+	}
+
+private:
+	void Open(AudioFormat &audio_format) override;
+	void Close() noexcept override;
+
+	std::chrono::steady_clock::duration Delay() const noexcept override {
+		return timer->IsStarted()
+			? timer->GetDelay()
+			: std::chrono::steady_clock::duration::zero();
+	}
+
+	size_t Play(const void *chunk, size_t size) override;
+
+	void Cancel() noexcept override {
+		timer->Reset();
+	}
+
+	void Connect();
+};
+
+RtpOutput::RtpOutput(const ConfigBlock &block)
+	:AudioOutput(FLAG_SOFTWARE_CLOCK),
+	 address(block.GetBlockValue("address", "")),
+	 ttl(block.GetBlockValue("ttl", 1U)),
+	 max_payload(block.GetPositiveValue("max_payload",
+					    unsigned(DEFAULT_MAX_PAYLOAD))),
+	 configured_payload_type(block.GetBlockValue("payload_type", 0U))
+{
+	if (address.empty())
+		throw std::runtime_error("No \"address\" parameter specified");
+
+	if (ttl > 255)
+		throw FormatRuntimeError("Invalid \"ttl\" value: %u", ttl);
+
+	if (configured_payload_type != 0 &&
+	    configured_payload_type < RTP_DYNAMIC_PAYLOAD_TYPE)
+		throw std::runtime_error("\"payload_type\" must be a dynamic payload type (96-127)");
+
+	if (configured_payload_type > 127)
+		throw FormatRuntimeError("Invalid \"payload_type\" value: %u",
+					 configured_payload_type);
+}
+
+/**
+ * Choose a payload type for "L16".  RFC 3551 assigns static payload
+ * types only to 44.1 kHz stereo and mono; everything else needs a
+ * dynamic type, which the receiver must be told about out of band
+ * (e.g. with a SDP file).
+ */
+gcc_const
+static uint8_t
+ChooseL16PayloadType(const AudioFormat &af) noexcept
+{
+	if (af.sample_rate == 44100) {
+		if (af.channels == 2)
+			return 10;
+		if (af.channels == 1)
+			return 11;
+	}
+
+	return RTP_DYNAMIC_PAYLOAD_TYPE;
+}
+
+/**
+ * A unicast receiver which is not (yet) listening triggers an ICMP
+ * "port unreachable", which gets reported by the next send() call.
+ * This is not fatal; the receiver may come up later.
+ */
+gcc_const
+static bool
+IsConnectionRefused(socket_error_t code) noexcept
+{
+#ifdef _WIN32
+	return code == WSAECONNREFUSED;
+#else
+	return code == ECONNREFUSED;
+#endif
+}
+
+inline void
+RtpOutput::Connect()
+{
+	const auto ai = Resolve(address.c_str(), DEFAULT_PORT,
+				0, SOCK_DGRAM);
+	const auto &a = ai.front();
+
+	if (!fd.Create(a.GetFamily(), a.GetType(), a.GetProtocol()))
+		throw MakeSocketError("Failed to create socket");
+
+	/* these only affect multicast destinations; for unicast,
+	   the kernel ignores them */
+	const int value = ttl;
+	if (a.GetFamily() == AF_INET)
+		fd.SetOption(IPPROTO_IP, IP_MULTICAST_TTL,
+			     &value, sizeof(value));
+#ifdef IPV6_MULTICAST_HOPS
+	else if (a.GetFamily() == AF_INET6)
+		fd.SetOption(IPPROTO_IPV6, IPV6_MULTICAST_HOPS,
+			     &value, sizeof(value));
+#endif
+
+	if (!fd.Connect(a)) {
+		const auto e = GetSocketError();
+		fd.Close();
+		throw MakeSocketError(e, "Failed to connect");
+	}
+}
+
+void
+RtpOutput::Open(AudioFormat &audio_format)
+{
+	/* the only PCM payload we send is "L16": 16 bit signed
+	   big-endian (RFC 3551 4.5.11) */
+	audio_format.format = SampleFormat::S16;
+
+	frame_size = audio_format.GetFrameSize();
+	if (max_payload < frame_size)
+		throw std::runtime_error("\"max_payload\" is too small");
+
+	payload_type = configured_payload_type != 0
+		? configured_payload_type
+		: ChooseL16PayloadType(audio_format);
+
+	Connect();
+
+	packet.reset(new uint8_t[RTP_HEADER_SIZE + max_payload]);
+
+	/* RFC 3550 5.1: the SSRC and the initial values of sequence
+	   number and timestamp should be random */
+	std::random_device rd;
+	ssrc = rd();
+	timestamp = rd();
+	sequence = rd();
+
+	timer = new Timer(audio_format);
+}
+
+void
+RtpOutput::Close() noexcept
+{
+	delete timer;
+	packet.reset();
+	fd.Close();
+}
+
+size_t
+RtpOutput::Play(const void *chunk, size_t size)
+{
+	if (!timer->IsStarted())
+		timer->Start();
+
+	/* send as many whole frames as fit into one packet */
+	const size_t n_frames = std::min(size, max_payload) / frame_size;
+	const size_t payload_size = n_frames * frame_size;
+	if (payload_size == 0)
+		/* cannot happen, MPD only passes whole frames */
+		return size;
+
+	uint8_t *p = packet.get();
+	p[0] = 0x80; /* version 2, no padding, no extension, no CSRC */
+	p[1] = payload_type;
+
+	const uint16_t sequence_be = ToBE16(sequence++);
+	memcpy(p + 2, &sequence_be, sizeof(sequence_be));
+
+	const uint32_t timestamp_be = ToBE32(timestamp);
+	memcpy(p + 4, &timestamp_be, sizeof(timestamp_be));
+	timestamp += n_frames;
+
+	const uint32_t ssrc_be = ToBE32(ssrc);
+	memcpy(p + 8, &ssrc_be, sizeof(ssrc_be));
+
+	const auto *src = (const uint16_t *)chunk;
+	auto *dest = (uint16_t *)(void *)(p + RTP_HEADER_SIZE);
+	for (size_t i = 0, n = payload_size / sizeof(*src); i < n; ++i)
+		dest[i] = ToBE16(src[i]);
+
+	if (fd.Write(p, RTP_HEADER_SIZE + payload_size) < 0) {
+		const auto e = GetSocketError();
+		if (!IsConnectionRefused(e))
+			throw MakeSocketError(e, "Failed to send RTP packet");
+	}
+
+	timer->Add(payload_size);
+	return payload_size;
+}
+
+const struct AudioOutputPlugin rtp_output_plugin = {
+	"rtp",
+	nullptr,
+	&RtpOutput::Create,
+	nullptr,
+};
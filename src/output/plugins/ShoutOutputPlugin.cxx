@@ -32,12 +32,15 @@
 
 #include <stdexcept>
 #include <memory>
+#include <thread>
 
 #include <assert.h>
 #include <stdio.h>
 
 static constexpr unsigned DEFAULT_CONN_TIMEOUT = 2;
 
+static constexpr unsigned DEFAULT_MAX_QUEUE = 256 * 1024;
+
 struct ShoutOutput final : AudioOutput {
 	shout_t *shout_conn;
 
@@ -46,6 +49,20 @@ struct ShoutOutput final : AudioOutput {
 
 	int timeout = DEFAULT_CONN_TIMEOUT;
 
+	/**
+	 * If libshout's send queue grows larger than this number of
+	 * bytes, then new PCM data is discarded instead of being
+	 * encoded.
+	 */
+	size_t max_queue = DEFAULT_MAX_QUEUE;
+
+	/**
+	 * Are we currently discarding PCM data because the server
+	 * does not keep up?  Used to log only one message per
+	 * congestion.
+	 */
+	bool skipping;
+
 	uint8_t buffer[32768];
 
 	explicit ShoutOutput(const ConfigBlock &block);
@@ -65,6 +82,15 @@ struct ShoutOutput final : AudioOutput {
 
 private:
 	void WritePage();
+
+	/**
+	 * Send as much of libshout's queue as possible without
+	 * blocking.
+	 *
+	 * @return true if the queue is small enough to accept more
+	 * data
+	 */
+	bool Flush();
 };
 
 static int shout_init_count;
@@ -173,11 +199,14 @@ ShoutOutput::ShoutOutput(const ConfigBlock &block)
 #ifdef SHOUT_TLS
 	    shout_set_tls(shout_conn, tls) != SHOUTERR_SUCCESS ||
 #endif
-	    shout_set_agent(shout_conn, "MPD") != SHOUTERR_SUCCESS)
+	    shout_set_agent(shout_conn, "MPD") != SHOUTERR_SUCCESS ||
+	    /* never block the output thread on a slow server */
+	    shout_set_nonblocking(shout_conn, 1) != SHOUTERR_SUCCESS)
 		throw std::runtime_error(shout_get_error(shout_conn));
 
 	/* optional paramters */
 	timeout = block.GetBlockValue("timeout", DEFAULT_CONN_TIMEOUT);
+	max_queue = block.GetPositiveValue("max_queue", DEFAULT_MAX_QUEUE);
 
 	value = block.GetBlockValue("genre");
 	if (value != nullptr && shout_set_genre(shout_conn, value))
@@ -226,6 +255,8 @@ HandleShoutError(shout_t *shout_conn, int err)
 {
 	switch (err) {
 	case SHOUTERR_SUCCESS:
+	case SHOUTERR_BUSY:
+		/* non-blocking mode: the data has been queued */
 		break;
 
 	case SHOUTERR_UNCONNECTED:
@@ -265,6 +296,29 @@ ShoutOutput::WritePage()
 	EncoderToShout(shout_conn, *encoder, buffer, sizeof(buffer));
 }
 
+bool
+ShoutOutput::Flush()
+{
+	/* a zero-length shout_send() only sends the queue */
+	HandleShoutError(shout_conn, shout_send(shout_conn, nullptr, 0));
+
+	const auto queue_length = shout_queuelen(shout_conn);
+	if (queue_length >= 0 && size_t(queue_length) > max_queue) {
+		if (!skipping) {
+			skipping = true;
+			FormatWarning(shout_output_domain,
+				      "Server %s:%i does not keep up, skipping audio",
+				      shout_get_host(shout_conn),
+				      shout_get_port(shout_conn));
+		}
+
+		return false;
+	}
+
+	skipping = false;
+	return true;
+}
+
 void
 ShoutOutput::Close() noexcept
 {
@@ -292,9 +346,27 @@ ShoutOutput::Cancel() noexcept
 }
 
 static void
-ShoutOpen(shout_t *shout_conn)
+ShoutOpen(shout_t *shout_conn, std::chrono::steady_clock::duration timeout)
 {
-	switch (shout_open(shout_conn)) {
+	int result = shout_open(shout_conn);
+
+	/* in non-blocking mode, wait until the connection has been
+	   established (but not longer than the configured
+	   timeout) */
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (result == SHOUTERR_BUSY) {
+		if (std::chrono::steady_clock::now() >= deadline) {
+			shout_close(shout_conn);
+			throw FormatRuntimeError("timeout connecting to shout server %s:%i",
+						 shout_get_host(shout_conn),
+						 shout_get_port(shout_conn));
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		result = shout_get_connected(shout_conn);
+	}
+
+	switch (result) {
 	case SHOUTERR_SUCCESS:
 	case SHOUTERR_CONNECTED:
 		break;
@@ -314,7 +386,8 @@ ShoutOutput::Open(AudioFormat &audio_format)
 
 	try {
 		ShoutSetAudioInfo(shout_conn, audio_format);
-		ShoutOpen(shout_conn);
+		ShoutOpen(shout_conn, std::chrono::seconds(timeout));
+		skipping = false;
 		WritePage();
 	} catch (...) {
 		delete encoder;
@@ -335,6 +408,12 @@ ShoutOutput::Delay() const noexcept
 size_t
 ShoutOutput::Play(const void *chunk, size_t size)
 {
+	if (!Flush())
+		/* the server is congested: skip this chunk (before
+		   encoding it, so the encoded stream remains
+		   valid) */
+		return size;
+
 	encoder->Write(chunk, size);
 	WritePage();
 	return size;
@@ -345,8 +424,10 @@ ShoutOutput::Pause()
 {
 	static char silence[1020];
 
-	encoder->Write(silence, sizeof(silence));
-	WritePage();
+	if (Flush()) {
+		encoder->Write(silence, sizeof(silence));
+		WritePage();
+	}
 
 	return true;
 }
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ThreadOutputStream.hxx"
+#include "thread/Name.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <chrono>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr Domain thread_output_stream_domain("thread_output_stream");
+
+/**
+ * Wake up the thread as soon as this many bytes are buffered.
+ */
+static constexpr size_t WRITE_BATCH = 256 * 1024;
+
+/**
+ * Write buffered data at least this often, even if there is less than
+ * #WRITE_BATCH.
+ */
+static constexpr std::chrono::steady_clock::duration MAX_WRITE_DELAY =
+	std::chrono::seconds(1);
+
+ThreadOutputStream::ThreadOutputStream(OutputStream &_next,
+				       size_t buffer_size)
+	:next(_next),
+	 thread(BIND_THIS_METHOD(Run)),
+	 allocation(buffer_size),
+	 buffer(&allocation.front(), allocation.size())
+{
+	allocation.ForkCow(false);
+
+	thread.Start();
+}
+
+ThreadOutputStream::~ThreadOutputStream() noexcept
+{
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		quit = true;
+		wake_cond.notify_one();
+	}
+
+	thread.Join();
+}
+
+void
+ThreadOutputStream::Flush()
+{
+	std::unique_lock<Mutex> lock(mutex);
+
+	flush = true;
+	wake_cond.notify_one();
+
+	done_cond.wait(lock, [this]{
+		return buffer.empty() || postponed_exception;
+	});
+
+	flush = false;
+
+	if (postponed_exception)
+		std::rethrow_exception(postponed_exception);
+}
+
+void
+ThreadOutputStream::Write(const void *_data, size_t size)
+{
+	const auto *data = (const uint8_t *)_data;
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	if (postponed_exception)
+		std::rethrow_exception(postponed_exception);
+
+	if (size > buffer.GetSpace()) {
+		/* the writer thread does not keep up; discard the
+		   data instead of blocking the caller */
+		if (dropped == 0) {
+			const ScopeUnlock unlock(mutex);
+			LogWarning(thread_output_stream_domain,
+				   "Write buffer is full, discarding data");
+		}
+
+		dropped += size;
+		return;
+	}
+
+	if (dropped > 0) {
+		const size_t n = dropped;
+		dropped = 0;
+
+		const ScopeUnlock unlock(mutex);
+		FormatWarning(thread_output_stream_domain,
+			      "Discarded %zu bytes", n);
+	}
+
+	while (size > 0) {
+		auto w = buffer.Write();
+		assert(!w.empty());
+
+		const size_t nbytes = std::min(w.size, size);
+		memcpy(w.data, data, nbytes);
+		buffer.Append(nbytes);
+
+		data += nbytes;
+		size -= nbytes;
+	}
+
+	if (buffer.GetSize() >= WRITE_BATCH)
+		wake_cond.notify_one();
+}
+
+inline void
+ThreadOutputStream::Run() noexcept
+{
+	SetThreadName("output_stream");
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (!quit) {
+		if (buffer.empty()) {
+			done_cond.notify_all();
+			wake_cond.wait(lock);
+			continue;
+		}
+
+		if (buffer.GetSize() < WRITE_BATCH && !flush)
+			/* wait for more data to collect a large
+			   batch, but don't keep it around for too
+			   long */
+			(void)wake_cond.wait_for(lock, MAX_WRITE_DELAY);
+
+		if (quit)
+			break;
+
+		const auto r = buffer.Read();
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			next.Write(r.data, r.size);
+		} catch (...) {
+			postponed_exception = std::current_exception();
+			done_cond.notify_all();
+			break;
+		}
+
+		buffer.Consume(r.size);
+	}
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_OUTPUT_STREAM_HXX
+#define MPD_THREAD_OUTPUT_STREAM_HXX
+
+#include "fs/io/OutputStream.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/HugeAllocator.hxx"
+#include "util/CircularBuffer.hxx"
+
+#include <exception>
+
+#include <stdint.h>
+
+/**
+ * An #OutputStream which copies all data into a ring buffer and
+ * writes it to another #OutputStream in a dedicated thread, in large
+ * batches.  This way, a slow disk never blocks the caller.
+ *
+ * If the buffer is full, Write() discards the data instead of
+ * waiting.
+ */
+class ThreadOutputStream final : public OutputStream {
+	OutputStream &next;
+
+	Thread thread;
+
+	mutable Mutex mutex;
+
+	/**
+	 * Signalled when the thread shall be woken up: when enough
+	 * data has been buffered, on Flush() and when the thread
+	 * shall quit.
+	 */
+	Cond wake_cond;
+
+	/**
+	 * Signalled by the thread when the buffer has run empty or
+	 * an error has occurred.
+	 */
+	Cond done_cond;
+
+	std::exception_ptr postponed_exception;
+
+	HugeArray<uint8_t> allocation;
+
+	CircularBuffer<uint8_t> buffer;
+
+	/**
+	 * The number of bytes discarded because the buffer was
+	 * full; it is logged when writing succeeds again.
+	 */
+	size_t dropped = 0;
+
+	/**
+	 * Shall the thread write all buffered data now?
+	 */
+	bool flush = false;
+
+	/**
+	 * Shall the thread quit?
+	 */
+	bool quit = false;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param _next the stream which receives the data; it must
+	 * stay valid until this object is destroyed
+	 */
+	ThreadOutputStream(OutputStream &_next, size_t buffer_size);
+
+	/**
+	 * Stop the thread, discarding all data which has not been
+	 * written yet.
+	 */
+	~ThreadOutputStream() noexcept;
+
+	/**
+	 * Wait until all buffered data has been passed to the
+	 * underlying stream.
+	 *
+	 * Throws on error.
+	 */
+	void Flush();
+
+	/* virtual methods from class OutputStream */
+	void Write(const void *data, size_t size) override;
+
+private:
+	void Run() noexcept;
+};
+
+#endif
@@ -27,9 +27,16 @@
 #include "net/UniqueSocketDescriptor.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 
 HttpdClient::~HttpdClient() noexcept
 {
@@ -56,7 +63,13 @@ HttpdClient::BeginResponse() noexcept
 	assert(state != State::RESPONSE);
 
 	state = State::RESPONSE;
+
+	const std::lock_guard<Mutex> protect(httpd.mutex);
+
+	/* start with the configured burst of recent pages, or
+	   with the next page broadcasted by the encoder */
 	current_page = nullptr;
+	next_page = httpd.GetBurstPosition();
 
 	if (!head_method)
 		httpd.SendHeader(*this);
@@ -188,31 +201,13 @@ HttpdClient::HttpdClient(HttpdOutput &_httpd, UniqueSocketDescriptor _fd,
 {
 }
 
-void
-HttpdClient::ClearQueue() noexcept
-{
-	assert(state == State::RESPONSE);
-
-	while (!pages.empty()) {
-#ifndef NDEBUG
-		auto &page = pages.front();
-		assert(queue_size >= page->GetSize());
-		queue_size -= page->GetSize();
-#endif
-
-		pages.pop();
-	}
-
-	assert(queue_size == 0);
-}
-
 void
 HttpdClient::CancelQueue() noexcept
 {
 	if (state != State::RESPONSE)
 		return;
 
-	ClearQueue();
+	next_page = httpd.GetPages().GetTail();
 
 	if (current_page == nullptr)
 		CancelWrite();
@@ -228,22 +223,75 @@ HttpdClient::TryWritePage(const Page &page, size_t position) noexcept
 }
 
 ssize_t
-HttpdClient::TryWritePageN(const Page &page,
-			   size_t position, ssize_t n) noexcept
+HttpdClient::TryWritePages(const PageRing &ring, size_t max_size) noexcept
 {
-	return n >= 0
-		? GetSocket().Write(page.GetData() + position, n)
-		: TryWritePage(page, position);
+	assert(!IsQueueEmpty(ring));
+	assert(max_size > 0);
+
+#ifdef _WIN32
+	/* no vectored I/O; send just the first page */
+	const Page &page = current_page != nullptr
+		? *current_page
+		: *ring.Get(next_page);
+	const size_t position = current_page != nullptr
+		? current_position
+		: 0;
+
+	return GetSocket().Write(page.GetData() + position,
+				 std::min(page.GetSize() - position,
+					  max_size));
+#else
+	static constexpr size_t MAX_VECTORS = 32;
+	struct iovec v[MAX_VECTORS];
+	size_t n = 0;
+
+	auto append = [&](const Page &page, size_t position){
+		const size_t size = std::min(page.GetSize() - position,
+					     max_size);
+		v[n].iov_base = const_cast<uint8_t *>(page.GetData() + position);
+		v[n].iov_len = size;
+		++n;
+		max_size -= size;
+	};
+
+	if (current_page != nullptr)
+		append(*current_page, current_position);
+
+	for (auto p = next_page;
+	     p != ring.GetTail() && n < MAX_VECTORS && max_size > 0; ++p)
+		append(*ring.Get(p), 0);
+
+	return GetSocket().Write(v, n);
+#endif
 }
 
-ssize_t
-HttpdClient::GetBytesTillMetaData() const noexcept
+void
+HttpdClient::ConsumePages(const PageRing &ring, size_t nbytes) noexcept
 {
-	if (metadata_requested &&
-	    current_page->GetSize() - current_position > metaint - metadata_fill)
-		return metaint - metadata_fill;
+	if (current_page != nullptr) {
+		const size_t remaining = current_page->GetSize() - current_position;
+		if (nbytes < remaining) {
+			current_position += nbytes;
+			return;
+		}
+
+		nbytes -= remaining;
+		current_page.reset();
+	}
+
+	while (nbytes > 0) {
+		const auto &page = ring.Get(next_page++);
+		if (nbytes < page->GetSize()) {
+			/* keep a reference to the partially sent
+			   page, because it may be evicted from the
+			   ring before we get to send the rest */
+			current_page = page;
+			current_position = nbytes;
+			return;
+		}
 
-	return -1;
+		nbytes -= page->GetSize();
+	}
 }
 
 inline bool
@@ -253,25 +301,25 @@ HttpdClient::TryWrite() noexcept
 
 	assert(state == State::RESPONSE);
 
-	if (current_page == nullptr) {
-		if (pages.empty()) {
-			/* another thread has removed the event source
-			   while this thread was waiting for
-			   httpd.mutex */
-			CancelWrite();
-			return true;
-		}
+	const auto &ring = httpd.GetPages();
 
-		current_page = pages.front();
-		pages.pop();
-		current_position = 0;
+	if (ring.IsEvicted(next_page)) {
+		FormatDebug(httpd_output_domain,
+			    "client is too slow, skipping pages");
 
-		assert(queue_size >= current_page->GetSize());
-		queue_size -= current_page->GetSize();
+		/* continue with the newest page */
+		next_page = std::max(ring.GetHead(), ring.GetTail() - 1);
 	}
 
-	const ssize_t bytes_to_write = GetBytesTillMetaData();
-	if (bytes_to_write == 0) {
+	if (IsQueueEmpty(ring)) {
+		/* another thread has removed the event source
+		   while this thread was waiting for
+		   httpd.mutex */
+		CancelWrite();
+		return true;
+	}
+
+	if (metadata_requested && metadata_fill >= metaint) {
 		if (!metadata_sent) {
 			ssize_t nbytes = TryWritePage(*metadata,
 						      metadata_current_position);
@@ -322,9 +370,11 @@ HttpdClient::TryWrite() noexcept
 			metadata_current_position = 0;
 		}
 	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
+		const size_t max_size = metadata_requested
+			? metaint - metadata_fill
+			: SIZE_MAX;
+
+		ssize_t nbytes = TryWritePages(ring, max_size);
 		if (nbytes < 0) {
 			auto e = GetSocketError();
 			if (IsSocketErrorAgain(e))
@@ -341,41 +391,39 @@ HttpdClient::TryWrite() noexcept
 			return false;
 		}
 
-		current_position += nbytes;
-		assert(current_position <= current_page->GetSize());
+		ConsumePages(ring, nbytes);
 
 		if (metadata_requested)
 			metadata_fill += nbytes;
 
-		if (current_position >= current_page->GetSize()) {
-			current_page.reset();
-
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
+		if (IsQueueEmpty(ring))
+			/* all pages are sent: remove the event
+			   source */
+			CancelWrite();
 	}
 
 	return true;
 }
 
 void
-HttpdClient::PushPage(PagePtr page) noexcept
+HttpdClient::PushHeader(PagePtr page) noexcept
+{
+	assert(state == State::RESPONSE);
+	assert(current_page == nullptr);
+
+	current_page = std::move(page);
+	current_position = 0;
+
+	ScheduleWrite();
+}
+
+void
+HttpdClient::NotifyPages() noexcept
 {
 	if (state != State::RESPONSE)
 		/* the client is still writing the HTTP request */
 		return;
 
-	if (queue_size > 256 * 1024) {
-		FormatDebug(httpd_output_domain,
-			    "client is too slow, flushing its queue");
-		ClearQueue();
-	}
-
-	queue_size += page->GetSize();
-	pages.emplace(std::move(page));
-
 	ScheduleWrite();
 }
 
@@ -21,15 +21,13 @@
 #define MPD_OUTPUT_HTTPD_CLIENT_HXX
 
 #include "Page.hxx"
+#include "PageRing.hxx"
 #include "event/BufferedSocket.hxx"
 #include "util/Compiler.h"
 
 #include <boost/intrusive/link_mode.hpp>
 #include <boost/intrusive/list_hook.hpp>
 
-#include <queue>
-#include <list>
-
 #include <stddef.h>
 
 class UniqueSocketDescriptor;
@@ -58,17 +56,18 @@ class HttpdClient final
 	} state = State::REQUEST;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
+	 * The position of the next page in the #HttpdOutput's
+	 * #PageRing to be sent to this client.  The ring is shared by
+	 * all clients; this is all the per-client state needed to
+	 * broadcast a page.
 	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
+	PageRing::Position next_page = 0;
 
 	/**
-	 * The sum of all page sizes in #pages.
-	 */
-	size_t queue_size = 0;
-
-	/**
-	 * The #page which is currently being sent to the client.
+	 * The #Page which is currently being sent to the client.
+	 * This is either the encoder header or a page from the ring
+	 * which was only sent partially (so it survives eviction from
+	 * the ring).
 	 */
 	PagePtr current_page;
 
@@ -155,7 +154,9 @@ public:
 	void LockClose() noexcept;
 
 	/**
-	 * Clears the page queue.
+	 * Skip all pending pages.
+	 *
+	 * Caller must lock the mutex.
 	 */
 	void CancelQueue() noexcept;
 
@@ -174,19 +175,30 @@ public:
 	 */
 	bool SendResponse() noexcept;
 
-	gcc_pure
-	ssize_t GetBytesTillMetaData() const noexcept;
-
 	ssize_t TryWritePage(const Page &page, size_t position) noexcept;
-	ssize_t TryWritePageN(const Page &page,
-			      size_t position, ssize_t n) noexcept;
+
+	/**
+	 * Send as much as possible of #current_page and the pages
+	 * from the ring (at most #max_size bytes) with one system
+	 * call.
+	 */
+	ssize_t TryWritePages(const PageRing &ring, size_t max_size) noexcept;
 
 	bool TryWrite() noexcept;
 
 	/**
-	 * Appends a page to the client's queue.
+	 * Sends this page (the encoder header) before all pages from
+	 * the ring.
+	 */
+	void PushHeader(PagePtr page) noexcept;
+
+	/**
+	 * New pages have been added to the #HttpdOutput's
+	 * #PageRing.
+	 *
+	 * Caller must lock the mutex.
 	 */
-	void PushPage(PagePtr page) noexcept;
+	void NotifyPages() noexcept;
 
 	/**
 	 * Sends the passed metadata.
@@ -194,7 +206,15 @@ public:
 	void PushMetaData(PagePtr page) noexcept;
 
 private:
-	void ClearQueue() noexcept;
+	gcc_pure
+	bool IsQueueEmpty(const PageRing &ring) const noexcept {
+		return current_page == nullptr && next_page == ring.GetTail();
+	}
+
+	/**
+	 * Mark the given number of bytes as sent.
+	 */
+	void ConsumePages(const PageRing &ring, size_t nbytes) noexcept;
 
 protected:
 	/* virtual methods from class SocketMonitor */
@@ -26,10 +26,11 @@
 #define MPD_OUTPUT_HTTPD_INTERNAL_H
 
 #include "HttpdClient.hxx"
+#include "PageRing.hxx"
 #include "output/Interface.hxx"
 #include "output/Timer.hxx"
+#include "AudioFormat.hxx"
 #include "thread/Mutex.hxx"
-#include "thread/Cond.hxx"
 #include "event/ServerSocket.hxx"
 #include "event/DeferEvent.hxx"
 #include "util/Cast.hxx"
@@ -37,8 +38,7 @@
 
 #include <boost/intrusive/list.hpp>
 
-#include <queue>
-#include <list>
+#include <chrono>
 #include <memory>
 
 struct ConfigBlock;
@@ -64,6 +64,19 @@ class HttpdOutput final : AudioOutput, ServerSocket {
 	std::unique_ptr<PreparedEncoder> prepared_encoder;
 	Encoder *encoder = nullptr;
 
+	/**
+	 * Is the #encoder shared with other outputs ("share_encoder")?
+	 * Then it is fed even if there are no clients, or else it
+	 * would fall out of sync with the others.
+	 */
+	const bool share_encoder;
+
+	/**
+	 * The amount of encoded audio sent to new clients right away
+	 * ("burst_seconds").
+	 */
+	const std::chrono::steady_clock::duration burst;
+
 	/**
 	 * Number of bytes which were fed into the encoder, without
 	 * ever receiving new output.  This is used to estimate
@@ -79,17 +92,11 @@ public:
 	const char *content_type;
 
 	/**
-	 * This mutex protects the listener socket and the client
-	 * list.
+	 * This mutex protects the listener socket, the client list
+	 * and the page ring.
 	 */
 	mutable Mutex mutex;
 
-	/**
-	 * This condition gets signalled when an item is removed from
-	 * #pages.
-	 */
-	Cond cond;
-
 private:
 	/**
 	 * A #Timer object to synchronize this output with the
@@ -97,6 +104,17 @@ private:
 	 */
 	Timer *timer;
 
+	/**
+	 * The audio format passed to the #encoder.
+	 */
+	AudioFormat stream_audio_format;
+
+	/**
+	 * The number of PCM bytes fed into the encoder since it was
+	 * opened.  This is used to tag pages with their stream time.
+	 */
+	uint64_t stream_size;
+
 	/**
 	 * The header page, which is sent to every client on connect.
 	 */
@@ -108,12 +126,19 @@ private:
 	PagePtr metadata;
 
 	/**
-	 * The page queue, i.e. pages from the encoder to be
-	 * broadcasted to all clients.  This container is necessary to
-	 * pass pages from the OutputThread to the IOThread.  It is
-	 * protected by #mutex, and removing signals #cond.
+	 * The most recent pages from the encoder, shared by all
+	 * clients.  The OutputThread appends to it, and the IOThread
+	 * sends from it to each client at the client's own position.
+	 * It is protected by #mutex.
 	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
+	PageRing pages;
+
+	/**
+	 * The position of the first page after the current #header
+	 * in #pages.  Older pages belong to a previous stream, and
+	 * must not be sent to new clients.  Protected by #mutex.
+	 */
+	PageRing::Position header_end;
 
 	DeferEvent defer_broadcast;
 
@@ -223,25 +248,40 @@ public:
 	/**
 	 * Sends the encoder header to the client.  This is called
 	 * right after the response headers have been sent.
+	 *
+	 * Caller must lock the mutex.
 	 */
 	void SendHeader(HttpdClient &client) const noexcept;
 
+	/**
+	 * Caller must lock the mutex.
+	 */
+	const PageRing &GetPages() const noexcept {
+		return pages;
+	}
+
+	/**
+	 * Determine the position in #pages where a new client shall
+	 * start, i.e. the beginning of the configured burst.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	PageRing::Position GetBurstPosition() const noexcept;
+
 	gcc_pure
 	std::chrono::steady_clock::duration Delay() const noexcept override;
 
+	PageRing::Duration GetStreamTime() const noexcept {
+		return stream_audio_format.SizeToTime<PageRing::Duration>(stream_size);
+	}
+
 	/**
 	 * Reads data from the encoder (as much as available) and
 	 * returns it as a new #page object.
 	 */
 	PagePtr ReadPage();
 
-	/**
-	 * Broadcasts a page struct to all clients.
-	 *
-	 * Mutext must not be locked.
-	 */
-	void BroadcastPage(PagePtr page) noexcept;
-
 	/**
 	 * Broadcasts data from the encoder to all clients.
 	 *
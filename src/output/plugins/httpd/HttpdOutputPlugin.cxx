@@ -32,17 +32,28 @@
 #include "util/DeleteDisposer.hxx"
 #include "config/Net.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 
 #include <string.h>
 
 const Domain httpd_output_domain("httpd_output");
 
+/**
+ * The maximum amount of encoded data kept in the page ring.  A
+ * client which lags behind further than this skips pages.
+ */
+static constexpr size_t HTTPD_MAX_LAG = 256 * 1024;
+
 inline
 HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
-	:AudioOutput(FLAG_ENABLE_DISABLE|FLAG_PAUSE),
+	:AudioOutput(FLAG_ENABLE_DISABLE|FLAG_PAUSE|FLAG_SOFTWARE_CLOCK),
 	 ServerSocket(_loop),
 	 prepared_encoder(CreateConfiguredEncoder(block)),
+	 share_encoder(block.GetBlockValue("share_encoder", false)),
+	 burst(std::chrono::seconds(block.GetBlockValue("burst_seconds", 0u))),
+	 pages(HTTPD_MAX_LAG, burst),
 	 defer_broadcast(_loop, BIND_THIS_METHOD(OnDeferredBroadcast))
 {
 	/* read configuration */
@@ -101,22 +112,13 @@ HttpdOutput::AddClient(UniqueSocketDescriptor fd) noexcept
 void
 HttpdOutput::OnDeferredBroadcast() noexcept
 {
-	/* this method runs in the IOThread; it broadcasts pages from
-	   our own queue to all clients */
+	/* this method runs in the IOThread; it wakes up all clients
+	   to send the new pages from the ring */
 
 	const std::lock_guard<Mutex> protect(mutex);
 
-	while (!pages.empty()) {
-		PagePtr page = std::move(pages.front());
-		pages.pop();
-
-		for (auto &client : clients)
-			client.PushPage(page);
-	}
-
-	/* wake up the client that may be waiting for the queue to be
-	   flushed */
-	cond.notify_all();
+	for (auto &client : clients)
+		client.NotifyPages();
 }
 
 void
@@ -176,8 +178,10 @@ HttpdOutput::OpenEncoder(AudioFormat &audio_format)
 	   bytes of encoder output after opening it, because it has to
 	   be sent to every new client */
 	header = ReadPage();
+	header_end = pages.GetTail();
 
 	unflushed_input = 0;
+	stream_size = 0;
 }
 
 void
@@ -189,6 +193,7 @@ HttpdOutput::Open(AudioFormat &audio_format)
 	const std::lock_guard<Mutex> protect(mutex);
 
 	OpenEncoder(audio_format);
+	stream_audio_format = audio_format;
 
 	/* initialize other attributes */
 
@@ -211,6 +216,7 @@ HttpdOutput::Close() noexcept
 			const std::lock_guard<Mutex> protect(mutex);
 			open = false;
 			clients.clear_and_dispose(DeleteDisposer());
+			pages.Clear();
 		});
 
 	header.reset();
@@ -227,11 +233,22 @@ HttpdOutput::RemoveClient(HttpdClient &client) noexcept
 				  DeleteDisposer());
 }
 
+PageRing::Position
+HttpdOutput::GetBurstPosition() const noexcept
+{
+	if (burst <= std::chrono::steady_clock::duration::zero())
+		return pages.GetTail();
+
+	/* pages are complete chunks of encoder output, so starting
+	   at a page boundary is safe */
+	return std::max(pages.FindNewerThan(burst), header_end);
+}
+
 void
 HttpdOutput::SendHeader(HttpdClient &client) const noexcept
 {
 	if (header != nullptr)
-		client.PushPage(header);
+		client.PushHeader(header);
 }
 
 std::chrono::steady_clock::duration
@@ -255,34 +272,15 @@ HttpdOutput::Delay() const noexcept
 		: std::chrono::steady_clock::duration::zero();
 }
 
-void
-HttpdOutput::BroadcastPage(PagePtr page) noexcept
-{
-	assert(page != nullptr);
-
-	{
-		const std::lock_guard<Mutex> lock(mutex);
-		pages.emplace(std::move(page));
-	}
-
-	defer_broadcast.Schedule();
-}
-
 void
 HttpdOutput::BroadcastFromEncoder()
 {
-	/* synchronize with the IOThread */
-	{
-		std::unique_lock<Mutex> lock(mutex);
-		cond.wait(lock, [this]{ return pages.empty(); });
-	}
-
 	bool empty = true;
 
 	PagePtr page;
 	while ((page = ReadPage()) != nullptr) {
 		const std::lock_guard<Mutex> lock(mutex);
-		pages.emplace(std::move(page));
+		pages.Push(std::move(page), GetStreamTime());
 		empty = false;
 	}
 
@@ -296,6 +294,7 @@ HttpdOutput::EncodeAndPlay(const void *chunk, size_t size)
 	encoder->Write(chunk, size);
 
 	unflushed_input += size;
+	stream_size += size;
 
 	BroadcastFromEncoder();
 }
@@ -305,7 +304,7 @@ HttpdOutput::Play(const void *chunk, size_t size)
 {
 	pause = false;
 
-	if (LockHasClients())
+	if (share_encoder || LockHasClients())
 		EncodeAndPlay(chunk, size);
 
 	if (!timer->IsStarted())
@@ -320,7 +319,7 @@ HttpdOutput::Pause()
 {
 	pause = true;
 
-	if (LockHasClients()) {
+	if (share_encoder || LockHasClients()) {
 		static const char silence[1020] = { 0 };
 		Play(silence, sizeof(silence));
 	}
@@ -360,8 +359,17 @@ HttpdOutput::SendTag(const Tag &tag)
 
 		auto page = ReadPage();
 		if (page != nullptr) {
-			header = page;
-			BroadcastPage(page);
+			{
+				const std::lock_guard<Mutex> lock(mutex);
+				header = page;
+				pages.Push(std::move(page), GetStreamTime());
+
+				/* don't burst pages of the previous
+				   stream to new clients */
+				header_end = pages.GetTail();
+			}
+
+			defer_broadcast.Schedule();
 		}
 	} else {
 		/* use Icy-Metadata */
@@ -385,15 +393,10 @@ HttpdOutput::CancelAllClients() noexcept
 {
 	const std::lock_guard<Mutex> protect(mutex);
 
-	while (!pages.empty()) {
-		PagePtr page = std::move(pages.front());
-		pages.pop();
-	}
+	pages.Clear();
 
 	for (auto &client : clients)
 		client.CancelQueue();
-
-	cond.notify_all();
 }
 
 void
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+#define MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+
+#include "Page.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <chrono>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A ring of the most recent #Page objects broadcasted by the httpd
+ * output.  All clients share this ring; each one only remembers the
+ * sequence number of the next page it is going to send, so
+ * broadcasting a page does not allocate anything per client.
+ *
+ * Each page is tagged with its stream time, which allows finding
+ * the pages of the last few seconds.
+ *
+ * Old pages are evicted when the ring is full, or when the total
+ * size exceeds the configured limit and the page is older than the
+ * configured minimum duration.  A client whose position has been
+ * evicted is too slow, and must skip ahead.
+ *
+ * This class is not thread-safe.
+ */
+class PageRing {
+	static constexpr size_t CAPACITY = 1024;
+
+public:
+	typedef uint64_t Position;
+	typedef std::chrono::steady_clock::duration Duration;
+
+private:
+	struct Slot {
+		PagePtr page;
+
+		/**
+		 * The stream time at the end of this page.
+		 */
+		Duration time;
+	};
+
+	std::array<Slot, CAPACITY> slots;
+
+	/**
+	 * The sequence number of the oldest page.
+	 */
+	uint64_t head = 0;
+
+	/**
+	 * The sequence number of the next page to be pushed.
+	 */
+	uint64_t tail = 0;
+
+	/**
+	 * The sum of all page sizes in the ring.
+	 */
+	size_t total_size = 0;
+
+	const size_t max_size;
+
+	/**
+	 * Pages newer than this (relative to the newest page) are
+	 * not evicted by #max_size.
+	 */
+	const Duration min_duration;
+
+public:
+	explicit PageRing(size_t _max_size,
+			  Duration _min_duration=Duration::zero()) noexcept
+		:max_size(_max_size), min_duration(_min_duration) {}
+
+	PageRing(const PageRing &) = delete;
+	PageRing &operator=(const PageRing &) = delete;
+
+	/**
+	 * The position of the oldest page.
+	 */
+	Position GetHead() const noexcept {
+		return head;
+	}
+
+	/**
+	 * The position which will be assigned to the next page.
+	 * Clients at this position have sent everything.
+	 */
+	Position GetTail() const noexcept {
+		return tail;
+	}
+
+	/**
+	 * Has the page at this position already been evicted?
+	 */
+	bool IsEvicted(Position p) const noexcept {
+		return p < head;
+	}
+
+	gcc_pure
+	const PagePtr &Get(Position p) const noexcept {
+		assert(p >= head);
+		assert(p < tail);
+
+		return slots[p % CAPACITY].page;
+	}
+
+	/**
+	 * Find the oldest page whose stream time is not older than
+	 * the given duration, relative to the newest page.  Returns
+	 * GetTail() if the ring is empty.
+	 */
+	gcc_pure
+	Position FindNewerThan(Duration d) const noexcept {
+		if (head == tail)
+			return tail;
+
+		const Duration t = GetTime(tail - 1) - d;
+
+		/* binary search; the stream time grows
+		   monotonically */
+		Position begin = head, end = tail - 1;
+		while (begin < end) {
+			const Position middle = begin + (end - begin) / 2;
+			if (GetTime(middle) < t)
+				begin = middle + 1;
+			else
+				end = middle;
+		}
+
+		return begin;
+	}
+
+	size_t GetTotalSize() const noexcept {
+		return total_size;
+	}
+
+	/**
+	 * @param time the stream time at the end of this page
+	 */
+	void Push(PagePtr page, Duration time) noexcept {
+		assert(page != nullptr);
+		assert(head == tail || time >= GetTime(tail - 1));
+
+		if (tail - head == CAPACITY)
+			PopFront();
+
+		total_size += page->GetSize();
+		auto &slot = slots[tail++ % CAPACITY];
+		slot.page = std::move(page);
+		slot.time = time;
+
+		/* always keep the newest page, even if it alone
+		   exceeds the limit */
+		while (total_size > max_size && tail - head > 1 &&
+		       GetTime(head) < time - min_duration)
+			PopFront();
+	}
+
+	/**
+	 * Evict all pages.
+	 */
+	void Clear() noexcept {
+		while (head != tail)
+			PopFront();
+	}
+
+private:
+	Duration GetTime(Position p) const noexcept {
+		return slots[p % CAPACITY].time;
+	}
+
+	void PopFront() noexcept {
+		assert(head != tail);
+
+		auto &slot = slots[head++ % CAPACITY];
+		assert(total_size >= slot.page->GetSize());
+		total_size -= slot.page->GetSize();
+		slot.page.reset();
+	}
+};
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "BitReverse.hxx"
+#include "util/bit_reverse.h"
+
+#ifdef __SSE2__
+#include "X86Convert.hxx"
+#elif defined(__ARM_NEON__)
+#include "Neon.hxx"
+#endif
+
+void
+PcmBitReverse(uint8_t *dest, const uint8_t *src, size_t n) noexcept
+{
+	size_t done = 0;
+
+#ifdef __SSE2__
+	X86Convert::BitReverse(dest, src, n);
+	done = n - n % X86Convert::BLOCK_SIZE;
+#elif defined(__ARM_NEON__)
+	NeonBitReverse(dest, src, n);
+	done = n - n % NEON_MIX_BLOCK_SIZE;
+#endif
+
+	for (size_t i = done; i < n; ++i)
+		dest[i] = bit_reverse(src[i]);
+}
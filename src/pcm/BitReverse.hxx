@@ -0,0 +1,35 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_BIT_REVERSE_HXX
+#define MPD_PCM_BIT_REVERSE_HXX
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Reverse the bit order of all bytes, e.g. to convert LSB-first DSD
+ * data to MSB-first.  Uses SIMD instructions if available.
+ *
+ * @param dest the destination buffer; may be equal to @a src
+ */
+void
+PcmBitReverse(uint8_t *dest, const uint8_t *src, size_t n) noexcept;
+
+#endif
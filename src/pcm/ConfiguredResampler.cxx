@@ -34,6 +34,10 @@
 #include "SoxrResampler.hxx"
 #endif
 
+#include <map>
+#include <memory>
+#include <string>
+
 #include <assert.h>
 #include <string.h>
 
@@ -49,7 +53,35 @@ enum class SelectedResampler {
 #endif
 };
 
-static SelectedResampler selected_resampler = SelectedResampler::FALLBACK;
+struct PcmResamplerSetup {
+	SelectedResampler plugin = SelectedResampler::FALLBACK;
+
+#ifdef ENABLE_LIBSAMPLERATE
+	int lsr_converter;
+#endif
+
+#ifdef ENABLE_SOXR
+	std::unique_ptr<SoxrSettings> soxr;
+#endif
+
+	PcmResamplerSetup() = default;
+
+	/**
+	 * Throws on error.
+	 */
+	explicit PcmResamplerSetup(const ConfigBlock &block);
+};
+
+/**
+ * The unnamed "resampler" block, used by all outputs which don't
+ * select another one.
+ */
+static PcmResamplerSetup default_setup;
+
+/**
+ * All "resampler" blocks which have a "name".
+ */
+static std::map<std::string, PcmResamplerSetup, std::less<>> named_setups;
 
 static const ConfigBlock *
 MakeResamplerDefaultConfig(ConfigBlock &block) noexcept
@@ -111,12 +143,25 @@ MigrateResamplerConfig(const ConfigParam *param, ConfigBlock &buffer) noexcept
 		: MigrateResamplerConfig(*param, buffer);
 }
 
+/**
+ * Find the "resampler" block without a "name".
+ */
+static const ConfigBlock *
+FindDefaultResamplerBlock(const ConfigData &config) noexcept
+{
+	for (const auto &block : config.GetBlockList(ConfigBlockOption::RESAMPLER))
+		if (block.GetBlockParam("name") == nullptr)
+			return &block;
+
+	return nullptr;
+}
+
 static const ConfigBlock *
 GetResamplerConfig(const ConfigData &config, ConfigBlock &buffer)
 {
 	const auto *old_param =
 		config.GetParam(ConfigOption::SAMPLERATE_CONVERTER);
-	const auto *block = config.GetBlock(ConfigBlockOption::RESAMPLER);
+	const auto *block = FindDefaultResamplerBlock(config);
 	if (block == nullptr)
 		return MigrateResamplerConfig(old_param, buffer);
 
@@ -128,28 +173,24 @@ GetResamplerConfig(const ConfigData &config, ConfigBlock &buffer)
 	return block;
 }
 
-void
-pcm_resampler_global_init(const ConfigData &config)
+PcmResamplerSetup::PcmResamplerSetup(const ConfigBlock &block)
 {
-	ConfigBlock buffer;
-	const auto *block = GetResamplerConfig(config, buffer);
-
-	const char *plugin_name = block->GetBlockValue("plugin");
+	const char *plugin_name = block.GetBlockValue("plugin");
 	if (plugin_name == nullptr)
 		throw FormatRuntimeError("'plugin' missing in line %d",
-					 block->line);
+					 block.line);
 
 	if (strcmp(plugin_name, "internal") == 0) {
-		selected_resampler = SelectedResampler::FALLBACK;
+		plugin = SelectedResampler::FALLBACK;
 #ifdef ENABLE_SOXR
 	} else if (strcmp(plugin_name, "soxr") == 0) {
-		selected_resampler = SelectedResampler::SOXR;
-		pcm_resample_soxr_global_init(*block);
+		plugin = SelectedResampler::SOXR;
+		soxr = std::make_unique<SoxrSettings>(block);
 #endif
 #ifdef ENABLE_LIBSAMPLERATE
 	} else if (strcmp(plugin_name, "libsamplerate") == 0) {
-		selected_resampler = SelectedResampler::LIBSAMPLERATE;
-		pcm_resample_lsr_global_init(*block);
+		plugin = SelectedResampler::LIBSAMPLERATE;
+		lsr_converter = pcm_resample_lsr_parse(block);
 #endif
 	} else {
 		throw FormatRuntimeError("No such resampler plugin: %s",
@@ -157,21 +198,54 @@ pcm_resampler_global_init(const ConfigData &config)
 	}
 }
 
+void
+pcm_resampler_global_init(const ConfigData &config)
+{
+	ConfigBlock buffer;
+	default_setup = PcmResamplerSetup(*GetResamplerConfig(config, buffer));
+
+	named_setups.clear();
+	for (const auto &block : config.GetBlockList(ConfigBlockOption::RESAMPLER)) {
+		const char *name = block.GetBlockValue("name");
+		if (name == nullptr)
+			continue;
+
+		block.SetUsed();
+
+		if (!named_setups.emplace(name, PcmResamplerSetup(block)).second)
+			throw FormatRuntimeError("Duplicate resampler name '%s' in line %d",
+						 name, block.line);
+	}
+}
+
+const PcmResamplerSetup &
+pcm_resampler_find(const char *name)
+{
+	auto i = named_setups.find(name);
+	if (i == named_setups.end())
+		throw FormatRuntimeError("No such resampler: %s", name);
+
+	return i->second;
+}
+
 PcmResampler *
-pcm_resampler_create()
+pcm_resampler_create(const PcmResamplerSetup *setup)
 {
-	switch (selected_resampler) {
+	if (setup == nullptr)
+		setup = &default_setup;
+
+	switch (setup->plugin) {
 	case SelectedResampler::FALLBACK:
 		return new FallbackPcmResampler();
 
 #ifdef ENABLE_LIBSAMPLERATE
 	case SelectedResampler::LIBSAMPLERATE:
-		return new LibsampleratePcmResampler();
+		return new LibsampleratePcmResampler(setup->lsr_converter);
 #endif
 
 #ifdef ENABLE_SOXR
 	case SelectedResampler::SOXR:
-		return new SoxrPcmResampler();
+		return new SoxrPcmResampler(*setup->soxr);
 #endif
 	}
 
@@ -21,16 +21,28 @@
 #define MPD_CONFIGURED_RESAMPLER_HXX
 
 struct ConfigData;
+struct PcmResamplerSetup;
 class PcmResampler;
 
 void
 pcm_resampler_global_init(const ConfigData &config);
 
+/**
+ * Look up a "resampler" block with the specified "name".
+ *
+ * Throws if no such block exists.
+ */
+const PcmResamplerSetup &
+pcm_resampler_find(const char *name);
+
 /**
  * Create a #PcmResampler instance from the implementation class
  * configured in mpd.conf.
+ *
+ * @param setup a setup returned by pcm_resampler_find(); nullptr
+ * selects the (unnamed) default "resampler" block
  */
 PcmResampler *
-pcm_resampler_create();
+pcm_resampler_create(const PcmResamplerSetup *setup=nullptr);
 
 #endif
@@ -19,6 +19,7 @@
 
 #include "Convert.hxx"
 #include "ConfiguredResampler.hxx"
+#include "ConfiguredDither.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <assert.h>
@@ -27,19 +28,44 @@ void
 pcm_convert_global_init(const ConfigData &config)
 {
 	pcm_resampler_global_init(config);
+	pcm_dither_global_init(config);
+
+#ifdef ENABLE_DSD
+	pcm_dsd_global_init(config);
+#endif
 }
 
 PcmConvert::PcmConvert(const AudioFormat _src_format,
-		       const AudioFormat dest_format)
-	:src_format(_src_format)
+		       const AudioFormat dest_format,
+		       const PcmResamplerSetup *resampler_setup)
+	:resampler(resampler_setup), src_format(_src_format)
 {
 	assert(src_format.IsValid());
 	assert(dest_format.IsValid());
 
 	AudioFormat format = _src_format;
-	if (format.format == SampleFormat::DSD)
+	if (format.format == SampleFormat::DSD) {
 		format.format = SampleFormat::FLOAT;
 
+#ifdef ENABLE_DSD
+		/* decimate as much as possible without going below
+		   the destination sample rate; this saves work for
+		   the resampler, or makes it unnecessary */
+		dsd.Open(format.channels,
+			 PcmDsd::ChooseDecimation(format.sample_rate,
+						  dest_format.sample_rate),
+			 PcmDsd::GetDefaultFilter());
+		format.sample_rate /= dsd.GetStride();
+
+		/* if nothing else needs floating point, generate
+		   24 bit samples directly */
+		dsd_s24 = format.sample_rate == dest_format.sample_rate &&
+			dest_format.format == SampleFormat::S24_P32;
+		if (dsd_s24)
+			format.format = SampleFormat::S24_P32;
+#endif
+	}
+
 	enable_resampler = format.sample_rate != dest_format.sample_rate;
 	if (enable_resampler) {
 		resampler.Open(format, dest_format.sample_rate);
@@ -49,6 +75,16 @@ PcmConvert::PcmConvert(const AudioFormat _src_format,
 	}
 
 	enable_format = format.format != dest_format.format;
+	enable_channels = format.channels != dest_format.channels;
+
+	/* prefer a single-pass kernel which converts both the
+	   sample format and the number of channels */
+	enable_fused = enable_format && enable_channels &&
+		fused_converter.Open(format.format, format.channels,
+				     dest_format.format, dest_format.channels);
+	if (enable_fused)
+		enable_format = enable_channels = false;
+
 	if (enable_format) {
 		try {
 			format_converter.Open(format.format,
@@ -62,7 +98,6 @@ PcmConvert::PcmConvert(const AudioFormat _src_format,
 
 	format.format = dest_format.format;
 
-	enable_channels = format.channels != dest_format.channels;
 	if (enable_channels) {
 		try {
 			channels_converter.Open(format.format, format.channels,
@@ -79,6 +114,8 @@ PcmConvert::PcmConvert(const AudioFormat _src_format,
 
 PcmConvert::~PcmConvert() noexcept
 {
+	if (enable_fused)
+		fused_converter.Close();
 	if (enable_channels)
 		channels_converter.Close();
 	if (enable_format)
@@ -108,17 +145,24 @@ PcmConvert::Convert(ConstBuffer<void> buffer)
 #ifdef ENABLE_DSD
 	if (src_format.format == SampleFormat::DSD) {
 		auto s = ConstBuffer<uint8_t>::FromVoid(buffer);
-		auto d = dsd.ToFloat(src_format.channels, s);
-		if (d.IsNull())
-			throw std::runtime_error("DSD to PCM conversion failed");
-
-		buffer = d.ToVoid();
+		buffer = dsd_s24
+			? dsd.ToS24(s).ToVoid()
+			: dsd.ToFloat(s).ToVoid();
+
+		if (buffer.empty())
+			/* with a decimation factor above 8, the
+			   input may not have been enough for one
+			   output frame */
+			return buffer;
 	}
 #endif
 
 	if (enable_resampler)
 		buffer = resampler.Resample(buffer);
 
+	if (enable_fused)
+		buffer = fused_converter.Convert(buffer);
+
 	if (enable_format)
 		buffer = format_converter.Convert(buffer);
 
@@ -134,6 +178,9 @@ PcmConvert::Flush()
 	if (enable_resampler) {
 		auto buffer = resampler.Flush();
 		if (!buffer.IsNull()) {
+			if (enable_fused)
+				buffer = fused_converter.Convert(buffer);
+
 			if (enable_format)
 				buffer = format_converter.Convert(buffer);
 
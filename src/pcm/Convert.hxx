@@ -22,6 +22,7 @@
 
 #include "FormatConverter.hxx"
 #include "ChannelsConverter.hxx"
+#include "FusedConvert.hxx"
 #include "GlueResampler.hxx"
 #include "AudioFormat.hxx"
 #include "config.h"
@@ -32,6 +33,7 @@
 
 template<typename T> struct ConstBuffer;
 struct ConfigData;
+struct PcmResamplerSetup;
 
 /**
  * This object is statically allocated (within another struct), and
@@ -47,16 +49,34 @@ class PcmConvert {
 	PcmFormatConverter format_converter;
 	PcmChannelsConverter channels_converter;
 
+	/**
+	 * Replaces #format_converter and #channels_converter if both
+	 * are needed and there is a single-pass kernel for this
+	 * combination.
+	 */
+	PcmFusedConverter fused_converter;
+
 	const AudioFormat src_format;
 
-	bool enable_resampler, enable_format, enable_channels;
+	bool enable_resampler, enable_format, enable_channels, enable_fused;
+
+#ifdef ENABLE_DSD
+	/**
+	 * Does #dsd generate S24_P32 instead of float?
+	 */
+	bool dsd_s24;
+#endif
 
 public:
 
 	/**
 	 * Throws on error.
+	 *
+	 * @param resampler the "resampler" block to be used; nullptr
+	 * selects the default one
 	 */
-	PcmConvert(AudioFormat _src_format, AudioFormat _dest_format);
+	PcmConvert(AudioFormat _src_format, AudioFormat _dest_format,
+		   const PcmResamplerSetup *resampler=nullptr);
 
 	~PcmConvert() noexcept;
 
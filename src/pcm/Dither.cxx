@@ -21,9 +21,58 @@
 #include "Prng.hxx"
 #include "Traits.hxx"
 
+#ifdef __SSE2__
+#include "X86Convert.hxx"
+#elif defined(__ARM_NEON__)
+#include "Neon.hxx"
+#endif
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+#include <assert.h>
+
+/**
+ * The low @a bits of the pcm_prng() state form a PRNG of their own
+ * which repeats every 2^bits steps.  Dithering uses only these low
+ * bits, so the noise for a whole buffer can be looked up in a table
+ * containing one period.
+ */
+template<unsigned bits>
+struct PrngNoiseTable {
+	static constexpr unsigned MASK = (1u << bits) - 1;
+
+	/**
+	 * The dither noise after each step, in the order of the PRNG
+	 * sequence starting at 0.
+	 */
+	int32_t noise[MASK + 1];
+
+	/**
+	 * Maps a (masked) PRNG state to its index in #noise.
+	 */
+	uint16_t position[MASK + 1];
+
+	constexpr PrngNoiseTable() noexcept:noise(), position() {
+		static_assert(bits <= 16, "Table too large");
+
+		unsigned state = 0;
+		for (unsigned i = 0; i <= MASK; ++i) {
+			const unsigned next = pcm_prng(state) & MASK;
+			position[state] = i;
+			noise[i] = int32_t(next) - int32_t(state);
+			state = next;
+		}
+	}
+};
+
+template<unsigned bits>
+static constexpr PrngNoiseTable<bits> prng_noise_table{};
+
 template<typename T, T MIN, T MAX, unsigned scale_bits>
 inline T
-PcmDither::Dither(T sample) noexcept
+PcmDither::Dither(T sample, T noise) noexcept
 {
 	constexpr T round = 1 << (scale_bits - 1);
 	constexpr T mask = (1 << scale_bits) - 1;
@@ -34,12 +83,7 @@ PcmDither::Dither(T sample) noexcept
 	error[1] = error[0] / 2;
 
 	/* round */
-	T output = sample + round;
-
-	const T rnd = pcm_prng(random);
-	output += (rnd & mask) - (random & mask);
-
-	random = rnd;
+	T output = sample + round + noise;
 
 	/* clip */
 	if (output > MAX) {
@@ -61,6 +105,178 @@ PcmDither::Dither(T sample) noexcept
 	return output >> scale_bits;
 }
 
+template<typename T, T MIN, T MAX, unsigned scale_bits>
+inline T
+PcmDither::Dither(T sample) noexcept
+{
+	constexpr T mask = (1 << scale_bits) - 1;
+
+	const T rnd = pcm_prng(random);
+	const T noise = (rnd & mask) - (random & mask);
+	random = rnd;
+
+	return Dither<T, MIN, MAX, scale_bits>(sample, noise);
+}
+
+/**
+ * One step of a xorshift32 PRNG.
+ */
+static constexpr uint32_t
+XorShift32(uint32_t x) noexcept
+{
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+/**
+ * Convert a random number to TPDF noise: the difference of two
+ * independent uniformly distributed values, taken from the lower and
+ * the upper half of the number.
+ */
+static constexpr int32_t
+TpdfNoise(uint32_t r, uint32_t mask) noexcept
+{
+	return int32_t(r & mask) - int32_t((r >> 16) & mask);
+}
+
+inline void
+PcmDither::FillTpdfNoise(int32_t *noise, size_t n, unsigned bits) noexcept
+{
+	assert(n % PCM_DITHER_LANES == 0);
+	assert(bits <= 16);
+
+#ifdef __SSE2__
+	X86Convert::TpdfNoise(lanes, noise, n, bits);
+#elif defined(__ARM_NEON__)
+	NeonTpdfNoise(lanes, noise, n, bits);
+#else
+	const uint32_t mask = (1u << bits) - 1;
+
+	for (size_t i = 0; i < n; i += PCM_DITHER_LANES)
+		for (size_t j = 0; j < PCM_DITHER_LANES; ++j)
+			noise[i + j] = TpdfNoise(lanes[j] = XorShift32(lanes[j]),
+						 mask);
+#endif
+}
+
+/**
+ * Add (dither) noise and rounding to 32 bit samples, shift them right
+ * and clamp to 16 bit.  This is written so the sum cannot overflow.
+ */
+static inline void
+PortableTpdfShiftS16(int16_t *dest, const int32_t *src,
+		     const int32_t *noise, size_t n, unsigned shift) noexcept
+{
+	const int32_t mask = (int32_t(1) << shift) - 1;
+	const int32_t round = int32_t(1) << (shift - 1);
+
+	for (size_t i = 0; i < n; ++i) {
+		const int32_t x = src[i];
+		const int32_t y = (x >> shift) +
+			(((x & mask) + round + noise[i]) >> shift);
+		dest[i] = std::clamp<int32_t>(y, INT16_MIN, INT16_MAX);
+	}
+}
+
+static inline void
+TpdfShiftS16(int16_t *dest, const int32_t *src,
+	     const int32_t *noise, size_t n, unsigned shift) noexcept
+{
+#ifdef __SSE2__
+	X86Convert::TpdfShiftS16(dest, src, noise, n, shift);
+	const size_t done = n - n % X86Convert::BLOCK_SIZE;
+#elif defined(__ARM_NEON__)
+	NeonTpdfShiftS16(dest, src, noise, n, shift);
+	const size_t done = n - n % NEON_MIX_BLOCK_SIZE;
+#else
+	const size_t done = 0;
+#endif
+
+	PortableTpdfShiftS16(dest + done, src + done, noise + done,
+			     n - done, shift);
+}
+
+template<typename T, T MIN, T MAX, unsigned scale_bits,
+	 typename D, typename F>
+inline void
+PcmDither::TpdfDither(D *dest, size_t n, F &&f) noexcept
+{
+	static_assert(scale_bits <= 16, "Too many bits to discard");
+
+	constexpr T round = T(1) << (scale_bits - 1);
+	constexpr T mask = (T(1) << scale_bits) - 1;
+	constexpr T DMIN = MIN >> scale_bits, DMAX = MAX >> scale_bits;
+
+	/* samples which fit into 32 bit and are reduced to 16 bit
+	   are handled by a (SIMD) kernel */
+	constexpr bool to_s16 = std::is_same<D, int16_t>::value &&
+		MIN >= INT32_MIN && MAX <= INT32_MAX &&
+		DMIN == INT16_MIN && DMAX == INT16_MAX;
+
+	/* the block size keeps the temporary buffers in the L1
+	   cache */
+	constexpr size_t BLOCK_SIZE = 256;
+	static_assert(BLOCK_SIZE % PCM_DITHER_LANES == 0, "");
+	int32_t noise[BLOCK_SIZE];
+
+	for (size_t done = 0; done < n;) {
+		const size_t chunk = std::min(n - done, BLOCK_SIZE);
+		FillTpdfNoise(noise, (chunk + PCM_DITHER_LANES - 1)
+			      / PCM_DITHER_LANES * PCM_DITHER_LANES,
+			      scale_bits);
+
+		if constexpr (to_s16) {
+			int32_t src[BLOCK_SIZE];
+			for (size_t i = 0; i < chunk; ++i)
+				src[i] = f(done + i);
+
+			TpdfShiftS16(dest + done, src, noise, chunk,
+				     scale_bits);
+		} else {
+			for (size_t i = 0; i < chunk; ++i) {
+				const T x = f(done + i);
+				const T y = (x >> scale_bits) +
+					(((x & mask) + round + noise[i]) >> scale_bits);
+				dest[done + i] = std::clamp(y, DMIN, DMAX);
+			}
+		}
+
+		done += chunk;
+	}
+}
+
+template<typename T, T MIN, T MAX, unsigned scale_bits,
+	 typename D, typename F>
+inline void
+PcmDither::Dither(D *dest, size_t n, F &&f) noexcept
+{
+	if (!shaping) {
+		TpdfDither<T, MIN, MAX, scale_bits>(dest, n,
+						    std::forward<F>(f));
+		return;
+	}
+
+	if constexpr (scale_bits <= 12) {
+		/* look up the noise instead of iterating the PRNG
+		   for each sample; this leaves only the error
+		   feedback in the per-sample dependency chain */
+		constexpr auto &table = prng_noise_table<scale_bits>;
+		constexpr unsigned mask = table.MASK;
+
+		const unsigned start = table.position[random & mask];
+		for (size_t i = 0; i < n; ++i)
+			dest[i] = Dither<T, MIN, MAX, scale_bits>(f(i),
+								  table.noise[(start + i) & mask]);
+
+		random = pcm_prng_skip(random, n);
+	} else {
+		for (size_t i = 0; i < n; ++i)
+			dest[i] = Dither<T, MIN, MAX, scale_bits>(f(i));
+	}
+}
+
 template<typename ST, unsigned SBITS, unsigned DBITS>
 inline ST
 PcmDither::DitherShift(ST sample) noexcept
@@ -74,6 +290,20 @@ PcmDither::DitherShift(ST sample) noexcept
 	return Dither<ST, MIN, MAX, SBITS - DBITS>(sample);
 }
 
+template<typename ST, unsigned SBITS, unsigned DBITS,
+	 typename D, typename F>
+inline void
+PcmDither::DitherShift(D *dest, size_t n, F &&f) noexcept
+{
+	static_assert(sizeof(ST) * 8 > SBITS, "Source type too small");
+	static_assert(SBITS > DBITS, "Non-positive scale_bits");
+
+	static constexpr ST MIN = -(ST(1) << (SBITS - 1));
+	static constexpr ST MAX = (ST(1) << (SBITS - 1)) - 1;
+
+	Dither<ST, MIN, MAX, SBITS - DBITS>(dest, n, std::forward<F>(f));
+}
+
 template<typename ST, typename DT>
 inline typename DT::value_type
 PcmDither::DitherConvert(typename ST::value_type sample) noexcept
@@ -93,8 +323,13 @@ PcmDither::DitherConvert(typename DT::pointer_type dest,
 			 typename ST::const_pointer_type src,
 			 typename ST::const_pointer_type src_end) noexcept
 {
-	while (src < src_end)
-		*dest++ = DitherConvert<ST, DT>(*src++);
+	constexpr unsigned scale_bits = ST::BITS - DT::BITS;
+
+	Dither<typename ST::sum_type, ST::MIN, ST::MAX,
+	       scale_bits>(dest, src_end - src,
+			   [src](size_t i){
+				   return typename ST::sum_type(src[i]);
+			   });
 }
 
 inline void
@@ -20,17 +20,54 @@
 #ifndef MPD_PCM_DITHER_HXX
 #define MPD_PCM_DITHER_HXX
 
+#include <stddef.h>
 #include <stdint.h>
 
 enum class SampleFormat : uint8_t;
 
+/**
+ * The number of independent PRNG lanes used for TPDF dither.  Each
+ * lane feeds every #PCM_DITHER_LANES-th sample, which allows
+ * generating the noise with SIMD instructions.
+ */
+static constexpr size_t PCM_DITHER_LANES = 8;
+
 class PcmDither {
 	int32_t error[3];
 	int32_t random;
 
+	/**
+	 * Apply noise shaping (error feedback)?  If not, plain TPDF
+	 * dither is used; it has no dependency from one sample to the
+	 * next and can therefore be vectorized.
+	 */
+	bool shaping;
+
+	/**
+	 * The xorshift PRNG states for TPDF dither.
+	 */
+	uint32_t lanes[PCM_DITHER_LANES];
+
+	static inline bool default_shaping = true;
+
 public:
-	constexpr PcmDither() noexcept
-		:error{0, 0, 0}, random(0) {}
+	PcmDither() noexcept
+		:error{0, 0, 0}, random(0), shaping(default_shaping),
+		 lanes{0x2545f491, 0x9e3779b9, 0x7f4a7c15, 0xbf58476d,
+		       0x94d049bb, 0x6a09e667, 0xbb67ae85, 0x3c6ef372} {}
+
+	/**
+	 * Choose whether new #PcmDither instances apply noise
+	 * shaping.  This is configured once at startup (the "dither"
+	 * setting in mpd.conf).
+	 */
+	static void SetDefaultShaping(bool _shaping) noexcept {
+		default_shaping = _shaping;
+	}
+
+	bool IsShaping() const noexcept {
+		return shaping;
+	}
 
 	/**
 	 * Shift the given sample by #SBITS-#DBITS to the right, and
@@ -44,6 +81,20 @@ public:
 	template<typename ST, unsigned SBITS, unsigned DBITS>
 	ST DitherShift(ST sample) noexcept;
 
+	/**
+	 * Like DitherShift(), but for a whole buffer.  This is faster
+	 * than calling DitherShift() for each sample, and the output
+	 * is the same.
+	 *
+	 * @param dest the destination buffer
+	 * @param n the number of samples
+	 * @param f a function which returns the input sample with the
+	 * given index (of type #ST)
+	 */
+	template<typename ST, unsigned SBITS, unsigned DBITS,
+		 typename D, typename F>
+	void DitherShift(D *dest, size_t n, F &&f) noexcept;
+
 	void Dither24To16(int16_t *dest, const int32_t *src,
 			  const int32_t *src_end) noexcept;
 
@@ -64,6 +115,39 @@ private:
 	template<typename T, T MIN, T MAX, unsigned scale_bits>
 	T Dither(T sample) noexcept;
 
+	/**
+	 * Like Dither(T), but with the given noise value instead of
+	 * one generated by the PRNG.
+	 */
+	template<typename T, T MIN, T MAX, unsigned scale_bits>
+	T Dither(T sample, T noise) noexcept;
+
+	/**
+	 * Generate TPDF noise with values in the range
+	 * [-(2^bits-1), 2^bits-1].
+	 *
+	 * @param n the number of values; must be a multiple of
+	 * #PCM_DITHER_LANES
+	 */
+	void FillTpdfNoise(int32_t *noise, size_t n, unsigned bits) noexcept;
+
+	/**
+	 * Dither a whole buffer without noise shaping.
+	 */
+	template<typename T, T MIN, T MAX, unsigned scale_bits,
+		 typename D, typename F>
+	void TpdfDither(D *dest, size_t n, F &&f) noexcept;
+
+	/**
+	 * Dither a whole buffer.
+	 *
+	 * @param f a function which returns the input sample with the
+	 * given index
+	 */
+	template<typename T, T MIN, T MAX, unsigned scale_bits,
+		 typename D, typename F>
+	void Dither(D *dest, size_t n, F &&f) noexcept;
+
 	/**
 	 * Convert the given sample from one sample format to another,
 	 * discarding bits.
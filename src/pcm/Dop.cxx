@@ -16,83 +16,62 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-
 #include "Dop.hxx"
 #include "ChannelDefs.hxx"
 #include "util/ConstBuffer.hxx"
 
-#include <functional>
-
 #include <assert.h>
 
-static constexpr uint32_t
-pcm_two_dsd_to_dop_marker1(uint8_t a, uint8_t b) noexcept
-{
-	return 0xff050000 | (a << 8) | b;
-}
-
-static constexpr uint32_t
-pcm_two_dsd_to_dop_marker2(uint8_t a, uint8_t b) noexcept
-{
-	return 0xfffa0000 | (a << 8) | b;
-}
-
 /**
- * @param num_dop_quads the number of "quad" bytes per channel in the
- * source buffer; each "quad" will be converted to two 24 bit samples
- * in the destination buffer, one for each marker
+ * The DoP marker bytes which alternate from one frame to the next.
  */
-static void
-DsdToDop(uint32_t *dest, const uint8_t *src,
-	 size_t num_dop_quads, unsigned channels) noexcept
-{
-	for (size_t i = num_dop_quads; i > 0; --i) {
-		for (unsigned c = channels; c > 0; --c) {
-			/* each 24 bit sample has 16 DSD sample bits
-			   plus the magic 0x05 marker */
-
-			*dest++ = pcm_two_dsd_to_dop_marker1(src[0], src[channels]);
-
-			/* seek the source pointer to the next
-			   channel */
-			++src;
-		}
+static constexpr uint8_t dop_markers[2] = { 0x05, 0xfa };
 
-		/* skip the second byte of each channel, because we
-		   have already copied it */
-		src += channels;
-
-		for (unsigned c = channels; c > 0; --c) {
-			/* each 24 bit sample has 16 DSD sample bits
-			   plus the magic 0xfa marker */
+void
+DsdToDopConverter::Open(unsigned channels) noexcept
+{
+	assert(audio_valid_channel_count(channels));
 
-			*dest++ = pcm_two_dsd_to_dop_marker2(src[0], src[channels]);
+	rest_buffer.Open(channels);
 
-			/* seek the source pointer to the next
-			   channel */
-			++src;
+	/* one block ("quad") of four DSD_U8 frames becomes two DoP
+	   frames; each 24 bit sample (padded to 32 bit) has 16 DSD
+	   sample bits plus the magic marker, and the top (padding)
+	   byte is 0xff */
+	const auto pos = [](size_t significance){
+		return PcmShuffle::NativeBytePosition(4, significance);
+	};
+
+	int8_t map[PcmShuffle::MAX_FRAME_SIZE];
+	uint8_t fill[PcmShuffle::MAX_FRAME_SIZE];
+	for (unsigned f = 0; f < 2; ++f) {
+		for (unsigned c = 0; c < channels; ++c) {
+			const size_t o = (f * channels + c) * 4;
+
+			map[o + pos(1)] = (2 * f) * channels + c;
+			fill[o + pos(1)] = 0;
+			map[o + pos(0)] = (2 * f + 1) * channels + c;
+			fill[o + pos(0)] = 0;
+			map[o + pos(2)] = -1;
+			fill[o + pos(2)] = dop_markers[f];
+			map[o + pos(3)] = -1;
+			fill[o + pos(3)] = 0xff;
 		}
-
-		/* skip the second byte of each channel, because we
-		   have already copied it */
-		src += channels;
 	}
-}
 
-void
-DsdToDopConverter::Open(unsigned _channels) noexcept
-{
-	assert(audio_valid_channel_count(_channels));
-
-	channels = _channels;
-
-	rest_buffer.Open(channels);
+	shuffle.Open(4, 8, channels, map, fill);
 }
 
-ConstBuffer<uint32_t>
+ConstBuffer<void>
 DsdToDopConverter::Convert(ConstBuffer<uint8_t> src) noexcept
 {
-	using namespace std::placeholders;
-	return rest_buffer.Process<uint32_t>(buffer, src, 2 * channels,
-					     std::bind(DsdToDop, _1, _2, _3, channels));
+	const size_t block_size = rest_buffer.GetInputBlockSize();
+	return rest_buffer.Process<uint8_t>(buffer, src,
+					    shuffle.GetOutputSize(block_size),
+					    [this, block_size](uint8_t *d,
+							       const uint8_t *s,
+							       size_t n_blocks){
+						    shuffle.Apply(d, s,
+								  n_blocks * block_size);
+					    }).ToVoid();
 }
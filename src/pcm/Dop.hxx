@@ -22,6 +22,7 @@
 
 #include "Buffer.hxx"
 #include "RestBuffer.hxx"
+#include "Shuffle.hxx"
 
 #include <stdint.h>
 
@@ -33,14 +34,25 @@ template<typename T> struct ConstBuffer;
  * http://dsd-guide.com/dop-open-standard
  */
 class DsdToDopConverter {
-	unsigned channels;
+	/**
+	 * Converts one block.
+	 */
+	PcmShuffle shuffle;
 
 	PcmBuffer buffer;
 
 	PcmRestBuffer<uint8_t, 4> rest_buffer;
 
 public:
-	void Open(unsigned _channels) noexcept;
+	void Open(unsigned channels) noexcept;
+
+	/**
+	 * Apply another permutation (e.g. byte swapping) to the
+	 * output of this converter, within the same pass.
+	 */
+	void Chain(const PcmShuffle &next) noexcept {
+		shuffle.Chain(next);
+	}
 
 	void Reset() noexcept {
 		rest_buffer.Reset();
@@ -57,10 +69,14 @@ public:
 	 * @return the size of one output block in bytes
 	 */
 	size_t GetOutputBlockSize() const noexcept {
-		return 2 * GetInputBlockSize();
+		return shuffle.GetOutputSize(GetInputBlockSize());
 	}
 
-	ConstBuffer<uint32_t> Convert(ConstBuffer<uint8_t> src) noexcept;
+	/**
+	 * @return the DoP samples (#uint32_t unless Chain() has
+	 * changed the sample size)
+	 */
+	ConstBuffer<void> Convert(ConstBuffer<uint8_t> src) noexcept;
 };
 
 #endif
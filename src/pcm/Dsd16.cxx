@@ -16,54 +16,37 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-
 #include "Dsd16.hxx"
 #include "util/ConstBuffer.hxx"
 
-#include <functional>
-
-/**
- * Construct a 16 bit integer from two bytes.
- */
-static constexpr uint16_t
-Construct16(uint8_t a, uint8_t b) noexcept
-{
-	/* "a" is the oldest byte, which must be in the most
-	   significant byte */
-
-	return uint16_t(b) | (uint16_t(a) << 8);
-}
-
-static constexpr uint16_t
-Dsd8To16Sample(const uint8_t *src, unsigned channels) noexcept
-{
-	return Construct16(src[0], src[channels]);
-}
-
-static void
-Dsd8To16(uint16_t *dest, const uint8_t *src,
-	 size_t out_frames, unsigned channels) noexcept
-{
-	for (size_t i = 0; i < out_frames; ++i) {
-		for (size_t c = 0; c < channels; ++c)
-			*dest++ = Dsd8To16Sample(src++, channels);
-
-		src += channels;
-	}
-}
-
 void
-Dsd16Converter::Open(unsigned _channels) noexcept
+Dsd16Converter::Open(unsigned channels) noexcept
 {
-	channels = _channels;
-
 	rest_buffer.Open(channels);
+
+	/* one block of two DSD_U8 frames becomes one DSD_U16 frame;
+	   the oldest byte goes into the most significant byte */
+	int8_t map[PcmShuffle::MAX_FRAME_SIZE];
+	for (unsigned c = 0; c < channels; ++c)
+		for (unsigned i = 0; i < 2; ++i)
+			map[c * 2 + PcmShuffle::NativeBytePosition(2, 1 - i)] =
+				i * channels + c;
+
+	shuffle.Open(2, 2, channels, map);
 }
 
 ConstBuffer<uint16_t>
 Dsd16Converter::Convert(ConstBuffer<uint8_t> src) noexcept
 {
-	using namespace std::placeholders;
-	return rest_buffer.Process<uint16_t>(buffer, src, channels,
-					     std::bind(Dsd8To16, _1, _2, _3, channels));
+	const size_t block_size = rest_buffer.GetInputBlockSize();
+	const auto dest =
+		rest_buffer.Process<uint8_t>(buffer, src,
+					     shuffle.GetOutputSize(block_size),
+					     [this, block_size](uint8_t *d,
+								const uint8_t *s,
+								size_t n_blocks){
+						     shuffle.Apply(d, s,
+								   n_blocks * block_size);
+					     });
+	return ConstBuffer<uint16_t>::FromVoid(dest.ToVoid());
 }
@@ -22,6 +22,7 @@
 
 #include "Buffer.hxx"
 #include "RestBuffer.hxx"
+#include "Shuffle.hxx"
 
 #include <stdint.h>
 
@@ -31,14 +32,25 @@ template<typename T> struct ConstBuffer;
  * Convert DSD_U8 to DSD_U16 (native endian, oldest bits in MSB).
  */
 class Dsd16Converter {
-	unsigned channels;
+	/**
+	 * Converts one block.
+	 */
+	PcmShuffle shuffle;
 
 	PcmBuffer buffer;
 
 	PcmRestBuffer<uint8_t, 2> rest_buffer;
 
 public:
-	void Open(unsigned _channels) noexcept;
+	void Open(unsigned channels) noexcept;
+
+	/**
+	 * Apply another permutation (e.g. byte swapping) to the
+	 * output of this converter, within the same pass.
+	 */
+	void Chain(const PcmShuffle &next) noexcept {
+		shuffle.Chain(next);
+	}
 
 	void Reset() noexcept {
 		rest_buffer.Reset();
@@ -55,7 +67,7 @@ public:
 	 * @return the size of one output block in bytes
 	 */
 	size_t GetOutputBlockSize() const noexcept {
-		return GetInputBlockSize();
+		return shuffle.GetOutputSize(GetInputBlockSize());
 	}
 
 	ConstBuffer<uint16_t> Convert(ConstBuffer<uint8_t> src) noexcept;
@@ -16,56 +16,38 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-
 #include "Dsd32.hxx"
 #include "util/ConstBuffer.hxx"
 
-#include <functional>
-
-/**
- * Construct a 32 bit integer from four bytes.
- */
-static constexpr uint32_t
-Construct32(uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept
-{
-	/* "a" is the oldest byte, which must be in the most
-	   significant byte */
-
-	return uint32_t(d) | (uint32_t(c) << 8) |
-		(uint32_t(b) << 16) | (uint32_t(a) << 24);
-}
-
-static constexpr uint32_t
-Dsd8To32Sample(const uint8_t *src, unsigned channels) noexcept
-{
-	return Construct32(src[0], src[channels],
-			   src[2 * channels], src[3 * channels]);
-}
-
-static void
-Dsd8To32(uint32_t *dest, const uint8_t *src,
-	 size_t out_frames, unsigned channels) noexcept
-{
-	for (size_t i = 0; i < out_frames; ++i) {
-		for (size_t c = 0; c < channels; ++c)
-			*dest++ = Dsd8To32Sample(src++, channels);
-
-		src += 3 * channels;
-	}
-}
-
 void
-Dsd32Converter::Open(unsigned _channels) noexcept
+Dsd32Converter::Open(unsigned channels) noexcept
 {
-	channels = _channels;
-
 	rest_buffer.Open(channels);
+
+	/* one block of four DSD_U8 frames becomes one DSD_U32
+	   frame; the oldest byte goes into the most significant
+	   byte */
+	int8_t map[PcmShuffle::MAX_FRAME_SIZE];
+	for (unsigned c = 0; c < channels; ++c)
+		for (unsigned i = 0; i < 4; ++i)
+			map[c * 4 + PcmShuffle::NativeBytePosition(4, 3 - i)] =
+				i * channels + c;
+
+	shuffle.Open(4, 4, channels, map);
 }
 
 ConstBuffer<uint32_t>
 Dsd32Converter::Convert(ConstBuffer<uint8_t> src) noexcept
 {
-	using namespace std::placeholders;
-	return rest_buffer.Process<uint32_t>(buffer, src, channels,
-					     std::bind(Dsd8To32, _1, _2, _3, channels));
+	const size_t block_size = rest_buffer.GetInputBlockSize();
+	const auto dest =
+		rest_buffer.Process<uint8_t>(buffer, src,
+					     shuffle.GetOutputSize(block_size),
+					     [this, block_size](uint8_t *d,
+								const uint8_t *s,
+								size_t n_blocks){
+						     shuffle.Apply(d, s,
+								   n_blocks * block_size);
+					     });
+	return ConstBuffer<uint32_t>::FromVoid(dest.ToVoid());
 }
@@ -19,9 +19,8 @@
 
 #include "Export.hxx"
 #include "Order.hxx"
-#include "Pack.hxx"
 #include "Silence.hxx"
-#include "util/ByteReverse.hxx"
+#include "util/ByteOrder.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/WritableBuffer.hxx"
 
@@ -92,17 +91,116 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 			reverse_endian = sample_size;
 	}
 
+	OpenShuffle(sample_format);
+
+#ifdef ENABLE_DSD
+	if (shuffle.IsDefined()) {
+		/* let the DSD converter swap, shift or pack its
+		   output in the same pass */
+		switch (dsd_mode) {
+		case DsdMode::NONE:
+			break;
+
+		case DsdMode::U16:
+			dsd16_converter.Chain(shuffle);
+			shuffle.Close();
+			break;
+
+		case DsdMode::U32:
+			dsd32_converter.Chain(shuffle);
+			shuffle.Close();
+			break;
+
+		case DsdMode::DOP:
+			dop_converter.Chain(shuffle);
+			shuffle.Close();
+			break;
+		}
+	}
+#endif
+
 	/* prepare a moment of silence for GetSilence() */
 	char buffer[sizeof(silence_buffer)];
 	const size_t buffer_size = GetInputBlockSize();
-	assert(buffer_size < sizeof(buffer));
+	assert(buffer_size <= sizeof(buffer));
 	PcmSilence({buffer, buffer_size}, src_sample_format);
 	auto s = Export({buffer, buffer_size});
-	assert(s.size < sizeof(silence_buffer));
+	assert(s.size <= sizeof(silence_buffer));
 	silence_size = s.size;
 	memcpy(silence_buffer, s.data, s.size);
 }
 
+/**
+ * Does ToAlsaChannelOrder() modify samples of this format?
+ */
+static constexpr bool
+IsAlsaChannelOrderFormat(SampleFormat format) noexcept
+{
+	switch (format) {
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::S8:
+	case SampleFormat::DSD:
+		return false;
+
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		return true;
+	}
+
+	return false;
+}
+
+void
+PcmExport::OpenShuffle(SampleFormat sample_format) noexcept
+{
+	/* the shuffle is chained to the DSD converters, which
+	   preserve the channel order */
+	const bool reorder = alsa_channel_order &&
+		IsAlsaChannelOrderFormat(src_sample_format) &&
+		(channels == 6 || channels == 8);
+
+	if (!reorder && !shift8 && !pack24 && reverse_endian == 0) {
+		shuffle.Close();
+		return;
+	}
+
+	const size_t in_sample_size = sample_format_size(sample_format);
+	const size_t out_sample_size = pack24 ? 3 : in_sample_size;
+	assert(channels * out_sample_size <= PcmShuffle::MAX_FRAME_SIZE);
+
+	int8_t map[PcmShuffle::MAX_FRAME_SIZE];
+	for (unsigned c = 0; c < channels; ++c) {
+		const unsigned src_channel = reorder
+			? ToAlsaChannelOrderSource(channels, c)
+			: c;
+
+		for (size_t b = 0; b < out_sample_size; ++b) {
+			/* which byte of the (possibly shifted or
+			   packed) sample lands here? */
+			const size_t j = reverse_endian > 0
+				? out_sample_size - 1 - b
+				: b;
+
+			int i = j;
+			if (shift8)
+				/* i << 8 */
+				i += IsBigEndian() ? 1 : -1;
+			else if (pack24 && IsBigEndian())
+				/* skip the most significant (padding)
+				   byte */
+				++i;
+
+			map[c * out_sample_size + b] = i >= 0 && i < int(in_sample_size)
+				? int8_t(src_channel * in_sample_size + i)
+				: int8_t(-1);
+		}
+	}
+
+	shuffle.Open(in_sample_size, out_sample_size, channels, map);
+}
+
 void
 PcmExport::Reset() noexcept
 {
@@ -267,10 +365,6 @@ PcmExport::Params::CalcInputSampleRate(unsigned sample_rate) const noexcept
 ConstBuffer<void>
 PcmExport::Export(ConstBuffer<void> data) noexcept
 {
-	if (alsa_channel_order)
-		data = ToAlsaChannelOrder(order_buffer, data,
-					  src_sample_format, channels);
-
 #ifdef ENABLE_DSD
 	switch (dsd_mode) {
 	case DsdMode::NONE:
@@ -287,43 +381,19 @@ PcmExport::Export(ConstBuffer<void> data) noexcept
 		break;
 
 	case DsdMode::DOP:
-		data = dop_converter.Convert(ConstBuffer<uint8_t>::FromVoid(data))
-			.ToVoid();
+		data = dop_converter.Convert(ConstBuffer<uint8_t>::FromVoid(data));
 		break;
 	}
 #endif
 
-	if (pack24) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
-		const size_t num_samples = src.size;
-		const size_t dest_size = num_samples * 3;
-		uint8_t *dest = (uint8_t *)pack_buffer.Get(dest_size);
-		assert(dest != nullptr);
-
-		pcm_pack_24(dest, src.begin(), src.end());
-
-		data.data = dest;
-		data.size = dest_size;
-	} else if (shift8) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
-
-		uint32_t *dest = (uint32_t *)pack_buffer.Get(data.size);
-		data.data = dest;
-
-		for (auto i : src)
-			*dest++ = i << 8;
-	}
-
-	if (reverse_endian > 0) {
-		assert(reverse_endian >= 2);
-
+	if (shuffle.IsDefined()) {
 		const auto src = ConstBuffer<uint8_t>::FromVoid(data);
-
-		uint8_t *dest = (uint8_t *)reverse_buffer.Get(data.size);
+		uint8_t *dest = (uint8_t *)
+			shuffle_buffer.Get(shuffle.GetOutputSize(src.size));
 		assert(dest != nullptr);
-		data.data = dest;
 
-		reverse_bytes(dest, src.begin(), src.end(), reverse_endian);
+		data.size = shuffle.Apply(dest, src.data, src.size);
+		data.data = dest;
 	}
 
 	return data;
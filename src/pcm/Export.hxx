@@ -22,6 +22,7 @@
 
 #include "SampleFormat.hxx"
 #include "Buffer.hxx"
+#include "Shuffle.hxx"
 #include "config.h"
 
 #ifdef ENABLE_DSD
@@ -40,13 +41,6 @@ template<typename T> struct ConstBuffer;
  * representation which are not supported by the #PcmConvert library.
  */
 class PcmExport {
-	/**
-	 * This buffer is used to reorder channels.
-	 *
-	 * @see #alsa_channel_order
-	 */
-	PcmBuffer order_buffer;
-
 #ifdef ENABLE_DSD
 	/**
 	 * @see DsdMode::U16
@@ -65,18 +59,18 @@ class PcmExport {
 #endif
 
 	/**
-	 * The buffer is used to pack samples, removing padding.
-	 *
-	 * @see #pack24
+	 * The byte permutation which implements
+	 * #alsa_channel_order, #shift8, #pack24 and #reverse_endian
+	 * in one pass.  It is undefined if none of these is enabled.
+	 * In DSD mode, it is chained to the DSD converter and then
+	 * closed.
 	 */
-	PcmBuffer pack_buffer;
+	PcmShuffle shuffle;
 
 	/**
-	 * The buffer is used to reverse the byte order.
-	 *
-	 * @see #reverse_endian
+	 * The destination buffer for #shuffle.
 	 */
-	PcmBuffer reverse_buffer;
+	PcmBuffer shuffle_buffer;
 
 	size_t silence_size;
 
@@ -182,6 +176,15 @@ public:
 	void Open(SampleFormat sample_format, unsigned channels,
 		  Params params) noexcept;
 
+private:
+	/**
+	 * Set up #shuffle according to the options.
+	 *
+	 * @param sample_format the sample format after DSD conversion
+	 */
+	void OpenShuffle(SampleFormat sample_format) noexcept;
+
+public:
 	/**
 	 * Reset the filter's state, e.g. drop/flush buffers.
 	 */
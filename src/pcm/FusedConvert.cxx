@@ -0,0 +1,217 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "FusedConvert.hxx"
+#include "Traits.hxx"
+#include "FloatConvert.hxx"
+#include "ShiftConvert.hxx"
+#include "util/ConstBuffer.hxx"
+
+/**
+ * Duplicate each (converted) mono sample to both stereo channels.
+ */
+template<typename Traits>
+struct MonoToStereoOp {
+	static constexpr unsigned SRC_CHANNELS = 1;
+	static constexpr unsigned DEST_CHANNELS = 2;
+
+	/**
+	 * @param f a function which returns the converted source
+	 * sample with the given index
+	 */
+	template<typename F>
+	static void Apply(typename Traits::pointer_type gcc_restrict dest,
+			  size_t frames, F &&f) noexcept {
+		for (size_t i = 0; i < frames; ++i) {
+			const auto value = f(i);
+			dest[2 * i] = value;
+			dest[2 * i + 1] = value;
+		}
+	}
+};
+
+/**
+ * Mix both (converted) stereo samples of each frame to mono.  This is
+ * the same formula as the one in PcmChannels.cxx.
+ */
+template<typename Traits>
+struct StereoToMonoOp {
+	static constexpr unsigned SRC_CHANNELS = 2;
+	static constexpr unsigned DEST_CHANNELS = 1;
+
+	template<typename F>
+	static void Apply(typename Traits::pointer_type gcc_restrict dest,
+			  size_t frames, F &&f) noexcept {
+		for (size_t i = 0; i < frames; ++i) {
+			const typename Traits::sum_type a(f(2 * i));
+			const typename Traits::sum_type b(f(2 * i + 1));
+			dest[i] = typename Traits::value_type((a + b) / 2);
+		}
+	}
+};
+
+/**
+ * A kernel for a sample converter which converts one sample at a
+ * time (see ShiftConvert.hxx and FloatConvert.hxx): each sample is
+ * loaded, converted and stored in its destination channel(s) in one
+ * go.  The compiler vectorizes this loop.
+ */
+template<typename C, template<typename> class Op>
+struct PerSampleKernel {
+	typedef typename C::SrcTraits SrcTraits;
+	typedef typename C::DstTraits DstTraits;
+	typedef Op<DstTraits> O;
+
+	static ConstBuffer<void> Convert(PcmBuffer &buffer,
+					 ConstBuffer<void> _src) noexcept {
+		const auto src = ConstBuffer<typename SrcTraits::value_type>::FromVoid(_src);
+		const size_t frames = src.size / O::SRC_CHANNELS;
+		const size_t dest_size = frames * O::DEST_CHANNELS;
+		const auto dest = buffer.GetT<typename DstTraits::value_type>(dest_size);
+
+		O::Apply(dest, frames, [data = src.data](size_t i){
+			return C::Convert(data[i]);
+		});
+
+		return ConstBuffer<typename DstTraits::value_type>(dest, dest_size).ToVoid();
+	}
+};
+
+typedef PcmFusedConverter::Function FusedFunction;
+
+/**
+ * Choose the channel conversion for the given sample converter.
+ *
+ * @return nullptr if this channel conversion is not implemented
+ */
+template<typename C>
+static FusedFunction
+ChooseChannels(unsigned src_channels, unsigned dest_channels) noexcept
+{
+	if (src_channels == 1 && dest_channels == 2)
+		return PerSampleKernel<C, MonoToStereoOp>::Convert;
+	else if (src_channels == 2 && dest_channels == 1)
+		return PerSampleKernel<C, StereoToMonoOp>::Convert;
+	else
+		return nullptr;
+}
+
+template<SampleFormat SF, SampleFormat DF>
+static FusedFunction
+ChooseLeftShift(unsigned src_channels, unsigned dest_channels) noexcept
+{
+	return ChooseChannels<LeftShiftSampleConvert<SF, DF>>(src_channels,
+							      dest_channels);
+}
+
+template<SampleFormat SF, SampleFormat DF>
+static FusedFunction
+ChooseRightShift(unsigned src_channels, unsigned dest_channels) noexcept
+{
+	return ChooseChannels<RightShiftSampleConvert<SF, DF>>(src_channels,
+							       dest_channels);
+}
+
+template<SampleFormat F>
+static FusedFunction
+ChooseToFloat(unsigned src_channels, unsigned dest_channels) noexcept
+{
+	return ChooseChannels<IntegerToFloatSampleConvert<F>>(src_channels,
+							      dest_channels);
+}
+
+static FusedFunction
+ChooseFunction(SampleFormat src_format, unsigned src_channels,
+	       SampleFormat dest_format, unsigned dest_channels) noexcept
+{
+	switch (dest_format) {
+	case SampleFormat::S24_P32:
+		switch (src_format) {
+		case SampleFormat::S16:
+			return ChooseLeftShift<SampleFormat::S16,
+					       SampleFormat::S24_P32>(src_channels,
+								      dest_channels);
+
+		case SampleFormat::S32:
+			return ChooseRightShift<SampleFormat::S32,
+						SampleFormat::S24_P32>(src_channels,
+								       dest_channels);
+
+		default:
+			break;
+		}
+
+		break;
+
+	case SampleFormat::S32:
+		switch (src_format) {
+		case SampleFormat::S16:
+			return ChooseLeftShift<SampleFormat::S16,
+					       SampleFormat::S32>(src_channels,
+								  dest_channels);
+
+		case SampleFormat::S24_P32:
+			return ChooseLeftShift<SampleFormat::S24_P32,
+					       SampleFormat::S32>(src_channels,
+								  dest_channels);
+
+		default:
+			break;
+		}
+
+		break;
+
+	case SampleFormat::FLOAT:
+		switch (src_format) {
+		case SampleFormat::S16:
+			return ChooseToFloat<SampleFormat::S16>(src_channels,
+								dest_channels);
+
+		case SampleFormat::S24_P32:
+			return ChooseToFloat<SampleFormat::S24_P32>(src_channels,
+								    dest_channels);
+
+		case SampleFormat::S32:
+			return ChooseToFloat<SampleFormat::S32>(src_channels,
+								dest_channels);
+
+		default:
+			break;
+		}
+
+		break;
+
+	default:
+		break;
+	}
+
+	return nullptr;
+}
+
+bool
+PcmFusedConverter::Open(SampleFormat src_format, unsigned src_channels,
+			SampleFormat dest_format,
+			unsigned dest_channels) noexcept
+{
+	assert(function == nullptr);
+
+	function = ChooseFunction(src_format, src_channels,
+				  dest_format, dest_channels);
+	return function != nullptr;
+}
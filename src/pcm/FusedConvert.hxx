@@ -0,0 +1,94 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_FUSED_CONVERT_HXX
+#define MPD_PCM_FUSED_CONVERT_HXX
+
+#include "SampleFormat.hxx"
+#include "Buffer.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <assert.h>
+
+/**
+ * Converts both the sample format and the number of channels in a
+ * single pass, without the intermediate buffer which
+ * #PcmFormatConverter followed by #PcmChannelsConverter would need.
+ * There is one template specialized kernel for each supported
+ * combination; it is chosen by Open().
+ *
+ * Only S16, S24_P32 and S32 sources are supported: the kernels are plain loops
+ * which rely on the compiler's vectorizer, and that loses against the
+ * hand-written SIMD code for float to integer conversion and for
+ * dithering.  The output is the same as the one of the generic
+ * chain.
+ */
+class PcmFusedConverter {
+public:
+	typedef ConstBuffer<void> (*Function)(PcmBuffer &buffer,
+					       ConstBuffer<void> src);
+
+private:
+	Function function = nullptr;
+
+	PcmBuffer buffer;
+
+public:
+#ifndef NDEBUG
+	~PcmFusedConverter() noexcept {
+		assert(function == nullptr);
+	}
+#endif
+
+	/**
+	 * Look up a kernel for the given combination and prepare for
+	 * Convert().
+	 *
+	 * @return false if there is no kernel for this combination;
+	 * the caller shall fall back to #PcmFormatConverter and
+	 * #PcmChannelsConverter then
+	 */
+	bool Open(SampleFormat src_format, unsigned src_channels,
+		  SampleFormat dest_format, unsigned dest_channels) noexcept;
+
+	/**
+	 * Closes the object.  After that, you may call Open() again.
+	 */
+	void Close() noexcept {
+		assert(function != nullptr);
+
+		function = nullptr;
+	}
+
+	/**
+	 * Convert a block of PCM data.
+	 *
+	 * @param src the input buffer
+	 * @return the destination buffer
+	 */
+	gcc_pure
+	ConstBuffer<void> Convert(ConstBuffer<void> src) noexcept {
+		assert(function != nullptr);
+
+		return function(buffer, src);
+	}
+};
+
+#endif
@@ -24,8 +24,8 @@
 
 #include <assert.h>
 
-GluePcmResampler::GluePcmResampler()
-	:resampler(pcm_resampler_create()) {}
+GluePcmResampler::GluePcmResampler(const PcmResamplerSetup *setup)
+	:resampler(pcm_resampler_create(setup)) {}
 
 GluePcmResampler::~GluePcmResampler() noexcept
 {
@@ -24,6 +24,7 @@
 #include "FormatConverter.hxx"
 
 struct AudioFormat;
+struct PcmResamplerSetup;
 class PcmResampler;
 template<typename T> struct ConstBuffer;
 
@@ -45,7 +46,10 @@ class GluePcmResampler {
 	PcmFormatConverter format_converter;
 
 public:
-	GluePcmResampler();
+	/**
+	 * @param setup see pcm_resampler_create()
+	 */
+	explicit GluePcmResampler(const PcmResamplerSetup *setup=nullptr);
 	~GluePcmResampler() noexcept;
 
 	void Open(AudioFormat src_format, unsigned new_sample_rate);
@@ -19,6 +19,16 @@
 
 #include "Interleave.hxx"
 
+#ifdef __SSE2__
+#include "X86Convert.hxx"
+#define INTERLEAVE_SIMD(name) X86Convert::name
+static constexpr size_t INTERLEAVE_BLOCK_SIZE = X86Convert::BLOCK_SIZE;
+#elif defined(__ARM_NEON__)
+#include "Neon.hxx"
+#define INTERLEAVE_SIMD(name) Neon ## name
+static constexpr size_t INTERLEAVE_BLOCK_SIZE = NEON_MIX_BLOCK_SIZE;
+#endif
+
 #include <string.h>
 
 static void
@@ -48,6 +58,56 @@ PcmInterleaveStereo(T *gcc_restrict dest,
 	}
 }
 
+#ifdef INTERLEAVE_SIMD
+
+/**
+ * Interleave full blocks with the SIMD kernel and leave the rest to
+ * the generic PcmInterleaveStereo().
+ */
+template<typename T, void (*F)(T *, const T *, const T *, size_t) noexcept>
+static void
+PcmInterleaveStereoOptimized(T *gcc_restrict dest,
+			     const T *gcc_restrict src1,
+			     const T *gcc_restrict src2,
+			     size_t n_frames) noexcept
+{
+	const size_t n = n_frames - n_frames % INTERLEAVE_BLOCK_SIZE;
+	F(dest, src1, src2, n);
+	PcmInterleaveStereo(dest + 2 * n, src1 + n, src2 + n, n_frames - n);
+}
+
+static void
+PcmInterleaveStereo(uint8_t *gcc_restrict dest,
+		    const uint8_t *gcc_restrict src1,
+		    const uint8_t *gcc_restrict src2,
+		    size_t n_frames) noexcept
+{
+	PcmInterleaveStereoOptimized<uint8_t, INTERLEAVE_SIMD(InterleaveStereo8)>
+		(dest, src1, src2, n_frames);
+}
+
+static void
+PcmInterleaveStereo(int16_t *gcc_restrict dest,
+		    const int16_t *gcc_restrict src1,
+		    const int16_t *gcc_restrict src2,
+		    size_t n_frames) noexcept
+{
+	PcmInterleaveStereoOptimized<int16_t, INTERLEAVE_SIMD(InterleaveStereo16)>
+		(dest, src1, src2, n_frames);
+}
+
+static void
+PcmInterleaveStereo(int32_t *gcc_restrict dest,
+		    const int32_t *gcc_restrict src1,
+		    const int32_t *gcc_restrict src2,
+		    size_t n_frames) noexcept
+{
+	PcmInterleaveStereoOptimized<int32_t, INTERLEAVE_SIMD(InterleaveStereo32)>
+		(dest, src1, src2, n_frames);
+}
+
+#endif
+
 template<typename T>
 static void
 PcmInterleaveT(T *gcc_restrict dest,
@@ -69,6 +129,14 @@ PcmInterleaveT(T *gcc_restrict dest,
 	}
 }
 
+static void
+PcmInterleave8(uint8_t *gcc_restrict dest,
+	       const ConstBuffer<const uint8_t *> src,
+	       size_t n_frames) noexcept
+{
+	PcmInterleaveT(dest, src, n_frames);
+}
+
 static void
 PcmInterleave16(int16_t *gcc_restrict dest,
 		const ConstBuffer<const int16_t *> src,
@@ -85,12 +153,60 @@ PcmInterleave32(int32_t *gcc_restrict dest,
 	PcmInterleaveT(dest, src, n_frames);
 }
 
+static void
+PcmDeinterleaveStereo(int32_t *gcc_restrict dest1,
+		      int32_t *gcc_restrict dest2,
+		      const int32_t *gcc_restrict src,
+		      size_t n_frames) noexcept
+{
+#ifdef INTERLEAVE_SIMD
+	const size_t n = n_frames - n_frames % INTERLEAVE_BLOCK_SIZE;
+	INTERLEAVE_SIMD(DeinterleaveStereo32)(dest1, dest2, src, n);
+	dest1 += n;
+	dest2 += n;
+	src += 2 * n;
+	n_frames -= n;
+#endif
+
+	for (size_t i = 0; i != n_frames; ++i) {
+		*dest1++ = *src++;
+		*dest2++ = *src++;
+	}
+}
+
+void
+PcmDeinterleave32(ConstBuffer<int32_t *> dest,
+		  const int32_t *gcc_restrict src,
+		  size_t n_frames) noexcept
+{
+	switch (dest.size) {
+	case 2:
+		PcmDeinterleaveStereo(dest[0], dest[1], src, n_frames);
+		return;
+	}
+
+	for (auto *d : dest) {
+		const auto *s = src++;
+
+		for (auto *const d_end = d + n_frames;
+		     d != d_end; ++d, s += dest.size)
+			*d = *s;
+	}
+}
+
 void
 PcmInterleave(void *gcc_restrict dest,
 	      ConstBuffer<const void *> src,
 	      size_t n_frames, size_t sample_size) noexcept
 {
 	switch (sample_size) {
+	case 1:
+		PcmInterleave8((uint8_t *)dest,
+			       ConstBuffer<const uint8_t *>((const uint8_t *const*)src.data,
+							    src.size),
+			       n_frames);
+		break;
+
 	case 2:
 		PcmInterleave16((int16_t *)dest,
 				ConstBuffer<const int16_t *>((const int16_t *const*)src.data,
@@ -50,4 +50,23 @@ PcmInterleaveFloat(float *gcc_restrict dest, ConstBuffer<const float *> src,
 			n_frames);
 }
 
+/**
+ * Deinterleave 32 bit PCM samples from #src into one buffer per
+ * channel (the opposite of PcmInterleave32()).
+ */
+void
+PcmDeinterleave32(ConstBuffer<int32_t *> dest,
+		  const int32_t *gcc_restrict src,
+		  size_t n_frames) noexcept;
+
+static inline void
+PcmDeinterleaveFloat(ConstBuffer<float *> dest,
+		     const float *gcc_restrict src,
+		     size_t n_frames) noexcept
+{
+	PcmDeinterleave32(ConstBuffer<int32_t *>((int32_t *const*)dest.data,
+						 dest.size),
+			  (const int32_t *)src, n_frames);
+}
+
 #endif
@@ -30,22 +30,21 @@
 
 static constexpr Domain libsamplerate_domain("libsamplerate");
 
-static int lsr_converter = SRC_SINC_FASTEST;
-
-static bool
+/**
+ * @return the converter id or -1 on error
+ */
+static int
 lsr_parse_converter(const char *s)
 {
 	assert(s != nullptr);
 
 	if (*s == 0)
-		return true;
+		return SRC_SINC_FASTEST;
 
 	char *endptr;
 	long l = strtol(s, &endptr, 10);
-	if (*endptr == 0 && src_get_name(l) != nullptr) {
-		lsr_converter = l;
-		return true;
-	}
+	if (*endptr == 0 && src_get_name(l) != nullptr)
+		return l;
 
 	size_t length = strlen(s);
 	for (int i = 0;; ++i) {
@@ -53,26 +52,26 @@ lsr_parse_converter(const char *s)
 		if (name == nullptr)
 			break;
 
-		if (StringEqualsCaseASCII(s, name, length)) {
-			lsr_converter = i;
-			return true;
-		}
+		if (StringEqualsCaseASCII(s, name, length))
+			return i;
 	}
 
-	return false;
+	return -1;
 }
 
-void
-pcm_resample_lsr_global_init(const ConfigBlock &block)
+int
+pcm_resample_lsr_parse(const ConfigBlock &block)
 {
-	const char *converter = block.GetBlockValue("type", "2");
-	if (!lsr_parse_converter(converter))
+	const char *type = block.GetBlockValue("type", "2");
+	const int converter = lsr_parse_converter(type);
+	if (converter < 0)
 		throw FormatRuntimeError("unknown samplerate converter '%s'",
-					 converter);
+					 type);
 
 	FormatDebug(libsamplerate_domain,
 		    "libsamplerate converter '%s'",
-		    src_get_name(lsr_converter));
+		    src_get_name(converter));
+	return converter;
 }
 
 AudioFormat
@@ -89,7 +88,7 @@ LibsampleratePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
 	af.format = SampleFormat::FLOAT;
 
 	int src_error;
-	state = src_new(lsr_converter, channels, &src_error);
+	state = src_new(converter, channels, &src_error);
 	if (!state)
 		throw FormatRuntimeError("libsamplerate initialization has failed: %s",
 					 src_strerror(src_error));
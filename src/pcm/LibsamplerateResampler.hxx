@@ -32,6 +32,8 @@ struct ConfigBlock;
  * A resampler using libsamplerate.
  */
 class LibsampleratePcmResampler final : public PcmResampler {
+	const int converter;
+
 	unsigned src_rate, dest_rate;
 	unsigned channels;
 
@@ -41,6 +43,9 @@ class LibsampleratePcmResampler final : public PcmResampler {
 	PcmBuffer buffer;
 
 public:
+	explicit LibsampleratePcmResampler(int _converter) noexcept
+		:converter(_converter) {}
+
 	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
 	void Close() noexcept override;
 	void Reset() noexcept override;
@@ -50,7 +55,13 @@ private:
 	ConstBuffer<float> Resample2(ConstBuffer<float> src);
 };
 
-void
-pcm_resample_lsr_global_init(const ConfigBlock &block);
+/**
+ * Parse the "type" setting of a "resampler" block and return the
+ * libsamplerate converter id.
+ *
+ * Throws on error.
+ */
+int
+pcm_resample_lsr_parse(const ConfigBlock &block);
 
 #endif
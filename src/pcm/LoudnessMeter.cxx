@@ -0,0 +1,188 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "LoudnessMeter.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * The BS.1770 block loudness offset.
+ */
+static constexpr double LOUDNESS_OFFSET = -0.691;
+
+static constexpr double ABSOLUTE_GATE = -70;
+static constexpr double RELATIVE_GATE = -10;
+
+static inline double
+EnergyToLoudness(double energy) noexcept
+{
+	return LOUDNESS_OFFSET + 10 * std::log10(energy);
+}
+
+static inline double
+LoudnessToEnergy(double loudness) noexcept
+{
+	return std::pow(10, (loudness - LOUDNESS_OFFSET) / 10);
+}
+
+/**
+ * The BS.1770 channel weight for the given channel in MPD's channel
+ * order: front channels 1.0, LFE ignored, surround channels 1.41.
+ */
+static constexpr double
+ChannelWeight(unsigned channel, unsigned n_channels) noexcept
+{
+	if (n_channels < 4)
+		return 1;
+
+	if (channel < (n_channels == 4 ? 2U : 3U))
+		return 1;
+
+	if (channel == 3 && n_channels >= 6)
+		/* LFE */
+		return 0;
+
+	return 1.41;
+}
+
+LoudnessMeter::LoudnessMeter(unsigned sample_rate,
+			     unsigned n_channels) noexcept
+	:subblock_frames(std::max(sample_rate / 10, 1U))
+{
+	const double rate = sample_rate;
+
+	/* the BS.1770 filter coefficients are specified for 48 kHz;
+	   these are the analog prototypes used to derive them for
+	   any sample rate */
+	{
+		const double f0 = 1681.974450955533;
+		const double G = 3.999843853973347;
+		const double Q = 0.7071752369554196;
+
+		const double K = std::tan(M_PI * f0 / rate);
+		const double Vh = std::pow(10.0, G / 20.0);
+		const double Vb = std::pow(Vh, 0.4996667741545416);
+		const double a0 = 1.0 + K / Q + K * K;
+
+		shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+		shelf.b1 = 2.0 * (K * K - Vh) / a0;
+		shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+		shelf.a1 = 2.0 * (K * K - 1.0) / a0;
+		shelf.a2 = (1.0 - K / Q + K * K) / a0;
+	}
+
+	{
+		const double f0 = 38.13547087602444;
+		const double Q = 0.5003270373238773;
+
+		const double K = std::tan(M_PI * f0 / rate);
+		const double a0 = 1.0 + K / Q + K * K;
+
+		highpass.b0 = 1.0;
+		highpass.b1 = -2.0;
+		highpass.b2 = 1.0;
+		highpass.a1 = 2.0 * (K * K - 1.0) / a0;
+		highpass.a2 = (1.0 - K / Q + K * K) / a0;
+	}
+
+	channels.reserve(n_channels);
+	for (unsigned i = 0; i < n_channels; ++i)
+		channels.emplace_back(ChannelWeight(i, n_channels));
+}
+
+void
+LoudnessMeter::Feed(ConstBuffer<float> src) noexcept
+{
+	const size_t n_channels = channels.size();
+
+	for (const float *p = src.begin(), *end = src.end();
+	     size_t(end - p) >= n_channels;) {
+		double sum = 0;
+
+		for (auto &c : channels) {
+			const double x = *p++;
+
+			const float a = std::fabs(float(x));
+			if (a > peak)
+				peak = a;
+
+			const double y = shelf.b0 * x + c.s1;
+			c.s1 = shelf.b1 * x - shelf.a1 * y + c.s2;
+			c.s2 = shelf.b2 * x - shelf.a2 * y;
+
+			const double z = highpass.b0 * y + c.h1;
+			c.h1 = highpass.b1 * y - highpass.a1 * z + c.h2;
+			c.h2 = highpass.b2 * y - highpass.a2 * z;
+
+			sum += c.weight * z * z;
+		}
+
+		subblock_sum += sum;
+
+		if (++subblock_position < subblock_frames)
+			continue;
+
+		const double mean = subblock_sum / subblock_frames;
+		subblock_sum = 0;
+		subblock_position = 0;
+
+		if (n_subblocks >= 3)
+			blocks.push_back((previous[0] + previous[1] +
+					  previous[2] + mean) / 4);
+
+		previous[0] = previous[1];
+		previous[1] = previous[2];
+		previous[2] = mean;
+		++n_subblocks;
+	}
+}
+
+double
+LoudnessMeter::GetIntegratedLoudness() const noexcept
+{
+	const double absolute_threshold = LoudnessToEnergy(ABSOLUTE_GATE);
+
+	double sum = 0;
+	size_t n = 0;
+	for (double i : blocks) {
+		if (i > absolute_threshold) {
+			sum += i;
+			++n;
+		}
+	}
+
+	if (n == 0)
+		return -INFINITY;
+
+	const double relative_threshold =
+		LoudnessToEnergy(EnergyToLoudness(sum / n) + RELATIVE_GATE);
+
+	sum = 0;
+	n = 0;
+	for (double i : blocks) {
+		if (i > absolute_threshold && i > relative_threshold) {
+			sum += i;
+			++n;
+		}
+	}
+
+	return EnergyToLoudness(sum / n);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_LOUDNESS_METER_HXX
+#define MPD_PCM_LOUDNESS_METER_HXX
+
+#include "util/Compiler.h"
+
+#include <vector>
+
+#include <stddef.h>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * Measures the integrated loudness of a song according to ITU-R
+ * BS.1770 / EBU R128 (K-weighting, 400 ms blocks with 75% overlap,
+ * absolute and relative gating) and its sample peak.
+ */
+class LoudnessMeter {
+	struct Biquad {
+		double b0, b1, b2, a1, a2;
+	};
+
+	/**
+	 * The two K-weighting stages: a high shelf modelling the
+	 * acoustic effect of the head, followed by a high pass.
+	 */
+	Biquad shelf, highpass;
+
+	struct ChannelState {
+		double weight;
+
+		/* transposed direct form II state of the two
+		   stages */
+		double s1 = 0, s2 = 0, h1 = 0, h2 = 0;
+
+		explicit ChannelState(double _weight) noexcept
+			:weight(_weight) {}
+	};
+
+	std::vector<ChannelState> channels;
+
+	/**
+	 * The number of frames in a 100 ms sub-block.
+	 */
+	const size_t subblock_frames;
+
+	size_t subblock_position = 0;
+
+	/**
+	 * The weighted sum of squares of the current sub-block.
+	 */
+	double subblock_sum = 0;
+
+	/**
+	 * The mean square values of the last three complete
+	 * sub-blocks; together with the current one, they form a
+	 * 400 ms gating block.
+	 */
+	double previous[3];
+
+	size_t n_subblocks = 0;
+
+	/**
+	 * The mean square values of all gating blocks.
+	 */
+	std::vector<double> blocks;
+
+	float peak = 0;
+
+public:
+	LoudnessMeter(unsigned sample_rate, unsigned n_channels) noexcept;
+
+	/**
+	 * Feed interleaved floating point samples.
+	 */
+	void Feed(ConstBuffer<float> src) noexcept;
+
+	/**
+	 * Returns the integrated loudness in LUFS; negative infinity
+	 * if all blocks are below the absolute gate (-70 LUFS).
+	 */
+	gcc_pure
+	double GetIntegratedLoudness() const noexcept;
+
+	/**
+	 * Returns the maximum absolute sample value.
+	 */
+	float GetPeak() const noexcept {
+		return peak;
+	}
+};
+
+#endif
@@ -23,25 +23,26 @@
 #include "Traits.hxx"
 #include "util/Clamp.hxx"
 
+#include "PcmFormat.hxx"
+#include "Buffer.hxx"
+#include "util/ConstBuffer.hxx"
+
 #include "Dither.cxx" // including the .cxx file to get inlined templates
 
+#ifdef __SSE2__
+#include "X86Convert.hxx"
+#define MIX_SIMD(name) X86Convert::name
+static constexpr size_t MIX_BLOCK_SIZE = X86Convert::BLOCK_SIZE;
+#elif defined(__ARM_NEON__)
+#include "Neon.hxx"
+#define MIX_SIMD(name) Neon ## name
+static constexpr size_t MIX_BLOCK_SIZE = NEON_MIX_BLOCK_SIZE;
+#endif
+
 #include <cmath>
 
 #include <assert.h>
-
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static typename Traits::value_type
-PcmAddVolume(PcmDither &dither,
-	     typename Traits::value_type _a, typename Traits::value_type _b,
-	     int volume1, int volume2) noexcept
-{
-	typename Traits::long_type a(_a), b(_b);
-	typename Traits::long_type c(a * volume1 + b * volume2);
-
-	return dither.DitherShift<typename Traits::long_type,
-				  Traits::BITS + PCM_VOLUME_BITS,
-				  Traits::BITS>(c);
-}
+#include <string.h>
 
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static void
@@ -50,9 +51,14 @@ PcmAddVolume(PcmDither &dither,
 	     typename Traits::const_pointer_type b,
 	     size_t n, int volume1, int volume2) noexcept
 {
-	for (size_t i = 0; i != n; ++i)
-		a[i] = PcmAddVolume<F, Traits>(dither, a[i], b[i],
-					       volume1, volume2);
+	typedef typename Traits::long_type long_type;
+
+	dither.DitherShift<long_type, Traits::BITS + PCM_VOLUME_BITS,
+			   Traits::BITS>(a, n,
+					 [a, b, volume1, volume2](size_t i){
+						 return long_type(a[i]) * volume1 +
+							 long_type(b[i]) * volume2;
+					 });
 }
 
 template<SampleFormat F, class Traits=SampleTraits<F>>
@@ -75,6 +81,14 @@ static void
 pcm_add_vol_float(float *buffer1, const float *buffer2,
 		  unsigned num_samples, float volume1, float volume2) noexcept
 {
+#ifdef MIX_SIMD
+	MIX_SIMD(MixFloat)(buffer1, buffer2, num_samples, volume1, volume2);
+	const size_t done = num_samples - num_samples % MIX_BLOCK_SIZE;
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+#endif
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -136,18 +150,73 @@ template<SampleFormat F, class Traits=SampleTraits<F>>
 static constexpr typename Traits::value_type
 PcmAdd(typename Traits::value_type _a, typename Traits::value_type _b) noexcept
 {
-	typename Traits::sum_type a(_a), b(_b);
+	typename Traits::long_type a(_a), b(_b);
 
 	return PcmClamp<F, Traits>(a + b);
 }
 
+/**
+ * Add full blocks of samples with SIMD instructions (if available
+ * for this sample format).
+ *
+ * @return the number of samples which were processed
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static size_t
+PcmAddOptimized(typename Traits::pointer_type,
+		typename Traits::const_pointer_type,
+		size_t) noexcept
+{
+	return 0;
+}
+
+#ifdef MIX_SIMD
+
+template<>
+size_t
+PcmAddOptimized<SampleFormat::S8>(int8_t *a, const int8_t *b,
+				  size_t n) noexcept
+{
+	MIX_SIMD(AddS8)(a, b, n);
+	return n - n % MIX_BLOCK_SIZE;
+}
+
+template<>
+size_t
+PcmAddOptimized<SampleFormat::S16>(int16_t *a, const int16_t *b,
+				   size_t n) noexcept
+{
+	MIX_SIMD(AddS16)(a, b, n);
+	return n - n % MIX_BLOCK_SIZE;
+}
+
+template<>
+size_t
+PcmAddOptimized<SampleFormat::S24_P32>(int32_t *a, const int32_t *b,
+				       size_t n) noexcept
+{
+	MIX_SIMD(AddS24)(a, b, n);
+	return n - n % MIX_BLOCK_SIZE;
+}
+
+template<>
+size_t
+PcmAddOptimized<SampleFormat::S32>(int32_t *a, const int32_t *b,
+				   size_t n) noexcept
+{
+	MIX_SIMD(AddS32)(a, b, n);
+	return n - n % MIX_BLOCK_SIZE;
+}
+
+#endif
+
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static void
 PcmAdd(typename Traits::pointer_type a,
        typename Traits::const_pointer_type b,
        size_t n) noexcept
 {
-	for (size_t i = 0; i != n; ++i)
+	for (size_t i = PcmAddOptimized<F, Traits>(a, b, n); i != n; ++i)
 		a[i] = PcmAdd<F, Traits>(a[i], b[i]);
 }
 
@@ -167,6 +236,14 @@ static void
 pcm_add_float(float *buffer1, const float *buffer2,
 	      unsigned num_samples) noexcept
 {
+#ifdef MIX_SIMD
+	MIX_SIMD(AddFloat)(buffer1, buffer2, num_samples);
+	const size_t done = num_samples - num_samples % MIX_BLOCK_SIZE;
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+#endif
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -211,23 +288,97 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 	gcc_unreachable();
 }
 
+/**
+ * Calculate the integer volume of the first buffer for cross-fading.
+ */
+gcc_const
+static int
+CrossFadeVolume(float portion1) noexcept
+{
+	float s = sin(M_PI_2 * portion1);
+	s *= s;
+
+	int vol1 = std::lround(s * PCM_VOLUME_1S);
+	return Clamp<int>(vol1, 0, PCM_VOLUME_1S);
+}
+
 bool
 pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format, float portion1) noexcept
 {
-	float s;
-
 	/* portion1 is between 0.0 and 1.0 for crossfading, MixRamp uses -1
 	 * to signal mixing rather than fading */
 	if (portion1 < 0)
 		return pcm_add(buffer1, buffer2, size, format);
 
-	s = sin(M_PI_2 * portion1);
-	s *= s;
-
-	int vol1 = std::lround(s * PCM_VOLUME_1S);
-	vol1 = Clamp<int>(vol1, 0, PCM_VOLUME_1S);
+	const int vol1 = CrossFadeVolume(portion1);
 
 	return pcm_add_vol(dither, buffer1, buffer2, size,
 			   vol1, PCM_VOLUME_1S - vol1, format);
 }
+
+ConstBuffer<void>
+pcm_mix_float(PcmBuffer &buffer1, PcmBuffer &buffer2, PcmDither &dither,
+	      ConstBuffer<void> src1, ConstBuffer<void> src2,
+	      SampleFormat format, float portion1) noexcept
+{
+	assert(src2.size <= src1.size);
+
+	switch (format) {
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+		break;
+
+	default:
+		/* no need for a float round trip (or no conversion
+		   back available): mix as usual */
+		{
+			void *dest = buffer1.Get(src1.size);
+			memcpy(dest, src1.data, src1.size);
+			if (!pcm_mix(dither, dest, src2.data, src2.size,
+				     format, portion1))
+				return nullptr;
+
+			return {dest, src1.size};
+		}
+	}
+
+	const auto f1 = pcm_convert_to_float(buffer1, format, src1);
+	const auto f2 = pcm_convert_to_float(buffer2, format, src2);
+
+	/* the result of pcm_convert_to_float() lives in our buffer
+	   and may be modified */
+	float *dest = const_cast<float *>(f1.data);
+
+	if (portion1 < 0)
+		pcm_add_float(dest, f2.data, f2.size);
+	else {
+		const int vol1 = CrossFadeVolume(portion1);
+		pcm_add_vol_float(dest, f2.data, f2.size,
+				  pcm_volume_to_float(vol1),
+				  pcm_volume_to_float(PCM_VOLUME_1S - vol1));
+	}
+
+	/* buffer2 is not needed anymore and receives the result;
+	   float to integer conversion clamps, but does not dither */
+	switch (format) {
+	case SampleFormat::S16:
+		return pcm_convert_to_16(buffer2, dither, SampleFormat::FLOAT,
+					 f1.ToVoid()).ToVoid();
+
+	case SampleFormat::S24_P32:
+		return pcm_convert_to_24(buffer2, SampleFormat::FLOAT,
+					 f1.ToVoid()).ToVoid();
+
+	case SampleFormat::S32:
+		return pcm_convert_to_32(buffer2, SampleFormat::FLOAT,
+					 f1.ToVoid()).ToVoid();
+
+	default:
+		break;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
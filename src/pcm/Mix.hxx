@@ -26,6 +26,8 @@
 #include <stddef.h>
 
 class PcmDither;
+class PcmBuffer;
+template<typename T> struct ConstBuffer;
 
 /*
  * Linearly mixes two PCM buffers.  Both must have the same length and
@@ -49,4 +51,28 @@ bool
 pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format, float portion1) noexcept;
 
+/**
+ * Like pcm_mix(), but mixes integer samples in the floating point
+ * domain: both buffers are converted to float, mixed and the result
+ * is converted back without dithering.  This is cheaper than
+ * pcm_mix() (the conversions are vectorized and there is no
+ * per-sample dither feedback), but S32 samples lose precision beyond
+ * 24 bits.  S8 and float samples are mixed with pcm_mix().
+ *
+ * @param buffer1 a buffer for the result
+ * @param buffer2 a scratch buffer
+ * @param src1 the first PCM buffer
+ * @param src2 the second PCM buffer; it may be shorter than the
+ * first one, and the rest of the first buffer is passed through
+ * @param format the sample format of both buffers
+ * @param portion1 see pcm_mix()
+ * @return the mixed PCM data (allocated in one of the given
+ * #PcmBuffer instances) or nullptr if the format is not supported
+ */
+gcc_warn_unused_result
+ConstBuffer<void>
+pcm_mix_float(PcmBuffer &buffer1, PcmBuffer &buffer2, PcmDither &dither,
+	      ConstBuffer<void> src1, ConstBuffer<void> src2,
+	      SampleFormat format, float portion1) noexcept;
+
 #endif
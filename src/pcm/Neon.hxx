@@ -91,4 +91,265 @@ struct NeonFloatTo16 {
 	}
 };
 
+/**
+ * Apply software volume to floating point samples using ARM NEON.
+ * Only full blocks of #BLOCK_SIZE samples are processed.
+ */
+struct NeonVolumeFloat {
+	static constexpr size_t BLOCK_SIZE = 4;
+
+	void Convert(float *dst, const float *src, size_t n,
+		     float volume) const noexcept {
+		for (size_t i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE)
+			vst1q_f32(dst, vmulq_n_f32(vld1q_f32(src), volume));
+	}
+};
+
+/**
+ * Apply software volume, converting S16 to S24_P32 using ARM NEON
+ * (see PcmVolumeConvert()).  Only full blocks of #BLOCK_SIZE samples
+ * are processed.
+ *
+ * @param SHIFT the number of bits to shift right after the
+ * multiplication
+ */
+template<unsigned SHIFT>
+struct NeonVolume16To24 {
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	void Convert(int32_t *dst, const int16_t *src, size_t n,
+		     int volume) const noexcept {
+		for (size_t i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			const int16x8_t x = vld1q_s16(src);
+			const int32x4_t lo = vmovl_s16(vget_low_s16(x));
+			const int32x4_t hi = vmovl_s16(vget_high_s16(x));
+
+			vst1q_s32(dst,
+				  vshrq_n_s32(vmulq_n_s32(lo, volume), SHIFT));
+			vst1q_s32(dst + 4,
+				  vshrq_n_s32(vmulq_n_s32(hi, volume), SHIFT));
+		}
+	}
+};
+
+/*
+ * Mixing kernels for ARM NEON (see Mix.cxx).  They process only full
+ * blocks of #NEON_MIX_BLOCK_SIZE samples.
+ */
+
+static constexpr size_t NEON_MIX_BLOCK_SIZE = 16;
+
+static inline void
+NeonAddS8(int8_t *a, const int8_t *b, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n / 16; ++i, a += 16, b += 16)
+		vst1q_s8(a, vqaddq_s8(vld1q_s8(a), vld1q_s8(b)));
+}
+
+static inline void
+NeonAddS16(int16_t *a, const int16_t *b, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n / 8; ++i, a += 8, b += 8)
+		vst1q_s16(a, vqaddq_s16(vld1q_s16(a), vld1q_s16(b)));
+}
+
+static inline void
+NeonAddS24(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	typedef SampleTraits<SampleFormat::S24_P32> Traits;
+	const int32x4_t min = vdupq_n_s32(Traits::MIN);
+	const int32x4_t max = vdupq_n_s32(Traits::MAX);
+
+	for (size_t i = 0; i < n / 4; ++i, a += 4, b += 4) {
+		const int32x4_t sum = vaddq_s32(vld1q_s32(a), vld1q_s32(b));
+		vst1q_s32(a, vmaxq_s32(vminq_s32(sum, max), min));
+	}
+}
+
+static inline void
+NeonAddS32(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n / 4; ++i, a += 4, b += 4)
+		vst1q_s32(a, vqaddq_s32(vld1q_s32(a), vld1q_s32(b)));
+}
+
+static inline void
+NeonAddFloat(float *a, const float *b, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n / 4; ++i, a += 4, b += 4)
+		vst1q_f32(a, vaddq_f32(vld1q_f32(a), vld1q_f32(b)));
+}
+
+static inline void
+NeonMixFloat(float *a, const float *b, size_t n,
+	     float volume1, float volume2) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n / 4; ++i, a += 4, b += 4)
+		vst1q_f32(a, vaddq_f32(vmulq_n_f32(vld1q_f32(a), volume1),
+				       vmulq_n_f32(vld1q_f32(b), volume2)));
+}
+
+/**
+ * Generate TPDF dither noise with 8 xorshift32 lanes (see
+ * PcmDither::FillTpdfNoise()); @a n must be a multiple of 8.
+ */
+static inline void
+NeonTpdfNoise(uint32_t lanes[8], int32_t *noise, size_t n,
+	      unsigned bits) noexcept
+{
+	const uint32x4_t mask = vdupq_n_u32((1u << bits) - 1);
+	uint32x4_t x[2] = { vld1q_u32(lanes), vld1q_u32(lanes + 4) };
+
+	for (size_t i = 0; i < n / 8; ++i, noise += 8) {
+		for (unsigned j = 0; j < 2; ++j) {
+			x[j] = veorq_u32(x[j], vshlq_n_u32(x[j], 13));
+			x[j] = veorq_u32(x[j], vshrq_n_u32(x[j], 17));
+			x[j] = veorq_u32(x[j], vshlq_n_u32(x[j], 5));
+
+			const int32x4_t a =
+				vreinterpretq_s32_u32(vandq_u32(x[j], mask));
+			const int32x4_t b =
+				vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(x[j], 16),
+								mask));
+			vst1q_s32(noise + 4 * j, vsubq_s32(a, b));
+		}
+	}
+
+	vst1q_u32(lanes, x[0]);
+	vst1q_u32(lanes + 4, x[1]);
+}
+
+/**
+ * Add noise and rounding to 32 bit samples, shift them right and
+ * clamp to 16 bit (see PortableTpdfShiftS16() in Dither.cxx).  Only
+ * full blocks of #NEON_MIX_BLOCK_SIZE samples are processed.
+ */
+static inline void
+NeonTpdfShiftS16(int16_t *dst, const int32_t *src, const int32_t *noise,
+		 size_t n, unsigned shift) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	const int32x4_t mask = vdupq_n_s32((1 << shift) - 1);
+	const int32x4_t round = vdupq_n_s32(1 << (shift - 1));
+	/* a negative count makes vshlq() shift right (arithmetic) */
+	const int32x4_t neg_shift = vdupq_n_s32(-int32_t(shift));
+
+	for (size_t i = 0; i < n / 8;
+	     ++i, src += 8, noise += 8, dst += 8) {
+		int16x4_t y[2];
+		for (unsigned j = 0; j < 2; ++j) {
+			const int32x4_t x = vld1q_s32(src + 4 * j);
+			const int32x4_t lo =
+				vaddq_s32(vaddq_s32(vandq_s32(x, mask), round),
+					  vld1q_s32(noise + 4 * j));
+			y[j] = vqmovn_s32(vaddq_s32(vshlq_s32(x, neg_shift),
+						    vshlq_s32(lo, neg_shift)));
+		}
+
+		vst1q_s16(dst, vcombine_s16(y[0], y[1]));
+	}
+}
+
+/**
+ * Interleave two channels of @a n frames each.  Only full blocks of
+ * #NEON_MIX_BLOCK_SIZE frames are processed.
+ */
+static inline void
+NeonInterleaveStereo8(uint8_t *dst, const uint8_t *src1,
+		      const uint8_t *src2, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n / 16; ++i, src1 += 16, src2 += 16, dst += 32) {
+		const uint8x16x2_t x{{vld1q_u8(src1), vld1q_u8(src2)}};
+		vst2q_u8(dst, x);
+	}
+}
+
+static inline void
+NeonInterleaveStereo16(int16_t *dst, const int16_t *src1,
+		       const int16_t *src2, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n / 8; ++i, src1 += 8, src2 += 8, dst += 16) {
+		const int16x8x2_t x{{vld1q_s16(src1), vld1q_s16(src2)}};
+		vst2q_s16(dst, x);
+	}
+}
+
+static inline void
+NeonInterleaveStereo32(int32_t *dst, const int32_t *src1,
+		       const int32_t *src2, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n / 4; ++i, src1 += 4, src2 += 4, dst += 8) {
+		const int32x4x2_t x{{vld1q_s32(src1), vld1q_s32(src2)}};
+		vst2q_s32(dst, x);
+	}
+}
+
+/**
+ * Split @a n stereo frames into two channels.  Only full blocks of
+ * #NEON_MIX_BLOCK_SIZE frames are processed.
+ */
+static inline void
+NeonDeinterleaveStereo32(int32_t *dst1, int32_t *dst2,
+			 const int32_t *src, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n / 4; ++i, src += 8, dst1 += 4, dst2 += 4) {
+		const int32x4x2_t x = vld2q_s32(src);
+		vst1q_s32(dst1, x.val[0]);
+		vst1q_s32(dst2, x.val[1]);
+	}
+}
+
+/**
+ * Reverse the bit order of @a n bytes.  Only full blocks of
+ * #NEON_MIX_BLOCK_SIZE bytes are processed.
+ */
+static inline void
+NeonBitReverse(uint8_t *dst, const uint8_t *src, size_t n) noexcept
+{
+	n -= n % NEON_MIX_BLOCK_SIZE;
+
+#ifndef __aarch64__
+	/* ARMv7 has no VRBIT for vectors; swap nibbles, pairs and
+	   bits with shifts */
+	const uint8x16_t m2 = vdupq_n_u8(0x33), m1 = vdupq_n_u8(0x55);
+#endif
+
+	for (size_t i = 0; i < n / 16; ++i, src += 16, dst += 16) {
+		uint8x16_t x = vld1q_u8(src);
+#ifdef __aarch64__
+		x = vrbitq_u8(x);
+#else
+		x = vorrq_u8(vshrq_n_u8(x, 4), vshlq_n_u8(x, 4));
+		x = vorrq_u8(vandq_u8(vshrq_n_u8(x, 2), m2),
+			     vshlq_n_u8(vandq_u8(x, m2), 2));
+		x = vorrq_u8(vandq_u8(vshrq_n_u8(x, 1), m1),
+			     vshlq_n_u8(vandq_u8(x, m1), 1));
+#endif
+		vst1q_u8(dst, x);
+	}
+}
+
 #endif
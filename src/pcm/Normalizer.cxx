@@ -0,0 +1,138 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Normalizer.hxx"
+#include "util/WritableBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+PcmNormalizer::PcmNormalizer(unsigned _history) noexcept
+	:peaks(new float[_history]), history(_history)
+{
+	assert(history > 0);
+
+	Reset();
+}
+
+void
+PcmNormalizer::Reset() noexcept
+{
+	std::fill_n(peaks.get(), history, 0.f);
+	position = 0;
+	gain = 1;
+}
+
+/**
+ * Determine the largest absolute sample value.  This compares the
+ * bit patterns as integers (which have the same order as
+ * non-negative floats), because a float max reduction cannot be
+ * vectorized without -ffast-math.
+ */
+gcc_pure
+static float
+FindPeak(const float *src, size_t n) noexcept
+{
+	uint32_t max_bits = 0;
+	for (size_t i = 0; i < n; ++i) {
+		uint32_t bits;
+		memcpy(&bits, &src[i], sizeof(bits));
+		max_bits = std::max(max_bits, bits & 0x7fffffffu);
+	}
+
+	/* treat NaN like infinity */
+	max_bits = std::min(max_bits, uint32_t(0x7f800000));
+
+	float peak;
+	memcpy(&peak, &max_bits, sizeof(peak));
+	return peak;
+}
+
+gcc_pure
+static size_t
+FindPeakPosition(const float *src, size_t n, float peak) noexcept
+{
+	for (size_t i = 0; i < n; ++i)
+		if (src[i] >= peak || -src[i] >= peak)
+			return i;
+
+	return n;
+}
+
+static inline float
+Amplify(float sample, float gain) noexcept
+{
+	return std::clamp(sample * gain, -1.f, 1.f);
+}
+
+void
+PcmNormalizer::Process(WritableBuffer<float> buffer) noexcept
+{
+	float *const data = buffer.data;
+	const size_t n = buffer.size;
+	if (n == 0)
+		return;
+
+	const float chunk_peak = FindPeak(data, n);
+
+	position = (position + 1) % history;
+	peaks[position] = chunk_peak;
+
+	const float peak =
+		std::max(*std::max_element(peaks.get(), peaks.get() + history),
+			 1.f / 32768);
+
+	/* the target gain, with inertia from the previous one */
+	float new_gain = TARGET / peak;
+	new_gain = (gain * ((1u << SMOOTH) - 1) + new_gain) / (1u << SMOOTH);
+	new_gain = std::clamp(new_gain, 1.f, MAX_GAIN);
+
+	/* ramp from the old gain to the new one over the whole
+	   buffer */
+	size_t ramp = n;
+
+	if (peak * new_gain > 1.f) {
+		/* don't clip, and reach the reduced gain before this
+		   chunk's peak */
+		new_gain = 1.f / peak;
+		ramp = peak == chunk_peak
+			? FindPeakPosition(data, n, peak)
+			: 0;
+	}
+
+	if (ramp == 0)
+		ramp = 1;
+
+	const float delta = (new_gain - gain) / ramp;
+
+	float current = gain;
+	for (size_t i = 0; i < ramp; ++i) {
+		data[i] = Amplify(data[i], current);
+		current += delta;
+	}
+
+	for (size_t i = ramp; i < n; ++i)
+		data[i] = Amplify(data[i], new_gain);
+
+	gain = new_gain;
+}
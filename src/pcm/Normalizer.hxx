@@ -0,0 +1,84 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_NORMALIZER_HXX
+#define MPD_PCM_NORMALIZER_HXX
+
+#include <memory>
+
+#include <stddef.h>
+
+template<typename T> struct WritableBuffer;
+
+/**
+ * A dynamic range normalizer for floating point samples.  It uses the
+ * algorithm of AudioCompress (src/AudioCompress/compress.c): the
+ * gain is chosen to bring the loudest peak of the last #history
+ * calls to the target level, with inertia, limited to a maximum
+ * amplification and to a value which does not clip.
+ *
+ * Unlike AudioCompress, it works on floating point samples, so
+ * high-resolution audio does not need to be converted to 16 bit.
+ */
+class PcmNormalizer {
+	/**
+	 * The target peak level.
+	 */
+	static constexpr float TARGET = 0.5f;
+
+	/**
+	 * The maximum amplification.
+	 */
+	static constexpr float MAX_GAIN = 32;
+
+	/**
+	 * The inertia of the gain: each call moves it by
+	 * 1/2^SMOOTH towards the desired value.
+	 */
+	static constexpr unsigned SMOOTH = 8;
+
+	/**
+	 * The peak of each of the last #history calls.
+	 */
+	const std::unique_ptr<float[]> peaks;
+
+	const unsigned history;
+
+	unsigned position = 0;
+
+	/**
+	 * The gain which was applied to the last sample.
+	 */
+	float gain = 1;
+
+public:
+	static constexpr unsigned DEFAULT_HISTORY = 400;
+
+	explicit PcmNormalizer(unsigned _history=DEFAULT_HISTORY) noexcept;
+
+	void Reset() noexcept;
+
+	/**
+	 * Apply the gain to the given (interleaved) samples in
+	 * place.
+	 */
+	void Process(WritableBuffer<float> buffer) noexcept;
+};
+
+#endif
@@ -33,4 +33,30 @@ ConstBuffer<void>
 ToAlsaChannelOrder(PcmBuffer &buffer, ConstBuffer<void> src,
 		   SampleFormat sample_format, unsigned channels) noexcept;
 
+/**
+ * Which source channel does ToAlsaChannelOrder() copy to the given
+ * destination channel?  This does not check whether the sample
+ * format is affected.
+ */
+constexpr unsigned
+ToAlsaChannelOrderSource(unsigned channels, unsigned channel) noexcept
+{
+	if (channels != 6 && channels != 8)
+		return channel;
+
+	/* swap center+LFE with surround left+right */
+	switch (channel) {
+	case 2:
+	case 3:
+		return channel + 2;
+
+	case 4:
+	case 5:
+		return channel - 2;
+
+	default:
+		return channel;
+	}
+}
+
 #endif
@@ -18,55 +18,364 @@
  */
 
 #include "PcmDsd.hxx"
-#include "dsd2pcm/dsd2pcm.h"
+#include "FloatConvert.hxx"
+#include "BitReverse.hxx"
+#include "config/Data.hxx"
+#include "config/Option.hxx"
+#include "util/bit_reverse.h"
 #include "util/ConstBuffer.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/StringAPI.hxx"
+
+#ifdef __SSE2__
+#include "X86Convert.hxx"
+#endif
+
+#include <algorithm>
+#include <cmath>
 
 #include <assert.h>
+#include <string.h>
+
+/**
+ * The second half (48 coefficients) of the symmetric 96-tap lowpass
+ * filter from dsd2pcm.c (Copyright 2009, 2011 Sebastian Gesemann),
+ * beginning at the center.
+ */
+static constexpr double dsd2pcm_htaps[] = {
+	0.09950731974056658,
+	0.09562845727714668,
+	0.08819647126516944,
+	0.07782552527068175,
+	0.06534876523171299,
+	0.05172629311427257,
+	0.0379429484910187,
+	0.02490921351762261,
+	0.0133774746265897,
+	0.003883043418804416,
+	-0.003284703416210726,
+	-0.008080250212687497,
+	-0.01067241812471033,
+	-0.01139427235000863,
+	-0.0106813877974587,
+	-0.009007905078766049,
+	-0.006828859761015335,
+	-0.004535184322001496,
+	-0.002425035959059578,
+	-0.0006922187080790708,
+	0.0005700762133516592,
+	0.001353838005269448,
+	0.001713709169690937,
+	0.001742046839472948,
+	0.001545601648013235,
+	0.001226696225277855,
+	0.0008704322683580222,
+	0.0005381636200535649,
+	0.000266446345425276,
+	7.002968738383528e-05,
+	-5.279407053811266e-05,
+	-0.0001140625650874684,
+	-0.0001304796361231895,
+	-0.0001189970287491285,
+	-9.396247155265073e-05,
+	-6.577634378272832e-05,
+	-4.07492895872535e-05,
+	-2.17407957554587e-05,
+	-9.163058931391722e-06,
+	-2.017460145032201e-06,
+	1.249721855219005e-06,
+	2.166655190537392e-06,
+	1.930520892991082e-06,
+	1.319400334374195e-06,
+	7.410039764949091e-07,
+	3.423230509967409e-07,
+	1.244182214744588e-07,
+	3.130441005359396e-08,
+};
+
+/**
+ * The gather loads of the SIMD kernel may read a few bytes beyond
+ * the end of each row.
+ */
+static constexpr size_t ROW_PADDING = 4;
+
+/**
+ * The pattern which the dsd2pcm library used to initialize its
+ * FIFO: a low energy 352.8 kHz tone and a high energy 1.0584 MHz
+ * tone which are filtered out completely.
+ */
+static constexpr uint8_t DSD_SILENCE = 0x69;
+
+/**
+ * The zeroth order modified Bessel function of the first kind, for
+ * the Kaiser window.
+ */
+gcc_const
+static double
+BesselI0(double x) noexcept
+{
+	double sum = 1, term = 1;
+	for (unsigned k = 1; k < 50; ++k) {
+		const double f = x / (2 * k);
+		term *= f * f;
+		sum += term;
+		if (term < sum * 1e-17)
+			break;
+	}
+
+	return sum;
+}
+
+/**
+ * Design the second half of a symmetric Kaiser-windowed sinc lowpass
+ * filter with DC gain 1.
+ *
+ * @param htaps the destination; the first element is next to the
+ * center
+ * @param n the number of coefficients in @a htaps (half the filter
+ * length)
+ * @param cutoff the cutoff frequency relative to the DSD bit rate
+ * @param beta the Kaiser window parameter
+ */
+static void
+DesignKaiserHalf(double *htaps, size_t n, double cutoff, double beta) noexcept
+{
+	const double i0_beta = BesselI0(beta);
+	double sum = 0;
+
+	for (size_t j = 0; j < n; ++j) {
+		/* distance from the center of the (even-length)
+		   filter */
+		const double x = j + 0.5;
+		const double arg = 2 * M_PI * cutoff * x;
+		const double r = x / n;
+		const double w = BesselI0(beta * std::sqrt(1 - r * r)) / i0_beta;
 
-PcmDsd::PcmDsd() noexcept
+		htaps[j] = std::sin(arg) / (M_PI * x) * w;
+		sum += 2 * htaps[j];
+	}
+
+	for (size_t j = 0; j < n; ++j)
+		htaps[j] /= sum;
+}
+
+unsigned
+PcmDsd::ChooseDecimation(unsigned dsd_rate, unsigned pcm_rate) noexcept
 {
-	dsd2pcm.fill(nullptr);
+	unsigned decimation = MIN_DECIMATION;
+	while (decimation < MAX_DECIMATION &&
+	       dsd_rate / (decimation / 4) >= pcm_rate)
+		decimation *= 2;
+
+	return decimation;
 }
 
-PcmDsd::~PcmDsd() noexcept
+void
+PcmDsd::Open(unsigned _channels, unsigned decimation,
+	     DsdFilter filter) noexcept
 {
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_destroy(i);
+	assert(_channels > 0);
+	assert(_channels <= MAX_CHANNELS);
+	assert(decimation == 8 || decimation == 16 || decimation == 32);
+
+	channels = _channels;
+	stride = decimation / 8;
+
+	/* the number of coefficients in one filter half */
+	const size_t n_htaps = filter == DsdFilter::SHARP
+		? 128 * stride
+		: 48 * stride;
+	assert(n_htaps % 8 == 0);
+
+	double htaps[MAX_TABLES * 8];
+	assert(n_htaps <= MAX_TABLES * 8);
+
+	if (filter == DsdFilter::FAST && stride == 1)
+		std::copy_n(dsd2pcm_htaps, n_htaps, htaps);
+	else if (filter == DsdFilter::FAST)
+		/* -6 dB at the output's Nyquist frequency, 100 dB
+		   attenuation from 0.77 of the output sample rate,
+		   i.e. nothing aliases into the audible range */
+		DesignKaiserHalf(htaps, n_htaps, 0.5 / decimation, 10.06);
+	else
+		/* 120 dB attenuation from the output's Nyquist
+		   frequency, flat up to 0.25 of the output sample
+		   rate */
+		DesignKaiserHalf(htaps, n_htaps, 0.378 / decimation, 12.27);
+
+	/* like precalc() in dsd2pcm.c: table i looks up the 8
+	   outermost-but-i taps; the most significant bit is the
+	   oldest one */
+	n_tables = n_htaps / 8;
+	tables.ResizeDiscard(n_tables * 256);
+
+	for (unsigned t = 0; t < n_tables; ++t) {
+		float *table = &tables[(n_tables - 1 - t) * 256];
+
+		for (unsigned e = 0; e < 256; ++e) {
+			double acc = 0;
+			for (unsigned m = 0; m < 8; ++m) {
+				/* each bit is either +1 or -1 */
+				const double tap = htaps[t * 8 + m];
+				acc += (e >> (7 - m)) & 1 ? tap : -tap;
+			}
+			table[e] = float(acc);
+		}
+	}
+
+	Reset();
 }
 
 void
 PcmDsd::Reset() noexcept
 {
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_reset(i);
+	memset(history, DSD_SILENCE, sizeof(history));
+	memset(reversed_history, bit_reverse(DSD_SILENCE),
+	       sizeof(reversed_history));
+
+	/* the first output sample is generated after "stride" input
+	   bytes */
+	pending = 0;
 }
 
-ConstBuffer<float>
-PcmDsd::ToFloat(unsigned channels, ConstBuffer<uint8_t> src) noexcept
+/**
+ * Evaluate the filter for @a n output samples of one channel.
+ *
+ * @param fwd the newest byte for the first output sample; the
+ * previous 2*n_tables-1 bytes must be valid
+ * @param rev the bit-reversed byte stream at the same position
+ */
+static void
+PortableFilterDsd(float *dest, const float *tables, unsigned n_tables,
+		  const uint8_t *fwd, const uint8_t *rev, unsigned stride,
+		  size_t n) noexcept
+{
+	/* the second filter half begins with the oldest byte */
+	rev -= 2 * n_tables - 1;
+
+	for (size_t i = 0; i < n; ++i, fwd += stride, rev += stride) {
+		/* two accumulators shorten the dependency chain */
+		float a = 0, b = 0;
+		for (unsigned t = 0; t < n_tables; ++t) {
+			const float *table = tables + t * 256;
+			a += table[fwd[-ptrdiff_t(t)]];
+			b += table[rev[t]];
+		}
+
+		*dest++ = a + b;
+	}
+}
+
+size_t
+PcmDsd::Filter(ConstBuffer<uint8_t> src, float *dest) noexcept
 {
-	assert(!src.IsNull());
-	assert(!src.empty());
+	assert(IsOpen());
 	assert(src.size % channels == 0);
-	assert(channels <= dsd2pcm.max_size());
 
-	const unsigned num_samples = src.size;
-	const unsigned num_frames = src.size / channels;
+	const size_t n = src.size / channels;
+	const size_t n_history = 2 * n_tables - 1;
+	const size_t row_size = n_history + n + ROW_PADDING;
 
-	float *dest = buffer.GetT<float>(num_samples);
+	/* which of the new bytes completes the first output
+	   sample? */
+	const size_t first = stride - 1 - pending;
+	const size_t n_out = n > first ? (n - first - 1) / stride + 1 : 0;
+	pending = (pending + n) % stride;
+
+	/* deinterleave into one row per channel, which begins with
+	   the history from the last call */
+	uint8_t *work = work_buffer.GetT<uint8_t>(2 * channels * row_size);
 
 	for (unsigned c = 0; c < channels; ++c) {
-		if (dsd2pcm[c] == nullptr) {
-			dsd2pcm[c] = dsd2pcm_init();
-			if (dsd2pcm[c] == nullptr)
-				return nullptr;
-		}
+		uint8_t *fwd = work + 2 * c * row_size;
+		uint8_t *rev = fwd + row_size;
+
+		memcpy(fwd, history[c], n_history);
+		memcpy(rev, reversed_history[c], n_history);
+
+		const uint8_t *s = src.data + c;
+		for (size_t i = 0; i < n; ++i, s += channels)
+			fwd[n_history + i] = *s;
+
+		PcmBitReverse(rev + n_history, fwd + n_history, n);
+
+		memset(fwd + n_history + n, 0, ROW_PADDING);
+		memset(rev + n_history + n, 0, ROW_PADDING);
+
+		memcpy(history[c], fwd + n, n_history);
+		memcpy(reversed_history[c], rev + n, n_history);
+
+		/* filter into one contiguous block per channel */
+		float *d = dest + c * n_out;
+		const size_t offset = n_history + first;
+		size_t done = 0;
+
+#ifdef __SSE2__
+		done = X86Convert::FilterDsd(d, &tables.front(), n_tables,
+					     fwd + offset, rev + offset,
+					     stride, n_out);
+#endif
+
+		PortableFilterDsd(d + done, &tables.front(), n_tables,
+				  fwd + offset + done * stride,
+				  rev + offset + done * stride,
+				  stride, n_out - done);
+	}
 
-		dsd2pcm_translate(dsd2pcm[c], num_frames,
-				  src.data + c, channels,
-				  false, dest + c, channels);
+	return n_out;
+}
+
+ConstBuffer<float>
+PcmDsd::ToFloat(ConstBuffer<uint8_t> src) noexcept
+{
+	const size_t max_out = src.size / channels / stride + 1;
+	float *blocks = work_float_buffer.GetT<float>(max_out * channels);
+	const size_t n_frames = Filter(src, blocks);
+	const size_t n_samples = n_frames * channels;
+
+	float *dest = buffer.GetT<float>(n_samples);
+	for (unsigned c = 0; c < channels; ++c) {
+		const float *s = blocks + c * n_frames;
+		float *d = dest + c;
+		for (size_t i = 0; i < n_frames; ++i, d += channels)
+			*d = s[i];
 	}
 
-	return { dest, num_samples };
+	return { dest, n_samples };
+}
+
+ConstBuffer<int32_t>
+PcmDsd::ToS24(ConstBuffer<uint8_t> src) noexcept
+{
+	using Convert = FloatToIntegerSampleConvert<SampleFormat::S24_P32>;
+
+	const size_t max_out = src.size / channels / stride + 1;
+	float *blocks = work_float_buffer.GetT<float>(max_out * channels);
+	const size_t n_frames = Filter(src, blocks);
+	const size_t n_samples = n_frames * channels;
+
+	int32_t *dest = buffer.GetT<int32_t>(n_samples);
+	for (unsigned c = 0; c < channels; ++c) {
+		const float *s = blocks + c * n_frames;
+		int32_t *d = dest + c;
+		for (size_t i = 0; i < n_frames; ++i, d += channels)
+			*d = Convert::Convert(s[i]);
+	}
+
+	return { dest, n_samples };
+}
+
+void
+pcm_dsd_global_init(const ConfigData &config)
+{
+	const char *filter = config.GetString(ConfigOption::DSD_FILTER,
+					      "fast");
+
+	if (StringIsEqual(filter, "fast"))
+		PcmDsd::SetDefaultFilter(DsdFilter::FAST);
+	else if (StringIsEqual(filter, "sharp"))
+		PcmDsd::SetDefaultFilter(DsdFilter::SHARP);
+	else
+		throw FormatRuntimeError("Invalid \"dsd_filter\" setting: %s",
+					 filter);
 }
@@ -22,29 +22,163 @@
 
 #include "Buffer.hxx"
 #include "ChannelDefs.hxx"
+#include "SampleFormat.hxx"
+#include "util/AllocatedArray.hxx"
 
-#include <array>
-
+#include <stddef.h>
 #include <stdint.h>
 
+struct ConfigData;
 template<typename T> struct ConstBuffer;
 
 /**
- * Wrapper for the dsd2pcm library.
+ * The lowpass filter used by #PcmDsd.
+ */
+enum class DsdFilter : uint8_t {
+	/**
+	 * A short filter: 96 taps per 8 bits of decimation.  At 1:8,
+	 * this is the original dsd2pcm filter (flat up to 48 kHz at
+	 * DSD64, alias-free up to 70 kHz).  At 1:16 and 1:32, it is a
+	 * Kaiser-windowed sinc which is alias-free in the audible
+	 * range.
+	 */
+	FAST,
+
+	/**
+	 * A Kaiser-windowed sinc with 256 taps per 8 bits of
+	 * decimation and 120 dB stopband attenuation beginning at the
+	 * output's Nyquist frequency.  This costs about 2.5 times as much
+	 * CPU as #FAST.
+	 */
+	SHARP,
+};
+
+/**
+ * Convert DSD to PCM: a multi-channel FIR lowpass filter with
+ * decimation by 8, 16 or 32.  Like the dsd2pcm library, it looks up
+ * the contribution of 8 DSD bits at a time in a table and uses the
+ * filter's symmetry to halve the table size.  All channels are
+ * converted in one pass over the interleaved input, and the filter
+ * is evaluated only where an output sample is needed.
  */
 class PcmDsd {
-	PcmBuffer buffer;
+	/**
+	 * The maximum number of lookup tables per filter half (see
+	 * #n_tables).
+	 */
+	static constexpr size_t MAX_TABLES = 64;
+
+	/**
+	 * The maximum number of bytes per channel which need to be
+	 * remembered from the previous Convert() call.
+	 */
+	static constexpr size_t MAX_HISTORY = 2 * MAX_TABLES - 1;
+
+	PcmBuffer buffer, work_buffer, work_float_buffer;
+
+	static inline DsdFilter default_filter = DsdFilter::FAST;
+
+	/**
+	 * One lookup table (256 floats) for each 8 taps of one half
+	 * of the filter.
+	 */
+	AllocatedArray<float> tables;
+
+	unsigned channels = 0;
+
+	/**
+	 * The number of input bytes per channel per output sample
+	 * (1, 2 or 4).
+	 */
+	unsigned stride;
+
+	/**
+	 * The number of tables per filter half; the filter spans
+	 * 2*n_tables bytes.
+	 */
+	unsigned n_tables;
 
-	std::array<struct dsd2pcm_ctx_s *, MAX_CHANNELS> dsd2pcm;
+	/**
+	 * The number of input bytes (per channel) since the last
+	 * output sample.
+	 */
+	unsigned pending;
+
+	/**
+	 * The last bytes of each channel from the previous Convert()
+	 * call, both as-is and bit-reversed (for the second half of
+	 * the filter).
+	 */
+	uint8_t history[MAX_CHANNELS][MAX_HISTORY];
+	uint8_t reversed_history[MAX_CHANNELS][MAX_HISTORY];
 
 public:
-	PcmDsd() noexcept;
-	~PcmDsd() noexcept;
+	/**
+	 * The supported decimation factors, which map DSD bits to PCM
+	 * samples.
+	 */
+	static constexpr unsigned MIN_DECIMATION = 8, MAX_DECIMATION = 32;
+
+	/**
+	 * Choose the largest decimation factor whose output sample
+	 * rate is not below the given one.
+	 *
+	 * @param dsd_rate the DSD sample rate in bytes per second
+	 * (i.e. AudioFormat::sample_rate)
+	 */
+	gcc_const
+	static unsigned ChooseDecimation(unsigned dsd_rate,
+					 unsigned pcm_rate) noexcept;
+
+	static DsdFilter GetDefaultFilter() noexcept {
+		return default_filter;
+	}
+
+	static void SetDefaultFilter(DsdFilter filter) noexcept {
+		default_filter = filter;
+	}
+
+	/**
+	 * Prepare the converter.  This function may be called multiple
+	 * times to reuse the object.
+	 *
+	 * @param decimation 8, 16 or 32
+	 */
+	void Open(unsigned _channels, unsigned decimation,
+		  DsdFilter filter) noexcept;
+
+	bool IsOpen() const noexcept {
+		return channels > 0;
+	}
+
+	/**
+	 * The factor by which the output sample rate (in frames) is
+	 * lower than the DSD byte rate.
+	 */
+	unsigned GetStride() const noexcept {
+		return stride;
+	}
 
 	void Reset() noexcept;
 
-	ConstBuffer<float> ToFloat(unsigned channels,
-				   ConstBuffer<uint8_t> src) noexcept;
+	ConstBuffer<float> ToFloat(ConstBuffer<uint8_t> src) noexcept;
+
+	ConstBuffer<int32_t> ToS24(ConstBuffer<uint8_t> src) noexcept;
+
+private:
+	/**
+	 * Filter the input, writing one contiguous block of output
+	 * samples per channel to @a dest.
+	 *
+	 * @return the number of output frames
+	 */
+	size_t Filter(ConstBuffer<uint8_t> src, float *dest) noexcept;
 };
 
+/**
+ * Apply the "dsd_filter" setting.  Throws on error.
+ */
+void
+pcm_dsd_global_init(const ConfigData &config);
+
 #endif
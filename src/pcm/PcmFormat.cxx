@@ -43,10 +43,51 @@ struct PerSampleConvert : C {
 	}
 };
 
-struct Convert8To16
+/**
+ * A template class that attempts to use the "optimized" algorithm for
+ * large portions of the buffer, and calls the "portable" algorithm"
+ * for the rest when the last block is not full.
+ */
+template<typename Optimized, typename Portable>
+class GlueOptimizedConvert : Optimized, Portable {
+public:
+	typedef typename Portable::SrcTraits SrcTraits;
+	typedef typename Portable::DstTraits DstTraits;
+
+	void Convert(typename DstTraits::pointer_type out,
+		     typename SrcTraits::const_pointer_type in,
+		     size_t n) const {
+		Optimized::Convert(out, in, n);
+
+		/* use the "portable" algorithm for the trailing
+		   samples */
+		size_t remaining = n % Optimized::BLOCK_SIZE;
+		size_t done = n - remaining;
+		Portable::Convert(out + done, in + done, remaining);
+	}
+};
+
+#ifdef __SSE2__
+#include "X86Convert.hxx"
+
+/**
+ * Use an #X86Convert function for whole blocks and the portable
+ * implementation for the rest.
+ */
+#define X86_OPTIMIZED(portable, func) \
+	GlueOptimizedConvert<X86ConvertWrapper<portable, X86Convert::func>, \
+			     portable>
+#else
+#define X86_OPTIMIZED(portable, func) portable
+#endif
+
+struct PortableConvert8To16
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S16>> {};
 
+struct Convert8To16
+	: X86_OPTIMIZED(PortableConvert8To16, S8ToS16) {};
+
 struct Convert24To16 {
 	typedef SampleTraits<SampleFormat::S24_P32> SrcTraits;
 	typedef SampleTraits<SampleFormat::S16> DstTraits;
@@ -80,30 +121,6 @@ struct PortableFloatToInteger
 template<SampleFormat F, class Traits=SampleTraits<F>>
 struct FloatToInteger : PortableFloatToInteger<F, Traits> {};
 
-/**
- * A template class that attempts to use the "optimized" algorithm for
- * large portions of the buffer, and calls the "portable" algorithm"
- * for the rest when the last block is not full.
- */
-template<typename Optimized, typename Portable>
-class GlueOptimizedConvert : Optimized, Portable {
-public:
-	typedef typename Portable::SrcTraits SrcTraits;
-	typedef typename Portable::DstTraits DstTraits;
-
-	void Convert(typename DstTraits::pointer_type out,
-		     typename SrcTraits::const_pointer_type in,
-		     size_t n) const {
-		Optimized::Convert(out, in, n);
-
-		/* use the "portable" algorithm for the trailing
-		   samples */
-		size_t remaining = n % Optimized::BLOCK_SIZE;
-		size_t done = n - remaining;
-		Portable::Convert(out + done, in + done, remaining);
-	}
-};
-
 #ifdef __ARM_NEON__
 #include "Neon.hxx"
 
@@ -114,6 +131,26 @@ struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
 
 #endif
 
+#ifdef __SSE2__
+
+template<>
+struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
+	: X86_OPTIMIZED(PortableFloatToInteger<SampleFormat::S16>,
+			FloatToS16) {};
+
+template<>
+struct FloatToInteger<SampleFormat::S24_P32,
+		      SampleTraits<SampleFormat::S24_P32>>
+	: X86_OPTIMIZED(PortableFloatToInteger<SampleFormat::S24_P32>,
+			FloatToS24) {};
+
+template<>
+struct FloatToInteger<SampleFormat::S32, SampleTraits<SampleFormat::S32>>
+	: X86_OPTIMIZED(PortableFloatToInteger<SampleFormat::S32>,
+			FloatToS32) {};
+
+#endif
+
 template<class C>
 static ConstBuffer<typename C::DstTraits::value_type>
 AllocateConvert(PcmBuffer &buffer, C convert,
@@ -189,14 +226,20 @@ pcm_convert_to_16(PcmBuffer &buffer, PcmDither &dither,
 	return nullptr;
 }
 
-struct Convert8To24
+struct PortableConvert8To24
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S24_P32>> {};
 
-struct Convert16To24
+struct Convert8To24
+	: X86_OPTIMIZED(PortableConvert8To24, S8ToS24) {};
+
+struct PortableConvert16To24
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
 						  SampleFormat::S24_P32>> {};
 
+struct Convert16To24
+	: X86_OPTIMIZED(PortableConvert16To24, S16ToS24) {};
+
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_24(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
@@ -209,10 +252,13 @@ pcm_allocate_16_to_24(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 	return AllocateConvert(buffer, Convert16To24(), src);
 }
 
-struct Convert32To24
+struct PortableConvert32To24
 	: PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
 						   SampleFormat::S24_P32>> {};
 
+struct Convert32To24
+	: X86_OPTIMIZED(PortableConvert32To24, S32ToS24) {};
+
 static ConstBuffer<int32_t>
 pcm_allocate_32_to_24(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
@@ -257,18 +303,27 @@ pcm_convert_to_24(PcmBuffer &buffer,
 	return nullptr;
 }
 
-struct Convert8To32
+struct PortableConvert8To32
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S32>> {};
 
-struct Convert16To32
+struct Convert8To32
+	: X86_OPTIMIZED(PortableConvert8To32, S8ToS32) {};
+
+struct PortableConvert16To32
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
 						  SampleFormat::S32>> {};
 
-struct Convert24To32
+struct Convert16To32
+	: X86_OPTIMIZED(PortableConvert16To32, S16ToS32) {};
+
+struct PortableConvert24To32
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
 						  SampleFormat::S32>> {};
 
+struct Convert24To32
+	: X86_OPTIMIZED(PortableConvert24To32, S24ToS32) {};
+
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_32(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
@@ -325,18 +380,30 @@ pcm_convert_to_32(PcmBuffer &buffer,
 	return nullptr;
 }
 
-struct Convert8ToFloat
+struct PortableConvert8ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S8>> {};
 
-struct Convert16ToFloat
+struct Convert8ToFloat
+	: X86_OPTIMIZED(PortableConvert8ToFloat, S8ToFloat) {};
+
+struct PortableConvert16ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>> {};
 
-struct Convert24ToFloat
+struct Convert16ToFloat
+	: X86_OPTIMIZED(PortableConvert16ToFloat, S16ToFloat) {};
+
+struct PortableConvert24ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>> {};
 
-struct Convert32ToFloat
+struct Convert24ToFloat
+	: X86_OPTIMIZED(PortableConvert24ToFloat, S24ToFloat) {};
+
+struct PortableConvert32ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>> {};
 
+struct Convert32ToFloat
+	: X86_OPTIMIZED(PortableConvert32ToFloat, S32ToFloat) {};
+
 static ConstBuffer<float>
 pcm_allocate_8_to_float(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
@@ -20,6 +20,8 @@
 #ifndef MPD_PCM_PRNG_HXX
 #define MPD_PCM_PRNG_HXX
 
+#include <stddef.h>
+
 /**
  * A very simple linear congruential PRNG.  It's good enough for PCM
  * dithering.
@@ -30,4 +32,27 @@ pcm_prng(unsigned long state) noexcept
 	return (state * 0x0019660dL + 0x3c6ef35fL) & 0xffffffffL;
 }
 
+/**
+ * Advance the PRNG by the given number of steps, i.e. the same as
+ * calling pcm_prng() @a n times, but in O(log n).
+ */
+constexpr static inline unsigned long
+pcm_prng_skip(unsigned long state, size_t n) noexcept
+{
+	unsigned long a = 0x0019660dL, c = 0x3c6ef35fL;
+	unsigned long total_a = 1, total_c = 0;
+
+	for (; n > 0; n >>= 1) {
+		if (n & 1) {
+			total_a = (total_a * a) & 0xffffffffL;
+			total_c = (total_c * a + c) & 0xffffffffL;
+		}
+
+		c = ((a + 1) * c) & 0xffffffffL;
+		a = (a * a) & 0xffffffffL;
+	}
+
+	return (state * total_a + total_c) & 0xffffffffL;
+}
+
 #endif
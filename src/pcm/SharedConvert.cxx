@@ -0,0 +1,312 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SharedConvert.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+bool
+PcmConvertCache::Entry::Matches(ConstBuffer<void> _src,
+				bool _flush) const noexcept
+{
+	return flush == _flush && src.size() == _src.size &&
+		(_src.size == 0 || memcmp(src.data(), _src.data, _src.size) == 0);
+}
+
+ConstBuffer<void>
+PcmConvertCache::Entry::GetResult() const noexcept
+{
+	if (dest.empty())
+		/* Flush() returns nullptr at the end */
+		return flush ? nullptr : ConstBuffer<void>(dest.data(), 0);
+
+	return {dest.data(), dest.size()};
+}
+
+PcmConvertCache::PcmConvertCache() noexcept = default;
+
+PcmConvertCache::~PcmConvertCache() noexcept
+{
+	assert(std::all_of(streams.begin(), streams.end(),
+			   [](const Stream &stream){
+				   return stream.members.empty();
+			   }));
+}
+
+PcmConvertCache::Stream &
+PcmConvertCache::MakeStream(AudioFormat src_format, AudioFormat dest_format,
+			    const PcmResamplerSetup *resampler)
+{
+	for (auto &stream : streams) {
+		if (stream.members.empty() &&
+		    stream.HasFormat(src_format, dest_format, resampler)) {
+			/* reuse an idle stream; this is cheaper than
+			   creating a new resampler */
+			stream.convert.Reset();
+			return stream;
+		}
+	}
+
+	return streams.emplace_back(src_format, dest_format, resampler);
+}
+
+void
+PcmConvertCache::Recycle(std::shared_ptr<Entry> &&entry) noexcept
+{
+	/* entries which are still referenced by a member's
+	   "current" pointer cannot be reused */
+	if (entry.use_count() == 1 && spare.size() < MAX_ENTRIES)
+		spare.emplace_back(std::move(entry));
+	else
+		entry.reset();
+}
+
+void
+PcmConvertCache::Attach(Stream &stream, SharedPcmConvert &member,
+			uint_least64_t position) noexcept
+{
+	assert(member.stream == nullptr);
+
+	stream.members.push_back(&member);
+	member.stream = &stream;
+	member.position = position;
+}
+
+void
+PcmConvertCache::Detach(SharedPcmConvert &member) noexcept
+{
+	auto *stream = std::exchange(member.stream, nullptr);
+	if (stream == nullptr)
+		return;
+
+	auto &members = stream->members;
+	members.erase(std::find(members.begin(), members.end(), &member));
+
+	if (members.empty()) {
+		/* keep the idle stream for MakeStream(), but drop its
+		   stale entries */
+		while (!stream->log.empty()) {
+			Recycle(std::move(stream->log.front()));
+			stream->log.pop_front();
+			++stream->begin;
+		}
+	} else
+		Prune(*stream);
+}
+
+void
+PcmConvertCache::Prune(Stream &stream) noexcept
+{
+	const uint_least64_t end = stream.GetEnd();
+
+	uint_least64_t needed = end > HISTORY ? end - HISTORY : 0;
+	for (const auto *member : stream.members)
+		needed = std::min(needed, member->position);
+
+	if (end - needed > MAX_ENTRIES) {
+		/* a member lags behind too much; it loses this
+		   stream (its "current" entry stays alive) and will
+		   look for a new one with its next call */
+		needed = end - MAX_ENTRIES;
+
+		for (auto i = stream.members.begin(); i != stream.members.end();) {
+			auto &member = **i;
+			if (member.position < needed) {
+				member.stream = nullptr;
+				i = stream.members.erase(i);
+			} else
+				++i;
+		}
+	}
+
+	while (stream.begin < needed) {
+		Recycle(std::move(stream.log.front()));
+		stream.log.pop_front();
+		++stream.begin;
+	}
+}
+
+void
+PcmConvertCache::RemoveIdleStreams() noexcept
+{
+	streams.remove_if([](const Stream &stream){
+		return stream.members.empty();
+	});
+}
+
+ConstBuffer<void>
+PcmConvertCache::Append(Stream &stream, SharedPcmConvert &member,
+			ConstBuffer<void> src, bool flush)
+{
+	assert(member.stream == &stream);
+	assert(member.position == stream.GetEnd());
+
+	assert(!stream.busy);
+	stream.busy = true;
+
+	ConstBuffer<void> result;
+
+	try {
+		/* the conversion may take a while; don't block the
+		   other streams meanwhile */
+		const ScopeUnlock unlock(mutex);
+
+		result = flush
+			? stream.convert.Flush()
+			: stream.convert.Convert(src);
+	} catch (...) {
+		stream.busy = false;
+		cond.notify_all();
+		throw;
+	}
+
+	stream.busy = false;
+	cond.notify_all();
+
+	std::shared_ptr<Entry> entry;
+	if (spare.empty())
+		entry = std::make_shared<Entry>();
+	else {
+		entry = std::move(spare.back());
+		spare.pop_back();
+	}
+
+	const auto *s = (const uint8_t *)src.data;
+	entry->src.assign(s, s + src.size);
+	const auto *r = (const uint8_t *)result.data;
+	entry->dest.assign(r, r + result.size);
+	entry->flush = flush;
+
+	stream.log.emplace_back(entry);
+	++member.position;
+	member.current = std::move(entry);
+
+	Prune(stream);
+
+	return member.current->GetResult();
+}
+
+ConstBuffer<void>
+PcmConvertCache::Lookup(std::unique_lock<Mutex> &lock,
+			SharedPcmConvert &member,
+			ConstBuffer<void> src, bool flush)
+{
+	while (member.stream != nullptr) {
+		auto &stream = *member.stream;
+		if (member.position < stream.GetEnd()) {
+			const auto &entry = stream.log[member.position - stream.begin];
+			if (entry->Matches(src, flush)) {
+				++member.position;
+				member.current = entry;
+				Prune(stream);
+				return member.current->GetResult();
+			}
+
+			/* the input differs from what the other
+			   members have submitted */
+			Detach(member);
+			break;
+		}
+
+		if (!stream.busy)
+			/* this member is the first one to get here */
+			return Append(stream, member, src, flush);
+
+		/* another member is converting the next entry right
+		   now; wait for it (this member may have been
+		   detached meanwhile) */
+		cond.wait(lock);
+	}
+
+	/* find another stream which has converted this input
+	   already; search backwards, because the most recent
+	   entries are the most likely candidates */
+	for (auto &stream : streams) {
+		if (stream.members.empty() ||
+		    !stream.HasFormat(member.src_format, member.dest_format,
+				      member.resampler))
+			continue;
+
+		for (size_t i = stream.log.size(); i > 0; --i) {
+			const auto &entry = stream.log[i - 1];
+			if (entry->Matches(src, flush)) {
+				Attach(stream, member, stream.begin + i);
+				member.current = entry;
+				Prune(stream);
+				return member.current->GetResult();
+			}
+		}
+	}
+
+	/* nobody has seen this input yet: start a new stream */
+	member.current.reset();
+	auto &stream = MakeStream(member.src_format, member.dest_format,
+				  member.resampler);
+	Attach(stream, member, stream.GetEnd());
+	return Append(stream, member, src, flush);
+}
+
+SharedPcmConvert::SharedPcmConvert(PcmConvertCache &_cache,
+				   AudioFormat _src_format,
+				   AudioFormat _dest_format,
+				   const PcmResamplerSetup *_resampler)
+	:cache(_cache), src_format(_src_format), dest_format(_dest_format),
+	 resampler(_resampler)
+{
+	const std::lock_guard<Mutex> protect(cache.mutex);
+
+	/* this throws if the conversion is not possible, and
+	   prepares the stream we're most likely going to use */
+	cache.MakeStream(src_format, dest_format, resampler);
+}
+
+SharedPcmConvert::~SharedPcmConvert() noexcept
+{
+	const std::lock_guard<Mutex> protect(cache.mutex);
+	cache.Detach(*this);
+	cache.RemoveIdleStreams();
+}
+
+void
+SharedPcmConvert::Reset() noexcept
+{
+	const std::lock_guard<Mutex> protect(cache.mutex);
+
+	/* the next Convert() call will look for a stream which
+	   matches the new input, or start a new one */
+	cache.Detach(*this);
+}
+
+ConstBuffer<void>
+SharedPcmConvert::Convert(ConstBuffer<void> src)
+{
+	std::unique_lock<Mutex> lock(cache.mutex);
+	return cache.Lookup(lock, *this, src, false);
+}
+
+ConstBuffer<void>
+SharedPcmConvert::Flush()
+{
+	std::unique_lock<Mutex> lock(cache.mutex);
+	return cache.Lookup(lock, *this, nullptr, true);
+}
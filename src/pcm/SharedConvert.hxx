@@ -0,0 +1,247 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_SHARED_CONVERT_HXX
+#define MPD_PCM_SHARED_CONVERT_HXX
+
+#include "Convert.hxx"
+#include "AudioFormat.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+template<typename T> struct ConstBuffer;
+class SharedPcmConvert;
+
+/**
+ * A set of #PcmConvert instances which are shared by several
+ * #SharedPcmConvert consumers (i.e. audio outputs).  Consumers which
+ * convert the same PCM data to the same format get the result of
+ * one single conversion.
+ *
+ * Each #Stream remembers the input and output of its most recent
+ * conversions.  A consumer which submits the same input as the
+ * next entry just gets a reference to its output; a consumer which
+ * diverges (e.g. because the input was modified by a per-output
+ * filter) moves to another #Stream or gets a new one.
+ *
+ * This object must outlive its consumers.
+ */
+class PcmConvertCache {
+	friend class SharedPcmConvert;
+
+public:
+	/**
+	 * How many conversions does a #Stream remember?  Consumers
+	 * which lag behind more than this lose their #Stream.  Their
+	 * next conversion starts with a fresh #PcmConvert, because
+	 * the resampler state cannot be copied; this is an audible
+	 * discontinuity, just like after Reset().
+	 */
+	static constexpr size_t MAX_ENTRIES = 64;
+
+	/**
+	 * How many entries which have been consumed by all members
+	 * are kept for consumers which join late (e.g. an output
+	 * which has just been enabled)?
+	 */
+	static constexpr size_t HISTORY = 8;
+
+private:
+	struct Entry {
+		std::vector<uint8_t> src, dest;
+
+		bool flush = false;
+
+		bool Matches(ConstBuffer<void> _src,
+			     bool _flush) const noexcept;
+
+		ConstBuffer<void> GetResult() const noexcept;
+	};
+
+	struct Stream {
+		const AudioFormat src_format, dest_format;
+
+		const PcmResamplerSetup *const resampler;
+
+		PcmConvert convert;
+
+		std::deque<std::shared_ptr<Entry>> log;
+
+		/**
+		 * The absolute index of the first #log entry.
+		 */
+		uint_least64_t begin = 0;
+
+		std::vector<SharedPcmConvert *> members;
+
+		/**
+		 * Is a member currently converting the next entry
+		 * (with the mutex unlocked)?
+		 */
+		bool busy = false;
+
+		/**
+		 * Throws on error.
+		 */
+		Stream(AudioFormat _src_format, AudioFormat _dest_format,
+		       const PcmResamplerSetup *_resampler)
+			:src_format(_src_format), dest_format(_dest_format),
+			 resampler(_resampler),
+			 convert(_src_format, _dest_format, _resampler) {}
+
+		uint_least64_t GetEnd() const noexcept {
+			return begin + log.size();
+		}
+
+		bool HasFormat(AudioFormat _src_format,
+			       AudioFormat _dest_format,
+			       const PcmResamplerSetup *_resampler) const noexcept {
+			return src_format == _src_format &&
+				dest_format == _dest_format &&
+				resampler == _resampler;
+		}
+	};
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a #Stream is not #busy anymore.
+	 */
+	Cond cond;
+
+	std::list<Stream> streams;
+
+	/**
+	 * Retired #Entry objects whose allocations may be reused.
+	 */
+	std::vector<std::shared_ptr<Entry>> spare;
+
+public:
+	PcmConvertCache() noexcept;
+	~PcmConvertCache() noexcept;
+
+	PcmConvertCache(const PcmConvertCache &) = delete;
+	PcmConvertCache &operator=(const PcmConvertCache &) = delete;
+
+private:
+	/**
+	 * Find an idle #Stream with the given formats or create a new
+	 * one.  Caller must lock the mutex.
+	 *
+	 * Throws on error.
+	 */
+	Stream &MakeStream(AudioFormat src_format, AudioFormat dest_format,
+			   const PcmResamplerSetup *resampler);
+
+	ConstBuffer<void> Lookup(std::unique_lock<Mutex> &lock,
+				 SharedPcmConvert &member,
+				 ConstBuffer<void> src, bool flush);
+
+	/**
+	 * Convert the next entry of the given #Stream, unlocking the
+	 * mutex while the conversion runs.
+	 */
+	ConstBuffer<void> Append(Stream &stream, SharedPcmConvert &member,
+				 ConstBuffer<void> src, bool flush);
+
+	void Attach(Stream &stream, SharedPcmConvert &member,
+		    uint_least64_t position) noexcept;
+	void Detach(SharedPcmConvert &member) noexcept;
+
+	/**
+	 * Remove the #Entry objects which are not needed anymore.
+	 */
+	void Prune(Stream &stream) noexcept;
+
+	void Recycle(std::shared_ptr<Entry> &&entry) noexcept;
+
+	/**
+	 * Destroy all streams which have no members.
+	 */
+	void RemoveIdleStreams() noexcept;
+};
+
+/**
+ * A replacement for #PcmConvert which shares the conversion with
+ * other consumers of the same #PcmConvertCache.
+ */
+class SharedPcmConvert {
+	friend class PcmConvertCache;
+
+	PcmConvertCache &cache;
+
+	const AudioFormat src_format, dest_format;
+
+	const PcmResamplerSetup *const resampler;
+
+	/**
+	 * The #PcmConvertCache::Stream this object is attached to;
+	 * nullptr if it needs to find one with the next call.
+	 */
+	PcmConvertCache::Stream *stream = nullptr;
+
+	/**
+	 * The absolute index of the next expected entry of #stream.
+	 */
+	uint_least64_t position;
+
+	/**
+	 * The entry whose result was returned by the most recent
+	 * call; this reference keeps it alive even if #stream drops
+	 * it.
+	 */
+	std::shared_ptr<const PcmConvertCache::Entry> current;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	SharedPcmConvert(PcmConvertCache &_cache,
+			 AudioFormat _src_format, AudioFormat _dest_format,
+			 const PcmResamplerSetup *_resampler=nullptr);
+
+	~SharedPcmConvert() noexcept;
+
+	SharedPcmConvert(const SharedPcmConvert &) = delete;
+	SharedPcmConvert &operator=(const SharedPcmConvert &) = delete;
+
+	/**
+	 * @see PcmConvert::Reset()
+	 */
+	void Reset() noexcept;
+
+	/**
+	 * @see PcmConvert::Convert()
+	 */
+	ConstBuffer<void> Convert(ConstBuffer<void> src);
+
+	/**
+	 * @see PcmConvert::Flush()
+	 */
+	ConstBuffer<void> Flush();
+};
+
+#endif
@@ -0,0 +1,323 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Shuffle.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+void
+PcmShuffle::Open(size_t _in_sample_size, size_t _out_sample_size,
+		 unsigned channels, const int8_t *_map,
+		 const uint8_t *_fill) noexcept
+{
+	assert(_in_sample_size > 0);
+	assert(_out_sample_size > 0);
+	assert(channels > 0);
+	assert(channels * _in_sample_size <= MAX_FRAME_SIZE);
+	assert(channels * _out_sample_size <= MAX_FRAME_SIZE);
+
+	in_sample_size = _in_sample_size;
+	out_sample_size = _out_sample_size;
+	in_frame_size = channels * in_sample_size;
+	out_frame_size = channels * out_sample_size;
+
+	for (size_t i = 0; i < out_frame_size; ++i) {
+		assert(_map[i] < int8_t(in_frame_size));
+		map[i] = _map[i];
+		fill[i] = _fill != nullptr ? _fill[i] : 0;
+	}
+
+#ifdef PCM_SHUFFLE_SIMD
+	PrepareGroups();
+#endif
+}
+
+void
+PcmShuffle::Chain(const PcmShuffle &next) noexcept
+{
+	assert(IsDefined());
+	assert(next.IsDefined());
+	assert(out_frame_size % next.in_frame_size == 0);
+	assert(out_sample_size % next.in_sample_size == 0);
+
+	const size_t n_frames = out_frame_size / next.in_frame_size;
+	const size_t new_out_frame_size = n_frames * next.out_frame_size;
+	assert(new_out_frame_size <= MAX_FRAME_SIZE);
+
+	int8_t new_map[MAX_FRAME_SIZE];
+	uint8_t new_fill[MAX_FRAME_SIZE];
+
+	for (size_t o = 0; o < new_out_frame_size; ++o) {
+		const size_t frame = o / next.out_frame_size;
+		const int8_t m = next.map[o % next.out_frame_size];
+		new_fill[o] = next.fill[o % next.out_frame_size];
+
+		if (m < 0) {
+			new_map[o] = -1;
+			continue;
+		}
+
+		/* the byte which "next" picks from our output */
+		const size_t i = frame * next.in_frame_size + m;
+		new_map[o] = map[i];
+		new_fill[o] |= fill[i];
+	}
+
+	out_sample_size = out_sample_size / next.in_sample_size
+		* next.out_sample_size;
+	out_frame_size = new_out_frame_size;
+	std::copy_n(new_map, out_frame_size, map);
+	std::copy_n(new_fill, out_frame_size, fill);
+
+#ifdef PCM_SHUFFLE_SIMD
+	PrepareGroups();
+#endif
+}
+
+#ifdef PCM_SHUFFLE_SIMD
+
+/**
+ * How many frames of the given size are needed to fill a whole
+ * number of 16 byte vectors?
+ */
+static constexpr size_t
+FramesPerVector(size_t frame_size) noexcept
+{
+	size_t n = 16;
+	while (n > 1 && frame_size % 2 == 0) {
+		frame_size /= 2;
+		n /= 2;
+	}
+
+	return n;
+}
+
+void
+PcmShuffle::PrepareGroups() noexcept
+{
+	/* both are powers of two, so the bigger one is the least
+	   common multiple */
+	group_frames = std::max(FramesPerVector(in_frame_size),
+				FramesPerVector(out_frame_size));
+	group_in_vectors = group_frames * in_frame_size / 16;
+	group_out_vectors = group_frames * out_frame_size / 16;
+	assert(group_out_vectors <= MAX_GROUP_VECTORS);
+	assert(group_in_vectors <= 0xff);
+
+	for (size_t v = 0; v < group_out_vectors; ++v) {
+		auto &n = n_sources[v];
+		n = 0;
+
+		for (size_t b = 0; b < 16; ++b) {
+			const size_t o = v * 16 + b;
+			vector_fill[v][b] = fill[o % out_frame_size];
+
+			const int8_t m = map[o % out_frame_size];
+			if (m < 0)
+				continue;
+
+			const size_t i = o / out_frame_size * in_frame_size + m;
+			const size_t vector = i / 16;
+
+			Source *s = std::find_if(sources[v], sources[v] + n,
+						 [vector](const Source &x){
+							 return x.vector == vector;
+						 });
+			if (s == sources[v] + n) {
+				if (n == MAX_SOURCES) {
+					/* too complicated for the
+					   shuffle table */
+					group_frames = 0;
+					return;
+				}
+
+				++n;
+				s->vector = vector;
+				memset(s->mask, 0xff, sizeof(s->mask));
+			}
+
+			s->mask[b] = i % 16;
+		}
+	}
+}
+
+#ifdef __SSE2__
+
+template<typename S, typename F>
+__attribute__((target("ssse3")))
+static void
+Ssse3Shuffle(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
+	     size_t n_groups, size_t in_vectors, size_t out_vectors,
+	     const uint8_t *n_sources, const S &sources,
+	     const F &fill) noexcept
+{
+	for (size_t g = 0; g < n_groups; ++g) {
+		for (size_t v = 0; v < out_vectors; ++v) {
+			__m128i r = _mm_loadu_si128((const __m128i *)fill[v]);
+
+			for (size_t j = 0; j < n_sources[v]; ++j) {
+				const auto &s = sources[v][j];
+				const __m128i x = _mm_loadu_si128((const __m128i *)(src + s.vector * 16));
+				const __m128i m = _mm_loadu_si128((const __m128i *)s.mask);
+				r = _mm_or_si128(r, _mm_shuffle_epi8(x, m));
+			}
+
+			_mm_storeu_si128((__m128i *)dest, r);
+			dest += 16;
+		}
+
+		src += in_vectors * 16;
+	}
+}
+
+static bool
+HaveSsse3() noexcept
+{
+	static const bool value = (__builtin_cpu_init(),
+				   __builtin_cpu_supports("ssse3"));
+	return value;
+}
+
+#else
+
+static inline uint8x16_t
+NeonLookup(uint8x16_t x, uint8x16_t m) noexcept
+{
+#ifdef __aarch64__
+	return vqtbl1q_u8(x, m);
+#else
+	const uint8x8x2_t t{{vget_low_u8(x), vget_high_u8(x)}};
+	return vcombine_u8(vtbl2_u8(t, vget_low_u8(m)),
+			   vtbl2_u8(t, vget_high_u8(m)));
+#endif
+}
+
+template<typename S, typename F>
+static void
+NeonShuffle(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
+	    size_t n_groups, size_t in_vectors, size_t out_vectors,
+	    const uint8_t *n_sources, const S &sources,
+	    const F &fill) noexcept
+{
+	for (size_t g = 0; g < n_groups; ++g) {
+		for (size_t v = 0; v < out_vectors; ++v) {
+			uint8x16_t r = vld1q_u8(fill[v]);
+
+			/* table lookups yield zero for out-of-range
+			   indices, just like PSHUFB does for 0xff */
+			for (size_t j = 0; j < n_sources[v]; ++j) {
+				const auto &s = sources[v][j];
+				r = vorrq_u8(r, NeonLookup(vld1q_u8(src + s.vector * 16),
+							   vld1q_u8(s.mask)));
+			}
+
+			vst1q_u8(dest, r);
+			dest += 16;
+		}
+
+		src += in_vectors * 16;
+	}
+}
+
+#endif
+
+#endif
+
+void
+PcmShuffle::ApplyPortable(uint8_t *gcc_restrict dest,
+			  const uint8_t *gcc_restrict src,
+			  size_t n_frames) const noexcept
+{
+	for (size_t f = 0; f < n_frames; ++f) {
+		for (size_t i = 0; i < out_frame_size; ++i)
+			*dest++ = (map[i] >= 0 ? src[map[i]] : 0) | fill[i];
+
+		src += in_frame_size;
+	}
+}
+
+void
+PcmShuffle::ApplyPartial(uint8_t *gcc_restrict dest,
+			 const uint8_t *gcc_restrict src,
+			 size_t src_size) const noexcept
+{
+	assert(src_size < in_frame_size);
+
+	/* treat input bytes beyond the end like bytes of a missing
+	   sample: they read as zero (only channel reordering may
+	   refer to them) */
+	const size_t dest_size = GetOutputSize(src_size);
+	for (size_t i = 0; i < dest_size; ++i)
+		dest[i] = (map[i] >= 0 && size_t(map[i]) < src_size
+			   ? src[map[i]]
+			   : 0) | fill[i];
+}
+
+size_t
+PcmShuffle::Apply(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
+		  size_t src_size) const noexcept
+{
+	assert(IsDefined());
+
+	const size_t dest_size = GetOutputSize(src_size);
+	size_t n_frames = src_size / in_frame_size;
+	const size_t rest = src_size % in_frame_size;
+
+#ifdef PCM_SHUFFLE_SIMD
+#ifdef __SSE2__
+	if (group_frames > 0 && HaveSsse3()) {
+#else
+	if (group_frames > 0) {
+#endif
+		const size_t n_groups = n_frames / group_frames;
+
+#ifdef __SSE2__
+		Ssse3Shuffle(dest, src, n_groups,
+			     group_in_vectors, group_out_vectors,
+			     n_sources, sources, vector_fill);
+#else
+		NeonShuffle(dest, src, n_groups,
+			    group_in_vectors, group_out_vectors,
+			    n_sources, sources, vector_fill);
+#endif
+
+		const size_t done = n_groups * group_frames;
+		dest += done * out_frame_size;
+		src += done * in_frame_size;
+		n_frames -= done;
+	}
+#endif
+
+	ApplyPortable(dest, src, n_frames);
+
+	if (rest > 0)
+		ApplyPartial(dest + n_frames * out_frame_size,
+			     src + n_frames * in_frame_size, rest);
+
+	return dest_size;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_SHUFFLE_HXX
+#define MPD_PCM_SHUFFLE_HXX
+
+#include "util/ByteOrder.hxx"
+#include "util/Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(__ARM_NEON__)
+#define PCM_SHUFFLE_SIMD
+#endif
+
+/**
+ * A byte permutation which is applied to each frame of a PCM buffer.
+ * Each output byte is copied from one byte of the input frame or is
+ * zero, and then a constant pattern may be ORed into it.  This is
+ * used by #PcmExport to reorder channels, pack or shift samples and
+ * reverse the byte order all in one single pass, and by the DSD
+ * converters to build DSD_U16, DSD_U32 and DoP samples.
+ *
+ * With SSSE3 or NEON, a table of byte shuffle masks is precomputed
+ * for a group of frames whose input and output sizes are multiples
+ * of 16 bytes.
+ */
+class PcmShuffle {
+public:
+	/**
+	 * The maximum size of an input or output frame.  The
+	 * biggest one is a pair of 8 channel DoP frames.
+	 */
+	static constexpr size_t MAX_FRAME_SIZE = 64;
+
+private:
+	size_t in_sample_size, out_sample_size;
+
+	size_t in_frame_size = 0, out_frame_size;
+
+	/**
+	 * For each output byte: the index of the input byte, or -1
+	 * for a zero byte.
+	 */
+	int8_t map[MAX_FRAME_SIZE];
+
+	/**
+	 * For each output byte: bits which are ORed into it.
+	 */
+	uint8_t fill[MAX_FRAME_SIZE];
+
+#ifdef PCM_SHUFFLE_SIMD
+	static constexpr size_t MAX_GROUP_VECTORS = 16 * MAX_FRAME_SIZE / 16;
+
+	/**
+	 * The maximum number of input vectors which may contribute to
+	 * one output vector.  If a permutation needs more, the SIMD
+	 * path is disabled.
+	 */
+	static constexpr size_t MAX_SOURCES = 4;
+
+	struct Source {
+		/**
+		 * Index of the input vector relative to the beginning
+		 * of the group.
+		 */
+		uint8_t vector;
+
+		/**
+		 * The shuffle mask; 0xff means this output byte does
+		 * not come from this input vector.
+		 */
+		uint8_t mask[16];
+	};
+
+	/**
+	 * The number of frames in one group; 0 if the SIMD path is
+	 * disabled.
+	 */
+	size_t group_frames;
+
+	/**
+	 * The number of input and output vectors in one group.
+	 */
+	size_t group_in_vectors, group_out_vectors;
+
+	uint8_t n_sources[MAX_GROUP_VECTORS];
+	Source sources[MAX_GROUP_VECTORS][MAX_SOURCES];
+
+	/**
+	 * The #fill pattern of each output vector.
+	 */
+	uint8_t vector_fill[MAX_GROUP_VECTORS][16];
+#endif
+
+public:
+	/**
+	 * Prepare the permutation.
+	 *
+	 * @param _in_sample_size the size of one input sample in bytes
+	 * @param _out_sample_size the size of one output sample in
+	 * bytes
+	 * @param channels the number of samples per frame
+	 * @param _map for each output byte of a frame: the index of
+	 * the input byte, or -1
+	 * @param _fill for each output byte of a frame: bits to be
+	 * ORed into it; nullptr means no bits
+	 */
+	void Open(size_t _in_sample_size, size_t _out_sample_size,
+		  unsigned channels, const int8_t *_map,
+		  const uint8_t *_fill=nullptr) noexcept;
+
+	/**
+	 * Append another permutation which is applied to the output
+	 * of this one, so both can be done in one pass.  The output
+	 * frame size of this object must be a multiple of the input
+	 * frame size of @a next.
+	 */
+	void Chain(const PcmShuffle &next) noexcept;
+
+	void Close() noexcept {
+		in_frame_size = 0;
+	}
+
+	/**
+	 * Determine the position of a byte within a native-endian
+	 * integer; helper for building maps.
+	 *
+	 * @param size the size of the integer in bytes
+	 * @param significance 0 for the least significant byte
+	 */
+	static constexpr size_t NativeBytePosition(size_t size,
+						   size_t significance) noexcept {
+		return IsLittleEndian() ? significance : size - 1 - significance;
+	}
+
+	bool IsDefined() const noexcept {
+		return in_frame_size > 0;
+	}
+
+	/**
+	 * Calculate the output size for the given input size (in
+	 * bytes).
+	 */
+	gcc_pure
+	size_t GetOutputSize(size_t in_size) const noexcept {
+		return in_size / in_sample_size * out_sample_size;
+	}
+
+	/**
+	 * Apply the permutation.  A trailing partial frame is
+	 * converted sample by sample.
+	 *
+	 * @param src_size the input size in bytes
+	 * @return the number of bytes written to @a dest (see
+	 * GetOutputSize())
+	 */
+	size_t Apply(uint8_t *gcc_restrict dest,
+		     const uint8_t *gcc_restrict src,
+		     size_t src_size) const noexcept;
+
+private:
+	void ApplyPortable(uint8_t *gcc_restrict dest,
+			   const uint8_t *gcc_restrict src,
+			   size_t n_frames) const noexcept;
+
+	void ApplyPartial(uint8_t *gcc_restrict dest,
+			  const uint8_t *gcc_restrict src,
+			  size_t src_size) const noexcept;
+
+#ifdef PCM_SHUFFLE_SIMD
+	void PrepareGroups() noexcept;
+#endif
+};
+
+#endif
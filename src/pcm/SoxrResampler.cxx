@@ -22,6 +22,7 @@
 #include "config/Block.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/Domain.hxx"
+#include "util/NumberParser.hxx"
 #include "Log.hxx"
 
 #include <soxr.h>
@@ -38,9 +39,6 @@ static constexpr unsigned long SOXR_DEFAULT_RECIPE = SOXR_HQ;
  */
 static constexpr unsigned long SOXR_INVALID_RECIPE = -1;
 
-static soxr_quality_spec_t soxr_quality;
-static soxr_runtime_spec_t soxr_runtime;
-
 static constexpr struct {
 	unsigned long recipe;
 	const char *name;
@@ -79,11 +77,81 @@ soxr_parse_quality(const char *quality) noexcept
 	return SOXR_INVALID_RECIPE;
 }
 
-void
-pcm_resample_soxr_global_init(const ConfigBlock &block)
+static constexpr struct {
+	unsigned long flags;
+	const char *name;
+} soxr_phase_table[] = {
+	{ SOXR_LINEAR_PHASE, "linear" },
+	{ SOXR_INTERMEDIATE_PHASE, "intermediate" },
+	{ SOXR_MINIMUM_PHASE, "minimum" },
+	{ 0, nullptr }
+};
+
+static unsigned long
+soxr_parse_phase_response(const ConfigBlock &block)
+{
+	const char *value = block.GetBlockValue("phase_response");
+	if (value == nullptr)
+		return SOXR_LINEAR_PHASE;
+
+	for (const auto *i = soxr_phase_table; i->name != nullptr; ++i)
+		if (strcmp(i->name, value) == 0)
+			return i->flags;
+
+	throw FormatRuntimeError("unknown phase_response setting '%s' in line %d",
+				 value, block.line);
+}
+
+static constexpr struct {
+	unsigned long flags;
+	const char *name;
+} soxr_interpolation_table[] = {
+	{ SOXR_COEF_INTERP_AUTO, "auto" },
+	{ SOXR_COEF_INTERP_LOW, "low" },
+	{ SOXR_COEF_INTERP_HIGH, "high" },
+	{ 0, nullptr }
+};
+
+static unsigned long
+soxr_parse_interpolation(const ConfigBlock &block)
+{
+	const char *value = block.GetBlockValue("interpolation");
+	if (value == nullptr)
+		return SOXR_COEF_INTERP_AUTO;
+
+	for (const auto *i = soxr_interpolation_table; i->name != nullptr; ++i)
+		if (strcmp(i->name, value) == 0)
+			return i->flags;
+
+	throw FormatRuntimeError("unknown interpolation setting '%s' in line %d",
+				 value, block.line);
+}
+
+/**
+ * Parse a percentage of the Nyquist frequency and return it as a
+ * fraction; returns 0 if the setting is not present.
+ */
+static double
+soxr_parse_band_edge(const ConfigBlock &block, const char *name)
+{
+	const char *value = block.GetBlockValue(name);
+	if (value == nullptr)
+		return 0;
+
+	char *endptr;
+	double percent = ParseDouble(value, &endptr);
+	if (endptr == value || *endptr != 0 ||
+	    percent <= 0 || percent > 100)
+		throw FormatRuntimeError("invalid %s setting '%s' in line %d",
+					 name, value, block.line);
+
+	return percent / 100;
+}
+
+SoxrSettings::SoxrSettings(const ConfigBlock &block)
 {
 	const char *quality_string = block.GetBlockValue("quality");
-	unsigned long recipe = soxr_parse_quality(quality_string);
+	recipe = soxr_parse_quality(quality_string);
 	if (recipe == SOXR_INVALID_RECIPE) {
 		assert(quality_string != nullptr);
 
@@ -91,14 +159,24 @@ pcm_resample_soxr_global_init(const ConfigBlock &block)
 					 quality_string, block.line);
 	}
 
-	soxr_quality = soxr_quality_spec(recipe, 0);
-
 	FormatDebug(soxr_domain,
 		    "soxr converter '%s'",
 		    soxr_quality_name(recipe));
 
-	const unsigned n_threads = block.GetBlockValue("threads", 1);
-	soxr_runtime = soxr_runtime_spec(n_threads);
+	recipe |= soxr_parse_phase_response(block);
+
+	if (block.GetBlockValue("steep", false))
+		recipe |= SOXR_STEEP_FILTER;
+
+	passband_end = soxr_parse_band_edge(block, "passband_end");
+	stopband_begin = soxr_parse_band_edge(block, "stopband_begin");
+	if (passband_end > 0 && stopband_begin > 0 &&
+	    passband_end >= stopband_begin)
+		throw FormatRuntimeError("passband_end must be below stopband_begin in line %d",
+					 block.line);
+
+	threads = block.GetBlockValue("threads", 1U);
+	runtime_flags = soxr_parse_interpolation(block);
 }
 
 AudioFormat
@@ -107,10 +185,19 @@ SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
 	assert(af.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
 
+	soxr_quality_spec_t quality = soxr_quality_spec(settings.recipe, 0);
+	if (settings.passband_end > 0)
+		quality.passband_end = settings.passband_end;
+	if (settings.stopband_begin > 0)
+		quality.stopband_begin = settings.stopband_begin;
+
+	soxr_runtime_spec_t runtime = soxr_runtime_spec(settings.threads);
+	runtime.flags |= settings.runtime_flags;
+
 	soxr_error_t e;
 	soxr = soxr_create(af.sample_rate, new_sample_rate,
 			   af.channels, &e,
-			   nullptr, &soxr_quality, &soxr_runtime);
+			   nullptr, &quality, &runtime);
 	if (soxr == nullptr)
 		throw FormatRuntimeError("soxr initialization has failed: %s",
 					 e);
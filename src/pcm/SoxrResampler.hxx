@@ -26,10 +26,46 @@
 struct AudioFormat;
 struct ConfigBlock;
 
+/**
+ * The soxr settings of one "resampler" block, parsed but not yet
+ * converted to libsoxr structures.
+ */
+struct SoxrSettings {
+	/**
+	 * The soxr_quality_spec() recipe, including the phase
+	 * response and "steep filter" bits.
+	 */
+	unsigned long recipe;
+
+	/**
+	 * The passband/stopband edges as fraction of the Nyquist
+	 * frequency; 0 means use the recipe's default.
+	 */
+	double passband_end = 0, stopband_begin = 0;
+
+	/**
+	 * The number of worker threads; 0 means "automatic" (one per
+	 * CPU core, if libsoxr was built with OpenMP).
+	 */
+	unsigned threads;
+
+	/**
+	 * The soxr_runtime_spec_t flags (coefficient interpolation).
+	 */
+	unsigned long runtime_flags;
+
+	/**
+	 * Throws on error.
+	 */
+	explicit SoxrSettings(const ConfigBlock &block);
+};
+
 /**
  * A resampler using soxr.
  */
 class SoxrPcmResampler final : public PcmResampler {
+	const SoxrSettings &settings;
+
 	struct soxr *soxr;
 
 	unsigned channels;
@@ -38,6 +74,9 @@ class SoxrPcmResampler final : public PcmResampler {
 	PcmBuffer buffer;
 
 public:
+	explicit SoxrPcmResampler(const SoxrSettings &_settings) noexcept
+		:settings(_settings) {}
+
 	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
 	void Close() noexcept override;
 	void Reset() noexcept override;
@@ -45,7 +84,4 @@ public:
 	ConstBuffer<void> Flush() override;
 };
 
-void
-pcm_resample_soxr_global_init(const ConfigBlock &block);
-
 #endif
@@ -27,6 +27,14 @@
 
 #include "Dither.cxx" // including the .cxx file to get inlined templates
 
+#ifdef __SSE2__
+#include "X86Convert.hxx"
+#elif defined(__ARM_NEON__)
+#include "Neon.hxx"
+#endif
+
+#include <algorithm>
+
 #include <assert.h>
 #include <stdint.h>
 #include <string.h>
@@ -74,19 +82,6 @@ PcmVolumeConvert(typename STraits::value_type _sample, int volume) noexcept
 	return result;
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static inline typename Traits::value_type
-pcm_volume_sample(PcmDither &dither,
-		  typename Traits::value_type _sample,
-		  int volume) noexcept
-{
-	typename Traits::long_type sample(_sample);
-
-	return dither.DitherShift<typename Traits::long_type,
-				  Traits::BITS + PCM_VOLUME_BITS,
-				  Traits::BITS>(sample * volume);
-}
-
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static void
 pcm_volume_change(PcmDither &dither,
@@ -95,11 +90,13 @@ pcm_volume_change(PcmDither &dither,
 		  size_t n,
 		  int volume) noexcept
 {
-	transform_n(src, n, dest,
-		    [&dither, volume](auto x){
-			    return pcm_volume_sample<F, Traits>(dither, x,
-								volume);
-		    });
+	typedef typename Traits::long_type long_type;
+
+	dither.DitherShift<long_type, Traits::BITS + PCM_VOLUME_BITS,
+			   Traits::BITS>(dest, n,
+					 [src, volume](size_t i){
+						 return long_type(src[i]) * volume;
+					 });
 }
 
 static void
@@ -122,7 +119,18 @@ static void
 PcmVolumeChange16to32(int32_t *dest, const int16_t *src, size_t n,
 		      int volume) noexcept
 {
-	transform_n(src, n, dest,
+#ifdef __SSE2__
+	X86Convert::VolumeS16ToS24(dest, src, n, volume);
+	const size_t done = n - n % X86Convert::BLOCK_SIZE;
+#elif defined(__ARM_NEON__)
+	using Neon = NeonVolume16To24<16 + PCM_VOLUME_BITS - 24>;
+	Neon().Convert(dest, src, n, volume);
+	const size_t done = n - n % Neon::BLOCK_SIZE;
+#else
+	const size_t done = 0;
+#endif
+
+	transform_n(src + done, n - done, dest + done,
 		    [volume](auto x){
 			    return PcmVolumeConvert<SampleFormat::S16,
 						    SampleFormat::S24_P32>(x,
@@ -151,10 +159,124 @@ static void
 pcm_volume_change_float(float *dest, const float *src, size_t n,
 			float volume) noexcept
 {
-	transform_n(src, n, dest,
+#ifdef __SSE2__
+	X86Convert::VolumeFloat(dest, src, n, volume);
+	const size_t done = n - n % X86Convert::BLOCK_SIZE;
+#elif defined(__ARM_NEON__)
+	NeonVolumeFloat().Convert(dest, src, n, volume);
+	const size_t done = n - n % NeonVolumeFloat::BLOCK_SIZE;
+#else
+	const size_t done = 0;
+#endif
+
+	transform_n(src + done, n - done, dest + done,
 		    [volume](float x){ return x * volume; });
 }
 
+/**
+ * Apply software volume and convert to a different integer sample
+ * format in one pass, dithering if bits get discarded.
+ */
+template<SampleFormat SF, SampleFormat DF,
+	 class STraits=SampleTraits<SF>,
+	 class DTraits=SampleTraits<DF>>
+static void
+PcmVolumeConvertN(PcmDither &dither,
+		  typename DTraits::pointer_type dest,
+		  typename STraits::const_pointer_type src, size_t n,
+		  int volume) noexcept
+{
+	typedef typename STraits::long_type long_type;
+
+	/* precision bits after multiplying with the volume */
+	constexpr unsigned BITS = STraits::BITS + PCM_VOLUME_BITS;
+
+	if constexpr (BITS > DTraits::BITS) {
+		/* the dither implementation discards at most 16
+		   bits; drop the rest with a plain shift */
+		constexpr unsigned PRE_SHIFT = BITS - DTraits::BITS > 16
+			? BITS - DTraits::BITS - 16
+			: 0;
+
+		constexpr unsigned SBITS = BITS - PRE_SHIFT;
+		static constexpr long_type MIN = -(long_type(1) << (SBITS - 1));
+		static constexpr long_type MAX = (long_type(1) << (SBITS - 1)) - 1;
+
+		dither.DitherShift<long_type, SBITS,
+				   DTraits::BITS>(dest, n,
+						  [src, volume](size_t i){
+							  long_type sample = long_type(src[i]) * volume;
+							  if constexpr (PRE_SHIFT > 0)
+								  /* clip here because the shifted value
+								     may be truncated to 32 bit by the
+								     dither implementation */
+								  sample = std::clamp(sample >> PRE_SHIFT,
+										      MIN, MAX);
+							  return sample;
+						  });
+	} else {
+		transform_n(src, n, dest, [volume](auto x){
+				constexpr int_least64_t factor =
+					int_least64_t(1) << (DTraits::BITS - BITS);
+				const int_least64_t sample =
+					int_least64_t(x) * volume * factor;
+				return typename DTraits::value_type(std::clamp<int_least64_t>(sample,
+											      DTraits::MIN,
+											      DTraits::MAX));
+			});
+	}
+}
+
+/**
+ * Apply software volume and convert integer samples to floating
+ * point; both are done by one multiplication.
+ */
+template<SampleFormat SF, class STraits=SampleTraits<SF>>
+static void
+PcmVolumeToFloatN(float *dest, typename STraits::const_pointer_type src,
+		  size_t n, int volume) noexcept
+{
+	const float factor = pcm_volume_to_float(volume) /
+		float(1u << (STraits::BITS - 1));
+
+	transform_n(src, n, dest,
+		    [factor](auto x){ return float(x) * factor; });
+}
+
+template<SampleFormat SF, class STraits=SampleTraits<SF>>
+static bool
+PcmVolumeConvertTo(PcmDither &dither, void *dest, const void *_src,
+		   size_t n, int volume, SampleFormat dest_format) noexcept
+{
+	const auto src = (typename STraits::const_pointer_type)_src;
+
+	switch (dest_format) {
+	case SampleFormat::S16:
+		PcmVolumeConvertN<SF, SampleFormat::S16>(dither, (int16_t *)dest,
+							 src, n, volume);
+		return true;
+
+	case SampleFormat::S24_P32:
+		PcmVolumeConvertN<SF, SampleFormat::S24_P32>(dither, (int32_t *)dest,
+							 src, n, volume);
+		return true;
+
+	case SampleFormat::S32:
+		PcmVolumeConvertN<SF, SampleFormat::S32>(dither, (int32_t *)dest,
+							 src, n, volume);
+		return true;
+
+	case SampleFormat::FLOAT:
+		PcmVolumeToFloatN<SF>((float *)dest, src, n, volume);
+		return true;
+
+	default:
+		break;
+	}
+
+	return false;
+}
+
 SampleFormat
 PcmVolume::Open(SampleFormat _format, bool allow_convert)
 {
@@ -195,13 +317,13 @@ PcmVolume::Open(SampleFormat _format, bool allow_convert)
 }
 
 ConstBuffer<void>
-PcmVolume::Apply(ConstBuffer<void> src) noexcept
+PcmVolume::DoApply(ConstBuffer<void> src, bool _convert) noexcept
 {
-	if (volume == PCM_VOLUME_1 && !convert)
+	if (volume == PCM_VOLUME_1 && !_convert)
 		return src;
 
 	size_t dest_size = src.size;
-	if (convert) {
+	if (_convert) {
 		assert(format == SampleFormat::S16);
 
 		/* converting to S24_P32 */
@@ -229,7 +351,7 @@ PcmVolume::Apply(ConstBuffer<void> src) noexcept
 		break;
 
 	case SampleFormat::S16:
-		if (convert)
+		if (_convert)
 			PcmVolumeChange16to32((int32_t *)data,
 					      (const int16_t *)src.data,
 					      src.size / sizeof(int16_t),
@@ -269,3 +391,73 @@ PcmVolume::Apply(ConstBuffer<void> src) noexcept
 
 	return { data, dest_size };
 }
+
+ConstBuffer<void>
+PcmVolume::Apply(ConstBuffer<void> src) noexcept
+{
+	return DoApply(src, convert);
+}
+
+ConstBuffer<void>
+PcmVolume::Apply(ConstBuffer<void> src, SampleFormat dest_format) noexcept
+{
+	if (dest_format == format)
+		/* no conversion; this is the plain volume
+		   implementation (without the S16 to S24 promotion) */
+		return DoApply(src, false);
+
+	if (volume == PCM_VOLUME_1)
+		/* Apply() is a no-op, and a separate conversion
+		   doesn't need to dither */
+		return nullptr;
+
+	const size_t n = src.size / sample_format_size(format);
+	const size_t dest_size = n * sample_format_size(dest_format);
+
+	void *data = buffer.Get(dest_size);
+
+	if (volume == 0) {
+		if (dest_format == SampleFormat::DSD)
+			return nullptr;
+
+		PcmSilence({data, dest_size}, dest_format);
+		return { data, dest_size };
+	}
+
+	bool success;
+	switch (format) {
+	case SampleFormat::S8:
+		success = PcmVolumeConvertTo<SampleFormat::S8>(dither, data, src.data,
+								n, volume,
+								dest_format);
+		break;
+
+	case SampleFormat::S16:
+		success = PcmVolumeConvertTo<SampleFormat::S16>(dither, data, src.data,
+								 n, volume,
+								 dest_format);
+		break;
+
+	case SampleFormat::S24_P32:
+		success = PcmVolumeConvertTo<SampleFormat::S24_P32>(dither, data,
+								     src.data,
+								     n, volume,
+								     dest_format);
+		break;
+
+	case SampleFormat::S32:
+		success = PcmVolumeConvertTo<SampleFormat::S32>(dither, data, src.data,
+								 n, volume,
+								 dest_format);
+		break;
+
+	default:
+		success = false;
+		break;
+	}
+
+	if (!success)
+		return nullptr;
+
+	return { data, dest_size };
+}
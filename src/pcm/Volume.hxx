@@ -122,6 +122,28 @@ public:
 	 */
 	gcc_pure
 	ConstBuffer<void> Apply(ConstBuffer<void> src) noexcept;
+
+	/**
+	 * Apply the volume level and convert to the specified
+	 * #SampleFormat in one pass, instead of the output format
+	 * returned by Open().  This replaces a separate
+	 * #PcmFormatConverter pass after this one.
+	 *
+	 * @return the destination buffer or nullptr if this
+	 * combination of sample formats is not implemented or if a
+	 * separate conversion is cheaper (i.e. at 100% volume)
+	 */
+	gcc_pure
+	ConstBuffer<void> Apply(ConstBuffer<void> src,
+				SampleFormat dest_format) noexcept;
+
+private:
+	/**
+	 * @param _convert convert S16 to S24_P32 (see #convert)?
+	 */
+	gcc_pure
+	ConstBuffer<void> DoApply(ConstBuffer<void> src,
+				  bool _convert) noexcept;
 };
 
 #endif
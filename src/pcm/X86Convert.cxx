@@ -0,0 +1,1253 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "X86Convert.hxx"
+#include "FloatConvert.hxx"
+#include "Volume.hxx"
+
+#ifdef __SSE2__
+
+#include <immintrin.h>
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+using namespace X86Convert;
+
+static constexpr float factor_from_8 =
+	IntegerToFloatSampleConvert<SampleFormat::S8>::factor;
+static constexpr float factor_from_16 =
+	IntegerToFloatSampleConvert<SampleFormat::S16>::factor;
+static constexpr float factor_from_24 =
+	IntegerToFloatSampleConvert<SampleFormat::S24_P32>::factor;
+static constexpr float factor_from_32 =
+	IntegerToFloatSampleConvert<SampleFormat::S32>::factor;
+
+static constexpr float factor_to_16 =
+	FloatToIntegerSampleConvert<SampleFormat::S16>::factor;
+static constexpr float factor_to_24 =
+	FloatToIntegerSampleConvert<SampleFormat::S24_P32>::factor;
+static constexpr float factor_to_32 =
+	FloatToIntegerSampleConvert<SampleFormat::S32>::factor;
+
+/*
+ * Float to integer conversion: the portable code truncates the
+ * scaled value towards zero and then clamps it.  Clamping the float
+ * first is equivalent as long as both limits are representable as
+ * float, which is true for 16 and 24 bit.  For 32 bit, only the
+ * lower limit is; values which are too large make cvttps return
+ * INT32_MIN, which is then flipped to INT32_MAX.
+ */
+
+static inline __m128i
+Sse2FloatToInt(__m128 x, float factor, float min, float max) noexcept
+{
+	x = _mm_mul_ps(x, _mm_set1_ps(factor));
+	x = _mm_max_ps(x, _mm_set1_ps(min));
+	x = _mm_min_ps(x, _mm_set1_ps(max));
+	return _mm_cvttps_epi32(x);
+}
+
+static inline __m128i
+Sse2FloatToInt32(__m128 x) noexcept
+{
+	x = _mm_mul_ps(x, _mm_set1_ps(factor_to_32));
+	x = _mm_max_ps(x, _mm_set1_ps(-factor_to_32));
+	__m128i overflow = _mm_castps_si128(_mm_cmpge_ps(x, _mm_set1_ps(factor_to_32)));
+	return _mm_xor_si128(_mm_cvttps_epi32(x), overflow);
+}
+
+static inline void
+Sse2StoreFloat(float *dst, __m128i x, float factor) noexcept
+{
+	_mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(x),
+				      _mm_set1_ps(factor)));
+}
+
+/**
+ * Load 16 signed 8 bit samples and convert them to 32 bit, shifted
+ * left by 24 bits.
+ */
+static inline void
+Sse2Load8(__m128i dst[4], const int8_t *src) noexcept
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i x = _mm_loadu_si128((const __m128i *)src);
+	const __m128i lo = _mm_unpacklo_epi8(zero, x);
+	const __m128i hi = _mm_unpackhi_epi8(zero, x);
+	dst[0] = _mm_unpacklo_epi16(zero, lo);
+	dst[1] = _mm_unpackhi_epi16(zero, lo);
+	dst[2] = _mm_unpacklo_epi16(zero, hi);
+	dst[3] = _mm_unpackhi_epi16(zero, hi);
+}
+
+/**
+ * Load 8 signed 16 bit samples and convert them to 32 bit, shifted
+ * left by 16 bits.
+ */
+static inline void
+Sse2Load16(__m128i dst[2], const int16_t *src) noexcept
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i x = _mm_loadu_si128((const __m128i *)src);
+	dst[0] = _mm_unpacklo_epi16(zero, x);
+	dst[1] = _mm_unpackhi_epi16(zero, x);
+}
+
+static inline __m128i
+Sse2Load32(const int32_t *src) noexcept
+{
+	return _mm_loadu_si128((const __m128i *)src);
+}
+
+static inline void
+Sse2Store32(int32_t *dst, __m128i x) noexcept
+{
+	_mm_storeu_si128((__m128i *)dst, x);
+}
+
+static void
+Sse2S8ToS16(int16_t *dst, const int8_t *src, size_t n) noexcept
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	for (size_t i = 0; i < n / BLOCK_SIZE;
+	     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(zero, x));
+		_mm_storeu_si128((__m128i *)(dst + 8),
+				 _mm_unpackhi_epi8(zero, x));
+	}
+}
+
+static void
+Sse2S8ToS24(int32_t *dst, const int8_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / BLOCK_SIZE;
+	     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+		__m128i x[4];
+		Sse2Load8(x, src);
+		for (unsigned j = 0; j < 4; ++j)
+			Sse2Store32(dst + 4 * j, _mm_srai_epi32(x[j], 8));
+	}
+}
+
+static void
+Sse2S8ToS32(int32_t *dst, const int8_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / BLOCK_SIZE;
+	     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+		__m128i x[4];
+		Sse2Load8(x, src);
+		for (unsigned j = 0; j < 4; ++j)
+			Sse2Store32(dst + 4 * j, x[j]);
+	}
+}
+
+static void
+Sse2S16ToS24(int32_t *dst, const int16_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8) {
+		__m128i x[2];
+		Sse2Load16(x, src);
+		Sse2Store32(dst, _mm_srai_epi32(x[0], 8));
+		Sse2Store32(dst + 4, _mm_srai_epi32(x[1], 8));
+	}
+}
+
+static void
+Sse2S16ToS32(int32_t *dst, const int16_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8) {
+		__m128i x[2];
+		Sse2Load16(x, src);
+		Sse2Store32(dst, x[0]);
+		Sse2Store32(dst + 4, x[1]);
+	}
+}
+
+static void
+Sse2S24ToS32(int32_t *dst, const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 4; ++i, src += 4, dst += 4)
+		Sse2Store32(dst, _mm_slli_epi32(Sse2Load32(src), 8));
+}
+
+static void
+Sse2S32ToS24(int32_t *dst, const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 4; ++i, src += 4, dst += 4)
+		Sse2Store32(dst, _mm_srai_epi32(Sse2Load32(src), 8));
+}
+
+static void
+Sse2S8ToFloat(float *dst, const int8_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / BLOCK_SIZE;
+	     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+		__m128i x[4];
+		Sse2Load8(x, src);
+		for (unsigned j = 0; j < 4; ++j)
+			Sse2StoreFloat(dst + 4 * j, _mm_srai_epi32(x[j], 24),
+				       factor_from_8);
+	}
+}
+
+static void
+Sse2S16ToFloat(float *dst, const int16_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8) {
+		__m128i x[2];
+		Sse2Load16(x, src);
+		Sse2StoreFloat(dst, _mm_srai_epi32(x[0], 16), factor_from_16);
+		Sse2StoreFloat(dst + 4, _mm_srai_epi32(x[1], 16),
+			       factor_from_16);
+	}
+}
+
+static void
+Sse2S24ToFloat(float *dst, const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 4; ++i, src += 4, dst += 4)
+		Sse2StoreFloat(dst, Sse2Load32(src), factor_from_24);
+}
+
+static void
+Sse2S32ToFloat(float *dst, const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 4; ++i, src += 4, dst += 4)
+		Sse2StoreFloat(dst, Sse2Load32(src), factor_from_32);
+}
+
+static void
+Sse2FloatToS16(int16_t *dst, const float *src, size_t n) noexcept
+{
+	using Traits = SampleTraits<SampleFormat::S16>;
+
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8) {
+		const __m128i a = Sse2FloatToInt(_mm_loadu_ps(src),
+						 factor_to_16,
+						 Traits::MIN, Traits::MAX);
+		const __m128i b = Sse2FloatToInt(_mm_loadu_ps(src + 4),
+						 factor_to_16,
+						 Traits::MIN, Traits::MAX);
+		_mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(a, b));
+	}
+}
+
+static void
+Sse2FloatToS24(int32_t *dst, const float *src, size_t n) noexcept
+{
+	using Traits = SampleTraits<SampleFormat::S24_P32>;
+
+	for (size_t i = 0; i < n / 4; ++i, src += 4, dst += 4)
+		Sse2Store32(dst, Sse2FloatToInt(_mm_loadu_ps(src),
+						factor_to_24,
+						Traits::MIN, Traits::MAX));
+}
+
+static void
+Sse2FloatToS32(int32_t *dst, const float *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 4; ++i, src += 4, dst += 4)
+		Sse2Store32(dst, Sse2FloatToInt32(_mm_loadu_ps(src)));
+}
+
+/**
+ * The number of bits PcmVolumeConvert() shifts right after
+ * multiplying a S16 sample with the volume to get S24_P32.
+ */
+static constexpr unsigned VOLUME_16_TO_24_SHIFT = 16 + PCM_VOLUME_BITS - 24;
+static_assert(16 + PCM_VOLUME_BITS > 24, "Unsupported PCM_VOLUME_BITS");
+
+static void
+Sse2VolumeS16ToS24(int32_t *dst, const int16_t *src, size_t n,
+		   int volume) noexcept
+{
+	if (volume > INT16_MAX) {
+		/* the 16 bit multiplication below cannot deal with
+		   such a large factor (which means a lot of clipping
+		   anyway) */
+		for (size_t i = 0; i < n; ++i)
+			dst[i] = (int32_t(src[i]) * volume) >> VOLUME_16_TO_24_SHIFT;
+		return;
+	}
+
+	const __m128i v = _mm_set1_epi16(volume);
+
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8) {
+		/* combine the low and high halves of the 16x16 bit
+		   products to 32 bit */
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		const __m128i lo = _mm_mullo_epi16(x, v);
+		const __m128i hi = _mm_mulhi_epi16(x, v);
+		Sse2Store32(dst, _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi),
+						VOLUME_16_TO_24_SHIFT));
+		Sse2Store32(dst + 4, _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi),
+						    VOLUME_16_TO_24_SHIFT));
+	}
+}
+
+static void
+Sse2VolumeFloat(float *dst, const float *src, size_t n,
+		float volume) noexcept
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	for (size_t i = 0; i < n / 4; ++i, src += 4, dst += 4)
+		_mm_storeu_ps(dst, _mm_mul_ps(_mm_loadu_ps(src), v));
+}
+
+static void
+Sse2AddS8(int8_t *a, const int8_t *b, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 16; ++i, a += 16, b += 16) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)a);
+		const __m128i y = _mm_loadu_si128((const __m128i *)b);
+		_mm_storeu_si128((__m128i *)a, _mm_adds_epi8(x, y));
+	}
+}
+
+static void
+Sse2AddS16(int16_t *a, const int16_t *b, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, a += 8, b += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)a);
+		const __m128i y = _mm_loadu_si128((const __m128i *)b);
+		_mm_storeu_si128((__m128i *)a, _mm_adds_epi16(x, y));
+	}
+}
+
+/**
+ * Select @a x where @a mask is set, @a y elsewhere.
+ */
+static inline __m128i
+Sse2Select(__m128i mask, __m128i x, __m128i y) noexcept
+{
+	return _mm_or_si128(_mm_and_si128(mask, x),
+			    _mm_andnot_si128(mask, y));
+}
+
+static void
+Sse2AddS24(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	using Traits = SampleTraits<SampleFormat::S24_P32>;
+	const __m128i min = _mm_set1_epi32(Traits::MIN);
+	const __m128i max = _mm_set1_epi32(Traits::MAX);
+
+	for (size_t i = 0; i < n / 4; ++i, a += 4, b += 4) {
+		/* the sum of two 24 bit samples cannot overflow 32
+		   bit; SSE2 has no min/max for 32 bit integers, so
+		   clamp with compare and select */
+		__m128i sum = _mm_add_epi32(Sse2Load32(a), Sse2Load32(b));
+		sum = Sse2Select(_mm_cmpgt_epi32(sum, max), max, sum);
+		sum = Sse2Select(_mm_cmplt_epi32(sum, min), min, sum);
+		Sse2Store32(a, sum);
+	}
+}
+
+static void
+Sse2AddS32(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	const __m128i int_max = _mm_set1_epi32(INT32_MAX);
+
+	for (size_t i = 0; i < n / 4; ++i, a += 4, b += 4) {
+		const __m128i x = Sse2Load32(a), y = Sse2Load32(b);
+		const __m128i sum = _mm_add_epi32(x, y);
+
+		/* the addition has overflowed if the sign of the sum
+		   differs from the sign of both operands; saturate
+		   towards the sign of the operands then */
+		const __m128i overflow =
+			_mm_srai_epi32(_mm_and_si128(_mm_xor_si128(x, sum),
+						     _mm_xor_si128(y, sum)),
+				       31);
+		const __m128i saturated =
+			_mm_xor_si128(_mm_srai_epi32(x, 31), int_max);
+		Sse2Store32(a, Sse2Select(overflow, saturated, sum));
+	}
+}
+
+static void
+Sse2AddFloat(float *a, const float *b, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 4; ++i, a += 4, b += 4)
+		_mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+}
+
+static void
+Sse2MixFloat(float *a, const float *b, size_t n,
+	     float volume1, float volume2) noexcept
+{
+	const __m128 v1 = _mm_set1_ps(volume1), v2 = _mm_set1_ps(volume2);
+
+	for (size_t i = 0; i < n / 4; ++i, a += 4, b += 4)
+		_mm_storeu_ps(a, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a), v1),
+					    _mm_mul_ps(_mm_loadu_ps(b), v2)));
+}
+
+static inline __m128i
+Sse2XorShift32(__m128i x) noexcept
+{
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+static inline __m128i
+Sse2TpdfNoise(__m128i r, __m128i mask) noexcept
+{
+	return _mm_sub_epi32(_mm_and_si128(r, mask),
+			     _mm_and_si128(_mm_srli_epi32(r, 16), mask));
+}
+
+static void
+Sse2TpdfNoise(uint32_t lanes[8], int32_t *noise, size_t n,
+	      unsigned bits) noexcept
+{
+	const __m128i mask = _mm_set1_epi32((1u << bits) - 1);
+	__m128i a = _mm_loadu_si128((const __m128i *)lanes);
+	__m128i b = _mm_loadu_si128((const __m128i *)(lanes + 4));
+
+	for (size_t i = 0; i < n / 8; ++i, noise += 8) {
+		a = Sse2XorShift32(a);
+		b = Sse2XorShift32(b);
+		Sse2Store32(noise, Sse2TpdfNoise(a, mask));
+		Sse2Store32(noise + 4, Sse2TpdfNoise(b, mask));
+	}
+
+	_mm_storeu_si128((__m128i *)lanes, a);
+	_mm_storeu_si128((__m128i *)(lanes + 4), b);
+}
+
+static inline __m128i
+Sse2TpdfShift(__m128i x, __m128i noise, __m128i mask, __m128i round,
+	      __m128i shift) noexcept
+{
+	/* shift the upper part and the lower part (plus noise)
+	   separately, to avoid overflowing 32 bit */
+	const __m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(x, mask),
+						       round),
+					 noise);
+	return _mm_add_epi32(_mm_sra_epi32(x, shift),
+			     _mm_sra_epi32(lo, shift));
+}
+
+static void
+Sse2TpdfShiftS16(int16_t *dst, const int32_t *src, const int32_t *noise,
+		 size_t n, unsigned _shift) noexcept
+{
+	const __m128i mask = _mm_set1_epi32((1 << _shift) - 1);
+	const __m128i round = _mm_set1_epi32(1 << (_shift - 1));
+	const __m128i shift = _mm_cvtsi32_si128(_shift);
+
+	for (size_t i = 0; i < n / 8;
+	     ++i, src += 8, noise += 8, dst += 8) {
+		const __m128i a = Sse2TpdfShift(Sse2Load32(src),
+						Sse2Load32(noise),
+						mask, round, shift);
+		const __m128i b = Sse2TpdfShift(Sse2Load32(src + 4),
+						Sse2Load32(noise + 4),
+						mask, round, shift);
+		_mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(a, b));
+	}
+}
+
+static void
+Sse2InterleaveStereo8(uint8_t *dst, const uint8_t *src1,
+		      const uint8_t *src2, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 16; ++i, src1 += 16, src2 += 16, dst += 32) {
+		const __m128i a = _mm_loadu_si128((const __m128i *)src1);
+		const __m128i b = _mm_loadu_si128((const __m128i *)src2);
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(a, b));
+		_mm_storeu_si128((__m128i *)(dst + 16),
+				 _mm_unpackhi_epi8(a, b));
+	}
+}
+
+static void
+Sse2InterleaveStereo16(int16_t *dst, const int16_t *src1,
+		       const int16_t *src2, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src1 += 8, src2 += 8, dst += 16) {
+		const __m128i a = _mm_loadu_si128((const __m128i *)src1);
+		const __m128i b = _mm_loadu_si128((const __m128i *)src2);
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(a, b));
+		_mm_storeu_si128((__m128i *)(dst + 8),
+				 _mm_unpackhi_epi16(a, b));
+	}
+}
+
+static void
+Sse2InterleaveStereo32(int32_t *dst, const int32_t *src1,
+		       const int32_t *src2, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 4; ++i, src1 += 4, src2 += 4, dst += 8) {
+		const __m128i a = Sse2Load32(src1);
+		const __m128i b = Sse2Load32(src2);
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi32(a, b));
+		_mm_storeu_si128((__m128i *)(dst + 4),
+				 _mm_unpackhi_epi32(a, b));
+	}
+}
+
+/*
+ * AVX2
+ *
+ */
+
+AVX2_TARGET
+static inline __m256i
+Avx2FloatToInt(__m256 x, float factor, float min, float max) noexcept
+{
+	x = _mm256_mul_ps(x, _mm256_set1_ps(factor));
+	x = _mm256_max_ps(x, _mm256_set1_ps(min));
+	x = _mm256_min_ps(x, _mm256_set1_ps(max));
+	return _mm256_cvttps_epi32(x);
+}
+
+AVX2_TARGET
+static inline __m256i
+Avx2FloatToInt32(__m256 x) noexcept
+{
+	x = _mm256_mul_ps(x, _mm256_set1_ps(factor_to_32));
+	x = _mm256_max_ps(x, _mm256_set1_ps(-factor_to_32));
+	__m256i overflow = _mm256_castps_si256(_mm256_cmp_ps(x, _mm256_set1_ps(factor_to_32),
+							     _CMP_GE_OQ));
+	return _mm256_xor_si256(_mm256_cvttps_epi32(x), overflow);
+}
+
+AVX2_TARGET
+static inline void
+Avx2StoreFloat(float *dst, __m256i x, float factor) noexcept
+{
+	_mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(x),
+					    _mm256_set1_ps(factor)));
+}
+
+/**
+ * Load 8 signed 8 bit samples and sign-extend them to 32 bit.
+ */
+AVX2_TARGET
+static inline __m256i
+Avx2Load8(const int8_t *src) noexcept
+{
+	return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)src));
+}
+
+/**
+ * Load 8 signed 16 bit samples and sign-extend them to 32 bit.
+ */
+AVX2_TARGET
+static inline __m256i
+Avx2Load16(const int16_t *src) noexcept
+{
+	return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+}
+
+AVX2_TARGET
+static inline __m256i
+Avx2Load32(const int32_t *src) noexcept
+{
+	return _mm256_loadu_si256((const __m256i *)src);
+}
+
+AVX2_TARGET
+static inline void
+Avx2Store32(int32_t *dst, __m256i x) noexcept
+{
+	_mm256_storeu_si256((__m256i *)dst, x);
+}
+
+AVX2_TARGET
+static void
+Avx2S8ToS16(int16_t *dst, const int8_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 16; ++i, src += 16, dst += 16) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm256_storeu_si256((__m256i *)dst,
+				    _mm256_slli_epi16(_mm256_cvtepi8_epi16(x), 8));
+	}
+}
+
+AVX2_TARGET
+static void
+Avx2S8ToS24(int32_t *dst, const int8_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2Store32(dst, _mm256_slli_epi32(Avx2Load8(src), 16));
+}
+
+AVX2_TARGET
+static void
+Avx2S8ToS32(int32_t *dst, const int8_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2Store32(dst, _mm256_slli_epi32(Avx2Load8(src), 24));
+}
+
+AVX2_TARGET
+static void
+Avx2S16ToS24(int32_t *dst, const int16_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2Store32(dst, _mm256_slli_epi32(Avx2Load16(src), 8));
+}
+
+AVX2_TARGET
+static void
+Avx2S16ToS32(int32_t *dst, const int16_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2Store32(dst, _mm256_slli_epi32(Avx2Load16(src), 16));
+}
+
+AVX2_TARGET
+static void
+Avx2S24ToS32(int32_t *dst, const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2Store32(dst, _mm256_slli_epi32(Avx2Load32(src), 8));
+}
+
+AVX2_TARGET
+static void
+Avx2S32ToS24(int32_t *dst, const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2Store32(dst, _mm256_srai_epi32(Avx2Load32(src), 8));
+}
+
+AVX2_TARGET
+static void
+Avx2S8ToFloat(float *dst, const int8_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2StoreFloat(dst, Avx2Load8(src), factor_from_8);
+}
+
+AVX2_TARGET
+static void
+Avx2S16ToFloat(float *dst, const int16_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2StoreFloat(dst, Avx2Load16(src), factor_from_16);
+}
+
+AVX2_TARGET
+static void
+Avx2S24ToFloat(float *dst, const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2StoreFloat(dst, Avx2Load32(src), factor_from_24);
+}
+
+AVX2_TARGET
+static void
+Avx2S32ToFloat(float *dst, const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2StoreFloat(dst, Avx2Load32(src), factor_from_32);
+}
+
+AVX2_TARGET
+static void
+Avx2FloatToS16(int16_t *dst, const float *src, size_t n) noexcept
+{
+	using Traits = SampleTraits<SampleFormat::S16>;
+
+	for (size_t i = 0; i < n / 16; ++i, src += 16, dst += 16) {
+		const __m256i a = Avx2FloatToInt(_mm256_loadu_ps(src),
+						 factor_to_16,
+						 Traits::MIN, Traits::MAX);
+		const __m256i b = Avx2FloatToInt(_mm256_loadu_ps(src + 8),
+						 factor_to_16,
+						 Traits::MIN, Traits::MAX);
+
+		/* packs works within each 128 bit lane; restore the
+		   sample order afterwards */
+		const __m256i packed = _mm256_packs_epi32(a, b);
+		_mm256_storeu_si256((__m256i *)dst,
+				    _mm256_permute4x64_epi64(packed, 0xd8));
+	}
+}
+
+AVX2_TARGET
+static void
+Avx2FloatToS24(int32_t *dst, const float *src, size_t n) noexcept
+{
+	using Traits = SampleTraits<SampleFormat::S24_P32>;
+
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2Store32(dst, Avx2FloatToInt(_mm256_loadu_ps(src),
+						factor_to_24,
+						Traits::MIN, Traits::MAX));
+}
+
+AVX2_TARGET
+static void
+Avx2FloatToS32(int32_t *dst, const float *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2Store32(dst, Avx2FloatToInt32(_mm256_loadu_ps(src)));
+}
+
+AVX2_TARGET
+static void
+Avx2VolumeS16ToS24(int32_t *dst, const int16_t *src, size_t n,
+		   int volume) noexcept
+{
+	const __m256i v = _mm256_set1_epi32(volume);
+
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		Avx2Store32(dst,
+			    _mm256_srai_epi32(_mm256_mullo_epi32(Avx2Load16(src), v),
+					      VOLUME_16_TO_24_SHIFT));
+}
+
+AVX2_TARGET
+static void
+Avx2VolumeFloat(float *dst, const float *src, size_t n,
+		float volume) noexcept
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	for (size_t i = 0; i < n / 8; ++i, src += 8, dst += 8)
+		_mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_loadu_ps(src), v));
+}
+
+AVX2_TARGET
+static void
+Avx2AddS8(int8_t *a, const int8_t *b, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 32; ++i, a += 32, b += 32) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)a);
+		const __m256i y = _mm256_loadu_si256((const __m256i *)b);
+		_mm256_storeu_si256((__m256i *)a, _mm256_adds_epi8(x, y));
+	}
+
+	/* BLOCK_SIZE is only half a vector */
+	Sse2AddS8(a, b, n % 32);
+}
+
+AVX2_TARGET
+static void
+Avx2AddS16(int16_t *a, const int16_t *b, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 16; ++i, a += 16, b += 16) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)a);
+		const __m256i y = _mm256_loadu_si256((const __m256i *)b);
+		_mm256_storeu_si256((__m256i *)a, _mm256_adds_epi16(x, y));
+	}
+}
+
+AVX2_TARGET
+static void
+Avx2AddS24(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	using Traits = SampleTraits<SampleFormat::S24_P32>;
+	const __m256i min = _mm256_set1_epi32(Traits::MIN);
+	const __m256i max = _mm256_set1_epi32(Traits::MAX);
+
+	for (size_t i = 0; i < n / 8; ++i, a += 8, b += 8) {
+		__m256i sum = _mm256_add_epi32(Avx2Load32(a), Avx2Load32(b));
+		sum = _mm256_max_epi32(_mm256_min_epi32(sum, max), min);
+		Avx2Store32(a, sum);
+	}
+}
+
+AVX2_TARGET
+static void
+Avx2AddS32(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	const __m256i int_max = _mm256_set1_epi32(INT32_MAX);
+
+	for (size_t i = 0; i < n / 8; ++i, a += 8, b += 8) {
+		const __m256i x = Avx2Load32(a), y = Avx2Load32(b);
+		const __m256i sum = _mm256_add_epi32(x, y);
+
+		/* see Sse2AddS32() */
+		const __m256i overflow =
+			_mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(x, sum),
+							   _mm256_xor_si256(y, sum)),
+					  31);
+		const __m256i saturated =
+			_mm256_xor_si256(_mm256_srai_epi32(x, 31), int_max);
+		Avx2Store32(a, _mm256_blendv_epi8(sum, saturated, overflow));
+	}
+}
+
+AVX2_TARGET
+static void
+Avx2AddFloat(float *a, const float *b, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, a += 8, b += 8)
+		_mm256_storeu_ps(a, _mm256_add_ps(_mm256_loadu_ps(a),
+						  _mm256_loadu_ps(b)));
+}
+
+AVX2_TARGET
+static void
+Avx2MixFloat(float *a, const float *b, size_t n,
+	     float volume1, float volume2) noexcept
+{
+	const __m256 v1 = _mm256_set1_ps(volume1);
+	const __m256 v2 = _mm256_set1_ps(volume2);
+
+	/* no FMA here, to get the same results as the portable
+	   code */
+	for (size_t i = 0; i < n / 8; ++i, a += 8, b += 8)
+		_mm256_storeu_ps(a, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a), v1),
+						  _mm256_mul_ps(_mm256_loadu_ps(b), v2)));
+}
+
+AVX2_TARGET
+static void
+Avx2TpdfNoise(uint32_t lanes[8], int32_t *noise, size_t n,
+	      unsigned bits) noexcept
+{
+	const __m256i mask = _mm256_set1_epi32((1u << bits) - 1);
+	__m256i x = _mm256_loadu_si256((const __m256i *)lanes);
+
+	for (size_t i = 0; i < n / 8; ++i, noise += 8) {
+		x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+		x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+
+		Avx2Store32(noise,
+			    _mm256_sub_epi32(_mm256_and_si256(x, mask),
+					     _mm256_and_si256(_mm256_srli_epi32(x, 16),
+							      mask)));
+	}
+
+	_mm256_storeu_si256((__m256i *)lanes, x);
+}
+
+AVX2_TARGET
+static void
+Avx2TpdfShiftS16(int16_t *dst, const int32_t *src, const int32_t *noise,
+		 size_t n, unsigned _shift) noexcept
+{
+	const __m256i mask = _mm256_set1_epi32((1 << _shift) - 1);
+	const __m256i round = _mm256_set1_epi32(1 << (_shift - 1));
+	const __m128i shift = _mm_cvtsi32_si128(_shift);
+
+	for (size_t i = 0; i < n / 16;
+	     ++i, src += 16, noise += 16, dst += 16) {
+		__m256i x[2];
+		for (unsigned j = 0; j < 2; ++j) {
+			const __m256i v = Avx2Load32(src + 8 * j);
+			const __m256i lo =
+				_mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(v, mask),
+								  round),
+						 Avx2Load32(noise + 8 * j));
+			x[j] = _mm256_add_epi32(_mm256_sra_epi32(v, shift),
+						_mm256_sra_epi32(lo, shift));
+		}
+
+		/* see Avx2FloatToS16() */
+		const __m256i packed = _mm256_packs_epi32(x[0], x[1]);
+		_mm256_storeu_si256((__m256i *)dst,
+				    _mm256_permute4x64_epi64(packed, 0xd8));
+	}
+}
+
+AVX2_TARGET
+static void
+Avx2InterleaveStereo8(uint8_t *dst, const uint8_t *src1,
+		      const uint8_t *src2, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 32; ++i, src1 += 32, src2 += 32, dst += 64) {
+		const __m256i a = _mm256_loadu_si256((const __m256i *)src1);
+		const __m256i b = _mm256_loadu_si256((const __m256i *)src2);
+
+		const __m256i lo = _mm256_unpacklo_epi8(a, b);
+		const __m256i hi = _mm256_unpackhi_epi8(a, b);
+		_mm256_storeu_si256((__m256i *)dst,
+				    _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst + 32),
+				    _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	/* the runtime dispatcher rounds only to #BLOCK_SIZE */
+	if (n % 32 != 0)
+		Sse2InterleaveStereo8(dst, src1, src2, n % 32);
+}
+
+AVX2_TARGET
+static void
+Avx2InterleaveStereo16(int16_t *dst, const int16_t *src1,
+		       const int16_t *src2, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 16; ++i, src1 += 16, src2 += 16, dst += 32) {
+		const __m256i a = _mm256_loadu_si256((const __m256i *)src1);
+		const __m256i b = _mm256_loadu_si256((const __m256i *)src2);
+
+		/* the unpack instructions work within 128 bit lanes;
+		   combine the lanes to restore the frame order */
+		const __m256i lo = _mm256_unpacklo_epi16(a, b);
+		const __m256i hi = _mm256_unpackhi_epi16(a, b);
+		_mm256_storeu_si256((__m256i *)dst,
+				    _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst + 16),
+				    _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+}
+
+AVX2_TARGET
+static void
+Avx2InterleaveStereo32(int32_t *dst, const int32_t *src1,
+		       const int32_t *src2, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src1 += 8, src2 += 8, dst += 16) {
+		const __m256i a = Avx2Load32(src1);
+		const __m256i b = Avx2Load32(src2);
+
+		/* see Avx2InterleaveStereo16() */
+		const __m256i lo = _mm256_unpacklo_epi32(a, b);
+		const __m256i hi = _mm256_unpackhi_epi32(a, b);
+		Avx2Store32(dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+		Avx2Store32(dst + 8, _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+}
+
+/**
+ * Load 8 bytes which are @a STRIDE bytes apart, zero-extended to 32
+ * bit.  This reads up to 3 bytes beyond the last one.
+ */
+template<unsigned STRIDE>
+AVX2_TARGET
+static inline __m256i
+Avx2LoadBytes(const uint8_t *p) noexcept
+{
+	static_assert(STRIDE == 1 || STRIDE == 2 || STRIDE == 4);
+
+	if constexpr (STRIDE == 1) {
+		return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+	} else if constexpr (STRIDE == 2) {
+		/* the low byte of each 16 bit word */
+		const __m128i x = _mm_loadu_si128((const __m128i *)p);
+		return _mm256_and_si256(_mm256_cvtepu16_epi32(x),
+					_mm256_set1_epi32(0xff));
+	} else {
+		/* the low byte of each 32 bit word */
+		return _mm256_and_si256(_mm256_loadu_si256((const __m256i *)p),
+					_mm256_set1_epi32(0xff));
+	}
+}
+
+template<unsigned STRIDE>
+AVX2_TARGET
+static void
+Avx2FilterDsd(float *dst, const float *tables, unsigned n_tables,
+	      const uint8_t *fwd, const uint8_t *rev, size_t n) noexcept
+{
+	/* the second filter half begins with the oldest byte */
+	rev -= 2 * n_tables - 1;
+
+	for (size_t i = 0; i < n / 8;
+	     ++i, fwd += 8 * STRIDE, rev += 8 * STRIDE, dst += 8) {
+		/* 8 consecutive output samples at once: each table
+		   lookup is one gather */
+		__m256 a = _mm256_setzero_ps(), b = _mm256_setzero_ps();
+		for (unsigned t = 0; t < n_tables; ++t) {
+			const float *table = tables + t * 256;
+			a = _mm256_add_ps(a, _mm256_i32gather_ps(table,
+								 Avx2LoadBytes<STRIDE>(fwd - t),
+								 4));
+			b = _mm256_add_ps(b, _mm256_i32gather_ps(table,
+								 Avx2LoadBytes<STRIDE>(rev + t),
+								 4));
+		}
+
+		_mm256_storeu_ps(dst, _mm256_add_ps(a, b));
+	}
+}
+
+static void
+Sse2DeinterleaveStereo32(int32_t *dst1, int32_t *dst2,
+			 const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 4; ++i, src += 8, dst1 += 4, dst2 += 4) {
+		const __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)src));
+		const __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + 4)));
+		_mm_storeu_si128((__m128i *)dst1,
+				 _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+		_mm_storeu_si128((__m128i *)dst2,
+				 _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+	}
+}
+
+AVX2_TARGET
+static void
+Avx2DeinterleaveStereo32(int32_t *dst1, int32_t *dst2,
+			 const int32_t *src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n / 8; ++i, src += 16, dst1 += 8, dst2 += 8) {
+		const __m256 a = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *)src));
+		const __m256 b = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *)(src + 8)));
+
+		/* the shuffle works within 128 bit lanes; reorder the
+		   64 bit pairs afterwards */
+		const __m256i l = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		const __m256i r = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm256_storeu_si256((__m256i *)dst1,
+				    _mm256_permute4x64_epi64(l, _MM_SHUFFLE(3, 1, 2, 0)));
+		_mm256_storeu_si256((__m256i *)dst2,
+				    _mm256_permute4x64_epi64(r, _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+}
+
+/*
+ * bit reversal
+ *
+ */
+
+/**
+ * Swap the bit groups selected by @a mask with their neighbours
+ * @a shift bits above.  The 16 bit shifts cannot carry bits into the
+ * neighbouring byte, because the mask clears them first.
+ */
+template<int shift>
+static inline __m128i
+Sse2SwapBits(__m128i x, __m128i mask) noexcept
+{
+	return _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, shift), mask),
+			    _mm_slli_epi16(_mm_and_si128(x, mask), shift));
+}
+
+static void
+Sse2BitReverse(uint8_t *dst, const uint8_t *src, size_t n) noexcept
+{
+	const __m128i m4 = _mm_set1_epi8(0x0f);
+	const __m128i m2 = _mm_set1_epi8(0x33);
+	const __m128i m1 = _mm_set1_epi8(0x55);
+
+	for (size_t i = 0; i < n / 16; ++i, src += 16, dst += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)src);
+		x = Sse2SwapBits<4>(x, m4);
+		x = Sse2SwapBits<2>(x, m2);
+		x = Sse2SwapBits<1>(x, m1);
+		_mm_storeu_si128((__m128i *)dst, x);
+	}
+}
+
+/**
+ * Reverse the bits with two nibble lookups (VPSHUFB).
+ */
+AVX2_TARGET
+static void
+Avx2BitReverse(uint8_t *dst, const uint8_t *src, size_t n) noexcept
+{
+	/* the reversed nibbles, once shifted to the high half */
+	const __m256i lut_lo = _mm256_setr_epi8(
+		0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+		0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+		0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+		0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0);
+	const __m256i lut_hi = _mm256_setr_epi8(
+		0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+		0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,
+		0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+		0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+	const __m256i m4 = _mm256_set1_epi8(0x0f);
+
+	for (size_t i = 0; i < n / 32; ++i, src += 32, dst += 32) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		const __m256i lo = _mm256_and_si256(x, m4);
+		const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4),
+						    m4);
+		_mm256_storeu_si256((__m256i *)dst,
+				    _mm256_or_si256(_mm256_shuffle_epi8(lut_lo, lo),
+						    _mm256_shuffle_epi8(lut_hi, hi)));
+	}
+
+	if (n % 32 != 0)
+		Sse2BitReverse(dst, src, n % 32);
+}
+
+/*
+ * runtime dispatch
+ *
+ */
+
+static bool
+HaveAvx2() noexcept
+{
+	static const bool value = (__builtin_cpu_init(),
+				   __builtin_cpu_supports("avx2"));
+	return value;
+}
+
+/* the kernels above process only whole vectors; round down to full
+   blocks so all of them leave the same tail to the caller */
+#define X86_CONVERT_DISPATCH(name, DT, ST) \
+	void X86Convert::name(DT *dst, const ST *src, size_t n) noexcept { \
+		n -= n % BLOCK_SIZE; \
+		if (HaveAvx2()) \
+			Avx2 ## name(dst, src, n); \
+		else \
+			Sse2 ## name(dst, src, n); \
+	}
+
+X86_CONVERT_DISPATCH(S8ToS16, int16_t, int8_t)
+X86_CONVERT_DISPATCH(S8ToS24, int32_t, int8_t)
+X86_CONVERT_DISPATCH(S8ToS32, int32_t, int8_t)
+X86_CONVERT_DISPATCH(S16ToS24, int32_t, int16_t)
+X86_CONVERT_DISPATCH(S16ToS32, int32_t, int16_t)
+X86_CONVERT_DISPATCH(S24ToS32, int32_t, int32_t)
+X86_CONVERT_DISPATCH(S32ToS24, int32_t, int32_t)
+X86_CONVERT_DISPATCH(S8ToFloat, float, int8_t)
+X86_CONVERT_DISPATCH(S16ToFloat, float, int16_t)
+X86_CONVERT_DISPATCH(S24ToFloat, float, int32_t)
+X86_CONVERT_DISPATCH(S32ToFloat, float, int32_t)
+X86_CONVERT_DISPATCH(FloatToS16, int16_t, float)
+X86_CONVERT_DISPATCH(FloatToS24, int32_t, float)
+X86_CONVERT_DISPATCH(FloatToS32, int32_t, float)
+
+#define X86_VOLUME_DISPATCH(name, DT, ST, VT) \
+	void X86Convert::name(DT *dst, const ST *src, size_t n, \
+			      VT volume) noexcept { \
+		n -= n % BLOCK_SIZE; \
+		if (HaveAvx2()) \
+			Avx2 ## name(dst, src, n, volume); \
+		else \
+			Sse2 ## name(dst, src, n, volume); \
+	}
+
+X86_VOLUME_DISPATCH(VolumeS16ToS24, int32_t, int16_t, int)
+X86_VOLUME_DISPATCH(VolumeFloat, float, float, float)
+
+void
+X86Convert::TpdfNoise(uint32_t lanes[8], int32_t *noise, size_t n,
+		      unsigned bits) noexcept
+{
+	if (HaveAvx2())
+		Avx2TpdfNoise(lanes, noise, n, bits);
+	else
+		Sse2TpdfNoise(lanes, noise, n, bits);
+}
+
+void
+X86Convert::TpdfShiftS16(int16_t *dst, const int32_t *src,
+			 const int32_t *noise, size_t n,
+			 unsigned shift) noexcept
+{
+	n -= n % BLOCK_SIZE;
+	if (HaveAvx2())
+		Avx2TpdfShiftS16(dst, src, noise, n, shift);
+	else
+		Sse2TpdfShiftS16(dst, src, noise, n, shift);
+}
+
+#define X86_ADD_DISPATCH(name, T) \
+	void X86Convert::name(T *a, const T *b, size_t n) noexcept { \
+		n -= n % BLOCK_SIZE; \
+		if (HaveAvx2()) \
+			Avx2 ## name(a, b, n); \
+		else \
+			Sse2 ## name(a, b, n); \
+	}
+
+X86_ADD_DISPATCH(AddS8, int8_t)
+X86_ADD_DISPATCH(AddS16, int16_t)
+X86_ADD_DISPATCH(AddS24, int32_t)
+X86_ADD_DISPATCH(AddS32, int32_t)
+X86_ADD_DISPATCH(AddFloat, float)
+
+void
+X86Convert::MixFloat(float *a, const float *b, size_t n,
+		     float volume1, float volume2) noexcept
+{
+	n -= n % BLOCK_SIZE;
+	if (HaveAvx2())
+		Avx2MixFloat(a, b, n, volume1, volume2);
+	else
+		Sse2MixFloat(a, b, n, volume1, volume2);
+}
+
+#define X86_INTERLEAVE_DISPATCH(name, T) \
+	void X86Convert::name(T *dst, const T *src1, const T *src2, \
+			      size_t n) noexcept { \
+		n -= n % BLOCK_SIZE; \
+		if (HaveAvx2()) \
+			Avx2 ## name(dst, src1, src2, n); \
+		else \
+			Sse2 ## name(dst, src1, src2, n); \
+	}
+
+X86_INTERLEAVE_DISPATCH(InterleaveStereo8, uint8_t)
+X86_INTERLEAVE_DISPATCH(InterleaveStereo16, int16_t)
+X86_INTERLEAVE_DISPATCH(InterleaveStereo32, int32_t)
+
+void
+X86Convert::DeinterleaveStereo32(int32_t *dst1, int32_t *dst2,
+				 const int32_t *src, size_t n) noexcept
+{
+	n -= n % BLOCK_SIZE;
+	if (HaveAvx2())
+		Avx2DeinterleaveStereo32(dst1, dst2, src, n);
+	else
+		Sse2DeinterleaveStereo32(dst1, dst2, src, n);
+}
+
+void
+X86Convert::BitReverse(uint8_t *dst, const uint8_t *src, size_t n) noexcept
+{
+	n -= n % BLOCK_SIZE;
+	if (HaveAvx2())
+		Avx2BitReverse(dst, src, n);
+	else
+		Sse2BitReverse(dst, src, n);
+}
+
+size_t
+X86Convert::FilterDsd(float *dst, const float *tables, unsigned n_tables,
+		      const uint8_t *fwd, const uint8_t *rev, unsigned stride,
+		      size_t n) noexcept
+{
+	/* without AVX2, there is no gather instruction, and SSE2
+	   cannot beat the portable loop */
+	if (!HaveAvx2())
+		return 0;
+
+	n -= n % 8;
+
+	switch (stride) {
+	case 1:
+		Avx2FilterDsd<1>(dst, tables, n_tables, fwd, rev, n);
+		break;
+
+	case 2:
+		Avx2FilterDsd<2>(dst, tables, n_tables, fwd, rev, n);
+		break;
+
+	case 4:
+		Avx2FilterDsd<4>(dst, tables, n_tables, fwd, rev, n);
+		break;
+
+	default:
+		return 0;
+	}
+
+	return n;
+}
+
+#endif
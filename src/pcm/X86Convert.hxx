@@ -0,0 +1,166 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_X86_CONVERT_HXX
+#define MPD_PCM_X86_CONVERT_HXX
+
+#include "Traits.hxx"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sample format converters for x86 using SSE2 and (if the CPU
+ * supports it, which is checked at runtime) AVX2.  They produce
+ * exactly the same results as the portable implementations in
+ * ShiftConvert.hxx and FloatConvert.hxx.
+ *
+ * Each function converts only full blocks of #BLOCK_SIZE samples
+ * and leaves the rest to the caller; this is what
+ * GlueOptimizedConvert expects.
+ */
+
+namespace X86Convert {
+
+static constexpr size_t BLOCK_SIZE = 16;
+
+void S8ToS16(int16_t *dst, const int8_t *src, size_t n) noexcept;
+void S8ToS24(int32_t *dst, const int8_t *src, size_t n) noexcept;
+void S8ToS32(int32_t *dst, const int8_t *src, size_t n) noexcept;
+void S16ToS24(int32_t *dst, const int16_t *src, size_t n) noexcept;
+void S16ToS32(int32_t *dst, const int16_t *src, size_t n) noexcept;
+void S24ToS32(int32_t *dst, const int32_t *src, size_t n) noexcept;
+void S32ToS24(int32_t *dst, const int32_t *src, size_t n) noexcept;
+
+void S8ToFloat(float *dst, const int8_t *src, size_t n) noexcept;
+void S16ToFloat(float *dst, const int16_t *src, size_t n) noexcept;
+void S24ToFloat(float *dst, const int32_t *src, size_t n) noexcept;
+void S32ToFloat(float *dst, const int32_t *src, size_t n) noexcept;
+
+void FloatToS16(int16_t *dst, const float *src, size_t n) noexcept;
+void FloatToS24(int32_t *dst, const float *src, size_t n) noexcept;
+void FloatToS32(int32_t *dst, const float *src, size_t n) noexcept;
+
+/**
+ * Apply software volume, converting S16 to S24_P32 (see
+ * PcmVolumeConvert()).
+ */
+void VolumeS16ToS24(int32_t *dst, const int16_t *src, size_t n,
+		    int volume) noexcept;
+
+/**
+ * Apply software volume to floating point samples.
+ */
+void VolumeFloat(float *dst, const float *src, size_t n,
+		 float volume) noexcept;
+
+/*
+ * Add @a b to @a a, clamping the results (see PcmAdd() in Mix.cxx).
+ */
+void AddS8(int8_t *a, const int8_t *b, size_t n) noexcept;
+void AddS16(int16_t *a, const int16_t *b, size_t n) noexcept;
+void AddS24(int32_t *a, const int32_t *b, size_t n) noexcept;
+void AddS32(int32_t *a, const int32_t *b, size_t n) noexcept;
+void AddFloat(float *a, const float *b, size_t n) noexcept;
+
+/**
+ * a := a * volume1 + b * volume2
+ */
+void MixFloat(float *a, const float *b, size_t n,
+	      float volume1, float volume2) noexcept;
+
+/**
+ * Generate TPDF dither noise with 8 xorshift32 lanes (see
+ * PcmDither::FillTpdfNoise()).  Unlike the other functions, this one
+ * handles all of the @a n values, which must be a multiple of 8.
+ */
+void TpdfNoise(uint32_t lanes[8], int32_t *noise, size_t n,
+	       unsigned bits) noexcept;
+
+/**
+ * Add noise and rounding to 32 bit samples, shift them right and
+ * clamp to 16 bit (see PortableTpdfShiftS16() in Dither.cxx).
+ */
+void TpdfShiftS16(int16_t *dst, const int32_t *src, const int32_t *noise,
+		  size_t n, unsigned shift) noexcept;
+
+/*
+ * Interleave two channels of @a n frames each (see
+ * PcmInterleaveStereo() in Interleave.cxx).
+ */
+void InterleaveStereo8(uint8_t *dst, const uint8_t *src1,
+		       const uint8_t *src2, size_t n) noexcept;
+void InterleaveStereo16(int16_t *dst, const int16_t *src1,
+			const int16_t *src2, size_t n) noexcept;
+void InterleaveStereo32(int32_t *dst, const int32_t *src1,
+			const int32_t *src2, size_t n) noexcept;
+
+/**
+ * Split @a n stereo frames into two channels (see
+ * PcmDeinterleaveStereo() in Interleave.cxx).
+ */
+void DeinterleaveStereo32(int32_t *dst1, int32_t *dst2,
+			  const int32_t *src, size_t n) noexcept;
+
+/**
+ * Reverse the bit order of @a n bytes (see PcmBitReverse() in
+ * BitReverse.cxx).  @a dst may be equal to @a src.
+ */
+void BitReverse(uint8_t *dst, const uint8_t *src, size_t n) noexcept;
+
+/**
+ * Evaluate the table-driven DSD lowpass filter for @a n output
+ * samples of one channel (see PortableFilterDsd() in PcmDsd.cxx)
+ * using AVX2 gather instructions.
+ *
+ * @return the number of output samples which were generated; this
+ * is a multiple of 8, and 0 if the CPU does not support AVX2
+ */
+size_t FilterDsd(float *dst, const float *tables, unsigned n_tables,
+		 const uint8_t *fwd, const uint8_t *rev, unsigned stride,
+		 size_t n) noexcept;
+
+}
+
+/**
+ * Adapter which makes one of the #X86Convert functions usable as the
+ * "optimized" parameter of GlueOptimizedConvert.
+ *
+ * @param P the portable implementation which provides the sample
+ * traits
+ */
+template<typename P,
+	 void (*F)(typename P::DstTraits::pointer_type,
+		   typename P::SrcTraits::const_pointer_type,
+		   size_t) noexcept>
+struct X86ConvertWrapper {
+	typedef typename P::SrcTraits SrcTraits;
+	typedef typename P::DstTraits DstTraits;
+
+	static constexpr size_t BLOCK_SIZE = X86Convert::BLOCK_SIZE;
+
+	void Convert(typename DstTraits::pointer_type dst,
+		     typename SrcTraits::const_pointer_type src,
+		     size_t n) const noexcept {
+		F(dst, src, n);
+	}
+};
+
+#endif
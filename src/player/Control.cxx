@@ -21,6 +21,10 @@
 #include "Outputs.hxx"
 #include "Idle.hxx"
 #include "song/DetachedSong.hxx"
+#include "decoder/Control.hxx"
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
 
 #include <algorithm>
 
@@ -30,11 +34,13 @@ PlayerControl::PlayerControl(PlayerListener &_listener,
 			     PlayerOutputs &_outputs,
 			     InputCacheManager *_input_cache,
 			     unsigned _buffer_chunks,
+			     size_t _buffer_chunk_size,
 			     AudioFormat _configured_audio_format,
 			     const ReplayGainConfig &_replay_gain_config) noexcept
 	:listener(_listener), outputs(_outputs),
 	 input_cache(_input_cache),
 	 buffer_chunks(_buffer_chunks),
+	 buffer_chunk_size(_buffer_chunk_size),
 	 configured_audio_format(_configured_audio_format),
 	 thread(BIND_THIS_METHOD(RunThread)),
 	 replay_gain_config(_replay_gain_config)
@@ -186,6 +192,43 @@ PlayerControl::LockGetStatus() noexcept
 	return status;
 }
 
+PlayerMetrics
+PlayerControl::LockGetMetrics() const noexcept
+{
+	PlayerMetrics metrics;
+	metrics.buffer_size = buffer_chunks;
+	metrics.buffer_used = 0;
+	metrics.buffer_chunk_memory = sizeof(MusicChunk) + buffer_chunk_size;
+	metrics.pipe_size = 0;
+	metrics.decoder_cpu_time = std::chrono::nanoseconds(-1);
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (metrics_buffer != nullptr)
+		metrics.buffer_used = metrics_buffer->GetAllocated();
+
+	if (metrics_dc != nullptr) {
+		/* DecoderControl::mutex is the same as ours */
+		if (metrics_dc->pipe != nullptr)
+			metrics.pipe_size = metrics_dc->pipe->GetSize();
+
+		metrics.decoder_cpu_time = metrics_dc->GetCPUTime();
+	}
+
+	return metrics;
+}
+
+DecoderStats
+PlayerControl::LockGetDecoderStats() const noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	/* DecoderControl::mutex is the same as ours */
+	return metrics_dc != nullptr
+		? metrics_dc->stats
+		: DecoderStats();
+}
+
 void
 PlayerControl::SetError(PlayerError type, std::exception_ptr &&_error) noexcept
 {
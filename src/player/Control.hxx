@@ -30,7 +30,9 @@
 #include "ReplayGainConfig.hxx"
 #include "ReplayGainMode.hxx"
 #include "MusicChunkPtr.hxx"
+#include "decoder/Stats.hxx"
 
+#include <chrono>
 #include <exception>
 #include <memory>
 
@@ -41,6 +43,8 @@ class PlayerListener;
 class PlayerOutputs;
 class InputCacheManager;
 class DetachedSong;
+class DecoderControl;
+class MusicBuffer;
 
 enum class PlayerState : uint8_t {
 	STOP,
@@ -102,6 +106,35 @@ enum class PlayerError : uint8_t {
 	OUTPUT,
 };
 
+/**
+ * Internal statistics of the player, see
+ * PlayerControl::LockGetMetrics().
+ */
+struct PlayerMetrics {
+	/**
+	 * The size of the #MusicBuffer and the number of chunks which
+	 * are currently in use.
+	 */
+	unsigned buffer_size, buffer_used;
+
+	/**
+	 * The number of bytes occupied by one chunk of the
+	 * #MusicBuffer, including its audio data.
+	 */
+	size_t buffer_chunk_memory;
+
+	/**
+	 * The number of chunks in the decoder's #MusicPipe.
+	 */
+	unsigned pipe_size;
+
+	/**
+	 * The CPU time consumed by the decoder thread; negative if
+	 * unknown.
+	 */
+	std::chrono::nanoseconds decoder_cpu_time;
+};
+
 struct PlayerStatus {
 	PlayerState state;
 	uint16_t bit_rate;
@@ -121,11 +154,57 @@ class PlayerControl final : public AudioOutputClient {
 
 	const unsigned buffer_chunks;
 
+	/**
+	 * The number of data bytes in each #MusicChunk, see
+	 * MusicChunkSizeForBuffer().
+	 */
+	const size_t buffer_chunk_size;
+
 	/**
 	 * The "audio_output_format" setting.
 	 */
 	const AudioFormat configured_audio_format;
 
+public:
+	/**
+	 * Use the low-latency profile ("low_latency")?  This
+	 * minimizes buffering before playback starts, and gives the
+	 * decoder thread real-time scheduling.  It must be set
+	 * before the player thread is started.
+	 */
+	bool low_latency = false;
+
+	/**
+	 * Fault in the #MusicBuffer and lock it into RAM
+	 * ("lock_memory"), so the real-time threads never have to
+	 * wait for a page fault.  It must be set before the player
+	 * thread is started.
+	 */
+	bool lock_memory = false;
+
+	/**
+	 * Start a second decoder thread which opens and decodes the
+	 * next song while the current one is still being decoded
+	 * ("lookahead_decoder")?  It must be set before the player
+	 * thread is started.
+	 */
+	bool lookahead_decoder = false;
+
+	/**
+	 * Convert all PCM data to floating point in the decoder
+	 * ("float_pipeline")?  It must be set before the player
+	 * thread is started.
+	 */
+	bool float_pipeline = false;
+
+	/**
+	 * Share one decoder with all other partitions playing the
+	 * same remote stream ("shared_decoder")?  It must be set
+	 * before the player thread is started.
+	 */
+	bool shared_decoder = false;
+
+private:
 	/**
 	 * The handle of the player thread.
 	 */
@@ -234,11 +313,20 @@ class PlayerControl final : public AudioOutputClient {
 
 	FloatDuration total_play_time = FloatDuration::zero();
 
+	/**
+	 * The player thread's #DecoderControl and #MusicBuffer; used
+	 * by LockGetMetrics().  Protected by #mutex.  They are
+	 * nullptr while the player thread is not running.
+	 */
+	const DecoderControl *metrics_dc = nullptr;
+	const MusicBuffer *metrics_buffer = nullptr;
+
 public:
 	PlayerControl(PlayerListener &_listener,
 		      PlayerOutputs &_outputs,
 		      InputCacheManager *_input_cache,
 		      unsigned buffer_chunks,
+		      size_t buffer_chunk_size,
 		      AudioFormat _configured_audio_format,
 		      const ReplayGainConfig &_replay_gain_config) noexcept;
 	~PlayerControl() noexcept;
@@ -349,6 +437,18 @@ public:
 		return total_play_time;
 	}
 
+	gcc_pure
+	PlayerMetrics LockGetMetrics() const noexcept;
+
+	/**
+	 * Returns the resource accounting of the song which is
+	 * currently (or was most recently) decoded.  The result is
+	 * undefined (see DecoderStats::IsDefined()) if the player
+	 * thread is not running.
+	 */
+	gcc_pure
+	DecoderStats LockGetDecoderStats() const noexcept;
+
 private:
 	/**
 	 * Signals the object.  The object should be locked prior to
@@ -19,9 +19,8 @@
 
 #include "CrossFade.hxx"
 #include "Chrono.hxx"
-#include "MusicChunk.hxx"
 #include "AudioFormat.hxx"
-#include "util/NumberParser.hxx"
+#include "MixRampInfo.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
@@ -33,34 +32,18 @@ static constexpr Domain cross_fade_domain("cross_fade");
 
 gcc_pure
 static FloatDuration
-mixramp_interpolate(const char *ramp_list, float required_db) noexcept
+mixramp_interpolate(const MixRampCurve &curve, float required_db) noexcept
 {
 	float last_db = 0;
 	FloatDuration last_duration = FloatDuration::zero();
 	bool have_last = false;
 
-	/* ramp_list is a string of pairs of dBs and seconds that describe the
-	 * volume profile. Delimiters are semi-colons between pairs and spaces
-	 * between the dB and seconds of a pair.
-	 * The dB values must be monotonically increasing for this to work. */
+	/* the curve describes the volume profile; the dB values
+	 * must be monotonically increasing for this to work */
 
-	while (1) {
-		/* Parse the dB value. */
-		char *endptr;
-		const float db = ParseFloat(ramp_list, &endptr);
-		if (endptr == ramp_list || *endptr != ' ')
-			break;
-
-		ramp_list = endptr + 1;
-
-		/* Parse the time. */
-		FloatDuration duration{ParseFloat(ramp_list, &endptr)};
-		if (endptr == ramp_list || (*endptr != ';' && *endptr != 0))
-			break;
-
-		ramp_list = endptr;
-		if (*ramp_list == ';')
-			++ramp_list;
+	for (const auto &point : curve.GetPoints()) {
+		const float db = point.db;
+		auto duration = point.time;
 
 		/* Check for exact match. */
 		if (db == required_db) {
@@ -90,9 +73,11 @@ mixramp_interpolate(const char *ramp_list, float required_db) noexcept
 unsigned
 CrossFadeSettings::Calculate(SignedSongTime total_time,
 			     float replay_gain_db, float replay_gain_prev_db,
-			     const char *mixramp_start, const char *mixramp_prev_end,
+			     const MixRampCurve &mixramp_start,
+			     const MixRampCurve &mixramp_prev_end,
 			     const AudioFormat af,
 			     const AudioFormat old_format,
+			     size_t chunk_size,
 			     unsigned max_chunks) const noexcept
 {
 	unsigned int chunks = 0;
@@ -108,10 +93,10 @@ CrossFadeSettings::Calculate(SignedSongTime total_time,
 	assert(af.IsValid());
 
 	const auto chunk_duration =
-		af.SizeToTime<FloatDuration>(sizeof(MusicChunk::data));
+		af.SizeToTime<FloatDuration>(chunk_size);
 
 	if (mixramp_delay <= FloatDuration::zero() ||
-	    !mixramp_start || !mixramp_prev_end) {
+	    !mixramp_start.IsDefined() || !mixramp_prev_end.IsDefined()) {
 		chunks = std::lround(duration / chunk_duration);
 	} else {
 		/* Calculate mixramp overlap. */
@@ -23,8 +23,11 @@
 #include "Chrono.hxx"
 #include "util/Compiler.h"
 
+#include <stddef.h>
+
 struct AudioFormat;
 class SignedSongTime;
+class MixRampCurve;
 
 struct CrossFadeSettings {
 	/**
@@ -57,6 +60,7 @@ struct CrossFadeSettings {
 	 * @param mixramp_prev_end the last songs mixramp_end setting
 	 * @param af the audio format of the new song
 	 * @param old_format the audio format of the current song
+	 * @param chunk_size the number of data bytes in each chunk
 	 * @param max_chunks the maximum number of chunks
 	 * @return the number of chunks for crossfading, or 0 if cross fading
 	 * should be disabled for this song change
@@ -64,9 +68,10 @@ struct CrossFadeSettings {
 	gcc_pure
 	unsigned Calculate(SignedSongTime total_time,
 			   float replay_gain_db, float replay_gain_prev_db,
-			   const char *mixramp_start,
-			   const char *mixramp_prev_end,
+			   const MixRampCurve &mixramp_start,
+			   const MixRampCurve &mixramp_prev_end,
 			   AudioFormat af, AudioFormat old_format,
+			   size_t chunk_size,
 			   unsigned max_chunks) const noexcept;
 };
 
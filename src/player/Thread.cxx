@@ -48,8 +48,10 @@
 #include "Idle.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
+#include "thread/Scheduling.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
 #include <exception>
 #include <memory>
 
@@ -63,10 +65,29 @@ static constexpr Domain player_domain("player");
  */
 static constexpr auto buffer_before_play_duration = std::chrono::seconds(1);
 
+/**
+ * Like #buffer_before_play_duration, but for the low-latency profile
+ * (PlayerControl::low_latency).
+ */
+static constexpr auto low_latency_buffer_before_play_duration =
+	std::chrono::milliseconds(5);
+
 class Player {
 	PlayerControl &pc;
 
-	DecoderControl &dc;
+	/**
+	 * The decoder which is decoding the current song (or has
+	 * already begun decoding the next one).
+	 */
+	DecoderControl *dc;
+
+	/**
+	 * The look-ahead decoder ("lookahead_decoder"), or nullptr if
+	 * disabled.  While #dc is still busy with the current song,
+	 * this one opens the queued song and decodes it into its own
+	 * #MusicPipe; when #dc finishes, both are exchanged.
+	 */
+	DecoderControl *lookahead_dc;
 
 	MusicBuffer &buffer;
 
@@ -82,7 +103,7 @@ class Player {
 	 * postponed, and sent to the output thread when the new song
 	 * really begins.
 	 */
-	std::unique_ptr<Tag> cross_fade_tag;
+	std::shared_ptr<const Tag> cross_fade_tag;
 
 	/**
 	 * Start playback as soon as this number of chunks has been
@@ -101,6 +122,14 @@ class Player {
 	 */
 	const unsigned decoder_wakeup_threshold;
 
+	/**
+	 * The maximum number of chunks the look-ahead decoder may
+	 * fill into its pipe before the current song's decoder has
+	 * finished.  This ensures that it does not steal too much of
+	 * the #MusicBuffer.
+	 */
+	const unsigned lookahead_chunks;
+
 	/**
 	 * Are we waiting for #buffer_before_play?
 	 */
@@ -196,9 +225,12 @@ class Player {
 
 public:
 	Player(PlayerControl &_pc, DecoderControl &_dc,
+	       DecoderControl *_lookahead_dc,
 	       MusicBuffer &_buffer) noexcept
-		:pc(_pc), dc(_dc), buffer(_buffer),
-		 decoder_wakeup_threshold(buffer.GetSize() * 3 / 4)
+		:pc(_pc), dc(&_dc), lookahead_dc(_lookahead_dc),
+		 buffer(_buffer),
+		 decoder_wakeup_threshold(buffer.GetSize() * 3 / 4),
+		 lookahead_chunks(std::max(buffer.GetSize() / 8, 1U))
 	{
 	}
 
@@ -217,13 +249,23 @@ private:
 		pipe = std::forward<P>(_pipe);
 	}
 
+	/**
+	 * Start the given decoder on PlayerControl::next_song.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void StartDecoder(DecoderControl &_dc, std::unique_lock<Mutex> &lock,
+			  std::shared_ptr<MusicPipe> pipe) noexcept;
+
 	/**
 	 * Start the decoder.
 	 *
 	 * Caller must lock the mutex.
 	 */
 	void StartDecoder(std::unique_lock<Mutex> &lock,
-			  std::shared_ptr<MusicPipe> pipe) noexcept;
+			  std::shared_ptr<MusicPipe> _pipe) noexcept {
+		StartDecoder(*dc, lock, std::move(_pipe));
+	}
 
 	/**
 	 * The decoder has acknowledged the "START" command (see
@@ -245,6 +287,39 @@ private:
 	 */
 	void StopDecoder(std::unique_lock<Mutex> &lock) noexcept;
 
+	/**
+	 * Is the look-ahead decoder busy with the queued song?
+	 */
+	gcc_pure
+	bool IsLookAheadActive() const noexcept {
+		return lookahead_dc != nullptr && lookahead_dc->pipe != nullptr;
+	}
+
+	/**
+	 * Start the look-ahead decoder on the queued song, while #dc
+	 * is still decoding the current one.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void StartLookAhead(std::unique_lock<Mutex> &lock) noexcept;
+
+	/**
+	 * Stop the look-ahead decoder (if it is active) and clear
+	 * (and free) its music pipe.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void StopLookAhead(std::unique_lock<Mutex> &lock) noexcept;
+
+	/**
+	 * The decoder has finished the current song; promote the
+	 * look-ahead decoder, which is already decoding the next
+	 * song.  After that, IsDecoderAtNextSong() returns true.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void SwapLookAhead() noexcept;
+
 	/**
 	 * Is the decoder still busy on the same song as the player?
 	 *
@@ -255,7 +330,7 @@ private:
 	bool IsDecoderAtCurrentSong() const noexcept {
 		assert(pipe != nullptr);
 
-		return dc.pipe == pipe;
+		return dc->pipe == pipe;
 	}
 
 	/**
@@ -265,7 +340,7 @@ private:
 	 */
 	gcc_pure
 	bool IsDecoderAtNextSong() const noexcept {
-		return dc.pipe != nullptr && !IsDecoderAtCurrentSong();
+		return dc->pipe != nullptr && !IsDecoderAtCurrentSong();
 	}
 
 	/**
@@ -365,20 +440,20 @@ public:
 };
 
 void
-Player::StartDecoder(std::unique_lock<Mutex> &lock,
+Player::StartDecoder(DecoderControl &_dc, std::unique_lock<Mutex> &lock,
 		     std::shared_ptr<MusicPipe> _pipe) noexcept
 {
 	assert(queued || pc.command == PlayerCommand::SEEK);
 	assert(pc.next_song != nullptr);
 
 	/* copy ReplayGain parameters to the decoder */
-	dc.replay_gain_mode = pc.replay_gain_mode;
+	_dc.replay_gain_mode = pc.replay_gain_mode;
 
 	SongTime start_time = pc.next_song->GetStartTime() + pc.seek_time;
 
-	dc.Start(lock, std::make_unique<DetachedSong>(*pc.next_song),
-		 start_time, pc.next_song->GetEndTime(),
-		 buffer, std::move(_pipe));
+	_dc.Start(lock, std::make_unique<DetachedSong>(*pc.next_song),
+		  start_time, pc.next_song->GetEndTime(),
+		  buffer, std::move(_pipe));
 }
 
 void
@@ -386,13 +461,13 @@ Player::StopDecoder(std::unique_lock<Mutex> &lock) noexcept
 {
 	const PlayerControl::ScopeOccupied occupied(pc);
 
-	dc.Stop(lock);
+	dc->Stop(lock);
 
-	if (dc.pipe != nullptr) {
+	if (dc->pipe != nullptr) {
 		/* clear and free the decoder pipe */
 
-		dc.pipe->Clear();
-		dc.pipe.reset();
+		dc->pipe->Clear();
+		dc->pipe.reset();
 
 		/* just in case we've been cross-fading: cancel it
 		   now, because we just deleted the new song's decoder
@@ -401,11 +476,66 @@ Player::StopDecoder(std::unique_lock<Mutex> &lock) noexcept
 	}
 }
 
+void
+Player::StartLookAhead(std::unique_lock<Mutex> &lock) noexcept
+{
+	assert(queued);
+	assert(lookahead_dc != nullptr);
+	assert(!IsLookAheadActive());
+	assert(!dc->IsIdle());
+	assert(IsDecoderAtCurrentSong());
+
+	/* pretend the look-ahead decoder has decoded the current
+	   song; this becomes the "previous" MixRamp/ReplayGain
+	   information for the cross-fade calculation */
+	lookahead_dc->InheritMixRamp(*dc);
+	lookahead_dc->pipe_limit = lookahead_chunks;
+
+	StartDecoder(*lookahead_dc, lock, std::make_shared<MusicPipe>());
+}
+
+void
+Player::StopLookAhead(std::unique_lock<Mutex> &lock) noexcept
+{
+	if (!IsLookAheadActive())
+		return;
+
+	const PlayerControl::ScopeOccupied occupied(pc);
+
+	lookahead_dc->Stop(lock);
+
+	lookahead_dc->pipe->Clear();
+	lookahead_dc->pipe.reset();
+}
+
+inline void
+Player::SwapLookAhead() noexcept
+{
+	assert(IsLookAheadActive());
+	assert(dc->IsIdle());
+	assert(IsDecoderAtCurrentSong());
+
+	/* the current song's pipe is owned by #pipe; the old decoder
+	   doesn't need to know it anymore, and any error which
+	   occurred after startup is ignored, just like
+	   DecoderControl::Start() would */
+	dc->pipe.reset();
+	dc->ClearError();
+
+	std::swap(dc, lookahead_dc);
+	pc.metrics_dc = dc;
+
+	/* lift the look-ahead restriction and wake up the decoder,
+	   which may be waiting for it */
+	dc->pipe_limit = 0;
+	dc->Signal();
+}
+
 bool
 Player::ForwardDecoderError() noexcept
 {
 	try {
-		dc.CheckRethrowError();
+		dc->CheckRethrowError();
 	} catch (...) {
 		pc.SetError(PlayerError::DECODER, std::current_exception());
 		return false;
@@ -511,26 +641,32 @@ Player::CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept
 	if (!ForwardDecoderError()) {
 		/* the decoder failed */
 		return false;
-	} else if (!dc.IsStarting()) {
+	} else if (!dc->IsStarting()) {
 		/* the decoder is ready and ok */
 
 		if (output_open &&
+		    dc->out_audio_format != play_audio_format &&
 		    !pc.WaitOutputConsumed(lock, 1))
-			/* the output devices havn't finished playing
-			   all chunks yet - wait for that */
+			/* the audio format changes, and the output
+			   devices havn't finished playing all chunks
+			   yet - wait for that before reopening them;
+			   with the same format, the new song's chunks
+			   are queued right behind the old ones
+			   (gapless) */
 			return true;
 
-		pc.total_time = real_song_duration(*dc.song,
-						   dc.total_time);
-		pc.audio_format = dc.in_audio_format;
-		play_audio_format = dc.out_audio_format;
+		pc.total_time = real_song_duration(*dc->song,
+						   dc->total_time);
+		pc.audio_format = dc->in_audio_format;
+		play_audio_format = dc->out_audio_format;
 		decoder_starting = false;
 
-		const size_t buffer_before_play_size =
-			play_audio_format.TimeToSize(buffer_before_play_duration);
+		const size_t buffer_before_play_size = pc.low_latency
+			? play_audio_format.TimeToSize(low_latency_buffer_before_play_duration)
+			: play_audio_format.TimeToSize(buffer_before_play_duration);
 		buffer_before_play =
-			(buffer_before_play_size + sizeof(MusicChunk::data) - 1)
-			/ sizeof(MusicChunk::data);
+			(buffer_before_play_size + buffer.GetChunkSize() - 1)
+			/ buffer.GetChunkSize();
 
 		idle_add(IDLE_PLAYER);
 
@@ -557,7 +693,7 @@ Player::CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept
 			FormatError(player_domain,
 				    "problems opening audio device "
 				    "while playing \"%s\"",
-				    dc.song->GetURI());
+				    dc->song->GetURI());
 			return true;
 		}
 
@@ -565,7 +701,7 @@ Player::CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept
 	} else {
 		/* the decoder is not yet ready; wait
 		   some more */
-		dc.WaitForDecoder(lock);
+		dc->WaitForDecoder(lock);
 
 		return true;
 	}
@@ -586,7 +722,7 @@ Player::SeekDecoder(std::unique_lock<Mutex> &lock, SongTime seek_time) noexcept
 	try {
 		const PlayerControl::ScopeOccupied occupied(pc);
 
-		dc.Seek(lock, song->GetStartTime() + seek_time);
+		dc->Seek(lock, song->GetStartTime() + seek_time);
 	} catch (...) {
 		/* decoder failure */
 		pc.SetError(PlayerError::DECODER, std::current_exception());
@@ -602,8 +738,11 @@ Player::SeekDecoder(std::unique_lock<Mutex> &lock) noexcept
 {
 	assert(pc.next_song != nullptr);
 
+	/* the SEEK command has replaced the queued song */
+	StopLookAhead(lock);
+
 	if (pc.seek_time > SongTime::zero() && // TODO: allow this only if the song duration is known
-	    dc.IsUnseekableCurrentSong(*pc.next_song)) {
+	    dc->IsUnseekableCurrentSong(*pc.next_song)) {
 		/* seeking into the current song; but we already know
 		   it's not seekable, so let's fail early */
 		/* note the seek_time>0 check: if seeking to the
@@ -624,7 +763,7 @@ Player::SeekDecoder(std::unique_lock<Mutex> &lock) noexcept
 
 	idle_add(IDLE_PLAYER);
 
-	if (!dc.IsSeekableCurrentSong(*pc.next_song)) {
+	if (!dc->IsSeekableCurrentSong(*pc.next_song)) {
 		/* the decoder is already decoding the "next" song -
 		   stop it and start the previous song again */
 
@@ -648,7 +787,7 @@ Player::SeekDecoder(std::unique_lock<Mutex> &lock) noexcept
 		if (!IsDecoderAtCurrentSong()) {
 			/* the decoder is already decoding the "next" song,
 			   but it is the same song file; exchange the pipe */
-			ReplacePipe(dc.pipe);
+			ReplacePipe(dc->pipe);
 		}
 
 		pc.next_song.reset();
@@ -712,7 +851,7 @@ Player::ProcessCommand(std::unique_lock<Mutex> &lock) noexcept
 		queued = true;
 		pc.CommandFinished();
 
-		if (dc.IsIdle())
+		if (dc->IsIdle())
 			StartDecoder(lock, std::make_shared<MusicPipe>());
 
 		break;
@@ -750,6 +889,8 @@ Player::ProcessCommand(std::unique_lock<Mutex> &lock) noexcept
 			   stop it and reset the position */
 			StopDecoder(lock);
 
+		StopLookAhead(lock);
+
 		pc.next_song.reset();
 		queued = false;
 		pc.CommandFinished();
@@ -847,7 +988,7 @@ Player::PlayNextChunk() noexcept
 		unsigned cross_fade_position = pipe->GetSize();
 		assert(cross_fade_position <= cross_fade_chunks);
 
-		auto other_chunk = dc.pipe->Shift();
+		auto other_chunk = dc->pipe->Shift();
 		if (other_chunk != nullptr) {
 			chunk = pipe->Shift();
 			assert(chunk != nullptr);
@@ -883,14 +1024,14 @@ Player::PlayNextChunk() noexcept
 
 			std::unique_lock<Mutex> lock(pc.mutex);
 
-			if (dc.IsIdle()) {
+			if (dc->IsIdle()) {
 				/* the decoder isn't running, abort
 				   cross fading */
 				xfade_state = CrossFadeState::DISABLED;
 			} else {
 				/* wait for the decoder */
-				dc.Signal();
-				dc.WaitForDecoder(lock);
+				dc->Signal();
+				dc->WaitForDecoder(lock);
 
 				return true;
 			}
@@ -936,10 +1077,10 @@ Player::PlayNextChunk() noexcept
 	/* this formula should prevent that the decoder gets woken up
 	   with each chunk; it is more efficient to make it decode a
 	   larger block at a time */
-	if (!dc.IsIdle() && dc.pipe->GetSize() <= decoder_wakeup_threshold) {
+	if (!dc->IsIdle() && dc->pipe->GetSize() <= decoder_wakeup_threshold) {
 		if (!decoder_woken) {
 			decoder_woken = true;
-			dc.Signal();
+			dc->Signal();
 		}
 	} else
 		decoder_woken = false;
@@ -955,7 +1096,7 @@ Player::SongBorder() noexcept
 
 		FormatDefault(player_domain, "played \"%s\"", song->GetURI());
 
-		ReplacePipe(dc.pipe);
+		ReplacePipe(dc->pipe);
 
 		pc.outputs.SongBorder();
 	}
@@ -978,6 +1119,8 @@ Player::Run() noexcept
 
 	std::unique_lock<Mutex> lock(pc.mutex);
 
+	pc.metrics_dc = dc;
+
 	StartDecoder(lock, pipe);
 	ActivateDecoder();
 
@@ -1001,10 +1144,10 @@ Player::Run() noexcept
 			   prevent stuttering on slow machines */
 
 			if (pipe->GetSize() < buffer_before_play &&
-			    !dc.IsIdle() && !buffer.IsFull()) {
+			    !dc->IsIdle() && !buffer.IsFull()) {
 				/* not enough decoded buffer space yet */
 
-				dc.WaitForDecoder(lock);
+				dc->WaitForDecoder(lock);
 				continue;
 			} else {
 				/* buffering is complete */
@@ -1012,13 +1155,26 @@ Player::Run() noexcept
 			}
 		}
 
-		if (dc.IsIdle() && queued && IsDecoderAtCurrentSong()) {
+		if (dc->IsIdle() && queued && IsDecoderAtCurrentSong()) {
 			/* the decoder has finished the current song;
 			   make it decode the next song */
 
-			assert(dc.pipe == nullptr || dc.pipe == pipe);
+			assert(dc->pipe == nullptr || dc->pipe == pipe);
 
-			StartDecoder(lock, std::make_shared<MusicPipe>());
+			if (IsLookAheadActive())
+				/* the look-ahead decoder has already
+				   begun decoding the next song */
+				SwapLookAhead();
+			else
+				StartDecoder(lock, std::make_shared<MusicPipe>());
+		} else if (queued && lookahead_dc != nullptr &&
+			   !IsLookAheadActive() &&
+			   !dc->IsIdle() && !dc->IsStarting() &&
+			   IsDecoderAtCurrentSong()) {
+			/* the decoder is still busy with the current
+			   song; begin opening and decoding the next
+			   song in parallel */
+			StartLookAhead(lock);
 		}
 
 		if (/* no cross-fading if MPD is going to pause at the
@@ -1026,18 +1182,19 @@ Player::Run() noexcept
 		    !pc.border_pause &&
 		    IsDecoderAtNextSong() &&
 		    xfade_state == CrossFadeState::UNKNOWN &&
-		    !dc.IsStarting()) {
+		    !dc->IsStarting()) {
 			/* enable cross fading in this song?  if yes,
 			   calculate how many chunks will be required
 			   for it */
 			cross_fade_chunks =
-				pc.cross_fade.Calculate(dc.total_time,
-							dc.replay_gain_db,
-							dc.replay_gain_prev_db,
-							dc.GetMixRampStart(),
-							dc.GetMixRampPreviousEnd(),
-							dc.out_audio_format,
+				pc.cross_fade.Calculate(dc->total_time,
+							dc->replay_gain_db,
+							dc->replay_gain_prev_db,
+							dc->GetMixRampStart(),
+							dc->GetMixRampPreviousEnd(),
+							dc->out_audio_format,
 							play_audio_format,
+							buffer.GetChunkSize(),
 							buffer.GetSize() -
 							buffer_before_play);
 			if (cross_fade_chunks > 0)
@@ -1066,14 +1223,14 @@ Player::Run() noexcept
 			   waiting for space in the MusicBuffer) and
 			   wait for it */
 			// TODO: eliminate this kludge
-			dc.Signal();
+			dc->Signal();
 
-			dc.WaitForDecoder(lock);
+			dc->WaitForDecoder(lock);
 		} else if (IsDecoderAtNextSong()) {
 			/* at the beginning of a new song */
 
 			SongBorder();
-		} else if (dc.IsIdle()) {
+		} else if (dc->IsIdle()) {
 			if (queued)
 				/* the decoder has just stopped,
 				   between the two IsIdle() checks,
@@ -1103,13 +1260,14 @@ Player::Run() noexcept
 			   waiting for space in the MusicBuffer) and
 			   wait for it */
 			// TODO: eliminate this kludge
-			dc.Signal();
+			dc->Signal();
 
-			dc.WaitForDecoder(lock);
+			dc->WaitForDecoder(lock);
 		}
 	}
 
 	CancelPendingSeek();
+	StopLookAhead(lock);
 	StopDecoder(lock);
 
 	pipe.reset();
@@ -1133,9 +1291,10 @@ Player::Run() noexcept
 
 static void
 do_play(PlayerControl &pc, DecoderControl &dc,
+	DecoderControl *lookahead_dc,
 	MusicBuffer &buffer) noexcept
 {
-	Player player(pc, dc, buffer);
+	Player player(pc, dc, lookahead_dc, buffer);
 	player.Run();
 }
 
@@ -1144,16 +1303,45 @@ PlayerControl::RunThread() noexcept
 try {
 	SetThreadName("player");
 
+	try {
+		ApplyThreadScheduling("player");
+	} catch (...) {
+		Log(LogLevel::WARNING, std::current_exception(),
+		    "Failed to apply \"thread\" settings");
+	}
+
+
 	DecoderControl dc(mutex, cond,
 			  input_cache,
 			  configured_audio_format,
 			  replay_gain_config);
+	dc.realtime = low_latency;
+	dc.float_pipeline = float_pipeline;
+	dc.shared_decoder = shared_decoder;
 	dc.StartThread();
 
-	MusicBuffer buffer(buffer_chunks);
+	std::unique_ptr<DecoderControl> lookahead_dc;
+	if (lookahead_decoder) {
+		lookahead_dc = std::make_unique<DecoderControl>(mutex, cond,
+								input_cache,
+								configured_audio_format,
+								replay_gain_config);
+		lookahead_dc->realtime = low_latency;
+		lookahead_dc->float_pipeline = float_pipeline;
+		lookahead_dc->shared_decoder = shared_decoder;
+		lookahead_dc->StartThread();
+	}
+
+	MusicBuffer buffer(buffer_chunks, buffer_chunk_size, lock_memory);
+	if (lock_memory && !buffer.IsLocked())
+		LogWarning(player_domain,
+			   "Failed to lock the audio buffer into RAM");
 
 	std::unique_lock<Mutex> lock(mutex);
 
+	metrics_dc = &dc;
+	metrics_buffer = &buffer;
+
 	while (1) {
 		switch (command) {
 		case PlayerCommand::SEEK:
@@ -1162,7 +1350,7 @@ try {
 
 			{
 				const ScopeUnlock unlock(mutex);
-				do_play(*this, dc, buffer);
+				do_play(*this, dc, lookahead_dc.get(), buffer);
 				listener.OnPlayerSync();
 			}
 
@@ -1204,9 +1392,14 @@ try {
 			break;
 
 		case PlayerCommand::EXIT:
+			metrics_dc = nullptr;
+			metrics_buffer = nullptr;
+
 			{
 				const ScopeUnlock unlock(mutex);
 				dc.Quit();
+				if (lookahead_dc)
+					lookahead_dc->Quit();
 				outputs.Close();
 			}
 
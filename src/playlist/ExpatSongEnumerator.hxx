@@ -0,0 +1,61 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_EXPAT_SONG_ENUMERATOR_HXX
+#define MPD_EXPAT_SONG_ENUMERATOR_HXX
+
+#include "StreamSongEnumerator.hxx"
+#include "lib/expat/ExpatParser.hxx"
+
+/**
+ * A #StreamSongEnumerator which parses XML with expat.
+ *
+ * @param P the parser state object, which is passed as "user data"
+ * to the expat callbacks; its constructor gets a reference to the
+ * list where it shall append new songs
+ */
+template<typename P>
+class ExpatSongEnumerator final : public StreamSongEnumerator {
+	P parser;
+
+	ExpatParser expat;
+
+public:
+	ExpatSongEnumerator(InputStreamPtr &&_is,
+			    XML_StartElementHandler start,
+			    XML_EndElementHandler end,
+			    XML_CharacterDataHandler data)
+		:StreamSongEnumerator(std::move(_is)),
+		 parser(songs), expat(&parser) {
+		expat.SetElementHandler(start, end);
+		expat.SetCharacterDataHandler(data);
+	}
+
+protected:
+	/* virtual methods from class StreamSongEnumerator */
+	void Parse(const char *data, size_t length) override {
+		expat.Parse(data, length);
+	}
+
+	void CompleteParse() override {
+		expat.CompleteParse();
+	}
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include "SongEnumerator.hxx"
 #include "Mapper.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "Log.hxx"
 #include "storage/StorageInterface.hxx"
 #include "util/UriUtil.hxx"
 
@@ -40,6 +41,13 @@ playlist_open_in_playlist_dir(const char *uri, Mutex &mutex)
 	if (path_fs.IsNull())
 		return nullptr;
 
+	try {
+		spl_flush(path_fs);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to apply stored playlist edits");
+	}
+
 	return playlist_open_path(path_fs, mutex);
 }
 
@@ -31,6 +31,7 @@
 
 #ifdef ENABLE_DATABASE
 #include "SongLoader.hxx"
+#include "util/UriUtil.hxx"
 #endif
 
 #include <memory>
@@ -39,12 +40,15 @@ void
 playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			 unsigned start_index, unsigned end_index,
 			 playlist &dest, PlayerControl &pc,
-			 const SongLoader &loader)
+			 const SongLoader &loader,
+			 std::vector<unsigned> *lazy_positions)
 {
 	const std::string base_uri = uri != nullptr
 		? PathTraitsUTF8::GetParent(uri)
 		: std::string(".");
 
+	std::vector<DetachedSong> songs;
+
 	std::unique_ptr<DetachedSong> song;
 	for (unsigned i = 0;
 	     i < end_index && (song = e.NextSong()) != nullptr;
@@ -54,20 +58,56 @@ playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			continue;
 		}
 
-		if (!playlist_check_translate_song(*song, base_uri.c_str(),
-						   loader)) {
+		playlist_translate_song_uri(*song, base_uri.c_str());
+		songs.emplace_back(std::move(*song));
+	}
+
+	/* songs which are appended as placeholders, without looking
+	   them up in the database */
+	std::vector<bool> lazy(songs.size(), false);
+
+#ifdef ENABLE_DATABASE
+	if (loader.GetDatabase() == nullptr)
+		lazy_positions = nullptr;
+
+	if (lazy_positions != nullptr)
+		for (std::size_t i = 0; i < songs.size(); ++i)
+			lazy[i] = songs[i].IsInDatabase() &&
+				uri_safe_local(songs[i].GetURI());
+#endif
+
+	/* verify all other songs at once, which allows the database
+	   to resolve them in one pass */
+	std::vector<DetachedSong *> check;
+	for (std::size_t i = 0; i < songs.size(); ++i)
+		if (!lazy[i])
+			check.push_back(&songs[i]);
+
+	const auto valid = playlist_check_load_songs({check.data(), check.size()},
+						     loader);
+
+	const unsigned old_length = dest.GetLength();
+
+	std::vector<DetachedSong> result;
+	result.reserve(songs.size());
+	for (std::size_t i = 0, j = 0; i < songs.size(); ++i) {
+		if (lazy[i])
+			lazy_positions->push_back(old_length + result.size());
+		else if (!valid[j++])
 			continue;
-		}
 
-		dest.AppendSong(pc, std::move(*song));
+		result.emplace_back(std::move(songs[i]));
 	}
+
+	dest.AppendSongs(pc, std::move(result));
 }
 
 void
 playlist_open_into_queue(const LocatedUri &uri,
 			 unsigned start_index, unsigned end_index,
 			 playlist &dest, PlayerControl &pc,
-			 const SongLoader &loader)
+			 const SongLoader &loader,
+			 std::vector<unsigned> *lazy_positions)
 {
 	Mutex mutex;
 
@@ -81,5 +121,5 @@ playlist_open_into_queue(const LocatedUri &uri,
 
 	playlist_load_into_queue(uri.canonical_uri, *playlist,
 				 start_index, end_index,
-				 dest, pc, loader);
+				 dest, pc, loader, lazy_positions);
 }
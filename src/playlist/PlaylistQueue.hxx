@@ -24,6 +24,8 @@
 #ifndef MPD_PLAYLIST_QUEUE_HXX
 #define MPD_PLAYLIST_QUEUE_HXX
 
+#include <vector>
+
 class SongLoader;
 class SongEnumerator;
 struct playlist;
@@ -37,12 +39,17 @@ class PlayerControl;
  * URIs
  * @param start_index the index of the first song
  * @param end_index the index of the last song (excluding)
+ * @param lazy_positions if not nullptr, then database songs are
+ * appended without looking them up, and their queue positions are
+ * added to this list; the caller is responsible for resolving them
+ * (see #LazySongResolver)
  */
 void
 playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			 unsigned start_index, unsigned end_index,
 			 playlist &dest, PlayerControl &pc,
-			 const SongLoader &loader);
+			 const SongLoader &loader,
+			 std::vector<unsigned> *lazy_positions=nullptr);
 
 /**
  * Opens a playlist with a playlist plugin and append to the specified
@@ -52,7 +59,8 @@ void
 playlist_open_into_queue(const LocatedUri &uri,
 			 unsigned start_index, unsigned end_index,
 			 playlist &dest, PlayerControl &pc,
-			 const SongLoader &loader);
+			 const SongLoader &loader,
+			 std::vector<unsigned> *lazy_positions=nullptr);
 
 #endif
 
@@ -17,6 +17,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "PlaylistSong.hxx"
 #include "SongLoader.hxx"
 #include "tag/Tag.hxx"
@@ -25,6 +26,12 @@
 #include "song/DetachedSong.hxx"
 #include "util/UriExtract.hxx"
 
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/DatabaseSong.hxx"
+#include "song/LightSong.hxx"
+#endif
+
 #include <algorithm>
 #include <string>
 
@@ -42,24 +49,27 @@ merge_song_metadata(DetachedSong &add, const DetachedSong &base) noexcept
 	add.SetLastModified(base.GetLastModified());
 }
 
-static bool
-playlist_check_load_song(DetachedSong &song, const SongLoader &loader) noexcept
-try {
-	DetachedSong tmp = loader.LoadSong(song.GetURI());
-
+static void
+apply_loaded_song(DetachedSong &song, const DetachedSong &tmp) noexcept
+{
 	song.SetURI(tmp.GetURI());
 	if (!song.HasRealURI() && tmp.HasRealURI())
 		song.SetRealURI(tmp.GetRealURI());
 
 	merge_song_metadata(song, tmp);
+}
+
+static bool
+playlist_check_load_song(DetachedSong &song, const SongLoader &loader) noexcept
+try {
+	apply_loaded_song(song, loader.LoadSong(song.GetURI()));
 	return true;
 } catch (...) {
 	return false;
 }
 
-bool
-playlist_check_translate_song(DetachedSong &song, const char *base_uri,
-			      const SongLoader &loader) noexcept
+void
+playlist_translate_song_uri(DetachedSong &song, const char *base_uri) noexcept
 {
 	if (base_uri != nullptr && strcmp(base_uri, ".") == 0)
 		/* PathTraitsUTF8::GetParent() returns "." when there
@@ -88,6 +98,66 @@ playlist_check_translate_song(DetachedSong &song, const char *base_uri,
 	if (base_uri != nullptr && !uri_has_scheme(uri) &&
 	    !PathTraitsUTF8::IsAbsolute(uri))
 		song.SetURI(PathTraitsUTF8::Build(base_uri, uri));
+}
 
+bool
+playlist_check_translate_song(DetachedSong &song, const char *base_uri,
+			      const SongLoader &loader) noexcept
+{
+	playlist_translate_song_uri(song, base_uri);
 	return playlist_check_load_song(song, loader);
 }
+
+std::vector<bool>
+playlist_check_load_songs(ConstBuffer<DetachedSong *> songs,
+			  const SongLoader &loader)
+{
+	std::vector<bool> valid(songs.size, false);
+
+	/* songs which still need to be checked one by one */
+	std::vector<bool> pending(songs.size, true);
+
+#ifdef ENABLE_DATABASE
+	const Database *db = loader.GetDatabase();
+	if (db != nullptr) {
+		std::vector<std::size_t> indexes;
+		std::vector<const char *> uris;
+		for (std::size_t i = 0; i < songs.size; ++i) {
+			if (songs[i]->IsInDatabase()) {
+				indexes.push_back(i);
+				uris.push_back(songs[i]->GetURI());
+			}
+		}
+
+		if (!uris.empty()) {
+			const Storage *storage = loader.GetStorage();
+
+			try {
+				db->GetSongs({uris.data(), uris.size()},
+					     [&](std::size_t j, const LightSong &song){
+						     const std::size_t i = indexes[j];
+						     apply_loaded_song(*songs[i],
+								       DatabaseDetachSong(storage, song));
+						     valid[i] = true;
+					     });
+
+				/* all others were not found */
+				for (std::size_t i : indexes)
+					pending[i] = false;
+			} catch (...) {
+				/* fall back to looking up each
+				   song, which reports the error for
+				   each of them */
+				for (std::size_t i : indexes)
+					pending[i] = !valid[i];
+			}
+		}
+	}
+#endif
+
+	for (std::size_t i = 0; i < songs.size; ++i)
+		if (pending[i])
+			valid[i] = playlist_check_load_song(*songs[i], loader);
+
+	return valid;
+}
@@ -20,9 +20,21 @@
 #ifndef MPD_PLAYLIST_SONG_HXX
 #define MPD_PLAYLIST_SONG_HXX
 
+#include "util/ConstBuffer.hxx"
+
+#include <vector>
+
 class SongLoader;
 class DetachedSong;
 
+/**
+ * Resolve the URI of the song relative to the given base URI (the
+ * playlist's parent directory), without looking it up.  This is the
+ * first step of playlist_check_translate_song().
+ */
+void
+playlist_translate_song_uri(DetachedSong &song, const char *base_uri) noexcept;
+
 /**
  * Verifies the song, returns false if it is unsafe.  Translate the
  * song to a song within the database, if it is a local file.
@@ -33,4 +45,17 @@ bool
 playlist_check_translate_song(DetachedSong &song, const char *base_uri,
 			      const SongLoader &loader) noexcept;
 
+/**
+ * Like playlist_check_translate_song(), but verifies many songs at
+ * once.  All database songs are looked up with one
+ * Database::GetSongs() call.
+ *
+ * @param songs the songs; their URIs must have been translated with
+ * playlist_translate_song_uri() already
+ * @return one flag per song; false if the song should not be used
+ */
+std::vector<bool>
+playlist_check_load_songs(ConstBuffer<DetachedSong *> songs,
+			  const SongLoader &loader);
+
 #endif
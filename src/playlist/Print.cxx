@@ -30,27 +30,61 @@
 #include "Partition.hxx"
 #include "Instance.hxx"
 
+#include <vector>
+
+/**
+ * The number of songs which are verified at once by
+ * playlist_provider_print().
+ */
+static constexpr std::size_t PRINT_BATCH_SIZE = 256;
+
+static void
+playlist_print_songs(Response &r, const SongLoader &loader,
+		     std::vector<DetachedSong> &songs, bool detail)
+{
+	std::vector<DetachedSong *> p;
+	p.reserve(songs.size());
+	for (auto &song : songs)
+		p.push_back(&song);
+
+	const auto valid = playlist_check_load_songs({p.data(), p.size()},
+						     loader);
+
+	for (std::size_t i = 0; i < songs.size(); ++i) {
+		if (valid[i] && detail)
+			song_print_info(r, songs[i]);
+		else
+			/* fallback if no detail was requested or no
+			   detail was available */
+			song_print_uri(r, songs[i]);
+	}
+
+	songs.clear();
+}
+
 static void
 playlist_provider_print(Response &r,
 			const SongLoader &loader,
 			const char *uri,
-			SongEnumerator &e, bool detail) noexcept
+			SongEnumerator &e, bool detail)
 {
 	const std::string base_uri = uri != nullptr
 		? PathTraitsUTF8::GetParent(uri)
 		: std::string(".");
 
+	std::vector<DetachedSong> songs;
+	songs.reserve(PRINT_BATCH_SIZE);
+
 	std::unique_ptr<DetachedSong> song;
 	while ((song = e.NextSong()) != nullptr) {
-		if (playlist_check_translate_song(*song, base_uri.c_str(),
-						  loader) &&
-		    detail)
-			song_print_info(r, *song);
-		else
-			/* fallback if no detail was requested or no
-			   detail was available */
-			song_print_uri(r, *song);
+		playlist_translate_song_uri(*song, base_uri.c_str());
+		songs.emplace_back(std::move(*song));
+
+		if (songs.size() >= PRINT_BATCH_SIZE)
+			playlist_print_songs(r, loader, songs, detail);
 	}
+
+	playlist_print_songs(r, loader, songs, detail);
 }
 
 bool
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "StreamSongEnumerator.hxx"
+#include "input/InputStream.hxx"
+
+StreamSongEnumerator::StreamSongEnumerator(InputStreamPtr &&_is) noexcept
+	:is(std::move(_is)) {}
+
+StreamSongEnumerator::~StreamSongEnumerator() noexcept = default;
+
+std::unique_ptr<DetachedSong>
+StreamSongEnumerator::NextSong()
+{
+	while (songs.empty()) {
+		if (!is)
+			return nullptr;
+
+		char buffer[4096];
+		size_t nbytes = is->LockRead(buffer, sizeof(buffer));
+		if (nbytes == 0) {
+			/* release the stream before the final parser
+			   call, it won't give us any more data */
+			is.reset();
+			CompleteParse();
+		} else
+			Parse(buffer, nbytes);
+	}
+
+	auto result = std::make_unique<DetachedSong>(std::move(songs.front()));
+	songs.pop_front();
+	return result;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STREAM_SONG_ENUMERATOR_HXX
+#define MPD_STREAM_SONG_ENUMERATOR_HXX
+
+#include "SongEnumerator.hxx"
+#include "input/Ptr.hxx"
+#include "song/DetachedSong.hxx"
+
+#include <list>
+
+#include <stddef.h>
+
+/**
+ * A #SongEnumerator which feeds an #InputStream chunk by chunk into
+ * an incremental parser.  Songs are returned as soon as the parser
+ * has produced them, without waiting for the end of the document.
+ */
+class StreamSongEnumerator : public SongEnumerator {
+	InputStreamPtr is;
+
+protected:
+	/**
+	 * Songs which have been produced by the parser, but have not
+	 * yet been returned by NextSong().  The parser appends to
+	 * this list.
+	 */
+	std::list<DetachedSong> songs;
+
+	explicit StreamSongEnumerator(InputStreamPtr &&_is) noexcept;
+
+	~StreamSongEnumerator() noexcept override;
+
+	/**
+	 * Feed more data into the parser.
+	 *
+	 * Throws on error.
+	 */
+	virtual void Parse(const char *data, size_t length) = 0;
+
+	/**
+	 * The end of the stream has been reached.
+	 *
+	 * Throws on error.
+	 */
+	virtual void CompleteParse() = 0;
+
+public:
+	std::unique_ptr<DetachedSong> NextSong() override;
+};
+
+#endif
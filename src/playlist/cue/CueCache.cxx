@@ -0,0 +1,152 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "CueCache.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Traits.hxx"
+#include "thread/Mutex.hxx"
+
+#include <map>
+
+namespace CueCache {
+
+/**
+ * The maximum number of CUE sheets in the cache.  When it is full,
+ * the least recently used one is evicted.
+ */
+static constexpr std::size_t MAX_ENTRIES = 256;
+
+struct Entry {
+	std::chrono::system_clock::time_point mtime;
+	uint64_t size;
+
+	std::shared_ptr<const SongList> songs;
+
+	/**
+	 * Used to find the least recently used entry.
+	 */
+	unsigned long last_used;
+};
+
+static Mutex cache_mutex;
+static std::map<std::string, Entry> cache_entries;
+static unsigned long cache_clock;
+
+bool
+MakeKey(const char *uri, Key &key) noexcept
+{
+	if (!PathTraitsUTF8::IsAbsolute(uri))
+		/* only local files are supported */
+		return false;
+
+	const auto path = AllocatedPath::FromUTF8(uri);
+	if (path.IsNull())
+		return false;
+
+	FileInfo fi;
+	if (!GetFileInfo(path, fi) || !fi.IsRegular())
+		return false;
+
+	key.path = uri;
+	key.mtime = fi.GetModificationTime();
+	key.size = fi.GetSize();
+	return true;
+}
+
+std::shared_ptr<const SongList>
+Get(const Key &key) noexcept
+{
+	const std::lock_guard<Mutex> protect(cache_mutex);
+
+	auto i = cache_entries.find(key.path);
+	if (i == cache_entries.end())
+		return nullptr;
+
+	auto &entry = i->second;
+	if (entry.mtime != key.mtime || entry.size != key.size) {
+		/* stale */
+		cache_entries.erase(i);
+		return nullptr;
+	}
+
+	entry.last_used = ++cache_clock;
+	return entry.songs;
+}
+
+void
+Put(Key &&key, SongList &&songs) noexcept
+try {
+	auto value = std::make_shared<const SongList>(std::move(songs));
+
+	const std::lock_guard<Mutex> protect(cache_mutex);
+
+	if (cache_entries.size() >= MAX_ENTRIES &&
+	    cache_entries.find(key.path) == cache_entries.end()) {
+		auto lru = cache_entries.begin();
+		for (auto i = lru; i != cache_entries.end(); ++i)
+			if (i->second.last_used < lru->second.last_used)
+				lru = i;
+
+		cache_entries.erase(lru);
+	}
+
+	cache_entries[std::move(key.path)] = {
+		key.mtime, key.size,
+		std::move(value),
+		++cache_clock,
+	};
+} catch (...) {
+	/* out of memory: don't cache it */
+}
+
+std::unique_ptr<DetachedSong>
+Enumerator::NextSong()
+{
+	if (i >= songs->size())
+		return nullptr;
+
+	return std::make_unique<DetachedSong>((*songs)[i++]);
+}
+
+std::unique_ptr<DetachedSong>
+Recorder::Record(std::unique_ptr<DetachedSong> song) noexcept
+{
+	if (!enabled)
+		return song;
+
+	if (song == nullptr) {
+		/* the end of the CUE sheet */
+		Put(std::move(key), std::move(songs));
+		enabled = false;
+		return song;
+	}
+
+	try {
+		songs.emplace_back(*song);
+	} catch (...) {
+		/* out of memory: give up caching */
+		songs.clear();
+		enabled = false;
+	}
+
+	return song;
+}
+
+} // namespace CueCache
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CUE_CACHE_HXX
+#define MPD_CUE_CACHE_HXX
+
+#include "../SongEnumerator.hxx"
+#include "song/DetachedSong.hxx"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * A process-wide cache of parsed CUE sheets, so browsing and queueing
+ * tracks of the same file doesn't parse it over and over again.
+ * Entries are identified by the local file path, its modification
+ * time and its size.
+ *
+ * All functions are thread-safe.
+ */
+namespace CueCache {
+
+using SongList = std::vector<DetachedSong>;
+
+struct Key {
+	std::string path;
+	std::chrono::system_clock::time_point mtime;
+	uint64_t size;
+};
+
+/**
+ * Build a cache key for the given URI.
+ *
+ * @return false if the URI is not a local file (or if it cannot be
+ * accessed), i.e. it cannot be cached
+ */
+bool
+MakeKey(const char *uri, Key &key) noexcept;
+
+/**
+ * @return the cached song list or nullptr
+ */
+std::shared_ptr<const SongList>
+Get(const Key &key) noexcept;
+
+void
+Put(Key &&key, SongList &&songs) noexcept;
+
+/**
+ * A #SongEnumerator which returns all songs from a cached entry.
+ */
+class Enumerator final : public SongEnumerator {
+	const std::shared_ptr<const SongList> songs;
+	SongList::size_type i = 0;
+
+public:
+	explicit Enumerator(std::shared_ptr<const SongList> &&_songs) noexcept
+		:songs(std::move(_songs)) {}
+
+	std::unique_ptr<DetachedSong> NextSong() override;
+};
+
+/**
+ * Collects copies of the songs returned by a #SongEnumerator, and
+ * submits them to the cache after the last one.  Nothing is stored if
+ * the enumeration is not completed.
+ */
+class Recorder {
+	Key key;
+	SongList songs;
+
+	bool enabled;
+
+public:
+	explicit Recorder(const char *uri) noexcept
+		:enabled(MakeKey(uri, key)) {}
+
+	bool IsEnabled() const noexcept {
+		return enabled;
+	}
+
+	const Key &GetKey() const noexcept {
+		return key;
+	}
+
+	/**
+	 * Pass the return value of SongEnumerator::NextSong() through
+	 * this method.
+	 */
+	std::unique_ptr<DetachedSong> Record(std::unique_ptr<DetachedSong> song) noexcept;
+};
+
+} // namespace CueCache
+
+#endif
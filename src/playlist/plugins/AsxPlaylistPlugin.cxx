@@ -19,21 +19,19 @@
 
 #include "AsxPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "tag/Builder.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringView.hxx"
-#include "lib/expat/ExpatParser.hxx"
 
 /**
  * This is the state object for our XML parser.
  */
 struct AsxParser {
 	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
+	 * New songs are appended to this list.
 	 */
-	std::forward_list<DetachedSong> songs;
+	std::list<DetachedSong> &songs;
 
 	/**
 	 * The current position in the XML file.
@@ -56,8 +54,8 @@ struct AsxParser {
 
 	TagBuilder tag_builder;
 
-	AsxParser()
-		:state(ROOT) {}
+	AsxParser(std::list<DetachedSong> &_songs) noexcept
+		:songs(_songs), state(ROOT) {}
 
 };
 
@@ -106,7 +104,7 @@ asx_end_element(void *user_data, const XML_Char *element_name)
 	case AsxParser::ENTRY:
 		if (StringEqualsCaseASCII(element_name, "entry")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
+				parser->songs.emplace_back(std::move(parser->location),
 							    parser->tag_builder.Commit());
 
 			parser->state = AsxParser::ROOT;
@@ -143,17 +141,10 @@ asx_char_data(void *user_data, const XML_Char *s, int len)
 static std::unique_ptr<SongEnumerator>
 asx_open_stream(InputStreamPtr &&is)
 {
-	AsxParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(asx_start_element, asx_end_element);
-		expat.SetCharacterDataHandler(asx_char_data);
-		expat.Parse(*is);
-	}
-
-	parser.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(parser.songs));
+	return std::make_unique<ExpatSongEnumerator<AsxParser>>(std::move(is),
+								asx_start_element,
+								asx_end_element,
+								asx_char_data);
 }
 
 static const char *const asx_suffixes[] = {
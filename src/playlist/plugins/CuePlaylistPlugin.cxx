@@ -21,28 +21,43 @@
 #include "../PlaylistPlugin.hxx"
 #include "../SongEnumerator.hxx"
 #include "../cue/CueParser.hxx"
+#include "../cue/CueCache.hxx"
 #include "input/TextInputStream.hxx"
+#include "input/InputStream.hxx"
 
 class CuePlaylist final : public SongEnumerator {
+	CueCache::Recorder recorder;
+
 	TextInputStream tis;
 	CueParser parser;
 
  public:
-	CuePlaylist(InputStreamPtr &&is)
-		:tis(std::move(is)) {
+	CuePlaylist(CueCache::Recorder &&_recorder, InputStreamPtr &&is)
+		:recorder(std::move(_recorder)), tis(std::move(is)) {
 	}
 
 	virtual std::unique_ptr<DetachedSong> NextSong() override;
+
+private:
+	std::unique_ptr<DetachedSong> Parse();
 };
 
 static std::unique_ptr<SongEnumerator>
 cue_playlist_open_stream(InputStreamPtr &&is)
 {
-	return std::make_unique<CuePlaylist>(std::move(is));
+	CueCache::Recorder recorder(is->GetURI());
+	if (recorder.IsEnabled()) {
+		auto songs = CueCache::Get(recorder.GetKey());
+		if (songs)
+			return std::make_unique<CueCache::Enumerator>(std::move(songs));
+	}
+
+	return std::make_unique<CuePlaylist>(std::move(recorder),
+					     std::move(is));
 }
 
-std::unique_ptr<DetachedSong>
-CuePlaylist::NextSong()
+inline std::unique_ptr<DetachedSong>
+CuePlaylist::Parse()
 {
 	auto song = parser.Get();
 	if (song != nullptr)
@@ -60,6 +75,12 @@ CuePlaylist::NextSong()
 	return parser.Get();
 }
 
+std::unique_ptr<DetachedSong>
+CuePlaylist::NextSong()
+{
+	return recorder.Record(Parse());
+}
+
 static const char *const cue_playlist_suffixes[] = {
 	"cue",
 	nullptr
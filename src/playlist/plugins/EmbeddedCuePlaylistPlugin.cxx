@@ -27,8 +27,8 @@
 #include "../PlaylistPlugin.hxx"
 #include "../SongEnumerator.hxx"
 #include "../cue/CueParser.hxx"
+#include "../cue/CueCache.hxx"
 #include "tag/Handler.hxx"
-#include "tag/Generic.hxx"
 #include "song/DetachedSong.hxx"
 #include "TagFile.hxx"
 #include "fs/Traits.hxx"
@@ -60,8 +60,16 @@ public:
 
 	std::unique_ptr<CueParser> parser;
 
+	CueCache::Recorder recorder;
+
 public:
+	explicit EmbeddedCuePlaylist(CueCache::Recorder &&_recorder) noexcept
+		:recorder(std::move(_recorder)) {}
+
 	std::unique_ptr<DetachedSong> NextSong() override;
+
+private:
+	std::unique_ptr<DetachedSong> Parse();
 };
 
 class ExtractCuesheetTagHandler final : public NullTagHandler {
@@ -88,18 +96,27 @@ embcue_playlist_open_uri(const char *uri,
 		/* only local files supported */
 		return nullptr;
 
+	CueCache::Recorder recorder(uri);
+	if (recorder.IsEnabled()) {
+		/* skip scanning the tags if this file was parsed
+		   before */
+		auto songs = CueCache::Get(recorder.GetKey());
+		if (songs)
+			return std::make_unique<CueCache::Enumerator>(std::move(songs));
+	}
+
 	const auto path_fs = AllocatedPath::FromUTF8Throw(uri);
 
 	ExtractCuesheetTagHandler extract_cuesheet;
-	ScanFileTagsNoGeneric(path_fs, extract_cuesheet);
-	if (extract_cuesheet.cuesheet.empty())
-		ScanGenericTags(path_fs, extract_cuesheet);
+	ScanFileTagsWithGeneric(path_fs, extract_cuesheet, [&extract_cuesheet](){
+			return !extract_cuesheet.cuesheet.empty();
+		});
 
 	if (extract_cuesheet.cuesheet.empty())
 		/* no "CUESHEET" tag found */
 		return nullptr;
 
-	auto playlist = std::make_unique<EmbeddedCuePlaylist>();
+	auto playlist = std::make_unique<EmbeddedCuePlaylist>(std::move(recorder));
 
 	playlist->filename = PathTraitsUTF8::GetBase(uri);
 
@@ -111,8 +128,8 @@ embcue_playlist_open_uri(const char *uri,
 	return playlist;
 }
 
-std::unique_ptr<DetachedSong>
-EmbeddedCuePlaylist::NextSong()
+inline std::unique_ptr<DetachedSong>
+EmbeddedCuePlaylist::Parse()
 {
 	auto song = parser->Get();
 	if (song != nullptr) {
@@ -147,6 +164,12 @@ EmbeddedCuePlaylist::NextSong()
 	return song;
 }
 
+std::unique_ptr<DetachedSong>
+EmbeddedCuePlaylist::NextSong()
+{
+	return recorder.Record(Parse());
+}
+
 static const char *const embcue_playlist_suffixes[] = {
 	/* a few codecs that are known to be supported; there are
 	   probably many more */
@@ -25,7 +25,7 @@
 
 #include "FlacPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../SongEnumerator.hxx"
 #include "lib/xiph/FlacMetadataChain.hxx"
 #include "lib/xiph/FlacMetadataIterator.hxx"
 #include "song/DetachedSong.hxx"
@@ -34,16 +34,35 @@
 
 #include <FLAC/metadata.h>
 
-static auto
-ToSongEnumerator(const char *uri,
-		 const FLAC__StreamMetadata_CueSheet &c,
-		 const unsigned sample_rate,
-		 const FLAC__uint64 total_samples) noexcept
-{
-	std::forward_list<DetachedSong> songs;
-	auto tail = songs.before_begin();
+#include <memory>
+
+/**
+ * Converts the tracks of a FLAC cue sheet to songs one by one, while
+ * keeping the metadata chain which contains it.
+ */
+class FlacCueSheetEnumerator final : public SongEnumerator {
+	const std::unique_ptr<FlacMetadataChain> chain;
+	const FLAC__StreamMetadata_CueSheet &c;
+	const unsigned sample_rate;
+	const FLAC__uint64 total_samples;
+
+	unsigned i = 0;
+
+public:
+	FlacCueSheetEnumerator(std::unique_ptr<FlacMetadataChain> &&_chain,
+			       const FLAC__StreamMetadata_CueSheet &_c,
+			       unsigned _sample_rate,
+			       FLAC__uint64 _total_samples) noexcept
+		:chain(std::move(_chain)), c(_c),
+		 sample_rate(_sample_rate), total_samples(_total_samples) {}
+
+	std::unique_ptr<DetachedSong> NextSong() override;
+};
 
-	for (unsigned i = 0; i < c.num_tracks; ++i) {
+std::unique_ptr<DetachedSong>
+FlacCueSheetEnumerator::NextSong()
+{
+	for (; i < c.num_tracks; ++i) {
 		const auto &track = c.tracks[i];
 		if (track.type != 0)
 			continue;
@@ -53,24 +72,26 @@ ToSongEnumerator(const char *uri,
 			? c.tracks[i + 1].offset
 			: total_samples;
 
-		tail = songs.emplace_after(tail, uri);
-		auto &song = *tail;
-		song.SetStartTime(SongTime::FromScale(start, sample_rate));
-		song.SetEndTime(SongTime::FromScale(end, sample_rate));
+		++i;
+
+		auto song = std::make_unique<DetachedSong>("");
+		song->SetStartTime(SongTime::FromScale(start, sample_rate));
+		song->SetEndTime(SongTime::FromScale(end, sample_rate));
+		return song;
 	}
 
-	return std::make_unique<MemorySongEnumerator>(std::move(songs));
+	return nullptr;
 }
 
 static std::unique_ptr<SongEnumerator>
 flac_playlist_open_stream(InputStreamPtr &&is)
 {
-	FlacMetadataChain chain;
-	if (!chain.Read(*is))
+	auto chain = std::make_unique<FlacMetadataChain>();
+	if (!chain->Read(*is))
 		throw FormatRuntimeError("Failed to read FLAC metadata: %s",
-					 chain.GetStatusString());
+					 chain->GetStatusString());
 
-	FlacMetadataIterator iterator((FLAC__Metadata_Chain *)chain);
+	FlacMetadataIterator iterator((FLAC__Metadata_Chain *)*chain);
 
 	unsigned sample_rate = 0;
 	FLAC__uint64 total_samples;
@@ -87,8 +108,10 @@ flac_playlist_open_stream(InputStreamPtr &&is)
 			if (sample_rate == 0)
 				break;
 
-			return ToSongEnumerator("", block.data.cue_sheet,
-						sample_rate, total_samples);
+			return std::make_unique<FlacCueSheetEnumerator>(std::move(chain),
+									block.data.cue_sheet,
+									sample_rate,
+									total_samples);
 
 		default:
 			break;
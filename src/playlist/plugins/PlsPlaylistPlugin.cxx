@@ -19,7 +19,7 @@
 
 #include "PlsPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../SongEnumerator.hxx"
 #include "input/TextInputStream.hxx"
 #include "input/InputStream.hxx"
 #include "song/DetachedSong.hxx"
@@ -28,6 +28,7 @@
 #include "util/StringStrip.hxx"
 #include "util/DivideString.hxx"
 
+#include <map>
 #include <string>
 
 #include <stdlib.h>
@@ -45,121 +46,187 @@ FindPlaylistSection(TextInputStream &is)
 	return false;
 }
 
-static bool
-ParsePls(TextInputStream &is, std::forward_list<DetachedSong> &songs)
-{
-	assert(songs.empty());
-
-	if (!FindPlaylistSection(is))
-		return false;
-
-	unsigned n_entries = 0;
+/**
+ * Parses the "[playlist]" section line by line.  PLS files may list
+ * the keys in any order, therefore an entry is returned only after
+ * its "File", "Title" and "Length" have all been seen; entries which
+ * lack one of them are held back until the end of the section.
+ */
+class PlsSongEnumerator final : public SongEnumerator {
+	static constexpr unsigned MAX_ENTRIES = 65536;
 
 	struct Entry {
 		std::string file, title;
-		int length;
+		int length = -1;
 
-		Entry():length(-1) {}
-	};
+		bool has_title = false, has_length = false;
 
-	static constexpr unsigned MAX_ENTRIES = 65536;
+		bool IsComplete() const noexcept {
+			return !file.empty() && has_title && has_length;
+		}
 
-	std::vector<Entry> entries;
+		std::unique_ptr<DetachedSong> ToSong() const {
+			TagBuilder tag;
+			if (!title.empty())
+				tag.AddItem(TAG_TITLE, title.c_str());
 
-	char *line;
-	while ((line = is.ReadLine()) != nullptr) {
-		line = Strip(line);
+			if (length > 0)
+				tag.SetDuration(SignedSongTime::FromS(length));
 
-		if (*line == 0 || *line == ';')
-			continue;
-
-		if (*line == '[')
-			/* another section starts; we only want
-			   [Playlist], so stop here */
-			break;
-
-		const DivideString ds(line, '=', true);
-		if (!ds.IsDefined())
-			continue;
-
-		const char *const name = ds.GetFirst();
-		const char *const value = ds.GetSecond();
-
-		if (StringEqualsCaseASCII(name, "NumberOfEntries")) {
-			n_entries = strtoul(value, nullptr, 10);
-			if (n_entries == 0)
-				/* empty file - nothing remains to be
-				   done */
-				return true;
-
-			if (n_entries > MAX_ENTRIES)
-				n_entries = MAX_ENTRIES;
-			entries.resize(n_entries);
-		} else if (StringEqualsCaseASCII(name, "File", 4)) {
-			unsigned i = strtoul(name + 4, nullptr, 10);
-			if (i >= 1 && i <= (n_entries > 0 ? n_entries : MAX_ENTRIES)) {
-				if (entries.size() < i)
-					entries.resize(i);
-				entries[i - 1].file = value;
-			}
-		} else if (StringEqualsCaseASCII(name, "Title", 5)) {
-			unsigned i = strtoul(name + 5, nullptr, 10);
-			if (i >= 1 && i <= (n_entries > 0 ? n_entries : MAX_ENTRIES)) {
-				if (entries.size() < i)
-					entries.resize(i);
-				entries[i - 1].title = value;
-			}
-		} else if (StringEqualsCaseASCII(name, "Length", 6)) {
-			unsigned i = strtoul(name + 6, nullptr, 10);
-			if (i >= 1 && i <= (n_entries > 0 ? n_entries : MAX_ENTRIES)) {
-				if (entries.size() < i)
-					entries.resize(i);
-				entries[i - 1].length = atoi(value);
-			}
+			return std::make_unique<DetachedSong>(file, tag.Commit());
 		}
+	};
+
+	TextInputStream tis;
+
+	/**
+	 * Entries which have not yet been returned, indexed by their
+	 * (1-based) number.
+	 */
+	std::map<unsigned, Entry> entries;
+
+	/**
+	 * The number of the next entry to be returned.
+	 */
+	unsigned next = 1;
+
+	/**
+	 * The value of "NumberOfEntries"; 0 if not (yet) seen.
+	 */
+	unsigned n_entries = 0;
+
+	/**
+	 * Has the end of the section been reached?
+	 */
+	bool eof = false;
+
+public:
+	explicit PlsSongEnumerator(InputStreamPtr &&_is) noexcept
+		:tis(std::move(_is)) {}
+
+	bool FindPlaylistSection() {
+		return ::FindPlaylistSection(tis);
 	}
 
-	if (n_entries == 0)
-		/* no "NumberOfEntries" found */
-		return false;
+	InputStreamPtr &&StealInputStream() noexcept {
+		return tis.StealInputStream();
+	}
 
-	auto i = songs.before_begin();
-	for (const auto &entry : entries) {
-		const char *uri = entry.file.c_str();
+	std::unique_ptr<DetachedSong> NextSong() override;
 
-		TagBuilder tag;
-		if (!entry.title.empty())
-			tag.AddItem(TAG_TITLE, entry.title.c_str());
+private:
+	unsigned GetMaxEntries() const noexcept {
+		return n_entries > 0 ? n_entries : MAX_ENTRIES;
+	}
 
-		if (entry.length > 0)
-			tag.SetDuration(SignedSongTime::FromS(entry.length));
+	Entry *GetEntry(const char *number) {
+		unsigned i = strtoul(number, nullptr, 10);
+		if (i < next || i > GetMaxEntries())
+			return nullptr;
 
-		i = songs.emplace_after(i, uri, tag.Commit());
+		return &entries[i];
 	}
 
-	return true;
-}
+	/**
+	 * Parse one line.
+	 *
+	 * @return false if the end of the section has been reached
+	 */
+	bool ParseLine(char *line);
+};
 
-static bool
-ParsePls(InputStreamPtr &&is, std::forward_list<DetachedSong> &songs)
+bool
+PlsSongEnumerator::ParseLine(char *line)
 {
-	TextInputStream tis(std::move(is));
-	if (!ParsePls(tis, songs)) {
-		is = tis.StealInputStream();
+	line = Strip(line);
+
+	if (*line == 0 || *line == ';')
+		return true;
+
+	if (*line == '[')
+		/* another section starts; we only want
+		   [Playlist], so stop here */
 		return false;
+
+	const DivideString ds(line, '=', true);
+	if (!ds.IsDefined())
+		return true;
+
+	const char *const name = ds.GetFirst();
+	const char *const value = ds.GetSecond();
+
+	if (StringEqualsCaseASCII(name, "NumberOfEntries")) {
+		n_entries = strtoul(value, nullptr, 10);
+		if (n_entries == 0) {
+			/* empty file - nothing remains to be
+			   done */
+			entries.clear();
+			return false;
+		}
+
+		if (n_entries > MAX_ENTRIES)
+			n_entries = MAX_ENTRIES;
+
+		entries.erase(entries.upper_bound(n_entries), entries.end());
+	} else if (StringEqualsCaseASCII(name, "File", 4)) {
+		Entry *entry = GetEntry(name + 4);
+		if (entry != nullptr)
+			entry->file = value;
+	} else if (StringEqualsCaseASCII(name, "Title", 5)) {
+		Entry *entry = GetEntry(name + 5);
+		if (entry != nullptr) {
+			entry->title = value;
+			entry->has_title = true;
+		}
+	} else if (StringEqualsCaseASCII(name, "Length", 6)) {
+		Entry *entry = GetEntry(name + 6);
+		if (entry != nullptr) {
+			entry->length = atoi(value);
+			entry->has_length = true;
+		}
 	}
 
 	return true;
 }
 
+std::unique_ptr<DetachedSong>
+PlsSongEnumerator::NextSong()
+{
+	while (true) {
+		auto i = entries.begin();
+		if (i != entries.end() &&
+		    (eof || (i->first == next && i->second.IsComplete()))) {
+			next = i->first + 1;
+			const Entry entry = std::move(i->second);
+			entries.erase(i);
+
+			if (entry.file.empty())
+				/* an incomplete entry at the end of
+				   the section */
+				continue;
+
+			return entry.ToSong();
+		}
+
+		if (eof)
+			return nullptr;
+
+		char *line = tis.ReadLine();
+		if (line == nullptr || !ParseLine(line))
+			eof = true;
+	}
+}
+
 static std::unique_ptr<SongEnumerator>
 pls_open_stream(InputStreamPtr &&is)
 {
-	std::forward_list<DetachedSong> songs;
-	if (!ParsePls(std::move(is), songs))
+	auto e = std::make_unique<PlsSongEnumerator>(std::move(is));
+	if (!e->FindPlaylistSection()) {
+		is = e->StealInputStream();
 		return nullptr;
+	}
 
-	return std::make_unique<MemorySongEnumerator>(std::move(songs));
+	return e;
 }
 
 static const char *const pls_suffixes[] = {
@@ -19,21 +19,19 @@
 
 #include "RssPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "tag/Builder.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringView.hxx"
-#include "lib/expat/ExpatParser.hxx"
 
 /**
  * This is the state object for the our XML parser.
  */
 struct RssParser {
 	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
+	 * New songs are appended to this list.
 	 */
-	std::forward_list<DetachedSong> songs;
+	std::list<DetachedSong> &songs;
 
 	/**
 	 * The current position in the XML file.
@@ -57,8 +55,8 @@ struct RssParser {
 
 	TagBuilder tag_builder;
 
-	RssParser()
-		:state(ROOT) {}
+	RssParser(std::list<DetachedSong> &_songs) noexcept
+		:songs(_songs), state(ROOT) {}
 };
 
 static void XMLCALL
@@ -104,7 +102,7 @@ rss_end_element(void *user_data, const XML_Char *element_name)
 	case RssParser::ITEM:
 		if (StringEqualsCaseASCII(element_name, "item")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
+				parser->songs.emplace_back(std::move(parser->location),
 							    parser->tag_builder.Commit());
 
 			parser->state = RssParser::ROOT;
@@ -141,17 +139,10 @@ rss_char_data(void *user_data, const XML_Char *s, int len)
 static std::unique_ptr<SongEnumerator>
 rss_open_stream(InputStreamPtr &&is)
 {
-	RssParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(rss_start_element, rss_end_element);
-		expat.SetCharacterDataHandler(rss_char_data);
-		expat.Parse(*is);
-	}
-
-	parser.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(parser.songs));
+	return std::make_unique<ExpatSongEnumerator<RssParser>>(std::move(is),
+								rss_start_element,
+								rss_end_element,
+								rss_char_data);
 }
 
 static const char *const rss_suffixes[] = {
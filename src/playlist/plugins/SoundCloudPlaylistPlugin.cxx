@@ -19,10 +19,9 @@
 
 #include "SoundCloudPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../StreamSongEnumerator.hxx"
 #include "lib/yajl/Handle.hxx"
 #include "lib/yajl/Callbacks.hxx"
-#include "lib/yajl/ParseInputStream.hxx"
 #include "config/Block.hxx"
 #include "input/InputStream.hxx"
 #include "tag/Builder.hxx"
@@ -109,7 +108,13 @@ struct SoundCloudJsonData {
 	std::string title;
 	int got_url = 0; /* nesting level of last stream_url */
 
-	std::forward_list<DetachedSong> songs;
+	/**
+	 * New songs are appended to this list.
+	 */
+	std::list<DetachedSong> &songs;
+
+	explicit SoundCloudJsonData(std::list<DetachedSong> &_songs) noexcept
+		:songs(_songs) {}
 
 	bool Integer(long long value) noexcept;
 	bool String(StringView value) noexcept;
@@ -194,7 +199,7 @@ SoundCloudJsonData::EndMap() noexcept
 	if (!title.empty())
 		tag.AddItem(TAG_NAME, title.c_str());
 
-	songs.emplace_front(u.c_str(), tag.Commit());
+	songs.emplace_back(u.c_str(), tag.Commit());
 
 	return true;
 }
@@ -215,17 +220,29 @@ static constexpr yajl_callbacks parse_callbacks = {
 };
 
 /**
- * Read JSON data and parse it using the given YAJL parser.
- * @param url URL of the JSON data.
- * @param handle YAJL parser handle.
+ * Parses the JSON response incrementally, returning each track as
+ * soon as it is complete.
  */
-static void
-soundcloud_parse_json(const char *url, Yajl::Handle &handle,
-		      Mutex &mutex)
-{
-	auto input_stream = InputStream::OpenReady(url, mutex);
-	Yajl::ParseInputStream(handle, *input_stream);
-}
+class SoundCloudSongEnumerator final : public StreamSongEnumerator {
+	SoundCloudJsonData data;
+	Yajl::Handle handle;
+
+public:
+	explicit SoundCloudSongEnumerator(InputStreamPtr &&_is) noexcept
+		:StreamSongEnumerator(std::move(_is)),
+		 data(songs),
+		 handle(&parse_callbacks, nullptr, &data) {}
+
+protected:
+	/* virtual methods from class StreamSongEnumerator */
+	void Parse(const char *p, size_t length) override {
+		handle.Parse((const unsigned char *)p, length);
+	}
+
+	void CompleteParse() override {
+		handle.CompleteParse();
+	}
+};
 
 /**
  * Parse a soundcloud:// URL and create a playlist.
@@ -275,12 +292,7 @@ soundcloud_open_uri(const char *uri, Mutex &mutex)
 		return nullptr;
 	}
 
-	SoundCloudJsonData data;
-	Yajl::Handle handle(&parse_callbacks, nullptr, &data);
-	soundcloud_parse_json(u, handle, mutex);
-
-	data.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(data.songs));
+	return std::make_unique<SoundCloudSongEnumerator>(InputStream::OpenReady(u, mutex));
 }
 
 static const char *const soundcloud_schemes[] = {
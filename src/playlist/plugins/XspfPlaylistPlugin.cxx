@@ -19,12 +19,11 @@
 
 #include "XspfPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "song/DetachedSong.hxx"
 #include "input/InputStream.hxx"
 #include "tag/Builder.hxx"
 #include "util/StringView.hxx"
-#include "lib/expat/ExpatParser.hxx"
 
 #include <string.h>
 
@@ -33,10 +32,9 @@
  */
 struct XspfParser {
 	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
+	 * New songs are appended to this list.
 	 */
-	std::forward_list<DetachedSong> songs;
+	std::list<DetachedSong> &songs;
 
 	/**
 	 * The current position in the XML file.
@@ -60,8 +58,8 @@ struct XspfParser {
 
 	TagBuilder tag_builder;
 
-	XspfParser()
-		:state(ROOT) {}
+	XspfParser(std::list<DetachedSong> &_songs) noexcept
+		:songs(_songs), state(ROOT) {}
 };
 
 static void XMLCALL
@@ -139,7 +137,7 @@ xspf_end_element(void *user_data, const XML_Char *element_name)
 	case XspfParser::TRACK:
 		if (strcmp(element_name, "track") == 0) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
+				parser->songs.emplace_back(std::move(parser->location),
 							    parser->tag_builder.Commit());
 
 			parser->state = XspfParser::TRACKLIST;
@@ -188,17 +186,10 @@ xspf_char_data(void *user_data, const XML_Char *s, int len)
 static std::unique_ptr<SongEnumerator>
 xspf_open_stream(InputStreamPtr &&is)
 {
-	XspfParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(xspf_start_element, xspf_end_element);
-		expat.SetCharacterDataHandler(xspf_char_data);
-		expat.Parse(*is);
-	}
-
-	parser.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(parser.songs));
+	return std::make_unique<ExpatSongEnumerator<XspfParser>>(std::move(is),
+								xspf_start_element,
+								xspf_end_element,
+								xspf_char_data);
 }
 
 static const char *const xspf_suffixes[] = {
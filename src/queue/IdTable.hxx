@@ -23,38 +23,64 @@
 #include "util/Compiler.h"
 
 #include <algorithm>
+#include <memory>
 
 #include <assert.h>
 
 /**
- * A table that maps id numbers to position numbers.
+ * A table that maps id numbers to position numbers.  It is empty
+ * initially and grows on demand (see Reserve()).
  */
 class IdTable {
-	unsigned size;
+	/**
+	 * The upper limit for #size.
+	 */
+	const unsigned max_size;
 
-	unsigned next;
+	unsigned size = 0;
 
-	int *const data;
+	unsigned next = 1;
 
-public:
-	IdTable(unsigned _size) noexcept
-		:size(_size), next(1), data(new int[size]) {
-		std::fill_n(data, size, -1);
-	}
+	std::unique_ptr<int[]> data;
 
-	~IdTable() noexcept {
-		delete[] data;
-	}
+public:
+	explicit IdTable(unsigned _max_size) noexcept
+		:max_size(_max_size) {}
 
 	IdTable(const IdTable &) = delete;
 	IdTable &operator=(const IdTable &) = delete;
 
+	/**
+	 * Returns the number of bytes allocated for the table.
+	 */
+	std::size_t GetMemoryUsage() const noexcept {
+		return size * sizeof(data[0]);
+	}
+
 	int IdToPosition(unsigned id) const noexcept {
 		return id < size
 			? data[id]
 			: -1;
 	}
 
+	/**
+	 * Enlarge the id number space to at least the specified size
+	 * (but not more than the configured maximum).  Existing ids
+	 * remain valid.
+	 */
+	void Reserve(unsigned new_size) noexcept {
+		new_size = std::min(new_size, max_size);
+		if (new_size <= size)
+			return;
+
+		std::unique_ptr<int[]> new_data(new int[new_size]);
+		std::copy_n(data.get(), size, new_data.get());
+		std::fill_n(new_data.get() + size, new_size - size, -1);
+
+		data = std::move(new_data);
+		size = new_size;
+	}
+
 	unsigned GenerateId() noexcept {
 		assert(next > 0);
 		assert(next < size);
@@ -38,6 +38,13 @@ public:
 	 * been notified by the player thread.
 	 */
 	virtual void OnQueueSongStarted() noexcept = 0;
+
+	/**
+	 * Called before a song is submitted to the player.  This
+	 * gives the listener a chance to complete a placeholder song
+	 * (see #LazySongResolver).
+	 */
+	virtual void OnQueueSongNeeded(unsigned id) noexcept = 0;
 };
 
 #endif
@@ -69,6 +69,8 @@ playlist::QueueSongOrder(PlayerControl &pc, unsigned order) noexcept
 
 	queued = order;
 
+	listener.OnQueueSongNeeded(queue.PositionToId(queue.OrderToPosition(order)));
+
 	const DetachedSong &song = queue.GetOrder(order);
 
 	FormatDebug(playlist_domain, "queue song %i:\"%s\"",
@@ -176,6 +178,8 @@ playlist::PlayOrder(PlayerControl &pc, unsigned order)
 	playing = true;
 	queued = -1;
 
+	listener.OnQueueSongNeeded(queue.PositionToId(queue.OrderToPosition(order)));
+
 	const DetachedSong &song = queue.GetOrder(order);
 
 	FormatDebug(playlist_domain, "play %u:\"%s\"", order, song.GetURI());
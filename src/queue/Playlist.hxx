@@ -24,6 +24,8 @@
 #include "queue/Queue.hxx"
 #include "config.h"
 
+#include <vector>
+
 enum TagType : uint8_t;
 struct Tag;
 class PlayerControl;
@@ -203,6 +205,19 @@ public:
 	 * The database has been modified.  Pull all updates.
 	 */
 	void DatabaseModified(const Database &db);
+
+	/**
+	 * Verify a range of songs against the database: update
+	 * modified songs, and delete songs which are not in the
+	 * database anymore.  This is used after the queue has been
+	 * restored from the state file without database lookups.
+	 *
+	 * @param start the first position to be checked
+	 * @param n the maximum number of songs to be checked
+	 * @return the position where the next call shall continue
+	 */
+	unsigned RefreshFromDatabase(PlayerControl &pc, const Database &db,
+				     unsigned start, unsigned n);
 #endif
 
 	/**
@@ -212,6 +227,17 @@ public:
 	 */
 	unsigned AppendSong(PlayerControl &pc, DetachedSong &&song);
 
+	/**
+	 * Append many songs at once.  This is much faster than
+	 * calling AppendSong() for each: the queue is enlarged only
+	 * once, the new songs are shuffled into the queue only once
+	 * (in random mode), and listeners are notified only once.
+	 *
+	 * Throws PlaylistError if the queue would be too large; the
+	 * songs which fit have been added nonetheless.
+	 */
+	void AppendSongs(PlayerControl &pc, std::vector<DetachedSong> &&songs);
+
 	/**
 	 * Throws #std::runtime_error on error.
 	 *
@@ -23,6 +23,7 @@
  */
 
 #include "Playlist.hxx"
+#include "Listener.hxx"
 #include "PlaylistError.hxx"
 #include "player/Control.hxx"
 #include "song/DetachedSong.hxx"
@@ -227,6 +228,8 @@ playlist::SeekSongOrder(PlayerControl &pc, unsigned i, SongTime seek_time)
 
 	queued = -1;
 
+	listener.OnQueueSongNeeded(queue.PositionToId(queue.OrderToPosition(i)));
+
 	try {
 		pc.LockSeek(std::make_unique<DetachedSong>(queue.GetOrder(i)), seek_time);
 	} catch (...) {
@@ -52,14 +52,26 @@
 #define PLAYLIST_STATE_FILE_MIXRAMPDELAY	"mixrampdelay: "
 #define PLAYLIST_STATE_FILE_PLAYLIST_BEGIN	"playlist_begin"
 #define PLAYLIST_STATE_FILE_PLAYLIST_END	"playlist_end"
+#define PLAYLIST_STATE_FILE_PLAYLIST_EXTERNAL	"playlist_external"
 
 #define PLAYLIST_STATE_FILE_STATE_PLAY		"play"
 #define PLAYLIST_STATE_FILE_STATE_PAUSE		"pause"
 #define PLAYLIST_STATE_FILE_STATE_STOP		"stop"
 
 void
-playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
-		    PlayerControl &pc)
+playlist_state_save_queue(const StateFileConfig &config,
+			  BufferedOutputStream &os,
+			  const struct playlist &playlist)
+{
+	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN "\n");
+	queue_save(os, playlist.queue, config.queue_metadata);
+	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_END "\n");
+}
+
+void
+playlist_state_save(const StateFileConfig &config,
+		    BufferedOutputStream &os, const struct playlist &playlist,
+		    PlayerControl &pc, bool external_queue)
 {
 	const auto player_status = pc.LockGetStatus();
 
@@ -95,13 +107,16 @@ playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
 	os.Format(PLAYLIST_STATE_FILE_MIXRAMPDB "%f\n", pc.GetMixRampDb());
 	os.Format(PLAYLIST_STATE_FILE_MIXRAMPDELAY "%f\n",
 		  pc.GetMixRampDelay().count());
-	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN "\n");
-	queue_save(os, playlist.queue);
-	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_END "\n");
+
+	if (external_queue)
+		os.Write(PLAYLIST_STATE_FILE_PLAYLIST_EXTERNAL "\n");
+	else
+		playlist_state_save_queue(config, os, playlist);
 }
 
 static void
-playlist_state_load(TextFile &file, const SongLoader &song_loader,
+playlist_state_load(const StateFileConfig &config,
+		    TextFile &file, const SongLoader &song_loader,
 		    struct playlist &playlist)
 {
 	const char *line = file.ReadLine();
@@ -110,24 +125,38 @@ playlist_state_load(TextFile &file, const SongLoader &song_loader,
 		return;
 	}
 
-	while (!StringStartsWith(line, PLAYLIST_STATE_FILE_PLAYLIST_END)) {
-		queue_load_song(file, song_loader, line, playlist.queue);
+	QueueLoader loader(song_loader, playlist.queue,
+			   config.queue_metadata);
 
-		line = file.ReadLine();
-		if (line == nullptr) {
-			LogWarning(playlist_domain,
-				   "'" PLAYLIST_STATE_FILE_PLAYLIST_END
-				   "' not found in state file");
-			break;
+	try {
+		while (!StringStartsWith(line, PLAYLIST_STATE_FILE_PLAYLIST_END)) {
+			loader.Load(file, line);
+
+			line = file.ReadLine();
+			if (line == nullptr) {
+				LogWarning(playlist_domain,
+					   "'" PLAYLIST_STATE_FILE_PLAYLIST_END
+					   "' not found in state file");
+				break;
+			}
 		}
+	} catch (...) {
+		/* keep the songs which were loaded before the
+		   error */
+		loader.Commit();
+		playlist.queue.IncrementVersion();
+		throw;
 	}
 
+	loader.Commit();
+
 	playlist.queue.IncrementVersion();
 }
 
 bool
 playlist_state_restore(const StateFileConfig &config,
 		       const char *line, TextFile &file,
+		       TextFile *queue_file,
 		       const SongLoader &song_loader,
 		       struct playlist &playlist, PlayerControl &pc)
 {
@@ -172,7 +201,21 @@ playlist_state_restore(const StateFileConfig &config,
 			current = atoi(p);
 		} else if (StringStartsWith(line,
 					    PLAYLIST_STATE_FILE_PLAYLIST_BEGIN)) {
-			playlist_state_load(file, song_loader, playlist);
+			playlist_state_load(config, file, song_loader,
+					    playlist);
+		} else if (StringIsEqual(line,
+					 PLAYLIST_STATE_FILE_PLAYLIST_EXTERNAL)) {
+			const char *begin = queue_file != nullptr
+				? queue_file->ReadLine()
+				: nullptr;
+			if (begin != nullptr &&
+			    StringStartsWith(begin,
+					     PLAYLIST_STATE_FILE_PLAYLIST_BEGIN))
+				playlist_state_load(config, *queue_file,
+						    song_loader, playlist);
+			else
+				LogWarning(playlist_domain,
+					   "No queue file");
 		}
 	}
 
@@ -32,13 +32,31 @@ class TextFile;
 class BufferedOutputStream;
 class SongLoader;
 
+/**
+ * @param external_queue true if the queue has been saved separately
+ * with playlist_state_save_queue(); then only a reference to it is
+ * written
+ */
+void
+playlist_state_save(const StateFileConfig &config,
+		    BufferedOutputStream &os, const playlist &playlist,
+		    PlayerControl &pc, bool external_queue=false);
+
+/**
+ * Save only the queue, for StateFileConfig::queue_path.
+ */
 void
-playlist_state_save(BufferedOutputStream &os, const playlist &playlist,
-		    PlayerControl &pc);
+playlist_state_save_queue(const StateFileConfig &config,
+			  BufferedOutputStream &os, const playlist &playlist);
 
+/**
+ * @param queue_file the file written by playlist_state_save_queue();
+ * it is read if the state file refers to it; may be nullptr
+ */
 bool
 playlist_state_restore(const StateFileConfig &config,
 		       const char *line, TextFile &file,
+		       TextFile *queue_file,
 		       const SongLoader &song_loader,
 		       playlist &playlist, PlayerControl &pc);
 
@@ -19,8 +19,29 @@
 
 #include "Playlist.hxx"
 #include "db/Interface.hxx"
+#include "db/DatabaseError.hxx"
 #include "song/LightSong.hxx"
 #include "song/DetachedSong.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <algorithm>
+
+/**
+ * Copy the metadata from the database song if it was modified.
+ *
+ * @return true if the song was modified
+ */
+static bool
+UpdatePlaylistSong(DetachedSong &song, const LightSong &original)
+{
+	if (original.mtime == song.GetLastModified())
+		/* not modified */
+		return false;
+
+	song.SetLastModified(original.mtime);
+	song.SetTag(original.tag);
+	return true;
+}
 
 static bool
 UpdatePlaylistSong(const Database &db, DetachedSong &song)
@@ -42,17 +63,8 @@ UpdatePlaylistSong(const Database &db, DetachedSong &song)
 
 	assert(original != nullptr);
 
-	if (original->mtime == song.GetLastModified()) {
-		/* not modified */
-		db.ReturnSong(original);
-		return false;
-	}
-
-	song.SetLastModified(original->mtime);
-	song.SetTag(original->tag);
-
-	db.ReturnSong(original);
-	return true;
+	AtScopeExit(&db, original) { db.ReturnSong(original); };
+	return UpdatePlaylistSong(song, *original);
 }
 
 void
@@ -70,3 +82,55 @@ playlist::DatabaseModified(const Database &db)
 	if (modified)
 		OnModified();
 }
+
+unsigned
+playlist::RefreshFromDatabase(PlayerControl &pc, const Database &db,
+			      unsigned start, unsigned n)
+{
+	bool modified = false;
+
+	unsigned i = start;
+	for (unsigned end = std::min(start + n, queue.GetLength());
+	     i < end;) {
+		DetachedSong &song = queue.Get(i);
+		if (!song.IsInDatabase() || !song.IsFile()) {
+			++i;
+			continue;
+		}
+
+		const LightSong *original;
+		try {
+			original = db.GetSong(song.GetURI());
+		} catch (const DatabaseError &e) {
+			if (e.GetCode() == DatabaseErrorCode::NOT_FOUND) {
+				/* the song was deleted from the
+				   database; the update thread didn't
+				   see it in the queue */
+				DeletePosition(pc, i);
+				--end;
+			} else
+				++i;
+
+			continue;
+		} catch (...) {
+			/* other database errors are not fatal here;
+			   keep the song */
+			++i;
+			continue;
+		}
+
+		AtScopeExit(&db, original) { db.ReturnSong(original); };
+
+		if (UpdatePlaylistSong(song, *original)) {
+			queue.ModifyAtPosition(i);
+			modified = true;
+		}
+
+		++i;
+	}
+
+	if (modified)
+		OnModified();
+
+	return i;
+}
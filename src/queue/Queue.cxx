@@ -20,10 +20,10 @@
 #include "Queue.hxx"
 #include "song/DetachedSong.hxx"
 
+#include <algorithm>
+
 Queue::Queue(unsigned _max_length) noexcept
 	:max_length(_max_length),
-	 items(new Item[max_length]),
-	 order(new unsigned[max_length]),
 	 id_table(max_length * HASH_MULT)
 {
 }
@@ -31,9 +31,45 @@ Queue::Queue(unsigned _max_length) noexcept
 Queue::~Queue() noexcept
 {
 	Clear();
+}
+
+void
+Queue::Grow() noexcept
+{
+	assert(!IsFull());
+
+	Reserve(std::max<unsigned>(items.size() * 2, INITIAL_CAPACITY));
+	assert(items.size() > length);
+}
+
+void
+Queue::Reserve(unsigned n) noexcept
+{
+	const unsigned capacity = std::min(n, max_length);
+	if (capacity <= items.size())
+		return;
+
+	items.resize(capacity);
+	order.resize(capacity);
+	inverse_order.resize(capacity);
+	id_table.Reserve(capacity * HASH_MULT);
+}
+
+std::size_t
+Queue::GetMemoryUsage() const noexcept
+{
+	std::size_t size = items.capacity() * sizeof(items.front()) +
+		order.capacity() * sizeof(order.front()) +
+		inverse_order.capacity() * sizeof(inverse_order.front()) +
+		id_table.GetMemoryUsage();
+
+	if (change_log)
+		size += CHANGE_LOG_SIZE * sizeof(change_log[0]);
+
+	for (unsigned i = 0; i < length; ++i)
+		size += items[i].song->GetMemoryUsage();
 
-	delete[] items;
-	delete[] order;
+	return size;
 }
 
 int
@@ -65,9 +101,44 @@ Queue::IncrementVersion() noexcept
 			items[i].version = 0;
 
 		version = 1;
+
+		/* the change log cannot represent the items with
+		   version 0 (which are newer than any version); it
+		   will be unusable until the queue is cleared */
+		change_log_count = 0;
+		change_log_min_version = UINT32_MAX;
 	}
 }
 
+bool
+Queue::CollectChanges(uint32_t _version,
+		      std::vector<unsigned> &positions) const
+{
+	if (_version > version || _version < change_log_min_version)
+		return false;
+
+	/* walk backwards from the newest entry; the versions in the
+	   log are monotonic */
+	unsigned i = change_log_head;
+	for (unsigned n = change_log_count; n > 0; --n) {
+		i = (i + CHANGE_LOG_SIZE - 1) % CHANGE_LOG_SIZE;
+
+		const auto &change = change_log[i];
+		if (change.version < _version)
+			break;
+
+		/* positions beyond the end have been deleted
+		   meanwhile */
+		if (change.position < length)
+			positions.push_back(change.position);
+	}
+
+	std::sort(positions.begin(), positions.end());
+	positions.erase(std::unique(positions.begin(), positions.end()),
+			positions.end());
+	return true;
+}
+
 void
 Queue::ModifyAtOrder(unsigned _order) noexcept
 {
@@ -82,16 +153,22 @@ Queue::Append(DetachedSong &&song, uint8_t priority) noexcept
 {
 	assert(!IsFull());
 
+	if (length == items.size())
+		Grow();
+
 	const unsigned position = length++;
 	const unsigned id = id_table.Insert(position);
 
 	auto &item = items[position];
 	item.song = new DetachedSong(std::move(song));
 	item.id = id;
-	item.version = version;
+	StampItem(position);
 	item.priority = priority;
 
+	index.Add(id, *item.song);
+
 	order[position] = position;
+	inverse_order[position] = position;
 
 	return id;
 }
@@ -104,8 +181,8 @@ Queue::SwapPositions(unsigned position1, unsigned position2) noexcept
 
 	std::swap(items[position1], items[position2]);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	StampItem(position1);
+	StampItem(position2);
 
 	id_table.Move(id1, position2);
 	id_table.Move(id2, position1);
@@ -130,7 +207,7 @@ Queue::MovePostion(unsigned from, unsigned to) noexcept
 
 	id_table.Move(tmp.id, to);
 	items[to] = tmp;
-	items[to].version = version;
+	StampItem(to);
 
 	/* now deal with order */
 
@@ -144,6 +221,8 @@ Queue::MovePostion(unsigned from, unsigned to) noexcept
 			else if (from == order[i])
 				order[i] = to;
 		}
+
+		UpdateInverseOrder(0, length);
 	}
 }
 
@@ -171,7 +250,7 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to) noexcept
 	{
 		id_table.Move(tmp[i - start].id, to + i - start);
 		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
+		StampItem(to + i - start);
 	}
 
 	if (random) {
@@ -187,6 +266,8 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to) noexcept
 			else if (start <= order[i] && order[i] < end)
 				order[i] += to - start;
 		}
+
+		UpdateInverseOrder(0, length);
 	}
 }
 
@@ -207,6 +288,9 @@ Queue::MoveOrder(unsigned from_order, unsigned to_order) noexcept
 	}
 
 	order[to_order] = from_position;
+
+	UpdateInverseOrder(std::min(from_order, to_order),
+			   std::max(from_order, to_order) + 1);
 	return to_order;
 }
 
@@ -243,6 +327,7 @@ Queue::DeletePosition(unsigned position) noexcept
 	/* release the song id */
 
 	id_table.Erase(id);
+	index.Remove(length);
 
 	/* delete song from songs array */
 
@@ -259,6 +344,8 @@ Queue::DeletePosition(unsigned position) noexcept
 	for (unsigned i = 0; i < length; i++)
 		if (order[i] > position)
 			--order[i];
+
+	UpdateInverseOrder(0, length);
 }
 
 void
@@ -273,6 +360,20 @@ Queue::Clear() noexcept
 	}
 
 	length = 0;
+
+	index.Invalidate();
+
+	/* all items are gone, and all new items will be logged */
+	change_log.reset();
+	change_log_head = 0;
+	change_log_count = 0;
+	change_log_min_version = 0;
+
+	/* release the memory; the arrays will grow again when new
+	   songs are added */
+	items = {};
+	order = {};
+	inverse_order = {};
 }
 
 static void
@@ -291,7 +392,8 @@ queue_sort_order_by_priority(Queue *queue,
 		return a.priority > b.priority;
 	};
 
-	std::stable_sort(queue->order + start, queue->order + end, cmp);
+	std::stable_sort(queue->order.begin() + start,
+			 queue->order.begin() + end, cmp);
 }
 
 void
@@ -302,7 +404,8 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end) noexcept
 	assert(end <= length);
 
 	rand.AutoCreate();
-	std::shuffle(order + start, order + end, rand);
+	std::shuffle(order.begin() + start, order.begin() + end, rand);
+	UpdateInverseOrder(start, end);
 }
 
 /**
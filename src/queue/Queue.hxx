@@ -22,15 +22,19 @@
 
 #include "util/Compiler.h"
 #include "IdTable.hxx"
+#include "QueueIndex.hxx"
 #include "SingleMode.hxx"
 #include "util/LazyRandomEngine.hxx"
 
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include <assert.h>
 #include <stdint.h>
 
 class DetachedSong;
+class SongFilter;
 
 /**
  * A queue of songs.  This is the backend of the playlist: it contains
@@ -44,11 +48,17 @@ class DetachedSong;
  */
 struct Queue {
 	/**
-	 * reserve max_length * HASH_MULT elements in the id
+	 * reserve capacity * HASH_MULT elements in the id
 	 * number space
 	 */
 	static constexpr unsigned HASH_MULT = 4;
 
+	/**
+	 * The initial capacity of the arrays; they grow
+	 * exponentially (see Grow()) up to #max_length.
+	 */
+	static constexpr unsigned INITIAL_CAPACITY = 64;
+
 	/**
 	 * One element of the queue: basically a song plus some queue specific
 	 * information attached.
@@ -79,15 +89,63 @@ struct Queue {
 	/** the current version number */
 	uint32_t version = 1;
 
-	/** all songs in "position" order */
-	Item *const items;
+	/**
+	 * One entry in the #change_log: an item at this position
+	 * was modified in this queue version.
+	 */
+	struct Change {
+		uint32_t version;
+		unsigned position;
+	};
+
+	static constexpr unsigned CHANGE_LOG_SIZE = 1024;
+
+	/**
+	 * A ring buffer of recent modifications; this allows
+	 * CollectChanges() to find modified items without looking
+	 * at all items.  It is allocated by the first StampItem()
+	 * call, so unused queues (e.g. of idle partitions) don't
+	 * need it.
+	 */
+	std::unique_ptr<Change[]> change_log;
+
+	/** the index of the next #change_log entry to be written */
+	unsigned change_log_head = 0;
+
+	/** the number of valid entries in #change_log */
+	unsigned change_log_count = 0;
+
+	/**
+	 * The #change_log contains all modifications at this version
+	 * and newer.  It increases when old entries are overwritten.
+	 */
+	uint32_t change_log_min_version = 0;
+
+	/**
+	 * All songs in "position" order.  The first #length elements
+	 * are used; the size of this array (and of #order and
+	 * #inverse_order) is the current capacity.
+	 */
+	std::vector<Item> items;
 
 	/** map order numbers to positions */
-	unsigned *const order;
+	std::vector<unsigned> order;
+
+	/**
+	 * Map positions to order numbers; this is the inverse of
+	 * #order, and must be updated whenever #order is modified.
+	 */
+	std::vector<unsigned> inverse_order;
 
 	/** map song ids to positions */
 	IdTable id_table;
 
+	/**
+	 * An index of URIs and tag values for "playlistfind"; it is
+	 * built on demand by LookupIndex().
+	 */
+	mutable QueueIndex index;
+
 	/** repeat playback when the end of the queue has been
 	    reached? */
 	bool repeat = false;
@@ -116,6 +174,13 @@ struct Queue {
 		return length;
 	}
 
+	/**
+	 * Determine the approximate number of bytes occupied by the
+	 * queue, including its songs.
+	 */
+	gcc_pure
+	std::size_t GetMemoryUsage() const noexcept;
+
 	/**
 	 * Determine if the queue is empty, i.e. there are no songs.
 	 */
@@ -166,13 +231,9 @@ struct Queue {
 	gcc_pure
 	unsigned PositionToOrder(unsigned position) const noexcept {
 		assert(position < length);
+		assert(order[inverse_order[position]] == position);
 
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
-
-			if (order[i] == position)
-				return i;
-		}
+		return inverse_order[position];
 	}
 
 	gcc_pure
@@ -221,6 +282,30 @@ struct Queue {
 			items[position].version == 0;
 	}
 
+	/**
+	 * Collect the positions of all songs which are newer than the
+	 * specified version (see IsNewerAtPosition()) from the change
+	 * log, sorted and without duplicates.
+	 *
+	 * @return false if the change log does not reach back far
+	 * enough; then the caller must check all positions with
+	 * IsNewerAtPosition()
+	 */
+	bool CollectChanges(uint32_t _version,
+			    std::vector<unsigned> &positions) const;
+
+	/**
+	 * Determine a superset of the positions matched by the given
+	 * filter (in ascending order) with the #index.
+	 *
+	 * @return false if the filter cannot be evaluated with the
+	 * index; then the caller must check all songs
+	 */
+	bool LookupIndex(const SongFilter &filter,
+			 std::vector<unsigned> &positions) const noexcept {
+		return index.Lookup(*this, filter, positions);
+	}
+
 	/**
 	 * Returns the order number following the specified one.  This takes
 	 * end of queue and "repeat" mode into account.
@@ -244,7 +329,11 @@ struct Queue {
 	void ModifyAtPosition(unsigned position) noexcept {
 		assert(position < length);
 
-		items[position].version = version;
+		StampItem(position);
+
+		/* the song's old values are unknown, so they cannot
+		   be removed from the index */
+		index.Invalidate();
 	}
 
 	/**
@@ -254,6 +343,13 @@ struct Queue {
 	 */
 	void ModifyAtOrder(unsigned order) noexcept;
 
+	/**
+	 * Enlarge the queue's arrays for at least the specified
+	 * number of songs (but not more than #max_length).  This is
+	 * an optimization for adding many songs at once.
+	 */
+	void Reserve(unsigned n) noexcept;
+
 	/**
 	 * Appends a song to the queue and returns its position.  Prior to
 	 * that, the caller must check if the queue is already full.
@@ -276,6 +372,8 @@ struct Queue {
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) noexcept {
 		std::swap(order[order1], order[order2]);
+		inverse_order[order[order1]] = order1;
+		inverse_order[order[order2]] = order2;
 	}
 
 	/**
@@ -328,7 +426,7 @@ struct Queue {
 	 */
 	void RestoreOrder() noexcept {
 		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
+			order[i] = inverse_order[i] = i;
 	}
 
 	/**
@@ -373,11 +471,48 @@ struct Queue {
 			      uint8_t priority, int after_order) noexcept;
 
 private:
+	/**
+	 * Set the version of the specified item to the current
+	 * version, and add it to the #change_log.
+	 */
+	void StampItem(unsigned position) noexcept {
+		items[position].version = version;
+
+		if (!change_log)
+			change_log.reset(new Change[CHANGE_LOG_SIZE]);
+
+		if (change_log_count == CHANGE_LOG_SIZE)
+			/* the oldest entry is about to be
+			   overwritten */
+			change_log_min_version =
+				change_log[change_log_head].version + 1;
+		else
+			++change_log_count;
+
+		change_log[change_log_head] = {version, position};
+		change_log_head = (change_log_head + 1) % CHANGE_LOG_SIZE;
+	}
+
+	/**
+	 * Enlarge the arrays (and the id table) for at least one more
+	 * item.  Must not be called if IsFull().
+	 */
+	void Grow() noexcept;
+
+	/**
+	 * Update #inverse_order after the specified range of #order
+	 * has been modified.
+	 */
+	void UpdateInverseOrder(unsigned start, unsigned end) noexcept {
+		for (unsigned i = start; i < end; ++i)
+			inverse_order[order[i]] = i;
+	}
+
 	void MoveItemTo(unsigned from, unsigned to) noexcept {
 		unsigned from_id = items[from].id;
 
 		items[to] = items[from];
-		items[to].version = version;
+		StampItem(to);
 		id_table.Move(from_id, to);
 	}
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "QueueIndex.hxx"
+#include "Queue.hxx"
+#include "song/DetachedSong.hxx"
+#include "song/Filter.hxx"
+#include "song/TagSongFilter.hxx"
+#include "song/UriSongFilter.hxx"
+#include "tag/Fallback.hxx"
+#include "tag/Tag.hxx"
+
+#include <algorithm>
+
+#include <stdint.h>
+
+void
+QueueIndex::Invalidate() noexcept
+{
+	uris.clear();
+	for (auto &i : values)
+		i.clear();
+
+	valid = false;
+}
+
+void
+QueueIndex::Insert(unsigned id, const DetachedSong &song) noexcept
+{
+	uris[song.GetURI()].push_back(id);
+
+	for (const auto &item : song.GetTag()) {
+		auto &list = values[item.type][item.value];
+		/* a song may have the same value twice */
+		if (list.empty() || list.back() != id)
+			list.push_back(id);
+	}
+}
+
+inline void
+QueueIndex::Build(const Queue &queue) noexcept
+{
+	Invalidate();
+
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		Insert(queue.PositionToId(i), queue.Get(i));
+
+	n_removed = 0;
+	valid = true;
+}
+
+/**
+ * Can this #StringFilter be evaluated by looking up its value in the
+ * index?
+ */
+gcc_pure
+static bool
+IsIndexable(const StringFilter &sf) noexcept
+{
+	return !sf.IsNegated() && !sf.GetFoldCase() &&
+		!sf.IsSubstring() && !sf.IsRegex() &&
+		/* an empty value also matches songs which don't
+		   have this tag at all */
+		!sf.empty();
+}
+
+gcc_pure
+static const std::vector<unsigned> *
+Find(const std::unordered_map<std::string, std::vector<unsigned>> &map,
+     const std::string &value) noexcept
+{
+	auto i = map.find(value);
+	return i != map.end()
+		? &i->second
+		: nullptr;
+}
+
+bool
+QueueIndex::Lookup(const Queue &queue, const SongFilter &filter,
+		   std::vector<unsigned> &dest) noexcept
+{
+	/* find the most selective item; a song can match a tag item
+	   through a fallback tag (e.g. "Artist" for "AlbumArtist"),
+	   so the posting lists of those need to be merged */
+
+	bool found = false;
+	size_t best_size = SIZE_MAX;
+	std::vector<const PostingList *> best;
+	std::vector<const PostingList *> lists;
+
+	for (const auto &i : filter.GetItems()) {
+		lists.clear();
+		size_t size = 0;
+
+		if (const auto *u = dynamic_cast<const UriSongFilter *>(i.get())) {
+			if (!IsIndexable(u->GetStringFilter()))
+				continue;
+
+			if (!valid)
+				Build(queue);
+
+			const auto *list = Find(uris, u->GetValue());
+			if (list != nullptr) {
+				lists.push_back(list);
+				size = list->size();
+			}
+		} else if (const auto *t = dynamic_cast<const TagSongFilter *>(i.get())) {
+			if (t->GetTagType() >= TAG_NUM_OF_ITEM_TYPES ||
+			    !IsIndexable(t->GetStringFilter()))
+				continue;
+
+			if (!valid)
+				Build(queue);
+
+			ApplyTagWithFallback(t->GetTagType(), [&](TagType type){
+					const auto *list = Find(values[type],
+								t->GetValue());
+					if (list != nullptr) {
+						lists.push_back(list);
+						size += list->size();
+					}
+
+					return false;
+				});
+		} else
+			continue;
+
+		if (size < best_size) {
+			found = true;
+			best_size = size;
+			best.swap(lists);
+		}
+	}
+
+	if (!found)
+		return false;
+
+	/* translate the ids to positions, skipping ids which have
+	   been removed from the queue (see Remove()); an id may have
+	   been reused by another song, but the caller applies the
+	   filter anyway */
+
+	dest.reserve(best_size);
+
+	for (const auto *list : best) {
+		for (unsigned id : *list) {
+			const int position = queue.IdToPosition(id);
+			if (position >= 0)
+				dest.push_back(position);
+		}
+	}
+
+	std::sort(dest.begin(), dest.end());
+	dest.erase(std::unique(dest.begin(), dest.end()), dest.end());
+	return true;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_INDEX_HXX
+#define MPD_QUEUE_INDEX_HXX
+
+#include "tag/Type.h"
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Queue;
+class DetachedSong;
+class SongFilter;
+
+/**
+ * An inverted index mapping URIs and tag values to the ids of the
+ * #Queue items which have them.  It allows "playlistfind" to answer
+ * exact matches without evaluating the filter on every song.
+ *
+ * The index is built by the first Lookup() call, so queues which are
+ * never searched do not pay for it.  After that, Add() and Remove()
+ * update it incrementally.  Since the old values of a modified song
+ * are not known, Invalidate() discards the whole index, and it gets
+ * rebuilt by the next Lookup().
+ *
+ * Removed items are not erased from the posting lists (that would
+ * require a linear search); their ids are skipped by Lookup(), and
+ * the index is rebuilt when there are too many stale entries.
+ */
+class QueueIndex {
+	typedef std::vector<unsigned> PostingList;
+	typedef std::unordered_map<std::string, PostingList> ValueMap;
+
+	/**
+	 * Maps each URI to the ids which have it.
+	 */
+	ValueMap uris;
+
+	/**
+	 * For each tag type, this maps each value to the ids which
+	 * have it.
+	 */
+	std::array<ValueMap, TAG_NUM_OF_ITEM_TYPES> values;
+
+	/**
+	 * The number of Remove() calls since the index was built.
+	 */
+	unsigned n_removed;
+
+	bool valid = false;
+
+public:
+	bool IsValid() const noexcept {
+		return valid;
+	}
+
+	void Invalidate() noexcept;
+
+	/**
+	 * A song has been appended to the queue.
+	 */
+	void Add(unsigned id, const DetachedSong &song) noexcept {
+		if (valid)
+			Insert(id, song);
+	}
+
+	/**
+	 * A song has been removed from the queue.
+	 *
+	 * @param length the new length of the queue
+	 */
+	void Remove(unsigned length) noexcept {
+		if (valid && ++n_removed > length)
+			/* more than half of the entries are stale */
+			Invalidate();
+	}
+
+	/**
+	 * Determine a superset of the positions matched by the given
+	 * filter, in ascending order.  The caller is responsible for
+	 * applying the filter to each of them.
+	 *
+	 * @return false if the filter cannot be evaluated with this
+	 * index (because it contains neither an exact URI nor an
+	 * exact tag match)
+	 */
+	bool Lookup(const Queue &queue, const SongFilter &filter,
+		    std::vector<unsigned> &dest) noexcept;
+
+private:
+	void Build(const Queue &queue) noexcept;
+
+	void Insert(unsigned id, const DetachedSong &song) noexcept;
+};
+
+#endif
@@ -25,6 +25,8 @@
 #include "song/LightSong.hxx"
 #include "client/Response.hxx"
 
+#include <vector>
+
 /**
  * Send detailed information about a range of songs in the queue to a
  * client.
@@ -70,10 +72,16 @@ queue_print_uris(Response &r, const Queue &queue,
 	}
 }
 
-void
-queue_print_changes_info(Response &r, const Queue &queue,
-			 uint32_t version,
-			 unsigned start, unsigned end)
+/**
+ * Invoke the given function for each position in the given range
+ * which is newer than the specified version, in ascending order.
+ * This uses the queue's change log if possible, and falls back to
+ * checking all positions.
+ */
+template<typename F>
+static void
+ForEachChange(const Queue &queue, uint32_t version,
+	      unsigned start, unsigned end, F &&f)
 {
 	assert(start <= end);
 
@@ -83,9 +91,27 @@ queue_print_changes_info(Response &r, const Queue &queue,
 	if (end > queue.GetLength())
 		end = queue.GetLength();
 
+	std::vector<unsigned> positions;
+	if (queue.CollectChanges(version, positions)) {
+		for (unsigned i : positions)
+			if (i >= start && i < end)
+				f(i);
+		return;
+	}
+
 	for (unsigned i = start; i < end; i++)
 		if (queue.IsNewerAtPosition(i, version))
+			f(i);
+}
+
+void
+queue_print_changes_info(Response &r, const Queue &queue,
+			 uint32_t version,
+			 unsigned start, unsigned end)
+{
+	ForEachChange(queue, version, start, end, [&r, &queue](unsigned i){
 			queue_print_song_info(r, queue, i);
+		});
 }
 
 void
@@ -93,24 +119,28 @@ queue_print_changes_position(Response &r, const Queue &queue,
 			     uint32_t version,
 			     unsigned start, unsigned end)
 {
-	assert(start <= end);
-
-	if (start >= queue.GetLength())
-		return;
-
-	if (end > queue.GetLength())
-		end = queue.GetLength();
-
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
+	ForEachChange(queue, version, start, end, [&r, &queue](unsigned i){
 			r.Format("cpos: %i\nId: %i\n",
 				 i, queue.PositionToId(i));
+		});
 }
 
 void
 queue_find(Response &r, const Queue &queue,
 	   const SongFilter &filter)
 {
+	std::vector<unsigned> positions;
+	if (queue.LookupIndex(filter, positions)) {
+		for (unsigned i : positions) {
+			const LightSong song{queue.Get(i)};
+
+			if (filter.Match(song))
+				queue_print_song_info(r, queue, i);
+		}
+
+		return;
+	}
+
 	for (unsigned i = 0; i < queue.GetLength(); i++) {
 		const LightSong song{queue.Get(i)};
 
@@ -17,17 +17,24 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "QueueSave.hxx"
 #include "Queue.hxx"
 #include "PlaylistError.hxx"
 #include "song/DetachedSong.hxx"
 #include "SongSave.hxx"
 #include "playlist/PlaylistSong.hxx"
+#include "SongLoader.hxx"
+#include "time/ChronoUtil.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "util/StringCompare.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_DATABASE
+#include "storage/StorageInterface.hxx"
+#endif
+
 #include <exception>
 
 #include <stdlib.h>
@@ -48,9 +55,10 @@ queue_save_full_song(BufferedOutputStream &os, const DetachedSong &song)
 }
 
 static void
-queue_save_song(BufferedOutputStream &os, int idx, const DetachedSong &song)
+queue_save_song(BufferedOutputStream &os, int idx, const DetachedSong &song,
+		bool metadata)
 {
-	if (song.IsInDatabase() &&
+	if (!metadata && song.IsInDatabase() &&
 	    song.GetStartTime().IsZero() && song.GetEndTime().IsZero())
 		/* use the brief format (just the URI) for "full"
 		   database songs */
@@ -62,14 +70,14 @@ queue_save_song(BufferedOutputStream &os, int idx, const DetachedSong &song)
 }
 
 void
-queue_save(BufferedOutputStream &os, const Queue &queue)
+queue_save(BufferedOutputStream &os, const Queue &queue, bool metadata)
 {
 	for (unsigned i = 0; i < queue.GetLength(); i++) {
 		uint8_t prio = queue.GetPriorityAtPosition(i);
 		if (prio != 0)
 			os.Format(PRIO_LABEL "%u\n", prio);
 
-		queue_save_song(os, i, queue.Get(i));
+		queue_save_song(os, i, queue.Get(i), metadata);
 	}
 }
 
@@ -93,11 +101,41 @@ LoadQueueSong(TextFile &file, const char *line)
 	}
 }
 
+/**
+ * Prepare a database song loaded from the state file (with all of
+ * its metadata) for the queue, without looking it up in the
+ * database.
+ *
+ * @return false if this is not such a song, and it must be checked
+ * with playlist_check_translate_song()
+ */
+static bool
+RestoreDatabaseSong(DetachedSong &song, const SongLoader &loader) noexcept
+{
+#ifdef ENABLE_DATABASE
+	if (loader.GetDatabase() == nullptr ||
+	    !song.IsInDatabase() || !song.IsFile() ||
+	    !song.GetStartTime().IsZero() || !song.GetEndTime().IsZero() ||
+	    IsNegative(song.GetLastModified()))
+		return false;
+
+	/* this is what DatabaseDetachSong() would do */
+	const auto *storage = loader.GetStorage();
+	if (storage != nullptr)
+		song.SetRealURI(storage->MapUTF8(song.GetURI()));
+
+	return true;
+#else
+	(void)song;
+	(void)loader;
+	return false;
+#endif
+}
+
 void
-queue_load_song(TextFile &file, const SongLoader &loader,
-		const char *line, Queue &queue)
+QueueLoader::Load(TextFile &file, const char *line)
 {
-	if (queue.IsFull())
+	if (queue.GetLength() + items.size() >= queue.max_length)
 		return;
 
 	uint8_t priority = 0;
@@ -110,10 +148,38 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 			return;
 	}
 
+	const bool full = StringStartsWith(line, SONG_BEGIN);
 	auto song = LoadQueueSong(file, line);
 
-	if (!playlist_check_translate_song(song, nullptr, loader))
-		return;
+	const bool check = !(metadata && full &&
+			     RestoreDatabaseSong(song, loader));
+	if (check)
+		playlist_translate_song_uri(song, nullptr);
+
+	items.push_back({std::move(song), priority, check});
+}
+
+void
+QueueLoader::Commit()
+{
+	std::vector<DetachedSong *> check;
+	for (auto &i : items)
+		if (i.check)
+			check.push_back(&i.song);
+
+	const auto valid = playlist_check_load_songs({check.data(), check.size()},
+						     loader);
+
+	std::size_t j = 0;
+	for (auto &i : items) {
+		if (i.check && !valid[j++])
+			continue;
+
+		if (queue.IsFull())
+			break;
+
+		queue.Append(std::move(i.song), i.priority);
+	}
 
-	queue.Append(std::move(song), priority);
+	items.clear();
 }
@@ -25,21 +25,67 @@
 #ifndef MPD_QUEUE_SAVE_HXX
 #define MPD_QUEUE_SAVE_HXX
 
+#include "song/DetachedSong.hxx"
+
+#include <cstdint>
+#include <vector>
+
 struct Queue;
 class BufferedOutputStream;
 class TextFile;
 class SongLoader;
 
+/**
+ * @param metadata save the metadata of database songs, too (instead
+ * of just the URI), to allow restoring them without database lookups
+ */
 void
-queue_save(BufferedOutputStream &os, const Queue &queue);
+queue_save(BufferedOutputStream &os, const Queue &queue, bool metadata);
 
 /**
- * Loads one song from the state file and appends it to the queue.
- *
- * Throws on error.
+ * Loads songs from the state file and appends them to the queue.
+ * They are collected first, and Commit() verifies them all at once
+ * (see playlist_check_load_songs()).
  */
-void
-queue_load_song(TextFile &file, const SongLoader &loader,
-		const char *line, Queue &queue);
+class QueueLoader {
+	const SongLoader &loader;
+	Queue &queue;
+
+	/**
+	 * Trust the metadata of database songs stored in the state
+	 * file, and don't look them up in the database.
+	 */
+	const bool metadata;
+
+	struct Item {
+		DetachedSong song;
+		uint8_t priority;
+
+		/**
+		 * Does this song need to be verified by Commit()?
+		 */
+		bool check;
+	};
+
+	std::vector<Item> items;
+
+public:
+	QueueLoader(const SongLoader &_loader, Queue &_queue,
+		    bool _metadata) noexcept
+		:loader(_loader), queue(_queue), metadata(_metadata) {}
+
+	/**
+	 * Loads one song from the state file.
+	 *
+	 * Throws on error.
+	 */
+	void Load(TextFile &file, const char *line);
+
+	/**
+	 * Verify all songs loaded so far and append them to the
+	 * queue.
+	 */
+	void Commit();
+};
 
 #endif
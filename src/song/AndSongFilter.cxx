@@ -18,6 +18,8 @@
  */
 
 #include "AndSongFilter.hxx"
+#include "LightSong.hxx"
+#include "tag/Tag.hxx"
 
 ISongFilterPtr
 AndSongFilter::Clone() const noexcept
@@ -27,6 +29,7 @@ AndSongFilter::Clone() const noexcept
 	for (const auto &i : items)
 		result->items.emplace_back(i->Clone());
 
+	result->required_tags = required_tags;
 	return result;
 }
 
@@ -51,9 +54,41 @@ AndSongFilter::ToExpression() const noexcept
 	return e;
 }
 
+gcc_pure
+static TagMask
+GetTagTypes(const Tag &tag) noexcept
+{
+	TagMask mask = TagMask::None();
+
+	const TagType *types = tag.GetItemTypes();
+	for (unsigned i = 0, n = tag.num_items; i != n; ++i)
+		mask.Set(types[i]);
+
+	return mask;
+}
+
+bool
+AndSongFilter::MatchTagTypes(const Tag &tag) const noexcept
+{
+	if (required_tags.empty())
+		return true;
+
+	const TagMask present = GetTagTypes(tag);
+	for (const auto &i : required_tags)
+		if (!(present & i).TestAny())
+			return false;
+
+	return true;
+}
+
 bool
 AndSongFilter::Match(const LightSong &song) const noexcept
 {
+	/* with only one item, the tag type pre-check would merely
+	   duplicate the work of that item */
+	if (items.size() > 1 && !MatchTagTypes(song.tag))
+		return false;
+
 	for (const auto &i : items)
 		if (!i->Match(song))
 			return false;
@@ -21,9 +21,13 @@
 #define MPD_AND_SONG_FILTER_HXX
 
 #include "ISongFilter.hxx"
+#include "tag/Mask.hxx"
 #include "util/Compiler.h"
 
 #include <list>
+#include <vector>
+
+struct Tag;
 
 /**
  * Combine multiple #ISongFilter instances with logical "and".
@@ -31,6 +35,15 @@
 class AndSongFilter final : public ISongFilter {
 	std::list<ISongFilterPtr> items;
 
+	/**
+	 * Each matching song has at least one tag type of each of
+	 * these masks (a tag type plus its fallbacks).  This is
+	 * derived from the #TagSongFilter items by
+	 * OptimizeSongFilter(), and allows rejecting songs before any
+	 * string is compared.
+	 */
+	std::vector<TagMask> required_tags;
+
 	friend void OptimizeSongFilter(AndSongFilter &) noexcept;
 	friend ISongFilterPtr OptimizeSongFilter(ISongFilterPtr) noexcept;
 
@@ -49,6 +62,15 @@ public:
 		return items.empty();
 	}
 
+	/**
+	 * Check only whether the #Tag has all tag types required by
+	 * this filter (see #required_tags).  If this returns false,
+	 * then Match() would return false as well, but a true return
+	 * value doesn't mean the song matches.
+	 */
+	gcc_pure
+	bool MatchTagTypes(const Tag &tag) const noexcept;
+
 	/* virtual methods from ISongFilter */
 	ISongFilterPtr Clone() const noexcept override;
 	std::string ToExpression() const noexcept override;
@@ -28,7 +28,8 @@ DetachedSong::DetachedSong(const LightSong &other)
 	 tag(other.tag),
 	 mtime(other.mtime),
 	 start_time(other.start_time),
-	 end_time(other.end_time) {}
+	 end_time(other.end_time),
+	 replay_gain(other.replay_gain) {}
 
 DetachedSong::operator LightSong() const noexcept
 {
@@ -38,6 +39,7 @@ DetachedSong::operator LightSong() const noexcept
 	result.mtime = mtime;
 	result.start_time = start_time;
 	result.end_time = end_time;
+	result.replay_gain = replay_gain;
 	return result;
 }
 
@@ -76,3 +78,23 @@ DetachedSong::GetDuration() const noexcept
 
 	return SignedSongTime(b - a);
 }
+
+/**
+ * Returns the heap memory allocated by the given std::string, or 0
+ * if it uses the small string optimization.
+ */
+gcc_pure
+static std::size_t
+GetHeapSize(const std::string &s) noexcept
+{
+	return s.capacity() >= sizeof(s)
+		? s.capacity() + 1
+		: 0;
+}
+
+std::size_t
+DetachedSong::GetMemoryUsage() const noexcept
+{
+	return sizeof(*this) + GetHeapSize(uri) + GetHeapSize(real_uri) +
+		tag.num_items * Tag::ItemSize();
+}
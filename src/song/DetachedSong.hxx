@@ -22,6 +22,7 @@
 
 #include "tag/Tag.hxx"
 #include "Chrono.hxx"
+#include "ReplayGainInfo.hxx"
 #include "util/Compiler.h"
 
 #include <chrono>
@@ -79,6 +80,13 @@ class DetachedSong {
 	 */
 	SongTime end_time = SongTime::zero();
 
+	/**
+	 * The ReplayGain values measured by the database update
+	 * ("update_loudness_analysis").  They are only used if the
+	 * decoder plugin does not find ReplayGain tags.
+	 */
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+
 public:
 	explicit DetachedSong(const char *_uri)
 		:uri(_uri) {}
@@ -228,9 +236,25 @@ public:
 		end_time = _value;
 	}
 
+	const ReplayGainInfo &GetReplayGain() const noexcept {
+		return replay_gain;
+	}
+
+	void SetReplayGain(const ReplayGainInfo &_value) noexcept {
+		replay_gain = _value;
+	}
+
 	gcc_pure
 	SignedSongTime GetDuration() const noexcept;
 
+	/**
+	 * Determine the approximate number of bytes occupied by this
+	 * object, including its URIs and the tag item array (but not
+	 * the tag items, which are shared in the tag pool).
+	 */
+	gcc_pure
+	std::size_t GetMemoryUsage() const noexcept;
+
 	/**
 	 * Update the #tag and #mtime.
 	 *
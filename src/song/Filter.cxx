@@ -25,6 +25,7 @@
 #include "TagSongFilter.hxx"
 #include "ModifiedSinceSongFilter.hxx"
 #include "AudioFormatSongFilter.hxx"
+#include "StickerSongFilter.hxx"
 #include "AudioParser.hxx"
 #include "tag/ParseName.hxx"
 #include "time/ISO8601.hxx"
@@ -43,6 +44,7 @@
 #define LOCATE_TAG_FILE_KEY     "file"
 #define LOCATE_TAG_FILE_KEY_OLD "filename"
 #define LOCATE_TAG_ANY_KEY      "any"
+#define LOCATE_TAG_STICKER_PREFIX "sticker:"
 
 enum {
 	/**
@@ -240,6 +242,72 @@ ParseStringFilter(const char *&s, bool fold_case)
 			    fold_case, false, negated);
 }
 
+/**
+ * Parse the sticker name following the "sticker:" prefix.
+ *
+ * Throws on error.
+ */
+static std::string
+ExpectStickerName(const char *&s)
+{
+	const char *begin = s;
+	while (!IsWhitespaceOrNull(*s) && *s != ')')
+		++s;
+
+	if (s == begin)
+		throw std::runtime_error("Sticker name expected");
+
+	std::string name(begin, s);
+	s = StripLeft(s);
+	return name;
+}
+
+/**
+ * Parse the (optional) operator and operand of a "sticker:" filter
+ * and convert it to a #StickerSongFilter.
+ *
+ * Throws on error.
+ */
+static ISongFilterPtr
+ParseStickerFilter(const char *&s)
+{
+	auto name = ExpectStickerName(s);
+
+	if (*s == ')')
+		return std::make_unique<StickerSongFilter>(std::move(name),
+							   StickerOperator::EXISTS,
+							   std::string());
+
+	StickerOperator op;
+	if (s[0] == '=' && s[1] == '=') {
+		op = StickerOperator::EQUALS;
+		s += 2;
+	} else if (s[0] == '<') {
+		op = StickerOperator::LESS_THAN;
+		++s;
+	} else if (s[0] == '>') {
+		op = StickerOperator::GREATER_THAN;
+		++s;
+	} else if (IsTagNameChar(*s)) {
+		const auto op_name = ExpectWord(s);
+		if (op_name == "eq")
+			op = StickerOperator::EQUALS_INT;
+		else if (op_name == "lt")
+			op = StickerOperator::LESS_THAN_INT;
+		else if (op_name == "gt")
+			op = StickerOperator::GREATER_THAN_INT;
+		else
+			throw std::runtime_error("Sticker operator expected");
+	} else
+		throw std::runtime_error("Sticker operator expected");
+
+	s = StripLeft(s);
+	auto value = ExpectQuoted(s);
+
+	return std::make_unique<StickerSongFilter>(std::move(name), op,
+						   std::move(value));
+}
+
 ISongFilterPtr
 SongFilter::ParseExpression(const char *&s, bool fold_case)
 {
@@ -287,6 +355,15 @@ SongFilter::ParseExpression(const char *&s, bool fold_case)
 		return std::make_unique<NotSongFilter>(std::move(inner));
 	}
 
+	if (auto after_sticker = StringAfterPrefix(s, LOCATE_TAG_STICKER_PREFIX)) {
+		s = after_sticker;
+		auto filter = ParseStickerFilter(s);
+		if (*s != ')')
+			throw std::runtime_error("')' expected");
+		s = StripLeft(s + 1);
+		return filter;
+	}
+
 	auto type = ExpectFilterType(s);
 
 	if (type == LOCATE_TAG_MODIFIED_SINCE) {
@@ -342,6 +419,17 @@ SongFilter::ParseExpression(const char *&s, bool fold_case)
 void
 SongFilter::Parse(const char *tag_string, const char *value, bool fold_case)
 {
+	if (auto sticker_name = StringAfterPrefix(tag_string,
+						  LOCATE_TAG_STICKER_PREFIX)) {
+		if (*sticker_name == 0)
+			throw std::runtime_error("Sticker name expected");
+
+		and_filter.AddItem(std::make_unique<StickerSongFilter>(sticker_name,
+								       StickerOperator::EQUALS,
+								       value));
+		return;
+	}
+
 	unsigned tag = locate_parse_type(tag_string);
 
 	switch (tag) {
@@ -438,6 +526,46 @@ SongFilter::HasFoldCase() const noexcept
 	return false;
 }
 
+bool
+SongFilter::HasExactTagMatch() const noexcept
+{
+	for (const auto &i : and_filter.GetItems()) {
+		const auto *t = dynamic_cast<const TagSongFilter *>(i.get());
+		if (t == nullptr)
+			continue;
+
+		const auto &sf = t->GetStringFilter();
+		if (!sf.IsNegated() && !sf.GetFoldCase() &&
+		    !sf.IsSubstring() && !sf.IsRegex() && !sf.empty())
+			return true;
+	}
+
+	return false;
+}
+
+gcc_pure
+static bool
+HasSticker(const ISongFilter &f) noexcept
+{
+	if (dynamic_cast<const StickerSongFilter *>(&f) != nullptr)
+		return true;
+
+	if (auto a = dynamic_cast<const AndSongFilter *>(&f)) {
+		for (const auto &i : a->GetItems())
+			if (HasSticker(*i))
+				return true;
+	} else if (auto n = dynamic_cast<const NotSongFilter *>(&f))
+		return HasSticker(n->GetChild());
+
+	return false;
+}
+
+bool
+SongFilter::HasSticker() const noexcept
+{
+	return ::HasSticker(and_filter);
+}
+
 bool
 SongFilter::HasOtherThanBase() const noexcept
 {
@@ -32,8 +32,15 @@
  */
 #define SORT_TAG_LAST_MODIFIED (TAG_NUM_OF_ITEM_TYPES + 3)
 
+/**
+ * Special value for the db_selection_print() sort parameter: sort by
+ * the sticker map in DatabaseSelection::sort_stickers.
+ */
+#define SORT_TAG_STICKER (TAG_NUM_OF_ITEM_TYPES + 4)
+
 template<typename T> struct ConstBuffer;
 enum TagType : uint8_t;
+struct Tag;
 struct LightSong;
 
 class SongFilter {
@@ -73,6 +80,16 @@ public:
 	gcc_pure
 	bool Match(const LightSong &song) const noexcept;
 
+	/**
+	 * A quick check which looks only at the tag types present in
+	 * the #Tag; see AndSongFilter::MatchTagTypes().  This allows
+	 * rejecting songs before a #LightSong is constructed.
+	 */
+	gcc_pure
+	bool MatchTagTypes(const Tag &tag) const noexcept {
+		return and_filter.MatchTagTypes(tag);
+	}
+
 	const auto &GetItems() const noexcept {
 		return and_filter.GetItems();
 	}
@@ -88,6 +105,22 @@ public:
 	gcc_pure
 	bool HasFoldCase() const noexcept;
 
+	/**
+	 * Is there at least one tag item which matches the value
+	 * exactly (i.e. not negated, case sensitive, no substring or
+	 * regular expression)?  Such a filter can be looked up in a
+	 * tag index.
+	 */
+	gcc_pure
+	bool HasExactTagMatch() const noexcept;
+
+	/**
+	 * Is there at least one "sticker" item?  Its result depends
+	 * on the sticker database, not only on the song.
+	 */
+	gcc_pure
+	bool HasSticker() const noexcept;
+
 	/**
 	 * Does this filter contain constraints other than "base"?
 	 */
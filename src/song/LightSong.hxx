@@ -22,6 +22,7 @@
 
 #include "Chrono.hxx"
 #include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
 #include "util/Compiler.h"
 
 #include <string>
@@ -85,6 +86,12 @@ struct LightSong {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * ReplayGain values measured by the database update; see
+	 * Song::GetReplayGain().
+	 */
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+
 	LightSong(const char *_uri, const Tag &_tag) noexcept
 		:uri(_uri), tag(_tag) {}
 
@@ -22,6 +22,95 @@
 #include "NotSongFilter.hxx"
 #include "TagSongFilter.hxx"
 #include "UriSongFilter.hxx"
+#include "BaseSongFilter.hxx"
+#include "ModifiedSinceSongFilter.hxx"
+#include "AudioFormatSongFilter.hxx"
+#include "tag/Type.h"
+#include "tag/Fallback.hxx"
+
+/**
+ * Estimate the cost of comparing a #StringFilter.
+ */
+gcc_pure
+static unsigned
+EstimateCost(const StringFilter &f, bool pool_lookup) noexcept
+{
+	if (f.IsRegex())
+		return 50;
+
+	unsigned cost = f.IsSubstring() ? 6 : 4;
+	if (f.GetFoldCase())
+		cost *= 3;
+	else if (pool_lookup && !f.IsSubstring())
+		/* compares tag pool ids, see TagSongFilter */
+		cost = 2;
+
+	return cost;
+}
+
+/**
+ * Estimate the relative cost of ISongFilter::Match().  The numbers
+ * are only meaningful in relation to each other.
+ */
+gcc_pure
+static unsigned
+EstimateCost(const ISongFilter &f) noexcept
+{
+	if (dynamic_cast<const BaseSongFilter *>(&f) != nullptr ||
+	    dynamic_cast<const ModifiedSinceSongFilter *>(&f) != nullptr ||
+	    dynamic_cast<const AudioFormatSongFilter *>(&f) != nullptr)
+		/* a string prefix or an integer comparison */
+		return 1;
+
+	if (auto *tf = dynamic_cast<const TagSongFilter *>(&f)) {
+		const unsigned cost =
+			EstimateCost(tf->GetStringFilter(), !tf->GetValue().empty());
+		return tf->GetTagType() == TAG_NUM_OF_ITEM_TYPES
+			/* "any": all tag items are compared */
+			? cost * 4
+			: cost;
+	}
+
+	if (auto *uf = dynamic_cast<const UriSongFilter *>(&f))
+		return EstimateCost(uf->GetStringFilter(), false);
+
+	if (auto *nf = dynamic_cast<const NotSongFilter *>(&f))
+		return EstimateCost(nf->GetChild());
+
+	if (auto *af = dynamic_cast<const AndSongFilter *>(&f)) {
+		unsigned cost = 0;
+		for (const auto &i : af->GetItems())
+			cost += EstimateCost(*i);
+		return cost;
+	}
+
+	/* unknown (e.g. sticker): assume it's expensive */
+	return 20;
+}
+
+/**
+ * If the given filter can only match songs which have a certain tag
+ * type (or one of its fallbacks), return a mask of these types;
+ * otherwise TagMask::None().
+ */
+gcc_pure
+static TagMask
+GetRequiredTags(const ISongFilter &f) noexcept
+{
+	const auto *tf = dynamic_cast<const TagSongFilter *>(&f);
+	if (tf == nullptr || tf->IsNegated() ||
+	    tf->GetTagType() == TAG_NUM_OF_ITEM_TYPES ||
+	    /* an empty value matches songs without this tag */
+	    tf->GetValue().empty())
+		return TagMask::None();
+
+	TagMask mask = TagMask::None();
+	ApplyTagWithFallback(tf->GetTagType(), [&mask](TagType type){
+		mask.Set(type);
+		return false;
+	});
+	return mask;
+}
 
 void
 OptimizeSongFilter(AndSongFilter &af) noexcept
@@ -37,6 +126,21 @@ OptimizeSongFilter(AndSongFilter &af) noexcept
 			++i;
 		}
 	}
+
+	/* evaluate cheap items first, so expensive ones (regular
+	   expressions, case folding) run only for songs which have
+	   passed all others; std::list::sort() is stable, so the
+	   client's order is kept among items of the same cost */
+	af.items.sort([](const ISongFilterPtr &a, const ISongFilterPtr &b){
+		return EstimateCost(*a) < EstimateCost(*b);
+	});
+
+	af.required_tags.clear();
+	for (const auto &i : af.items) {
+		const auto mask = GetRequiredTags(*i);
+		if (mask.TestAny())
+			af.required_tags.push_back(mask);
+	}
 }
 
 ISongFilterPtr
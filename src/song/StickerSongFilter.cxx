@@ -0,0 +1,69 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "StickerSongFilter.hxx"
+#include "Escape.hxx"
+#include "LightSong.hxx"
+
+gcc_const
+static const char *
+GetOperatorName(StickerOperator op) noexcept
+{
+	switch (op) {
+	case StickerOperator::EXISTS:
+		break;
+
+	case StickerOperator::EQUALS:
+		return "==";
+
+	case StickerOperator::LESS_THAN:
+		return "<";
+
+	case StickerOperator::GREATER_THAN:
+		return ">";
+
+	case StickerOperator::EQUALS_INT:
+		return "eq";
+
+	case StickerOperator::LESS_THAN_INT:
+		return "lt";
+
+	case StickerOperator::GREATER_THAN_INT:
+		return "gt";
+	}
+
+	return nullptr;
+}
+
+std::string
+StickerSongFilter::ToExpression() const noexcept
+{
+	const char *op_name = GetOperatorName(op);
+	if (op_name == nullptr)
+		return "(sticker:" + name + ")";
+
+	return "(sticker:" + name + " " + op_name
+		+ " \"" + EscapeFilterString(value) + "\")";
+}
+
+bool
+StickerSongFilter::Match(const LightSong &song) const noexcept
+{
+	return values->find(song.GetURI()) != values->end();
+}
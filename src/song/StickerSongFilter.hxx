@@ -0,0 +1,86 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STICKER_SONG_FILTER_HXX
+#define MPD_STICKER_SONG_FILTER_HXX
+
+#include "ISongFilter.hxx"
+#include "sticker/Match.hxx"
+#include "sticker/ValueMap.hxx"
+
+/**
+ * Matches songs which have a sticker with the given name whose value
+ * matches the given operator/operand.
+ *
+ * This class does not access the sticker database; before the
+ * filter is used, the caller needs to load all matching stickers
+ * with sticker_song_load_filter().  Until then, no song matches.
+ */
+class StickerSongFilter final : public ISongFilter {
+	std::string name;
+
+	StickerOperator op;
+
+	std::string value;
+
+	/**
+	 * The URIs of all songs which have a matching sticker.  This
+	 * is shared among all clones of this object.
+	 */
+	std::shared_ptr<StickerValueMap> values;
+
+public:
+	template<typename N, typename V>
+	StickerSongFilter(N &&_name, StickerOperator _op, V &&_value) noexcept
+		:name(std::forward<N>(_name)), op(_op),
+		 value(std::forward<V>(_value)),
+		 values(std::make_shared<StickerValueMap>()) {}
+
+	const std::string &GetName() const noexcept {
+		return name;
+	}
+
+	StickerOperator GetOperator() const noexcept {
+		return op;
+	}
+
+	/**
+	 * @return the operand, or nullptr if the operator is
+	 * #StickerOperator::EXISTS
+	 */
+	const char *GetValue() const noexcept {
+		return op == StickerOperator::EXISTS
+			? nullptr
+			: value.c_str();
+	}
+
+	void SetValues(StickerValueMap &&_values) const noexcept {
+		*values = std::move(_values);
+	}
+
+	/* virtual methods from ISongFilter */
+	ISongFilterPtr Clone() const noexcept override {
+		return std::make_unique<StickerSongFilter>(*this);
+	}
+
+	std::string ToExpression() const noexcept override;
+	bool Match(const LightSong &song) const noexcept override;
+};
+
+#endif
@@ -18,7 +18,9 @@
  */
 
 #include "StringFilter.hxx"
-#include "util/StringAPI.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Item.hxx"
+#include "tag/Pool.hxx"
 
 #include <assert.h>
 
@@ -38,11 +40,45 @@ StringFilter::MatchWithoutNegation(const char *s) const noexcept
 			: fold_case == s;
 	} else {
 		return substring
-			? StringFind(s, value.c_str()) != nullptr
+			? search.Find(value.c_str(), s) != nullptr
 			: value == s;
 	}
 }
 
+bool
+StringFilter::MatchWithoutNegation(const TagItem &item) const noexcept
+{
+	if (IcuCompare::CanCompareFolded() && fold_case && !IsRegex()) {
+		const char *folded = tag_pool_get_folded(item);
+		if (folded != nullptr)
+			return substring
+				? fold_case.IsInFolded(folded)
+				: fold_case.EqualsFolded(folded);
+	}
+
+	return MatchWithoutNegation(item.value);
+}
+
+bool
+StringFilter::MatchAnyWithoutNegation(const Tag &tag) const noexcept
+{
+	if (IsPlainSubstring()) {
+		/* fast path: skip the per-value dispatch and call the
+		   prepared searcher directly */
+		for (const auto &i : tag)
+			if (search.Find(value.c_str(), i.value) != nullptr)
+				return true;
+
+		return false;
+	}
+
+	for (const auto &i : tag)
+		if (MatchWithoutNegation(i))
+			return true;
+
+	return false;
+}
+
 bool
 StringFilter::Match(const char *s) const noexcept
 {
@@ -21,6 +21,7 @@
 #define MPD_STRING_FILTER_HXX
 
 #include "lib/icu/Compare.hxx"
+#include "util/StringSearch.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
@@ -31,6 +32,9 @@
 #include <string>
 #include <memory>
 
+struct Tag;
+struct TagItem;
+
 class StringFilter {
 	std::string value;
 
@@ -39,6 +43,12 @@ class StringFilter {
 	 */
 	IcuCompare fold_case;
 
+	/**
+	 * The prepared substring search for #value.  This is only
+	 * set up for case-sensitive substring searches.
+	 */
+	StringSearch search;
+
 #ifdef HAVE_PCRE
 	std::shared_ptr<UniqueRegex> regex;
 #endif
@@ -57,6 +67,9 @@ public:
 		 fold_case(_fold_case
 			   ? IcuCompare(value.c_str())
 			   : IcuCompare()),
+		 search(_substring && !_fold_case
+			? StringSearch(value.data(), value.size())
+			: StringSearch()),
 		 substring(_substring), negated(_negated) {}
 
 	bool empty() const noexcept {
@@ -86,6 +99,10 @@ public:
 		return fold_case;
 	}
 
+	bool IsSubstring() const noexcept {
+		return substring;
+	}
+
 	bool IsNegated() const noexcept {
 		return negated;
 	}
@@ -110,6 +127,27 @@ public:
 	 */
 	gcc_pure
 	bool MatchWithoutNegation(const char *s) const noexcept;
+
+	/**
+	 * Like MatchWithoutNegation(const char *), but use the
+	 * case-folded value from the tag pool if one is available
+	 * (see #tag_pool_fold_case).
+	 */
+	gcc_pure
+	bool MatchWithoutNegation(const TagItem &item) const noexcept;
+
+	/**
+	 * Does any of the values of the given #Tag match (ignoring
+	 * the "negated" flag)?  The kind of comparison is chosen only
+	 * once for all values.
+	 */
+	gcc_pure
+	bool MatchAnyWithoutNegation(const Tag &tag) const noexcept;
+
+private:
+	bool IsPlainSubstring() const noexcept {
+		return substring && !fold_case && !IsRegex();
+	}
 };
 
 #endif
@@ -21,7 +21,40 @@
 #include "Escape.hxx"
 #include "LightSong.hxx"
 #include "tag/Tag.hxx"
+#include "tag/Pool.hxx"
 #include "tag/Fallback.hxx"
+#include "util/StringView.hxx"
+
+TagSongFilter::TagSongFilter(TagType _type, StringFilter &&_filter) noexcept
+	:type(_type), filter(std::move(_filter))
+{
+	if (type < TAG_NUM_OF_ITEM_TYPES && !filter.GetFoldCase() &&
+	    !filter.IsSubstring() && !filter.IsRegex() &&
+	    /* an empty value also matches songs which don't have
+	       this tag at all */
+	    !filter.empty()) {
+		/* this obtains a reference, so all songs with this
+		   value will share this item while the filter
+		   exists */
+		const auto &value = filter.GetValue();
+		pool_item = tag_pool_get_item(type, {value.data(), value.size()});
+		pool_item_id = tag_pool_get_id(*pool_item);
+	}
+}
+
+TagSongFilter::TagSongFilter(const TagSongFilter &src) noexcept
+	:ISongFilter(src), type(src.type), filter(src.filter),
+	 pool_item(src.pool_item), pool_item_id(src.pool_item_id)
+{
+	if (pool_item != nullptr)
+		tag_pool_dup_item(pool_item);
+}
+
+TagSongFilter::~TagSongFilter() noexcept
+{
+	if (pool_item != nullptr)
+		tag_pool_put_item(pool_item);
+}
 
 std::string
 TagSongFilter::ToExpression() const noexcept
@@ -37,13 +70,41 @@ TagSongFilter::ToExpression() const noexcept
 bool
 TagSongFilter::Match(const Tag &tag) const noexcept
 {
+	if (pool_item != nullptr) {
+		/* fast path: compare tag pool ids; the tag items
+		   need not be looked up at all */
+		const TagType *types = tag.GetItemTypes();
+		bool found_type = false;
+
+		for (unsigned i = 0, n = tag.num_items; i != n; ++i) {
+			if (types[i] == type) {
+				if (tag.GetItemId(i) == pool_item_id)
+					return !filter.IsNegated();
+
+				found_type = true;
+			}
+		}
+
+		if (found_type)
+			return filter.IsNegated();
+
+		/* the type is not present; the code below checks the
+		   fallback tags */
+	}
+
+	if (type == TAG_NUM_OF_ITEM_TYPES)
+		/* "any": there are no fallbacks, just scan all
+		   values */
+		return filter.MatchAnyWithoutNegation(tag) !=
+			filter.IsNegated();
+
 	bool visited_types[TAG_NUM_OF_ITEM_TYPES]{};
 
 	for (const auto &i : tag) {
 		visited_types[i.type] = true;
 
 		if ((type == TAG_NUM_OF_ITEM_TYPES || i.type == type) &&
-		    filter.MatchWithoutNegation(i.value))
+		    filter.MatchWithoutNegation(i))
 			return !filter.IsNegated();
 	}
 
@@ -61,7 +122,7 @@ TagSongFilter::Match(const Tag &tag) const noexcept
 
 			for (const auto &item : tag) {
 				if (item.type == tag2 &&
-				    filter.MatchWithoutNegation(item.value)) {
+				    filter.MatchWithoutNegation(item)) {
 					result = true;
 					break;
 				}
@@ -27,6 +27,7 @@
 
 enum TagType : uint8_t;
 struct Tag;
+struct TagItem;
 struct LightSong;
 
 class TagSongFilter final : public ISongFilter {
@@ -34,9 +35,25 @@ class TagSongFilter final : public ISongFilter {
 
 	StringFilter filter;
 
+	/**
+	 * If the filter compares the whole value of one tag type
+	 * (case-sensitive), then this is a reference to the
+	 * #TagItem in the tag pool.  Since each type/value pair has
+	 * only one item, the tag pool ids can be compared instead of
+	 * the strings.
+	 */
+	TagItem *pool_item = nullptr;
+
+	uint32_t pool_item_id;
+
 public:
-	TagSongFilter(TagType _type, StringFilter &&_filter) noexcept
-		:type(_type), filter(std::move(_filter)) {}
+	TagSongFilter(TagType _type, StringFilter &&_filter) noexcept;
+
+	TagSongFilter(const TagSongFilter &src) noexcept;
+
+	~TagSongFilter() noexcept;
+
+	TagSongFilter &operator=(const TagSongFilter &) = delete;
 
 	TagType GetTagType() const {
 		return type;
@@ -46,6 +63,10 @@ public:
 		return filter.GetValue();
 	}
 
+	const StringFilter &GetStringFilter() const noexcept {
+		return filter;
+	}
+
 	bool GetFoldCase() const {
 		return filter.GetFoldCase();
 	}
@@ -34,6 +34,10 @@ public:
 		return filter.GetValue();
 	}
 
+	const StringFilter &GetStringFilter() const noexcept {
+		return filter;
+	}
+
 	bool GetFoldCase() const {
 		return filter.GetFoldCase();
 	}
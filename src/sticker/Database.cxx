@@ -24,7 +24,10 @@
 #include "Idle.hxx"
 #include "util/StringCompare.hxx"
 #include "util/ScopeExit.hxx"
+#include "thread/Name.hxx"
+#include "Log.hxx"
 
+#include <algorithm>
 #include <iterator>
 
 #include <assert.h>
@@ -42,6 +45,9 @@ enum sticker_sql {
 	STICKER_SQL_FIND_VALUE,
 	STICKER_SQL_FIND_LT,
 	STICKER_SQL_FIND_GT,
+	STICKER_SQL_FIND_EQ_INT,
+	STICKER_SQL_FIND_LT_INT,
+	STICKER_SQL_FIND_GT_INT,
 	STICKER_SQL_COUNT
 };
 
@@ -58,17 +64,29 @@ static const char *const sticker_sql[] = {
 	"DELETE FROM sticker WHERE type=? AND uri=?",
 	//[STICKER_SQL_DELETE_VALUE] =
 	"DELETE FROM sticker WHERE type=? AND uri=? AND name=?",
+	/* the URI prefix is matched with a half-open range instead
+	   of "LIKE", which allows using an index */
+
 	//[STICKER_SQL_FIND] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=?",
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=?",
 
 	//[STICKER_SQL_FIND_VALUE] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value=?",
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=? AND value=?",
 
 	//[STICKER_SQL_FIND_LT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value<?",
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=? AND value<?",
 
 	//[STICKER_SQL_FIND_GT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value>?",
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=? AND value>?",
+
+	//[STICKER_SQL_FIND_EQ_INT] =
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=? AND CAST(value AS INTEGER)=CAST(? AS INTEGER)",
+
+	//[STICKER_SQL_FIND_LT_INT] =
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=? AND CAST(value AS INTEGER)<CAST(? AS INTEGER)",
+
+	//[STICKER_SQL_FIND_GT_INT] =
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=? AND CAST(value AS INTEGER)>CAST(? AS INTEGER)",
 };
 
 static const char sticker_sql_create[] =
@@ -80,22 +98,67 @@ static const char sticker_sql_create[] =
 	");"
 	"CREATE UNIQUE INDEX IF NOT EXISTS"
 	" sticker_value ON sticker(type, uri, name);"
+	/* a covering index for "sticker find": equality on type and
+	   name, a range on uri, and the value is compared without
+	   looking up the table row */
+	"CREATE INDEX IF NOT EXISTS"
+	" sticker_name_uri ON sticker(type, name, uri, value);"
 	"";
 
+/**
+ * Returns the smallest string which is bigger than all strings
+ * beginning with the given prefix; together with the prefix, this
+ * forms a half-open range for a query on the "uri" column.  UTF-8
+ * never contains the byte 0xff, therefore "\xff" is bigger than all
+ * URIs.
+ */
+static std::string
+PrefixUpperBound(const char *prefix) noexcept
+{
+	std::string result(prefix);
+	while (!result.empty() && (unsigned char)result.back() == 0xff)
+		result.pop_back();
+
+	if (result.empty())
+		return "\xff";
+
+	++result.back();
+	return result;
+}
+
+/**
+ * Pending writes are committed after this duration, together in one
+ * transaction.
+ */
+static constexpr std::chrono::seconds STICKER_COMMIT_DELAY(2);
+
+static void
+ExecuteSql(sqlite3 *db, const char *sql, const char *msg)
+{
+	int ret = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK)
+		throw SqliteError(db, ret, msg);
+}
+
 StickerDatabase::StickerDatabase(Path path)
-	:db(path.c_str())
+	:db(path.c_str()),
+	 writer(BIND_THIS_METHOD(WriterThread))
 {
 	assert(!path.IsNull());
 
-	int ret;
+	/* with WAL, readers and the writer don't block each other,
+	   and a commit needs fewer fsync() calls */
+
+	ExecuteSql(db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;",
+		   "Failed to enable WAL mode");
 
 	/* create the table and index */
 
-	ret = sqlite3_exec(db, sticker_sql_create,
-			   nullptr, nullptr, nullptr);
-	if (ret != SQLITE_OK)
-		throw SqliteError(db, ret,
-				  "Failed to create sticker table");
+	ExecuteSql(db, sticker_sql_create, "Failed to create sticker table");
+
+	write_db = Sqlite::Database(path.c_str());
+	ExecuteSql(write_db, "PRAGMA synchronous=NORMAL;",
+		   "Failed to configure sticker database");
 
 	/* prepare the statements we're going to use */
 
@@ -103,17 +166,30 @@ StickerDatabase::StickerDatabase(Path path)
 		assert(sticker_sql[i] != nullptr);
 
 		stmt[i] = Prepare(db, sticker_sql[i]);
+		write_stmt[i] = Prepare(write_db, sticker_sql[i]);
 	}
+
+	writer.Start();
 }
 
 StickerDatabase::~StickerDatabase() noexcept
 {
 	assert(db != nullptr);
 
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		quit = true;
+		cond.notify_one();
+	}
+
+	writer.Join();
+
 	for (unsigned i = 0; i < std::size(stmt); ++i) {
 		assert(stmt[i] != nullptr);
+		assert(write_stmt[i] != nullptr);
 
 		sqlite3_finalize(stmt[i]);
+		sqlite3_finalize(write_stmt[i]);
 	}
 }
 
@@ -129,6 +205,21 @@ StickerDatabase::LoadValue(const char *type, const char *uri, const char *name)
 	if (StringIsEmpty(name))
 		return std::string();
 
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		auto i = pending.find(Key(type, uri, name));
+		if (i != pending.end())
+			return i->second.deleted
+				? std::string()
+				: i->second.value;
+
+		if (pending.find(Key(type, uri, "")) != pending.end())
+			/* all stickers of this object are being
+			   deleted */
+			return std::string();
+	}
+
 	BindAll(s, type, uri, name);
 
 	AtScopeExit(s) {
@@ -164,13 +255,33 @@ StickerDatabase::ListValues(std::map<std::string, std::string> &table,
 		const char *value = (const char *)sqlite3_column_text(s, 1);
 		table.insert(std::make_pair(name, value));
 	});
+
+	/* apply the pending writes; the entries of this object are
+	   contiguous, beginning with the one which deletes all of
+	   them */
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	for (auto i = pending.lower_bound(Key(type, uri, ""));
+	     i != pending.end() &&
+		     std::get<0>(i->first) == type &&
+		     std::get<1>(i->first) == uri;
+	     ++i) {
+		const auto &name = std::get<2>(i->first);
+		if (name.empty())
+			table.clear();
+		else if (i->second.deleted)
+			table.erase(name);
+		else
+			table[name] = i->second.value;
+	}
 }
 
 bool
 StickerDatabase::UpdateValue(const char *type, const char *uri,
 			     const char *name, const char *value)
 {
-	sqlite3_stmt *const s = stmt[STICKER_SQL_UPDATE];
+	sqlite3_stmt *const s = write_stmt[STICKER_SQL_UPDATE];
 
 	assert(type != nullptr);
 	assert(uri != nullptr);
@@ -185,18 +296,14 @@ StickerDatabase::UpdateValue(const char *type, const char *uri,
 		sqlite3_clear_bindings(s);
 	};
 
-	bool modified = ExecuteModified(s);
-
-	if (modified)
-		idle_add(IDLE_STICKER);
-	return modified;
+	return ExecuteModified(s);
 }
 
 void
 StickerDatabase::InsertValue(const char *type, const char *uri,
 			     const char *name, const char *value)
 {
-	sqlite3_stmt *const s = stmt[STICKER_SQL_INSERT];
+	sqlite3_stmt *const s = write_stmt[STICKER_SQL_INSERT];
 
 	assert(type != nullptr);
 	assert(uri != nullptr);
@@ -212,6 +319,21 @@ StickerDatabase::InsertValue(const char *type, const char *uri,
 	};
 
 	ExecuteCommand(s);
+}
+
+void
+StickerDatabase::Enqueue(const char *type, const char *uri, const char *name,
+			 const char *value, bool deleted) noexcept
+{
+	if (pending.empty())
+		/* start the commit timer */
+		cond.notify_one();
+
+	auto &w = pending[Key(type, uri, name)];
+	w.value = value;
+	w.serial = ++serial;
+	w.deleted = deleted;
+
 	idle_add(IDLE_STICKER);
 }
 
@@ -227,51 +349,175 @@ StickerDatabase::StoreValue(const char *type, const char *uri,
 	if (StringIsEmpty(name))
 		return;
 
-	if (!UpdateValue(type, uri, name, value))
-		InsertValue(type, uri, name, value);
+	const std::lock_guard<Mutex> protect(mutex);
+	Enqueue(type, uri, name, value, false);
 }
 
 bool
 StickerDatabase::Delete(const char *type, const char *uri)
 {
-	sqlite3_stmt *const s = stmt[STICKER_SQL_DELETE];
-
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
-	BindAll(s, type, uri);
+	std::map<std::string, std::string> table;
+	ListValues(table, type, uri);
+	if (table.empty())
+		return false;
 
-	AtScopeExit(s) {
-		sqlite3_reset(s);
-		sqlite3_clear_bindings(s);
-	};
+	const std::lock_guard<Mutex> protect(mutex);
 
-	bool modified = ExecuteModified(s);
-	if (modified)
-		idle_add(IDLE_STICKER);
-	return modified;
+	/* the pending writes of this object are obsolete; the
+	   "delete all" entry applies to what has been committed
+	   already */
+	auto i = pending.lower_bound(Key(type, uri, ""));
+	while (i != pending.end() &&
+	       std::get<0>(i->first) == type &&
+	       std::get<1>(i->first) == uri)
+		i = pending.erase(i);
+
+	Enqueue(type, uri, "", "", true);
+	return true;
 }
 
 bool
 StickerDatabase::DeleteValue(const char *type, const char *uri,
 			     const char *name)
 {
-	sqlite3_stmt *const s = stmt[STICKER_SQL_DELETE_VALUE];
-
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
-	BindAll(s, type, uri, name);
+	if (LoadValue(type, uri, name).empty())
+		return false;
 
-	AtScopeExit(s) {
-		sqlite3_reset(s);
-		sqlite3_clear_bindings(s);
-	};
+	const std::lock_guard<Mutex> protect(mutex);
+	Enqueue(type, uri, name, "", true);
+	return true;
+}
+
+void
+StickerDatabase::Commit(const std::vector<std::pair<Key, PendingWrite>> &writes)
+{
+	ExecuteSql(write_db, "BEGIN", "Failed to begin sticker transaction");
+
+	try {
+		for (const auto &i : writes) {
+			const char *type = std::get<0>(i.first).c_str();
+			const char *uri = std::get<1>(i.first).c_str();
+			const char *name = std::get<2>(i.first).c_str();
+			const auto &w = i.second;
+
+			if (!w.deleted) {
+				if (!UpdateValue(type, uri, name,
+						 w.value.c_str()))
+					InsertValue(type, uri, name,
+						    w.value.c_str());
+				continue;
+			}
+
+			sqlite3_stmt *const s = *name == 0
+				? write_stmt[STICKER_SQL_DELETE]
+				: write_stmt[STICKER_SQL_DELETE_VALUE];
+
+			if (*name == 0)
+				BindAll(s, type, uri);
+			else
+				BindAll(s, type, uri, name);
+
+			AtScopeExit(s) {
+				sqlite3_reset(s);
+				sqlite3_clear_bindings(s);
+			};
+
+			ExecuteCommand(s);
+		}
+
+		ExecuteSql(write_db, "COMMIT",
+			   "Failed to commit sticker transaction");
+	} catch (...) {
+		sqlite3_exec(write_db, "ROLLBACK", nullptr, nullptr, nullptr);
+		throw;
+	}
+}
 
-	bool modified = ExecuteModified(s);
-	if (modified)
-		idle_add(IDLE_STICKER);
-	return modified;
+void
+StickerDatabase::WriterThread() noexcept
+{
+	SetThreadName("sticker");
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (true) {
+		if (pending.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(lock);
+			continue;
+		}
+
+		if (!quit && !flush_requested)
+			/* collect more writes for this transaction */
+			cond.wait_for(lock, STICKER_COMMIT_DELAY);
+
+		flush_requested = false;
+
+		std::vector<std::pair<Key, PendingWrite>> writes(pending.begin(),
+								 pending.end());
+		std::sort(writes.begin(), writes.end(),
+			  [](const auto &a, const auto &b){
+				  return a.second.serial < b.second.serial;
+			  });
+
+		lock.unlock();
+
+		bool success = true;
+		try {
+			Commit(writes);
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to write sticker database");
+			success = false;
+		}
+
+		lock.lock();
+
+		if (success) {
+			/* remove the committed entries, unless they
+			   have been replaced in the meantime */
+			for (const auto &i : writes) {
+				auto j = pending.find(i.first);
+				if (j != pending.end() &&
+				    j->second.serial == i.second.serial)
+					pending.erase(j);
+			}
+		}
+
+		++cycle;
+		committed_cond.notify_all();
+
+		if (!success && quit)
+			/* give up */
+			break;
+	}
+}
+
+void
+StickerDatabase::Flush() noexcept
+{
+	std::unique_lock<Mutex> lock(mutex);
+	if (pending.empty())
+		return;
+
+	/* the transaction currently running may not include all
+	   pending writes; wait for the next one */
+	const unsigned end_cycle = cycle + 2;
+
+	flush_requested = true;
+	cond.notify_one();
+
+	committed_cond.wait(lock, [this, end_cycle]{
+		return pending.empty() || int(cycle - end_cycle) >= 0;
+	});
 }
 
 Sticker
@@ -286,34 +532,49 @@ StickerDatabase::Load(const char *type, const char *uri)
 
 sqlite3_stmt *
 StickerDatabase::BindFind(const char *type, const char *base_uri,
-			  const char *name,
+			  const char *base_uri_end, const char *name,
 			  StickerOperator op, const char *value)
 {
 	assert(type != nullptr);
+	assert(base_uri != nullptr);
+	assert(base_uri_end != nullptr);
 	assert(name != nullptr);
 
-	if (base_uri == nullptr)
-		base_uri = "";
-
 	switch (op) {
 	case StickerOperator::EXISTS:
-		BindAll(stmt[STICKER_SQL_FIND], type, base_uri, name);
+		BindAll(stmt[STICKER_SQL_FIND], type, base_uri, base_uri_end,
+			name);
 		return stmt[STICKER_SQL_FIND];
 
 	case StickerOperator::EQUALS:
 		BindAll(stmt[STICKER_SQL_FIND_VALUE],
-			type, base_uri, name, value);
+			type, base_uri, base_uri_end, name, value);
 		return stmt[STICKER_SQL_FIND_VALUE];
 
 	case StickerOperator::LESS_THAN:
 		BindAll(stmt[STICKER_SQL_FIND_LT],
-			type, base_uri, name, value);
+			type, base_uri, base_uri_end, name, value);
 		return stmt[STICKER_SQL_FIND_LT];
 
 	case StickerOperator::GREATER_THAN:
 		BindAll(stmt[STICKER_SQL_FIND_GT],
-			type, base_uri, name, value);
+			type, base_uri, base_uri_end, name, value);
 		return stmt[STICKER_SQL_FIND_GT];
+
+	case StickerOperator::EQUALS_INT:
+		BindAll(stmt[STICKER_SQL_FIND_EQ_INT],
+			type, base_uri, base_uri_end, name, value);
+		return stmt[STICKER_SQL_FIND_EQ_INT];
+
+	case StickerOperator::LESS_THAN_INT:
+		BindAll(stmt[STICKER_SQL_FIND_LT_INT],
+			type, base_uri, base_uri_end, name, value);
+		return stmt[STICKER_SQL_FIND_LT_INT];
+
+	case StickerOperator::GREATER_THAN_INT:
+		BindAll(stmt[STICKER_SQL_FIND_GT_INT],
+			type, base_uri, base_uri_end, name, value);
+		return stmt[STICKER_SQL_FIND_GT_INT];
 	}
 
 	assert(false);
@@ -329,7 +590,19 @@ StickerDatabase::Find(const char *type, const char *base_uri, const char *name,
 {
 	assert(func != nullptr);
 
-	sqlite3_stmt *const s = BindFind(type, base_uri, name, op, value);
+	/* the query needs to see all pending writes */
+	Flush();
+
+	if (base_uri == nullptr)
+		base_uri = "";
+
+	/* must outlive the statement, because the bindings
+	   reference it */
+	const std::string base_uri_end = PrefixUpperBound(base_uri);
+
+	sqlite3_stmt *const s = BindFind(type, base_uri,
+					 base_uri_end.c_str(), name,
+					 op, value);
 	assert(s != nullptr);
 
 	AtScopeExit(s) {
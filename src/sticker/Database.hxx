@@ -44,11 +44,18 @@
 
 #include "Match.hxx"
 #include "lib/sqlite/Database.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
 
 #include <sqlite3.h>
 
 #include <map>
 #include <string>
+#include <tuple>
+#include <vector>
+
+#include <stdint.h>
 
 class Path;
 struct Sticker;
@@ -65,13 +72,87 @@ class StickerDatabase {
 		  SQL_FIND_VALUE,
 		  SQL_FIND_LT,
 		  SQL_FIND_GT,
+		  SQL_FIND_EQ_INT,
+		  SQL_FIND_LT_INT,
+		  SQL_FIND_GT_INT,
 
 		  SQL_COUNT
 	};
 
+	/**
+	 * The connection used by the caller's thread; it only reads.
+	 */
 	Sqlite::Database db;
 	sqlite3_stmt *stmt[SQL_COUNT];
 
+	/**
+	 * The connection used by the #writer thread.  Thanks to WAL
+	 * mode, the other connection can read while a transaction is
+	 * being committed.
+	 */
+	Sqlite::Database write_db;
+	sqlite3_stmt *write_stmt[SQL_COUNT];
+
+	/**
+	 * (type, uri, name); an empty name refers to all stickers of
+	 * the object.
+	 */
+	using Key = std::tuple<std::string, std::string, std::string>;
+
+	/**
+	 * A write which has not yet been committed.
+	 */
+	struct PendingWrite {
+		std::string value;
+
+		/**
+		 * Used to apply the writes in the order they were
+		 * submitted, and to detect whether an entry was
+		 * replaced while it was being committed.
+		 */
+		uint64_t serial;
+
+		/**
+		 * If true, then the sticker (or all stickers of the
+		 * object) shall be deleted.
+		 */
+		bool deleted;
+	};
+
+	/**
+	 * Protects #pending, #serial, #cycle, #flush_requested and
+	 * #quit.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Wakes up the #writer thread.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled by the #writer thread after each transaction.
+	 */
+	Cond committed_cond;
+
+	/**
+	 * The write-behind queue.  It is also consulted by readers,
+	 * so they see the pending writes.
+	 */
+	std::map<Key, PendingWrite> pending;
+
+	uint64_t serial = 0;
+
+	/**
+	 * The number of transactions attempted by the #writer
+	 * thread.
+	 */
+	unsigned cycle = 0;
+
+	bool flush_requested = false, quit = false;
+
+	Thread writer;
+
 public:
 	/**
 	 * Opens the sticker database.
@@ -92,9 +173,9 @@ public:
 
 	/**
 	 * Sets a sticker value in the specified object.  Overwrites existing
-	 * values.
-	 *
-	 * Throws #SqliteError on error.
+	 * values.  The value is written by a background thread, together
+	 * with other writes in one transaction; until then, it is kept in
+	 * memory, therefore errors are only logged.
 	 */
 	void StoreValue(const char *type, const char *uri,
 			const char *name, const char *value);
@@ -146,14 +227,35 @@ private:
 	void ListValues(std::map<std::string, std::string> &table,
 			const char *type, const char *uri);
 
+	/**
+	 * Add a write to the queue.  Caller must lock #mutex.
+	 */
+	void Enqueue(const char *type, const char *uri, const char *name,
+		     const char *value, bool deleted) noexcept;
+
+	/**
+	 * Wait until the #writer thread has committed all pending
+	 * writes (or has failed to do so).
+	 */
+	void Flush() noexcept;
+
+	/* these run in the #writer thread */
 	bool UpdateValue(const char *type, const char *uri,
 			 const char *name, const char *value);
 
 	void InsertValue(const char *type, const char *uri,
 			 const char *name, const char *value);
 
+	void Commit(const std::vector<std::pair<Key, PendingWrite>> &writes);
+
+	void WriterThread() noexcept;
+
+	/**
+	 * @param base_uri_end the upper bound of the URI range,
+	 * see PrefixUpperBound()
+	 */
 	sqlite3_stmt *BindFind(const char *type, const char *base_uri,
-			       const char *name,
+			       const char *base_uri_end, const char *name,
 			       StickerOperator op, const char *value);
 };
 
@@ -44,6 +44,21 @@ enum class StickerOperator {
 	 * value bigger than the specified one.
 	 */
 	GREATER_THAN,
+
+	/**
+	 * Like #EQUALS, but compare the values as integers.
+	 */
+	EQUALS_INT,
+
+	/**
+	 * Like #LESS_THAN, but compare the values as integers.
+	 */
+	LESS_THAN_INT,
+
+	/**
+	 * Like #GREATER_THAN, but compare the values as integers.
+	 */
+	GREATER_THAN_INT,
 };
 
 #endif
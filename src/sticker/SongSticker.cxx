@@ -21,6 +21,10 @@
 #include "Sticker.hxx"
 #include "Database.hxx"
 #include "song/LightSong.hxx"
+#include "song/Filter.hxx"
+#include "song/AndSongFilter.hxx"
+#include "song/NotSongFilter.hxx"
+#include "song/StickerSongFilter.hxx"
 #include "db/Interface.hxx"
 #include "util/Alloc.hxx"
 #include "util/ScopeExit.hxx"
@@ -133,3 +137,44 @@ sticker_song_find(StickerDatabase &sticker_database, const Database &db,
 	sticker_database.Find("song", data.base_uri, name, op, value,
 			      sticker_song_find_cb, &data);
 }
+
+static void
+sticker_song_load_values_cb(const char *uri, const char *value,
+			    void *user_data)
+{
+	auto &values = *(StickerValueMap *)user_data;
+	values.emplace(uri, value);
+}
+
+StickerValueMap
+sticker_song_load_values(StickerDatabase &db, const char *name,
+			 StickerOperator op, const char *value)
+{
+	StickerValueMap values;
+	db.Find("song", "", name, op, value,
+		sticker_song_load_values_cb, &values);
+	return values;
+}
+
+static void
+sticker_song_load_filter(StickerDatabase &db, const ISongFilter &f)
+{
+	if (auto s = dynamic_cast<const StickerSongFilter *>(&f)) {
+		s->SetValues(sticker_song_load_values(db,
+						      s->GetName().c_str(),
+						      s->GetOperator(),
+						      s->GetValue()));
+	} else if (auto a = dynamic_cast<const AndSongFilter *>(&f)) {
+		for (const auto &i : a->GetItems())
+			sticker_song_load_filter(db, *i);
+	} else if (auto n = dynamic_cast<const NotSongFilter *>(&f)) {
+		sticker_song_load_filter(db, n->GetChild());
+	}
+}
+
+void
+sticker_song_load_filter(StickerDatabase &db, const SongFilter &filter)
+{
+	for (const auto &i : filter.GetItems())
+		sticker_song_load_filter(db, *i);
+}
@@ -21,6 +21,7 @@
 #define MPD_SONG_STICKER_HXX
 
 #include "Match.hxx"
+#include "ValueMap.hxx"
 
 #include <string>
 
@@ -28,6 +29,7 @@ struct LightSong;
 struct Sticker;
 class Database;
 class StickerDatabase;
+class SongFilter;
 
 /**
  * Returns one value from a song's sticker record.
@@ -100,4 +102,25 @@ sticker_song_find(StickerDatabase &sticker_database, const Database &db,
 			       void *user_data),
 		  void *user_data);
 
+/**
+ * Loads the value of the specified sticker of all songs whose value
+ * matches.  This is one SQL query, instead of one per song.
+ *
+ * Throws #SqliteError on error.
+ */
+StickerValueMap
+sticker_song_load_values(StickerDatabase &db, const char *name,
+			 StickerOperator op=StickerOperator::EXISTS,
+			 const char *value=nullptr);
+
+/**
+ * Loads the stickers referenced by all #StickerSongFilter instances
+ * in the given #SongFilter.  This must be called before the filter is
+ * used.
+ *
+ * Throws #SqliteError on error.
+ */
+void
+sticker_song_load_filter(StickerDatabase &db, const SongFilter &filter);
+
 #endif
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STICKER_VALUE_MAP_HXX
+#define MPD_STICKER_VALUE_MAP_HXX
+
+#include <string>
+#include <unordered_map>
+
+/**
+ * Maps song URIs to the value of one sticker.  This is loaded from
+ * the sticker database once per query, so the database walk can
+ * look up the sticker of each song without a SQL query.
+ */
+using StickerValueMap = std::unordered_map<std::string, std::string>;
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PrefetchedTree.hxx"
+#include "MemoryDirectoryReader.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/StringCompare.hxx"
+
+#include <string.h>
+
+void
+PrefetchedTree::Add(Map &map, const std::string &uri_utf8,
+		    const StorageFileInfo &info) noexcept
+{
+	const char *slash = strrchr(uri_utf8.c_str(), '/');
+	if (slash == nullptr)
+		map[std::string()][uri_utf8] = info;
+	else
+		map[std::string(uri_utf8.c_str(), slash)][slash + 1] = info;
+
+	if (info.IsDirectory())
+		/* make sure empty directories are known */
+		map[uri_utf8];
+}
+
+void
+PrefetchedTree::Set(Map &&map) noexcept
+{
+	/* the old contents are moved to the caller's variable, to be
+	   freed outside of the mutex */
+	const std::lock_guard<Mutex> protect(mutex);
+	directories.swap(map);
+}
+
+void
+PrefetchedTree::Clear() noexcept
+{
+	Map old;
+
+	const std::lock_guard<Mutex> protect(mutex);
+	directories.swap(old);
+}
+
+bool
+PrefetchedTree::GetInfo(const char *uri_utf8, StorageFileInfo &info_r) const
+{
+	if (StringIsEmpty(uri_utf8))
+		return false;
+
+	const char *slash = strrchr(uri_utf8, '/');
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	const auto i = slash != nullptr
+		? directories.find(std::string(uri_utf8, slash))
+		: directories.find(std::string());
+	if (i == directories.end())
+		return false;
+
+	const auto j = i->second.find(slash != nullptr ? slash + 1 : uri_utf8);
+	if (j == i->second.end())
+		/* the directory is known, but this file is not
+		   inside */
+		throw FormatRuntimeError("No such file: %s", uri_utf8);
+
+	info_r = j->second;
+	return true;
+}
+
+std::unique_ptr<StorageDirectoryReader>
+PrefetchedTree::OpenDirectory(const char *uri_utf8) const noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	const auto i = directories.find(uri_utf8);
+	if (i == directories.end())
+		return nullptr;
+
+	MemoryStorageDirectoryReader::List entries;
+	for (const auto &j : i->second)
+		entries.emplace_front(j.first).info = j.second;
+
+	return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
+}
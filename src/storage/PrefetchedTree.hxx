@@ -0,0 +1,88 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STORAGE_PREFETCHED_TREE_HXX
+#define MPD_STORAGE_PREFETCHED_TREE_HXX
+
+#include "FileInfo.hxx"
+#include "thread/Mutex.hxx"
+
+#include <map>
+#include <memory>
+#include <string>
+
+class StorageDirectoryReader;
+
+/**
+ * A directory tree fetched in bulk by Storage::Prefetch().  Storage
+ * plugins use it to answer Storage::GetInfo() and
+ * Storage::OpenDirectory() from memory.  This class is thread-safe.
+ */
+class PrefetchedTree {
+public:
+	/**
+	 * The entries of one directory, indexed by name.
+	 */
+	using Directory = std::map<std::string, StorageFileInfo>;
+
+	/**
+	 * Maps the (relative) URI of each directory to its
+	 * entries.
+	 */
+	using Map = std::map<std::string, Directory>;
+
+private:
+	mutable Mutex mutex;
+
+	Map directories;
+
+public:
+	/**
+	 * Add an entry to a #Map; if it is a directory, an (empty)
+	 * #Directory is created for it as well.
+	 */
+	static void Add(Map &map, const std::string &uri_utf8,
+			const StorageFileInfo &info) noexcept;
+
+	/**
+	 * Replace the contents.
+	 */
+	void Set(Map &&map) noexcept;
+
+	void Clear() noexcept;
+
+	/**
+	 * Look up a file.
+	 *
+	 * Throws if the file's directory is known, but the file does
+	 * not exist.
+	 *
+	 * @param info_r receives the file information on success
+	 * @return false if the file's directory is not known
+	 */
+	bool GetInfo(const char *uri_utf8, StorageFileInfo &info_r) const;
+
+	/**
+	 * @return a reader for the directory or nullptr if it is not
+	 * known
+	 */
+	std::unique_ptr<StorageDirectoryReader> OpenDirectory(const char *uri_utf8) const noexcept;
+};
+
+#endif
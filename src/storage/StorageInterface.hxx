@@ -83,6 +83,23 @@ public:
 	 */
 	gcc_pure
 	virtual const char *MapToRelativeUTF8(const char *uri_utf8) const noexcept = 0;
+
+	/**
+	 * Announce that the whole directory tree below the given URI
+	 * is about to be visited (e.g. by the database update).  An
+	 * implementation may fetch the tree in bulk and answer the
+	 * following GetInfo() and OpenDirectory() calls from memory,
+	 * until ReleasePrefetch() is called.
+	 *
+	 * Errors are not fatal; they are reported by the following
+	 * calls.
+	 */
+	virtual void Prefetch(gcc_unused const char *uri_utf8) noexcept {}
+
+	/**
+	 * Free the data collected by Prefetch().
+	 */
+	virtual void ReleasePrefetch() noexcept {}
 };
 
 #endif
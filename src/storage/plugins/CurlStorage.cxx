@@ -22,6 +22,7 @@
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "storage/MemoryDirectoryReader.hxx"
+#include "storage/PrefetchedTree.hxx"
 #include "lib/curl/Init.hxx"
 #include "lib/curl/Global.hxx"
 #include "lib/curl/Slist.hxx"
@@ -40,18 +41,63 @@
 #include "util/StringCompare.hxx"
 #include "util/StringFormat.hxx"
 #include "util/UriExtract.hxx"
+#include "util/Domain.hxx"
+#include "util/Exception.hxx"
+#include "Log.hxx"
 
+#include <list>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
 
 #include <assert.h>
 
+static constexpr Domain curl_storage_domain("curl_storage");
+
+/**
+ * The number of "Depth: 1" PROPFIND requests which are kept in
+ * flight while prefetching a tree from a server which does not
+ * allow "Depth: infinity".
+ */
+static constexpr std::size_t PREFETCH_CONCURRENCY = 8;
+
 class CurlStorage final : public Storage {
 	const std::string base;
 
 	CurlInit curl;
 
+	PrefetchedTree prefetched;
+
+	/**
+	 * Set after the server has refused a "Depth: infinity"
+	 * PROPFIND; Prefetch() will then crawl the tree with
+	 * concurrent "Depth: 1" requests.
+	 */
+	bool infinity_refused = false;
+
+	/**
+	 * A directory listing obtained by a previous Prefetch() call.
+	 */
+	struct CachedCollection {
+		/**
+		 * The collection's "getetag" property; empty if the
+		 * server did not send one.
+		 */
+		std::string etag;
+
+		PrefetchedTree::Directory entries;
+	};
+
+	/**
+	 * Maps the (relative) URI of each directory to its
+	 * #CachedCollection.  It survives ReleasePrefetch(), so the
+	 * next Prefetch() can send conditional requests and reuse
+	 * the listings of collections which were not modified.  Only
+	 * accessed by Prefetch().
+	 */
+	std::map<std::string, CachedCollection> collection_cache;
+
 public:
 	CurlStorage(EventLoop &_loop, const char *_base)
 		:base(_base),
@@ -65,6 +111,29 @@ public:
 	std::string MapUTF8(const char *uri_utf8) const noexcept override;
 
 	const char *MapToRelativeUTF8(const char *uri_utf8) const noexcept override;
+
+	void Prefetch(const char *uri_utf8) noexcept override;
+	void ReleasePrefetch() noexcept override;
+
+private:
+	/**
+	 * Map the URI of a directory to its (absolute) collection URI,
+	 * which must end with a slash.
+	 */
+	std::string MapCollection(const char *uri_utf8) const noexcept {
+		std::string uri = MapUTF8(uri_utf8);
+		if (uri.back() != '/')
+			uri.push_back('/');
+		return uri;
+	}
+
+	/**
+	 * Fetch the tree with concurrent "Depth: 1" PROPFIND
+	 * requests.  Collections which have a known "getetag" are
+	 * requested with "If-None-Match", and if they were not
+	 * modified, their listing is taken from #collection_cache.
+	 */
+	void CrawlTree(const char *uri_utf8, PrefetchedTree::Map &tree);
 };
 
 std::string
@@ -156,6 +225,35 @@ private:
 	}
 };
 
+/**
+ * A PROPFIND request was answered with an error status.
+ */
+class PropfindError final : public std::runtime_error {
+	unsigned status;
+
+	/**
+	 * Did the response body contain the "propfind-finite-depth"
+	 * precondition (RFC 4918 9.1)?
+	 */
+	bool finite_depth;
+
+public:
+	PropfindError(unsigned _status, bool _finite_depth)
+		:std::runtime_error(StringFormat<80>("Status %u from WebDAV server; expected \"207 Multi-Status\"",
+						     _status).c_str()),
+		 status(_status), finite_depth(_finite_depth) {}
+
+	/**
+	 * Has the server refused to process a "Depth: infinity"
+	 * request?  Many servers do that with "403 Forbidden" (with
+	 * or without the "propfind-finite-depth" precondition) or
+	 * "501 Not Implemented".
+	 */
+	bool IsDepthRefused() const noexcept {
+		return finite_depth || status == 403 || status == 501;
+	}
+};
+
 /**
  * The (relevant) contents of a "<D:response>" element.
  */
@@ -166,6 +264,7 @@ struct DavResponse {
 	std::chrono::system_clock::time_point mtime =
 		std::chrono::system_clock::time_point::min();
 	uint64_t length = 0;
+	std::string etag;
 
 	bool Check() const {
 		return !href.empty();
@@ -241,6 +340,30 @@ IsXmlContentType(const std::multimap<std::string, std::string> &headers) noexcep
 class PropfindOperation : BlockingHttpRequest, CommonExpatParser {
 	CurlSlist request_headers;
 
+	/**
+	 * Was an "If-None-Match" header sent?
+	 */
+	const bool conditional;
+
+	/**
+	 * Has the server reported that the (conditional) request's
+	 * entity tag still matches?
+	 */
+	bool not_modified = false;
+
+	/**
+	 * The HTTP status if it was not "207 Multi-Status"; the
+	 * (XML) body is then scanned for a DAV "error" element
+	 * instead of "response" elements.
+	 */
+	unsigned error_status = 0;
+
+	/**
+	 * Was the "propfind-finite-depth" precondition found in the
+	 * error body?
+	 */
+	bool finite_depth = false;
+
 	enum class State {
 		ROOT,
 		RESPONSE,
@@ -249,20 +372,31 @@ class PropfindOperation : BlockingHttpRequest, CommonExpatParser {
 		TYPE,
 		MTIME,
 		LENGTH,
+		ETAG,
 	} state = State::ROOT;
 
 	DavResponse response;
 
 public:
-	PropfindOperation(CurlGlobal &_curl, const char *_uri, unsigned depth)
+	/**
+	 * @param if_none_match if not nullptr, then send this entity
+	 * tag in an "If-None-Match" header; see IsNotModified()
+	 */
+	PropfindOperation(CurlGlobal &_curl, const char *_uri, const char *depth,
+			  const char *if_none_match=nullptr)
 		:BlockingHttpRequest(_curl, _uri),
-		 CommonExpatParser(ExpatNamespaceSeparator{'|'})
+		 CommonExpatParser(ExpatNamespaceSeparator{'|'}),
+		 conditional(if_none_match != nullptr)
 	{
 		request.SetOption(CURLOPT_CUSTOMREQUEST, "PROPFIND");
 		request.SetOption(CURLOPT_FOLLOWLOCATION, 1l);
 		request.SetOption(CURLOPT_MAXREDIRS, 1l);
 
-		request_headers.Append(StringFormat<40>("depth: %u", depth));
+		request_headers.Append(StringFormat<40>("depth: %s", depth));
+
+		if (if_none_match != nullptr)
+			request_headers.Append(("if-none-match: " +
+						std::string(if_none_match)).c_str());
 
 		request.SetOption(CURLOPT_HTTPHEADER, request_headers.Get());
 
@@ -272,6 +406,8 @@ public:
 				  "<a:prop><a:resourcetype/></a:prop>"
 				  "<a:prop><a:getcontenttype/></a:prop>"
 				  "<a:prop><a:getcontentlength/></a:prop>"
+				  "<a:prop><a:getlastmodified/></a:prop>"
+				  "<a:prop><a:getetag/></a:prop>"
 				  "</a:propfind>");
 
 		// TODO: send request body
@@ -280,6 +416,15 @@ public:
 	using BlockingHttpRequest::GetEasy;
 	using BlockingHttpRequest::Wait;
 
+	/**
+	 * Did the server reject the "If-None-Match" condition, i.e.
+	 * the resource was not modified?  In that case,
+	 * OnDavResponse() has not been called.
+	 */
+	bool IsNotModified() const noexcept {
+		return not_modified;
+	}
+
 protected:
 	virtual void OnDavResponse(DavResponse &&r) = 0;
 
@@ -293,27 +438,57 @@ private:
 	/* virtual methods from CurlResponseHandler */
 	void OnHeaders(unsigned status,
 		       std::multimap<std::string, std::string> &&headers) final {
-		if (status != 207)
-			throw FormatRuntimeError("Status %d from WebDAV server; expected \"207 Multi-Status\"",
-						 status);
+		if (conditional && (status == 304 || status == 412)) {
+			/* RFC 7232 3.2: a failed "If-None-Match"
+			   condition yields "304 Not Modified" for
+			   GET/HEAD and "412 Precondition Failed" for
+			   all other methods, but some servers send
+			   304 for PROPFIND, too */
+			not_modified = true;
+			return;
+		}
+
+		if (status != 207) {
+			if (!IsXmlContentType(headers))
+				throw PropfindError(status, false);
+
+			/* parse the error body in OnData(), and throw
+			   in OnEnd() */
+			error_status = status;
+			return;
+		}
 
 		if (!IsXmlContentType(headers))
 			throw std::runtime_error("Unexpected Content-Type from WebDAV server");
 	}
 
 	void OnData(ConstBuffer<void> _data) final {
+		if (not_modified)
+			return;
+
 		const auto data = ConstBuffer<char>::FromVoid(_data);
 		Parse(data.data, data.size);
 	}
 
 	void OnEnd() final {
-		CompleteParse();
+		if (!not_modified)
+			CompleteParse();
+
+		if (error_status != 0)
+			throw PropfindError(error_status, finite_depth);
+
 		LockSetDone();
 	}
 
 	/* virtual methods from CommonExpatParser */
 	void StartElement(const XML_Char *name,
 			  gcc_unused const XML_Char **attrs) final {
+		if (error_status != 0) {
+			if (strcmp(name, "DAV:|propfind-finite-depth") == 0)
+				finite_depth = true;
+			return;
+		}
+
 		switch (state) {
 		case State::ROOT:
 			if (strcmp(name, "DAV:|response") == 0)
@@ -331,6 +506,8 @@ private:
 				state = State::MTIME;
 			else if (strcmp(name, "DAV:|getcontentlength") == 0)
 				state = State::LENGTH;
+			else if (strcmp(name, "DAV:|getetag") == 0)
+				state = State::ETAG;
 			break;
 
 		case State::TYPE:
@@ -342,6 +519,7 @@ private:
 		case State::STATUS:
 		case State::LENGTH:
 		case State::MTIME:
+		case State::ETAG:
 			break;
 		}
 	}
@@ -383,6 +561,11 @@ private:
 			if (strcmp(name, "DAV:|getcontentlength") == 0)
 				state = State::RESPONSE;
 			break;
+
+		case State::ETAG:
+			if (strcmp(name, "DAV:|getetag") == 0)
+				state = State::RESPONSE;
+			break;
 		}
 	}
 
@@ -408,6 +591,12 @@ private:
 		case State::LENGTH:
 			response.length = ParseU64(s, len);
 			break;
+
+		case State::ETAG:
+			/* the entity tag is sent to the server
+			   verbatim, so don't let expat split it */
+			response.etag.append(s, len);
+			break;
 		}
 	}
 };
@@ -420,7 +609,7 @@ class HttpGetInfoOperation final : public PropfindOperation {
 
 public:
 	HttpGetInfoOperation(CurlGlobal &curl, const char *uri)
-		:PropfindOperation(curl, uri, 0),
+		:PropfindOperation(curl, uri, "0"),
 		 info(StorageFileInfo::Type::OTHER) {
 	}
 
@@ -446,6 +635,10 @@ protected:
 StorageFileInfo
 CurlStorage::GetInfo(const char *uri_utf8, gcc_unused bool follow)
 {
+	StorageFileInfo info;
+	if (prefetched.GetInfo(uri_utf8, info))
+		return info;
+
 	// TODO: escape the given URI
 
 	const auto uri = MapUTF8(uri_utf8);
@@ -470,9 +663,15 @@ class HttpListDirectoryOperation final : public PropfindOperation {
 
 	MemoryStorageDirectoryReader::List entries;
 
+	/**
+	 * The "getetag" property of the collection itself.
+	 */
+	std::string etag;
+
 public:
-	HttpListDirectoryOperation(CurlGlobal &curl, const char *uri)
-		:PropfindOperation(curl, uri, 1),
+	HttpListDirectoryOperation(CurlGlobal &curl, const char *uri,
+				   const char *if_none_match=nullptr)
+		:PropfindOperation(curl, uri, "1", if_none_match),
 		 base_path(UriPathOrSlash(uri)) {}
 
 	std::unique_ptr<StorageDirectoryReader> Perform() {
@@ -480,11 +679,34 @@ public:
 		return ToReader();
 	}
 
+	MemoryStorageDirectoryReader::List TakeEntries() noexcept {
+		return std::move(entries);
+	}
+
+	const std::string &GetETag() const noexcept {
+		return etag;
+	}
+
 private:
 	std::unique_ptr<StorageDirectoryReader> ToReader() {
 		return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
 	}
 
+	/**
+	 * Does the "href" attribute refer to the requested collection
+	 * itself?
+	 */
+	gcc_pure
+	bool IsBaseHref(const char *href) const noexcept {
+		const char *path = uri_get_path(href);
+		if (path == nullptr)
+			return false;
+
+		/* see HrefToEscapedName() */
+		path = StringAfterPrefixIgnoreCase(path, base_path.c_str());
+		return path != nullptr && (*path == 0 || StringIsEqual(path, "/"));
+	}
+
 	/**
 	 * Convert a "href" attribute (which may be an absolute URI)
 	 * to the base file name.
@@ -521,6 +743,11 @@ protected:
 		if (r.status != 200)
 			return;
 
+		if (IsBaseHref(r.href.c_str())) {
+			etag = std::move(r.etag);
+			return;
+		}
+
 		const auto escaped_name = HrefToEscapedName(r.href.c_str());
 		if (escaped_name.IsNull())
 			return;
@@ -536,15 +763,259 @@ protected:
 	}
 };
 
+/**
+ * Obtain a whole directory tree using a WebDAV PROPFIND with
+ * "Depth: infinity".
+ */
+class HttpListTreeOperation final : public PropfindOperation {
+	const std::string base_path;
+
+	/**
+	 * The relative URI of the requested collection within the
+	 * storage.
+	 */
+	const std::string base_uri_utf8;
+
+	PrefetchedTree::Map &tree;
+
+public:
+	HttpListTreeOperation(CurlGlobal &curl, const char *uri,
+			      const char *_base_uri_utf8, PrefetchedTree::Map &_tree)
+		:PropfindOperation(curl, uri, "infinity"),
+		 base_path(UriPathOrSlash(uri)),
+		 base_uri_utf8(_base_uri_utf8),
+		 tree(_tree) {}
+
+	void Perform() {
+		Wait();
+	}
+
+protected:
+	/* virtual methods from PropfindOperation */
+	void OnDavResponse(DavResponse &&r) override {
+		if (r.status != 200)
+			return;
+
+		const char *path = uri_get_path(r.href.c_str());
+		if (path == nullptr)
+			return;
+
+		/* see HttpListDirectoryOperation::HrefToEscapedName() */
+		path = StringAfterPrefixIgnoreCase(path, base_path.c_str());
+		if (path == nullptr)
+			return;
+
+		StringView escaped(path);
+		if (!escaped.empty() && escaped.back() == '/')
+			escaped.pop_back();
+
+		if (escaped.empty()) {
+			/* the requested collection itself */
+			tree[base_uri_utf8];
+			return;
+		}
+
+		const auto uri_utf8 =
+			PathTraitsUTF8::Build(base_uri_utf8.c_str(),
+					      CurlUnescape(GetEasy(), escaped).c_str());
+
+		StorageFileInfo info(r.collection
+				     ? StorageFileInfo::Type::DIRECTORY
+				     : StorageFileInfo::Type::REGULAR);
+		info.size = r.length;
+		info.mtime = r.mtime;
+
+		PrefetchedTree::Add(tree, uri_utf8, info);
+	}
+};
+
+/**
+ * Is the given (relative) URI the given directory or inside it?
+ */
+gcc_pure
+static bool
+IsInsideDirectory(const std::string &uri_utf8, const char *directory) noexcept
+{
+	if (StringIsEmpty(directory))
+		return true;
+
+	const char *rest = StringAfterPrefix(uri_utf8.c_str(), directory);
+	return rest != nullptr && (*rest == 0 || *rest == '/');
+}
+
+void
+CurlStorage::CrawlTree(const char *uri_utf8, PrefetchedTree::Map &tree)
+{
+	struct Running {
+		std::string uri_utf8;
+
+		/**
+		 * The previous listing of this collection; only set
+		 * if a conditional request was sent.
+		 */
+		const CachedCollection *cached;
+
+		std::unique_ptr<HttpListDirectoryOperation> operation;
+	};
+
+	std::list<std::string> pending{uri_utf8};
+	std::list<Running> running;
+
+	/* the new cache contents for this subtree; #collection_cache
+	   is not modified before all requests have finished, so
+	   Running::cached remains valid */
+	decltype(collection_cache) new_cache;
+	unsigned n_not_modified = 0;
+
+	std::exception_ptr error;
+
+	while (!pending.empty() || !running.empty()) {
+		/* keep several requests in flight on the CurlGlobal
+		   multi handle */
+		while (!error && !pending.empty() &&
+		       running.size() < PREFETCH_CONCURRENCY) {
+			auto &r = pending.front();
+			const auto collection = MapCollection(r.c_str());
+
+			const CachedCollection *cached = nullptr;
+			auto c = collection_cache.find(r);
+			if (c != collection_cache.end() &&
+			    !c->second.etag.empty())
+				cached = &c->second;
+
+			running.push_back({std::move(r), cached,
+					   std::make_unique<HttpListDirectoryOperation>(*curl,
+											collection.c_str(),
+											cached != nullptr
+											? cached->etag.c_str()
+											: nullptr)});
+			pending.pop_front();
+		}
+
+		auto &r = running.front();
+
+		try {
+			r.operation->Wait();
+		} catch (...) {
+			/* wait for the other requests before
+			   bailing out */
+			if (!error)
+				error = std::current_exception();
+		}
+
+		if (!error) {
+			auto &dir = tree[r.uri_utf8];
+			auto &c = new_cache[r.uri_utf8];
+
+			if (r.operation->IsNotModified()) {
+				assert(r.cached != nullptr);
+
+				c = *r.cached;
+				dir = c.entries;
+				++n_not_modified;
+			} else {
+				c.etag = r.operation->GetETag();
+
+				for (auto &i : r.operation->TakeEntries())
+					dir.emplace(std::move(i.name), i.info);
+
+				c.entries = dir;
+			}
+
+			for (const auto &i : dir)
+				if (i.second.IsDirectory())
+					pending.emplace_back(PathTraitsUTF8::Build(r.uri_utf8.c_str(),
+										   i.first.c_str()));
+		}
+
+		running.pop_front();
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+
+	FormatDebug(curl_storage_domain,
+		    "%u of %zu collections were not modified",
+		    n_not_modified, new_cache.size());
+
+	/* replace the cached subtree; this also forgets collections
+	   which have been deleted */
+	for (auto i = collection_cache.begin(); i != collection_cache.end();) {
+		if (IsInsideDirectory(i->first, uri_utf8))
+			i = collection_cache.erase(i);
+		else
+			++i;
+	}
+
+	collection_cache.merge(new_cache);
+}
+
+void
+CurlStorage::Prefetch(const char *uri_utf8) noexcept
+{
+	PrefetchedTree::Map tree;
+
+	try {
+		bool crawl = infinity_refused;
+
+		if (!crawl) {
+			try {
+				HttpListTreeOperation(*curl,
+						      MapCollection(uri_utf8).c_str(),
+						      uri_utf8, tree).Perform();
+			} catch (const PropfindError &e) {
+				if (!e.IsDepthRefused())
+					throw;
+
+				/* don't try "Depth: infinity" again
+				   with this server */
+				FormatDebug(curl_storage_domain,
+					    "PROPFIND with \"Depth: infinity\" refused, falling back to \"Depth: 1\": %s",
+					    e.what());
+				infinity_refused = true;
+				crawl = true;
+				tree.clear();
+			} catch (...) {
+				/* a transient error (e.g. a timeout,
+				   which is likely with a big tree):
+				   crawl this time, but try "Depth:
+				   infinity" again next time */
+				FormatDebug(curl_storage_domain,
+					    "PROPFIND with \"Depth: infinity\" failed, falling back to \"Depth: 1\": %s",
+					    GetFullMessage(std::current_exception()).c_str());
+				crawl = true;
+				tree.clear();
+			}
+		}
+
+		if (crawl)
+			CrawlTree(uri_utf8, tree);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to prefetch WebDAV directory tree");
+		return;
+	}
+
+	FormatDebug(curl_storage_domain, "prefetched %zu directories",
+		    tree.size());
+
+	prefetched.Set(std::move(tree));
+}
+
+void
+CurlStorage::ReleasePrefetch() noexcept
+{
+	prefetched.Clear();
+}
+
 std::unique_ptr<StorageDirectoryReader>
 CurlStorage::OpenDirectory(const char *uri_utf8)
 {
-	std::string uri = MapUTF8(uri_utf8);
-
-	/* collection URIs must end with a slash */
-	if (uri.back() != '/')
-		uri.push_back('/');
+	auto reader = prefetched.OpenDirectory(uri_utf8);
+	if (reader != nullptr)
+		return reader;
 
+	const auto uri = MapCollection(uri_utf8);
 	return HttpListDirectoryOperation(*curl, uri.c_str()).Perform();
 }
 
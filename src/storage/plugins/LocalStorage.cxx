@@ -23,11 +23,15 @@
 #include "storage/FileInfo.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "fs/Charset.hxx"
 #include "fs/DirectoryReader.hxx"
+#include "thread/Mutex.hxx"
 #include "util/StringCompare.hxx"
 
 #include <string>
 
+#include <string.h>
+
 class LocalDirectoryReader final : public StorageDirectoryReader {
 	AllocatedPath base_fs;
 
@@ -35,9 +39,19 @@ class LocalDirectoryReader final : public StorageDirectoryReader {
 
 	std::string name_utf8;
 
+	/**
+	 * The directory path followed by a separator; GetInfo()
+	 * appends the entry name to build the path to be passed to
+	 * stat() without allocating for each entry.
+	 */
+	PathTraitsFS::string path_buffer;
+
 public:
 	LocalDirectoryReader(AllocatedPath &&_base_fs)
-		:base_fs(std::move(_base_fs)), reader(base_fs) {}
+		:base_fs(std::move(_base_fs)), reader(base_fs),
+		 path_buffer(base_fs.c_str()) {
+		path_buffer.push_back(PathTraitsFS::SEPARATOR);
+	}
 
 	/* virtual methods from class StorageDirectoryReader */
 	const char *Read() noexcept override;
@@ -48,6 +62,21 @@ class LocalStorage final : public Storage {
 	const AllocatedPath base_fs;
 	const std::string base_utf8;
 
+	/**
+	 * Protects #cache_directory_utf8 and #cache_directory_fs.
+	 */
+	mutable Mutex cache_mutex;
+
+	/**
+	 * The parent directory of the most recent MapFSOrThrow() call
+	 * which needed a charset conversion, and its mapped file
+	 * system path.  The update walk maps all files of one
+	 * directory in a row, and this saves converting the
+	 * directory part again for each of them.
+	 */
+	mutable std::string cache_directory_utf8;
+	mutable AllocatedPath cache_directory_fs = nullptr;
+
 public:
 	explicit LocalStorage(Path _base_fs)
 		:base_fs(_base_fs), base_utf8(base_fs.ToUTF8Throw()) {
@@ -113,7 +142,34 @@ LocalStorage::MapFSOrThrow(const char *uri_utf8) const
 	if (StringIsEmpty(uri_utf8))
 		return base_fs;
 
-	return base_fs / AllocatedPath::FromUTF8Throw(uri_utf8);
+#ifndef _WIN32
+	if (IsFSCharsetUTF8())
+		/* no conversion: concatenate with one allocation */
+		return AllocatedPath::Build(base_fs, uri_utf8);
+#endif
+
+	const char *slash = strrchr(uri_utf8, '/');
+	if (slash == nullptr)
+		return base_fs / AllocatedPath::FromUTF8Throw(uri_utf8);
+
+	const auto name_fs = AllocatedPath::FromUTF8Throw(slash + 1);
+	std::string directory_utf8(uri_utf8, slash);
+
+	{
+		const std::lock_guard<Mutex> protect(cache_mutex);
+		if (!cache_directory_fs.IsNull() &&
+		    directory_utf8 == cache_directory_utf8)
+			return cache_directory_fs / name_fs;
+	}
+
+	auto directory_fs = base_fs /
+		AllocatedPath::FromUTF8Throw(directory_utf8.c_str());
+	auto result = directory_fs / name_fs;
+
+	const std::lock_guard<Mutex> protect(cache_mutex);
+	cache_directory_utf8 = std::move(directory_utf8);
+	cache_directory_fs = std::move(directory_fs);
+	return result;
 }
 
 AllocatedPath
@@ -161,6 +217,13 @@ LocalDirectoryReader::Read() noexcept
 		if (SkipNameFS(name_fs.c_str()))
 			continue;
 
+#ifndef _WIN32
+		if (IsFSCharsetUTF8())
+			/* no conversion: return the name from the
+			   directory entry without copying it */
+			return name_fs.c_str();
+#endif
+
 		try {
 			name_utf8 = name_fs.ToUTF8Throw();
 			return name_utf8.c_str();
@@ -174,7 +237,10 @@ LocalDirectoryReader::Read() noexcept
 StorageFileInfo
 LocalDirectoryReader::GetInfo(bool follow)
 {
-	return Stat(base_fs / reader.GetEntry(), follow);
+	const size_t base_length = base_fs.length() + 1;
+	path_buffer.resize(base_length);
+	path_buffer.append(reader.GetEntry().c_str());
+	return Stat(Path::FromFS(path_buffer.c_str()), follow);
 }
 
 std::unique_ptr<Storage>
@@ -22,6 +22,7 @@
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "storage/MemoryDirectoryReader.hxx"
+#include "storage/PrefetchedTree.hxx"
 #include "lib/nfs/Blocking.hxx"
 #include "lib/nfs/Base.hxx"
 #include "lib/nfs/Lease.hxx"
@@ -36,18 +37,27 @@
 #include "event/TimerEvent.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringCompare.hxx"
+#include "Log.hxx"
 
 extern "C" {
 #include <nfsc/libnfs.h>
 #include <nfsc/libnfs-raw-nfs.h>
 }
 
+#include <list>
+#include <memory>
 #include <string>
 
 #include <assert.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
+/**
+ * The number of directory listings which are kept in flight on the
+ * #NfsConnection by NfsStorage::Prefetch().
+ */
+static constexpr std::size_t PREFETCH_CONCURRENCY = 8;
+
 class NfsStorage final
 	: public Storage, NfsLease {
 
@@ -69,6 +79,8 @@ class NfsStorage final
 	State state = State::INITIAL;
 	std::exception_ptr last_exception;
 
+	PrefetchedTree prefetched;
+
 public:
 	NfsStorage(EventLoop &_loop, const char *_base,
 		   std::string &&_server, std::string &&_export_name)
@@ -94,6 +106,9 @@ public:
 
 	const char *MapToRelativeUTF8(const char *uri_utf8) const noexcept override;
 
+	void Prefetch(const char *uri_utf8) noexcept override;
+	void ReleasePrefetch() noexcept override;
+
 	/* virtual methods from NfsLease */
 	void OnNfsConnectionReady() noexcept final {
 		assert(state == State::CONNECTING);
@@ -296,6 +311,10 @@ protected:
 StorageFileInfo
 NfsStorage::GetInfo(const char *uri_utf8, bool follow)
 {
+	if (StorageFileInfo info;
+	    follow && prefetched.GetInfo(uri_utf8, info))
+		return info;
+
 	const std::string path = UriToNfsPath(uri_utf8);
 
 	WaitConnected();
@@ -351,6 +370,10 @@ public:
 		return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
 	}
 
+	MemoryStorageDirectoryReader::List TakeEntries() noexcept {
+		return std::move(entries);
+	}
+
 protected:
 	void Start() override {
 		connection.OpenDirectory(path, *this);
@@ -399,6 +422,10 @@ NfsListDirectoryOperation::CollectEntries(struct nfsdir *dir)
 std::unique_ptr<StorageDirectoryReader>
 NfsStorage::OpenDirectory(const char *uri_utf8)
 {
+	auto reader = prefetched.OpenDirectory(uri_utf8);
+	if (reader != nullptr)
+		return reader;
+
 	const std::string path = UriToNfsPath(uri_utf8);
 
 	WaitConnected();
@@ -409,6 +436,91 @@ NfsStorage::OpenDirectory(const char *uri_utf8)
 	return operation.ToReader();
 }
 
+void
+NfsStorage::Prefetch(const char *uri_utf8) noexcept
+try {
+	/* the directory entries obtained with READDIRPLUS contain
+	   all attributes we need, so a listing of all directories
+	   is enough; several of them are kept in flight to hide the
+	   latency */
+
+	struct Running {
+		std::string uri_utf8, path;
+		std::unique_ptr<NfsListDirectoryOperation> operation;
+
+		explicit Running(std::string &&_uri_utf8)
+			:uri_utf8(std::move(_uri_utf8)),
+			 path(UriToNfsPath(uri_utf8.c_str())) {}
+	};
+
+	WaitConnected();
+
+	PrefetchedTree::Map tree;
+	std::list<std::string> pending{uri_utf8};
+	std::list<Running> running;
+	std::exception_ptr error;
+
+	while (!pending.empty() || !running.empty()) {
+		while (!error && !pending.empty() &&
+		       running.size() < PREFETCH_CONCURRENCY) {
+			try {
+				running.emplace_back(std::move(pending.front()));
+			} catch (...) {
+				/* cannot be converted to the filesystem
+				   charset: skip it */
+				pending.pop_front();
+				continue;
+			}
+
+			pending.pop_front();
+
+			auto &r = running.back();
+			r.operation = std::make_unique<NfsListDirectoryOperation>(*connection,
+										  r.path.c_str());
+			r.operation->Submit();
+		}
+
+		auto &r = running.front();
+
+		try {
+			r.operation->Wait();
+		} catch (...) {
+			/* wait for the other operations before
+			   bailing out */
+			if (!error)
+				error = std::current_exception();
+		}
+
+		if (!error) {
+			auto &dir = tree[r.uri_utf8];
+
+			for (auto &i : r.operation->TakeEntries()) {
+				if (i.info.IsDirectory())
+					pending.emplace_back(PathTraitsUTF8::Build(r.uri_utf8.c_str(),
+										   i.name.c_str()));
+
+				dir.emplace(std::move(i.name), i.info);
+			}
+		}
+
+		running.pop_front();
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+
+	prefetched.Set(std::move(tree));
+} catch (...) {
+	LogError(std::current_exception(),
+		 "Failed to prefetch NFS directory tree");
+}
+
+void
+NfsStorage::ReleasePrefetch() noexcept
+{
+	prefetched.Clear();
+}
+
 static std::unique_ptr<Storage>
 CreateNfsStorageURI(EventLoop &event_loop, const char *base)
 {
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "IoUring.hxx"
+#include "Error.hxx"
+
+#include <stdexcept>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int
+SysIoUringSetup(unsigned entries, io_uring_params &p) noexcept
+{
+	return syscall(__NR_io_uring_setup, entries, &p);
+}
+
+static int
+SysIoUringEnter(int fd, unsigned to_submit, unsigned min_complete,
+		unsigned flags) noexcept
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, nullptr, 0);
+}
+
+IoUring::Mapping::~Mapping() noexcept
+{
+	if (p != nullptr)
+		munmap(p, size);
+}
+
+void
+IoUring::Mapping::Map(int _fd, size_t _size, off_t offset)
+{
+	void *q = mmap(nullptr, _size, PROT_READ|PROT_WRITE,
+		       MAP_SHARED|MAP_POPULATE, _fd, offset);
+	if (q == MAP_FAILED)
+		throw MakeErrno("Failed to map io_uring");
+
+	p = q;
+	size = _size;
+}
+
+template<typename T>
+static T *
+At(void *base, size_t offset) noexcept
+{
+	return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+}
+
+IoUring::IoUring(unsigned entries)
+{
+	io_uring_params p;
+	memset(&p, 0, sizeof(p));
+
+	fd = UniqueFileDescriptor(SysIoUringSetup(entries, p));
+	if (!fd.IsDefined())
+		throw MakeErrno("io_uring_setup() failed");
+
+	if ((p.features & IORING_FEAT_NODROP) == 0)
+		throw std::runtime_error("io_uring is too old");
+
+	sq_ring.Map(fd.Get(), p.sq_off.array + p.sq_entries * sizeof(unsigned),
+		    IORING_OFF_SQ_RING);
+	cq_ring.Map(fd.Get(),
+		    p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe),
+		    IORING_OFF_CQ_RING);
+	sqe_array.Map(fd.Get(), p.sq_entries * sizeof(io_uring_sqe),
+		      IORING_OFF_SQES);
+
+	sq_head = At<unsigned>(sq_ring.p, p.sq_off.head);
+	sq_tail = At<unsigned>(sq_ring.p, p.sq_off.tail);
+	sq_array = At<unsigned>(sq_ring.p, p.sq_off.array);
+	sq_mask = *At<unsigned>(sq_ring.p, p.sq_off.ring_mask);
+	sq_entries = *At<unsigned>(sq_ring.p, p.sq_off.ring_entries);
+
+	cq_head = At<unsigned>(cq_ring.p, p.cq_off.head);
+	cq_tail = At<unsigned>(cq_ring.p, p.cq_off.tail);
+	cq_mask = *At<unsigned>(cq_ring.p, p.cq_off.ring_mask);
+	cqes = At<io_uring_cqe>(cq_ring.p, p.cq_off.cqes);
+
+	sqes = static_cast<io_uring_sqe *>(sqe_array.p);
+
+	local_sq_tail = *sq_tail;
+}
+
+io_uring_sqe *
+IoUring::GetSqe() noexcept
+{
+	const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	if (local_sq_tail - head >= sq_entries)
+		return nullptr;
+
+	const unsigned i = local_sq_tail++ & sq_mask;
+	sq_array[i] = i;
+
+	io_uring_sqe *sqe = &sqes[i];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+int
+IoUring::Submit(unsigned wait_nr) noexcept
+{
+	__atomic_store_n(sq_tail, local_sq_tail, __ATOMIC_RELEASE);
+
+	const unsigned to_submit =
+		local_sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	if (to_submit == 0 && wait_nr == 0)
+		return 0;
+
+	int result = SysIoUringEnter(fd.Get(), to_submit, wait_nr,
+				     wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+	return result < 0 ? -errno : result;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SYSTEM_IO_URING_HXX
+#define MPD_SYSTEM_IO_URING_HXX
+
+#include "UniqueFileDescriptor.hxx"
+
+#include <linux/io_uring.h>
+
+#include <stddef.h>
+
+/**
+ * A minimal wrapper for a Linux io_uring instance, implemented with
+ * the raw system calls (without liburing).  It is not thread-safe.
+ */
+class IoUring {
+	UniqueFileDescriptor fd;
+
+	struct Mapping {
+		void *p = nullptr;
+		size_t size = 0;
+
+		~Mapping() noexcept;
+		void Map(int fd, size_t _size, off_t offset);
+	};
+
+	Mapping sq_ring, cq_ring, sqe_array;
+
+	unsigned *sq_head, *sq_tail, *sq_array;
+	unsigned sq_mask, sq_entries;
+
+	unsigned *cq_head, *cq_tail;
+	unsigned cq_mask;
+	io_uring_cqe *cqes;
+
+	io_uring_sqe *sqes;
+
+	/**
+	 * The tail of the submission queue which has not yet been
+	 * published to the kernel.
+	 */
+	unsigned local_sq_tail;
+
+public:
+	/**
+	 * Throws on error, e.g. if the kernel does not support
+	 * io_uring or is too old (the features
+	 * #IORING_FEAT_NODROP is required).
+	 */
+	explicit IoUring(unsigned entries);
+
+	IoUring(const IoUring &) = delete;
+	IoUring &operator=(const IoUring &) = delete;
+
+	/**
+	 * Obtain a cleared submission queue entry.  The entry is
+	 * submitted by the next Submit() call.
+	 *
+	 * @return nullptr if the submission queue is full; call
+	 * Submit() and try again
+	 */
+	io_uring_sqe *GetSqe() noexcept;
+
+	/**
+	 * Submit all queued entries to the kernel, and optionally
+	 * wait for completions.
+	 *
+	 * @param wait_nr the number of completions to wait for
+	 * @return a negative errno value on error
+	 */
+	int Submit(unsigned wait_nr=0) noexcept;
+
+	/**
+	 * Invoke the function for each completion queue entry and
+	 * remove them from the queue.
+	 */
+	template<typename F>
+	void ForEachCompletion(F &&f) noexcept {
+		unsigned head = *cq_head;
+		const unsigned tail = __atomic_load_n(cq_tail,
+						      __ATOMIC_ACQUIRE);
+
+		for (; head != tail; ++head)
+			f(cqes[head & cq_mask]);
+
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	}
+};
+
+#endif
@@ -20,9 +20,10 @@
 #include "ApeLoader.hxx"
 #include "util/ByteOrder.hxx"
 #include "input/InputStream.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/StringView.hxx"
 
-#include <memory>
+#include <algorithm>
 
 #include <stdint.h>
 #include <assert.h>
@@ -37,8 +38,34 @@ struct ApeFooter {
 	unsigned char reserved[8];
 };
 
+/**
+ * Refuse to parse tags larger than this.  The items are read one by
+ * one, and binary items (cover art) are skipped by seeking, so this
+ * does not limit the memory usage.
+ */
+static constexpr size_t APE_MAX_TAG_SIZE = 64 * 1024 * 1024;
+
+/**
+ * Items with values larger than this are skipped.
+ */
+static constexpr size_t APE_MAX_ITEM_SIZE = 16 * 1024 * 1024;
+
+/**
+ * The APEv2 specification limits keys to 255 characters.
+ */
+static constexpr size_t APE_MAX_KEY_LENGTH = 255;
+
+/**
+ * Is this a binary item (e.g. cover art)?
+ */
+static constexpr bool
+IsApeBinaryItem(unsigned long flags) noexcept
+{
+	return ((flags >> 1) & 0x3) == 1;
+}
+
 bool
-tag_ape_scan(InputStream &is, ApeTagCallback callback)
+tag_ape_scan(InputStream &is, ApeTagCallback callback, bool want_binary)
 try {
 	std::unique_lock<Mutex> lock(is.mutex);
 
@@ -57,47 +84,79 @@ try {
 	/* find beginning of ape tag */
 	size_t remaining = FromLE32(footer.length);
 	if (remaining <= sizeof(footer) + 10 ||
-	    /* refuse to load more than one megabyte of tag data */
-	    remaining > 1024 * 1024)
+	    remaining > APE_MAX_TAG_SIZE ||
+	    offset_type(remaining) > is.GetSize())
 		return false;
 
-	is.Seek(lock, is.GetSize() - remaining);
+	offset_type offset = is.GetSize() - remaining;
 
-	/* read tag into buffer */
 	remaining -= sizeof(footer);
 	assert(remaining > 10);
 
-	std::unique_ptr<char[]> buffer(new char[remaining]);
-	is.ReadFull(lock, buffer.get(), remaining);
+	/* the value buffer is allocated on demand, and it is only as
+	   large as the largest value which was read */
+	AllocatedArray<char> value_buffer;
 
-	/* read tags */
+	/* read the items one by one */
 	unsigned n = FromLE32(footer.count);
-	const char *p = buffer.get();
 	while (n-- && remaining > 10) {
-		size_t size = FromLE32(*(const uint32_t *)p);
-		p += 4;
-		remaining -= 4;
-		unsigned long flags = FromLE32(*(const uint32_t *)p);
-		p += 4;
-		remaining -= 4;
+		/* read the item header and the key */
+		uint8_t header[8 + APE_MAX_KEY_LENGTH + 1];
+		const size_t header_size = std::min(remaining, sizeof(header));
+		is.Seek(lock, offset);
+		is.ReadFull(lock, header, header_size);
+
+		uint32_t size_le, flags_le;
+		memcpy(&size_le, header, sizeof(size_le));
+		memcpy(&flags_le, header + 4, sizeof(flags_le));
+		const size_t size = FromLE32(size_le);
+		const unsigned long flags = FromLE32(flags_le);
 
 		/* get the key */
-		const char *key = p;
-		const char *key_end = (const char *)memchr(p, '\0', remaining);
+		const char *key = (const char *)header + 8;
+		const char *key_end = (const char *)
+			memchr(key, '\0', header_size - 8);
 		if (key_end == nullptr)
 			break;
 
-		p = key_end + 1;
-		remaining -= p - key;
+		const size_t item_header_size =
+			(const uint8_t *)key_end + 1 - header;
+		offset += item_header_size;
+		remaining -= item_header_size;
 
 		/* get the value */
 		if (remaining < size)
 			break;
 
-		if (!callback(flags, key, {p, size}))
-			break;
-
-		p += size;
+		if ((want_binary || !IsApeBinaryItem(flags)) &&
+		    size <= APE_MAX_ITEM_SIZE) {
+			value_buffer.GrowDiscard(std::max<size_t>(size, 1));
+
+			if (item_header_size < header_size) {
+				/* the value (or a part of it) has
+				   already been read with the header */
+				const size_t n_copy =
+					std::min(size, header_size - item_header_size);
+				memcpy(value_buffer.begin(),
+				       header + item_header_size, n_copy);
+				if (n_copy < size) {
+					is.Seek(lock, offset + n_copy);
+					is.ReadFull(lock,
+						    value_buffer.begin() + n_copy,
+						    size - n_copy);
+				}
+			} else {
+				is.Seek(lock, offset);
+				is.ReadFull(lock, value_buffer.begin(), size);
+			}
+
+			if (!callback(flags, key, {value_buffer.begin(), size}))
+				break;
+		}
+
+		/* binary items which are not wanted are skipped
+		   without reading them */
+		offset += size;
 		remaining -= size;
 	}
 
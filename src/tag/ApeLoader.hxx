@@ -29,12 +29,16 @@ typedef std::function<bool(unsigned long flags, const char *key,
 			   StringView value)> ApeTagCallback;
 
 /**
- * Scans the APE tag values from a file.
+ * Scans the APE tag values from a file.  The items are read one by
+ * one, so only the largest value needs to fit into memory.
  *
+ * @param want_binary pass binary items (e.g. cover art) to the
+ * callback?  If false, they are skipped without reading them
  * @return false if the file could not be opened or if no APE tag is
  * present
  */
 bool
-tag_ape_scan(InputStream &is, ApeTagCallback callback);
+tag_ape_scan(InputStream &is, ApeTagCallback callback,
+	     bool want_binary=false);
 
 #endif
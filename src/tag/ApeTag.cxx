@@ -22,9 +22,13 @@
 #include "ParseName.hxx"
 #include "Table.hxx"
 #include "Handler.hxx"
+#include "util/ASCII.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/StringView.hxx"
 #include "util/IterableSplitString.hxx"
 
+#include <string.h>
+
 static constexpr struct tag_table ape_tags[] = {
 	{ "album artist", TAG_ALBUM_ARTIST },
 	{ "year", TAG_DATE },
@@ -41,6 +45,26 @@ tag_ape_name_parse(const char *name)
 	return type;
 }
 
+/**
+ * Import a binary item.  The only one we know is the front cover,
+ * which consists of a file name, a null byte and the file contents.
+ */
+static void
+tag_ape_import_binary(const char *key, StringView value,
+		      TagHandler &handler) noexcept
+{
+	if (!handler.WantPicture() ||
+	    !StringEqualsCaseASCII(key, "Cover Art (Front)"))
+		return;
+
+	const char *end = (const char *)memchr(value.data, 0, value.size);
+	if (end == nullptr)
+		return;
+
+	++end;
+	handler.OnPicture(nullptr, {end, size_t(value.end() - end)});
+}
+
 /**
  * @return true if the item was recognized
  */
@@ -49,6 +73,11 @@ tag_ape_import_item(unsigned long flags,
 		    const char *key, StringView value,
 		    TagHandler &handler) noexcept
 {
+	if (((flags >> 1) & 0x3) == 1) {
+		tag_ape_import_binary(key, value, handler);
+		return false;
+	}
+
 	/* we only care about utf-8 text tags */
 	if ((flags & (0x3 << 1)) != 0)
 		return false;
@@ -79,5 +108,6 @@ tag_ape_scan2(InputStream &is, TagHandler &handler) noexcept
 		return true;
 	};
 
-	return tag_ape_scan(is, callback) && recognized;
+	return tag_ape_scan(is, callback, handler.WantPicture()) &&
+		recognized;
 }
@@ -36,24 +36,42 @@ TagBuilder::TagBuilder(const Tag &other) noexcept
 {
 	items.reserve(other.num_items);
 
-	const std::lock_guard<Mutex> protect(tag_pool_lock);
-
 	for (unsigned i = 0, n = other.num_items; i != n; ++i)
-		items.push_back(tag_pool_dup_item(other.items[i]));
+		items.push_back(tag_pool_dup_item(&tag_pool_get_item_by_id(other.GetItemId(i))));
 }
 
 TagBuilder::TagBuilder(Tag &&other) noexcept
 	:duration(other.duration), has_playlist(other.has_playlist)
 {
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
+	MoveItemsFrom(std::move(other));
+}
+
+void
+TagBuilder::MoveItemsFrom(Tag &&other) noexcept
+{
+	assert(items.empty());
+
 	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
 
-	/* discard the pointers from the Tag object */
+	if (other.IsExclusive()) {
+		/* move all TagItem pointers from the Tag object; we
+		   don't need to contact the tag pool, because all we
+		   do is move references */
+		for (unsigned i = 0, n = other.num_items; i != n; ++i)
+			items.push_back(&tag_pool_get_item_by_id(other.GetItemId(i)));
+
+		Tag::FreeItems(other.items);
+	} else {
+		/* the items buffer is shared with other Tag objects;
+		   obtain our own references */
+		for (unsigned i = 0, n = other.num_items; i != n; ++i)
+			items.push_back(tag_pool_dup_item(&tag_pool_get_item_by_id(other.GetItemId(i))));
+
+		Tag::ReleaseItems(other.items, other.num_items);
+	}
+
+	/* discard the ids from the Tag object */
 	other.num_items = 0;
-	delete[] other.items;
 	other.items = nullptr;
 }
 
@@ -66,7 +84,6 @@ TagBuilder::operator=(const TagBuilder &other) noexcept
 	items = other.items;
 
 	/* increment the tag pool refcounters */
-	const std::lock_guard<Mutex> protect(tag_pool_lock);
 	for (auto i : items)
 		tag_pool_dup_item(i);
 
@@ -89,17 +106,8 @@ TagBuilder::operator=(Tag &&other) noexcept
 	duration = other.duration;
 	has_playlist = other.has_playlist;
 
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
-	items.clear();
-	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
-
-	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	RemoveAll();
+	MoveItemsFrom(std::move(other));
 
 	return *this;
 }
@@ -120,14 +128,20 @@ TagBuilder::Commit(Tag &tag) noexcept
 	tag.duration = duration;
 	tag.has_playlist = has_playlist;
 
-	/* move all TagItem pointers to the new Tag object without
+	/* move all TagItem references to the new Tag object without
 	   touching the TagPool reference counters; the
 	   vector::clear() call is important to detach them from this
 	   object */
 	const unsigned n_items = items.size();
 	tag.num_items = n_items;
-	tag.items = new TagItem *[n_items];
-	std::copy_n(items.begin(), n_items, tag.items);
+	tag.items = Tag::AllocateItems(n_items);
+
+	TagType *types = tag.GetItemTypes();
+	for (unsigned i = 0; i != n_items; ++i) {
+		tag.items[i] = tag_pool_get_id(*items[i]);
+		types[i] = items[i]->type;
+	}
+
 	items.clear();
 
 	/* now ensure that this object is fresh (will not delete any
@@ -178,25 +192,16 @@ TagBuilder::Complement(const Tag &other) noexcept
 
 	items.reserve(items.size() + other.num_items);
 
-	const std::lock_guard<Mutex> protect(tag_pool_lock);
-	for (unsigned i = 0, n = other.num_items; i != n; ++i) {
-		TagItem *item = other.items[i];
-		if (!present[item->type])
-			items.push_back(tag_pool_dup_item(item));
-	}
+	const TagType *other_types = other.GetItemTypes();
+	for (unsigned i = 0, n = other.num_items; i != n; ++i)
+		if (!present[other_types[i]])
+			items.push_back(tag_pool_dup_item(&tag_pool_get_item_by_id(other.GetItemId(i))));
 }
 
 void
 TagBuilder::AddItemUnchecked(TagType type, StringView value) noexcept
 {
-	TagItem *i;
-
-	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
-		i = tag_pool_get_item(type, value);
-	}
-
-	items.push_back(i);
+	items.push_back(tag_pool_get_item(type, value));
 }
 
 inline void
@@ -242,11 +247,8 @@ TagBuilder::AddEmptyItem(TagType type) noexcept
 void
 TagBuilder::RemoveAll() noexcept
 {
-	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
-		for (auto i : items)
-			tag_pool_put_item(i);
-	}
+	for (auto i : items)
+		tag_pool_put_item(i);
 
 	items.clear();
 }
@@ -175,6 +175,12 @@ public:
 	void RemoveType(TagType type) noexcept;
 
 private:
+	/**
+	 * Take over the items of the given #Tag, which is empty
+	 * afterwards.  This object must not have any items.
+	 */
+	void MoveItemsFrom(Tag &&other) noexcept;
+
 	gcc_nonnull_all
 	void AddItemInternal(TagType type, StringView value) noexcept;
 };
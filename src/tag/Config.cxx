@@ -20,6 +20,7 @@
 #include "Config.hxx"
 #include "Settings.hxx"
 #include "ParseName.hxx"
+#include "Pool.hxx"
 #include "config/Data.hxx"
 #include "config/Option.hxx"
 #include "util/ASCII.hxx"
@@ -29,6 +30,9 @@
 void
 TagLoadConfig(const ConfigData &config)
 {
+	tag_pool_fold_case = config.GetBool(ConfigOption::PRECOMPUTE_FOLD_CASE,
+					    false);
+
 	const char *value = config.GetString(ConfigOption::METADATA_TO_USE);
 	if (value == nullptr)
 		return;
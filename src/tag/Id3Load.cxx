@@ -25,9 +25,25 @@
 #include <id3tag.h>
 
 #include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
 static constexpr size_t ID3V1_SIZE = 128;
 
+/**
+ * The size of an ID3v2 tag header, footer and (v2.3/v2.4) frame
+ * header.
+ */
+static constexpr size_t ID3V2_HEADER_SIZE = 10;
+
+/* ID3v2 tag header flags */
+static constexpr id3_byte_t ID3V2_FLAG_UNSYNCHRONISATION = 0x80;
+static constexpr id3_byte_t ID3V2_FLAG_EXTENDED_HEADER = 0x40;
+static constexpr id3_byte_t ID3V2_FLAG_FOOTER = 0x10;
+
 gcc_pure
 static inline bool
 tag_is_id3v1(struct id3_tag *tag) noexcept
@@ -48,8 +64,157 @@ try {
 	return 0;
 }
 
+static constexpr uint32_t
+ParseSyncSafe(const id3_byte_t *p) noexcept
+{
+	return (uint32_t(p[0] & 0x7f) << 21) |
+		(uint32_t(p[1] & 0x7f) << 14) |
+		(uint32_t(p[2] & 0x7f) << 7) |
+		uint32_t(p[3] & 0x7f);
+}
+
+static void
+WriteSyncSafe(id3_byte_t *p, uint32_t value) noexcept
+{
+	p[0] = (value >> 21) & 0x7f;
+	p[1] = (value >> 14) & 0x7f;
+	p[2] = (value >> 7) & 0x7f;
+	p[3] = value & 0x7f;
+}
+
+static constexpr uint32_t
+ParseBigEndian32(const id3_byte_t *p) noexcept
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+		(uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+/**
+ * Can the frames of this ID3v2 tag be read one by one?  This is
+ * only implemented for ID3v2.3 and ID3v2.4 tags without
+ * unsynchronisation (which would change the frame sizes in v2.3)
+ * and without extended header (which may contain a CRC over all
+ * frames).
+ */
+gcc_pure
+static bool
+IsStreamableId3v2(const id3_byte_t *header) noexcept
+{
+	return memcmp(header, "ID3", 3) == 0 &&
+		(header[3] == 3 || header[3] == 4) &&
+		(header[5] & (ID3V2_FLAG_UNSYNCHRONISATION |
+			      ID3V2_FLAG_EXTENDED_HEADER)) == 0;
+}
+
+/**
+ * Shall the payload of this frame be skipped?  Pictures are only
+ * needed if the caller asked for them, and general encapsulated
+ * objects are never used.
+ */
+gcc_pure
+static bool
+IsSkippedFrame(const id3_byte_t *frame_id, bool want_picture) noexcept
+{
+	return memcmp(frame_id, "GEOB", 4) == 0 ||
+		(!want_picture && memcmp(frame_id, "APIC", 4) == 0);
+}
+
+static void
+SkipInput(InputStream &is, std::unique_lock<Mutex> &lock,
+	  offset_type nbytes)
+{
+	if (nbytes == 0)
+		return;
+
+	if (is.CheapSeeking()) {
+		is.Skip(lock, nbytes);
+		return;
+	}
+
+	id3_byte_t buffer[4096];
+	while (nbytes > 0) {
+		size_t n = std::min<offset_type>(nbytes, sizeof(buffer));
+		is.ReadFull(lock, buffer, n);
+		nbytes -= n;
+	}
+}
+
+/**
+ * Read an ID3v2 tag frame by frame, skipping the payload of frames
+ * which are not needed (see IsSkippedFrame()), and parse the rest.
+ * Large embedded pictures are therefore neither allocated nor read
+ * (if the stream can seek cheaply).  Afterwards, the stream is
+ * positioned after the tag.
+ *
+ * @param header the ID3v2 tag header which was already read
+ * @param tag_size the total size of the tag (from id3_tag_query())
+ */
+static UniqueId3Tag
+ReadId3v2Frames(InputStream &is, std::unique_lock<Mutex> &lock,
+		const id3_byte_t *header, size_t tag_size,
+		bool want_picture)
+{
+	assert(IsStreamableId3v2(header));
+	assert(tag_size >= ID3V2_HEADER_SIZE);
+
+	const bool v24 = header[3] == 4;
+
+	size_t remaining = tag_size - ID3V2_HEADER_SIZE;
+	size_t footer_size = 0;
+	if (header[5] & ID3V2_FLAG_FOOTER) {
+		if (remaining < ID3V2_HEADER_SIZE)
+			return nullptr;
+
+		footer_size = ID3V2_HEADER_SIZE;
+		remaining -= footer_size;
+	}
+
+	std::vector<id3_byte_t> buffer(header, header + ID3V2_HEADER_SIZE);
+
+	while (remaining >= ID3V2_HEADER_SIZE) {
+		id3_byte_t frame_header[ID3V2_HEADER_SIZE];
+		is.ReadFull(lock, frame_header, sizeof(frame_header));
+		remaining -= sizeof(frame_header);
+
+		if (frame_header[0] == 0)
+			/* padding */
+			break;
+
+		const size_t frame_size = v24
+			? ParseSyncSafe(frame_header + 4)
+			: ParseBigEndian32(frame_header + 4);
+		if (frame_size > remaining)
+			/* malformed; ignore the rest */
+			break;
+
+		remaining -= frame_size;
+
+		if (IsSkippedFrame(frame_header, want_picture)) {
+			SkipInput(is, lock, frame_size);
+			continue;
+		}
+
+		buffer.insert(buffer.end(),
+			      frame_header, frame_header + sizeof(frame_header));
+
+		const size_t position = buffer.size();
+		buffer.resize(position + frame_size);
+		is.ReadFull(lock, buffer.data() + position, frame_size);
+	}
+
+	/* skip padding and footer */
+	SkipInput(is, lock, remaining + footer_size);
+
+	/* fix up the header for the reduced tag (without footer) */
+	buffer[5] &= ~ID3V2_FLAG_FOOTER;
+	WriteSyncSafe(buffer.data() + 6, buffer.size() - ID3V2_HEADER_SIZE);
+
+	return UniqueId3Tag(id3_tag_parse(buffer.data(), buffer.size()));
+}
+
 static UniqueId3Tag
-ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock)
+ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock,
+	   bool want_picture)
 try {
 	id3_byte_t query_buffer[ID3_TAG_QUERYSIZE];
 	is.ReadFull(lock, query_buffer, sizeof(query_buffer));
@@ -63,6 +228,11 @@ try {
 		/* we have enough data already */
 		return UniqueId3Tag(id3_tag_parse(query_buffer, tag_size));
 
+	static_assert(ID3_TAG_QUERYSIZE >= ID3V2_HEADER_SIZE);
+	if (IsStreamableId3v2(query_buffer))
+		return ReadId3v2Frames(is, lock, query_buffer, tag_size,
+				       want_picture);
+
 	std::unique_ptr<id3_byte_t[]> tag_buffer(new id3_byte_t[tag_size]);
 
 	/* copy the start of the tag we already have to the allocated
@@ -80,11 +250,12 @@ try {
 }
 
 static UniqueId3Tag
-ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock, offset_type offset)
+ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock, offset_type offset,
+	   bool want_picture)
 try {
 	is.Seek(lock, offset);
 
-	return ReadId3Tag(is, lock);
+	return ReadId3Tag(is, lock, want_picture);
 } catch (...) {
 	return nullptr;
 }
@@ -111,9 +282,10 @@ try {
 }
 
 static UniqueId3Tag
-tag_id3_find_from_beginning(InputStream &is, std::unique_lock<Mutex> &lock)
+tag_id3_find_from_beginning(InputStream &is, std::unique_lock<Mutex> &lock,
+			    bool want_picture)
 try {
-	auto tag = ReadId3Tag(is, lock);
+	auto tag = ReadId3Tag(is, lock, want_picture);
 	if (!tag) {
 		return nullptr;
 	} else if (tag_is_id3v1(tag.get())) {
@@ -130,7 +302,8 @@ try {
 			break;
 
 		/* Get the tag specified by the SEEK frame */
-		auto seektag = ReadId3Tag(is, lock, is.GetOffset() + seek);
+		auto seektag = ReadId3Tag(is, lock, is.GetOffset() + seek,
+					  want_picture);
 		if (!seektag || tag_is_id3v1(seektag.get()))
 			break;
 
@@ -144,7 +317,8 @@ try {
 }
 
 static UniqueId3Tag
-tag_id3_find_from_end(InputStream &is, std::unique_lock<Mutex> &lock)
+tag_id3_find_from_end(InputStream &is, std::unique_lock<Mutex> &lock,
+		      bool want_picture)
 try {
 	if (!is.KnownSize() || !is.CheapSeeking())
 		return nullptr;
@@ -174,7 +348,7 @@ try {
 		return v1tag;
 
 	/* Get the tag which the footer belongs to */
-	auto tag = ReadId3Tag(is, lock, offset - tag_size);
+	auto tag = ReadId3Tag(is, lock, offset - tag_size, want_picture);
 	if (!tag)
 		return v1tag;
 
@@ -185,7 +359,8 @@ try {
 }
 
 static UniqueId3Tag
-tag_id3_riff_aiff_load(InputStream &is, std::unique_lock<Mutex> &lock)
+tag_id3_riff_aiff_load(InputStream &is, std::unique_lock<Mutex> &lock,
+		       bool want_picture)
 try {
 	size_t size;
 	try {
@@ -194,6 +369,11 @@ try {
 		size = aiff_seek_id3(is, lock);
 	}
 
+	if (!want_picture)
+		/* the chunk contains a regular ID3v2 tag; read it
+		   frame by frame, skipping the pictures */
+		return ReadId3Tag(is, lock, false);
+
 	if (size > 4 * 1024 * 1024)
 		/* too large, don't allocate so much memory */
 		return nullptr;
@@ -207,15 +387,15 @@ try {
 }
 
 UniqueId3Tag
-tag_id3_load(InputStream &is)
+tag_id3_load(InputStream &is, bool want_picture)
 try {
 	std::unique_lock<Mutex> lock(is.mutex);
 
-	auto tag = tag_id3_find_from_beginning(is, lock);
+	auto tag = tag_id3_find_from_beginning(is, lock, want_picture);
 	if (tag == nullptr && is.CheapSeeking()) {
-		tag = tag_id3_riff_aiff_load(is, lock);
+		tag = tag_id3_riff_aiff_load(is, lock, want_picture);
 		if (tag == nullptr)
-			tag = tag_id3_find_from_end(is, lock);
+			tag = tag_id3_find_from_end(is, lock, want_picture);
 	}
 
 	return tag;
@@ -27,9 +27,11 @@ class InputStream;
 /**
  * Loads the ID3 tags from the #InputStream into a libid3tag object.
  *
+ * @param want_picture if false, then "APIC" frames are skipped
+ * without reading them (if possible)
  * @return nullptr on error or if no ID3 tag was found in the file
  */
 UniqueId3Tag
-tag_id3_load(InputStream &is);
+tag_id3_load(InputStream &is, bool want_picture);
 
 #endif
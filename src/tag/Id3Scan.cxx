@@ -386,7 +386,7 @@ tag_id3_scan(InputStream &is, TagHandler &handler) noexcept
 	UniqueId3Tag tag;
 
 	try {
-		tag = tag_id3_load(is);
+		tag = tag_id3_load(is, handler.WantPicture());
 		if (!tag)
 			return false;
 	} catch (...) {
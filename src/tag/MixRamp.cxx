@@ -21,23 +21,59 @@
 #include "VorbisComment.hxx"
 #include "MixRampInfo.hxx"
 #include "util/ASCII.hxx"
+#include "util/NumberParser.hxx"
 #include "util/StringView.hxx"
 
+#include <string>
+
 #include <assert.h>
 
+MixRampCurve
+ParseMixRampCurve(StringView value) noexcept
+{
+	/* ParseFloat() needs a null-terminated string */
+	const std::string buffer(value.data, value.size);
+	const char *p = buffer.c_str();
+
+	std::vector<MixRampCurve::Point> points;
+
+	while (true) {
+		/* Parse the dB value. */
+		char *endptr;
+		const float db = ParseFloat(p, &endptr);
+		if (endptr == p || *endptr != ' ')
+			break;
+
+		p = endptr + 1;
+
+		/* Parse the time. */
+		const FloatDuration time{ParseFloat(p, &endptr)};
+		if (endptr == p || (*endptr != ';' && *endptr != 0))
+			break;
+
+		points.push_back({db, time});
+
+		p = endptr;
+		if (*p == ';')
+			++p;
+	}
+
+	return MixRampCurve(std::move(points));
+}
+
 template<typename T>
 static bool
 ParseMixRampTagTemplate(MixRampInfo &info, const T t) noexcept
 {
 	const auto start = t["mixramp_start"];
 	if (!start.IsNull()) {
-		info.SetStart(std::string(start.data, start.size));
+		info.SetStart(ParseMixRampCurve(start));
 		return true;
 	}
 
 	const auto end = t["mixramp_end"];
-	if (!start.IsNull()) {
-		info.SetEnd(std::string(end.data, end.size));
+	if (!end.IsNull()) {
+		info.SetEnd(ParseMixRampCurve(end));
 		return true;
 	}
 
@@ -20,8 +20,20 @@
 #ifndef MPD_TAG_MIXRAMP_HXX
 #define MPD_TAG_MIXRAMP_HXX
 
+#include "util/Compiler.h"
+
 struct StringView;
 class MixRampInfo;
+class MixRampCurve;
+
+/**
+ * Parse a "mixramp_start" or "mixramp_end" value: pairs of dB and
+ * seconds, separated by a space; pairs are delimited by semicolons.
+ * Parsing stops at the first malformed pair.
+ */
+gcc_pure
+MixRampCurve
+ParseMixRampCurve(StringView value) noexcept;
 
 bool
 ParseMixRampTag(MixRampInfo &info,
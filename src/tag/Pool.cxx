@@ -19,111 +19,409 @@
 
 #include "Pool.hxx"
 #include "Item.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
 #include "util/StringView.hxx"
+#include "util/AllocatedString.hxx"
+#include "lib/icu/CaseFold.hxx"
 
-#include <limits>
+#include <algorithm>
+#include <atomic>
 
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
 
-Mutex tag_pool_lock;
+bool tag_pool_fold_case = false;
 
-static constexpr size_t NUM_SLOTS = 4093;
+/**
+ * The pool is split into this many independent hash tables, each
+ * with its own lock, to reduce contention between threads.  The
+ * stripe is selected by the upper bits of the hash.
+ */
+static constexpr unsigned STRIPE_BITS = 6;
+static constexpr size_t NUM_STRIPES = size_t(1) << STRIPE_BITS;
+
+/**
+ * The initial number of buckets of each stripe.  Must be a power of
+ * two.
+ */
+static constexpr size_t INITIAL_BUCKETS = 64;
+
+/**
+ * Grow the hash table of a stripe when it contains more than this
+ * number of items per bucket.
+ */
+static constexpr size_t MAX_LOAD = 2;
+
+/**
+ * The id table (see tag_pool_get_id()) is allocated in chunks of
+ * this many entries.
+ */
+static constexpr unsigned ID_CHUNK_BITS = 16;
+static constexpr size_t ID_CHUNK_SIZE = size_t(1) << ID_CHUNK_BITS;
+static constexpr size_t MAX_ID_CHUNKS = size_t(1) << (32 - ID_CHUNK_BITS);
+
+/**
+ * Each stripe allocates its own ids: the lower #STRIPE_BITS are the
+ * stripe index, so no global lock is needed.
+ */
+static constexpr uint32_t MAX_LOCAL_ID = uint32_t(1) << (32 - STRIPE_BITS);
+
+static constexpr uint32_t NO_ID = ~uint32_t(0);
 
 struct TagPoolSlot {
-	TagPoolSlot *next;
-	uint8_t ref = 1;
-	TagItem item;
+	TagPoolSlot *next = nullptr;
+
+#ifdef HAVE_ICU_CASE_FOLD
+	/**
+	 * The case-folded value; only set if #tag_pool_fold_case was
+	 * enabled and it differs from the original value.
+	 */
+	AllocatedString<> folded = nullptr;
+#endif
+
+	/**
+	 * The reference counter.  It may be incremented without the
+	 * stripe lock by somebody who already owns a reference, but
+	 * the transition from 1 to 0 (and the increment after a
+	 * lookup) happen only while the stripe lock is held.
+	 */
+	std::atomic_uint ref{1};
+
+	const uint32_t hash;
+
+	/**
+	 * The id of this item; see tag_pool_get_id().
+	 */
+	uint32_t id;
 
-	static constexpr unsigned MAX_REF = std::numeric_limits<decltype(ref)>::max();
+	/**
+	 * Is the value already case-folded?
+	 */
+	bool is_folded = false;
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
-		    StringView value) noexcept
-		:next(_next) {
+	TagItem item;
+
+	TagPoolSlot(uint32_t _hash, TagType type, StringView value) noexcept
+		:hash(_hash) {
 		item.type = type;
 		memcpy(item.value, value.data, value.size);
 		item.value[value.size] = 0;
+
+#ifdef HAVE_ICU_CASE_FOLD
+		if (tag_pool_fold_case) {
+			/* if folding fails, "folded" remains nullptr
+			   and is_folded false; GetFolded() returns
+			   nullptr then, and the caller falls back to
+			   comparing the original value */
+			folded = IcuCaseFold(item.value);
+			if (!folded.IsNull() &&
+			    strcmp(folded.c_str(), item.value) == 0) {
+				/* share the original value */
+				folded = nullptr;
+				is_folded = true;
+			}
+		}
+#endif
+	}
+
+	const char *GetFolded() const noexcept {
+#ifdef HAVE_ICU_CASE_FOLD
+		if (is_folded)
+			return item.value;
+
+		return folded.c_str();
+#else
+		return nullptr;
+#endif
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
+	static TagPoolSlot *Create(uint32_t hash, TagType type,
 				   StringView value) noexcept;
+
+	/**
+	 * Returns the approximate number of bytes allocated for this
+	 * slot, including the value and its case-folded copy.
+	 */
+	gcc_pure
+	size_t GetMemoryUsage() const noexcept {
+		size_t size = sizeof(*this) - sizeof(item.value) +
+			strlen(item.value) + 1;
+#ifdef HAVE_ICU_CASE_FOLD
+		if (folded != nullptr)
+			size += strlen(folded.c_str()) + 1;
+#endif
+		return size;
+	}
 };
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
-		    StringView value) noexcept
+TagPoolSlot::Create(uint32_t hash, TagType type, StringView value) noexcept
 {
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       value.size + 1,
-				       _next, type,
+				       hash, type,
 				       value);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
+/**
+ * An entry in the id table: either the slot which has this id, or
+ * (if the id is unused) the next unused id of the same stripe.
+ */
+union TagPoolIdEntry {
+	TagPoolSlot *slot;
+	uint32_t next_free;
+};
 
-static inline unsigned
-calc_hash(TagType type, StringView p) noexcept
+/**
+ * Maps ids to slots.  The chunks are allocated on demand and never
+ * freed.  Lookups need no lock: whoever looks up an id owns a
+ * reference to the item, so its entry cannot change meanwhile.
+ */
+static std::atomic<TagPoolIdEntry *> id_chunks[MAX_ID_CHUNKS];
+
+static TagPoolIdEntry &
+GetIdEntry(uint32_t id) noexcept
+{
+	auto *chunk = id_chunks[id >> ID_CHUNK_BITS].load(std::memory_order_acquire);
+	assert(chunk != nullptr);
+	return chunk[id & (ID_CHUNK_SIZE - 1)];
+}
+
+/**
+ * Like GetIdEntry(), but allocate the chunk if necessary.
+ */
+static TagPoolIdEntry &
+MakeIdEntry(uint32_t id) noexcept
+{
+	auto &c = id_chunks[id >> ID_CHUNK_BITS];
+	auto *chunk = c.load(std::memory_order_acquire);
+	if (chunk == nullptr) {
+		/* chunks contain ids of all stripes, so another
+		   thread may be allocating it right now */
+		auto *new_chunk = new TagPoolIdEntry[ID_CHUNK_SIZE];
+		if (c.compare_exchange_strong(chunk, new_chunk,
+					      std::memory_order_acq_rel,
+					      std::memory_order_acquire))
+			chunk = new_chunk;
+		else
+			delete[] new_chunk;
+	}
+
+	return chunk[id & (ID_CHUNK_SIZE - 1)];
+}
+
+/**
+ * One chained hash table with its own lock.  The bucket array is
+ * allocated on demand and never freed, so there is no static
+ * destructor which could run before the last item is released.
+ */
+struct TagPoolStripe {
+	Mutex mutex;
+
+	TagPoolSlot **buckets = nullptr;
+
+	size_t n_buckets = 0, n_items = 0;
+
+	/**
+	 * The sum of TagPoolSlot::GetMemoryUsage() of all items.
+	 */
+	size_t n_bytes = 0;
+
+	/**
+	 * The longest chain walked by a lookup since the last
+	 * resize.
+	 */
+	size_t max_chain = 0;
+
+	/**
+	 * The number of local ids ever allocated by this stripe.
+	 */
+	uint32_t n_ids = 0;
+
+	/**
+	 * The head of the list of unused ids, linked through
+	 * TagPoolIdEntry::next_free.
+	 */
+	uint32_t free_id = NO_ID;
+
+	uint32_t AllocateId(unsigned stripe_index, TagPoolSlot &slot) noexcept {
+		uint32_t id;
+		if (free_id != NO_ID) {
+			id = free_id;
+			auto &entry = GetIdEntry(id);
+			free_id = entry.next_free;
+			entry.slot = &slot;
+		} else {
+			assert(n_ids < MAX_LOCAL_ID);
+			id = (n_ids++ << STRIPE_BITS) | stripe_index;
+			MakeIdEntry(id).slot = &slot;
+		}
+
+		return id;
+	}
+
+	void FreeId(uint32_t id) noexcept {
+		GetIdEntry(id).next_free = free_id;
+		free_id = id;
+	}
+
+	TagPoolSlot *&GetBucket(uint32_t hash) noexcept {
+		assert(buckets != nullptr);
+
+		return buckets[hash & (n_buckets - 1)];
+	}
+
+	TagPoolSlot *Find(uint32_t hash, TagType type,
+			  StringView value) noexcept {
+		if (buckets == nullptr)
+			return nullptr;
+
+		size_t chain = 0;
+		for (auto slot = GetBucket(hash); slot != nullptr;
+		     slot = slot->next) {
+			++chain;
+
+			if (slot->hash == hash && slot->item.type == type &&
+			    value.Equals(slot->item.value)) {
+				max_chain = std::max(max_chain, chain);
+				return slot;
+			}
+		}
+
+		max_chain = std::max(max_chain, chain);
+		return nullptr;
+	}
+
+	void Resize(size_t new_size) noexcept;
+
+	void Insert(TagPoolSlot &slot) noexcept {
+		if (buckets == nullptr)
+			Resize(INITIAL_BUCKETS);
+		else if (n_items >= n_buckets * MAX_LOAD)
+			Resize(n_buckets * 2);
+
+		auto &bucket = GetBucket(slot.hash);
+		slot.next = bucket;
+		bucket = &slot;
+		++n_items;
+		n_bytes += slot.GetMemoryUsage();
+	}
+
+	void Remove(TagPoolSlot &slot) noexcept {
+		TagPoolSlot **slot_p = &GetBucket(slot.hash);
+		while (*slot_p != &slot) {
+			assert(*slot_p != nullptr);
+			slot_p = &(*slot_p)->next;
+		}
+
+		*slot_p = slot.next;
+
+		assert(n_items > 0);
+		--n_items;
+
+		const size_t size = slot.GetMemoryUsage();
+		assert(n_bytes >= size);
+		n_bytes -= size;
+	}
+};
+
+void
+TagPoolStripe::Resize(size_t new_size) noexcept
 {
-	unsigned hash = 5381;
+	assert(new_size > n_buckets);
+	assert((new_size & (new_size - 1)) == 0);
+
+	auto *new_buckets = new TagPoolSlot *[new_size]();
 
-	for (auto ch : p)
-		hash = (hash << 5) + hash + ch;
+	for (size_t i = 0; i < n_buckets; ++i) {
+		for (auto *slot = buckets[i]; slot != nullptr;) {
+			auto *next = slot->next;
+			auto &bucket = new_buckets[slot->hash & (new_size - 1)];
+			slot->next = bucket;
+			bucket = slot;
+			slot = next;
+		}
+	}
 
-	return hash ^ type;
+	delete[] buckets;
+	buckets = new_buckets;
+	n_buckets = new_size;
+	max_chain = 0;
 }
 
-static inline unsigned
-calc_hash(TagType type, const char *p) noexcept
+static TagPoolStripe stripes[NUM_STRIPES];
+
+/**
+ * FNV-1a with a final avalanche step (from MurmurHash3), so both the
+ * upper bits (stripe) and the lower bits (bucket) are well
+ * distributed.
+ */
+gcc_pure
+static uint32_t
+calc_hash(TagType type, StringView p) noexcept
 {
-	unsigned hash = 5381;
+	uint32_t hash = 2166136261u ^ type;
 
-	assert(p != nullptr);
+	for (auto ch : p) {
+		hash ^= (unsigned char)ch;
+		hash *= 16777619u;
+	}
 
-	while (*p != 0)
-		hash = (hash << 5) + hash + *p++;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash;
+}
 
-	return hash ^ type;
+static unsigned
+GetStripeIndex(uint32_t hash) noexcept
+{
+	return hash >> (32 - STRIPE_BITS);
 }
 
-static constexpr TagPoolSlot *
-tag_item_to_slot(TagItem *item) noexcept
+static TagPoolStripe &
+GetStripe(uint32_t hash) noexcept
 {
-	return &ContainerCast(*item, &TagPoolSlot::item);
+	return stripes[GetStripeIndex(hash)];
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, StringView value) noexcept
+static constexpr TagPoolSlot *
+tag_item_to_slot(TagItem *item) noexcept
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value) noexcept
+static constexpr const TagPoolSlot *
+tag_item_to_slot(const TagItem *item) noexcept
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
 TagItem *
 tag_pool_get_item(TagType type, StringView value) noexcept
 {
-	auto slot_p = tag_value_slot_p(type, value);
-	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
-		if (slot->item.type == type &&
-		    value.Equals(slot->item.value) &&
-		    slot->ref < TagPoolSlot::MAX_REF) {
-			assert(slot->ref > 0);
-			++slot->ref;
-			return &slot->item;
-		}
+	const uint32_t hash = calc_hash(type, value);
+	auto &stripe = GetStripe(hash);
+
+	const std::lock_guard<Mutex> protect(stripe.mutex);
+
+	auto *slot = stripe.Find(hash, type, value);
+	if (slot != nullptr) {
+		assert(slot->ref > 0);
+		slot->ref.fetch_add(1, std::memory_order_relaxed);
+		return &slot->item;
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value);
-	*slot_p = slot;
+	slot = TagPoolSlot::Create(hash, type, value);
+	slot->id = stripe.AllocateId(GetStripeIndex(hash), *slot);
+	stripe.Insert(*slot);
 	return &slot->item;
 }
 
@@ -134,35 +432,85 @@ tag_pool_dup_item(TagItem *item) noexcept
 
 	assert(slot->ref > 0);
 
-	if (slot->ref < TagPoolSlot::MAX_REF) {
-		++slot->ref;
-		return item;
-	} else {
-		/* the reference counter overflows above MAX_REF;
-		   obtain a reference to a different TagPoolSlot which
-		   isn't yet "full" */
-		return tag_pool_get_item(item->type, item->value);
-	}
+	/* the caller owns a reference, so the counter cannot drop
+	   to zero meanwhile; no lock needed */
+	slot->ref.fetch_add(1, std::memory_order_relaxed);
+	return item;
 }
 
 void
 tag_pool_put_item(TagItem *item) noexcept
 {
-	TagPoolSlot **slot_p, *slot;
+	TagPoolSlot *slot = tag_item_to_slot(item);
 
-	slot = tag_item_to_slot(item);
-	assert(slot->ref > 0);
-	--slot->ref;
+	/* fast path: this is not the last reference */
+	unsigned ref = slot->ref.load(std::memory_order_relaxed);
+	while (ref > 1)
+		if (slot->ref.compare_exchange_weak(ref, ref - 1,
+						    std::memory_order_release,
+						    std::memory_order_relaxed))
+			return;
+
+	assert(ref > 0);
+
+	/* this may be the last reference: the stripe lock prevents
+	   tag_pool_get_item() from finding the slot while it is
+	   being removed */
+	{
+		auto &stripe = GetStripe(slot->hash);
+		const std::lock_guard<Mutex> protect(stripe.mutex);
 
-	if (slot->ref > 0)
-		return;
+		if (slot->ref.fetch_sub(1, std::memory_order_acq_rel) > 1)
+			/* somebody else has obtained a new reference
+			   meanwhile */
+			return;
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
-	     *slot_p != slot;
-	     slot_p = &(*slot_p)->next) {
-		assert(*slot_p != nullptr);
+		stripe.Remove(*slot);
+		stripe.FreeId(slot->id);
 	}
 
-	*slot_p = slot->next;
 	DeleteVarSize(slot);
 }
+
+uint32_t
+tag_pool_get_id(const TagItem &item) noexcept
+{
+	return tag_item_to_slot(&item)->id;
+}
+
+TagItem &
+tag_pool_get_item_by_id(uint32_t id) noexcept
+{
+	auto *slot = GetIdEntry(id).slot;
+	assert(slot != nullptr);
+	assert(slot->id == id);
+	return slot->item;
+}
+
+const char *
+tag_pool_get_folded(const TagItem &item) noexcept
+{
+	return tag_item_to_slot(&item)->GetFolded();
+}
+
+TagPoolStats
+tag_pool_get_stats() noexcept
+{
+	TagPoolStats stats;
+
+	for (auto &stripe : stripes) {
+		const std::lock_guard<Mutex> protect(stripe.mutex);
+		stats.items += stripe.n_items;
+		stats.buckets += stripe.n_buckets;
+		stats.max_chain = std::max(stats.max_chain, stripe.max_chain);
+		stats.bytes += stripe.n_bytes;
+	}
+
+	stats.bytes += stats.buckets * sizeof(TagPoolSlot *);
+
+	for (const auto &c : id_chunks)
+		if (c.load(std::memory_order_relaxed) != nullptr)
+			stats.bytes += ID_CHUNK_SIZE * sizeof(TagPoolIdEntry);
+
+	return stats;
+}
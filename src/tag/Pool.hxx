@@ -21,20 +21,93 @@
 #define MPD_TAG_POOL_HXX
 
 #include "Type.h"
-#include "thread/Mutex.hxx"
+#include "util/Compiler.h"
 
-extern Mutex tag_pool_lock;
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Store a case-folded copy of each new tag value in the pool (see
+ * tag_pool_get_folded())?  This must be set before the first item is
+ * allocated, and is ignored if MPD was built without ICU.
+ */
+extern bool tag_pool_fold_case;
 
 struct TagItem;
 struct StringView;
 
+/*
+ * The tag pool is thread-safe; it has internal locks, and
+ * tag_pool_dup_item() usually does not need a lock at all.
+ */
+
 TagItem *
 tag_pool_get_item(TagType type, StringView value) noexcept;
 
+/**
+ * Obtain another reference to the given item.  This always returns
+ * the given pointer.
+ */
 TagItem *
 tag_pool_dup_item(TagItem *item) noexcept;
 
 void
 tag_pool_put_item(TagItem *item) noexcept;
 
+/**
+ * Returns the 32 bit id of an item obtained from the pool.  It is
+ * unique among all items which are currently allocated, and each
+ * type/value pair has only one item, therefore comparing ids is
+ * equivalent to comparing types and values.  An id may be reused
+ * after its item has been freed.
+ */
+gcc_pure
+uint32_t
+tag_pool_get_id(const TagItem &item) noexcept;
+
+/**
+ * Look up an item by its id (see tag_pool_get_id()).  The caller
+ * must own a reference to the item.  This function does not lock.
+ */
+gcc_pure
+TagItem &
+tag_pool_get_item_by_id(uint32_t id) noexcept;
+
+/**
+ * Returns the case-folded value (see IcuCaseFold()) of an item
+ * obtained from the pool, or nullptr if it is not available.  The
+ * pointer is valid as long as the item.
+ */
+gcc_pure
+const char *
+tag_pool_get_folded(const TagItem &item) noexcept;
+
+struct TagPoolStats {
+	/**
+	 * The number of distinct tag items.
+	 */
+	size_t items = 0;
+
+	/**
+	 * The total number of hash buckets.
+	 */
+	size_t buckets = 0;
+
+	/**
+	 * The longest hash chain walked by a lookup (since the
+	 * respective hash table was last resized).
+	 */
+	size_t max_chain = 0;
+
+	/**
+	 * The approximate number of bytes allocated by the pool:
+	 * items, hash buckets and the id table.
+	 */
+	size_t bytes = 0;
+};
+
+gcc_pure
+TagPoolStats
+tag_pool_get_stats() noexcept;
+
 #endif
@@ -21,6 +21,8 @@
 #include "Pool.hxx"
 #include "Builder.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 
 void
@@ -29,29 +31,32 @@ Tag::Clear() noexcept
 	duration = SignedSongTime::Negative();
 	has_playlist = false;
 
-	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
-		for (unsigned i = 0; i < num_items; ++i)
-			tag_pool_put_item(items[i]);
-	}
-
-	delete[] items;
+	ReleaseItems(items, num_items);
 	items = nullptr;
 	num_items = 0;
 }
 
+void
+Tag::ReleaseItems(uint32_t *p, unsigned n) noexcept
+{
+	if (p == nullptr ||
+	    GetRefCount(p).fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	for (unsigned i = 0; i < n; ++i)
+		tag_pool_put_item(&tag_pool_get_item_by_id(p[i]));
+
+	FreeItems(p);
+}
+
 Tag::Tag(const Tag &other) noexcept
 	:duration(other.duration), has_playlist(other.has_playlist),
 	 num_items(other.num_items),
-	 items(nullptr)
+	 items(other.items)
 {
-	if (num_items > 0) {
-		items = new TagItem *[num_items];
-
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
-		for (unsigned i = 0; i < num_items; i++)
-			items[i] = tag_pool_dup_item(other.items[i]);
-	}
+	/* share the (immutable) items buffer */
+	if (items != nullptr)
+		GetRefCount(items).fetch_add(1, std::memory_order_relaxed);
 }
 
 std::unique_ptr<Tag>
@@ -74,14 +79,33 @@ Tag::Merge(std::unique_ptr<Tag> base, std::unique_ptr<Tag> add) noexcept
 	return Merge(*base, *add);
 }
 
+std::shared_ptr<const Tag>
+Tag::Merge(std::shared_ptr<const Tag> base,
+	   std::shared_ptr<const Tag> add) noexcept
+{
+	if (add == nullptr)
+		return base;
+
+	if (base == nullptr)
+		return add;
+
+	TagBuilder builder(*add);
+	builder.Complement(*base);
+
+	auto tag = std::make_shared<Tag>();
+	builder.Commit(*tag);
+	return tag;
+}
+
 const char *
 Tag::GetValue(TagType type) const noexcept
 {
 	assert(type < TAG_NUM_OF_ITEM_TYPES);
 
-	for (const auto &item : *this)
-		if (item.type == type)
-			return item.value;
+	const TagType *types = GetItemTypes();
+	for (unsigned i = 0; i < num_items; ++i)
+		if (types[i] == type)
+			return tag_pool_get_item_by_id(items[i]).value;
 
 	return nullptr;
 }
@@ -89,7 +113,8 @@ Tag::GetValue(TagType type) const noexcept
 bool
 Tag::HasType(TagType type) const noexcept
 {
-	return GetValue(type) != nullptr;
+	return std::find(GetItemTypes(), GetItemTypes() + num_items,
+			 type) != GetItemTypes() + num_items;
 }
 
 static TagType
@@ -23,11 +23,18 @@
 #include "Type.h" // IWYU pragma: export
 #include "Item.hxx" // IWYU pragma: export
 #include "Chrono.hxx"
+#include "Pool.hxx"
 #include "util/Compiler.h"
 
+#include <atomic>
 #include <memory>
+#include <new>
 #include <utility>
 
+#include <cstddef>
+
+#include <stdint.h>
+
 /**
  * The meta information about a song file.  It is a MPD specific
  * subset of tags (e.g. from ID3, vorbis comments, ...).
@@ -48,8 +55,20 @@ struct Tag {
 	/** the total number of tag items in the #items array */
 	unsigned short num_items = 0;
 
-	/** an array of tag items */
-	TagItem **items = nullptr;
+	/**
+	 * The tag pool ids (see tag_pool_get_id()) of all items,
+	 * followed by #num_items #TagType bytes (see GetItemTypes()),
+	 * in one allocation (see AllocateItems()).  This is much
+	 * smaller than an array of #TagItem pointers, and the type
+	 * bytes allow looking for a certain tag type without
+	 * touching the items.
+	 *
+	 * The buffer is immutable and reference counted; copies of
+	 * this object share it (e.g. a #DetachedSong in the queue
+	 * and the database #Song it was created from).  Modifying a
+	 * #Tag always means replacing the buffer.
+	 */
+	uint32_t *items = nullptr;
 
 	/**
 	 * Create an empty tag.
@@ -90,6 +109,76 @@ struct Tag {
 		std::swap(num_items, other.num_items);
 	}
 
+	/**
+	 * Allocate an uninitialized #items buffer for the given number
+	 * of items, with a reference counter of 1.  Returns nullptr
+	 * if the number is zero.  Release it with ReleaseItems() or
+	 * FreeItems().
+	 */
+	static uint32_t *AllocateItems(unsigned n) noexcept {
+		if (n == 0)
+			return nullptr;
+
+		auto *ref = static_cast<std::atomic_uint *>(::operator new(sizeof(std::atomic_uint) +
+									    n * ItemSize()));
+		new(ref) std::atomic_uint(1);
+		return reinterpret_cast<uint32_t *>(ref + 1);
+	}
+
+	/**
+	 * Free an #items buffer without releasing the tag pool
+	 * references (which the caller has taken over).  This is only
+	 * allowed if IsExclusive() returns true.
+	 */
+	static void FreeItems(uint32_t *p) noexcept {
+		if (p != nullptr)
+			::operator delete(&GetRefCount(p));
+	}
+
+	/**
+	 * Release one reference to an #items buffer.  If this was the
+	 * last one, release all tag pool references and free the
+	 * buffer.
+	 */
+	static void ReleaseItems(uint32_t *p, unsigned n) noexcept;
+
+	/**
+	 * Is this the only reference to the #items buffer?  If yes,
+	 * its tag pool references may be taken over by the caller
+	 * (followed by FreeItems()).
+	 */
+	gcc_pure
+	bool IsExclusive() const noexcept {
+		return items == nullptr ||
+			GetRefCount(items).load(std::memory_order_acquire) == 1;
+	}
+
+	/**
+	 * The number of bytes per item in the #items buffer.
+	 */
+	static constexpr std::size_t ItemSize() noexcept {
+		return sizeof(uint32_t) + sizeof(TagType);
+	}
+
+	/**
+	 * Returns the tag pool id of the item at the given position.
+	 */
+	uint32_t GetItemId(unsigned i) const noexcept {
+		return items[i];
+	}
+
+	static std::atomic_uint &GetRefCount(uint32_t *p) noexcept {
+		return reinterpret_cast<std::atomic_uint *>(p)[-1];
+	}
+
+	const TagType *GetItemTypes() const noexcept {
+		return reinterpret_cast<const TagType *>(items + num_items);
+	}
+
+	TagType *GetItemTypes() noexcept {
+		return reinterpret_cast<TagType *>(items + num_items);
+	}
+
 	/**
 	 * Returns true if the tag contains no items.  This ignores
 	 * the "duration" attribute.
@@ -128,6 +217,16 @@ struct Tag {
 	static std::unique_ptr<Tag> Merge(std::unique_ptr<Tag> base,
 					  std::unique_ptr<Tag> add) noexcept;
 
+	/**
+	 * Merges the data from two shared tags.  Any of the two may
+	 * be nullptr.  If only one of them is present, it is returned
+	 * as-is (without copying).
+	 *
+	 * @return the merged tag (or one of the parameters)
+	 */
+	static std::shared_ptr<const Tag> Merge(std::shared_ptr<const Tag> base,
+						std::shared_ptr<const Tag> add) noexcept;
+
 	/**
 	 * Returns the first value of the specified tag type, or
 	 * nullptr if none is present in this tag object.
@@ -153,17 +252,24 @@ struct Tag {
 
 	class const_iterator {
 		friend struct Tag;
-		const TagItem *const*cursor;
+		const uint32_t *cursor;
 
-		constexpr const_iterator(const TagItem *const*_cursor) noexcept
+		constexpr const_iterator(const uint32_t *_cursor) noexcept
 			:cursor(_cursor) {}
 
 	public:
-		constexpr const TagItem &operator*() const noexcept {
-			return **cursor;
+		const TagItem &operator*() const noexcept {
+			return tag_pool_get_item_by_id(*cursor);
+		}
+
+		const TagItem *operator->() const noexcept {
+			return &tag_pool_get_item_by_id(*cursor);
 		}
 
-		constexpr const TagItem *operator->() const noexcept {
+		/**
+		 * Returns the tag pool id of the current item.
+		 */
+		uint32_t GetId() const noexcept {
 			return *cursor;
 		}
 
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "AllocStats.hxx"
+#include "Mutex.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+struct AllocStatsSlot {
+	char name[16];
+
+	std::atomic<uint64_t> allocations, deallocations, bytes;
+};
+
+}
+
+static constexpr size_t MAX_SLOTS = 64;
+
+/**
+ * This array is never resized, because that would allocate memory.
+ * Slots are never removed; slot 0 is "other".
+ */
+static AllocStatsSlot slots[MAX_SLOTS] = {{"other", {}, {}, {}}};
+
+/**
+ * The number of slots in use.  Slots are added while holding
+ * #slots_mutex, and the counter is incremented after the slot name
+ * has been written.
+ */
+static std::atomic_size_t n_slots{1};
+
+static Mutex slots_mutex;
+
+static thread_local AllocStatsSlot *current_slot = &slots[0];
+
+static AllocStatsSlot &
+FindOrAddSlot(const char *name) noexcept
+{
+	const std::lock_guard<Mutex> protect(slots_mutex);
+
+	const size_t n = n_slots.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < n; ++i)
+		if (strncmp(slots[i].name, name, sizeof(slots[i].name) - 1) == 0)
+			return slots[i];
+
+	if (n >= MAX_SLOTS)
+		/* table is full */
+		return slots[0];
+
+	auto &slot = slots[n];
+	strncpy(slot.name, name, sizeof(slot.name) - 1);
+	n_slots.store(n + 1, std::memory_order_release);
+	return slot;
+}
+
+void
+AllocStatsSetThreadName(const char *name) noexcept
+{
+	current_slot = &FindOrAddSlot(name);
+}
+
+size_t
+GetAllocStats(AllocThreadStats *dest, size_t max) noexcept
+{
+	const size_t n = std::min(n_slots.load(std::memory_order_acquire),
+				  max);
+	for (size_t i = 0; i < n; ++i) {
+		const auto &src = slots[i];
+		dest[i].name = src.name;
+		dest[i].allocations = src.allocations.load(std::memory_order_relaxed);
+		dest[i].deallocations = src.deallocations.load(std::memory_order_relaxed);
+		dest[i].bytes = src.bytes.load(std::memory_order_relaxed);
+	}
+
+	return n;
+}
+
+static void *
+CountedAllocate(size_t size) noexcept
+{
+	void *p = malloc(size > 0 ? size : 1);
+	if (p != nullptr) {
+		auto &slot = *current_slot;
+		slot.allocations.fetch_add(1, std::memory_order_relaxed);
+		slot.bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	return p;
+}
+
+static void
+CountedFree(void *p) noexcept
+{
+	if (p == nullptr)
+		return;
+
+	current_slot->deallocations.fetch_add(1, std::memory_order_relaxed);
+	free(p);
+}
+
+void *
+operator new(size_t size)
+{
+	void *p = CountedAllocate(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *
+operator new[](size_t size)
+{
+	void *p = CountedAllocate(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *
+operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void *
+operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void
+operator delete(void *p) noexcept
+{
+	CountedFree(p);
+}
+
+void
+operator delete[](void *p) noexcept
+{
+	CountedFree(p);
+}
+
+void
+operator delete(void *p, size_t) noexcept
+{
+	CountedFree(p);
+}
+
+void
+operator delete[](void *p, size_t) noexcept
+{
+	CountedFree(p);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_ALLOC_STATS_HXX
+#define MPD_THREAD_ALLOC_STATS_HXX
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Heap allocation accounting per thread (build option
+ * "alloc_stats").  The global operator new is replaced by a version
+ * which counts all allocations in a slot identified by the name of
+ * the calling thread, see SetThreadName().  Allocations by the main
+ * thread and by threads which were not named by MPD are counted in
+ * the slot "other".
+ */
+
+struct AllocThreadStats {
+	/**
+	 * The thread name; the pointer remains valid forever.
+	 */
+	const char *name;
+
+	uint64_t allocations, deallocations, bytes;
+};
+
+/**
+ * Count the future allocations of the current thread in the slot of
+ * the given name.  This is called by SetThreadName().
+ */
+void
+AllocStatsSetThreadName(const char *name) noexcept;
+
+/**
+ * Copy the counters of all slots into the given array.
+ *
+ * @return the number of slots copied
+ */
+size_t
+GetAllocStats(AllocThreadStats *dest, size_t max) noexcept;
+
+#endif
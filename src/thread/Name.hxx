@@ -32,13 +32,21 @@
 #  endif
 #endif
 
-#ifdef HAVE_THREAD_NAME
+#if defined(HAVE_THREAD_NAME) || defined(ENABLE_ALLOC_STATS)
 #include "util/StringFormat.hxx"
 #endif
 
+#ifdef ENABLE_ALLOC_STATS
+#include "AllocStats.hxx"
+#endif
+
 static inline void
 SetThreadName(const char *name) noexcept
 {
+#ifdef ENABLE_ALLOC_STATS
+	AllocStatsSetThreadName(name);
+#endif
+
 #if defined(HAVE_PTHREAD_SETNAME_NP) && !defined(__NetBSD__)
 	/* not using pthread_setname_np() on NetBSD because it
 	   requires a non-const pointer argument, which we don't have
@@ -60,7 +68,7 @@ template<typename... Args>
 static inline void
 FormatThreadName(const char *fmt, gcc_unused Args&&... args) noexcept
 {
-#ifdef HAVE_THREAD_NAME
+#if defined(HAVE_THREAD_NAME) || defined(ENABLE_ALLOC_STATS)
 	SetThreadName(StringFormat<16>(fmt, args...));
 #else
 	(void)fmt;
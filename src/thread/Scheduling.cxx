@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2014-2016 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Scheduling.hxx"
+#include "Slack.hxx"
+#include "util/Compiler.h"
+
+#include <string>
+#include <utility>
+
+#include <string.h>
+
+static std::vector<std::pair<std::string, ThreadScheduling>> thread_scheduling;
+
+void
+SetThreadScheduling(const char *name, ThreadScheduling &&s) noexcept
+{
+	for (auto &i : thread_scheduling) {
+		if (i.first == name) {
+			i.second = std::move(s);
+			return;
+		}
+	}
+
+	thread_scheduling.emplace_back(name, std::move(s));
+}
+
+gcc_pure
+static const ThreadScheduling *
+FindThreadScheduling(const char *name) noexcept
+{
+	for (const auto &i : thread_scheduling)
+		if (i.first == name)
+			return &i.second;
+
+	return nullptr;
+}
+
+void
+ApplyThreadScheduling(const char *name)
+{
+	const auto *s = FindThreadScheduling(name);
+	if (s == nullptr) {
+		/* fall back to the settings for the thread class,
+		   e.g. "output" for "output:NAME" */
+		const char *colon = strchr(name, ':');
+		if (colon == nullptr)
+			return;
+
+		s = FindThreadScheduling(std::string(name, colon).c_str());
+		if (s == nullptr)
+			return;
+	}
+
+	if (!s->cpus.empty())
+		SetThreadAffinity({s->cpus.data(), s->cpus.size()});
+
+	if (s->has_policy)
+		SetThreadPolicy(s->policy, s->priority);
+
+	if (s->has_nice)
+		SetThreadNice(s->nice);
+
+	if (s->timer_slack.count() >= 0)
+		SetThreadTimerSlack(s->timer_slack);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014-2016 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef THREAD_SCHEDULING_HXX
+#define THREAD_SCHEDULING_HXX
+
+#include "Util.hxx"
+
+#include <chrono>
+#include <vector>
+
+/**
+ * Scheduling settings for one class of threads.  Each attribute
+ * has a "don't change" value; the thread keeps its built-in
+ * defaults for those.
+ */
+struct ThreadScheduling {
+	/**
+	 * The CPUs the thread may run on.  Empty means don't change.
+	 */
+	std::vector<unsigned> cpus;
+
+	/**
+	 * The real-time priority for #ThreadPolicy::FIFO and
+	 * #ThreadPolicy::RR.
+	 */
+	unsigned priority = 40;
+
+	/**
+	 * The "nice" value; only used if #has_nice is set.
+	 */
+	int nice = 0;
+
+	/**
+	 * The timer slack; negative means don't change.
+	 */
+	std::chrono::nanoseconds timer_slack = std::chrono::nanoseconds(-1);
+
+	ThreadPolicy policy = ThreadPolicy::OTHER;
+
+	/**
+	 * Shall #policy be applied?
+	 */
+	bool has_policy = false;
+
+	bool has_nice = false;
+};
+
+/**
+ * Register scheduling settings for all threads with the given name.
+ * The name "output" applies to all threads called "output:NAME"
+ * unless there are settings for the exact name.
+ *
+ * This function is not thread-safe; it must be called before the
+ * affected threads are started.
+ */
+void
+SetThreadScheduling(const char *name, ThreadScheduling &&s) noexcept;
+
+/**
+ * Apply the settings registered with SetThreadScheduling() to the
+ * current thread, overriding the defaults the caller has applied
+ * before.  Does nothing if nothing was registered for this name.
+ *
+ * Throws std::system_error on error.
+ *
+ * @param name the name of the current thread, e.g. "decoder" or
+ * "output:NAME"
+ */
+void
+ApplyThreadScheduling(const char *name);
+
+#endif
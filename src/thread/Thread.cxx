@@ -20,6 +20,10 @@
 #include "Thread.hxx"
 #include "system/Error.hxx"
 
+#ifndef _WIN32
+#include <time.h>
+#endif
+
 #ifdef ANDROID
 #include "java/Global.hxx"
 #endif
@@ -57,6 +61,36 @@ Thread::Join() noexcept
 #endif
 }
 
+std::chrono::nanoseconds
+Thread::GetCPUTime() const noexcept
+{
+	assert(IsDefined());
+
+#ifdef _WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!::GetThreadTimes(handle, &creation_time, &exit_time,
+			      &kernel_time, &user_time))
+		return std::chrono::nanoseconds(-1);
+
+	const auto ToTicks = [](const FILETIME &ft){
+		return (ULONGLONG(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+	};
+
+	/* FILETIME is in 100 nanosecond units */
+	return std::chrono::nanoseconds((ToTicks(kernel_time) +
+					 ToTicks(user_time)) * 100);
+#else
+	clockid_t clock_id;
+	struct timespec ts;
+	if (pthread_getcpuclockid(handle, &clock_id) != 0 ||
+	    clock_gettime(clock_id, &ts) != 0)
+		return std::chrono::nanoseconds(-1);
+
+	return std::chrono::seconds(ts.tv_sec) +
+		std::chrono::nanoseconds(ts.tv_nsec);
+#endif
+}
+
 inline void
 Thread::Run() noexcept
 {
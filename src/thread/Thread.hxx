@@ -29,6 +29,8 @@
 #include <pthread.h>
 #endif
 
+#include <chrono>
+
 #include <assert.h>
 
 class Thread {
@@ -103,6 +105,14 @@ public:
 
 	void Join() noexcept;
 
+	/**
+	 * Returns the CPU time consumed by this thread so far, or a
+	 * negative value if that is unknown.  The thread must be
+	 * running.
+	 */
+	gcc_pure
+	std::chrono::nanoseconds GetCPUTime() const noexcept;
+
 private:
 	void Run() noexcept;
 
@@ -32,12 +32,16 @@
 
 #ifdef __linux__
 #include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 #elif defined(_WIN32)
 #include <windows.h>
 #endif
 
+#include <time.h>
+
 #ifdef __linux__
 
 #ifndef ANDROID
@@ -98,17 +102,138 @@ SetThreadIdlePriority() noexcept
 
 void
 SetThreadRealtime()
+{
+	SetThreadPolicy(ThreadPolicy::FIFO, 40);
+};
+
+void
+SetThreadPolicy(ThreadPolicy _policy, unsigned priority)
 {
 #ifdef __linux__
 	struct sched_param sched_param;
-	sched_param.sched_priority = 40;
+	sched_param.sched_priority = 0;
+
+	int policy = SCHED_OTHER;
+	bool realtime = false;
+
+	switch (_policy) {
+	case ThreadPolicy::OTHER:
+		break;
+
+	case ThreadPolicy::BATCH:
+#ifdef SCHED_BATCH
+		policy = SCHED_BATCH;
+#endif
+		break;
+
+	case ThreadPolicy::IDLE:
+#ifdef SCHED_IDLE
+		policy = SCHED_IDLE;
+#endif
+		break;
+
+	case ThreadPolicy::FIFO:
+		policy = SCHED_FIFO;
+		realtime = true;
+		break;
+
+	case ThreadPolicy::RR:
+		policy = SCHED_RR;
+		realtime = true;
+		break;
+	}
+
+	if (realtime) {
+		sched_param.sched_priority = priority;
 
-	int policy = SCHED_FIFO;
 #ifdef SCHED_RESET_ON_FORK
-	policy |= SCHED_RESET_ON_FORK;
+		policy |= SCHED_RESET_ON_FORK;
 #endif
+	}
 
 	if (linux_sched_setscheduler(0, policy, &sched_param) < 0)
 		throw MakeErrno("sched_setscheduler failed");
+#else
+	(void)_policy;
+	(void)priority;
 #endif	// __linux__
-};
+}
+
+void
+SetThreadNice(int nice)
+{
+#ifdef __linux__
+	/* on Linux, setpriority() with a thread id affects only this
+	   thread */
+	if (setpriority(PRIO_PROCESS, syscall(__NR_gettid), nice) < 0)
+		throw MakeErrno("setpriority failed");
+#else
+	(void)nice;
+#endif
+}
+
+void
+SetThreadAffinity(ConstBuffer<unsigned> cpus)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (unsigned cpu : cpus) {
+		if (cpu >= CPU_SETSIZE)
+			throw MakeErrno(EINVAL, "CPU number too large");
+
+		CPU_SET(cpu, &set);
+	}
+
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+		throw MakeErrno("sched_setaffinity failed");
+#else
+	(void)cpus;
+#endif
+}
+
+void
+LockThreadStack()
+{
+#ifdef __linux__
+	/* this array occupies the stack pages which will be used
+	   later by the caller's callees; writing to each page faults
+	   it in, and the pages remain locked after this function
+	   returns */
+	volatile unsigned char stack[THREAD_STACK_LOCK_SIZE];
+	for (size_t i = 0; i < sizeof(stack); i += 1024)
+		stack[i] = 0;
+
+	if (mlock((const void *)stack, sizeof(stack)) < 0)
+		throw MakeErrno("mlock() failed");
+#endif
+}
+
+std::chrono::nanoseconds
+GetCurrentThreadCPUTime() noexcept
+{
+#ifdef _WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!::GetThreadTimes(::GetCurrentThread(), &creation_time,
+			      &exit_time, &kernel_time, &user_time))
+		return std::chrono::nanoseconds(-1);
+
+	const auto ToTicks = [](const FILETIME &ft){
+		return (ULONGLONG(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+	};
+
+	/* FILETIME is in 100 nanosecond units */
+	return std::chrono::nanoseconds((ToTicks(kernel_time) +
+					 ToTicks(user_time)) * 100);
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return std::chrono::nanoseconds(-1);
+
+	return std::chrono::seconds(ts.tv_sec) +
+		std::chrono::nanoseconds(ts.tv_nsec);
+#else
+	return std::chrono::nanoseconds(-1);
+#endif
+}
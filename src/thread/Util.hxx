@@ -30,6 +30,41 @@
 #ifndef THREAD_UTIL_HXX
 #define THREAD_UTIL_HXX
 
+#include "util/ConstBuffer.hxx"
+
+#include <chrono>
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum class ThreadPolicy : uint8_t {
+	/**
+	 * The default time-sharing policy.
+	 */
+	OTHER,
+
+	/**
+	 * Like #OTHER, but for CPU-intensive non-interactive
+	 * threads.
+	 */
+	BATCH,
+
+	/**
+	 * Very low priority background jobs.
+	 */
+	IDLE,
+
+	/**
+	 * Real-time first-in/first-out.
+	 */
+	FIFO,
+
+	/**
+	 * Real-time round-robin.
+	 */
+	RR,
+};
+
 /**
  * Lower the current thread's priority to "idle" (very low).
  */
@@ -44,4 +79,52 @@ SetThreadIdlePriority() noexcept;
 void
 SetThreadRealtime();
 
+/**
+ * Change the current thread's scheduling policy.
+ *
+ * Throws std::system_error on error.
+ *
+ * @param priority the real-time priority; only used for
+ * #ThreadPolicy::FIFO and #ThreadPolicy::RR
+ */
+void
+SetThreadPolicy(ThreadPolicy policy, unsigned priority=0);
+
+/**
+ * Change the "nice" value of the current thread (not of the whole
+ * process).
+ *
+ * Throws std::system_error on error.
+ */
+void
+SetThreadNice(int nice);
+
+/**
+ * Allow the current thread to run only on the specified CPUs.
+ *
+ * Throws std::system_error on error.
+ */
+void
+SetThreadAffinity(ConstBuffer<unsigned> cpus);
+
+/**
+ * Fault in the topmost #THREAD_STACK_LOCK_SIZE bytes of the current
+ * thread's stack (below the caller's stack frame) and lock them into
+ * RAM, so a real-time thread doesn't stall on a page fault when its
+ * stack grows.
+ *
+ * Throws std::system_error on error.
+ */
+void
+LockThreadStack();
+
+static constexpr size_t THREAD_STACK_LOCK_SIZE = 128 * 1024;
+
+/**
+ * Returns the CPU time consumed by the current thread so far, or a
+ * negative value if that is not available.
+ */
+std::chrono::nanoseconds
+GetCurrentThreadCPUTime() noexcept;
+
 #endif
@@ -99,6 +99,31 @@ HugeDiscard(void *p, size_t size) noexcept
 #endif
 }
 
+bool
+HugeLock(void *p, size_t size) noexcept
+{
+	size = AlignToPageSize(size);
+
+	/* mlock() faults in all pages */
+	if (mlock(p, size) == 0)
+		return true;
+
+#ifdef MADV_POPULATE_WRITE
+	if (madvise(p, size, MADV_POPULATE_WRITE) == 0)
+		return false;
+#endif
+
+	/* fallback for old kernels: write to each page (without
+	   modifying its contents) */
+	static const long page_size = sysconf(_SC_PAGESIZE);
+	const size_t step = page_size > 0 ? size_t(page_size) : 4096;
+	auto *q = (volatile unsigned char *)p;
+	for (size_t i = 0; i < size; i += step)
+		q[i] = q[i];
+
+	return false;
+}
+
 #elif defined(_WIN32)
 
 WritableBuffer<void>
@@ -77,6 +77,19 @@ HugeForkCow(void *p, size_t size, bool enable) noexcept;
 void
 HugeDiscard(void *p, size_t size) noexcept;
 
+/**
+ * Fault in all pages of the allocation and lock them into RAM, so
+ * accessing it later never causes a page fault.  If locking is not
+ * permitted (e.g. because RLIMIT_MEMLOCK is too low), the pages are
+ * still faulted in.
+ *
+ * @param p an allocation returned by HugeAllocate()
+ * @param size the allocation's size as passed to HugeAllocate()
+ * @return true if the memory was locked
+ */
+bool
+HugeLock(void *p, size_t size) noexcept;
+
 #elif defined(_WIN32)
 #include <windows.h>
 
@@ -100,6 +113,12 @@ HugeDiscard(void *p, size_t size) noexcept
 	VirtualAlloc(p, size, MEM_RESET, PAGE_NOACCESS);
 }
 
+static inline bool
+HugeLock(void *p, size_t size) noexcept
+{
+	return VirtualLock(p, size);
+}
+
 #else
 
 /* not Linux: fall back to standard C calls */
@@ -129,6 +148,12 @@ HugeDiscard(void *, size_t) noexcept
 {
 }
 
+static inline bool
+HugeLock(void *, size_t) noexcept
+{
+	return false;
+}
+
 #endif
 
 /**
@@ -178,6 +203,14 @@ public:
 		HugeDiscard(v.data, v.size);
 	}
 
+	/**
+	 * See HugeLock().
+	 */
+	bool Lock() noexcept {
+		auto v = buffer.ToVoid();
+		return HugeLock(v.data, v.size);
+	}
+
 	constexpr bool operator==(std::nullptr_t) const noexcept {
 		return buffer == nullptr;
 	}
@@ -21,13 +21,64 @@
 #include "DynamicFifoBuffer.hxx"
 
 #include <algorithm>
+#include <array>
 
 #include <assert.h>
 #include <string.h>
 
+namespace {
+
+/**
+ * A per-thread cache of empty "normal" buffers.  Buffers are given
+ * back to it as soon as they have been drained, so idle sockets do
+ * not hold one, and new connections (e.g. while hundreds of clients
+ * reconnect at once) get a buffer without a heap allocation.
+ */
+class FifoBufferPool {
+	static constexpr size_t MAX_ITEMS = 64;
+
+	std::array<DynamicFifoBuffer<uint8_t> *, MAX_ITEMS> items;
+	size_t n_items = 0;
+
+public:
+	FifoBufferPool() = default;
+	FifoBufferPool(const FifoBufferPool &) = delete;
+	FifoBufferPool &operator=(const FifoBufferPool &) = delete;
+
+	~FifoBufferPool() noexcept {
+		for (size_t i = 0; i < n_items; ++i)
+			delete items[i];
+	}
+
+	DynamicFifoBuffer<uint8_t> *Get(size_t size) {
+		for (size_t i = n_items; i-- > 0;) {
+			auto *b = items[i];
+			if (b->GetCapacity() == size) {
+				items[i] = items[--n_items];
+				return b;
+			}
+		}
+
+		return new DynamicFifoBuffer<uint8_t>(size);
+	}
+
+	void Put(DynamicFifoBuffer<uint8_t> *b) noexcept {
+		if (n_items < MAX_ITEMS) {
+			b->Clear();
+			items[n_items++] = b;
+		} else
+			delete b;
+	}
+};
+
+thread_local FifoBufferPool fifo_buffer_pool;
+
+}
+
 PeakBuffer::~PeakBuffer()
 {
-	delete normal_buffer;
+	if (normal_buffer != nullptr)
+		fifo_buffer_pool.Put(normal_buffer);
 	delete peak_buffer;
 }
 
@@ -56,11 +107,30 @@ PeakBuffer::Read() const noexcept
 	return nullptr;
 }
 
+size_t
+PeakBuffer::GetAllocatedSize() const noexcept
+{
+	size_t size = 0;
+
+	if (normal_buffer != nullptr)
+		size += normal_buffer->GetCapacity();
+
+	if (peak_buffer != nullptr)
+		size += peak_buffer->GetCapacity();
+
+	return size;
+}
+
 void
 PeakBuffer::Consume(size_t length) noexcept
 {
 	if (normal_buffer != nullptr && !normal_buffer->empty()) {
 		normal_buffer->Consume(length);
+		if (normal_buffer->empty()) {
+			fifo_buffer_pool.Put(normal_buffer);
+			normal_buffer = nullptr;
+		}
+
 		return;
 	}
 
@@ -113,7 +183,7 @@ PeakBuffer::Append(const void *data, size_t length)
 	}
 
 	if (normal_buffer == nullptr)
-		normal_buffer = new DynamicFifoBuffer<uint8_t>(normal_size);
+		normal_buffer = fifo_buffer_pool.Get(normal_size);
 
 	size_t nbytes = AppendTo(*normal_buffer, data, length);
 	if (nbytes > 0) {
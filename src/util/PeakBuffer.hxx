@@ -62,6 +62,13 @@ public:
 	gcc_pure
 	WritableBuffer<void> Read() const noexcept;
 
+	/**
+	 * Returns the number of bytes currently allocated by both
+	 * buffers.
+	 */
+	gcc_pure
+	size_t GetAllocatedSize() const noexcept;
+
 	void Consume(size_t length) noexcept;
 
 	bool Append(const void *data, size_t length);
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PERFECT_HASH_HXX
+#define MPD_PERFECT_HASH_HXX
+
+#include <array>
+#include <stdexcept>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A minimal "hash and displace" perfect hash table for a fixed set
+ * of strings, generated at compile time.  Each key maps to a
+ * distinct slot, so a lookup costs two hash calculations and one
+ * string comparison.
+ *
+ * @param N the number of keys
+ */
+template<size_t N>
+class PerfectHashTable {
+	static_assert(N > 0 && N < 0xffff);
+
+	static constexpr size_t N_BUCKETS = (N + 1) / 2;
+
+	static constexpr size_t RoundUpPowerOfTwo(size_t n) noexcept {
+		size_t result = 1;
+		while (result < n)
+			result <<= 1;
+		return result;
+	}
+
+	static constexpr size_t N_SLOTS = RoundUpPowerOfTwo(N * 2);
+
+	/**
+	 * For each bucket: the seed passed to Mix() for its keys.
+	 */
+	std::array<uint16_t, N_BUCKETS> seeds{};
+
+	/**
+	 * For each slot: the key index plus one, or zero if the slot
+	 * is empty.
+	 */
+	std::array<uint16_t, N_SLOTS> slots{};
+
+public:
+	/**
+	 * @param get_key a function returning the key with the given
+	 * index
+	 */
+	template<typename F>
+	constexpr explicit PerfectHashTable(F &&get_key) {
+		std::array<uint32_t, N> hashes{};
+		for (size_t i = 0; i < N; ++i)
+			hashes[i] = Hash(get_key(i));
+
+		std::array<size_t, N_BUCKETS> bucket_sizes{};
+		for (size_t i = 0; i < N; ++i)
+			++bucket_sizes[hashes[i] % N_BUCKETS];
+
+		std::array<bool, N_BUCKETS> bucket_done{};
+
+		/* place the largest buckets first, because they are
+		   the hardest to place */
+		for (size_t n = 0; n < N_BUCKETS; ++n) {
+			size_t b = 0, max_size = 0;
+			for (size_t i = 0; i < N_BUCKETS; ++i) {
+				if (!bucket_done[i] &&
+				    bucket_sizes[i] >= max_size) {
+					b = i;
+					max_size = bucket_sizes[i];
+				}
+			}
+
+			bucket_done[b] = true;
+			if (max_size == 0)
+				continue;
+
+			seeds[b] = PlaceBucket(hashes, b);
+		}
+	}
+
+	/**
+	 * Find the only key which may be equal to the given string.
+	 * The caller must compare the string with the key, because
+	 * other strings map to arbitrary keys.
+	 *
+	 * @return the key index or N if there is none
+	 */
+	constexpr size_t Lookup(const char *s) const noexcept {
+		const uint32_t hash = Hash(s);
+		const unsigned seed = seeds[hash % N_BUCKETS];
+		const unsigned slot = slots[Mix(hash, seed) % N_SLOTS];
+		return slot > 0 ? slot - 1 : N;
+	}
+
+private:
+	/* FNV-1a */
+	static constexpr uint32_t Hash(const char *s) noexcept {
+		uint32_t hash = 2166136261u;
+		for (; *s != 0; ++s)
+			hash = (hash ^ (unsigned char)*s) * 16777619u;
+		return hash;
+	}
+
+	static constexpr uint32_t Mix(uint32_t hash, uint32_t seed) noexcept {
+		hash ^= seed * 0x9e3779b9u;
+		hash *= 0x85ebca6bu;
+		return hash ^ (hash >> 16);
+	}
+
+	/**
+	 * Find a seed which maps all keys of the given bucket to
+	 * empty slots, and occupy these.
+	 */
+	constexpr unsigned PlaceBucket(const std::array<uint32_t, N> &hashes,
+				       size_t bucket) {
+		for (unsigned seed = 1; seed < 0xffff; ++seed) {
+			std::array<bool, N_SLOTS> taken{};
+
+			bool ok = true;
+			for (size_t i = 0; ok && i < N; ++i) {
+				if (hashes[i] % N_BUCKETS != bucket)
+					continue;
+
+				const size_t slot = Mix(hashes[i], seed) % N_SLOTS;
+				if (slots[slot] != 0 || taken[slot])
+					ok = false;
+				else
+					taken[slot] = true;
+			}
+
+			if (!ok)
+				continue;
+
+			for (size_t i = 0; i < N; ++i)
+				if (hashes[i] % N_BUCKETS == bucket)
+					slots[Mix(hashes[i], seed) % N_SLOTS] = i + 1;
+
+			return seed;
+		}
+
+		/* duplicate keys */
+		throw std::logic_error("No perfect hash found");
+	}
+};
+
+#endif
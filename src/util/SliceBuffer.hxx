@@ -79,6 +79,14 @@ public:
 		return buffer.size();
 	}
 
+	/**
+	 * Returns the number of slices which are currently
+	 * allocated.
+	 */
+	unsigned GetAllocated() const noexcept {
+		return n_allocated;
+	}
+
 	bool empty() const noexcept {
 		return n_allocated == 0;
 	}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "StringSearch.hxx"
+
+#include <algorithm>
+
+#include <string.h>
+
+StringSearch::StringSearch(const char *needle, size_t length) noexcept
+	:needle_length(length)
+{
+	std::fill_n(skip, 256, uint8_t(std::min<size_t>(length, 255)));
+
+	if (length > 0)
+		for (size_t i = 0; i < length - 1; ++i)
+			skip[(uint8_t)needle[i]] =
+				std::min<size_t>(length - 1 - i, 255);
+}
+
+const char *
+StringSearch::Find(const char *needle, const char *haystack,
+		   size_t haystack_length) const noexcept
+{
+	if (haystack_length < needle_length)
+		return nullptr;
+
+	if (needle_length <= 1)
+		return needle_length == 0
+			? haystack
+			: (const char *)memchr(haystack, needle[0],
+					       haystack_length);
+
+	const size_t last = needle_length - 1;
+	const char last_ch = needle[last];
+	const char *p = haystack;
+	const char *const end = haystack + haystack_length - needle_length;
+
+	while (p <= end) {
+		const char ch = p[last];
+
+		/* check the last and the first byte before comparing
+		   the rest; this rejects most candidates without
+		   calling memcmp() */
+		if (ch == last_ch && p[0] == needle[0] &&
+		    memcmp(p + 1, needle + 1, last - 1) == 0)
+			return p;
+
+		p += skip[(uint8_t)ch];
+	}
+
+	return nullptr;
+}
+
+const char *
+StringSearch::Find(const char *needle, const char *haystack) const noexcept
+{
+	return Find(needle, haystack, strlen(haystack));
+}
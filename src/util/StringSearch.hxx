@@ -0,0 +1,75 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STRING_SEARCH_HXX
+#define MPD_STRING_SEARCH_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A prepared substring search for one fixed needle, using the
+ * Boyer-Moore-Horspool algorithm.  The skip table is calculated once
+ * in the constructor, which pays off when the same needle is searched
+ * in many haystacks (e.g. all tag values of all songs).
+ *
+ * This object does not own the needle; the caller passes it to
+ * Find() again, which allows the owner to store the needle in a
+ * std::string without having to worry about pointer invalidation
+ * when the owner is copied or moved.
+ */
+class StringSearch {
+	size_t needle_length = 0;
+
+	/**
+	 * How far can the window be moved when the last byte of the
+	 * window is the given byte?  Values are clipped to 255, which
+	 * is always safe, because a shorter skip never misses a
+	 * match.
+	 */
+	uint8_t skip[256]{};
+
+public:
+	StringSearch() = default;
+
+	StringSearch(const char *needle, size_t length) noexcept;
+
+	size_t GetNeedleLength() const noexcept {
+		return needle_length;
+	}
+
+	/**
+	 * Find the first occurrence of the needle in the haystack.
+	 *
+	 * @param needle the needle which was passed to the constructor
+	 * @return a pointer to the first occurrence or nullptr if
+	 * there is none
+	 */
+	gcc_pure gcc_nonnull_all
+	const char *Find(const char *needle, const char *haystack,
+			 size_t haystack_length) const noexcept;
+
+	gcc_pure gcc_nonnull_all
+	const char *Find(const char *needle,
+			 const char *haystack) const noexcept;
+};
+
+#endif
@@ -95,6 +95,20 @@ uri_get_scheme(const char *uri) noexcept
 	return {uri, end};
 }
 
+StringView
+uri_get_authority(const char *uri) noexcept
+{
+	const char *ap = uri_after_scheme(uri);
+	if (ap == nullptr)
+		return nullptr;
+
+	const char *slash = strchr(ap, '/');
+	if (slash == nullptr)
+		return ap;
+
+	return {ap, slash};
+}
+
 bool
 uri_is_relative_path(const char *uri) noexcept
 {
@@ -49,6 +49,14 @@ gcc_pure
 StringView
 uri_get_scheme(const char *uri) noexcept;
 
+/**
+ * Returns the authority (host name, port and user credentials) of
+ * the specified URI, or nullptr if it has none.
+ */
+gcc_pure
+StringView
+uri_get_authority(const char *uri) noexcept;
+
 gcc_pure
 bool
 uri_is_relative_path(const char *uri) noexcept;
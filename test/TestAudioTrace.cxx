@@ -0,0 +1,71 @@
+/*
+ * Unit tests for src/AudioTrace.hxx
+ */
+
+#include "AudioTrace.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+static std::vector<uint32_t>
+CollectValues(const AudioTrace &trace)
+{
+	std::vector<uint32_t> values;
+	trace.ForEach([&values](const AudioTrace::Entry &e){
+			values.push_back(e.value);
+		});
+	return values;
+}
+
+TEST(AudioTrace, Basic)
+{
+	AudioTrace trace(4);
+	EXPECT_TRUE(CollectValues(trace).empty());
+
+	int chunk, object;
+	trace.Record(AudioTraceEvent::PIPE_PUSH, &chunk,
+		     SignedSongTime::FromMS(1234), &object, 7);
+
+	unsigned n = 0;
+	trace.ForEach([&](const AudioTrace::Entry &e){
+			EXPECT_EQ(e.event, AudioTraceEvent::PIPE_PUSH);
+			EXPECT_EQ(e.chunk, &chunk);
+			EXPECT_EQ(e.chunk_time.ToMS(), 1234);
+			EXPECT_EQ(e.object, &object);
+			EXPECT_EQ(e.value, 7u);
+			++n;
+		});
+	EXPECT_EQ(n, 1u);
+
+	EXPECT_STREQ(ToString(AudioTraceEvent::OUTPUT_UNDERRUN),
+		     "output_underrun");
+}
+
+TEST(AudioTrace, Overwrite)
+{
+	/* rounded up to 4 slots */
+	AudioTrace trace(3);
+
+	for (uint32_t i = 0; i < 10; ++i)
+		trace.Record(AudioTraceEvent::CHUNK_ALLOCATE, nullptr,
+			     SignedSongTime::Negative(), nullptr, i);
+
+	const std::vector<uint32_t> expected{6, 7, 8, 9};
+	EXPECT_EQ(CollectValues(trace), expected);
+}
+
+TEST(AudioTrace, Monotonic)
+{
+	AudioTrace trace(16);
+
+	for (uint32_t i = 0; i < 16; ++i)
+		trace.Record(AudioTraceEvent::OUTPUT_PLAY, nullptr,
+			     SignedSongTime::Negative(), nullptr, i);
+
+	std::chrono::nanoseconds last{};
+	trace.ForEach([&last](const AudioTrace::Entry &e){
+			EXPECT_GE(e.time, last);
+			last = e.time;
+		});
+}
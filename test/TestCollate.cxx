@@ -0,0 +1,68 @@
+/*
+ * Unit tests for src/lib/icu/Collate.hxx
+ */
+
+#include "config.h"
+#include "lib/icu/Collate.hxx"
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+
+static constexpr const char *collate_strings[] = {
+	"",
+	"a",
+	"A",
+	"ab",
+	"Ab",
+	"b",
+	"B",
+	"abc",
+	"\xc3\xa4", /* a with diaeresis */
+	"\xc3\x84", /* A with diaeresis */
+	"\xc3\xa5rhus", /* aarhus */
+	"Zebra",
+	"zebra",
+	"10",
+	"9",
+	"The Beatles",
+	"the beatles",
+	"\xe6\x97\xa5\xe6\x9c\xac", /* Japanese */
+	"\xfc", /* invalid UTF-8 */
+};
+
+static int
+Sign(int i) noexcept
+{
+	return (i > 0) - (i < 0);
+}
+
+class CollateTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+#ifdef HAVE_ICU
+		IcuCollateInit();
+#endif
+	}
+
+	void TearDown() override {
+#ifdef HAVE_ICU
+		IcuCollateFinish();
+#endif
+	}
+};
+
+TEST_F(CollateTest, Key)
+{
+	for (const char *a : collate_strings) {
+		const auto a_key = IcuCollateKey(a);
+
+		for (const char *b : collate_strings) {
+			const auto b_key = IcuCollateKey(b);
+
+			EXPECT_EQ(Sign(IcuCollate(a, b)),
+				  Sign(a_key.compare(b_key)))
+				<< "a=\"" << a << "\" b=\"" << b << "\"";
+		}
+	}
+}
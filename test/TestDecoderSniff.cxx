@@ -0,0 +1,105 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "decoder/Sniff.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+static const char *
+Sniff(const void *data, size_t size) noexcept
+{
+	const auto *plugins = SniffDecoderPlugins({data, size});
+	return plugins != nullptr ? plugins[0] : nullptr;
+}
+
+template<size_t size>
+static const char *
+Sniff(const char (&data)[size]) noexcept
+{
+	/* ignore the null terminator */
+	return Sniff(data, size - 1);
+}
+
+TEST(DecoderSniff, Unknown)
+{
+	EXPECT_EQ(Sniff("", 0), nullptr);
+	EXPECT_EQ(Sniff("hello world"), nullptr);
+	EXPECT_EQ(Sniff("\xff\xff\xff\xff"), nullptr);
+}
+
+TEST(DecoderSniff, Simple)
+{
+	EXPECT_STREQ(Sniff("fLaC\0\0\0\x22"), "flac");
+	EXPECT_STREQ(Sniff("wvpk"), "wavpack");
+	EXPECT_STREQ(Sniff("MPCK"), "mpcdec");
+	EXPECT_STREQ(Sniff("DSD \x1c\0\0\0"), "dsf");
+	EXPECT_STREQ(Sniff("FRM8"), "dsdiff");
+	EXPECT_STREQ(Sniff("RIFF\0\0\0\0WAVEfmt "), "sndfile");
+	EXPECT_STREQ(Sniff("FORM\0\0\0\0AIFF"), "sndfile");
+	EXPECT_STREQ(Sniff("\0\0\0\x20" "ftypM4A "), "hybrid_dsd");
+	EXPECT_STREQ(Sniff("MAC "), "ffmpeg");
+}
+
+TEST(DecoderSniff, Mpeg)
+{
+	/* MPEG-1 layer III, 128 kbit/s, 44.1 kHz */
+	EXPECT_STREQ(Sniff("\xff\xfb\x90\x64"), "mad");
+
+	/* reserved sample rate */
+	EXPECT_EQ(Sniff("\xff\xfb\x9c\x64"), nullptr);
+
+	/* ADTS, AAC LC, 44.1 kHz */
+	EXPECT_STREQ(Sniff("\xff\xf1\x50\x80\x02\x1f\xfc"), "faad");
+}
+
+TEST(DecoderSniff, ID3)
+{
+	char buffer[64];
+	memset(buffer, 0, sizeof(buffer));
+	memcpy(buffer, "ID3\x04\0\0\0\0\0\x10", 10);
+	memcpy(buffer + 26, "\xff\xfb\x90\x64", 4);
+
+	EXPECT_STREQ(Sniff(buffer, sizeof(buffer)), "mad");
+
+	/* the tag is larger than the buffer */
+	buffer[8] = 0x01;
+	EXPECT_EQ(Sniff(buffer, sizeof(buffer)), nullptr);
+}
+
+TEST(DecoderSniff, Ogg)
+{
+	char buffer[64];
+	memset(buffer, 0, sizeof(buffer));
+	memcpy(buffer, "OggS", 4);
+	buffer[26] = 1;
+
+	memcpy(buffer + 28, "\001vorbis", 7);
+	EXPECT_STREQ(Sniff(buffer, sizeof(buffer)), "vorbis");
+
+	memcpy(buffer + 28, "OpusHead", 8);
+	EXPECT_STREQ(Sniff(buffer, sizeof(buffer)), "opus");
+
+	memcpy(buffer + 28, "\177FLAC", 5);
+	EXPECT_STREQ(Sniff(buffer, sizeof(buffer)), "oggflac");
+
+	memcpy(buffer + 28, "\200theora", 7);
+	EXPECT_STREQ(Sniff(buffer, sizeof(buffer)), "ffmpeg");
+}
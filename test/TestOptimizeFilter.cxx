@@ -0,0 +1,75 @@
+/*
+ * Unit tests for src/song/OptimizeFilter.hxx
+ */
+
+#include "MakeTag.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Type.h"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+static SongFilter
+ParseOptimized(const char *expression)
+{
+	SongFilter filter;
+	filter.Parse(ConstBuffer<const char *>(&expression, 1));
+	filter.Optimize();
+	return filter;
+}
+
+static bool
+InvokeFilter(const SongFilter &f, const char *uri, const Tag &tag) noexcept
+{
+	return f.Match(LightSong(uri, tag));
+}
+
+TEST(OptimizeSongFilter, Order)
+{
+	/* cheap items are moved to the front */
+	EXPECT_EQ(ParseOptimized("((title contains \"x\") AND (base \"foo\"))").ToExpression(),
+		  "((base \"foo\") AND (Title contains \"x\"))");
+
+	EXPECT_EQ(ParseOptimized("((any == \"x\") AND (artist == \"y\"))").ToExpression(),
+		  "((Artist == \"y\") AND (any == \"x\"))");
+
+	/* items of the same cost keep their order */
+	EXPECT_EQ(ParseOptimized("((artist == \"y\") AND (album == \"x\"))").ToExpression(),
+		  "((Artist == \"y\") AND (Album == \"x\"))");
+
+	/* nested "AND" is flattened before sorting */
+	EXPECT_EQ(ParseOptimized("((title contains \"x\") AND ((base \"foo\") AND (album == \"y\")))").ToExpression(),
+		  "((base \"foo\") AND (Album == \"y\") AND (Title contains \"x\"))");
+}
+
+TEST(OptimizeSongFilter, RequiredTags)
+{
+	const auto f = ParseOptimized("((album == \"a\") AND (title contains \"t\"))");
+
+	EXPECT_TRUE(InvokeFilter(f, "x", MakeTag(TAG_ALBUM, "a", TAG_TITLE, "t")));
+	EXPECT_FALSE(InvokeFilter(f, "x", MakeTag(TAG_TITLE, "t")));
+	EXPECT_FALSE(InvokeFilter(f, "x", MakeTag(TAG_ALBUM, "a")));
+	EXPECT_FALSE(InvokeFilter(f, "x", MakeTag()));
+}
+
+TEST(OptimizeSongFilter, RequiredTagsFallback)
+{
+	/* "AlbumArtist" falls back to "Artist" */
+	const auto f = ParseOptimized("((albumartist == \"b\") AND (album == \"a\"))");
+
+	EXPECT_TRUE(InvokeFilter(f, "x", MakeTag(TAG_ALBUM, "a", TAG_ALBUM_ARTIST, "b")));
+	EXPECT_TRUE(InvokeFilter(f, "x", MakeTag(TAG_ALBUM, "a", TAG_ARTIST, "b")));
+	EXPECT_FALSE(InvokeFilter(f, "x", MakeTag(TAG_ALBUM, "a", TAG_TITLE, "b")));
+}
+
+TEST(OptimizeSongFilter, RequiredTagsEmpty)
+{
+	/* an empty value matches songs without the tag, and negated
+	   items don't require the tag either */
+	const auto f = ParseOptimized("((album == \"\") AND (artist != \"b\"))");
+
+	EXPECT_TRUE(InvokeFilter(f, "x", MakeTag()));
+	EXPECT_TRUE(InvokeFilter(f, "x", MakeTag(TAG_TITLE, "t")));
+	EXPECT_FALSE(InvokeFilter(f, "x", MakeTag(TAG_ARTIST, "b")));
+}
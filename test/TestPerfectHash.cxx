@@ -0,0 +1,46 @@
+/*
+ * Unit tests for src/util/PerfectHash.hxx
+ */
+
+#include "util/PerfectHash.hxx"
+#include "util/StringAPI.hxx"
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+
+static constexpr const char *keys[] = {
+	"add", "addid", "clear", "delete", "find", "idle", "list",
+	"lsinfo", "next", "outputs", "pause", "play", "playlistinfo",
+	"search", "status", "stop", "update",
+};
+
+static constexpr size_t n_keys = std::size(keys);
+
+static constexpr PerfectHashTable<n_keys> table([](size_t i){
+		return keys[i];
+	});
+
+TEST(PerfectHash, Keys)
+{
+	for (size_t i = 0; i < n_keys; ++i)
+		EXPECT_EQ(table.Lookup(keys[i]), i);
+}
+
+TEST(PerfectHash, Unknown)
+{
+	for (const char *s : {"", "foo", "addi", "addidx", "Status"}) {
+		const size_t i = table.Lookup(s);
+		EXPECT_TRUE(i == n_keys || !StringIsEqual(s, keys[i]));
+	}
+}
+
+TEST(PerfectHash, Single)
+{
+	static constexpr const char *one[] = {"ping"};
+	static constexpr PerfectHashTable<1> t([](size_t i){
+			return one[i];
+		});
+
+	EXPECT_EQ(t.Lookup("ping"), 0u);
+}
@@ -0,0 +1,65 @@
+/*
+ * Unit tests for src/util/StringSearch.hxx
+ */
+
+#include "util/StringSearch.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+static const char *
+Find(const char *needle, const char *haystack) noexcept
+{
+	const StringSearch search(needle, strlen(needle));
+	return search.Find(needle, haystack);
+}
+
+TEST(StringSearch, Basic)
+{
+	constexpr char haystack[] = "The quick brown fox";
+	EXPECT_EQ(Find("The", haystack), haystack);
+	EXPECT_EQ(Find("quick", haystack), haystack + 4);
+	EXPECT_EQ(Find("fox", haystack), haystack + 16);
+	EXPECT_EQ(Find("q", haystack), haystack + 4);
+	EXPECT_EQ(Find("", haystack), haystack);
+	EXPECT_EQ(Find("Fox", haystack), nullptr);
+	EXPECT_EQ(Find("foxes", haystack), nullptr);
+	EXPECT_EQ(Find("x", ""), nullptr);
+	EXPECT_EQ(Find("The quick brown fox!", haystack), nullptr);
+}
+
+TEST(StringSearch, Repeated)
+{
+	constexpr char haystack[] = "aaabaaabaaab";
+	EXPECT_EQ(Find("aab", haystack), haystack + 1);
+	EXPECT_EQ(Find("baaab", haystack), haystack + 3);
+	EXPECT_EQ(Find("abab", haystack), nullptr);
+}
+
+TEST(StringSearch, CompareStrstr)
+{
+	constexpr char haystack[] = "abracadabra, abracadabra";
+	const char *const needles[] = {
+		"a", "ab", "bra", "cad", "abra", "dabra,", "a, a", "rab",
+		"abracadabra", "abracadabra, abracadabra", "z", "aa",
+	};
+
+	for (const char *needle : needles)
+		EXPECT_EQ(Find(needle, haystack), strstr(haystack, needle))
+			<< needle;
+}
+
+TEST(StringSearch, LongNeedle)
+{
+	/* the skip table is clipped to 255 */
+	std::string needle(300, 'x');
+	needle.back() = 'y';
+
+	std::string haystack(1000, 'x');
+	haystack.replace(600, needle.size(), needle);
+
+	const StringSearch search(needle.data(), needle.size());
+	EXPECT_EQ(search.Find(needle.c_str(), haystack.c_str()),
+		  strstr(haystack.c_str(), needle.c_str()));
+}
@@ -0,0 +1,53 @@
+/*
+ * Unit tests for src/tag/Pool.hxx
+ */
+
+#include "tag/Pool.hxx"
+#include "tag/Item.hxx"
+#include "util/StringView.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(TagPool, Share)
+{
+	TagItem *a = tag_pool_get_item(TAG_ARTIST, "foo");
+	TagItem *b = tag_pool_get_item(TAG_ARTIST, "foo");
+	TagItem *c = tag_pool_get_item(TAG_ALBUM, "foo");
+
+	EXPECT_EQ(a, b);
+	EXPECT_NE(a, c);
+	EXPECT_EQ(tag_pool_get_id(*a), tag_pool_get_id(*b));
+	EXPECT_NE(tag_pool_get_id(*a), tag_pool_get_id(*c));
+	EXPECT_EQ(&tag_pool_get_item_by_id(tag_pool_get_id(*c)), c);
+
+	tag_pool_put_item(a);
+	tag_pool_put_item(b);
+	tag_pool_put_item(c);
+}
+
+TEST(TagPool, Stats)
+{
+	const auto before = tag_pool_get_stats();
+
+	TagItem *a = tag_pool_get_item(TAG_TITLE, "a rather long title");
+	TagItem *b = tag_pool_get_item(TAG_TITLE, "another one");
+
+	const auto during = tag_pool_get_stats();
+	EXPECT_EQ(during.items, before.items + 2);
+	EXPECT_GT(during.bytes, before.bytes + 30);
+
+	TagItem *a2 = tag_pool_dup_item(a);
+	EXPECT_EQ(a2, a);
+	EXPECT_EQ(tag_pool_get_stats().bytes, during.bytes);
+
+	tag_pool_put_item(a2);
+	tag_pool_put_item(a);
+	tag_pool_put_item(b);
+
+	const auto after = tag_pool_get_stats();
+	EXPECT_EQ(after.items, before.items);
+
+	/* the hash buckets and the id table are never freed */
+	EXPECT_LT(after.bytes, during.bytes);
+	EXPECT_GE(after.bytes, before.bytes);
+}
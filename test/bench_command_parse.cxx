@@ -0,0 +1,175 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A micro-benchmark for the protocol parser: it tokenizes command
+ * lines the same way command_process() does, and looks up the command
+ * name with PerfectHashTable and (for comparison) with a binary
+ * search.
+ */
+
+#include "util/Tokenizer.hxx"
+#include "util/PerfectHash.hxx"
+#include "util/StringAPI.hxx"
+#include "util/PrintException.hxx"
+
+#include <chrono>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr const char *command_names[] = {
+	"add", "addid", "addtagid", "clear", "currentsong", "delete",
+	"deleteid", "find", "findadd", "idle", "list", "listall",
+	"listallinfo", "load", "lsinfo", "move", "moveid", "next",
+	"outputs", "pause", "ping", "play", "playid", "playlistfind",
+	"playlistid", "playlistinfo", "plchanges", "previous", "prio",
+	"random", "repeat", "search", "searchadd", "seek", "setvol",
+	"shuffle", "stats", "status", "stop", "tagtypes", "update",
+};
+
+static constexpr size_t n_commands = std::size(command_names);
+
+static constexpr PerfectHashTable<n_commands> command_hash([](size_t i){
+		return command_names[i];
+	});
+
+static size_t
+LookupHash(const char *name) noexcept
+{
+	const size_t i = command_hash.Lookup(name);
+	return i < n_commands && StringIsEqual(name, command_names[i])
+		? i
+		: n_commands;
+}
+
+static size_t
+LookupBinary(const char *name) noexcept
+{
+	size_t a = 0, b = n_commands;
+	while (a < b) {
+		const size_t i = (a + b) / 2;
+		const int cmp = strcmp(name, command_names[i]);
+		if (cmp == 0)
+			return i;
+		else if (cmp < 0)
+			b = i;
+		else
+			a = i + 1;
+	}
+
+	return n_commands;
+}
+
+static std::vector<std::string>
+MakeLines(unsigned n)
+{
+	std::vector<std::string> lines;
+	lines.reserve(n);
+
+	char buffer[256];
+	for (unsigned i = 0; i < n; ++i) {
+		switch (i % 4) {
+		case 0:
+		case 1:
+			snprintf(buffer, sizeof(buffer),
+				 "addid \"Artist %u/Album \\\"%u\\\"/%02u - Title.flac\"",
+				 i % 97, i % 13, i % 20);
+			break;
+
+		case 2:
+			snprintf(buffer, sizeof(buffer),
+				 "playlistinfo %u:%u", i, i + 10);
+			break;
+
+		default:
+			strcpy(buffer, "status");
+			break;
+		}
+
+		lines.emplace_back(buffer);
+	}
+
+	return lines;
+}
+
+template<typename L>
+static double
+Run(const std::vector<std::string> &lines, L &&lookup)
+{
+	/* work on copies, because the Tokenizer modifies the lines */
+	std::vector<std::string> copies(lines);
+
+	size_t found = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (auto &line : copies) {
+		Tokenizer tokenizer(&line.front());
+		const char *name = tokenizer.NextWord();
+
+		const char *argv[16];
+		size_t argc = 0;
+		while (argc < std::size(argv)) {
+			const char *a = tokenizer.NextParam();
+			if (a == nullptr)
+				break;
+			argv[argc++] = a;
+		}
+
+		if (lookup(name) < n_commands)
+			found += argc > 0 ? argc : 1;
+	}
+
+	const std::chrono::duration<double, std::nano> duration =
+		std::chrono::steady_clock::now() - start;
+
+	if (found == 0)
+		fprintf(stderr, "No command found\n");
+
+	return duration.count() / lines.size();
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_command_parse [COUNT]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+	if (n == 0) {
+		fprintf(stderr, "Invalid count\n");
+		return EXIT_FAILURE;
+	}
+
+	const auto lines = MakeLines(n);
+
+	printf("perfect hash:  %.1f ns/line\n", Run(lines, LookupHash));
+	printf("binary search: %.1f ns/line\n", Run(lines, LookupBinary));
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
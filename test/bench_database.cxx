@@ -0,0 +1,736 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A benchmark for the "simple" database plugin: it generates a
+ * synthetic library with the given number of songs and tag
+ * cardinalities, and measures saving and loading it in all database
+ * formats, typical Visit() queries (tag filters, substring searches,
+ * sort+window), CollectUniqueTags(), GetStats() and UpdateWalk on a
+ * directory tree of (tiny) DSF files.
+ *
+ * The results are printed as tab-separated lines: operation,
+ * variant, duration of the first call, average duration of all
+ * calls, number of results and peak resident memory during the
+ * operation (in KiB).  Everything is written to WORKDIR, which must
+ * exist.
+ *
+ * Usage: bench_database [OPTIONS] WORKDIR
+ */
+
+#include "config.h"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/Selection.hxx"
+#include "db/Stats.hxx"
+#include "song/LightSong.hxx"
+#include "song/Filter.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Tag.hxx"
+#include "config/Block.hxx"
+#include "config/Data.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/Path.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/OptionDef.hxx"
+#include "util/OptionParser.hxx"
+#include "util/PrintException.hxx"
+#include "util/RecursiveMap.hxx"
+#include "AudioFormat.hxx"
+
+#ifdef ENABLE_DSD
+#include "db/update/Walk.hxx"
+#include "db/update/Config.hxx"
+#include "storage/plugins/LocalStorage.hxx"
+#include "storage/StorageInterface.hxx"
+#include "decoder/DecoderList.hxx"
+#include "playlist/PlaylistRegistry.hxx"
+#include "input/Init.hxx"
+#include "event/Thread.hxx"
+#include "system/Error.hxx"
+#include "util/ByteOrder.hxx"
+#endif
+
+#include <chrono>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct CommandLine {
+	const char *workdir;
+
+	unsigned songs = 100000;
+	unsigned artists = 1000;
+
+	/**
+	 * The number of songs per album, which is also the number of
+	 * songs per directory.
+	 */
+	unsigned tracks = 12;
+
+	unsigned genres = 40;
+	unsigned dates = 60;
+
+	/**
+	 * The number of files generated for the UpdateWalk
+	 * benchmark; 0 disables it.
+	 */
+	unsigned update_songs = 2000;
+
+	unsigned scan_threads = 1;
+
+	/**
+	 * How often each query is repeated.
+	 */
+	unsigned repeat = 5;
+};
+
+enum Option {
+	OPTION_SONGS,
+	OPTION_ARTISTS,
+	OPTION_TRACKS,
+	OPTION_GENRES,
+	OPTION_DATES,
+	OPTION_UPDATE_SONGS,
+	OPTION_SCAN_THREADS,
+	OPTION_REPEAT,
+};
+
+static constexpr OptionDef option_defs[] = {
+	{"songs", 0, true, "Number of songs in the library (100000)"},
+	{"artists", 0, true, "Number of distinct artists (1000)"},
+	{"tracks", 0, true, "Number of songs per album/directory (12)"},
+	{"genres", 0, true, "Number of distinct genres (40)"},
+	{"dates", 0, true, "Number of distinct dates (60)"},
+	{"update-songs", 0, true, "Number of files for UpdateWalk, 0 to disable (2000)"},
+	{"scan-threads", 0, true, "Value of \"update_scan_threads\" (1)"},
+	{"repeat", 0, true, "How often each query is repeated (5)"},
+};
+
+static unsigned
+ParseCount(const char *s, bool allow_zero=false)
+{
+	char *endptr;
+	const auto value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0 || (value == 0 && !allow_zero))
+		throw std::runtime_error(std::string("Malformed number: ") + s);
+
+	return value;
+}
+
+static CommandLine
+ParseCommandLine(int argc, char **argv)
+{
+	CommandLine c;
+
+	OptionParser option_parser(option_defs, argc, argv);
+	while (auto o = option_parser.Next()) {
+		switch (Option(o.index)) {
+		case OPTION_SONGS:
+			c.songs = ParseCount(o.value);
+			break;
+
+		case OPTION_ARTISTS:
+			c.artists = ParseCount(o.value);
+			break;
+
+		case OPTION_TRACKS:
+			c.tracks = ParseCount(o.value);
+			break;
+
+		case OPTION_GENRES:
+			c.genres = ParseCount(o.value);
+			break;
+
+		case OPTION_DATES:
+			c.dates = ParseCount(o.value);
+			break;
+
+		case OPTION_UPDATE_SONGS:
+			c.update_songs = ParseCount(o.value, true);
+			break;
+
+		case OPTION_SCAN_THREADS:
+			c.scan_threads = ParseCount(o.value);
+			break;
+
+		case OPTION_REPEAT:
+			c.repeat = ParseCount(o.value);
+			break;
+		}
+	}
+
+	auto args = option_parser.GetRemaining();
+	if (args.size != 1)
+		throw std::runtime_error("Usage: bench_database [--songs=N] [--artists=N] [--tracks=N] [--genres=N] [--dates=N] [--update-songs=N] [--scan-threads=N] [--repeat=N] WORKDIR");
+
+	c.workdir = args.front();
+	return c;
+}
+
+/**
+ * Reset the peak resident set size of this process, so
+ * GetPeakMemory() measures only the following operation.  This is
+ * only implemented on Linux; elsewhere, the peak of the whole
+ * process is reported.
+ */
+static void
+ResetPeakMemory() noexcept
+{
+#ifdef __linux__
+	FILE *file = fopen("/proc/self/clear_refs", "w");
+	if (file != nullptr) {
+		fputs("5", file);
+		fclose(file);
+	}
+#endif
+}
+
+/**
+ * @return the peak resident set size in KiB
+ */
+static long
+GetPeakMemory() noexcept
+{
+#ifdef __linux__
+	FILE *file = fopen("/proc/self/status", "r");
+	if (file != nullptr) {
+		char line[256];
+		long value = -1;
+		while (fgets(line, sizeof(line), file) != nullptr)
+			if (sscanf(line, "VmHWM: %ld", &value) == 1)
+				break;
+		fclose(file);
+
+		if (value >= 0)
+			return value;
+	}
+#endif
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+/**
+ * Call the given function @a repeat times and print the durations
+ * of the first call and the average of all calls.
+ *
+ * @param f returns the number of results, which is printed as a
+ * sanity check
+ */
+static void
+Run(const char *operation, const char *variant, unsigned repeat,
+    const std::function<size_t()> &f)
+{
+	using Clock = std::chrono::steady_clock;
+
+	ResetPeakMemory();
+
+	std::chrono::duration<double> first{}, total{};
+	size_t n = 0;
+
+	for (unsigned i = 0; i < repeat; ++i) {
+		const auto start = Clock::now();
+		n = f();
+		const std::chrono::duration<double> elapsed =
+			Clock::now() - start;
+
+		if (i == 0)
+			first = elapsed;
+		total += elapsed;
+	}
+
+	printf("%s\t%s\t%.6f\t%.6f\t%zu\t%ld\n", operation, variant,
+	       first.count(), total.count() / repeat, n,
+	       GetPeakMemory());
+	fflush(stdout);
+}
+
+/**
+ * Describes where the synthetic library places song number @a i, and
+ * which tags it gets.  All tag values are derived from the album
+ * number, so albums are consistent, and the cardinalities are
+ * exactly the ones given on the command line (as long as there are
+ * enough albums).
+ */
+struct SyntheticSong {
+	unsigned album, track, artist, genre, date;
+
+	SyntheticSong(const CommandLine &c, unsigned i) noexcept
+		:album(i / c.tracks), track(i % c.tracks),
+		 artist(album % c.artists),
+		 genre((album / c.artists) % c.genres),
+		 date(album % c.dates) {}
+
+	bool IsFirstOfAlbum() const noexcept {
+		return track == 0;
+	}
+
+	std::string GetArtist() const noexcept {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "Artist %05u", artist);
+		return buffer;
+	}
+
+	std::string GetAlbum() const noexcept {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "Album %06u", album);
+		return buffer;
+	}
+};
+
+static void
+AddTags(TagBuilder &tag, const SyntheticSong &s, unsigned i) noexcept
+{
+	char buffer[32];
+
+	const auto artist = s.GetArtist();
+	tag.AddItem(TAG_ARTIST, artist.c_str());
+	tag.AddItem(TAG_ALBUM_ARTIST, artist.c_str());
+	tag.AddItem(TAG_ALBUM, s.GetAlbum().c_str());
+
+	snprintf(buffer, sizeof(buffer), "Title %u", i);
+	tag.AddItem(TAG_TITLE, buffer);
+
+	snprintf(buffer, sizeof(buffer), "%u", s.track + 1);
+	tag.AddItem(TAG_TRACK, buffer);
+
+	snprintf(buffer, sizeof(buffer), "Genre %03u", s.genre);
+	tag.AddItem(TAG_GENRE, buffer);
+
+	snprintf(buffer, sizeof(buffer), "%u", 1950 + s.date);
+	tag.AddItem(TAG_DATE, buffer);
+
+	tag.SetDuration(SongTime::FromS(120 + i % 300));
+}
+
+/**
+ * Fill the (empty) tree with the synthetic library.
+ */
+static void
+Generate(Directory &root, const CommandLine &c) noexcept
+{
+	const ScopeDatabaseLock protect;
+
+	const auto epoch = std::chrono::system_clock::from_time_t(1500000000);
+	Directory *directory = nullptr;
+	TagBuilder tag;
+
+	for (unsigned i = 0; i < c.songs; ++i) {
+		const SyntheticSong s(c, i);
+		if (directory == nullptr || s.IsFirstOfAlbum())
+			directory = root.MakeChild(s.GetArtist().c_str())
+				->MakeChild(s.GetAlbum().c_str());
+
+		char name[64];
+		snprintf(name, sizeof(name), "%02u - Title %u.flac",
+			 s.track + 1, i);
+
+		auto song = Song::New(name, *directory);
+		AddTags(tag, s, i);
+		tag.Commit(song->tag);
+		song->mtime = epoch + std::chrono::seconds(i * 61 % c.songs);
+		song->audio_format = AudioFormat(44100, SampleFormat::S16, 2);
+		directory->AddSong(std::move(song));
+	}
+
+	db_modified();
+}
+
+static SimpleDatabase
+MakeDatabase(const AllocatedPath &path, const char *format,
+	     const char *compress)
+{
+	ConfigBlock block;
+	block.AddBlockParam("path", path.c_str());
+	block.AddBlockParam("format", format);
+	block.AddBlockParam("compress", compress);
+	return SimpleDatabase(block);
+}
+
+static size_t
+CountVisit(const Database &db, const DatabaseSelection &selection)
+{
+	size_t n = 0;
+	db.Visit(selection, [&n](const LightSong &){ ++n; });
+	return n;
+}
+
+static void
+BenchFilter(const Database &db, const char *variant, const char *format,
+	    const char *expression, bool fold_case, unsigned repeat)
+{
+	SongFilter filter;
+	const char *args[] = { expression };
+	filter.Parse({args, 1}, fold_case);
+	filter.Optimize();
+
+	const DatabaseSelection selection("", true, &filter);
+
+	std::string v = format;
+	v += '/';
+	v += variant;
+
+	Run("visit", v.c_str(), repeat, [&db, &selection]{
+			return CountVisit(db, selection);
+		});
+}
+
+static void
+BenchSort(const Database &db, const char *variant, const char *format,
+	  TagType sort, bool descending, unsigned repeat)
+{
+	DatabaseSelection selection("", true);
+	selection.sort = sort;
+	selection.descending = descending;
+	selection.window = {0, 100};
+
+	std::string v = format;
+	v += '/';
+	v += variant;
+
+	Run("sort_window", v.c_str(), repeat, [&db, &selection]{
+			return CountVisit(db, selection);
+		});
+}
+
+static void
+BenchUniqueTags(const Database &db, const char *variant, const char *format,
+		ConstBuffer<TagType> tag_types, unsigned repeat)
+{
+	const DatabaseSelection selection("", true);
+
+	std::string v = format;
+	v += '/';
+	v += variant;
+
+	Run("unique_tags", v.c_str(), repeat, [&db, &selection, tag_types]{
+			return db.CollectUniqueTags(selection,
+						    tag_types).size();
+		});
+}
+
+static void
+BenchQueries(const Database &db, const char *format, const CommandLine &c)
+{
+	const unsigned repeat = c.repeat;
+
+	Run("visit", (std::string(format) + "/all").c_str(), repeat, [&db]{
+			return CountVisit(db, DatabaseSelection("", true));
+		});
+
+	/* query the tag values of a song in the middle of the
+	   library, so all filters have results */
+	const SyntheticSong s(c, c.songs / 2);
+
+	char buffer[128];
+	snprintf(buffer, sizeof(buffer), "(Artist == \"%s\")",
+		 s.GetArtist().c_str());
+	BenchFilter(db, "artist", format, buffer, false, repeat);
+
+	snprintf(buffer, sizeof(buffer),
+		 "((Genre == \"Genre %03u\") AND (Date == \"%u\"))",
+		 s.genre, 1950 + s.date);
+	BenchFilter(db, "genre+date", format, buffer, false, repeat);
+
+	BenchFilter(db, "title_contains", format,
+		    "(Title contains \"77\")", false, repeat);
+	BenchFilter(db, "any_contains_fold_case", format,
+		    "(any contains \"album 0001\")", true, repeat);
+
+	snprintf(buffer, sizeof(buffer), "(base \"%s\")",
+		 s.GetArtist().c_str());
+	BenchFilter(db, "base", format, buffer, false, repeat);
+
+	BenchSort(db, "album", format, TAG_ALBUM, false, repeat);
+	BenchSort(db, "last_modified_descending", format,
+		  TagType(SORT_TAG_LAST_MODIFIED), true, repeat);
+
+	static constexpr TagType artist[] = { TAG_ARTIST };
+	BenchUniqueTags(db, "artist", format, {artist, 1}, repeat);
+
+	static constexpr TagType album_artist_album[] = {
+		TAG_ALBUM_ARTIST, TAG_ALBUM,
+	};
+	BenchUniqueTags(db, "albumartist+album", format,
+			{album_artist_album, 2}, repeat);
+
+	static constexpr TagType genre_date[] = { TAG_GENRE, TAG_DATE };
+	BenchUniqueTags(db, "genre+date", format, {genre_date, 2}, repeat);
+
+	Run("stats", format, repeat, [&db]{
+			return db.GetStats(DatabaseSelection("", true))
+				.song_count;
+		});
+}
+
+/**
+ * Save the library in the given format, load it again and run the
+ * queries on the loaded copy.
+ */
+static void
+BenchFormat(const CommandLine &c, const char *format, const char *compress)
+{
+	std::string variant = format;
+	if (strcmp(compress, "no") != 0)
+		variant += "+gzip";
+
+	const auto path = AllocatedPath::Build(Path::FromFS(c.workdir),
+					       (std::string("bench_") +
+						variant + ".db").c_str());
+	if (PathExists(path))
+		RemoveFile(path);
+
+	{
+		auto db = MakeDatabase(path, format, compress);
+		db.Open();
+
+		Run("generate", variant.c_str(), 1, [&db, &c]{
+				Generate(db.GetRoot(), c);
+				return c.songs;
+			});
+
+		Run("save", variant.c_str(), 1, [&db, &c]{
+				db.Save();
+				return c.songs;
+			});
+
+		db.Close();
+	}
+
+	auto db = MakeDatabase(path, format, compress);
+	Run("load", variant.c_str(), 1, [&db]{
+			db.Open();
+			return CountVisit(db, DatabaseSelection("", true));
+		});
+
+	BenchQueries(db, variant.c_str(), c);
+
+	db.Close();
+}
+
+#ifdef ENABLE_DSD
+
+class BenchDatabaseListener final : public DatabaseListener {
+public:
+	void OnDatabaseModified() noexcept override {}
+	void OnDatabaseSongRemoved(const char *) noexcept override {}
+};
+
+/**
+ * Write a DSF file with one block of silence, the smallest file the
+ * DSF decoder plugin accepts.
+ */
+static void
+WriteDsfFile(Path path)
+{
+	static constexpr unsigned channels = 2, block_size = 4096;
+	static constexpr size_t header_size = 28 + 52 + 12;
+	static constexpr size_t data_size = channels * block_size;
+
+	uint8_t buffer[header_size + data_size];
+	memset(buffer, 0x69, sizeof(buffer));
+
+	auto *p = buffer;
+	auto put_id = [&p](const char *id){
+		memcpy(p, id, 4);
+		p += 4;
+	};
+	auto put32 = [&p](uint32_t value){
+		value = ToLE32(value);
+		memcpy(p, &value, sizeof(value));
+		p += sizeof(value);
+	};
+	auto put64 = [&p](uint64_t value){
+		value = ToLE64(value);
+		memcpy(p, &value, sizeof(value));
+		p += sizeof(value);
+	};
+
+	put_id("DSD ");
+	put64(28);
+	put64(sizeof(buffer));
+	put64(0);
+
+	put_id("fmt ");
+	put64(52);
+	put32(1); /* version */
+	put32(0); /* DSD raw */
+	put32(channels); /* channel type */
+	put32(channels);
+	put32(2822400);
+	put32(1); /* LSB first */
+	put64(block_size * 8);
+	put32(block_size);
+	put32(0);
+
+	put_id("data");
+	put64(12 + data_size);
+
+	const int fd = open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	if (fd < 0)
+		throw FormatErrno("Failed to create %s", path.c_str());
+
+	const ssize_t nbytes = write(fd, buffer, sizeof(buffer));
+	close(fd);
+	if (nbytes != ssize_t(sizeof(buffer)))
+		throw FormatErrno("Failed to write %s", path.c_str());
+}
+
+static void
+MakeDirectory(Path path)
+{
+	if (mkdir(path.c_str(), 0777) < 0 && errno != EEXIST)
+		throw FormatErrno("Failed to create %s", path.c_str());
+}
+
+/**
+ * Generate a music directory with the same layout as the synthetic
+ * library, but with (untagged) DSF files.
+ */
+static AllocatedPath
+GenerateMusicDirectory(const CommandLine &c)
+{
+	const auto music = AllocatedPath::Build(Path::FromFS(c.workdir),
+						"bench_music");
+	MakeDirectory(music);
+
+	AllocatedPath directory = nullptr;
+	for (unsigned i = 0; i < c.update_songs; ++i) {
+		const SyntheticSong s(c, i);
+		if (directory.IsNull() || s.IsFirstOfAlbum()) {
+			const auto artist =
+				AllocatedPath::Build(music,
+						     s.GetArtist().c_str());
+			MakeDirectory(artist);
+
+			directory = AllocatedPath::Build(artist,
+							 s.GetAlbum().c_str());
+			MakeDirectory(directory);
+		}
+
+		char name[32];
+		snprintf(name, sizeof(name), "%02u.dsf", s.track + 1);
+		WriteDsfFile(AllocatedPath::Build(directory, name));
+	}
+
+	return music;
+}
+
+static void
+BenchUpdate(const CommandLine &c)
+{
+	const ConfigData config;
+	EventThread io_thread;
+	io_thread.Start();
+
+	const ScopeInputPluginsInit input_plugins_init(config,
+						       io_thread.GetEventLoop());
+	const ScopePlaylistPluginsInit playlist_plugins_init(config);
+	const ScopeDecoderPluginsInit decoder_plugins_init(config);
+
+	Run("generate_files", "dsf", 1, [&c]{
+			GenerateMusicDirectory(c);
+			return c.update_songs;
+		});
+
+	const auto music = AllocatedPath::Build(Path::FromFS(c.workdir),
+						"bench_music");
+	const auto storage = CreateLocalStorage(music);
+
+	const auto path = AllocatedPath::Build(Path::FromFS(c.workdir),
+					       "bench_update.db");
+	if (PathExists(path))
+		RemoveFile(path);
+	auto db = MakeDatabase(path, "text", "no");
+	db.Open();
+
+	UpdateConfig update_config(config);
+	update_config.scan_threads = c.scan_threads;
+
+	char variant[32];
+	snprintf(variant, sizeof(variant), "threads=%u", c.scan_threads);
+
+	BenchDatabaseListener listener;
+	UpdateWalk walk(update_config, io_thread.GetEventLoop(), listener,
+			*storage, nullptr);
+
+	const std::set<std::string> no_names;
+	auto count = [&db]{
+		return CountVisit(db, DatabaseSelection("", true));
+	};
+
+	Run("update_full", variant, 1, [&]{
+			walk.Walk(db.GetRoot(), "", no_names, false);
+			return count();
+		});
+
+	Run("update_unchanged", variant, c.repeat, [&]{
+			walk.Walk(db.GetRoot(), "", no_names, false);
+			return count();
+		});
+
+	Run("update_discard", variant, 1, [&]{
+			walk.Walk(db.GetRoot(), "", no_names, true);
+			return count();
+		});
+
+	db.Close();
+}
+
+#endif
+
+int
+main(int argc, char **argv)
+try {
+	const auto c = ParseCommandLine(argc, argv);
+
+	printf("# operation\tvariant\tfirst_seconds\tavg_seconds\tresults\tpeak_rss_kib\n");
+
+	BenchFormat(c, "text", "no");
+#ifdef ENABLE_ZLIB
+	BenchFormat(c, "text", "yes");
+#endif
+	BenchFormat(c, "binary", "no");
+
+#ifdef ENABLE_DSD
+	if (c.update_songs > 0)
+		BenchUpdate(c);
+#endif
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
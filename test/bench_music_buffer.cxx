@@ -0,0 +1,142 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * A micro-benchmark for #MusicBuffer: a "decoder" thread fills chunks
+ * and pushes them into a #MusicPipe while an "output" thread consumes
+ * them, and then several threads allocate and return chunks
+ * concurrently.
+ */
+
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "MusicPipe.hxx"
+#include "AudioFormat.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+
+static void
+RunDecoder(MusicBuffer &buffer, MusicPipe &pipe, unsigned n) noexcept
+{
+	for (unsigned i = 0; i < n;) {
+		auto chunk = buffer.Allocate();
+		if (!chunk) {
+			/* the buffer is full; wait for the output */
+			std::this_thread::yield();
+			continue;
+		}
+
+		auto w = chunk->Write(audio_format, SongTime::zero(), 0);
+		memset(w.data, 0, w.size);
+		chunk->Expand(audio_format, w.size);
+
+		pipe.Push(std::move(chunk));
+		++i;
+	}
+}
+
+static void
+RunOutput(MusicPipe &pipe, unsigned n) noexcept
+{
+	for (unsigned i = 0; i < n;) {
+		auto chunk = pipe.Shift();
+		if (!chunk) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		/* returns the chunk to the MusicBuffer */
+		chunk.reset();
+		++i;
+	}
+}
+
+static double
+RunPipe(MusicBuffer &buffer, unsigned n)
+{
+	MusicPipe pipe;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::thread output(RunOutput, std::ref(pipe), n);
+	RunDecoder(buffer, pipe, n);
+	output.join();
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void
+RunChurn(MusicBuffer &buffer, unsigned n) noexcept
+{
+	MusicChunkPtr batch[8];
+
+	for (unsigned i = 0; i < n; i += std::size(batch)) {
+		for (auto &chunk : batch)
+			chunk = buffer.Allocate();
+
+		for (auto &chunk : batch)
+			chunk.reset();
+	}
+}
+
+static double
+RunChurn(MusicBuffer &buffer, unsigned n_threads, unsigned n)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads.emplace_back([&buffer, n](){
+			RunChurn(buffer, n);
+		});
+
+	for (auto &t : threads)
+		t.join();
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int
+main(int argc, char **argv)
+{
+	const unsigned n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+	const unsigned n_threads = argc > 2 ? strtoul(argv[2], nullptr, 10) : 3;
+
+	MusicBuffer buffer(1024, CHUNK_SIZE);
+
+	const double pipe_time = RunPipe(buffer, n);
+	printf("pipe:  %u chunks in %.3f s (%.0f chunks/s)\n",
+	       n, pipe_time, n / pipe_time);
+
+	const double churn_time = RunChurn(buffer, n_threads, n);
+	printf("churn: %u threads x %u chunks in %.3f s (%.0f chunks/s)\n",
+	       n_threads, n, churn_time, n_threads * n / churn_time);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,664 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A throughput benchmark for the PCM kernels: sample format
+ * conversion, combined sample format and channel conversion,
+ * software volume, mixing, dithering, #PcmExport, DSD to PCM, DoP and
+ * the resamplers.
+ *
+ * The results are printed as tab-separated lines (kernel, variant,
+ * number of channels, input samples per second), which can be
+ * compared between two builds to find regressions.
+ *
+ * Usage: bench_pcm [SECONDS [FILTER]]
+ *
+ * SECONDS is the duration of each case (default 0.5), and FILTER
+ * selects only the kernels whose name contains this string.
+ */
+
+#include "config.h"
+#include "AudioFormat.hxx"
+#include "pcm/FormatConverter.hxx"
+#include "pcm/ChannelsConverter.hxx"
+#include "pcm/FusedConvert.hxx"
+#include "pcm/Volume.hxx"
+#include "pcm/Mix.hxx"
+#include "pcm/Dither.hxx"
+#include "pcm/PcmFormat.hxx"
+#include "pcm/Buffer.hxx"
+#include "pcm/Export.hxx"
+#include "pcm/Resampler.hxx"
+#include "pcm/ConfiguredResampler.hxx"
+#include "config/Data.hxx"
+#include "config/Block.hxx"
+#include "config/Option.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/PrintException.hxx"
+
+#ifdef ENABLE_DSD
+#include "pcm/PcmDsd.hxx"
+#include "pcm/Dop.hxx"
+#endif
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of frames passed to each kernel call, like one
+ * #MusicChunk would contain.
+ */
+static constexpr size_t BLOCK_FRAMES = 1024;
+
+static constexpr unsigned channel_counts[] = { 2, 6 };
+
+static constexpr SampleFormat pcm_formats[] = {
+	SampleFormat::S8,
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+	SampleFormat::FLOAT,
+};
+
+static double duration = 0.5;
+static const char *filter = nullptr;
+
+/**
+ * The last byte of each kernel result is accumulated here, so the
+ * compiler cannot optimize the calls away.
+ */
+static volatile uint8_t sink;
+
+static void
+Consume(ConstBuffer<void> b) noexcept
+{
+	if (!b.empty())
+		sink = sink + ((const uint8_t *)b.data)[b.size - 1];
+}
+
+static bool
+IsSelected(const char *kernel) noexcept
+{
+	return filter == nullptr || strstr(kernel, filter) != nullptr;
+}
+
+/**
+ * Call the given function repeatedly for #duration seconds and print
+ * the throughput.
+ *
+ * @param samples the number of (input) samples processed by each
+ * call
+ */
+static void
+Run(const char *kernel, const char *variant, unsigned channels,
+    size_t samples, const std::function<void()> &f)
+{
+	using Clock = std::chrono::steady_clock;
+
+	/* warm up: allocate buffers, fill caches */
+	f();
+
+	size_t n = 0;
+	const auto start = Clock::now();
+	std::chrono::duration<double> elapsed;
+
+	do {
+		for (unsigned i = 0; i < 16; ++i)
+			f();
+		n += 16;
+
+		elapsed = Clock::now() - start;
+	} while (elapsed.count() < duration);
+
+	printf("%s\t%s\t%u\t%.0f\n", kernel, variant, channels,
+	       n * samples / elapsed.count());
+	fflush(stdout);
+}
+
+/**
+ * Generate pseudo-random samples in the full range of the given
+ * format.
+ */
+static std::vector<uint8_t>
+MakeSamples(SampleFormat format, size_t samples) noexcept
+{
+	std::vector<uint8_t> v(samples * sample_format_size(format));
+
+	uint32_t r = 0x12345678;
+	auto next = [&r]{
+		r ^= r << 13;
+		r ^= r >> 17;
+		r ^= r << 5;
+		return r;
+	};
+
+	switch (format) {
+	case SampleFormat::S24_P32:
+		for (size_t i = 0; i < samples; ++i)
+			((int32_t *)v.data())[i] = int32_t(next()) >> 8;
+		break;
+
+	case SampleFormat::FLOAT:
+		for (size_t i = 0; i < samples; ++i)
+			((float *)v.data())[i] = int32_t(next()) / 2147483648.f;
+		break;
+
+	default:
+		for (auto &b : v)
+			b = next();
+		break;
+	}
+
+	return v;
+}
+
+static ConstBuffer<void>
+ToBuffer(const std::vector<uint8_t> &v) noexcept
+{
+	return {v.data(), v.size()};
+}
+
+static void
+BenchFormat()
+{
+	if (!IsSelected("format"))
+		return;
+
+	const size_t samples = BLOCK_FRAMES * 2;
+
+	for (const auto src_format : pcm_formats) {
+		const auto src = MakeSamples(src_format, samples);
+
+		for (const auto dest_format : pcm_formats) {
+			if (dest_format == src_format)
+				continue;
+
+			PcmFormatConverter converter;
+			try {
+				converter.Open(src_format, dest_format);
+			} catch (...) {
+				/* not supported */
+				continue;
+			}
+
+			char variant[64];
+			snprintf(variant, sizeof(variant), "%s->%s",
+				 sample_format_to_string(src_format),
+				 sample_format_to_string(dest_format));
+
+			Run("format", variant, 2, samples, [&]{
+				Consume(converter.Convert(ToBuffer(src)));
+			});
+
+			converter.Close();
+		}
+	}
+}
+
+struct ConvertCase {
+	SampleFormat src_format;
+	unsigned src_channels;
+	SampleFormat dest_format;
+	unsigned dest_channels;
+};
+
+static constexpr ConvertCase convert_cases[] = {
+	{ SampleFormat::S16, 1, SampleFormat::S32, 2 },
+	{ SampleFormat::S16, 1, SampleFormat::S24_P32, 2 },
+	{ SampleFormat::S16, 1, SampleFormat::FLOAT, 2 },
+	{ SampleFormat::S16, 2, SampleFormat::S32, 1 },
+	{ SampleFormat::S24_P32, 1, SampleFormat::S32, 2 },
+	{ SampleFormat::S24_P32, 2, SampleFormat::FLOAT, 1 },
+	{ SampleFormat::S32, 2, SampleFormat::S24_P32, 1 },
+
+	/* no fused kernel; these show the generic chain */
+	{ SampleFormat::S24_P32, 1, SampleFormat::S16, 2 },
+	{ SampleFormat::FLOAT, 1, SampleFormat::S32, 2 },
+};
+
+/**
+ * Compare #PcmFusedConverter with the generic chain which
+ * #PcmConvert would use without it.
+ */
+static void
+BenchConvert()
+{
+	if (!IsSelected("convert"))
+		return;
+
+	for (const auto &c : convert_cases) {
+		const size_t samples = BLOCK_FRAMES * c.src_channels;
+		const auto src = MakeSamples(c.src_format, samples);
+
+		char variant[64];
+
+		PcmFusedConverter fused;
+		if (fused.Open(c.src_format, c.src_channels,
+			       c.dest_format, c.dest_channels)) {
+			snprintf(variant, sizeof(variant), "%s:%u->%s:%u fused",
+				 sample_format_to_string(c.src_format),
+				 c.src_channels,
+				 sample_format_to_string(c.dest_format),
+				 c.dest_channels);
+
+			Run("convert", variant, c.src_channels, samples, [&]{
+				Consume(fused.Convert(ToBuffer(src)));
+			});
+
+			fused.Close();
+		}
+
+		PcmFormatConverter format_converter;
+		format_converter.Open(c.src_format, c.dest_format);
+
+		PcmChannelsConverter channels_converter;
+		channels_converter.Open(c.dest_format, c.src_channels,
+					c.dest_channels);
+
+		snprintf(variant, sizeof(variant), "%s:%u->%s:%u chain",
+			 sample_format_to_string(c.src_format),
+			 c.src_channels,
+			 sample_format_to_string(c.dest_format),
+			 c.dest_channels);
+
+		Run("convert", variant, c.src_channels, samples, [&]{
+			Consume(channels_converter.Convert(format_converter.Convert(ToBuffer(src))));
+		});
+
+		channels_converter.Close();
+		format_converter.Close();
+	}
+}
+
+static void
+BenchVolume()
+{
+	if (!IsSelected("volume"))
+		return;
+
+	const size_t samples = BLOCK_FRAMES * 2;
+
+	for (const auto format : pcm_formats) {
+		const auto src = MakeSamples(format, samples);
+
+		PcmVolume pv;
+		pv.Open(format, false);
+		pv.SetVolume(PCM_VOLUME_1 / 2);
+
+		Run("volume", sample_format_to_string(format), 2, samples, [&]{
+			Consume(pv.Apply(ToBuffer(src)));
+		});
+
+		pv.Close();
+	}
+}
+
+static void
+BenchMix()
+{
+	if (!IsSelected("mix"))
+		return;
+
+	const size_t samples = BLOCK_FRAMES * 2;
+
+	for (const auto format : pcm_formats) {
+		auto buffer1 = MakeSamples(format, samples);
+		const auto buffer2 = MakeSamples(format, samples);
+		const auto src1 = buffer1;
+
+		PcmDither dither;
+
+		for (const float portion : {0.7f, -1.0f}) {
+			char variant[64];
+			snprintf(variant, sizeof(variant), "%s %s",
+				 sample_format_to_string(format),
+				 portion < 0 ? "add" : "portion");
+
+			Run("mix", variant, 2, samples, [&]{
+				if (pcm_mix(dither, buffer1.data(),
+					    buffer2.data(), buffer1.size(),
+					    format, portion))
+					Consume(ToBuffer(buffer1));
+			});
+		}
+
+		PcmBuffer b1, b2;
+		char variant[64];
+		snprintf(variant, sizeof(variant), "%s float",
+			 sample_format_to_string(format));
+
+		Run("mix", variant, 2, samples, [&]{
+			Consume(pcm_mix_float(b1, b2, dither,
+					      ToBuffer(src1), ToBuffer(buffer2),
+					      format, 0.7f));
+		});
+	}
+}
+
+static void
+BenchDither()
+{
+	if (!IsSelected("dither"))
+		return;
+
+	const size_t samples = BLOCK_FRAMES * 2;
+
+	for (const bool shaping : {true, false}) {
+		PcmDither::SetDefaultShaping(shaping);
+
+		for (const auto format : {SampleFormat::S24_P32, SampleFormat::S32}) {
+			const auto src = MakeSamples(format, samples);
+
+			PcmBuffer buffer;
+			PcmDither dither;
+
+			char variant[64];
+			snprintf(variant, sizeof(variant), "%s->16 %s",
+				 sample_format_to_string(format),
+				 shaping ? "shaping" : "tpdf");
+
+			Run("dither", variant, 2, samples, [&]{
+				Consume(pcm_convert_to_16(buffer, dither,
+							  format,
+							  ToBuffer(src)).ToVoid());
+			});
+		}
+	}
+
+	PcmDither::SetDefaultShaping(true);
+}
+
+static void
+BenchExport(const char *variant, SampleFormat format, unsigned channels,
+	    PcmExport::Params params)
+{
+	const size_t samples = BLOCK_FRAMES * channels;
+	const auto src = MakeSamples(format, samples);
+
+	PcmExport e;
+	e.Open(format, channels, params);
+
+	Run("export", variant, channels, samples, [&]{
+		Consume(e.Export(ToBuffer(src)));
+	});
+}
+
+static void
+BenchExport()
+{
+	if (!IsSelected("export"))
+		return;
+
+	for (const unsigned channels : channel_counts) {
+		PcmExport::Params params;
+
+		params.reverse_endian = true;
+		BenchExport("S16 reverse_endian", SampleFormat::S16,
+			    channels, params);
+		BenchExport("S32 reverse_endian", SampleFormat::S32,
+			    channels, params);
+
+		params = {};
+		params.pack24 = true;
+		BenchExport("S24_P32 pack24", SampleFormat::S24_P32,
+			    channels, params);
+
+		params = {};
+		params.shift8 = true;
+		BenchExport("S24_P32 shift8", SampleFormat::S24_P32,
+			    channels, params);
+
+		if (channels == 6) {
+			params = {};
+			params.alsa_channel_order = true;
+			BenchExport("S16 alsa_channel_order",
+				    SampleFormat::S16, channels, params);
+			BenchExport("S32 alsa_channel_order",
+				    SampleFormat::S32, channels, params);
+		}
+
+#ifdef ENABLE_DSD
+		params = {};
+		params.dsd_mode = PcmExport::DsdMode::U16;
+		BenchExport("DSD_U16", SampleFormat::DSD, channels, params);
+
+		params.dsd_mode = PcmExport::DsdMode::U32;
+		BenchExport("DSD_U32", SampleFormat::DSD, channels, params);
+
+		params.dsd_mode = PcmExport::DsdMode::DOP;
+		BenchExport("DoP", SampleFormat::DSD, channels, params);
+
+		params.pack24 = true;
+		BenchExport("DoP pack24", SampleFormat::DSD, channels, params);
+#endif
+	}
+}
+
+#ifdef ENABLE_DSD
+
+static void
+BenchDsd()
+{
+	if (!IsSelected("dsd"))
+		return;
+
+	for (const unsigned channels : channel_counts) {
+		/* DSD "samples" are bytes (8 bits of one channel) */
+		const size_t samples = BLOCK_FRAMES * channels;
+		const auto src = MakeSamples(SampleFormat::DSD, samples);
+		const ConstBuffer<uint8_t> src_u8(src.data(), src.size());
+
+		for (const auto f : {DsdFilter::FAST, DsdFilter::SHARP}) {
+			for (const unsigned decimation : {8u, 16u, 32u}) {
+				PcmDsd dsd;
+				dsd.Open(channels, decimation, f);
+
+				const char *filter_name = f == DsdFilter::FAST
+					? "fast" : "sharp";
+				char variant[64];
+
+				snprintf(variant, sizeof(variant),
+					 "float %s 1:%u", filter_name,
+					 decimation);
+				Run("dsd", variant, channels, samples, [&]{
+					Consume(dsd.ToFloat(src_u8).ToVoid());
+				});
+
+				snprintf(variant, sizeof(variant),
+					 "S24_P32 %s 1:%u", filter_name,
+					 decimation);
+				Run("dsd", variant, channels, samples, [&]{
+					Consume(dsd.ToS24(src_u8).ToVoid());
+				});
+			}
+		}
+	}
+}
+
+static void
+BenchDop()
+{
+	if (!IsSelected("dop"))
+		return;
+
+	for (const unsigned channels : channel_counts) {
+		const size_t samples = BLOCK_FRAMES * channels;
+		const auto src = MakeSamples(SampleFormat::DSD, samples);
+
+		DsdToDopConverter dop;
+		dop.Open(channels);
+
+		Run("dop", "DSD->DoP", channels, samples, [&]{
+			Consume(dop.Convert({src.data(), src.size()}));
+		});
+	}
+}
+
+#endif
+
+struct ResamplerCase {
+	const char *name;
+	const char *plugin;
+	const char *key, *value;
+
+	/**
+	 * The maximum number of channels supported by this
+	 * resampler; 0 means no limit.
+	 */
+	unsigned max_channels = 0;
+};
+
+static constexpr ResamplerCase resampler_cases[] = {
+	{ "internal", "internal", nullptr, nullptr, 2 },
+#ifdef ENABLE_LIBSAMPLERATE
+	{ "libsamplerate fastest", "libsamplerate", "type", "Fastest Sinc Interpolator" },
+	{ "libsamplerate medium", "libsamplerate", "type", "Medium Sinc Interpolator" },
+	{ "libsamplerate best", "libsamplerate", "type", "Best Sinc Interpolator" },
+	{ "libsamplerate linear", "libsamplerate", "type", "Linear Interpolator" },
+#endif
+#ifdef ENABLE_SOXR
+	{ "soxr quick", "soxr", "quality", "quick" },
+	{ "soxr low", "soxr", "quality", "low" },
+	{ "soxr medium", "soxr", "quality", "medium" },
+	{ "soxr high", "soxr", "quality", "high" },
+	{ "soxr very high", "soxr", "quality", "very high" },
+#endif
+};
+
+/**
+ * Register one named "resampler" block for each of
+ * #resampler_cases.
+ */
+static void
+InitResamplers()
+{
+	ConfigData config;
+
+	for (const auto &c : resampler_cases) {
+		ConfigBlock block;
+		block.AddBlockParam("name", c.name);
+		block.AddBlockParam("plugin", c.plugin);
+		if (c.key != nullptr)
+			block.AddBlockParam(c.key, c.value);
+		config.AddBlock(ConfigBlockOption::RESAMPLER,
+				std::move(block));
+	}
+
+	pcm_resampler_global_init(config);
+}
+
+static void
+BenchResampler(const ResamplerCase &c, SampleFormat format,
+	       unsigned channels, unsigned src_rate, unsigned dest_rate)
+{
+	std::unique_ptr<PcmResampler> resampler(pcm_resampler_create(&pcm_resampler_find(c.name)));
+
+	AudioFormat af(src_rate, format, channels);
+	resampler->Open(af, dest_rate);
+
+	if (af.format != format) {
+		/* this resampler converts to another input format,
+		   which is covered by another case */
+		resampler->Close();
+		return;
+	}
+
+	const size_t samples = BLOCK_FRAMES * channels;
+	const auto src = MakeSamples(format, samples);
+
+	char variant[96];
+	snprintf(variant, sizeof(variant), "%s %s %u->%u", c.name,
+		 sample_format_to_string(format), src_rate, dest_rate);
+
+	Run("resampler", variant, channels, samples, [&]{
+		Consume(resampler->Resample(ToBuffer(src)));
+	});
+
+	resampler->Close();
+}
+
+static void
+BenchResamplers()
+{
+	if (!IsSelected("resampler"))
+		return;
+
+	InitResamplers();
+
+	for (const auto &c : resampler_cases) {
+		for (const unsigned channels : channel_counts) {
+			if (c.max_channels > 0 && channels > c.max_channels)
+				continue;
+
+			for (const auto format : pcm_formats) {
+				BenchResampler(c, format, channels,
+					       44100, 48000);
+				BenchResampler(c, format, channels,
+					       96000, 44100);
+			}
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc > 3) {
+		fprintf(stderr, "Usage: bench_pcm [SECONDS [FILTER]]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1) {
+		char *endptr;
+		duration = strtod(argv[1], &endptr);
+		if (endptr == argv[1] || *endptr != 0 || duration <= 0) {
+			fprintf(stderr, "Malformed duration: %s\n", argv[1]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc > 2)
+		filter = argv[2];
+
+	printf("# kernel\tvariant\tchannels\tsamples_per_second\n");
+
+	BenchFormat();
+	BenchConvert();
+	BenchVolume();
+	BenchMix();
+	BenchDither();
+	BenchExport();
+#ifdef ENABLE_DSD
+	BenchDsd();
+	BenchDop();
+#endif
+	BenchResamplers();
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
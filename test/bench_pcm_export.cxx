@@ -0,0 +1,97 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A micro-benchmark for the DSD paths of #PcmExport: it converts a
+ * DSD512 stream to DSD_U16, DSD_U32 and DoP (optionally with byte
+ * swapping or 24 bit packing) and prints how many times faster than
+ * real time this is.
+ */
+
+#include "config.h"
+#include "pcm/Export.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <chrono>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * DSD512 transports 512 * 44100 bits per second and channel.
+ */
+static constexpr unsigned dsd512_bytes_per_second = 512 * 44100 / 8;
+
+static void
+Run(const char *name, unsigned channels, PcmExport::Params params,
+    unsigned seconds)
+{
+	/* the size of one MusicChunk's worth of data, like the
+	   output thread would pass it */
+	std::vector<uint8_t> src(4096 * channels);
+	for (size_t i = 0; i < src.size(); ++i)
+		src[i] = i * 0x9d;
+
+	PcmExport e;
+	e.Open(SampleFormat::DSD, channels, params);
+
+	const size_t total = size_t(seconds) * dsd512_bytes_per_second * channels;
+	size_t checksum = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t done = 0; done < total; done += src.size()) {
+		const auto dest = e.Export({src.data(), src.size()});
+		checksum += ((const uint8_t *)dest.data)[dest.size - 1];
+	}
+
+	const double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%-12s %u ch: %.3f s for %u s of DSD512 (%.0fx real time, %.0f MB/s) [%zx]\n",
+	       name, channels, t, seconds, seconds / t,
+	       total / t / 1e6, checksum & 0xff);
+}
+
+int
+main(int argc, char **argv)
+{
+	const unsigned seconds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 60;
+
+	for (const unsigned channels : {2u, 6u}) {
+		PcmExport::Params params;
+
+		params.dsd_mode = PcmExport::DsdMode::U16;
+		Run("DSD_U16", channels, params, seconds);
+
+		params.dsd_mode = PcmExport::DsdMode::U32;
+		Run("DSD_U32", channels, params, seconds);
+
+		params.reverse_endian = true;
+		Run("DSD_U32_BE", channels, params, seconds);
+
+		params.reverse_endian = false;
+		params.dsd_mode = PcmExport::DsdMode::DOP;
+		Run("DoP", channels, params, seconds);
+
+		params.pack24 = true;
+		Run("DoP packed", channels, params, seconds);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -69,7 +69,7 @@ try {
 
 	auto is = OpenLocalInputStream(path, mutex);
 
-	const auto tag = tag_id3_load(*is);
+	const auto tag = tag_id3_load(*is, false);
 	if (tag == NULL) {
 		fprintf(stderr, "No ID3 tag found\n");
 		return EXIT_FAILURE;
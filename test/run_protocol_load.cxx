@@ -0,0 +1,682 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A load generator for the MPD protocol: it opens many connections
+ * to a running MPD, sends a weighted mix of commands on each of them
+ * (optionally pipelined) and prints the throughput and latency
+ * percentiles of each command.
+ *
+ * Usage: run_protocol_load [OPTIONS] ADDRESS [[WEIGHT*]COMMAND...]
+ *
+ * ADDRESS is "HOST[:PORT]", the path of a local socket or "@NAME"
+ * for an abstract socket.  Each COMMAND is a raw protocol line
+ * (without the newline), optionally prefixed with a weight, e.g.
+ * "10*status".  "idle" is sent together with "noidle", i.e. it
+ * measures the idle round trip.  The default mix is "status".
+ */
+
+#include "event/Loop.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "event/TimerEvent.hxx"
+#include "net/Resolver.hxx"
+#include "net/AddressInfo.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/SocketAddress.hxx"
+#include "net/SocketError.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/OptionDef.hxx"
+#include "util/OptionParser.hxx"
+#include "util/PrintException.hxx"
+#include "util/StringCompare.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <forward_list>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct CommandLine {
+	const char *address = nullptr;
+
+	const char *password = nullptr;
+
+	unsigned connections = 10;
+
+	/**
+	 * The number of requests each connection keeps in flight.
+	 */
+	unsigned depth = 1;
+
+	double duration = 10;
+
+	/**
+	 * Responses received during this period after the start are
+	 * not counted.
+	 */
+	double warmup = 1;
+
+	ConstBuffer<const char *> commands;
+};
+
+enum Option {
+	OPTION_CONNECTIONS,
+	OPTION_DEPTH,
+	OPTION_DURATION,
+	OPTION_WARMUP,
+	OPTION_PASSWORD,
+};
+
+static constexpr OptionDef option_defs[] = {
+	{"connections", 'c', true, "Number of concurrent connections (10)"},
+	{"depth", 'd', true, "Number of pipelined requests per connection (1)"},
+	{"duration", 't', true, "Duration of the measurement in seconds (10)"},
+	{"warmup", 0, true, "Seconds before the measurement starts (1)"},
+	{"password", 0, true, "Send this password on each connection"},
+};
+
+static unsigned
+ParsePositive(const char *s)
+{
+	char *endptr;
+	const auto value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0 || value == 0)
+		throw std::runtime_error(std::string("Malformed number: ") + s);
+
+	return value;
+}
+
+static double
+ParseSeconds(const char *s)
+{
+	char *endptr;
+	const double value = strtod(s, &endptr);
+	if (endptr == s || *endptr != 0 || value < 0)
+		throw std::runtime_error(std::string("Malformed duration: ") + s);
+
+	return value;
+}
+
+static CommandLine
+ParseCommandLine(int argc, char **argv)
+{
+	CommandLine c;
+
+	OptionParser option_parser(option_defs, argc, argv);
+	while (auto o = option_parser.Next()) {
+		switch (Option(o.index)) {
+		case OPTION_CONNECTIONS:
+			c.connections = ParsePositive(o.value);
+			break;
+
+		case OPTION_DEPTH:
+			c.depth = ParsePositive(o.value);
+			break;
+
+		case OPTION_DURATION:
+			c.duration = ParseSeconds(o.value);
+			if (c.duration <= 0)
+				throw std::runtime_error("Duration must be positive");
+			break;
+
+		case OPTION_WARMUP:
+			c.warmup = ParseSeconds(o.value);
+			break;
+
+		case OPTION_PASSWORD:
+			c.password = o.value;
+			break;
+		}
+	}
+
+	auto args = option_parser.GetRemaining();
+	if (args.empty())
+		throw std::runtime_error("Usage: run_protocol_load [--connections=N] [--depth=N] [--duration=SECONDS] [--warmup=SECONDS] [--password=PASSWORD] ADDRESS [[WEIGHT*]COMMAND...]");
+
+	c.address = args.shift();
+	c.commands = args;
+	return c;
+}
+
+/**
+ * One command of the mix, and the statistics collected for it.
+ */
+struct MixEntry {
+	/**
+	 * The command line as specified by the user; used in the
+	 * report.
+	 */
+	std::string name;
+
+	/**
+	 * The text sent to MPD, including the trailing newline.
+	 */
+	std::string request;
+
+	/**
+	 * The latencies of all counted responses [microseconds].
+	 */
+	std::vector<uint32_t> latencies;
+
+	unsigned errors = 0;
+
+	explicit MixEntry(const char *command) noexcept
+		:name(command), request(command) {
+		request.push_back('\n');
+
+		/* "idle" would block until something happens; cancel
+		   it right away to measure the round trip */
+		if (StringIsEqual(command, "idle") ||
+		    StringStartsWith(command, "idle "))
+			request += "noidle\n";
+	}
+};
+
+class CommandMix {
+	std::vector<MixEntry> entries;
+
+	/**
+	 * Each entry index appears here as often as its weight, so a
+	 * uniformly chosen element picks a weighted entry.
+	 */
+	std::vector<unsigned> schedule;
+
+public:
+	explicit CommandMix(ConstBuffer<const char *> commands) {
+		if (commands.empty()) {
+			Add("status", 1);
+			return;
+		}
+
+		for (const char *command : commands) {
+			unsigned weight = 1;
+
+			char *endptr;
+			const auto value = strtoul(command, &endptr, 10);
+			if (endptr != command && *endptr == '*') {
+				if (value == 0)
+					throw std::runtime_error(std::string("Malformed weight: ") + command);
+
+				weight = value;
+				command = endptr + 1;
+			}
+
+			Add(command, weight);
+		}
+	}
+
+	template<typename R>
+	unsigned Pick(R &random) const noexcept {
+		return schedule[random() % schedule.size()];
+	}
+
+	MixEntry &operator[](unsigned i) noexcept {
+		return entries[i];
+	}
+
+	std::vector<MixEntry> &GetEntries() noexcept {
+		return entries;
+	}
+
+private:
+	void Add(const char *command, unsigned weight) {
+		const unsigned i = entries.size();
+		entries.emplace_back(command);
+		schedule.insert(schedule.end(), weight, i);
+	}
+};
+
+class LoadGenerator;
+
+class LoadConnection final : FullyBufferedSocket {
+	/**
+	 * A "pending" entry index which marks the (uncounted)
+	 * "password" command.
+	 */
+	static constexpr unsigned PASSWORD = ~0U;
+
+	LoadGenerator &generator;
+
+	std::minstd_rand random;
+
+	struct Pending {
+		unsigned entry;
+		Clock::time_point start;
+	};
+
+	/**
+	 * The requests which have been sent, but whose response has
+	 * not been received completely yet, in the order they have
+	 * been sent.
+	 */
+	std::deque<Pending> pending;
+
+	/**
+	 * The number of bytes of a "binary" chunk (plus its trailing
+	 * newline) which have not been received yet.
+	 */
+	size_t binary_remaining = 0;
+
+	/**
+	 * Has the "OK MPD" greeting been received?
+	 */
+	bool greeted = false;
+
+	/**
+	 * Discard input until the next newline?  This is set when a
+	 * response line doesn't fit into the input buffer; those
+	 * lines are never the end of a response.
+	 */
+	bool skip_line = false;
+
+public:
+	LoadConnection(LoadGenerator &_generator, EventLoop &_loop,
+		       SocketDescriptor _fd, unsigned seed) noexcept
+		:FullyBufferedSocket(_fd, _loop, 16384, 65536),
+		 generator(_generator), random(seed + 1) {}
+
+	~LoadConnection() noexcept {
+		if (IsDefined())
+			Close();
+	}
+
+	/**
+	 * Send more requests until the configured pipelining depth
+	 * has been reached.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool Fill() noexcept;
+
+private:
+	bool SendRequest(unsigned entry, const std::string &request) noexcept {
+		pending.push_back({entry, Clock::now()});
+		return Write(request.data(), request.size());
+	}
+
+	/**
+	 * @return false if the socket has been closed
+	 */
+	bool OnLine(const char *line, size_t length) noexcept;
+
+	/**
+	 * The response to the oldest pending request has been
+	 * received completely.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool OnResponse(bool error) noexcept;
+
+	void Fail(const char *msg) noexcept;
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(void *data, size_t length) noexcept override;
+	void OnSocketError(std::exception_ptr ep) noexcept override;
+	void OnSocketClosed() noexcept override;
+};
+
+class LoadGenerator {
+	EventLoop &loop;
+
+	const CommandLine &config;
+
+	CommandMix mix;
+
+	std::forward_list<LoadConnection> connections;
+
+	TimerEvent warmup_timer, stop_timer;
+
+	Clock::time_point measure_start;
+	std::chrono::duration<double> measure_duration{};
+
+	unsigned n_alive = 0;
+
+	/**
+	 * Are responses being counted?  This is false during the
+	 * warmup.
+	 */
+	bool recording = false;
+
+	bool stopping = false;
+
+public:
+	LoadGenerator(EventLoop &_loop, const CommandLine &_config)
+		:loop(_loop), config(_config), mix(config.commands),
+		 warmup_timer(loop, BIND_THIS_METHOD(OnWarmupTimer)),
+		 stop_timer(loop, BIND_THIS_METHOD(OnStopTimer)) {}
+
+	const CommandLine &GetConfig() const noexcept {
+		return config;
+	}
+
+	bool IsStopping() const noexcept {
+		return stopping;
+	}
+
+	template<typename R>
+	unsigned PickEntry(R &random) const noexcept {
+		return mix.Pick(random);
+	}
+
+	const std::string &GetRequest(unsigned entry) noexcept {
+		return mix[entry].request;
+	}
+
+	/**
+	 * Open all connections and start the timers.
+	 */
+	void Start();
+
+	void Record(unsigned entry, Clock::duration latency,
+		    bool error) noexcept {
+		if (!recording)
+			return;
+
+		auto &e = mix[entry];
+		if (error)
+			++e.errors;
+		else
+			e.latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+	}
+
+	void OnConnectionFailed() noexcept {
+		if (--n_alive == 0 && !stopping) {
+			fprintf(stderr, "All connections have failed\n");
+			OnStopTimer();
+		}
+	}
+
+	void PrintReport() noexcept;
+
+private:
+	void Connect(const AddressInfoList &addresses, unsigned i);
+
+	void OnWarmupTimer() noexcept {
+		measure_start = Clock::now();
+		recording = true;
+		stop_timer.Schedule(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.duration)));
+	}
+
+	void OnStopTimer() noexcept {
+		if (recording)
+			measure_duration = Clock::now() - measure_start;
+
+		recording = false;
+		stopping = true;
+		loop.Break();
+	}
+};
+
+bool
+LoadConnection::Fill() noexcept
+{
+	const unsigned depth = generator.GetConfig().depth;
+
+	while (pending.size() < depth && !generator.IsStopping()) {
+		const unsigned entry = generator.PickEntry(random);
+		if (!SendRequest(entry, generator.GetRequest(entry)))
+			return false;
+	}
+
+	return true;
+}
+
+inline bool
+LoadConnection::OnResponse(bool error) noexcept
+{
+	if (pending.empty()) {
+		Fail("Unexpected response");
+		return false;
+	}
+
+	const auto p = pending.front();
+	pending.pop_front();
+
+	if (p.entry != PASSWORD)
+		generator.Record(p.entry, Clock::now() - p.start, error);
+	else if (error) {
+		Fail("Password rejected");
+		return false;
+	}
+
+	return Fill();
+}
+
+inline bool
+LoadConnection::OnLine(const char *line, size_t length) noexcept
+{
+	const std::string_view s(line, length);
+
+	if (!greeted) {
+		if (s.substr(0, 7) != "OK MPD ") {
+			Fail("Not a MPD server");
+			return false;
+		}
+
+		greeted = true;
+
+		const char *password = generator.GetConfig().password;
+		if (password != nullptr &&
+		    !SendRequest(PASSWORD,
+				 std::string("password \"") + password + "\"\n"))
+			return false;
+
+		return Fill();
+	}
+
+	if (s == "OK")
+		return OnResponse(false);
+
+	if (s.substr(0, 4) == "ACK ")
+		return OnResponse(true);
+
+	if (s.substr(0, 8) == "binary: ")
+		/* the chunk is followed by a newline */
+		binary_remaining = strtoul(line + 8, nullptr, 10) + 1;
+
+	return true;
+}
+
+BufferedSocket::InputResult
+LoadConnection::OnSocketInput(void *data, size_t length) noexcept
+{
+	const char *p = (const char *)data, *const end = p + length;
+
+	while (p < end) {
+		if (binary_remaining > 0) {
+			const size_t n = std::min<size_t>(binary_remaining,
+							  end - p);
+			binary_remaining -= n;
+			p += n;
+			continue;
+		}
+
+		const char *newline = (const char *)
+			memchr(p, '\n', end - p);
+		if (newline == nullptr) {
+			if (p == data && length >= 4096) {
+				/* too long for a line we're interested
+				   in */
+				skip_line = true;
+				p = end;
+			}
+
+			break;
+		}
+
+		if (skip_line)
+			skip_line = false;
+		else if (!OnLine(p, newline - p))
+			return InputResult::CLOSED;
+
+		p = newline + 1;
+	}
+
+	ConsumeInput(p - (const char *)data);
+	return InputResult::MORE;
+}
+
+void
+LoadConnection::Fail(const char *msg) noexcept
+{
+	fprintf(stderr, "%s\n", msg);
+	Close();
+	generator.OnConnectionFailed();
+}
+
+void
+LoadConnection::OnSocketError(std::exception_ptr ep) noexcept
+{
+	PrintException(ep);
+	Close();
+	generator.OnConnectionFailed();
+}
+
+void
+LoadConnection::OnSocketClosed() noexcept
+{
+	Fail("Connection closed by MPD");
+}
+
+void
+LoadGenerator::Connect(const AddressInfoList &addresses, unsigned i)
+{
+	UniqueSocketDescriptor fd;
+
+	if (addresses.empty()) {
+		AllocatedSocketAddress address;
+		address.SetLocal(config.address);
+
+		if (!fd.Create(AF_LOCAL, SOCK_STREAM, 0))
+			throw MakeSocketError("Failed to create socket");
+
+		if (!fd.Connect(address))
+			throw MakeSocketError("Failed to connect");
+	} else {
+		const auto &ai = addresses.front();
+		if (!fd.Create(ai.GetFamily(), ai.GetType(), ai.GetProtocol()))
+			throw MakeSocketError("Failed to create socket");
+
+		if (!fd.Connect(ai))
+			throw MakeSocketError("Failed to connect");
+
+		fd.SetNoDelay();
+	}
+
+	fd.SetNonBlocking();
+
+	connections.emplace_front(*this, loop, fd.Release(), i);
+	++n_alive;
+}
+
+void
+LoadGenerator::Start()
+{
+	AddressInfoList addresses;
+	if (config.address[0] != '/' && config.address[0] != '@')
+		addresses = Resolve(config.address, 6600, 0, SOCK_STREAM);
+
+	for (unsigned i = 0; i < config.connections; ++i)
+		Connect(addresses, i);
+
+	warmup_timer.Schedule(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.warmup)));
+}
+
+/**
+ * @param p the percentile (0..1)
+ */
+static double
+Percentile(const std::vector<uint32_t> &sorted, double p) noexcept
+{
+	if (sorted.empty())
+		return 0;
+
+	const size_t i = std::min<size_t>(sorted.size() * p,
+					  sorted.size() - 1);
+	return sorted[i] / 1000.;
+}
+
+static void
+PrintLine(const char *name, std::vector<uint32_t> &latencies,
+	  unsigned errors, double duration) noexcept
+{
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("%s\t%zu\t%u\t%.1f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n",
+	       name, latencies.size(), errors,
+	       (latencies.size() + errors) / duration,
+	       Percentile(latencies, 0.5),
+	       Percentile(latencies, 0.9),
+	       Percentile(latencies, 0.99),
+	       Percentile(latencies, 0.999),
+	       latencies.empty() ? 0. : latencies.back() / 1000.);
+}
+
+void
+LoadGenerator::PrintReport() noexcept
+{
+	const double duration = measure_duration.count();
+	if (duration <= 0) {
+		fprintf(stderr, "No responses were counted\n");
+		return;
+	}
+
+	printf("# command\tresponses\terrors\trequests_per_second\tp50_ms\tp90_ms\tp99_ms\tp99.9_ms\tmax_ms\n");
+
+	std::vector<uint32_t> all;
+	unsigned all_errors = 0;
+
+	for (auto &e : mix.GetEntries()) {
+		all.insert(all.end(), e.latencies.begin(), e.latencies.end());
+		all_errors += e.errors;
+
+		PrintLine(e.name.c_str(), e.latencies, e.errors, duration);
+	}
+
+	PrintLine("total", all, all_errors, duration);
+}
+
+int
+main(int argc, char **argv)
+try {
+	const auto c = ParseCommandLine(argc, argv);
+
+	EventLoop loop;
+	LoadGenerator generator(loop, c);
+	generator.Start();
+
+	loop.Run();
+
+	generator.PrintReport();
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
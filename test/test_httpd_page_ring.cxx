@@ -0,0 +1,117 @@
+/*
+ * Unit tests for class PageRing.
+ */
+
+#include "output/plugins/httpd/PageRing.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+using std::chrono::seconds;
+
+static PagePtr
+MakePage(size_t size)
+{
+	return std::make_shared<Page>(size);
+}
+
+TEST(PageRing, Basic)
+{
+	PageRing ring(1024);
+
+	EXPECT_EQ(ring.GetHead(), ring.GetTail());
+	EXPECT_EQ(size_t(0), ring.GetTotalSize());
+
+	auto a = MakePage(100), b = MakePage(200);
+	ring.Push(a, seconds(1));
+	ring.Push(b, seconds(2));
+
+	EXPECT_EQ(PageRing::Position(0), ring.GetHead());
+	EXPECT_EQ(PageRing::Position(2), ring.GetTail());
+	EXPECT_EQ(size_t(300), ring.GetTotalSize());
+	EXPECT_EQ(a, ring.Get(0));
+	EXPECT_EQ(b, ring.Get(1));
+	EXPECT_FALSE(ring.IsEvicted(0));
+
+	ring.Clear();
+	EXPECT_EQ(PageRing::Position(2), ring.GetHead());
+	EXPECT_EQ(PageRing::Position(2), ring.GetTail());
+	EXPECT_EQ(size_t(0), ring.GetTotalSize());
+	EXPECT_TRUE(ring.IsEvicted(0));
+	EXPECT_TRUE(ring.IsEvicted(1));
+	EXPECT_FALSE(ring.IsEvicted(2));
+
+	/* the ring doesn't hold references to evicted pages */
+	EXPECT_EQ(1, a.use_count());
+	EXPECT_EQ(1, b.use_count());
+}
+
+TEST(PageRing, EvictBySize)
+{
+	PageRing ring(1000);
+
+	for (unsigned i = 0; i < 10; ++i)
+		ring.Push(MakePage(300), seconds(i));
+
+	EXPECT_EQ(PageRing::Position(7), ring.GetHead());
+	EXPECT_EQ(PageRing::Position(10), ring.GetTail());
+	EXPECT_EQ(size_t(900), ring.GetTotalSize());
+
+	/* the newest page is kept even if it is too large */
+	auto big = MakePage(5000);
+	ring.Push(big, seconds(10));
+	EXPECT_EQ(PageRing::Position(10), ring.GetHead());
+	EXPECT_EQ(PageRing::Position(11), ring.GetTail());
+	EXPECT_EQ(big, ring.Get(10));
+}
+
+TEST(PageRing, EvictByCount)
+{
+	PageRing ring(SIZE_MAX);
+
+	std::vector<PagePtr> v;
+	for (unsigned i = 0; i < 5000; ++i) {
+		v.emplace_back(MakePage(1));
+		ring.Push(v.back(), seconds(i));
+	}
+
+	EXPECT_EQ(ring.GetTail() - ring.GetHead(),
+		  PageRing::Position(ring.GetTotalSize()));
+	EXPECT_EQ(PageRing::Position(5000), ring.GetTail());
+
+	for (auto p = ring.GetHead(); p != ring.GetTail(); ++p)
+		EXPECT_EQ(v[p], ring.Get(p));
+
+	EXPECT_EQ(1, v[ring.GetHead() - 1].use_count());
+}
+
+TEST(PageRing, MinDuration)
+{
+	PageRing ring(1000, seconds(3));
+
+	for (unsigned i = 0; i < 10; ++i)
+		ring.Push(MakePage(300), seconds(i));
+
+	/* pages of the last 3 seconds are kept even though they
+	   exceed the size limit */
+	EXPECT_EQ(PageRing::Position(6), ring.GetHead());
+	EXPECT_EQ(size_t(1200), ring.GetTotalSize());
+}
+
+TEST(PageRing, FindNewerThan)
+{
+	PageRing ring(SIZE_MAX);
+
+	EXPECT_EQ(ring.GetTail(), ring.FindNewerThan(seconds(5)));
+
+	for (unsigned i = 0; i < 10; ++i)
+		ring.Push(MakePage(1), seconds(i));
+
+	EXPECT_EQ(PageRing::Position(9), ring.FindNewerThan(seconds(0)));
+	EXPECT_EQ(PageRing::Position(7), ring.FindNewerThan(seconds(2)));
+	EXPECT_EQ(PageRing::Position(0), ring.FindNewerThan(seconds(9)));
+	EXPECT_EQ(PageRing::Position(0), ring.FindNewerThan(seconds(100)));
+}
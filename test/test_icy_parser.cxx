@@ -18,7 +18,8 @@ icy_parse_tag(const char *p)
 {
 	char *q = strdup(p);
 	AtScopeExit(q) { free(q); };
-	return icy_parse_tag(
+	TagBuilder tag_builder;
+	return icy_parse_tag(tag_builder,
 #ifdef HAVE_ICU_CONVERTER
 			     nullptr,
 #endif
@@ -30,7 +31,7 @@ CompareTagTitle(const Tag &tag, const std::string &title)
 {
 	EXPECT_EQ(uint16_t(1), tag.num_items);
 
-	const TagItem &item = *tag.items[0];
+	const TagItem &item = *tag.begin();
 	EXPECT_EQ(TAG_TITLE, item.type);
 	EXPECT_EQ(title, std::string(item.value));
 }
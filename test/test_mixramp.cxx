@@ -3,64 +3,64 @@
  */
 
 #include "player/CrossFade.cxx"
+#include "tag/MixRamp.hxx"
+#include "util/StringView.hxx"
 
 #include <gtest/gtest.h>
 
-#include <string.h>
+TEST(MixRamp, Parse)
+{
+	auto curve = ParseMixRampCurve("1.0 0.00;3.0 0.10;6.0 2.50;");
+	EXPECT_TRUE(curve.IsDefined());
+	ASSERT_EQ(curve.GetPoints().size(), 3u);
+	EXPECT_EQ(curve.GetPoints()[1].db, 3.0f);
+	EXPECT_NEAR(curve.GetPoints()[2].time.count(), 2.5, 0.001);
+
+	/* parsing stops at the first malformed pair */
+	curve = ParseMixRampCurve("1.0 0.00;3.0;6.0 2.50");
+	EXPECT_TRUE(curve.IsDefined());
+	EXPECT_EQ(curve.GetPoints().size(), 1u);
+
+	curve = ParseMixRampCurve("foo");
+	EXPECT_TRUE(curve.IsDefined());
+	EXPECT_TRUE(curve.GetPoints().empty());
+}
 
 TEST(MixRamp, Interpolate)
 {
-	const char *input = "1.0 0.00;3.0 0.10;6.0 2.50;";
+	const auto input = ParseMixRampCurve("1.0 0.00;3.0 0.10;6.0 2.50;");
 
-	char *foo = strdup(input);
 	EXPECT_NEAR(double(0),
-		    mixramp_interpolate(foo, 0).count(),
+		    mixramp_interpolate(input, 0).count(),
 		    0.05);
-	free(foo);
 
-	foo = strdup(input);
 	EXPECT_NEAR(float(0),
-		    mixramp_interpolate(foo, 1).count(),
+		    mixramp_interpolate(input, 1).count(),
 		    0.005);
-	free(foo);
 
-	foo = strdup(input);
 	EXPECT_NEAR(float(0.1),
-		    mixramp_interpolate(foo, 3).count(),
+		    mixramp_interpolate(input, 3).count(),
 		    0.005);
-	free(foo);
 
-	foo = strdup(input);
 	EXPECT_NEAR(float(2.5),
-		    mixramp_interpolate(foo, 6).count(),
+		    mixramp_interpolate(input, 6).count(),
 		    0.01);
-	free(foo);
 
-	foo = strdup(input);
-	EXPECT_LT(mixramp_interpolate(foo, 6.1), FloatDuration::zero());
-	free(foo);
+	EXPECT_LT(mixramp_interpolate(input, 6.1), FloatDuration::zero());
 
-	foo = strdup(input);
 	EXPECT_NEAR(float(0.05),
-		    mixramp_interpolate(foo, 2).count(),
+		    mixramp_interpolate(input, 2).count(),
 		    0.05);
-	free(foo);
 
-	foo = strdup(input);
 	EXPECT_NEAR(float(1.3),
-		    mixramp_interpolate(foo, 4.5).count(),
+		    mixramp_interpolate(input, 4.5).count(),
 		    0.05);
-	free(foo);
 
-	foo = strdup(input);
 	EXPECT_NEAR(float(0.9),
-		    mixramp_interpolate(foo, 4).count(),
+		    mixramp_interpolate(input, 4).count(),
 		    0.05);
-	free(foo);
 
-	foo = strdup(input);
 	EXPECT_NEAR(float(1.7),
-		    mixramp_interpolate(foo, 5).count(),
+		    mixramp_interpolate(input, 5).count(),
 		    0.05);
-	free(foo);
 }
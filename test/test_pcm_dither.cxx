@@ -51,3 +51,107 @@ TEST(PcmTest, Dither32)
 		EXPECT_LT(dest[i], (src[i] >> 16) + 8);
 	}
 }
+
+/**
+ * The buffer version of DitherShift() must produce the same output
+ * (and leave the same state behind) as calling the per-sample
+ * version in a loop.
+ */
+TEST(PcmTest, DitherShiftBuffer)
+{
+	constexpr unsigned N = 509;
+	const auto src = TestDataBuffer<int32_t, N>(RandomInt24());
+
+	PcmDither a, b;
+
+	for (unsigned round = 0; round < 3; ++round) {
+		int32_t expected[N], actual[N];
+		for (unsigned i = 0; i < N; ++i)
+			expected[i] = a.DitherShift<int_least64_t, 34, 24>(int_least64_t(src[i]) * 700);
+
+		b.DitherShift<int_least64_t, 34, 24>(actual, N,
+						     [&src](size_t i){
+							     return int_least64_t(src[i]) * 700;
+						     });
+
+		for (unsigned i = 0; i < N; ++i)
+			EXPECT_EQ(expected[i], actual[i]);
+	}
+}
+
+/**
+ * Create a #PcmDither which uses plain TPDF dither.
+ */
+static PcmDither
+MakeTpdfDither()
+{
+	PcmDither::SetDefaultShaping(false);
+	PcmDither dither;
+	PcmDither::SetDefaultShaping(true);
+	return dither;
+}
+
+TEST(PcmTest, TpdfDither24)
+{
+	constexpr unsigned N = 509;
+	const auto src = TestDataBuffer<int32_t, N>(RandomInt24());
+
+	int16_t dest[N];
+	PcmDither dither = MakeTpdfDither();
+	EXPECT_FALSE(dither.IsShaping());
+	dither.Dither24To16(dest, src.begin(), src.end());
+
+	for (unsigned i = 0; i < N; ++i) {
+		EXPECT_GE(dest[i], (src[i] >> 8) - 1);
+		EXPECT_LE(dest[i], (src[i] >> 8) + 2);
+	}
+}
+
+TEST(PcmTest, TpdfDither32)
+{
+	constexpr unsigned N = 509;
+	auto src = TestDataBuffer<int32_t, N>();
+	/* these must not overflow */
+	src[0] = INT32_MAX;
+	src[1] = INT32_MIN;
+
+	int16_t dest[N];
+	PcmDither dither = MakeTpdfDither();
+	dither.Dither32To16(dest, src.begin(), src.end());
+
+	EXPECT_EQ(INT16_MAX, dest[0]);
+	EXPECT_GE(dest[1], INT16_MIN);
+	EXPECT_LE(dest[1], INT16_MIN + 1);
+
+	for (unsigned i = 0; i < N; ++i) {
+		EXPECT_GE(dest[i], std::max((src[i] >> 16) - 1, INT16_MIN));
+		EXPECT_LE(dest[i], std::min((src[i] >> 16) + 2, INT16_MAX));
+	}
+}
+
+/**
+ * The (SIMD) kernel must produce the same output as the portable
+ * code.
+ */
+TEST(PcmTest, TpdfShift)
+{
+	constexpr unsigned N = 509;
+	auto src = TestDataBuffer<int32_t, N>();
+	src[0] = INT32_MAX;
+	src[1] = INT32_MIN;
+
+	for (unsigned shift : {8u, 10u, 16u}) {
+		const uint32_t mask = (1u << shift) - 1;
+		uint32_t r = 1;
+		int32_t noise[N];
+		for (unsigned i = 0; i < N; ++i)
+			noise[i] = TpdfNoise(r = XorShift32(r), mask);
+
+		int16_t expected[N], actual[N];
+		PortableTpdfShiftS16(expected, src.begin(), noise, N, shift);
+		TpdfShiftS16(actual, src.begin(), noise, N, shift);
+
+		for (unsigned i = 0; i < N; ++i)
+			EXPECT_EQ(expected[i], actual[i]);
+	}
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "pcm/PcmDsd.hxx"
+#include "pcm/BitReverse.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/ConstBuffer.hxx"
+#include "util/bit_reverse.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static std::vector<uint8_t>
+RandomDsd(size_t size)
+{
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<unsigned> dis(0, 0xff);
+
+	std::vector<uint8_t> result(size);
+	for (auto &i : result)
+		i = dis(gen);
+	return result;
+}
+
+/**
+ * Convert the whole buffer in chunks of varying size.
+ */
+static std::vector<float>
+ConvertChunked(PcmDsd &dsd, unsigned channels, ConstBuffer<uint8_t> src)
+{
+	std::vector<float> result;
+
+	size_t chunk = 1;
+	while (!src.empty()) {
+		const size_t size = std::min(chunk * channels, src.size);
+		const auto d = dsd.ToFloat({src.data, size});
+		result.insert(result.end(), d.begin(), d.end());
+
+		src.skip_front(size);
+		chunk = chunk * 3 % 257 + 1;
+	}
+
+	return result;
+}
+
+TEST(PcmTest, DsdCompatible)
+{
+	constexpr unsigned channels = 3;
+	constexpr size_t n_frames = 4099;
+	const auto src = RandomDsd(n_frames * channels);
+
+	PcmDsd dsd;
+	dsd.Open(channels, 8, DsdFilter::FAST);
+	const auto actual = ConvertChunked(dsd, channels,
+					   {src.data(), src.size()});
+	ASSERT_EQ(actual.size(), src.size());
+
+	for (unsigned c = 0; c < channels; ++c) {
+		std::vector<float> expected(n_frames);
+
+		auto *ctx = dsd2pcm_init();
+		ASSERT_NE(ctx, nullptr);
+		dsd2pcm_translate(ctx, n_frames, src.data() + c, channels,
+				  false, expected.data(), 1);
+		dsd2pcm_destroy(ctx);
+
+		/* skip the first samples: dsd2pcm forgets to
+		   bit-reverse its initial silence pattern */
+		for (size_t i = 12; i < n_frames; ++i)
+			ASSERT_NEAR(expected[i], actual[i * channels + c], 1e-6)
+				<< "c=" << c << " i=" << i;
+	}
+}
+
+/**
+ * Splitting the input into chunks must not change the output.
+ */
+TEST(PcmTest, DsdChunked)
+{
+	constexpr unsigned channels = 2;
+	constexpr size_t n_frames = 8191;
+	const auto src = RandomDsd(n_frames * channels);
+
+	for (const auto filter : {DsdFilter::FAST, DsdFilter::SHARP}) {
+		for (unsigned decimation : {8u, 16u, 32u}) {
+			PcmDsd dsd;
+			dsd.Open(channels, decimation, filter);
+			const auto expected = dsd.ToFloat({src.data(), src.size()});
+			const std::vector<float> expected_copy(expected.begin(),
+							       expected.end());
+			ASSERT_EQ(expected_copy.size(),
+				  n_frames / (decimation / 8) * channels);
+
+			dsd.Reset();
+			const auto actual = ConvertChunked(dsd, channels,
+							   {src.data(), src.size()});
+			ASSERT_EQ(actual.size(), expected_copy.size());
+
+			for (size_t i = 0; i < actual.size(); ++i)
+				ASSERT_NEAR(expected_copy[i], actual[i], 1e-6);
+		}
+	}
+}
+
+/**
+ * All filters must pass DC (all bits set) with unity gain and must
+ * remove the DSD silence pattern.
+ */
+TEST(PcmTest, DsdGain)
+{
+	for (const auto filter : {DsdFilter::FAST, DsdFilter::SHARP}) {
+		for (unsigned decimation : {8u, 16u, 32u}) {
+			PcmDsd dsd;
+			dsd.Open(1, decimation, filter);
+
+			const std::vector<uint8_t> ones(4096, 0xff);
+			auto d = dsd.ToFloat({ones.data(), ones.size()});
+			ASSERT_FALSE(d.empty());
+			EXPECT_NEAR(d.back(), 1.0, 1e-5);
+
+			const std::vector<uint8_t> silence(4096, 0x69);
+			d = dsd.ToFloat({silence.data(), silence.size()});
+			ASSERT_FALSE(d.empty());
+			EXPECT_NEAR(d.back(), 0.0, 1e-4);
+
+			const auto s24 = dsd.ToS24({ones.data(), ones.size()});
+			ASSERT_FALSE(s24.empty());
+
+			/* full scale is clamped */
+			EXPECT_GE(s24.back(), 0x7fff00);
+			EXPECT_LE(s24.back(), 0x7fffff);
+		}
+	}
+}
+
+TEST(PcmTest, DsdChooseDecimation)
+{
+	/* DSD64 */
+	EXPECT_EQ(PcmDsd::ChooseDecimation(352800, 352800), 8u);
+	EXPECT_EQ(PcmDsd::ChooseDecimation(352800, 176400), 16u);
+	EXPECT_EQ(PcmDsd::ChooseDecimation(352800, 88200), 32u);
+	EXPECT_EQ(PcmDsd::ChooseDecimation(352800, 44100), 32u);
+	EXPECT_EQ(PcmDsd::ChooseDecimation(352800, 96000), 16u);
+
+	/* DSD256 */
+	EXPECT_EQ(PcmDsd::ChooseDecimation(1411200, 384000), 16u);
+	EXPECT_EQ(PcmDsd::ChooseDecimation(1411200, 352800), 32u);
+
+	/* upsampling */
+	EXPECT_EQ(PcmDsd::ChooseDecimation(352800, 768000), 8u);
+}
+
+TEST(PcmTest, BitReverse)
+{
+	/* enough bytes for the SIMD kernels, with varying tails and
+	   unaligned start */
+	const auto src = RandomDsd(259);
+
+	for (size_t offset = 0; offset < 3; ++offset) {
+		for (size_t n = 0; n + offset <= src.size(); n += 37) {
+			std::vector<uint8_t> dest(n + 1, 0xde);
+			PcmBitReverse(dest.data(), src.data() + offset, n);
+
+			for (size_t i = 0; i < n; ++i)
+				EXPECT_EQ(bit_reverse(src[offset + i]), dest[i]);
+			EXPECT_EQ(0xde, dest[n]);
+		}
+	}
+
+	/* in place */
+	auto buffer = src;
+	PcmBitReverse(buffer.data(), buffer.data(), buffer.size());
+	for (size_t i = 0; i < src.size(); ++i)
+		EXPECT_EQ(bit_reverse(src[i]), buffer[i]);
+}
@@ -19,12 +19,18 @@
 
 #include "config.h"
 #include "pcm/Export.hxx"
+#include "pcm/Order.hxx"
+#include "pcm/Pack.hxx"
 #include "pcm/Traits.hxx"
 #include "util/ByteOrder.hxx"
+#include "util/ByteReverse.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <gtest/gtest.h>
 
+#include <random>
+#include <vector>
+
 #include <string.h>
 
 TEST(PcmTest, ExportShift8)
@@ -442,3 +448,159 @@ TEST(PcmTest, ExportAlsaChannelOrder)
 	TestAlsaChannelOrder51<SampleFormat::S32>();
 	TestAlsaChannelOrder71<SampleFormat::S32>();
 }
+
+/**
+ * Export with the separate (unfused) steps, the way PcmExport used
+ * to do it.
+ */
+static std::vector<uint8_t>
+ReferenceExport(ConstBuffer<void> src, SampleFormat format, unsigned channels,
+		const PcmExport::Params &params)
+{
+	PcmBuffer order_buffer;
+	if (params.alsa_channel_order)
+		src = ToAlsaChannelOrder(order_buffer, src, format, channels);
+
+	std::vector<uint8_t> result((const uint8_t *)src.data,
+				    (const uint8_t *)src.data + src.size);
+	size_t sample_size = sample_format_size(format);
+
+	if (params.pack24) {
+		const auto s = ConstBuffer<int32_t>::FromVoid(src);
+		result.resize(s.size * 3);
+		pcm_pack_24(result.data(), s.begin(), s.end());
+		sample_size = 3;
+	} else if (params.shift8) {
+		const auto s = ConstBuffer<int32_t>::FromVoid(src);
+		for (size_t i = 0; i < s.size; ++i) {
+			const uint32_t x = uint32_t(s[i]) << 8;
+			memcpy(result.data() + i * 4, &x, 4);
+		}
+	}
+
+	if (params.reverse_endian && sample_size > 1) {
+		std::vector<uint8_t> reversed(result.size());
+		reverse_bytes(reversed.data(), result.data(),
+			      result.data() + result.size(), sample_size);
+		result = std::move(reversed);
+	}
+
+	return result;
+}
+
+/**
+ * Compare the single-pass export with the reference for all
+ * combinations of options.
+ */
+TEST(PcmTest, ExportCombined)
+{
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<unsigned> dis(0, 0xff);
+
+	for (const auto format : {SampleFormat::S16, SampleFormat::S24_P32,
+				  SampleFormat::S32}) {
+		for (unsigned channels = 1; channels <= 8; ++channels) {
+			for (unsigned flags = 0; flags < 16; ++flags) {
+				PcmExport::Params params;
+				params.alsa_channel_order = flags & 1;
+				params.shift8 = (flags & 6) == 2;
+				params.pack24 = (flags & 6) == 4;
+				params.reverse_endian = flags & 8;
+
+				if ((params.shift8 || params.pack24) &&
+				    format != SampleFormat::S24_P32)
+					continue;
+
+				/* a few groups plus a partial one */
+				const size_t n_frames = 77;
+				std::vector<uint8_t> src(n_frames * channels *
+							 sample_format_size(format));
+				for (auto &i : src)
+					i = dis(gen);
+
+				PcmExport e;
+				e.Open(format, channels, params);
+
+				const auto expected =
+					ReferenceExport({src.data(), src.size()},
+							format, channels, params);
+				const auto dest = e.Export({src.data(), src.size()});
+
+				ASSERT_EQ(expected.size(), dest.size);
+				EXPECT_EQ(memcmp(dest.data, expected.data(),
+						 dest.size), 0)
+					<< "channels=" << channels
+					<< " flags=" << flags;
+			}
+		}
+	}
+}
+
+#ifdef ENABLE_DSD
+
+/**
+ * Compare the DSD conversion with a chained byte swap, shift or pack
+ * with the separate steps, feeding the input in odd chunks.
+ */
+TEST(PcmTest, ExportDsdCombined)
+{
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<unsigned> dis(0, 0xff);
+	std::uniform_int_distribution<size_t> chunk_dis(0, 37);
+
+	for (const auto dsd_mode : {PcmExport::DsdMode::U16,
+				    PcmExport::DsdMode::U32,
+				    PcmExport::DsdMode::DOP}) {
+		const SampleFormat format = dsd_mode == PcmExport::DsdMode::U16
+			? SampleFormat::S16
+			: (dsd_mode == PcmExport::DsdMode::U32
+			   ? SampleFormat::S32
+			   : SampleFormat::S24_P32);
+
+		for (unsigned channels = 1; channels <= 8; ++channels) {
+			for (unsigned flags = 0; flags < 8; ++flags) {
+				PcmExport::Params params;
+				params.dsd_mode = dsd_mode;
+				params.shift8 = (flags & 3) == 1;
+				params.pack24 = (flags & 3) == 2;
+				params.reverse_endian = flags & 4;
+
+				if ((flags & 3) == 3 ||
+				    ((params.shift8 || params.pack24) &&
+				     format != SampleFormat::S24_P32))
+					continue;
+
+				PcmExport::Params plain_params;
+				plain_params.dsd_mode = dsd_mode;
+
+				PcmExport e, plain;
+				e.Open(SampleFormat::DSD, channels, params);
+				plain.Open(SampleFormat::DSD, channels, plain_params);
+
+				std::vector<uint8_t> dest, converted;
+				for (unsigned i = 0; i < 50; ++i) {
+					std::vector<uint8_t> src(chunk_dis(gen) * channels);
+					for (auto &j : src)
+						j = dis(gen);
+
+					const auto d = ConstBuffer<uint8_t>::FromVoid(e.Export({src.data(), src.size()}));
+					dest.insert(dest.end(), d.begin(), d.end());
+
+					const auto c = ConstBuffer<uint8_t>::FromVoid(plain.Export({src.data(), src.size()}));
+					converted.insert(converted.end(), c.begin(), c.end());
+				}
+
+				const auto expected =
+					ReferenceExport({converted.data(), converted.size()},
+							format, channels, params);
+
+				ASSERT_EQ(expected.size(), dest.size());
+				EXPECT_EQ(expected, dest)
+					<< "channels=" << channels
+					<< " flags=" << flags;
+			}
+		}
+	}
+}
+
+#endif
@@ -22,6 +22,8 @@
 #include "pcm/Dither.hxx"
 #include "pcm/Buffer.hxx"
 #include "pcm/SampleFormat.hxx"
+#include "pcm/ShiftConvert.hxx"
+#include "pcm/FloatConvert.hxx"
 
 #include <gtest/gtest.h>
 
@@ -159,3 +161,113 @@ TEST(PcmTest, FormatFloat32)
 	for (size_t i = 4; i < N; ++i)
 		EXPECT_NEAR(src[i], d[i], error);
 }
+
+/*
+ * Compare the converters (which may use SIMD kernels) with the
+ * portable per-sample implementations; the remainder of N=509 after
+ * the last full block exercises the portable tail.
+ */
+
+template<typename C, typename D, typename S>
+static void
+CheckSameAs(const D &d, const S &src)
+{
+	EXPECT_EQ(src.size(), d.size);
+
+	for (size_t i = 0; i < src.size(); ++i)
+		EXPECT_EQ(C::Convert(src[i]), d[i]) << "sample " << i;
+}
+
+TEST(PcmTest, FormatIntegerConvertExact)
+{
+	constexpr size_t N = 509;
+	const auto src8 = TestDataBuffer<int8_t, N>();
+	const auto src16 = TestDataBuffer<int16_t, N>();
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	const auto src32 = TestDataBuffer<int32_t, N>();
+
+	PcmBuffer buffer;
+	PcmDither dither;
+
+	CheckSameAs<LeftShiftSampleConvert<SampleFormat::S8,
+					   SampleFormat::S16>>
+		(pcm_convert_to_16(buffer, dither, SampleFormat::S8, src8),
+		 src8);
+	CheckSameAs<LeftShiftSampleConvert<SampleFormat::S8,
+					   SampleFormat::S24_P32>>
+		(pcm_convert_to_24(buffer, SampleFormat::S8, src8), src8);
+	CheckSameAs<LeftShiftSampleConvert<SampleFormat::S8,
+					   SampleFormat::S32>>
+		(pcm_convert_to_32(buffer, SampleFormat::S8, src8), src8);
+	CheckSameAs<LeftShiftSampleConvert<SampleFormat::S16,
+					   SampleFormat::S24_P32>>
+		(pcm_convert_to_24(buffer, SampleFormat::S16, src16), src16);
+	CheckSameAs<LeftShiftSampleConvert<SampleFormat::S16,
+					   SampleFormat::S32>>
+		(pcm_convert_to_32(buffer, SampleFormat::S16, src16), src16);
+	CheckSameAs<LeftShiftSampleConvert<SampleFormat::S24_P32,
+					   SampleFormat::S32>>
+		(pcm_convert_to_32(buffer, SampleFormat::S24_P32, src24),
+		 src24);
+	CheckSameAs<RightShiftSampleConvert<SampleFormat::S32,
+					    SampleFormat::S24_P32>>
+		(pcm_convert_to_24(buffer, SampleFormat::S32, src32), src32);
+}
+
+TEST(PcmTest, FormatToFloatExact)
+{
+	constexpr size_t N = 509;
+	const auto src8 = TestDataBuffer<int8_t, N>();
+	const auto src16 = TestDataBuffer<int16_t, N>();
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	const auto src32 = TestDataBuffer<int32_t, N>();
+
+	PcmBuffer buffer;
+
+	CheckSameAs<IntegerToFloatSampleConvert<SampleFormat::S8>>
+		(pcm_convert_to_float(buffer, SampleFormat::S8, src8), src8);
+	CheckSameAs<IntegerToFloatSampleConvert<SampleFormat::S16>>
+		(pcm_convert_to_float(buffer, SampleFormat::S16, src16),
+		 src16);
+	CheckSameAs<IntegerToFloatSampleConvert<SampleFormat::S24_P32>>
+		(pcm_convert_to_float(buffer, SampleFormat::S24_P32, src24),
+		 src24);
+	CheckSameAs<IntegerToFloatSampleConvert<SampleFormat::S32>>
+		(pcm_convert_to_float(buffer, SampleFormat::S32, src32),
+		 src32);
+}
+
+/**
+ * Random floats well beyond [-1, 1], so a good part of the samples
+ * needs clamping.
+ */
+struct RandomLoudFloat : RandomFloat {
+	float operator()() {
+		return RandomFloat::operator()() * 3;
+	}
+};
+
+TEST(PcmTest, FormatFromFloatExact)
+{
+	constexpr size_t N = 509;
+	auto src = TestDataBuffer<float, N>(RandomLoudFloat());
+
+	/* exact limits and values around them */
+	static constexpr float special[] = {
+		0, 1, -1, 10, -10,
+		0.999999f, -0.999999f, 1.000001f, -1.000001f,
+		0.5f / 32768, -0.5f / 32768, 1.5f / 32768, -1.5f / 32768,
+	};
+	std::copy(std::begin(special), std::end(special), src.begin());
+
+	PcmBuffer buffer;
+	PcmDither dither;
+
+	CheckSameAs<FloatToIntegerSampleConvert<SampleFormat::S16>>
+		(pcm_convert_to_16(buffer, dither, SampleFormat::FLOAT, src),
+		 src);
+	CheckSameAs<FloatToIntegerSampleConvert<SampleFormat::S24_P32>>
+		(pcm_convert_to_24(buffer, SampleFormat::FLOAT, src), src);
+	CheckSameAs<FloatToIntegerSampleConvert<SampleFormat::S32>>
+		(pcm_convert_to_32(buffer, SampleFormat::FLOAT, src), src);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "test_pcm_util.hxx"
+#include "pcm/FusedConvert.hxx"
+#include "pcm/FormatConverter.hxx"
+#include "pcm/ChannelsConverter.hxx"
+#include "pcm/Traits.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+/**
+ * Compare the output of #PcmFusedConverter with the one of the
+ * generic chain (#PcmFormatConverter followed by
+ * #PcmChannelsConverter).
+ */
+template<SampleFormat SF, SampleFormat DF, typename G>
+static void
+CheckFused(unsigned src_channels, unsigned dest_channels, G g)
+{
+	typedef SampleTraits<SF> ST;
+	typedef SampleTraits<DF> DT;
+
+	constexpr size_t N = 1019;
+	const TestDataBuffer<typename ST::value_type, N * 2> src(g);
+	const ConstBuffer<void> src_buffer(src.begin(),
+					   N * src_channels * sizeof(src[0]));
+
+	PcmFusedConverter fused;
+	ASSERT_TRUE(fused.Open(SF, src_channels, DF, dest_channels));
+
+	PcmFormatConverter format_converter;
+	format_converter.Open(SF, DF);
+
+	PcmChannelsConverter channels_converter;
+	channels_converter.Open(DF, src_channels, dest_channels);
+
+	/* run twice to check that the buffer can be reused */
+	for (unsigned i = 0; i < 2; ++i) {
+		const auto expected = ConstBuffer<typename DT::value_type>::FromVoid(channels_converter.Convert(format_converter.Convert(src_buffer)));
+		const auto actual = ConstBuffer<typename DT::value_type>::FromVoid(fused.Convert(src_buffer));
+
+		ASSERT_EQ(expected.size, N * dest_channels);
+		ASSERT_EQ(actual.size, expected.size);
+
+		for (size_t j = 0; j < expected.size; ++j)
+			EXPECT_EQ(expected[j], actual[j]);
+	}
+
+	channels_converter.Close();
+	format_converter.Close();
+	fused.Close();
+}
+
+template<SampleFormat SF, SampleFormat DF, typename G>
+static void
+CheckFused(G g)
+{
+	CheckFused<SF, DF>(1, 2, g);
+	CheckFused<SF, DF>(2, 1, g);
+}
+
+TEST(PcmTest, FusedIntegerToInteger)
+{
+	CheckFused<SampleFormat::S16, SampleFormat::S24_P32>(RandomInt<int16_t>());
+	CheckFused<SampleFormat::S16, SampleFormat::S32>(RandomInt<int16_t>());
+	CheckFused<SampleFormat::S24_P32, SampleFormat::S32>(RandomInt24());
+	CheckFused<SampleFormat::S32, SampleFormat::S24_P32>(RandomInt<int32_t>());
+}
+
+TEST(PcmTest, FusedFloat)
+{
+	CheckFused<SampleFormat::S16, SampleFormat::FLOAT>(RandomInt<int16_t>());
+	CheckFused<SampleFormat::S24_P32, SampleFormat::FLOAT>(RandomInt24());
+	CheckFused<SampleFormat::S32, SampleFormat::FLOAT>(RandomInt<int32_t>());
+}
+
+TEST(PcmTest, FusedUnsupported)
+{
+	PcmFusedConverter fused;
+	EXPECT_FALSE(fused.Open(SampleFormat::S16, 2,
+				SampleFormat::S32, 6));
+	EXPECT_FALSE(fused.Open(SampleFormat::S8, 1,
+				SampleFormat::S16, 2));
+	EXPECT_FALSE(fused.Open(SampleFormat::FLOAT, 1,
+				SampleFormat::S16, 2));
+	EXPECT_FALSE(fused.Open(SampleFormat::S24_P32, 2,
+				SampleFormat::S16, 1));
+}
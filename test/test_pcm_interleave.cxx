@@ -118,3 +118,72 @@ TEST(PcmTest, Interleave64)
 {
 	TestInterleaveN<uint64_t>();
 }
+
+template<typename T>
+static void
+TestInterleaveStereo()
+{
+	/* enough frames for the SIMD kernels plus a tail */
+	static constexpr size_t n_frames = 67;
+
+	T src1[n_frames], src2[n_frames];
+	for (size_t i = 0; i < n_frames; ++i) {
+		src1[i] = T(2 * i);
+		src2[i] = T(2 * i + 1);
+	}
+
+	const T *src_all[] = { src1, src2 };
+	const ConstBuffer<const void *> src((const void *const*)src_all, 2);
+
+	static constexpr T poison = T(0xdeadbeef);
+	T dest[n_frames * 2 + 1];
+	std::fill_n(dest, std::size(dest), poison);
+
+	PcmInterleave(dest, src, n_frames, sizeof(T));
+
+	for (size_t i = 0; i < n_frames * 2; ++i)
+		EXPECT_EQ(T(i), dest[i]);
+	EXPECT_EQ(poison, dest[n_frames * 2]);
+}
+
+TEST(PcmTest, InterleaveStereo)
+{
+	TestInterleaveStereo<uint8_t>();
+	TestInterleaveStereo<uint16_t>();
+	TestInterleaveStereo<uint32_t>();
+}
+
+template<unsigned channels>
+static void
+TestDeinterleave()
+{
+	/* enough frames for the SIMD kernels plus a tail */
+	static constexpr size_t n_frames = 67;
+
+	int32_t src[n_frames * channels];
+	for (size_t i = 0; i < std::size(src); ++i)
+		src[i] = i;
+
+	static constexpr int32_t poison = 0xdeadbeef;
+	int32_t dest[channels][n_frames + 1];
+	int32_t *dest_all[channels];
+	for (unsigned c = 0; c < channels; ++c) {
+		std::fill_n(dest[c], n_frames + 1, poison);
+		dest_all[c] = dest[c];
+	}
+
+	PcmDeinterleave32({dest_all, channels}, src, n_frames);
+
+	for (unsigned c = 0; c < channels; ++c) {
+		for (size_t i = 0; i < n_frames; ++i)
+			EXPECT_EQ(int32_t(i * channels + c), dest[c][i]);
+		EXPECT_EQ(poison, dest[c][n_frames]);
+	}
+}
+
+TEST(PcmTest, Deinterleave)
+{
+	TestDeinterleave<1>();
+	TestDeinterleave<2>();
+	TestDeinterleave<3>();
+}
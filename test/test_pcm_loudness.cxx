@@ -0,0 +1,98 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "pcm/LoudnessMeter.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+static std::vector<float>
+MakeSine(unsigned sample_rate, unsigned channels, double amplitude,
+	 unsigned seconds, unsigned silent_channel=~0U)
+{
+	std::vector<float> result(size_t(sample_rate) * seconds * channels);
+
+	for (size_t i = 0; i < result.size() / channels; ++i) {
+		const float x = amplitude *
+			std::sin(2 * M_PI * 1000 * i / sample_rate);
+		for (unsigned c = 0; c < channels; ++c)
+			result[i * channels + c] = c == silent_channel ? 0 : x;
+	}
+
+	return result;
+}
+
+static double
+Measure(unsigned sample_rate, unsigned channels,
+	const std::vector<float> &src)
+{
+	LoudnessMeter meter(sample_rate, channels);
+	meter.Feed({src.data(), src.size()});
+	return meter.GetIntegratedLoudness();
+}
+
+/**
+ * EBU Tech 3341 test case 1: a stereo 1 kHz sine wave at -23 dBFS
+ * must measure -23 LUFS.
+ */
+TEST(LoudnessMeter, Sine)
+{
+	const double amplitude = std::pow(10, -23.0 / 20);
+
+	for (unsigned sample_rate : {44100U, 48000U, 96000U}) {
+		const auto src = MakeSine(sample_rate, 2, amplitude, 20);
+		EXPECT_NEAR(Measure(sample_rate, 2, src), -23, 0.1);
+	}
+}
+
+TEST(LoudnessMeter, Peak)
+{
+	const auto src = MakeSine(48000, 1, 0.5, 1);
+
+	LoudnessMeter meter(48000, 1);
+	meter.Feed({src.data(), src.size()});
+	EXPECT_NEAR(meter.GetPeak(), 0.5, 0.001);
+}
+
+TEST(LoudnessMeter, Silence)
+{
+	const std::vector<float> src(48000 * 2 * 5);
+	EXPECT_TRUE(std::isinf(Measure(48000, 2, src)));
+}
+
+TEST(LoudnessMeter, Gate)
+{
+	/* 10 seconds of sine followed by 10 seconds of silence: the
+	   silent blocks are gated, the result is the same */
+	const double amplitude = std::pow(10, -23.0 / 20);
+	auto src = MakeSine(48000, 2, amplitude, 10);
+	src.resize(src.size() * 2);
+	EXPECT_NEAR(Measure(48000, 2, src), -23, 0.1);
+}
+
+TEST(LoudnessMeter, LFE)
+{
+	/* the LFE channel of a 5.1 stream is ignored */
+	const auto a = MakeSine(48000, 6, 0.1, 5);
+	const auto b = MakeSine(48000, 6, 0.1, 5, 3);
+	EXPECT_NEAR(Measure(48000, 6, a), Measure(48000, 6, b), 0.001);
+}
@@ -20,6 +20,9 @@
 #include "test_pcm_util.hxx"
 #include "pcm/Mix.hxx"
 #include "pcm/Dither.hxx"
+#include "pcm/Buffer.hxx"
+#include "pcm/Traits.hxx"
+#include "util/ConstBuffer.hxx"
 
 #include <gtest/gtest.h>
 
@@ -81,3 +84,100 @@ TEST(PcmTest, Mix32)
 {
 	TestPcmMix<int32_t, SampleFormat::S32>();
 }
+
+/**
+ * MixRamp: a negative portion means the samples are added with
+ * clamping.
+ */
+template<typename T, SampleFormat format, typename G=RandomInt<T>>
+static void
+TestPcmAdd(G g=G())
+{
+	typedef SampleTraits<format> Traits;
+
+	constexpr unsigned N = 509;
+	const auto src1 = TestDataBuffer<T, N>(g);
+	const auto src2 = TestDataBuffer<T, N>(g);
+
+	PcmDither dither;
+
+	auto result = src1;
+	bool success = pcm_mix(dither,
+			       result.begin(), src2.begin(), sizeof(result),
+			       format, -1);
+	ASSERT_TRUE(success);
+
+	for (unsigned i = 0; i < N; ++i) {
+		int64_t expected = int64_t(src1[i]) + int64_t(src2[i]);
+		if (expected > Traits::MAX)
+			expected = Traits::MAX;
+		else if (expected < Traits::MIN)
+			expected = Traits::MIN;
+
+		EXPECT_EQ(expected, result[i]);
+	}
+}
+
+TEST(PcmTest, Add8)
+{
+	TestPcmAdd<int8_t, SampleFormat::S8>();
+}
+
+TEST(PcmTest, Add16)
+{
+	TestPcmAdd<int16_t, SampleFormat::S16>();
+}
+
+TEST(PcmTest, Add24)
+{
+	TestPcmAdd<int32_t, SampleFormat::S24_P32>(RandomInt24());
+}
+
+TEST(PcmTest, Add32)
+{
+	TestPcmAdd<int32_t, SampleFormat::S32>();
+}
+
+template<typename T, SampleFormat format, typename G=RandomInt<T>>
+static void
+TestPcmMixFloat(int64_t tolerance, G g=G())
+{
+	constexpr unsigned N = 509, N2 = 300;
+	const auto src1 = TestDataBuffer<T, N>(g);
+	const auto src2 = TestDataBuffer<T, N>(g);
+
+	PcmBuffer buffer1, buffer2;
+	PcmDither dither;
+
+	/* the second buffer is shorter; the rest of the first one
+	   must be passed through */
+	auto result = ConstBuffer<T>::FromVoid(pcm_mix_float(buffer1, buffer2,
+							     dither,
+							     ConstBuffer<T>(src1).ToVoid(),
+							     ConstBuffer<T>(src2.begin(), N2).ToVoid(),
+							     format, 0.5));
+	ASSERT_EQ(N, result.size);
+
+	for (unsigned i = 0; i < N2; ++i)
+		EXPECT_NEAR(result[i],
+			    (int64_t(src1[i]) + int64_t(src2[i])) / 2,
+			    tolerance);
+
+	for (unsigned i = N2; i < N; ++i)
+		EXPECT_NEAR(result[i], src1[i], tolerance);
+}
+
+TEST(PcmTest, MixFloat16)
+{
+	TestPcmMixFloat<int16_t, SampleFormat::S16>(1);
+}
+
+TEST(PcmTest, MixFloat24)
+{
+	TestPcmMixFloat<int32_t, SampleFormat::S24_P32>(1, RandomInt24());
+}
+
+TEST(PcmTest, MixFloat32)
+{
+	TestPcmMixFloat<int32_t, SampleFormat::S32>(256);
+}
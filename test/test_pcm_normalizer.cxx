@@ -0,0 +1,98 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "pcm/Normalizer.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static std::vector<float>
+MakeSine(double amplitude, size_t n)
+{
+	std::vector<float> result(n);
+	for (size_t i = 0; i < n; ++i)
+		result[i] = amplitude * std::sin(2 * M_PI * i / 100);
+	return result;
+}
+
+static float
+Peak(const std::vector<float> &v)
+{
+	float peak = 0;
+	for (float i : v)
+		peak = std::max(peak, std::fabs(i));
+	return peak;
+}
+
+TEST(PcmNormalizer, Quiet)
+{
+	PcmNormalizer normalizer;
+
+	/* a quiet signal is amplified towards the target level
+	   (0.5) without overshooting */
+	float peak = 0;
+	for (unsigned i = 0; i < 2000; ++i) {
+		auto buffer = MakeSine(0.05, 1024);
+		normalizer.Process({buffer.data(), buffer.size()});
+		peak = Peak(buffer);
+		EXPECT_LE(peak, 0.5f + 0.001f);
+	}
+
+	EXPECT_NEAR(peak, 0.5, 0.01);
+}
+
+TEST(PcmNormalizer, Loud)
+{
+	PcmNormalizer normalizer;
+
+	/* a loud signal is left alone */
+	auto buffer = MakeSine(0.9, 1024);
+	const auto expected = buffer;
+	normalizer.Process({buffer.data(), buffer.size()});
+	EXPECT_EQ(buffer, expected);
+}
+
+TEST(PcmNormalizer, NoClip)
+{
+	PcmNormalizer normalizer;
+
+	for (unsigned i = 0; i < 2000; ++i) {
+		auto buffer = MakeSine(0.01, 1024);
+		normalizer.Process({buffer.data(), buffer.size()});
+	}
+
+	/* a sudden loud chunk after a long quiet period: the gain
+	   is reduced before the peak, so nothing clips */
+	auto buffer = MakeSine(0.9, 1024);
+	normalizer.Process({buffer.data(), buffer.size()});
+	EXPECT_LE(Peak(buffer), 1.f);
+
+	/* the gain returns to 1 with inertia */
+	for (unsigned i = 0; i < 2000; ++i) {
+		buffer = MakeSine(0.9, 1024);
+		normalizer.Process({buffer.data(), buffer.size()});
+		EXPECT_LE(Peak(buffer), 1.f);
+	}
+
+	EXPECT_NEAR(Peak(buffer), 0.9, 0.01);
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "pcm/SharedConvert.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <string.h>
+
+static constexpr AudioFormat src_format(44100, SampleFormat::S16, 2);
+static constexpr AudioFormat dest_format(48000, SampleFormat::S16, 2);
+
+using Chunk = std::vector<int16_t>;
+
+static std::vector<Chunk>
+MakeChunks(unsigned n, unsigned seed)
+{
+	std::mt19937 gen(seed);
+	std::uniform_int_distribution<int> dis(-32768, 32767);
+
+	std::vector<Chunk> chunks(n);
+	for (auto &chunk : chunks) {
+		chunk.resize(1024 * 2);
+		for (auto &i : chunk)
+			i = dis(gen);
+	}
+
+	return chunks;
+}
+
+static std::vector<uint8_t>
+ToVector(ConstBuffer<void> b)
+{
+	const auto *p = (const uint8_t *)b.data;
+	return {p, p + b.size};
+}
+
+template<typename T>
+static ConstBuffer<void>
+ToBuffer(const std::vector<T> &chunk)
+{
+	return {chunk.data(), chunk.size() * sizeof(chunk.front())};
+}
+
+/**
+ * Convert the chunks with a private #PcmConvert.
+ */
+template<typename T>
+static std::vector<std::vector<uint8_t>>
+Reference(const std::vector<std::vector<T>> &chunks, size_t begin=0,
+	  AudioFormat src=src_format, AudioFormat dest=dest_format)
+{
+	PcmConvert convert(src, dest);
+
+	std::vector<std::vector<uint8_t>> result;
+	for (size_t i = begin; i < chunks.size(); ++i)
+		result.emplace_back(ToVector(convert.Convert(ToBuffer(chunks[i]))));
+
+	return result;
+}
+
+TEST(PcmTest, SharedConvert)
+{
+	const auto chunks = MakeChunks(20, 1);
+	const auto expected = Reference(chunks);
+
+	PcmConvertCache cache;
+	SharedPcmConvert a(cache, src_format, dest_format);
+	SharedPcmConvert b(cache, src_format, dest_format);
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		const auto ra = a.Convert(ToBuffer(chunks[i]));
+		const auto rb = b.Convert(ToBuffer(chunks[i]));
+
+		EXPECT_EQ(expected[i], ToVector(ra));
+
+		/* the second one gets the same buffer */
+		EXPECT_EQ(ra.data, rb.data);
+		EXPECT_EQ(ra.size, rb.size);
+	}
+}
+
+TEST(PcmTest, SharedConvertDiverge)
+{
+	const auto chunks = MakeChunks(20, 2);
+	auto other_chunks = chunks;
+	for (size_t i = 10; i < other_chunks.size(); ++i)
+		other_chunks[i][0] ^= 1;
+
+	const auto expected = Reference(chunks);
+	const auto expected_other = Reference(other_chunks, 10);
+
+	PcmConvertCache cache;
+	SharedPcmConvert a(cache, src_format, dest_format);
+	SharedPcmConvert b(cache, src_format, dest_format);
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		EXPECT_EQ(expected[i], ToVector(a.Convert(ToBuffer(chunks[i]))));
+
+		/* after the inputs diverge, "b" gets its own
+		   converter */
+		const auto rb = ToVector(b.Convert(ToBuffer(other_chunks[i])));
+		if (i < 10)
+			EXPECT_EQ(expected[i], rb);
+		else
+			EXPECT_EQ(expected_other[i - 10], rb);
+	}
+}
+
+TEST(PcmTest, SharedConvertLag)
+{
+	const size_t n = PcmConvertCache::MAX_ENTRIES + 20;
+	const auto chunks = MakeChunks(n, 3);
+	const auto expected = Reference(chunks);
+
+	PcmConvertCache cache;
+	SharedPcmConvert a(cache, src_format, dest_format);
+	SharedPcmConvert late(cache, src_format, dest_format);
+	SharedPcmConvert slow(cache, src_format, dest_format);
+
+	/* "late" joins at chunk 5 and still finds the shared
+	   stream, so it gets the same (continuous) output as "a";
+	   "slow" stops at chunk 10 and falls behind by more than
+	   MAX_ENTRIES, so it loses the stream */
+	std::vector<std::vector<uint8_t>> slow_result;
+	for (size_t i = 0; i < n; ++i) {
+		EXPECT_EQ(expected[i], ToVector(a.Convert(ToBuffer(chunks[i]))));
+
+		if (i >= 5) {
+			EXPECT_EQ(expected[i],
+				  ToVector(late.Convert(ToBuffer(chunks[i]))));
+		}
+
+		if (i < 10)
+			slow_result.emplace_back(ToVector(slow.Convert(ToBuffer(chunks[i]))));
+	}
+
+	const auto expected_slow = Reference(chunks, 10);
+	for (size_t i = 10; i < n; ++i)
+		slow_result.emplace_back(ToVector(slow.Convert(ToBuffer(chunks[i]))));
+
+	for (size_t i = 0; i < 10; ++i)
+		EXPECT_EQ(expected[i], slow_result[i]);
+
+	/* after losing the stream, "slow" continues with a new
+	   #PcmConvert, as if the stream had been restarted at chunk
+	   10 (see SharedConvertLagRestart) */
+	for (size_t i = 10; i < n; ++i)
+		EXPECT_EQ(expected_slow[i - 10], slow_result[i]);
+}
+
+/**
+ * A consumer which lags behind too much continues with a new
+ * #PcmConvert, and the state of the old one is lost.  This is an
+ * audible discontinuity; here, it is made visible with the state of
+ * the noise shaping ditherer.
+ */
+TEST(PcmTest, SharedConvertLagRestart)
+{
+	static constexpr AudioFormat dither_src(44100, SampleFormat::S24_P32, 2);
+	static constexpr AudioFormat dither_dest(44100, SampleFormat::S16, 2);
+
+	const size_t n = PcmConvertCache::MAX_ENTRIES + 20;
+
+	std::mt19937 gen(7);
+	std::uniform_int_distribution<int32_t> dis(-0x800000, 0x7fffff);
+	std::vector<std::vector<int32_t>> chunks(n);
+	for (auto &chunk : chunks) {
+		chunk.resize(1024 * 2);
+		for (auto &i : chunk)
+			i = dis(gen);
+	}
+
+	const auto expected = Reference(chunks, 0, dither_src, dither_dest);
+	const auto expected_restart = Reference(chunks, 10,
+						dither_src, dither_dest);
+
+	PcmConvertCache cache;
+	SharedPcmConvert a(cache, dither_src, dither_dest);
+	SharedPcmConvert slow(cache, dither_src, dither_dest);
+
+	for (size_t i = 0; i < 10; ++i) {
+		a.Convert(ToBuffer(chunks[i]));
+		EXPECT_EQ(expected[i],
+			  ToVector(slow.Convert(ToBuffer(chunks[i]))));
+	}
+
+	for (size_t i = 10; i < n; ++i)
+		a.Convert(ToBuffer(chunks[i]));
+
+	/* "slow" has lost the stream: its output is the one of a
+	   new converter, not the continuation of the old one */
+	const auto r = ToVector(slow.Convert(ToBuffer(chunks[10])));
+	EXPECT_EQ(expected_restart[0], r);
+	EXPECT_NE(expected[10], r);
+}
+
+TEST(PcmTest, SharedConvertReset)
+{
+	const auto chunks = MakeChunks(10, 4);
+	const auto chunks2 = MakeChunks(10, 5);
+	const auto expected2 = Reference(chunks2);
+
+	PcmConvertCache cache;
+	SharedPcmConvert a(cache, src_format, dest_format);
+	SharedPcmConvert b(cache, src_format, dest_format);
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		a.Convert(ToBuffer(chunks[i]));
+		b.Convert(ToBuffer(chunks[i]));
+	}
+
+	/* "a" seeks first, while "b" still plays the old data */
+	a.Reset();
+	for (size_t i = 0; i < 3; ++i)
+		EXPECT_EQ(expected2[i],
+			  ToVector(a.Convert(ToBuffer(chunks2[i]))));
+
+	b.Reset();
+	for (size_t i = 0; i < chunks2.size(); ++i) {
+		const auto rb = b.Convert(ToBuffer(chunks2[i]));
+		EXPECT_EQ(expected2[i], ToVector(rb));
+
+		if (i >= 3) {
+			/* both share one stream again */
+			const auto ra = a.Convert(ToBuffer(chunks2[i]));
+			EXPECT_EQ(ra.data, rb.data);
+		}
+	}
+}
+
+TEST(PcmTest, SharedConvertThreads)
+{
+	const auto chunks = MakeChunks(200, 6);
+	const auto expected = Reference(chunks);
+
+	PcmConvertCache cache;
+
+	std::vector<std::thread> threads;
+	std::vector<size_t> errors(4);
+	for (auto &e : errors)
+		threads.emplace_back([&cache, &chunks, &expected, &e](){
+			SharedPcmConvert c(cache, src_format, dest_format);
+			for (size_t i = 0; i < chunks.size(); ++i)
+				if (ToVector(c.Convert(ToBuffer(chunks[i]))) != expected[i])
+					++e;
+		});
+
+	for (auto &t : threads)
+		t.join();
+
+	for (auto e : errors)
+		EXPECT_EQ(e, 0u);
+}
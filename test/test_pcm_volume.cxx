@@ -158,3 +158,105 @@ TEST(PcmTest, VolumeFloat)
 
 	pv.Close();
 }
+
+TEST(PcmTest, Volume16to32Loud)
+{
+	/* a volume which doesn't fit into 16 bit */
+	constexpr unsigned volume = 40000;
+
+	PcmVolume pv;
+	EXPECT_EQ(pv.Open(SampleFormat::S16, true), SampleFormat::S24_P32);
+
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<int16_t, N>();
+	const ConstBuffer<void> src(_src, sizeof(_src));
+
+	pv.SetVolume(volume);
+	const auto d = ConstBuffer<int32_t>::FromVoid(pv.Apply(src));
+	EXPECT_EQ(N, d.size);
+
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_EQ((int32_t(_src[i]) * int32_t(volume)) >> 2, d[i]);
+
+	pv.Close();
+}
+
+TEST(PcmTest, VolumeConvert)
+{
+	PcmVolume pv;
+	EXPECT_EQ(pv.Open(SampleFormat::S24_P32, false),
+		  SampleFormat::S24_P32);
+
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<int32_t, N>(RandomInt24());
+	const ConstBuffer<void> src(_src, sizeof(_src));
+
+	/* no-op volume: leave the conversion to somebody else */
+	EXPECT_TRUE(pv.Apply(src, SampleFormat::S16).IsNull());
+
+	pv.SetVolume(0);
+	auto d32 = ConstBuffer<int32_t>::FromVoid(pv.Apply(src, SampleFormat::S32));
+	EXPECT_EQ(N, d32.size);
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_EQ(0, d32[i]);
+
+	pv.SetVolume(PCM_VOLUME_1 / 2);
+
+	d32 = ConstBuffer<int32_t>::FromVoid(pv.Apply(src, SampleFormat::S32));
+	EXPECT_EQ(N, d32.size);
+	for (size_t i = 0; i < N; ++i) {
+		EXPECT_GE(d32[i], _src[i] * 128 - 2);
+		EXPECT_LE(d32[i], _src[i] * 128 + 2);
+	}
+
+	auto d16 = ConstBuffer<int16_t>::FromVoid(pv.Apply(src, SampleFormat::S16));
+	EXPECT_EQ(N, d16.size);
+	for (size_t i = 0; i < N; ++i) {
+		const int expected = _src[i] / 512;
+		EXPECT_GE(d16[i], expected - 4);
+		EXPECT_LE(d16[i], expected + 4);
+	}
+
+	auto f = ConstBuffer<float>::FromVoid(pv.Apply(src, SampleFormat::FLOAT));
+	EXPECT_EQ(N, f.size);
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_FLOAT_EQ(_src[i] / float(1 << 24), f[i]);
+
+	/* too loud: clip instead of wrapping around */
+	pv.SetVolume(PCM_VOLUME_1 * 4);
+	d16 = ConstBuffer<int16_t>::FromVoid(pv.Apply(src, SampleFormat::S16));
+	for (size_t i = 0; i < N; ++i) {
+		const int expected = std::clamp(_src[i] / 64, -32768, 32767);
+		EXPECT_GE(d16[i], expected - 4);
+		EXPECT_LE(d16[i], expected + 4);
+	}
+
+	pv.Close();
+}
+
+TEST(PcmTest, VolumeConvert16)
+{
+	/* the S16 to S24_P32 promotion is skipped if the caller
+	   wants S16 anyway */
+	PcmVolume pv;
+	EXPECT_EQ(pv.Open(SampleFormat::S16, true), SampleFormat::S24_P32);
+
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<int16_t, N>();
+	const ConstBuffer<void> src(_src, sizeof(_src));
+
+	auto dest = pv.Apply(src, SampleFormat::S16);
+	EXPECT_EQ(src.data, dest.data);
+	EXPECT_EQ(src.size, dest.size);
+
+	pv.SetVolume(PCM_VOLUME_1 / 2);
+	const auto d = ConstBuffer<int16_t>::FromVoid(pv.Apply(src, SampleFormat::S16));
+	EXPECT_EQ(N, d.size);
+	for (size_t i = 0; i < N; ++i) {
+		const int expected = (_src[i] + 1) / 2;
+		EXPECT_GE(d[i], expected - 4);
+		EXPECT_LE(d[i], expected + 4);
+	}
+
+	pv.Close();
+}
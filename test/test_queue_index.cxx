@@ -0,0 +1,118 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MakeTag.hxx"
+#include "queue/Queue.hxx"
+#include "song/DetachedSong.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+static SongFilter
+MakeFilter(std::initializer_list<const char *> args)
+{
+	SongFilter filter;
+	filter.Parse({args.begin(), args.size()});
+	return filter;
+}
+
+/**
+ * Evaluate the filter like queue_find() does: with the index if
+ * possible, and fall back to checking all songs.
+ */
+static std::vector<unsigned>
+Find(const Queue &queue, const SongFilter &filter, bool expect_indexed)
+{
+	std::vector<unsigned> candidates, result;
+	EXPECT_EQ(queue.LookupIndex(filter, candidates), expect_indexed);
+
+	if (!expect_indexed)
+		for (unsigned i = 0; i < queue.GetLength(); ++i)
+			candidates.push_back(i);
+
+	for (unsigned i : candidates)
+		if (filter.Match(LightSong{queue.Get(i)}))
+			result.push_back(i);
+
+	return result;
+}
+
+static void
+Append(Queue &queue, const char *uri, const char *artist,
+       const char *title)
+{
+	queue.Append(DetachedSong(uri, MakeTag(TAG_ARTIST, artist,
+					       TAG_TITLE, title)),
+		     0);
+}
+
+TEST(QueueIndex, Lookup)
+{
+	Queue queue(32);
+	Append(queue, "a.ogg", "A", "One");
+	Append(queue, "b.ogg", "B", "Two");
+	Append(queue, "c.ogg", "A", "Three");
+
+	const auto file_b = MakeFilter({"file", "b.ogg"});
+	const auto artist_a = MakeFilter({"artist", "A"});
+	const auto artist_a_three = MakeFilter({"artist", "A", "title", "Three"});
+
+	EXPECT_EQ(Find(queue, file_b, true), std::vector<unsigned>({1}));
+	EXPECT_EQ(Find(queue, artist_a, true), std::vector<unsigned>({0, 2}));
+	EXPECT_EQ(Find(queue, artist_a_three, true),
+		  std::vector<unsigned>({2}));
+	EXPECT_TRUE(Find(queue, MakeFilter({"file", "x.ogg"}), true).empty());
+
+	/* not indexable */
+	EXPECT_EQ(Find(queue, MakeFilter({"(artist != \"A\")"}), false),
+		  std::vector<unsigned>({1}));
+
+	/* the index is updated incrementally */
+
+	Append(queue, "b.ogg", "A", "Four");
+	EXPECT_EQ(Find(queue, file_b, true), std::vector<unsigned>({1, 3}));
+	EXPECT_EQ(Find(queue, artist_a, true),
+		  std::vector<unsigned>({0, 2, 3}));
+
+	queue.DeletePosition(0);
+	EXPECT_EQ(Find(queue, file_b, true), std::vector<unsigned>({0, 2}));
+	EXPECT_EQ(Find(queue, artist_a, true), std::vector<unsigned>({1, 2}));
+
+	/* the freed id may be reused by a song with other values */
+	Append(queue, "d.ogg", "D", "Five");
+	EXPECT_EQ(Find(queue, artist_a, true), std::vector<unsigned>({1, 2}));
+	EXPECT_EQ(Find(queue, MakeFilter({"artist", "D"}), true),
+		  std::vector<unsigned>({3}));
+
+	/* modified songs are found with their new values */
+	queue.Get(0).SetTag(MakeTag(TAG_ARTIST, "A", TAG_TITLE, "Two"));
+	queue.ModifyAtPosition(0);
+	EXPECT_EQ(Find(queue, artist_a, true),
+		  std::vector<unsigned>({0, 1, 2}));
+
+	queue.MovePostion(0, 3);
+	EXPECT_EQ(Find(queue, file_b, true), std::vector<unsigned>({1, 3}));
+
+	queue.Clear();
+	EXPECT_TRUE(Find(queue, artist_a, true).empty());
+}
@@ -4,9 +4,7 @@
 #include <gtest/gtest.h>
 
 #include <iterator>
-
-Tag::Tag(const Tag &) noexcept {}
-void Tag::Clear() noexcept {}
+#include <vector>
 
 static void
 check_descending_priority(const Queue *queue,
@@ -164,3 +162,91 @@ TEST(QueuePriority, Priority)
 	a_order = queue.PositionToOrder(a_position);
 	EXPECT_EQ(6u, a_order);
 }
+
+static void
+check_inverse_order(const Queue &queue)
+{
+	for (unsigned position = 0; position < queue.GetLength(); ++position)
+		EXPECT_EQ(position,
+			  queue.OrderToPosition(queue.PositionToOrder(position)));
+}
+
+TEST(QueuePriority, InverseOrder)
+{
+	Queue queue(64);
+
+	for (unsigned i = 0; i < 32; ++i)
+		queue.Append(DetachedSong("x.ogg"), 0);
+
+	queue.random = true;
+	queue.ShuffleOrder();
+	check_inverse_order(queue);
+
+	queue.SetPriorityRange(8, 16, 10, 2);
+	check_inverse_order(queue);
+
+	queue.MovePostion(3, 20);
+	check_inverse_order(queue);
+
+	queue.MoveRange(10, 14, 2);
+	check_inverse_order(queue);
+
+	queue.MoveOrderAfter(5, 17);
+	check_inverse_order(queue);
+
+	queue.DeletePosition(7);
+	check_inverse_order(queue);
+
+	queue.ShuffleOrderLastWithPriority(0, queue.GetLength());
+	check_inverse_order(queue);
+
+	queue.random = false;
+	queue.RestoreOrder();
+	check_inverse_order(queue);
+}
+
+static void
+check_changes(const Queue &queue, uint32_t version)
+{
+	std::vector<unsigned> positions;
+	ASSERT_TRUE(queue.CollectChanges(version, positions));
+
+	std::vector<unsigned> expected;
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		if (queue.IsNewerAtPosition(i, version))
+			expected.push_back(i);
+
+	EXPECT_EQ(expected, positions);
+}
+
+TEST(QueuePriority, ChangeLog)
+{
+	Queue queue(64);
+
+	for (unsigned i = 0; i < 16; ++i)
+		queue.Append(DetachedSong("x.ogg"), 0);
+	queue.IncrementVersion();
+
+	const uint32_t v1 = queue.version;
+	queue.ModifyAtPosition(3);
+	queue.SwapPositions(7, 9);
+	queue.IncrementVersion();
+
+	const uint32_t v2 = queue.version;
+	queue.MovePostion(12, 14);
+	queue.DeletePosition(15);
+	queue.IncrementVersion();
+
+	check_changes(queue, 0);
+	check_changes(queue, v1);
+	check_changes(queue, v2);
+	check_changes(queue, queue.version);
+
+	/* overflow the change log */
+	for (unsigned i = 0; i < Queue::CHANGE_LOG_SIZE; ++i)
+		queue.ModifyAtPosition(0);
+	queue.IncrementVersion();
+
+	std::vector<unsigned> positions;
+	EXPECT_FALSE(queue.CollectChanges(v1, positions));
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "AudioFormat.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include <string.h>
+
+/**
+ * A fake encoder which copies its input to its output, and
+ * generates markers for all other operations.
+ */
+class CopyEncoder final : public Encoder {
+	std::string output;
+
+public:
+	static inline unsigned n_opened, n_written;
+
+	CopyEncoder() noexcept:Encoder(false), output("H") {
+		++n_opened;
+	}
+
+	void End() override {
+		output.push_back('E');
+	}
+
+	void Flush() override {
+		output.push_back('F');
+	}
+
+	void Write(const void *data, size_t length) override {
+		++n_written;
+		output.append((const char *)data, length);
+	}
+
+	size_t Read(void *dest, size_t length) override {
+		if (length > output.size())
+			length = output.size();
+
+		memcpy(dest, output.data(), length);
+		output.erase(0, length);
+		return length;
+	}
+};
+
+class PreparedCopyEncoder final : public PreparedEncoder {
+public:
+	Encoder *Open(AudioFormat &) override {
+		return new CopyEncoder();
+	}
+};
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+
+static std::unique_ptr<PreparedEncoder>
+MakeShared()
+{
+	return NewSharedEncoder("copy",
+				std::make_unique<PreparedCopyEncoder>());
+}
+
+static std::unique_ptr<Encoder>
+Open(PreparedEncoder &prepared)
+{
+	AudioFormat af = audio_format;
+	std::unique_ptr<Encoder> e(prepared.Open(af));
+	EXPECT_EQ(af, audio_format);
+	return e;
+}
+
+static std::string
+ReadAll(Encoder &encoder)
+{
+	std::string result;
+	char buffer[3];
+	size_t nbytes;
+	while ((nbytes = encoder.Read(buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+	return result;
+}
+
+class SharedEncoderTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		CopyEncoder::n_opened = CopyEncoder::n_written = 0;
+	}
+};
+
+TEST_F(SharedEncoderTest, Basic)
+{
+	auto pa = MakeShared(), pb = MakeShared();
+	auto a = Open(*pa), b = Open(*pb);
+	EXPECT_EQ(1u, CopyEncoder::n_opened);
+
+	EXPECT_EQ(ReadAll(*a), "H");
+	EXPECT_EQ(ReadAll(*b), "H");
+
+	a->Write("abc", 3);
+	a->Write("def", 3);
+	b->Write("abc", 3);
+	EXPECT_EQ(ReadAll(*a), "abcdef");
+	EXPECT_EQ(ReadAll(*b), "abc");
+
+	b->Write("def", 3);
+	b->Write("ghi", 3);
+	a->Write("ghi", 3);
+	EXPECT_EQ(ReadAll(*a), "ghi");
+	EXPECT_EQ(ReadAll(*b), "defghi");
+
+	EXPECT_EQ(3u, CopyEncoder::n_written);
+	EXPECT_EQ(1u, CopyEncoder::n_opened);
+}
+
+TEST_F(SharedEncoderTest, Flush)
+{
+	auto pa = MakeShared(), pb = MakeShared();
+	auto a = Open(*pa), b = Open(*pb);
+
+	/* a flush by one consumer doesn't break sharing */
+	a->Write("abc", 3);
+	a->Flush();
+	a->Write("def", 3);
+	b->Write("abc", 3);
+	b->Write("def", 3);
+	b->Flush();
+
+	EXPECT_EQ(ReadAll(*a), "HabcFdef");
+
+	/* "b" was at the head, so the flush was performed */
+	EXPECT_EQ(ReadAll(*b), "HabcFdefF");
+	EXPECT_EQ(2u, CopyEncoder::n_written);
+}
+
+TEST_F(SharedEncoderTest, Join)
+{
+	auto pa = MakeShared(), pb = MakeShared();
+	auto a = Open(*pa);
+	a->Write("abc", 3);
+
+	/* a late consumer gets the header, followed by new data */
+	auto b = Open(*pb);
+	a->Write("def", 3);
+	b->Write("def", 3);
+
+	EXPECT_EQ(ReadAll(*a), "Habcdef");
+	EXPECT_EQ(ReadAll(*b), "Hdef");
+	EXPECT_EQ(1u, CopyEncoder::n_opened);
+	EXPECT_EQ(2u, CopyEncoder::n_written);
+}
+
+TEST_F(SharedEncoderTest, Diverge)
+{
+	auto pa = MakeShared(), pb = MakeShared();
+	auto a = Open(*pa), b = Open(*pb);
+
+	a->Write("abc", 3);
+	b->Write("abc", 3);
+	a->Write("def", 3);
+	b->Write("xyz", 3);
+	a->Write("ghi", 3);
+	b->Write("uvw", 3);
+
+	EXPECT_EQ(ReadAll(*a), "Habcdefghi");
+	EXPECT_EQ(ReadAll(*b), "HabcHxyzuvw");
+	EXPECT_EQ(2u, CopyEncoder::n_opened);
+}
+
+TEST_F(SharedEncoderTest, End)
+{
+	auto pa = MakeShared(), pb = MakeShared();
+	auto a = Open(*pa), b = Open(*pb);
+
+	a->Write("abc", 3);
+	a->End();
+	EXPECT_EQ(ReadAll(*a), "Habc");
+	a.reset();
+
+	/* the other consumer can continue */
+	b->Write("abc", 3);
+	b->Write("def", 3);
+	b->End();
+	EXPECT_EQ(ReadAll(*b), "HabcdefE");
+}
+
+TEST_F(SharedEncoderTest, Lag)
+{
+	auto pa = MakeShared(), pb = MakeShared();
+	auto a = Open(*pa), b = Open(*pb);
+
+	std::string expected = "H";
+	for (unsigned i = 0; i < 100; ++i) {
+		const std::string s = std::to_string(i) + ",";
+		a->Write(s.data(), s.size());
+		expected += s;
+	}
+
+	EXPECT_EQ(ReadAll(*a), expected);
+
+	/* "b" has lost track and gets its own stream */
+	b->Write("0,", 2);
+	EXPECT_EQ(ReadAll(*b), "HH0,");
+	EXPECT_EQ(2u, CopyEncoder::n_opened);
+}
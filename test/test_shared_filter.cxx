@@ -0,0 +1,154 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "filter/SharedFilter.hxx"
+#include "filter/Filter.hxx"
+#include "filter/Prepared.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S32, 1);
+
+/**
+ * A stateful test filter: each output sample is the sum of all
+ * input samples so far.
+ */
+class SumFilter final : public Filter {
+	unsigned &invocations;
+
+	int32_t sum = 0;
+
+	std::vector<int32_t> buffer;
+
+public:
+	SumFilter(AudioFormat _audio_format, unsigned &_invocations) noexcept
+		:Filter(_audio_format), invocations(_invocations) {}
+
+	void Reset() noexcept override {
+		sum = 0;
+	}
+
+	ConstBuffer<void> FilterPCM(ConstBuffer<void> _src) override {
+		++invocations;
+
+		const auto src = ConstBuffer<int32_t>::FromVoid(_src);
+		buffer.clear();
+		for (const auto i : src)
+			buffer.push_back(sum += i);
+
+		return ConstBuffer<int32_t>(buffer.data(), buffer.size()).ToVoid();
+	}
+};
+
+class PreparedSumFilter final : public PreparedFilter {
+public:
+	unsigned opened = 0, invocations = 0;
+
+	std::unique_ptr<Filter> Open(AudioFormat &af) override {
+		++opened;
+		return std::make_unique<SumFilter>(af, invocations);
+	}
+};
+
+struct Consumer {
+	PreparedSumFilter *counter;
+	std::unique_ptr<PreparedFilter> prepared;
+	std::unique_ptr<Filter> filter;
+
+	Consumer(FilterCache &cache, const char *name) {
+		auto p = std::make_unique<PreparedSumFilter>();
+		counter = p.get();
+		prepared = shared_filter_prepare(cache, name, std::move(p));
+
+		AudioFormat af = audio_format;
+		filter = prepared->Open(af);
+	}
+
+	std::vector<int32_t> Apply(std::vector<int32_t> src) {
+		const ConstBuffer<int32_t> input(src.data(), src.size());
+		const auto result = ConstBuffer<int32_t>::FromVoid(filter->FilterPCM(input.ToVoid()));
+		return {result.begin(), result.end()};
+	}
+};
+
+TEST(SharedFilter, Shared)
+{
+	FilterCache cache;
+	Consumer a(cache, "eq"), b(cache, "eq");
+
+	EXPECT_EQ(a.Apply({1, 2, 3}), (std::vector<int32_t>{1, 3, 6}));
+	EXPECT_EQ(b.Apply({1, 2, 3}), (std::vector<int32_t>{1, 3, 6}));
+	EXPECT_EQ(b.Apply({4}), (std::vector<int32_t>{10}));
+	EXPECT_EQ(a.Apply({4}), (std::vector<int32_t>{10}));
+
+	/* the filter was opened and invoked only once */
+	EXPECT_EQ(a.counter->opened + b.counter->opened, 1u);
+	EXPECT_EQ(a.counter->invocations + b.counter->invocations, 2u);
+}
+
+TEST(SharedFilter, Names)
+{
+	FilterCache cache;
+	Consumer a(cache, "eq"), b(cache, "other");
+
+	EXPECT_EQ(a.Apply({1, 2}), (std::vector<int32_t>{1, 3}));
+	EXPECT_EQ(b.Apply({1, 2}), (std::vector<int32_t>{1, 3}));
+
+	/* different names never share */
+	EXPECT_EQ(a.counter->invocations, 1u);
+	EXPECT_EQ(b.counter->invocations, 1u);
+}
+
+TEST(SharedFilter, Diverge)
+{
+	FilterCache cache;
+	Consumer a(cache, "eq"), b(cache, "eq");
+
+	EXPECT_EQ(a.Apply({1}), (std::vector<int32_t>{1}));
+	EXPECT_EQ(b.Apply({1}), (std::vector<int32_t>{1}));
+
+	/* "b" gets different input and moves to a new filter
+	   instance, which has not seen the previous data */
+	EXPECT_EQ(a.Apply({2}), (std::vector<int32_t>{3}));
+	EXPECT_EQ(b.Apply({5}), (std::vector<int32_t>{5}));
+	EXPECT_EQ(a.Apply({2}), (std::vector<int32_t>{5}));
+	EXPECT_EQ(b.Apply({5}), (std::vector<int32_t>{10}));
+}
+
+TEST(SharedFilter, Reset)
+{
+	FilterCache cache;
+	Consumer a(cache, "eq"), b(cache, "eq");
+
+	a.Apply({1});
+	b.Apply({1});
+
+	a.filter->Reset();
+	b.filter->Reset();
+
+	/* after a seek, both start from scratch and share again */
+	EXPECT_EQ(a.Apply({7}), (std::vector<int32_t>{7}));
+	EXPECT_EQ(b.Apply({7}), (std::vector<int32_t>{7}));
+	EXPECT_EQ(a.counter->invocations + b.counter->invocations, 2u);
+}
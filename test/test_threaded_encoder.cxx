@@ -0,0 +1,181 @@
+/*
+ * Copyright 2003-2019 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "encoder/ThreadedEncoder.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "AudioFormat.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <string.h>
+
+/**
+ * A fake encoder which copies its input to its output, and
+ * generates markers for all other operations.
+ */
+class CopyEncoder final : public Encoder {
+	std::string output;
+
+public:
+	CopyEncoder() noexcept:Encoder(false), output("H") {}
+
+	void End() override {
+		output.push_back('E');
+	}
+
+	void Flush() override {
+		output.push_back('F');
+	}
+
+	void PreTag() override {
+		output.push_back('P');
+	}
+
+	void Write(const void *data, size_t length) override {
+		if (length >= 4 && memcmp(data, "FAIL", 4) == 0)
+			throw std::runtime_error("Write failed");
+
+		output.append((const char *)data, length);
+	}
+
+	size_t Read(void *dest, size_t length) override {
+		if (length > output.size())
+			length = output.size();
+
+		memcpy(dest, output.data(), length);
+		output.erase(0, length);
+		return length;
+	}
+};
+
+class PreparedCopyEncoder final : public PreparedEncoder {
+public:
+	Encoder *Open(AudioFormat &) override {
+		return new CopyEncoder();
+	}
+
+	const char *GetMimeType() const noexcept override {
+		return "audio/x-copy";
+	}
+};
+
+/* one byte per frame, so the test can write arbitrary strings */
+static constexpr AudioFormat audio_format(44100, SampleFormat::S8, 1);
+
+static std::unique_ptr<Encoder>
+Open(PreparedEncoder &prepared)
+{
+	AudioFormat af = audio_format;
+	return std::unique_ptr<Encoder>(prepared.Open(af));
+}
+
+static std::string
+ReadAll(Encoder &encoder)
+{
+	std::string result;
+	char buffer[7];
+	size_t nbytes;
+	while ((nbytes = encoder.Read(buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+	return result;
+}
+
+static void
+Write(Encoder &encoder, const char *s)
+{
+	encoder.Write(s, strlen(s));
+}
+
+TEST(ThreadedEncoder, Header)
+{
+	auto prepared = NewThreadedEncoder(std::make_unique<PreparedCopyEncoder>());
+	EXPECT_STREQ(prepared->GetMimeType(), "audio/x-copy");
+
+	auto e = Open(*prepared);
+	EXPECT_EQ(ReadAll(*e), "H");
+	EXPECT_EQ(ReadAll(*e), "");
+}
+
+TEST(ThreadedEncoder, Order)
+{
+	auto prepared = NewThreadedEncoder(std::make_unique<PreparedCopyEncoder>());
+	auto e = Open(*prepared);
+
+	std::string expected = "H";
+	for (unsigned i = 0; i < 100; ++i) {
+		Write(*e, "abc");
+		Write(*e, "de");
+		expected += "abcde";
+
+		if (i % 10 == 0) {
+			e->Flush();
+			expected += 'F';
+		}
+
+		if (i % 33 == 0) {
+			e->PreTag();
+			expected += 'P';
+		}
+	}
+
+	e->End();
+	expected += 'E';
+
+	/* End() has waited for the thread, so everything is
+	   available now */
+	EXPECT_EQ(ReadAll(*e), expected);
+}
+
+TEST(ThreadedEncoder, Large)
+{
+	auto prepared = NewThreadedEncoder(std::make_unique<PreparedCopyEncoder>());
+	auto e = Open(*prepared);
+
+	/* more than the queue size, so Write() must wait for the
+	   thread */
+	std::string data;
+	for (unsigned i = 0; i < 3 * 1024 * 1024; ++i)
+		data.push_back('a' + i % 26);
+
+	std::string result;
+	for (size_t i = 0; i < data.size(); i += 65536) {
+		e->Write(data.data() + i, std::min<size_t>(65536,
+							   data.size() - i));
+		result += ReadAll(*e);
+	}
+
+	e->Flush();
+	result += ReadAll(*e);
+
+	EXPECT_EQ(result, "H" + data + "F");
+}
+
+TEST(ThreadedEncoder, Error)
+{
+	auto prepared = NewThreadedEncoder(std::make_unique<PreparedCopyEncoder>());
+	auto e = Open(*prepared);
+
+	Write(*e, "FAIL");
+	EXPECT_THROW(e->Flush(), std::runtime_error);
+	EXPECT_THROW(Write(*e, "abc"), std::runtime_error);
+}
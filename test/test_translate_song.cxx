@@ -14,6 +14,7 @@
 #include "ls.hxx"
 #include "Log.hxx"
 #include "db/DatabaseSong.hxx"
+#include "song/LightSong.hxx"
 #include "storage/StorageInterface.hxx"
 #include "storage/plugins/LocalStorage.hxx"
 #include "Mapper.hxx"
@@ -95,6 +96,13 @@ DatabaseDetachSong(gcc_unused const Database &db,
 	throw std::runtime_error("No such song");
 }
 
+DetachedSong
+DatabaseDetachSong(gcc_unused const Storage *_storage,
+		   const LightSong &song) noexcept
+{
+	return DetachedSong(song);
+}
+
 bool
 DetachedSong::LoadFile(Path path)
 {
@@ -290,3 +298,24 @@ TEST_F(TranslateSongTest, Backslash)
 						   loader));
 #endif
 }
+
+TEST_F(TranslateSongTest, Batch)
+{
+	DetachedSong song1("http://example.com/foo.ogg");
+	DetachedSong song2(uri1, MakeTag1b());
+	DetachedSong song3(uri2, MakeTag2b());
+	auto se1 = ToString(song1);
+	auto se2 = ToString(DetachedSong(uri1, MakeTag1c()));
+
+	/* without a database, relative URIs are rejected */
+	const SongLoader loader(nullptr, nullptr);
+	DetachedSong *songs[] = { &song1, &song2, &song3 };
+	const auto valid = playlist_check_load_songs({songs, 3}, loader);
+
+	ASSERT_EQ(valid.size(), 3u);
+	EXPECT_TRUE(valid[0]);
+	EXPECT_EQ(se1, ToString(song1));
+	EXPECT_TRUE(valid[1]);
+	EXPECT_EQ(se2, ToString(song2));
+	EXPECT_FALSE(valid[2]);
+}